@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "AnalysisManager.h"
+
+#include "CallGraph.h"
+#include "Timer.h"
+#include "Trace.h"
+#include "TypeSystem.h"
+
+AnalysisManager::AnalysisManager() = default;
+
+AnalysisManager::~AnalysisManager() = default;
+
+const ClassHierarchy& AnalysisManager::class_hierarchy(const Scope& scope) {
+  if (!m_class_hierarchy) {
+    Timer t("Building class hierarchy");
+    m_class_hierarchy = build_type_hierarchy(scope);
+  }
+  return *m_class_hierarchy;
+}
+
+const SignatureMap& AnalysisManager::signature_map(const Scope& scope) {
+  if (m_signature_map == nullptr) {
+    Timer t("Building signature map");
+    m_signature_map = m_signature_map_cache.get(scope);
+  }
+  return *m_signature_map;
+}
+
+const method_override_graph::Graph& AnalysisManager::method_override_graph(
+    const Scope& scope) {
+  return m_method_override_graph_cache.get(scope);
+}
+
+const TypeSystem& AnalysisManager::type_system(const Scope& scope) {
+  if (m_type_system == nullptr) {
+    Timer t("Building type system");
+    m_type_system = std::make_unique<const TypeSystem>(scope);
+  }
+  return *m_type_system;
+}
+
+const call_graph::Graph& AnalysisManager::call_graph(const Scope& scope) {
+  if (m_call_graph == nullptr) {
+    Timer t("Building call graph");
+    m_call_graph = std::make_unique<const call_graph::Graph>(
+        call_graph::single_callee_graph(scope));
+  }
+  return *m_call_graph;
+}
+
+const XStoreRefs& AnalysisManager::xstore_refs(const DexStoresVector& stores) {
+  if (m_xstore_refs == nullptr) {
+    m_xstore_refs = std::make_unique<const XStoreRefs>(stores);
+  }
+  return *m_xstore_refs;
+}
+
+ReferenceIndex& AnalysisManager::reference_index(const Scope& scope) {
+  if (m_reference_index == nullptr) {
+    Timer t("Building reference index");
+    m_reference_index = std::make_unique<ReferenceIndex>(scope);
+  }
+  return *m_reference_index;
+}
+
+void AnalysisManager::build(analysis::Set analyses, DexStoresVector& stores) {
+  if (analyses == analysis::NONE) {
+    return;
+  }
+  auto scope = build_class_scope(stores);
+  if (analyses & analysis::CLASS_HIERARCHY) {
+    class_hierarchy(scope);
+  }
+  if (analyses & analysis::SIGNATURE_MAP) {
+    signature_map(scope);
+  }
+  if (analyses & analysis::METHOD_OVERRIDE_GRAPH) {
+    method_override_graph(scope);
+  }
+  if (analyses & analysis::TYPE_SYSTEM) {
+    type_system(scope);
+  }
+  if (analyses & analysis::CALL_GRAPH) {
+    call_graph(scope);
+  }
+  if (analyses & analysis::XSTORE_REFS) {
+    xstore_refs(stores);
+  }
+  if (analyses & analysis::REFERENCE_INDEX) {
+    reference_index(scope);
+  }
+}
+
+void AnalysisManager::invalidate(analysis::Set analyses) {
+  TRACE(PM, 3, "Invalidating analyses 0x%x\n", analyses);
+  if (analyses & analysis::CLASS_HIERARCHY) {
+    m_class_hierarchy = boost::none;
+  }
+  if (analyses & analysis::SIGNATURE_MAP) {
+    // The cache still compares the next scope with the one the map was built
+    // from, and may keep it.
+    m_signature_map.reset();
+  }
+  if (analyses & analysis::METHOD_OVERRIDE_GRAPH) {
+    m_method_override_graph_cache.invalidate();
+  }
+  if (analyses & analysis::TYPE_SYSTEM) {
+    m_type_system.reset();
+  }
+  if (analyses & analysis::CALL_GRAPH) {
+    m_call_graph.reset();
+  }
+  if (analyses & analysis::XSTORE_REFS) {
+    m_xstore_refs.reset();
+  }
+  if (analyses & analysis::REFERENCE_INDEX) {
+    m_reference_index.reset();
+  }
+}
+
+bool AnalysisManager::is_cached(analysis::Kind analysis) const {
+  switch (analysis) {
+  case analysis::CLASS_HIERARCHY:
+    return !!m_class_hierarchy;
+  case analysis::SIGNATURE_MAP:
+    return m_signature_map != nullptr;
+  case analysis::METHOD_OVERRIDE_GRAPH:
+    return m_method_override_graph_cache.is_valid();
+  case analysis::TYPE_SYSTEM:
+    return m_type_system != nullptr;
+  case analysis::CALL_GRAPH:
+    return m_call_graph != nullptr;
+  case analysis::XSTORE_REFS:
+    return m_xstore_refs != nullptr;
+  case analysis::REFERENCE_INDEX:
+    return m_reference_index != nullptr;
+  }
+  not_reached();
+}
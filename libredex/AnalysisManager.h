@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <boost/optional.hpp>
+
+#include "AnalysisSet.h"
+#include "ClassHierarchy.h"
+#include "DexClass.h"
+#include "DexStore.h"
+#include "MethodOverrideGraph.h"
+#include "ReferenceIndex.h"
+#include "VirtualScope.h"
+
+class TypeSystem;
+
+namespace call_graph {
+class Graph;
+} // namespace call_graph
+
+/*
+ * Builds the whole-program analyses on demand and keeps them until they are
+ * invalidated. The PassManager invalidates, after each pass, all the analyses
+ * that the pass does not declare as preserved, so a pass gets an analysis for
+ * free when an earlier pass built it and nothing in between changed what it
+ * depends on.
+ *
+ * The analyses are always of the whole program: the getters must be called
+ * with the whole scope (or all the stores), which is only used to build an
+ * analysis that is not cached. A result stays valid until the next
+ * invalidation of its analysis. A pass that changes what an analysis depends
+ * on, and then needs the analysis again, must invalidate it first.
+ *
+ * This is not thread-safe. Passes must get all the analyses they need before
+ * they start any parallel work.
+ */
+class AnalysisManager {
+ public:
+  AnalysisManager();
+  ~AnalysisManager();
+
+  const ClassHierarchy& class_hierarchy(const Scope& scope);
+
+  const SignatureMap& signature_map(const Scope& scope);
+
+  const method_override_graph::Graph& method_override_graph(
+      const Scope& scope);
+
+  // For the APIs that take a cache, e.g. reachability. It is invalidated
+  // together with METHOD_OVERRIDE_GRAPH.
+  method_override_graph::GraphCache& method_override_graph_cache() {
+    return m_method_override_graph_cache;
+  }
+
+  const TypeSystem& type_system(const Scope& scope);
+
+  const call_graph::Graph& call_graph(const Scope& scope);
+
+  const XStoreRefs& xstore_refs(const DexStoresVector& stores);
+
+  // Unlike the other analyses, the index can be updated as a pass changes
+  // code. A pass that keeps it up to date may preserve REFERENCE_INDEX.
+  ReferenceIndex& reference_index(const Scope& scope);
+
+  // Build all the analyses in `analyses` that are not cached yet.
+  void build(analysis::Set analyses, DexStoresVector& stores);
+
+  void invalidate(analysis::Set analyses);
+
+  bool is_cached(analysis::Kind analysis) const;
+
+ private:
+  boost::optional<ClassHierarchy> m_class_hierarchy;
+  SignatureMapCache m_signature_map_cache;
+  std::shared_ptr<const SignatureMap> m_signature_map;
+  method_override_graph::GraphCache m_method_override_graph_cache;
+  std::unique_ptr<const TypeSystem> m_type_system;
+  std::unique_ptr<const call_graph::Graph> m_call_graph;
+  std::unique_ptr<const XStoreRefs> m_xstore_refs;
+  std::unique_ptr<ReferenceIndex> m_reference_index;
+};
@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+/*
+ * The whole-program analyses that the PassManager keeps from one pass to the
+ * next. Every pass declares, as a Set, the analyses it requires and the ones it
+ * preserves.
+ */
+namespace analysis {
+
+enum Kind : uint32_t {
+  CLASS_HIERARCHY = 1 << 0,
+  SIGNATURE_MAP = 1 << 1,
+  METHOD_OVERRIDE_GRAPH = 1 << 2,
+  TYPE_SYSTEM = 1 << 3,
+  CALL_GRAPH = 1 << 4,
+  XSTORE_REFS = 1 << 5,
+  REFERENCE_INDEX = 1 << 6,
+};
+
+using Set = uint32_t;
+
+constexpr Set NONE = 0;
+
+// The analyses that only depend on the classes, their super types, their
+// interfaces and the signatures of their virtual methods.
+constexpr Set CLASS_HIERARCHY_ANALYSES =
+    CLASS_HIERARCHY | SIGNATURE_MAP | METHOD_OVERRIDE_GRAPH | TYPE_SYSTEM;
+
+// The analyses that don't look at code, which passes that only change code
+// preserve.
+constexpr Set CODE_AGNOSTIC = CLASS_HIERARCHY_ANALYSES | XSTORE_REFS;
+
+constexpr Set ALL = CODE_AGNOSTIC | CALL_GRAPH | REFERENCE_INDEX;
+
+} // namespace analysis
@@ -7,6 +7,10 @@
 
 #include "ApiLevelChecker.h"
 
+#include <numeric>
+
+#include "Parallel.h"
+
 namespace api {
 
 // These initial values are bogus until `init()` is called. We can't initialize
@@ -16,8 +20,9 @@ int32_t LevelChecker::s_min_level = 0;
 DexType* LevelChecker::s_requires_api = nullptr;
 DexType* LevelChecker::s_target_api = nullptr;
 bool LevelChecker::s_has_been_init = false;
+std::unordered_map<const DexClass*, int32_t> LevelChecker::s_class_levels;
 
-void LevelChecker::init(int32_t min_level) {
+void LevelChecker::init(int32_t min_level, const Scope& scope) {
   s_has_been_init = true;
   s_min_level = min_level;
   s_requires_api =
@@ -33,6 +38,17 @@ void LevelChecker::init(int32_t min_level) {
             "WARNING: Unable to find TargetApi annotation. It's either "
             "unused (okay) or been deleted (not okay)\n");
   }
+
+  s_class_levels.clear();
+  std::vector<size_t> indices(scope.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  std::vector<int32_t> levels(scope.size());
+  parallel_for(indices.begin(), indices.end(),
+               [&](size_t i) { levels[i] = get_class_level(scope[i]); });
+  s_class_levels.reserve(scope.size());
+  for (size_t i = 0; i < scope.size(); ++i) {
+    s_class_levels.emplace(scope[i], levels[i]);
+  }
 }
 
 // If the DexMethod (or its containing classes) has a Target/RequiresApi
@@ -43,8 +59,20 @@ int32_t LevelChecker::get_method_level(const DexMethod* method) {
   if (method_level != s_min_level) {
     return method_level;
   }
-  for (DexClass* cls = type_class(method->get_class()); cls != nullptr;
-       cls = get_outer_class(cls)) {
+  const DexClass* cls = type_class(method->get_class());
+  if (cls == nullptr) {
+    return s_min_level;
+  }
+  auto it = s_class_levels.find(cls);
+  if (it != s_class_levels.end()) {
+    return it->second;
+  }
+  // The class was created after `init`.
+  return get_class_level(cls);
+}
+
+int32_t LevelChecker::get_class_level(const DexClass* cls) {
+  for (; cls != nullptr; cls = get_outer_class(cls)) {
     int32_t level = get_level(cls);
     if (level != s_min_level) {
       return level;
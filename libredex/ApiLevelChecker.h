@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <unordered_map>
+
 #include "DexAnnotation.h"
 #include "DexClass.h"
 
@@ -23,12 +25,12 @@ class LevelChecker {
    * because the static instance is created before the classes are loaded.
    *
    * `min_level` is the api level that un-annotated code should be assumed to
-   * have.
+   * have. The levels of the classes of `scope` are computed here, once.
    *
    * After this initialization, `get_method_level` can be called in parallel
    * safely.
    */
-  static void init(int32_t min_level);
+  static void init(int32_t min_level, const Scope& scope);
 
   /**
    * Get the "most specific" api level of this method. If the method is
@@ -82,6 +84,11 @@ class LevelChecker {
  private:
   static DexClass* get_outer_class(const DexClass* cls);
 
+  /**
+   * The level of the class or, if it isn't annotated, of its outer classes.
+   */
+  static int32_t get_class_level(const DexClass* cls);
+
   /**
    * These states are only meant to be edited during `init`. After
    * initialization, these are read-only and safe to use in parallel
@@ -90,6 +97,9 @@ class LevelChecker {
   static DexType* s_requires_api;
   static DexType* s_target_api;
   static bool s_has_been_init;
+  // The result of `get_class_level` for the classes that were in the scope
+  // given to `init`.
+  static std::unordered_map<const DexClass*, int32_t> s_class_levels;
 };
 
 } // namespace api
@@ -38,3 +38,11 @@ std::shared_ptr<FILE*> ApkManager::new_asset_file(const char* filename) {
     throw new std::runtime_error("Error creating new asset file");
   }
 }
+
+ZipWriter* ApkManager::new_zip_file(const char* filename) {
+  check_directory(m_apk_dir);
+  std::ostringstream path;
+  path << m_apk_dir << "/" << filename;
+  m_zips.emplace_back(std::make_unique<ZipWriter>(path.str()));
+  return m_zips.back().get();
+}
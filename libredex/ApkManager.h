@@ -9,6 +9,8 @@
 #include <vector>
 #include <memory>
 
+#include "ZipWriter.h"
+
 class ApkManager {
  public:
    ApkManager(std::string&& apk_dir)
@@ -26,7 +28,13 @@ class ApkManager {
 
    std::shared_ptr<FILE*> new_asset_file(const char* filename);
 
+   // A zip file under the APK directory that entries, e.g. dexes, can be
+   // added to from several threads. It is finished when the ApkManager is
+   // destroyed, unless it was finished before.
+   ZipWriter* new_zip_file(const char* filename);
+
  private:
    std::vector<std::shared_ptr<FILE*>> m_files;
+   std::vector<std::unique_ptr<ZipWriter>> m_zips;
    std::string m_apk_dir;
 };
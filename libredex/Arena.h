@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * A bump allocator. Memory is carved out of large blocks and is only given
+ * back, all at once, when the arena is destroyed. This avoids the per-object
+ * malloc overhead and the heap fragmentation that come with allocating very
+ * many small objects that all live about as long as each other, and keeps
+ * objects that are allocated together close together in memory.
+ *
+ * The arena never runs destructors; owners of objects with non-trivial
+ * destructors must call them explicitly. Not thread-safe.
+ *
+ * Each new block is twice as large as the previous one, up to
+ * `max_block_size`, so that arenas which usually stay small can start with a
+ * small first block.
+ */
+class Arena {
+ public:
+  explicit Arena(size_t block_size = 64 * 1024, size_t max_block_size = 0)
+      : m_block_size(block_size),
+        m_max_block_size(std::max(block_size, max_block_size)) {}
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+    auto cur = reinterpret_cast<uintptr_t>(m_cur);
+    auto aligned = (cur + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (m_cur == nullptr ||
+        aligned + size > reinterpret_cast<uintptr_t>(m_end)) {
+      new_block(size + alignment);
+      cur = reinterpret_cast<uintptr_t>(m_cur);
+      aligned = (cur + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    }
+    m_cur = reinterpret_cast<char*>(aligned + size);
+    m_bytes_allocated += size;
+    return reinterpret_cast<void*>(aligned);
+  }
+
+  template <typename T, typename... Args>
+  T* make(Args&&... args) {
+    return new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+  }
+
+  // Take over the memory of `other`, which is left empty. Objects allocated
+  // from `other` stay where they are and now live as long as this arena.
+  void take_blocks(Arena& other) {
+    m_blocks.insert(m_blocks.end(),
+                    std::make_move_iterator(other.m_blocks.begin()),
+                    std::make_move_iterator(other.m_blocks.end()));
+    other.m_blocks.clear();
+    other.m_cur = other.m_end = nullptr;
+    m_bytes_allocated += other.m_bytes_allocated;
+    m_bytes_reserved += other.m_bytes_reserved;
+    other.m_bytes_allocated = other.m_bytes_reserved = 0;
+  }
+
+  // Bytes handed out so far, excluding alignment padding and unused space at
+  // the end of blocks.
+  size_t bytes_allocated() const { return m_bytes_allocated; }
+
+  // Bytes reserved from the system.
+  size_t bytes_reserved() const { return m_bytes_reserved; }
+
+ private:
+  void new_block(size_t min_size) {
+    auto size = std::max(m_block_size, min_size);
+    m_block_size = std::min(m_block_size * 2, m_max_block_size);
+    m_blocks.emplace_back(new char[size]);
+    m_cur = m_blocks.back().get();
+    m_end = m_cur + size;
+    m_bytes_reserved += size;
+  }
+
+  size_t m_block_size;
+  const size_t m_max_block_size;
+  std::vector<std::unique_ptr<char[]>> m_blocks;
+  char* m_cur{nullptr};
+  char* m_end{nullptr};
+  size_t m_bytes_allocated{0};
+  size_t m_bytes_reserved{0};
+};
+
+/**
+ * Allocates objects of a single type from an Arena. Destroyed objects are kept
+ * on a free list and their memory is reused by later allocations; it goes
+ * back to the system only when the pool is destroyed. Objects still alive at
+ * that point are not destroyed. Not thread-safe.
+ */
+template <typename T>
+class ArenaPool {
+ public:
+  explicit ArenaPool(size_t first_block_objects = 8,
+                     size_t max_block_objects = 512)
+      : m_arena(first_block_objects * sizeof(T),
+                max_block_objects * sizeof(T)) {}
+
+  template <typename... Args>
+  T* make(Args&&... args) {
+    void* mem;
+    if (!m_free.empty()) {
+      mem = m_free.back();
+      m_free.pop_back();
+    } else {
+      mem = m_arena.allocate(sizeof(T), alignof(T));
+    }
+    return new (mem) T(std::forward<Args>(args)...);
+  }
+
+  void destroy(T* obj) {
+    obj->~T();
+    m_free.push_back(obj);
+  }
+
+  // Take over all objects of `other`, live or free, which is left empty.
+  void take_all(ArenaPool& other) {
+    m_arena.take_blocks(other.m_arena);
+    m_free.insert(m_free.end(), other.m_free.begin(), other.m_free.end());
+    other.m_free.clear();
+  }
+
+ private:
+  Arena m_arena;
+  std::vector<void*> m_free;
+};
+
+/**
+ * A standard allocator that carves memory out of an Arena, for containers
+ * whose elements should live in it, like the nodes of an std::map. Freed
+ * memory is not reused, so it suits containers that mostly grow. The arena
+ * must outlive the container. Not thread-safe.
+ */
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+  explicit ArenaAllocator(Arena* arena) : m_arena(arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.arena()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T*, size_t) {}
+
+  Arena* arena() const { return m_arena; }
+
+ private:
+  Arena* m_arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return !(a == b);
+}
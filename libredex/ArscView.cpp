@@ -0,0 +1,206 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ArscView.h"
+
+#include <algorithm>
+
+#include "Debug.h"
+#include "utils/ByteOrder.h"
+#include "utils/String16.h"
+#include "utils/String8.h"
+
+namespace arsc {
+
+namespace {
+
+const android::ResChunk_header* chunk_at(const void* base, size_t offset) {
+  return reinterpret_cast<const android::ResChunk_header*>(
+      static_cast<const char*>(base) + offset);
+}
+
+// Calls fn on each child chunk of a chunk, i.e. on the chunks between the end
+// of its header and its end.
+template <class Fn>
+void for_each_child(const android::ResChunk_header* parent, const Fn& fn) {
+  size_t end = dtohl(parent->size);
+  size_t offset = dtohs(parent->headerSize);
+  while (offset + sizeof(android::ResChunk_header) <= end) {
+    auto chunk = chunk_at(parent, offset);
+    size_t size = dtohl(chunk->size);
+    always_assert_log(size >= sizeof(android::ResChunk_header) &&
+                          offset + size <= end,
+                      "Malformed chunk at offset %zu", offset);
+    fn(chunk);
+    offset += size;
+  }
+}
+
+std::unique_ptr<android::ResStringPool> make_pool(
+    const android::ResStringPool_header* header) {
+  // Without copying, the pool only points into the chunk.
+  auto pool = std::make_unique<android::ResStringPool>(
+      header, dtohl(header->header.size), false /* copyData */);
+  always_assert_log(pool->getError() == android::NO_ERROR,
+                    "Malformed string pool");
+  return pool;
+}
+
+} // namespace
+
+std::string string_at(const android::ResStringPool& pool, size_t idx) {
+  size_t len;
+  if (pool.isUTF8()) {
+    auto chars = pool.string8At(idx, &len);
+    return chars == nullptr ? std::string() : std::string(chars, len);
+  }
+  auto wide_chars = pool.stringAt(idx, &len);
+  if (wide_chars == nullptr) {
+    return std::string();
+  }
+  return android::String8(android::String16(wide_chars, len)).string();
+}
+
+PackageView::PackageView(const android::ResTable_package* package)
+    : m_package(package) {}
+
+uint32_t PackageView::id() const { return dtohl(m_package->id); }
+
+std::string PackageView::name() const {
+  const auto& name = m_package->name;
+  size_t len = 0;
+  while (len < sizeof(name) / sizeof(name[0]) && name[len] != 0) {
+    ++len;
+  }
+  android::String16 s16(reinterpret_cast<const char16_t*>(name), len);
+  return android::String8(s16).string();
+}
+
+const android::ResStringPool& PackageView::type_strings() const {
+  if (m_type_strings == nullptr) {
+    m_type_strings = make_pool(
+        reinterpret_cast<const android::ResStringPool_header*>(
+            chunk_at(m_package, dtohl(m_package->typeStrings))));
+  }
+  return *m_type_strings;
+}
+
+const android::ResStringPool& PackageView::key_strings() const {
+  if (m_key_strings == nullptr) {
+    m_key_strings = make_pool(
+        reinterpret_cast<const android::ResStringPool_header*>(
+            chunk_at(m_package, dtohl(m_package->keyStrings))));
+  }
+  return *m_key_strings;
+}
+
+void PackageView::for_each_type(
+    const std::function<void(const android::ResTable_type*)>& fn) const {
+  for_each_child(&m_package->header,
+                 [&](const android::ResChunk_header* chunk) {
+                   if (dtohs(chunk->type) == android::RES_TABLE_TYPE_TYPE) {
+                     fn(reinterpret_cast<const android::ResTable_type*>(chunk));
+                   }
+                 });
+}
+
+void PackageView::for_each_entry(
+    const std::function<void(uint32_t, const android::ResTable_entry*)>& fn)
+    const {
+  uint32_t package_bits = id() << 24;
+  for_each_type([&](const android::ResTable_type* type) {
+    uint32_t type_bits = static_cast<uint32_t>(type->id) << 16;
+    auto base = reinterpret_cast<const char*>(type);
+    size_t size = dtohl(type->header.size);
+    uint32_t entry_count = dtohl(type->entryCount);
+    size_t entries_start = dtohl(type->entriesStart);
+    auto offsets = reinterpret_cast<const uint32_t*>(
+        base + dtohs(type->header.headerSize));
+    always_assert_log(
+        dtohs(type->header.headerSize) + entry_count * sizeof(uint32_t) <=
+            size,
+        "Malformed type chunk %u", type->id);
+    for (uint32_t i = 0; i < entry_count; ++i) {
+      uint32_t offset = dtohl(offsets[i]);
+      if (offset == android::ResTable_type::NO_ENTRY) {
+        continue;
+      }
+      always_assert_log(
+          entries_start + offset + sizeof(android::ResTable_entry) <= size,
+          "Malformed entry %u of type chunk %u", i, type->id);
+      fn(package_bits | type_bits | i,
+         reinterpret_cast<const android::ResTable_entry*>(
+             base + entries_start + offset));
+    }
+  });
+}
+
+TableView::TableView(const void* data, size_t size)
+    : m_header(static_cast<const android::ResTable_header*>(data)) {
+  always_assert_log(size >= sizeof(android::ResTable_header) &&
+                        dtohs(m_header->header.type) ==
+                            android::RES_TABLE_TYPE &&
+                        dtohl(m_header->header.size) <= size,
+                    "Not a resource table");
+  for_each_child(&m_header->header, [&](const android::ResChunk_header* chunk) {
+    if (m_global_strings_header == nullptr &&
+        dtohs(chunk->type) == android::RES_STRING_POOL_TYPE) {
+      m_global_strings_header =
+          reinterpret_cast<const android::ResStringPool_header*>(chunk);
+    }
+  });
+  always_assert_log(m_global_strings_header != nullptr,
+                    "Resource table without a string pool");
+}
+
+const android::ResStringPool& TableView::global_strings() const {
+  if (m_global_strings == nullptr) {
+    m_global_strings = make_pool(m_global_strings_header);
+  }
+  return *m_global_strings;
+}
+
+void TableView::for_each_package(
+    const std::function<void(PackageView&)>& fn) const {
+  for_each_child(&m_header->header, [&](const android::ResChunk_header* chunk) {
+    if (dtohs(chunk->type) == android::RES_TABLE_PACKAGE_TYPE) {
+      PackageView package(
+          reinterpret_cast<const android::ResTable_package*>(chunk));
+      fn(package);
+    }
+  });
+}
+
+std::map<std::string, std::vector<uint32_t>> get_name_to_ids(
+    const TableView& table) {
+  std::map<std::string, std::vector<uint32_t>> name_to_ids;
+  table.for_each_package([&](PackageView& package) {
+    const auto& keys = package.key_strings();
+    // Decode each key once, however many entries refer to it.
+    std::vector<std::string> key_names(keys.size());
+    std::vector<bool> decoded(keys.size(), false);
+    package.for_each_entry(
+        [&](uint32_t res_id, const android::ResTable_entry* entry) {
+          size_t key = dtohl(entry->key.index);
+          always_assert_log(key < keys.size(), "Bad key of resource 0x%x",
+                            res_id);
+          if (!decoded[key]) {
+            key_names[key] = string_at(keys, key);
+            decoded[key] = true;
+          }
+          name_to_ids[key_names[key]].push_back(res_id);
+        });
+  });
+  for (auto& pair : name_to_ids) {
+    auto& ids = pair.second;
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  }
+  return name_to_ids;
+}
+
+} // namespace arsc
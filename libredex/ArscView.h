@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "androidfw/ResourceTypes.h"
+
+namespace arsc {
+
+// Decodes a string of a pool, whether it is UTF-8 or UTF-16.
+std::string string_at(const android::ResStringPool& pool, size_t idx);
+
+/*
+ * A read-only view over one package of a resources.arsc file. The type and
+ * key string pools are only set up when first asked for, and decode their
+ * strings one at a time.
+ */
+class PackageView {
+ public:
+  explicit PackageView(const android::ResTable_package* package);
+
+  uint32_t id() const;
+  std::string name() const;
+
+  const android::ResStringPool& type_strings() const;
+  const android::ResStringPool& key_strings() const;
+
+  // Calls fn on each ResTable_type chunk of the package, in file order. There
+  // is one per type and configuration.
+  void for_each_type(
+      const std::function<void(const android::ResTable_type*)>& fn) const;
+
+  // Calls fn on each entry of each type chunk, with the id of its resource.
+  // A resource with values for several configurations is seen once per
+  // configuration.
+  void for_each_entry(
+      const std::function<void(uint32_t, const android::ResTable_entry*)>& fn)
+      const;
+
+ private:
+  const android::ResTable_package* m_package;
+  mutable std::unique_ptr<android::ResStringPool> m_type_strings;
+  mutable std::unique_ptr<android::ResStringPool> m_key_strings;
+};
+
+/*
+ * A read-only view over the bytes of a resources.arsc file, e.g. a file
+ * mapped with map_file. Unlike ResTable, nothing is copied: the chunks are
+ * found by walking their headers when iterated. The bytes must outlive the
+ * view. The string pools are set up lazily, so a view must not be shared
+ * between threads.
+ */
+class TableView {
+ public:
+  TableView(const void* data, size_t size);
+
+  const android::ResStringPool& global_strings() const;
+
+  // Calls fn on each package, in file order.
+  void for_each_package(const std::function<void(PackageView&)>& fn) const;
+
+ private:
+  const android::ResTable_header* m_header;
+  const android::ResStringPool_header* m_global_strings_header{nullptr};
+  mutable std::unique_ptr<android::ResStringPool> m_global_strings;
+};
+
+/*
+ * Maps the name of each resource entry to the ids of the resources with that
+ * name, in ascending order. This is the name_to_ids input of
+ * get_js_resources and get_resources_by_name_prefix.
+ */
+std::map<std::string, std::vector<uint32_t>> get_name_to_ids(
+    const TableView& table);
+
+} // namespace arsc
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "ControlFlow.h"
+#include "ControlFlowView.h"
 #include "IRInstruction.h"
 #include "MonotonicFixpointIterator.h"
 
@@ -78,4 +79,70 @@ class BaseBackwardsIRAnalyzer
                                    Domain* current_state) const = 0;
 };
 
+/*
+ * The analyzers above, over a read-only cfg::ControlFlowView. Analyses that
+ * don't need the Blocks and Edges of a ControlFlowGraph can use these to avoid
+ * building one.
+ */
+template <typename Domain>
+class BaseIRViewAnalyzer
+    : public sparta::MonotonicFixpointIterator<cfg::ViewGraphInterface,
+                                               Domain> {
+ public:
+  using NodeId = cfg::ViewGraphInterface::NodeId;
+
+  explicit BaseIRViewAnalyzer(const cfg::ControlFlowView& view)
+      : sparta::MonotonicFixpointIterator<cfg::ViewGraphInterface, Domain>(
+            view, view.num_blocks()) {}
+
+  virtual void analyze_node(const NodeId& node,
+                            Domain* current_state) const override {
+    for (auto& mie :
+         ir_list::ConstInstructionIterable(this->m_graph.entries(node))) {
+      analyze_instruction(mie.insn, current_state);
+    }
+  }
+
+  Domain analyze_edge(const cfg::ViewGraphInterface::EdgeId&,
+                      const Domain& exit_state_at_source) const override {
+    return exit_state_at_source;
+  }
+
+  virtual void analyze_instruction(IRInstruction* insn,
+                                   Domain* current_state) const = 0;
+};
+
+template <typename Domain>
+class BaseBackwardsIRViewAnalyzer
+    : public sparta::MonotonicFixpointIterator<
+          sparta::BackwardsFixpointIterationAdaptor<cfg::ViewGraphInterface>,
+          Domain> {
+ public:
+  using NodeId = cfg::ViewGraphInterface::NodeId;
+
+  explicit BaseBackwardsIRViewAnalyzer(const cfg::ControlFlowView& view)
+      : sparta::MonotonicFixpointIterator<
+            sparta::BackwardsFixpointIterationAdaptor<cfg::ViewGraphInterface>,
+            Domain>(view, view.num_blocks()) {}
+
+  virtual void analyze_node(const NodeId& node,
+                            Domain* current_state) const override {
+    auto entries = this->m_graph.entries(node);
+    for (auto it = entries.end(); it != entries.begin();) {
+      --it;
+      if (it->type == MFLOW_OPCODE) {
+        analyze_instruction(it->insn, current_state);
+      }
+    }
+  }
+
+  Domain analyze_edge(const cfg::ViewGraphInterface::EdgeId&,
+                      const Domain& exit_state_at_source) const override {
+    return exit_state_at_source;
+  }
+
+  virtual void analyze_instruction(IRInstruction* insn,
+                                   Domain* current_state) const = 0;
+};
+
 } // namespace ir_analyzer
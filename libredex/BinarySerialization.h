@@ -7,8 +7,10 @@
 
 #include <boost/bimap/bimap.hpp>
 #include <boost/bimap/unordered_set_of.hpp>
+#include <istream>
 #include <limits>
 #include <ostream>
+#include <string>
 #include <type_traits>
 
 #include "Debug.h"
@@ -38,16 +40,52 @@ void write_array(std::ostream& os, const Container& container) {
   }
 }
 
+/*
+ * Write a string as its size followed by its bytes.
+ */
+inline void write_string(std::ostream& os, const std::string& str) {
+  always_assert(str.size() <= std::numeric_limits<uint32_t>::max());
+  write<uint32_t>(os, str.size());
+  os.write(str.data(), str.size());
+}
+
+/*
+ * Read a string written by write_string(). Returns false if the stream ends
+ * first.
+ */
+inline bool read_string(std::istream& is, std::string* str) {
+  uint32_t size;
+  is.read((char*)&size, sizeof(size));
+  if (!is) {
+    return false;
+  }
+  str->resize(size);
+  is.read(&(*str)[0], size);
+  return bool(is);
+}
+
 /*
  * Write a simple header. Ideally we should use a single header format across
  * all our binary files.
  */
+constexpr uint32_t k_header_magic = 0xfaceb000; // serves as endianess check
+
 inline void write_header(std::ostream& os, uint32_t version) {
-  uint32_t magic = 0xfaceb000; // serves as endianess check
-  write(os, magic);
+  write(os, k_header_magic);
   write(os, version);
 }
 
+/*
+ * Read a header written by write_header(). Returns false if the stream doesn't
+ * start with a valid header.
+ */
+inline bool read_header(std::istream& is, uint32_t* version) {
+  uint32_t magic;
+  is.read((char*)&magic, sizeof(magic));
+  is.read((char*)version, sizeof(*version));
+  return is && magic == k_header_magic;
+}
+
 /*
  * Serialize a graph as an adjacency list. For a graph with N nodes, we will
  * emit N lines of the form
@@ -24,22 +24,31 @@ namespace cfg {
 void CFGInliner::inline_cfg(ControlFlowGraph* caller,
                             const InstructionIterator& callsite,
                             const ControlFlowGraph& callee_orig) {
-  always_assert(&callsite.cfg() == caller);
-
   // copy the callee because we're going to move its contents into the caller
   ControlFlowGraph callee;
   callee_orig.deep_copy(&callee);
+  inline_cfg_by_move(caller, callsite, &callee);
+}
+
+/*
+ * Move callee's blocks into caller
+ */
+void CFGInliner::inline_cfg_by_move(ControlFlowGraph* caller,
+                                    const InstructionIterator& callsite,
+                                    ControlFlowGraph* callee) {
+  always_assert(&callsite.cfg() == caller);
+  always_assert(callee != caller);
 
   TRACE(CFG, 3, "caller %s\n", SHOW(*caller));
-  TRACE(CFG, 3, "callee %s\n", SHOW(callee));
+  TRACE(CFG, 3, "callee %s\n", SHOW(*callee));
 
   if (caller->get_succ_edge_of_type(callsite.block(), EDGE_THROW) != nullptr) {
-    split_on_callee_throws(&callee);
+    split_on_callee_throws(callee);
   }
 
   // we save these blocks here because we're going to empty out the callee CFG
-  const auto& callee_entry_block = callee.entry_block();
-  const auto& callee_return_blocks = callee.return_blocks();
+  const auto& callee_entry_block = callee->entry_block();
+  const auto& callee_return_blocks = callee->return_blocks();
 
   // make the invoke last of its block
   Block* after_callee = maybe_split_block(caller, callsite);
@@ -47,7 +56,7 @@ void CFGInliner::inline_cfg(ControlFlowGraph* caller,
 
   DexPosition* callsite_dbg_pos = get_dbg_pos(callsite);
   if (callsite_dbg_pos) {
-    set_dbg_pos_parents(&callee, callsite_dbg_pos);
+    set_dbg_pos_parents(callee, callsite_dbg_pos);
     // ensure that the caller's code after the inlined method retain their
     // original position
     const auto& first = after_callee->begin();
@@ -60,18 +69,18 @@ void CFGInliner::inline_cfg(ControlFlowGraph* caller,
   }
 
   // make sure the callee's registers don't overlap with the caller's
-  auto callee_regs_size = callee.get_registers_size();
+  auto callee_regs_size = callee->get_registers_size();
   auto caller_regs_size = caller->get_registers_size();
-  remap_registers(&callee, caller_regs_size);
+  remap_registers(callee, caller_regs_size);
 
-  move_arg_regs(&callee, callsite->insn);
+  move_arg_regs(callee, callsite->insn);
   const cfg::InstructionIterator& move_res = caller->move_result_of(callsite);
-  move_return_reg(&callee,
+  move_return_reg(callee,
                   move_res.is_end()
                       ? boost::none
                       : boost::optional<uint16_t>{move_res->insn->dest()});
 
-  TRACE(CFG, 3, "callee after remap %s\n", SHOW(callee));
+  TRACE(CFG, 3, "callee after remap %s\n", SHOW(*callee));
 
   // delete the move-result before connecting the cfgs because it's in a block
   // that may be merged into another
@@ -80,8 +89,8 @@ void CFGInliner::inline_cfg(ControlFlowGraph* caller,
   }
 
   // redirect to callee
-  const std::vector<Block*> callee_blocks = callee.blocks();
-  steal_contents(caller, callsite.block(), &callee);
+  const std::vector<Block*> callee_blocks = callee->blocks();
+  steal_contents(caller, callsite.block(), callee);
   connect_cfgs(caller, callsite.block(), callee_blocks, callee_entry_block,
                callee_return_blocks, after_callee);
   caller->set_registers_size(callee_regs_size + caller_regs_size);
@@ -154,6 +163,15 @@ void CFGInliner::steal_contents(ControlFlowGraph* caller,
   caller->m_edges.reserve(caller->m_edges.size() + callee->m_edges.size());
   caller->m_edges.insert(callee->m_edges.begin(), callee->m_edges.end());
   callee->m_edges.clear();
+
+  // and of the memory they live in
+  caller->m_block_pool.take_all(callee->m_block_pool);
+  caller->m_edge_pool.take_all(callee->m_edge_pool);
+  callee->m_entry_block = nullptr;
+  callee->m_exit_block = nullptr;
+
+  caller->invalidate_analyses();
+  callee->invalidate_analyses();
 }
 
 /*
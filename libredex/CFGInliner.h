@@ -22,6 +22,15 @@ class CFGInliner {
                          const cfg::InstructionIterator& callsite,
                          const ControlFlowGraph& callee);
 
+  /*
+   * Move callee's blocks into caller, renaming the callee's registers in place
+   * instead of copying it first. Use this when the callsite is the callee's
+   * last use: callee is left without any blocks.
+   */
+  static void inline_cfg_by_move(ControlFlowGraph* caller,
+                                 const cfg::InstructionIterator& callsite,
+                                 ControlFlowGraph* callee);
+
  private:
   /*
    * If it isn't already, make `it` the last instruction of its block
@@ -7,6 +7,11 @@
 
 #include "CallGraph.h"
 
+#include <algorithm>
+#include <boost/range/irange.hpp>
+#include <limits>
+
+#include "Parallel.h"
 #include "VirtualScope.h"
 #include "Walkers.h"
 
@@ -61,7 +66,7 @@ class SingleCalleeStrategy final : public BuildStrategy {
 
   const Scope& m_scope;
   std::unordered_set<DexMethod*> m_non_virtual;
-  mutable MethodRefCache m_resolved_refs;
+  mutable ConcurrentMethodRefCache m_resolved_refs;
 };
 
 } // namespace
@@ -85,22 +90,33 @@ Graph::Graph(const BuildStrategy& strat) {
     make_node(root).m_predecessors.emplace_back(edge);
   }
 
-  // Obtain the callsites of each method recursively, building the graph in the
-  // process.
+  // Obtain the callsites of each method breadth-first, building the graph in
+  // the process. The callsites of each wave of newly discovered methods are
+  // computed in parallel, and the edges are then added in order, so that the
+  // graph does not depend on the thread scheduling.
   std::unordered_set<const DexMethod*> visited;
-  std::function<void(DexMethod*)> visit = [&](auto* caller) {
-    if (visited.count(caller) != 0) {
-      return;
+  std::vector<DexMethod*> wave;
+  for (DexMethod* root : roots) {
+    if (visited.emplace(root).second) {
+      wave.push_back(root);
     }
-    visited.emplace(caller);
-    for (const auto& callsite : strat.get_callsites(caller)) {
-      this->add_edge(caller, callsite.callee, callsite.invoke);
-      visit(callsite.callee);
+  }
+  while (!wave.empty()) {
+    std::vector<CallSites> callsites(wave.size());
+    auto indices = boost::irange<size_t>(0, wave.size());
+    parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+      callsites[i] = strat.get_callsites(wave[i]);
+    });
+    std::vector<DexMethod*> next_wave;
+    for (size_t i = 0; i < wave.size(); ++i) {
+      for (const auto& callsite : callsites[i]) {
+        this->add_edge(wave[i], callsite.callee, callsite.invoke);
+        if (visited.emplace(callsite.callee).second) {
+          next_wave.push_back(callsite.callee);
+        }
+      }
     }
-  };
-
-  for (DexMethod* root : roots) {
-    visit(root);
+    wave = std::move(next_wave);
   }
 }
 
@@ -121,4 +137,98 @@ void Graph::add_edge(DexMethod* caller,
   make_node(callee).m_predecessors.emplace_back(edge);
 }
 
+std::vector<std::vector<SccComponent>> scc_waves(
+    const std::vector<std::vector<SccNodeId>>& successors,
+    const std::vector<bool>& placeholders) {
+  constexpr uint32_t UNVISITED = std::numeric_limits<uint32_t>::max();
+  struct Frame {
+    SccNodeId node;
+    size_t next_successor;
+  };
+  const size_t n = successors.size();
+  std::vector<uint32_t> index(n, UNVISITED);
+  std::vector<uint32_t> lowlink(n);
+  std::vector<bool> on_stack(n, false);
+  std::vector<uint32_t> component_of(n, UNVISITED);
+  // For each component, the first wave in which the nodes that depend on it
+  // can run.
+  std::vector<size_t> component_done;
+  std::vector<SccNodeId> stack;
+  std::vector<Frame> frames;
+  std::vector<std::vector<SccComponent>> waves;
+  uint32_t next_index = 0;
+  auto visit = [&](SccNodeId node) {
+    index[node] = lowlink[node] = next_index++;
+    on_stack[node] = true;
+    stack.push_back(node);
+    frames.push_back({node, 0});
+  };
+  for (SccNodeId root = 0; root < n; ++root) {
+    if (index[root] != UNVISITED) {
+      continue;
+    }
+    visit(root);
+    while (!frames.empty()) {
+      auto& frame = frames.back();
+      SccNodeId node = frame.node;
+      if (frame.next_successor < successors[node].size()) {
+        SccNodeId successor = successors[node][frame.next_successor++];
+        if (index[successor] == UNVISITED) {
+          visit(successor);
+        } else if (on_stack[successor]) {
+          lowlink[node] = std::min(lowlink[node], index[successor]);
+        }
+        continue;
+      }
+      frames.pop_back();
+      if (!frames.empty()) {
+        auto& parent = lowlink[frames.back().node];
+        parent = std::min(parent, lowlink[node]);
+      }
+      if (lowlink[node] != index[node]) {
+        continue;
+      }
+      // Components are completed successors first, so the wave of each one
+      // is known when it completes.
+      uint32_t component_id = component_done.size();
+      SccComponent component;
+      SccNodeId member;
+      do {
+        member = stack.back();
+        stack.pop_back();
+        on_stack[member] = false;
+        component_of[member] = component_id;
+        component.push_back(member);
+      } while (member != node);
+      size_t wave = 0;
+      for (auto member : component) {
+        for (auto successor : successors[member]) {
+          auto successor_component = component_of[successor];
+          if (successor_component != component_id) {
+            wave = std::max(wave, component_done[successor_component]);
+          }
+        }
+      }
+      if (!placeholders.empty()) {
+        component.erase(std::remove_if(component.begin(), component.end(),
+                                       [&](SccNodeId member) {
+                                         return placeholders[member];
+                                       }),
+                        component.end());
+      }
+      if (component.empty()) {
+        component_done.push_back(wave);
+        continue;
+      }
+      component_done.push_back(wave + 1);
+      if (waves.size() <= wave) {
+        waves.resize(wave + 1);
+      }
+      std::sort(component.begin(), component.end());
+      waves[wave].push_back(std::move(component));
+    }
+  }
+  return waves;
+}
+
 } // namespace call_graph
@@ -52,6 +52,9 @@ using CallSites = std::vector<CallSite>;
  * recursively until the graph is fully mapped out. One can think of the
  * BuildStrategy as implicitly encoding the graph structure, with the Graph
  * constructor reifying it.
+ *
+ * The Graph ctor calls get_callsites() on several methods concurrently, so
+ * any state that it shares between calls must be thread-safe.
  */
 class BuildStrategy {
  public:
@@ -154,4 +157,28 @@ class GraphInterface {
   }
 };
 
+/*
+ * Schedules a bottom-up or top-down analysis over a call graph. The nodes of
+ * the graph are numbered [0, successors.size()), and successors[n] lists the
+ * nodes that n depends on, e.g. its callees.
+ *
+ * Returns the strongly connected components of the graph, grouped into waves:
+ * the successors of the members of a component are all either in the same
+ * component or in an earlier wave. So the waves can be analyzed one after the
+ * other, and the components of a wave in parallel. The members of each
+ * component are sorted.
+ *
+ * Nodes marked in `placeholders`, e.g. for virtual dispatch, are not part of
+ * any component. A component made up of placeholders only takes no wave of
+ * its own, so the nodes that depend on it only wait for its successors.
+ *
+ * This is Tarjan's algorithm with an explicit stack, since call chains can be
+ * deeper than the native stack allows.
+ */
+using SccNodeId = uint32_t;
+using SccComponent = std::vector<SccNodeId>;
+std::vector<std::vector<SccComponent>> scc_waves(
+    const std::vector<std::vector<SccNodeId>>& successors,
+    const std::vector<bool>& placeholders = {});
+
 } // namespace call_graph
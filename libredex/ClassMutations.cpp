@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ClassMutations.h"
+
+#include "Parallel.h"
+
+template <typename Fn>
+void ClassMutations::stage(const DexType* type, const Fn& fn) {
+  auto cls = type_class(type);
+  always_assert_log(cls != nullptr, "%s has no definition", SHOW(type));
+  m_mutations.update(cls, [&](DexClass*, Mutations& mutations, bool) {
+    fn(mutations);
+  });
+}
+
+void ClassMutations::add_method(DexMethod* method) {
+  stage(method->get_class(), [method](Mutations& mutations) {
+    mutations.added_methods.push_back(method);
+  });
+}
+
+void ClassMutations::remove_method(DexMethod* method) {
+  stage(method->get_class(), [method](Mutations& mutations) {
+    mutations.removed_methods.push_back(method);
+  });
+}
+
+void ClassMutations::add_field(DexField* field) {
+  stage(field->get_class(), [field](Mutations& mutations) {
+    mutations.added_fields.push_back(field);
+  });
+}
+
+void ClassMutations::remove_field(DexField* field) {
+  stage(field->get_class(), [field](Mutations& mutations) {
+    mutations.removed_fields.push_back(field);
+  });
+}
+
+void ClassMutations::apply() {
+  std::vector<std::pair<DexClass*, Mutations>> classes(m_mutations.begin(),
+                                                        m_mutations.end());
+  m_mutations.clear();
+  // Each class is only changed by one thread.
+  parallel_for(classes.begin(), classes.end(),
+               [](const std::pair<DexClass*, Mutations>& pair) {
+                 auto cls = pair.first;
+                 const auto& mutations = pair.second;
+                 for (auto method : mutations.removed_methods) {
+                   cls->remove_method(method);
+                 }
+                 for (auto field : mutations.removed_fields) {
+                   cls->remove_field(field);
+                 }
+                 for (auto method : mutations.added_methods) {
+                   cls->add_method(method);
+                 }
+                 for (auto field : mutations.added_fields) {
+                   cls->add_field(field);
+                 }
+               });
+}
@@ -0,0 +1,57 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "ConcurrentContainers.h"
+#include "DexClass.h"
+
+/*
+ * Stages changes to the members of classes from a parallel region, and applies
+ * them once the region is over.
+ *
+ * DexClass::add_method() and friends are not thread-safe, and the walkers
+ * iterate over the member lists of the classes, so a pass can't change them
+ * from a parallel region. Instead, it stages the changes here from any thread,
+ * and calls apply() once no other thread looks at the classes.
+ *
+ * The result does not depend on the order in which the changes were staged:
+ * the members of a class are kept sorted, and the removals from a class are
+ * applied before the additions to it.
+ */
+class ClassMutations {
+ public:
+  // All the staging methods are thread-safe. The members must belong to a
+  // class with a definition.
+  void add_method(DexMethod* method);
+  void remove_method(DexMethod* method);
+  void add_field(DexField* field);
+  void remove_field(DexField* field);
+
+  /*
+   * Applies all the staged changes, in parallel over the classes, and forgets
+   * them. This is not thread-safe.
+   */
+  void apply();
+
+  bool empty() const { return m_mutations.size() == 0; }
+
+ private:
+  struct Mutations {
+    std::vector<DexMethod*> added_methods;
+    std::vector<DexMethod*> removed_methods;
+    std::vector<DexField*> added_fields;
+    std::vector<DexField*> removed_fields;
+  };
+
+  template <typename Fn>
+  void stage(const DexType* type, const Fn& fn);
+
+  ConcurrentMap<DexClass*, Mutations> m_mutations;
+};
@@ -7,12 +7,17 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <initializer_list>
 #include <iterator>
+#include <memory>
+#include <stdexcept>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <boost/thread.hpp>
 
@@ -372,6 +377,511 @@ class ConcurrentSet final
   }
 };
 
+/*
+ * A concurrent map for read-mostly workloads, such as the interning tables in
+ * RedexContext, which are looked up far more often than they are modified once
+ * the input has been loaded.
+ *
+ * Writers behave as in ConcurrentMap: each one locks the slot that the key
+ * hashes to. Readers, however, take no lock at all. Each slot is a chained hash
+ * table whose bucket heads and links are atomic pointers, and whose entries are
+ * never modified in place once published. Instead:
+ *  - insert_or_assign() and update() link in a new node that replaces the old
+ *    one;
+ *  - erase() unlinks the node;
+ *  - growing a slot relinks its nodes into a new table, which is then
+ *    published in one atomic store. A reader that misses a key while the slot
+ *    was being relinked looks it up again under the slot lock.
+ * Unlinked nodes and outgrown tables may still be in use by concurrent readers.
+ * They are retired, and freed once all the readers that could have seen them
+ * are done (epoch-based reclamation). The pointers returned by find() thus stay
+ * valid until their entry is erased or replaced.
+ *
+ * Since readers are handed copies of (or pointers to) immutable entries, all
+ * read operations are thread-safe, even while the map is being modified. Only
+ * iteration, size() and copying require the absence of concurrent writers.
+ */
+template <typename Key,
+          typename Value,
+          typename Hash = std::hash<Key>,
+          typename Equal = std::equal_to<Key>,
+          size_t n_slots = 31>
+class ReadOptimizedConcurrentMap final {
+ public:
+  static_assert(n_slots > 0, "The concurrent container has no slots");
+
+  using value_type = std::pair<const Key, Value>;
+
+ private:
+  struct Node {
+    template <typename... Args>
+    Node(size_t hash, Args&&... args)
+        : entry(std::forward<Args>(args)...), hash(hash) {}
+
+    const value_type entry;
+    size_t hash;
+    std::atomic<Node*> next{nullptr};
+  };
+
+  struct Table {
+    explicit Table(size_t n)
+        : n_buckets(n), buckets(new std::atomic<Node*>[n]) {
+      for (size_t i = 0; i < n; ++i) {
+        buckets[i].store(nullptr, std::memory_order_relaxed);
+      }
+    }
+
+    std::atomic<Node*>& bucket(size_t hash) {
+      return buckets[(hash / n_slots) % n_buckets];
+    }
+
+    const size_t n_buckets;
+    std::unique_ptr<std::atomic<Node*>[]> buckets;
+  };
+
+  struct Slot {
+    // The current table, read without holding `lock`.
+    std::atomic<Table*> table{nullptr};
+    // Odd while the nodes are being relinked into a new table.
+    std::atomic<size_t> resize_seq{0};
+    // Everything below is only accessed while holding `lock`.
+    mutable boost::mutex lock;
+    size_t size{0};
+  };
+
+  // The readers are counted in stripes, so that concurrent readers don't all
+  // contend on the same cache line.
+  static constexpr size_t n_stripes = 8;
+
+  struct alignas(64) ReaderCount {
+    std::atomic<size_t> n{0};
+  };
+
+  /*
+   * Announces a reader for the duration of its scope. The objects retired in
+   * an epoch are freed once no reader of that epoch remains.
+   */
+  class ReadGuard final {
+   public:
+    explicit ReadGuard(const ReadOptimizedConcurrentMap* map) {
+      static std::atomic<size_t> s_next_stripe{0};
+      thread_local size_t t_stripe = s_next_stripe++ % n_stripes;
+      while (true) {
+        auto epoch = map->m_epoch.load();
+        m_count = &map->m_readers[epoch & 1][t_stripe].n;
+        m_count->fetch_add(1);
+        // The epoch may have moved on before we were counted, in which case
+        // its objects may be freed from under us.
+        if (map->m_epoch.load() == epoch) {
+          return;
+        }
+        m_count->fetch_sub(1);
+      }
+    }
+
+    ~ReadGuard() { m_count->fetch_sub(1, std::memory_order_release); }
+
+   private:
+    std::atomic<size_t>* m_count;
+  };
+
+ public:
+  class const_iterator final {
+   public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = typename ReadOptimizedConcurrentMap::value_type;
+    using pointer = const value_type*;
+    using reference = const value_type&;
+    using iterator_category = std::forward_iterator_tag;
+
+    const_iterator(const ReadOptimizedConcurrentMap* map, size_t slot)
+        : m_map(map), m_slot(slot) {
+      advance_to_bucket();
+    }
+
+    const_iterator& operator++() {
+      m_node = m_node->next.load(std::memory_order_acquire);
+      if (m_node == nullptr) {
+        ++m_bucket;
+        advance_to_bucket();
+      }
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator retval = *this;
+      ++(*this);
+      return retval;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return m_map == other.m_map && m_node == other.m_node;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+
+    reference operator*() const { return m_node->entry; }
+
+    pointer operator->() const { return &m_node->entry; }
+
+   private:
+    // Move to the first node at or after (m_slot, m_bucket).
+    void advance_to_bucket() {
+      m_node = nullptr;
+      for (; m_slot < n_slots; ++m_slot, m_bucket = 0) {
+        auto table =
+            m_map->m_slots[m_slot].table.load(std::memory_order_acquire);
+        if (table == nullptr) {
+          continue;
+        }
+        for (; m_bucket < table->n_buckets; ++m_bucket) {
+          m_node = table->buckets[m_bucket].load(std::memory_order_acquire);
+          if (m_node != nullptr) {
+            return;
+          }
+        }
+      }
+    }
+
+    const ReadOptimizedConcurrentMap* m_map;
+    size_t m_slot;
+    size_t m_bucket{0};
+    Node* m_node{nullptr};
+  };
+
+  ReadOptimizedConcurrentMap() = default;
+
+  ReadOptimizedConcurrentMap(const ReadOptimizedConcurrentMap& other) {
+    for (const auto& entry : other) {
+      emplace(entry.first, entry.second);
+    }
+  }
+
+  ReadOptimizedConcurrentMap& operator=(const ReadOptimizedConcurrentMap&) =
+      delete;
+
+  ~ReadOptimizedConcurrentMap() {
+    for (auto& slot : m_slots) {
+      auto table = slot.table.load(std::memory_order_relaxed);
+      if (table == nullptr) {
+        continue;
+      }
+      for (size_t i = 0; i < table->n_buckets; ++i) {
+        auto node = table->buckets[i].load(std::memory_order_relaxed);
+        while (node != nullptr) {
+          auto next = node->next.load(std::memory_order_relaxed);
+          delete node;
+          node = next;
+        }
+      }
+      delete table;
+    }
+    for (size_t parity = 0; parity < 2; ++parity) {
+      free_retired(parity);
+    }
+  }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+
+  const_iterator end() const { return const_iterator(this, n_slots); }
+
+  size_t size() const {
+    size_t s = 0;
+    for (const auto& slot : m_slots) {
+      s += slot.size;
+    }
+    return s;
+  }
+
+  /*
+   * Returns a pointer to the entry for `key`, or nullptr if there is none.
+   * Lock-free, unless the slot of `key` was being resized. The entry stays
+   * valid until it is erased or replaced.
+   */
+  const value_type* find(const Key& key) const {
+    auto hash = Hash()(key);
+    auto& slot = m_slots[hash % n_slots];
+    ReadGuard guard(this);
+    auto seq = slot.resize_seq.load(std::memory_order_acquire);
+    auto table = slot.table.load(std::memory_order_acquire);
+    if (table != nullptr) {
+      for (auto node = table->bucket(hash).load(std::memory_order_acquire);
+           node != nullptr;
+           node = node->next.load(std::memory_order_acquire)) {
+        if (node->hash == hash && Equal()(node->entry.first, key)) {
+          return &node->entry;
+        }
+      }
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq % 2 == 0 &&
+        slot.resize_seq.load(std::memory_order_relaxed) == seq) {
+      return nullptr;
+    }
+    // The nodes were moving between chains while we walked them, so we may
+    // have missed the key.
+    boost::lock_guard<boost::mutex> lock(slot.lock);
+    return find_locked(slot, hash, key);
+  }
+
+  /*
+   * Lock-free.
+   */
+  size_t count(const Key& key) const { return find(key) != nullptr ? 1 : 0; }
+
+  /*
+   * Lock-free.
+   */
+  Value get(const Key& key, Value default_value) const {
+    auto entry = find(key);
+    return entry != nullptr ? entry->second : default_value;
+  }
+
+  /*
+   * Lock-free. Throws std::out_of_range if the key is absent.
+   */
+  const Value& at(const Key& key) const {
+    auto entry = find(key);
+    if (entry == nullptr) {
+      throw std::out_of_range("ReadOptimizedConcurrentMap::at");
+    }
+    return entry->second;
+  }
+
+  /*
+   * The Boolean return value denotes whether the insertion took place.
+   * This operation is always thread-safe.
+   */
+  template <typename... Args>
+  bool emplace(Args&&... args) {
+    auto node = std::make_unique<Node>(0, std::forward<Args>(args)...);
+    auto hash = Hash()(node->entry.first);
+    auto& slot = m_slots[hash % n_slots];
+    boost::lock_guard<boost::mutex> lock(slot.lock);
+    if (find_locked(slot, hash, node->entry.first) != nullptr) {
+      return false;
+    }
+    node->hash = hash;
+    link(slot, std::move(node));
+    return true;
+  }
+
+  /*
+   * Sets out[i] to the value of keys[i] for every i in [0, n), inserting
+   * make_value(keys[i]) for the keys that are absent. Each slot lock is
+   * taken at most once. make_value is called while holding a slot lock, so it
+   * must not access this map.
+   */
+  template <typename MakeValue>
+  void get_or_emplace_all(const Key* keys,
+                          size_t n,
+                          Value* out,
+                          const MakeValue& make_value) {
+    // (slot, index) of the keys that the lock-free lookup didn't find.
+    std::vector<std::pair<size_t, size_t>> misses;
+    std::vector<size_t> hashes(n);
+    for (size_t i = 0; i < n; ++i) {
+      hashes[i] = Hash()(keys[i]);
+      auto entry = find(keys[i]);
+      if (entry != nullptr) {
+        out[i] = entry->second;
+      } else {
+        misses.emplace_back(hashes[i] % n_slots, i);
+      }
+    }
+    std::sort(misses.begin(), misses.end());
+    for (auto it = misses.begin(); it != misses.end();) {
+      auto& slot = m_slots[it->first];
+      boost::lock_guard<boost::mutex> lock(slot.lock);
+      for (auto slot_idx = it->first;
+           it != misses.end() && it->first == slot_idx;
+           ++it) {
+        auto i = it->second;
+        auto entry = find_locked(slot, hashes[i], keys[i]);
+        if (entry == nullptr) {
+          auto node =
+              std::make_unique<Node>(hashes[i], keys[i], make_value(keys[i]));
+          entry = &node->entry;
+          link(slot, std::move(node));
+        }
+        out[i] = entry->second;
+      }
+    }
+  }
+
+  /*
+   * This operation is always thread-safe.
+   */
+  bool insert(const value_type& entry) {
+    return emplace(entry.first, entry.second);
+  }
+
+  /*
+   * This operation is always thread-safe.
+   */
+  void insert_or_assign(const value_type& entry) {
+    auto hash = Hash()(entry.first);
+    auto& slot = m_slots[hash % n_slots];
+    boost::lock_guard<boost::mutex> lock(slot.lock);
+    unlink(slot, hash, entry.first);
+    link(slot, std::make_unique<Node>(hash, entry));
+  }
+
+  /*
+   * This operation atomically modifies an entry in the map. If the entry
+   * doesn't exist, it is created. The third argument of the updater function is
+   * a Boolean flag denoting whether the entry exists or not. The updater works
+   * on a copy of the value, which then replaces the entry.
+   */
+  void update(const Key& key,
+              const std::function<void(const Key&, Value&, bool)>& updater) {
+    auto hash = Hash()(key);
+    auto& slot = m_slots[hash % n_slots];
+    boost::lock_guard<boost::mutex> lock(slot.lock);
+    auto entry = find_locked(slot, hash, key);
+    Value value = entry != nullptr ? entry->second : Value();
+    updater(key, value, entry != nullptr);
+    unlink(slot, hash, key);
+    link(slot, std::make_unique<Node>(hash, key, std::move(value)));
+  }
+
+  /*
+   * This operation is always thread-safe.
+   */
+  size_t erase(const Key& key) {
+    auto hash = Hash()(key);
+    auto& slot = m_slots[hash % n_slots];
+    boost::lock_guard<boost::mutex> lock(slot.lock);
+    return unlink(slot, hash, key) ? 1 : 0;
+  }
+
+ private:
+  const value_type* find_locked(const Slot& slot,
+                                size_t hash,
+                                const Key& key) const {
+    auto table = slot.table.load(std::memory_order_relaxed);
+    if (table == nullptr) {
+      return nullptr;
+    }
+    for (auto node = table->bucket(hash).load(std::memory_order_relaxed);
+         node != nullptr;
+         node = node->next.load(std::memory_order_relaxed)) {
+      if (node->hash == hash && Equal()(node->entry.first, key)) {
+        return &node->entry;
+      }
+    }
+    return nullptr;
+  }
+
+  // Must hold slot.lock. Grows the table when the load factor exceeds one.
+  void link(Slot& slot, std::unique_ptr<Node> node) {
+    auto table = slot.table.load(std::memory_order_relaxed);
+    if (table == nullptr || slot.size + 1 > table->n_buckets) {
+      table = grow(slot, table);
+    }
+    auto& head = table->bucket(node->hash);
+    node->next.store(head.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+    head.store(node.release(), std::memory_order_release);
+    ++slot.size;
+  }
+
+  // Must hold slot.lock. The unlinked node is retired, since readers may still
+  // be looking at it.
+  bool unlink(Slot& slot, size_t hash, const Key& key) {
+    auto table = slot.table.load(std::memory_order_relaxed);
+    if (table == nullptr) {
+      return false;
+    }
+    auto* link = &table->bucket(hash);
+    for (auto node = link->load(std::memory_order_relaxed); node != nullptr;
+         link = &node->next, node = link->load(std::memory_order_relaxed)) {
+      if (node->hash == hash && Equal()(node->entry.first, key)) {
+        link->store(node->next.load(std::memory_order_relaxed),
+                    std::memory_order_release);
+        --slot.size;
+        retire(node, nullptr);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Must hold slot.lock. Returns the new table, into which the nodes of the
+  // old one are relinked.
+  Table* grow(Slot& slot, Table* old) {
+    auto table = new Table(old == nullptr ? 4 : old->n_buckets * 2);
+    if (old == nullptr) {
+      slot.table.store(table, std::memory_order_release);
+      return table;
+    }
+    // A reader that walks a chain while its nodes move to the new table may
+    // skip some of them. The odd sequence number tells it to look again.
+    auto seq = slot.resize_seq.load(std::memory_order_relaxed);
+    slot.resize_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < old->n_buckets; ++i) {
+      auto node = old->buckets[i].load(std::memory_order_relaxed);
+      while (node != nullptr) {
+        auto next = node->next.load(std::memory_order_relaxed);
+        auto& head = table->bucket(node->hash);
+        node->next.store(head.load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+        head.store(node, std::memory_order_relaxed);
+        node = next;
+      }
+    }
+    slot.table.store(table, std::memory_order_release);
+    slot.resize_seq.store(seq + 2, std::memory_order_release);
+    retire(nullptr, old);
+    return table;
+  }
+
+  // Frees `node` and `table` (either may be null) once no reader can see
+  // them anymore.
+  void retire(Node* node, Table* table) {
+    boost::lock_guard<boost::mutex> lock(m_retire_lock);
+    auto parity = m_epoch.load() & 1;
+    if (node != nullptr) {
+      m_retired_nodes[parity].push_back(node);
+    }
+    if (table != nullptr) {
+      m_retired_tables[parity].push_back(table);
+    }
+    // The readers of the previous epoch are the only ones that can still see
+    // what was retired in it. Once they are gone, free it and start a new
+    // epoch, whose retired objects go where the freed ones were.
+    auto previous = parity ^ 1;
+    for (const auto& count : m_readers[previous]) {
+      if (count.n.load() != 0) {
+        return;
+      }
+    }
+    free_retired(previous);
+    m_epoch.fetch_add(1);
+  }
+
+  void free_retired(size_t parity) {
+    for (auto node : m_retired_nodes[parity]) {
+      delete node;
+    }
+    m_retired_nodes[parity].clear();
+    for (auto table : m_retired_tables[parity]) {
+      delete table;
+    }
+    m_retired_tables[parity].clear();
+  }
+
+  Slot m_slots[n_slots];
+  std::atomic<size_t> m_epoch{0};
+  mutable ReaderCount m_readers[2][n_stripes];
+  boost::mutex m_retire_lock;
+  std::vector<Node*> m_retired_nodes[2];
+  std::vector<Table*> m_retired_tables[2];
+};
+
 namespace cc_impl {
 
 template <typename Container, size_t n_slots>
@@ -9,11 +9,13 @@
 
 #include <fstream>
 #include <iostream>
+#include <numeric>
 #include <string>
 #include <vector>
 
 #include "Debug.h"
 #include "DexClass.h"
+#include "Parallel.h"
 
 void JsonWrapper::get(const char* name, int64_t dflt, int64_t& param) const {
   param = m_config.get(name, (Json::Int64)dflt).asInt();
@@ -162,6 +164,8 @@ ConfigFiles::ConfigFiles(const Json::Value& config, const std::string& outdir)
   if (m_profiled_methods_filename != "") {
     load_method_to_weight();
   }
+  m_method_profiles =
+      load_method_profiles(config.get("method_profiles", Json::arrayValue));
 }
 
 ConfigFiles::ConfigFiles(const Json::Value& config) : ConfigFiles(config, "") {}
@@ -189,7 +193,7 @@ const std::unordered_set<DexType*>& ConfigFiles::get_no_optimizations_annos() {
  * Read an interdex list file and return as a vector of appropriately-formatted
  * classname strings.
  */
-std::vector<std::string> ConfigFiles::load_coldstart_classes() {
+std::vector<std::string> ConfigFiles::load_coldstart_classes() const {
   const char* kClassTail = ".class";
   const size_t lentail = strlen(kClassTail);
   auto file = m_coldstart_class_filename.c_str();
@@ -212,6 +216,38 @@ std::vector<std::string> ConfigFiles::load_coldstart_classes() {
   return coldstart_classes;
 }
 
+/**
+ * Resolve the coldstart class names once, so that consumers can work with
+ * types instead of building and comparing name strings. The lookups are
+ * independent and done in parallel.
+ */
+const std::vector<DexType*>& ConfigFiles::get_coldstart_types() {
+  const auto& coldstart_classes = get_coldstart_classes();
+  if (m_coldstart_types.size() != coldstart_classes.size()) {
+    m_coldstart_types = resolve_types(coldstart_classes);
+  }
+  return m_coldstart_types;
+}
+
+std::vector<DexType*> ConfigFiles::resolve_coldstart_types() const {
+  if (!m_coldstart_types.empty()) {
+    return m_coldstart_types;
+  }
+  return resolve_types(m_coldstart_classes.empty() ? load_coldstart_classes()
+                                                   : m_coldstart_classes);
+}
+
+std::vector<DexType*> ConfigFiles::resolve_types(
+    const std::vector<std::string>& names) {
+  std::vector<DexType*> types(names.size(), nullptr);
+  std::vector<size_t> indices(names.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    types[i] = DexType::get_type(names[i]);
+  });
+  return types;
+}
+
 /**
  * Read a map of {list_name : class_list} from json
  */
@@ -266,22 +302,5 @@ std::vector<std::string> ConfigFiles::load_coldstart_methods() {
 }
 
 void ConfigFiles::load_method_to_weight() {
-  std::ifstream infile(m_profiled_methods_filename.c_str());
-  assert_log(infile, "Can't open method profile file: %s\n",
-             m_profiled_methods_filename.c_str());
-
-  std::string deobfuscated_name;
-  unsigned int weight;
-  TRACE(CUSTOMSORT, 2, "Setting sort start file %s\n",
-        m_profiled_methods_filename.c_str());
-
-  unsigned int count = 0;
-  while (infile >> deobfuscated_name >> weight) {
-    m_method_to_weight[deobfuscated_name] = weight;
-    count++;
-  }
-
-  assert_log(count > 0, "Method profile file %s didn't contain valid entries\n",
-             m_profiled_methods_filename.c_str());
-  TRACE(CUSTOMSORT, 2, "Preset sort weight count=%d\n", count);
+  m_method_to_weight = read_method_weights(m_profiled_methods_filename);
 }
@@ -15,6 +15,7 @@
 #include <json/json.h>
 
 #include "DexClass.h"
+#include "MethodProfiles.h"
 #include "ProguardMap.h"
 
 class DexType;
@@ -74,6 +75,19 @@ struct ConfigFiles {
     return m_coldstart_classes;
   }
 
+  /**
+   * The coldstart classes resolved to their types, in the same order as
+   * get_coldstart_classes(). Names that don't denote any type (like the
+   * interdex markers) resolve to nullptr. This relies on g_redex.
+   */
+  const std::vector<DexType*>& get_coldstart_types();
+
+  /**
+   * Same as get_coldstart_types(), but nothing is cached, so that it can be
+   * used on a const ConfigFiles.
+   */
+  std::vector<DexType*> resolve_coldstart_types() const;
+
   const std::vector<std::string>& get_coldstart_methods() {
     if (m_coldstart_methods.size() == 0) {
       m_coldstart_methods = load_coldstart_methods();
@@ -110,6 +124,10 @@ struct ConfigFiles {
     return m_method_to_weight;
   }
 
+  const std::vector<MethodProfile>& get_method_profiles() const {
+    return m_method_profiles;
+  }
+
   bool save_move_map() const { return m_move_map; }
 
   const MethodMap& get_moved_methods_map() const {
@@ -145,7 +163,9 @@ struct ConfigFiles {
   JsonWrapper m_json;
   std::string outdir;
 
-  std::vector<std::string> load_coldstart_classes();
+  std::vector<std::string> load_coldstart_classes() const;
+  static std::vector<DexType*> resolve_types(
+      const std::vector<std::string>& names);
   std::vector<std::string> load_coldstart_methods();
   std::unordered_map<std::string, std::vector<std::string> > load_class_lists();
   void load_method_to_weight();
@@ -158,9 +178,11 @@ struct ConfigFiles {
   std::string m_coldstart_method_filename;
   std::string m_profiled_methods_filename;
   std::vector<std::string> m_coldstart_classes;
+  std::vector<DexType*> m_coldstart_types;
   std::vector<std::string> m_coldstart_methods;
   std::unordered_map<std::string, std::vector<std::string> > m_class_lists;
   std::unordered_map<std::string, unsigned int> m_method_to_weight;
+  std::vector<MethodProfile> m_method_profiles;
   std::string m_printseeds; // Filename to dump computed seeds.
 
   // global no optimizations annotations
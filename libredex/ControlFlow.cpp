@@ -10,6 +10,7 @@
 #include <boost/dynamic_bitset.hpp>
 #include <boost/numeric/conversion/cast.hpp>
 #include <iterator>
+#include <limits>
 #include <stack>
 #include <utility>
 
@@ -19,46 +20,6 @@
 
 namespace {
 
-// return true if `it` should be the last instruction of this block
-bool end_of_block(const IRList* ir, IRList::iterator it, bool in_try) {
-  auto next = std::next(it);
-  if (next == ir->end()) {
-    return true;
-  }
-
-  // End the block before the first target in a contiguous sequence of targets.
-  if (next->type == MFLOW_TARGET && it->type != MFLOW_TARGET) {
-    return true;
-  }
-
-  // End the block before the first catch marker in a contiguous sequence of
-  // catch markers.
-  if (next->type == MFLOW_CATCH && it->type != MFLOW_CATCH) {
-    return true;
-  }
-
-  // End the block before a TRY_START
-  // and after a TRY_END
-  if ((next->type == MFLOW_TRY && next->tentry->type == TRY_START) ||
-      (it->type == MFLOW_TRY && it->tentry->type == TRY_END)) {
-    return true;
-  }
-
-  if (in_try && it->type == MFLOW_OPCODE &&
-      opcode::may_throw(it->insn->opcode())) {
-    return true;
-  }
-  if (it->type != MFLOW_OPCODE) {
-    return false;
-  }
-  if (is_branch(it->insn->opcode()) || is_return(it->insn->opcode()) ||
-      it->insn->opcode() == OPCODE_THROW) {
-    return true;
-  }
-
-  return false;
-}
-
 bool ends_with_may_throw(cfg::Block* p) {
   for (auto last = p->rbegin(); last != p->rend(); ++last) {
     if (last->type != MFLOW_OPCODE) {
@@ -141,6 +102,47 @@ void remove_duplicate_positions(IRList* ir) {
 
 namespace cfg {
 
+bool end_of_block(IRList::const_iterator it,
+                  IRList::const_iterator end,
+                  bool in_try) {
+  auto next = std::next(it);
+  if (next == end) {
+    return true;
+  }
+
+  // End the block before the first target in a contiguous sequence of targets.
+  if (next->type == MFLOW_TARGET && it->type != MFLOW_TARGET) {
+    return true;
+  }
+
+  // End the block before the first catch marker in a contiguous sequence of
+  // catch markers.
+  if (next->type == MFLOW_CATCH && it->type != MFLOW_CATCH) {
+    return true;
+  }
+
+  // End the block before a TRY_START
+  // and after a TRY_END
+  if ((next->type == MFLOW_TRY && next->tentry->type == TRY_START) ||
+      (it->type == MFLOW_TRY && it->tentry->type == TRY_END)) {
+    return true;
+  }
+
+  if (in_try && it->type == MFLOW_OPCODE &&
+      opcode::may_throw(it->insn->opcode())) {
+    return true;
+  }
+  if (it->type != MFLOW_OPCODE) {
+    return false;
+  }
+  if (is_branch(it->insn->opcode()) || is_return(it->insn->opcode()) ||
+      it->insn->opcode() == OPCODE_THROW) {
+    return true;
+  }
+
+  return false;
+}
+
 IRList::iterator Block::begin() {
   if (m_parent->editable()) {
     return m_entries.begin();
@@ -454,7 +456,7 @@ void ControlFlowGraph::find_block_boundaries(IRList* ir,
       current_position = it->pos.get();
     }
 
-    if (!end_of_block(ir, it, in_try)) {
+    if (!end_of_block(it, ir->end(), in_try)) {
       continue;
     }
 
@@ -685,8 +687,9 @@ uint32_t ControlFlowGraph::remove_unreachable_blocks() {
       num_insns_removed += b->num_opcodes();
       always_assert(b->succs().empty());
       always_assert(b->preds().empty());
-      delete b;
+      m_block_pool.destroy(b);
       it = m_blocks.erase(it);
+      invalidate_analyses();
     } else {
       ++it;
     }
@@ -718,51 +721,120 @@ void ControlFlowGraph::remove_empty_blocks() {
   always_assert(editable());
   std::unordered_set<DexPosition*> deleted_positions;
   for (auto it = m_blocks.begin(); it != m_blocks.end();) {
-    Block* b = it->second;
+    // Advance first, `remove_empty_block` erases `b` from m_blocks.
+    Block* b = (it++)->second;
     if (!is_effectively_empty(b) || b == exit_block()) {
-      ++it;
       continue;
     }
+    remove_empty_block(b, &deleted_positions);
+  }
+  remove_dangling_parents(deleted_positions);
+}
+
+bool ControlFlowGraph::remove_empty_block(
+    Block* b, std::unordered_set<DexPosition*>* deleted_positions) {
+  const auto& succs = b->succs();
+  if (succs.size() > 0) {
+    always_assert_log(succs.size() == 1,
+                      "too many successors for empty block %d:\n%s",
+                      b->id(), SHOW(*this));
+    const auto& succ_edge = succs[0];
+    Block* succ = succ_edge->target();
+
+    if (b == succ) { // `b` follows itself: an infinite loop
+      return false;
+    }
+    // b is empty. Reorganize the edges so we can remove it
+
+    // Remove the one goto edge from b to succ
+    delete_edges_between(b, succ);
+
+    // Redirect from b's predecessors to b's successor (skipping b). We
+    // can't move edges around while we iterate through the edge list
+    // though.
+    std::vector<Edge*> need_redirect(b->m_preds.begin(), b->m_preds.end());
+    for (Edge* pred_edge : need_redirect) {
+      set_edge_target(pred_edge, succ);
+    }
+
+    if (b == entry_block()) {
+      m_entry_block = succ;
+    }
+  }
+
+  for (const auto& mie : *b) {
+    if (mie.type == MFLOW_POSITION) {
+      deleted_positions->insert(mie.pos.get());
+    }
+  }
+  m_blocks.erase(b->id());
+  m_block_pool.destroy(b);
+  invalidate_analyses();
+  return true;
+}
 
+uint32_t ControlFlowGraph::simplify_worklist() {
+  always_assert(editable());
+  // Neither removing empty blocks nor merging blocks changes what is
+  // reachable, so one sweep for unreachable blocks is enough.
+  uint32_t num_blocks_before = m_blocks.size();
+  remove_unreachable_blocks();
+  uint32_t num_blocks_removed = num_blocks_before - m_blocks.size();
+
+  // `b` can absorb its successor if it jumps there unconditionally and is the
+  // only way in.
+  auto mergeable_succ = [this](Block* b) -> Block* {
     const auto& succs = b->succs();
-    if (succs.size() > 0) {
-      always_assert_log(succs.size() == 1,
-                        "too many successors for empty block %d:\n%s",
-                        it->first, SHOW(*this));
-      const auto& succ_edge = succs[0];
-      Block* succ = succ_edge->target();
-
-      if (b == succ) { // `b` follows itself: an infinite loop
-        ++it;
-        continue;
-      }
-      // b is empty. Reorganize the edges so we can remove it
+    if (succs.size() != 1 || succs[0]->type() != EDGE_GOTO) {
+      return nullptr;
+    }
+    Block* succ = succs[0]->target();
+    if (succ == b || succ == entry_block() || succ == exit_block() ||
+        succ->preds().size() != 1 || !blocks_are_in_same_try(b, succ)) {
+      return nullptr;
+    }
+    return succ;
+  };
 
-      // Remove the one goto edge from b to succ
-      delete_edges_between(b, succ);
+  std::unordered_set<DexPosition*> deleted_positions;
+  // Block ids rather than pointers, because blocks on the worklist may be
+  // destroyed before we get to them. Seeded so that blocks are popped in id
+  // order.
+  std::vector<BlockId> worklist;
+  worklist.reserve(m_blocks.size());
+  for (auto it = m_blocks.rbegin(); it != m_blocks.rend(); ++it) {
+    worklist.push_back(it->first);
+  }
+  while (!worklist.empty()) {
+    auto find = m_blocks.find(worklist.back());
+    worklist.pop_back();
+    if (find == m_blocks.end()) {
+      continue;
+    }
+    Block* b = find->second;
 
-      // Redirect from b's predecessors to b's successor (skipping b). We
-      // can't move edges around while we iterate through the edge list
-      // though.
-      std::vector<Edge*> need_redirect(b->m_preds.begin(), b->m_preds.end());
-      for (Edge* pred_edge : need_redirect) {
-        set_edge_target(pred_edge, succ);
+    if (is_effectively_empty(b) && b != exit_block()) {
+      std::vector<BlockId> pred_ids;
+      for (const Edge* e : b->preds()) {
+        pred_ids.push_back(e->src()->id());
       }
-
-      if (b == entry_block()) {
-        m_entry_block = succ;
+      if (remove_empty_block(b, &deleted_positions)) {
+        ++num_blocks_removed;
+        // The predecessors now jump straight to b's successor, which may have
+        // made them mergeable with it.
+        worklist.insert(worklist.end(), pred_ids.begin(), pred_ids.end());
       }
+      continue;
     }
 
-    for (const auto& mie : *b) {
-      if (mie.type == MFLOW_POSITION) {
-        deleted_positions.insert(mie.pos.get());
-      }
+    for (Block* succ = mergeable_succ(b); succ != nullptr;
+         succ = mergeable_succ(b)) {
+      merge_blocks(b, succ);
+      ++num_blocks_removed;
     }
-    delete b;
-    it = m_blocks.erase(it);
   }
   remove_dangling_parents(deleted_positions);
+  return num_blocks_removed;
 }
 
 void ControlFlowGraph::no_unreferenced_edges() const {
@@ -985,7 +1057,7 @@ void ControlFlowGraph::deep_copy(ControlFlowGraph* new_cfg) const {
   old_edge_to_new.reserve(num_edges);
   for (const Edge* old_edge : this->m_edges) {
     // this shallowly copies block pointers inside, then we patch them later
-    Edge* new_edge = new Edge(*old_edge);
+    Edge* new_edge = new_cfg->m_edge_pool.make(*old_edge);
     new_cfg->m_edges.insert(new_edge);
     old_edge_to_new.emplace(old_edge, new_edge);
   }
@@ -995,7 +1067,7 @@ void ControlFlowGraph::deep_copy(ControlFlowGraph* new_cfg) const {
   for (const auto& entry : this->m_blocks) {
     const Block* block = entry.second;
     // this shallowly copies edge pointers inside, then we patch them later
-    Block* new_block = new Block(*block, &cloner);
+    Block* new_block = new_cfg->m_block_pool.make(*block, &cloner);
     new_cfg->m_blocks.emplace(new_block->id(), new_block);
   }
   // We need a second pass because parent position pointers may refer to
@@ -1412,20 +1484,22 @@ std::vector<Block*> ControlFlowGraph::blocks() const {
 }
 
 ControlFlowGraph::~ControlFlowGraph() {
+  // The pools release the memory itself; only the destructors are left to run.
   for (const auto& entry : m_blocks) {
     Block* b = entry.second;
-    delete b;
+    b->~Block();
   }
 
   for (Edge* e : m_edges) {
-    delete e;
+    e->~Edge();
   }
 }
 
 Block* ControlFlowGraph::create_block() {
   size_t id = next_block_id();
-  Block* b = new Block(this, id);
+  Block* b = m_block_pool.make(this, id);
   m_blocks.emplace(id, b);
+  invalidate_analyses();
   return b;
 }
 
@@ -1549,6 +1623,7 @@ void ControlFlowGraph::calculate_exit_block() {
 
   ExitBlocks eb;
   eb.visit(entry_block());
+  invalidate_analyses();
   if (eb.exit_blocks.size() == 1) {
     m_exit_block = eb.exit_blocks[0];
   } else {
@@ -1611,7 +1686,7 @@ void ControlFlowGraph::cleanup_deleted_edges(const EdgeSet& edges) {
 
 void ControlFlowGraph::free_edge(Edge* edge) {
   m_edges.erase(edge);
-  delete edge;
+  m_edge_pool.destroy(edge);
 }
 
 void ControlFlowGraph::free_edges(const EdgeSet& edges) {
@@ -1705,7 +1780,8 @@ void ControlFlowGraph::merge_blocks(Block* pred, Block* succ) {
   delete_pred_edges(succ);
   delete_succ_edges(succ);
   m_blocks.erase(succ->id());
-  delete succ;
+  m_block_pool.destroy(succ);
+  invalidate_analyses();
 }
 
 void ControlFlowGraph::set_edge_target(Edge* edge, Block* new_target) {
@@ -1830,7 +1906,8 @@ void ControlFlowGraph::remove_block(Block* block) {
   delete_succ_edges(block);
   m_blocks.erase(block->id());
   block->m_entries.clear_and_dispose();
-  delete block;
+  m_block_pool.destroy(block);
+  invalidate_analyses();
 }
 
 // delete old_block and reroute its predecessors to new_block
@@ -1960,6 +2037,255 @@ ControlFlowGraph::immediate_dominators() const {
   return postorder_dominator;
 }
 
+namespace {
+
+constexpr uint32_t NOT_VISITED = std::numeric_limits<uint32_t>::max();
+
+// The blocks reachable from `roots`, following successor edges or, if
+// `reverse` is set, predecessor edges. They are listed in the postorder of a
+// depth-first search from a virtual block whose children are `roots`.
+std::vector<Block*> postorder_from(const std::vector<Block*>& roots,
+                                   size_t num_ids,
+                                   bool reverse) {
+  std::vector<Block*> postorder;
+  std::vector<bool> visited(num_ids);
+  // blocks and the index of the next edge to follow out of them
+  std::vector<std::pair<Block*, size_t>> stack;
+  for (Block* root : roots) {
+    if (visited[root->id()]) {
+      continue;
+    }
+    visited[root->id()] = true;
+    stack.emplace_back(root, 0);
+    while (!stack.empty()) {
+      Block* b = stack.back().first;
+      const auto& edges = reverse ? b->preds() : b->succs();
+      size_t& next = stack.back().second;
+      if (next == edges.size()) {
+        postorder.push_back(b);
+        stack.pop_back();
+        continue;
+      }
+      Edge* e = edges[next++];
+      Block* other = reverse ? e->src() : e->target();
+      if (!visited[other->id()]) {
+        visited[other->id()] = true;
+        stack.emplace_back(other, 0);
+      }
+    }
+  }
+  return postorder;
+}
+
+// Immediate dominators (or, if `reverse` is set, post-dominators) by block
+// id, computed as in Cooper et al., A Simple, Fast Dominance Algorithm. Roots
+// are their own immediate dominators; blocks that are dominated only by the
+// virtual block above all roots get nullptr, like unreachable blocks.
+std::vector<Block*> compute_idoms(const std::vector<Block*>& postorder,
+                                  const std::vector<Block*>& roots,
+                                  size_t num_ids,
+                                  bool reverse) {
+  const uint32_t n = postorder.size();
+  std::vector<uint32_t> po(num_ids, NOT_VISITED);
+  for (uint32_t i = 0; i < n; ++i) {
+    po[postorder[i]->id()] = i;
+  }
+  // Indexed by postorder number. `n` stands for the virtual root.
+  std::vector<uint32_t> idom(n + 1, NOT_VISITED);
+  std::vector<bool> is_root(n + 1);
+  idom[n] = n;
+  for (Block* root : roots) {
+    idom[po[root->id()]] = n;
+    is_root[po[root->id()]] = true;
+  }
+  auto intersect = [&idom](uint32_t a, uint32_t b) {
+    while (a != b) {
+      while (a < b) {
+        a = idom[a];
+      }
+      while (b < a) {
+        b = idom[b];
+      }
+    }
+    return a;
+  };
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+      uint32_t i = po[(*it)->id()];
+      if (is_root[i]) {
+        continue;
+      }
+      uint32_t new_idom = NOT_VISITED;
+      for (Edge* e : reverse ? (*it)->succs() : (*it)->preds()) {
+        uint32_t p = po[(reverse ? e->target() : e->src())->id()];
+        if (p == NOT_VISITED || idom[p] == NOT_VISITED) {
+          continue;
+        }
+        new_idom = new_idom == NOT_VISITED ? p : intersect(p, new_idom);
+      }
+      if (new_idom != idom[i]) {
+        idom[i] = new_idom;
+        changed = true;
+      }
+    }
+  }
+
+  std::vector<Block*> result(num_ids, nullptr);
+  for (uint32_t i = 0; i < n; ++i) {
+    if (is_root[i]) {
+      result[postorder[i]->id()] = postorder[i];
+    } else if (idom[i] != n) {
+      result[postorder[i]->id()] = postorder[idom[i]];
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+ControlFlowGraph::AnalysisCache& ControlFlowGraph::dominator_cache() const {
+  if (!m_analysis_cache) {
+    m_analysis_cache = std::make_unique<AnalysisCache>();
+  }
+  auto& cache = *m_analysis_cache;
+  if (cache.has_dominators) {
+    return cache;
+  }
+  always_assert(m_entry_block != nullptr);
+  size_t num_ids = next_block_id();
+  std::vector<Block*> roots{m_entry_block};
+  auto postorder = postorder_from(roots, num_ids, /* reverse */ false);
+  cache.idoms = compute_idoms(postorder, roots, num_ids, /* reverse */ false);
+  cache.reverse_postorder.assign(postorder.rbegin(), postorder.rend());
+  cache.rpo_index.assign(num_ids, NOT_VISITED);
+  for (uint32_t i = 0; i < cache.reverse_postorder.size(); ++i) {
+    cache.rpo_index[cache.reverse_postorder[i]->id()] = i;
+  }
+  cache.has_dominators = true;
+  return cache;
+}
+
+ControlFlowGraph::AnalysisCache& ControlFlowGraph::post_dominator_cache()
+    const {
+  if (!m_analysis_cache) {
+    m_analysis_cache = std::make_unique<AnalysisCache>();
+  }
+  auto& cache = *m_analysis_cache;
+  if (cache.has_post_dominators) {
+    return cache;
+  }
+  size_t num_ids = next_block_id();
+  std::vector<Block*> roots;
+  for (const auto& entry : m_blocks) {
+    if (entry.second->succs().empty()) {
+      roots.push_back(entry.second);
+    }
+  }
+  auto postorder = postorder_from(roots, num_ids, /* reverse */ true);
+  cache.post_idoms =
+      compute_idoms(postorder, roots, num_ids, /* reverse */ true);
+  cache.has_post_dominators = true;
+  return cache;
+}
+
+ControlFlowGraph::AnalysisCache& ControlFlowGraph::loop_cache() const {
+  auto& cache = dominator_cache();
+  if (cache.has_loops) {
+    return cache;
+  }
+  size_t num_ids = next_block_id();
+  cache.loop_depths.assign(num_ids, 0);
+  cache.loop_headers.assign(num_ids, nullptr);
+  // In reverse postorder, the header of a loop comes before the headers of
+  // the loops nested in it, so the innermost header is the last one written.
+  std::vector<bool> in_loop(num_ids);
+  std::vector<Block*> body;
+  std::vector<Block*> work;
+  for (Block* header : cache.reverse_postorder) {
+    for (Edge* e : header->preds()) {
+      if (dominates(header, e->src())) {
+        work.push_back(e->src());
+      }
+    }
+    if (work.empty()) {
+      continue;
+    }
+    // Natural loop: the header, and every block that reaches the source of a
+    // back edge without going through the header.
+    in_loop[header->id()] = true;
+    body.push_back(header);
+    while (!work.empty()) {
+      Block* b = work.back();
+      work.pop_back();
+      if (in_loop[b->id()]) {
+        continue;
+      }
+      in_loop[b->id()] = true;
+      body.push_back(b);
+      for (Edge* e : b->preds()) {
+        if (cache.idoms[e->src()->id()] != nullptr) {
+          work.push_back(e->src());
+        }
+      }
+    }
+    for (Block* b : body) {
+      ++cache.loop_depths[b->id()];
+      cache.loop_headers[b->id()] = header;
+      in_loop[b->id()] = false;
+    }
+    body.clear();
+  }
+  cache.has_loops = true;
+  return cache;
+}
+
+const std::vector<Block*>& ControlFlowGraph::reverse_postorder() const {
+  return dominator_cache().reverse_postorder;
+}
+
+Block* ControlFlowGraph::idom(const Block* b) const {
+  return dominator_cache().idoms.at(b->id());
+}
+
+bool ControlFlowGraph::dominates(const Block* a, const Block* b) const {
+  const auto& idoms = dominator_cache().idoms;
+  while (b != nullptr && b != a) {
+    Block* dom = idoms.at(b->id());
+    b = dom == b ? nullptr : dom;
+  }
+  return b != nullptr;
+}
+
+Block* ControlFlowGraph::common_dominator(Block* a, Block* b) const {
+  const auto& cache = dominator_cache();
+  always_assert(cache.idoms.at(a->id()) != nullptr &&
+                cache.idoms.at(b->id()) != nullptr);
+  while (a != b) {
+    while (cache.rpo_index[a->id()] > cache.rpo_index[b->id()]) {
+      a = cache.idoms[a->id()];
+    }
+    while (cache.rpo_index[b->id()] > cache.rpo_index[a->id()]) {
+      b = cache.idoms[b->id()];
+    }
+  }
+  return a;
+}
+
+Block* ControlFlowGraph::post_idom(const Block* b) const {
+  return post_dominator_cache().post_idoms.at(b->id());
+}
+
+uint32_t ControlFlowGraph::loop_depth(const Block* b) const {
+  return loop_cache().loop_depths.at(b->id());
+}
+
+Block* ControlFlowGraph::loop_header(const Block* b) const {
+  return loop_cache().loop_headers.at(b->id());
+}
+
 ControlFlowGraph::EdgeSet ControlFlowGraph::remove_succ_edges(Block* b,
                                                               bool cleanup) {
   return remove_succ_edge_if(b, [](const Edge*) { return true; }, cleanup);
@@ -15,6 +15,7 @@
 #include <utility>
 #include <vector>
 
+#include "Arena.h"
 #include "IRCode.h"
 
 /**
@@ -177,6 +178,12 @@ std::ostream& operator<<(std::ostream& os, const Edge& e);
 
 using BlockId = size_t;
 
+// Return true if a block ends after `it` in a linear IRList that ends at `end`.
+// `in_try` is whether `it` is inside a try region.
+bool end_of_block(IRList::const_iterator it,
+                  IRList::const_iterator end,
+                  bool in_try);
+
 template <bool is_const>
 class InstructionIteratorImpl;
 using InstructionIterator = InstructionIteratorImpl</* is_const */ false>;
@@ -238,6 +245,9 @@ class Block final {
   // returns true if there are no MethodItemEntries (not IRInstructions)
   bool empty() const { return m_entries.empty(); }
 
+  // number of MethodItemEntries (not IRInstructions), for editable CFGs only
+  size_t num_entries() const { return m_entries.size(); }
+
   uint32_t num_opcodes() const;
 
   // return an iterator to the last MFLOW_OPCODE, or end() if there are none
@@ -324,8 +334,14 @@ class ControlFlowGraph {
   const Block* exit_block() const { return m_exit_block; }
   Block* entry_block() { return m_entry_block; }
   Block* exit_block() { return m_exit_block; }
-  void set_entry_block(Block* b) { m_entry_block = b; }
-  void set_exit_block(Block* b) { m_exit_block = b; }
+  void set_entry_block(Block* b) {
+    m_entry_block = b;
+    invalidate_analyses();
+  }
+  void set_exit_block(Block* b) {
+    m_exit_block = b;
+    invalidate_analyses();
+  }
 
   /*
    * If there is a single method exit point, this returns a vector holding the
@@ -352,7 +368,8 @@ class ControlFlowGraph {
   // args are arguments to an Edge constructor
   template <class... Args>
   void add_edge(Args&&... args) {
-    Edge* edge = new Edge(std::forward<Args>(args)...);
+    Edge* edge = m_edge_pool.make(std::forward<Args>(args)...);
+    invalidate_analyses();
     m_edges.insert(edge);
     edge->src()->m_succs.emplace_back(edge);
     edge->target()->m_preds.emplace_back(edge);
@@ -493,6 +510,37 @@ class ControlFlowGraph {
   // Finding immediate dominator for each blocks in ControlFlowGraph.
   std::unordered_map<Block*, DominatorInfo> immediate_dominators() const;
 
+  /*
+   * The analyses below are computed on first use and cached until the next
+   * change to the blocks or edges of the graph. Blocks that were created
+   * after the last change have no results. Not thread-safe.
+   */
+
+  // The blocks reachable from the entry block, in reverse postorder.
+  const std::vector<Block*>& reverse_postorder() const;
+
+  // The immediate dominator of `b`. The entry block is its own immediate
+  // dominator. nullptr if `b` is unreachable from the entry block.
+  Block* idom(const Block* b) const;
+
+  // Does `a` dominate `b`? Every block dominates itself.
+  bool dominates(const Block* a, const Block* b) const;
+
+  // The closest block that dominates both `a` and `b`.
+  Block* common_dominator(Block* a, Block* b) const;
+
+  // The immediate post-dominator of `b`. Blocks without successors are their
+  // own immediate post-dominators. nullptr if no exit can be reached from `b`,
+  // or if `b` reaches several exits and no block post-dominates it; call
+  // `calculate_exit_block()` first to have a single exit.
+  Block* post_idom(const Block* b) const;
+
+  // The number of natural loops that contain `b`.
+  uint32_t loop_depth(const Block* b) const;
+
+  // The header of the innermost natural loop that contains `b`, or nullptr.
+  Block* loop_header(const Block* b) const;
+
   // Do writes to this CFG propagate back to IR and Dex code?
   bool editable() const { return m_editable; }
 
@@ -513,6 +561,14 @@ class ControlFlowGraph {
   // Assumes m_editable is true
   void simplify();
 
+  // Like simplify(), but also merges each block into its predecessor when the
+  // predecessor unconditionally jumps to it and is its only way in. Driven by
+  // a worklist: after a block is removed, only the blocks whose neighbourhood
+  // changed are looked at again.
+  // Returns the number of blocks removed
+  // Assumes m_editable is true
+  uint32_t simplify_worklist();
+
   // SIGABORT if the internal state of the CFG is invalid
   void sanity_check() const;
 
@@ -645,6 +701,11 @@ class ControlFlowGraph {
   // remove blocks with no entries
   void remove_empty_blocks();
 
+  // Remove the effectively empty block `b`, redirecting its predecessors to
+  // its successor. Returns false if `b` is an infinite loop and was kept.
+  bool remove_empty_block(Block* b,
+                          std::unordered_set<DexPosition*>* deleted_positions);
+
   // remove any parent pointer that was passed in as an arg (e.g. for when
   // you delete the supplied positions)
   void remove_dangling_parents(const std::unordered_set<DexPosition*>&);
@@ -671,6 +732,7 @@ class ControlFlowGraph {
                          Block* target,
                          EdgePredicate predicate,
                          bool cleanup = true) {
+    invalidate_analyses();
     auto& forward_edges = source->m_succs;
     EdgeSet to_remove;
     forward_edges.erase(
@@ -703,6 +765,7 @@ class ControlFlowGraph {
   EdgeSet remove_pred_edge_if(Block* block,
                               EdgePredicate predicate,
                               bool cleanup = true) {
+    invalidate_analyses();
     auto& reverse_edges = block->m_preds;
 
     std::vector<Block*> source_blocks;
@@ -739,6 +802,7 @@ class ControlFlowGraph {
   EdgeSet remove_succ_edge_if(Block* block,
                               EdgePredicate predicate,
                               bool cleanup = true) {
+    invalidate_analyses();
     auto& forward_edges = block->m_succs;
 
     std::vector<Block*> target_blocks;
@@ -795,10 +859,32 @@ class ControlFlowGraph {
   // Return the next unused block identifier
   BlockId next_block_id() const;
 
-  // The memory of all blocks and edges in this graph are owned here
+  struct AnalysisCache {
+    // Indexed by block id, like all the vectors below.
+    std::vector<uint32_t> rpo_index;
+    std::vector<Block*> reverse_postorder;
+    std::vector<Block*> idoms;
+    std::vector<Block*> post_idoms;
+    std::vector<uint32_t> loop_depths;
+    std::vector<Block*> loop_headers;
+    bool has_dominators{false};
+    bool has_post_dominators{false};
+    bool has_loops{false};
+  };
+  AnalysisCache& dominator_cache() const;
+  AnalysisCache& post_dominator_cache() const;
+  AnalysisCache& loop_cache() const;
+  void invalidate_analyses() { m_analysis_cache.reset(); }
+
+  // The memory of all blocks and edges in this graph is owned here. It is
+  // returned to the system all at once when the graph is destroyed.
+  ArenaPool<Block> m_block_pool;
+  ArenaPool<Edge> m_edge_pool;
   Blocks m_blocks;
   EdgeSet m_edges;
 
+  mutable std::unique_ptr<AnalysisCache> m_analysis_cache;
+
   uint16_t m_registers_size{0};
   Block* m_entry_block{nullptr};
   Block* m_exit_block{nullptr};
@@ -0,0 +1,265 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ControlFlowView.h"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+#include "DexUtil.h"
+
+namespace cfg {
+
+ControlFlowView::ControlFlowView(const IRCode& code) {
+  always_assert_log(!code.editable_cfg_built(),
+                    "The code of an editable CFG is in its blocks");
+  auto end = code.end();
+  always_assert_log(code.begin() != end, "IRList contains no instructions");
+
+  // The last entry of each block, and the catch_start of the try region that
+  // the block is in, if any.
+  std::vector<const MethodItemEntry*> last_entries;
+  std::vector<const MethodItemEntry*> block_catches;
+  std::vector<std::pair<const MethodItemEntry*, NodeId>> targets;
+  std::unordered_map<const CatchEntry*, NodeId> catch_blocks;
+
+  m_block_begins.push_back(code.begin());
+  bool in_try = false;
+  const MethodItemEntry* catches = nullptr;
+  for (auto it = code.begin(); it != end; ++it) {
+    NodeId block = m_block_begins.size() - 1;
+    const MethodItemEntry* block_catch = catches;
+    if (it->type == MFLOW_TRY) {
+      if (it->tentry->type == TRY_START) {
+        // Assumption: TRY_STARTs are only at the beginning of blocks
+        always_assert(it == m_block_begins.back());
+        in_try = true;
+        catches = block_catch = it->tentry->catch_start;
+      } else if (it->tentry->type == TRY_END) {
+        // A TRY_END ends its block, which is still in the try region.
+        in_try = false;
+        block_catch = it->tentry->catch_start;
+        catches = nullptr;
+      }
+    } else if (it->type == MFLOW_CATCH) {
+      catch_blocks[it->centry] = block;
+    } else if (it->type == MFLOW_TARGET) {
+      targets.emplace_back(it->target->src, block);
+    }
+
+    if (!end_of_block(it, end, in_try)) {
+      continue;
+    }
+    last_entries.push_back(&*it);
+    block_catches.push_back(block_catch);
+    m_block_begins.push_back(std::next(it));
+  }
+
+  connect_blocks(last_entries, block_catches, targets, catch_blocks);
+  index_edges();
+  remove_unreachable_succ_edges();
+  calculate_exit_block();
+}
+
+namespace {
+
+bool ends_with_may_throw(const boost::iterator_range<IRList::const_iterator>&
+                             entries) {
+  for (auto it = entries.end(); it != entries.begin();) {
+    --it;
+    if (it->type == MFLOW_OPCODE) {
+      return opcode::can_throw(it->insn->opcode());
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+// Add the edges in the same order as a ControlFlowGraph would: the branch
+// targets, then the fallthrough, then the catch blocks.
+void ControlFlowView::connect_blocks(
+    const std::vector<const MethodItemEntry*>& last_entries,
+    const std::vector<const MethodItemEntry*>& block_catches,
+    const std::vector<std::pair<const MethodItemEntry*, NodeId>>& targets,
+    const std::unordered_map<const CatchEntry*, NodeId>& catch_blocks) {
+  size_t num_blocks = last_entries.size();
+  std::unordered_map<const MethodItemEntry*, NodeId> branch_blocks;
+  for (NodeId b = 0; b < num_blocks; ++b) {
+    const auto* last_mie = last_entries[b];
+    if (last_mie->type == MFLOW_OPCODE &&
+        is_branch(last_mie->insn->opcode())) {
+      branch_blocks.emplace(last_mie, b);
+    }
+  }
+  for (const auto& pair : targets) {
+    auto it = branch_blocks.find(pair.first);
+    if (it == branch_blocks.end()) {
+      continue;
+    }
+    auto edge_type =
+        is_goto(pair.first->insn->opcode()) ? EDGE_GOTO : EDGE_BRANCH;
+    m_edges.push_back(EdgeInfo{it->second, pair.second, edge_type});
+  }
+
+  for (NodeId b = 0; b < num_blocks; ++b) {
+    const auto* last_mie = last_entries[b];
+    bool fallthrough = true;
+    if (last_mie->type == MFLOW_OPCODE) {
+      auto last_op = last_mie->insn->opcode();
+      fallthrough = !is_goto(last_op) && !is_return(last_op) &&
+                    last_op != OPCODE_THROW;
+    }
+    if (fallthrough && b + 1 < num_blocks) {
+      m_edges.push_back(EdgeInfo{b, b + 1, EDGE_GOTO});
+    }
+    if (block_catches[b] != nullptr && ends_with_may_throw(entries(b))) {
+      for (auto mie = block_catches[b]; mie != nullptr;
+           mie = mie->centry->next) {
+        m_edges.push_back(
+            EdgeInfo{b, catch_blocks.at(mie->centry), EDGE_THROW});
+      }
+    }
+  }
+}
+
+void ControlFlowView::index_edges() {
+  size_t num_blocks = this->num_blocks();
+  m_succ_offsets.assign(num_blocks + 1, 0);
+  m_pred_offsets.assign(num_blocks + 1, 0);
+  for (const auto& edge : m_edges) {
+    ++m_succ_offsets[edge.src + 1];
+    ++m_pred_offsets[edge.target + 1];
+  }
+  for (size_t b = 0; b < num_blocks; ++b) {
+    m_succ_offsets[b + 1] += m_succ_offsets[b];
+    m_pred_offsets[b + 1] += m_pred_offsets[b];
+  }
+
+  // A stable counting sort by source block.
+  std::vector<EdgeInfo> edges(m_edges.size());
+  std::vector<EdgeId> next(m_succ_offsets.begin(), m_succ_offsets.end() - 1);
+  for (const auto& edge : m_edges) {
+    edges[next[edge.src]++] = edge;
+  }
+  m_edges = std::move(edges);
+
+  m_pred_edges.resize(m_edges.size());
+  next.assign(m_pred_offsets.begin(), m_pred_offsets.end() - 1);
+  for (EdgeId e = 0; e < m_edges.size(); ++e) {
+    m_pred_edges[next[m_edges[e].target]++] = e;
+  }
+}
+
+void ControlFlowView::remove_unreachable_succ_edges() {
+  std::vector<bool> visited(num_blocks());
+  std::vector<NodeId> to_visit{entry_block()};
+  size_t num_visited = 0;
+  while (!to_visit.empty()) {
+    NodeId b = to_visit.back();
+    to_visit.pop_back();
+    if (visited[b]) {
+      continue;
+    }
+    visited[b] = true;
+    ++num_visited;
+    for (EdgeId e : succs(b)) {
+      to_visit.push_back(target(e));
+    }
+  }
+  if (num_visited == num_blocks()) {
+    return;
+  }
+
+  m_edges.erase(std::remove_if(m_edges.begin(), m_edges.end(),
+                               [&](const EdgeInfo& edge) {
+                                 return !visited[edge.src];
+                               }),
+                m_edges.end());
+  index_edges();
+}
+
+// This is ControlFlowGraph::calculate_exit_block() without the recursion: the
+// exit blocks are the heads of the strongly connected components that have no
+// successors outside themselves.
+void ControlFlowView::calculate_exit_block() {
+  // Depth-first number. Special values:
+  //   0 - unvisited
+  //   VISITED - visited and determined to be in a separate SCC
+  constexpr uint32_t VISITED = std::numeric_limits<uint32_t>::max();
+  struct Frame {
+    NodeId block;
+    EdgeId next_edge;
+    uint32_t head;
+    // whether any vertex in the current SCC has a successor edge that points
+    // outside itself
+    bool has_exit;
+  };
+  std::vector<uint32_t> dfns(num_blocks(), 0);
+  std::vector<NodeId> stack;
+  std::vector<Frame> frames;
+  std::vector<NodeId> exit_blocks;
+  uint32_t next_dfn{0};
+  auto visit = [&](NodeId b) {
+    stack.push_back(b);
+    dfns[b] = ++next_dfn;
+    frames.push_back(Frame{b, m_succ_offsets[b], dfns[b], false});
+  };
+
+  visit(entry_block());
+  while (!frames.empty()) {
+    auto& frame = frames.back();
+    if (frame.next_edge < m_succ_offsets[frame.block + 1]) {
+      NodeId succ = target(frame.next_edge++);
+      uint32_t succ_dfn = dfns[succ];
+      if (succ_dfn == 0) {
+        visit(succ);
+      } else {
+        frame.has_exit |= succ_dfn == VISITED;
+        frame.head = std::min(frame.head, succ_dfn);
+      }
+      continue;
+    }
+
+    NodeId b = frame.block;
+    uint32_t head = frame.head;
+    bool has_exit = frame.has_exit;
+    frames.pop_back();
+    if (head == dfns[b]) {
+      if (!has_exit) {
+        exit_blocks.push_back(b);
+        has_exit = true;
+      }
+      NodeId top;
+      do {
+        top = stack.back();
+        stack.pop_back();
+        dfns[top] = VISITED;
+      } while (top != b);
+    }
+    if (!frames.empty()) {
+      auto& parent = frames.back();
+      parent.has_exit |= has_exit;
+      parent.head = std::min(parent.head, head);
+    }
+  }
+
+  if (exit_blocks.size() == 1) {
+    m_exit_block = exit_blocks[0];
+    return;
+  }
+  // Add a ghost exit block, an empty range at the end of the code.
+  m_exit_block = num_blocks();
+  m_block_begins.push_back(m_block_begins.back());
+  for (NodeId b : exit_blocks) {
+    m_edges.push_back(EdgeInfo{b, m_exit_block, EDGE_GHOST});
+  }
+  index_edges();
+}
+
+} // namespace cfg
@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <boost/range/irange.hpp>
+#include <boost/range/iterator_range.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "ControlFlow.h"
+#include "IRCode.h"
+
+namespace cfg {
+
+/*
+ * A read-only control-flow graph of an IRCode, for analyses that never change
+ * the code.
+ *
+ * Unlike a non-editable ControlFlowGraph, the view allocates no Block or Edge
+ * objects. Blocks are numbered in code order, and each block is a range of the
+ * IRCode's entries, which stay where they are. Edges are kept in flat arrays
+ * indexed by block. The blocks and edges are the same as those of a
+ * non-editable ControlFlowGraph after calculate_exit_block(): the successor
+ * edges of unreachable blocks are dropped, and if the code has several exit
+ * points, a ghost exit block (with no entries) is added.
+ *
+ * The view is only valid as long as the IRCode isn't modified.
+ */
+class ControlFlowView {
+ public:
+  using NodeId = uint32_t;
+  using EdgeId = uint32_t;
+  using Entries = boost::iterator_range<IRList::const_iterator>;
+
+  explicit ControlFlowView(const IRCode& code);
+
+  size_t num_blocks() const { return m_block_begins.size() - 1; }
+
+  size_t num_edges() const { return m_edges.size(); }
+
+  NodeId entry_block() const { return 0; }
+
+  NodeId exit_block() const { return m_exit_block; }
+
+  // The MethodItemEntries of a block.
+  Entries entries(NodeId b) const {
+    return Entries(m_block_begins[b], m_block_begins[b + 1]);
+  }
+
+  boost::integer_range<EdgeId> succs(NodeId b) const {
+    return boost::irange(m_succ_offsets[b], m_succ_offsets[b + 1]);
+  }
+
+  boost::iterator_range<const EdgeId*> preds(NodeId b) const {
+    const EdgeId* edges = m_pred_edges.data();
+    return boost::make_iterator_range(edges + m_pred_offsets[b],
+                                      edges + m_pred_offsets[b + 1]);
+  }
+
+  NodeId src(EdgeId e) const { return m_edges[e].src; }
+
+  NodeId target(EdgeId e) const { return m_edges[e].target; }
+
+  EdgeType type(EdgeId e) const { return m_edges[e].type; }
+
+ private:
+  struct EdgeInfo {
+    NodeId src;
+    NodeId target;
+    EdgeType type;
+  };
+
+  void connect_blocks(
+      const std::vector<const MethodItemEntry*>& last_entries,
+      const std::vector<const MethodItemEntry*>& block_catches,
+      const std::vector<std::pair<const MethodItemEntry*, NodeId>>& targets,
+      const std::unordered_map<const CatchEntry*, NodeId>& catch_blocks);
+
+  // Sorts the edges by source block and builds the edge arrays.
+  void index_edges();
+
+  void remove_unreachable_succ_edges();
+
+  void calculate_exit_block();
+
+  // The begin of each block, followed by the end of the code. The ghost exit
+  // block, if any, is the empty range at the end.
+  std::vector<IRList::const_iterator> m_block_begins;
+  // Sorted by source block, so that the successor edges of block b are the
+  // ids in [m_succ_offsets[b], m_succ_offsets[b + 1]).
+  std::vector<EdgeInfo> m_edges;
+  std::vector<EdgeId> m_succ_offsets;
+  std::vector<EdgeId> m_pred_offsets;
+  std::vector<EdgeId> m_pred_edges;
+  NodeId m_exit_block{0};
+};
+
+// A static-method-only API for use with the monotonic fixpoint iterator.
+class ViewGraphInterface {
+ public:
+  using Graph = ControlFlowView;
+  using NodeId = ControlFlowView::NodeId;
+  using EdgeId = ControlFlowView::EdgeId;
+  static NodeId entry(const Graph& graph) { return graph.entry_block(); }
+  static NodeId exit(const Graph& graph) { return graph.exit_block(); }
+  static boost::iterator_range<const EdgeId*> predecessors(const Graph& graph,
+                                                           const NodeId& b) {
+    return graph.preds(b);
+  }
+  static boost::integer_range<EdgeId> successors(const Graph& graph,
+                                                 const NodeId& b) {
+    return graph.succs(b);
+  }
+  static NodeId source(const Graph& graph, const EdgeId& e) {
+    return graph.src(e);
+  }
+  static NodeId target(const Graph& graph, const EdgeId& e) {
+    return graph.target(e);
+  }
+};
+
+} // namespace cfg
@@ -25,7 +25,7 @@ DexProto* make_static_sig(DexMethod* meth) {
   auto rtype = proto->get_rtype();
   std::deque<DexType*> arg_list;
   arg_list.push_back(meth->get_class());
-  auto args = proto->get_args()->get_type_list();
+  const auto& args = proto->get_args()->get_type_list();
   arg_list.insert(arg_list.end(), args.begin(), args.end());
   auto new_args = DexTypeList::make_type_list(std::move(arg_list));
   return DexProto::make_proto(rtype, new_args);
@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CrossStoreRefs.h"
+
+#include <algorithm>
+#include <numeric>
+#include <unordered_map>
+
+#include "DexUtil.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "Parallel.h"
+
+namespace {
+
+/*
+ * visible[r][t] says whether store r may refer to store t. The external store
+ * is visible from all stores.
+ */
+std::vector<std::vector<bool>> build_visibility(const DexStoresVector& stores,
+                                                bool root_store_visible) {
+  size_t num_stores = stores.size();
+  std::unordered_map<std::string, size_t> store_indices;
+  for (size_t i = 0; i < num_stores; ++i) {
+    store_indices.emplace(stores[i].get_name(), i);
+  }
+  std::vector<std::vector<bool>> visible(
+      num_stores, std::vector<bool>(num_stores + 1, false));
+  for (size_t i = 0; i < num_stores; ++i) {
+    auto& row = visible[i];
+    row[num_stores] = true;
+    if (root_store_visible) {
+      row[0] = true;
+    }
+    // Everything that the store depends on, transitively.
+    std::vector<bool> reached(num_stores, false);
+    std::vector<size_t> pending{i};
+    reached[i] = true;
+    while (!pending.empty()) {
+      auto store = pending.back();
+      pending.pop_back();
+      row[store] = true;
+      for (const auto& dependency : stores[store].get_dependencies()) {
+        auto it = store_indices.find(dependency);
+        if (it != store_indices.end() && !reached[it->second]) {
+          reached[it->second] = true;
+          pending.push_back(it->second);
+        }
+      }
+    }
+  }
+  return visible;
+}
+
+const DexClass* referenced_class(const IRInstruction* insn) {
+  if (insn->has_type()) {
+    return type_class(insn->get_type());
+  }
+  if (insn->has_field()) {
+    return type_class(insn->get_field()->get_class());
+  }
+  if (insn->has_method()) {
+    // For virtual methods, the class that the method is bound to may not
+    // define it.
+    return type_class(insn->get_method()->get_class());
+  }
+  return nullptr;
+}
+
+} // namespace
+
+std::vector<CrossStoreRef> find_cross_store_refs(const DexStoresVector& stores,
+                                                 bool root_store_visible) {
+  auto visible = build_visibility(stores, root_store_visible);
+  size_t external_store = stores.size();
+
+  std::vector<std::pair<DexClass*, size_t>> classes;
+  std::unordered_map<const DexClass*, size_t> class_stores;
+  for (size_t i = 0; i < stores.size(); ++i) {
+    for (const auto& dex : stores[i].get_dexen()) {
+      for (auto cls : dex) {
+        if (class_stores.emplace(cls, i).second) {
+          classes.emplace_back(cls, i);
+        }
+      }
+    }
+  }
+
+  std::vector<std::vector<CrossStoreRef>> refs_by_class(classes.size());
+  std::vector<size_t> indices(classes.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    auto source = classes[i].first;
+    auto source_store = classes[i].second;
+    std::vector<const DexClass*> targets;
+    // TODO: walk through annotations
+    for (auto* methods : {&source->get_dmethods(), &source->get_vmethods()}) {
+      for (auto method : *methods) {
+        auto code = method->get_code();
+        if (code == nullptr) {
+          continue;
+        }
+        for (const auto& mie : InstructionIterable(code)) {
+          auto target = referenced_class(mie.insn);
+          if (target != nullptr) {
+            targets.push_back(target);
+          }
+        }
+      }
+    }
+    sort_unique(targets);
+    auto& refs = refs_by_class[i];
+    for (auto target : targets) {
+      auto it = class_stores.find(target);
+      auto target_store =
+          it == class_stores.end() ? external_store : it->second;
+      refs.push_back(CrossStoreRef{source, source_store, target, target_store,
+                                   visible[source_store][target_store]});
+    }
+  });
+
+  std::vector<CrossStoreRef> refs;
+  for (auto& class_refs : refs_by_class) {
+    refs.insert(refs.end(), class_refs.begin(), class_refs.end());
+  }
+  std::sort(refs.begin(), refs.end(),
+            [](const CrossStoreRef& a, const CrossStoreRef& b) {
+              if (a.source_store != b.source_store) {
+                return a.source_store < b.source_store;
+              }
+              if (a.source != b.source) {
+                return compare_dexclasses(a.source, b.source);
+              }
+              if (a.target_store != b.target_store) {
+                return a.target_store < b.target_store;
+              }
+              return compare_dexclasses(a.target, b.target);
+            });
+  return refs;
+}
@@ -0,0 +1,41 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "DexClass.h"
+#include "DexStore.h"
+
+/**
+ * A reference from the code of a class to another class, as the verifiers of
+ * store dependencies see it. Stores are identified by their index in the
+ * DexStoresVector. Classes that are in no store, e.g. those of the library
+ * jars, are in the "external" store, whose index is the number of stores.
+ */
+struct CrossStoreRef {
+  const DexClass* source;
+  size_t source_store;
+  const DexClass* target;
+  size_t target_store;
+  // Whether the source store may refer to the target store.
+  bool allowed;
+};
+
+/**
+ * Finds the classes that the instructions of each class refer to, through a
+ * type, a field or a method. A store may refer to itself and to the stores
+ * it depends on, directly or transitively. With `root_store_visible`, every
+ * store may also refer to the root store, stores[0].
+ *
+ * The classes are scanned in parallel. The result has one entry per pair of
+ * classes, sorted by source store, source class name, target store and
+ * target class name, so it doesn't depend on the scheduling.
+ */
+std::vector<CrossStoreRef> find_cross_store_refs(const DexStoresVector& stores,
+                                                 bool root_store_visible);
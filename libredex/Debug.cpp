@@ -13,6 +13,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "Trace.h"
+
 #ifndef _MSC_VER
 #include <execinfo.h>
 #include <unistd.h>
@@ -30,6 +32,7 @@ void crash_backtrace() {
 }; // namespace
 
 void crash_backtrace_handler(int sig) {
+  flush_trace_on_crash();
   crash_backtrace();
 
   signal(sig, SIG_DFL);
@@ -42,6 +45,9 @@ void assert_fail(const char* expr,
                  const char* func,
                  const char* fmt,
                  ...) {
+  // Write out what was traced up to the failure first, as it is what explains
+  // it.
+  flush_trace();
   va_list ap;
   va_start(ap, fmt);
   fprintf(
@@ -12,6 +12,7 @@
 #include <list>
 #include <map>
 #include <sstream>
+#include <unordered_map>
 
 #include "Gatherable.h"
 #include "Show.h"
@@ -91,6 +92,11 @@ class DexEncodedValue : public Gatherable {
   bool is_zero() const;
   bool is_wide() const;
   static DexEncodedValue* zero_for_type(DexType* type);
+  // A numeric value, i.e. one that is neither a boolean nor a reference.
+  static DexEncodedValue* make_numeric(DexEncodedValueTypes type,
+                                       uint64_t value) {
+    return new DexEncodedValue(type, value);
+  }
 };
 
 inline size_t hash_value(const DexEncodedValue& v) { return v.hash_value(); }
@@ -391,7 +397,7 @@ class DexAnnotationSet : public Gatherable {
   }
   void vencode(DexOutputIdx* dodx,
                std::vector<uint32_t>& asetout,
-               std::map<DexAnnotation*, uint32_t>& annoout);
+               std::unordered_map<DexAnnotation*, uint32_t>& annoout);
   void gather_annotations(std::vector<DexAnnotation*>& alist);
 };
 
@@ -461,8 +467,8 @@ class DexAnnotationDirectory {
   void gather_xrefs(std::vector<ParamAnnotations*>& xrefs);
   void vencode(DexOutputIdx* dodx,
                std::vector<uint32_t>& annodirout,
-               std::map<ParamAnnotations*, uint32_t>& xrefmap,
-               std::map<DexAnnotationSet*, uint32_t>& asetmap);
+               std::unordered_map<ParamAnnotations*, uint32_t>& xrefmap,
+               std::unordered_map<DexAnnotationSet*, uint32_t>& asetmap);
 
   friend std::string show(const DexAnnotationDirectory*);
 };
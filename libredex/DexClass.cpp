@@ -16,6 +16,7 @@
 #include "DexUtil.h"
 #include "IRCode.h"
 #include "IRInstruction.h"
+#include "Resolver.h"
 #include "StringBuilder.h"
 #include "Util.h"
 #include "Walkers.h"
@@ -38,8 +39,8 @@ uint32_t DexString::length() const {
 
 int DexTypeList::encode(DexOutputIdx* dodx, uint32_t* output) {
   uint16_t* typep = (uint16_t*)(output + 1);
-  *output = (uint32_t)m_list.size();
-  for (auto const& type : m_list) {
+  *output = m_size;
+  for (auto const& type : *this) {
     *typep++ = dodx->typeidx(type);
   }
   return (int)(((uint8_t*)typep) - (uint8_t*)output);
@@ -211,7 +212,7 @@ std::vector<std::unique_ptr<DexDebugInstruction>> generate_debug_instructions(
     for (; it != entries.end() && it->addr == addr; ++it) {
       switch (it->type) {
       case DexDebugEntryType::Position:
-        if (it->pos->file != nullptr) {
+        if (it->pos->file() != nullptr) {
           positions.push_back(it->pos.get());
         }
         break;
@@ -511,21 +512,55 @@ std::string DexMethod::get_fully_deobfuscated_name() const {
 }
 
 void DexMethod::set_code(std::unique_ptr<IRCode> code) {
+  drop_pending_balloon();
   m_code = std::move(code);
 }
 
 void DexMethod::balloon() {
   assert(m_code == nullptr);
+  m_balloon_pending.store(false, std::memory_order_relaxed);
   m_code = std::make_unique<IRCode>(this);
   m_dex_code.reset();
 }
 
 void DexMethod::sync() {
+  balloon_if_pending();
   assert(m_dex_code == nullptr);
   m_dex_code = m_code->sync(this);
   m_code.reset();
 }
 
+void DexMethod::balloon_lazily() {
+  assert(m_code == nullptr);
+  m_balloon_pending.store(m_dex_code != nullptr, std::memory_order_release);
+}
+
+namespace {
+// Lazily ballooned methods are ballooned under one of these locks, picked by
+// the address of the method.
+constexpr size_t kBalloonLocks = 31;
+std::mutex s_balloon_locks[kBalloonLocks];
+} // namespace
+
+void DexMethod::drop_pending_balloon() {
+  // Leave the method as if it had been ballooned and its code then replaced.
+  if (m_balloon_pending.exchange(false)) {
+    m_dex_code.reset();
+  }
+}
+
+void DexMethod::balloon_pending() const {
+  auto& lock = s_balloon_locks[std::hash<const DexMethod*>()(this) %
+                               kBalloonLocks];
+  std::lock_guard<std::mutex> guard(lock);
+  if (m_balloon_pending.load(std::memory_order_relaxed)) {
+    auto self = const_cast<DexMethod*>(this);
+    self->m_code = std::make_unique<IRCode>(self);
+    self->m_dex_code.reset();
+    m_balloon_pending.store(false, std::memory_order_release);
+  }
+}
+
 size_t hash_value(const DexMethodSpec& r) {
   size_t seed = boost::hash<DexType*>()(r.cls);
   boost::hash_combine(seed, r.name);
@@ -626,7 +661,22 @@ void DexClass::set_deobfuscated_name(const std::string& name) {
   g_redex->alias_type_name(m_self, new_name);
 }
 
+void DexClass::set_super_class(DexType* super_class) {
+  always_assert_log(
+      !m_external, "Unexpected external class %s\n", SHOW(m_self));
+  m_super_class = super_class;
+  invalidate_method_resolution_cache();
+}
+
+void DexClass::set_interfaces(DexTypeList* intfs) {
+  always_assert_log(!m_external,
+      "Unexpected external class %s\n", SHOW(m_self));
+  m_interfaces = intfs;
+  invalidate_method_resolution_cache();
+}
+
 void DexClass::remove_method(const DexMethod* m) {
+  invalidate_method_resolution_cache();
   auto& meths = m->is_virtual() ? m_vmethods : m_dmethods;
   auto it = std::find(meths.begin(), meths.end(), m);
   DEBUG_ONLY bool erased = false;
@@ -651,6 +701,7 @@ void DexMethod::make_concrete(DexAccessFlags access,
                               std::unique_ptr<DexCode> dc,
                               bool is_virtual) {
   m_access = access;
+  m_balloon_pending.store(false, std::memory_order_relaxed);
   m_dex_code = std::move(dc);
   m_concrete = true;
   m_virtual = is_virtual;
@@ -660,6 +711,7 @@ void DexMethod::make_concrete(DexAccessFlags access,
                               std::unique_ptr<IRCode> dc,
                               bool is_virtual) {
   m_access = access;
+  drop_pending_balloon();
   m_code = std::move(dc);
   m_concrete = true;
   m_virtual = is_virtual;
@@ -672,6 +724,7 @@ void DexMethod::make_concrete(DexAccessFlags access, bool is_virtual) {
 void DexMethod::make_non_concrete() {
   m_access = static_cast<DexAccessFlags>(0);
   m_concrete = false;
+  drop_pending_balloon();
   m_code.reset();
   m_virtual = false;
   m_param_anno.clear();
@@ -744,9 +797,13 @@ void DexClass::load_class_data_item(DexIdx* idx,
   }
 }
 
-std::unique_ptr<IRCode> DexMethod::release_code() { return std::move(m_code); }
+std::unique_ptr<IRCode> DexMethod::release_code() {
+  balloon_if_pending();
+  return std::move(m_code);
+}
 
 void DexClass::add_method(DexMethod* m) {
+  invalidate_method_resolution_cache();
   always_assert_log(m->is_concrete() || m->is_external(),
                     "Method %s must be concrete",
                     SHOW(m));
@@ -1027,9 +1084,7 @@ DexClass::DexClass(DexIdx* idx,
 }
 
 void DexTypeList::gather_types(std::vector<DexType*>& ltype) const {
-  for (auto const& type : m_list) {
-    ltype.push_back(type);
-  }
+  ltype.insert(ltype.end(), begin(), end());
 }
 
 static DexString* make_shorty(DexType* rtype, DexTypeList* args) {
@@ -1172,7 +1227,8 @@ void DexField::gather_methods(std::vector<DexMethodRef*>& lmethod) const {
 
 void DexMethod::gather_types(std::vector<DexType*>& ltype) const {
   // We handle m_spec.cls and proto in the first-layer gather.
-  if (m_code) m_code->gather_types(ltype);
+  auto code = get_code();
+  if (code) code->gather_types(ltype);
   if (m_anno) m_anno->gather_types(ltype);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -1185,7 +1241,8 @@ void DexMethod::gather_types(std::vector<DexType*>& ltype) const {
 
 void DexMethod::gather_strings(std::vector<DexString*>& lstring) const {
   // We handle m_name and proto in the first-layer gather.
-  if (m_code) m_code->gather_strings(lstring);
+  auto code = get_code();
+  if (code) code->gather_strings(lstring);
   if (m_anno) m_anno->gather_strings(lstring);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -1197,7 +1254,8 @@ void DexMethod::gather_strings(std::vector<DexString*>& lstring) const {
 }
 
 void DexMethod::gather_fields(std::vector<DexFieldRef*>& lfield) const {
-  if (m_code) m_code->gather_fields(lfield);
+  auto code = get_code();
+  if (code) code->gather_fields(lfield);
   if (m_anno) m_anno->gather_fields(lfield);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -1209,7 +1267,8 @@ void DexMethod::gather_fields(std::vector<DexFieldRef*>& lfield) const {
 }
 
 void DexMethod::gather_methods(std::vector<DexMethodRef*>& lmethod) const {
-  if (m_code) m_code->gather_methods(lmethod);
+  auto code = get_code();
+  if (code) code->gather_methods(lmethod);
   if (m_anno) m_anno->gather_methods(lmethod);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
 #include <functional>
@@ -133,24 +135,35 @@ inline bool compare_dexstrings(const DexString* a, const DexString* b) {
   } else if (b == nullptr) {
     return false;
   }
-  if (a->is_simple() && b->is_simple())
-    return (strcmp(a->c_str(), b->c_str()) < 0);
-  /*
-   * Bother, need to do code-point character-by-character
-   * comparison.
-   */
   const char* sa = a->c_str();
   const char* sb = b->c_str();
-  /* Equivalence test first, so we don't worry about walking
-   * off the end.
+  /*
+   * Find the first byte that differs, counting the terminating NUL of the
+   * shorter string, so that different strings always have one. Encoded
+   * chars never contain NULs.
    */
-  if (strcmp(sa, sb) == 0) return false;
-  if (strlen(sa) == 0) {
-    return true;
-  }
-  if (strlen(sb) == 0) {
-    return false;
-  }
+  const size_t n = std::min(a->size(), b->size()) + 1;
+  size_t i = mismatch_index(sa, sb, n);
+  if (i == n) return false;
+  /*
+   * ASCII bytes, and the terminator, are whole code points that compare like
+   * their bytes.
+   */
+  const uint8_t ca = sa[i];
+  const uint8_t cb = sb[i];
+  if (ca < 0x80 && cb < 0x80) return ca < cb;
+  /*
+   * Bother, need to do code-point character-by-character comparison, from
+   * the start of the char that differs.
+   */
+  auto is_continuation = [](char c) { return (c & 0xc0) == 0x80; };
+  while (i > 0 && (is_continuation(sa[i]) || is_continuation(sb[i]))) {
+    i--;
+  }
+  sa += i;
+  sb += i;
+  if (*sa == '\0') return true;
+  if (*sb == '\0') return false;
   while (1) {
     uint32_t cpa = mutf8_next_code_point(sa);
     uint32_t cpb = mutf8_next_code_point(sb);
@@ -171,8 +184,12 @@ struct dexstrings_comparator {
 
 class DexType {
   friend struct RedexContext;
+  friend DexClass* type_class(const DexType* t);
 
   DexString* m_name;
+  // The class defining this type, if any. Set once by
+  // RedexContext::publish_class, so that type_class() is a single load.
+  mutable std::atomic<DexClass*> m_class{nullptr};
 
   // See UNIQUENESS above for the rationale for the private constructor pattern.
   DexType(DexString* dstring) {
@@ -374,7 +391,9 @@ class DexField : public DexFieldRef {
     return full_name.substr(dot_pos + 1, colon_pos-dot_pos - 1);
   }
 
-  void set_deobfuscated_name(std::string name) { m_deobfuscated_name = name; }
+  void set_deobfuscated_name(std::string name) {
+    m_deobfuscated_name = std::move(name);
+  }
   const std::string& get_deobfuscated_name() const {
     return m_deobfuscated_name;
   }
@@ -423,17 +442,34 @@ struct dexfields_comparator {
   }
 };
 
+/*
+ * An interned, immutable list of types. The types are stored inline, right
+ * after the object, which is allocated together with them in an arena owned
+ * by the RedexContext. The hash of the list is computed once, when it is
+ * interned.
+ */
 class DexTypeList {
   friend struct RedexContext;
 
-  std::deque<DexType*> m_list;
+  size_t m_hash;
+  uint32_t m_size;
 
   // See UNIQUENESS above for the rationale for the private constructor pattern.
-  DexTypeList(std::deque<DexType*>&& p) {
-    m_list = std::move(p);
+  DexTypeList(size_t hash, uint32_t size) : m_hash(hash), m_size(size) {}
+
+  DexType** data() { return reinterpret_cast<DexType**>(this + 1); }
+  DexType* const* data() const {
+    return reinterpret_cast<DexType* const*>(this + 1);
   }
 
  public:
+  using value_type = DexType*;
+  using const_iterator = DexType* const*;
+  using iterator = const_iterator;
+
+  DexTypeList(const DexTypeList&) = delete;
+  DexTypeList& operator=(const DexTypeList&) = delete;
+
   // DexTypeList retrieval/creation
 
   // If the DexTypeList exists, return it, otherwise create it and return it.
@@ -448,12 +484,30 @@ class DexTypeList {
   }
 
  public:
-  const std::deque<DexType*>& get_type_list() const { return m_list; }
+  // The list used to be an std::deque; this is kept for the code that
+  // iterates over it. Use to_deque() to build a modified copy.
+  const DexTypeList& get_type_list() const { return *this; }
 
-  size_t size() const {
-    return get_type_list().size();
+  std::deque<DexType*> to_deque() const {
+    return std::deque<DexType*>(begin(), end());
   }
 
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + m_size; }
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+
+  DexType* operator[](size_t i) const { return data()[i]; }
+  DexType* at(size_t i) const {
+    always_assert(i < m_size);
+    return data()[i];
+  }
+  DexType* front() const { return at(0); }
+  DexType* back() const { return at(m_size - 1); }
+
+  size_t hash() const { return m_hash; }
+
   /**
    * Returns size of the encoded typelist in bytes, input
    * pointer must be aligned.
@@ -461,11 +515,11 @@ class DexTypeList {
   int encode(DexOutputIdx* dodx, uint32_t* output);
 
   friend bool operator<(const DexTypeList& a, const DexTypeList& b) {
-    auto ita = a.m_list.begin();
-    auto itb = b.m_list.begin();
+    auto ita = a.begin();
+    auto itb = b.begin();
     while (1) {
-      if (itb == b.m_list.end()) return false;
-      if (ita == a.m_list.end()) return true;
+      if (itb == b.end()) return false;
+      if (ita == a.end()) return true;
       if (*ita != *itb) {
         const DexType* ta = *ita;
         const DexType* tb = *itb;
@@ -814,6 +868,9 @@ class DexMethod : public DexMethodRef {
   std::unique_ptr<IRCode> m_code;
   DexAccessFlags m_access;
   bool m_virtual;
+  // Set by balloon_lazily(); m_dex_code is then ballooned on first access to
+  // m_code.
+  mutable std::atomic<bool> m_balloon_pending{false};
   ParamAnnotations m_param_anno;
   std::string m_deobfuscated_name;
 
@@ -919,8 +976,14 @@ class DexMethod : public DexMethodRef {
   DexAnnotationSet* get_anno_set() { return m_anno; }
   const DexCode* get_dex_code() const { return m_dex_code.get(); }
   DexCode* get_dex_code() { return m_dex_code.get(); }
-  IRCode* get_code() { return m_code.get(); }
-  const IRCode* get_code() const { return m_code.get(); }
+  IRCode* get_code() {
+    balloon_if_pending();
+    return m_code.get();
+  }
+  const IRCode* get_code() const {
+    balloon_if_pending();
+    return m_code.get();
+  }
   std::unique_ptr<IRCode> release_code();
   bool is_virtual() const { return m_virtual; }
   DexAccessFlags get_access() const {
@@ -938,7 +1001,9 @@ class DexMethod : public DexMethodRef {
 
   // Note: be careful to maintain 1:1 mapping between name (possibily
   // obfuscated) and deobfuscated name, when you mutate the method.
-  void set_deobfuscated_name(std::string name) { m_deobfuscated_name = name; }
+  void set_deobfuscated_name(std::string name) {
+    m_deobfuscated_name = std::move(name);
+  }
   const std::string& get_deobfuscated_name() const {
     return m_deobfuscated_name;
   }
@@ -1017,6 +1082,24 @@ class DexMethod : public DexMethodRef {
    */
   void balloon();
   void sync();
+  /*
+   * Defer balloon() until the IRCode is first requested. Until then the method
+   * only holds its DexCode. Ballooning on access is thread-safe.
+   */
+  void balloon_lazily();
+  // Whether balloon_lazily() was called and the IRCode wasn't requested yet.
+  bool is_balloon_pending() const {
+    return m_balloon_pending.load(std::memory_order_acquire);
+  }
+
+ private:
+  void balloon_if_pending() const {
+    if (m_balloon_pending.load(std::memory_order_acquire)) {
+      balloon_pending();
+    }
+  }
+  void balloon_pending() const;
+  void drop_pending_balloon();
 };
 
 using dexcode_to_offset = std::unordered_map<DexCode*, uint32_t>;
@@ -1135,17 +1218,9 @@ class DexClass {
     m_access_flags = access;
   }
 
-  void set_super_class(DexType* super_class) {
-    always_assert_log(
-        !m_external, "Unexpected external class %s\n", SHOW(m_self));
-    m_super_class = super_class;
-  }
+  void set_super_class(DexType* super_class);
 
-  void set_interfaces(DexTypeList* intfs) {
-    always_assert_log(!m_external,
-        "Unexpected external class %s\n", SHOW(m_self));
-    m_interfaces = intfs;
-  }
+  void set_interfaces(DexTypeList* intfs);
 
   void clear_annotations() {
     delete m_anno;
@@ -1252,7 +1327,7 @@ struct dexmethods_profiled_comparator {
  * no such DexClass exists.
  */
 inline DexClass* type_class(const DexType* t) {
-  return g_redex->type_class(t);
+  return t->m_class.load(std::memory_order_acquire);
 }
 
 /**
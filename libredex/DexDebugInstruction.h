@@ -57,6 +57,9 @@ class DexDebugInstruction : public Gatherable {
 
   int32_t value() const { return m_value; }
 
+  // Whether the value is encoded as an sleb128 rather than an uleb128.
+  bool is_signed() const { return m_signed; }
+
   void set_opcode(DexDebugItemOpcode op) { m_opcode = op; }
 
   void set_uvalue(uint32_t uv) { m_uvalue = uv; }
@@ -8,6 +8,7 @@
 #include "DexIdx.h"
 
 #include <sstream>
+#include <vector>
 
 #include "DexClass.h"
 
@@ -36,6 +37,28 @@ DexIdx::~DexIdx() {
   free(m_proto_cache);
 }
 
+void DexIdx::intern_strings_and_types() {
+  std::vector<const char*> strs(m_string_ids_size);
+  std::vector<uint32_t> utfsizes(m_string_ids_size);
+  for (uint32_t i = 0; i < m_string_ids_size; i++) {
+    uint32_t stroff = m_string_ids[i].offset;
+    always_assert_log(
+      stroff < ((dex_header*)m_dexbase)->file_size,
+      "String data offset out of range");
+    const uint8_t* dstr = m_dexbase + stroff;
+    utfsizes[i] = read_uleb128(&dstr);
+    strs[i] = (const char*)dstr;
+  }
+  g_redex->make_strings(
+      m_string_ids_size, strs.data(), utfsizes.data(), m_string_cache);
+
+  std::vector<DexString*> names(m_type_ids_size);
+  for (uint32_t i = 0; i < m_type_ids_size; i++) {
+    names[i] = get_stringidx(m_type_ids[i].string_idx);
+  }
+  g_redex->make_types(m_type_ids_size, names.data(), m_type_cache);
+}
+
 DexString* DexIdx::get_stringidx_fromdex(uint32_t stridx) {
   assert(stridx < m_string_ids_size);
   uint32_t stroff = m_string_ids[stridx].offset;
@@ -52,6 +52,12 @@ class DexIdx {
   explicit DexIdx(const dex_header* dh);
   ~DexIdx();
 
+  /*
+   * Intern every string and type of the dex up front, batched so that each
+   * RedexContext shard is locked once rather than once per id.
+   */
+  void intern_strings_and_types();
+
   DexString* get_stringidx(uint32_t stridx) {
     if (m_string_cache[stridx] == nullptr) {
       m_string_cache[stridx] = get_stringidx_fromdex(stridx);
@@ -11,6 +11,7 @@
 #include "DexDefs.h"
 #include "DexAccess.h"
 #include "IRCode.h"
+#include "Parallel.h"
 #include "Trace.h"
 #include "Walkers.h"
 #include "WorkQueue.h"
@@ -183,6 +184,7 @@ DexClasses DexLoader::load_dex(const char* location, dex_stats_t* stats) {
     return DexClasses(0);
   }
   m_idx = new DexIdx(dh);
+  m_idx->intern_strings_and_types();
   auto off = (uint64_t)dh->class_defs_off;
   auto limit = off + dh->class_defs_size * sizeof(dex_class_def);
   always_assert_log(off < m_file.size(), "class_defs_off out of range");
@@ -215,16 +217,26 @@ DexClasses DexLoader::load_dex(const char* location, dex_stats_t* stats) {
   return classes;
 }
 
+static bool s_lazy_ballooning = false;
+
+void set_lazy_ballooning(bool lazy) { s_lazy_ballooning = lazy; }
+
 static void mt_balloon(DexMethod* method) { method->balloon(); }
 
 static void balloon_all(const Scope& scope) {
-  auto wq = workqueue_foreach<DexMethod*>(mt_balloon);
+  std::vector<DexMethod*> methods;
   walk::methods(scope, [&](DexMethod* m) {
     if (m->get_dex_code()) {
-      wq.add_item(m);
+      methods.push_back(m);
     }
   });
-  wq.run_all();
+  if (s_lazy_ballooning) {
+    for (auto m : methods) {
+      m->balloon_lazily();
+    }
+    return;
+  }
+  parallel_for(methods.begin(), methods.end(), mt_balloon);
 }
 
 DexClasses load_classes_from_dex(const char* location, bool balloon) {
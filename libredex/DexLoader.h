@@ -15,4 +15,11 @@
 DexClasses load_classes_from_dex(const char* location, bool balloon = true);
 DexClasses load_classes_from_dex(const char* location, dex_stats_t* stats, bool balloon = true);
 
+/*
+ * With lazy ballooning, the `balloon` flag above only marks methods for
+ * ballooning, and each method keeps its DexCode until its IRCode is first
+ * requested. Off by default.
+ */
+void set_lazy_ballooning(bool lazy);
+
 void balloon_for_test(const Scope& scope);
@@ -8,40 +8,35 @@
 #include <algorithm>
 #include <assert.h>
 #include <exception>
-#include <fcntl.h>
 #include <fstream>
 #include <functional>
+#include <condition_variable>
+#include <cstring>
 #include <list>
 #include <memory>
+#include <mutex>
+#include <numeric>
 #include <stdlib.h>
-#include <sys/stat.h>
+#include <tuple>
+#include <unordered_map>
 #include <unordered_set>
 
-#ifdef _MSC_VER
-// TODO: Rewrite open/write/close with C/C++ standards. But it works for now.
-#include <io.h>
-#define open _open
-#define write _write
-#define close _close
-#define fstat _fstat64i32
-#define stat _stat64i32
-#define O_CREAT _O_CREAT
-#define O_TRUNC _O_TRUNC
-#define O_WRONLY _O_WRONLY
-#endif
-
+#include "Adler32.h"
 #include "Debug.h"
 #include "DexClass.h"
 #include "DexOutput.h"
+#include "DexSink.h"
 #include "DexUtil.h"
 #include "IODIMetadata.h"
 #include "IRCode.h"
+#include "Parallel.h"
 #include "Pass.h"
 #include "Resolver.h"
 #include "Sha1.h"
 #include "Trace.h"
 #include "Walkers.h"
 #include "WorkQueue.h"
+#include "ZipWriter.h"
 
 /*
  * For adler32...
@@ -81,6 +76,39 @@ class CustomSort {
     }
 };
 
+namespace {
+
+// Sorts `items` by `key`, which must be unique per item. Each key is computed
+// once, rather than on every comparison.
+template <class T, class Key>
+void sort_by_key(std::vector<T*>& items, const Key& key) {
+  using K = decltype(key(items.front()));
+  std::vector<std::pair<K, T*>> keyed;
+  keyed.reserve(items.size());
+  for (auto item : items) {
+    keyed.emplace_back(key(item), item);
+  }
+  std::sort(keyed.begin(), keyed.end(),
+            [](const std::pair<K, T*>& a, const std::pair<K, T*>& b) {
+              return a.first < b.first;
+            });
+  for (size_t i = 0; i < keyed.size(); ++i) {
+    items[i] = keyed[i].second;
+  }
+}
+
+} // namespace
+
+DexStringRanks::DexStringRanks(std::vector<DexString*> strings) {
+  sort_unique(strings);
+  std::sort(strings.begin(), strings.end(), compare_dexstrings);
+  m_ranks.reserve(strings.size());
+  uint32_t rank = 0;
+  for (auto s : strings) {
+    m_ranks.emplace(s, rank++);
+  }
+}
+
 GatheredTypes::GatheredTypes(DexClasses* classes)
   : m_classes(classes)
 {
@@ -104,6 +132,17 @@ std::unordered_set<DexString*> GatheredTypes::index_type_names() {
   return type_names;
 }
 
+std::vector<DexString*> GatheredTypes::get_dexstring_emitlist() {
+  if (m_string_ranks == nullptr) {
+    return get_dexstring_emitlist(compare_dexstrings);
+  }
+  std::vector<DexString*> strlist(m_lstring);
+  sort_by_key(strlist, [this](const DexString* s) {
+    return m_string_ranks->rank(s);
+  });
+  return strlist;
+}
+
 std::vector<DexString*> GatheredTypes::get_cls_order_dexstring_emitlist() {
   return get_dexstring_emitlist(CustomSort<DexString, cmp_dstring>(
         m_cls_load_strings,
@@ -150,9 +189,172 @@ void GatheredTypes::sort_dexmethod_emitlist_cls_order(
 
 void GatheredTypes::sort_dexmethod_emitlist_profiled_order(
     std::vector<DexMethod*>& lmeth) {
-  std::stable_sort(lmeth.begin(),
-                   lmeth.end(),
-                   dexmethods_profiled_comparator(&m_method_to_weight));
+  // Looking up a weight builds the deobfuscated name of the method, so we do
+  // it once per method (in parallel) rather than in every comparison, and sort
+  // the methods by their precomputed weights.
+  std::vector<size_t> indices(lmeth.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  std::vector<int> weights(lmeth.size());
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    weights[i] = get_method_weight_if_available(lmeth[i], &m_method_to_weight);
+  });
+  std::stable_sort(indices.begin(), indices.end(), [&](size_t a, size_t b) {
+    return weights[a] > weights[b];
+  });
+  std::vector<DexMethod*> sorted;
+  sorted.reserve(lmeth.size());
+  for (size_t i : indices) {
+    sorted.push_back(lmeth[i]);
+  }
+  lmeth = std::move(sorted);
+}
+
+const ProfiledMethods* GatheredTypes::get_profiled_methods() {
+  if (m_profiled_methods == nullptr && m_method_profiles != nullptr) {
+    m_profiled_methods = std::make_unique<ProfiledMethods>(
+        *m_method_profiles, get_dexmethod_emitlist());
+  }
+  return m_profiled_methods.get();
+}
+
+void GatheredTypes::sort_dexmethod_emitlist_profiles_order(
+    std::vector<DexMethod*>& lmeth) {
+  auto profiled_methods = get_profiled_methods();
+  if (profiled_methods != nullptr) {
+    profiled_methods->sort(lmeth);
+  }
+}
+
+std::vector<DexString*> GatheredTypes::get_ranked_dexstring_emitlist(
+    const std::unordered_map<const DexString*, unsigned int>& rank) {
+  auto strlist = get_dexstring_emitlist();
+  std::stable_sort(strlist.begin(), strlist.end(),
+                   [&](const DexString* a, const DexString* b) {
+                     auto ra = rank.find(a);
+                     auto rb = rank.find(b);
+                     if (rb == rank.end()) {
+                       return ra != rank.end();
+                     }
+                     return ra != rank.end() && ra->second < rb->second;
+                   });
+  return strlist;
+}
+
+std::vector<DexString*> GatheredTypes::get_profiles_order_dexstring_emitlist() {
+  auto profiled_methods = get_profiled_methods();
+  if (profiled_methods == nullptr) {
+    return get_dexstring_emitlist();
+  }
+  auto lmeth = get_dexmethod_emitlist();
+  profiled_methods->sort(lmeth);
+  std::unordered_map<const DexString*, unsigned int> rank;
+  for (DexMethod* meth : lmeth) {
+    // The sort puts the methods that appear in no profile last.
+    if (!profiled_methods->in_any_profile(meth)) {
+      break;
+    }
+    std::vector<DexString*> strings;
+    meth->gather_strings(strings);
+    for (DexString* str : strings) {
+      rank.emplace(str, rank.size());
+    }
+  }
+  return get_ranked_dexstring_emitlist(rank);
+}
+
+bool GatheredTypes::has_startup_data() {
+  return (m_startup_class_ranks != nullptr &&
+          !m_startup_class_ranks->empty()) ||
+         get_profiled_methods() != nullptr;
+}
+
+std::vector<DexClass*> GatheredTypes::get_startup_classes() {
+  std::vector<DexClass*> classes;
+  if (m_startup_class_ranks == nullptr) {
+    return classes;
+  }
+  for (DexClass* cls : *m_classes) {
+    if (m_startup_class_ranks->count(cls->get_type())) {
+      classes.push_back(cls);
+    }
+  }
+  std::stable_sort(classes.begin(), classes.end(),
+                   [&](const DexClass* a, const DexClass* b) {
+                     return m_startup_class_ranks->at(a->get_type()) <
+                            m_startup_class_ranks->at(b->get_type());
+                   });
+  return classes;
+}
+
+std::vector<DexMethod*> GatheredTypes::get_startup_methods() {
+  auto profiled_methods = get_profiled_methods();
+  auto class_rank = [&](const DexMethod* meth) {
+    if (m_startup_class_ranks == nullptr) {
+      return std::numeric_limits<uint32_t>::max();
+    }
+    auto it = m_startup_class_ranks->find(meth->get_class());
+    return it == m_startup_class_ranks->end()
+               ? std::numeric_limits<uint32_t>::max()
+               : it->second;
+  };
+  std::vector<DexMethod*> methods;
+  for (DexMethod* meth : get_dexmethod_emitlist()) {
+    bool startup_class =
+        class_rank(meth) != std::numeric_limits<uint32_t>::max();
+    bool profiled = profiled_methods != nullptr
+                        ? profiled_methods->in_any_profile(meth)
+                        : startup_class;
+    if (profiled || (startup_class && is_clinit(meth))) {
+      methods.push_back(meth);
+    }
+  }
+  if (profiled_methods != nullptr) {
+    profiled_methods->sort(methods);
+  } else {
+    std::stable_sort(methods.begin(), methods.end(),
+                     [&](const DexMethod* a, const DexMethod* b) {
+                       return class_rank(a) < class_rank(b);
+                     });
+  }
+  return methods;
+}
+
+void GatheredTypes::sort_dexmethod_emitlist_startup_order(
+    std::vector<DexMethod*>& lmeth) {
+  std::unordered_map<const DexMethod*, size_t> rank;
+  for (DexMethod* meth : get_startup_methods()) {
+    rank.emplace(meth, rank.size());
+  }
+  std::stable_sort(lmeth.begin(), lmeth.end(),
+                   [&](const DexMethod* a, const DexMethod* b) {
+                     auto ra = rank.find(a);
+                     auto rb = rank.find(b);
+                     if (rb == rank.end()) {
+                       return ra != rank.end();
+                     }
+                     return ra != rank.end() && ra->second < rb->second;
+                   });
+}
+
+std::vector<DexString*> GatheredTypes::get_startup_order_dexstring_emitlist() {
+  std::unordered_map<const DexString*, unsigned int> rank;
+  // Loading a class resolves the types it refers to, so their names come
+  // first, as in build_cls_load_map().
+  for (DexClass* cls : get_startup_classes()) {
+    std::vector<DexType*> types;
+    cls->gather_types(types);
+    for (DexType* type : types) {
+      rank.emplace(type->get_name(), rank.size());
+    }
+  }
+  for (DexMethod* meth : get_startup_methods()) {
+    std::vector<DexString*> strings;
+    meth->gather_strings(strings);
+    for (DexString* str : strings) {
+      rank.emplace(str, rank.size());
+    }
+  }
+  return get_ranked_dexstring_emitlist(rank);
 }
 
 void GatheredTypes::sort_dexmethod_emitlist_clinit_order(
@@ -182,12 +384,18 @@ DexOutputIdx* GatheredTypes::get_dodx(const uint8_t* base) {
   dextype_to_idx* type = get_type_index();
   dexproto_to_idx* proto = get_proto_index();
   dexfield_to_idx* field = get_field_index();
-  dexmethod_to_idx* method = get_method_index();
+  dexmethod_to_idx* method = get_method_index(compare_dexmethods, proto);
   return new DexOutputIdx(string, type, proto, field, method, base);
 }
 
 dexstring_to_idx* GatheredTypes::get_string_index(cmp_dstring cmp) {
-  std::sort(m_lstring.begin(), m_lstring.end(), cmp);
+  if (m_string_ranks != nullptr && cmp == compare_dexstrings) {
+    sort_by_key(m_lstring, [this](const DexString* s) {
+      return m_string_ranks->rank(s);
+    });
+  } else {
+    std::sort(m_lstring.begin(), m_lstring.end(), cmp);
+  }
   dexstring_to_idx* sidx = new dexstring_to_idx();
   uint32_t idx = 0;
   for (auto it = m_lstring.begin(); it != m_lstring.end(); it++) {
@@ -197,7 +405,13 @@ dexstring_to_idx* GatheredTypes::get_string_index(cmp_dstring cmp) {
 }
 
 dextype_to_idx* GatheredTypes::get_type_index(cmp_dtype cmp) {
-  std::sort(m_ltype.begin(), m_ltype.end(), cmp);
+  if (m_string_ranks != nullptr && cmp == compare_dextypes) {
+    sort_by_key(m_ltype, [this](const DexType* t) {
+      return m_string_ranks->rank(t->get_name());
+    });
+  } else {
+    std::sort(m_ltype.begin(), m_ltype.end(), cmp);
+  }
   dextype_to_idx* sidx = new dextype_to_idx();
   uint32_t idx = 0;
   for (auto it = m_ltype.begin(); it != m_ltype.end(); it++) {
@@ -207,7 +421,15 @@ dextype_to_idx* GatheredTypes::get_type_index(cmp_dtype cmp) {
 }
 
 dexfield_to_idx* GatheredTypes::get_field_index(cmp_dfield cmp) {
-  std::sort(m_lfield.begin(), m_lfield.end(), cmp);
+  if (m_string_ranks != nullptr && cmp == compare_dexfields) {
+    sort_by_key(m_lfield, [this](const DexFieldRef* f) {
+      return std::make_tuple(m_string_ranks->rank(f->get_class()->get_name()),
+                             m_string_ranks->rank(f->get_name()),
+                             m_string_ranks->rank(f->get_type()->get_name()));
+    });
+  } else {
+    std::sort(m_lfield.begin(), m_lfield.end(), cmp);
+  }
   dexfield_to_idx* sidx = new dexfield_to_idx();
   uint32_t idx = 0;
   for (auto it = m_lfield.begin(); it != m_lfield.end(); it++) {
@@ -216,8 +438,19 @@ dexfield_to_idx* GatheredTypes::get_field_index(cmp_dfield cmp) {
   return sidx;
 }
 
-dexmethod_to_idx* GatheredTypes::get_method_index(cmp_dmethod cmp) {
-  std::sort(m_lmethod.begin(), m_lmethod.end(), cmp);
+dexmethod_to_idx* GatheredTypes::get_method_index(
+    cmp_dmethod cmp, const dexproto_to_idx* protos) {
+  if (m_string_ranks != nullptr && protos != nullptr &&
+      cmp == compare_dexmethods) {
+    // The proto ids are in compare_dexprotos order already.
+    sort_by_key(m_lmethod, [&](const DexMethodRef* m) {
+      return std::make_tuple(m_string_ranks->rank(m->get_class()->get_name()),
+                             m_string_ranks->rank(m->get_name()),
+                             protos->at(m->get_proto()));
+    });
+  } else {
+    std::sort(m_lmethod.begin(), m_lmethod.end(), cmp);
+  }
   dexmethod_to_idx* sidx = new dexmethod_to_idx();
   uint32_t idx = 0;
   for (auto it = m_lmethod.begin(); it != m_lmethod.end(); it++) {
@@ -233,7 +466,21 @@ dexproto_to_idx* GatheredTypes::get_proto_index(cmp_dproto cmp) {
   }
   std::sort(protos.begin(), protos.end());
   protos.erase(std::unique(protos.begin(), protos.end()), protos.end());
-  std::sort(protos.begin(), protos.end(), cmp);
+  if (m_string_ranks != nullptr && cmp == compare_dexprotos) {
+    // Return type first, then the arguments lexicographically, with a prefix
+    // ordered before the longer lists it starts.
+    sort_by_key(protos, [this](const DexProto* p) {
+      std::vector<uint32_t> key;
+      key.reserve(p->get_args()->size() + 1);
+      key.push_back(m_string_ranks->rank(p->get_rtype()->get_name()));
+      for (auto arg : p->get_args()->get_type_list()) {
+        key.push_back(m_string_ranks->rank(arg->get_name()));
+      }
+      return key;
+    });
+  } else {
+    std::sort(protos.begin(), protos.end(), cmp);
+  }
   dexproto_to_idx* sidx = new dexproto_to_idx();
   uint32_t idx = 0;
   for (auto const& proto : protos) {
@@ -360,10 +607,15 @@ void GatheredTypes::gather_components() {
 }
 
 constexpr uint32_t k_max_dex_size = 16 * 1024 * 1024;
-typedef std::map<DexAnnotation*, uint32_t> annomap_t;
-typedef std::map<DexAnnotationSet*, uint32_t> asetmap_t;
-typedef std::map<ParamAnnotations*, uint32_t> xrefmap_t;
-typedef std::map<DexAnnotationDirectory*, uint32_t> adirmap_t;
+typedef std::unordered_map<DexAnnotation*, uint32_t> annomap_t;
+typedef std::unordered_map<DexAnnotationSet*, uint32_t> asetmap_t;
+typedef std::unordered_map<ParamAnnotations*, uint32_t> xrefmap_t;
+typedef std::unordered_map<DexAnnotationDirectory*, uint32_t> adirmap_t;
+// The offset at which each distinct encoding was emitted, to share the
+// storage of identical items.
+template <typename T>
+using encoding_offsets_t =
+    std::unordered_map<std::vector<T>, uint32_t, boost::hash<std::vector<T>>>;
 
 enum class DebugInfoKind {
   Normal = 0,
@@ -376,10 +628,13 @@ enum class DebugInfoKind {
 struct CodeItemEmit {
   DexMethod* method;
   DexCode* code;
-  dex_code_item* code_item;
+  uint32_t offset;
+  // The code item is streamed out before its debug item is laid out, so its
+  // debug_info_off is written over it at the end.
+  uint32_t debug_info_off{0};
 
-  CodeItemEmit(DexMethod* meth, DexCode* c, dex_code_item* ci)
-      : method(meth), code(c), code_item(ci) {}
+  CodeItemEmit(DexMethod* meth, DexCode* c, uint32_t off)
+      : method(meth), code(c), offset(off) {}
 };
 
 class DexOutput {
@@ -389,9 +644,20 @@ public:
   DexClasses* m_classes;
   DexOutputIdx* dodx;
   GatheredTypes* m_gtypes;
+  // The header, the ids and the class defs, which are filled in as the data
+  // is laid out, and written out last.
+  std::vector<uint8_t> m_front;
+  // The data laid out since it was last streamed out to m_sink, which starts
+  // at m_output_start. m_offset is where the next byte goes.
   uint8_t* m_output;
+  uint32_t m_output_start{0};
   uint32_t m_offset;
+  std::unique_ptr<DexSink> m_sink;
   const char* m_filename;
+  ZipWriter* m_zip{nullptr};
+  bool m_lower{false};
+  bool m_lower_with_cfg{false};
+  instruction_lowering::Stats m_lowering_stats;
   size_t m_store_number;
   size_t m_dex_number;
   DebugInfoKind m_debug_info_kind;
@@ -401,6 +667,17 @@ public:
   std::string m_class_mapping_filename;
   std::string m_pg_mapping_filename;
   std::string m_bytecode_offset_filename;
+  std::string m_method_profiles_report_filename;
+  // For each method profile: the number of profiled methods in the dex, and
+  // the pages touched by their code items and by the strings they reference.
+  struct ProfilePages {
+    size_t methods{0};
+    std::unordered_set<uint32_t> code_pages;
+    std::unordered_set<uint32_t> string_pages;
+  };
+  std::vector<ProfilePages> m_profile_pages;
+  // Whether the class data of the startup classes is laid out first.
+  bool m_startup_class_data{false};
   std::unordered_map<DexTypeList*, uint32_t> m_tl_emit_offsets;
   std::vector<CodeItemEmit> m_code_item_emits;
   std::unordered_map<DexMethod*, uint64_t>* m_method_to_id;
@@ -428,6 +705,8 @@ public:
   // clinit methods come before all other methods, and remaining methods are sorted
   // by class.
   void generate_code_items(const std::vector<SortMode>& modes);
+  void count_profile_pages();
+  void count_startup_pages();
   void generate_static_values();
   void unique_annotations(annomap_t& annomap,
                           std::vector<DexAnnotation*>& annolist);
@@ -448,10 +727,17 @@ public:
   void finalize_header();
   void init_header_offsets();
   void write_symbol_files();
+  void write_method_profiles_report();
   void align_output() { m_offset = (m_offset + 3) & ~3; }
+  // Where the byte at `offset` goes, in the front or in the data that hasn't
+  // been streamed out yet.
+  uint8_t* output_at(uint32_t offset);
+  // Streams out the data laid out so far, and reuses the buffer.
+  void flush_output();
+  void open_sink();
   void emit_locator(Locator locator);
   void emit_name_based_locators();
-  std::unique_ptr<Locator> locator_for_descriptor(
+  const Locator* locator_for_descriptor(
       const std::unordered_set<DexString*>& type_names, DexString* descriptor);
 
  public:
@@ -471,12 +757,45 @@ public:
             const std::string& method_mapping_path,
             const std::string& class_mapping_path,
             const std::string& pg_mapping_path,
-            const std::string& bytecode_offset_path);
+            const std::string& bytecode_offset_path,
+            const std::string& method_profiles_report_path,
+            // Gathered from `classes` if null. Owned by the DexOutput.
+            GatheredTypes* gtypes = nullptr);
   ~DexOutput();
   void prepare(SortMode string_mode,
                const std::vector<SortMode>& code_mode,
                const ConfigFiles& cfg);
   void write();
+
+  // prepare() and write() are made of the steps below. The steps that use
+  // state shared with other dexes -- the position mapper, the IODI metadata
+  // and the symbol files -- are kept apart from the others, so that several
+  // dexes can be emitted in parallel while these run in dex order.
+  void prepare_sections(SortMode string_mode,
+                        const std::vector<SortMode>& code_mode,
+                        const ConfigFiles& cfg);
+  void prepare_debug_items() { generate_debug_items(); }
+  void finish_sections();
+  void write_dex();
+  void write_symbols() { write_symbol_files(); }
+
+  // Makes write_dex() add the dex to the zip, under the base name of its
+  // file, rather than write the file.
+  void set_zip(ZipWriter* zip) { m_zip = zip; }
+
+  // Makes generate_code_items() lower the IR of the dex's methods as it syncs
+  // them, instead of expecting instruction_lowering::run to have lowered it.
+  void set_lower(bool lower_with_cfg) {
+    m_lower = true;
+    m_lower_with_cfg = lower_with_cfg;
+  }
+  void set_startup_class_ranks(
+      const std::unordered_map<const DexType*, uint32_t>* ranks) {
+    m_gtypes->set_startup_class_ranks(ranks);
+  }
+  const instruction_lowering::Stats& get_lowering_stats() const {
+    return m_lowering_stats;
+  }
 };
 
 DexOutput::DexOutput(
@@ -495,14 +814,20 @@ DexOutput::DexOutput(
     const std::string& method_mapping_filename,
     const std::string& class_mapping_filename,
     const std::string& pg_mapping_filename,
-    const std::string& bytecode_offset_filename)
+    const std::string& bytecode_offset_filename,
+    const std::string& method_profiles_report_filename,
+    GatheredTypes* gtypes)
     : m_config_files(config_files) {
   m_classes = classes;
   m_iodi_metadata = iodi_metadata;
-  m_output = (uint8_t*)malloc(k_max_dex_size);
-  memset(m_output, 0, k_max_dex_size);
+  // The encoders rely on the buffer being zeroed. calloc lets the allocator
+  // hand out pages the kernel has already zeroed instead of touching all of
+  // k_max_dex_size up front. Since each section is streamed out once it's
+  // laid out, only the pages of the largest section become resident.
+  m_output = (uint8_t*)calloc(k_max_dex_size, 1);
+  always_assert_log(m_output != nullptr, "Can't allocate the dex buffer\n");
   m_offset = 0;
-  m_gtypes = new GatheredTypes(classes);
+  m_gtypes = gtypes != nullptr ? gtypes : new GatheredTypes(classes);
   dodx = m_gtypes->get_dodx(m_output);
   m_filename = path;
   m_pos_mapper = pos_mapper;
@@ -512,6 +837,7 @@ DexOutput::DexOutput(
   m_class_mapping_filename = class_mapping_filename;
   m_pg_mapping_filename = pg_mapping_filename;
   m_bytecode_offset_filename = bytecode_offset_filename;
+  m_method_profiles_report_filename = method_profiles_report_filename;
   m_store_number = store_number;
   m_dex_number = dex_number;
   m_locator_index = locator_index;
@@ -536,16 +862,46 @@ void DexOutput::insert_map_item(uint16_t maptype,
   m_map_items.emplace_back(item);
 }
 
+uint8_t* DexOutput::output_at(uint32_t offset) {
+  if (offset < hdr.data_off) {
+    return m_front.data() + offset;
+  }
+  always_assert_log(offset >= m_output_start &&
+                        offset - m_output_start < k_max_dex_size,
+                    "Offset %u is out of the section being laid out\n",
+                    offset);
+  return m_output + (offset - m_output_start);
+}
+
+void DexOutput::flush_output() {
+  size_t size = m_offset - m_output_start;
+  m_sink->write(m_output_start, m_output, size);
+  memset(m_output, 0, size);
+  m_output_start = m_offset;
+}
+
+void DexOutput::open_sink() {
+  if (m_zip != nullptr) {
+    const char* basename = strrchr(m_filename, '/');
+    m_sink = std::make_unique<ZipEntryDexSink>(
+        m_zip, basename == nullptr ? m_filename : basename + 1);
+  } else {
+    m_sink = std::make_unique<FileDexSink>(m_filename);
+  }
+}
+
 void DexOutput::emit_locator(Locator locator) {
-  char buf[Locator::encoded_max];
-  size_t locator_length = locator.encode(buf);
-  write_uleb128(m_output + m_offset, (uint32_t) locator_length);
-  m_offset += uleb128_encoding_size((uint32_t) locator_length);
-  memcpy(m_output + m_offset, buf, locator_length + 1);
-  m_offset += locator_length + 1;
+  // Locators are short enough for their length to take a single uleb128
+  // byte, so they are encoded in place right after it.
+  static_assert(Locator::encoded_max < 0x80, "Locator length is one byte");
+  auto output = output_at(m_offset);
+  size_t locator_length = locator.encode((char*)(output + 1));
+  output[0] = (uint8_t)locator_length;
+  m_offset += 1 + locator_length + 1;
 }
 
-std::unique_ptr<Locator>
+// The returned locator is owned by the index, or is the system locator.
+const Locator*
 DexOutput::locator_for_descriptor(
   const std::unordered_set<DexString*>& type_names,
   DexString* descriptor)
@@ -556,7 +912,7 @@ DexOutput::locator_for_descriptor(
     if (locator_it != locator_index->end()) {
       // This string is the name of a type we define in one of our
       // dex files.
-      return std::unique_ptr<Locator>(new Locator(locator_it->second));
+      return &locator_it->second;
     }
 
     if (type_names.count(descriptor)) {
@@ -569,7 +925,7 @@ DexOutput::locator_for_descriptor(
         if (elementDescriptor != nullptr) {
           locator_it = locator_index->find(elementDescriptor);
           if (locator_it != locator_index->end()) {
-            return std::unique_ptr<Locator>(new Locator(locator_it->second));
+            return &locator_it->second;
           }
         }
       }
@@ -577,7 +933,8 @@ DexOutput::locator_for_descriptor(
       // We have the name of a type, but it's not a type we define.
       // Emit the special locator that indicates we should look in the
       // system classloader.
-      return std::unique_ptr<Locator>(new Locator(Locator::make(0, 0, 0)));
+      static const Locator system_locator = Locator::make(0, 0, 0);
+      return &system_locator;
     }
   }
 
@@ -600,21 +957,33 @@ void DexOutput::generate_string_data(SortMode mode) {
   } else if (mode == SortMode::CLASS_STRINGS) {
     TRACE(CUSTOMSORT, 2, "using class names pack for string pool sorting\n");
     string_order = m_gtypes->keep_cls_strings_together_emitlist();
+  } else if (mode == SortMode::METHOD_PROFILES_ORDER) {
+    TRACE(CUSTOMSORT, 2, "using method profiles for string pool sorting\n");
+    string_order = m_gtypes->get_profiles_order_dexstring_emitlist();
+  } else if (mode == SortMode::STARTUP_ORDER) {
+    TRACE(CUSTOMSORT, 2, "using startup order for string pool sorting\n");
+    string_order = m_gtypes->get_startup_order_dexstring_emitlist();
   } else {
     TRACE(CUSTOMSORT, 2, "using default string pool sorting\n");
     string_order = m_gtypes->get_dexstring_emitlist();
   }
-  dex_string_id* stringids = (dex_string_id*)(m_output + hdr.string_ids_off);
+  dex_string_id* stringids = (dex_string_id*)output_at(hdr.string_ids_off);
 
   std::unordered_set<DexString*> type_names = m_gtypes->index_type_names();
   unsigned locator_size = 0;
 
   // If we're generating locator strings, we need to include them in
-  // the total count of strings in this section.
+  // the total count of strings in this section. They are looked up once,
+  // for both the count and the emission.
+  std::vector<const Locator*> string_locators;
   size_t locators = 0;
-  for (DexString* str : string_order) {
-    if (locator_for_descriptor(type_names, str)) {
-      ++locators;
+  if (m_locator_index != nullptr) {
+    string_locators.reserve(string_order.size());
+    for (DexString* str : string_order) {
+      string_locators.push_back(locator_for_descriptor(type_names, str));
+      if (string_locators.back() != nullptr) {
+        ++locators;
+      }
     }
   }
 
@@ -626,9 +995,11 @@ void DexOutput::generate_string_data(SortMode mode) {
   size_t nrstr = string_order.size() + locators;
 
   insert_map_item(TYPE_STRING_DATA_ITEM, (uint32_t)nrstr, m_offset);
-  for (DexString* str : string_order) {
+  for (size_t i = 0; i < string_order.size(); i++) {
+    DexString* str = string_order[i];
     // Emit lookup acceleration string if requested
-    std::unique_ptr<Locator> locator = locator_for_descriptor(type_names, str);
+    const Locator* locator =
+        string_locators.empty() ? nullptr : string_locators[i];
     if (locator) {
       unsigned orig_offset = m_offset;
       emit_locator(*locator);
@@ -648,7 +1019,7 @@ void DexOutput::generate_string_data(SortMode mode) {
     // Emit the string itself
     TRACE(CUSTOMSORT, 3, "str emit %s\n", SHOW(str));
     stringids[idx].offset = m_offset;
-    str->encode(m_output + m_offset);
+    str->encode(output_at(m_offset));
     m_offset += str->get_entry_size();
     m_stats.num_strings++;
   }
@@ -665,7 +1036,7 @@ void DexOutput::emit_name_based_locators() {
 
   // We decode all class names --- to find the first and last renamed one,
   // and also check that all renamed names are indeed in the right place.
-  dex_class_def* cdefs = (dex_class_def*)(m_output + hdr.class_defs_off);
+  dex_class_def* cdefs = (dex_class_def*)output_at(hdr.class_defs_off);
   for (uint32_t i = 0; i < hdr.class_defs_size; i++) {
     DexClass* clz = m_classes->at(i);
     const char* str = clz->get_name()->c_str();
@@ -729,7 +1100,7 @@ void DexOutput::generate_type_data() {
       dodx->type_to_idx().size(),
       kMaxTypeRefs);
 
-  dex_type_id* typeids = (dex_type_id*)(m_output + hdr.type_ids_off);
+  dex_type_id* typeids = (dex_type_id*)output_at(hdr.type_ids_off);
   for (auto& p : dodx->type_to_idx()) {
     auto t = p.first;
     auto idx = p.second;
@@ -760,7 +1131,7 @@ void DexOutput::generate_typelist_data() {
     ++num_tls;
     align_output();
     m_tl_emit_offsets[tl] = m_offset;
-    int size = tl->encode(dodx, (uint32_t*)(m_output + m_offset));
+    int size = tl->encode(dodx, (uint32_t*)output_at(m_offset));
     m_offset += size;
     m_stats.num_type_lists++;
   }
@@ -768,7 +1139,7 @@ void DexOutput::generate_typelist_data() {
 }
 
 void DexOutput::generate_proto_data() {
-  auto protoids = (dex_proto_id*)(m_output + hdr.proto_ids_off);
+  auto protoids = (dex_proto_id*)output_at(hdr.proto_ids_off);
 
   for (auto& it : dodx->proto_to_idx()) {
     auto proto = it.first;
@@ -781,7 +1152,7 @@ void DexOutput::generate_proto_data() {
 }
 
 void DexOutput::generate_field_data() {
-  auto fieldids = (dex_field_id*)(m_output + hdr.field_ids_off);
+  auto fieldids = (dex_field_id*)output_at(hdr.field_ids_off);
   for (auto& it : dodx->field_to_idx()) {
     auto field = it.first;
     auto idx = it.second;
@@ -808,7 +1179,7 @@ void DexOutput::generate_method_data() {
       m_dex_number,
       dodx->field_to_idx().size(),
       kMaxFieldRefs);
-  auto methodids = (dex_method_id*)(m_output + hdr.method_ids_off);
+  auto methodids = (dex_method_id*)output_at(hdr.method_ids_off);
   for (auto& it : dodx->method_to_idx()) {
     auto method = it.first;
     auto idx = it.second;
@@ -820,7 +1191,7 @@ void DexOutput::generate_method_data() {
 }
 
 void DexOutput::generate_class_data() {
-  dex_class_def* cdefs = (dex_class_def*)(m_output + hdr.class_defs_off);
+  dex_class_def* cdefs = (dex_class_def*)output_at(hdr.class_defs_off);
   for (uint32_t i = 0; i < hdr.class_defs_size; i++) {
     m_stats.num_classes++;
     DexClass* clz = m_classes->at(i);
@@ -868,14 +1239,26 @@ void DexOutput::generate_class_data_items() {
   dexcode_to_offset dco;
   uint32_t cdi_start = m_offset;
   for (auto& it : m_code_item_emits) {
-    uint32_t offset = (uint32_t)(((uint8_t*)it.code_item) - m_output);
-    dco[it.code] = offset;
+    dco[it.code] = it.offset;
+  }
+  // The class data items are referred to by offset, so they can be laid out
+  // in any order.
+  std::vector<DexClass*> classes;
+  if (m_startup_class_data) {
+    classes = m_gtypes->get_startup_classes();
   }
+  std::unordered_set<DexClass*> startup_classes(classes.begin(),
+                                                classes.end());
   for (uint32_t i = 0; i < hdr.class_defs_size; i++) {
     DexClass* clz = m_classes->at(i);
+    if (!startup_classes.count(clz)) {
+      classes.push_back(clz);
+    }
+  }
+  for (DexClass* clz : classes) {
     if (!clz->has_class_data()) continue;
     /* No alignment constraints for this data */
-    int size = clz->encode(dodx, dco, m_output + m_offset);
+    int size = clz->encode(dodx, dco, output_at(m_offset));
     m_cdi_offsets[clz] = m_offset;
     m_offset += size;
   }
@@ -884,7 +1267,7 @@ void DexOutput::generate_class_data_items() {
 
 static void sync_all(const Scope& scope) {
   constexpr bool serial = false; // for debugging
-  auto wq = workqueue_foreach<DexMethod*>([](DexMethod* m){m->sync();});
+  std::vector<DexMethod*> methods;
   walk::code(scope,
             [](DexMethod*) { return true; },
             [&](DexMethod* m, IRCode&) {
@@ -892,10 +1275,48 @@ static void sync_all(const Scope& scope) {
                 TRACE(MTRANS, 2, "Syncing %s\n", SHOW(m));
                 m->sync();
               } else {
-                wq.add_item(m);
+                methods.push_back(m);
               }
             });
-  wq.run_all();
+  parallel_for(methods.begin(), methods.end(), [](DexMethod* m) { m->sync(); });
+}
+
+// Same as sync_all, but each method is lowered right before it is synced,
+// while its IR is still in cache.
+static instruction_lowering::Stats lower_and_sync_all(const Scope& scope,
+                                                      bool lower_with_cfg) {
+  std::vector<DexMethod*> methods;
+  walk::code(scope,
+             [](DexMethod*) { return true; },
+             [&](DexMethod* m, IRCode&) { methods.push_back(m); });
+  return parallel_reduce(
+      methods.begin(), methods.end(), instruction_lowering::Stats(),
+      [lower_with_cfg](DexMethod* m) {
+        auto stats = instruction_lowering::lower(m, lower_with_cfg);
+        m->sync();
+        return stats;
+      },
+      [](instruction_lowering::Stats a, const instruction_lowering::Stats& b) {
+        a.accumulate(b);
+        return a;
+      });
+}
+
+// An upper bound on the number of bytes DexCode::encode() writes.
+static size_t code_item_size_bound(const DexCode* code) {
+  size_t insns_size = 0;
+  for (auto const& opc : code->get_instructions()) {
+    insns_size += opc->size();
+  }
+  // Header, instructions and the padding before the tries.
+  size_t size = sizeof(dex_code_item) + (insns_size + 1) * sizeof(uint16_t);
+  // Tries, the handler list size, and per try a handler count and up to
+  // two uleb128s per catch.
+  size += 5;
+  for (auto const& dextry : code->get_tries()) {
+    size += sizeof(dex_tries_item) + 5 + dextry->m_catches.size() * 10;
+  }
+  return size;
 }
 
 void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
@@ -906,7 +1327,11 @@ void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
    */
   align_output();
   uint32_t ci_start = m_offset;
-  sync_all(*m_classes);
+  if (m_lower) {
+    m_lowering_stats = lower_and_sync_all(*m_classes, m_lower_with_cfg);
+  } else {
+    sync_all(*m_classes);
+  }
 
   // Get all methods.
   std::vector<DexMethod*> lmeth = m_gtypes->get_dexmethod_emitlist();
@@ -924,6 +1349,15 @@ void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
               "using method profiled order for bytecode sorting\n");
         m_gtypes->sort_dexmethod_emitlist_profiled_order(lmeth);
         break;
+      case SortMode::METHOD_PROFILES_ORDER:
+        TRACE(CUSTOMSORT, 2,
+              "using method profiles order for bytecode sorting\n");
+        m_gtypes->sort_dexmethod_emitlist_profiles_order(lmeth);
+        break;
+      case SortMode::STARTUP_ORDER:
+        TRACE(CUSTOMSORT, 2, "using startup order for bytecode sorting\n");
+        m_gtypes->sort_dexmethod_emitlist_startup_order(lmeth);
+        break;
       case SortMode::CLINIT_FIRST:
         TRACE(CUSTOMSORT, 2,
               "sorting <clinit> sections before all other bytecode");
@@ -940,25 +1374,157 @@ void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
         break;
       }
   }
+  std::vector<DexMethod*> emit_methods;
   for (DexMethod* meth : lmeth) {
     if (meth->get_access() & (ACC_ABSTRACT | ACC_NATIVE)) {
       // There is no code item for ABSTRACT or NATIVE methods.
       continue;
     }
-    TRACE(CUSTOMSORT, 3, "method emit %s %s\n", SHOW(meth->get_class()), SHOW(meth));
-    DexCode* code = meth->get_dex_code();
     always_assert_log(
-        meth->is_concrete() && code != nullptr,
+        meth->is_concrete() && meth->get_dex_code() != nullptr,
         "Undefined method in generate_code_items()\n\t prototype: %s\n", SHOW(meth));
+    emit_methods.push_back(meth);
+  }
+  // Code items don't refer to their own offset, so they are encoded into
+  // separate buffers in parallel, and then laid out in emit order. The buffers
+  // start zeroed like the output, so that the result is the same as encoding
+  // in place.
+  std::vector<std::vector<uint32_t>> encoded(emit_methods.size());
+  std::vector<size_t> sizes(emit_methods.size());
+  std::vector<size_t> indices(emit_methods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    DexCode* code = emit_methods[i]->get_dex_code();
+    auto& buffer = encoded[i];
+    buffer.resize(code_item_size_bound(code) / sizeof(uint32_t) + 1);
+    sizes[i] = code->encode(dodx, buffer.data());
+    always_assert(sizes[i] <= buffer.size() * sizeof(uint32_t));
+  });
+  for (size_t i = 0; i < emit_methods.size(); ++i) {
+    DexMethod* meth = emit_methods[i];
+    TRACE(CUSTOMSORT, 3, "method emit %s %s\n", SHOW(meth->get_class()), SHOW(meth));
+    DexCode* code = meth->get_dex_code();
     align_output();
-    int size = code->encode(dodx, (uint32_t*)(m_output + m_offset));
+    auto size = sizes[i];
+    memcpy(output_at(m_offset), encoded[i].data(), size);
+    std::vector<uint32_t>().swap(encoded[i]);
     m_method_bytecode_offsets.emplace_back(meth->get_name()->c_str(), m_offset);
-    m_code_item_emits.emplace_back(meth, code,
-                                   (dex_code_item*)(m_output + m_offset));
+    m_code_item_emits.emplace_back(meth, code, m_offset);
     m_offset += size;
     m_stats.num_instructions += code->get_instructions().size();
   }
   insert_map_item(TYPE_CODE_ITEM, (uint32_t) m_code_item_emits.size(), ci_start);
+  if (!m_method_profiles_report_filename.empty()) {
+    count_profile_pages();
+  }
+}
+
+/*
+ * Simulates the page faults of startup: counts the 4KB pages that hold the
+ * string data, class data and code items used at startup, as defined by
+ * GatheredTypes::get_startup_classes() and get_startup_methods().
+ */
+void DexOutput::count_startup_pages() {
+  constexpr uint32_t k_page_size = 4096;
+  std::unordered_set<uint32_t> pages;
+  auto add_pages = [&](uint32_t offset, uint32_t size) {
+    for (uint32_t page = offset / k_page_size;
+         page <= (offset + std::max<uint32_t>(size, 1) - 1) / k_page_size;
+         ++page) {
+      pages.insert(page);
+    }
+  };
+  auto stringids = (const dex_string_id*)output_at(hdr.string_ids_off);
+  auto add_string = [&](DexString* str) {
+    add_pages(stringids[dodx->stringidx(str)].offset, str->get_entry_size());
+  };
+  // The class data items and code items are contiguous, so an item ends where
+  // the next one starts.
+  std::vector<uint32_t> cdi_offsets;
+  for (const auto& it : m_cdi_offsets) {
+    cdi_offsets.push_back(it.second);
+  }
+  std::sort(cdi_offsets.begin(), cdi_offsets.end());
+  for (DexClass* cls : m_gtypes->get_startup_classes()) {
+    add_string(cls->get_type()->get_name());
+    auto it = m_cdi_offsets.find(cls);
+    if (it != m_cdi_offsets.end()) {
+      auto next = std::upper_bound(cdi_offsets.begin(), cdi_offsets.end(),
+                                   it->second);
+      uint32_t end = next == cdi_offsets.end() ? it->second + 1 : *next;
+      add_pages(it->second, end - it->second);
+    }
+  }
+  std::unordered_map<const DexMethod*, size_t> emit_index;
+  for (size_t i = 0; i < m_code_item_emits.size(); ++i) {
+    emit_index.emplace(m_code_item_emits[i].method, i);
+  }
+  for (DexMethod* meth : m_gtypes->get_startup_methods()) {
+    auto it = emit_index.find(meth);
+    if (it == emit_index.end()) {
+      continue;
+    }
+    size_t i = it->second;
+    const auto& emit = m_code_item_emits[i];
+    uint32_t offset = emit.offset;
+    uint32_t end = i + 1 < m_code_item_emits.size()
+                       ? m_code_item_emits[i + 1].offset
+                       : offset + 1;
+    add_pages(offset, end - offset);
+    std::vector<DexString*> strings;
+    for (const auto* insn : emit.code->get_instructions()) {
+      insn->gather_strings(strings);
+    }
+    for (DexString* str : strings) {
+      add_string(str);
+    }
+  }
+  m_stats.num_startup_pages = pages.size();
+}
+
+void DexOutput::count_profile_pages() {
+  constexpr uint32_t k_page_size = 4096;
+  auto profiled_methods = m_gtypes->get_profiled_methods();
+  if (profiled_methods == nullptr) {
+    return;
+  }
+  auto add_pages = [](uint32_t offset, uint32_t size,
+                      std::unordered_set<uint32_t>* pages) {
+    for (uint32_t page = offset / k_page_size;
+         page <= (offset + std::max<uint32_t>(size, 1) - 1) / k_page_size;
+         ++page) {
+      pages->insert(page);
+    }
+  };
+  auto stringids = (const dex_string_id*)output_at(hdr.string_ids_off);
+  m_profile_pages.resize(profiled_methods->num_profiles());
+  for (size_t i = 0; i < m_code_item_emits.size(); ++i) {
+    const auto& emit = m_code_item_emits[i];
+    uint32_t offset = emit.offset;
+    uint32_t end = i + 1 < m_code_item_emits.size()
+                       ? m_code_item_emits[i + 1].offset
+                       : m_offset;
+    std::vector<DexString*> strings;
+    bool gathered = false;
+    for (size_t p = 0; p < m_profile_pages.size(); ++p) {
+      if (!profiled_methods->in_profile(emit.method, p)) {
+        continue;
+      }
+      auto& pages = m_profile_pages[p];
+      ++pages.methods;
+      add_pages(offset, end - offset, &pages.code_pages);
+      if (!gathered) {
+        for (const auto* insn : emit.code->get_instructions()) {
+          insn->gather_strings(strings);
+        }
+        gathered = true;
+      }
+      for (DexString* str : strings) {
+        add_pages(stringids[dodx->stringidx(str)].offset,
+                  str->get_entry_size(), &pages.string_pages);
+      }
+    }
+  }
 }
 
 void DexOutput::generate_static_values() {
@@ -979,7 +1545,7 @@ void DexOutput::generate_static_values() {
     if (enc_arrays.count(*deva)) {
       m_static_values[clz] = enc_arrays.at(*deva);
     } else {
-      uint8_t* output = m_output + m_offset;
+      uint8_t* output = output_at(m_offset);
       uint8_t* outputsv = output;
       /* No alignment requirements */
       deva->encode(dodx, output);
@@ -1003,20 +1569,18 @@ void DexOutput::unique_annotations(annomap_t& annomap,
                                    std::vector<DexAnnotation*>& annolist) {
   int annocnt = 0;
   uint32_t mentry_offset = m_offset;
-  std::map<std::vector<uint8_t>, uint32_t> annotation_byte_offsets;
+  encoding_offsets_t<uint8_t> annotation_byte_offsets;
   for (auto anno : annolist) {
     if (annomap.count(anno)) continue;
     std::vector<uint8_t> annotation_bytes;
     anno->vencode(dodx, annotation_bytes);
-    if (annotation_byte_offsets.count(annotation_bytes)) {
-      annomap[anno] = annotation_byte_offsets[annotation_bytes];
+    auto inserted = annotation_byte_offsets.emplace(annotation_bytes, m_offset);
+    annomap[anno] = inserted.first->second;
+    if (!inserted.second) {
       continue;
     }
-    /* Insert new annotation in tracking structs */
-    annotation_byte_offsets[annotation_bytes] = m_offset;
-    annomap[anno] = m_offset;
     /* Not a dupe, encode... */
-    uint8_t* annoout = (uint8_t*)(m_output + m_offset);
+    uint8_t* annoout = output_at(m_offset);
     memcpy(annoout, &annotation_bytes[0], annotation_bytes.size());
     m_offset += annotation_bytes.size();
     annocnt++;
@@ -1032,20 +1596,18 @@ void DexOutput::unique_asets(annomap_t& annomap,
                              std::vector<DexAnnotationSet*>& asetlist) {
   int asetcnt = 0;
   uint32_t mentry_offset = m_offset;
-  std::map<std::vector<uint32_t>, uint32_t> aset_offsets;
+  encoding_offsets_t<uint32_t> aset_offsets;
   for (auto aset : asetlist) {
     if (asetmap.count(aset)) continue;
     std::vector<uint32_t> aset_bytes;
     aset->vencode(dodx, aset_bytes, annomap);
-    if (aset_offsets.count(aset_bytes)) {
-      asetmap[aset] = aset_offsets[aset_bytes];
+    auto inserted = aset_offsets.emplace(aset_bytes, m_offset);
+    asetmap[aset] = inserted.first->second;
+    if (!inserted.second) {
       continue;
     }
-    /* Insert new aset in tracking structs */
-    aset_offsets[aset_bytes] = m_offset;
-    asetmap[aset] = m_offset;
     /* Not a dupe, encode... */
-    uint8_t* asetout = (uint8_t*)(m_output + m_offset);
+    uint8_t* asetout = output_at(m_offset);
     memcpy(asetout, &aset_bytes[0], aset_bytes.size() * sizeof(uint32_t));
     m_offset += aset_bytes.size() * sizeof(uint32_t);
     asetcnt++;
@@ -1060,7 +1622,7 @@ void DexOutput::unique_xrefs(asetmap_t& asetmap,
                              std::vector<ParamAnnotations*>& xreflist) {
   int xrefcnt = 0;
   uint32_t mentry_offset = m_offset;
-  std::map<std::vector<uint32_t>, uint32_t> xref_offsets;
+  encoding_offsets_t<uint32_t> xref_offsets;
   for (auto xref : xreflist) {
     if (xrefmap.count(xref)) continue;
     std::vector<uint32_t> xref_bytes;
@@ -1071,15 +1633,13 @@ void DexOutput::unique_xrefs(asetmap_t& asetmap,
                         "Uninitialized aset %p '%s'", das, SHOW(das));
       xref_bytes.push_back(asetmap[das]);
     }
-    if (xref_offsets.count(xref_bytes)) {
-      xrefmap[xref] = xref_offsets[xref_bytes];
+    auto inserted = xref_offsets.emplace(xref_bytes, m_offset);
+    xrefmap[xref] = inserted.first->second;
+    if (!inserted.second) {
       continue;
     }
-    /* Insert new xref in tracking structs */
-    xref_offsets[xref_bytes] = m_offset;
-    xrefmap[xref] = m_offset;
     /* Not a dupe, encode... */
-    uint8_t* xrefout = (uint8_t*)(m_output + m_offset);
+    uint8_t* xrefout = output_at(m_offset);
     memcpy(xrefout, &xref_bytes[0], xref_bytes.size() * sizeof(uint32_t));
     m_offset += xref_bytes.size() * sizeof(uint32_t);
     xrefcnt++;
@@ -1095,20 +1655,18 @@ void DexOutput::unique_adirs(asetmap_t& asetmap,
                              std::vector<DexAnnotationDirectory*>& adirlist) {
   int adircnt = 0;
   uint32_t mentry_offset = m_offset;
-  std::map<std::vector<uint32_t>, uint32_t> adir_offsets;
+  encoding_offsets_t<uint32_t> adir_offsets;
   for (auto adir : adirlist) {
     if (adirmap.count(adir)) continue;
     std::vector<uint32_t> adir_bytes;
     adir->vencode(dodx, adir_bytes, xrefmap, asetmap);
-    if (adir_offsets.count(adir_bytes)) {
-      adirmap[adir] = adir_offsets[adir_bytes];
+    auto inserted = adir_offsets.emplace(adir_bytes, m_offset);
+    adirmap[adir] = inserted.first->second;
+    if (!inserted.second) {
       continue;
     }
-    /* Insert new adir in tracking structs */
-    adir_offsets[adir_bytes] = m_offset;
-    adirmap[adir] = m_offset;
     /* Not a dupe, encode... */
-    uint8_t* adirout = (uint8_t*)(m_output + m_offset);
+    uint8_t* adirout = output_at(m_offset);
     memcpy(adirout, &adir_bytes[0], adir_bytes.size() * sizeof(uint32_t));
     m_offset += adir_bytes.size() * sizeof(uint32_t);
     adircnt++;
@@ -1164,19 +1722,29 @@ void DexOutput::generate_annotations() {
   unique_adirs(asetmap, xrefmap, adirmap, lad);
   for (auto ad : lad) {
     int class_num = ad_to_classnum[ad];
-    dex_class_def* cdefs = (dex_class_def*)(m_output + hdr.class_defs_off);
+    dex_class_def* cdefs = (dex_class_def*)output_at(hdr.class_defs_off);
     cdefs[class_num].annotations_off = adirmap[ad];
     delete ad;
   }
 }
 
 namespace {
+// An upper bound on the number of bytes DexDebugItem::encode() writes: the
+// line start and parameter count, a uleb128p1 per parameter, up to four
+// leb128s after each opcode byte, and the end of sequence.
+size_t debug_item_size_bound(
+    DexDebugItem* dbg,
+    const std::vector<std::unique_ptr<DexDebugInstruction>>& dbgops) {
+  return 10 + dbg->get_param_names().size() * 5 + dbgops.size() * 21 + 1;
+}
+
+// Encodes the debug item at `output`, which goes at `offset` in the dex.
 int emit_debug_info(
     DexOutputIdx* dodx,
     bool emit_positions,
     DexDebugItem* dbg,
     DexCode* dc,
-    dex_code_item* dci,
+    uint32_t* debug_info_off,
     PositionMapper* pos_mapper,
     uint8_t* output,
     uint32_t offset,
@@ -1188,8 +1756,8 @@ int emit_debug_info(
                                             &debug_line_info);
   int size = 0;
   if (emit_positions) {
-    size = dbg->encode(dodx, output + offset, line_start, dbgops);
-    dci->debug_info_off = offset;
+    size = dbg->encode(dodx, output, line_start, dbgops);
+    *debug_info_off = offset;
   }
   if (dbg_lines != nullptr) {
     (*dbg_lines)[dc] = debug_line_info;
@@ -1197,6 +1765,7 @@ int emit_debug_info(
   return size;
 }
 
+// Encodes the debug items from `output`, which goes at `offset` in the dex.
 uint32_t emit_instruction_offset_debug_info(
     DexOutputIdx* dodx,
     bool per_arity,
@@ -1260,7 +1829,8 @@ uint32_t emit_instruction_offset_debug_info(
       dbgops.push_back(std::make_unique<DexDebugInstruction>(
           static_cast<DexDebugItemOpcode>(0x1e)));
     }
-    offset += DexDebugItem::encode(nullptr, output + offset, 0, params, dbgops);
+    offset += DexDebugItem::encode(nullptr, output + (offset - initial_offset),
+                                   0, params, dbgops);
     *dbgcount += 1;
   }
   // (3)
@@ -1271,12 +1841,12 @@ uint32_t emit_instruction_offset_debug_info(
     if (!dbg) {
       continue;
     }
-    dex_code_item* dci = it.code_item;
     bool use_iodi = iodi_metadata.can_safely_use_iodi(it.method);
     // We still want to fill in pos_mapper and code_debug_map, so run the
     // usual code to emit debug info, additionally we actual emit the usual
     // debug info if we can't safely use iodi.
-    offset += emit_debug_info(dodx, !use_iodi, dbg, dc, dci, pos_mapper, output,
+    offset += emit_debug_info(dodx, !use_iodi, dbg, dc, &it.debug_info_off,
+                              pos_mapper, output + (offset - initial_offset),
                               offset, code_debug_map);
     if (use_iodi) {
       uint32_t param_size =
@@ -1284,7 +1854,7 @@ uint32_t emit_instruction_offset_debug_info(
       auto offset_it = param_to_offset.find(param_size);
       always_assert_log(offset_it != offset_end,
                         "Expected to find param to offset");
-      dci->debug_info_off = offset_it->second;
+      it.debug_info_off = offset_it->second;
     } else {
       *dbgcount += 1;
     }
@@ -1309,7 +1879,7 @@ void DexOutput::generate_debug_items() {
                                                    m_pos_mapper,
                                                    m_code_item_emits,
                                                    *m_iodi_metadata,
-                                                   m_output,
+                                                   output_at(m_offset),
                                                    m_offset,
                                                    &dbgcount,
                                                    m_code_debug_lines);
@@ -1319,15 +1889,58 @@ void DexOutput::generate_debug_items() {
               "[IODI] WARNING: Not using IODI because no iodi metadata file was"
               " specified.\n");
     }
+    struct PendingDebugItem {
+      DexCode* dc;
+      DexDebugItem* dbg;
+      uint32_t line_start;
+      std::vector<std::unique_ptr<DexDebugInstruction>> dbgops;
+      std::string encoded;
+    };
+    std::vector<PendingDebugItem> items;
+    // The position mapper assigns lines in the order positions are mapped,
+    // so the debug instructions are generated serially, in emit order.
     for (auto& it : m_code_item_emits) {
       DexCode* dc = it.code;
-      dex_code_item* dci = it.code_item;
       auto dbg = dc->get_debug_item();
       if (dbg == nullptr) continue;
-      dbgcount++;
-      m_offset +=
-          emit_debug_info(dodx, emit_positions, dbg, dc, dci, m_pos_mapper,
-                          m_output, m_offset, m_code_debug_lines);
+      std::vector<DebugLineItem> debug_line_info;
+      uint32_t line_start{0};
+      auto dbgops = generate_debug_instructions(dbg, m_pos_mapper, &line_start,
+                                                &debug_line_info);
+      if (m_code_debug_lines != nullptr) {
+        (*m_code_debug_lines)[dc] = debug_line_info;
+      }
+      items.push_back({dc, dbg, line_start, std::move(dbgops), {}});
+    }
+    if (emit_positions) {
+      // Encoding depends only on the item itself, so it happens in parallel
+      // into separate buffers that are then laid out in emit order.
+      parallel_for(items.begin(), items.end(), [&](PendingDebugItem& item) {
+        item.encoded.resize(debug_item_size_bound(item.dbg, item.dbgops));
+        auto size = item.dbg->encode(dodx, (uint8_t*)&item.encoded[0],
+                                     item.line_start, item.dbgops);
+        always_assert(size <= (int)item.encoded.size());
+        item.encoded.resize(size);
+      });
+      // Code items can share a debug item, so byte-identical debug programs
+      // are only emitted once.
+      std::unordered_map<std::string, uint32_t> encoded_offsets;
+      size_t i = 0;
+      for (auto& it : m_code_item_emits) {
+        if (it.code->get_debug_item() == nullptr) continue;
+        auto& item = items[i++];
+        auto emitted = encoded_offsets.find(item.encoded);
+        if (emitted != encoded_offsets.end()) {
+          it.debug_info_off = emitted->second;
+          continue;
+        }
+        memcpy(output_at(m_offset), item.encoded.data(), item.encoded.size());
+        it.debug_info_off = m_offset;
+        auto size = item.encoded.size();
+        encoded_offsets.emplace(std::move(item.encoded), m_offset);
+        m_offset += size;
+        dbgcount++;
+      }
     }
   }
   if (emit_positions) {
@@ -1337,7 +1950,7 @@ void DexOutput::generate_debug_items() {
 
 void DexOutput::generate_map() {
   align_output();
-  uint32_t* mapout = (uint32_t*)(m_output + m_offset);
+  uint32_t* mapout = (uint32_t*)output_at(m_offset);
   hdr.map_off = m_offset;
   insert_map_item(TYPE_MAP_LIST, 1, m_offset);
   *mapout = (uint32_t) m_map_items.size();
@@ -1423,6 +2036,8 @@ void DexOutput::init_header_offsets() {
 
   m_offset += m_classes->size() * sizeof(dex_class_def);
   hdr.data_off = m_offset;
+  m_front.assign(hdr.data_off, 0);
+  m_output_start = m_offset;
   /* Todo... */
   hdr.map_off = 0;
   hdr.data_size = 0;
@@ -1430,21 +2045,60 @@ void DexOutput::init_header_offsets() {
 }
 
 void DexOutput::finalize_header() {
+  flush_output();
   hdr.data_size = m_offset - hdr.data_off;
   hdr.file_size = m_offset;
   int skip;
   skip = sizeof(hdr.magic) + sizeof(hdr.checksum) + sizeof(hdr.signature);
-  memcpy(m_output, &hdr, sizeof(hdr));
+  memcpy(m_front.data(), &hdr, sizeof(hdr));
+  // The data is read back a chunk at a time, to write the debug info offsets
+  // over the code items, which are in emit order, and to compute the
+  // signature and the checksum. The signature covers what follows it, and the
+  // checksum what follows itself, signature included. Both go over the bytes
+  // after the signature in one pass. The checksum of the signature is then
+  // put in front with adler32_combine.
+  constexpr size_t k_chunk = 64 * 1024;
   Sha1Context context;
   sha1_init(&context);
-  sha1_update(&context, m_output + skip, hdr.file_size - skip);
+  sha1_update(&context, m_front.data() + skip, hdr.data_off - skip);
+  uint32_t body_adler = (uint32_t)adler32(0L, Z_NULL, 0);
+  body_adler = adler32_update(body_adler, m_front.data() + skip,
+                              hdr.data_off - skip);
+  std::vector<uint8_t> chunk(k_chunk);
+  auto field_of = [](const CodeItemEmit& emit) {
+    return emit.offset + offsetof(dex_code_item, debug_info_off);
+  };
+  auto emit = m_code_item_emits.begin();
+  for (size_t offset = hdr.data_off; offset < hdr.file_size;
+       offset += k_chunk) {
+    auto size = std::min<size_t>(k_chunk, hdr.file_size - offset);
+    m_sink->read(offset, chunk.data(), size);
+    bool patched = false;
+    for (; emit != m_code_item_emits.end() && field_of(*emit) < offset + size;
+         ++emit) {
+      if (emit->debug_info_off == 0) {
+        continue;
+      }
+      // Code items are 4-byte aligned, and so are the chunks, so the field
+      // never straddles two chunks.
+      auto field = field_of(*emit);
+      always_assert(field + sizeof(uint32_t) <= offset + size);
+      memcpy(&chunk[field - offset], &emit->debug_info_off, sizeof(uint32_t));
+      patched = true;
+    }
+    if (patched) {
+      m_sink->write(offset, chunk.data(), size);
+    }
+    sha1_update(&context, chunk.data(), size);
+    body_adler = adler32_update(body_adler, chunk.data(), size);
+  }
   sha1_final(hdr.signature, &context);
-  memcpy(m_output, &hdr, sizeof(hdr));
   uint32_t adler = (uint32_t)adler32(0L, Z_NULL, 0);
-  skip = sizeof(hdr.magic) + sizeof(hdr.checksum);
-  adler = (uint32_t) adler32(adler, (const Bytef*)(m_output + skip), hdr.file_size - skip);
-  hdr.checksum = adler;
-  memcpy(m_output, &hdr, sizeof(hdr));
+  adler = (uint32_t)adler32(adler, hdr.signature, sizeof(hdr.signature));
+  hdr.checksum = (uint32_t)adler32_combine(adler, body_adler,
+                                           hdr.file_size - skip);
+  memcpy(m_front.data(), &hdr, sizeof(hdr));
+  m_sink->write(0, m_front.data(), m_front.size());
 }
 
 namespace {
@@ -1671,7 +2325,7 @@ void write_pg_mapping(const std::string& filename, DexClasses* classes) {
       auto rtype_str = deobf_type(rtype);
       ss << rtype_str;
       ss << " " << method->get_simple_deobfuscated_name() << "(";
-      auto args = proto->get_args()->get_type_list();
+      const auto& args = proto->get_args()->get_type_list();
       for (auto iter = args.begin() ; iter != args.end() ; ++iter) {
         auto* atype = *iter;
         auto atype_str = deobf_type(atype);
@@ -1763,6 +2417,35 @@ void DexOutput::write_symbol_files() {
   );
   write_bytecode_offset_mapping(m_bytecode_offset_filename,
                                 m_method_bytecode_offsets);
+  write_method_profiles_report();
+}
+
+/*
+ * Appends one line per method profile to the report:
+ *
+ *   <dex> <profile> <methods> <code pages> <string pages>
+ *
+ * where the pages are the 4KB pages of the dex touched by the code items of
+ * the profiled methods and by the string data they reference.
+ */
+void DexOutput::write_method_profiles_report() {
+  if (m_method_profiles_report_filename.empty() || m_profile_pages.empty()) {
+    return;
+  }
+  auto fd = fopen(m_method_profiles_report_filename.c_str(), "a");
+  assert_log(fd, "Can't open method profiles report %s: %s\n",
+             m_method_profiles_report_filename.c_str(),
+             strerror(errno));
+  auto profiled_methods = m_gtypes->get_profiled_methods();
+  const char* basename = strrchr(m_filename, '/');
+  for (size_t p = 0; p < m_profile_pages.size(); ++p) {
+    const auto& pages = m_profile_pages[p];
+    fprintf(fd, "%s %s %zu %zu %zu\n",
+            basename == nullptr ? m_filename : basename + 1,
+            profiled_methods->profile(p).name.c_str(), pages.methods,
+            pages.code_pages.size(), pages.string_pages.size());
+  }
+  fclose(fd);
 }
 
 void GatheredTypes::set_method_to_weight(
@@ -1773,47 +2456,69 @@ void GatheredTypes::set_method_to_weight(
 void DexOutput::prepare(SortMode string_mode,
                         const std::vector<SortMode>& code_mode,
                         const ConfigFiles& cfg) {
+  prepare_sections(string_mode, code_mode, cfg);
+  prepare_debug_items();
+  finish_sections();
+}
 
+void DexOutput::prepare_sections(SortMode string_mode,
+                                 const std::vector<SortMode>& code_mode,
+                                 const ConfigFiles& cfg) {
   if (std::find(code_mode.begin(), code_mode.end(),
                 SortMode::METHOD_PROFILED_ORDER) != code_mode.end()) {
     m_gtypes->set_method_to_weight(cfg.get_method_to_weight());
   }
+  if (!cfg.get_method_profiles().empty()) {
+    m_gtypes->set_method_profiles(&cfg.get_method_profiles());
+  }
+  m_startup_class_data =
+      std::find(code_mode.begin(), code_mode.end(), SortMode::STARTUP_ORDER) !=
+      code_mode.end();
 
   fix_jumbos(m_classes, dodx);
+  open_sink();
   init_header_offsets();
+  // Each section of the data is streamed out once it's laid out, while the
+  // ids and class defs stay in front until finalize_header().
   generate_static_values();
+  flush_output();
   generate_typelist_data();
+  flush_output();
   generate_string_data(string_mode);
+  flush_output();
   generate_code_items(code_mode);
+  flush_output();
   generate_class_data_items();
+  flush_output();
   generate_type_data();
   generate_proto_data();
   generate_field_data();
   generate_method_data();
   generate_class_data();
   generate_annotations();
-  generate_debug_items();
+  flush_output();
+  if (m_gtypes->has_startup_data()) {
+    count_startup_pages();
+  }
+}
+
+void DexOutput::finish_sections() {
+  flush_output();
   generate_map();
   align_output();
   finalize_header();
 }
 
 void DexOutput::write() {
-  struct stat st;
-  int fd = open(m_filename, O_CREAT | O_TRUNC | O_WRONLY, 0660);
-  if (fd == -1) {
-    perror("Error writing dex");
-    return;
-  }
-  ::write(fd, m_output, m_offset);
-  if (0 == fstat(fd, &st)) {
-    m_stats.num_bytes = st.st_size;
-  }
-  close(fd);
-
+  write_dex();
   write_symbol_files();
 }
 
+void DexOutput::write_dex() {
+  m_sink->close();
+  m_stats.num_bytes = m_offset;
+}
+
 static SortMode make_sort_bytecode(const std::string& sort_bytecode) {
   if (sort_bytecode == "class_order") {
     return SortMode::CLASS_ORDER;
@@ -1821,6 +2526,10 @@ static SortMode make_sort_bytecode(const std::string& sort_bytecode) {
     return SortMode::CLINIT_FIRST;
   } else if (sort_bytecode == "method_profiled_order") {
     return SortMode::METHOD_PROFILED_ORDER;
+  } else if (sort_bytecode == "method_profiles_order") {
+    return SortMode::METHOD_PROFILES_ORDER;
+  } else if (sort_bytecode == "startup_order") {
+    return SortMode::STARTUP_ORDER;
   } else {
     return SortMode::DEFAULT;
   }
@@ -1841,6 +2550,135 @@ static DebugInfoKind deserialize_debug_info_kind(std::string raw_kind) {
   }
 }
 
+namespace {
+
+// The output options of write_classes_to_dex(es) that come from the config.
+struct DexOutputConfig {
+  std::string method_mapping_filename;
+  std::string class_mapping_filename;
+  std::string pg_mapping_filename;
+  std::string bytecode_offset_filename;
+  std::string method_profiles_report_filename;
+  DebugInfoKind debug_info_kind;
+  SortMode string_sort_mode{SortMode::DEFAULT};
+  std::vector<SortMode> code_sort_mode;
+  bool lower_with_cfg{false};
+  // The rank of each class in the coldstart list.
+  std::unordered_map<const DexType*, uint32_t> startup_class_ranks;
+
+  explicit DexOutputConfig(const ConfigFiles& cfg) {
+    const JsonWrapper& json_cfg = cfg.get_json_config();
+    json_cfg.get("lower_with_cfg", false, lower_with_cfg);
+    method_mapping_filename =
+        cfg.metafile(json_cfg.get("method_mapping", std::string()));
+    class_mapping_filename =
+        cfg.metafile(json_cfg.get("class_mapping", std::string()));
+    pg_mapping_filename =
+        cfg.metafile(json_cfg.get("proguard_map_output", std::string()));
+    bytecode_offset_filename =
+        cfg.metafile(json_cfg.get("bytecode_offset_map", std::string()));
+    method_profiles_report_filename = cfg.metafile(
+        json_cfg.get("method_profiles_page_report", std::string()));
+    auto sort_strings = json_cfg.get("string_sort_mode", std::string());
+    debug_info_kind = deserialize_debug_info_kind(
+        json_cfg.get("debug_info_kind", std::string()));
+    if (sort_strings == "class_strings") {
+      string_sort_mode = SortMode::CLASS_STRINGS;
+    } else if (sort_strings == "class_order") {
+      string_sort_mode = SortMode::CLASS_ORDER;
+    } else if (sort_strings == "method_profiles_order") {
+      string_sort_mode = SortMode::METHOD_PROFILES_ORDER;
+    } else if (sort_strings == "startup_order") {
+      string_sort_mode = SortMode::STARTUP_ORDER;
+    }
+
+    auto sort_bytecode_cfg = json_cfg.get("bytecode_sort_mode", Json::Value());
+    if (sort_bytecode_cfg.isString()) {
+      code_sort_mode.push_back(
+          make_sort_bytecode(sort_bytecode_cfg.asString()));
+    } else if (sort_bytecode_cfg.isArray()) {
+      for (auto val : sort_bytecode_cfg) {
+        code_sort_mode.push_back(make_sort_bytecode(val.asString()));
+      }
+    }
+    if (code_sort_mode.empty()) {
+      code_sort_mode.push_back(SortMode::DEFAULT);
+    }
+
+    uint32_t rank = 0;
+    for (const DexType* type : cfg.resolve_coldstart_types()) {
+      if (type != nullptr && startup_class_ranks.emplace(type, rank).second) {
+        ++rank;
+      }
+    }
+  }
+};
+
+std::unique_ptr<DexOutput> make_dex_output(
+    const DexOutputConfig& out_cfg,
+    const std::string& filename,
+    DexClasses* classes,
+    LocatorIndex* locator_index,
+    bool emit_name_based_locators,
+    size_t store_number,
+    size_t dex_number,
+    const ConfigFiles& cfg,
+    PositionMapper* pos_mapper,
+    std::unordered_map<DexMethod*, uint64_t>* method_to_id,
+    std::unordered_map<DexCode*, std::vector<DebugLineItem>>* code_debug_lines,
+    IODIMetadata* iodi_metadata,
+    GatheredTypes* gtypes = nullptr) {
+  TRACE(OPUT, 2, "[write_classes_to_dex][filename] %s\n", filename.c_str());
+  auto dout = std::make_unique<DexOutput>(
+      filename.c_str(),
+      classes,
+      locator_index,
+      emit_name_based_locators,
+      store_number,
+      dex_number,
+      out_cfg.debug_info_kind,
+      iodi_metadata,
+      cfg,
+      pos_mapper,
+      method_to_id,
+      code_debug_lines,
+      out_cfg.method_mapping_filename,
+      out_cfg.class_mapping_filename,
+      out_cfg.pg_mapping_filename,
+      out_cfg.bytecode_offset_filename,
+      out_cfg.method_profiles_report_filename,
+      gtypes);
+  dout->set_startup_class_ranks(&out_cfg.startup_class_ranks);
+  return dout;
+}
+
+/*
+ * Lets the tasks working on dexes 0, 1, 2, ... enter a section one after the
+ * other, in that order.
+ */
+class OrderedSection {
+ public:
+  void enter(size_t i) {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_cv.wait(lock, [&] { return m_next == i; });
+  }
+
+  void leave() {
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+      ++m_next;
+    }
+    m_cv.notify_all();
+  }
+
+ private:
+  std::mutex m_lock;
+  std::condition_variable m_cv;
+  size_t m_next{0};
+};
+
+} // namespace
+
 dex_stats_t write_classes_to_dex(
     std::string filename,
     DexClasses* classes,
@@ -1853,98 +2691,178 @@ dex_stats_t write_classes_to_dex(
     std::unordered_map<DexMethod*, uint64_t>* method_to_id,
     std::unordered_map<DexCode*, std::vector<DebugLineItem>>* code_debug_lines,
     IODIMetadata* iodi_metadata) {
-  const JsonWrapper& json_cfg = cfg.get_json_config();
-  auto method_mapping_filename =
-      cfg.metafile(json_cfg.get("method_mapping", std::string()));
-  auto class_mapping_filename =
-      cfg.metafile(json_cfg.get("class_mapping", std::string()));
-  auto pg_mapping_filename =
-      cfg.metafile(json_cfg.get("proguard_map_output", std::string()));
-  auto bytecode_offset_filename =
-      cfg.metafile(json_cfg.get("bytecode_offset_map", std::string()));
-  auto sort_strings = json_cfg.get("string_sort_mode", std::string());
-  DebugInfoKind debug_info_kind = deserialize_debug_info_kind(
-      json_cfg.get("debug_info_kind", std::string()));
-  SortMode string_sort_mode = SortMode::DEFAULT;
-  if (sort_strings == "class_strings") {
-    string_sort_mode = SortMode::CLASS_STRINGS;
-  } else if (sort_strings == "class_order") {
-    string_sort_mode = SortMode::CLASS_ORDER;
-  }
-
-  auto sort_bytecode_cfg = json_cfg.get("bytecode_sort_mode", Json::Value());
-  std::vector<SortMode> code_sort_mode;
+  DexOutputConfig out_cfg(cfg);
+  auto dout = make_dex_output(out_cfg, filename, classes, locator_index,
+                              emit_name_based_locators, store_number,
+                              dex_number, cfg, pos_mapper, method_to_id,
+                              code_debug_lines, iodi_metadata);
+  dout->prepare(out_cfg.string_sort_mode, out_cfg.code_sort_mode, cfg);
+  dout->write();
+  return dout->m_stats;
+}
 
-  if (sort_bytecode_cfg.isString()) {
-    code_sort_mode.push_back(make_sort_bytecode(sort_bytecode_cfg.asString()));
-  } else if (sort_bytecode_cfg.isArray()) {
-    for (auto val : sort_bytecode_cfg) {
-      code_sort_mode.push_back(make_sort_bytecode(val.asString()));
+std::vector<dex_stats_t> write_classes_to_dexes(
+    const std::vector<DexOutputTarget>& targets,
+    LocatorIndex* locator_index,
+    bool emit_name_based_locators,
+    const ConfigFiles& cfg,
+    PositionMapper* pos_mapper,
+    std::unordered_map<DexMethod*, uint64_t>* method_to_id,
+    std::unordered_map<DexCode*, std::vector<DebugLineItem>>* code_debug_lines,
+    IODIMetadata* iodi_metadata,
+    instruction_lowering::Stats* lowering_stats,
+    bool release_code) {
+  always_assert(!release_code ||
+                (iodi_metadata == nullptr && code_debug_lines == nullptr));
+  DexOutputConfig out_cfg(cfg);
+  std::vector<dex_stats_t> stats(targets.size());
+  std::vector<instruction_lowering::Stats> dex_lowering_stats(targets.size());
+  OrderedSection debug_items;
+  OrderedSection symbols;
+  std::vector<size_t> indices(targets.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  // The index range is handed out in order, so a task only ever waits on
+  // tasks that started before it, and that are running or done.
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    const auto& target = targets[i];
+    // 0: before the debug items, 1: emitting them, 2: before the symbols,
+    // 3: writing them, 4: done.
+    int stage = 0;
+    try {
+      // Each dex is gathered as its turn comes, so that it is written out
+      // without waiting for the others. Its strings are ranked once, instead
+      // of sorting each kind of id by comparing strings.
+      auto gtypes = std::make_unique<GatheredTypes>(target.classes);
+      DexStringRanks string_ranks(gtypes->get_strings());
+      gtypes->set_string_ranks(&string_ranks);
+      auto dout = make_dex_output(
+          out_cfg, target.filename, target.classes, locator_index,
+          emit_name_based_locators, target.store_number, target.dex_number,
+          cfg, pos_mapper, method_to_id, code_debug_lines, iodi_metadata,
+          gtypes.release());
+      dout->set_zip(target.zip);
+      if (lowering_stats != nullptr) {
+        dout->set_lower(out_cfg.lower_with_cfg);
+      }
+      dout->prepare_sections(out_cfg.string_sort_mode, out_cfg.code_sort_mode,
+                             cfg);
+      // Line numbers are handed out by the position mapper in emission order.
+      debug_items.enter(i);
+      stage = 1;
+      dout->prepare_debug_items();
+      debug_items.leave();
+      stage = 2;
+      dout->finish_sections();
+      dout->write_dex();
+      // The symbol files are appended to, one dex after the other.
+      symbols.enter(i);
+      stage = 3;
+      dout->write_symbols();
+      symbols.leave();
+      stage = 4;
+      stats[i] = dout->m_stats;
+      dex_lowering_stats[i] = dout->get_lowering_stats();
+      dout.reset();
+      if (release_code) {
+        for (auto* cls : *target.classes) {
+          for (auto* m : cls->get_dmethods()) {
+            m->set_dex_code(nullptr);
+          }
+          for (auto* m : cls->get_vmethods()) {
+            m->set_dex_code(nullptr);
+          }
+        }
+      }
+    } catch (...) {
+      // Let the later dexes through both sections before reporting the
+      // failure.
+      switch (stage) {
+      case 0:
+        debug_items.enter(i);
+        // fallthrough
+      case 1:
+        debug_items.leave();
+        // fallthrough
+      case 2:
+        symbols.enter(i);
+        // fallthrough
+      case 3:
+        symbols.leave();
+        break;
+      default:
+        break;
+      }
+      throw;
+    }
+  }, 1);
+  if (lowering_stats != nullptr) {
+    for (const auto& dex_stats : dex_lowering_stats) {
+      lowering_stats->accumulate(dex_stats);
     }
   }
-  if (code_sort_mode.empty()) {
-    code_sort_mode.push_back(SortMode::DEFAULT);
-  }
-
-  TRACE(OPUT, 2, "[write_classes_to_dex][filename] %s\n", filename.c_str());
-
-  DexOutput dout = DexOutput(filename.c_str(),
-                             classes,
-                             locator_index,
-                             emit_name_based_locators,
-                             store_number,
-                             dex_number,
-                             debug_info_kind,
-                             iodi_metadata,
-                             cfg,
-                             pos_mapper,
-                             method_to_id,
-                             code_debug_lines,
-                             method_mapping_filename,
-                             class_mapping_filename,
-                             pg_mapping_filename,
-                             bytecode_offset_filename);
-
-  dout.prepare(string_sort_mode, code_sort_mode, cfg);
-  dout.write();
-  return dout.m_stats;
+  return stats;
 }
 
 LocatorIndex make_locator_index(DexStoresVector& stores,
                                 bool emit_name_based_locators) {
-  LocatorIndex index;
-
+  struct DexLocation {
+    uint32_t strnr;
+    uint32_t dexnr;
+    const DexClasses* classes;
+  };
+  std::vector<DexLocation> dexes;
+  size_t num_classes = 0;
   for (uint32_t strnr = 0; strnr < stores.size(); strnr++) {
     DexClassesVector& dexen = stores[strnr].get_dexen();
     uint32_t dexnr = 1; // Zero is reserved for Android classes
     for (auto dexit = dexen.begin(); dexit != dexen.end(); ++dexit, ++dexnr) {
-      const DexClasses& classes = *dexit;
-      uint32_t clsnr = 0;
-      for (auto clsit = classes.begin(); clsit != classes.end();
-           ++clsit, ++clsnr) {
-        DexString* clsname = (*clsit)->get_type()->get_name();
-        if (emit_name_based_locators) {
-          const auto cstr = clsname->c_str();
-          uint32_t global_clsnr = Locator::decodeGlobalClassIndex(cstr);
-          if (global_clsnr != Locator::invalid_global_class_index) {
-            TRACE(LOC, 3,
-                  "%s (%u, %u, %u) needs no locator; global class index=%u\n",
-                  cstr, strnr, dexnr, clsnr, global_clsnr);
-            // This prefix is followed by the global class index; this case
-            // doesn't need a locator since emit_name_based_locators is enabled.
-            continue;
-          }
-        }
+      dexes.push_back({strnr, dexnr, &*dexit});
+      num_classes += dexit->size();
+    }
+  }
 
-        bool inserted = index
-                            .insert(std::make_pair(
-                                clsname, Locator::make(strnr, dexnr, clsnr)))
-                            .second;
-        // We shouldn't see the same class defined in two dexen
-        always_assert_log(inserted, "This was already inserted %s\n",
-                          (*clsit)->get_deobfuscated_name().c_str());
-        (void) inserted; // Shut up compiler when defined(NDEBUG)
+  // The locators of each dex are computed in parallel, and then inserted in
+  // dex order, so that duplicates are reported deterministically.
+  std::vector<std::vector<std::pair<DexClass*, Locator>>> dex_locators(
+      dexes.size());
+  std::vector<size_t> indices(dexes.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    const DexLocation& dex = dexes[i];
+    auto& locators = dex_locators[i];
+    locators.reserve(dex.classes->size());
+    uint32_t clsnr = 0;
+    for (auto clsit = dex.classes->begin(); clsit != dex.classes->end();
+         ++clsit, ++clsnr) {
+      if (emit_name_based_locators) {
+        const auto cstr = (*clsit)->get_type()->get_name()->c_str();
+        uint32_t global_clsnr = Locator::decodeGlobalClassIndex(cstr);
+        if (global_clsnr != Locator::invalid_global_class_index) {
+          TRACE(LOC, 3,
+                "%s (%u, %u, %u) needs no locator; global class index=%u\n",
+                cstr, dex.strnr, dex.dexnr, clsnr, global_clsnr);
+          // This prefix is followed by the global class index; this case
+          // doesn't need a locator since emit_name_based_locators is enabled.
+          continue;
+        }
       }
+      locators.emplace_back(*clsit,
+                            Locator::make(dex.strnr, dex.dexnr, clsnr));
+    }
+  });
+
+  LocatorIndex index;
+  index.reserve(num_classes);
+  for (const auto& locators : dex_locators) {
+    for (const auto& cls_locator : locators) {
+      DexClass* cls = cls_locator.first;
+      bool inserted =
+          index.emplace(cls->get_type()->get_name(), cls_locator.second)
+              .second;
+      // We shouldn't see the same class defined in two dexen
+      always_assert_log(inserted, "This was already inserted %s\n",
+                        cls->get_deobfuscated_name().c_str());
+      (void) inserted; // Shut up compiler when defined(NDEBUG)
     }
   }
 
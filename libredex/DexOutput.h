@@ -7,11 +7,16 @@
 
 #pragma once
 
+#include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "ConfigFiles.h"
 #include "DexClass.h"
 #include "DexUtil.h"
+#include "InstructionLowering.h"
+#include "MethodProfiles.h"
 #include "Trace.h"
 #include "Pass.h"
 #include "ProguardMap.h"
@@ -34,6 +39,8 @@ enum class SortMode {
   CLASS_STRINGS,
   CLINIT_FIRST,
   METHOD_PROFILED_ORDER,
+  METHOD_PROFILES_ORDER,
+  STARTUP_ORDER,
   DEFAULT
 };
 
@@ -92,6 +99,7 @@ class DexOutputIdx {
 };
 
 class IODIMetadata;
+class ZipWriter;
 
 dex_stats_t write_classes_to_dex(
     std::string filename,
@@ -106,12 +114,66 @@ dex_stats_t write_classes_to_dex(
     std::unordered_map<DexCode*, std::vector<DebugLineItem>>* code_debug_lines,
     IODIMetadata* iodi_metadata);
 
+struct DexOutputTarget {
+  std::string filename;
+  DexClasses* classes;
+  size_t store_number;
+  size_t dex_number;
+  // If set, the dex is added to this zip, under the base name of `filename`,
+  // instead of being written to `filename`.
+  ZipWriter* zip{nullptr};
+};
+
+/*
+ * Same as calling write_classes_to_dex on each target in turn, but the dexes
+ * are emitted in parallel. The parts that depend on the order of the dexes --
+ * line numbers from the PositionMapper, IODI debug info and the symbol files --
+ * still run one dex after the other, in the order of `targets`, so the output
+ * does not change. Returns the stats of each target.
+ *
+ * With `lowering_stats`, the code doesn't need to have been lowered by
+ * instruction_lowering::run: each dex lowers its methods as it syncs them, so
+ * that the IR of a method is converted in one go, and the stats of the
+ * lowering are added to `lowering_stats`.
+ *
+ * With `release_code`, the code of each dex's methods, and their debug items,
+ * are freed as soon as the dex is written. Nothing can look at the code
+ * afterwards, so this can't be used along with IODI metadata, debug line
+ * mappings, or a position mapper that writes a line map.
+ */
+std::vector<dex_stats_t> write_classes_to_dexes(
+    const std::vector<DexOutputTarget>& targets,
+    LocatorIndex* locator_index /* nullable */,
+    bool emit_name_based_locators,
+    const ConfigFiles& cfg,
+    PositionMapper* line_mapper,
+    std::unordered_map<DexMethod*, uint64_t>* method_to_id,
+    std::unordered_map<DexCode*, std::vector<DebugLineItem>>* code_debug_lines,
+    IODIMetadata* iodi_metadata,
+    instruction_lowering::Stats* lowering_stats = nullptr,
+    bool release_code = false);
+
 typedef bool (*cmp_dstring)(const DexString*, const DexString*);
 typedef bool (*cmp_dtype)(const DexType*, const DexType*);
 typedef bool (*cmp_dproto)(const DexProto*, const DexProto*);
 typedef bool (*cmp_dfield)(const DexFieldRef*, const DexFieldRef*);
 typedef bool (*cmp_dmethod)(const DexMethodRef*, const DexMethodRef*);
 
+/*
+ * The position of each of a set of strings in compare_dexstrings order. It is
+ * computed once for the strings of a dex, so that the dex can sort its string,
+ * type, proto, field and method ids by comparing integers rather than MUTF-8
+ * strings.
+ */
+class DexStringRanks {
+ public:
+  explicit DexStringRanks(std::vector<DexString*> strings);
+  uint32_t rank(const DexString* s) const { return m_ranks.at(s); }
+
+ private:
+  std::unordered_map<const DexString*, uint32_t> m_ranks;
+};
+
 /*
  * This API gathers all of the data referred to by a set of DexClasses in
  * preparation for emitting a dex file and provides the symbol tables in indexed
@@ -152,23 +214,39 @@ class GatheredTypes {
   std::unordered_map<const DexString*, unsigned int> m_cls_strings;
   std::unordered_map<const DexMethod*, unsigned int> m_methods_in_cls_order;
   std::unordered_map<std::string, unsigned int> m_method_to_weight;
+  const std::vector<MethodProfile>* m_method_profiles{nullptr};
+  std::unique_ptr<ProfiledMethods> m_profiled_methods;
+  const std::unordered_map<const DexType*, uint32_t>* m_startup_class_ranks{
+      nullptr};
+  const DexStringRanks* m_string_ranks{nullptr};
 
   void gather_components();
   dexstring_to_idx* get_string_index(cmp_dstring cmp = compare_dexstrings);
   dextype_to_idx* get_type_index(cmp_dtype cmp = compare_dextypes);
   dexproto_to_idx* get_proto_index(cmp_dproto cmp = compare_dexprotos);
   dexfield_to_idx* get_field_index(cmp_dfield cmp = compare_dexfields);
-  dexmethod_to_idx* get_method_index(cmp_dmethod cmp = compare_dexmethods);
+  // `protos` is only needed to sort by m_string_ranks.
+  dexmethod_to_idx* get_method_index(cmp_dmethod cmp = compare_dexmethods,
+                                     const dexproto_to_idx* protos = nullptr);
 
   void build_cls_load_map();
   void build_cls_map();
   void build_method_map();
+  // The strings in `rank` come first, by rank, then the others in default
+  // order.
+  std::vector<DexString*> get_ranked_dexstring_emitlist(
+      const std::unordered_map<const DexString*, unsigned int>& rank);
 
  public:
   GatheredTypes(DexClasses* classes);
   DexOutputIdx* get_dodx(const uint8_t* base);
-  template <class T = decltype(compare_dexstrings)>
-  std::vector<DexString*> get_dexstring_emitlist(T cmp = compare_dexstrings);
+  // The strings gathered from the classes, including those of their types.
+  const std::vector<DexString*>& get_strings() const { return m_lstring; }
+  // With ranks covering get_strings(), get_dodx() sorts the ids by rank.
+  void set_string_ranks(const DexStringRanks* ranks) { m_string_ranks = ranks; }
+  std::vector<DexString*> get_dexstring_emitlist();
+  template <class T>
+  std::vector<DexString*> get_dexstring_emitlist(T cmp);
   std::vector<DexString*> get_cls_order_dexstring_emitlist();
   std::vector<DexString*> keep_cls_strings_together_emitlist();
   std::vector<DexMethod*> get_dexmethod_emitlist();
@@ -182,6 +260,36 @@ class GatheredTypes {
   void set_method_to_weight(
       const std::unordered_map<std::string, unsigned int>& method_to_weight);
 
+  // The profiles used by the METHOD_PROFILES_ORDER sort modes. They are
+  // resolved against the methods of the dex on first use.
+  void set_method_profiles(const std::vector<MethodProfile>* profiles) {
+    m_method_profiles = profiles;
+  }
+  const ProfiledMethods* get_profiled_methods();
+  void sort_dexmethod_emitlist_profiles_order(std::vector<DexMethod*>& lmeth);
+  // The strings referenced by the code of profiled methods come first, in the
+  // order of the methods, followed by the other strings in default order.
+  std::vector<DexString*> get_profiles_order_dexstring_emitlist();
+
+  // The classes of the coldstart list, by rank in the list. Together with the
+  // method profiles, they define what the dex needs at startup.
+  void set_startup_class_ranks(
+      const std::unordered_map<const DexType*, uint32_t>* ranks) {
+    m_startup_class_ranks = ranks;
+  }
+  bool has_startup_data();
+  // The classes of the dex that are in the coldstart list, by rank.
+  std::vector<DexClass*> get_startup_classes();
+  // The methods run at startup: the methods in any profile, or without
+  // profiles, all the methods of the startup classes; and the <clinit>s of
+  // the startup classes. They are sorted in the order they should be laid out.
+  std::vector<DexMethod*> get_startup_methods();
+  // Moves the startup methods first, in get_startup_methods() order.
+  void sort_dexmethod_emitlist_startup_order(std::vector<DexMethod*>& lmeth);
+  // The type names of the startup classes and the strings of the startup
+  // methods come first, followed by the other strings in default order.
+  std::vector<DexString*> get_startup_order_dexstring_emitlist();
+
   std::unordered_set<DexString*> index_type_names();
 };
 
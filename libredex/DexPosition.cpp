@@ -13,16 +13,23 @@
 #include "DexPosition.h"
 #include "DexUtil.h"
 
-DexPosition::DexPosition(uint32_t line) : line(line), parent(nullptr) {}
+namespace {
+
+const DexPositionOrigin s_unbound_origin{nullptr, nullptr};
+
+} // namespace
+
+DexPosition::DexPosition(uint32_t line)
+    : parent(nullptr), origin(&s_unbound_origin), line(line) {}
 
 void DexPosition::bind(DexMethod* method_, DexString* file_) {
   always_assert(method_ != nullptr);
-  this->method = method_;
-  this->file = file_;
+  this->origin = g_redex->make_position_origin(method_, file_);
 }
 
 bool DexPosition::operator==(const DexPosition& that) const {
-  return method == that.method && file == that.file && line == that.line &&
+  // Origins are interned, so equal origins are the same object.
+  return origin == that.origin && line == that.line &&
          (parent == that.parent ||
           (parent != nullptr && that.parent != nullptr &&
            *parent == *that.parent));
@@ -88,11 +95,11 @@ void RealPositionMapper::write_map_v1() {
       std::cerr << "Parent position " << show(pos->parent) << " of "
                 << show(pos) << " was not registered" << std::endl;
     }
-    if (string_ids.find(pos->file) == string_ids.end()) {
-      string_ids[pos->file] = string_pool.size();
-      string_pool.push_back(pos->file);
+    if (string_ids.find(pos->file()) == string_ids.end()) {
+      string_ids[pos->file()] = string_pool.size();
+      string_pool.push_back(pos->file());
     }
-    auto string_id = string_ids[pos->file];
+    auto string_id = string_ids[pos->file()];
     pos_out.write((const char*)&string_id, sizeof(string_id));
     pos_out.write((const char*)&pos->line, sizeof(pos->line));
     pos_out.write((const char*)&parent_line, sizeof(parent_line));
@@ -161,7 +168,7 @@ void RealPositionMapper::write_map_v2() {
                 << show(pos) << " was not registered" << std::endl;
     }
     // of the form "class_name.method_name:(arg_types)return_type"
-    auto full_method_name = pos->method->get_deobfuscated_name();
+    auto full_method_name = pos->method()->get_deobfuscated_name();
     // strip out the args and return type
     auto qualified_method_name =
       full_method_name.substr(0, full_method_name.find(":"));
@@ -171,7 +178,7 @@ void RealPositionMapper::write_map_v2() {
         qualified_method_name.substr(qualified_method_name.rfind(".") + 1);
     auto class_id = id_of_string(class_name);
     auto method_id = id_of_string(method_name);
-    auto file_id = id_of_string(pos->file->c_str());
+    auto file_id = id_of_string(pos->file()->c_str());
     pos_out.write((const char*)&class_id, sizeof(class_id));
     pos_out.write((const char*)&method_id, sizeof(method_id));
     pos_out.write((const char*)&file_id, sizeof(file_id));
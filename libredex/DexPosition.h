@@ -17,15 +17,28 @@ class DexMethod;
 class DexString;
 class DexDebugItem;
 
+/*
+ * The method and source file of a position. All the positions of a method
+ * share them, so they are interned once by the RedexContext and positions only
+ * point to them.
+ */
+struct DexPositionOrigin {
+  DexMethod* method;
+  DexString* file;
+};
+
 struct DexPosition final {
-  DexMethod* method{nullptr};
-  DexString* file{nullptr};
-  uint32_t line;
   // when a function gets inlined for the first time, all its DexPositions will
   // have the DexPosition of the callsite as their parent.
   DexPosition* parent;
+  const DexPositionOrigin* origin;
+  uint32_t line;
   DexPosition(uint32_t line);
 
+  // Both are null until the position is bound.
+  DexMethod* method() const { return origin->method; }
+  DexString* file() const { return origin->file; }
+
   void bind(DexMethod* method_, DexString* file_);
   bool operator==(const DexPosition&) const;
 };
@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "DexSink.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+
+#ifdef _MSC_VER
+#include <io.h>
+
+namespace {
+
+int open(const char* path, int flags, int mode) {
+  return _open(path, flags | _O_BINARY, mode);
+}
+
+int close(int fd) { return _close(fd); }
+
+int64_t pwrite(int fd, const void* data, size_t size, int64_t offset) {
+  if (_lseeki64(fd, offset, SEEK_SET) < 0) {
+    return -1;
+  }
+  return _write(fd, data, (unsigned)size);
+}
+
+int64_t pread(int fd, void* data, size_t size, int64_t offset) {
+  if (_lseeki64(fd, offset, SEEK_SET) < 0) {
+    return -1;
+  }
+  return _read(fd, data, (unsigned)size);
+}
+
+} // namespace
+
+#define O_CREAT _O_CREAT
+#define O_TRUNC _O_TRUNC
+#define O_RDWR _O_RDWR
+#else
+#include <unistd.h>
+#endif
+
+#include "Debug.h"
+#include "ZipWriter.h"
+
+FileDexSink::FileDexSink(std::string path) : m_path(std::move(path)) {
+  m_fd = open(m_path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0660);
+  always_assert_log(m_fd != -1, "Error opening %s for writing: %s\n",
+                    m_path.c_str(), strerror(errno));
+}
+
+FileDexSink::~FileDexSink() {
+  if (m_fd != -1) {
+    ::close(m_fd);
+  }
+}
+
+void FileDexSink::write(uint32_t offset, const void* data, size_t size) {
+  auto bytes = static_cast<const uint8_t*>(data);
+  // pwrite() may write less than asked for, so keep going until it's all out.
+  for (size_t written = 0; written < size;) {
+    auto n = pwrite(m_fd, bytes + written, size - written, offset + written);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    always_assert_log(n > 0, "Error writing %s: %s\n", m_path.c_str(),
+                      n < 0 ? strerror(errno) : "nothing written");
+    written += n;
+  }
+}
+
+void FileDexSink::read(uint32_t offset, void* data, size_t size) {
+  auto bytes = static_cast<uint8_t*>(data);
+  for (size_t done = 0; done < size;) {
+    auto n = pread(m_fd, bytes + done, size - done, offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    always_assert_log(n > 0, "Error reading back %s: %s\n", m_path.c_str(),
+                      n < 0 ? strerror(errno) : "unexpected end of file");
+    done += n;
+  }
+}
+
+void FileDexSink::close() {
+  // Some file systems only report write errors on close.
+  int closed = ::close(m_fd);
+  m_fd = -1;
+  always_assert_log(closed == 0, "Error writing %s: %s\n", m_path.c_str(),
+                    strerror(errno));
+}
+
+ZipEntryDexSink::ZipEntryDexSink(ZipWriter* zip, const std::string& name)
+    : FileDexSink(zip->path() + "-" + name + ".tmp"),
+      m_zip(zip),
+      m_name(name) {}
+
+ZipEntryDexSink::~ZipEntryDexSink() { std::remove(path().c_str()); }
+
+void ZipEntryDexSink::close() {
+  FileDexSink::close();
+  m_zip->add_file(m_name, path());
+  std::remove(path().c_str());
+}
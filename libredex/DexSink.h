@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class ZipWriter;
+
+/*
+ * Where DexOutput streams a dex to. Each section is written as soon as it is
+ * laid out, so that only the section being laid out is held in memory. The
+ * fields that refer to later sections -- in the header, the ids, the class
+ * defs and the code items -- are written over once everything is laid out,
+ * and the checksum and signature are then computed by reading the dex back.
+ */
+class DexSink {
+ public:
+  virtual ~DexSink() {}
+
+  // Writes `size` bytes at `offset`, past the end of what was written so far
+  // or over it.
+  virtual void write(uint32_t offset, const void* data, size_t size) = 0;
+
+  // Reads back `size` bytes that were written at `offset`.
+  virtual void read(uint32_t offset, void* data, size_t size) = 0;
+
+  // Completes the dex. Nothing can be written afterwards.
+  virtual void close() = 0;
+};
+
+// Writes the dex to a file.
+class FileDexSink : public DexSink {
+ public:
+  explicit FileDexSink(std::string path);
+  ~FileDexSink() override;
+
+  FileDexSink(const FileDexSink&) = delete;
+  FileDexSink& operator=(const FileDexSink&) = delete;
+
+  void write(uint32_t offset, const void* data, size_t size) override;
+  void read(uint32_t offset, void* data, size_t size) override;
+  void close() override;
+
+  const std::string& path() const { return m_path; }
+
+ private:
+  std::string m_path;
+  int m_fd;
+};
+
+// Writes the dex to a temporary file next to the zip, and adds it to the zip
+// under `name` when closed. The file is removed in any case.
+class ZipEntryDexSink : public FileDexSink {
+ public:
+  ZipEntryDexSink(ZipWriter* zip, const std::string& name);
+  ~ZipEntryDexSink() override;
+
+  void close() override;
+
+ private:
+  ZipWriter* m_zip;
+  std::string m_name;
+};
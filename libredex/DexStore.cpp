@@ -4,6 +4,7 @@
  * This source code is licensed under the MIT license found in the
  * LICENSE file in the root directory of this source tree.
  */
+#include <algorithm>
 #include <json/json.h>
 #include <iostream>
 #include <fstream>
@@ -67,29 +68,34 @@ void DexMetadata::parse(const std::string& path) {
 }
 
 XStoreRefs::XStoreRefs(const DexStoresVector& stores) {
-  m_xstores.push_back(std::unordered_set<const DexType*>());
+  auto add_classes = [&](const DexClasses& classes) {
+    for (const auto& cls : classes) {
+      m_store_idx.emplace(cls->get_type(), m_stores.size() - 1);
+    }
+  };
   m_stores.push_back(&stores[0]);
-  for (const auto& cls : stores[0].get_dexen()[0]) {
-    m_xstores.back().insert(cls->get_type());
-  }
+  add_classes(stores[0].get_dexen()[0]);
   m_root_stores = 1;
   if (stores[0].get_dexen().size() > 1) {
     m_root_stores++;
-    m_xstores.push_back(std::unordered_set<const DexType*>());
     m_stores.push_back(&stores[0]);
     for (size_t i = 1; i < stores[0].get_dexen().size(); i++) {
-      for (const auto& cls : stores[0].get_dexen()[i]) {
-        m_xstores.back().insert(cls->get_type());
-      }
+      add_classes(stores[0].get_dexen()[i]);
     }
   }
   for (size_t i = 1; i < stores.size(); i++) {
-    m_xstores.push_back(std::unordered_set<const DexType*>());
     m_stores.push_back(&stores[i]);
     for (const auto& classes : stores[i].get_dexen()) {
-      for (const auto& cls : classes) {
-        m_xstores.back().insert(cls->get_type());
-      }
+      add_classes(classes);
+    }
+  }
+  m_depends_on.assign(m_stores.size(), std::vector<bool>(m_stores.size()));
+  for (size_t caller = m_root_stores; caller < m_stores.size(); caller++) {
+    const auto& dependencies = m_stores[caller]->get_dependencies();
+    for (size_t callee = 0; callee < m_stores.size(); callee++) {
+      m_depends_on[caller][callee] =
+          std::find(dependencies.begin(), dependencies.end(),
+                    m_stores[callee]->get_name()) != dependencies.end();
     }
   }
 }
@@ -9,8 +9,9 @@
 
 #include <cstdlib>
 #include <cstring>
-#include <vector>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include "DexClass.h"
 
 class DexStore;
@@ -113,14 +114,14 @@ public:
 class XStoreRefs {
  private:
   /**
-   * Set of classes in each logical store. A primary DEX goes in its own
-   * bucket (first element in the array).
+   * The logical store of each class, as an index into m_stores. A primary DEX
+   * goes in its own store (index 0). A class that is in several stores
+   * belongs to the first one.
    */
-  std::vector<std::unordered_set<const DexType*>> m_xstores;
+  std::unordered_map<const DexType*, size_t> m_store_idx;
 
   /**
-   * Pointers to original stores in the same order as used to populate
-   * m_xstores
+   * Pointers to original stores, one per logical store.
    */
   std::vector<const DexStore*> m_stores;
 
@@ -129,6 +130,13 @@ class XStoreRefs {
    */
   size_t m_root_stores;
 
+  /**
+   * Whether each logical store lists the store of another one among its
+   * dependencies, indexed by caller then callee. Only ever true for non-root
+   * callers.
+   */
+  std::vector<std::vector<bool>> m_depends_on;
+
  public:
   explicit XStoreRefs(const DexStoresVector& stores);
 
@@ -138,10 +146,10 @@ class XStoreRefs {
    * api.
    */
   size_t get_store_idx(const DexType* type) const {
-    for (size_t store_idx = 0; store_idx < m_xstores.size(); store_idx++) {
-      if (m_xstores[store_idx].count(type) > 0) return store_idx;
-    }
-    always_assert_log(false, "type %s not in the current APK", SHOW(type));
+    auto it = m_store_idx.find(type);
+    always_assert_log(it != m_store_idx.end(), "type %s not in the current APK",
+                      SHOW(type));
+    return it->second;
   }
 
   const DexStore* get_store(size_t idx) const { return m_stores[idx]; }
@@ -171,12 +179,11 @@ class XStoreRefs {
     if (type_class_internal(type) == nullptr) return false;
     // Temporary HACK: optimizations may leave references to dead classes and
     // if we just call get_store_idx() - as we should - the assert will fire...
-    size_t type_store_idx = 0;
-    for (; type_store_idx < m_xstores.size(); type_store_idx++) {
-      if (m_xstores[type_store_idx].count(type) > 0) break;
-    }
-    if ((store_idx >= m_xstores.size()) ||
-        (type_store_idx >= m_xstores.size())) {
+    auto it = m_store_idx.find(type);
+    size_t type_store_idx =
+        it == m_store_idx.end() ? m_stores.size() : it->second;
+    if ((store_idx >= m_stores.size()) ||
+        (type_store_idx >= m_stores.size())) {
       return type_store_idx > store_idx;
     }
     return illegal_ref_between_stores(store_idx, type_store_idx);
@@ -197,17 +204,6 @@ class XStoreRefs {
 
     // Check if the caller depends on the callee,
     // TODO - do it transitively.
-    if (caller_store_idx >= m_root_stores) {
-      const auto& callee_store_name = get_store(callee_store_idx)->get_name();
-      const auto& caller_dependencies =
-          get_store(caller_store_idx)->get_dependencies();
-
-      if (std::find(caller_dependencies.begin(), caller_dependencies.end(),
-                    callee_store_name) != caller_dependencies.end()) {
-        return false;
-      }
-    }
-
-    return true;
+    return !m_depends_on[caller_store_idx][callee_store_idx];
   }
 };
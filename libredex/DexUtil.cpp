@@ -479,6 +479,7 @@ dex_stats_t&
   lhs.num_type_lists += rhs.num_type_lists;
   lhs.num_bytes += rhs.num_bytes;
   lhs.num_instructions += rhs.num_instructions;
+  lhs.num_startup_pages += rhs.num_startup_pages;
   return lhs;
 }
 
@@ -511,51 +512,81 @@ void change_visibility(DexMethod* method) {
 
   editable_cfg_adapter::iterate(code, [](MethodItemEntry* mie) {
     auto insn = mie->insn;
-
+    // FIXME no point in rewriting opcodes in the method
     if (insn->has_field()) {
-      auto cls = type_class(insn->get_field()->get_class());
-      if (cls != nullptr && !cls->is_external()) {
-        set_public(cls);
-      }
       auto field =
           resolve_field(insn->get_field(), is_sfield_op(insn->opcode())
               ? FieldSearch::Static : FieldSearch::Instance);
       if (field != nullptr && field->is_concrete()) {
-        set_public(field);
-        set_public(type_class(field->get_class()));
-        // FIXME no point in rewriting opcodes in the method
         insn->set_field(field);
       }
     } else if (insn->has_method()) {
-      auto cls = type_class(insn->get_method()->get_class());
-      if (cls != nullptr && !cls->is_external()) {
-        set_public(cls);
-      }
       auto current_method = resolve_method(
           insn->get_method(), opcode_to_search(insn));
       if (current_method != nullptr && current_method->is_concrete()) {
-        set_public(current_method);
-        set_public(type_class(current_method->get_class()));
-        // FIXME no point in rewriting opcodes in the method
         insn->set_method(current_method);
       }
-    } else if (insn->has_type()) {
-      auto type = insn->get_type();
-      auto cls = type_class(type);
-      if (cls != nullptr && !cls->is_external()) {
-        set_public(cls);
-      }
     }
     return editable_cfg_adapter::LOOP_CONTINUE;
   });
 
-  std::vector<DexType*> types;
-  method->get_code()->gather_catch_types(types);
-  for (auto type : types) {
+  get_visibility_changes(method).apply();
+}
+
+VisibilityChanges get_visibility_changes(DexMethod* method) {
+  auto code = method->get_code();
+  always_assert(code != nullptr);
+
+  VisibilityChanges changes;
+  auto add_class = [&changes](DexType* type) {
     auto cls = type_class(type);
     if (cls != nullptr && !cls->is_external()) {
-      set_public(cls);
+      changes.classes.insert(cls);
+    }
+  };
+  editable_cfg_adapter::iterate(code, [&](MethodItemEntry* mie) {
+    auto insn = mie->insn;
+
+    if (insn->has_field()) {
+      add_class(insn->get_field()->get_class());
+      auto field =
+          resolve_field(insn->get_field(), is_sfield_op(insn->opcode())
+              ? FieldSearch::Static : FieldSearch::Instance);
+      if (field != nullptr && field->is_concrete()) {
+        changes.fields.insert(field);
+        add_class(field->get_class());
+      }
+    } else if (insn->has_method()) {
+      add_class(insn->get_method()->get_class());
+      auto current_method = resolve_method(
+          insn->get_method(), opcode_to_search(insn));
+      if (current_method != nullptr && current_method->is_concrete()) {
+        changes.methods.insert(current_method);
+        add_class(current_method->get_class());
+      }
+    } else if (insn->has_type()) {
+      add_class(insn->get_type());
     }
+    return editable_cfg_adapter::LOOP_CONTINUE;
+  });
+
+  std::vector<DexType*> types;
+  code->gather_catch_types(types);
+  for (auto type : types) {
+    add_class(type);
+  }
+  return changes;
+}
+
+void VisibilityChanges::apply() const {
+  for (auto cls : classes) {
+    set_public(cls);
+  }
+  for (auto field : fields) {
+    set_public(field);
+  }
+  for (auto method : methods) {
+    set_public(method);
   }
 }
 
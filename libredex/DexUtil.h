@@ -265,6 +265,21 @@ bool is_subclass(const DexType* parent, const DexType* child);
  */
 void change_visibility(DexMethod* method);
 
+/**
+ * What change_visibility() would make public for a method, gathered without
+ * changing anything, so that it can be applied later, e.g. only once the code
+ * of the method has been inlined. Does not rewrite the references of the code
+ * to the definitions they resolve to.
+ */
+struct VisibilityChanges {
+  std::unordered_set<DexClass*> classes;
+  std::unordered_set<DexField*> fields;
+  std::unordered_set<DexMethod*> methods;
+
+  void apply() const;
+};
+VisibilityChanges get_visibility_changes(DexMethod* method);
+
 /**
  * NOTE: Only relocates the method. Doesn't check the correctness here,
  *       nor does it make sure that the members are accessible from the
@@ -429,6 +444,9 @@ struct dex_stats_t {
   int num_type_lists = 0;
   int num_bytes = 0;
   int num_instructions = 0;
+  // The number of 4KB pages of string data, class data and code items that
+  // startup touches, according to the coldstart list and method profiles.
+  int num_startup_pages = 0;
 };
 
 dex_stats_t&
@@ -7,8 +7,10 @@
 
 #include "FieldOpTracker.h"
 
+#include "IRCode.h"
 #include "Resolver.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace field_op_tracker {
 
@@ -17,17 +19,22 @@ bool is_own_init(DexField* field, const DexMethod* method) {
          method->get_class() == field->get_class();
 }
 
-FieldStatsMap analyze(const Scope& scope) {
+FieldStatsMap analyze(const DexMethod* method) {
   FieldStatsMap field_stats;
+  auto code = method->get_code();
+  if (code == nullptr) {
+    return field_stats;
+  }
   // Gather the read/write counts.
-  walk::opcodes(scope, [&](const DexMethod* method, const IRInstruction* insn) {
+  for (const auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
     auto op = insn->opcode();
     if (!insn->has_field()) {
-      return;
+      continue;
     }
     auto field = resolve_field(insn->get_field());
     if (field == nullptr) {
-      return;
+      continue;
     }
     if (is_sget(op) || is_iget(op)) {
       ++field_stats[field].reads;
@@ -37,8 +44,77 @@ FieldStatsMap analyze(const Scope& scope) {
     } else if (is_sput(op) || is_iput(op)) {
       ++field_stats[field].writes;
     }
-  });
+  }
   return field_stats;
 }
 
+FieldStatsMap analyze(const Scope& scope) {
+  return walk::parallel::reduce_methods<FieldStatsMap>(
+      scope,
+      [](DexMethod* method) { return analyze(method); },
+      [](FieldStatsMap left, FieldStatsMap right) {
+        if (left.size() < right.size()) {
+          std::swap(left, right);
+        }
+        for (const auto& pair : right) {
+          left[pair.first] += pair.second;
+        }
+        return left;
+      });
+}
+
+FieldStatsTracker::FieldStatsTracker(const Scope& scope) {
+  // Create the entries up front, so that the parallel scan only writes to
+  // existing values.
+  walk::code(scope, [&](const DexMethod* method, const IRCode&) {
+    m_method_stats[method];
+  });
+  auto wq = workqueue_foreach<const DexMethod*>(
+      [&](const DexMethod* method) {
+        m_method_stats.at(method) = analyze(method);
+      });
+  for (const auto& pair : m_method_stats) {
+    wq.add_item(pair.first);
+  }
+  wq.run_all();
+  for (const auto& pair : m_method_stats) {
+    add(pair.second);
+  }
+}
+
+void FieldStatsTracker::recount(
+    const std::vector<const DexMethod*>& changed_methods) {
+  std::vector<FieldStatsMap> new_stats(changed_methods.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    new_stats[i] = analyze(changed_methods[i]);
+  });
+  for (size_t i = 0; i < changed_methods.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+  for (size_t i = 0; i < changed_methods.size(); ++i) {
+    auto& method_stats = m_method_stats[changed_methods[i]];
+    remove(method_stats);
+    method_stats = std::move(new_stats[i]);
+    add(method_stats);
+  }
+}
+
+void FieldStatsTracker::add(const FieldStatsMap& method_stats) {
+  for (const auto& pair : method_stats) {
+    m_field_stats[pair.first] += pair.second;
+  }
+}
+
+void FieldStatsTracker::remove(const FieldStatsMap& method_stats) {
+  for (const auto& pair : method_stats) {
+    auto it = m_field_stats.find(pair.first);
+    it->second -= pair.second;
+    // Fields that are no longer referenced are left out, as in analyze().
+    if (it->second.empty()) {
+      m_field_stats.erase(it);
+    }
+  }
+}
+
 } // namespace field_op_tracker
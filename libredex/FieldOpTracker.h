@@ -10,6 +10,7 @@
 #include "DexClass.h"
 
 #include <unordered_map>
+#include <vector>
 
 namespace field_op_tracker {
 
@@ -21,10 +22,55 @@ struct FieldStats {
   size_t reads_outside_init{0};
   // Number of instructions which write a field in the entire program.
   size_t writes{0};
+
+  FieldStats& operator+=(const FieldStats& that) {
+    reads += that.reads;
+    reads_outside_init += that.reads_outside_init;
+    writes += that.writes;
+    return *this;
+  }
+
+  FieldStats& operator-=(const FieldStats& that) {
+    reads -= that.reads;
+    reads_outside_init -= that.reads_outside_init;
+    writes -= that.writes;
+    return *this;
+  }
+
+  bool empty() const {
+    return reads == 0 && reads_outside_init == 0 && writes == 0;
+  }
 };
 
 using FieldStatsMap = std::unordered_map<DexField*, FieldStats>;
 
+// The counts of the instructions of a single method.
+FieldStatsMap analyze(const DexMethod* method);
+
+// The counts of the whole scope. Methods are scanned in parallel.
 FieldStatsMap analyze(const Scope& scope);
 
-}
+/*
+ * The counts of a scope that is being modified. The counts of each method are
+ * kept, so that after some methods changed, only those need to be scanned
+ * again to bring the totals up to date.
+ */
+class FieldStatsTracker {
+ public:
+  explicit FieldStatsTracker(const Scope& scope);
+
+  const FieldStatsMap& field_stats() const { return m_field_stats; }
+
+  // Scans the given methods again. They may have gained or lost their code,
+  // and methods that weren't in the scope are added to it.
+  void recount(const std::vector<const DexMethod*>& changed_methods);
+
+ private:
+  void add(const FieldStatsMap& method_stats);
+  void remove(const FieldStatsMap& method_stats);
+
+  std::unordered_map<const DexMethod*, FieldStatsMap> m_method_stats;
+  FieldStatsMap m_field_stats;
+};
+
+} // namespace field_op_tracker
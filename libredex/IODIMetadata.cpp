@@ -11,6 +11,7 @@
 #include "DexAccess.h"
 #include "DexUtil.h"
 #include "IRCode.h"
+#include "Parallel.h"
 #include "Resolver.h"
 #include "Trace.h"
 #include "Walkers.h"
@@ -96,19 +97,18 @@ void emplace_warning_existence(T& map,
 }
 } // namespace
 
-void IODIMetadata::emplace_entry(const std::string& key,
+void IODIMetadata::emplace_entry(std::string key,
                                  const DexMethod* method,
                                  bool allow_collision) {
+  emplace_warning_existence(m_pretty_map, method, key);
   auto iter = m_entries.find(key);
   auto end = m_entries.end();
   always_assert(allow_collision || iter == end);
   if (iter == end) {
     TRACE(IODI, 6, "[IODI] Found 1 %s\n", key.c_str());
-    m_entries.emplace(key, method);
-    emplace_warning_existence(m_pretty_map, method, key);
+    m_entries.emplace(std::move(key), method);
   } else {
     iter->second.push_back(method);
-    emplace_warning_existence(m_pretty_map, method, key);
   }
 }
 
@@ -204,22 +204,51 @@ void IODIMetadata::mark_and_rename_methods(DexStoresVector& scope) {
   // (method_id, insn_offset) -> line_offset (and eventually line offset maps
   // to (file, line number)).
   //
-  // We do this linearly for now because otherwise we need locks
   for (auto& store : scope) {
     for (auto& classes : store.get_dexen()) {
-      for (auto& cls : classes) {
-        m_scope.push_back(cls);
-        auto pretty_prefix = pretty_prefix_for_cls(cls);
-        // First we need to mark all entries...
-        for (DexMethod* m : cls->get_dmethods()) {
-          emplace_entry(pretty_prefix + m->str(), m);
-        }
-        for (DexMethod* m : cls->get_vmethods()) {
-          emplace_entry(pretty_prefix + m->str(), m);
-        }
-      }
+      m_scope.insert(m_scope.end(), classes.begin(), classes.end());
     }
   }
+  // Building the external names is the expensive part, and each class can do
+  // it independently. The entries are then marked in scope order, so that
+  // duplicates end up in the same order as if this was done linearly.
+  struct PrettyNames {
+    const DexClass* cls;
+    std::vector<std::pair<std::string, const DexMethod*>> names;
+  };
+  std::vector<PrettyNames> pretty_names;
+  pretty_names.reserve(m_scope.size());
+  for (auto cls : m_scope) {
+    pretty_names.push_back({cls, {}});
+  }
+  parallel_for(pretty_names.begin(), pretty_names.end(),
+               [](PrettyNames& pretty) {
+                 auto cls = pretty.cls;
+                 auto pretty_prefix = pretty_prefix_for_cls(cls);
+                 auto& names = pretty.names;
+                 names.reserve(cls->get_dmethods().size() +
+                               cls->get_vmethods().size());
+                 for (DexMethod* m : cls->get_dmethods()) {
+                   names.emplace_back(pretty_prefix + m->str(), m);
+                 }
+                 for (DexMethod* m : cls->get_vmethods()) {
+                   names.emplace_back(pretty_prefix + m->str(), m);
+                 }
+               });
+  size_t n_methods = 0;
+  for (const auto& pretty : pretty_names) {
+    n_methods += pretty.names.size();
+  }
+  // m_entries isn't reserved: its iteration order decides which renames win
+  // and the order of the metadata file, so it grows as it always has.
+  m_pretty_map.reserve(n_methods);
+  // First we need to mark all entries...
+  for (auto& pretty : pretty_names) {
+    for (auto& name : pretty.names) {
+      emplace_entry(std::move(name.first), name.second);
+    }
+    pretty.names = {};
+  }
   // Then we can try to rename everything. Secondary dictionary so we don't
   // mutate m_entries while iterating over it.
   EntryMap new_entries;
@@ -484,7 +513,6 @@ void IODIMetadata::write(
   uint32_t single_count = 0;
   uint32_t dup_count = 0;
 
-  std::ostringstream dofs;
   struct __attribute__((__packed__)) SingleEntryHeader {
     uint16_t klen;
     uint64_t method_id;
@@ -500,71 +528,77 @@ void IODIMetadata::write(
   size_t dup_meth_with_dbg_count_not_emitted = 0;
   size_t dup_meth_with_dbg_count_emitted = 0;
 
+  // The single entries come first, so the duplicates are written by a second
+  // pass over the entries instead of being buffered.
   for (const auto& it : m_entries) {
     if (it.second.is_duplicate()) {
-      always_assert(it.second.size() > 1);
-      // Skip if this isn't a method that's safe to use IODI with.
-      const auto& caller_map = it.second.get_caller_map();
-      size_t mids_count = caller_map.size();
-      if (!can_safely_use_iodi(caller_map.begin()->first)) {
-        dup_meth_count_not_emitted += mids_count;
-        for (auto& caller_it : caller_map) {
-          const DexMethod* callee = caller_it.first;
-          const auto dc = callee->get_dex_code();
-          if (dc != nullptr && dc->get_debug_item() != nullptr) {
-            dup_meth_with_dbg_count_not_emitted += 1;
-          }
-        }
-        continue;
-      }
-      dup_meth_count_emitted += mids_count;
-      dup_count += 1;
-      always_assert_log(dup_count != 0, "Too many dups found, overflowed");
-      always_assert(it.first.size() < UINT16_MAX);
-      deh.klen = it.first.size();
-      always_assert(mids_count < UINT32_MAX);
-      deh.count = mids_count;
-      dofs.write((const char*)&deh, sizeof(DupEntryHeader));
-      dofs << it.first;
-      for (const auto& caller_it : caller_map) {
+      continue;
+    }
+    single_count += 1;
+    always_assert_log(single_count != 0, "Too many sgls found, overflowed");
+    always_assert(it.first.size() < UINT16_MAX);
+    seh.klen = it.first.size();
+    seh.method_id =
+        method_to_id.at(const_cast<DexMethod*>(it.second.get_method()));
+    ofs.write((const char*)&seh, sizeof(SingleEntryHeader));
+    ofs << it.first;
+  }
+  for (const auto& it : m_entries) {
+    if (!it.second.is_duplicate()) {
+      continue;
+    }
+    always_assert(it.second.size() > 1);
+    // Skip if this isn't a method that's safe to use IODI with.
+    const auto& caller_map = it.second.get_caller_map();
+    size_t mids_count = caller_map.size();
+    if (!can_safely_use_iodi(caller_map.begin()->first)) {
+      dup_meth_count_not_emitted += mids_count;
+      for (auto& caller_it : caller_map) {
         const DexMethod* callee = caller_it.first;
         const auto dc = callee->get_dex_code();
         if (dc != nullptr && dc->get_debug_item() != nullptr) {
-          dup_meth_with_dbg_count_emitted += 1;
-        }
-        always_assert(caller_it.second.size() < UINT32_MAX);
-        struct __attribute__((__packed__)) CallerMappingHeader {
-          uint64_t method_id;
-          uint32_t count;
-        } mapping_hdr = {
-            .method_id = method_to_id.at(const_cast<DexMethod*>(callee)),
-            .count = static_cast<uint32_t>(caller_it.second.size()),
-        };
-        dofs.write((const char*)&mapping_hdr, sizeof(CallerMappingHeader));
-        struct __attribute__((__packed__)) Callsite {
-          uint64_t method_id;
-          uint16_t pc;
-        } callsite;
-        for (const auto& caller : caller_it.second) {
-          callsite.method_id =
-              method_to_id.at(const_cast<DexMethod*>(caller.method));
-          always_assert(caller.pc < UINT16_MAX);
-          callsite.pc = caller.pc;
-          dofs.write((const char*)&callsite, sizeof(Callsite));
+          dup_meth_with_dbg_count_not_emitted += 1;
         }
       }
-    } else {
-      single_count += 1;
-      always_assert_log(single_count != 0, "Too many sgls found, overflowed");
-      always_assert(it.first.size() < UINT16_MAX);
-      seh.klen = it.first.size();
-      seh.method_id =
-          method_to_id.at(const_cast<DexMethod*>(it.second.get_method()));
-      ofs.write((const char*)&seh, sizeof(SingleEntryHeader));
-      ofs << it.first;
+      continue;
+    }
+    dup_meth_count_emitted += mids_count;
+    dup_count += 1;
+    always_assert_log(dup_count != 0, "Too many dups found, overflowed");
+    always_assert(it.first.size() < UINT16_MAX);
+    deh.klen = it.first.size();
+    always_assert(mids_count < UINT32_MAX);
+    deh.count = mids_count;
+    ofs.write((const char*)&deh, sizeof(DupEntryHeader));
+    ofs << it.first;
+    for (const auto& caller_it : caller_map) {
+      const DexMethod* callee = caller_it.first;
+      const auto dc = callee->get_dex_code();
+      if (dc != nullptr && dc->get_debug_item() != nullptr) {
+        dup_meth_with_dbg_count_emitted += 1;
+      }
+      always_assert(caller_it.second.size() < UINT32_MAX);
+      struct __attribute__((__packed__)) CallerMappingHeader {
+        uint64_t method_id;
+        uint32_t count;
+      } mapping_hdr = {
+          .method_id = method_to_id.at(const_cast<DexMethod*>(callee)),
+          .count = static_cast<uint32_t>(caller_it.second.size()),
+      };
+      ofs.write((const char*)&mapping_hdr, sizeof(CallerMappingHeader));
+      struct __attribute__((__packed__)) Callsite {
+        uint64_t method_id;
+        uint16_t pc;
+      } callsite;
+      for (const auto& caller : caller_it.second) {
+        callsite.method_id =
+            method_to_id.at(const_cast<DexMethod*>(caller.method));
+        always_assert(caller.pc < UINT16_MAX);
+        callsite.pc = caller.pc;
+        ofs.write((const char*)&callsite, sizeof(Callsite));
+      }
     }
   }
-  ofs << dofs.str();
   // Rewind and write the header now that we know single/dup counts
   ofs.seekp(0);
   Header header = {.magic = 0xfaceb001,
@@ -110,7 +110,7 @@ class IODIMetadata {
   // This will properly push_back a duplicate if method is a duplicate and
   // allow_collision is true. If allow collision is false and there is a
   // collision then will assert.
-  void emplace_entry(const std::string& key,
+  void emplace_entry(std::string key,
                      const DexMethod* method,
                      bool allow_collision = true);
   // This tries to rename all of the duplicates in old_entry, fills new_entries
@@ -123,8 +123,8 @@ s_expr _to_s_expr(const DexPosition* pos, uint32_t idx, uint32_t parent_idx) {
   auto parent_idx_str = get_dbg_label(parent_idx);
   return s_expr({
       s_expr(".pos:" + idx_str),
-      s_expr(show(pos->method)),
-      s_expr(pos->file->c_str()),
+      s_expr(show(pos->method())),
+      s_expr(pos->file()->c_str()),
       s_expr(std::to_string(pos->line)),
       s_expr(parent_idx_str),
   });
@@ -158,8 +158,8 @@ std::vector<s_expr> to_s_exprs(
     auto idx_str = get_dbg_label(positions_emitted->size() - 1);
     return {s_expr({
         s_expr(".pos:" + idx_str),
-        s_expr(show(pos->method)),
-        s_expr(pos->file->c_str()),
+        s_expr(show(pos->method())),
+        s_expr(pos->file()->c_str()),
         s_expr(std::to_string(pos->line)),
     })};
   }
@@ -279,10 +279,10 @@ std::unique_ptr<DexPosition> position_from_s_expr(
       s_patn(&file_str),
       s_patn(&line_str),
   }, parent_expr).must_match(e, "Expected 3 or 4 args for position directive");
+  // Positions may name methods that are not concrete, e.g. ones inlined from
+  // elsewhere. Every method ref is a DexMethod object, so the cast is safe.
   auto* dex_method =
       static_cast<DexMethod*>(DexMethod::make_method(method_str));
-  // We should ideally allow DexPosition to take non-concrete methods too...
-  always_assert(dex_method->is_concrete());
   auto* file = DexString::make_string(file_str);
   uint32_t line;
   std::istringstream in(line_str);
@@ -549,6 +549,22 @@ static boost::optional<uint16_t> largest_reg_operand(const IRInstruction* insn)
   return max_reg;
 }
 
+bool can_express(const IRCode* code) {
+  if (code->editable_cfg_built()) {
+    return false;
+  }
+  for (const auto& mie : *code) {
+    if (mie.type == MFLOW_DEBUG || mie.type == MFLOW_DEX_OPCODE) {
+      return false;
+    }
+    if (mie.type == MFLOW_OPCODE &&
+        opcode::ref(mie.insn->opcode()) == opcode::Ref::Data) {
+      return false;
+    }
+  }
+  return true;
+}
+
 std::unique_ptr<IRCode> ircode_from_s_expr(const s_expr& e) {
   s_expr insns_expr;
   auto code = std::make_unique<IRCode>();
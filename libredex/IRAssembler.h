@@ -58,6 +58,11 @@ inline std::string to_string(const IRCode* code) {
   return to_s_expr(code).str();
 }
 
+// Whether the syntax above can express all of `code`. It can't express debug
+// entries, unconverted dex opcodes, fill-array-data payloads, or code held in
+// an editable CFG.
+bool can_express(const IRCode* code);
+
 std::unique_ptr<IRCode> ircode_from_s_expr(const sparta::s_expr&);
 
 std::unique_ptr<IRCode> ircode_from_string(const std::string&);
@@ -8,8 +8,6 @@
 #include "IRCode.h"
 
 #include <algorithm>
-#include <boost/bimap/bimap.hpp>
-#include <boost/bimap/unordered_set_of.hpp>
 #include <boost/numeric/conversion/cast.hpp>
 #include <memory>
 #include <unordered_set>
@@ -56,32 +54,67 @@ DexOpcode goto_for_offset(int32_t offset) {
 
 namespace {
 
-using namespace boost::bimaps;
+/*
+ * The MethodItemEntries of the instructions of a DexCode, and the addresses
+ * (in code units) at which the instructions start. The addresses are dense, so
+ * the entry at an address is found with a single indexed load.
+ */
+class EntryAddrMap {
+ public:
+  explicit EntryAddrMap(size_t num_insns) { m_entries.reserve(num_insns); }
+
+  void insert(MethodItemEntry* mei, uint32_t addr) {
+    set(mei, addr);
+    m_entries.emplace_back(mei, addr);
+  }
 
-struct Entry {};
-struct Addr {};
+  // The address just past the last instruction, which maps to the end of the
+  // IRList.
+  void set_end(MethodItemEntry* mei, uint32_t addr) { set(mei, addr); }
 
-typedef bimap<tagged<MethodItemEntry*, Entry>,
-              unordered_set_of<tagged<uint32_t, Addr>>>
-    EntryAddrBiMap;
+  bool contains(uint32_t addr) const {
+    return addr < m_entry_at.size() && m_entry_at[addr] != nullptr;
+  }
+
+  MethodItemEntry* at(uint32_t addr) const {
+    always_assert_log(contains(addr), "No instruction at address %08x\n",
+                      addr);
+    return m_entry_at[addr];
+  }
+
+  // The instructions' entries and addresses, in address order.
+  const std::vector<std::pair<MethodItemEntry*, uint32_t>>& entries() const {
+    return m_entries;
+  }
+
+ private:
+  void set(MethodItemEntry* mei, uint32_t addr) {
+    if (addr >= m_entry_at.size()) {
+      m_entry_at.resize(addr + 1, nullptr);
+    }
+    m_entry_at[addr] = mei;
+  }
+
+  std::vector<MethodItemEntry*> m_entry_at;
+  std::vector<std::pair<MethodItemEntry*, uint32_t>> m_entries;
+};
 
 } // namespace
 
-static MethodItemEntry* get_target(
-    const MethodItemEntry* mei,
-    const EntryAddrBiMap& bm) {
-  uint32_t base = bm.by<Entry>().at(const_cast<MethodItemEntry*>(mei));
+static MethodItemEntry* get_target(const MethodItemEntry* mei,
+                                   uint32_t base,
+                                   const EntryAddrMap& bm) {
   int offset = mei->dex_insn->offset();
   uint32_t target = base + offset;
   always_assert_log(
-      bm.by<Addr>().count(target) != 0,
+      bm.contains(target),
       "Invalid opcode target %08x[%p](%08x) %08x in get_target %s\n",
       base,
       mei,
       offset,
       target,
       SHOW(mei->insn));
-  return bm.by<Addr>().at(target);
+  return bm.at(target);
 }
 
 static void insert_branch_target(IRList* ir,
@@ -193,16 +226,16 @@ static int32_t read_int32(const uint16_t*& data) {
 static void shard_multi_target(IRList* ir,
                                DexOpcodeData* fopcode,
                                MethodItemEntry* src,
-                               const EntryAddrBiMap& bm) {
+                               uint32_t base,
+                               const EntryAddrMap& bm) {
   const uint16_t* data = fopcode->data();
   uint16_t entries = *data++;
   auto ftype = fopcode->opcode();
-  uint32_t base = bm.by<Entry>().at(src);
   if (ftype == FOPCODE_PACKED_SWITCH) {
     int32_t case_key = read_int32(data);
     for (int i = 0; i < entries; i++) {
       uint32_t targetaddr = base + read_int32(data);
-      auto target = bm.by<Addr>().at(targetaddr);
+      auto target = bm.at(targetaddr);
       insert_multi_branch_target(ir, case_key, target, src);
       case_key++;
     }
@@ -211,7 +244,7 @@ static void shard_multi_target(IRList* ir,
     for (int i = 0; i < entries; i++) {
       int32_t case_key = read_int32(data);
       uint32_t targetaddr = base + read_int32(tdata);
-      auto target = bm.by<Addr>().at(targetaddr);
+      auto target = bm.at(targetaddr);
       insert_multi_branch_target(ir, case_key, target, src);
     }
   } else {
@@ -221,21 +254,21 @@ static void shard_multi_target(IRList* ir,
 
 static void generate_branch_targets(
     IRList* ir,
-    const EntryAddrBiMap& bm,
+    const EntryAddrMap& bm,
     const std::unordered_map<MethodItemEntry*, DexOpcodeData*>& entry_to_data) {
-  for (auto miter = ir->begin(); miter != ir->end(); ++miter) {
-    MethodItemEntry* mentry = &*miter;
+  for (const auto& entry_addr : bm.entries()) {
+    MethodItemEntry* mentry = entry_addr.first;
     if (mentry->type == MFLOW_DEX_OPCODE) {
       auto insn = mentry->dex_insn;
       if (dex_opcode::is_branch(insn->opcode())) {
         if (dex_opcode::is_switch(insn->opcode())) {
-          auto* fopcode_entry = get_target(mentry, bm);
+          auto* fopcode_entry = get_target(mentry, entry_addr.second, bm);
           auto* fopcode = entry_to_data.at(fopcode_entry);
-          shard_multi_target(ir, fopcode, mentry, bm);
+          shard_multi_target(ir, fopcode, mentry, entry_addr.second, bm);
           delete fopcode;
           // TODO: erase fopcode from map
         } else {
-          auto target = get_target(mentry, bm);
+          auto target = get_target(mentry, entry_addr.second, bm);
           insert_branch_target(ir, target, mentry);
         }
       }
@@ -245,9 +278,9 @@ static void generate_branch_targets(
 
 static void associate_debug_entries(IRList* ir,
                                     DexDebugItem& dbg,
-                                    const EntryAddrBiMap& bm) {
+                                    const EntryAddrMap& bm) {
   for (auto& entry : dbg.get_entries()) {
-    auto insert_point = bm.by<Addr>().at(entry.addr);
+    auto insert_point = bm.at(entry.addr);
     MethodItemEntry* mentry;
     switch (entry.type) {
       case DexDebugEntryType::Instruction:
@@ -265,7 +298,7 @@ static void associate_debug_entries(IRList* ir,
 // Insert MFLOW_TRYs and MFLOW_CATCHes
 static void associate_try_items(IRList* ir,
                                 DexCode& code,
-                                const EntryAddrBiMap& bm) {
+                                const EntryAddrMap& bm) {
   // We insert the catches after the try markers to handle the case where the
   // try block ends on the same instruction as the beginning of the catch block.
   // We need to end the try block before we start the catch block, not vice
@@ -279,7 +312,7 @@ static void associate_try_items(IRList* ir,
     MethodItemEntry* catch_start = nullptr;
     CatchEntry* last_catch = nullptr;
     for (const auto& catz : tri->m_catches) {
-      auto catzop = bm.by<Addr>().at(catz.second);
+      auto catzop = bm.at(catz.second);
       TRACE(MTRANS, 3, "try_catch %08x mei %p\n", catz.second, catzop);
       auto catch_mie = new MethodItemEntry(catz.first);
       catch_start = catch_start == nullptr ? catch_mie : catch_start;
@@ -291,12 +324,12 @@ static void associate_try_items(IRList* ir,
       catches_to_insert.emplace_back(catzop, catch_mie);
     }
 
-    auto begin = bm.by<Addr>().at(tri->m_start_addr);
+    auto begin = bm.at(tri->m_start_addr);
     TRACE(MTRANS, 3, "try_start %08x mei %p\n", tri->m_start_addr, begin);
     auto try_start = new MethodItemEntry(TRY_START, catch_start);
     ir->insert_before(ir->iterator_to(*begin), *try_start);
     uint32_t lastaddr = tri->m_start_addr + tri->m_insn_count;
-    auto end = bm.by<Addr>().at(lastaddr);
+    auto end = bm.at(lastaddr);
     TRACE(MTRANS, 3, "try_end %08x mei %p\n", lastaddr, end);
     auto try_end = new MethodItemEntry(TRY_END, catch_start);
     ir->insert_before(ir->iterator_to(*end), *try_end);
@@ -319,7 +352,7 @@ static void associate_try_items(IRList* ir,
 void generate_load_params(const DexMethod* method,
                           size_t temp_regs,
                           IRCode* code) {
-  auto args = method->get_proto()->get_args()->get_type_list();
+  const auto& args = method->get_proto()->get_args()->get_type_list();
   auto param_reg = temp_regs;
   if (!is_static(method)) {
     auto insn = new IRInstruction(IOPCODE_LOAD_PARAM_OBJECT);
@@ -345,9 +378,10 @@ void generate_load_params(const DexMethod* method,
 
 void translate_dex_to_ir(
     IRList* ir_list,
-    const EntryAddrBiMap& bm,
+    const EntryAddrMap& bm,
     const std::unordered_map<MethodItemEntry*, DexOpcodeData*>& entry_to_data) {
-  for (auto it = ir_list->begin(); it != ir_list->end(); ++it) {
+  for (const auto& entry_addr : bm.entries()) {
+    auto it = ir_list->iterator_to(*entry_addr.first);
     if (it->type != MFLOW_DEX_OPCODE) {
       continue;
     }
@@ -401,7 +435,8 @@ void translate_dex_to_ir(
     } else if (dex_opcode::has_literal(dex_op)) {
       insn->set_literal(dex_insn->get_literal());
     } else if (op == OPCODE_FILL_ARRAY_DATA) {
-      insn->set_data(entry_to_data.at(get_target(&*it, bm)));
+      insn->set_data(
+          entry_to_data.at(get_target(&*it, entry_addr.second, bm)));
     }
 
     insn->normalize_registers();
@@ -409,8 +444,8 @@ void translate_dex_to_ir(
     it->type = MFLOW_OPCODE;
     it->insn = insn;
     if (move_result_pseudo != nullptr) {
-      it = ir_list->insert_before(std::next(it),
-                           *(new MethodItemEntry(move_result_pseudo)));
+      ir_list->insert_before(std::next(it),
+                             *(new MethodItemEntry(move_result_pseudo)));
     }
   }
 }
@@ -420,7 +455,7 @@ void balloon(DexMethod* method, IRList* ir_list) {
   auto instructions = dex_code->release_instructions();
   // This is a 1-to-1 map between MethodItemEntries of type MFLOW_OPCODE and
   // address offsets.
-  EntryAddrBiMap bm;
+  EntryAddrMap bm(instructions->size());
   std::unordered_map<MethodItemEntry*, DexOpcodeData*> entry_to_data;
 
   uint32_t addr = 0;
@@ -439,11 +474,11 @@ void balloon(DexMethod* method, IRList* ir_list) {
       mei = new MethodItemEntry(insn);
     }
     ir_list->push_back(*mei);
-    bm.insert(EntryAddrBiMap::relation(mei, addr));
+    bm.insert(mei, addr);
     TRACE(MTRANS, 5, "%08x: %s[mei %p]\n", addr, SHOW(insn), mei);
     addr += insn->size();
   }
-  bm.insert(EntryAddrBiMap::relation(&*ir_list->end(), addr));
+  bm.set_end(&*ir_list->end(), addr);
 
   generate_branch_targets(ir_list, bm, entry_to_data);
   associate_try_items(ir_list, *dex_code, bm);
@@ -585,13 +620,16 @@ IRCode::IRCode(const IRCode& code) {
 }
 
 void IRCode::build_cfg(bool editable) {
+  if (m_keep_cfg && editable_cfg_built()) {
+    return;
+  }
   clear_cfg();
   m_cfg = std::make_unique<cfg::ControlFlowGraph>(
       m_ir_list, m_registers_size, editable);
 }
 
 void IRCode::clear_cfg() {
-  if (!m_cfg) {
+  if (!m_cfg || (m_keep_cfg && m_cfg->editable())) {
     return;
   }
 
@@ -614,6 +652,17 @@ bool IRCode::editable_cfg_built() const {
   return m_cfg != nullptr && m_cfg->editable();
 }
 
+size_t IRCode::estimate_size() const {
+  if (!editable_cfg_built()) {
+    return m_ir_list->size();
+  }
+  size_t size = 0;
+  for (const auto* block : m_cfg->blocks()) {
+    size += block->num_entries();
+  }
+  return size;
+}
+
 namespace {
 
 using RegMap = transform::RegMap;
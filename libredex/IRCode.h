@@ -41,6 +41,7 @@ class IRCode {
 
   IRList* m_ir_list;
   std::unique_ptr<cfg::ControlFlowGraph> m_cfg;
+  bool m_keep_cfg{false};
 
   uint16_t m_registers_size{0};
   // TODO(jezng): we shouldn't be storing / exposing the DexDebugItem... just
@@ -167,6 +168,11 @@ class IRCode {
 
   bool editable_cfg_built() const;
 
+  // While set, build_cfg reuses an editable CFG that is already built, and
+  // clear_cfg leaves an editable CFG in place. Used by the PassManager to keep
+  // CFGs alive across passes; see Pass::is_cfg_friendly().
+  void set_keep_cfg(bool keep) { m_keep_cfg = keep; }
+
   /* Generate DexCode from IRCode */
   std::unique_ptr<DexCode> sync(const DexMethod*);
 
@@ -270,6 +276,13 @@ class IRCode {
    */
   size_t count_opcodes() const { return m_ir_list->count_opcodes(); }
 
+  /*
+   * Returns the number of MethodItemEntries, whether they live in the IRList
+   * or in the blocks of an editable CFG. This is a cheap stand-in for
+   * count_opcodes() when only a rough measure of size is needed.
+   */
+  size_t estimate_size() const;
+
   void sanity_check() const { m_ir_list->sanity_check(); }
 
   IRList::iterator begin() { return m_ir_list->begin(); }
@@ -7,6 +7,9 @@
 
 #include "IRInstruction.h"
 
+#include <algorithm>
+#include <limits>
+
 #include "DexClass.h"
 #include "DexUtil.h"
 
@@ -23,7 +26,45 @@ DexOpcode convert_3to2addr(DexOpcode op) {
 }
 
 IRInstruction::IRInstruction(IROpcode op) : m_opcode(op) {
-  m_srcs.resize(opcode_impl::min_srcs_size(op));
+  set_srcs_size(opcode_impl::min_srcs_size(op));
+}
+
+IRInstruction::IRInstruction(const IRInstruction& that)
+    : m_opcode(that.m_opcode), m_dest(that.m_dest), m_literal(that.m_literal) {
+  set_srcs_size(that.m_num_srcs);
+  std::copy(that.srcs_data(), that.srcs_data() + m_num_srcs, srcs_data());
+}
+
+IRInstruction& IRInstruction::operator=(const IRInstruction& that) {
+  if (this != &that) {
+    m_opcode = that.m_opcode;
+    m_dest = that.m_dest;
+    m_literal = that.m_literal;
+    set_srcs_size(that.m_num_srcs);
+    std::copy(that.srcs_data(), that.srcs_data() + m_num_srcs, srcs_data());
+  }
+  return *this;
+}
+
+void IRInstruction::set_srcs_size(size_t count) {
+  always_assert(count <= std::numeric_limits<uint16_t>::max());
+  size_t kept = std::min<size_t>(count, m_num_srcs);
+  if (count <= MAX_INLINE_SRCS) {
+    if (!srcs_inline()) {
+      uint16_t* heap_srcs = m_heap_srcs;
+      std::copy(heap_srcs, heap_srcs + kept, m_inline_srcs);
+      delete[] heap_srcs;
+    }
+    std::fill(m_inline_srcs + kept, m_inline_srcs + count, 0);
+  } else if (count != m_num_srcs) {
+    auto heap_srcs = new uint16_t[count]();
+    std::copy(srcs_data(), srcs_data() + kept, heap_srcs);
+    if (!srcs_inline()) {
+      delete[] m_heap_srcs;
+    }
+    m_heap_srcs = heap_srcs;
+  }
+  m_num_srcs = count;
 }
 
 // Structural equality of opcodes except branches offsets are ignored
@@ -31,7 +72,8 @@ IRInstruction::IRInstruction(IROpcode op) : m_opcode(op) {
 bool IRInstruction::operator==(const IRInstruction& that) const {
   return m_opcode == that.m_opcode &&
     m_string == that.m_string && // just test one member of the union
-    m_srcs == that.m_srcs &&
+    m_num_srcs == that.m_num_srcs &&
+    std::equal(srcs_data(), srcs_data() + m_num_srcs, that.srcs_data()) &&
     m_dest == that.m_dest &&
     m_literal == that.m_literal;
 }
@@ -104,7 +146,7 @@ bool IRInstruction::invoke_src_is_wide(size_t i) const {
     --i;
   }
 
-  const std::deque<DexType*>& args =
+  const auto& args =
       m_method->get_proto()->get_args()->get_type_list();
   return is_wide_type(args[i]);
 }
@@ -209,7 +251,8 @@ void IRInstruction::denormalize_registers() {
       }
     }
     if (has_wide) {
-      m_srcs = srcs;
+      set_srcs_size(srcs.size());
+      std::copy(srcs.begin(), srcs.end(), srcs_data());
     }
   }
 }
@@ -7,8 +7,11 @@
 
 #pragma once
 
+#include <boost/range/iterator_range.hpp>
+
 #include "DexInstruction.h"
 #include "Show.h"
+#include "SlabAllocator.h"
 
 /*
  * Our IR is very similar to the Dalvik instruction set, but with a few tweaks
@@ -108,6 +111,25 @@
 class IRInstruction final {
  public:
   explicit IRInstruction(IROpcode op);
+  IRInstruction(const IRInstruction&);
+  IRInstruction& operator=(const IRInstruction&);
+  ~IRInstruction() {
+    if (!srcs_inline()) {
+      delete[] m_heap_srcs;
+    }
+  }
+
+  // Instructions are created and deleted in very large numbers, so they come
+  // from a per-thread slab allocator rather than malloc.
+  static void* operator new(size_t size) {
+    always_assert(size == sizeof(IRInstruction));
+    return SlabAllocator<sizeof(IRInstruction), alignof(IRInstruction)>::
+        allocate();
+  }
+  static void operator delete(void* ptr) {
+    SlabAllocator<sizeof(IRInstruction),
+                  alignof(IRInstruction)>::deallocate(ptr);
+  }
 
   /*
    * Ensures that wide registers only have their first register referenced
@@ -151,7 +173,11 @@ class IRInstruction final {
    */
   size_t dests_size() const { return opcode_impl::dests_size(m_opcode); }
 
-  size_t srcs_size() const { return m_srcs.size(); }
+  size_t srcs_size() const { return m_num_srcs; }
+  // The memory taken by source registers that don't fit in the instruction.
+  size_t srcs_heap_bytes() const {
+    return srcs_inline() ? 0 : m_num_srcs * sizeof(uint16_t);
+  }
 
   bool has_move_result_pseudo() const {
     return opcode_impl::has_move_result_pseudo(m_opcode);
@@ -194,9 +220,17 @@ class IRInstruction final {
     always_assert_log(dests_size(), "No dest for %s", SHOW(m_opcode));
     return m_dest;
   }
-  uint16_t src(size_t i) const { return m_srcs.at(i); }
-  const std::vector<uint16_t>& srcs() const { return m_srcs; }
-  uint16_t arg_word_count() const { return m_srcs.size(); }
+  uint16_t src(size_t i) const {
+    always_assert(i < m_num_srcs);
+    return srcs_data()[i];
+  }
+  boost::iterator_range<const uint16_t*> srcs() const {
+    return {srcs_data(), srcs_data() + m_num_srcs};
+  }
+  std::vector<uint16_t> srcs_vec() const {
+    return {srcs_data(), srcs_data() + m_num_srcs};
+  }
+  uint16_t arg_word_count() const { return m_num_srcs; }
 
   /*
    * Setters for logical parts of the instruction.
@@ -211,11 +245,12 @@ class IRInstruction final {
     return this;
   }
   IRInstruction* set_src(size_t i, uint16_t vreg) {
-    m_srcs.at(i) = vreg;
+    always_assert(i < m_num_srcs);
+    srcs_data()[i] = vreg;
     return this;
   }
   IRInstruction* set_arg_word_count(uint16_t count) {
-    m_srcs.resize(count);
+    set_srcs_size(count);
     return this;
   }
 
@@ -313,9 +348,26 @@ class IRInstruction final {
   uint64_t hash();
 
  private:
+  // Up to this many source registers are stored in the instruction itself,
+  // which covers every opcode except range invokes. Longer lists go into a
+  // separate array.
+  static constexpr size_t MAX_INLINE_SRCS = dex_opcode::NON_RANGE_MAX;
+
+  bool srcs_inline() const { return m_num_srcs <= MAX_INLINE_SRCS; }
+  const uint16_t* srcs_data() const {
+    return srcs_inline() ? m_inline_srcs : m_heap_srcs;
+  }
+  uint16_t* srcs_data() { return srcs_inline() ? m_inline_srcs : m_heap_srcs; }
+  // Registers past the old size are set to zero.
+  void set_srcs_size(size_t count);
+
   IROpcode m_opcode;
-  std::vector<uint16_t> m_srcs;
+  uint16_t m_num_srcs{0};
   uint16_t m_dest{0};
+  union {
+    uint16_t m_inline_srcs[MAX_INLINE_SRCS];
+    uint16_t* m_heap_srcs;
+  };
   union {
     // Zero-initialize this union with the uint64_t member instead of a
     // pointer-type member so that it works properly even on 32-bit machines
@@ -14,6 +14,7 @@
 #include "DexClass.h"
 #include "DexDebugInstruction.h"
 #include "IRInstruction.h"
+#include "SlabAllocator.h"
 
 struct MethodItemEntry;
 
@@ -149,6 +150,17 @@ struct MethodItemEntry {
   MethodItemEntry() : type(MFLOW_FALLTHROUGH) {}
   ~MethodItemEntry();
 
+  // Like IRInstructions, entries come from a per-thread slab allocator.
+  static void* operator new(size_t size) {
+    always_assert(size == sizeof(MethodItemEntry));
+    return SlabAllocator<sizeof(MethodItemEntry),
+                         alignof(MethodItemEntry)>::allocate();
+  }
+  static void operator delete(void* ptr) {
+    SlabAllocator<sizeof(MethodItemEntry),
+                  alignof(MethodItemEntry)>::deallocate(ptr);
+  }
+
   /*
    * This should only ever be used by the instruction lowering step. Do NOT use
    * it in passes!
@@ -13,7 +13,7 @@
 
 namespace opcode {
 
-Ref ref(IROpcode opcode) {
+static constexpr Ref compute_ref(IROpcode opcode) {
   switch (opcode) {
 #define OP(op, ref, ...) \
   case OPCODE_##op:      \
@@ -490,7 +490,7 @@ IROpcode from_dex_opcode(DexOpcode op) {
   not_reached();
 }
 
-DexOpcode to_dex_opcode(IROpcode op) {
+static constexpr DexOpcode compute_dex_opcode(IROpcode op) {
   switch (op) {
   case OPCODE_NOP:
     return DOPCODE_NOP;
@@ -828,6 +828,8 @@ DexOpcode to_dex_opcode(IROpcode op) {
   }
 }
 
+DexOpcode to_dex_opcode(IROpcode op) { return compute_dex_opcode(op); }
+
 DexOpcode range_version(IROpcode op) {
   switch (op) {
   case OPCODE_INVOKE_DIRECT:
@@ -847,7 +849,7 @@ DexOpcode range_version(IROpcode op) {
   }
 }
 
-bool has_variable_srcs_size(IROpcode op) {
+static constexpr bool compute_has_variable_srcs_size(IROpcode op) {
   switch (op) {
   case OPCODE_INVOKE_VIRTUAL:
   case OPCODE_INVOKE_DIRECT:
@@ -861,7 +863,7 @@ bool has_variable_srcs_size(IROpcode op) {
   }
 }
 
-bool may_throw(IROpcode op) {
+static constexpr bool compute_may_throw(IROpcode op) {
   switch (op) {
   case OPCODE_CONST_STRING:
   case OPCODE_CONST_CLASS:
@@ -934,8 +936,8 @@ bool may_throw(IROpcode op) {
   }
 }
 
-Branchingness branchingness(IROpcode op) {
-  if (may_throw(op)) {
+static constexpr Branchingness compute_branchingness(IROpcode op) {
+  if (compute_may_throw(op)) {
     return BRANCH_THROW;
   }
 
@@ -970,7 +972,7 @@ Branchingness branchingness(IROpcode op) {
   }
 }
 
-bool has_range_form(IROpcode op) {
+static constexpr bool compute_has_range_form(IROpcode op) {
   switch (op) {
   case OPCODE_INVOKE_DIRECT:
   case OPCODE_INVOKE_STATIC:
@@ -984,7 +986,7 @@ bool has_range_form(IROpcode op) {
   }
 }
 
-bool is_internal(IROpcode op) {
+static constexpr bool compute_is_internal(IROpcode op) {
   switch (op) {
   case IOPCODE_LOAD_PARAM:
   case IOPCODE_LOAD_PARAM_OBJECT:
@@ -1098,36 +1100,36 @@ IROpcode invert_conditional_branch(IROpcode op) {
 
 namespace opcode_impl {
 
-unsigned dests_size(IROpcode op) {
-  if (opcode::is_internal(op)) {
+static constexpr unsigned compute_dests_size(IROpcode op) {
+  if (opcode::compute_is_internal(op)) {
     return 1;
   } else {
-    auto dex_op = opcode::to_dex_opcode(op);
-    return !opcode::may_throw(op) && dex_opcode::dests_size(dex_op);
+    auto dex_op = opcode::compute_dex_opcode(op);
+    return !opcode::compute_may_throw(op) && dex_opcode::dests_size(dex_op);
   }
 }
 
-bool has_move_result_pseudo(IROpcode op) {
-  if (opcode::is_internal(op)) {
+static constexpr bool compute_has_move_result_pseudo(IROpcode op) {
+  if (opcode::compute_is_internal(op)) {
     return false;
   } else if (op == OPCODE_CHECK_CAST) {
     return true;
   } else {
-    auto dex_op = opcode::to_dex_opcode(op);
-    return dex_opcode::dests_size(dex_op) && opcode::may_throw(op);
+    auto dex_op = opcode::compute_dex_opcode(op);
+    return dex_opcode::dests_size(dex_op) && opcode::compute_may_throw(op);
   }
 }
 
-unsigned min_srcs_size(IROpcode op) {
-  if (opcode::is_internal(op)) {
+static constexpr unsigned compute_min_srcs_size(IROpcode op) {
+  if (opcode::compute_is_internal(op)) {
     return 0;
   } else {
-    auto dex_op = opcode::to_dex_opcode(op);
+    auto dex_op = opcode::compute_dex_opcode(op);
     return dex_opcode::min_srcs_size(dex_op);
   }
 }
 
-bool dest_is_wide(IROpcode op) {
+static constexpr bool compute_dest_is_wide(IROpcode op) {
   switch (op) {
   case OPCODE_MOVE_WIDE:
   case OPCODE_MOVE_RESULT_WIDE:
@@ -1183,34 +1185,32 @@ bool dest_is_wide(IROpcode op) {
   }
 }
 
-bool dest_is_object(IROpcode op) {
+// The HAS_DEST_IS_OBJECT and DEST_IS_OBJECT bits of the opcode.
+static constexpr uint32_t compute_dest_is_object(IROpcode op) {
   switch (op) {
   case OPCODE_NOP:
-    always_assert_log(false, "No dest");
-    not_reached();
+    return 0;
   case OPCODE_MOVE:
   case OPCODE_MOVE_WIDE:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case OPCODE_MOVE_OBJECT:
-    return true;
+    return HAS_DEST_IS_OBJECT | DEST_IS_OBJECT;
   case OPCODE_MOVE_RESULT:
   case OPCODE_MOVE_RESULT_WIDE:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case OPCODE_MOVE_RESULT_OBJECT:
   case OPCODE_MOVE_EXCEPTION:
-    return true;
+    return HAS_DEST_IS_OBJECT | DEST_IS_OBJECT;
   case OPCODE_RETURN_VOID:
   case OPCODE_RETURN:
   case OPCODE_RETURN_WIDE:
   case OPCODE_RETURN_OBJECT:
-    always_assert_log(false, "No dest");
-    not_reached();
+    return 0;
   case OPCODE_MONITOR_ENTER:
   case OPCODE_MONITOR_EXIT:
   case OPCODE_THROW:
   case OPCODE_GOTO:
-    always_assert_log(false, "No dest");
-    not_reached();
+    return 0;
   case OPCODE_NEG_INT:
   case OPCODE_NOT_INT:
   case OPCODE_NEG_LONG:
@@ -1233,13 +1233,13 @@ bool dest_is_object(IROpcode op) {
   case OPCODE_INT_TO_CHAR:
   case OPCODE_INT_TO_SHORT:
   case OPCODE_ARRAY_LENGTH:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case OPCODE_CMPL_FLOAT:
   case OPCODE_CMPG_FLOAT:
   case OPCODE_CMPL_DOUBLE:
   case OPCODE_CMPG_DOUBLE:
   case OPCODE_CMP_LONG:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case OPCODE_IF_EQ:
   case OPCODE_IF_NE:
   case OPCODE_IF_LT:
@@ -1252,18 +1252,17 @@ bool dest_is_object(IROpcode op) {
   case OPCODE_IF_GEZ:
   case OPCODE_IF_GTZ:
   case OPCODE_IF_LEZ:
-    always_assert_log(false, "No dest");
-    not_reached();
+    return 0;
   case OPCODE_AGET:
   case OPCODE_AGET_WIDE:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case OPCODE_AGET_OBJECT:
-    return true;
+    return HAS_DEST_IS_OBJECT | DEST_IS_OBJECT;
   case OPCODE_AGET_BOOLEAN:
   case OPCODE_AGET_BYTE:
   case OPCODE_AGET_CHAR:
   case OPCODE_AGET_SHORT:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case OPCODE_APUT:
   case OPCODE_APUT_WIDE:
   case OPCODE_APUT_OBJECT:
@@ -1271,8 +1270,7 @@ bool dest_is_object(IROpcode op) {
   case OPCODE_APUT_BYTE:
   case OPCODE_APUT_CHAR:
   case OPCODE_APUT_SHORT:
-    always_assert_log(false, "No dest");
-    not_reached();
+    return 0;
   case OPCODE_ADD_INT:
   case OPCODE_SUB_INT:
   case OPCODE_MUL_INT:
@@ -1305,7 +1303,7 @@ bool dest_is_object(IROpcode op) {
   case OPCODE_MUL_DOUBLE:
   case OPCODE_DIV_DOUBLE:
   case OPCODE_REM_DOUBLE:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case OPCODE_ADD_INT_LIT16:
   case OPCODE_RSUB_INT:
   case OPCODE_MUL_INT_LIT16:
@@ -1325,25 +1323,24 @@ bool dest_is_object(IROpcode op) {
   case OPCODE_SHL_INT_LIT8:
   case OPCODE_SHR_INT_LIT8:
   case OPCODE_USHR_INT_LIT8:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case OPCODE_CONST:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case OPCODE_FILL_ARRAY_DATA:
   case OPCODE_PACKED_SWITCH:
   case OPCODE_SPARSE_SWITCH:
-    always_assert_log(false, "No dest");
-    not_reached();
+    return 0;
   case OPCODE_CONST_WIDE:
   case OPCODE_IGET:
   case OPCODE_IGET_WIDE:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case OPCODE_IGET_OBJECT:
-    return true;
+    return HAS_DEST_IS_OBJECT | DEST_IS_OBJECT;
   case OPCODE_IGET_BOOLEAN:
   case OPCODE_IGET_BYTE:
   case OPCODE_IGET_CHAR:
   case OPCODE_IGET_SHORT:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case OPCODE_IPUT:
   case OPCODE_IPUT_WIDE:
   case OPCODE_IPUT_OBJECT:
@@ -1351,18 +1348,17 @@ bool dest_is_object(IROpcode op) {
   case OPCODE_IPUT_BYTE:
   case OPCODE_IPUT_CHAR:
   case OPCODE_IPUT_SHORT:
-    always_assert_log(false, "No dest");
-    not_reached();
+    return 0;
   case OPCODE_SGET:
   case OPCODE_SGET_WIDE:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case OPCODE_SGET_OBJECT:
-    return true;
+    return HAS_DEST_IS_OBJECT | DEST_IS_OBJECT;
   case OPCODE_SGET_BOOLEAN:
   case OPCODE_SGET_BYTE:
   case OPCODE_SGET_CHAR:
   case OPCODE_SGET_SHORT:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case OPCODE_SPUT:
   case OPCODE_SPUT_WIDE:
   case OPCODE_SPUT_OBJECT:
@@ -1370,40 +1366,82 @@ bool dest_is_object(IROpcode op) {
   case OPCODE_SPUT_BYTE:
   case OPCODE_SPUT_CHAR:
   case OPCODE_SPUT_SHORT:
-    always_assert_log(false, "No dest");
-    not_reached();
+    return 0;
   case OPCODE_INVOKE_VIRTUAL:
   case OPCODE_INVOKE_SUPER:
   case OPCODE_INVOKE_DIRECT:
   case OPCODE_INVOKE_STATIC:
   case OPCODE_INVOKE_INTERFACE:
-    always_assert_log(false, "No dest");
-    not_reached();
+    return 0;
   case OPCODE_CONST_STRING:
   case OPCODE_CONST_CLASS:
   case OPCODE_CHECK_CAST:
-    return true;
+    return HAS_DEST_IS_OBJECT | DEST_IS_OBJECT;
   case OPCODE_INSTANCE_OF:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case OPCODE_NEW_INSTANCE:
   case OPCODE_NEW_ARRAY:
   case OPCODE_FILLED_NEW_ARRAY:
-    return true;
+    return HAS_DEST_IS_OBJECT | DEST_IS_OBJECT;
   case IOPCODE_LOAD_PARAM:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case IOPCODE_LOAD_PARAM_OBJECT:
-    return true;
+    return HAS_DEST_IS_OBJECT | DEST_IS_OBJECT;
   case IOPCODE_LOAD_PARAM_WIDE:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case IOPCODE_MOVE_RESULT_PSEUDO:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   case IOPCODE_MOVE_RESULT_PSEUDO_OBJECT:
-    return true;
+    return HAS_DEST_IS_OBJECT | DEST_IS_OBJECT;
   case IOPCODE_MOVE_RESULT_PSEUDO_WIDE:
-    return false;
+    return HAS_DEST_IS_OBJECT;
   default:
     always_assert_log(false, "Unknown opcode %02x\n", op);
   }
 }
 
 } // namespace opcode_impl
+
+namespace opcode_impl {
+
+static constexpr uint32_t compute_properties(IROpcode op) {
+  uint32_t props = static_cast<uint32_t>(opcode::compute_ref(op));
+  props |= static_cast<uint32_t>(opcode::compute_branchingness(op))
+           << BRANCHINGNESS_SHIFT;
+  props |= compute_min_srcs_size(op) << MIN_SRCS_SIZE_SHIFT;
+  props |= compute_dest_is_object(op);
+  if (opcode::compute_may_throw(op)) {
+    props |= MAY_THROW;
+  }
+  if (opcode::compute_has_range_form(op)) {
+    props |= HAS_RANGE_FORM;
+  }
+  if (opcode::compute_has_variable_srcs_size(op)) {
+    props |= HAS_VARIABLE_SRCS_SIZE;
+  }
+  if (opcode::compute_is_internal(op)) {
+    props |= IS_INTERNAL;
+  }
+  if (compute_dests_size(op) != 0) {
+    props |= HAS_DEST;
+  }
+  if (compute_has_move_result_pseudo(op)) {
+    props |= HAS_MOVE_RESULT_PSEUDO;
+  }
+  if (compute_dest_is_wide(op)) {
+    props |= DEST_IS_WIDE;
+  }
+  return props;
+}
+
+static constexpr PropertyTable compute_property_table() {
+  PropertyTable table{};
+  for (size_t op = 0; op < NUM_OPCODES; ++op) {
+    table.properties[op] = compute_properties(static_cast<IROpcode>(op));
+  }
+  return table;
+}
+
+constexpr PropertyTable k_property_table = compute_property_table();
+
+} // namespace opcode_impl
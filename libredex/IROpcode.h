@@ -10,6 +10,7 @@
 #include <cstdint>
 #include <string>
 
+#include "Debug.h"
 #include "Show.h"
 
 enum DexOpcode : uint16_t;
@@ -212,9 +213,51 @@ std::string show(IROpcode);
 
 using bit_width_t = uint8_t;
 
+namespace opcode_impl {
+
+constexpr size_t NUM_OPCODES = IOPCODE_MOVE_RESULT_PSEUDO_WIDE + 1;
+
+/*
+ * The static properties of the IROpcodes are queried for nearly every
+ * instruction by nearly every analysis. They are packed into one word per
+ * opcode, in a table that is computed at compile time from the OPS list and
+ * the DexOpcode formats, so that each query is a single indexed load.
+ */
+enum Property : uint32_t {
+  REF_MASK = 0x7, // opcode::Ref
+  MAY_THROW = 1 << 3,
+  BRANCHINGNESS_SHIFT = 4,
+  BRANCHINGNESS_MASK = 0x7 << BRANCHINGNESS_SHIFT, // opcode::Branchingness
+  HAS_RANGE_FORM = 1 << 7,
+  HAS_VARIABLE_SRCS_SIZE = 1 << 8,
+  IS_INTERNAL = 1 << 9,
+  HAS_DEST = 1 << 10,
+  HAS_MOVE_RESULT_PSEUDO = 1 << 11,
+  MIN_SRCS_SIZE_SHIFT = 12,
+  MIN_SRCS_SIZE_MASK = 0x3 << MIN_SRCS_SIZE_SHIFT,
+  DEST_IS_WIDE = 1 << 14,
+  // Whether dest_is_object() is defined for the opcode, and its value.
+  HAS_DEST_IS_OBJECT = 1 << 15,
+  DEST_IS_OBJECT = 1 << 16,
+};
+
+struct PropertyTable {
+  uint32_t properties[NUM_OPCODES];
+};
+
+extern const PropertyTable k_property_table;
+
+inline uint32_t properties(IROpcode op) {
+  return k_property_table.properties[op];
+}
+
+} // namespace opcode_impl
+
 namespace opcode {
 
-Ref ref(IROpcode);
+inline Ref ref(IROpcode op) {
+  return static_cast<Ref>(opcode_impl::properties(op) & opcode_impl::REF_MASK);
+}
 
 /*
  * 2addr and non-2addr DexOpcode pairs will get mapped to the same IROpcode.
@@ -237,21 +280,29 @@ IROpcode from_dex_opcode(DexOpcode);
  */
 DexOpcode to_dex_opcode(IROpcode);
 
-bool may_throw(IROpcode);
+inline bool may_throw(IROpcode op) {
+  return opcode_impl::properties(op) & opcode_impl::MAY_THROW;
+}
 
 inline bool can_throw(IROpcode op) {
   return may_throw(op) || op == OPCODE_THROW;
 }
 
 // if an IROpcode can be translated to a DexOpcode of /range format
-bool has_range_form(IROpcode);
+inline bool has_range_form(IROpcode op) {
+  return opcode_impl::properties(op) & opcode_impl::HAS_RANGE_FORM;
+}
 
 DexOpcode range_version(IROpcode);
 
-bool has_variable_srcs_size(IROpcode op);
+inline bool has_variable_srcs_size(IROpcode op) {
+  return opcode_impl::properties(op) & opcode_impl::HAS_VARIABLE_SRCS_SIZE;
+}
 
 // Internal opcodes cannot be mapped to a corresponding DexOpcode.
-bool is_internal(IROpcode);
+inline bool is_internal(IROpcode op) {
+  return opcode_impl::properties(op) & opcode_impl::IS_INTERNAL;
+}
 
 bool is_load_param(IROpcode);
 
@@ -278,7 +329,11 @@ enum Branchingness {
   BRANCH_THROW // both always throw and may_throw
 };
 
-Branchingness branchingness(IROpcode op);
+inline Branchingness branchingness(IROpcode op) {
+  return static_cast<Branchingness>(
+      (opcode_impl::properties(op) & opcode_impl::BRANCHINGNESS_MASK) >>
+      opcode_impl::BRANCHINGNESS_SHIFT);
+}
 
 } // namespace opcode
 
@@ -288,16 +343,28 @@ Branchingness branchingness(IROpcode op);
  */
 namespace opcode_impl {
 
-unsigned dests_size(IROpcode);
+inline unsigned dests_size(IROpcode op) {
+  return (properties(op) & HAS_DEST) ? 1 : 0;
+}
 
-bool has_move_result_pseudo(IROpcode);
+inline bool has_move_result_pseudo(IROpcode op) {
+  return properties(op) & HAS_MOVE_RESULT_PSEUDO;
+}
 
 // we can't tell the srcs size from the opcode alone -- format 35c opcodes
 // encode that separately. So this just returns the minimum.
-unsigned min_srcs_size(IROpcode);
+inline unsigned min_srcs_size(IROpcode op) {
+  return (properties(op) & MIN_SRCS_SIZE_MASK) >> MIN_SRCS_SIZE_SHIFT;
+}
 
-bool dest_is_wide(IROpcode);
+inline bool dest_is_wide(IROpcode op) {
+  return properties(op) & DEST_IS_WIDE;
+}
 
-bool dest_is_object(IROpcode);
+inline bool dest_is_object(IROpcode op) {
+  auto props = properties(op);
+  always_assert_log(props & HAS_DEST_IS_OBJECT, "No dest");
+  return props & DEST_IS_OBJECT;
+}
 
 } // namespace opcode_impl
@@ -0,0 +1,1017 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "IRSnapshot.h"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+#include "ConcurrentContainers.h"
+#include "Creators.h"
+#include "DexAnnotation.h"
+#include "DexDebugInstruction.h"
+#include "DexInstruction.h"
+#include "DexPosition.h"
+#include "IRCode.h"
+#include "Parallel.h"
+
+/*
+ * The snapshot is a header -- a magic string and the size of the file --
+ * followed by the tables of strings, types, type lists, protos, fields and
+ * methods, and then by the stores, their dexes and their classes. Everything
+ * else refers to the tables by index. Integers are in host byte order.
+ *
+ * The code of a method is prefixed by its size, so that the classes can be
+ * read in one go and the code decoded afterwards, in parallel. Within the
+ * code, the entries that point to other entries -- try markers, catches,
+ * branch targets and positions with a parent -- refer to them by their index
+ * in the method.
+ */
+namespace {
+
+constexpr const char* SNAPSHOT_FILE_NAME = "/irsnapshot.bin";
+
+// Change the version whenever the encoding, or the numbering of the IR
+// opcodes, changes.
+constexpr char SNAPSHOT_MAGIC[] = "redex-ir-snapshot-1";
+
+struct SnapshotHeader {
+  char magic[sizeof(SNAPSHOT_MAGIC)];
+  uint64_t file_size;
+};
+
+constexpr uint32_t NO_INDEX = 0xffffffff;
+
+// Stands for a missing encoded value, e.g. a static field without one.
+constexpr uint8_t NO_VALUE = 0xff;
+
+class Writer {
+ public:
+  explicit Writer(std::string* out) : m_out(out) {}
+
+  void u8(uint8_t v) { m_out->push_back(static_cast<char>(v)); }
+  void u16(uint16_t v) { m_out->append(reinterpret_cast<char*>(&v), 2); }
+  void u32(uint32_t v) { m_out->append(reinterpret_cast<char*>(&v), 4); }
+  void u64(uint64_t v) { m_out->append(reinterpret_cast<char*>(&v), 8); }
+  void str(const std::string& str) {
+    u32(str.size());
+    m_out->append(str);
+  }
+  void bytes(const std::string& bytes) { m_out->append(bytes); }
+
+ private:
+  std::string* m_out;
+};
+
+class Reader {
+ public:
+  Reader(const char* begin, const char* end) : m_pos(begin), m_end(end) {}
+
+  uint8_t u8() { return get<uint8_t>(); }
+  uint16_t u16() { return get<uint16_t>(); }
+  uint32_t u32() { return get<uint32_t>(); }
+  uint64_t u64() { return get<uint64_t>(); }
+  std::string str() {
+    auto size = u32();
+    return std::string(skip(size), size);
+  }
+  // Returns where the skipped bytes start.
+  const char* skip(size_t size) {
+    always_assert_log(size <= size_t(m_end - m_pos), "Truncated IR snapshot");
+    auto pos = m_pos;
+    m_pos += size;
+    return pos;
+  }
+  bool at_end() const { return m_pos == m_end; }
+
+ private:
+  template <typename T>
+  T get() {
+    T v;
+    memcpy(&v, skip(sizeof(T)), sizeof(T));
+    return v;
+  }
+
+  const char* m_pos;
+  const char* m_end;
+};
+
+/*
+ * Writes classes out. References are written as indices given by `Index`,
+ * which is either References, that collects what the classes refer to so that
+ * the tables can be built, or Tables, once they are built.
+ */
+template <typename Index>
+class Encoder {
+ public:
+  Encoder(Index& index, std::string* out) : m_index(index), m_out(out) {}
+
+  void write_class(DexClass* cls) {
+    m_out.u32(m_index(cls->get_type()));
+    m_out.str(cls->get_location());
+    m_out.u32(m_index(cls->get_super_class()));
+    m_out.u32(cls->get_access());
+    m_out.u32(m_index(cls->get_interfaces()));
+    m_out.u32(m_index(cls->get_source_file()));
+    write_annotations(cls->get_anno_set());
+    write_fields(cls->get_sfields());
+    write_fields(cls->get_ifields());
+    write_methods(cls->get_dmethods());
+    write_methods(cls->get_vmethods());
+  }
+
+ private:
+  void write_fields(const std::vector<DexField*>& fields) {
+    m_out.u32(fields.size());
+    for (auto field : fields) {
+      m_out.u32(m_index(field));
+      m_out.u32(field->get_access());
+      write_annotations(field->get_anno_set());
+      write_value(field->get_static_value());
+    }
+  }
+
+  void write_methods(const std::vector<DexMethod*>& methods) {
+    m_out.u32(methods.size());
+    for (auto method : methods) {
+      m_out.u32(m_index(method));
+      m_out.u32(method->get_access());
+      write_annotations(method->get_anno_set());
+      auto param_anno = method->get_param_anno();
+      m_out.u32(param_anno == nullptr ? 0 : param_anno->size());
+      if (param_anno != nullptr) {
+        for (const auto& pair : *param_anno) {
+          m_out.u32(pair.first);
+          write_annotations(pair.second);
+        }
+      }
+      auto code = method->get_code();
+      m_out.u8(code != nullptr);
+      if (code != nullptr) {
+        std::string bytes;
+        Encoder(m_index, &bytes).write_code(method, code);
+        m_out.u32(bytes.size());
+        m_out.bytes(bytes);
+      }
+    }
+  }
+
+  void write_annotations(const DexAnnotationSet* aset) {
+    if (aset == nullptr) {
+      m_out.u32(NO_INDEX);
+      return;
+    }
+    m_out.u32(aset->size());
+    for (auto anno : aset->get_annotations()) {
+      m_out.u32(m_index(anno->type()));
+      m_out.u8(anno->viz());
+      write_elements(anno->anno_elems());
+    }
+  }
+
+  void write_elements(const EncodedAnnotations& elems) {
+    m_out.u32(elems.size());
+    for (const auto& elem : elems) {
+      m_out.u32(m_index(elem.string));
+      write_value(elem.encoded_value);
+    }
+  }
+
+  void write_value(DexEncodedValue* ev) {
+    if (ev == nullptr) {
+      m_out.u8(NO_VALUE);
+      return;
+    }
+    m_out.u8(ev->evtype());
+    switch (ev->evtype()) {
+    case DEVT_STRING:
+      m_out.u32(m_index(static_cast<DexEncodedValueString*>(ev)->string()));
+      break;
+    case DEVT_TYPE:
+      m_out.u32(m_index(static_cast<DexEncodedValueType*>(ev)->type()));
+      break;
+    case DEVT_FIELD:
+    case DEVT_ENUM:
+      m_out.u32(m_index(static_cast<DexEncodedValueField*>(ev)->field()));
+      break;
+    case DEVT_METHOD:
+      m_out.u32(m_index(static_cast<DexEncodedValueMethod*>(ev)->method()));
+      break;
+    case DEVT_ARRAY: {
+      auto array = static_cast<DexEncodedValueArray*>(ev);
+      m_out.u8(array->is_static_val());
+      m_out.u32(array->evalues()->size());
+      for (auto value : *array->evalues()) {
+        write_value(value);
+      }
+      break;
+    }
+    case DEVT_ANNOTATION: {
+      auto anno = static_cast<DexEncodedValueAnnotation*>(ev);
+      m_out.u32(m_index(anno->type()));
+      write_elements(*anno->annotations());
+      break;
+    }
+    default:
+      m_out.u64(ev->value());
+      break;
+    }
+  }
+
+  void write_code(const DexMethod* method, IRCode* code) {
+    always_assert_log(!code->editable_cfg_built(),
+                      "Cannot snapshot %s while its CFG is built",
+                      SHOW(method));
+    m_out.u16(code->get_registers_size());
+    auto dbg = code->get_debug_item();
+    m_out.u8(dbg != nullptr);
+    if (dbg != nullptr) {
+      m_out.u32(dbg->get_param_names().size());
+      for (auto name : dbg->get_param_names()) {
+        m_out.u32(m_index(name));
+      }
+    }
+    std::unordered_map<const MethodItemEntry*, uint32_t> entry_ids;
+    std::unordered_map<const DexPosition*, uint32_t> pos_ids;
+    for (const auto& mie : *code) {
+      if (mie.type == MFLOW_POSITION) {
+        pos_ids.emplace(mie.pos.get(), entry_ids.size());
+      }
+      entry_ids.emplace(&mie, entry_ids.size());
+    }
+    auto entry_id = [&](const MethodItemEntry* mie) {
+      if (mie == nullptr) {
+        return NO_INDEX;
+      }
+      auto it = entry_ids.find(mie);
+      always_assert_log(it != entry_ids.end(),
+                        "An entry of %s refers to one outside of it",
+                        SHOW(method));
+      return it->second;
+    };
+    m_out.u32(entry_ids.size());
+    for (const auto& mie : *code) {
+      m_out.u8(mie.type);
+      switch (mie.type) {
+      case MFLOW_TRY:
+        m_out.u8(mie.tentry->type);
+        m_out.u32(entry_id(mie.tentry->catch_start));
+        break;
+      case MFLOW_CATCH:
+        m_out.u32(m_index(mie.centry->catch_type));
+        m_out.u32(entry_id(mie.centry->next));
+        break;
+      case MFLOW_OPCODE:
+        write_insn(mie.insn);
+        break;
+      case MFLOW_DEX_OPCODE:
+        always_assert_log(false, "Cannot snapshot the lowered code of %s",
+                          SHOW(method));
+        break;
+      case MFLOW_TARGET:
+        m_out.u8(mie.target->type);
+        m_out.u32(entry_id(mie.target->src));
+        m_out.u32(mie.target->case_key);
+        break;
+      case MFLOW_DEBUG:
+        write_debug(mie.dbgop.get());
+        break;
+      case MFLOW_POSITION: {
+        auto pos = mie.pos.get();
+        m_out.u32(pos->line);
+        m_out.u32(m_index(pos->method()));
+        m_out.u32(m_index(pos->file()));
+        auto parent = NO_INDEX;
+        if (pos->parent != nullptr) {
+          auto it = pos_ids.find(pos->parent);
+          always_assert_log(it != pos_ids.end(),
+                            "The parent of a position of %s is not in it",
+                            SHOW(method));
+          parent = it->second;
+        }
+        m_out.u32(parent);
+        break;
+      }
+      case MFLOW_FALLTHROUGH:
+        break;
+      }
+    }
+  }
+
+  void write_insn(const IRInstruction* insn) {
+    m_out.u16(insn->opcode());
+    m_out.u16(insn->dests_size() ? insn->dest() : 0);
+    m_out.u16(insn->srcs_size());
+    for (auto reg : insn->srcs()) {
+      m_out.u16(reg);
+    }
+    switch (opcode::ref(insn->opcode())) {
+    case opcode::Ref::None:
+      break;
+    case opcode::Ref::Literal:
+      m_out.u64(insn->get_literal());
+      break;
+    case opcode::Ref::String:
+      m_out.u32(m_index(insn->get_string()));
+      break;
+    case opcode::Ref::Type:
+      m_out.u32(m_index(insn->get_type()));
+      break;
+    case opcode::Ref::Field:
+      m_out.u32(m_index(insn->get_field()));
+      break;
+    case opcode::Ref::Method:
+      m_out.u32(m_index(insn->get_method()));
+      break;
+    case opcode::Ref::Data: {
+      // The payload is kept as the code units it is emitted as.
+      auto data = insn->get_data();
+      std::vector<uint16_t> units(data->size());
+      auto out = units.data();
+      data->encode(nullptr, out);
+      m_out.u32(units.size());
+      for (auto unit : units) {
+        m_out.u16(unit);
+      }
+      break;
+    }
+    }
+  }
+
+  void write_debug(const DexDebugInstruction* dbgop) {
+    m_out.u8(dbgop->opcode());
+    m_out.u8(dbgop->is_signed());
+    m_out.u32(dbgop->uvalue());
+    switch (dbgop->opcode()) {
+    case DBG_SET_FILE:
+      m_out.u32(m_index(
+          static_cast<const DexDebugOpcodeSetFile*>(dbgop)->file()));
+      break;
+    case DBG_START_LOCAL:
+    case DBG_START_LOCAL_EXTENDED: {
+      auto start = static_cast<const DexDebugOpcodeStartLocal*>(dbgop);
+      m_out.u32(m_index(start->name()));
+      m_out.u32(m_index(start->type()));
+      m_out.u32(m_index(start->sig()));
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  Index& m_index;
+  Writer m_out;
+};
+
+// What the classes refer to, collected from all of them in parallel.
+struct References {
+  ConcurrentSet<const DexString*> strings;
+  ConcurrentSet<const DexType*> types;
+  ConcurrentSet<const DexTypeList*> type_lists;
+  ConcurrentSet<const DexProto*> protos;
+  ConcurrentSet<const DexFieldRef*> fields;
+  ConcurrentSet<const DexMethodRef*> methods;
+
+  template <typename T>
+  static uint32_t add(ConcurrentSet<const T*>& set, const T* item) {
+    if (item != nullptr) {
+      set.insert(item);
+    }
+    return 0;
+  }
+  uint32_t operator()(const DexString* s) { return add(strings, s); }
+  uint32_t operator()(const DexType* t) { return add(types, t); }
+  uint32_t operator()(const DexTypeList* l) { return add(type_lists, l); }
+  uint32_t operator()(const DexProto* p) { return add(protos, p); }
+  uint32_t operator()(const DexFieldRef* f) { return add(fields, f); }
+  uint32_t operator()(const DexMethodRef* m) { return add(methods, m); }
+
+  // Adds what the references themselves refer to. Each kind only refers to
+  // the ones after it.
+  void close() {
+    for (auto method : methods) {
+      (*this)(method->get_class());
+      (*this)(method->get_name());
+      (*this)(method->get_proto());
+    }
+    for (auto field : fields) {
+      (*this)(field->get_class());
+      (*this)(field->get_name());
+      (*this)(field->get_type());
+    }
+    for (auto proto : protos) {
+      (*this)(proto->get_rtype());
+      (*this)(proto->get_args());
+      (*this)(proto->get_shorty());
+    }
+    for (auto list : type_lists) {
+      for (auto type : *list) {
+        (*this)(type);
+      }
+    }
+    for (auto type : types) {
+      (*this)(type->get_name());
+    }
+  }
+};
+
+// The items of one kind, in a stable order, and their indices.
+template <typename T>
+struct Table {
+  std::vector<const T*> items;
+  std::unordered_map<const T*, uint32_t> ids;
+
+  template <typename Less>
+  void build(const ConcurrentSet<const T*>& set, Less less) {
+    items.assign(set.begin(), set.end());
+    std::sort(items.begin(), items.end(), less);
+    ids.reserve(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+      ids.emplace(items[i], i);
+    }
+  }
+
+  uint32_t operator[](const T* item) const {
+    if (item == nullptr) {
+      return NO_INDEX;
+    }
+    auto it = ids.find(item);
+    always_assert(it != ids.end());
+    return it->second;
+  }
+};
+
+struct Tables {
+  Table<DexString> strings;
+  Table<DexType> types;
+  Table<DexTypeList> type_lists;
+  Table<DexProto> protos;
+  Table<DexFieldRef> fields;
+  Table<DexMethodRef> methods;
+
+  explicit Tables(const References& refs) {
+    strings.build(refs.strings, compare_dexstrings);
+    types.build(refs.types, compare_dextypes);
+    type_lists.build(refs.type_lists, compare_dextypelists);
+    protos.build(refs.protos, compare_dexprotos);
+    fields.build(refs.fields, compare_dexfields);
+    methods.build(refs.methods, compare_dexmethods);
+  }
+
+  uint32_t operator()(const DexString* s) const { return strings[s]; }
+  uint32_t operator()(const DexType* t) const { return types[t]; }
+  uint32_t operator()(const DexTypeList* l) const { return type_lists[l]; }
+  uint32_t operator()(const DexProto* p) const { return protos[p]; }
+  uint32_t operator()(const DexFieldRef* f) const { return fields[f]; }
+  uint32_t operator()(const DexMethodRef* m) const { return methods[m]; }
+
+  void write(Writer& out) const {
+    out.u32(strings.items.size());
+    for (auto str : strings.items) {
+      out.u32(str->length());
+      out.u32(str->size());
+    }
+    for (auto str : strings.items) {
+      out.bytes(str->str());
+      out.u8(0);
+    }
+    out.u32(types.items.size());
+    for (auto type : types.items) {
+      out.u32(strings[type->get_name()]);
+    }
+    out.u32(type_lists.items.size());
+    for (auto list : type_lists.items) {
+      out.u32(list->size());
+      for (auto type : *list) {
+        out.u32(types[type]);
+      }
+    }
+    out.u32(protos.items.size());
+    for (auto proto : protos.items) {
+      out.u32(types[proto->get_rtype()]);
+      out.u32(type_lists[proto->get_args()]);
+      out.u32(strings[proto->get_shorty()]);
+    }
+    out.u32(fields.items.size());
+    for (auto field : fields.items) {
+      out.u32(types[field->get_class()]);
+      out.u32(strings[field->get_name()]);
+      out.u32(types[field->get_type()]);
+    }
+    out.u32(methods.items.size());
+    for (auto method : methods.items) {
+      out.u32(types[method->get_class()]);
+      out.u32(strings[method->get_name()]);
+      out.u32(protos[method->get_proto()]);
+    }
+  }
+};
+
+// Where the code of a method is in the snapshot, until it is decoded.
+struct PendingCode {
+  DexMethod* method;
+  const char* begin;
+  const char* end;
+};
+
+class Decoder {
+ public:
+  // Interns everything in the tables.
+  void read_tables(Reader& in) {
+    auto num_strings = in.u32();
+    std::vector<uint32_t> utfsizes(num_strings);
+    std::vector<uint32_t> sizes(num_strings);
+    for (uint32_t i = 0; i < num_strings; ++i) {
+      utfsizes[i] = in.u32();
+      sizes[i] = in.u32();
+    }
+    std::vector<const char*> chars(num_strings);
+    for (uint32_t i = 0; i < num_strings; ++i) {
+      chars[i] = in.skip(sizes[i] + 1);
+      always_assert_log(chars[i][sizes[i]] == '\0', "Malformed IR snapshot");
+    }
+    m_strings.resize(num_strings);
+    g_redex->make_strings(
+        num_strings, chars.data(), utfsizes.data(), m_strings.data());
+
+    std::vector<DexString*> names(in.u32());
+    for (auto& name : names) {
+      name = string_at(in.u32());
+    }
+    m_types.resize(names.size());
+    g_redex->make_types(names.size(), names.data(), m_types.data());
+
+    m_type_lists.resize(in.u32());
+    for (auto& list : m_type_lists) {
+      std::deque<DexType*> types(in.u32());
+      for (auto& type : types) {
+        type = type_at(in.u32());
+      }
+      list = DexTypeList::make_type_list(std::move(types));
+    }
+    m_protos.resize(in.u32());
+    for (auto& proto : m_protos) {
+      auto rtype = type_at(in.u32());
+      auto args = type_list_at(in.u32());
+      auto shorty = string_at(in.u32());
+      proto = shorty == nullptr ? DexProto::make_proto(rtype, args)
+                                : DexProto::make_proto(rtype, args, shorty);
+    }
+    m_fields.resize(in.u32());
+    for (auto& field : m_fields) {
+      auto cls = type_at(in.u32());
+      auto name = string_at(in.u32());
+      field = DexField::make_field(cls, name, type_at(in.u32()));
+    }
+    m_methods.resize(in.u32());
+    for (auto& method : m_methods) {
+      auto cls = type_at(in.u32());
+      auto name = string_at(in.u32());
+      method = DexMethod::make_method(cls, name, proto_at(in.u32()));
+    }
+  }
+
+  // Creates the class. The code of its methods is left to decode_code().
+  DexClass* read_class(Reader& in, std::vector<PendingCode>* pending) {
+    auto type = type_at(in.u32());
+    ClassCreator cc(type, in.str());
+    cc.set_super(type_at(in.u32()));
+    cc.set_access(static_cast<DexAccessFlags>(in.u32()));
+    auto interfaces = type_list_at(in.u32());
+    if (interfaces != nullptr) {
+      for (auto intf : *interfaces) {
+        cc.add_interface(intf);
+      }
+    }
+    auto cls = cc.get_class();
+    cls->set_source_file(string_at(in.u32()));
+    cls->attach_annotation_set(read_annotations(in));
+    // The static fields, then the instance ones.
+    read_fields(in, &cc);
+    read_fields(in, &cc);
+    read_methods(in, &cc, false /* is_virtual */, pending);
+    read_methods(in, &cc, true /* is_virtual */, pending);
+    return cc.create();
+  }
+
+  void decode_code(const PendingCode& pending) const {
+    Reader in(pending.begin, pending.end);
+    auto code = std::make_unique<IRCode>();
+    code->set_registers_size(in.u16());
+    if (in.u8()) {
+      auto dbg = std::make_unique<DexDebugItem>();
+      auto num_params = in.u32();
+      for (uint32_t i = 0; i < num_params; ++i) {
+        dbg->get_param_names().push_back(string_at(in.u32()));
+      }
+      code->set_debug_item(std::move(dbg));
+    }
+
+    // The entries that refer to others are linked once all of them exist. A
+    // try marker is only created then, since it can't be without its catch.
+    auto num_entries = in.u32();
+    std::vector<MethodItemEntry*> entries(num_entries);
+    std::vector<uint32_t> links(num_entries, NO_INDEX);
+    std::vector<TryEntryType> try_types(num_entries);
+    auto entry_at = [&](uint32_t id) {
+      always_assert_log(id < num_entries && entries[id] != nullptr,
+                        "Malformed IR snapshot");
+      return entries[id];
+    };
+    for (uint32_t i = 0; i < num_entries; ++i) {
+      auto type = static_cast<MethodItemType>(in.u8());
+      switch (type) {
+      case MFLOW_TRY:
+        try_types[i] = static_cast<TryEntryType>(in.u8());
+        links[i] = in.u32();
+        break;
+      case MFLOW_CATCH:
+        entries[i] = new MethodItemEntry(type_at(in.u32()));
+        links[i] = in.u32();
+        break;
+      case MFLOW_OPCODE:
+        entries[i] = new MethodItemEntry(read_insn(in));
+        break;
+      case MFLOW_TARGET: {
+        auto target = new BranchTarget();
+        target->type = static_cast<BranchTargetType>(in.u8());
+        target->src = nullptr;
+        links[i] = in.u32();
+        target->case_key = static_cast<int32_t>(in.u32());
+        entries[i] = new MethodItemEntry(target);
+        break;
+      }
+      case MFLOW_DEBUG:
+        entries[i] = new MethodItemEntry(read_debug(in));
+        break;
+      case MFLOW_POSITION: {
+        auto pos = std::make_unique<DexPosition>(in.u32());
+        auto method = method_at(in.u32());
+        auto file = string_at(in.u32());
+        if (method != nullptr) {
+          pos->bind(static_cast<DexMethod*>(method), file);
+        }
+        links[i] = in.u32();
+        entries[i] = new MethodItemEntry(std::move(pos));
+        break;
+      }
+      case MFLOW_FALLTHROUGH:
+        entries[i] = new MethodItemEntry();
+        break;
+      default:
+        always_assert_log(false, "Malformed IR snapshot");
+      }
+    }
+    for (uint32_t i = 0; i < num_entries; ++i) {
+      if (entries[i] == nullptr) {
+        entries[i] = new MethodItemEntry(try_types[i], entry_at(links[i]));
+      } else if (links[i] != NO_INDEX) {
+        auto linked = entry_at(links[i]);
+        switch (entries[i]->type) {
+        case MFLOW_CATCH:
+          entries[i]->centry->next = linked;
+          break;
+        case MFLOW_TARGET:
+          entries[i]->target->src = linked;
+          break;
+        case MFLOW_POSITION:
+          always_assert_log(linked->type == MFLOW_POSITION,
+                            "Malformed IR snapshot");
+          entries[i]->pos->parent = linked->pos.get();
+          break;
+        default:
+          break;
+        }
+      }
+    }
+    for (auto mie : entries) {
+      code->push_back(*mie);
+    }
+    always_assert_log(in.at_end(), "Malformed IR snapshot");
+    pending.method->set_code(std::move(code));
+  }
+
+ private:
+  template <typename T>
+  static T* at(const std::vector<T*>& table, uint32_t id) {
+    if (id == NO_INDEX) {
+      return nullptr;
+    }
+    always_assert_log(id < table.size(), "Malformed IR snapshot");
+    return table[id];
+  }
+  DexString* string_at(uint32_t id) const { return at(m_strings, id); }
+  DexType* type_at(uint32_t id) const { return at(m_types, id); }
+  DexTypeList* type_list_at(uint32_t id) const { return at(m_type_lists, id); }
+  DexProto* proto_at(uint32_t id) const { return at(m_protos, id); }
+  DexFieldRef* field_at(uint32_t id) const { return at(m_fields, id); }
+  DexMethodRef* method_at(uint32_t id) const { return at(m_methods, id); }
+
+  void read_fields(Reader& in, ClassCreator* cc) const {
+    auto num_fields = in.u32();
+    for (uint32_t i = 0; i < num_fields; ++i) {
+      auto field = static_cast<DexField*>(field_at(in.u32()));
+      auto access = static_cast<DexAccessFlags>(in.u32());
+      auto aset = read_annotations(in);
+      if (aset != nullptr) {
+        field->attach_annotation_set(aset);
+      }
+      field->make_concrete(access, read_value(in));
+      cc->add_field(field);
+    }
+  }
+
+  void read_methods(Reader& in,
+                    ClassCreator* cc,
+                    bool is_virtual,
+                    std::vector<PendingCode>* pending) const {
+    auto num_methods = in.u32();
+    for (uint32_t i = 0; i < num_methods; ++i) {
+      auto method = static_cast<DexMethod*>(method_at(in.u32()));
+      auto access = static_cast<DexAccessFlags>(in.u32());
+      auto aset = read_annotations(in);
+      if (aset != nullptr) {
+        method->attach_annotation_set(aset);
+      }
+      auto num_param_annos = in.u32();
+      for (uint32_t j = 0; j < num_param_annos; ++j) {
+        auto paramno = in.u32();
+        method->attach_param_annotation_set(paramno, read_annotations(in));
+      }
+      if (in.u8()) {
+        auto size = in.u32();
+        auto begin = in.skip(size);
+        pending->push_back({method, begin, begin + size});
+      }
+      method->make_concrete(access, std::unique_ptr<IRCode>(nullptr),
+                            is_virtual);
+      cc->add_method(method);
+    }
+  }
+
+  DexAnnotationSet* read_annotations(Reader& in) const {
+    auto size = in.u32();
+    if (size == NO_INDEX) {
+      return nullptr;
+    }
+    auto aset = new DexAnnotationSet();
+    for (uint32_t i = 0; i < size; ++i) {
+      auto type = type_at(in.u32());
+      auto viz = static_cast<DexAnnotationVisibility>(in.u8());
+      auto anno = new DexAnnotation(type, viz);
+      auto num_elems = in.u32();
+      for (uint32_t j = 0; j < num_elems; ++j) {
+        auto key = string_at(in.u32());
+        anno->add_element(key->c_str(), read_value(in));
+      }
+      aset->add_annotation(anno);
+    }
+    return aset;
+  }
+
+  DexEncodedValue* read_value(Reader& in) const {
+    auto type = in.u8();
+    if (type == NO_VALUE) {
+      return nullptr;
+    }
+    auto evtype = static_cast<DexEncodedValueTypes>(type);
+    switch (evtype) {
+    case DEVT_STRING:
+      return new DexEncodedValueString(string_at(in.u32()));
+    case DEVT_TYPE:
+      return new DexEncodedValueType(type_at(in.u32()));
+    case DEVT_FIELD:
+    case DEVT_ENUM:
+      return new DexEncodedValueField(evtype, field_at(in.u32()));
+    case DEVT_METHOD:
+      return new DexEncodedValueMethod(method_at(in.u32()));
+    case DEVT_ARRAY: {
+      bool static_val = in.u8();
+      auto values = new std::deque<DexEncodedValue*>(in.u32());
+      for (auto& value : *values) {
+        value = read_value(in);
+      }
+      return new DexEncodedValueArray(values, static_val);
+    }
+    case DEVT_ANNOTATION: {
+      auto anno_type = type_at(in.u32());
+      auto elems = new EncodedAnnotations();
+      auto num_elems = in.u32();
+      for (uint32_t i = 0; i < num_elems; ++i) {
+        auto key = string_at(in.u32());
+        elems->emplace_back(key, read_value(in));
+      }
+      return new DexEncodedValueAnnotation(anno_type, elems);
+    }
+    case DEVT_NULL:
+    case DEVT_BOOLEAN:
+      return new DexEncodedValueBit(evtype, in.u64() != 0);
+    default:
+      return DexEncodedValue::make_numeric(evtype, in.u64());
+    }
+  }
+
+  IRInstruction* read_insn(Reader& in) const {
+    auto insn = new IRInstruction(static_cast<IROpcode>(in.u16()));
+    auto dest = in.u16();
+    if (insn->dests_size()) {
+      insn->set_dest(dest);
+    }
+    auto num_srcs = in.u16();
+    insn->set_arg_word_count(num_srcs);
+    for (uint16_t i = 0; i < num_srcs; ++i) {
+      insn->set_src(i, in.u16());
+    }
+    switch (opcode::ref(insn->opcode())) {
+    case opcode::Ref::None:
+      break;
+    case opcode::Ref::Literal:
+      insn->set_literal(static_cast<int64_t>(in.u64()));
+      break;
+    case opcode::Ref::String:
+      insn->set_string(string_at(in.u32()));
+      break;
+    case opcode::Ref::Type:
+      insn->set_type(type_at(in.u32()));
+      break;
+    case opcode::Ref::Field:
+      insn->set_field(field_at(in.u32()));
+      break;
+    case opcode::Ref::Method:
+      insn->set_method(method_at(in.u32()));
+      break;
+    case opcode::Ref::Data: {
+      auto size = in.u32();
+      always_assert_log(size > 0, "Malformed IR snapshot");
+      std::vector<uint16_t> units(size);
+      for (auto& unit : units) {
+        unit = in.u16();
+      }
+      insn->set_data(new DexOpcodeData(units.data(), size - 1));
+      break;
+    }
+    }
+    return insn;
+  }
+
+  std::unique_ptr<DexDebugInstruction> read_debug(Reader& in) const {
+    auto op = static_cast<DexDebugItemOpcode>(in.u8());
+    bool is_signed = in.u8();
+    auto uvalue = in.u32();
+    switch (op) {
+    case DBG_SET_FILE:
+      return std::make_unique<DexDebugOpcodeSetFile>(string_at(in.u32()));
+    case DBG_START_LOCAL:
+    case DBG_START_LOCAL_EXTENDED: {
+      auto name = string_at(in.u32());
+      auto type = type_at(in.u32());
+      auto sig = string_at(in.u32());
+      return std::make_unique<DexDebugOpcodeStartLocal>(uvalue, name, type,
+                                                        sig);
+    }
+    default:
+      if (is_signed) {
+        return std::make_unique<DexDebugInstruction>(
+            op, static_cast<int32_t>(uvalue));
+      }
+      return std::make_unique<DexDebugInstruction>(op, uvalue);
+    }
+  }
+
+  std::vector<DexString*> m_strings;
+  std::vector<DexType*> m_types;
+  std::vector<DexTypeList*> m_type_lists;
+  std::vector<DexProto*> m_protos;
+  std::vector<DexFieldRef*> m_fields;
+  std::vector<DexMethodRef*> m_methods;
+};
+
+// Only the non-empty dexes are kept, as in the intermediate dexes.
+template <typename Fn>
+void for_each_dex(const DexStoresVector& stores, const Fn& fn) {
+  for (const auto& store : stores) {
+    for (const auto& dex : store.get_dexen()) {
+      if (!dex.empty()) {
+        fn(store, dex);
+      }
+    }
+  }
+}
+
+} // namespace
+
+namespace ir_snapshot {
+
+void dump(const DexStoresVector& stores, const std::string& output_dir) {
+  std::vector<std::pair<DexClass*, std::string>> classes;
+  for_each_dex(stores, [&](const DexStore&, const DexClasses& dex) {
+    for (auto cls : dex) {
+      classes.emplace_back(cls, std::string());
+    }
+  });
+
+  References refs;
+  parallel_for(classes.begin(), classes.end(),
+               [&](std::pair<DexClass*, std::string>& pair) {
+                 std::string ignored;
+                 Encoder<References>(refs, &ignored).write_class(pair.first);
+               });
+  refs.close();
+  const Tables tables(refs);
+  parallel_for(classes.begin(), classes.end(),
+               [&](std::pair<DexClass*, std::string>& pair) {
+                 Encoder<const Tables>(tables, &pair.second)
+                     .write_class(pair.first);
+               });
+
+  std::string contents;
+  Writer out(&contents);
+  tables.write(out);
+  auto next_class = classes.begin();
+  out.u32(stores.size());
+  for (const auto& store : stores) {
+    out.str(store.get_name());
+    uint32_t num_dexes = 0;
+    for (const auto& dex : store.get_dexen()) {
+      num_dexes += !dex.empty();
+    }
+    out.u32(num_dexes);
+    for (const auto& dex : store.get_dexen()) {
+      if (dex.empty()) {
+        continue;
+      }
+      out.u32(dex.size());
+      for (size_t i = 0; i < dex.size(); ++i, ++next_class) {
+        out.bytes(next_class->second);
+        // Release the class as soon as it is in the snapshot.
+        std::string().swap(next_class->second);
+      }
+    }
+  }
+
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  header.file_size = sizeof(header) + contents.size();
+  auto path = output_dir + SNAPSHOT_FILE_NAME;
+  std::ofstream ofs(path, std::ofstream::binary);
+  ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  ofs.write(contents.data(), contents.size());
+  ofs.close();
+  always_assert_log(ofs, "Error writing %s: %s\n", path.c_str(),
+                    strerror(errno));
+}
+
+bool load(const std::string& input_dir, DexStoresVector& stores) {
+  auto path = input_dir + SNAPSHOT_FILE_NAME;
+  if (!boost::filesystem::exists(path)) {
+    return false;
+  }
+  boost::iostreams::mapped_file_source file(path);
+  SnapshotHeader header;
+  if (file.size() < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, file.data(), sizeof(header));
+  if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+      header.file_size != file.size()) {
+    fprintf(stderr,
+            "warning: ignoring IR snapshot %s: it is truncated or was "
+            "written by another version\n",
+            path.c_str());
+    return false;
+  }
+
+  Reader in(file.data() + sizeof(header), file.data() + file.size());
+  Decoder decoder;
+  decoder.read_tables(in);
+  std::vector<PendingCode> pending;
+  auto num_stores = in.u32();
+  for (uint32_t i = 0; i < num_stores; ++i) {
+    stores.emplace_back(in.str());
+    auto num_dexes = in.u32();
+    for (uint32_t j = 0; j < num_dexes; ++j) {
+      DexClasses classes(in.u32());
+      for (auto& cls : classes) {
+        cls = decoder.read_class(in, &pending);
+      }
+      stores.back().add_classes(std::move(classes));
+    }
+  }
+  always_assert_log(in.at_end(), "Malformed IR snapshot %s", path.c_str());
+  parallel_for(pending.begin(), pending.end(),
+               [&](const PendingCode& code) { decoder.decode_code(code); });
+  return true;
+}
+
+} // namespace ir_snapshot
@@ -0,0 +1,39 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "DexStore.h"
+
+/*
+ * A binary snapshot of the IR of every class in the stores: the interned
+ * strings, types, type lists, protos and member references, the classes with
+ * their annotations and static values, and the IRCode of their methods, with
+ * its positions, debug entries and try/catch and branch structure. Unlike the
+ * intermediate dexes, the code is kept as it is between passes, so loading the
+ * snapshot needs no ballooning and loses nothing that lowering would.
+ *
+ * The snapshot is memory-mapped when loaded: the strings are interned straight
+ * from the mapping, and the code of the methods is decoded in parallel. It is
+ * only meant to be read by the build of Redex that wrote it, on the same
+ * machine. The ReferencedState and deobfuscated names are not in it; they are
+ * kept by the IR meta (see IRMetaIO.h).
+ */
+namespace ir_snapshot {
+
+void dump(const DexStoresVector& stores, const std::string& output_dir);
+
+/*
+ * Returns false, without loading anything, if there is no snapshot in the
+ * directory or it was written by another version. Otherwise the classes are
+ * created and added to new stores, appended to `stores`.
+ */
+bool load(const std::string& input_dir, DexStoresVector& stores);
+
+} // namespace ir_snapshot
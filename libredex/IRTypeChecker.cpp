@@ -7,11 +7,14 @@
 
 #include "IRTypeChecker.h"
 
+#include <algorithm>
+#include <atomic>
 #include <boost/optional/optional_io.hpp>
 #include <cstdint>
 #include <functional>
 #include <iomanip>
 #include <limits>
+#include <mutex>
 #include <ostream>
 #include <sstream>
 #include <stdexcept>
@@ -34,6 +37,7 @@
 #include "PatriciaTreeMapAbstractEnvironment.h"
 #include "ReducedProductAbstractDomain.h"
 #include "Show.h"
+#include "Walkers.h"
 
 using namespace sparta;
 
@@ -189,6 +193,15 @@ class TypeInference final : public BaseIRAnalyzer<TypeEnvironment> {
         m_inference(true) {}
 
   void run(DexMethod* dex_method) {
+    infer(dex_method);
+    populate_type_environments();
+    // We turn off the type inference mode. All subsequent calls to
+    // analyze_instruction will perform type checking.
+    m_inference = false;
+  }
+
+  // Computes the fixpoint only, for check_and_analyze.
+  void infer(DexMethod* dex_method) {
     // We need to compute the initial environment by assigning the parameter
     // registers their correct types derived from the method's signature. The
     // IOPCODE_LOAD_PARAM_* instructions are pseudo-operations that are used to
@@ -246,10 +259,17 @@ class TypeInference final : public BaseIRAnalyzer<TypeEnvironment> {
     }
   done:
     MonotonicFixpointIterator::run(init_state);
-    populate_type_environments();
-    // We turn off the type inference mode. All subsequent calls to
-    // analyze_instruction will perform type checking.
+  }
+
+  // Type checks an instruction against the environment that precedes it,
+  // then updates the environment past the instruction. Walking each block
+  // this way from its entry state checks the method without storing the
+  // environment of every instruction.
+  void check_and_analyze(IRInstruction* insn, TypeEnvironment* current_state) {
     m_inference = false;
+    analyze_instruction(insn, current_state);
+    m_inference = true;
+    analyze_instruction(insn, current_state);
   }
 
   // This method is used in two different modes. When m_inference == true, it
@@ -657,7 +677,8 @@ class TypeInference final : public BaseIRAnalyzer<TypeEnvironment> {
     case OPCODE_INVOKE_STATIC:
     case OPCODE_INVOKE_INTERFACE: {
       DexMethodRef* dex_method = insn->get_method();
-      auto arg_types = dex_method->get_proto()->get_args()->get_type_list();
+      const auto& arg_types =
+          dex_method->get_proto()->get_args()->get_type_list();
       size_t src_idx{0};
       if (insn->opcode() != OPCODE_INVOKE_STATIC) {
         // The first argument is a reference to the object instance on which the
@@ -1338,6 +1359,7 @@ IRTypeChecker::IRTypeChecker(DexMethod* dex_method)
       m_complete(false),
       m_enable_polymorphic_constants(false),
       m_verify_moves(false),
+      m_check_only(false),
       m_good(true),
       m_what("OK") {}
 
@@ -1368,6 +1390,39 @@ void IRTypeChecker::run() {
   const cfg::ControlFlowGraph& cfg = code->cfg();
   m_type_inference = std::make_unique<irtc_impl::TypeInference>(
       cfg, m_enable_polymorphic_constants, m_verify_moves);
+  auto report = [this](const MethodItemEntry& mie,
+                       const irtc_impl::TypeCheckingException& e) {
+    m_good = false;
+    std::ostringstream out;
+    out << "Type error in method " << m_dex_method->get_deobfuscated_name()
+        << " at instruction '" << SHOW(mie.insn) << "' @ " << std::hex
+        << static_cast<const void*>(&mie) << " for " << e.what();
+    m_what = out.str();
+  };
+
+  if (m_check_only) {
+    // The blocks of a non-editable CFG follow the order of the code, so this
+    // finds the same first error as the check below.
+    m_type_inference->infer(m_dex_method);
+    for (cfg::Block* block : cfg.blocks()) {
+      if (!m_good) {
+        break;
+      }
+      auto current_state = m_type_inference->get_entry_state_at(block);
+      for (const MethodItemEntry& mie : InstructionIterable(block)) {
+        try {
+          m_type_inference->check_and_analyze(mie.insn, &current_state);
+        } catch (const irtc_impl::TypeCheckingException& e) {
+          report(mie, e);
+          break;
+        }
+      }
+    }
+    m_type_inference.reset();
+    code->clear_cfg();
+    m_complete = true;
+    return;
+  }
   m_type_inference->run(m_dex_method);
 
   // Finally, we use the inferred types to type-check each instruction in the
@@ -1380,12 +1435,7 @@ void IRTypeChecker::run() {
       always_assert(it != type_envs.end());
       m_type_inference->analyze_instruction(insn, &it->second);
     } catch (const irtc_impl::TypeCheckingException& e) {
-      m_good = false;
-      std::ostringstream out;
-      out << "Type error in method " << m_dex_method->get_deobfuscated_name()
-          << " at instruction '" << SHOW(insn) << "' @ " << std::hex
-          << static_cast<const void*>(&mie) << " for " << e.what();
-      m_what = out.str();
+      report(mie, e);
       m_complete = true;
       return;
     }
@@ -1400,7 +1450,7 @@ void IRTypeChecker::run() {
 }
 
 IRType IRTypeChecker::get_type(IRInstruction* insn, uint16_t reg) const {
-  check_completion();
+  check_types_available();
   auto& type_envs = m_type_inference->m_type_envs;
   auto it = type_envs.find(insn);
   if (it == type_envs.end()) {
@@ -1413,7 +1463,7 @@ IRType IRTypeChecker::get_type(IRInstruction* insn, uint16_t reg) const {
 
 const DexType* IRTypeChecker::get_dex_type(IRInstruction* insn,
                                            uint16_t reg) const {
-  check_completion();
+  check_types_available();
   auto& type_envs = m_type_inference->m_type_envs;
   auto it = type_envs.find(insn);
   if (it == type_envs.end()) {
@@ -1424,7 +1474,53 @@ const DexType* IRTypeChecker::get_dex_type(IRInstruction* insn,
   return *it->second.get_dex_type(reg);
 }
 
+IRTypeChecker::ScopeResult IRTypeChecker::check_scope(
+    const Scope& scope,
+    const ScopeOptions& options,
+    const std::function<bool(DexMethod*)>& should_check) {
+  std::atomic<size_t> checked{0};
+  std::atomic<bool> failed{false};
+  std::mutex failures_lock;
+  ScopeResult result;
+  auto check = [&](DexMethod* method) {
+    if (options.stop_at_first_failure && failed.load()) {
+      return;
+    }
+    if (should_check && !should_check(method)) {
+      return;
+    }
+    ++checked;
+    IRTypeChecker checker(method);
+    checker.check_only();
+    if (options.polymorphic_constants) {
+      checker.enable_polymorphic_constants();
+    }
+    if (options.verify_moves) {
+      checker.verify_moves();
+    }
+    checker.run();
+    if (checker.fail()) {
+      failed = true;
+      std::lock_guard<std::mutex> guard(failures_lock);
+      result.failures.push_back({method, checker.what()});
+    }
+  };
+  walk::parallel::methods(scope,
+                          check,
+                          options.num_threads > 0
+                              ? options.num_threads
+                              : walk::parallel::default_num_threads());
+  result.checked = checked;
+  std::sort(result.failures.begin(),
+            result.failures.end(),
+            [](const Failure& a, const Failure& b) {
+              return compare_dexmethods(a.method, b.method);
+            });
+  return result;
+}
+
 std::ostream& operator<<(std::ostream& output, const IRTypeChecker& checker) {
+  checker.check_types_available();
   checker.m_type_inference->print(output);
   return output;
 }
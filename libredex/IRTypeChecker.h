@@ -8,9 +8,11 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <memory>
 #include <ostream>
 #include <string>
+#include <vector>
 
 #include "Debug.h"
 #include "DexClass.h"
@@ -193,6 +195,20 @@ class IRTypeChecker final {
     }
   }
 
+  /*
+   * Only check the method, without keeping the inferred types: the type
+   * environments are computed one block at a time from the fixpoint and
+   * discarded, instead of being stored for every instruction, and the CFG is
+   * freed once the check is done. get_type and get_dex_type can't be used
+   * afterwards. This is how check_scope checks methods.
+   */
+  void check_only() {
+    if (!m_complete) {
+      // We can only set this parameter before running the type checker.
+      m_check_only = true;
+    }
+  }
+
   void run();
 
   bool good() const {
@@ -228,6 +244,37 @@ class IRTypeChecker final {
 
   const DexType* get_dex_type(IRInstruction* insn, uint16_t reg) const;
 
+  struct ScopeOptions {
+    bool polymorphic_constants{false};
+    bool verify_moves{false};
+    // Stop starting new checks as soon as a method fails. The methods whose
+    // checks were already under way still report their failures.
+    bool stop_at_first_failure{false};
+    // The default of the parallel walks if 0.
+    size_t num_threads{0};
+  };
+
+  struct Failure {
+    DexMethod* method;
+    std::string what;
+  };
+
+  struct ScopeResult {
+    size_t checked{0};
+    // Ordered by method, so that the first one doesn't depend on scheduling.
+    std::vector<Failure> failures;
+  };
+
+  /*
+   * Check the methods of `scope` in parallel, skipping those for which
+   * `should_check` returns false, if it is given. `should_check` is called
+   * from the worker threads.
+   */
+  static ScopeResult check_scope(
+      const Scope& scope,
+      const ScopeOptions& options,
+      const std::function<bool(DexMethod*)>& should_check = nullptr);
+
  private:
   void check_completion() const {
     always_assert_log(m_complete,
@@ -235,10 +282,18 @@ class IRTypeChecker final {
                       m_dex_method->get_deobfuscated_name().c_str());
   }
 
+  void check_types_available() const {
+    check_completion();
+    always_assert_log(!m_check_only,
+                      "The types of method %s were not kept.\n",
+                      m_dex_method->get_deobfuscated_name().c_str());
+  }
+
   DexMethod* m_dex_method;
   bool m_complete;
   bool m_enable_polymorphic_constants;
   bool m_verify_moves;
+  bool m_check_only;
   bool m_good;
   std::string m_what;
   std::unique_ptr<irtc_impl::TypeInference> m_type_inference;
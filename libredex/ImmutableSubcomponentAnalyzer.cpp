@@ -282,11 +282,11 @@ class Analyzer final : public BaseIRAnalyzer<AbstractAccessPathEnvironment> {
 
   boost::optional<AccessPath> get_access_path(size_t reg,
                                               IRInstruction* insn) const {
-    auto it = m_environments.find(insn);
-    if (it == m_environments.end()) {
+    auto env = get_environment(insn);
+    if (env == nullptr) {
       return boost::none;
     }
-    AbstractAccessPathDomain abs_path = it->second.get(reg);
+    AbstractAccessPathDomain abs_path = env->get(reg);
     return abs_path.access_path();
   }
 
@@ -313,26 +313,54 @@ class Analyzer final : public BaseIRAnalyzer<AbstractAccessPathEnvironment> {
   std::set<size_t> find_access_path_registers(
       IRInstruction* insn,
       const AccessPath& path) const {
-    auto it = m_environments.find(insn);
-    if (it == m_environments.end()) {
+    auto env = get_environment(insn);
+    if (env == nullptr) {
       return {};
     }
-    auto env = it->second;
-    return find_access_path_registers(env, path);
+    return find_access_path_registers(*env, path);
   }
 
-  void populate_environments() {
-    // We reserve enough space for the map in order to avoid repeated rehashing
-    // during the computation.
-    m_environments.reserve(m_cfg.blocks().size() * 16);
+  /*
+   * Only the block of each instruction is recorded here. The environments at
+   * the instructions themselves are recomputed from the fixpoint's entry state
+   * of their block when they are first queried.
+   */
+  void populate_instruction_blocks() {
     for (cfg::Block* block : m_cfg.blocks()) {
+      for (auto& mie : InstructionIterable(block)) {
+        m_insn_blocks.emplace(mie.insn, block);
+      }
+    }
+  }
+
+  cfg::Block* get_block(const IRInstruction* insn) const {
+    auto it = m_insn_blocks.find(insn);
+    return it == m_insn_blocks.end() ? nullptr : it->second;
+  }
+
+  /*
+   * Clients typically issue several queries on instructions of the same block
+   * in a row, hence we only keep the environments of the last block queried.
+   * This bounds the memory footprint by the size of the largest block instead
+   * of the size of the method.
+   */
+  const AbstractAccessPathEnvironment* get_environment(
+      const IRInstruction* insn) const {
+    cfg::Block* block = get_block(insn);
+    if (block == nullptr) {
+      return nullptr;
+    }
+    if (block != m_cached_block) {
+      m_cached_environments.clear();
       AbstractAccessPathEnvironment current_state = get_entry_state_at(block);
       for (auto& mie : InstructionIterable(block)) {
-        IRInstruction* insn = mie.insn;
-        m_environments.emplace(insn, current_state);
-        analyze_instruction(insn, &current_state);
+        IRInstruction* block_insn = mie.insn;
+        m_cached_environments.emplace(block_insn, current_state);
+        analyze_instruction(block_insn, &current_state);
       }
+      m_cached_block = block;
     }
+    return &m_cached_environments.at(insn);
   }
 
   BindingSnapshot get_known_access_path_bindings(
@@ -353,16 +381,28 @@ class Analyzer final : public BaseIRAnalyzer<AbstractAccessPathEnvironment> {
     return ret;
   }
 
+  BlockStateSnapshot get_block_state_snapshot(cfg::Block* block) {
+    return {get_known_access_path_bindings(get_entry_state_at(block)),
+            get_known_access_path_bindings(get_exit_state_at(block))};
+  }
+
   std::unordered_map<cfg::BlockId, BlockStateSnapshot> get_block_state_snapshot() {
     std::unordered_map<cfg::BlockId, BlockStateSnapshot> ret;
     for (NodeId block : m_cfg.blocks()) {
-      auto entry_state = get_entry_state_at(block);
-      auto exit_state = get_exit_state_at(block);
-      BlockStateSnapshot snapshot = {
-        get_known_access_path_bindings(entry_state),
-        get_known_access_path_bindings(exit_state)
-      };
-      ret.emplace(block->id(), snapshot);
+      ret.emplace(block->id(), get_block_state_snapshot(block));
+    }
+    return ret;
+  }
+
+  std::unordered_map<cfg::BlockId, BlockStateSnapshot> get_block_state_snapshot(
+      const std::vector<IRInstruction*>& insns) {
+    std::unordered_map<cfg::BlockId, BlockStateSnapshot> ret;
+    for (IRInstruction* insn : insns) {
+      cfg::Block* block = get_block(insn);
+      if (block == nullptr || ret.count(block->id())) {
+        continue;
+      }
+      ret.emplace(block->id(), get_block_state_snapshot(block));
     }
     return ret;
   }
@@ -370,8 +410,11 @@ class Analyzer final : public BaseIRAnalyzer<AbstractAccessPathEnvironment> {
  private:
   const cfg::ControlFlowGraph& m_cfg;
   std::function<bool(DexMethodRef*)> m_is_immutable_getter;
-  std::unordered_map<IRInstruction*, AbstractAccessPathEnvironment>
-      m_environments;
+  std::unordered_map<const IRInstruction*, cfg::Block*> m_insn_blocks;
+  mutable cfg::Block* m_cached_block{nullptr};
+  mutable std::unordered_map<const IRInstruction*,
+                             AbstractAccessPathEnvironment>
+      m_cached_environments;
   const std::unordered_set<uint16_t> m_allowed_locals;
 };
 
@@ -442,7 +485,7 @@ ImmutableSubcomponentAnalyzer::ImmutableSubcomponentAnalyzer(
   }
 
   m_analyzer->run(init);
-  m_analyzer->populate_environments();
+  m_analyzer->populate_instruction_blocks();
 }
 
 boost::optional<AccessPath> ImmutableSubcomponentAnalyzer::get_access_path(
@@ -468,3 +511,12 @@ std::unordered_map<cfg::BlockId, BlockStateSnapshot> ImmutableSubcomponentAnalyz
   }
   return m_analyzer->get_block_state_snapshot();
 }
+
+std::unordered_map<cfg::BlockId, BlockStateSnapshot>
+ImmutableSubcomponentAnalyzer::get_block_state_snapshot(
+    const std::vector<IRInstruction*>& insns) const {
+  if (m_analyzer == nullptr) {
+    return {};
+  }
+  return m_analyzer->get_block_state_snapshot(insns);
+}
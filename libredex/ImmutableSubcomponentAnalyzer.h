@@ -162,6 +162,11 @@ class ImmutableSubcomponentAnalyzer final {
   /*
    * The user-provided predicate is used to decide whether a method referenced
    * in an invoke-virtual operation is a getter for an immutable structure.
+   *
+   * The fixpoint is computed once at construction. The access paths at a given
+   * instruction are then recomputed on demand from the entry state of its
+   * block, so queries are cheap as long as they stay within the same block.
+   * Queries are not thread-safe.
    */
   ImmutableSubcomponentAnalyzer(
       DexMethod* dex_method,
@@ -186,6 +191,14 @@ class ImmutableSubcomponentAnalyzer final {
 
   std::unordered_map<cfg::BlockId, BlockStateSnapshot> get_block_state_snapshot() const;
 
+  /*
+   * Same as above, restricted to the blocks containing the given instructions.
+   * Clients that only inspect a few instructions should prefer this variant,
+   * as the snapshot of every block of a large method can be sizable.
+   */
+  std::unordered_map<cfg::BlockId, BlockStateSnapshot> get_block_state_snapshot(
+      const std::vector<IRInstruction*>& insns) const;
+
  private:
   std::unique_ptr<isa_impl::Analyzer> m_analyzer;
 };
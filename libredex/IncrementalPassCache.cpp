@@ -0,0 +1,233 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "IncrementalPassCache.h"
+
+#include <boost/functional/hash.hpp>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "BinarySerialization.h"
+#include "ConfigFiles.h"
+#include "DexClass.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "PassManager.h"
+#include "ReachableClasses.h"
+#include "Resolver.h"
+#include "Show.h"
+
+namespace {
+
+// Bump this whenever the format of the file or of the inputs changes.
+constexpr uint32_t k_cache_version = 2;
+
+// A hash of the running Redex binary, so that a cache written by another
+// build is never trusted. Empty if the binary can't be read.
+const std::string& build_id() {
+  static const std::string id = [] {
+    std::ifstream is("/proc/self/exe", std::ios::binary);
+    if (!is) {
+      return std::string();
+    }
+    size_t hash = 0;
+    std::string chunk(1 << 20, '\0');
+    while (is.read(&chunk[0], chunk.size()) || is.gcount() > 0) {
+      boost::hash_combine(hash, std::hash<std::string>()(chunk.substr(
+                                    0, static_cast<size_t>(is.gcount()))));
+    }
+    return std::to_string(hash);
+  }();
+  return id;
+}
+
+// The definitions that the code refers to, as far as a method-local pass can
+// observe them.
+void summarize_refs(const IRCode& code, std::ostream& out) {
+  for (const auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    if (insn->has_method()) {
+      auto method = resolve_method(insn->get_method(), opcode_to_search(insn));
+      if (method == nullptr) {
+        out << "?\n";
+        continue;
+      }
+      out << show(method) << ' ' << method->get_access() << ' '
+          << assumenosideeffects(method) << '\n';
+    } else if (insn->has_field()) {
+      auto field = resolve_field(insn->get_field());
+      if (field == nullptr) {
+        out << "?\n";
+        continue;
+      }
+      out << show(field) << ' ' << field->get_access() << '\n';
+    }
+  }
+}
+
+} // namespace
+
+IncrementalPassCache::IncrementalPassCache(const std::string& dir,
+                                           const std::string& name,
+                                           std::string config)
+    : m_path(dir + '/' + name + ".cache"), m_config(std::move(config)) {
+  load();
+}
+
+IncrementalPassCache::IncrementalPassCache(const ConfigFiles& cfg,
+                                           const PassManager& mgr,
+                                           const std::string& extra_config) {
+  std::string dir;
+  cfg.get_json_config().get("incremental_cache_dir", "", dir);
+  if (dir.empty()) {
+    return;
+  }
+  const auto* pass_info = mgr.get_current_pass_info();
+  always_assert(pass_info != nullptr);
+  m_path = dir + '/' + pass_info->name + ".cache";
+  m_config =
+      cfg.get_json_config()[pass_info->pass->name().c_str()].toStyledString() +
+      extra_config;
+  load();
+}
+
+void IncrementalPassCache::load() {
+  if (build_id().empty()) {
+    TRACE(PM, 1, "Not caching %s: can't identify the Redex binary\n",
+          m_path.c_str());
+    m_path.clear();
+    return;
+  }
+  std::ifstream is(m_path, std::ios::binary);
+  uint32_t version;
+  if (!is || !binary_serialization::read_header(is, &version) ||
+      version != k_cache_version) {
+    return;
+  }
+  std::string id;
+  if (!binary_serialization::read_string(is, &id) || id != build_id()) {
+    TRACE(PM, 1, "Ignoring %s: written by another build of Redex\n",
+          m_path.c_str());
+    return;
+  }
+  std::string config;
+  uint32_t num_entries;
+  if (!binary_serialization::read_string(is, &config) || config != m_config) {
+    TRACE(PM, 1, "Ignoring %s: the configuration changed\n", m_path.c_str());
+    return;
+  }
+  is.read((char*)&num_entries, sizeof(num_entries));
+  for (uint32_t i = 0; is && i < num_entries; ++i) {
+    std::string input;
+    Entry entry;
+    if (!binary_serialization::read_string(is, &input)) {
+      break;
+    }
+    is.read((char*)&entry.registers_size, sizeof(entry.registers_size));
+    if (!binary_serialization::read_string(is, &entry.code)) {
+      break;
+    }
+    uint32_t num_stats = 0;
+    is.read((char*)&num_stats, sizeof(num_stats));
+    for (uint32_t j = 0; is && j < num_stats; ++j) {
+      uint64_t stat;
+      is.read((char*)&stat, sizeof(stat));
+      entry.stats.push_back(static_cast<size_t>(stat));
+    }
+    if (!is) {
+      break;
+    }
+    m_loaded.emplace(std::move(input), std::move(entry));
+  }
+  TRACE(PM, 1, "Loaded %lu entries from %s\n", m_loaded.size(),
+        m_path.c_str());
+}
+
+IncrementalPassCache::Stats IncrementalPassCache::run(
+    DexMethod* method,
+    bool summarize_refs,
+    const std::function<Stats()>& optimize) {
+  auto* code = method->get_code();
+  if (!enabled() || code == nullptr || !assembler::can_express(code)) {
+    return optimize();
+  }
+
+  std::ostringstream input;
+  input << show(method) << ' ' << method->get_access() << '\n';
+  if (summarize_refs) {
+    ::summarize_refs(*code, input);
+  }
+  input << assembler::to_string(code);
+  auto key = input.str();
+
+  auto it = m_loaded.find(key);
+  if (it != m_loaded.end()) {
+    const auto& entry = it->second;
+    auto cached = assembler::ircode_from_string(entry.code);
+    cached->set_registers_size(entry.registers_size);
+    cached->set_debug_item(code->release_debug_item());
+    method->set_code(std::move(cached));
+    m_used.emplace(std::move(key), entry);
+    ++m_hits;
+    return entry.stats;
+  }
+
+  auto stats = optimize();
+  code = method->get_code();
+  if (code == nullptr || !assembler::can_express(code)) {
+    return stats;
+  }
+  auto output = assembler::to_string(code);
+  // Only keep the code that the assembler reads back as it was.
+  if (assembler::to_string(assembler::ircode_from_string(output).get()) !=
+      output) {
+    return stats;
+  }
+  m_used.emplace(std::move(key),
+                 Entry{static_cast<uint32_t>(code->get_registers_size()),
+                       std::move(output), stats});
+  return stats;
+}
+
+void IncrementalPassCache::save() const {
+  if (!enabled()) {
+    return;
+  }
+  // Write to a temporary file first, so that an interrupted run doesn't leave
+  // a truncated cache behind.
+  auto tmp_path = m_path + ".tmp";
+  {
+    std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!os) {
+      fprintf(stderr, "Unable to write %s\n", tmp_path.c_str());
+      return;
+    }
+    binary_serialization::write_header(os, k_cache_version);
+    binary_serialization::write_string(os, build_id());
+    binary_serialization::write_string(os, m_config);
+    binary_serialization::write<uint32_t>(os, m_used.size());
+    for (const auto& pair : m_used) {
+      binary_serialization::write_string(os, pair.first);
+      binary_serialization::write(os, pair.second.registers_size);
+      binary_serialization::write_string(os, pair.second.code);
+      binary_serialization::write<uint32_t>(os, pair.second.stats.size());
+      for (auto stat : pair.second.stats) {
+        binary_serialization::write<uint64_t>(os, stat);
+      }
+    }
+  }
+  std::rename(tmp_path.c_str(), m_path.c_str());
+}
+
+void IncrementalPassCache::finish(PassManager& mgr) const {
+  if (!enabled()) {
+    return;
+  }
+  save();
+  mgr.incr_metric("incremental_cache_hits", m_hits);
+}
@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ConcurrentContainers.h"
+
+class DexMethod;
+class IRCode;
+class PassManager;
+struct ConfigFiles;
+
+/*
+ * Keeps the results of a method-local pass from one Redex run to the next.
+ * In developer builds few methods change between runs, so only the changed
+ * methods need to be optimized again.
+ *
+ * The cache is enabled by setting the global `incremental_cache_dir` option.
+ * Each run of a pass in the pipeline has its own file in that directory.
+ *
+ * An entry maps the input of the pass for a method to the code the pass
+ * produced. The input is:
+ *  - the method's signature and access flags;
+ *  - the configuration of the pass;
+ *  - the code, in assembler syntax;
+ *  - optionally, a summary of the definitions that the instructions refer
+ *    to.
+ * When a method's input matches an entry, the cached code is installed
+ * instead of running the pass, and the statistics that the pass reported for
+ * the method are replayed, so the metrics of the pass don't depend on the
+ * state of the cache.
+ *
+ * The file also records a hash of the Redex binary that wrote it. The whole
+ * file is ignored when another build of Redex reads it.
+ *
+ * Caveat: some methods are never cached: those whose code the assembler
+ * syntax can't express (debug entries, fill-array-data), and those whose code
+ * is in an editable CFG.
+ */
+class IncrementalPassCache {
+ public:
+  // The counters that a pass reports for one method. Each pass decides what
+  // they mean; the cache only stores them.
+  using Stats = std::vector<size_t>;
+
+  // A disabled cache, which always runs the pass.
+  IncrementalPassCache() = default;
+
+  // A cache stored in `dir`, in the file `name`. The entries written with a
+  // different `config`, or by another build of Redex, are ignored.
+  IncrementalPassCache(const std::string& dir,
+                       const std::string& name,
+                       std::string config);
+
+  // The cache of the pass that `mgr` is running, configured from `cfg`. The
+  // configuration of the pass is its section of the config, plus
+  // `extra_config` for the settings that don't come from there.
+  IncrementalPassCache(const ConfigFiles& cfg,
+                       const PassManager& mgr,
+                       const std::string& extra_config = "");
+
+  bool enabled() const { return !m_path.empty(); }
+
+  /*
+   * Runs `optimize`, which changes the code of `method` and returns its
+   * statistics, unless an earlier run of the pass had the same input. In that
+   * case the cached code replaces the method's code instead, and the
+   * statistics that `optimize` returned back then are returned. With
+   * `summarize_refs`, the input includes the resolved methods and fields that
+   * the code refers to. Passes whose results depend on those definitions,
+   * e.g. on whether a callee has side effects, must set it.
+   *
+   * This can be called from several threads at once for different methods.
+   */
+  Stats run(DexMethod* method,
+            bool summarize_refs,
+            const std::function<Stats()>& optimize);
+
+  // Writes the entries that this run of the pass used or added. Entries that
+  // were not used are dropped.
+  void save() const;
+
+  // Saves the cache and records the number of hits as a metric of the pass.
+  void finish(PassManager& mgr) const;
+
+  size_t hits() const { return m_hits; }
+
+ private:
+  struct Entry {
+    uint32_t registers_size;
+    std::string code;
+    Stats stats;
+  };
+
+  void load();
+
+  std::string m_path;
+  std::string m_config;
+  std::unordered_map<std::string, Entry> m_loaded;
+  ConcurrentMap<std::string, Entry> m_used;
+  std::atomic<size_t> m_hits{0};
+};
@@ -7,6 +7,8 @@
 
 #include "Inliner.h"
 
+#include <numeric>
+
 #include "AnnoUtils.h"
 #include "ApiLevelChecker.h"
 #include "CFGInliner.h"
@@ -16,6 +18,7 @@
 #include "IRInstruction.h"
 #include "Mutators.h"
 #include "OptData.h"
+#include "Parallel.h"
 #include "Resolver.h"
 #include "Transform.h"
 #include "Walkers.h"
@@ -166,6 +169,23 @@ bool method_ok(DexType* type, DexMethodRef* meth) {
   return false;
 }
 
+/*
+ * Ignore internal opcodes because they do not take up any space in the final
+ * dex file. Ignore move opcodes with the hope that RegAlloc will eliminate
+ * most of them.
+ */
+size_t count_important_opcodes(const IRCode* code) {
+  size_t count{0};
+  editable_cfg_adapter::iterate(code, [&](const MethodItemEntry& mie) {
+    auto op = mie.insn->opcode();
+    if (!opcode::is_internal(op) && !opcode::is_move(op)) {
+      ++count;
+    }
+    return editable_cfg_adapter::LOOP_CONTINUE;
+  });
+  return count;
+}
+
 } // namespace
 
 MultiMethodInliner::MultiMethodInliner(
@@ -192,6 +212,10 @@ MultiMethodInliner::MultiMethodInliner(
 }
 
 void MultiMethodInliner::inline_methods() {
+  if (m_config.parallel) {
+    inline_methods_in_levels();
+    return;
+  }
   // we want to inline bottom up, so as a first step we identify all the
   // top level callers, then we recurse into all inlinable callees until we
   // hit a leaf and we start inlining from there
@@ -242,8 +266,116 @@ void MultiMethodInliner::caller_inline(
   inline_callees(caller, nonrecursive_callees);
 }
 
-void MultiMethodInliner::inline_callees(
-    DexMethod* caller, const std::vector<DexMethod*>& callees) {
+void MultiMethodInliner::compute_levels(
+    DexMethod* caller,
+    const std::vector<DexMethod*>& callees,
+    sparta::PatriciaTreeSet<DexMethod*> call_stack,
+    std::unordered_map<const DexMethod*, size_t>* level_of,
+    std::vector<std::vector<std::pair<DexMethod*, std::vector<DexMethod*>>>>*
+        levels) {
+  if (!level_of->emplace(caller, 0).second) {
+    return;
+  }
+  call_stack.insert(caller);
+
+  size_t level = 0;
+  std::vector<DexMethod*> nonrecursive_callees;
+  nonrecursive_callees.reserve(callees.size());
+  for (auto callee : callees) {
+    if (call_stack.contains(callee)) {
+      info.recursive++;
+      continue;
+    }
+    auto maybe_caller = caller_callee.find(callee);
+    if (maybe_caller != caller_callee.end()) {
+      compute_levels(
+          callee, maybe_caller->second, call_stack, level_of, levels);
+      // The callee is not on the call stack, so its level is final.
+      level = std::max(level, level_of->at(callee) + 1);
+    }
+    nonrecursive_callees.push_back(callee);
+  }
+  (*level_of)[caller] = level;
+  if (levels->size() <= level) {
+    levels->resize(level + 1);
+  }
+  (*levels)[level].emplace_back(caller, std::move(nonrecursive_callees));
+}
+
+void MultiMethodInliner::inline_methods_in_levels() {
+  std::unordered_map<const DexMethod*, size_t> level_of;
+  std::vector<std::vector<std::pair<DexMethod*, std::vector<DexMethod*>>>>
+      levels;
+  for (auto& it : caller_callee) {
+    auto caller = it.first;
+    if (callee_caller.find(caller) != callee_caller.end()) continue;
+    compute_levels(caller,
+                   it.second,
+                   sparta::PatriciaTreeSet<DexMethod*>(),
+                   &level_of,
+                   &levels);
+  }
+
+  for (const auto& level : levels) {
+    std::vector<std::vector<std::pair<DexMethod*, IRList::iterator>>> selected(
+        level.size());
+    for (size_t i = 0; i < level.size(); ++i) {
+      auto caller = level[i].first;
+      std::vector<DexMethod*> callees;
+      for (auto callee : level[i].second) {
+        if (should_inline(caller, callee)) {
+          callees.push_back(callee);
+        }
+      }
+      size_t estimated_insn_size = caller->get_code()->sum_opcode_sizes();
+      for (const auto& inlinable : find_inlinables(caller, callees)) {
+        auto callee = inlinable.first;
+        if (is_inlinable(
+                caller, callee, inlinable.second->insn, estimated_insn_size)) {
+          selected[i].push_back(inlinable);
+          estimated_insn_size += get_callee_summary(callee).code_size;
+        }
+      }
+    }
+
+    std::vector<std::vector<char>> succeeded(level.size());
+    // The visibility changes of the callees that are moved, which can only be
+    // applied serially, and only once the move has succeeded.
+    std::vector<std::vector<VisibilityChanges>> moved_visibility(
+        level.size());
+    std::vector<size_t> indices(level.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    parallel_for(indices.begin(),
+                 indices.end(),
+                 [&](size_t i) {
+                   auto caller = level[i].first;
+                   moved_visibility[i].resize(selected[i].size());
+                   for (size_t j = 0; j < selected[i].size(); ++j) {
+                     auto callee = selected[i][j].first;
+                     if (can_move_callee(callee)) {
+                       moved_visibility[i][j] =
+                           get_visibility_changes(callee);
+                     }
+                     succeeded[i].push_back(inline_inlinable(
+                         caller, callee, selected[i][j].second));
+                   }
+                 },
+                 /* grain */ 1);
+
+    for (size_t i = 0; i < level.size(); ++i) {
+      for (size_t j = 0; j < selected[i].size(); ++j) {
+        if (succeeded[i][j]) {
+          moved_visibility[i][j].apply();
+          record_inlined(selected[i][j].first);
+        }
+      }
+    }
+  }
+}
+
+std::vector<std::pair<DexMethod*, IRList::iterator>>
+MultiMethodInliner::find_inlinables(DexMethod* caller,
+                                    const std::vector<DexMethod*>& callees) {
   size_t found = 0;
 
   // walk the caller opcodes collecting all candidates to inline
@@ -275,8 +407,12 @@ void MultiMethodInliner::inline_callees(
     always_assert(found <= callees.size());
     info.not_found += callees.size() - found;
   }
+  return inlinables;
+}
 
-  inline_inlinables(caller, inlinables);
+void MultiMethodInliner::inline_callees(
+    DexMethod* caller, const std::vector<DexMethod*>& callees) {
+  inline_inlinables(caller, find_inlinables(caller, callees));
 }
 
 void MultiMethodInliner::inline_callees(
@@ -311,34 +447,66 @@ void MultiMethodInliner::inline_inlinables(
     if (!is_inlinable(caller, callee, callsite->insn, estimated_insn_size)) {
       continue;
     }
+    // The callee's code won't be around anymore once it is moved into the
+    // caller, so gather what record_inlined() can't.
+    VisibilityChanges moved_visibility;
+    if (can_move_callee(callee)) {
+      moved_visibility = get_visibility_changes(callee);
+    }
+    if (!inline_inlinable(caller, callee, callsite)) {
+      continue;
+    }
+    moved_visibility.apply();
+    estimated_insn_size += get_callee_summary(callee).code_size;
+    record_inlined(callee);
+  }
+}
 
-    TRACE(MMINL, 4, "inline %s (%d) in %s (%d)\n", SHOW(callee),
-          caller->get_code()->get_registers_size(), SHOW(caller),
-          callee->get_code()->get_registers_size());
+bool MultiMethodInliner::inline_inlinable(DexMethod* caller,
+                                          DexMethod* callee,
+                                          IRList::iterator callsite) {
+  TRACE(MMINL, 4, "inline %s (%d) in %s (%d)\n", SHOW(callee),
+        caller->get_code()->get_registers_size(), SHOW(caller),
+        callee->get_code()->get_registers_size());
+
+  if (m_config.use_cfg_inliner) {
+    bool success = inliner::inline_with_cfg(
+        caller, callee, callsite->insn, can_move_callee(callee));
+    if (!success) {
+      return false;
+    }
+  } else {
+    // Logging before the call to inline_method to get the most relevant line
+    // number near callsite before callsite gets replaced. Should be ok as
+    // inline_method does not fail to inline.
+    log_opt(INLINED, caller, callsite->insn);
 
-    if (m_config.use_cfg_inliner) {
-      bool success = inliner::inline_with_cfg(caller, callee, callsite->insn);
-      if (!success) {
-        continue;
-      }
-    } else {
-      // Logging before the call to inline_method to get the most relevant line
-      // number near callsite before callsite gets replaced. Should be ok as
-      // inline_method does not fail to inline.
-      log_opt(INLINED, caller, callsite->insn);
+    inliner::inline_method(caller->get_code(), callee->get_code(), callsite);
+  }
+  m_callee_summaries.erase(caller);
+  TRACE(INL, 2, "caller: %s\tcallee: %s\n", SHOW(caller), SHOW(callee));
+  return true;
+}
 
-      inliner::inline_method(caller->get_code(), callee->get_code(), callsite);
-    }
-    TRACE(INL, 2, "caller: %s\tcallee: %s\n", SHOW(caller), SHOW(callee));
-    estimated_insn_size += callee->get_code()->sum_opcode_sizes();
-    TRACE(MMINL,
-          6,
-          "checking visibility usage of members in %s\n",
-          SHOW(callee));
+void MultiMethodInliner::record_inlined(DexMethod* callee) {
+  TRACE(MMINL,
+        6,
+        "checking visibility usage of members in %s\n",
+        SHOW(callee));
+  if (!can_move_callee(callee)) {
     change_visibility(callee);
-    info.calls_inlined++;
-    inlined.insert(callee);
   }
+  info.calls_inlined++;
+  inlined.insert(callee);
+}
+
+bool MultiMethodInliner::can_move_callee(const DexMethod* callee) const {
+  if (!m_config.use_cfg_inliner || !m_config.move_single_callsite_callees) {
+    return false;
+  }
+  auto it = callee_caller.find(callee);
+  return it != callee_caller.end() && it->second.size() == 1 &&
+         can_delete(callee);
 }
 
 /**
@@ -348,12 +516,13 @@ bool MultiMethodInliner::is_inlinable(const DexMethod* caller,
                                       const DexMethod* callee,
                                       const IRInstruction* insn,
                                       size_t estimated_insn_size) {
+  auto summary = get_callee_summary(callee);
   // don't inline cross store references
-  if (cross_store_reference(callee)) {
+  if (summary.cross_store) {
     log_nopt(INL_CROSS_STORE_REFS, caller, insn);
     return false;
   }
-  if (is_blacklisted(callee)) {
+  if (summary.blacklisted) {
     log_nopt(INL_BLACKLISTED_CALLEE, callee);
     return false;
   }
@@ -361,14 +530,15 @@ bool MultiMethodInliner::is_inlinable(const DexMethod* caller,
     log_nopt(INL_BLACKLISTED_CALLER, caller);
     return false;
   }
-  if (has_external_catch(callee)) {
+  if (summary.external_catch) {
     log_nopt(INL_EXTERN_CATCH, callee);
     return false;
   }
   if (cannot_inline_opcodes(caller, callee, insn)) {
     return false;
   }
-  if (caller_too_large(caller->get_class(), estimated_insn_size, callee)) {
+  if (caller_too_large(
+          caller->get_class(), estimated_insn_size, summary.code_size)) {
     log_nopt(INL_TOO_BIG, caller, insn);
     return false;
   }
@@ -376,7 +546,7 @@ bool MultiMethodInliner::is_inlinable(const DexMethod* caller,
   // Don't inline code into a method that doesn't have the same (or higher)
   // required API. We don't want to bring API specific code into a class where
   // it's not supported.
-  int32_t callee_api = api::LevelChecker::get_method_level(callee);
+  int32_t callee_api = summary.api_level;
   if (callee_api != api::LevelChecker::get_min_level() &&
       callee_api > api::LevelChecker::get_method_level(caller)) {
     // check callee_api against the minimum and short-circuit because most
@@ -389,15 +559,36 @@ bool MultiMethodInliner::is_inlinable(const DexMethod* caller,
     return false;
   }
 
-  DexClass* cls = type_class(callee->get_class());
-  if (has_any_annotation(cls, m_config.no_inline) ||
-      has_any_annotation(callee, m_config.no_inline)) {
+  if (summary.no_inline) {
     return false;
   }
 
   return true;
 }
 
+MultiMethodInliner::CalleeSummary MultiMethodInliner::get_callee_summary(
+    const DexMethod* callee) {
+  CalleeSummary summary;
+  m_callee_summaries.update(
+      callee, [&](const DexMethod*, CalleeSummary& cached, bool exists) {
+        if (!exists) {
+          auto code = callee->get_code();
+          cached.code_size = code->sum_opcode_sizes();
+          cached.important_opcodes = count_important_opcodes(code);
+          cached.cross_store = cross_store_reference(callee);
+          cached.blacklisted = is_blacklisted(callee);
+          cached.external_catch = has_external_catch(callee);
+          cached.no_inline =
+              has_any_annotation(type_class(callee->get_class()),
+                                 m_config.no_inline) ||
+              has_any_annotation(callee, m_config.no_inline);
+          cached.api_level = api::LevelChecker::get_method_level(callee);
+        }
+        summary = cached;
+      });
+  return summary;
+}
+
 /**
  * Return whether the method or any of its ancestors are in the blacklist.
  * Typically used to prevent inlining / deletion of methods that are called
@@ -420,12 +611,11 @@ bool MultiMethodInliner::is_blacklisted(const DexMethod* callee) {
 }
 
 bool MultiMethodInliner::is_estimate_over_max(uint64_t estimated_caller_size,
-                                              const DexMethod* callee,
+                                              uint64_t callee_size,
                                               uint64_t max) {
   // INSTRUCTION_BUFFER is added because the final method size is often larger
   // than our estimate -- during the sync phase, we may have to pick larger
   // branch opcodes to encode large jumps.
-  auto callee_size = callee->get_code()->sum_opcode_sizes();
   if (estimated_caller_size + callee_size > max - INSTRUCTION_BUFFER) {
     info.caller_too_large++;
     return true;
@@ -435,8 +625,8 @@ bool MultiMethodInliner::is_estimate_over_max(uint64_t estimated_caller_size,
 
 bool MultiMethodInliner::caller_too_large(DexType* caller_type,
                                           size_t estimated_caller_size,
-                                          const DexMethod* callee) {
-  if (is_estimate_over_max(estimated_caller_size, callee,
+                                          size_t callee_size) {
+  if (is_estimate_over_max(estimated_caller_size, callee_size,
                            HARD_MAX_INSTRUCTION_SIZE)) {
     return true;
   }
@@ -449,7 +639,7 @@ bool MultiMethodInliner::caller_too_large(DexType* caller_type,
     return false;
   }
 
-  if (is_estimate_over_max(estimated_caller_size, callee,
+  if (is_estimate_over_max(estimated_caller_size, callee_size,
                            SOFT_MAX_INSTRUCTION_SIZE)) {
     return true;
   }
@@ -458,7 +648,7 @@ bool MultiMethodInliner::caller_too_large(DexType* caller_type,
 }
 
 bool MultiMethodInliner::should_inline(const DexMethod* caller,
-                                       const DexMethod* callee) const {
+                                       const DexMethod* callee) {
   if (has_any_annotation(callee, m_config.force_inline)) {
     return true;
   }
@@ -469,31 +659,11 @@ bool MultiMethodInliner::should_inline(const DexMethod* caller,
   return true;
 }
 
-/*
- * Ignore internal opcodes because they do not take up any space in the final
- * dex file. Ignore move opcodes with the hope that RegAlloc will eliminate
- * most of them.
- */
-static size_t count_important_opcodes(const IRCode* code) {
-  size_t count{0};
-  editable_cfg_adapter::iterate(code, [&](const MethodItemEntry& mie) {
-    auto op = mie.insn->opcode();
-    if (!opcode::is_internal(op) && !opcode::is_move(op)) {
-      ++count;
-    }
-    return editable_cfg_adapter::LOOP_CONTINUE;
-  });
-  return count;
-}
-
-bool MultiMethodInliner::too_many_callers(const DexMethod* callee) const {
+bool MultiMethodInliner::too_many_callers(const DexMethod* callee) {
   auto caller_count = callee_caller.at(callee).size();
   always_assert(caller_count > 0);
 
-  if (!m_opcode_counts.count(callee)) {
-    m_opcode_counts[callee] = count_important_opcodes(callee->get_code());
-  }
-  auto code_size = m_opcode_counts.at(callee);
+  auto code_size = get_callee_summary(callee).important_opcodes;
 
   if (!can_delete(callee)) {
     if (m_config.inline_small_non_deletables) {
@@ -550,34 +720,58 @@ bool MultiMethodInliner::has_external_catch(const DexMethod* callee) {
 bool MultiMethodInliner::cannot_inline_opcodes(const DexMethod* caller,
                                                const DexMethod* callee,
                                                const IRInstruction* invk_insn) {
+  // Make sure the rest of the summary is there before adding the verdict.
+  get_callee_summary(callee);
+  bool same_class = caller->get_class() == callee->get_class();
+  OpcodeVerdict verdict;
+  m_callee_summaries.update(
+      callee, [&](const DexMethod*, CalleeSummary& summary, bool) {
+        auto& cached = same_class ? summary.same_class_opcodes
+                                  : summary.other_class_opcodes;
+        if (!cached) {
+          cached = check_opcodes(caller, callee);
+        }
+        verdict = *cached;
+      });
+  if (verdict.callsite_reason) {
+    log_nopt(*verdict.callsite_reason, caller, invk_insn);
+  }
+  if (verdict.multiple_returns) {
+    log_nopt(INL_MULTIPLE_RETURNS, callee);
+  }
+  return !verdict.inlinable;
+}
+
+MultiMethodInliner::OpcodeVerdict MultiMethodInliner::check_opcodes(
+    const DexMethod* caller, const DexMethod* callee) {
   int ret_count = 0;
-  bool can_inline = true;
+  OpcodeVerdict verdict;
   editable_cfg_adapter::iterate(
       callee->get_code(), [&](const MethodItemEntry& mie) {
         auto insn = mie.insn;
         if (create_vmethod(insn)) {
-          log_nopt(INL_CREATE_VMETH, caller, invk_insn);
-          can_inline = false;
+          verdict.callsite_reason = INL_CREATE_VMETH;
+          verdict.inlinable = false;
           return editable_cfg_adapter::LOOP_BREAK;
         }
         if (nonrelocatable_invoke_super(insn, callee, caller)) {
-          log_nopt(INL_HAS_INVOKE_SUPER, caller, invk_insn);
-          can_inline = false;
+          verdict.callsite_reason = INL_HAS_INVOKE_SUPER;
+          verdict.inlinable = false;
           return editable_cfg_adapter::LOOP_BREAK;
         }
         if (unknown_virtual(insn, callee, caller)) {
-          log_nopt(INL_UNKNOWN_VIRTUAL, caller, invk_insn);
-          can_inline = false;
+          verdict.callsite_reason = INL_UNKNOWN_VIRTUAL;
+          verdict.inlinable = false;
           return editable_cfg_adapter::LOOP_BREAK;
         }
         if (unknown_field(insn, callee, caller)) {
-          log_nopt(INL_UNKNOWN_FIELD, caller, invk_insn);
-          can_inline = false;
+          verdict.callsite_reason = INL_UNKNOWN_FIELD;
+          verdict.inlinable = false;
           return editable_cfg_adapter::LOOP_BREAK;
         }
         if (!m_config.throws_inline && insn->opcode() == OPCODE_THROW) {
           info.throws++;
-          can_inline = false;
+          verdict.inlinable = false;
           return editable_cfg_adapter::LOOP_BREAK;
         }
         if (is_return(insn->opcode())) {
@@ -594,10 +788,10 @@ bool MultiMethodInliner::cannot_inline_opcodes(const DexMethod* caller,
   // The CFG inliner can handle multiple return callees.
   if (ret_count > 1 && !m_config.use_cfg_inliner) {
     info.multi_ret++;
-    log_nopt(INL_MULTIPLE_RETURNS, callee);
-    can_inline = false;
+    verdict.multiple_returns = true;
+    verdict.inlinable = false;
   }
-  return !can_inline;
+  return verdict;
 }
 
 /**
@@ -1115,7 +1309,7 @@ void inline_method(IRCode* caller_code,
   const auto invoke_position = last_position_before(pos, caller_code);
   if (invoke_position) {
     TRACE(INL, 3, "Inlining call at %s:%d\n",
-          invoke_position->file->c_str(),
+          invoke_position->file()->c_str(),
           invoke_position->line);
   }
 
@@ -1236,7 +1430,8 @@ void inline_tail_call(DexMethod* caller,
 // return true on successful inlining, false otherwise
 bool inline_with_cfg(DexMethod* caller_method,
                      DexMethod* callee_method,
-                     IRInstruction* callsite) {
+                     IRInstruction* callsite,
+                     bool move_callee) {
   auto& caller_cfg = caller_method->get_code()->cfg();
   const cfg::InstructionIterator& callsite_it = caller_cfg.find_insn(callsite);
   if (callsite_it.is_end()) {
@@ -1254,8 +1449,14 @@ bool inline_with_cfg(DexMethod* caller_method,
   // inline_cfg does not fail to inline.
   log_opt(INLINED, caller_method, callsite);
 
-  cfg::CFGInliner::inline_cfg(&caller_cfg, callsite_it,
-                              callee_method->get_code()->cfg());
+  if (move_callee) {
+    cfg::CFGInliner::inline_cfg_by_move(&caller_cfg, callsite_it,
+                                        &callee_method->get_code()->cfg());
+    callee_method->set_code(nullptr);
+  } else {
+    cfg::CFGInliner::inline_cfg(&caller_cfg, callsite_it,
+                                callee_method->get_code()->cfg());
+  }
   return true;
 }
 
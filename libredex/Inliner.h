@@ -12,9 +12,13 @@
 #include <set>
 #include <vector>
 
+#include <boost/optional.hpp>
+
+#include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "DexStore.h"
 #include "IRCode.h"
+#include "OptDataDefs.h"
 #include "PatriciaTreeSet.h"
 #include "Resolver.h"
 
@@ -50,10 +54,15 @@ void inline_method(IRCode* caller,
 /*
  * Use the editable CFG instead of IRCode to do the inlining. Return true on
  * success.
+ *
+ * If `move_callee` is true, the callee's blocks are moved into the caller
+ * rather than copied, and on success the callee is left without code. Only do
+ * this for a callee that gets deleted after this callsite is inlined.
  */
 bool inline_with_cfg(DexMethod* caller_method,
                      DexMethod* callee_method,
-                     IRInstruction* callsite);
+                     IRInstruction* callsite,
+                     bool move_callee = false);
 
 } // namespace inliner
 
@@ -74,6 +83,13 @@ class MultiMethodInliner {
     bool multiple_callers{false};
     bool inline_small_non_deletables{false};
     bool use_cfg_inliner{false};
+    // With the CFG inliner, move the code of a deletable callee that has a
+    // single callsite into its caller instead of copying it. The callee is
+    // left without code, so the pass must delete the inlined methods.
+    bool move_single_callsite_callees{false};
+    // Inline level by level from the leaves up, with the callers of each
+    // level edited concurrently. See inline_methods_in_levels().
+    bool parallel{false};
     std::unordered_set<DexType*> black_list;
     std::unordered_set<DexType*> caller_black_list;
     std::unordered_set<DexType*> whitelist_no_method_limit;
@@ -118,6 +134,40 @@ class MultiMethodInliner {
                       const std::unordered_set<IRInstruction*>& insns);
 
  private:
+  /**
+   * Outcome of the opcode checks of cannot_inline_opcodes() for one callee.
+   */
+  struct OpcodeVerdict {
+    bool inlinable{true};
+    // The reason logged for each rejected callsite, if any.
+    boost::optional<NoptReason> callsite_reason;
+    bool multiple_returns{false};
+  };
+
+  /**
+   * What the inlining decisions need to know about a callee that does not
+   * depend on the caller. A summary is computed the first time the callee is
+   * considered, and dropped whenever code gets inlined into the callee.
+   */
+  struct CalleeSummary {
+    // The sum of the opcode sizes of the callee.
+    size_t code_size{0};
+    // See count_important_opcodes().
+    size_t important_opcodes{0};
+    bool cross_store{false};
+    bool blacklisted{false};
+    bool external_catch{false};
+    bool no_inline{false};
+    int32_t api_level{0};
+    // The opcode checks only depend on whether the caller and the callee are
+    // in the same class, so there is one verdict for each case. They are
+    // computed lazily.
+    boost::optional<OpcodeVerdict> same_class_opcodes;
+    boost::optional<OpcodeVerdict> other_class_opcodes;
+  };
+
+  CalleeSummary get_callee_summary(const DexMethod* callee);
+
   /**
    * Inline all callees into caller.
    * Recurse in a callee if that has inlinable candidates of its own.
@@ -128,10 +178,53 @@ class MultiMethodInliner {
                      sparta::PatriciaTreeSet<DexMethod*> call_stack,
                      std::unordered_set<DexMethod*>* visited);
 
+  /**
+   * Sort the callers reached by the traversal of caller_inline() into levels.
+   * A caller is one level above the highest of its callees that are callers
+   * themselves, so callers that only call leaves are at level 0. Callees that
+   * are on the call stack are dropped, just like in caller_inline().
+   */
+  void compute_levels(
+      DexMethod* caller,
+      const std::vector<DexMethod*>& callees,
+      sparta::PatriciaTreeSet<DexMethod*> call_stack,
+      std::unordered_map<const DexMethod*, size_t>* level_of,
+      std::vector<std::vector<std::pair<DexMethod*, std::vector<DexMethod*>>>>*
+          levels);
+
+  /**
+   * The parallel version of inline_methods(). Levels are processed from the
+   * bottom up. The inlining decisions for all the callers of a level are made
+   * in sequence, and then the callers are edited concurrently, each one by a
+   * single thread. Callees of a level are all in lower levels, so their code
+   * is final and only read. The bookkeeping of the inlined callees, including
+   * visibility changes, is done in sequence once the level is done.
+   */
+  void inline_methods_in_levels();
+
+  std::vector<std::pair<DexMethod*, IRList::iterator>> find_inlinables(
+      DexMethod* caller, const std::vector<DexMethod*>& callees);
+
   void inline_inlinables(
       DexMethod* caller,
       const std::vector<std::pair<DexMethod*, IRList::iterator>>& inlinables);
 
+  /**
+   * Inline a single callsite, and return whether it was inlined.
+   */
+  bool inline_inlinable(DexMethod* caller,
+                        DexMethod* callee,
+                        IRList::iterator callsite);
+
+  void record_inlined(DexMethod* callee);
+
+  /**
+   * Return whether the code of the callee can be moved into its caller
+   * instead of copied, because its only callsite is being inlined and it
+   * gets deleted afterwards.
+   */
+  bool can_move_callee(const DexMethod* callee) const;
+
   /**
    * Return true if the callee is inlinable into the caller.
    * The predicates below define the constraints for inlining.
@@ -165,6 +258,8 @@ class MultiMethodInliner {
                              const DexMethod* callee,
                              const IRInstruction* invk_insn);
 
+  OpcodeVerdict check_opcodes(const DexMethod* caller, const DexMethod* callee);
+
   /**
    * Return true if inlining would require a method called from the callee
    * (candidate) to turn into a virtual method (e.g. private to public).
@@ -207,7 +302,7 @@ class MultiMethodInliner {
   bool cross_store_reference(const DexMethod* context);
 
   bool is_estimate_over_max(uint64_t estimated_insn_size,
-                            const DexMethod* callee,
+                            uint64_t callee_size,
                             uint64_t max);
 
   /**
@@ -220,7 +315,7 @@ class MultiMethodInliner {
    */
   bool caller_too_large(DexType* caller_type,
                         size_t estimated_caller_size,
-                        const DexMethod* callee);
+                        size_t callee_size);
 
   /**
    * Return whether the callee should be inlined into the caller. This differs
@@ -235,13 +330,13 @@ class MultiMethodInliner {
    * a call to `inline_methods()`, but not if `inline_callees()` is invoked
    * directly.
    */
-  bool should_inline(const DexMethod* caller, const DexMethod* callee) const;
+  bool should_inline(const DexMethod* caller, const DexMethod* callee);
 
   /**
    * We want to avoid inlining a large method with many callers as that would
    * bloat the bytecode.
    */
-  bool too_many_callers(const DexMethod* callee) const;
+  bool too_many_callers(const DexMethod* callee);
 
   /**
    * Staticize required methods (stored in `m_make_static`) and update
@@ -278,9 +373,9 @@ class MultiMethodInliner {
   std::map<DexMethod*, std::vector<DexMethod*>, dexmethods_comparator>
       caller_callee;
 
-  // Cache of the opcode counts of each method after all its eligible callsites
-  // have been inlined.
-  mutable std::unordered_map<const DexMethod*, size_t> m_opcode_counts;
+  // Summaries of the callees considered so far. Entries are erased
+  // concurrently when callers are edited in parallel.
+  ConcurrentMap<const DexMethod*, CalleeSummary> m_callee_summaries;
 
  private:
   /**
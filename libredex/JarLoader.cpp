@@ -5,9 +5,15 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <boost/filesystem.hpp>
 #include <boost/iostreams/device/mapped_file.hpp>
 
+#include <algorithm>
 #include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include <zlib.h>
 
@@ -21,6 +27,8 @@
 #include "Creators.h"
 #include "DexClass.h"
 #include "JarLoader.h"
+#include "Parallel.h"
+#include "Sha1.h"
 #include "Trace.h"
 #include "Util.h"
 
@@ -68,15 +76,29 @@ struct cp_entry {
   };
 };
 
-struct cp_field_info {
+struct MemberStub {
+  std::string name;
+  std::string desc;
   uint16_t aflags;
-  uint16_t nameNdx;
-  uint16_t descNdx;
+  // Where the attributes of the member start in the class file. Only kept
+  // while the class file is around.
+  uint8_t* attributes{nullptr};
 };
-struct cp_method_info {
+
+/*
+ * The names, descriptors and access flags of an external class and of its
+ * members, which is all that loading it needs from its class file. Unlike the
+ * class itself, a stub can be built without touching the global state, and it
+ * is what the stub cache of a jar stores.
+ */
+struct ClassStub {
+  std::string self;
+  // Empty if the class doesn't have a superclass.
+  std::string super;
   uint16_t aflags;
-  uint16_t nameNdx;
-  uint16_t descNdx;
+  std::vector<std::string> interfaces;
+  std::vector<MemberStub> fields;
+  std::vector<MemberStub> methods;
 };
 }
 
@@ -147,31 +169,31 @@ static void skip_attributes(uint8_t* &buffer) {
   }
 }
 #define MAX_CLASS_NAMELEN (8 * 1024)
-static DexType *make_dextype_from_cref(std::vector<cp_entry> &cpool,
-                                       uint16_t cref) {
-  char nbuffer[MAX_CLASS_NAMELEN];
+static bool extract_class_name(const std::vector<cp_entry>& cpool,
+                               uint16_t cref,
+                               std::string* out) {
   if (cpool[cref].tag != CP_CONST_CLASS) {
     fprintf(stderr, "Non-class ref in get_class_name, Bailing\n");
-    return nullptr;
+    return false;
   }
   uint16_t utf8ref = cpool[cref].s0;
   const cp_entry &utf8cpe = cpool[utf8ref];
   if (utf8cpe.tag != CP_CONST_UTF8) {
     fprintf(stderr, "Non-utf8 ref in get_utf8, Bailing\n");
-    return nullptr;
+    return false;
   }
   if (utf8cpe.len > (MAX_CLASS_NAMELEN + 3)) {
     fprintf(stderr, "classname is greater than max, bailing");
-    return nullptr;
+    return false;
   }
-  nbuffer[0] = 'L';
-  memcpy(nbuffer+1, utf8cpe.data, utf8cpe.len);
-  nbuffer[1+utf8cpe.len] = ';';
-  nbuffer[2+utf8cpe.len] = '\0';
-  return DexType::make_type(nbuffer);
+  out->reserve(utf8cpe.len + 2);
+  out->assign(1, 'L');
+  out->append(reinterpret_cast<const char*>(utf8cpe.data), utf8cpe.len);
+  out->push_back(';');
+  return true;
 }
 
-static bool extract_utf8(std::vector<cp_entry> &cpool, uint16_t utf8ref,
+static bool extract_utf8(const std::vector<cp_entry> &cpool, uint16_t utf8ref,
                          char *out, uint32_t size) {
   const cp_entry &utf8cpe = cpool[utf8ref];
   if (utf8cpe.tag != CP_CONST_UTF8) {
@@ -187,19 +209,29 @@ static bool extract_utf8(std::vector<cp_entry> &cpool, uint16_t utf8ref,
   return true;
 }
 
-static DexField *make_dexfield(std::vector<cp_entry> &cpool,
-                               DexType *self, cp_field_info &finfo) {
-  char dbuffer[MAX_CLASS_NAMELEN];
-  char nbuffer[MAX_CLASS_NAMELEN];
-  if (!extract_utf8(cpool, finfo.nameNdx, nbuffer, MAX_CLASS_NAMELEN) ||
-     !extract_utf8(cpool, finfo.descNdx, dbuffer, MAX_CLASS_NAMELEN)) {
-    return nullptr;
+static bool extract_utf8(const std::vector<cp_entry>& cpool,
+                         uint16_t utf8ref,
+                         std::string* out) {
+  const cp_entry &utf8cpe = cpool[utf8ref];
+  if (utf8cpe.tag != CP_CONST_UTF8) {
+    fprintf(stderr, "Non-utf8 ref in get_utf8, bailing\n");
+    return false;
+  }
+  if (utf8cpe.len > (MAX_CLASS_NAMELEN - 1)) {
+    fprintf(stderr, "Name is greater (%hu) than max (%u), bailing\n",
+            utf8cpe.len, MAX_CLASS_NAMELEN);
+    return false;
   }
-  DexString *name = DexString::make_string(nbuffer);
-  DexType *desc = DexType::make_type(dbuffer);
+  out->assign(reinterpret_cast<const char*>(utf8cpe.data), utf8cpe.len);
+  return true;
+}
+
+static DexField *make_dexfield(DexType *self, const MemberStub& stub) {
+  DexString *name = DexString::make_string(stub.name.c_str());
+  DexType *desc = DexType::make_type(stub.desc.c_str());
   DexField *field =
       static_cast<DexField*>(DexField::make_field(self, name, desc));
-  field->set_access((DexAccessFlags)finfo.aflags);
+  field->set_access((DexAccessFlags)stub.aflags);
   field->set_external();
   return field;
 }
@@ -304,16 +336,9 @@ static DexTypeList *extract_arguments(const char* &buf) {
   return DexTypeList::make_type_list(std::move(args));
 }
 
-static DexMethod *make_dexmethod(std::vector<cp_entry> &cpool,
-                               DexType *self, cp_method_info &finfo) {
-  char dbuffer[MAX_CLASS_NAMELEN];
-  char nbuffer[MAX_CLASS_NAMELEN];
-  if (!extract_utf8(cpool, finfo.nameNdx, nbuffer, MAX_CLASS_NAMELEN) ||
-     !extract_utf8(cpool, finfo.descNdx, dbuffer, MAX_CLASS_NAMELEN)) {
-    return nullptr;
-  }
-  DexString *name = DexString::make_string(nbuffer);
-  const char *ptr = dbuffer;
+static DexMethod *make_dexmethod(DexType *self, const MemberStub& stub) {
+  DexString *name = DexString::make_string(stub.name.c_str());
+  const char *ptr = stub.desc.c_str();
   DexTypeList *tlist = extract_arguments(ptr);
   if (tlist == nullptr)
     return nullptr;
@@ -328,11 +353,11 @@ static DexMethod *make_dexmethod(std::vector<cp_entry> &cpool,
         SHOW(method));
     return nullptr;
   }
-  uint32_t access = finfo.aflags;
+  uint32_t access = stub.aflags;
   bool is_virt = true;
-  if (nbuffer[0] == '<') {
+  if (stub.name[0] == '<') {
     is_virt = false;
-    if (nbuffer[1] == 'i') {
+    if (stub.name[1] == 'i') {
       access |= ACC_CONSTRUCTOR;
     }
   } else if (access & (ACC_PRIVATE | ACC_STATIC))
@@ -368,10 +393,27 @@ void read_dup_class_whitelist(const JsonWrapper& json_cfg) {
   TRACE(MAIN, 1, "}\n");
 }
 
-static bool parse_class(uint8_t* buffer,
-                        Scope* classes,
-                        attribute_hook_t attr_hook,
-                        const std::string& jar_location = "") {
+namespace {
+
+/*
+ * A class file whose stub is being parsed. The constant pool points into the
+ * class file.
+ */
+struct ClassFile {
+  std::vector<cp_entry> cpool;
+  uint16_t super;
+  uint16_t ifcount;
+  // Where the interfaces start.
+  uint8_t* rest;
+};
+
+} // namespace
+
+// Parse the class file up to its interfaces, which is enough to tell which
+// class it defines.
+static bool parse_class_header(uint8_t* buffer,
+                               ClassFile* class_file,
+                               ClassStub* stub) {
   uint32_t magic = read32(buffer);
   uint16_t vminor DEBUG_ONLY = read16(buffer);
   uint16_t vmajor DEBUG_ONLY = read16(buffer);
@@ -380,7 +422,7 @@ static bool parse_class(uint8_t* buffer,
     fprintf(stderr, "Bad class magic %08x, Bailing\n", magic);
     return false;
   }
-  std::vector<cp_entry> cpool;
+  auto& cpool = class_file->cpool;
   cpool.resize(cp_count);
   /* The zero'th entry is always empty.  Java is annoying. */
   for (int i=1; i<cp_count; i++) {
@@ -392,22 +434,69 @@ static bool parse_class(uint8_t* buffer,
       i++;
     }
   }
-  uint16_t aflags = read16(buffer);
+  stub->aflags = read16(buffer);
   uint16_t clazz = read16(buffer);
-  uint16_t super = read16(buffer);
-  uint16_t ifcount = read16(buffer);
-  DexType *self = make_dextype_from_cref(cpool, clazz);
-  DexClass* cls = type_class(self);
-  if (cls) {
+  class_file->super = read16(buffer);
+  class_file->ifcount = read16(buffer);
+  class_file->rest = buffer;
+  return extract_class_name(cpool, clazz, &stub->self);
+}
+
+static bool parse_member_stubs(ClassFile& class_file,
+                               uint8_t*& buffer,
+                               std::vector<MemberStub>* members) {
+  uint16_t count = read16(buffer);
+  members->resize(count);
+  for (auto& member : *members) {
+    member.aflags = read16(buffer);
+    uint16_t name_index = read16(buffer);
+    uint16_t desc_index = read16(buffer);
+    member.attributes = buffer;
+    skip_attributes(buffer);
+    if (!extract_utf8(class_file.cpool, name_index, &member.name) ||
+        !extract_utf8(class_file.cpool, desc_index, &member.desc)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Parse the rest of the class file, once its header has been parsed.
+static bool parse_class_members(ClassFile& class_file, ClassStub* stub) {
+  auto& cpool = class_file.cpool;
+  auto buffer = class_file.rest;
+  if (class_file.super != 0 &&
+      !extract_class_name(cpool, class_file.super, &stub->super)) {
+    return false;
+  }
+  stub->interfaces.resize(class_file.ifcount);
+  for (auto& iface : stub->interfaces) {
+    if (!extract_class_name(cpool, read16(buffer), &iface)) {
+      return false;
+    }
+  }
+  return parse_member_stubs(class_file, buffer, &stub->fields) &&
+         parse_member_stubs(class_file, buffer, &stub->methods);
+}
+
+// Return true if `self` is already defined, or has already been parsed from
+// `previous_location` by the jars that are being loaded with it.
+static bool is_dup(DexType* self,
+                   const std::string& jar_location,
+                   const std::string* previous_location = nullptr) {
+  DexClass* cls = previous_location == nullptr ? type_class(self) : nullptr;
+  if (cls || previous_location) {
     // We are seeing duplicate classes when parsing jar file
-    if (cls->is_external()) {
+    if (previous_location || cls->is_external()) {
       // Two external classes in .jar file has the same name
       // Just issue an warning for now
       TRACE(MAIN, 1,
             "Warning: Found a duplicate class '%s' in two .jar files:\n "
             "  Current: '%s'\n"
             "  Previous: '%s'\n",
-            SHOW(self), jar_location.c_str(), cls->get_location().c_str());
+            SHOW(self), jar_location.c_str(),
+            previous_location ? previous_location->c_str()
+                              : cls->get_location().c_str());
     } else if (!is_known_dup(cls)) {
       TRACE(MAIN, 1,
             "Warning: Found a duplicate class '%s' in .dex and .jar file.\n"
@@ -422,35 +511,41 @@ static bool parse_class(uint8_t* buffer,
     }
     return true;
   }
+  return false;
+}
 
-  ClassCreator cc(self, jar_location);
-  cc.set_external();
-  if (super != 0) {
-    DexType *sclazz = make_dextype_from_cref(cpool, super);
-    cc.set_super(sclazz);
+// Build the class of the given stub, without publishing it, so that classes
+// of different types can be built in parallel. The attribute hook needs the
+// constant pool of the class file, and the attributes its members point to.
+static std::unique_ptr<ClassCreator> build_class(
+    const ClassStub& stub,
+    DexType* self,
+    const std::vector<cp_entry>* cpool,
+    attribute_hook_t attr_hook,
+    const std::string& jar_location) {
+  auto cc = std::make_unique<ClassCreator>(self, jar_location);
+  cc->set_external();
+  if (!stub.super.empty()) {
+    cc->set_super(DexType::make_type(stub.super.c_str()));
   }
-  cc.set_access((DexAccessFlags)aflags);
-  if (ifcount) {
-    for (int i=0; i < ifcount; i++) {
-      uint16_t iface = read16(buffer);
-      DexType *iftype = make_dextype_from_cref(cpool, iface);
-      cc.add_interface(iftype);
-    }
+  cc->set_access((DexAccessFlags)stub.aflags);
+  for (const auto& iface : stub.interfaces) {
+    cc->add_interface(DexType::make_type(iface.c_str()));
   }
-  uint16_t fcount = read16(buffer);
 
   auto invoke_attr_hook = [&](
       boost::variant<DexField*, DexMethod*> field_or_method, uint8_t* attrPtr) {
     if (attr_hook == nullptr) {
       return;
     }
+    always_assert(cpool != nullptr && attrPtr != nullptr);
     uint16_t attributes_count = read16(attrPtr);
     for (uint16_t j = 0; j < attributes_count; j++) {
       uint16_t attribute_name_index = read16(attrPtr);
       uint32_t attribute_length = read32(attrPtr);
       char attribute_name[MAX_CLASS_NAMELEN];
       if (extract_utf8(
-              cpool, attribute_name_index, attribute_name, MAX_CLASS_NAMELEN)) {
+              *cpool, attribute_name_index, attribute_name, MAX_CLASS_NAMELEN)) {
         attr_hook(field_or_method, attribute_name, attrPtr);
       } else {
         always_assert_log(
@@ -462,37 +557,22 @@ static bool parse_class(uint8_t* buffer,
     }
   };
 
-  for (int i=0; i < fcount; i++) {
-    cp_field_info cpfield;
-    cpfield.aflags = read16(buffer);
-    cpfield.nameNdx = read16(buffer);
-    cpfield.descNdx = read16(buffer);
-    uint8_t* attrPtr = buffer;
-    skip_attributes(buffer);
-    DexField *field = make_dexfield(cpool, self, cpfield);
-    if (field == nullptr)
-      return false;
-    cc.add_field(field);
-    invoke_attr_hook({field}, attrPtr);
+  for (const auto& field_stub : stub.fields) {
+    DexField *field = make_dexfield(self, field_stub);
+    cc->add_field(field);
+    invoke_attr_hook({field}, field_stub.attributes);
   }
-
-  uint16_t mcount = read16(buffer);
-  if (mcount) {
-    for (int i=0; i < mcount; i++) {
-      cp_method_info cpmethod;
-      cpmethod.aflags = read16(buffer);
-      cpmethod.nameNdx = read16(buffer);
-      cpmethod.descNdx = read16(buffer);
-
-      uint8_t* attrPtr = buffer;
-      skip_attributes(buffer);
-      DexMethod *method = make_dexmethod(cpool, self, cpmethod);
-      if (method == nullptr)
-        return false;
-      cc.add_method(method);
-      invoke_attr_hook({method}, attrPtr);
-    }
+  for (const auto& method_stub : stub.methods) {
+    DexMethod *method = make_dexmethod(self, method_stub);
+    if (method == nullptr)
+      return nullptr;
+    cc->add_method(method);
+    invoke_attr_hook({method}, method_stub.attributes);
   }
+  return cc;
+}
+
+static void create_class(ClassCreator& cc, Scope* classes) {
   DexClass *dc = cc.create();
   if (classes != nullptr) {
     classes->emplace_back(dc);
@@ -526,6 +606,30 @@ static bool parse_class(uint8_t* buffer,
   }
 
 #endif
+}
+
+static bool parse_class(uint8_t* buffer,
+                        Scope* classes,
+                        attribute_hook_t attr_hook,
+                        const std::string& jar_location = "") {
+  ClassFile class_file;
+  ClassStub stub;
+  if (!parse_class_header(buffer, &class_file, &stub)) {
+    return false;
+  }
+  auto self = DexType::make_type(stub.self.c_str());
+  if (is_dup(self, jar_location)) {
+    return true;
+  }
+  if (!parse_class_members(class_file, &stub)) {
+    return false;
+  }
+  auto cc =
+      build_class(stub, self, &class_file.cpool, attr_hook, jar_location);
+  if (cc == nullptr) {
+    return false;
+  }
+  create_class(*cc, classes);
   return true;
 }
 
@@ -765,87 +869,411 @@ static bool decompress_class(jar_entry &file, const uint8_t *mapping,
   return true;
 }
 
-static const int kStartBufferSize = 128 * 1024;
-
-static bool process_jar_entries(const char* location,
-                                std::vector<jar_entry>& files,
-                                const uint8_t* mapping,
-                                Scope* classes,
-                                attribute_hook_t attr_hook) {
-  ssize_t bufsize = kStartBufferSize;
-  uint8_t *outbuffer = (uint8_t*)malloc(bufsize);
+static bool is_class_entry(const jar_entry& file) {
   static char classEndString[] = ".class";
   static size_t classEndStringLen = strlen(classEndString);
-  init_basic_types();
-  for (auto &file : files) {
-    if (file.cd_entry.ucomp_size == 0)
-      continue;
-    if (file.cd_entry.fname_len < (classEndStringLen  + 1))
-      continue;
+  if (file.cd_entry.ucomp_size == 0)
+    return false;
+  if (file.cd_entry.fname_len < (classEndStringLen  + 1))
+    return false;
 
-    // Skip non-class files
-    uint8_t *endcomp = file.filename +
-      (file.cd_entry.fname_len - classEndStringLen);
-    if (memcmp(endcomp, classEndString, classEndStringLen) != 0)
-      continue;
+  // Skip non-class files
+  uint8_t *endcomp = file.filename +
+    (file.cd_entry.fname_len - classEndStringLen);
+  return memcmp(endcomp, classEndString, classEndStringLen) == 0;
+}
 
-    // Resize output if necessary.
-    if (bufsize < file.cd_entry.ucomp_size) {
-      while(bufsize < file.cd_entry.ucomp_size)
-        bufsize *= 2;
-      free(outbuffer);
-      outbuffer = (uint8_t*)malloc(bufsize);
+/*
+ * The stub cache of a jar holds the stubs of all of its class files, in jar
+ * order, and is named after the SHA1 of the jar, so that a jar that changes
+ * gets a new cache file instead of a stale one. It is a magic string followed
+ * by the stubs, where strings are prefixed by their length and integers are
+ * in host byte order: the cache is only meant to be read on the machine that
+ * wrote it.
+ */
+namespace {
+
+static const char kStubCacheMagic[] = "redex-jar-stubs-1";
+
+class StubCacheWriter {
+ public:
+  StubCacheWriter() { m_out.append(kStubCacheMagic, sizeof(kStubCacheMagic)); }
+
+  void write(const ClassStub& stub) {
+    put(stub.self);
+    put(stub.super);
+    put16(stub.aflags);
+    put32(stub.interfaces.size());
+    for (const auto& iface : stub.interfaces) {
+      put(iface);
     }
+    put(stub.fields);
+    put(stub.methods);
+  }
 
-    if (!decompress_class(file, mapping, outbuffer, bufsize)) {
-      free(outbuffer);
-      return false;
+  const std::string& contents() const { return m_out; }
+
+ private:
+  void put16(uint16_t v) { m_out.append(reinterpret_cast<char*>(&v), 2); }
+  void put32(uint32_t v) { m_out.append(reinterpret_cast<char*>(&v), 4); }
+  void put(const std::string& str) {
+    put32(str.size());
+    m_out.append(str);
+  }
+  void put(const std::vector<MemberStub>& members) {
+    put32(members.size());
+    for (const auto& member : members) {
+      put(member.name);
+      put(member.desc);
+      put16(member.aflags);
     }
+  }
 
-    if (!parse_class(outbuffer, classes, attr_hook, location)) {
-      free(outbuffer);
+  std::string m_out;
+};
+
+class StubCacheReader {
+ public:
+  explicit StubCacheReader(const std::string& contents)
+      : m_pos(contents.data()), m_end(contents.data() + contents.size()) {
+    m_ok = contents.size() >= sizeof(kStubCacheMagic) &&
+           memcmp(m_pos, kStubCacheMagic, sizeof(kStubCacheMagic)) == 0;
+    m_pos += sizeof(kStubCacheMagic);
+  }
+
+  // Return false once the contents are exhausted, or if they are malformed.
+  bool read(ClassStub* stub) {
+    if (!m_ok || m_pos == m_end) {
       return false;
     }
+    get(&stub->self);
+    get(&stub->super);
+    get16(&stub->aflags);
+    uint32_t ifcount = 0;
+    get32(&ifcount);
+    if (m_ok) {
+      stub->interfaces.resize(std::min<size_t>(ifcount, m_end - m_pos));
+      for (auto& iface : stub->interfaces) {
+        get(&iface);
+      }
+    }
+    get(&stub->fields);
+    get(&stub->methods);
+    return m_ok;
   }
-  free(outbuffer);
-  return true;
-}
 
-static bool process_jar(const char* location,
-                        const uint8_t* mapping,
-                        ssize_t size,
-                        Scope* classes,
-                        attribute_hook_t attr_hook) {
-  pk_cdir_end pce;
+  bool at_end() const { return m_ok && m_pos == m_end; }
+
+ private:
+  bool has(size_t size) {
+    m_ok = m_ok && size <= size_t(m_end - m_pos);
+    return m_ok;
+  }
+  void get16(uint16_t* v) {
+    if (has(2)) {
+      memcpy(v, m_pos, 2);
+      m_pos += 2;
+    }
+  }
+  void get32(uint32_t* v) {
+    if (has(4)) {
+      memcpy(v, m_pos, 4);
+      m_pos += 4;
+    }
+  }
+  void get(std::string* str) {
+    uint32_t size = 0;
+    get32(&size);
+    if (has(size)) {
+      str->assign(m_pos, size);
+      m_pos += size;
+    }
+  }
+  void get(std::vector<MemberStub>* members) {
+    uint32_t count = 0;
+    get32(&count);
+    if (!m_ok) {
+      return;
+    }
+    members->resize(std::min<size_t>(count, m_end - m_pos));
+    for (auto& member : *members) {
+      get(&member.name);
+      get(&member.desc);
+      get16(&member.aflags);
+    }
+  }
+
+  const char* m_pos;
+  const char* m_end;
+  bool m_ok;
+};
+
+struct Jar {
+  std::string location;
+  boost::iostreams::mapped_file file;
   std::vector<jar_entry> files;
-  if (!find_central_directory(mapping, size, pce))
+  // Where the stubs of the jar are cached, if they are.
+  std::string stub_cache_path;
+  bool from_stub_cache{false};
+};
+
+/*
+ * A class of a jar, as it goes through loading. Unless its stub comes from the
+ * stub cache, the class file is decompressed and its stub is parsed. Then its
+ * class is built unless it is a duplicate.
+ */
+struct ClassEntry {
+  const Jar* jar;
+  jar_entry* file{nullptr};
+  std::vector<uint8_t> contents;
+  ClassFile class_file;
+  ClassStub stub;
+  DexType* self{nullptr};
+  // Whether the class it defines is known, and whether the whole stub is.
+  bool header_ok{false};
+  bool ok{false};
+  std::unique_ptr<ClassCreator> creator;
+};
+
+} // namespace
+
+static std::string jar_sha1_hex(const Jar& jar) {
+  auto data = reinterpret_cast<const unsigned char*>(jar.file.const_data());
+  size_t size = jar.file.size();
+  Sha1Context context;
+  sha1_init(&context);
+  const size_t kChunkSize = 1 << 20;
+  for (size_t offset = 0; offset < size; offset += kChunkSize) {
+    sha1_update(&context, data + offset, std::min(kChunkSize, size - offset));
+  }
+  unsigned char digest[20];
+  sha1_final(digest, &context);
+  std::string hex;
+  char buf[3];
+  for (auto byte : digest) {
+    snprintf(buf, sizeof(buf), "%02x", byte);
+    hex.append(buf);
+  }
+  return hex;
+}
+
+static bool read_stub_cache(const std::string& path,
+                            std::vector<ClassStub>* stubs) {
+  std::ifstream ifs(path, std::ifstream::binary);
+  if (!ifs) {
     return false;
-  if (!validate_pce(pce, size))
+  }
+  std::string contents((std::istreambuf_iterator<char>(ifs)),
+                       std::istreambuf_iterator<char>());
+  StubCacheReader reader(contents);
+  ClassStub stub;
+  while (reader.read(&stub)) {
+    stubs->push_back(std::move(stub));
+    stub = ClassStub();
+  }
+  if (!reader.at_end()) {
+    fprintf(stderr, "warning: ignoring malformed jar stub cache: %s\n",
+            path.c_str());
+    stubs->clear();
     return false;
-  if (!get_jar_entries(mapping, pce, files))
+  }
+  return true;
+}
+
+// Write the cache to a temporary file that is then renamed, so that a run
+// never sees the cache of another one half-written.
+static void write_stub_cache(const std::string& path,
+                             const std::vector<ClassEntry*>& entries) {
+  StubCacheWriter writer;
+  for (const auto* entry : entries) {
+    writer.write(entry->stub);
+  }
+  boost::system::error_code ec;
+  auto tmp_path = boost::filesystem::unique_path(path + ".%%%%-%%%%-%%%%", ec);
+  if (!ec) {
+    std::ofstream ofs(tmp_path.string(), std::ofstream::binary);
+    ofs.write(writer.contents().data(), writer.contents().size());
+    ofs.close();
+    if (ofs) {
+      boost::filesystem::rename(tmp_path, path, ec);
+    } else {
+      ec = boost::system::errc::make_error_code(boost::system::errc::io_error);
+    }
+  }
+  if (ec) {
+    fprintf(stderr, "warning: cannot write jar stub cache %s: %s\n",
+            path.c_str(), ec.message().c_str());
+    boost::filesystem::remove(tmp_path, ec);
+  }
+}
+
+static bool open_jar(Jar& jar, const std::string& stub_cache_dir) {
+  jar.file.open(jar.location, boost::iostreams::mapped_file::readonly);
+  if (!jar.file.is_open()) {
+    fprintf(stderr, "error: cannot open jar file: %s\n", jar.location.c_str());
     return false;
-  if (!process_jar_entries(location, files, mapping, classes, attr_hook)) {
+  }
+  if (!stub_cache_dir.empty()) {
+    jar.stub_cache_path = stub_cache_dir + "/" + jar_sha1_hex(jar) + ".stubs";
+  }
+  auto mapping = reinterpret_cast<const uint8_t*>(jar.file.const_data());
+  ssize_t size = jar.file.size();
+  pk_cdir_end pce;
+  if (!find_central_directory(mapping, size, pce) ||
+      !validate_pce(pce, size) || !get_jar_entries(mapping, pce, jar.files)) {
+    fprintf(stderr, "error: cannot process jar: %s\n", jar.location.c_str());
     return false;
   }
   return true;
 }
 
-bool load_jar_file(const char* location,
-                   Scope* classes,
-                   attribute_hook_t attr_hook) {
-  boost::iostreams::mapped_file file;
-  file.open(location, boost::iostreams::mapped_file::readonly);
-  if (!file.is_open()) {
-    fprintf(stderr, "error: cannot open jar file: %s\n", location);
-    return false;
+/*
+ * The class files of all the jars are decompressed and parsed in parallel.
+ * Only deciding which of the files that define the same class wins, and
+ * publishing the classes, happen in order: the first file in jar order wins,
+ * as if the jars had been loaded one after the other. If a jar fails to load,
+ * the classes before the failure have still been loaded.
+ */
+bool load_jar_files(const std::vector<std::string>& locations,
+                    Scope* classes,
+                    attribute_hook_t attr_hook,
+                    const std::string& stub_cache_dir) {
+  init_basic_types();
+  // The attribute hook needs the class files.
+  std::string cache_dir = attr_hook == nullptr ? stub_cache_dir : "";
+  std::vector<std::unique_ptr<Jar>> jars;
+  std::vector<ClassEntry> entries;
+  bool jars_ok = true;
+  for (const auto& location : locations) {
+    jars.emplace_back(std::make_unique<Jar>());
+    auto& jar = *jars.back();
+    jar.location = location;
+    if (!open_jar(jar, cache_dir)) {
+      jars_ok = false;
+      break;
+    }
+    std::vector<ClassStub> stubs;
+    if (!jar.stub_cache_path.empty() &&
+        read_stub_cache(jar.stub_cache_path, &stubs)) {
+      TRACE(MAIN, 2, "Loading the stubs of %s from %s\n", location.c_str(),
+            jar.stub_cache_path.c_str());
+      jar.from_stub_cache = true;
+      for (auto& stub : stubs) {
+        entries.emplace_back();
+        entries.back().jar = &jar;
+        entries.back().stub = std::move(stub);
+        entries.back().header_ok = entries.back().ok = true;
+      }
+      continue;
+    }
+    for (auto& file : jar.files) {
+      if (is_class_entry(file)) {
+        entries.emplace_back();
+        entries.back().jar = &jar;
+        entries.back().file = &file;
+      }
+    }
+  }
+
+  auto parse_stub = [&](ClassEntry& entry) {
+    if (entry.file != nullptr) {
+      auto mapping =
+          reinterpret_cast<const uint8_t*>(entry.jar->file.const_data());
+      entry.contents.resize(entry.file->cd_entry.ucomp_size);
+      entry.header_ok =
+          decompress_class(*entry.file, mapping, entry.contents.data(),
+                           entry.contents.size()) &&
+          parse_class_header(entry.contents.data(), &entry.class_file,
+                             &entry.stub);
+      entry.ok = entry.header_ok &&
+                 parse_class_members(entry.class_file, &entry.stub);
+      if (attr_hook == nullptr) {
+        std::vector<uint8_t>().swap(entry.contents);
+        std::vector<cp_entry>().swap(entry.class_file.cpool);
+      }
+    }
+    if (entry.header_ok) {
+      entry.self = DexType::make_type(entry.stub.self.c_str());
+    }
+  };
+  parallel_for(entries.begin(), entries.end(), parse_stub);
+
+  // Cache the stubs of the jars that were fully parsed, dups included, since
+  // what is a dup depends on what the jar is loaded with.
+  std::vector<ClassEntry*> jar_entries;
+  for (size_t i = 0; i < entries.size(); i++) {
+    auto& entry = entries[i];
+    jar_entries.push_back(&entry);
+    if (i + 1 < entries.size() && entries[i + 1].jar == entry.jar) {
+      continue;
+    }
+    const auto& jar = *entry.jar;
+    if (!jar.stub_cache_path.empty() && !jar.from_stub_cache &&
+        std::all_of(jar_entries.begin(), jar_entries.end(),
+                    [](const ClassEntry* e) { return e->ok; })) {
+      write_stub_cache(jar.stub_cache_path, jar_entries);
+    }
+    jar_entries.clear();
+  }
+
+  // Skip the duplicates, in order.
+  std::unordered_map<const DexType*, const ClassEntry*> first_entries;
+  std::vector<ClassEntry*> to_build;
+  const ClassEntry* failed = nullptr;
+  for (auto& entry : entries) {
+    if (!entry.header_ok) {
+      failed = &entry;
+      break;
+    }
+    auto self = entry.self;
+    auto it = first_entries.find(self);
+    if (is_dup(self, entry.jar->location,
+               it != first_entries.end() ? &it->second->jar->location
+                                         : nullptr)) {
+      std::vector<uint8_t>().swap(entry.contents);
+      continue;
+    }
+    if (!entry.ok) {
+      failed = &entry;
+      break;
+    }
+    first_entries.emplace(self, &entry);
+    to_build.push_back(&entry);
   }
 
-  auto mapping = reinterpret_cast<const uint8_t*>(file.const_data());
-  if (!process_jar(location, mapping, file.size(), classes, attr_hook)) {
-    fprintf(stderr, "error: cannot process jar: %s\n", location);
+  auto build = [&](ClassEntry* entry) {
+    entry->creator = build_class(entry->stub, entry->self,
+                                 &entry->class_file.cpool, attr_hook,
+                                 entry->jar->location);
+    entry->ok = entry->creator != nullptr;
+    std::vector<uint8_t>().swap(entry->contents);
+  };
+  // The attribute hook isn't expected to be thread-safe.
+  if (attr_hook == nullptr) {
+    parallel_for(to_build.begin(), to_build.end(), build);
+  } else {
+    std::for_each(to_build.begin(), to_build.end(), build);
+  }
+
+  for (auto* entry : to_build) {
+    if (!entry->ok) {
+      failed = entry;
+      break;
+    }
+    create_class(*entry->creator, classes);
+  }
+  if (failed != nullptr) {
+    fprintf(stderr, "error: cannot process jar: %s\n",
+            failed->jar->location.c_str());
     return false;
   }
-  return true;
+  return jars_ok;
+}
+
+bool load_jar_file(const char* location,
+                   Scope* classes,
+                   attribute_hook_t attr_hook) {
+  return load_jar_files({location}, classes, attr_hook);
 }
 
 //#define LOCAL_MAIN
@@ -30,6 +30,21 @@ bool load_jar_file(const char* location,
                    Scope* classes = nullptr,
                    attribute_hook_t = nullptr);
 
+/**
+ * Load the jars together, as `load_jar_file` would one after the other, but
+ * decompress and parse their classes in parallel. The attribute hook, if any,
+ * is called serially.
+ *
+ * If `stub_cache_dir` is set, the names, descriptors and access flags of the
+ * classes of each jar are cached there, keyed by the SHA1 of the jar, so that
+ * later loads of the same jar don't decompress or parse its class files. The
+ * cache is not used when there is an attribute hook.
+ */
+bool load_jar_files(const std::vector<std::string>& locations,
+                    Scope* classes = nullptr,
+                    attribute_hook_t = nullptr,
+                    const std::string& stub_cache_dir = "");
+
 void read_dup_class_whitelist(const JsonWrapper& json_cfg);
 
 bool load_class_file(const std::string& filename, Scope* classes = nullptr);
@@ -64,20 +64,8 @@ struct Reason {
 
 size_t hash_value(const Reason&);
 
-struct ReasonPtrHash {
-  size_t operator()(const Reason* reason) const {
-    return boost::hash<Reason>()(*reason);
-  }
-};
-
-struct ReasonPtrEqual {
-  size_t operator()(const keep_reason::Reason* r1,
-                    const keep_reason::Reason* r2) const {
-    return *r1 == *r2;
-  }
-};
-
-using ReasonPtrSet =
-    std::unordered_set<const Reason*, ReasonPtrHash, ReasonPtrEqual>;
+// Reasons are interned by RedexContext::make_keep_reason, so sets of them can
+// compare and hash the pointers.
+using ReasonPtrSet = std::unordered_set<const Reason*>;
 
 } // namespace keep_reason
@@ -42,12 +42,18 @@ match_t<IRInstruction, std::tuple<match_t<IRInstruction> > >
     return invoke_static(any<IRInstruction>());
 };
 
+match_t<IRInstruction, std::tuple<match_t<IRInstruction> > >
+  invoke_virtual() {
+    return invoke_virtual(any<IRInstruction>());
+};
+
 match_t<IRInstruction> return_void() {
   return {
     [](const IRInstruction* insn) {
       auto opcode = insn->opcode();
       return opcode == OPCODE_RETURN_VOID;
-    }
+    },
+    opcodes_of({OPCODE_RETURN_VOID})
   };
 }
 
@@ -82,7 +88,8 @@ match_t<IRInstruction> const_string() {
     [](const IRInstruction* insn) {
       auto opcode = insn->opcode();
       return opcode == OPCODE_CONST_STRING;
-    }
+    },
+    opcodes_of({OPCODE_CONST_STRING})
   };
 }
 
@@ -90,7 +97,8 @@ match_t<IRInstruction> move_result_pseudo() {
   return {
     [](const IRInstruction* insn) {
       return opcode::is_move_result_pseudo(insn->opcode());
-    }
+    },
+    opcodes_if(opcode::is_move_result_pseudo)
   };
 }
 
@@ -104,7 +112,8 @@ match_t<IRInstruction> throwex() {
     [](const IRInstruction* insn) {
       auto opcode = insn->opcode();
       return opcode == OPCODE_THROW;
-    }
+    },
+    opcodes_of({OPCODE_THROW})
   };
 }
 
@@ -8,6 +8,8 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <bitset>
 #include <functional>
 #include <type_traits>
 #include <vector>
@@ -59,6 +61,35 @@ inline bool has_code(const DexMethodRef* meth) {
 
 namespace m {
 
+/*
+ * A set of IROpcodes. Every match_t carries the opcodes of the instructions it
+ * can match, which is all of them unless it checks the opcode. This lets
+ * find_matches skip the instructions that can't start a match with a bit
+ * test, instead of calling into the matchers for each of them.
+ */
+using opcode_set = std::bitset<IOPCODE_MOVE_RESULT_PSEUDO_WIDE + 1>;
+
+inline opcode_set all_opcodes() { return opcode_set().set(); }
+
+inline opcode_set opcodes_of(std::initializer_list<IROpcode> ops) {
+  opcode_set set;
+  for (auto op : ops) {
+    set.set(op);
+  }
+  return set;
+}
+
+template <typename Fn>
+opcode_set opcodes_if(const Fn& fn) {
+  opcode_set set;
+  for (size_t op = 0; op < set.size(); ++op) {
+    if (fn(static_cast<IROpcode>(op))) {
+      set.set(op);
+    }
+  }
+  return set;
+}
+
 // N.B. recursive template for matching opcode pattern against insn sequence
 template<typename T, typename N>
 struct insns_matcher {
@@ -66,11 +97,19 @@ struct insns_matcher {
     int at,
     const std::vector<IRInstruction*>& insns,
     const T& t) {
-    const auto& insn = insns.at(at);
-    typename std::tuple_element<N::value, T>::type insn_match = std::get<N::value>(t);
+    const auto& insn = insns[at];
+    const auto& insn_match = std::get<N::value>(t);
     return insn_match.matches(insn) &&
         insns_matcher<T, std::integral_constant<size_t, N::value+1> >::matches_at(at+1, insns, t);
   }
+
+  // The opcode sets of the matchers, in order.
+  static void get_opcodes(const T& t,
+                          std::array<opcode_set, std::tuple_size<T>::value>& ops) {
+    ops[N::value] = std::get<N::value>(t).opcodes;
+    insns_matcher<T, std::integral_constant<size_t, N::value + 1>>::get_opcodes(
+        t, ops);
+  }
 };
 
 // N.B. base case of recursive template where N = opcode pattern length
@@ -82,6 +121,9 @@ struct insns_matcher<T, std::integral_constant<size_t, std::tuple_size<T>::value
     const T& t) {
     return true;
   }
+
+  static void get_opcodes(const T&,
+                          std::array<opcode_set, std::tuple_size<T>::value>&) {}
 };
 
 // Find all sequences in `insns` that match `p` and put them into `matches`
@@ -89,12 +131,20 @@ template <typename P, size_t N = std::tuple_size<P>::value>
 void find_matches(const std::vector<IRInstruction*>& insns,
                   const P& p,
                   std::vector<std::vector<IRInstruction*>>& matches) {
+  using matcher = m::insns_matcher<P, std::integral_constant<size_t, 0>>;
+  std::array<opcode_set, N> ops;
+  matcher::get_opcodes(p, ops);
   // No way to match if we have fewer insns than N
   if (insns.size() >= N) {
     // Try to match starting at i
     for (size_t i = 0; i <= insns.size() - N; ++i) {
-      if (m::insns_matcher<P, std::integral_constant<size_t, 0>>::matches_at(
-              i, insns, p)) {
+      // Most windows can be ruled out by their opcodes alone, which is much
+      // cheaper than running the matchers.
+      bool opcodes_match = true;
+      for (size_t c = 0; c < N && opcodes_match; ++c) {
+        opcodes_match = ops[c].test(insns[i + c]->opcode());
+      }
+      if (opcodes_match && matcher::matches_at(i, insns, p)) {
         matches.emplace_back();
         auto& matching_insns = matches.back();
         matching_insns.reserve(N);
@@ -117,6 +167,7 @@ struct match_t;
 template <typename T, typename P>
 struct match_t<T, P, 0> {
   bool (*fn)(const T*);
+  opcode_set opcodes{all_opcodes()};
   bool matches(const T* t) const {
     return fn(t);
   }
@@ -128,6 +179,7 @@ struct match_t<T, P, 1> {
   using P0_t = typename std::tuple_element<0, P>::type;
   bool (*fn)(const T*, const P0_t& p0);
   P0_t p0;
+  opcode_set opcodes{all_opcodes()};
   bool matches(const T* t) const {
     return fn(t, p0);
   }
@@ -141,6 +193,7 @@ struct match_t<T, P, 2> {
   bool (*fn)(const T*, const P0_t& p0, const P1_t& p1);
   P0_t p0;
   P1_t p1;
+  opcode_set opcodes{all_opcodes()};
   bool matches(const T* t) const {
     return fn(t, p0, p1);
   }
@@ -153,7 +206,8 @@ match_t<T, std::tuple<match_t<T, P0> > >
   return {
     [](const T* t, const match_t<T, P0>& p0) {
       return !p0.matches(t); },
-    p0 };
+    p0,
+    all_opcodes() };
 }
 
 /** Match two subordinate matches whose logical or is true */
@@ -164,7 +218,8 @@ match_t<T, std::tuple<match_t<T, P0>, match_t<T, P1> > >
     [](const T* t, const match_t<T, P0>& p0, const match_t<T, P1>& p1) {
       return p0.matches(t) || p1.matches(t); },
     p0,
-    p1 };
+    p1,
+    p0.opcodes | p1.opcodes };
 }
 
 /** Match two subordinate matches whose logical and is true */
@@ -175,7 +230,8 @@ match_t<T, std::tuple<match_t<T, P0>, match_t<T, P1> > >
     [](const T* t, const match_t<T, P0>& p0, const match_t<T, P1>& p1) {
       return p0.matches(t) && p1.matches(t); },
     p0,
-    p1 };
+    p1,
+    p0.opcodes & p1.opcodes };
 }
 
 /** Match two subordinate matches whose logical xor is true */
@@ -186,7 +242,8 @@ match_t<T, std::tuple<match_t<T, P0>, match_t<T, P1> > >
     [](const T* t, const match_t<T, P0>& p0, const match_t<T, P1>& p1) {
       return p0.matches(t) ^ p1.matches(t); },
     p0,
-    p1 };
+    p1,
+    p0.opcodes | p1.opcodes };
 }
 
 /** Match any T (always matches) */
@@ -281,7 +338,8 @@ match_t<IRInstruction, std::tuple<match_t<IRInstruction, P> > >
         return false;
       }
     },
-    p
+    p,
+    opcodes_of({OPCODE_NEW_INSTANCE}) & p.opcodes
   };
 }
 
@@ -304,7 +362,8 @@ match_t<IRInstruction, std::tuple<match_t<IRInstruction, P> > >
         return false;
       }
     },
-    p
+    p,
+    opcodes_of({OPCODE_INVOKE_DIRECT}) & p.opcodes
   };
 }
 
@@ -324,7 +383,8 @@ match_t<IRInstruction, std::tuple<match_t<IRInstruction, P> > >
         return false;
       }
     },
-    p
+    p,
+    opcodes_of({OPCODE_INVOKE_STATIC}) & p.opcodes
   };
 }
 
@@ -344,7 +404,8 @@ match_t<IRInstruction, std::tuple<match_t<IRInstruction, P> > >
         return false;
       }
     },
-    p
+    p,
+    opcodes_of({OPCODE_INVOKE_VIRTUAL}) & p.opcodes
   };
 }
 
@@ -359,7 +420,8 @@ match_t<IRInstruction, std::tuple<match_t<IRInstruction, P> > >
     [](const IRInstruction* insn, const match_t<IRInstruction, P>& p) {
       return is_invoke(insn->opcode()) && p.matches(insn);
     },
-    p
+    p,
+    opcodes_if([](IROpcode op) { return is_invoke(op); }) & p.opcodes
   };
 }
 
@@ -379,7 +441,8 @@ inline match_t<IRInstruction, std::tuple<IROpcode>> is_opcode(IROpcode opcode) {
   return {[](const IRInstruction* insn, const IROpcode& opcode) {
             return insn->opcode() == opcode;
           },
-          opcode};
+          opcode,
+          opcodes_of({opcode})};
 }
 
 /** Matchers that map from IRInstruction -> other types */
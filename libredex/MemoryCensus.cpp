@@ -0,0 +1,224 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "MemoryCensus.h"
+
+#include <algorithm>
+#include <deque>
+#include <string>
+
+#include "ControlFlow.h"
+#include "DexAnnotation.h"
+#include "DexInstruction.h"
+#include "DexPosition.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "JemallocUtil.h"
+#include "RedexContext.h"
+#include "Walkers.h"
+
+namespace {
+
+// The heap buffers of the standard containers, as libstdc++ lays them out.
+
+size_t string_heap_bytes(size_t size) {
+  // Short strings are stored in the std::string itself.
+  const size_t kInlineChars = 15;
+  return size <= kInlineChars ? 0 : size + 1;
+}
+
+template <typename T>
+size_t deque_heap_bytes(size_t size) {
+  const size_t kNodeBytes = 512;
+  const size_t per_node = sizeof(T) < kNodeBytes ? kNodeBytes / sizeof(T) : 1;
+  size_t nodes = size / per_node + 1;
+  size_t map_size = std::max<size_t>(8, nodes + 2);
+  return nodes * std::max(kNodeBytes, sizeof(T)) + map_size * sizeof(T*);
+}
+
+template <typename T>
+size_t vector_heap_bytes(const std::vector<T>& v) {
+  return v.capacity() * sizeof(T);
+}
+
+void count_annotations(const DexAnnotationSet* aset, MemoryCensus* census) {
+  if (aset == nullptr) {
+    return;
+  }
+  census->add(MemoryCensus::ANNOTATION,
+              sizeof(DexAnnotationSet) +
+                  vector_heap_bytes(aset->get_annotations()),
+              0);
+  for (auto anno : aset->get_annotations()) {
+    census->add(MemoryCensus::ANNOTATION,
+                sizeof(DexAnnotation) + vector_heap_bytes(anno->anno_elems()));
+  }
+}
+
+void count_entry(const MethodItemEntry& mie, MemoryCensus* census) {
+  census->add(MemoryCensus::METHOD_ITEM_ENTRY, sizeof(MethodItemEntry));
+  if (mie.type == MFLOW_OPCODE) {
+    census->add(MemoryCensus::IR_INSTRUCTION,
+                sizeof(IRInstruction) + mie.insn->srcs_heap_bytes());
+  } else if (mie.type == MFLOW_POSITION) {
+    census->add(MemoryCensus::POSITION, sizeof(DexPosition));
+  }
+}
+
+MemoryCensus count_method(DexMethod* method) {
+  MemoryCensus census;
+  count_annotations(method->get_anno_set(), &census);
+  if (auto param_annos = method->get_param_anno()) {
+    for (const auto& param_anno : *param_annos) {
+      count_annotations(param_anno.second, &census);
+    }
+  }
+
+  if (method->is_balloon_pending()) {
+    const auto& insns = method->get_dex_code()->get_instructions();
+    census.add(MemoryCensus::DEX_CODE,
+               sizeof(DexCode) + vector_heap_bytes(insns) +
+                   insns.size() * sizeof(DexInstruction));
+    return census;
+  }
+  auto code = method->get_code();
+  if (code == nullptr) {
+    return census;
+  }
+  census.add(MemoryCensus::IR_CODE, sizeof(IRCode) + sizeof(IRList));
+  if (code->editable_cfg_built()) {
+    // The entries have moved from the IRList into the blocks.
+    auto& cfg = code->cfg();
+    census.add(MemoryCensus::IR_CODE, sizeof(cfg::ControlFlowGraph));
+    for (auto block : cfg.blocks()) {
+      census.add(MemoryCensus::CFG_BLOCK,
+                 sizeof(cfg::Block) + sizeof(IRList) +
+                     vector_heap_bytes(block->preds()) +
+                     vector_heap_bytes(block->succs()));
+      census.add(MemoryCensus::CFG_EDGE,
+                 block->succs().size() * sizeof(cfg::Edge),
+                 block->succs().size());
+      for (const auto& mie : *block) {
+        count_entry(mie, &census);
+      }
+    }
+  } else {
+    for (const auto& mie : *code) {
+      count_entry(mie, &census);
+    }
+  }
+  return census;
+}
+
+} // namespace
+
+const char* MemoryCensus::name(Category category) {
+  switch (category) {
+  case STRING:
+    return "DexString";
+  case TYPE:
+    return "DexType";
+  case TYPE_LIST:
+    return "DexTypeList";
+  case PROTO:
+    return "DexProto";
+  case FIELD:
+    return "DexField";
+  case METHOD:
+    return "DexMethod";
+  case CLASS:
+    return "DexClass";
+  case ANNOTATION:
+    return "DexAnnotation";
+  case DEX_CODE:
+    return "DexCode";
+  case IR_CODE:
+    return "IRCode";
+  case IR_INSTRUCTION:
+    return "IRInstruction";
+  case METHOD_ITEM_ENTRY:
+    return "MethodItemEntry";
+  case POSITION:
+    return "DexPosition";
+  case CFG_BLOCK:
+    return "cfg::Block";
+  case CFG_EDGE:
+    return "cfg::Edge";
+  case NUM_CATEGORIES:
+    break;
+  }
+  not_reached();
+}
+
+MemoryCensus& MemoryCensus::operator+=(const MemoryCensus& that) {
+  for (size_t i = 0; i < NUM_CATEGORIES; i++) {
+    counts[i].objects += that.counts[i].objects;
+    counts[i].bytes += that.counts[i].bytes;
+  }
+  return *this;
+}
+
+size_t MemoryCensus::total_bytes() const {
+  size_t total = 0;
+  for (const auto& count : counts) {
+    total += count.bytes;
+  }
+  return total;
+}
+
+MemoryCensus MemoryCensus::take(const Scope& scope) {
+  MemoryCensus census;
+  g_redex->walk_strings([&](const DexString* str) {
+    census.add(STRING, sizeof(DexString) + string_heap_bytes(str->size()));
+  });
+  g_redex->walk_types([&](const DexString* name, const DexType* type) {
+    if (type->get_name() == name) {
+      census.add(TYPE, sizeof(DexType));
+    }
+  });
+  g_redex->walk_type_lists([&](const DexTypeList* list) {
+    // RedexContext keeps a copy of the list as the key it is interned by.
+    census.add(TYPE_LIST,
+               sizeof(DexTypeList) +
+                   2 * deque_heap_bytes<DexType*>(list->size()));
+  });
+  g_redex->walk_protos(
+      [&](const DexProto*) { census.add(PROTO, sizeof(DexProto)); });
+  g_redex->walk_fields([&](const DexFieldRef* field) {
+    census.add(FIELD, field->is_def() ? sizeof(DexField) : sizeof(DexFieldRef));
+  });
+  g_redex->walk_methods([&](const DexMethodRef* method) {
+    census.add(METHOD,
+               method->is_def() ? sizeof(DexMethod) : sizeof(DexMethodRef));
+  });
+
+  for (auto cls : scope) {
+    census.add(CLASS,
+               sizeof(DexClass) + vector_heap_bytes(cls->get_dmethods()) +
+                   vector_heap_bytes(cls->get_vmethods()) +
+                   vector_heap_bytes(cls->get_sfields()) +
+                   vector_heap_bytes(cls->get_ifields()));
+    count_annotations(cls->get_anno_set(), &census);
+    for (auto field : cls->get_sfields()) {
+      count_annotations(field->get_anno_set(), &census);
+    }
+    for (auto field : cls->get_ifields()) {
+      count_annotations(field->get_anno_set(), &census);
+    }
+  }
+  census += walk::parallel::reduce_methods<MemoryCensus>(
+      scope,
+      [](DexMethod* method) { return count_method(method); },
+      [](MemoryCensus a, const MemoryCensus& b) {
+        a += b;
+        return a;
+      });
+
+  census.has_allocated_bytes =
+      jemalloc_util::get_allocated_bytes(&census.allocated_bytes);
+  return census;
+}
@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "DexClass.h"
+
+/*
+ * A count of the live IR objects by category, with an estimate of the memory
+ * each category takes. The estimate covers the objects themselves and the
+ * buffers they own, but not the overhead of the allocator, nor that of the
+ * tables in RedexContext that intern them.
+ *
+ * Taking a census walks the interned objects and all the code, but costs
+ * nothing at other times, so it can be used in production builds.
+ * PassManager takes one after each pass when `memory_census` is set.
+ */
+struct MemoryCensus {
+  enum Category : size_t {
+    STRING,
+    TYPE,
+    TYPE_LIST,
+    PROTO,
+    FIELD,
+    METHOD,
+    CLASS,
+    ANNOTATION,
+    // The code of methods whose balloon is pending.
+    DEX_CODE,
+    IR_CODE,
+    IR_INSTRUCTION,
+    METHOD_ITEM_ENTRY,
+    POSITION,
+    CFG_BLOCK,
+    CFG_EDGE,
+    NUM_CATEGORIES,
+  };
+
+  struct Count {
+    size_t objects{0};
+    size_t bytes{0};
+  };
+
+  std::array<Count, NUM_CATEGORIES> counts;
+  // Everything the process has allocated, as jemalloc reports it, for
+  // comparison with the sum of the categories. Only set if jemalloc is linked
+  // in.
+  bool has_allocated_bytes{false};
+  uint64_t allocated_bytes{0};
+
+  static const char* name(Category category);
+
+  void add(Category category, size_t bytes, size_t objects = 1) {
+    counts[category].objects += objects;
+    counts[category].bytes += bytes;
+  }
+
+  MemoryCensus& operator+=(const MemoryCensus& that);
+
+  size_t total_bytes() const;
+
+  // Count the interned objects, and the classes in `scope` with their
+  // annotations and code.
+  static MemoryCensus take(const Scope& scope);
+};
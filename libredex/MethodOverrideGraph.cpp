@@ -10,9 +10,11 @@
 #include <boost/range/adaptor/map.hpp>
 
 #include "BinarySerialization.h"
+#include "Parallel.h"
 #include "PatriciaTreeMap.h"
 #include "PatriciaTreeSet.h"
 #include "Timer.h"
+#include "Trace.h"
 #include "Walkers.h"
 
 using namespace method_override_graph;
@@ -77,17 +79,70 @@ class GraphBuilder {
 
   std::unique_ptr<Graph> run() {
     m_graph = std::make_unique<Graph>();
-    walk::parallel::classes(m_scope, [&](const DexClass* cls) {
-      if (is_interface(cls)) {
+    for (const auto* cls : m_scope) {
+      depth(cls);
+    }
+    // The signature maps of a class start from those of its super types, so
+    // the classes are analyzed level by level and every class of a level
+    // finds the maps of its super types already computed. All interfaces come
+    // before the classes that implement them.
+    for (const auto& level : m_interface_levels) {
+      parallel_for(level.begin(), level.end(), [&](const DexClass* cls) {
         analyze_interface(cls);
-      } else {
+      });
+    }
+    for (const auto& level : m_class_levels) {
+      parallel_for(level.begin(), level.end(), [&](const DexClass* cls) {
         analyze_non_interface(cls);
-      }
-    });
+      });
+    }
     return std::move(m_graph);
   }
 
  private:
+  /*
+   * The length of the longest chain of super types of the class that have a
+   * DexClass, counting only super interfaces for interfaces and only super
+   * classes for classes. Also puts the class in its level.
+   */
+  size_t depth(const DexClass* cls) {
+    auto it = m_depths.find(cls);
+    if (it != m_depths.end()) {
+      return it->second;
+    }
+    size_t d = 0;
+    if (is_interface(cls)) {
+      for (auto* intf : cls->get_interfaces()->get_type_list()) {
+        auto intf_cls = type_class(intf);
+        if (intf_cls != nullptr) {
+          d = std::max(d, depth(intf_cls) + 1);
+        }
+      }
+    } else {
+      auto super_cls = cls->get_super_class() != nullptr
+                           ? type_class(cls->get_super_class())
+                           : nullptr;
+      if (super_cls != nullptr) {
+        d = depth(super_cls) + 1;
+      }
+      // The implemented interfaces may be outside of the scope, they still
+      // need to be in a level.
+      for (auto* intf : cls->get_interfaces()->get_type_list()) {
+        auto intf_cls = type_class(intf);
+        if (intf_cls != nullptr) {
+          depth(intf_cls);
+        }
+      }
+    }
+    m_depths.emplace(cls, d);
+    auto& levels = is_interface(cls) ? m_interface_levels : m_class_levels;
+    if (levels.size() <= d) {
+      levels.resize(d + 1);
+    }
+    levels[d].push_back(cls);
+    return d;
+  }
+
   ClassSignatureMap analyze_non_interface(const DexClass* cls) {
     always_assert(!is_interface(cls));
     if (m_class_signature_maps.count(cls) != 0) {
@@ -194,6 +249,9 @@ class GraphBuilder {
   }
 
   std::unique_ptr<Graph> m_graph;
+  std::unordered_map<const DexClass*, size_t> m_depths;
+  std::vector<std::vector<const DexClass*>> m_interface_levels;
+  std::vector<std::vector<const DexClass*>> m_class_levels;
   ClassSignatureMaps m_class_signature_maps;
   InterfaceSignatureMaps m_interface_signature_maps;
   const Scope& m_scope;
@@ -243,6 +301,49 @@ std::unique_ptr<const Graph> build_graph(const Scope& scope) {
   return GraphBuilder(scope).run();
 }
 
+const Graph& GraphCache::get(const Scope& scope) {
+  if (m_graph != nullptr && m_valid) {
+    return *m_graph;
+  }
+  auto inputs = graph_inputs(scope);
+  if (m_graph == nullptr || inputs != m_inputs) {
+    m_graph = build_graph(scope);
+    m_inputs = std::move(inputs);
+  } else {
+    TRACE(PM, 2, "Reusing the method override graph\n");
+  }
+  m_valid = true;
+  return *m_graph;
+}
+
+void GraphCache::clear() {
+  m_valid = false;
+  m_inputs.clear();
+  m_graph.reset();
+}
+
+std::vector<const void*> graph_inputs(const Scope& scope) {
+  std::vector<const void*> inputs;
+  for (const auto* cls : scope) {
+    inputs.push_back(cls);
+    inputs.push_back(is_interface(cls) ? cls->get_type() : nullptr);
+    inputs.push_back(cls->get_super_class());
+    inputs.push_back(type_class(cls->get_super_class()));
+    for (auto* intf : cls->get_interfaces()->get_type_list()) {
+      inputs.push_back(intf);
+      inputs.push_back(type_class(intf));
+    }
+    for (const auto* method : cls->get_vmethods()) {
+      inputs.push_back(method);
+      inputs.push_back(method->get_name());
+      inputs.push_back(method->get_proto());
+    }
+    // Keeps the lists of two consecutive classes apart.
+    inputs.push_back(nullptr);
+  }
+  return inputs;
+}
+
 std::unordered_set<const DexMethod*> get_overriding_methods(
     const Graph& graph, const DexMethod* method) {
   std::unordered_set<const DexMethod*> overrides;
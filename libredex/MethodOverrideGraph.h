@@ -32,6 +32,14 @@ std::unordered_set<const DexMethod*> get_overriding_methods(
  */
 std::unique_ptr<const Graph> build_graph(const Scope&);
 
+/*
+ * Everything about the scope that build_graph() depends on: the classes, their
+ * super types, interfaces and virtual method signatures. When two scopes have
+ * the same inputs, build_graph() builds the same graph for both, so a graph
+ * can be kept for as long as the inputs of the scope don't change.
+ */
+std::vector<const void*> graph_inputs(const Scope&);
+
 /*
  * The `children` edges point to the overriders / implementors of the current
  * Node's method.
@@ -55,4 +63,31 @@ class Graph {
   ConcurrentMap<const DexMethod*, Node> m_nodes;
 };
 
+/*
+ * Keeps a method override graph for as long as the class hierarchy is known
+ * not to change, e.g. across repeated runs of RemoveUnreachablePass or across
+ * the passes that declare that they preserve the class hierarchy.
+ *
+ * Once invalidate() has been called, the next get() compares the graph inputs
+ * of the scope with those of the kept graph and only rebuilds it if they
+ * differ. Whoever owns the cache must call invalidate() whenever the hierarchy
+ * may have changed. get() must always be called with the whole scope.
+ */
+class GraphCache {
+ public:
+  const Graph& get(const Scope& scope);
+
+  void invalidate() { m_valid = false; }
+
+  // Whether get() would return the kept graph without checking it.
+  bool is_valid() const { return m_valid && m_graph != nullptr; }
+
+  void clear();
+
+ private:
+  bool m_valid{false};
+  std::vector<const void*> m_inputs;
+  std::unique_ptr<const Graph> m_graph;
+};
+
 } // namespace method_override_graph
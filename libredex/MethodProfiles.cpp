@@ -0,0 +1,268 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "MethodProfiles.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+
+#include "BinarySerialization.h"
+#include "Debug.h"
+#include "DexClass.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+namespace {
+
+constexpr uint32_t k_binary_profile_version = 1;
+
+struct BinaryProfileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t count;
+  uint32_t max_weight;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(BinaryProfileHeader) == 24, "Unexpected padding");
+static_assert(sizeof(unsigned int) == sizeof(uint32_t),
+              "Weights are stored as 32-bit values");
+
+} // namespace
+
+uint64_t method_signature_hash(const std::string& deobfuscated_name) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (unsigned char c : deobfuscated_name) {
+    hash ^= c;
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+std::unique_ptr<BinaryMethodProfile> BinaryMethodProfile::open(
+    const std::string& filename) {
+  std::unique_ptr<BinaryMethodProfile> profile(new BinaryMethodProfile());
+  auto& file = profile->m_file;
+  try {
+    file.open(filename);
+  } catch (const std::exception&) {
+    return nullptr;
+  }
+  BinaryProfileHeader header;
+  if (file.size() < sizeof(header)) {
+    return nullptr;
+  }
+  memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != binary_serialization::k_header_magic) {
+    return nullptr;
+  }
+  always_assert_log(header.version == k_binary_profile_version,
+                    "Unsupported version %u of binary method profile %s\n",
+                    header.version, filename.c_str());
+  always_assert_log(file.size() == sizeof(header) + header.count *
+                                                        (sizeof(uint64_t) +
+                                                         sizeof(uint32_t)),
+                    "Truncated binary method profile %s\n", filename.c_str());
+  profile->m_count = header.count;
+  profile->m_max_weight = header.max_weight;
+  profile->m_hashes =
+      reinterpret_cast<const uint64_t*>(file.data() + sizeof(header));
+  profile->m_weights =
+      reinterpret_cast<const unsigned int*>(profile->m_hashes + header.count);
+  TRACE(CUSTOMSORT, 2, "Mapped binary method profile %s with %zu entries\n",
+        filename.c_str(), profile->m_count);
+  return profile;
+}
+
+const unsigned int* BinaryMethodProfile::find(uint64_t hash) const {
+  auto end = m_hashes + m_count;
+  auto it = std::lower_bound(m_hashes, end, hash);
+  if (it == end || *it != hash) {
+    return nullptr;
+  }
+  return m_weights + (it - m_hashes);
+}
+
+void write_binary_method_profile(
+    const std::string& filename,
+    const std::unordered_map<std::string, unsigned int>& method_to_weight) {
+  std::vector<std::pair<uint64_t, uint32_t>> entries;
+  entries.reserve(method_to_weight.size());
+  uint32_t max_weight = 0;
+  for (const auto& pair : method_to_weight) {
+    entries.emplace_back(method_signature_hash(pair.first), pair.second);
+    max_weight = std::max(max_weight, pair.second);
+  }
+  // Sorting by weight too puts the highest weight of a hash last.
+  std::sort(entries.begin(), entries.end());
+  std::vector<uint64_t> hashes;
+  std::vector<uint32_t> weights;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (i + 1 < entries.size() && entries[i + 1].first == entries[i].first) {
+      continue;
+    }
+    hashes.push_back(entries[i].first);
+    weights.push_back(entries[i].second);
+  }
+
+  std::ofstream os(filename, std::ios::binary | std::ios::trunc);
+  always_assert_log(os, "Can't write binary method profile %s\n",
+                    filename.c_str());
+  BinaryProfileHeader header{binary_serialization::k_header_magic,
+                             k_binary_profile_version, hashes.size(),
+                             max_weight, 0};
+  os.write((const char*)&header, sizeof(header));
+  os.write((const char*)hashes.data(), hashes.size() * sizeof(uint64_t));
+  os.write((const char*)weights.data(), weights.size() * sizeof(uint32_t));
+}
+
+const unsigned int* MethodProfile::find(const std::string& deobfuscated_name,
+                                        uint64_t hash) const {
+  if (binary != nullptr) {
+    return binary->find(hash);
+  }
+  auto it = method_to_weight.find(deobfuscated_name);
+  return it == method_to_weight.end() ? nullptr : &it->second;
+}
+
+unsigned int MethodProfile::max_weight() const {
+  if (binary != nullptr) {
+    return binary->max_weight();
+  }
+  unsigned int max_weight = 0;
+  for (const auto& entry : method_to_weight) {
+    max_weight = std::max(max_weight, entry.second);
+  }
+  return max_weight;
+}
+
+std::unordered_map<std::string, unsigned int> read_method_weights(
+    const std::string& filename) {
+  std::ifstream infile(filename.c_str());
+  assert_log(infile, "Can't open method profile file: %s\n", filename.c_str());
+
+  std::unordered_map<std::string, unsigned int> method_to_weight;
+  std::string deobfuscated_name;
+  unsigned int weight;
+  TRACE(CUSTOMSORT, 2, "Setting sort start file %s\n", filename.c_str());
+
+  unsigned int count = 0;
+  while (infile >> deobfuscated_name >> weight) {
+    method_to_weight[deobfuscated_name] = weight;
+    count++;
+  }
+
+  assert_log(count > 0, "Method profile file %s didn't contain valid entries\n",
+             filename.c_str());
+  TRACE(CUSTOMSORT, 2, "Preset sort weight count=%d\n", count);
+  return method_to_weight;
+}
+
+std::vector<MethodProfile> load_method_profiles(const Json::Value& config) {
+  std::vector<MethodProfile> profiles;
+  for (const auto& entry : config) {
+    auto filename = entry.get("file", "").asString();
+    always_assert_log(!filename.empty(),
+                      "Every method profile needs a \"file\"\n");
+    MethodProfile profile;
+    profile.name = entry.get("name", filename).asString();
+    profile.importance = entry.get("importance", 1.0).asDouble();
+    profile.binary = BinaryMethodProfile::open(filename);
+    if (profile.binary == nullptr) {
+      profile.method_to_weight = read_method_weights(filename);
+    }
+    profiles.push_back(std::move(profile));
+  }
+  always_assert_log(profiles.size() <= ProfiledMethods::MAX_PROFILES,
+                    "At most %zu method profiles are supported\n",
+                    ProfiledMethods::MAX_PROFILES);
+  return profiles;
+}
+
+ProfiledMethods::ProfiledMethods(const std::vector<MethodProfile>& profiles,
+                                 const std::vector<DexMethod*>& methods)
+    : m_profiles(profiles) {
+  std::vector<unsigned int> max_weights;
+  for (const auto& profile : m_profiles) {
+    max_weights.push_back(profile.max_weight());
+  }
+
+  std::vector<Entry> entries(methods.size());
+  std::vector<size_t> indices(methods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    const std::string& name = methods[i]->get_fully_deobfuscated_name();
+    auto hash = method_signature_hash(name);
+    auto& entry = entries[i];
+    for (size_t p = 0; p < m_profiles.size(); ++p) {
+      auto weight = m_profiles[p].find(name, hash);
+      if (weight == nullptr) {
+        continue;
+      }
+      entry.profiles |= uint64_t(1) << p;
+      if (max_weights[p] > 0) {
+        entry.score += m_profiles[p].importance * *weight / max_weights[p];
+      }
+    }
+  });
+  for (size_t i = 0; i < methods.size(); ++i) {
+    if (entries[i].profiles != 0) {
+      m_entries.emplace(methods[i], entries[i]);
+    }
+  }
+}
+
+double ProfiledMethods::group_importance(uint64_t profiles) const {
+  double importance = 0;
+  for (size_t p = 0; p < m_profiles.size(); ++p) {
+    if ((profiles >> p) & 1) {
+      importance += m_profiles[p].importance;
+    }
+  }
+  return importance;
+}
+
+void ProfiledMethods::sort(std::vector<DexMethod*>& methods) const {
+  std::vector<Entry> entries(methods.size());
+  std::unordered_map<uint64_t, double> importances;
+  for (size_t i = 0; i < methods.size(); ++i) {
+    auto it = m_entries.find(methods[i]);
+    if (it != m_entries.end()) {
+      entries[i] = it->second;
+      if (!importances.count(it->second.profiles)) {
+        importances.emplace(it->second.profiles,
+                            group_importance(it->second.profiles));
+      }
+    }
+  }
+  std::vector<size_t> indices(methods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  std::stable_sort(indices.begin(), indices.end(), [&](size_t a, size_t b) {
+    const auto& ea = entries[a];
+    const auto& eb = entries[b];
+    if (ea.profiles == eb.profiles) {
+      return ea.score > eb.score;
+    }
+    if (ea.profiles == 0 || eb.profiles == 0) {
+      return eb.profiles == 0;
+    }
+    double ia = importances.at(ea.profiles);
+    double ib = importances.at(eb.profiles);
+    if (ia != ib) {
+      return ia > ib;
+    }
+    return ea.profiles < eb.profiles;
+  });
+  std::vector<DexMethod*> sorted;
+  sorted.reserve(methods.size());
+  for (size_t i : indices) {
+    sorted.push_back(methods[i]);
+  }
+  methods = std::move(sorted);
+}
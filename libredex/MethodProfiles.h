@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <json/json.h>
+
+class DexMethod;
+
+/*
+ * The key of a method in a binary profile: a 64-bit FNV-1a hash of its
+ * deobfuscated name.
+ */
+uint64_t method_signature_hash(const std::string& deobfuscated_name);
+
+/*
+ * A profile in the binary format, which is memory-mapped rather than parsed.
+ * Large profiles load in constant time, and are only paged in as far as
+ * lookups touch them. The file consists of
+ *
+ *   <binary_serialization header> <uint64 count> <uint32 max weight>
+ *   <uint32 reserved> <uint64 hashes[count]> <uint32 weights[count]>
+ *
+ * where the hashes are the method_signature_hash() of the methods, in
+ * increasing order.
+ */
+class BinaryMethodProfile {
+ public:
+  // Returns null if `filename` isn't a binary profile.
+  static std::unique_ptr<BinaryMethodProfile> open(
+      const std::string& filename);
+
+  size_t size() const { return m_count; }
+
+  unsigned int max_weight() const { return m_max_weight; }
+
+  // Returns null if no method with the given hash is in the profile.
+  const unsigned int* find(uint64_t hash) const;
+
+ private:
+  BinaryMethodProfile() = default;
+
+  boost::iostreams::mapped_file_source m_file;
+  const uint64_t* m_hashes{nullptr};
+  const unsigned int* m_weights{nullptr};
+  size_t m_count{0};
+  unsigned int m_max_weight{0};
+};
+
+/*
+ * Write `method_to_weight` as a binary profile. Should two names hash the
+ * same, the higher weight is kept.
+ */
+void write_binary_method_profile(
+    const std::string& filename,
+    const std::unordered_map<std::string, unsigned int>& method_to_weight);
+
+/*
+ * A method profile maps the deobfuscated names of the methods that were
+ * executed during some scenario (cold start, warm start, scrolling, ...) to a
+ * weight, a higher weight meaning a hotter method. The importance says how
+ * much the scenario matters relative to the other profiles.
+ *
+ * Profiles are read from the `method_profiles` entry of the config:
+ *
+ *   "method_profiles": [
+ *     {"name": "coldstart", "file": "coldstart.txt", "importance": 4},
+ *     {"name": "scroll", "file": "scroll.txt", "importance": 1}
+ *   ]
+ *
+ * where each file either has the same format as `profiled_methods_file`, i.e.
+ * one `<deobfuscated method name> <weight>` pair per line, or is a
+ * BinaryMethodProfile. Only one of `method_to_weight` and `binary` is filled.
+ */
+struct MethodProfile {
+  std::string name;
+  double importance{1.0};
+  std::unordered_map<std::string, unsigned int> method_to_weight;
+  std::shared_ptr<const BinaryMethodProfile> binary;
+
+  // The weight of the method, or null if the profile doesn't have it.
+  const unsigned int* find(const std::string& deobfuscated_name,
+                           uint64_t hash) const;
+
+  unsigned int max_weight() const;
+};
+
+/*
+ * Read the `<deobfuscated method name> <weight>` pairs of a profile file.
+ */
+std::unordered_map<std::string, unsigned int> read_method_weights(
+    const std::string& filename);
+
+std::vector<MethodProfile> load_method_profiles(const Json::Value& config);
+
+/*
+ * The profile data of a given set of methods, i.e., which profiles each method
+ * appears in and with what weight. The deobfuscated name of each method is
+ * built, hashed and looked up once, in parallel, when the object is
+ * constructed.
+ *
+ * The layout computed by sort() aims at minimizing the number of pages that
+ * each profile touches, weighted by the importance of the profiles. Methods
+ * are grouped by the exact set of profiles they appear in, so that a page
+ * doesn't mix methods of a profile with methods it never executes. The groups
+ * shared by the most important profiles come first, and within a group,
+ * methods are ordered by their combined weight: the sum over the profiles of
+ * the importance times the weight normalized to the hottest method of the
+ * profile. Methods that appear in no profile keep their relative order and go
+ * last.
+ */
+class ProfiledMethods {
+ public:
+  // Each method's profiles are kept in a bit set.
+  static constexpr size_t MAX_PROFILES = 64;
+
+  ProfiledMethods(const std::vector<MethodProfile>& profiles,
+                  const std::vector<DexMethod*>& methods);
+
+  size_t num_profiles() const { return m_profiles.size(); }
+
+  const MethodProfile& profile(size_t i) const { return m_profiles[i]; }
+
+  bool in_any_profile(const DexMethod* method) const {
+    return m_entries.count(method) != 0;
+  }
+
+  bool in_profile(const DexMethod* method, size_t profile) const {
+    auto it = m_entries.find(method);
+    return it != m_entries.end() && (it->second.profiles >> profile) & 1;
+  }
+
+  void sort(std::vector<DexMethod*>& methods) const;
+
+ private:
+  struct Entry {
+    uint64_t profiles{0};
+    double score{0};
+  };
+
+  double group_importance(uint64_t profiles) const;
+
+  const std::vector<MethodProfile>& m_profiles;
+  // Only the methods that appear in at least one profile have an entry.
+  std::unordered_map<const DexMethod*, Entry> m_entries;
+};
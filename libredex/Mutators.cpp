@@ -56,7 +56,7 @@ namespace mutators {
 
 void make_static(DexMethod* method, KeepThis keep /* = Yes */) {
   auto proto = method->get_proto();
-  auto params = proto->get_args()->get_type_list();
+  auto params = proto->get_args()->to_deque();
   auto clstype = method->get_class();
   if (keep == KeepThis::Yes) {
     // make `this` an explicit parameter
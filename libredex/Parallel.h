@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <vector>
+
+#include "ThreadPool.h"
+
+/**
+ * Range-based parallel loops on the global ThreadPool, for when the work comes
+ * as a contiguous sequence of elements and making one WorkQueue item per
+ * element would cost more than the work itself.
+ *
+ * The range is handed out in chunks using guided self-scheduling: each thread
+ * claims a chunk proportional to the remaining work divided by the number of
+ * threads, but never smaller than `grain` elements. Early chunks are thus
+ * large, which keeps the synchronization overhead low, while late chunks are
+ * small, which evens out the finish times. With `grain` left at zero, it is
+ * chosen so that a range splits into no more than a few hundred chunks.
+ */
+namespace parallel_impl {
+
+template <class Iterator>
+class ChunkDispenser {
+ public:
+  ChunkDispenser(Iterator begin, size_t size, size_t grain, size_t threads)
+      : m_begin(begin), m_size(size), m_grain(grain), m_threads(threads) {}
+
+  // Claim the next chunk. Returns false once the range is exhausted.
+  bool next(Iterator* chunk_begin, Iterator* chunk_end) {
+    auto start = m_next.load(std::memory_order_relaxed);
+    size_t end;
+    do {
+      if (start >= m_size) {
+        return false;
+      }
+      auto remaining = m_size - start;
+      end = start + std::min(remaining,
+                             std::max(m_grain, remaining / (2 * m_threads)));
+    } while (!m_next.compare_exchange_weak(start, end));
+    *chunk_begin = std::next(m_begin, start);
+    *chunk_end = std::next(m_begin, end);
+    return true;
+  }
+
+ private:
+  const Iterator m_begin;
+  const size_t m_size;
+  const size_t m_grain;
+  const size_t m_threads;
+  std::atomic<size_t> m_next{0};
+};
+
+inline size_t default_grain(size_t size, size_t threads) {
+  return std::max<size_t>(1, size / (threads * 64));
+}
+
+} // namespace parallel_impl
+
+/**
+ * Call `fn` on every element of the random-access range [begin, end), in
+ * parallel. Returns once all calls have finished.
+ */
+template <class Iterator, class Fn>
+void parallel_for(Iterator begin,
+                  Iterator end,
+                  const Fn& fn,
+                  size_t grain = 0) {
+  size_t size = std::distance(begin, end);
+  auto threads = ThreadPool::get().num_threads();
+  if (grain == 0) {
+    grain = parallel_impl::default_grain(size, threads);
+  }
+  if (threads == 1 || size <= grain) {
+    std::for_each(begin, end, fn);
+    return;
+  }
+  parallel_impl::ChunkDispenser<Iterator> dispenser(begin, size, grain,
+                                                    threads);
+  ThreadPool::get().run(threads, [&](size_t) {
+    Iterator chunk_begin, chunk_end;
+    while (dispenser.next(&chunk_begin, &chunk_end)) {
+      std::for_each(chunk_begin, chunk_end, fn);
+    }
+  });
+}
+
+/**
+ * Map every element of the random-access range [begin, end) with `mapper` and
+ * combine the results with `reducer`, in parallel. `init` must be an identity
+ * of `reducer`, and since elements are not combined in any particular order,
+ * `reducer` must be associative and commutative.
+ */
+template <class Output, class Iterator, class Mapper, class Reducer>
+Output parallel_reduce(Iterator begin,
+                       Iterator end,
+                       const Output& init,
+                       const Mapper& mapper,
+                       const Reducer& reducer,
+                       size_t grain = 0) {
+  size_t size = std::distance(begin, end);
+  auto threads = ThreadPool::get().num_threads();
+  if (grain == 0) {
+    grain = parallel_impl::default_grain(size, threads);
+  }
+  if (threads == 1 || size <= grain) {
+    Output result = init;
+    for (auto it = begin; it != end; ++it) {
+      result = reducer(std::move(result), mapper(*it));
+    }
+    return result;
+  }
+  parallel_impl::ChunkDispenser<Iterator> dispenser(begin, size, grain,
+                                                    threads);
+  std::vector<Output> partials(threads, init);
+  ThreadPool::get().run(threads, [&](size_t idx) {
+    auto& partial = partials[idx];
+    Iterator chunk_begin, chunk_end;
+    while (dispenser.next(&chunk_begin, &chunk_end)) {
+      for (auto it = chunk_begin; it != chunk_end; ++it) {
+        partial = reducer(std::move(partial), mapper(*it));
+      }
+    }
+  });
+  Output result = init;
+  for (auto& partial : partials) {
+    result = reducer(std::move(result), std::move(partial));
+  }
+  return result;
+}
@@ -12,15 +12,35 @@
 #include <json/json.h>
 #include <iostream>
 #include <algorithm>
+#include <memory>
 
+#include "AnalysisSet.h"
 #include "DexStore.h"
 #include "ConfigFiles.h"
 #include "PassRegistry.h"
 
+class DexMethod;
 class PassManager;
 
 class Pass {
  public:
+  /**
+   * Does the work of a method-local pass one method at a time. See
+   * method_runner().
+   */
+  class MethodRunner {
+   public:
+    virtual ~MethodRunner() {}
+
+    // Optimizes the code of `method`. Called concurrently for different
+    // methods, including methods of the same class, and only for methods with
+    // code.
+    virtual void run(DexMethod* method) = 0;
+
+    // Called once every method has been run, to record the metrics.
+    virtual void finish(PassManager&) {}
+  };
+
 
   Pass(const std::string& name)
      : m_name(name) {
@@ -43,6 +63,55 @@ class Pass {
   virtual void eval_pass(DexStoresVector& stores, ConfigFiles& cfg, PassManager& mgr) {};
   virtual void run_pass(DexStoresVector& stores, ConfigFiles& cfg, PassManager& mgr) = 0;
 
+  /**
+   * Passes that only look at and change code through editable CFGs
+   * (IRCode::build_cfg(true) and IRCode::cfg()), and never through the linear
+   * IRList, should return true. With the "persistent_cfg" option, the
+   * PassManager keeps the editable CFGs alive across a run of such passes and
+   * only linearizes them before the next pass that returns false.
+   */
+  virtual bool is_cfg_friendly() const { return false; }
+
+  /**
+   * Passes that change each method's code looking only at that code and at
+   * definitions (classes, fields, method signatures and flags), never at the
+   * code of other methods, and that change nothing else, should return true.
+   * With the "method_local_processes" option, the PassManager may run a
+   * sequence of such passes over shards of the classes in separate processes.
+   */
+  virtual bool is_method_local() const { return false; }
+
+  /**
+   * Method-local passes may return a runner that does their work one method
+   * at a time. With the "pipeline_method_local_passes" option, the
+   * PassManager runs a sequence of passes that have runners in a single
+   * parallel walk, taking each method through all of them in turn instead of
+   * walking the whole scope once per pass. The runners of a sequence are all
+   * created before any method is run, so whatever a later pass reads from the
+   * PassManager when creating its runner must be recorded here, not in
+   * finish(). Returning null, which must have no effect, makes the
+   * PassManager call run_pass() instead.
+   */
+  virtual std::unique_ptr<MethodRunner> method_runner(DexStoresVector&,
+                                                      ConfigFiles&,
+                                                      PassManager&) {
+    return nullptr;
+  }
+
+  /**
+   * The analyses kept by the PassManager's AnalysisManager that this pass
+   * gets from it. They are built, if not cached, before the pass runs.
+   */
+  virtual analysis::Set required_analyses() const { return analysis::NONE; }
+
+  /**
+   * The analyses that are still valid after this pass has run. All other
+   * cached analyses are invalidated. Passes that never add or remove classes
+   * or virtual methods, and never change super classes, interfaces or method
+   * signatures, preserve analysis::CLASS_HIERARCHY_ANALYSES.
+   */
+  virtual analysis::Set preserved_analyses() const { return analysis::NONE; }
+
  private:
   std::string m_name;
 };
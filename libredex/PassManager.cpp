@@ -7,12 +7,26 @@
 
 #include "PassManager.h"
 
+#include <algorithm>
+#include <atomic>
 #include <boost/filesystem.hpp>
+#include <chrono>
+#include <cmath>
 #include <cstdio>
+#include <fstream>
+#include <numeric>
 #include <unordered_set>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "AnalysisManager.h"
 #include "ApiLevelChecker.h"
 #include "ApkManager.h"
+#include "BinarySerialization.h"
 #include "CommandProfiling.h"
 #include "ConfigFiles.h"
 #include "Debug.h"
@@ -20,6 +34,7 @@
 #include "DexLoader.h"
 #include "DexOutput.h"
 #include "DexUtil.h"
+#include "IRAssembler.h"
 #include "IRCode.h"
 #include "IRTypeChecker.h"
 #include "InstructionLowering.h"
@@ -29,8 +44,12 @@
 #include "ProguardPrintConfiguration.h"
 #include "ProguardReporting.h"
 #include "ReachableClasses.h"
+#include "Resolver.h"
+#include "ThreadPool.h"
 #include "Timer.h"
+#include "Trace.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -50,6 +69,7 @@ void RedexOptions::serialize(Json::Value& entry_data) const {
   options["is_art_build"] = is_art_build;
   options["instrument_pass_enabled"] = instrument_pass_enabled;
   options["min_sdk"] = min_sdk;
+  options["num_threads"] = num_threads;
 }
 
 void RedexOptions::deserialize(const Json::Value& entry_data) {
@@ -58,6 +78,7 @@ void RedexOptions::deserialize(const Json::Value& entry_data) {
   is_art_build = options_data["is_art_build"].asBool();
   instrument_pass_enabled = options_data["instrument_pass_enabled"].asBool();
   min_sdk = options_data["min_sdk"].asInt();
+  num_threads = options_data["num_threads"].asUInt();
 }
 
 std::unique_ptr<redex::ProguardConfiguration> empty_pg_config() {
@@ -79,7 +100,8 @@ PassManager::PassManager(
       m_current_pass_info(nullptr),
       m_pg_config(std::move(pg_config)),
       m_redex_options(options),
-      m_testing_mode(false) {
+      m_testing_mode(false),
+      m_analyses(std::make_unique<AnalysisManager>()) {
   init(config);
   if (getenv("PROFILE_COMMAND") && getenv("PROFILE_PASS")) {
     // Resolve the pass in the constructor so that any typos / references to
@@ -97,6 +119,8 @@ PassManager::PassManager(
   }
 }
 
+PassManager::~PassManager() = default;
+
 void PassManager::init(const Json::Value& config) {
   if (config["redex"].isMember("passes")) {
     auto passes_from_config = config["redex"]["passes"];
@@ -129,36 +153,669 @@ void PassManager::init(const Json::Value& config) {
   }
 }
 
-void PassManager::run_type_checker(const Scope& scope,
-                                   bool polymorphic_constants,
-                                   bool verify_moves) {
+namespace {
+
+int to_ms(double secs) { return static_cast<int>(std::round(secs * 1000)); }
+
+/*
+ * How well the pass's parallel regions kept their workers busy. The
+ * utilization is the busy share of the workers' time; the critical path is
+ * the least time the regions could have taken with their tasks spread over
+ * the workers as they were.
+ */
+void set_work_queue_metrics(const WorkQueueTotals& totals, PassManager& mgr) {
+  mgr.set_metric("work_queue_runs", totals.num_runs);
+  mgr.set_metric("work_queue_tasks", totals.num_tasks);
+  mgr.set_metric("work_queue_steal_attempts", totals.num_steal_attempts);
+  mgr.set_metric("work_queue_steals", totals.num_steals);
+  mgr.set_metric("work_queue_wall_ms", to_ms(totals.wall_secs));
+  mgr.set_metric("work_queue_busy_ms", to_ms(totals.busy_secs));
+  mgr.set_metric("work_queue_idle_ms", to_ms(totals.idle_secs));
+  mgr.set_metric("work_queue_critical_path_ms",
+                 to_ms(totals.critical_path_secs));
+  double worker_secs = totals.busy_secs + totals.idle_secs;
+  mgr.set_metric(
+      "work_queue_utilization_pct",
+      worker_secs > 0 ? std::round(100 * totals.busy_secs / worker_secs) : 0);
+}
+
+/*
+ * Everything in a method that the IRTypeChecker looks at, written out exactly
+ * in a single pass over its code, so that a method is only skipped when none
+ * of it changed. That is:
+ * - its signature and register count;
+ * - every instruction, along with the protos and field types of the refs it
+ *   uses, as refs can be mutated in place;
+ * - the branches and try regions. Their entries refer to each other by
+ *   address, so the address of every entry is recorded too. Code that was
+ *   rebuilt at other addresses is simply checked again.
+ * - the class and superclasses of every type that is mentioned, which the
+ *   inference of reference types relies on to join them.
+ * This takes about as much memory as the code itself.
+ */
+std::vector<uintptr_t> type_checker_inputs(DexMethod* method) {
+  std::vector<uintptr_t> inputs;
+  auto add = [&](const void* p) {
+    inputs.push_back(reinterpret_cast<uintptr_t>(p));
+  };
+  auto add_type = [&](const DexType* type) {
+    // Catch-all entries and the root of the hierarchy have no type.
+    while (type != nullptr) {
+      add(type);
+      auto cls = type_class(type);
+      add(cls);
+      type = cls != nullptr ? cls->get_super_class() : nullptr;
+    }
+    add(nullptr);
+  };
+  auto add_proto = [&](const DexProto* proto) {
+    add_type(proto->get_rtype());
+    for (auto arg : proto->get_args()->get_type_list()) {
+      add_type(arg);
+    }
+    add(nullptr);
+  };
+  add_proto(method->get_proto());
+  add_type(method->get_class());
+  inputs.push_back(method->get_access());
+  IRCode* code = method->get_code();
+  if (code == nullptr) {
+    return inputs;
+  }
+  inputs.push_back(code->get_registers_size());
+  for (auto& mie : *code) {
+    add(&mie);
+    inputs.push_back(mie.type);
+    switch (mie.type) {
+    case MFLOW_TRY:
+      inputs.push_back(mie.tentry->type);
+      add(mie.tentry->catch_start);
+      break;
+    case MFLOW_CATCH:
+      add_type(mie.centry->catch_type);
+      add(mie.centry->next);
+      break;
+    case MFLOW_OPCODE: {
+      auto insn = mie.insn;
+      inputs.push_back(insn->opcode());
+      if (insn->dests_size() > 0) {
+        inputs.push_back(insn->dest());
+      }
+      inputs.push_back(insn->srcs_size());
+      for (size_t i = 0; i < insn->srcs_size(); ++i) {
+        inputs.push_back(insn->src(i));
+      }
+      if (insn->has_literal()) {
+        inputs.push_back(insn->get_literal());
+      }
+      if (insn->has_string()) {
+        add(insn->get_string());
+      } else if (insn->has_type()) {
+        add_type(insn->get_type());
+      } else if (insn->has_field()) {
+        auto field = insn->get_field();
+        add(field);
+        add_type(field->get_class());
+        add_type(field->get_type());
+      } else if (insn->has_method()) {
+        auto callee = insn->get_method();
+        add(callee);
+        add_type(callee->get_class());
+        add_proto(callee->get_proto());
+      } else if (insn->has_data()) {
+        auto data = insn->get_data();
+        inputs.push_back(data->data_size());
+        inputs.insert(inputs.end(), data->data(),
+                      data->data() + data->data_size());
+      }
+      break;
+    }
+    case MFLOW_DEX_OPCODE:
+      add(mie.dex_insn);
+      break;
+    case MFLOW_TARGET:
+      inputs.push_back(mie.target->type);
+      add(mie.target->src);
+      if (mie.target->type == BRANCH_MULTI) {
+        inputs.push_back(mie.target->case_key);
+      }
+      break;
+    case MFLOW_DEBUG:
+    case MFLOW_POSITION:
+    case MFLOW_FALLTHROUGH:
+      break;
+    }
+  }
+  return inputs;
+}
+
+struct ResourceSample {
+  std::chrono::steady_clock::time_point wall;
+  double cpu_seconds{0};
+  int64_t rss_kb{0};
+  int64_t peak_rss_kb{0};
+  bool has_allocated_bytes{false};
+  uint64_t allocated_bytes{0};
+  bool has_numa_stats{false};
+  int64_t numa_local_pages{0};
+  int64_t numa_remote_pages{0};
+};
+
+// Zero where /proc/self/statm is not available.
+int64_t read_rss_kb() {
+#ifdef __linux__
+  std::ifstream statm("/proc/self/statm");
+  int64_t size_pages, resident_pages;
+  if (statm >> size_pages >> resident_pages) {
+    return resident_pages * (sysconf(_SC_PAGESIZE) / 1024);
+  }
+#endif
+  return 0;
+}
+
+// Sums up the numastat counters of all the nodes. Returns false unless there
+// are several nodes.
+bool read_numa_stats(int64_t* local_pages, int64_t* remote_pages) {
+#ifdef __linux__
+  *local_pages = 0;
+  *remote_pages = 0;
+  size_t num_nodes = 0;
+  for (;; ++num_nodes) {
+    std::ifstream in("/sys/devices/system/node/node" +
+                     std::to_string(num_nodes) + "/numastat");
+    if (!in) {
+      break;
+    }
+    std::string key;
+    int64_t value;
+    while (in >> key >> value) {
+      if (key == "local_node") {
+        *local_pages += value;
+      } else if (key == "other_node") {
+        *remote_pages += value;
+      }
+    }
+  }
+  return num_nodes > 1;
+#else
+  return false;
+#endif
+}
+
+// Cheap enough to take around every pass: two getrusage calls, a read of
+// /proc/self/statm, of the numastat of each NUMA node, and a jemalloc stats
+// refresh.
+ResourceSample sample_resources() {
+  ResourceSample sample;
+  sample.wall = std::chrono::steady_clock::now();
+#if defined(__unix__) || defined(__APPLE__)
+  auto seconds = [](const timeval& tv) {
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+  };
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    sample.cpu_seconds = seconds(usage.ru_utime) + seconds(usage.ru_stime);
+#ifdef __APPLE__
+    sample.peak_rss_kb = usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    sample.peak_rss_kb = usage.ru_maxrss;
+#endif
+  }
+  // The shards of the method-local passes run in child processes, which are
+  // counted here once they have been waited for.
+  if (getrusage(RUSAGE_CHILDREN, &usage) == 0) {
+    sample.cpu_seconds += seconds(usage.ru_utime) + seconds(usage.ru_stime);
+  }
+#endif
+  sample.rss_kb = read_rss_kb();
+  sample.has_allocated_bytes =
+      jemalloc_util::get_allocated_bytes(&sample.allocated_bytes);
+  sample.has_numa_stats =
+      read_numa_stats(&sample.numa_local_pages, &sample.numa_remote_pages);
+  return sample;
+}
+
+PassManager::PassResources resources_between(const ResourceSample& before,
+                                             const ResourceSample& after) {
+  PassManager::PassResources res;
+  res.wall_seconds =
+      std::chrono::duration<double>(after.wall - before.wall).count();
+  res.cpu_seconds = after.cpu_seconds - before.cpu_seconds;
+  res.rss_delta_kb = after.rss_kb - before.rss_kb;
+  res.peak_rss_kb = after.peak_rss_kb;
+  res.has_allocated_bytes =
+      before.has_allocated_bytes && after.has_allocated_bytes;
+  if (res.has_allocated_bytes) {
+    res.allocated_bytes_delta =
+        (int64_t)after.allocated_bytes - (int64_t)before.allocated_bytes;
+  }
+  res.has_numa_stats = before.has_numa_stats && after.has_numa_stats;
+  if (res.has_numa_stats) {
+    res.numa_local_pages_delta =
+        after.numa_local_pages - before.numa_local_pages;
+    res.numa_remote_pages_delta =
+        after.numa_remote_pages - before.numa_remote_pages;
+  }
+  return res;
+}
+
+/*
+ * The part of the resources of a group of method-local passes that goes to one
+ * of them, given its `share` of the time spent in the group. The peak RSS is
+ * the group's.
+ */
+PassManager::PassResources share_of(const PassManager::PassResources& group,
+                                    double share) {
+  auto res = group;
+  res.wall_seconds *= share;
+  res.cpu_seconds *= share;
+  res.rss_delta_kb = std::llround(group.rss_delta_kb * share);
+  res.allocated_bytes_delta = std::llround(group.allocated_bytes_delta * share);
+  res.numa_local_pages_delta =
+      std::llround(group.numa_local_pages_delta * share);
+  res.numa_remote_pages_delta =
+      std::llround(group.numa_remote_pages_delta * share);
+  return res;
+}
+
+// The slowest work items and the work queue stats of a pass, or of a group of
+// method-local passes, as far as they are enabled.
+struct WorkMeasures {
+  std::vector<WorkItemProfiler::Sample> hot_items;
+  boost::optional<WorkQueueTotals> work_queue_totals;
+};
+
+void start_work_measures(size_t profile_top_n, bool work_queue_stats) {
+  if (profile_top_n > 0) {
+    WorkItemProfiler::start(profile_top_n);
+  }
+  if (work_queue_stats) {
+    WorkQueueTotals::start();
+  }
+}
+
+WorkMeasures stop_work_measures(size_t profile_top_n, bool work_queue_stats) {
+  WorkMeasures measures;
+  if (work_queue_stats) {
+    measures.work_queue_totals = WorkQueueTotals::stop();
+  }
+  if (profile_top_n > 0) {
+    measures.hot_items = WorkItemProfiler::stop();
+  }
+  return measures;
+}
+
+// Bump this whenever the format of the files written by the shards changes.
+constexpr uint32_t k_shard_version = 2;
+
+void for_each_code(const Scope& scope,
+                   const std::function<void(DexMethod*, IRCode*)>& f) {
+  for (auto cls : scope) {
+    for (auto* methods : {&cls->get_dmethods(), &cls->get_vmethods()}) {
+      for (auto method : *methods) {
+        if (method->get_code() != nullptr) {
+          f(method, method->get_code());
+        }
+      }
+    }
+  }
+}
+
+/*
+ * Splits the classes of `scope` into `n` shards with roughly the same amount
+ * of code. Classes with code that the assembler can't express go to `local`
+ * instead, since their code can't be sent back from another process. Each
+ * shard keeps the order of `scope`.
+ */
+std::vector<Scope> make_shards(const Scope& scope, size_t n, Scope* local) {
+  std::vector<std::pair<size_t, size_t>> sizes; // (code size, index in scope)
+  for (size_t i = 0; i < scope.size(); ++i) {
+    size_t size = 0;
+    bool expressible = true;
+    for_each_code({scope[i]}, [&](DexMethod*, IRCode* code) {
+      size += code->sum_opcode_sizes();
+      expressible = expressible && assembler::can_express(code);
+    });
+    if (expressible) {
+      sizes.emplace_back(size, i);
+    } else {
+      local->push_back(scope[i]);
+    }
+  }
+  // Largest first, each to the shard with the least code so far.
+  std::sort(sizes.begin(), sizes.end(), [](const auto& a, const auto& b) {
+    return a.first != b.first ? a.first > b.first : a.second < b.second;
+  });
+  std::vector<size_t> totals(n, 0);
+  std::vector<std::vector<size_t>> indices(n);
+  for (const auto& pair : sizes) {
+    auto shard = std::min_element(totals.begin(), totals.end()) - totals.begin();
+    totals[shard] += pair.first;
+    indices[shard].push_back(pair.second);
+  }
+  std::vector<Scope> shards(n);
+  for (size_t k = 0; k < n; ++k) {
+    std::sort(indices[k].begin(), indices[k].end());
+    for (auto i : indices[k]) {
+      shards[k].push_back(scope[i]);
+    }
+  }
+  return shards;
+}
+
+/*
+ * Removes the classes that are not in `keep` from the dexes of `stores`, and
+ * returns the dexes as they were.
+ */
+std::vector<std::vector<DexClasses>> restrict_stores(
+    DexStoresVector& stores, const std::unordered_set<const DexClass*>& keep) {
+  std::vector<std::vector<DexClasses>> original;
+  for (auto& store : stores) {
+    original.push_back(store.get_dexen());
+    for (auto& dex : store.get_dexen()) {
+      dex.erase(std::remove_if(dex.begin(), dex.end(),
+                               [&](DexClass* cls) { return !keep.count(cls); }),
+                dex.end());
+    }
+  }
+  return original;
+}
+
+void restore_stores(DexStoresVector& stores,
+                    std::vector<std::vector<DexClasses>> original) {
+  for (size_t i = 0; i < stores.size(); ++i) {
+    stores[i].get_dexen() = std::move(original[i]);
+  }
+}
+
+} // namespace
+
+void PassManager::set_keep_cfgs(const Scope& scope, bool keep) {
+  m_keeping_cfgs = keep;
+  Timer t(keep ? "Keeping CFGs" : "Linearizing kept CFGs");
+  walk::parallel::code(scope, [keep](DexMethod*, IRCode& code) {
+    code.set_keep_cfg(keep);
+    if (!keep) {
+      code.clear_cfg();
+    }
+  });
+}
+
+size_t PassManager::run_type_checker(
+    const Scope& scope,
+    const IRTypeChecker::ScopeOptions& options,
+    ConcurrentMap<const DexMethod*, TypeCheckerInputs>* last_checked) {
   TRACE(PM, 1, "Running IRTypeChecker...\n");
   Timer t("IRTypeChecker");
-  walk::parallel::methods(scope, [=](DexMethod* dex_method) {
-    IRTypeChecker checker(dex_method);
-    if (polymorphic_constants) {
-      checker.enable_polymorphic_constants();
+  std::function<bool(DexMethod*)> should_check;
+  if (last_checked != nullptr) {
+    should_check = [last_checked](DexMethod* dex_method) {
+      auto inputs = type_checker_inputs(dex_method);
+      bool unchanged = false;
+      // Any failure aborts below, so the inputs can be recorded before the
+      // method is checked.
+      last_checked->update(dex_method,
+                           [&](const DexMethod*, TypeCheckerInputs& last,
+                               bool exists) {
+                             unchanged = exists && last == inputs;
+                             if (!unchanged) {
+                               last = std::move(inputs);
+                             }
+                           });
+      return !unchanged;
+    };
+  }
+  auto result = IRTypeChecker::check_scope(scope, options, should_check);
+  for (const auto& failure : result.failures) {
+    fprintf(stderr, "ABORT! Inconsistency found in Dex code for %s.\n %s\n",
+            SHOW(failure.method), failure.what.c_str());
+    fprintf(stderr, "Code:\n%s\n", SHOW(failure.method->get_code()));
+  }
+  if (!result.failures.empty()) {
+    exit(EXIT_FAILURE);
+  }
+  TRACE(PM, 1, "IRTypeChecker checked %zu methods\n", result.checked);
+  return result.checked;
+}
+
+void PassManager::run_method_local_group(size_t begin,
+                                         size_t end,
+                                         bool pipeline,
+                                         DexStoresVector& stores,
+                                         ConfigFiles& cfg,
+                                         std::vector<double>* pass_seconds) {
+  using clock = std::chrono::steady_clock;
+  size_t p = begin;
+  while (p < end) {
+    // Take the following passes that have method runners...
+    std::vector<std::unique_ptr<Pass::MethodRunner>> runners;
+    size_t first = p;
+    for (; pipeline && p < end; ++p) {
+      m_current_pass_info = &m_pass_info[p];
+      auto runner = m_activated_passes[p]->method_runner(stores, cfg, *this);
+      m_current_pass_info = nullptr;
+      if (runner == nullptr) {
+        break;
+      }
+      runners.push_back(std::move(runner));
+    }
+
+    // ... or else run the next one as usual.
+    if (runners.empty()) {
+      Pass* pass = m_activated_passes[p];
+      TRACE(PM, 1, "Running %s...\n", pass->name().c_str());
+      Timer t(pass->name() + " (run)");
+      m_current_pass_info = &m_pass_info[p];
+      invalidate_method_resolution_cache();
+      auto start = clock::now();
+      pass->run_pass(stores, cfg, *this);
+      (*pass_seconds)[p - begin] +=
+          std::chrono::duration<double>(clock::now() - start).count();
+      flush_trace();
+      m_current_pass_info = nullptr;
+      ++p;
+      continue;
+    }
+
+    std::string names;
+    for (size_t q = first; q < p; ++q) {
+      names += (q == first ? "" : ", ") + m_activated_passes[q]->name();
+    }
+    TRACE(PM, 1, "Running %s one method at a time...\n", names.c_str());
+    // The time spent in each runner, summed over the methods.
+    std::vector<std::atomic<uint64_t>> runner_nanos(runners.size());
+    {
+      Timer t(names + " (pipelined run)");
+      invalidate_method_resolution_cache();
+      walk::parallel::code(
+          build_class_scope(stores), [&](DexMethod* method, IRCode&) {
+            auto start = clock::now();
+            for (size_t r = 0; r < runners.size(); ++r) {
+              runners[r]->run(method);
+              auto now = clock::now();
+              runner_nanos[r].fetch_add(
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      now - start)
+                      .count(),
+                  std::memory_order_relaxed);
+              start = now;
+            }
+          },
+          walk::parallel::default_num_threads(),
+          walk::parallel::Split::LARGE_CLASSES);
+    }
+    for (size_t q = first; q < p; ++q) {
+      (*pass_seconds)[q - begin] += runner_nanos[q - first] / 1e9;
+      m_current_pass_info = &m_pass_info[q];
+      runners[q - first]->finish(*this);
+      m_current_pass_info = nullptr;
+    }
+    flush_trace();
+  }
+}
+
+void PassManager::run_method_local_passes(size_t begin,
+                                          size_t end,
+                                          size_t num_processes,
+                                          bool pipeline,
+                                          DexStoresVector& stores,
+                                          ConfigFiles& cfg,
+                                          std::vector<double>* pass_seconds) {
+#if defined(__unix__) || defined(__APPLE__)
+  Timer t("Method-local passes in " + std::to_string(num_processes) +
+          " processes");
+  always_assert(!m_keeping_cfgs);
+  Scope local;
+  auto shards = make_shards(build_class_scope(stores), num_processes, &local);
+  std::vector<std::string> paths;
+  for (size_t k = 0; k < num_processes; ++k) {
+    paths.push_back((boost::filesystem::temp_directory_path() /
+                     boost::filesystem::unique_path("redex-shard-%%%%%%%%"))
+                        .string());
+  }
+
+  // Output that is still buffered, by stdio or by TRACE, would be written by
+  // every child too.
+  flush_trace();
+  fflush(nullptr);
+  std::vector<pid_t> children;
+  for (size_t k = 0; k < num_processes; ++k) {
+    auto child = fork();
+    always_assert_log(child != -1, "Failed to fork");
+    if (child != 0) {
+      children.push_back(child);
+      continue;
     }
-    if (verify_moves) {
-      checker.verify_moves();
+    // In the child: run the passes over shard k and write the results for the
+    // parent. Exit without running destructors or atexit handlers, which
+    // belong to the parent.
+    int status = EXIT_SUCCESS;
+    try {
+      ThreadPool::get().reset_after_fork();
+      restrict_stores(stores, std::unordered_set<const DexClass*>(
+                                  shards[k].begin(), shards[k].end()));
+      for (size_t p = begin; p < end; ++p) {
+        // Keep the incremental caches of the shards apart.
+        m_pass_info[p].name += ".shard" + std::to_string(k);
+        m_pass_info[p].metrics.clear();
+      }
+      std::vector<double> shard_seconds(end - begin, 0);
+      run_method_local_group(begin, end, pipeline, stores, cfg,
+                             &shard_seconds);
+
+      std::ofstream os(paths[k], std::ios::binary | std::ios::trunc);
+      always_assert_log(os, "Unable to write %s", paths[k].c_str());
+      binary_serialization::write_header(os, k_shard_version);
+      binary_serialization::write<uint8_t>(os, m_regalloc_has_run);
+      for (size_t p = begin; p < end; ++p) {
+        const auto& metrics = m_pass_info[p].metrics;
+        binary_serialization::write<uint32_t>(os, metrics.size());
+        for (const auto& pair : metrics) {
+          binary_serialization::write_string(os, pair.first);
+          binary_serialization::write<int32_t>(os, pair.second);
+        }
+        binary_serialization::write<uint64_t>(
+            os, std::llround(shard_seconds[p - begin] * 1e6));
+      }
+      for_each_code(shards[k], [&](DexMethod* method, IRCode* code) {
+        code->clear_cfg();
+        always_assert_log(assembler::can_express(code),
+                          "Can't send back the code of %s", SHOW(method));
+        binary_serialization::write_string(os, show(method));
+        binary_serialization::write<uint32_t>(os, code->get_registers_size());
+        binary_serialization::write_string(os, assembler::to_string(code));
+      });
+      os.close();
+      always_assert_log(os, "Unable to write %s", paths[k].c_str());
+    } catch (const std::exception& e) {
+      fprintf(stderr, "Shard %zu failed: %s\n", k, e.what());
+      status = EXIT_FAILURE;
     }
-    checker.run();
-    if (checker.fail()) {
-      std::string msg = checker.what();
-      fprintf(stderr, "ABORT! Inconsistency found in Dex code for %s.\n %s\n",
-              SHOW(dex_method), msg.c_str());
-      fprintf(stderr, "Code:\n%s\n", SHOW(dex_method->get_code()));
-      exit(EXIT_FAILURE);
+    flush_trace();
+    fflush(nullptr);
+    _exit(status);
+  }
+
+  // Meanwhile, run the passes over the classes that stay here.
+  {
+    auto original = restrict_stores(
+        stores,
+        std::unordered_set<const DexClass*>(local.begin(), local.end()));
+    run_method_local_group(begin, end, pipeline, stores, cfg, pass_seconds);
+    restore_stores(stores, std::move(original));
+  }
+
+  // The code that the shards sent back. It is read serially, since the files
+  // are sequential, and then parsed in parallel.
+  struct ShardedCode {
+    uint32_t registers_size;
+    std::string body;
+  };
+  std::unordered_map<const DexMethod*, ShardedCode> sharded_code;
+  Scope sharded_classes;
+  for (size_t k = 0; k < num_processes; ++k) {
+    int status;
+    always_assert(waitpid(children[k], &status, 0) == children[k]);
+    always_assert_log(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS,
+                      "Shard %zu of the method-local passes failed", k);
+
+    std::ifstream is(paths[k], std::ios::binary);
+    uint32_t version;
+    always_assert_log(binary_serialization::read_header(is, &version) &&
+                          version == k_shard_version,
+                      "Bad shard file %s", paths[k].c_str());
+    uint8_t regalloc_has_run;
+    is.read((char*)&regalloc_has_run, sizeof(regalloc_has_run));
+    m_regalloc_has_run = m_regalloc_has_run || regalloc_has_run;
+    for (size_t p = begin; p < end; ++p) {
+      uint32_t num_metrics;
+      is.read((char*)&num_metrics, sizeof(num_metrics));
+      for (uint32_t i = 0; is && i < num_metrics; ++i) {
+        std::string key;
+        int32_t value;
+        binary_serialization::read_string(is, &key);
+        is.read((char*)&value, sizeof(value));
+        m_pass_info[p].metrics[key] += value;
+      }
+      uint64_t micros;
+      is.read((char*)&micros, sizeof(micros));
+      (*pass_seconds)[p - begin] += micros / 1e6;
     }
+    for_each_code(shards[k], [&](DexMethod* method, IRCode*) {
+      std::string name;
+      ShardedCode code;
+      binary_serialization::read_string(is, &name);
+      is.read((char*)&code.registers_size, sizeof(code.registers_size));
+      always_assert_log(binary_serialization::read_string(is, &code.body) &&
+                            name == show(method),
+                        "Bad shard file %s at %s", paths[k].c_str(),
+                        SHOW(method));
+      sharded_code.emplace(method, std::move(code));
+    });
+    is.close();
+    boost::filesystem::remove(paths[k]);
+    sharded_classes.insert(sharded_classes.end(), shards[k].begin(),
+                           shards[k].end());
+  }
+
+  walk::parallel::code(sharded_classes, [&](DexMethod* method, IRCode& code) {
+    const auto& sharded = sharded_code.at(method);
+    auto optimized = assembler::ircode_from_string(sharded.body);
+    optimized->set_registers_size(sharded.registers_size);
+    optimized->set_debug_item(code.release_debug_item());
+    method->set_code(std::move(optimized));
   });
+#else
+  always_assert_log(false, "Sharded passes need fork()");
+#endif
 }
 
 void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& cfg) {
-  api::LevelChecker::init(m_redex_options.min_sdk);
-
   DexStoreClassesIterator it(stores);
   Scope scope = build_class_scope(it);
 
+  api::LevelChecker::init(m_redex_options.min_sdk, scope);
+
   char* seeds_output_file = std::getenv("REDEX_SEEDS_FILE");
   if (seeds_output_file) {
     std::string seed_filename = seeds_output_file;
@@ -204,42 +861,206 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& cfg) {
       cfg.get_json_config()["ir_type_checker"];
   bool run_after_each_pass =
       type_checker_args.get("run_after_each_pass", false).asBool();
+  IRTypeChecker::ScopeOptions type_checker_options;
   // When verify_none is enabled, it's OK to have polymorphic constants.
-  bool polymorphic_constants =
+  type_checker_options.polymorphic_constants =
       type_checker_args.get("polymorphic_constants", false).asBool() ||
       get_redex_options().verify_none_enabled;
-  bool verify_moves = type_checker_args.get("verify_moves", false).asBool();
+  type_checker_options.verify_moves =
+      type_checker_args.get("verify_moves", false).asBool();
+  // When off, every method is checked and all the failures are reported.
+  type_checker_options.stop_at_first_failure =
+      type_checker_args.get("stop_at_first_failure", true).asBool();
+  // Between passes, only re-check the methods that changed since their last
+  // check. The check before generating the output always covers every method.
+  bool incremental = type_checker_args.get("incremental", true).asBool();
+  ConcurrentMap<const DexMethod*, TypeCheckerInputs> type_checked_inputs;
   std::unordered_set<std::string> trigger_passes;
 
   for (auto& trigger_pass : type_checker_args["run_after_passes"]) {
     trigger_passes.insert(trigger_pass.asString());
   }
+  // Return the memory that these passes freed to the OS once they're done,
+  // instead of leaving it fragmented in the allocator's arenas.
+  std::unordered_set<std::string> malloc_purge_passes;
+  for (auto& purge_pass :
+       cfg.get_json_config()["malloc_purge_after_passes"]) {
+    malloc_purge_passes.insert(purge_pass.asString());
+  }
+
+  // Keep editable CFGs alive across consecutive passes that work on them,
+  // instead of linearizing and rebuilding them for every pass.
+  bool persistent_cfg = cfg.get_json_config().get("persistent_cfg", false);
+  size_t profile_top_n;
+  cfg.get_json_config().get("work_item_profile_top_n", 0, profile_top_n);
+  bool work_queue_stats =
+      cfg.get_json_config().get("work_queue_stats", false);
+  bool memory_census = cfg.get_json_config().get("memory_census", false);
+  // The slowest work items and the work queue stats go to the current pass.
+  auto record_work_measures = [&](const WorkMeasures& measures) {
+    if (measures.work_queue_totals) {
+      set_work_queue_metrics(*measures.work_queue_totals, *this);
+    }
+    m_current_pass_info->hot_items = measures.hot_items;
+  };
+  // Records the RSS before and after on the current pass.
+  auto purge_malloc = [&](const Pass* pass) {
+    auto rss_before_kb = read_rss_kb();
+    if (jemalloc_util::purge_all_arenas()) {
+      auto rss_after_kb = read_rss_kb();
+      TRACE(PM, 1, "Purged the allocator after %s: RSS %ld kB -> %ld kB\n",
+            pass->name().c_str(), (long)rss_before_kb, (long)rss_after_kb);
+      set_metric("malloc_purge_rss_before_kb", rss_before_kb);
+      set_metric("malloc_purge_rss_after_kb", rss_after_kb);
+    }
+  };
+  // Run sequences of method-local passes over shards of the classes in this
+  // many forked processes. Zero or one runs them here, as usual.
+  size_t method_local_processes;
+  cfg.get_json_config().get("method_local_processes", 0,
+                            method_local_processes);
+#if !defined(__unix__) && !defined(__APPLE__)
+  method_local_processes = 0;
+#endif
+  // Run sequences of method-local passes one method at a time, in a single
+  // walk over the methods.
+  bool pipeline =
+      cfg.get_json_config().get("pipeline_method_local_passes", false);
+  auto can_group = [&](const Pass* pass) {
+    return (method_local_processes > 1 || pipeline) &&
+           pass->is_method_local() &&
+           pass->required_analyses() == analysis::NONE &&
+           !(m_profiler_info && m_profiler_info->pass == pass) &&
+           m_malloc_profile_pass != pass;
+  };
 
   for (size_t i = 0; i < m_activated_passes.size(); ++i) {
     Pass* pass = m_activated_passes[i];
+    size_t end = i;
+    while (end < m_activated_passes.size() &&
+           can_group(m_activated_passes[end])) {
+      ++end;
+    }
+    // Pipelining a single pass gains nothing.
+    if (end > i + (method_local_processes > 1 ? 0 : 1)) {
+      // Kept CFGs would have to be linearized for the shards, and the passes
+      // that work on the linear code need it linearized anyway.
+      if (m_keeping_cfgs) {
+        set_keep_cfgs(build_class_scope(it), false);
+      }
+      std::vector<double> pass_seconds(end - i, 0);
+      auto before = sample_resources();
+      start_work_measures(profile_top_n, work_queue_stats);
+      if (method_local_processes > 1) {
+        run_method_local_passes(i, end, method_local_processes, pipeline,
+                                stores, cfg, &pass_seconds);
+      } else {
+        run_method_local_group(i, end, pipeline, stores, cfg, &pass_seconds);
+      }
+      auto work = stop_work_measures(profile_top_n, work_queue_stats);
+      auto resources = resources_between(before, sample_resources());
+      // The resources of the group are shared out by the time spent in each
+      // pass. The walks over the methods are shared by the passes, so their
+      // slowest items and work queue stats are recorded on each of them.
+      double group_seconds =
+          std::accumulate(pass_seconds.begin(), pass_seconds.end(), 0.0);
+      size_t purge_after = end;
+      for (size_t p = i; p < end; ++p) {
+        m_current_pass_info = &m_pass_info[p];
+        m_current_pass_info->resources =
+            share_of(resources, group_seconds > 0
+                                    ? pass_seconds[p - i] / group_seconds
+                                    : 1.0 / (end - i));
+        record_work_measures(work);
+        set_metric("method_local_group_passes", end - i);
+        if (malloc_purge_passes.count(m_activated_passes[p]->name())) {
+          purge_after = p;
+        }
+      }
+      // Neither can be taken between the passes of the group, so they are
+      // taken after it, and recorded on the last pass that asked for them.
+      if (purge_after != end) {
+        m_current_pass_info = &m_pass_info[purge_after];
+        purge_malloc(m_activated_passes[purge_after]);
+      }
+      if (memory_census) {
+        Timer census_timer("Memory census after " +
+                           m_activated_passes[end - 1]->name());
+        m_pass_info[end - 1].memory_census =
+            MemoryCensus::take(build_class_scope(it));
+      }
+      m_current_pass_info = nullptr;
+      bool check = run_after_each_pass;
+      for (size_t p = i; p < end; ++p) {
+        m_analyses->invalidate(~m_activated_passes[p]->preserved_analyses());
+        check = check || trigger_passes.count(m_activated_passes[p]->name());
+      }
+      if (check) {
+        scope = build_class_scope(it);
+        size_t checked = run_type_checker(
+            scope, type_checker_options,
+            incremental ? &type_checked_inputs : nullptr);
+        m_current_pass_info = &m_pass_info[end - 1];
+        set_metric("ir_type_checker_methods_checked", checked);
+        m_current_pass_info = nullptr;
+      }
+      i = end - 1;
+      continue;
+    }
     TRACE(PM, 1, "Running %s...\n", pass->name().c_str());
+    if (persistent_cfg && pass->is_cfg_friendly() != m_keeping_cfgs) {
+      set_keep_cfgs(build_class_scope(it), pass->is_cfg_friendly());
+    }
     Timer t(pass->name() + " (run)");
     m_current_pass_info = &m_pass_info[i];
+    // The previous pass may have edited method lists without going through
+    // the hooks that invalidate memoized resolutions.
+    invalidate_method_resolution_cache();
+    m_analyses->build(pass->required_analyses(), stores);
 
+    auto before = sample_resources();
     {
       ScopedCommandProfiling cmd_prof(
           m_profiler_info && m_profiler_info->pass == pass
               ? boost::make_optional(m_profiler_info->command)
               : boost::none);
       jemalloc_util::ScopedProfiling malloc_prof(m_malloc_profile_pass == pass);
+      start_work_measures(profile_top_n, work_queue_stats);
       pass->run_pass(stores, cfg, *this);
+      record_work_measures(stop_work_measures(profile_top_n, work_queue_stats));
     }
+    m_current_pass_info->resources =
+        resources_between(before, sample_resources());
+    if (malloc_purge_passes.count(pass->name())) {
+      purge_malloc(pass);
+    }
+    if (memory_census) {
+      Timer census_timer("Memory census after " + pass->name());
+      m_current_pass_info->memory_census =
+          MemoryCensus::take(build_class_scope(it));
+    }
+    flush_trace();
+    m_analyses->invalidate(~pass->preserved_analyses());
 
     if (run_after_each_pass || trigger_passes.count(pass->name()) > 0) {
       scope = build_class_scope(it);
-      run_type_checker(scope, polymorphic_constants, verify_moves);
+      if (m_keeping_cfgs) {
+        set_keep_cfgs(scope, false);
+      }
+      size_t checked = run_type_checker(
+          scope, type_checker_options,
+          incremental ? &type_checked_inputs : nullptr);
+      set_metric("ir_type_checker_methods_checked", checked);
     }
     m_current_pass_info = nullptr;
   }
 
   // Always run the type checker before generating the optimized dex code.
   scope = build_class_scope(it);
-  run_type_checker(scope, polymorphic_constants, verify_moves);
+  if (m_keeping_cfgs) {
+    set_keep_cfgs(scope, false);
+  }
+  run_type_checker(scope, type_checker_options);
 
   if (!cfg.get_printseeds().empty()) {
     Timer t("Writing outgoing classes to file " + cfg.get_printseeds() +
@@ -8,21 +8,30 @@
 #pragma once
 
 #include "ApkManager.h"
+#include "ConcurrentContainers.h"
+#include "IRTypeChecker.h"
+#include "MemoryCensus.h"
 #include "Pass.h"
 #include "ProguardConfiguration.h"
+#include "WorkItemProfiler.h"
 
 #include <boost/optional.hpp>
 #include <json/json.h>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+class AnalysisManager;
+
 struct RedexOptions {
   bool verify_none_enabled{false};
   bool is_art_build{false};
   bool instrument_pass_enabled{false};
   int32_t min_sdk{0};
+  // Size of the global ThreadPool. Zero means one per hardware thread.
+  uint32_t num_threads{0};
 
   // Encode the struct to entry_data for redex-opt tool.
   void serialize(Json::Value& entry_data) const;
@@ -41,6 +50,28 @@ class PassManager {
               const Json::Value& config = Json::Value(Json::objectValue),
               const RedexOptions& options = RedexOptions{});
 
+  ~PassManager();
+
+  // Process resources consumed by one run of a pass, recorded for every pass.
+  struct PassResources {
+    double wall_seconds{0};
+    // User + system time of all threads; over wall_seconds, it gives the
+    // average parallelism of the pass.
+    double cpu_seconds{0};
+    int64_t rss_delta_kb{0};
+    // High-water mark of the process RSS at the end of the pass.
+    int64_t peak_rss_kb{0};
+    // Only set when running with jemalloc.
+    bool has_allocated_bytes{false};
+    int64_t allocated_bytes_delta{0};
+    // Only set on Linux machines with several NUMA nodes. The pages that were
+    // allocated on the node of the allocating CPU, and on another node. These
+    // are counted by the kernel for the whole machine, not just for Redex.
+    bool has_numa_stats{false};
+    int64_t numa_local_pages_delta{0};
+    int64_t numa_remote_pages_delta{0};
+  };
+
   struct PassInfo {
     const Pass* pass;
     size_t order; // zero-based
@@ -48,6 +79,12 @@ class PassManager {
     size_t total_repeat;
     std::string name;
     std::unordered_map<std::string, int> metrics;
+    PassResources resources;
+    // The slowest work items of the pass's parallel walks, slowest first.
+    // Only collected when `work_item_profile_top_n` is set.
+    std::vector<WorkItemProfiler::Sample> hot_items;
+    // Taken after the pass when `memory_census` is set.
+    boost::optional<MemoryCensus> memory_census;
   };
 
   void run_passes(DexStoresVector&, ConfigFiles&);
@@ -77,6 +114,10 @@ class PassManager {
 
   bool regalloc_has_run() { return m_regalloc_has_run; }
 
+  // The whole-program analyses shared by the passes. After each pass, the
+  // analyses that it does not preserve are invalidated.
+  AnalysisManager& analyses() { return *m_analyses; }
+
  private:
   void activate_pass(const char* name, const Json::Value& cfg);
 
@@ -84,9 +125,43 @@ class PassManager {
 
   void init(const Json::Value& config);
 
-  static void run_type_checker(const Scope& scope,
-                               bool polymorphic_constants,
-                               bool verify_moves);
+  // Turn IRCode::set_keep_cfg on or off for every method in `scope`. Turning
+  // it off linearizes the CFGs that were kept.
+  void set_keep_cfgs(const Scope& scope, bool keep);
+
+  // Runs the method-local passes m_activated_passes[begin, end). With
+  // `pipeline`, the passes that have method runners are run together one
+  // method at a time. See Pass::method_runner(). Adds the seconds spent in
+  // each pass to `pass_seconds`, indexed from `begin`, which tell how to
+  // share out the resources measured around the whole group.
+  void run_method_local_group(size_t begin,
+                              size_t end,
+                              bool pipeline,
+                              DexStoresVector& stores,
+                              ConfigFiles& cfg,
+                              std::vector<double>* pass_seconds);
+
+  // Same as above, with the classes split into `num_processes` shards, each
+  // handled by a forked process. See Pass::is_method_local().
+  void run_method_local_passes(size_t begin,
+                               size_t end,
+                               size_t num_processes,
+                               bool pipeline,
+                               DexStoresVector& stores,
+                               ConfigFiles& cfg,
+                               std::vector<double>* pass_seconds);
+
+  // What the IRTypeChecker looked at when it last checked a method.
+  using TypeCheckerInputs = std::vector<uintptr_t>;
+
+  // With `last_checked`, only the methods whose inputs changed since they were
+  // last checked are checked, and `last_checked` is updated. Returns the
+  // number of methods checked.
+  static size_t run_type_checker(
+      const Scope& scope,
+      const IRTypeChecker::ScopeOptions& options,
+      ConcurrentMap<const DexMethod*, TypeCheckerInputs>* last_checked =
+          nullptr);
 
   ApkManager m_apk_mgr;
   std::vector<Pass*> m_registered_passes;
@@ -100,6 +175,8 @@ class PassManager {
   const RedexOptions& m_redex_options;
   bool m_testing_mode{false};
   bool m_regalloc_has_run{false};
+  bool m_keeping_cfgs{false};
+  std::unique_ptr<AnalysisManager> m_analyses;
 
   struct ProfilerInfo {
     std::string command;
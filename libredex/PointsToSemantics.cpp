@@ -27,6 +27,7 @@
 #include <boost/optional.hpp>
 
 #include "BaseIRAnalyzer.h"
+#include "BinarySerialization.h"
 #include "ControlFlow.h"
 #include "Debug.h"
 #include "DexAccess.h"
@@ -37,6 +38,7 @@
 #include "IROpcode.h"
 #include "PatriciaTreeMapAbstractEnvironment.h"
 #include "PatriciaTreeSetAbstractDomain.h"
+#include "Parallel.h"
 #include "PointsToSemanticsUtils.h"
 #include "RedexContext.h"
 #include "Trace.h"
@@ -44,6 +46,180 @@
 
 using namespace sparta;
 
+namespace pts_impl {
+
+/*
+ * Past the header of BinarySerialization.h, the binary format is a sequence of
+ * unsigned LEB128 integers (signed integers are zigzag-encoded first). Names
+ * are interned on the fly: a name is written as its index in the table of names
+ * seen so far and, the first time it occurs, the index is followed by the
+ * length and the characters of the name. The reader rebuilds the same table as
+ * it goes.
+ */
+class BinaryWriter {
+ public:
+  explicit BinaryWriter(std::ostream& output) : m_output(output) {}
+
+  void write_uint(uint64_t value) {
+    do {
+      uint8_t byte = value & 0x7f;
+      value >>= 7;
+      if (value != 0) {
+        byte |= 0x80;
+      }
+      m_output.put(static_cast<char>(byte));
+    } while (value != 0);
+  }
+
+  void write_int(int64_t value) {
+    write_uint((static_cast<uint64_t>(value) << 1) ^
+               static_cast<uint64_t>(value >> 63));
+  }
+
+  void write_string(const DexString* str) {
+    auto it = m_strings.find(str);
+    if (it != m_strings.end()) {
+      write_uint(it->second);
+      return;
+    }
+    size_t index = m_strings.size();
+    m_strings.emplace(str, index);
+    write_uint(index);
+    write_uint(str->size());
+    m_output.write(str->c_str(), str->size());
+  }
+
+  void write_type(const DexType* dex_type) {
+    write_string(dex_type->get_name());
+  }
+
+  void write_field(const DexFieldRef* dex_field) {
+    write_type(dex_field->get_class());
+    write_string(dex_field->get_name());
+    write_type(dex_field->get_type());
+  }
+
+  void write_method(const DexMethodRef* dex_method) {
+    DexProto* proto = dex_method->get_proto();
+    const auto& args = proto->get_args()->get_type_list();
+    write_type(dex_method->get_class());
+    write_string(dex_method->get_name());
+    write_type(proto->get_rtype());
+    write_uint(args.size());
+    for (DexType* arg : args) {
+      write_type(arg);
+    }
+  }
+
+ private:
+  std::ostream& m_output;
+  std::unordered_map<const DexString*, size_t> m_strings;
+};
+
+class BinaryReader {
+ public:
+  explicit BinaryReader(std::istream& input) : m_input(input) {}
+
+  bool read_uint(uint64_t* value) {
+    *value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+      int c = m_input.get();
+      if (c == std::char_traits<char>::eof()) {
+        return false;
+      }
+      *value |= static_cast<uint64_t>(c & 0x7f) << shift;
+      if ((c & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool read_int(int64_t* value) {
+    uint64_t encoded;
+    if (!read_uint(&encoded)) {
+      return false;
+    }
+    *value = static_cast<int64_t>(encoded >> 1) ^
+             -static_cast<int64_t>(encoded & 1);
+    return true;
+  }
+
+  bool read_string(std::string* str) {
+    uint64_t index;
+    if (!read_uint(&index)) {
+      return false;
+    }
+    if (index < m_strings.size()) {
+      *str = m_strings[index];
+      return true;
+    }
+    uint64_t length;
+    if (index != m_strings.size() || !read_uint(&length)) {
+      return false;
+    }
+    str->resize(length);
+    if (!m_input.read(&(*str)[0], length)) {
+      return false;
+    }
+    m_strings.push_back(*str);
+    return true;
+  }
+
+  DexType* read_type() {
+    std::string name;
+    if (!read_string(&name)) {
+      return nullptr;
+    }
+    return DexType::make_type(name.c_str());
+  }
+
+  DexFieldRef* read_field() {
+    DexType* container = read_type();
+    std::string name;
+    if (container == nullptr || !read_string(&name)) {
+      return nullptr;
+    }
+    DexType* type = read_type();
+    if (type == nullptr) {
+      return nullptr;
+    }
+    return DexField::make_field(container, DexString::make_string(name), type);
+  }
+
+  DexMethodRef* read_method() {
+    DexType* container = read_type();
+    std::string name;
+    if (container == nullptr || !read_string(&name)) {
+      return nullptr;
+    }
+    DexType* rtype = read_type();
+    uint64_t arg_count;
+    if (rtype == nullptr || !read_uint(&arg_count)) {
+      return nullptr;
+    }
+    std::deque<DexType*> types;
+    for (uint64_t i = 0; i < arg_count; ++i) {
+      DexType* arg = read_type();
+      if (arg == nullptr) {
+        return nullptr;
+      }
+      types.push_back(arg);
+    }
+    return DexMethod::make_method(
+        container,
+        DexString::make_string(name),
+        DexProto::make_proto(rtype,
+                             DexTypeList::make_type_list(std::move(types))));
+  }
+
+ private:
+  std::istream& m_input;
+  std::vector<std::string> m_strings;
+};
+
+} // namespace pts_impl
+
 s_expr PointsToVariable::to_s_expr() const {
   return s_expr({s_expr("V"), s_expr(m_id)});
 }
@@ -57,6 +233,20 @@ boost::optional<PointsToVariable> PointsToVariable::from_s_expr(
   return {PointsToVariable(id)};
 }
 
+void PointsToVariable::write_binary(pts_impl::BinaryWriter& w) const {
+  w.write_int(m_id);
+}
+
+boost::optional<PointsToVariable> PointsToVariable::read_binary(
+    pts_impl::BinaryReader& r) {
+  int64_t id;
+  if (!r.read_int(&id) || id < std::numeric_limits<int32_t>::min() ||
+      id > std::numeric_limits<int32_t>::max()) {
+    return {};
+  }
+  return {PointsToVariable(static_cast<int32_t>(id))};
+}
+
 size_t hash_value(const PointsToVariable& v) {
   boost::hash<int32_t> hasher;
   return hasher(v.m_id);
@@ -325,6 +515,122 @@ boost::optional<PointsToOperation> PointsToOperation::from_s_expr(
   }
 }
 
+void PointsToOperation::write_binary(pts_impl::BinaryWriter& w) const {
+  w.write_uint(kind);
+  switch (kind) {
+  case PTS_CONST_STRING: {
+    w.write_string(dex_string);
+    break;
+  }
+  case PTS_CONST_CLASS:
+  case PTS_NEW_OBJECT:
+  case PTS_CHECK_CAST: {
+    w.write_type(dex_type);
+    break;
+  }
+  case PTS_GET_EXCEPTION:
+  case PTS_GET_CLASS:
+  case PTS_RETURN:
+  case PTS_DISJUNCTION: {
+    break;
+  }
+  case PTS_LOAD_PARAM: {
+    w.write_uint(parameter);
+    break;
+  }
+  case PTS_IGET:
+  case PTS_SGET:
+  case PTS_IPUT:
+  case PTS_SPUT: {
+    w.write_field(dex_field);
+    break;
+  }
+  case PTS_IGET_SPECIAL:
+  case PTS_IPUT_SPECIAL: {
+    w.write_uint(special_edge);
+    break;
+  }
+  case PTS_INVOKE_VIRTUAL:
+  case PTS_INVOKE_SUPER:
+  case PTS_INVOKE_DIRECT:
+  case PTS_INVOKE_INTERFACE:
+  case PTS_INVOKE_STATIC: {
+    w.write_method(dex_method);
+    break;
+  }
+  }
+}
+
+boost::optional<PointsToOperation> PointsToOperation::read_binary(
+    pts_impl::BinaryReader& r) {
+  uint64_t kind_value;
+  if (!r.read_uint(&kind_value) || kind_value > PTS_DISJUNCTION) {
+    return {};
+  }
+  auto op_kind = static_cast<PointsToOperationKind>(kind_value);
+  switch (op_kind) {
+  case PTS_CONST_STRING: {
+    std::string dex_string_str;
+    if (!r.read_string(&dex_string_str)) {
+      return {};
+    }
+    return {PointsToOperation(op_kind, DexString::make_string(dex_string_str))};
+  }
+  case PTS_CONST_CLASS:
+  case PTS_NEW_OBJECT:
+  case PTS_CHECK_CAST: {
+    DexType* dex_type = r.read_type();
+    if (dex_type == nullptr) {
+      return {};
+    }
+    return {PointsToOperation(op_kind, dex_type)};
+  }
+  case PTS_GET_EXCEPTION:
+  case PTS_GET_CLASS:
+  case PTS_RETURN:
+  case PTS_DISJUNCTION: {
+    return {PointsToOperation(op_kind)};
+  }
+  case PTS_LOAD_PARAM: {
+    uint64_t parameter;
+    if (!r.read_uint(&parameter)) {
+      return {};
+    }
+    return {PointsToOperation(op_kind, static_cast<size_t>(parameter))};
+  }
+  case PTS_IGET:
+  case PTS_SGET:
+  case PTS_IPUT:
+  case PTS_SPUT: {
+    DexFieldRef* dex_field = r.read_field();
+    if (dex_field == nullptr) {
+      return {};
+    }
+    return {PointsToOperation(op_kind, dex_field)};
+  }
+  case PTS_IGET_SPECIAL:
+  case PTS_IPUT_SPECIAL: {
+    uint64_t edge;
+    if (!r.read_uint(&edge) || edge != PTS_ARRAY_ELEMENT) {
+      return {};
+    }
+    return {PointsToOperation(op_kind, static_cast<SpecialPointsToEdge>(edge))};
+  }
+  case PTS_INVOKE_VIRTUAL:
+  case PTS_INVOKE_SUPER:
+  case PTS_INVOKE_DIRECT:
+  case PTS_INVOKE_INTERFACE:
+  case PTS_INVOKE_STATIC: {
+    DexMethodRef* dex_method = r.read_method();
+    if (dex_method == nullptr) {
+      return {};
+    }
+    return {PointsToOperation(op_kind, dex_method)};
+  }
+  }
+  not_reached();
+}
+
 namespace pts_impl {
 
 // A wrapper for a set of variables. We use this structure for the generation of
@@ -516,6 +822,37 @@ boost::optional<PointsToAction> PointsToAction::from_s_expr(const s_expr& e) {
   return {PointsToAction(*operation_opt, arguments)};
 }
 
+void PointsToAction::write_binary(pts_impl::BinaryWriter& w) const {
+  m_operation.write_binary(w);
+  w.write_uint(m_arguments.size());
+  for (const auto& arg : m_arguments) {
+    w.write_int(arg.first);
+    arg.second.write_binary(w);
+  }
+}
+
+boost::optional<PointsToAction> PointsToAction::read_binary(
+    pts_impl::BinaryReader& r) {
+  auto operation_opt = PointsToOperation::read_binary(r);
+  uint64_t arg_count;
+  if (!operation_opt || !r.read_uint(&arg_count)) {
+    return {};
+  }
+  std::vector<std::pair<int32_t, PointsToVariable>> arguments;
+  for (uint64_t i = 0; i < arg_count; ++i) {
+    int64_t arg;
+    if (!r.read_int(&arg)) {
+      return {};
+    }
+    auto var_opt = PointsToVariable::read_binary(r);
+    if (!var_opt) {
+      return {};
+    }
+    arguments.push_back({static_cast<int32_t>(arg), *var_opt});
+  }
+  return {PointsToAction(*operation_opt, arguments)};
+}
+
 namespace pts_impl {
 
 std::string special_edge_to_string(SpecialPointsToEdge e) {
@@ -1516,6 +1853,40 @@ boost::optional<PointsToMethodSemantics> PointsToMethodSemantics::from_s_expr(
   return boost::optional<PointsToMethodSemantics>(semantics);
 }
 
+void PointsToMethodSemantics::write_binary(pts_impl::BinaryWriter& w) const {
+  w.write_method(m_dex_method);
+  w.write_uint(m_kind);
+  w.write_uint(m_variable_counter);
+  w.write_uint(m_points_to_actions.size());
+  for (const auto& a : m_points_to_actions) {
+    a.write_binary(w);
+  }
+}
+
+boost::optional<PointsToMethodSemantics> PointsToMethodSemantics::read_binary(
+    pts_impl::BinaryReader& r) {
+  DexMethodRef* dex_method = r.read_method();
+  uint64_t kind;
+  uint64_t var_counter;
+  uint64_t action_count;
+  if (dex_method == nullptr || !r.read_uint(&kind) || kind > PTS_STUB ||
+      !r.read_uint(&var_counter) || !r.read_uint(&action_count)) {
+    return {};
+  }
+  PointsToMethodSemantics semantics(dex_method,
+                                    static_cast<MethodKind>(kind),
+                                    var_counter,
+                                    action_count);
+  for (uint64_t i = 0; i < action_count; ++i) {
+    auto action_opt = PointsToAction::read_binary(r);
+    if (!action_opt) {
+      return {};
+    }
+    semantics.add(*action_opt);
+  }
+  return boost::optional<PointsToMethodSemantics>(std::move(semantics));
+}
+
 std::ostream& operator<<(std::ostream& o, const PointsToMethodSemantics& s) {
   o << s.m_dex_method->get_class()->get_name()->str() << "#"
     << s.m_dex_method->get_name()->str() << ": "
@@ -1545,30 +1916,61 @@ std::ostream& operator<<(std::ostream& o, const PointsToMethodSemantics& s) {
 
 PointsToSemantics::PointsToSemantics(const Scope& scope, bool generate_stubs)
     : m_generate_stubs(generate_stubs), m_type_system(scope) {
-  // We size the hash table so as to fit all the methods in scope.
-  size_t method_count = 0;
+  std::vector<DexMethod*> methods;
   for (DexClass* dex_class : scope) {
-    method_count +=
-        dex_class->get_dmethods().size() + dex_class->get_vmethods().size();
+    const auto& dmethods = dex_class->get_dmethods();
+    const auto& vmethods = dex_class->get_vmethods();
+    methods.insert(methods.end(), dmethods.begin(), dmethods.end());
+    methods.insert(methods.end(), vmethods.begin(), vmethods.end());
   }
-  m_method_semantics.reserve(method_count);
 
-  // We initialize all entries in the hash table, which can then be concurrently
-  // accessed by the workers using the thread-safe find() operation of
-  // std::unordered_map.
-  for (DexClass* dex_class : scope) {
-    for (DexMethod* dmethod : dex_class->get_dmethods()) {
-      initialize_entry(dmethod);
-    }
-    for (DexMethod* vmethod : dex_class->get_vmethods()) {
-      initialize_entry(vmethod);
-    }
+  // We generate a system of points-to actions for each Dex method in parallel.
+  // Every thread appends the semantics it produces to its own vector, so that
+  // the workers don't share any state. The vectors are then concatenated and
+  // moved into the hash table sequentially.
+  using SemanticsVector = std::vector<PointsToMethodSemantics>;
+  SemanticsVector semantics = parallel_reduce(
+      methods.begin(),
+      methods.end(),
+      SemanticsVector(),
+      [this](DexMethod* dex_method) {
+        SemanticsVector result;
+        result.push_back(generate_points_to_actions(dex_method));
+        return result;
+      },
+      [](SemanticsVector v1, SemanticsVector v2) {
+        if (v1.size() < v2.size()) {
+          std::swap(v1, v2);
+        }
+        std::move(v2.begin(), v2.end(), std::back_inserter(v1));
+        return v1;
+      });
+
+  m_method_semantics.reserve(semantics.size());
+  for (auto& s : semantics) {
+    DexMethodRef* dex_method = s.get_method();
+    m_method_semantics.emplace(dex_method, std::move(s));
   }
+}
 
-  // We generate a system of points-to actions for each Dex method in parallel.
-  walk::parallel::methods(scope, [this](DexMethod* dex_method) {
-    generate_points_to_actions(dex_method);
-  });
+PointsToSemantics::PointsToSemantics(const Scope& scope,
+                                     std::istream& binary_input)
+    : m_generate_stubs(false), m_type_system(scope) {
+  uint32_t version;
+  uint64_t method_count;
+  pts_impl::BinaryReader reader(binary_input);
+  always_assert_log(binary_serialization::read_header(binary_input, &version) &&
+                        version == 1 && reader.read_uint(&method_count),
+                    "Invalid header in binary points-to semantics\n");
+  m_method_semantics.reserve(method_count);
+  for (uint64_t i = 0; i < method_count; ++i) {
+    auto semantics_opt = PointsToMethodSemantics::read_binary(reader);
+    always_assert_log(semantics_opt,
+                      "Couldn't read the semantics of method %lu\n",
+                      static_cast<unsigned long>(i));
+    DexMethodRef* dex_method = semantics_opt->get_method();
+    m_method_semantics.emplace(dex_method, std::move(*semantics_opt));
+  }
 }
 
 void PointsToSemantics::load_stubs(const std::string& file_name) {
@@ -1595,6 +1997,15 @@ void PointsToSemantics::load_stubs(const std::string& file_name) {
   }
 }
 
+void PointsToSemantics::write_binary(std::ostream& output) const {
+  binary_serialization::write_header(output, /* version */ 1);
+  pts_impl::BinaryWriter writer(output);
+  writer.write_uint(m_method_semantics.size());
+  for (const auto& entry : m_method_semantics) {
+    entry.second.write_binary(writer);
+  }
+}
+
 boost::optional<PointsToMethodSemantics*>
 PointsToSemantics::get_method_semantics(DexMethodRef* dex_method) {
   auto entry = m_method_semantics.find(dex_method);
@@ -1608,47 +2019,38 @@ MethodKind PointsToSemantics::default_method_kind() const {
   return m_generate_stubs ? PTS_STUB : PTS_APK;
 }
 
-void PointsToSemantics::initialize_entry(DexMethod* dex_method) {
+MethodKind PointsToSemantics::method_kind(DexMethod* dex_method) const {
   DexAccessFlags access_flags = dex_method->get_access();
-  MethodKind kind;
-  if (dex_method->get_code() == nullptr) {
-    if ((access_flags & DexAccessFlags::ACC_ABSTRACT)) {
-      kind = PTS_ABSTRACT;
-    } else if ((access_flags & DexAccessFlags::ACC_NATIVE)) {
-      kind = PTS_NATIVE;
-    } else {
-      // The definition of a method that is neither abstract nor native should
-      // always have an associated IRCode component.
-      always_assert_log(false,
-                        "Method %s has no associated code component",
-                        SHOW(dex_method->get_name()));
-    }
-  } else {
-    kind = default_method_kind();
-  }
-  m_method_semantics.emplace(std::piecewise_construct,
-                             std::forward_as_tuple(dex_method),
-                             std::forward_as_tuple(/* dex_method */ dex_method,
-                                                   /* kind */ kind,
-                                                   /* start_var_id */ 0,
-                                                   /* size_hint */ 8));
+  if (dex_method->get_code() != nullptr) {
+    return default_method_kind();
+  }
+  if ((access_flags & DexAccessFlags::ACC_ABSTRACT)) {
+    return PTS_ABSTRACT;
+  }
+  if ((access_flags & DexAccessFlags::ACC_NATIVE)) {
+    return PTS_NATIVE;
+  }
+  // The definition of a method that is neither abstract nor native should
+  // always have an associated IRCode component.
+  always_assert_log(false,
+                    "Method %s has no associated code component",
+                    SHOW(dex_method->get_name()));
+  not_reached();
 }
 
-void PointsToSemantics::generate_points_to_actions(DexMethod* dex_method) {
-  // According to section [container.requirements.dataraces] of the C++ standard
-  // definition document, the find() method of std::unordered_map is
-  // thread-safe. Since this function operates on a single Dex method and the
-  // hash table m_method_semantics is indexed by Dex methods, the following code
-  // is not subject to data races.
-  auto entry = m_method_semantics.find(dex_method);
-  // All hash table entries have been initialized in the constructor.
-  always_assert(entry != m_method_semantics.end());
-  PointsToMethodSemantics* semantics = &entry->second;
-  if (semantics->kind() == default_method_kind()) {
+PointsToMethodSemantics PointsToSemantics::generate_points_to_actions(
+    DexMethod* dex_method) {
+  MethodKind kind = method_kind(dex_method);
+  PointsToMethodSemantics semantics(/* dex_method */ dex_method,
+                                    /* kind */ kind,
+                                    /* start_var_id */ 0,
+                                    /* size_hint */ 8);
+  if (kind == default_method_kind()) {
     pts_impl::PointsToActionGenerator generator(
-        dex_method, semantics, m_type_system, m_utils);
+        dex_method, &semantics, m_type_system, m_utils);
     generator.run();
   }
+  return semantics;
 }
 
 std::ostream& operator<<(std::ostream& o, const PointsToSemantics& s) {
@@ -10,12 +10,14 @@
 #include <bitset>
 #include <cstdint>
 #include <initializer_list>
+#include <istream>
 #include <ostream>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <boost/container/flat_map.hpp>
+#include <boost/container/small_vector.hpp>
 #include <boost/optional.hpp>
 
 #include "ControlFlow.h"
@@ -92,9 +94,16 @@
  * code.
  */
 
-// Forward declaration.
+// Forward declarations.
 class PointsToSemantics;
 
+namespace pts_impl {
+
+class BinaryReader;
+class BinaryWriter;
+
+} // namespace pts_impl
+
 /*
  * A points-to variable denotes a set of abstract object instances. It is
  * uniquely identified by a positive number.
@@ -120,6 +129,11 @@ class PointsToVariable final {
 
   static boost::optional<PointsToVariable> from_s_expr(const sparta::s_expr& e);
 
+  void write_binary(pts_impl::BinaryWriter& w) const;
+
+  static boost::optional<PointsToVariable> read_binary(
+      pts_impl::BinaryReader& r);
+
  private:
   static constexpr int32_t null_var_id() { return -1; }
 
@@ -296,6 +310,11 @@ struct PointsToOperation {
 
   static boost::optional<PointsToOperation> from_s_expr(
       const sparta::s_expr& e);
+
+  void write_binary(pts_impl::BinaryWriter& w) const;
+
+  static boost::optional<PointsToOperation> read_binary(
+      pts_impl::BinaryReader& r);
 };
 
 /*
@@ -395,6 +414,10 @@ class PointsToAction final {
 
   static boost::optional<PointsToAction> from_s_expr(const sparta::s_expr& e);
 
+  void write_binary(pts_impl::BinaryWriter& w) const;
+
+  static boost::optional<PointsToAction> read_binary(pts_impl::BinaryReader& r);
+
  private:
   static constexpr int32_t lhs_key() { return -1; }
   static constexpr int32_t rhs_key() { return -2; }
@@ -421,8 +444,16 @@ class PointsToAction final {
   // method call are denoted by positive indexes that correspond to their
   // position in the original invocation. Arguments specific to a points-to
   // operation (like the left-hand side of an assignment operation) have a
-  // negative index.
-  boost::container::flat_map<int32_t, PointsToVariable> m_arguments;
+  // negative index. Most actions have at most three arguments, which are then
+  // stored inline in the action itself. Since the actions of a method are laid
+  // out contiguously in a vector, this spares us one heap allocation per
+  // action during the generation.
+  boost::container::flat_map<
+      int32_t,
+      PointsToVariable,
+      std::less<int32_t>,
+      boost::container::small_vector<std::pair<int32_t, PointsToVariable>, 3>>
+      m_arguments;
 };
 
 std::ostream& operator<<(std::ostream& o, const PointsToAction& a);
@@ -479,6 +510,11 @@ class PointsToMethodSemantics {
   static boost::optional<PointsToMethodSemantics> from_s_expr(
       const sparta::s_expr& e);
 
+  void write_binary(pts_impl::BinaryWriter& w) const;
+
+  static boost::optional<PointsToMethodSemantics> read_binary(
+      pts_impl::BinaryReader& r);
+
  private:
   DexMethodRef* m_dex_method;
   MethodKind m_kind;
@@ -515,12 +551,21 @@ class PointsToSemantics final {
 
   /*
    * The constructor generates points-to actions for all methods in the given
-   * scope. The generation is performed in parallel using a pool of threads. If
-   * the flag `generate_stubs` is set to true, all methods in the scope are
-   * interpreted as stubs.
+   * scope. The generation is performed in parallel using a pool of threads.
+   * Each thread accumulates the semantics it produces in its own vector and
+   * the vectors are merged once all methods have been processed. If the flag
+   * `generate_stubs` is set to true, all methods in the scope are interpreted
+   * as stubs.
    */
   PointsToSemantics(const Scope& scope, bool generate_stubs = false);
 
+  /*
+   * Reads back the points-to semantics previously saved with write_binary(),
+   * instead of generating them from the code. The scope is only used to build
+   * the type system.
+   */
+  PointsToSemantics(const Scope& scope, std::istream& binary_input);
+
   /*
    * The stubs are stored in the specified text file as S-expressions. In case
    * of a collision between a method in the APK and a stub, the stub is
@@ -528,6 +573,14 @@ class PointsToSemantics final {
    */
   void load_stubs(const std::string& file_name);
 
+  /*
+   * Saves the points-to semantics of all methods in a compact binary format,
+   * so that the resolution can be run separately from the generation. Dex
+   * entities are referred to by name and each distinct name is only written
+   * once.
+   */
+  void write_binary(std::ostream& output) const;
+
   iterator begin() { return m_method_semantics.begin(); }
 
   iterator end() { return m_method_semantics.end(); }
@@ -540,9 +593,9 @@ class PointsToSemantics final {
  private:
   MethodKind default_method_kind() const;
 
-  void initialize_entry(DexMethod* dex_method);
+  MethodKind method_kind(DexMethod* dex_method) const;
 
-  void generate_points_to_actions(DexMethod* dex_method);
+  PointsToMethodSemantics generate_points_to_actions(DexMethod* dex_method);
 
   bool m_generate_stubs;
   TypeSystem m_type_system;
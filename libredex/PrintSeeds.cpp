@@ -65,47 +65,49 @@ void show_class(std::ostream& output,
 }
 
 // Print out the seeds computed in classes by Redex to the specified ostream.
-// The ProGuard map is used to help deobfuscate type descriptors.
+// The ProGuard map is used to help deobfuscate type descriptors. Classes are
+// formatted in parallel but written in the order of `classes`.
 void redex::print_seeds(std::ostream& output,
                         const ProguardMap& pg_map,
                         const Scope& classes,
                         const bool allowshrinking_filter,
                         const bool allowobfuscation_filter) {
-  for (const auto& cls : classes) {
-    auto deob = cls->get_deobfuscated_name();
+  print_classes_in_parallel(output, classes, [&](std::ostream& buffer,
+                                                  const DexClass* cls) {
+    const auto& deob = cls->get_deobfuscated_name();
     if (deob.empty()) {
       std::cerr << "WARNING: this class has no deobu name: "
                 << cls->get_name()->c_str() << std::endl;
-      deob = cls->get_name()->c_str();
     }
-    std::string name = redex::dexdump_name_to_dot_name(deob);
+    std::string name = redex::dexdump_name_to_dot_name(
+        deob.empty() ? cls->get_name()->str() : deob);
     if (has_keep(cls)) {
       show_class(
-          output, cls, name, allowshrinking_filter, allowobfuscation_filter);
+          buffer, cls, name, allowshrinking_filter, allowobfuscation_filter);
     }
-    print_field_seeds(output,
+    print_field_seeds(buffer,
                       pg_map,
                       name,
                       cls->get_ifields(),
                       allowshrinking_filter,
                       allowobfuscation_filter);
-    print_field_seeds(output,
+    print_field_seeds(buffer,
                       pg_map,
                       name,
                       cls->get_sfields(),
                       allowshrinking_filter,
                       allowobfuscation_filter);
-    print_method_seeds(output,
+    print_method_seeds(buffer,
                        pg_map,
                        name,
                        cls->get_dmethods(),
                        allowshrinking_filter,
                        allowobfuscation_filter);
-    print_method_seeds(output,
+    print_method_seeds(buffer,
                        pg_map,
                        name,
                        cls->get_vmethods(),
                        allowshrinking_filter,
                        allowobfuscation_filter);
-  }
+  });
 }
@@ -7,7 +7,14 @@
 
 #include "ProguardMap.h"
 
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstring>
+#include <functional>
+#include <iterator>
+
 #include "DexUtil.h"
+#include "Parallel.h"
 #include "Timer.h"
 #include "WorkQueue.h"
 
@@ -141,83 +148,56 @@ bool is_maybe_proguard_generated_member(const std::string& s) {
   }
   return false;
 }
-} // namespace
 
-ProguardMap::ProguardMap(const std::string& filename) {
-  if (!filename.empty()) {
-    Timer t("Parsing proguard map");
-    std::ifstream fp(filename);
-    always_assert_log(fp, "Can't open proguard map: %s\n", filename.c_str());
-    parse_proguard_map(fp);
-  }
-}
-
-std::string ProguardMap::translate_class(const std::string& cls) const {
-  return find_or_same(cls, m_classMap);
-}
-
-std::string ProguardMap::translate_field(const std::string& field) const {
-  return find_or_same(field, m_fieldMap);
-}
-
-std::string ProguardMap::translate_method(const std::string& method) const {
-  return find_or_same(method, m_methodMap);
-}
-
-std::string ProguardMap::deobfuscate_class(const std::string& cls) const {
-  return find_or_same(cls, m_obfClassMap);
-}
-
-std::string ProguardMap::deobfuscate_field(const std::string& field) const {
-  return find_or_same(field, m_obfFieldMap);
-}
-
-std::string ProguardMap::deobfuscate_method(const std::string& method) const {
-  return find_or_same(method, m_obfMethodMap);
-}
-
-void ProguardMap::parse_proguard_map(std::istream& fp) {
-  std::string line;
-  while (std::getline(fp, line)) {
-    parse_class(line);
-  }
-  fp.clear();
-  fp.seekg(0);
-  assert_log(!fp.fail(), "Can't use ProguardMap with non-seekable stream");
-  while (std::getline(fp, line)) {
-    if (parse_class(line)) {
-      continue;
-    }
-    if (parse_field(line)) {
-      continue;
-    }
-    if (parse_method(line)) {
-      continue;
-    }
-    if (comment(line)) {
-      continue;
+/**
+ * Call `f` on every line of [begin, end), without its newline.
+ */
+template <typename F>
+void for_each_line(const char* begin, const char* end, F f) {
+  while (begin < end) {
+    auto eol = static_cast<const char*>(memchr(begin, '\n', end - begin));
+    if (eol == nullptr) {
+      eol = end;
     }
-    always_assert_log(false,
-                      "Bogus line encountered in proguard map: %s\n",
-                      line.c_str());
+    f(begin, eol);
+    begin = eol + 1;
   }
 }
 
-bool ProguardMap::parse_class(const std::string& line) {
+/**
+ * The member lines that follow a class line of the map, and what they parse
+ * to.
+ */
+struct ClassSection {
+  const char* begin;
+  const char* end;
+  std::string cls;
+  std::string new_cls;
+  std::vector<std::pair<std::string, std::string>> fields;
+  std::vector<std::pair<std::string, std::string>> methods;
+  // Pairs of a coalesced interface and the field it was found in.
+  std::vector<std::pair<std::string, std::string>> coalesced_interfaces;
+  bool bogus{false};
+  std::string bogus_line;
+};
+
+bool parse_class(const std::string& line,
+                 std::string* cls,
+                 std::string* new_cls) {
   std::string classname;
   std::string newname;
   auto p = line.c_str();
   if (!id(p, classname)) return false;
   if (!literal(p, " -> ")) return false;
   if (!id(p, newname)) return false;
-  m_currClass = convert_type(classname);
-  m_currNewClass = convert_type(newname);
-  m_classMap[m_currClass] = m_currNewClass;
-  m_obfClassMap[m_currNewClass] = m_currClass;
+  *cls = convert_type(classname);
+  *new_cls = convert_type(newname);
   return true;
 }
 
-bool ProguardMap::parse_field(const std::string& line) {
+bool parse_field(const std::string& line,
+                 const ProguardMap& pm,
+                 ClassSection* section) {
   std::string type;
   std::string fieldname;
   std::string newname;
@@ -231,23 +211,20 @@ bool ProguardMap::parse_field(const std::string& line) {
   if (!id(p, newname)) return false;
 
   auto ctype = convert_type(type);
-  auto xtype = translate_type(ctype, *this);
-  auto pgnew = convert_field(m_currNewClass, xtype, newname);
-  auto pgold = convert_field(m_currClass, ctype, fieldname);
+  auto xtype = translate_type(ctype, pm);
+  auto pgnew = convert_field(section->new_cls, xtype, newname);
+  auto pgold = convert_field(section->cls, ctype, fieldname);
   // Record interfaces that are coalesced by Proguard.
   if (ctype[0] == 'L' && is_maybe_proguard_generated_member(fieldname)) {
-    fprintf(stderr,
-            "Type '%s' is touched by Proguard in '%s'\n",
-            ctype.c_str(),
-            pgold.c_str());
-    m_pg_coalesced_interfaces.insert(ctype);
+    section->coalesced_interfaces.emplace_back(ctype, pgold);
   }
-  m_fieldMap[pgold] = pgnew;
-  m_obfFieldMap[pgnew] = pgold;
+  section->fields.emplace_back(std::move(pgold), std::move(pgnew));
   return true;
 }
 
-bool ProguardMap::parse_method(const std::string& line) {
+bool parse_method(const std::string& line,
+                  const ProguardMap& pm,
+                  ClassSection* section) {
   std::string type;
   std::string methodname;
   std::string old_args;
@@ -272,7 +249,7 @@ bool ProguardMap::parse_method(const std::string& line) {
     if (literal(p, ')')) break;
     id(p, arg);
     auto old_arg = convert_type(arg);
-    auto new_arg = translate_type(old_arg, *this);
+    auto new_arg = translate_type(old_arg, pm);
     old_args += old_arg;
     new_args += new_arg;
     literal(p, ',');
@@ -287,60 +264,197 @@ bool ProguardMap::parse_method(const std::string& line) {
   if (!id(p, newname)) return false;
 
   auto old_rtype = convert_type(type);
-  auto new_rtype = translate_type(old_rtype, *this);
-  auto pgold = convert_method(m_currClass, old_rtype, methodname, old_args);
-  auto pgnew = convert_method(m_currNewClass, new_rtype, newname, new_args);
-  m_methodMap[pgold] = pgnew;
-  m_obfMethodMap[pgnew] = pgold;
+  auto new_rtype = translate_type(old_rtype, pm);
+  auto pgold = convert_method(section->cls, old_rtype, methodname, old_args);
+  auto pgnew = convert_method(section->new_cls, new_rtype, newname, new_args);
+  section->methods.emplace_back(std::move(pgold), std::move(pgnew));
   return true;
 }
 
-void apply_deobfuscated_names(const std::vector<DexClasses>& dexen,
-                              const ProguardMap& pm) {
-  std::function<void(DexClass*)> worker_empty_pg_map = [&](DexClass* cls) {
-    cls->set_deobfuscated_name(show(cls));
-    for (const auto& m : cls->get_dmethods()) {
-      m->set_deobfuscated_name(show(m));
+using Mappings = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * Insert the mappings of all the sections in both directions, the later ones
+ * taking precedence.
+ */
+void insert_mappings(const std::vector<ClassSection>& sections,
+                     Mappings ClassSection::*mappings,
+                     std::unordered_map<std::string, std::string>* map,
+                     std::unordered_map<std::string, std::string>* obf_map) {
+  size_t size = 0;
+  for (const auto& section : sections) {
+    size += (section.*mappings).size();
+  }
+  map->reserve(size);
+  obf_map->reserve(size);
+  for (const auto& section : sections) {
+    for (const auto& mapping : section.*mappings) {
+      (*map)[mapping.first] = mapping.second;
+      (*obf_map)[mapping.second] = mapping.first;
     }
-    for (const auto& m : cls->get_vmethods()) {
-      m->set_deobfuscated_name(show(m));
+  }
+}
+} // namespace
+
+ProguardMap::ProguardMap(const std::string& filename) {
+  if (!filename.empty()) {
+    Timer t("Parsing proguard map");
+    always_assert_log(boost::filesystem::exists(filename),
+                      "Can't open proguard map: %s\n",
+                      filename.c_str());
+    // Empty files can't be mapped.
+    if (boost::filesystem::is_empty(filename)) {
+      return;
     }
-    for (const auto& f : cls->get_ifields()) {
-      f->set_deobfuscated_name(show(f));
+    boost::iostreams::mapped_file_source file(filename);
+    always_assert_log(file.is_open(), "Can't open proguard map: %s\n",
+                      filename.c_str());
+    parse_proguard_map(file.data(), file.data() + file.size());
+  }
+}
+
+ProguardMap::ProguardMap(std::istream& is) {
+  std::string contents{std::istreambuf_iterator<char>(is),
+                       std::istreambuf_iterator<char>()};
+  parse_proguard_map(contents.data(), contents.data() + contents.size());
+}
+
+std::string ProguardMap::translate_class(const std::string& cls) const {
+  return find_or_same(cls, m_classMap);
+}
+
+std::string ProguardMap::translate_field(const std::string& field) const {
+  return find_or_same(field, m_fieldMap);
+}
+
+std::string ProguardMap::translate_method(const std::string& method) const {
+  return find_or_same(method, m_methodMap);
+}
+
+std::string ProguardMap::deobfuscate_class(const std::string& cls) const {
+  return find_or_same(cls, m_obfClassMap);
+}
+
+std::string ProguardMap::deobfuscate_field(const std::string& field) const {
+  return find_or_same(field, m_obfFieldMap);
+}
+
+std::string ProguardMap::deobfuscate_method(const std::string& method) const {
+  return find_or_same(method, m_obfMethodMap);
+}
+
+/**
+ * The map is parsed in two passes, since members refer to classes that may
+ * only be mapped further down. The first one maps the classes and splits the
+ * map into class sections, the second one parses the sections in parallel.
+ */
+void ProguardMap::parse_proguard_map(const char* begin, const char* end) {
+  // The lines before the first class line, if any.
+  std::vector<ClassSection> sections(1);
+  sections[0].begin = begin;
+  std::string line;
+  std::string cls;
+  std::string new_cls;
+  for_each_line(begin, end, [&](const char* line_begin, const char* line_end) {
+    line.assign(line_begin, line_end);
+    if (!parse_class(line, &cls, &new_cls)) {
+      return;
     }
-    for (const auto& f : cls->get_sfields()) {
-      f->set_deobfuscated_name(show(f));
+    m_classMap[cls] = new_cls;
+    m_obfClassMap[new_cls] = cls;
+    sections.back().end = line_begin;
+    sections.emplace_back();
+    sections.back().begin = line_end == end ? end : line_end + 1;
+    sections.back().cls = cls;
+    sections.back().new_cls = new_cls;
+  });
+  sections.back().end = end;
+  // Like the members of the last class.
+  sections[0].cls = cls;
+  sections[0].new_cls = new_cls;
+
+  parallel_for(sections.begin(), sections.end(), [&](ClassSection& section) {
+    std::string line;
+    for_each_line(section.begin, section.end,
+                  [&](const char* line_begin, const char* line_end) {
+                    if (section.bogus) {
+                      return;
+                    }
+                    line.assign(line_begin, line_end);
+                    if (parse_field(line, *this, &section) ||
+                        parse_method(line, *this, &section) || comment(line)) {
+                      return;
+                    }
+                    section.bogus = true;
+                    section.bogus_line = line;
+                  });
+  });
+
+  for (const auto& section : sections) {
+    for (const auto& interface_and_field : section.coalesced_interfaces) {
+      fprintf(stderr,
+              "Type '%s' is touched by Proguard in '%s'\n",
+              interface_and_field.first.c_str(),
+              interface_and_field.second.c_str());
+      m_pg_coalesced_interfaces.insert(interface_and_field.first);
     }
-  };
+    always_assert_log(!section.bogus,
+                      "Bogus line encountered in proguard map: %s\n",
+                      section.bogus_line.c_str());
+  }
+
+  std::vector<std::function<void()>> inserts{
+      [&] {
+        insert_mappings(sections, &ClassSection::fields, &m_fieldMap,
+                        &m_obfFieldMap);
+      },
+      [&] {
+        insert_mappings(sections, &ClassSection::methods, &m_methodMap,
+                        &m_obfMethodMap);
+      }};
+  parallel_for(inserts.begin(), inserts.end(),
+               [](const std::function<void()>& insert) { insert(); }, 1);
+}
 
-  std::function<void(DexClass*)> worker_pg_map = [&](DexClass* cls) {
+void apply_deobfuscated_names(const std::vector<DexClasses>& dexen,
+                              const ProguardMap& pm) {
+  auto wq = workqueue_foreach<DexClass*>([&](DexClass* cls) {
+    // Reused by all the lookups of a thread.
+    thread_local std::string name;
+    name.clear();
+    show_to(name, cls);
+    cls->set_deobfuscated_name(pm.empty() ? name : pm.deobfuscate_class(name));
     TRACE(PGR, 4, "deob cls %s %s\n", SHOW(cls),
-          pm.deobfuscate_class(show(cls)).c_str());
-    cls->set_deobfuscated_name(pm.deobfuscate_class(show(cls)));
+          cls->get_deobfuscated_name().c_str());
     for (const auto& m : cls->get_dmethods()) {
+      name.clear();
+      show_to(name, m);
+      m->set_deobfuscated_name(pm.empty() ? name : pm.deobfuscate_method(name));
       TRACE(PGR, 4, "deob dmeth %s %s\n", SHOW(m),
-            pm.deobfuscate_method(show(m)).c_str());
-      m->set_deobfuscated_name(pm.deobfuscate_method(show(m)));
+            m->get_deobfuscated_name().c_str());
     }
     for (const auto& m : cls->get_vmethods()) {
+      name.clear();
+      show_to(name, m);
+      m->set_deobfuscated_name(pm.empty() ? name : pm.deobfuscate_method(name));
       TRACE(PM, 4, "deob vmeth %s %s\n", SHOW(m),
-            pm.deobfuscate_method(show(m)).c_str());
-      m->set_deobfuscated_name(pm.deobfuscate_method(show(m)));
+            m->get_deobfuscated_name().c_str());
     }
     for (const auto& f : cls->get_ifields()) {
+      name.clear();
+      show_to(name, f);
+      f->set_deobfuscated_name(pm.empty() ? name : pm.deobfuscate_field(name));
       TRACE(PM, 4, "deob ifield %s %s\n", SHOW(f),
-            pm.deobfuscate_field(show(f)).c_str());
-      f->set_deobfuscated_name(pm.deobfuscate_field(show(f)));
+            f->get_deobfuscated_name().c_str());
     }
     for (const auto& f : cls->get_sfields()) {
+      name.clear();
+      show_to(name, f);
+      f->set_deobfuscated_name(pm.empty() ? name : pm.deobfuscate_field(name));
       TRACE(PM, 4, "deob sfield %s %s\n", SHOW(f),
-            pm.deobfuscate_field(show(f)).c_str());
-      f->set_deobfuscated_name(pm.deobfuscate_field(show(f)));
+            f->get_deobfuscated_name().c_str());
     }
-  };
-
-  auto wq = workqueue_foreach<DexClass*>(
-      pm.empty() ? worker_empty_pg_map : worker_pg_map);
+  });
 
   for (const auto& dex : dexen) {
     for (const auto& cls : dex) {
@@ -46,9 +46,7 @@ struct ProguardMap {
   /**
    * Construct map from a given stream.
    */
-  explicit ProguardMap(std::istream& is) {
-    parse_proguard_map(is);
-  }
+  explicit ProguardMap(std::istream& is);
 
   /**
    * Translate un-obfuscated class name to obfuscated name.
@@ -89,11 +87,7 @@ struct ProguardMap {
   }
 
  private:
-  void parse_proguard_map(std::istream& fp);
-
-  bool parse_class(const std::string& line);
-  bool parse_field(const std::string& line);
-  bool parse_method(const std::string& line);
+  void parse_proguard_map(const char* begin, const char* end);
 
  private:
   // Unobfuscated to obfuscated maps
@@ -108,9 +102,6 @@ struct ProguardMap {
 
   // Interfaces that are (most likely) coalesced by Proguard.
   std::unordered_set<std::string> m_pg_coalesced_interfaces;
-
-  std::string m_currClass;
-  std::string m_currNewClass;
 };
 
 /**
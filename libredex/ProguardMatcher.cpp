@@ -8,12 +8,14 @@
 #include <algorithm>
 #include <boost/regex.hpp>
 #include <iostream>
+#include <numeric>
 #include <thread>
 
 #include "ClassHierarchy.h"
 #include "ConcurrentContainers.h"
 #include "DexUtil.h"
 #include "IRCode.h"
+#include "Parallel.h"
 #include "ProguardMatcher.h"
 #include "ProguardPrintConfiguration.h"
 #include "ProguardRegex.h"
@@ -21,20 +23,43 @@
 #include "ReachableClasses.h"
 #include "StringBuilder.h"
 #include "Timer.h"
-#include "WorkQueue.h"
 
 using namespace redex;
 
 namespace {
 
-using RegexMap = std::unordered_map<std::string, boost::regex>;
+/*
+ * Returns the compiled form of :rx. Regexes are compiled once per process and
+ * shared by all the rules and threads; the key is the regex source, which is
+ * the normalized form of the wildcard pattern it comes from. Matching against
+ * a const boost::regex is thread-safe.
+ */
+const boost::regex& shared_regex(const std::string& rx) {
+  static auto* s_regexes =
+      new ConcurrentMap<std::string, std::shared_ptr<const boost::regex>>();
+  auto compiled = s_regexes->get(rx, nullptr);
+  if (compiled == nullptr) {
+    // Two threads may compile the same regex; only one of them gets in.
+    s_regexes->emplace(rx, std::make_shared<const boost::regex>(rx));
+    compiled = s_regexes->get(rx, nullptr);
+  }
+  // Entries are never removed, so the regex outlives this reference.
+  return *compiled;
+}
 
-std::unique_ptr<boost::regex> make_rx(const std::string& s,
-                                      bool convert = true) {
+const boost::regex* make_rx(const std::string& s, bool convert = true) {
   if (s.empty()) return nullptr;
   auto wc = convert ? proguard_parser::convert_wildcard_type(s) : s;
-  auto rx = proguard_parser::form_type_regex(wc);
-  return std::make_unique<boost::regex>(rx);
+  return &shared_regex(proguard_parser::form_type_regex(wc));
+}
+
+std::unique_ptr<proguard_parser::TypePatternMatcher> make_type_matcher(
+    const std::string& s) {
+  if (s.empty()) return nullptr;
+  auto matcher = std::make_unique<proguard_parser::TypePatternMatcher>(
+      proguard_parser::convert_wildcard_type(s));
+  if (!matcher->is_compiled()) return nullptr;
+  return matcher;
 }
 
 bool match_annotation_rx(const DexClass* cls, const boost::regex& annorx) {
@@ -57,10 +82,27 @@ struct ClassMatcher {
       : setFlags_(ks.class_spec.setAccessFlags),
         unsetFlags_(ks.class_spec.unsetAccessFlags),
         m_class_name(ks.class_spec.className),
-        m_cls(make_rx(ks.class_spec.className)),
+        m_cls_matcher(make_type_matcher(ks.class_spec.className)),
+        m_extends_matcher(make_type_matcher(ks.class_spec.extendsClassName)),
         m_anno(make_rx(ks.class_spec.annotationType, false)),
-        m_extends(make_rx(ks.class_spec.extendsClassName)),
-        m_extends_anno(make_rx(ks.class_spec.extendsAnnotationType, false)) {}
+        m_extends_anno(make_rx(ks.class_spec.extendsAnnotationType, false)) {
+    // The regexes are only needed for the patterns that can't be compiled.
+    if (m_cls_matcher == nullptr) {
+      m_cls = make_rx(ks.class_spec.className);
+    }
+    if (m_extends_matcher == nullptr) {
+      m_extends = make_rx(ks.class_spec.extendsClassName);
+    }
+  }
+
+  /*
+   * If not null, the prefix that the names of all the matching classes start
+   * with.
+   */
+  const std::string* name_prefix() const {
+    if (m_cls_matcher == nullptr) return nullptr;
+    return &m_cls_matcher->prefix();
+  }
 
   bool match(const DexClass* cls) {
     // Check for class name match
@@ -84,6 +126,7 @@ struct ClassMatcher {
  private:
   bool match_name(const DexClass* cls) const {
     const auto& deob_name = cls->get_deobfuscated_name();
+    if (m_cls_matcher) return m_cls_matcher->match(deob_name);
     return boost::regex_match(deob_name, *m_cls);
   }
 
@@ -97,7 +140,7 @@ struct ClassMatcher {
   }
 
   bool match_extends(const DexClass* cls) {
-    if (!m_extends) return true;
+    if (!m_extends && !m_extends_matcher) return true;
     return search_extends_and_interfaces(cls);
   }
 
@@ -111,6 +154,7 @@ struct ClassMatcher {
       }
     }
     const auto& deob_name = cls->get_deobfuscated_name();
+    if (m_extends_matcher) return m_extends_matcher->match(deob_name);
     return boost::regex_match(deob_name, *m_extends);
   }
 
@@ -161,10 +205,12 @@ struct ClassMatcher {
   DexAccessFlags setFlags_;
   DexAccessFlags unsetFlags_;
   std::string m_class_name;
-  std::unique_ptr<boost::regex> m_cls;
-  std::unique_ptr<boost::regex> m_anno;
-  std::unique_ptr<boost::regex> m_extends;
-  std::unique_ptr<boost::regex> m_extends_anno;
+  std::unique_ptr<proguard_parser::TypePatternMatcher> m_cls_matcher;
+  std::unique_ptr<proguard_parser::TypePatternMatcher> m_extends_matcher;
+  const boost::regex* m_cls{nullptr};
+  const boost::regex* m_anno;
+  const boost::regex* m_extends{nullptr};
+  const boost::regex* m_extends_anno;
 
   std::unordered_map<const DexClass*, bool> m_extends_result_cache;
 };
@@ -208,6 +254,57 @@ void build_extends_or_implements_hierarchy(const Scope& scope,
   }
 }
 
+/*
+ * The changes that applying a rule to some classes makes to the
+ * ReferencedState of classes and members, and to the counters of the rule.
+ * The rules are matched in parallel, over chunks of the classes, each chunk
+ * recording its changes here. The changes are then replayed in the order of
+ * the rules, and within a rule in the order of the classes. The result is the
+ * same as when the rules are applied serially; this matters for the keep
+ * modifiers, which depend on whether an earlier rule already kept the class or
+ * member.
+ */
+class RstateDeltas {
+ public:
+  enum class Op : uint8_t {
+    KEEP_MODIFIERS,
+    // The keep modifiers of an <init>, which is never obfuscated.
+    INIT_KEEP_MODIFIERS,
+    HAS_KEEP,
+    CLINIT_KEEP,
+    KEEP_COUNT,
+    BLANKET_KEEPNAMES,
+    WHYAREYOUKEEPING,
+    ASSUMENOSIDEEFFECTS,
+  };
+
+  void record(Op op, ReferencedState* rstate) {
+    m_deltas.push_back({op, rstate});
+  }
+
+  template <class DexMember>
+  void record_keep_modifiers(DexMember* member) {
+    record(strcmp(member->get_name()->c_str(), "<init>") == 0
+               ? Op::INIT_KEEP_MODIFIERS
+               : Op::KEEP_MODIFIERS,
+           &member->rstate);
+  }
+
+  // The match counters of rules and member specifications.
+  void record_count(unsigned long* count) { m_counts.push_back(count); }
+
+  void replay(const KeepSpec& keep_rule) const;
+
+ private:
+  struct Delta {
+    Op op;
+    ReferencedState* rstate;
+  };
+
+  std::vector<Delta> m_deltas;
+  std::vector<unsigned long*> m_counts;
+};
+
 /*
  * This class contains the logic for matching against a single keep rule.
  */
@@ -215,10 +312,8 @@ class KeepRuleMatcher {
  public:
   KeepRuleMatcher(RuleType rule_type,
                   const KeepSpec& keep_rule,
-                  RegexMap& regex_map)
-      : m_rule_type(rule_type),
-        m_keep_rule(keep_rule),
-        m_regex_map(regex_map) {}
+                  RstateDeltas* deltas)
+      : m_rule_type(rule_type), m_keep_rule(keep_rule), m_deltas(deltas) {}
 
   void keep_processor(DexClass*);
 
@@ -277,17 +372,16 @@ class KeepRuleMatcher {
   bool has_annotation(const DexMember* member,
                       const std::string& annotation) const;
 
-  boost::regex register_matcher(const std::string& regex) const {
-    if (!m_regex_map.count(regex)) {
-      m_regex_map.emplace(regex, boost::regex{regex});
-    }
-    return m_regex_map.at(regex);
+  const boost::regex& register_matcher(const std::string& regex) const {
+    return shared_regex(regex);
   }
 
  private:
+  void keep_clinits(DexClass* cls);
+
   RuleType m_rule_type;
   const KeepSpec& m_keep_rule;
-  RegexMap& m_regex_map;
+  RstateDeltas* m_deltas;
 };
 
 class ProguardMatcher {
@@ -303,6 +397,8 @@ class ProguardMatcher {
     // may, for instance, forbid renaming of all classes that inherit from a
     // given external class.
     build_extends_or_implements_hierarchy(m_external_classes, &m_hierarchy);
+    m_sorted_classes = sort_by_name(m_classes);
+    m_sorted_external_classes = sort_by_name(m_external_classes);
   }
 
   void process_proguard_rules(const ProguardConfiguration& pg_config);
@@ -314,16 +410,36 @@ class ProguardMatcher {
   DexClass* find_single_class(const std::string& descriptor) const;
 
  private:
+  static std::vector<DexClass*> sort_by_name(const Scope& classes);
+
+  // A range of classes in a list.
+  using ClassRange = std::pair<DexClass* const*, DexClass* const*>;
+
+  static ClassRange whole(const std::vector<DexClass*>& classes) {
+    return {classes.data(), classes.data() + classes.size()};
+  }
+
+  /*
+   * The classes in :sorted_classes whose name starts with :prefix.
+   */
+  static ClassRange with_prefix(const std::vector<DexClass*>& sorted_classes,
+                                const std::string& prefix);
+
   const ProguardMap& m_pg_map;
   const Scope& m_classes;
   const Scope& m_external_classes;
   ClassHierarchy m_hierarchy;
+  // The classes sorted by deobfuscated name, so that the classes that can
+  // match a literal or prefix pattern are found by a binary search.
+  std::vector<DexClass*> m_sorted_classes;
+  std::vector<DexClass*> m_sorted_external_classes;
 };
 
 // Updates a class, field or method to add keep modifiers.
 // Note: includedescriptorclasses and allowoptimization are not implemented.
-template <class DexMember>
-void apply_keep_modifiers(const KeepSpec& k, DexMember* member) {
+void apply_keep_modifiers(const KeepSpec& k,
+                          bool is_init,
+                          ReferencedState* rstate) {
   // We only set allowshrinking when no other keep rule has been applied to this
   // class or member.
   //
@@ -333,24 +449,58 @@ void apply_keep_modifiers(const KeepSpec& k, DexMember* member) {
   // programmers must fix the rules. Instead, we pick a conservative choice:
   // don't shrink or don't obfuscate.
   if (k.allowshrinking) {
-    if (!has_keep(member)) {
-      member->rstate.set_allowshrinking();
+    if (!rstate->has_keep()) {
+      rstate->set_allowshrinking();
     } else {
       // We already observed a keep rule for this member. So, even if another
       // "-keep,allowshrinking" tries to set allowshrinking, we must ignore it.
     }
   } else {
     // Otherwise reset it: don't allow shrinking.
-    member->rstate.unset_allowshrinking();
+    rstate->unset_allowshrinking();
   }
   // The same case: unsetting allowobfuscation has a priority.
   if (k.allowobfuscation) {
-    if (!has_keep(member) &&
-        strcmp(member->get_name()->c_str(), "<init>") != 0) {
-      member->rstate.set_allowobfuscation();
+    if (!rstate->has_keep() && !is_init) {
+      rstate->set_allowobfuscation();
     }
   } else {
-    member->rstate.unset_allowobfuscation();
+    rstate->unset_allowobfuscation();
+  }
+}
+
+void RstateDeltas::replay(const KeepSpec& keep_rule) const {
+  for (const auto& delta : m_deltas) {
+    auto rstate = delta.rstate;
+    switch (delta.op) {
+    case Op::KEEP_MODIFIERS:
+      apply_keep_modifiers(keep_rule, /* is_init */ false, rstate);
+      break;
+    case Op::INIT_KEEP_MODIFIERS:
+      apply_keep_modifiers(keep_rule, /* is_init */ true, rstate);
+      break;
+    case Op::HAS_KEEP:
+      rstate->set_has_keep(&keep_rule);
+      break;
+    case Op::CLINIT_KEEP:
+      rstate->set_has_keep(keep_reason::CLINIT);
+      break;
+    case Op::KEEP_COUNT:
+      rstate->increment_keep_count();
+      break;
+    case Op::BLANKET_KEEPNAMES:
+      rstate->set_blanket_keepnames();
+      break;
+    case Op::WHYAREYOUKEEPING:
+      rstate->set_whyareyoukeeping();
+      break;
+    case Op::ASSUMENOSIDEEFFECTS:
+      rstate->set_assumenosideeffects();
+      break;
+    }
+  }
+  for (auto count : m_counts) {
+    ++*count;
   }
 }
 
@@ -433,10 +583,10 @@ void KeepRuleMatcher::keep_fields(
       continue;
     }
     if (apply_modifiers) {
-      apply_keep_modifiers(m_keep_rule, field);
+      m_deltas->record_keep_modifiers(field);
     }
     apply_rule(field);
-    fieldSpecification.count++;
+    m_deltas->record_count(&fieldSpecification.count);
   }
 }
 
@@ -478,7 +628,7 @@ bool KeepRuleMatcher::method_level_match(
   return boost::regex_match(dequalified_name.c_str(), method_regex);
 }
 
-void keep_clinits(DexClass* cls) {
+void KeepRuleMatcher::keep_clinits(DexClass* cls) {
   for (auto method : cls->get_dmethods()) {
     if (is_clinit(method) && method->get_code()) {
       auto ii = InstructionIterable(method->get_code());
@@ -487,7 +637,7 @@ void keep_clinits(DexClass* cls) {
         ++it;
       }
       if (!(it->insn->opcode() == OPCODE_RETURN_VOID && (++it) == ii.end())) {
-        method->rstate.set_has_keep(keep_reason::CLINIT);
+        m_deltas->record(RstateDeltas::Op::CLINIT_KEEP, &method->rstate);
       }
       break;
     }
@@ -503,10 +653,10 @@ void KeepRuleMatcher::keep_methods(
   for (DexMethod* method : methods) {
     if (method_level_match(methodSpecification, method, method_regex)) {
       if (apply_modifiers) {
-        apply_keep_modifiers(m_keep_rule, method);
+        m_deltas->record_keep_modifiers(method);
       }
       apply_rule(method);
-      methodSpecification.count++;
+      m_deltas->record_count(&methodSpecification.count);
     }
   }
 }
@@ -609,11 +759,8 @@ bool KeepRuleMatcher::process_mark_conditionally(const DexClass* cls) {
 // in the class hierarchy.
 //
 // Parallelization note: We parallelize process_keep, and this function will be
-// eventually executed concurrently. There are potential races in rstate:
-// (1) m_keep, (2) m_(un)set_allow(shrinking|obfuscation), (3)
-// m_blanket_keepnames, and (4) m_keep_count. We use an atomic value for
-// m_keep_count, but the other boolean values are always overwritten. These WAW
-// (write-after-write) races are benign and do not affect the results.
+// eventually executed concurrently. It only reads the rstate of the classes
+// and members, and records its changes to them in m_deltas.
 void KeepRuleMatcher::mark_class_and_members_for_keep(DexClass* cls) {
   // First check to see if we need to mark conditionally to see if all
   // field and method rules match i.e. we have a -keepclasseswithmembers
@@ -636,10 +783,10 @@ void KeepRuleMatcher::mark_class_and_members_for_keep(DexClass* cls) {
         << "WARNING: 'allowoptimization' keep modifier is NOT implemented: "
         << redex::show_keep(m_keep_rule) << std::endl;
   }
-  m_keep_rule.count++;
+  m_deltas->record_count(&m_keep_rule.count);
   if (m_keep_rule.mark_classes || m_keep_rule.mark_conditionally) {
-    apply_keep_modifiers(m_keep_rule, cls);
-    cls->rstate.set_has_keep(&m_keep_rule);
+    m_deltas->record_keep_modifiers(cls);
+    m_deltas->record(RstateDeltas::Op::HAS_KEEP, &cls->rstate);
     if (cls->rstate.report_whyareyoukeeping()) {
       TRACE(
           PGR, 2, "whyareyoukeeping Class %s kept by %s\n",
@@ -647,10 +794,10 @@ void KeepRuleMatcher::mark_class_and_members_for_keep(DexClass* cls) {
           show_keep(m_keep_rule).c_str());
     }
     if (!m_keep_rule.allowobfuscation) {
-      cls->rstate.increment_keep_count();
+      m_deltas->record(RstateDeltas::Op::KEEP_COUNT, &cls->rstate);
     }
     if (is_blanket_keepnames_rule(m_keep_rule)) {
-      cls->rstate.set_blanket_keepnames();
+      m_deltas->record(RstateDeltas::Op::BLANKET_KEEPNAMES, &cls->rstate);
     }
     // Mark non-empty <clinit> methods as seeds.
     keep_clinits(cls);
@@ -673,7 +820,7 @@ void KeepRuleMatcher::mark_class_and_members_for_keep(DexClass* cls) {
 
 // This function is also executed concurrently.
 void KeepRuleMatcher::process_whyareyoukeeping(DexClass* cls) {
-  cls->rstate.set_whyareyoukeeping();
+  m_deltas->record(RstateDeltas::Op::WHYAREYOUKEEPING, &cls->rstate);
 
   apply_field_keeps(cls, false);
   // Set any method-level keep whyareyoukeeping bits.
@@ -682,7 +829,7 @@ void KeepRuleMatcher::process_whyareyoukeeping(DexClass* cls) {
 
 // This function is also executed concurrently.
 void KeepRuleMatcher::process_assumenosideeffects(DexClass* cls) {
-  cls->rstate.set_assumenosideeffects();
+  m_deltas->record(RstateDeltas::Op::ASSUMENOSIDEEFFECTS, &cls->rstate);
 
   // Apply any method-level keep specifications.
   apply_method_keeps(cls, false);
@@ -692,10 +839,10 @@ template <class DexMember>
 void KeepRuleMatcher::apply_rule(DexMember* member) {
   switch (m_rule_type) {
   case RuleType::WHY_ARE_YOU_KEEPING:
-    member->rstate.set_whyareyoukeeping();
+    m_deltas->record(RstateDeltas::Op::WHYAREYOUKEEPING, &member->rstate);
     break;
   case RuleType::KEEP: {
-    member->rstate.set_has_keep(&m_keep_rule);
+    m_deltas->record(RstateDeltas::Op::HAS_KEEP, &member->rstate);
     if (member->rstate.report_whyareyoukeeping()) {
       TRACE(PGR, 2, "whyareyoukeeping %s kept by %s\n", SHOW(member),
             show_keep(m_keep_rule).c_str());
@@ -703,7 +850,7 @@ void KeepRuleMatcher::apply_rule(DexMember* member) {
     break;
   }
   case RuleType::ASSUME_NO_SIDE_EFFECTS:
-    member->rstate.set_assumenosideeffects();
+    m_deltas->record(RstateDeltas::Op::ASSUMENOSIDEEFFECTS, &member->rstate);
     break;
   }
 }
@@ -722,6 +869,37 @@ void KeepRuleMatcher::keep_processor(DexClass* cls) {
   }
 }
 
+std::vector<DexClass*> ProguardMatcher::sort_by_name(const Scope& classes) {
+  std::vector<DexClass*> sorted;
+  sorted.reserve(classes.size());
+  for (auto cls : classes) {
+    if (cls != nullptr) {
+      sorted.push_back(cls);
+    }
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [](const DexClass* a, const DexClass* b) {
+              return a->get_deobfuscated_name() < b->get_deobfuscated_name();
+            });
+  return sorted;
+}
+
+ProguardMatcher::ClassRange ProguardMatcher::with_prefix(
+    const std::vector<DexClass*>& sorted_classes, const std::string& prefix) {
+  auto range = whole(sorted_classes);
+  auto begin = std::lower_bound(range.first, range.second, prefix,
+                                [](const DexClass* cls, const std::string& p) {
+                                  return cls->get_deobfuscated_name() < p;
+                                });
+  auto end = begin;
+  while (end != range.second &&
+         (*end)->get_deobfuscated_name().compare(0, prefix.size(), prefix) ==
+             0) {
+    ++end;
+  }
+  return {begin, end};
+}
+
 DexClass* ProguardMatcher::find_single_class(
     const std::string& descriptor) const {
   auto const& dsc = JavaNameUtil::external_to_internal(descriptor);
@@ -742,69 +920,124 @@ void ProguardMatcher::process_keep(const KeepSpecSet& keep_rules,
 
   auto process_single_keep = [rule_type, process_external](
                                  ClassMatcher& class_match,
-                                 const KeepSpec& keep_rule, DexClass* cls,
-                                 RegexMap& regex_map) {
+                                 const KeepSpec& keep_rule,
+                                 RstateDeltas* deltas, DexClass* cls) {
     // Skip external classes.
     if (cls == nullptr || (!process_external && cls->is_external())) {
       return;
     }
     if (class_match.match(cls)) {
-      KeepRuleMatcher rule_matcher(rule_type, keep_rule, regex_map);
+      KeepRuleMatcher rule_matcher(rule_type, keep_rule, deltas);
       rule_matcher.keep_processor(cls);
     }
   };
 
-  // We only parallelize if keep_rule needs to be applied to all classes.
-  auto wq = workqueue_foreach<const KeepSpec*>([&](const KeepSpec* keep_rule) {
-    RegexMap regex_map;
-    ClassMatcher class_match(*keep_rule);
-
-    for (const auto& cls : m_classes) {
-      process_single_keep(class_match, *keep_rule, cls, regex_map);
-    }
-    if (process_external) {
-      for (const auto& cls : m_external_classes) {
-        process_single_keep(class_match, *keep_rule, cls, regex_map);
-      }
-    }
-  });
+  // First find the classes that each rule can match, as ranges of class
+  // lists. The rules with a literal class name own their short lists.
+  struct Candidates {
+    std::vector<DexClass*> owned;
+    std::vector<ClassRange> ranges;
+  };
+  std::vector<const KeepSpec*> rules(keep_rules.begin(), keep_rules.end());
+  std::vector<Candidates> candidates(rules.size());
+  std::vector<size_t> indices(rules.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(
+      indices.begin(), indices.end(),
+      [&](size_t i) {
+        const auto& keep_rule = *rules[i];
+        auto& rule_candidates = candidates[i];
+        auto own = [&](DexClass* cls) {
+          if (cls != nullptr) {
+            rule_candidates.owned.push_back(cls);
+          }
+        };
+
+        // This case is very fast.
+        const auto& className = keep_rule.class_spec.className;
+        if (!classname_contains_wildcard(className)) {
+          own(find_single_class(className));
+          rule_candidates.ranges.push_back(whole(rule_candidates.owned));
+          return;
+        }
 
-  RegexMap regex_map;
-  for (const auto& keep_rule_ptr : keep_rules) {
-    const auto& keep_rule = *keep_rule_ptr;
-    ClassMatcher class_match(keep_rule);
+        // This is also very fast.
+        const auto& extendsClassName = keep_rule.class_spec.extendsClassName;
+        if (extendsClassName != "" &&
+            !classname_contains_wildcard(extendsClassName)) {
+          DexClass* super = find_single_class(extendsClassName);
+          if (super != nullptr) {
+            TypeSet children;
+            get_all_children(m_hierarchy, super->get_type(), children);
+            own(super);
+            for (auto const* type : children) {
+              own(type_class(type));
+            }
+          }
+          rule_candidates.ranges.push_back(whole(rule_candidates.owned));
+          return;
+        }
 
-    // This case is very fast. Just process it immediately in the main thread.
-    const auto& className = keep_rule.class_spec.className;
-    if (!classname_contains_wildcard(className)) {
-      DexClass* cls = find_single_class(className);
-      process_single_keep(class_match, keep_rule, cls, regex_map);
-      continue;
-    }
+        TRACE(PGR, 2, "Slow rule: %s\n", show_keep(keep_rule).c_str());
+        // Only the classes that start with the literal part of the class name
+        // pattern can match it.
+        ClassMatcher class_match(keep_rule);
+        const auto* prefix = class_match.name_prefix();
+        if (prefix != nullptr) {
+          rule_candidates.ranges.push_back(
+              with_prefix(m_sorted_classes, *prefix));
+          if (process_external) {
+            rule_candidates.ranges.push_back(
+                with_prefix(m_sorted_external_classes, *prefix));
+          }
+          return;
+        }
 
-    // This is also very fast. Process it in the main thread, too.
-    const auto& extendsClassName = keep_rule.class_spec.extendsClassName;
-    if (extendsClassName != "" &&
-        !classname_contains_wildcard(extendsClassName)) {
-      DexClass* super = find_single_class(extendsClassName);
-      if (super != nullptr) {
-        TypeSet children;
-        get_all_children(m_hierarchy, super->get_type(), children);
-        process_single_keep(class_match, keep_rule, super, regex_map);
-        for (auto const* type : children) {
-          process_single_keep(class_match, keep_rule, type_class(type),
-                              regex_map);
+        rule_candidates.ranges.push_back(whole(m_classes));
+        if (process_external) {
+          rule_candidates.ranges.push_back(whole(m_external_classes));
         }
+      },
+      /* grain */ 1);
+
+  // Then match each rule against chunks of its classes in parallel, so that a
+  // slow rule over many classes doesn't hold up the others. The changes are
+  // applied once all the chunks have been matched, in the order of the rules
+  // and then of the classes.
+  constexpr size_t k_classes_per_unit = 256;
+  struct WorkUnit {
+    size_t rule;
+    ClassRange classes;
+  };
+  std::vector<WorkUnit> units;
+  for (size_t i = 0; i < rules.size(); ++i) {
+    for (const auto& range : candidates[i].ranges) {
+      for (auto it = range.first; it != range.second;) {
+        auto end =
+            it + std::min<size_t>(k_classes_per_unit, range.second - it);
+        units.push_back({i, {it, end}});
+        it = end;
       }
-      continue;
     }
-
-    TRACE(PGR, 2, "Slow rule: %s\n", show_keep(keep_rule).c_str());
-    // Otherwise, it might take a longer time. Add to the work queue.
-    wq.add_item(&keep_rule);
   }
+  std::vector<RstateDeltas> deltas(units.size());
+  indices.resize(units.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(
+      indices.begin(), indices.end(),
+      [&](size_t u) {
+        const auto& unit = units[u];
+        const auto& keep_rule = *rules[unit.rule];
+        ClassMatcher class_match(keep_rule);
+        for (auto it = unit.classes.first; it != unit.classes.second; ++it) {
+          process_single_keep(class_match, keep_rule, &deltas[u], *it);
+        }
+      },
+      /* grain */ 1);
 
-  wq.run_all();
+  for (size_t u = 0; u < units.size(); ++u) {
+    deltas[u].replay(*rules[units[u].rule]);
+  }
 }
 
 void ProguardMatcher::process_proguard_rules(
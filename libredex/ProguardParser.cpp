@@ -7,7 +7,12 @@
 
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
 
+#include "Parallel.h"
 #include "ProguardLexer.h"
 #include "ProguardMap.h"
 #include "ProguardParser.h"
@@ -969,23 +974,19 @@ void parse(std::vector<unique_ptr<Token>>::iterator it,
   }
 }
 
-void parse(istream& config,
+void parse(std::vector<unique_ptr<Token>>* tokens,
            ProguardConfiguration* pg_config,
            const std::string& filename) {
-  std::vector<unique_ptr<Token>> tokens = lex(config);
   bool ok = true;
   // Check for bad tokens.
-  for (auto& tok : tokens) {
+  for (auto& tok : *tokens) {
     if (tok->type == token::unknownToken) {
-      std::string spelling =
-          static_cast<UnknownToken*>(tok.get())->token_string;
       ok = false;
     }
-    // std::cout << tok->show() << " at line " << tok->line << std::endl;
   }
   unsigned int parse_errors = 0;
   if (ok) {
-    parse(tokens.begin(), tokens.end(), pg_config, &parse_errors, filename);
+    parse(tokens->begin(), tokens->end(), pg_config, &parse_errors, filename);
   }
 
   if (parse_errors == 0) {
@@ -996,28 +997,129 @@ void parse(istream& config,
   }
 }
 
-void parse_file(const std::string& filename, ProguardConfiguration* pg_config) {
+void parse(istream& config,
+           ProguardConfiguration* pg_config,
+           const std::string& filename) {
+  std::vector<unique_ptr<Token>> tokens = lex(config);
+  parse(&tokens, pg_config, filename);
+}
+
+namespace {
+
+using Tokens = std::vector<unique_ptr<Token>>;
+
+/*
+ * The tokens of a configuration file, which are shared between the files that
+ * have the same contents.
+ */
+struct LexedFile {
+  bool opened{false};
+  std::string contents;
+  std::shared_ptr<Tokens> tokens;
+};
+
+bool read_file(const std::string& filename,
+               const std::string& basedirectory,
+               std::string* contents) {
+  // First try relative path, then with -basedirectory.
   ifstream config(filename);
-  // First try relative path.
   if (!config.is_open()) {
-    // Try with -basedirectory
-    config.open(pg_config->basedirectory + "/" + filename);
+    config.open(basedirectory + "/" + filename);
     if (!config.is_open()) {
-      cerr << "ERROR: Failed to open ProGuard configuration file " << filename
+      return false;
+    }
+  }
+  std::ostringstream ss;
+  ss << config.rdbuf();
+  *contents = ss.str();
+  return true;
+}
+
+/*
+ * Read and lex the given files in parallel. Files whose contents have already
+ * been lexed, by this call or an earlier one, reuse the tokens in the cache.
+ */
+std::vector<LexedFile> lex_files(
+    const std::vector<std::string>& filenames,
+    const std::string& basedirectory,
+    std::unordered_map<std::string, std::shared_ptr<Tokens>>* cache) {
+  std::vector<LexedFile> files(filenames.size());
+  std::vector<size_t> indices(filenames.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(
+      indices.begin(), indices.end(), [&](size_t i) {
+        files[i].opened =
+            read_file(filenames[i], basedirectory, &files[i].contents);
+      },
+      1);
+
+  std::vector<LexedFile*> to_lex;
+  for (auto& file : files) {
+    if (!file.opened) {
+      continue;
+    }
+    auto& tokens = (*cache)[file.contents];
+    if (tokens == nullptr) {
+      tokens = std::make_shared<Tokens>();
+      to_lex.push_back(&file);
+    }
+    file.tokens = tokens;
+  }
+  parallel_for(
+      to_lex.begin(), to_lex.end(), [](LexedFile* file) {
+        std::istringstream config(file->contents);
+        *file->tokens = lex(config);
+      },
+      1);
+  for (auto& file : files) {
+    file.contents.clear();
+  }
+  return files;
+}
+
+} // namespace
+
+/*
+ * The included files are processed breadth first, in the order of their
+ * -include commands. Each round reads and lexes all the files that were newly
+ * included by the previous round in parallel, and then parses them in order,
+ * since the parser state carries over from one file to the next.
+ */
+void parse_file(const std::string& filename, ProguardConfiguration* pg_config) {
+  std::unordered_map<std::string, std::shared_ptr<Tokens>> cache;
+  auto parse_lexed = [&](const std::string& name, const LexedFile& file) {
+    if (!file.opened) {
+      cerr << "ERROR: Failed to open ProGuard configuration file " << name
            << endl;
       exit(1);
     }
-  }
+    parse(file.tokens.get(), pg_config, name);
+  };
+  parse_lexed(filename,
+              lex_files({filename}, pg_config->basedirectory, &cache)[0]);
 
-  parse(config, pg_config, filename);
   // Parse the included files.
-  for (const auto& included_filename : pg_config->includes) {
-    if (pg_config->already_included.find(included_filename) !=
-        pg_config->already_included.end()) {
-      continue;
+  size_t next_include = 0;
+  while (next_include < pg_config->includes.size()) {
+    std::vector<std::string> filenames;
+    for (; next_include < pg_config->includes.size(); ++next_include) {
+      const auto& included_filename = pg_config->includes[next_include];
+      if (pg_config->already_included.emplace(included_filename).second) {
+        filenames.push_back(included_filename);
+      }
+    }
+    const auto basedirectory = pg_config->basedirectory;
+    auto files = lex_files(filenames, basedirectory, &cache);
+    for (size_t i = 0; i < filenames.size(); ++i) {
+      if (pg_config->basedirectory != basedirectory) {
+        // A -basedirectory command changed where the remaining files are
+        // looked up.
+        files[i] = std::move(lex_files({filenames[i]},
+                                       pg_config->basedirectory,
+                                       &cache)[0]);
+      }
+      parse_lexed(filenames[i], files[i]);
     }
-    pg_config->already_included.emplace(included_filename);
-    parse_file(included_filename, pg_config);
   }
 }
 
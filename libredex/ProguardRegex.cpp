@@ -5,8 +5,10 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <cctype>
 #include <cstring>
 
+#include "Debug.h"
 #include "ProguardRegex.h"
 #include "ProguardMap.h"
 
@@ -165,5 +167,68 @@ std::string convert_wildcard_type(std::string typ) {
   return wildcard_descriptor;
 }
 
+namespace {
+
+// Characters that stand for themselves in the regex built by
+// form_type_regex().
+bool is_literal_type_char(char ch) {
+  return isalnum(static_cast<unsigned char>(ch)) || ch == '_' || ch == '$' || ch == '/' || ch == '-';
+}
+
+} // namespace
+
+TypePatternMatcher::TypePatternMatcher(const std::string& wildcard_type) {
+  // form_type_regex() reads "L*;" as "L**;".
+  const std::string& pattern =
+      wildcard_type == "L*;" ? std::string("L**;") : wildcard_type;
+  if (pattern.size() < 2 || pattern.back() != ';') {
+    return;
+  }
+  size_t end = pattern.size() - 1;
+  size_t literal_end = 0;
+  while (literal_end < end && is_literal_type_char(pattern[literal_end])) {
+    ++literal_end;
+  }
+  auto wildcard = pattern.substr(literal_end, end - literal_end);
+  Kind kind;
+  if (wildcard.empty()) {
+    kind = Kind::LITERAL;
+  } else if (wildcard == "*") {
+    kind = Kind::ANY_SEGMENT;
+  } else if (wildcard == "**") {
+    kind = Kind::ANY_SEGMENTS;
+  } else {
+    return;
+  }
+  m_kind = kind;
+  m_prefix = pattern.substr(0, literal_end);
+}
+
+bool TypePatternMatcher::match(const std::string& name) const {
+  always_assert(is_compiled());
+  if (name.size() < m_prefix.size() + 1 || name.back() != ';' ||
+      name.compare(0, m_prefix.size(), m_prefix) != 0) {
+    return false;
+  }
+  size_t begin = m_prefix.size();
+  size_t end = name.size() - 1;
+  switch (m_kind) {
+  case Kind::LITERAL:
+    return begin == end;
+  case Kind::ANY_SEGMENT:
+    return name.find('/', begin) >= end;
+  case Kind::ANY_SEGMENTS: {
+    if (begin == end || name[begin] == '/' || name[end - 1] == '/') {
+      return false;
+    }
+    auto slashes = name.find("//", begin);
+    return slashes == std::string::npos || slashes + 1 >= end;
+  }
+  case Kind::REGEX:
+    break;
+  }
+  not_reached();
+}
+
 } // namespace proguard_parser
 } // namespace redex
@@ -16,5 +16,39 @@ std::string form_member_regex(std::string proguard_regex);
 std::string form_type_regex(std::string proguard_regex);
 std::string convert_wildcard_type(std::string typ);
 
+/*
+ * Matches class names against a wildcard type descriptor, as produced by
+ * convert_wildcard_type(), without a regex. Only literal descriptors and
+ * descriptors whose only wildcard is a trailing * or ** can be compiled, e.g.
+ * "Lcom/foo/Bar;", "Lcom/foo/Bar*;" or "Lcom/foo/Bar**;". For those, match()
+ * gives the same result as matching form_type_regex() of the descriptor, and
+ * every matching name starts with prefix(). Any other pattern has to be
+ * matched by the regex.
+ */
+class TypePatternMatcher {
+ public:
+  explicit TypePatternMatcher(const std::string& wildcard_type);
+
+  bool is_compiled() const { return m_kind != Kind::REGEX; }
+
+  const std::string& prefix() const { return m_prefix; }
+
+  bool match(const std::string& name) const;
+
+ private:
+  enum class Kind {
+    REGEX,
+    // The name is the prefix followed by a semicolon.
+    LITERAL,
+    // The rest of the name is a single segment, which may be empty.
+    ANY_SEGMENT,
+    // The rest of the name is one or more non-empty segments.
+    ANY_SEGMENTS,
+  };
+
+  Kind m_kind{Kind::REGEX};
+  std::string m_prefix;
+};
+
 } // namespace proguard_parser
 } // namespace redex
@@ -9,7 +9,7 @@
 #include "DexClass.h"
 #include "ReachableClasses.h"
 
-std::string extract_suffix(std::string class_name) {
+std::string extract_suffix(const std::string& class_name) {
   auto i = class_name.find_last_of(".");
   if (i == std::string::npos) {
     // This is a class name with no package prefix.
@@ -74,7 +74,7 @@ std::string type_descriptor_to_java(const std::string& descriptor) {
   exit(2);
 }
 
-std::string extract_member_name(std::string qualified) {
+std::string extract_member_name(const std::string& qualified) {
   auto dot = qualified.find(".");
   auto colon = qualified.find(":");
   return qualified.substr(dot + 1, colon - dot - 1);
@@ -111,7 +111,7 @@ std::string deobfuscate_type_descriptor(const ProguardMap& pg_map,
 }
 
 std::string form_java_args(const ProguardMap& pg_map,
-                           const std::deque<DexType*>& args) {
+                           const DexTypeList& args) {
   std::string s;
   unsigned long i = 0;
   for (const auto& arg : args) {
@@ -126,7 +126,7 @@ std::string form_java_args(const ProguardMap& pg_map,
   return s;
 }
 
-std::string java_args(const ProguardMap& pg_map, const std::deque<DexType*>& args) {
+std::string java_args(const ProguardMap& pg_map, const DexTypeList& args) {
   std::string str = "(";
   str += form_java_args(pg_map, args);
   str += ")";
@@ -145,7 +145,7 @@ void redex::print_method(std::ostream& output,
     method_name = extract_suffix(class_name);
     is_constructor = true;
   } else {
-    auto deob = method->get_deobfuscated_name();
+    const auto& deob = method->get_deobfuscated_name();
     if (deob.empty()) {
       std::cerr << "WARNING: method has no deobfu: " << method_name
                 << std::endl;
@@ -154,7 +154,7 @@ void redex::print_method(std::ostream& output,
     }
   }
   auto proto = method->get_proto();
-  auto args = proto->get_args()->get_type_list();
+  const auto& args = proto->get_args()->get_type_list();
   auto return_type = proto->get_rtype();
   output << class_name << ": ";
   if (!is_constructor) {
@@ -180,7 +180,6 @@ void redex::print_field(std::ostream& output,
                         const ProguardMap& pg_map,
                         const std::string& class_name,
                         const DexField* field) {
-  auto field_name = field->get_deobfuscated_name();
   auto field_type = field->get_type()->get_name()->c_str();
   std::string deobfu_field_type =
       deobfuscate_type_descriptor(pg_map, field_type);
@@ -202,13 +201,13 @@ void redex::print_fields(std::ostream& output,
 void redex::print_class(std::ostream& output,
                         const ProguardMap& pg_map,
                         const DexClass* cls) {
-  auto deob = cls->get_deobfuscated_name();
+  const auto& deob = cls->get_deobfuscated_name();
   if (deob.empty()) {
     std::cerr << "WARNING: this class has no deobu name: "
               << cls->get_name()->c_str() << std::endl;
-    deob = cls->get_name()->c_str();
   }
-  std::string name = redex::dexdump_name_to_dot_name(deob);
+  std::string name = redex::dexdump_name_to_dot_name(
+      deob.empty() ? cls->get_name()->str() : deob);
   output << name << std::endl;
   print_fields(output, pg_map, name, cls->get_ifields());
   print_fields(output, pg_map, name, cls->get_sfields());
@@ -219,9 +218,10 @@ void redex::print_class(std::ostream& output,
 void redex::print_classes(std::ostream& output,
                           const ProguardMap& pg_map,
                           const Scope& classes) {
-  for (const auto& cls : classes) {
-    if (!cls->is_external()) {
-      redex::print_class(output, pg_map, cls);
-    }
-  }
+  print_classes_in_parallel(
+      output, classes, [&](std::ostream& buffer, const DexClass* cls) {
+        if (!cls->is_external()) {
+          redex::print_class(buffer, pg_map, cls);
+        }
+      });
 }
@@ -9,8 +9,11 @@
 
 #include "DexClass.h"
 #include "DexUtil.h"
+#include "Parallel.h"
 #include "ProguardMap.h"
 #include <iostream>
+#include <numeric>
+#include <sstream>
 
 namespace redex {
 
@@ -45,4 +48,33 @@ void print_class(std::ostream& output,
 void print_classes(std::ostream& output,
                    const ProguardMap& pg_map,
                    const Scope& classes);
+
+/*
+ * Call `print_class(std::ostream&, const DexClass*)` on each class and write
+ * what it prints to `output`, in the order of `classes`. The classes are
+ * formatted in parallel, one batch at a time, so that only a batch worth of
+ * output is buffered.
+ */
+template <class PrintClass>
+void print_classes_in_parallel(std::ostream& output,
+                               const Scope& classes,
+                               const PrintClass& print_class) {
+  constexpr size_t batch_size = 4096;
+  std::vector<std::string> buffers;
+  std::vector<size_t> indices;
+  for (size_t begin = 0; begin < classes.size(); begin += batch_size) {
+    size_t end = std::min(classes.size(), begin + batch_size);
+    buffers.assign(end - begin, std::string());
+    indices.resize(end - begin);
+    std::iota(indices.begin(), indices.end(), 0);
+    parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+      std::ostringstream buffer;
+      print_class(buffer, classes[begin + i]);
+      buffers[i] = buffer.str();
+    });
+    for (const auto& buffer : buffers) {
+      output << buffer;
+    }
+  }
+}
 }
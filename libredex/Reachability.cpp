@@ -35,6 +35,28 @@ struct SafeVector {
 
 static ReachableObject SEED_SINGLETON{};
 
+std::vector<const DexFieldRef*> scope_fields(const Scope& scope) {
+  std::vector<const DexFieldRef*> fields;
+  for (auto cls : scope) {
+    fields.insert(fields.end(), cls->get_ifields().begin(),
+                  cls->get_ifields().end());
+    fields.insert(fields.end(), cls->get_sfields().begin(),
+                  cls->get_sfields().end());
+  }
+  return fields;
+}
+
+std::vector<const DexMethodRef*> scope_methods(const Scope& scope) {
+  std::vector<const DexMethodRef*> methods;
+  for (auto cls : scope) {
+    methods.insert(methods.end(), cls->get_dmethods().begin(),
+                   cls->get_dmethods().end());
+    methods.insert(methods.end(), cls->get_vmethods().begin(),
+                   cls->get_vmethods().end());
+  }
+  return methods;
+}
+
 bool is_canary(const DexClass* cls) {
   return strstr(cls->get_name()->c_str(), "Canary");
 }
@@ -473,15 +495,20 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects(
     DexStoresVector& stores,
     const IgnoreSets& ignore_sets,
     int* num_ignore_check_strings,
-    bool record_reachability) {
+    bool record_reachability,
+    MethodOverrideGraphCache* graph_cache) {
   Timer t("Marking");
   auto scope = build_class_scope(stores);
-  auto reachable_objects = std::make_unique<ReachableObjects>();
+  auto reachable_objects = std::make_unique<ReachableObjects>(scope);
   ConditionallyMarked cond_marked;
-  auto method_override_graph = mog::build_graph(scope);
+  MethodOverrideGraphCache local_graph_cache;
+  if (graph_cache == nullptr) {
+    graph_cache = &local_graph_cache;
+  }
+  const auto& method_override_graph = graph_cache->get(scope);
 
   ConcurrentSet<ReachableObject, ReachableObjectHash> root_set;
-  RootSetMarker root_set_marker(*method_override_graph,
+  RootSetMarker root_set_marker(method_override_graph,
                                 record_reachability,
                                 &cond_marked,
                                 reachable_objects.get(),
@@ -493,7 +520,7 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects(
   MarkWorkQueue work_queue(
       [&](MarkWorkerState* worker_state, const ReachableObject& obj) {
         TransitiveClosureMarker transitive_closure_marker(
-            ignore_sets, *method_override_graph, record_reachability,
+            ignore_sets, method_override_graph, record_reachability,
             &cond_marked, reachable_objects.get(), worker_state);
         transitive_closure_marker.visit(obj);
         return nullptr;
@@ -514,6 +541,11 @@ std::unique_ptr<ReachableObjects> compute_reachable_objects(
   return reachable_objects;
 }
 
+ReachableObjects::ReachableObjects(const Scope& scope)
+    : m_marked_classes(std::vector<const DexClass*>(scope.begin(), scope.end())),
+      m_marked_fields(scope_fields(scope)),
+      m_marked_methods(scope_methods(scope)) {}
+
 void ReachableObjects::record_reachability(const DexMethodRef* member,
                                            const DexClass* cls) {
   // Each class member trivially retains its containing class; let's filter out
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -88,8 +89,72 @@ using ReachableObjectSet =
 using ReachableObjectGraph =
     ConcurrentMap<ReachableObject, ReachableObjectSet, ReachableObjectHash>;
 
+/*
+ * The marks of one kind of object. The objects given to the constructor get
+ * a dense index and are marked in an atomic bitset, which takes no lock. Any
+ * other object, e.g. a reference to an external method, falls back to a
+ * ConcurrentSet.
+ */
+template <class T>
+class MarkSet {
+ public:
+  MarkSet() = default;
+
+  explicit MarkSet(const std::vector<const T*>& objects)
+      : m_bits((objects.size() + 63) / 64) {
+    m_ids.reserve(objects.size());
+    for (auto obj : objects) {
+      m_ids.emplace(obj, m_ids.size());
+    }
+  }
+
+  void insert(const T* obj) {
+    auto it = m_ids.find(obj);
+    if (it == m_ids.end()) {
+      m_others.insert(obj);
+      return;
+    }
+    m_bits[it->second / 64].fetch_or(uint64_t(1) << (it->second % 64),
+                                     std::memory_order_relaxed);
+  }
+
+  bool count(const T* obj) const {
+    auto it = m_ids.find(obj);
+    if (it == m_ids.end()) {
+      return m_others.count(obj);
+    }
+    return (m_bits[it->second / 64].load(std::memory_order_relaxed) >>
+            (it->second % 64)) &
+           1;
+  }
+
+  bool count_unsafe(const T* obj) const {
+    auto it = m_ids.find(obj);
+    if (it == m_ids.end()) {
+      return m_others.count_unsafe(obj);
+    }
+    return (m_bits[it->second / 64].load(std::memory_order_relaxed) >>
+            (it->second % 64)) &
+           1;
+  }
+
+ private:
+  // Never modified after construction, hence safe to read concurrently.
+  std::unordered_map<const T*, size_t> m_ids;
+  std::vector<std::atomic<uint64_t>> m_bits;
+  ConcurrentSet<const T*> m_others;
+};
+
 class ReachableObjects {
  public:
+  ReachableObjects() = default;
+
+  /*
+   * Index all the classes, methods and fields of the scope up front, so that
+   * marking them is cheap.
+   */
+  explicit ReachableObjects(const Scope& scope);
+
   const ReachableObjectGraph& retainers_of() const { return m_retainers_of; }
 
   void mark(const DexClass* cls) { m_marked_classes.insert(cls); }
@@ -134,9 +199,9 @@ class ReachableObjects {
 
   void record_reachability(const DexMethodRef* member, const DexClass* cls);
 
-  ConcurrentSet<const DexClass*> m_marked_classes;
-  ConcurrentSet<const DexFieldRef*> m_marked_fields;
-  ConcurrentSet<const DexMethodRef*> m_marked_methods;
+  MarkSet<DexClass> m_marked_classes;
+  MarkSet<DexFieldRef> m_marked_fields;
+  MarkSet<DexMethodRef> m_marked_methods;
   ReachableObjectGraph m_retainers_of;
 
   friend class RootSetMarker;
@@ -293,11 +358,14 @@ class TransitiveClosureMarker {
   MarkWorkerState* m_worker_state;
 };
 
+using MethodOverrideGraphCache = method_override_graph::GraphCache;
+
 std::unique_ptr<ReachableObjects> compute_reachable_objects(
     DexStoresVector& stores,
     const IgnoreSets& ignore_sets,
     int* num_ignore_check_strings,
-    bool record_reachability = false);
+    bool record_reachability = false,
+    MethodOverrideGraphCache* graph_cache = nullptr);
 
 void sweep(DexStoresVector& stores,
            const ReachableObjects& reachables,
@@ -135,6 +135,28 @@ void analyze_reflection(const Scope& scope) {
            }},
       };
 
+  // The same table, keyed by the interned types and names, so that most
+  // invokes are ruled out by a couple of pointer lookups. Classes and names
+  // that were never interned cannot be referenced by any invoke.
+  std::unordered_map<const DexType*,
+                     std::unordered_map<const DexString*, ReflectionType>>
+      refl_refs;
+  for (const auto& class_it : refls) {
+    auto type = DexType::get_type(class_it.first.c_str());
+    if (type == nullptr) {
+      continue;
+    }
+    for (const auto& method_it : class_it.second) {
+      auto name = DexString::get_string(method_it.first.c_str());
+      if (name != nullptr) {
+        refl_refs[type].emplace(name, method_it.second);
+      }
+    }
+  }
+  if (refl_refs.empty()) {
+    return;
+  }
+
   auto dex_string_lookup = [](const SimpleReflectionAnalysis& analysis,
                               ReflectionType refl_type,
                               IRInstruction* insn) {
@@ -159,19 +181,19 @@ void analyze_reflection(const Scope& scope) {
       }
 
       // See if it matches something in refls
-      auto& method_name = insn->get_method()->get_name()->str();
-      auto& method_class_name =
-          insn->get_method()->get_class()->get_name()->str();
-      auto method_map = refls.find(method_class_name);
-      if (method_map == refls.end()) {
+      auto method_map = refl_refs.find(insn->get_method()->get_class());
+      if (method_map == refl_refs.end()) {
         continue;
       }
 
-      auto refl_entry = method_map->second.find(method_name);
+      auto refl_entry = method_map->second.find(insn->get_method()->get_name());
       if (refl_entry == method_map->second.end()) {
         continue;
       }
       ReflectionType refl_type = refl_entry->second;
+      auto& method_name = insn->get_method()->get_name()->str();
+      auto& method_class_name =
+          insn->get_method()->get_class()->get_name()->str();
 
       // Instantiating the analysis object also runs the reflection analysis
       // on the method. So, we wait until we're sure we need it.
@@ -219,6 +241,11 @@ void analyze_reflection(const Scope& scope) {
         break;
       }
     }
+    if (analysis) {
+      // The results are keyed by instruction, so the cfg the analysis built
+      // is no longer needed, and later passes don't expect one.
+      code.clear_cfg();
+    }
   });
 }
 
@@ -312,11 +339,14 @@ void mark_onclick_attributes_reachable(
   TypeSet children;
   get_all_children(class_hierarchy, type_context, children);
 
+  Scope context_classes;
   for (const auto &t : children) {
     auto dclass = type_class(t);
-    if (dclass->is_external()) {
-      continue;
+    if (!dclass->is_external()) {
+      context_classes.push_back(dclass);
     }
+  }
+  walk::parallel::classes(context_classes, [&](DexClass* dclass) {
     // Methods are invoked via reflection. Only public methods are relevant.
     for (const auto &m : dclass->get_vmethods()) {
       if (matches_onclick_method(m, onclick_attribute_values)) {
@@ -328,7 +358,7 @@ void mark_onclick_attributes_reachable(
         m->rstate.set_referenced_by_resource_xml();
       }
     }
-  }
+  });
 }
 
 DexClass* maybe_class_from_string(const std::string& classname) {
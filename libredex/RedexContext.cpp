@@ -7,22 +7,49 @@
 
 #include "RedexContext.h"
 
+#include <algorithm>
 #include <exception>
 #include <mutex>
 #include <regex>
 #include <unordered_set>
 
+#include <boost/container/small_vector.hpp>
+
 #include "Debug.h"
 #include "DexClass.h"
+#include "DexPosition.h"
+#include "Resolver.h"
 
 RedexContext* g_redex;
 
-RedexContext::RedexContext() {}
+namespace {
+
+// FNV-1a. Also computes the length of the string, which comes for free.
+size_t hash_string(const char* s, size_t* len) {
+  size_t hash = 14695981039346656037ull;
+  const char* p = s;
+  for (; *p != '\0'; ++p) {
+    hash = (hash ^ static_cast<unsigned char>(*p)) * 1099511628211ull;
+  }
+  *len = p - s;
+  return hash;
+}
+
+} // namespace
+
+RedexContext::RedexContext(bool hashed_string_table)
+    : m_hashed_string_table(hashed_string_table) {
+  invalidate_method_resolution_cache();
+}
 
 RedexContext::~RedexContext() {
-  // Delete DexStrings.
-  for (auto const& p : s_string_map) {
-    delete p.second;
+  invalidate_method_resolution_cache();
+  // Destroy DexStrings. Their memory belongs to the shard arenas.
+  for (auto& shard : s_string_shards) {
+    for (auto const& p : shard.tree) {
+      p.second->~DexString();
+    }
+    shard.hashed.for_each([](DexString* str) { str->~DexString(); });
   }
   // Delete DexTypes.  NB: This table intentionally contains aliases (multiple
   // DexStrings map to the same DexType), so we have to dedup the set of types
@@ -38,10 +65,7 @@ RedexContext::~RedexContext() {
   for (auto const& it : s_field_map) {
     delete static_cast<DexField*>(it.second);
   }
-  // Delete DexTypeLists.
-  for (auto const& p : s_typelist_map) {
-    delete p.second;
-  }
+  // DexTypeLists are trivially destructible and belong to s_typelist_arena.
   // Delete DexProtos.
   for (auto const& p : s_proto_map) {
     delete p.second;
@@ -55,9 +79,11 @@ RedexContext::~RedexContext() {
     delete it.second;
   }
 
-  for (const auto& p : s_keep_reasons) {
+  for (const auto& p : s_position_origin_map) {
     delete p.second;
   }
+  // Keep reasons are trivially destructible and belong to
+  // m_keep_reasons_arena.
 }
 
 /*
@@ -84,25 +110,143 @@ static StoredValue* try_insert(Key key,
   return container->at(key);
 }
 
+DexString* RedexContext::HashedStringSet::find(size_t hash,
+                                               const char* s,
+                                               size_t len) const {
+  if (m_entries.empty()) {
+    return nullptr;
+  }
+  auto mask = m_entries.size() - 1;
+  for (auto i = hash & mask;; i = (i + 1) & mask) {
+    const auto& entry = m_entries[i];
+    if (entry.str == nullptr) {
+      return nullptr;
+    }
+    if (entry.hash == hash && entry.str->size() == len &&
+        memcmp(entry.str->c_str(), s, len) == 0) {
+      return entry.str;
+    }
+  }
+}
+
+void RedexContext::HashedStringSet::insert(size_t hash, DexString* str) {
+  // Keep the load factor at or below one half.
+  if (2 * (m_size + 1) > m_entries.size()) {
+    grow();
+  }
+  auto mask = m_entries.size() - 1;
+  auto i = hash & mask;
+  while (m_entries[i].str != nullptr) {
+    i = (i + 1) & mask;
+  }
+  m_entries[i] = Entry{hash, str};
+  ++m_size;
+}
+
+void RedexContext::HashedStringSet::grow() {
+  std::vector<Entry> old(std::max<size_t>(16, 2 * m_entries.size()),
+                         Entry{0, nullptr});
+  std::swap(old, m_entries);
+  m_size = 0;
+  for (const auto& entry : old) {
+    if (entry.str != nullptr) {
+      insert(entry.hash, entry.str);
+    }
+  }
+}
+
+DexString* RedexContext::find_string(StringShard& shard,
+                                     size_t hash,
+                                     const char* nstr,
+                                     size_t len) const {
+  if (m_hashed_string_table) {
+    return shard.hashed.find(hash, nstr, len);
+  }
+  auto it = shard.tree.find(nstr);
+  return it == shard.tree.end() ? nullptr : it->second;
+}
+
+size_t RedexContext::string_hash(const char* nstr, size_t* len) const {
+  return m_hashed_string_table ? hash_string(nstr, len)
+                               : TruncatedStringHash()(nstr);
+}
+
 DexString* RedexContext::make_string(const char* nstr, uint32_t utfsize) {
   always_assert(nstr != nullptr);
-  auto rv = s_string_map.get(nstr, nullptr);
+  size_t len = 0;
+  auto hash = string_hash(nstr, &len);
+  auto& shard = s_string_shards[hash % n_string_shards];
+  std::lock_guard<std::mutex> lock(shard.lock);
+  return make_string_locked(shard, hash, nstr, len, utfsize);
+}
+
+void RedexContext::make_strings(size_t n,
+                                const char* const* nstrs,
+                                const uint32_t* utfsizes,
+                                DexString** out) {
+  struct Key {
+    size_t shard;
+    size_t hash;
+    size_t len;
+    size_t idx;
+  };
+  std::vector<Key> keys(n);
+  for (size_t i = 0; i < n; ++i) {
+    always_assert(nstrs[i] != nullptr);
+    auto& key = keys[i];
+    key.hash = string_hash(nstrs[i], &key.len);
+    key.shard = key.hash % n_string_shards;
+    key.idx = i;
+  }
+  std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) {
+    return a.shard < b.shard;
+  });
+  for (auto it = keys.begin(); it != keys.end();) {
+    auto& shard = s_string_shards[it->shard];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    for (auto shard_idx = it->shard;
+         it != keys.end() && it->shard == shard_idx;
+         ++it) {
+      auto i = it->idx;
+      out[i] =
+          make_string_locked(shard, it->hash, nstrs[i], it->len, utfsizes[i]);
+    }
+  }
+}
+
+DexString* RedexContext::make_string_locked(StringShard& shard,
+                                            size_t hash,
+                                            const char* nstr,
+                                            size_t len,
+                                            uint32_t utfsize) {
+  auto rv = find_string(shard, hash, nstr, len);
   if (rv != nullptr) {
     return rv;
   }
-  // Note that DexStrings are keyed by the c_str() of the underlying
-  // std::string. The c_str is valid until a the string is destroyed, or until a
-  // non-const function is called on the string (but note the std::string itself
-  // is const)
-  auto dexstring = new DexString(nstr, utfsize);
-  return try_insert(dexstring->c_str(), dexstring, &s_string_map);
+  auto dexstring = new (shard.arena.allocate(sizeof(DexString),
+                                             alignof(DexString)))
+      DexString(nstr, utfsize);
+  if (m_hashed_string_table) {
+    shard.hashed.insert(hash, dexstring);
+  } else {
+    // Note that DexStrings are keyed by the c_str() of the underlying
+    // std::string. The c_str is valid until a the string is destroyed, or
+    // until a non-const function is called on the string (but note the
+    // std::string itself is const)
+    shard.tree.emplace(dexstring->c_str(), dexstring);
+  }
+  return dexstring;
 }
 
 DexString* RedexContext::get_string(const char* nstr, uint32_t utfsize) {
   if (nstr == nullptr) {
     return nullptr;
   }
-  return s_string_map.get(nstr, nullptr);
+  size_t len = 0;
+  auto hash = string_hash(nstr, &len);
+  auto& shard = s_string_shards[hash % n_string_shards];
+  std::lock_guard<std::mutex> lock(shard.lock);
+  return find_string(shard, hash, nstr, len);
 }
 
 DexType* RedexContext::make_type(DexString* dstring) {
@@ -114,6 +258,16 @@ DexType* RedexContext::make_type(DexString* dstring) {
   return try_insert(dstring, new DexType(dstring), &s_type_map);
 }
 
+void RedexContext::make_types(size_t n,
+                              DexString* const* dstrings,
+                              DexType** out) {
+  for (size_t i = 0; i < n; ++i) {
+    always_assert(dstrings[i] != nullptr);
+  }
+  s_type_map.get_or_emplace_all(
+      dstrings, n, out, [](DexString* dstring) { return new DexType(dstring); });
+}
+
 DexType* RedexContext::get_type(DexString* dstring) {
   if (dstring == nullptr) {
     return nullptr;
@@ -127,11 +281,12 @@ void RedexContext::set_type_name(DexType* type, DexString* new_name) {
 }
 
 void RedexContext::alias_type_name(DexType* type, DexString* new_name) {
+  // Checking and inserting in one step keeps this safe when types are renamed
+  // concurrently.
   always_assert_log(
-      !s_type_map.count(new_name),
+      s_type_map.emplace(new_name, type),
       "Bailing, attempting to alias a symbol that already exists! '%s'\n",
       new_name->c_str());
-  s_type_map.emplace(new_name, type);
 }
 
 void RedexContext::remove_type_name(DexString* name) { s_type_map.erase(name); }
@@ -200,17 +355,47 @@ void RedexContext::mutate_field(DexFieldRef* field,
   }
 }
 
+namespace {
+
+// Most type lists are short parameter lists, which this copies without
+// allocating.
+using TypeListBuffer = boost::container::small_vector<DexType*, 8>;
+
+} // namespace
+
 DexTypeList* RedexContext::make_type_list(std::deque<DexType*>&& p) {
-  auto rv = s_typelist_map.get(p, nullptr);
+  TypeListBuffer types(p.begin(), p.end());
+  TypeListKey key{types.data(), types.size(),
+                  boost::hash_range(types.begin(), types.end())};
+  auto rv = s_typelist_map.get(key, nullptr);
   if (rv != nullptr) {
     return rv;
   }
-  auto typelist = new DexTypeList(std::move(p));
-  return try_insert(typelist->m_list, typelist, &s_typelist_map);
+  static_assert(sizeof(DexTypeList) % alignof(DexType*) == 0,
+                "The types must be aligned after the DexTypeList");
+  DexTypeList* typelist;
+  {
+    std::lock_guard<std::mutex> lock(s_typelist_lock);
+    auto mem = s_typelist_arena.allocate(
+        sizeof(DexTypeList) + types.size() * sizeof(DexType*),
+        alignof(DexTypeList));
+    typelist = new (mem) DexTypeList(key.hash, types.size());
+  }
+  std::copy(types.begin(), types.end(), typelist->data());
+  key.types = typelist->data();
+  if (s_typelist_map.emplace(key, typelist)) {
+    return typelist;
+  }
+  // Another thread interned the same list first. The memory of ours stays in
+  // the arena, but this race is rare.
+  return s_typelist_map.at(key);
 }
 
 DexTypeList* RedexContext::get_type_list(std::deque<DexType*>&& p) {
-  return s_typelist_map.get(p, nullptr);
+  TypeListBuffer types(p.begin(), p.end());
+  TypeListKey key{types.data(), types.size(),
+                  boost::hash_range(types.begin(), types.end())};
+  return s_typelist_map.get(key, nullptr);
 }
 
 DexProto* RedexContext::make_proto(DexType* rtype,
@@ -257,6 +442,7 @@ DexMethodRef* RedexContext::get_method(DexType* type,
 
 void RedexContext::erase_method(DexMethodRef* method) {
   s_method_map.erase(method->m_spec);
+  invalidate_method_resolution_cache();
 }
 
 void RedexContext::mutate_method(DexMethodRef* method,
@@ -264,6 +450,7 @@ void RedexContext::mutate_method(DexMethodRef* method,
                                  bool rename_on_collision,
                                  bool update_deobfuscated_name) {
   std::lock_guard<std::mutex> lock(s_method_lock);
+  invalidate_method_resolution_cache();
   DexMethodSpec old_spec = method->m_spec;
   s_method_map.erase(method->m_spec);
 
@@ -354,8 +541,20 @@ void RedexContext::mutate_method(DexMethodRef* method,
   }
 }
 
+const DexPositionOrigin* RedexContext::make_position_origin(DexMethod* method,
+                                                            DexString* file) {
+  PositionOriginKey key(method, file);
+  auto rv = s_position_origin_map.get(key, nullptr);
+  if (rv != nullptr) {
+    return rv;
+  }
+  return try_insert(key, new DexPositionOrigin{method, file},
+                    &s_position_origin_map);
+}
+
 void RedexContext::publish_class(DexClass* cls) {
   std::lock_guard<std::mutex> l(m_type_system_mutex);
+  invalidate_method_resolution_cache();
   const DexType* type = cls->get_type();
   if (m_type_to_class.find(type) != end(m_type_to_class)) {
     const auto& prev_loc = m_type_to_class[type]->get_location();
@@ -378,10 +577,22 @@ void RedexContext::publish_class(DexClass* cls) {
       throw duplicate_class(class_name, dex_1, dex_2);
     }
   }
-  m_type_to_class.emplace(type, cls);
+  if (m_type_to_class.emplace(type, cls).second) {
+    type->m_class.store(cls, std::memory_order_release);
+  }
 }
 
 DexClass* RedexContext::type_class(const DexType* t) {
-  auto it = m_type_to_class.find(t);
-  return it != m_type_to_class.end() ? it->second : nullptr;
+  return t->m_class.load(std::memory_order_acquire);
+}
+
+const keep_reason::Reason* RedexContext::intern_keep_reason(
+    const keep_reason::Reason& reason) {
+  const keep_reason::Reason* interned;
+  s_keep_reasons.get_or_emplace_all(
+      &reason, 1, &interned, [this](const keep_reason::Reason& r) {
+        std::lock_guard<std::mutex> lock(m_keep_reasons_lock);
+        return m_keep_reasons_arena.make<keep_reason::Reason>(r);
+      });
+  return interned;
 }
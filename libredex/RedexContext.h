@@ -19,6 +19,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "Arena.h"
 #include "ConcurrentContainers.h"
 #include "DexMemberRefs.h"
 #include "KeepReason.h"
@@ -29,17 +30,24 @@ class DexType;
 class DexFieldRef;
 class DexTypeList;
 class DexProto;
+class DexMethod;
 class DexMethodRef;
 class DexClass;
 struct DexFieldSpec;
 struct DexDebugEntry;
 struct DexPosition;
+struct DexPositionOrigin;
 struct RedexContext;
 
 extern RedexContext* g_redex;
 
 struct RedexContext {
-  RedexContext();
+  /*
+   * With `hashed_string_table`, DexStrings are interned in open-addressing
+   * hash tables keyed by a hash of the whole string, computed once per lookup,
+   * instead of in trees ordered by strcmp. See StringShard below.
+   */
+  explicit RedexContext(bool hashed_string_table = false);
   ~RedexContext();
 
   DexString* make_string(const char* nstr, uint32_t utfsize);
@@ -48,6 +56,17 @@ struct RedexContext {
   DexType* make_type(DexString* dstring);
   DexType* get_type(DexString* dstring);
 
+  /*
+   * Batched make_string / make_type: out[i] is set to the interned value of
+   * the i-th key. The keys are grouped by shard, so that each lock is taken at
+   * most once per call instead of once per key.
+   */
+  void make_strings(size_t n,
+                    const char* const* nstrs,
+                    const uint32_t* utfsizes,
+                    DexString** out);
+  void make_types(size_t n, DexString* const* dstrings, DexType** out);
+
   /**
    * Change the name of a type, but do not remove the old name from the mapping
    */
@@ -92,6 +111,9 @@ struct RedexContext {
   DexDebugEntry* make_dbg_entry(DexDebugInstruction* opcode);
   DexDebugEntry* make_dbg_entry(DexPosition* pos);
 
+  const DexPositionOrigin* make_position_origin(DexMethod* method,
+                                                DexString* file);
+
   void publish_class(DexClass*);
   DexClass* type_class(const DexType* t);
   template <class TypeClassWalkerFn = void(const DexType*, const DexClass*)>
@@ -101,6 +123,60 @@ struct RedexContext {
     }
   }
 
+  /*
+   * Walk the interned objects, e.g. to count them. Nothing may be interned or
+   * erased meanwhile.
+   */
+  template <class Fn = void(const DexString*)>
+  void walk_strings(const Fn& fn) const {
+    for (const auto& shard : s_string_shards) {
+      if (m_hashed_string_table) {
+        shard.hashed.for_each(fn);
+      } else {
+        for (const auto& entry : shard.tree) {
+          fn(entry.second);
+        }
+      }
+    }
+  }
+
+  // Types are walked once per name they can be found by, which includes the
+  // old names of renamed types and the aliases.
+  template <class Fn = void(const DexString*, const DexType*)>
+  void walk_types(const Fn& fn) const {
+    for (const auto& entry : s_type_map) {
+      fn(entry.first, entry.second);
+    }
+  }
+
+  template <class Fn = void(const DexTypeList*)>
+  void walk_type_lists(const Fn& fn) const {
+    for (const auto& entry : s_typelist_map) {
+      fn(entry.second);
+    }
+  }
+
+  template <class Fn = void(const DexProto*)>
+  void walk_protos(const Fn& fn) const {
+    for (const auto& entry : s_proto_map) {
+      fn(entry.second);
+    }
+  }
+
+  template <class Fn = void(const DexFieldRef*)>
+  void walk_fields(const Fn& fn) const {
+    for (const auto& entry : s_field_map) {
+      fn(entry.second);
+    }
+  }
+
+  template <class Fn = void(const DexMethodRef*)>
+  void walk_methods(const Fn& fn) const {
+    for (const auto& entry : s_method_map) {
+      fn(entry.second);
+    }
+  }
+
   /*
    * This returns true if we want to preserve keep reasons for better
    * diagnostics.
@@ -110,38 +186,25 @@ struct RedexContext {
     g_redex->m_record_keep_reasons = v;
   }
 
+  /*
+   * Keep reasons are interned, so two reasons are equal iff they are the same
+   * object. Looking up a reason that already exists takes no lock and
+   * allocates nothing.
+   */
   template <class... Args>
-  static keep_reason::Reason* make_keep_reason(Args&&... args) {
-    auto to_insert =
-        std::make_unique<keep_reason::Reason>(std::forward<Args>(args)...);
-    if (g_redex->s_keep_reasons.emplace(to_insert.get(), to_insert.get())) {
-      return to_insert.release();
+  static const keep_reason::Reason* make_keep_reason(Args&&... args) {
+    keep_reason::Reason reason(std::forward<Args>(args)...);
+    auto interned = g_redex->s_keep_reasons.get(reason, nullptr);
+    if (interned != nullptr) {
+      return interned;
     }
-    return g_redex->s_keep_reasons.at(to_insert.get());
+    return g_redex->intern_keep_reason(reason);
   }
 
  private:
   struct Strcmp;
   struct TruncatedStringHash;
 
-  // We use this instead of an unordered_map-based ConcurrentMap because
-  // hashing is expensive on large strings -- it has to hash the entire key to
-  // find its bucket. An std::map (i.e. a tree) performs better with large keys
-  // in a sparse keyset because it only needs to find the first character that
-  // differs between keys when traversing the tree, meaning that it usually
-  // doesn't need to examine the entire key for insertions.
-  //
-  // We still need to do hashing in order to shard the keys across the
-  // individually-locked std::maps, but it suffices to hash a substring for this
-  // purpose.
-  template <typename Value, size_t n_slots = 31>
-  using ConcurrentLargeStringMap =
-      ConcurrentMapContainer<std::map<const char*, Value, Strcmp>,
-                             const char*,
-                             Value,
-                             TruncatedStringHash,
-                             n_slots>;
-
   struct Strcmp {
     bool operator()(const char* a, const char* b) const {
       return strcmp(a, b) < 0;
@@ -165,41 +228,153 @@ struct RedexContext {
     }
   };
 
+  // An open-addressing set of DexStrings that stores the full hash of each
+  // string next to it, so that neither growing the table nor probing it ever
+  // needs to rehash or compare the contents of non-matching strings.
+  class HashedStringSet {
+   public:
+    DexString* find(size_t hash, const char* s, size_t len) const;
+    // The string must not be present already.
+    void insert(size_t hash, DexString* str);
+
+    template <typename Fn>
+    void for_each(const Fn& fn) const {
+      for (const auto& entry : m_entries) {
+        if (entry.str != nullptr) {
+          fn(entry.str);
+        }
+      }
+    }
+
+   private:
+    struct Entry {
+      size_t hash;
+      DexString* str;
+    };
+    void grow();
+
+    std::vector<Entry> m_entries;
+    size_t m_size{0};
+  };
+
   // DexString
-  ConcurrentLargeStringMap<DexString*> s_string_map;
+  //
+  // Strings are interned in individually-locked shards. Each shard allocates
+  // its DexStrings and its tree nodes from its own arena, which saves two
+  // mallocs per string and keeps the strings of a shard close together.
+  //
+  // By default a shard is an std::map rather than a hash table, because
+  // hashing is expensive on large strings -- it has to hash the entire key to
+  // find its bucket. A tree performs better with large keys in a sparse keyset
+  // because it only needs to find the first character that differs between
+  // keys when traversing the tree, meaning that it usually doesn't need to
+  // examine the entire key for insertions. We still need to do hashing in order
+  // to shard the keys, but it suffices to hash a substring for this purpose.
+  //
+  // With m_hashed_string_table, the full hash is computed once instead and
+  // used both to pick the shard and to probe its HashedStringSet.
+  static constexpr size_t n_string_shards = 31;
+  using StringTree = std::map<
+      const char*,
+      DexString*,
+      Strcmp,
+      ArenaAllocator<std::pair<const char* const, DexString*>>>;
+  struct StringShard {
+    std::mutex lock;
+    Arena arena;
+    // Declared after `arena`, which must outlive it.
+    StringTree tree{Strcmp(), StringTree::allocator_type(&arena)};
+    HashedStringSet hashed;
+  };
+  StringShard s_string_shards[n_string_shards];
+  const bool m_hashed_string_table;
+
+  // `len` is only computed, and only needed, with m_hashed_string_table.
+  size_t string_hash(const char* nstr, size_t* len) const;
+  DexString* find_string(StringShard& shard,
+                         size_t hash,
+                         const char* nstr,
+                         size_t len) const;
+  // Must hold shard.lock.
+  DexString* make_string_locked(StringShard& shard,
+                                size_t hash,
+                                const char* nstr,
+                                size_t len,
+                                uint32_t utfsize);
+
+  // The type, proto and method tables below are read far more often than they
+  // are written once the input has been loaded, so they use lock-free reads.
 
   // DexType
-  ConcurrentMap<DexString*, DexType*> s_type_map;
+  ReadOptimizedConcurrentMap<DexString*, DexType*> s_type_map;
 
   // DexFieldRef
   ConcurrentMap<DexFieldSpec, DexFieldRef*> s_field_map;
   std::mutex s_field_lock;
 
   // DexTypeList
-  ConcurrentMap<std::deque<DexType*>,
-                DexTypeList*,
-                boost::hash<std::deque<DexType*>>>
+  //
+  // The keys point to the types stored inline in the interned lists, or, for
+  // lookups, to a temporary copy of the requested types. The lists, together
+  // with their types, are allocated from s_typelist_arena.
+  struct TypeListKey {
+    DexType* const* types;
+    size_t size;
+    size_t hash;
+  };
+  struct TypeListKeyHash {
+    size_t operator()(const TypeListKey& key) const { return key.hash; }
+  };
+  struct TypeListKeyEqual {
+    bool operator()(const TypeListKey& a, const TypeListKey& b) const {
+      return a.hash == b.hash && a.size == b.size &&
+             std::equal(a.types, a.types + a.size, b.types);
+    }
+  };
+  ReadOptimizedConcurrentMap<TypeListKey,
+                             DexTypeList*,
+                             TypeListKeyHash,
+                             TypeListKeyEqual>
       s_typelist_map;
+  std::mutex s_typelist_lock;
+  Arena s_typelist_arena;
 
   // DexProto
   using ProtoKey = std::pair<DexType*, DexTypeList*>;
-  ConcurrentMap<ProtoKey, DexProto*, boost::hash<ProtoKey>> s_proto_map;
+  ReadOptimizedConcurrentMap<ProtoKey, DexProto*, boost::hash<ProtoKey>>
+      s_proto_map;
 
   // DexMethod
-  ConcurrentMap<DexMethodSpec, DexMethodRef*> s_method_map;
+  ReadOptimizedConcurrentMap<DexMethodSpec, DexMethodRef*> s_method_map;
   std::mutex s_method_lock;
 
-  // Type-to-class map and class hierarchy
+  // DexPositionOrigin
+  using PositionOriginKey = std::pair<DexMethod*, DexString*>;
+  ConcurrentMap<PositionOriginKey,
+                DexPositionOrigin*,
+                boost::hash<PositionOriginKey>>
+      s_position_origin_map;
+
+  // Type-to-class map and class hierarchy. Lookups go through the class
+  // pointer on DexType instead; the map is kept for walk_type_class and for
+  // freeing the classes.
   std::mutex m_type_system_mutex;
   std::unordered_map<const DexType*, DexClass*> m_type_to_class;
 
   const std::vector<const DexType*> m_empty_types;
 
-  ConcurrentMap<keep_reason::Reason*,
-                keep_reason::Reason*,
-                keep_reason::ReasonPtrHash,
-                keep_reason::ReasonPtrEqual>
+  // Keep reasons. They are allocated from an arena since there can be one per
+  // keep rule, reflection site, etc., and they all live as long as the
+  // context.
+  ReadOptimizedConcurrentMap<keep_reason::Reason,
+                             const keep_reason::Reason*,
+                             boost::hash<keep_reason::Reason>>
       s_keep_reasons;
+  std::mutex m_keep_reasons_lock;
+  Arena m_keep_reasons_arena{4 * 1024, 64 * 1024};
+
+  const keep_reason::Reason* intern_keep_reason(
+      const keep_reason::Reason& reason);
 
   bool m_record_keep_reasons{false};
 };
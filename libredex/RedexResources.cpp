@@ -17,6 +17,8 @@
 #include <fcntl.h>
 #include <fstream>
 #include <map>
+#include <mutex>
+#include <numeric>
 #include <sstream>
 #include <string>
 
@@ -45,7 +47,9 @@
 #include "utils/TypeHelpers.h"
 #include <json/json.h>
 
+#include "ArscView.h"
 #include "Debug.h"
+#include "Parallel.h"
 #include "StringUtil.h"
 
 constexpr size_t MIN_CLASSNAME_LENGTH = 10;
@@ -57,6 +61,37 @@ using path_t = boost::filesystem::path;
 using dir_iterator = boost::filesystem::directory_iterator;
 using rdir_iterator = boost::filesystem::recursive_directory_iterator;
 
+namespace {
+
+/*
+ * What was read from a layout file, along with the size and modification
+ * time of the file at that point. Redex reads the layouts several times, and
+ * only rewrites a few of them in between.
+ */
+struct LayoutContents {
+  std::unordered_set<std::string> classes;
+  std::unordered_multimap<std::string, std::string> attributes;
+};
+
+struct CachedLayout {
+  off_t size;
+  time_t mtime;
+  std::unordered_set<std::string> attributes_read;
+  LayoutContents contents;
+};
+
+std::mutex s_layout_cache_mutex;
+std::unordered_map<std::string, CachedLayout> s_layout_cache;
+
+// Must be called whenever a file that may be a layout is written, since a
+// rewrite within the same second with the same size would go unnoticed.
+void invalidate_cached_layout(const std::string& file_path) {
+  std::lock_guard<std::mutex> lock(s_layout_cache_mutex);
+  s_layout_cache.erase(file_path);
+}
+
+} // namespace
+
 std::string convert_from_string16(const android::String16& string16) {
   android::String8 string8(string16);
   std::string converted(string8.string());
@@ -418,13 +453,14 @@ std::string read_attribute_name_at_idx(const android::ResXMLTree& parser,
 }
 
 void extract_classes_from_layout(
-    const std::string& layout_contents,
+    const char* data,
+    size_t size,
     const std::unordered_set<std::string>& attributes_to_read,
     std::unordered_set<std::string>& out_classes,
     std::unordered_multimap<std::string, std::string>& out_attributes) {
 
   android::ResXMLTree parser;
-  parser.setTo(layout_contents.data(), layout_contents.size());
+  parser.setTo(data, size);
 
   android::String16 name("name");
   android::String16 klazz("class");
@@ -550,6 +586,7 @@ std::string read_entire_file(const std::string& filename) {
 void write_entire_file(
     const std::string& filename,
     const std::string& contents) {
+  invalidate_cached_layout(filename);
   std::ofstream out(filename, std::ofstream::binary);
   out << contents;
 }
@@ -738,6 +775,16 @@ std::unordered_set<uint32_t> get_js_resources(
   return js_assets;
 }
 
+std::map<std::string, std::vector<uint32_t>> get_resources_name_to_ids(
+    const std::string& arsc_path) {
+  int file_desc;
+  size_t len;
+  auto fp = map_file(arsc_path.c_str(), &file_desc, &len);
+  auto name_to_ids = arsc::get_name_to_ids(arsc::TableView(fp, len));
+  unmap_and_close(file_desc, fp, len);
+  return name_to_ids;
+}
+
 std::unordered_set<uint32_t> get_resources_by_name_prefix(
     const std::vector<std::string>& prefixes,
     const std::map<std::string, std::vector<uint32_t>>& name_to_ids) {
@@ -939,17 +986,56 @@ std::vector<std::string> find_layout_files(const std::string& apk_directory) {
   return layout_files;
 }
 
+namespace {
+
+LayoutContents read_layout(
+    const std::string& file_path,
+    const std::unordered_set<std::string>& attributes_to_read) {
+  LayoutContents result;
+  struct stat st = {};
+  bool has_stat = stat(file_path.c_str(), &st) == 0;
+  if (has_stat) {
+    std::lock_guard<std::mutex> lock(s_layout_cache_mutex);
+    auto it = s_layout_cache.find(file_path);
+    if (it != s_layout_cache.end() && it->second.size == st.st_size &&
+        it->second.mtime == st.st_mtime &&
+        it->second.attributes_read == attributes_to_read) {
+      return it->second.contents;
+    }
+  }
+  // An empty or unreadable file has nothing to parse, and can't be mapped.
+  if (!has_stat || st.st_size == 0) {
+    return result;
+  }
+  int file_desc;
+  size_t len;
+  void* fp;
+  try {
+    fp = map_file(file_path.c_str(), &file_desc, &len);
+  } catch (const std::runtime_error&) {
+    return result;
+  }
+  extract_classes_from_layout(static_cast<const char*>(fp), len,
+                              attributes_to_read, result.classes,
+                              result.attributes);
+  unmap_and_close(file_desc, fp, len);
+
+  std::lock_guard<std::mutex> lock(s_layout_cache_mutex);
+  s_layout_cache[file_path] =
+      CachedLayout{st.st_size, st.st_mtime, attributes_to_read, result};
+  return result;
+}
+
+} // namespace
+
 void collect_layout_classes_and_attributes_for_file(
     const std::string& file_path,
     const std::unordered_set<std::string>& attributes_to_read,
     std::unordered_set<std::string>& out_classes,
     std::unordered_multimap<std::string, std::string>& out_attributes) {
-  std::string contents = read_entire_file(file_path);
-  extract_classes_from_layout(
-    contents,
-    attributes_to_read,
-    out_classes,
-    out_attributes);
+  auto contents = read_layout(file_path, attributes_to_read);
+  out_classes.insert(contents.classes.begin(), contents.classes.end());
+  out_attributes.insert(contents.attributes.begin(), contents.attributes.end());
 }
 
 void collect_layout_classes_and_attributes(
@@ -958,12 +1044,15 @@ void collect_layout_classes_and_attributes(
     std::unordered_set<std::string>& out_classes,
     std::unordered_multimap<std::string, std::string>& out_attributes) {
   std::vector<std::string> files = find_layout_files(apk_directory);
-  for (auto layout_file : files) {
-    collect_layout_classes_and_attributes_for_file(
-      layout_file,
-      attributes_to_read,
-      out_classes,
-      out_attributes);
+  std::vector<LayoutContents> contents(files.size());
+  std::vector<size_t> indices(files.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    contents[i] = read_layout(files[i], attributes_to_read);
+  });
+  for (const auto& layout : contents) {
+    out_classes.insert(layout.classes.begin(), layout.classes.end());
+    out_attributes.insert(layout.attributes.begin(), layout.attributes.end());
   }
 }
 
@@ -1182,6 +1271,7 @@ int rename_classes_in_layout(
   size_t* out_num_renamed,
   ssize_t* out_size_delta) {
 
+  invalidate_cached_layout(file_path);
   int file_desc;
   size_t len;
   auto fp = map_file(file_path.c_str(), &file_desc, &len, true);
@@ -1199,3 +1289,64 @@ int rename_classes_in_layout(
   *out_size_delta = serialized.size() - len;
   return android::OK;
 }
+
+namespace {
+
+// Whether the ResStringPool of a binary XML file has any string to rename.
+// Much cheaper than replace_in_xml_string_pool, which builds a new pool.
+bool xml_string_pool_has_any(
+    const void* data,
+    const size_t len,
+    const std::map<std::string, std::string>& shortened_names) {
+  const auto chunk_size = sizeof(android::ResChunk_header);
+  const auto pool_header_size =
+    (uint16_t) sizeof(android::ResStringPool_header);
+  if (len < chunk_size + pool_header_size) {
+    return false;
+  }
+  auto pool_ptr = (android::ResStringPool_header*) ((char*) data + chunk_size);
+  if (dtohs(pool_ptr->header.type) != android::RES_STRING_POOL_TYPE) {
+    return false;
+  }
+  android::ResStringPool pool(pool_ptr, dtohl(pool_ptr->header.size));
+  for (size_t i = 0; i < pool_ptr->stringCount; i++) {
+    auto str = arsc::string_at(pool, i);
+    if (shortened_names.count(str)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+void rename_classes_in_layouts(
+    const std::vector<std::string>& file_paths,
+    const std::map<std::string, std::string>& shortened_names,
+    size_t* out_num_renamed,
+    ssize_t* out_size_delta) {
+  std::vector<size_t> num_renamed(file_paths.size(), 0);
+  std::vector<ssize_t> size_delta(file_paths.size(), 0);
+  std::vector<size_t> indices(file_paths.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    const auto& file_path = file_paths[i];
+    struct stat st = {};
+    if (stat(file_path.c_str(), &st) != 0 || st.st_size == 0) {
+      return;
+    }
+    int file_desc;
+    size_t len;
+    auto fp = map_file(file_path.c_str(), &file_desc, &len);
+    bool has_any = xml_string_pool_has_any(fp, len, shortened_names);
+    unmap_and_close(file_desc, fp, len);
+    if (has_any) {
+      rename_classes_in_layout(
+          file_path, shortened_names, &num_renamed[i], &size_delta[i]);
+    }
+  });
+  for (size_t i = 0; i < file_paths.size(); i++) {
+    *out_num_renamed += num_renamed[i];
+    *out_size_delta += size_delta[i];
+  }
+}
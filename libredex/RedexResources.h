@@ -98,7 +98,8 @@ void remap_xml_reference_attributes(
 // Iterates through all layouts in the given directory. Adds all class names to
 // the output set, and allows for any specified attribute values to be returned
 // as well. Attribute names should specify their namespace, if any (so
-// android:onClick instead of just onClick)
+// android:onClick instead of just onClick). The layouts are parsed in
+// parallel, and what was read from a layout is reused until the file changes.
 void collect_layout_classes_and_attributes(
     const std::string& apk_directory,
     const std::unordered_set<std::string>& attributes_to_read,
@@ -138,6 +139,16 @@ int rename_classes_in_layout(
     size_t* out_num_renamed,
     ssize_t* out_size_delta);
 
+// Same as above for many files, which are processed in parallel. Only the
+// files whose ResStringPool has a string to rename are rewritten. Adds the
+// number of strings renamed and the change in size of all the files to the
+// output params.
+void rename_classes_in_layouts(
+    const std::vector<std::string>& file_paths,
+    const std::map<std::string, std::string>& shortened_names,
+    size_t* out_num_renamed,
+    ssize_t* out_size_delta);
+
 /**
  * Follows the reference links for a resource for all configurations.
  * Outputs all the nodes visited, as well as all the string values seen.
@@ -148,6 +159,11 @@ void walk_references_for_resource(
     std::unordered_set<uint32_t>* nodes_visited,
     std::unordered_set<std::string>* leaf_string_values);
 
+// Maps each resource name in the given resources.arsc to the ids of the
+// resources with that name, without loading the whole ResTable.
+std::map<std::string, std::vector<uint32_t>> get_resources_name_to_ids(
+    const std::string& arsc_path);
+
 std::unordered_set<uint32_t> get_js_resources(
     const std::string& directory,
     const std::vector<std::string>& js_assets_lists,
@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ReferenceIndex.h"
+
+#include <algorithm>
+#include <numeric>
+#include <unordered_set>
+
+#include "DexUtil.h"
+#include "IRCode.h"
+#include "Parallel.h"
+#include "Walkers.h"
+
+namespace {
+
+const ReferenceIndex::Referrers s_no_referrers;
+
+} // namespace
+
+ReferenceIndex::ReferenceIndex(const Scope& scope) {
+  std::vector<DexMethod*> methods;
+  walk::code(scope, [&](DexMethod* method, IRCode&) {
+    methods.push_back(method);
+  });
+  update_methods(methods);
+}
+
+std::vector<ReferenceIndex::Ref> ReferenceIndex::gather_refs(
+    const DexMethod* method) {
+  std::vector<Ref> refs;
+  auto code = method->get_code();
+  if (code == nullptr) {
+    return refs;
+  }
+  for (const auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    if (insn->has_type() && insn->get_type() != nullptr) {
+      refs.push_back(
+          {Kind::TYPE, get_array_type_or_self(insn->get_type()), insn});
+    } else if (insn->has_method()) {
+      refs.push_back({Kind::METHOD, insn->get_method(), insn});
+    } else if (insn->has_field()) {
+      refs.push_back({Kind::FIELD, insn->get_field(), insn});
+    }
+  }
+  return refs;
+}
+
+void ReferenceIndex::update_methods(const std::vector<DexMethod*>& methods) {
+  std::vector<std::vector<Ref>> refs(methods.size());
+  std::vector<size_t> indices(methods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(),
+               [&](size_t i) { refs[i] = gather_refs(methods[i]); });
+  for (size_t i = 0; i < methods.size(); ++i) {
+    remove_method(methods[i]);
+    add(methods[i], std::move(refs[i]));
+  }
+}
+
+void ReferenceIndex::add(DexMethod* method, std::vector<Ref> refs) {
+  for (const auto& ref : refs) {
+    map(ref.kind)[ref.ref].push_back({method, ref.insn});
+  }
+  m_method_refs.emplace(method, std::move(refs));
+}
+
+void ReferenceIndex::remove_method(DexMethod* method) {
+  auto it = m_method_refs.find(method);
+  if (it == m_method_refs.end()) {
+    return;
+  }
+  // A method often references the same thing many times, and all of its
+  // referrers go at once.
+  std::unordered_set<const void*> removed;
+  for (const auto& ref : it->second) {
+    if (!removed.insert(ref.ref).second) {
+      continue;
+    }
+    auto& refs_map = map(ref.kind);
+    auto referrers_it = refs_map.find(ref.ref);
+    auto& referrers = referrers_it->second;
+    referrers.erase(std::remove_if(referrers.begin(), referrers.end(),
+                                   [&](const Referrer& referrer) {
+                                     return referrer.method == method;
+                                   }),
+                    referrers.end());
+    if (referrers.empty()) {
+      refs_map.erase(referrers_it);
+    }
+  }
+  m_method_refs.erase(it);
+}
+
+ReferenceIndex::Map& ReferenceIndex::map(Kind kind) {
+  switch (kind) {
+  case Kind::TYPE:
+    return m_types;
+  case Kind::METHOD:
+    return m_methods;
+  case Kind::FIELD:
+    return m_fields;
+  }
+  not_reached();
+}
+
+const ReferenceIndex::Referrers& ReferenceIndex::find(const Map& map,
+                                                      const void* ref) const {
+  auto it = map.find(ref);
+  return it == map.end() ? s_no_referrers : it->second;
+}
+
+const ReferenceIndex::Referrers& ReferenceIndex::type_referrers(
+    const DexType* type) const {
+  return find(m_types, type);
+}
+
+const ReferenceIndex::Referrers& ReferenceIndex::method_referrers(
+    const DexMethodRef* method) const {
+  return find(m_methods, method);
+}
+
+const ReferenceIndex::Referrers& ReferenceIndex::field_referrers(
+    const DexFieldRef* field) const {
+  return find(m_fields, field);
+}
@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "DexClass.h"
+
+class IRInstruction;
+
+/*
+ * Maps every type, method and field to the instructions that reference it, so
+ * that passes can find who references something without walking the whole
+ * scope.
+ *
+ * An instruction references the type, method or field it holds. The referrers
+ * of a type also include the instructions that hold an array of it. The index
+ * does not look at method signatures, field types or annotations.
+ *
+ * The index is built in parallel once, and then kept up to date by the passes
+ * that change code: after changing the code of some methods, or adding
+ * methods, a pass calls update_methods() on them. Referrers are in scope order
+ * after the index is built, and in no particular order after an update.
+ *
+ * This is not thread-safe, except for concurrent lookups.
+ */
+class ReferenceIndex {
+ public:
+  struct Referrer {
+    DexMethod* method;
+    IRInstruction* insn;
+
+    bool operator==(const Referrer& other) const {
+      return method == other.method && insn == other.insn;
+    }
+  };
+
+  using Referrers = std::vector<Referrer>;
+
+  explicit ReferenceIndex(const Scope& scope);
+
+  const Referrers& type_referrers(const DexType* type) const;
+
+  const Referrers& method_referrers(const DexMethodRef* method) const;
+
+  const Referrers& field_referrers(const DexFieldRef* field) const;
+
+  /*
+   * Re-indexes the code of `methods`, which may not have been indexed before.
+   * The code is gathered in parallel.
+   */
+  void update_methods(const std::vector<DexMethod*>& methods);
+
+  /*
+   * Forgets the references of a method that is removed, or whose code is.
+   */
+  void remove_method(DexMethod* method);
+
+  // The number of indexed methods.
+  size_t size() const { return m_method_refs.size(); }
+
+ private:
+  enum class Kind : uint8_t { TYPE, METHOD, FIELD };
+
+  struct Ref {
+    Kind kind;
+    const void* ref;
+    IRInstruction* insn;
+  };
+
+  using Map = std::unordered_map<const void*, Referrers>;
+
+  static std::vector<Ref> gather_refs(const DexMethod* method);
+
+  void add(DexMethod* method, std::vector<Ref> refs);
+
+  Map& map(Kind kind);
+
+  const Referrers& find(const Map& map, const void* ref) const;
+
+  Map m_types;
+  Map m_methods;
+  Map m_fields;
+  std::unordered_map<const DexMethod*, std::vector<Ref>> m_method_refs;
+};
@@ -6,10 +6,49 @@
  */
 
 #include "Resolver.h"
+
+#include <atomic>
+
+#include "ConcurrentContainers.h"
 #include "DexUtil.h"
 
 namespace {
 
+struct MethodResolutionKey {
+  DexMethodRef* method;
+  MethodSearch search;
+
+  bool operator==(const MethodResolutionKey& other) const {
+    return method == other.method && search == other.search;
+  }
+};
+
+struct MethodResolutionKeyHash {
+  size_t operator()(const MethodResolutionKey& key) const {
+    return std::hash<DexMethodRef*>()(key.method) * 31 +
+           static_cast<size_t>(key.search);
+  }
+};
+
+// An entry is only valid if it was computed in the current generation.
+// Invalidating the cache just starts a new generation, so that it never races
+// with lookups.
+struct MethodResolution {
+  DexMethod* def;
+  uint64_t generation;
+};
+
+std::atomic<uint64_t> s_method_resolution_generation{0};
+
+ConcurrentMap<MethodResolutionKey, MethodResolution, MethodResolutionKeyHash>&
+method_resolution_cache() {
+  // Never destroyed: passes may still resolve during static destruction.
+  static auto* s_cache = new ConcurrentMap<MethodResolutionKey,
+                                           MethodResolution,
+                                           MethodResolutionKeyHash>();
+  return *s_cache;
+}
+
 inline bool match(const DexString* name,
                   const DexProto* proto,
                   const DexMethod* cls_meth) {
@@ -134,6 +173,28 @@ DexField* resolve_field(
   return nullptr;
 }
 
+DexMethod* resolve_method_cached(DexMethodRef* method, MethodSearch search) {
+  if (method->is_def()) return static_cast<DexMethod*>(method);
+  // Read the generation first, so that an invalidation that happens while
+  // resolving makes the new entry stale.
+  auto generation = s_method_resolution_generation.load();
+  auto& cache = method_resolution_cache();
+  MethodResolutionKey key{method, search};
+  auto cached = cache.get(key, MethodResolution{nullptr, 0});
+  if (cached.def != nullptr && cached.generation == generation) {
+    return cached.def;
+  }
+  auto def = resolve_method(method, search);
+  if (def != nullptr) {
+    cache.insert_or_assign(std::make_pair(key, MethodResolution{def, generation}));
+  }
+  return def;
+}
+
+void invalidate_method_resolution_cache() {
+  ++s_method_resolution_generation;
+}
+
 DexMethod* find_top_impl(
     const DexClass* cls, const DexString* name, const DexProto* proto) {
   DexMethod* top_impl = nullptr;
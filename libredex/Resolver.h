@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "IRInstruction.h"
@@ -16,6 +17,7 @@
 
 
 using MethodRefCache = std::unordered_map<DexMethodRef*, DexMethod*>;
+using ConcurrentMethodRefCache = ConcurrentMap<DexMethodRef*, DexMethod*>;
 using MethodSet = std::unordered_set<DexMethod*>;
 
 /**
@@ -153,6 +155,43 @@ inline DexMethod* resolve_method(
   return mdef;
 }
 
+/**
+ * Same as above, but the cache may be shared by several threads.
+ */
+inline DexMethod* resolve_method(DexMethodRef* method,
+                                 MethodSearch search,
+                                 ConcurrentMethodRefCache& ref_cache) {
+  if (method->is_def()) return static_cast<DexMethod*>(method);
+  auto def = ref_cache.get(method, nullptr);
+  if (def != nullptr) {
+    return def;
+  }
+  auto mdef = resolve_method(method, search);
+  if (mdef != nullptr) {
+    ref_cache.emplace(method, mdef);
+  }
+  return mdef;
+}
+
+/**
+ * Resolve a method through a memo table keyed by (method, search) that is
+ * shared by all passes and threads, and is safe to use from walk::parallel
+ * regions.
+ * If the method is already a definition return itself.
+ * If the type the method belongs to is unknown return nullptr.
+ * The memo table is invalidated when a method is renamed, erased, added to or
+ * removed from a class, when a class's super class or interfaces change, when
+ * a class is published, and before every pass. A pass that edits the method
+ * lists of classes directly must call invalidate_method_resolution_cache().
+ */
+DexMethod* resolve_method_cached(DexMethodRef* method, MethodSearch search);
+
+/**
+ * Forget all the resolutions memoized by resolve_method_cached(). This is
+ * thread-safe and takes constant time.
+ */
+void invalidate_method_resolution_cache();
+
 /**
  * Given a scope defined by DexClass, a name and a proto look for the vmethod
  * on the top ancestor. Essentially finds where the method was introduced.
@@ -620,11 +620,9 @@ std::ostream& operator<<(std::ostream& o, const DexType& type) {
 // This format must match the proguard map format because it's used to look up
 // in the proguard map
 std::string show(const DexFieldRef* p) {
-  if (!p) return "";
-  string_builders::StaticStringBuilder<5> b;
-  b << show(p->get_class()) << "." << show(p->get_name()) << ":"
-    << show(p->get_type());
-  return b.str();
+  std::string out;
+  show_to(out, p);
+  return out;
 }
 
 std::ostream& operator<<(std::ostream& o, const DexFieldRef& p) {
@@ -671,22 +669,17 @@ std::string vshow(const DexProto* p, bool include_ret_type = true) {
 // This format must match the proguard map format because it's used to look up
 // in the proguard map
 std::string show(const DexTypeList* p) {
-  if (!p) return "";
-  const auto& type_list = p->get_type_list();
-  string_builders::DynamicStringBuilder b(type_list.size());
-  for (auto const type : type_list) {
-    b << show(type);
-  }
-  return b.str();
+  std::string out;
+  show_to(out, p);
+  return out;
 }
 
 // This format must match the proguard map format because it's used to look up
 // in the proguard map
 std::string show(const DexProto* p) {
-  if (!p) return "";
-  string_builders::StaticStringBuilder<4> b;
-  b << "(" << show(p->get_args()) << ")" << show(p->get_rtype());
-  return b.str();
+  std::string out;
+  show_to(out, p);
+  return out;
 }
 
 std::string show(const DexCode* code) {
@@ -706,11 +699,54 @@ std::string show(const DexCode* code) {
 // This format must match the proguard map format because it's used to look up
 // in the proguard map
 std::string show(const DexMethodRef* p) {
-  if (!p) return "";
-  string_builders::StaticStringBuilder<5> b;
-  b << show(p->get_class()) << "." << show(p->get_name()) << ":"
-    << show(p->get_proto());
-  return b.str();
+  std::string out;
+  show_to(out, p);
+  return out;
+}
+
+void show_to(std::string& out, const DexString* p) {
+  if (p) out.append(p->str());
+}
+
+void show_to(std::string& out, const DexType* p) {
+  if (p) show_to(out, p->get_name());
+}
+
+void show_to(std::string& out, const DexClass* p) {
+  if (p) show_to(out, p->get_type());
+}
+
+void show_to(std::string& out, const DexTypeList* p) {
+  if (!p) return;
+  for (auto const type : p->get_type_list()) {
+    show_to(out, type);
+  }
+}
+
+void show_to(std::string& out, const DexProto* p) {
+  if (!p) return;
+  out.push_back('(');
+  show_to(out, p->get_args());
+  out.push_back(')');
+  show_to(out, p->get_rtype());
+}
+
+void show_to(std::string& out, const DexFieldRef* p) {
+  if (!p) return;
+  show_to(out, p->get_class());
+  out.push_back('.');
+  show_to(out, p->get_name());
+  out.push_back(':');
+  show_to(out, p->get_type());
+}
+
+void show_to(std::string& out, const DexMethodRef* p) {
+  if (!p) return;
+  show_to(out, p->get_class());
+  out.push_back('.');
+  show_to(out, p->get_name());
+  out.push_back(':');
+  show_to(out, p->get_proto());
 }
 
 std::string vshow(uint32_t acc, bool is_method) {
@@ -950,10 +986,10 @@ std::string show(const DexDebugInstruction* insn) {
 }
 
 std::ostream& operator<<(std::ostream& o, const DexPosition& pos) {
-  if (pos.file == nullptr) {
+  if (pos.file() == nullptr) {
     o << "Unknown source";
   } else {
-    o << *pos.file;
+    o << *pos.file();
   }
   o << ":" << pos.line;
   if (pos.parent != nullptr) {
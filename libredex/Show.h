@@ -120,6 +120,18 @@ std::string show(const MethodBlock*);
 std::string show(const ir_list::InstructionIterable&);
 std::string show(const SwitchIndices& si);
 
+/*
+ * Append what `show` returns to `out`, without a stream or a temporary string,
+ * so that a buffer can be reused across the names of many members.
+ */
+void show_to(std::string& out, const DexString*);
+void show_to(std::string& out, const DexType*);
+void show_to(std::string& out, const DexClass*);
+void show_to(std::string& out, const DexTypeList*);
+void show_to(std::string& out, const DexProto*);
+void show_to(std::string& out, const DexFieldRef*);
+void show_to(std::string& out, const DexMethodRef*);
+
 // Variants of show that use deobfuscated names
 std::string show_deobfuscated(const DexType* t);
 std::string show_deobfuscated(const DexClass*);
@@ -0,0 +1,231 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#if defined(__SANITIZE_ADDRESS__)
+#define REDEX_SLAB_ALLOCATOR_DISABLED 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define REDEX_SLAB_ALLOCATOR_DISABLED 1
+#endif
+#endif
+
+/**
+ * Hands out fixed-size blocks of memory for one kind of object. Each thread
+ * carves blocks out of its own slabs and keeps the blocks it frees on its own
+ * free list, so allocating and freeing takes no lock and objects that are
+ * created together end up next to each other. A thread only takes the shared
+ * lock when it needs a new slab, when its free list grows past a couple of
+ * slabs' worth of blocks (one thread freeing what another allocated), and when
+ * it exits, giving its free blocks back to the shared list.
+ *
+ * Slabs are never returned to the system, so this is meant for objects that
+ * are created and destroyed over and over, like IR instructions.
+ *
+ * Under AddressSanitizer every block comes from operator new instead, so that
+ * use-after-free bugs are still caught.
+ */
+template <size_t size, size_t alignment = alignof(std::max_align_t)>
+class SlabAllocator {
+ public:
+  static void* allocate() {
+#ifdef REDEX_SLAB_ALLOCATOR_DISABLED
+    return ::operator new(size);
+#else
+    if (t_cache_destroyed) {
+      return allocate_shared();
+    }
+    return cache().allocate();
+#endif
+  }
+
+  static void deallocate(void* ptr) {
+#ifdef REDEX_SLAB_ALLOCATOR_DISABLED
+    ::operator delete(ptr);
+#else
+    if (t_cache_destroyed) {
+      deallocate_shared(ptr);
+      return;
+    }
+    cache().deallocate(ptr);
+#endif
+  }
+
+ private:
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  static constexpr size_t BLOCK_ALIGNMENT =
+      std::max(alignment, alignof(FreeBlock));
+  static constexpr size_t BLOCK_SIZE =
+      (std::max(size, sizeof(FreeBlock)) + BLOCK_ALIGNMENT - 1) /
+      BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+  static constexpr size_t SLAB_SIZE = 64 * 1024;
+  static_assert(BLOCK_SIZE <= SLAB_SIZE, "Block size too large for a slab");
+  static constexpr size_t BLOCKS_PER_SLAB = SLAB_SIZE / BLOCK_SIZE;
+  // A thread's free list is trimmed by a slab's worth of blocks once it holds
+  // more than this many, and a refill takes at most a slab's worth.
+  static constexpr size_t MAX_LOCAL_FREE = 2 * BLOCKS_PER_SLAB;
+
+  struct Shared {
+    std::mutex lock;
+    FreeBlock* free{nullptr};
+    std::vector<std::unique_ptr<char[]>> slabs;
+
+    // Requires `lock` to be held.
+    char* new_slab() {
+      // operator new[] returns memory aligned for any fundamental type.
+      slabs.emplace_back(new char[SLAB_SIZE]);
+      return slabs.back().get();
+    }
+
+    // Requires `lock` to be held. Pushes the list from `first` to `last`.
+    void push(FreeBlock* first, FreeBlock* last) {
+      last->next = free;
+      free = first;
+    }
+  };
+
+  // Never destroyed: threads may still free blocks during static destruction.
+  static Shared& shared() {
+    static Shared* s_shared = new Shared();
+    return *s_shared;
+  }
+
+  // Used once the calling thread's cache has been destroyed, e.g. by other
+  // thread_local destructors that run after it. Every call takes the lock.
+  static void* allocate_shared() {
+    auto& s = shared();
+    std::lock_guard<std::mutex> guard(s.lock);
+    if (s.free == nullptr) {
+      auto slab = s.new_slab();
+      for (size_t i = BLOCKS_PER_SLAB; i-- > 0;) {
+        auto block = reinterpret_cast<FreeBlock*>(slab + i * BLOCK_SIZE);
+        s.push(block, block);
+      }
+    }
+    auto block = s.free;
+    s.free = block->next;
+    return block;
+  }
+
+  static void deallocate_shared(void* ptr) {
+    auto block = static_cast<FreeBlock*>(ptr);
+    auto& s = shared();
+    std::lock_guard<std::mutex> guard(s.lock);
+    s.push(block, block);
+  }
+
+  struct ThreadCache {
+    FreeBlock* free{nullptr};
+    size_t free_count{0};
+    char* cur{nullptr};
+    char* end{nullptr};
+
+    ~ThreadCache() {
+      // The unused part of the current slab goes back as free blocks too.
+      for (; cur + BLOCK_SIZE <= end; cur += BLOCK_SIZE) {
+        auto block = reinterpret_cast<FreeBlock*>(cur);
+        block->next = free;
+        free = block;
+      }
+      if (free != nullptr) {
+        auto last = free;
+        while (last->next != nullptr) {
+          last = last->next;
+        }
+        auto& s = shared();
+        std::lock_guard<std::mutex> guard(s.lock);
+        s.push(free, last);
+      }
+      free = nullptr;
+      free_count = 0;
+      cur = end = nullptr;
+      t_cache_destroyed = true;
+    }
+
+    void* allocate() {
+      if (free == nullptr && cur == end) {
+        refill();
+      }
+      if (free != nullptr) {
+        auto block = free;
+        free = block->next;
+        --free_count;
+        return block;
+      }
+      auto block = cur;
+      cur += BLOCK_SIZE;
+      return block;
+    }
+
+    void deallocate(void* ptr) {
+      if (free_count >= MAX_LOCAL_FREE) {
+        give_back();
+      }
+      auto block = static_cast<FreeBlock*>(ptr);
+      block->next = free;
+      free = block;
+      ++free_count;
+    }
+
+    // Hands a slab's worth of free blocks to the shared list, so that a
+    // thread that only frees does not hoard them.
+    void give_back() {
+      auto first = free;
+      auto last = first;
+      for (size_t i = 1; i < BLOCKS_PER_SLAB; ++i) {
+        last = last->next;
+      }
+      free = last->next;
+      free_count -= BLOCKS_PER_SLAB;
+      auto& s = shared();
+      std::lock_guard<std::mutex> guard(s.lock);
+      s.push(first, last);
+    }
+
+    void refill() {
+      auto& s = shared();
+      std::lock_guard<std::mutex> guard(s.lock);
+      if (s.free != nullptr) {
+        auto last = s.free;
+        size_t count = 1;
+        for (; count < BLOCKS_PER_SLAB && last->next != nullptr; ++count) {
+          last = last->next;
+        }
+        free = s.free;
+        s.free = last->next;
+        last->next = nullptr;
+        free_count = count;
+        return;
+      }
+      cur = s.new_slab();
+      end = cur + BLOCKS_PER_SLAB * BLOCK_SIZE;
+    }
+  };
+
+  // Set when this thread's cache is destroyed. It has no destructor of its
+  // own, so it stays readable for as long as the thread runs.
+  static thread_local bool t_cache_destroyed;
+
+  static ThreadCache& cache() {
+    thread_local ThreadCache t_cache;
+    return t_cache;
+  }
+};
+
+template <size_t size, size_t alignment>
+thread_local bool SlabAllocator<size, alignment>::t_cache_destroyed = false;
@@ -0,0 +1,353 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SummarySerialization.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "BinarySerialization.h"
+#include "IRCode.h"
+
+namespace summary_serialization {
+
+namespace {
+
+// FNV-1a, so that the hashes don't depend on the standard library either.
+class StableHasher {
+ public:
+  void add(const std::string& s) {
+    for (unsigned char c : s) {
+      add_byte(c);
+    }
+    // Separate consecutive strings.
+    add_byte(0);
+  }
+
+  void add(uint64_t v) {
+    for (size_t i = 0; i < sizeof(v); ++i) {
+      add_byte((v >> (8 * i)) & 0xff);
+    }
+  }
+
+  uint64_t get() const { return m_hash; }
+
+ private:
+  void add_byte(unsigned char c) {
+    m_hash ^= c;
+    m_hash *= 0x100000001b3;
+  }
+
+  uint64_t m_hash{0xcbf29ce484222325};
+};
+
+constexpr uint32_t k_binary_cache_version = 1;
+
+struct BinaryCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t count;
+};
+
+uint64_t method_key(const std::string& name) {
+  StableHasher hasher;
+  hasher.add(name);
+  return hasher.get();
+}
+
+enum BinaryTag : uint8_t { TAG_INT32, TAG_STRING, TAG_LIST };
+
+// Sizes are written as LEB128, which takes a single byte for most of them.
+void write_size(std::ostream& output, uint64_t size) {
+  do {
+    uint8_t byte = size & 0x7f;
+    size >>= 7;
+    if (size != 0) {
+      byte |= 0x80;
+    }
+    output.put(byte);
+  } while (size != 0);
+}
+
+bool read_size(const char** begin, const char* end, uint64_t* size) {
+  *size = 0;
+  for (size_t shift = 0; shift < 64; shift += 7) {
+    if (*begin == end) {
+      return false;
+    }
+    uint8_t byte = *(*begin)++;
+    *size |= uint64_t(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool read_string(const char** begin, const char* end, std::string* str) {
+  uint64_t size;
+  if (!read_size(begin, end, &size) ||
+      size > static_cast<uint64_t>(end - *begin)) {
+    return false;
+  }
+  str->assign(*begin, size);
+  *begin += size;
+  return true;
+}
+
+} // namespace
+
+void write_binary(std::ostream& output, const sparta::s_expr& expr) {
+  if (expr.is_int32()) {
+    output.put(TAG_INT32);
+    binary_serialization::write(output, expr.get_int32());
+  } else if (expr.is_string()) {
+    output.put(TAG_STRING);
+    write_size(output, expr.get_string().size());
+    output << expr.get_string();
+  } else {
+    output.put(TAG_LIST);
+    write_size(output, expr.size());
+    for (size_t i = 0; i < expr.size(); ++i) {
+      write_binary(output, expr[i]);
+    }
+  }
+}
+
+bool read_binary(const char** begin, const char* end, sparta::s_expr* expr) {
+  if (*begin == end) {
+    return false;
+  }
+  auto tag = static_cast<uint8_t>(*(*begin)++);
+  switch (tag) {
+  case TAG_INT32: {
+    int32_t n;
+    if (end - *begin < static_cast<ptrdiff_t>(sizeof(n))) {
+      return false;
+    }
+    memcpy(&n, *begin, sizeof(n));
+    *begin += sizeof(n);
+    *expr = sparta::s_expr(n);
+    return true;
+  }
+  case TAG_STRING: {
+    std::string str;
+    if (!read_string(begin, end, &str)) {
+      return false;
+    }
+    *expr = sparta::s_expr(str);
+    return true;
+  }
+  case TAG_LIST: {
+    uint64_t size;
+    if (!read_size(begin, end, &size) ||
+        size > static_cast<uint64_t>(end - *begin)) {
+      return false;
+    }
+    std::vector<sparta::s_expr> elements(size);
+    for (auto& element : elements) {
+      if (!read_binary(begin, end, &element)) {
+        return false;
+      }
+    }
+    *expr = sparta::s_expr(elements);
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+void write_binary_cache(std::ostream& output,
+                        std::vector<BinaryCacheEntry> entries) {
+  std::vector<uint64_t> keys;
+  keys.reserve(entries.size());
+  for (const auto& entry : entries) {
+    keys.push_back(method_key(entry.method));
+  }
+  std::vector<size_t> order(entries.size());
+  std::iota(order.begin(), order.end(), 0);
+  // Sorting by name too makes the output deterministic.
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    if (keys[a] != keys[b]) {
+      return keys[a] < keys[b];
+    }
+    return entries[a].method < entries[b].method;
+  });
+
+  BinaryCacheHeader header{binary_serialization::k_header_magic,
+                           k_binary_cache_version, entries.size()};
+  output.write((const char*)&header, sizeof(header));
+  uint64_t offset = 0;
+  std::vector<std::string> data;
+  for (auto i : order) {
+    std::ostringstream os;
+    write_size(os, entries[i].method.size());
+    os << entries[i].method << entries[i].summary;
+    data.push_back(os.str());
+    uint64_t row[] = {keys[i], entries[i].hash, offset, data.back().size()};
+    output.write((const char*)row, sizeof(row));
+    offset += data.back().size();
+  }
+  for (const auto& bytes : data) {
+    output << bytes;
+  }
+}
+
+std::unique_ptr<BinaryCache> BinaryCache::open(const std::string& filename) {
+  std::unique_ptr<BinaryCache> cache(new BinaryCache());
+  auto& file = cache->m_file;
+  try {
+    file.open(filename);
+  } catch (const std::exception&) {
+    return nullptr;
+  }
+  BinaryCacheHeader header;
+  if (file.size() < sizeof(header)) {
+    return nullptr;
+  }
+  memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != binary_serialization::k_header_magic ||
+      header.version != k_binary_cache_version ||
+      header.count > (file.size() - sizeof(header)) / sizeof(Entry)) {
+    return nullptr;
+  }
+  cache->m_count = header.count;
+  cache->m_entries =
+      reinterpret_cast<const Entry*>(file.data() + sizeof(header));
+  cache->m_data =
+      reinterpret_cast<const char*>(cache->m_entries + header.count);
+  cache->m_data_size = file.data() + file.size() - cache->m_data;
+  return cache;
+}
+
+boost::optional<BinaryCache::Lookup> BinaryCache::find(
+    const DexMethodRef* method) const {
+  auto name = show(method);
+  auto key = method_key(name);
+  auto end = m_entries + m_count;
+  auto it = std::lower_bound(
+      m_entries, end, key,
+      [](const Entry& entry, uint64_t key) { return entry.key < key; });
+  for (; it != end && it->key == key; ++it) {
+    if (it->offset > m_data_size || it->size > m_data_size - it->offset) {
+      return boost::none;
+    }
+    const char* begin = m_data + it->offset;
+    const char* entry_end = begin + it->size;
+    std::string entry_name;
+    // Names are compared in case two of them hash the same.
+    if (read_string(&begin, entry_end, &entry_name) && entry_name == name) {
+      return Lookup{it->hash, begin, entry_end};
+    }
+  }
+  return boost::none;
+}
+
+uint64_t method_hash(const DexMethod* method,
+                     const call_graph::Graph& call_graph) {
+  StableHasher hasher;
+  const auto* code = method->get_code();
+  always_assert(code != nullptr);
+  // Entries that refer to other entries do so by their position, since their
+  // addresses change from one run to the next.
+  std::unordered_map<const MethodItemEntry*, uint64_t> positions;
+  uint64_t position{0};
+  for (const auto& mie : *code) {
+    positions.emplace(&mie, position++);
+  }
+  auto position_of = [&](const MethodItemEntry* mie) -> uint64_t {
+    return mie == nullptr ? position : positions.at(mie);
+  };
+  for (const auto& mie : *code) {
+    hasher.add(mie.type);
+    switch (mie.type) {
+    case MFLOW_OPCODE:
+      hasher.add(show(mie.insn));
+      break;
+    case MFLOW_TARGET:
+      hasher.add(mie.target->type);
+      hasher.add(mie.target->case_key);
+      hasher.add(position_of(mie.target->src));
+      break;
+    case MFLOW_TRY:
+      hasher.add(mie.tentry->type);
+      hasher.add(position_of(mie.tentry->catch_start));
+      break;
+    case MFLOW_CATCH:
+      hasher.add(mie.centry->catch_type == nullptr
+                     ? std::string()
+                     : show(mie.centry->catch_type));
+      hasher.add(position_of(mie.centry->next));
+      break;
+    case MFLOW_DEX_OPCODE:
+    case MFLOW_DEBUG:
+    case MFLOW_POSITION:
+    case MFLOW_FALLTHROUGH:
+      // These don't change what the analyses compute.
+      break;
+    }
+  }
+  // The invokes may resolve to other methods when the class hierarchy
+  // changes, even if this code doesn't.
+  if (call_graph.has_node(method)) {
+    for (const auto& edge : call_graph.node(method).callees()) {
+      hasher.add(show(edge->callee()));
+    }
+  }
+  return hasher.get();
+}
+
+std::unordered_set<const DexMethodRef*> valid_cached_methods(
+    const std::unordered_map<const DexMethodRef*, uint64_t>& cached_hashes,
+    const call_graph::Graph& call_graph) {
+  std::unordered_set<const DexMethodRef*> valid;
+  for (const auto& pair : cached_hashes) {
+    if (!pair.first->is_def()) {
+      continue;
+    }
+    auto* method = static_cast<const DexMethod*>(pair.first);
+    if (method->get_code() != nullptr &&
+        method_hash(method, call_graph) == pair.second) {
+      valid.emplace(method);
+    }
+  }
+
+  // A summary also depends on the summaries of the callees, so it is only
+  // valid if theirs are too. Callees without code are summarized from
+  // elsewhere, and don't invalidate their callers.
+  std::vector<const DexMethod*> invalidated;
+  for (auto* ref : valid) {
+    auto* method = static_cast<const DexMethod*>(ref);
+    if (!call_graph.has_node(method)) {
+      continue;
+    }
+    for (const auto& edge : call_graph.node(method).callees()) {
+      auto* callee = edge->callee();
+      if (callee->get_code() != nullptr && valid.count(callee) == 0) {
+        invalidated.push_back(method);
+        break;
+      }
+    }
+  }
+  for (auto* method : invalidated) {
+    valid.erase(method);
+  }
+  while (!invalidated.empty()) {
+    auto* method = invalidated.back();
+    invalidated.pop_back();
+    for (const auto& edge : call_graph.node(method).callers()) {
+      auto* caller = edge->caller();
+      if (caller != nullptr && valid.erase(caller) != 0) {
+        invalidated.push_back(caller);
+      }
+    }
+  }
+  return valid;
+}
+
+} // namespace summary_serialization
@@ -7,17 +7,30 @@
 
 #pragma once
 
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/optional.hpp>
 #include <istream>
+#include <memory>
+#include <numeric>
 #include <ostream>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 
+#include "CallGraph.h"
 #include "DexClass.h"
+#include "Parallel.h"
 #include "S_Expression.h"
 #include "Show.h"
+#include "Walkers.h"
 
 /*
  * This module serves to (de)serialize maps of DexMethods to summary objects
  * of any type, which is useful for the analysis of methods external to the
- * APK.
+ * APK, and for caching the summaries of the methods of the APK from one run
+ * to the next. Caches come in two formats: s-expression text, which is easy to
+ * read and diff, and a binary format that is memory-mapped and only decodes
+ * the summaries that are still valid.
  */
 
 namespace summary_serialization {
@@ -67,4 +80,232 @@ size_t read(std::istream& input,
   return load_count;
 }
 
+/*
+ * A hash of the code of a method and of the callees its call graph node
+ * resolves to, i.e. of everything a summary of it is computed from that isn't
+ * the summary of another method. It only depends on names, so that it can be
+ * compared with the hash of a previous run.
+ */
+uint64_t method_hash(const DexMethod*, const call_graph::Graph&);
+
+/*
+ * The methods whose cached summary is still valid: their hash matches, and so
+ * do the hashes of all the callees with code they transitively depend on.
+ */
+std::unordered_set<const DexMethodRef*> valid_cached_methods(
+    const std::unordered_map<const DexMethodRef*, uint64_t>& cached_hashes,
+    const call_graph::Graph&);
+
+/*
+ * Print the summaries of the methods with code, along with their hash, for
+ * read_cache to pick up in a later run. Summaries of methods without code
+ * have nothing to be hashed, and are read from external summary files
+ * instead.
+ */
+template <typename V>
+void print_cache(std::ostream& output,
+                 const std::unordered_map<const DexMethodRef*, V>& map,
+                 const call_graph::Graph& call_graph) {
+  std::map<const DexMethodRef*, const V*, dexmethods_comparator> ordered;
+  for (const auto& pair : map) {
+    if (pair.first->is_def() &&
+        static_cast<const DexMethod*>(pair.first)->get_code() != nullptr) {
+      ordered.emplace(pair.first, &pair.second);
+    }
+  }
+  for (const auto& pair : ordered) {
+    auto* method = static_cast<const DexMethod*>(pair.first);
+    std::vector<sparta::s_expr> s_exprs;
+    s_exprs.emplace_back(show(method));
+    s_exprs.emplace_back(std::to_string(method_hash(method, call_graph)));
+    s_exprs.emplace_back(to_s_expr(*pair.second));
+    output << sparta::s_expr(s_exprs) << std::endl;
+  }
+}
+
+/*
+ * Add the summaries printed by print_cache that are still valid to the map,
+ * unless it already has a summary for their method. Returns the number of
+ * summaries added; the methods of the others have to be analyzed again.
+ */
+template <typename V>
+size_t read_cache(std::istream& input,
+                  const call_graph::Graph& call_graph,
+                  std::unordered_map<const DexMethodRef*, V>* map) {
+  std::unordered_map<const DexMethodRef*, uint64_t> cached_hashes;
+  std::unordered_map<const DexMethodRef*, V> cached_summaries;
+  sparta::s_expr_istream s_expr_input(input);
+  while (s_expr_input.good()) {
+    sparta::s_expr expr;
+    s_expr_input >> expr;
+    if (s_expr_input.eoi()) {
+      break;
+    }
+    always_assert_log(!s_expr_input.fail(), "%s\n",
+                      s_expr_input.what().c_str());
+    DexMethodRef* dex_method =
+        DexMethod::get_method(expr[0].get_string().c_str());
+    if (dex_method == nullptr) {
+      continue;
+    }
+    cached_hashes.emplace(dex_method, std::stoull(expr[1].get_string()));
+    cached_summaries.emplace(dex_method, V::from_s_expr(expr[2]));
+  }
+  size_t load_count{0};
+  for (auto* method : valid_cached_methods(cached_hashes, call_graph)) {
+    if (map->emplace(method, cached_summaries.at(method)).second) {
+      ++load_count;
+    }
+  }
+  return load_count;
+}
+
+/*
+ * A compact binary encoding of s-expressions, which reads back without
+ * tokenizing any text. read_binary() advances `*begin` past the expression,
+ * and returns false if the input is malformed or ends first.
+ */
+void write_binary(std::ostream& output, const sparta::s_expr& expr);
+
+bool read_binary(const char** begin, const char* end, sparta::s_expr* expr);
+
+struct BinaryCacheEntry {
+  std::string method;
+  uint64_t hash{0};
+  // The summary, encoded by write_binary().
+  std::string summary;
+};
+
+/*
+ * Write the entries in the format that BinaryCache reads: a table of
+ *
+ *   <stable hash of the method name> <method_hash> <offset> <size>
+ *
+ * sorted by the first column, followed by the method names and the encoded
+ * summaries that the offsets point to.
+ */
+void write_binary_cache(std::ostream& output,
+                        std::vector<BinaryCacheEntry> entries);
+
+/*
+ * A cache written by write_binary_cache(), mapped into memory. Looking up a
+ * method is a binary search of the table, and only the summaries that are
+ * looked up get decoded.
+ */
+class BinaryCache {
+ public:
+  // Returns null if the file doesn't exist or isn't a binary cache.
+  static std::unique_ptr<BinaryCache> open(const std::string& filename);
+
+  struct Lookup {
+    uint64_t hash;
+    const char* summary_begin;
+    const char* summary_end;
+  };
+
+  boost::optional<Lookup> find(const DexMethodRef* method) const;
+
+  size_t size() const { return m_count; }
+
+ private:
+  struct Entry {
+    uint64_t key;
+    uint64_t hash;
+    uint64_t offset;
+    uint64_t size;
+  };
+
+  BinaryCache() = default;
+
+  boost::iostreams::mapped_file_source m_file;
+  const Entry* m_entries{nullptr};
+  size_t m_count{0};
+  const char* m_data{nullptr};
+  size_t m_data_size{0};
+};
+
+/*
+ * Like print_cache, in the binary format.
+ */
+template <typename V>
+void print_binary_cache(std::ostream& output,
+                        const std::unordered_map<const DexMethodRef*, V>& map,
+                        const call_graph::Graph& call_graph) {
+  std::vector<const DexMethod*> methods;
+  for (const auto& pair : map) {
+    if (pair.first->is_def() &&
+        static_cast<const DexMethod*>(pair.first)->get_code() != nullptr) {
+      methods.push_back(static_cast<const DexMethod*>(pair.first));
+    }
+  }
+  std::vector<BinaryCacheEntry> entries(methods.size());
+  std::vector<size_t> indices(methods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    auto* method = methods[i];
+    auto& entry = entries[i];
+    entry.method = show(method);
+    entry.hash = method_hash(method, call_graph);
+    std::ostringstream summary;
+    write_binary(summary, to_s_expr(map.at(method)));
+    entry.summary = summary.str();
+  });
+  write_binary_cache(output, std::move(entries));
+}
+
+/*
+ * Like read_cache, for a cache written by print_binary_cache. Rather than
+ * parsing the whole file, each method of `scope` with code is looked up in
+ * the memory-mapped cache, in parallel, and only the summaries that are still
+ * valid are decoded. Does nothing if the file isn't a binary cache.
+ */
+template <typename V>
+size_t read_binary_cache(const std::string& filename,
+                         const Scope& scope,
+                         const call_graph::Graph& call_graph,
+                         std::unordered_map<const DexMethodRef*, V>* map) {
+  auto cache = BinaryCache::open(filename);
+  if (cache == nullptr) {
+    return 0;
+  }
+  std::vector<const DexMethod*> methods;
+  walk::code(scope, [&](const DexMethod* method, IRCode&) {
+    methods.push_back(method);
+  });
+  std::vector<boost::optional<BinaryCache::Lookup>> lookups(methods.size());
+  std::vector<size_t> indices(methods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(),
+               [&](size_t i) { lookups[i] = cache->find(methods[i]); });
+
+  std::unordered_map<const DexMethodRef*, uint64_t> cached_hashes;
+  for (size_t i = 0; i < methods.size(); ++i) {
+    if (lookups[i]) {
+      cached_hashes.emplace(methods[i], lookups[i]->hash);
+    }
+  }
+  auto valid = valid_cached_methods(cached_hashes, call_graph);
+  std::vector<boost::optional<V>> summaries(methods.size());
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    if (!lookups[i] || valid.count(methods[i]) == 0 ||
+        map->count(methods[i]) != 0) {
+      return;
+    }
+    const char* begin = lookups[i]->summary_begin;
+    sparta::s_expr expr;
+    always_assert_log(read_binary(&begin, lookups[i]->summary_end, &expr),
+                      "Malformed summary of %s in %s\n", SHOW(methods[i]),
+                      filename.c_str());
+    summaries[i] = V::from_s_expr(expr);
+  });
+  size_t load_count{0};
+  for (size_t i = 0; i < methods.size(); ++i) {
+    if (summaries[i]) {
+      map->emplace(methods[i], std::move(*summaries[i]));
+      ++load_count;
+    }
+  }
+  return load_count;
+}
+
 } // namespace summary_serialization
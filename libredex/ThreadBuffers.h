@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * One buffer of type T per thread, for recording from many threads without
+ * contention and collecting everything afterwards. A thread gets its buffer
+ * the first time it asks for one, and the buffer is kept until the registry
+ * is destroyed, so what worker threads recorded can still be collected after
+ * they exit.
+ *
+ * A thread finds its buffer through a thread_local pointer that is shared by
+ * all registries of the same T, so there must be only one registry per T.
+ */
+template <typename T>
+class ThreadBuffers {
+ public:
+  struct Buffer {
+    // Small sequential id; the first thread to get a buffer gets 0.
+    uint32_t thread_id;
+    // Held by the owning thread while it writes, and by for_each(), so it is
+    // only contended while the buffers are being collected.
+    std::mutex lock;
+    T data;
+  };
+
+  Buffer& this_thread() {
+    thread_local Buffer* t_buffer = nullptr;
+    if (t_buffer == nullptr) {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_buffers.emplace_back(new Buffer());
+      t_buffer = m_buffers.back().get();
+      t_buffer->thread_id = m_buffers.size() - 1;
+    }
+    return *t_buffer;
+  }
+
+  // Calls `fn` on every buffer created so far, with the buffer's lock held.
+  template <typename Fn>
+  void for_each(const Fn& fn) {
+    std::lock_guard<std::mutex> guard(m_lock);
+    for (auto& buffer : m_buffers) {
+      std::lock_guard<std::mutex> buffer_guard(buffer->lock);
+      fn(*buffer);
+    }
+  }
+
+  // Like for_each(), but skips the buffers whose lock is held instead of
+  // waiting for it, so it can run where the caller may hold one, e.g. when a
+  // thread crashes.
+  template <typename Fn>
+  void try_for_each(const Fn& fn) {
+    std::unique_lock<std::mutex> guard(m_lock, std::try_to_lock);
+    if (!guard.owns_lock()) {
+      return;
+    }
+    for (auto& buffer : m_buffers) {
+      std::unique_lock<std::mutex> buffer_guard(buffer->lock, std::try_to_lock);
+      if (buffer_guard.owns_lock()) {
+        fn(*buffer);
+      }
+    }
+  }
+
+ private:
+  std::mutex m_lock;
+  std::vector<std::unique_ptr<Buffer>> m_buffers;
+};
@@ -0,0 +1,320 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+size_t default_num_threads() {
+  return std::max(1u, boost::thread::hardware_concurrency());
+}
+
+#ifdef __linux__
+// Parses a sysfs CPU list, e.g. "0-3,8-11".
+std::vector<int> parse_cpu_list(const std::string& list) {
+  std::vector<int> cpus;
+  std::istringstream is(list);
+  std::string range;
+  while (std::getline(is, range, ',')) {
+    auto dash = range.find('-');
+    try {
+      int first = std::stoi(range.substr(0, dash));
+      int last =
+          dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      for (int cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    } catch (const std::exception&) {
+      // Skip whatever we can't parse, e.g. the newline at the end.
+    }
+  }
+  return cpus;
+}
+#endif
+
+/*
+ * The CPUs that the process may run on, by NUMA node. Nodes without any such
+ * CPU are left out. Everything is on a single node if the topology is
+ * unknown.
+ */
+std::vector<std::vector<int>> read_node_cpus() {
+  std::vector<std::vector<int>> node_cpus;
+#ifdef __linux__
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return node_cpus;
+  }
+  for (int node = 0;; ++node) {
+    std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) +
+                     "/cpulist");
+    if (!in) {
+      break;
+    }
+    std::string list;
+    std::getline(in, list);
+    std::vector<int> cpus;
+    for (int cpu : parse_cpu_list(list)) {
+      if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+        cpus.push_back(cpu);
+      }
+    }
+    if (!cpus.empty()) {
+      node_cpus.push_back(std::move(cpus));
+    }
+  }
+  if (node_cpus.empty()) {
+    node_cpus.emplace_back();
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &allowed)) {
+        node_cpus.back().push_back(cpu);
+      }
+    }
+  }
+#endif
+  if (node_cpus.empty()) {
+    node_cpus.emplace_back();
+  }
+  return node_cpus;
+}
+
+void pin_current_thread(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  // Pinning is only a hint for locality, so failing to pin is fine.
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+} // namespace
+
+/*
+ * A call to run(). Indices are claimed on a first-come, first-served basis by
+ * the submitting thread and by whichever pool threads pick up the batch. A pool
+ * thread may dequeue a batch after all of its indices are gone, so the batch
+ * is kept alive by shared_ptr and `fn` is only touched for claimed indices.
+ *
+ * The indices are split into one range per NUMA node. A thread claims the
+ * indices of its own node first.
+ */
+struct ThreadPool::Batch {
+  Batch(size_t n, const std::function<void(size_t)>& fn, size_t num_nodes)
+      : n(n),
+        fn(fn),
+        num_nodes(num_nodes),
+        next(new std::atomic<size_t>[num_nodes]) {
+    for (size_t node = 0; node < num_nodes; ++node) {
+      next[node] = first_of_node(node, n, num_nodes);
+    }
+  }
+
+  // Returns true if this call finished the batch.
+  bool run_some(size_t home_node) {
+    bool finished_last = false;
+    for (size_t k = 0; k < num_nodes; ++k) {
+      auto node = (home_node + k) % num_nodes;
+      auto end = first_of_node(node + 1, n, num_nodes);
+      for (auto i = next[node].fetch_add(1); i < end;
+           i = next[node].fetch_add(1)) {
+        try {
+          fn(i);
+        } catch (...) {
+          boost::lock_guard<boost::mutex> guard(mutex);
+          if (!error) {
+            error = std::current_exception();
+          }
+        }
+        if (done.fetch_add(1) + 1 == n) {
+          finished_last = true;
+        }
+      }
+    }
+    return finished_last;
+  }
+
+  const size_t n;
+  const std::function<void(size_t)>& fn;
+  const size_t num_nodes;
+  // The next unclaimed index of each node.
+  std::unique_ptr<std::atomic<size_t>[]> next;
+  std::atomic<size_t> done{0};
+  std::exception_ptr error;
+  boost::mutex mutex;
+  boost::condition_variable finished;
+};
+
+ThreadPool& ThreadPool::get() {
+  static ThreadPool pool;
+  return pool;
+}
+
+ThreadPool::ThreadPool()
+    : m_num_threads(default_num_threads()),
+      m_workers(std::make_unique<Workers>()) {}
+
+ThreadPool::~ThreadPool() { stop_threads(); }
+
+void ThreadPool::set_num_threads(size_t num_threads) {
+  if (num_threads == 0) {
+    num_threads = default_num_threads();
+  }
+  if (num_threads == m_num_threads) {
+    return;
+  }
+  stop_threads();
+  m_num_threads = num_threads;
+}
+
+void ThreadPool::set_pin_threads(bool pin_threads) {
+  if (pin_threads == m_pin_threads) {
+    return;
+  }
+  stop_threads();
+  m_pin_threads = pin_threads;
+  if (pin_threads && m_node_cpus.empty()) {
+    m_node_cpus = read_node_cpus();
+    for (size_t node = 0; node < m_node_cpus.size(); ++node) {
+      for (int cpu : m_node_cpus[node]) {
+        if (m_cpu_node.size() <= static_cast<size_t>(cpu)) {
+          m_cpu_node.resize(cpu + 1, 0);
+        }
+        m_cpu_node[cpu] = node;
+      }
+    }
+  }
+}
+
+void ThreadPool::set_thread_init(std::function<void()> init) {
+  stop_threads();
+  m_thread_init = std::move(init);
+}
+
+size_t ThreadPool::current_node() const {
+  if (num_nodes() == 1) {
+    return 0;
+  }
+#ifdef __linux__
+  int cpu = sched_getcpu();
+  if (cpu >= 0 && static_cast<size_t>(cpu) < m_cpu_node.size()) {
+    return m_cpu_node[cpu];
+  }
+#endif
+  return 0;
+}
+
+void ThreadPool::reset_after_fork() {
+  // Only the forking thread exists in the child. The pool threads and whatever
+  // they were waiting on can't be joined or destroyed here, so they are
+  // leaked, and the next run() starts new threads.
+  m_workers.release();
+  m_workers = std::make_unique<Workers>();
+}
+
+void ThreadPool::start_threads() {
+  // The caller of run() is one of the m_num_threads threads.
+  for (size_t i = 1; i < m_num_threads; ++i) {
+    boost::thread::attributes attrs;
+    attrs.set_stack_size(8 * 1024 * 1024);
+    // Spread the threads over the nodes like the calls of run(), and over the
+    // CPUs of each node in turn.
+    auto node = node_of(i, m_num_threads, num_nodes());
+    int cpu = -1;
+    if (m_pin_threads && !m_node_cpus[node].empty()) {
+      const auto& cpus = m_node_cpus[node];
+      cpu = cpus[(i - first_of_node(node, m_num_threads, num_nodes())) %
+                 cpus.size()];
+    }
+    m_workers->threads.emplace_back(attrs, [this, node, cpu] {
+      if (cpu >= 0) {
+        pin_current_thread(cpu);
+      }
+      if (m_thread_init) {
+        m_thread_init();
+      }
+      worker_loop(node);
+    });
+  }
+}
+
+void ThreadPool::stop_threads() {
+  {
+    boost::lock_guard<boost::mutex> guard(m_workers->mutex);
+    m_workers->stopping = true;
+  }
+  m_workers->work_available.notify_all();
+  for (auto& thread : m_workers->threads) {
+    thread.join();
+  }
+  m_workers->threads.clear();
+  m_workers->stopping = false;
+}
+
+void ThreadPool::worker_loop(size_t node) {
+  while (true) {
+    std::shared_ptr<Batch> batch;
+    {
+      boost::unique_lock<boost::mutex> lock(m_workers->mutex);
+      m_workers->work_available.wait(lock, [this] {
+        return m_workers->stopping || !m_workers->pending.empty();
+      });
+      if (m_workers->stopping) {
+        return;
+      }
+      batch = std::move(m_workers->pending.front());
+      m_workers->pending.pop_front();
+    }
+    if (batch->run_some(node)) {
+      boost::lock_guard<boost::mutex> guard(batch->mutex);
+      batch->finished.notify_all();
+    }
+  }
+}
+
+void ThreadPool::run(size_t n, const std::function<void(size_t)>& fn) {
+  if (n == 0) {
+    return;
+  }
+  auto batch = std::make_shared<Batch>(n, fn, num_nodes());
+  auto helpers = std::min(n, m_num_threads) - 1;
+  if (helpers > 0) {
+    boost::lock_guard<boost::mutex> guard(m_workers->mutex);
+    if (m_workers->threads.empty()) {
+      start_threads();
+    }
+    for (size_t i = 0; i < helpers; ++i) {
+      m_workers->pending.push_back(batch);
+    }
+  }
+  if (helpers == 1) {
+    m_workers->work_available.notify_one();
+  } else if (helpers > 1) {
+    m_workers->work_available.notify_all();
+  }
+
+  batch->run_some(current_node());
+  {
+    boost::unique_lock<boost::mutex> lock(batch->mutex);
+    batch->finished.wait(lock, [&] { return batch->done.load() == n; });
+  }
+  if (batch->error) {
+    std::rethrow_exception(batch->error);
+  }
+}
@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * Process-wide pool of worker threads. WorkQueue (and thus all the
+ * walk::parallel helpers) run on it instead of spawning and joining their own
+ * threads, which also bounds the total concurrency of the process.
+ *
+ * The calling thread always takes part in the work it submits, and never
+ * blocks on work that has not started yet. Parallel regions can therefore be
+ * nested freely: if every pool thread is busy, the inner region simply runs on
+ * the thread that entered it.
+ */
+class ThreadPool {
+ public:
+  /**
+   * Get the global pool object.
+   */
+  static ThreadPool& get();
+
+  /**
+   * Number of threads that can be working at once, including the caller of
+   * run().
+   */
+  size_t num_threads() const { return m_num_threads; }
+
+  /**
+   * Resize the pool. Zero means one thread per hardware thread. Must not be
+   * called while any work is running.
+   */
+  void set_num_threads(size_t num_threads);
+
+  /**
+   * Pin each pool thread to a CPU, filling the NUMA nodes one after the other.
+   * With pinning on a NUMA machine, the calls of run() are split into one
+   * contiguous range per node (see first_of_node()), and each thread claims
+   * the calls of its own node before helping out on the others. Callers that
+   * give the same range to the same data from one run() to the next thus keep
+   * it on the node where it was first touched. A no-op where the OS doesn't
+   * support thread affinity. Must not be called while any work is running.
+   */
+  void set_pin_threads(bool pin_threads);
+
+  /**
+   * Have each pool thread call `init` when it starts, e.g. to set up its
+   * allocator state. Pool threads that are already running are restarted. The
+   * caller of run() is not a pool thread, so it is up to the caller to set
+   * itself up. Must not be called while any work is running.
+   */
+  void set_thread_init(std::function<void()> init);
+
+  /**
+   * The number of NUMA nodes that the calls of run() are split over. Always
+   * one unless the pool threads are pinned.
+   */
+  size_t num_nodes() const {
+    return m_pin_threads ? m_node_cpus.size() : 1;
+  }
+
+  /**
+   * The first of the n calls of run() that belongs to `node`. The calls of
+   * the node are those up to the first one of the next node.
+   */
+  static size_t first_of_node(size_t node, size_t n, size_t num_nodes) {
+    return (node * n + num_nodes - 1) / num_nodes;
+  }
+
+  /**
+   * The node that call i of n belongs to.
+   */
+  static size_t node_of(size_t i, size_t n, size_t num_nodes) {
+    return i * num_nodes / n;
+  }
+
+  /**
+   * Call fn(0) ... fn(n - 1), each exactly once, spread across the calling
+   * thread and the pool. Returns once all the calls have finished. If any of
+   * them throws, the first exception is rethrown here.
+   */
+  void run(size_t n, const std::function<void(size_t)>& fn);
+
+  /**
+   * Must be called in the child after a fork(), before any work is submitted,
+   * because the pool threads of the parent don't exist in the child. The fork
+   * must not happen while the parent is running work on the pool.
+   */
+  void reset_after_fork();
+
+  ~ThreadPool();
+
+ private:
+  struct Batch;
+
+  ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+
+  void start_threads();
+  void stop_threads();
+  void worker_loop(size_t node);
+  // The node of the CPU that the calling thread is on.
+  size_t current_node() const;
+
+  // Everything that the pool threads use.
+  struct Workers {
+    std::vector<boost::thread> threads;
+    std::deque<std::shared_ptr<Batch>> pending;
+    bool stopping{false};
+    boost::mutex mutex;
+    boost::condition_variable work_available;
+  };
+
+  size_t m_num_threads;
+  std::unique_ptr<Workers> m_workers;
+  std::function<void()> m_thread_init;
+  bool m_pin_threads{false};
+  // The CPUs that the process may run on, by NUMA node, and the other way
+  // around. Only read when pinning.
+  std::vector<std::vector<int>> m_node_cpus;
+  std::vector<size_t> m_cpu_node;
+};
@@ -7,30 +7,133 @@
 
 #include "Timer.h"
 
+#include <algorithm>
+#include <cstdio>
+
+#include "Debug.h"
 #include "Trace.h"
 
-unsigned Timer::s_indent = 0;
-std::mutex Timer::s_lock;
-Timer::times_t Timer::s_times;
+ThreadBuffers<Timer::ThreadSpans> Timer::s_buffers;
+const Timer::clock::time_point Timer::s_epoch = Timer::clock::now();
 
-Timer::Timer(const std::string& msg)
-  : m_msg(msg),
-    m_start(std::chrono::high_resolution_clock::now())
-{
-  ++s_indent;
+namespace {
+
+void write_json_string(std::ostream& os, const std::string& str) {
+  os << '"';
+  for (unsigned char c : str) {
+    switch (c) {
+    case '"':
+      os << "\\\"";
+      break;
+    case '\\':
+      os << "\\\\";
+      break;
+    case '\n':
+      os << "\\n";
+      break;
+    case '\t':
+      os << "\\t";
+      break;
+    default:
+      if (c < 0x20) {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "\\u%04x", c);
+        os << buf;
+      } else {
+        os << c;
+      }
+    }
+  }
+  os << '"';
 }
 
+} // namespace
+
+Timer::Timer(const std::string& msg)
+    : m_buffer(s_buffers.this_thread()),
+      m_msg(msg),
+      m_depth(m_buffer.data.depth++),
+      m_start(clock::now()) {}
+
 Timer::~Timer() {
-  --s_indent;
-  auto end = std::chrono::high_resolution_clock::now();
-  auto duration_s = std::chrono::duration<double>(end - m_start).count();
+  auto end = clock::now();
+  --m_buffer.data.depth;
+  auto duration = end - m_start;
+  double duration_s DEBUG_ONLY =
+      std::chrono::duration<double>(duration).count();
   TRACE(TIME, 1, "%*s%s completed in %.1lf seconds\n",
-        4 * s_indent, "",
+        4 * m_depth, "",
         m_msg.c_str(),
         duration_s);
 
-  {
-    std::lock_guard<std::mutex> guard(s_lock);
-    s_times.push_back({std::move(m_msg), duration_s});
+  std::lock_guard<std::mutex> guard(m_buffer.lock);
+  m_buffer.data.spans.push_back(
+      {std::move(m_msg), m_buffer.thread_id, m_depth,
+       std::chrono::duration_cast<std::chrono::microseconds>(m_start -
+                                                             s_epoch),
+       std::chrono::duration_cast<std::chrono::microseconds>(duration)});
+}
+
+std::vector<Timer::Span> Timer::get_spans() {
+  std::vector<Span> spans;
+  s_buffers.for_each([&spans](ThreadBuffer& buffer) {
+    const auto& thread_spans = buffer.data.spans;
+    spans.insert(spans.end(), thread_spans.begin(), thread_spans.end());
+  });
+  // Enclosing spans start no later than the ones they contain; the depth
+  // breaks ties between spans that start in the same microsecond.
+  std::stable_sort(spans.begin(), spans.end(),
+                   [](const Span& a, const Span& b) {
+                     if (a.start != b.start) {
+                       return a.start < b.start;
+                     }
+                     return a.depth < b.depth;
+                   });
+  return spans;
+}
+
+Timer::times_t Timer::get_times() {
+  auto spans = get_spans();
+  // Spans are already ordered by start time, and on each thread by
+  // completion order among spans that start together.
+  std::stable_sort(spans.begin(), spans.end(),
+                   [](const Span& a, const Span& b) {
+                     auto a_end = a.start + a.duration;
+                     auto b_end = b.start + b.duration;
+                     if (a_end != b_end) {
+                       return a_end < b_end;
+                     }
+                     return a.depth > b.depth;
+                   });
+  times_t times;
+  times.reserve(spans.size());
+  for (auto& span : spans) {
+    times.emplace_back(std::move(span.msg),
+                       std::chrono::duration<double>(span.duration).count());
+  }
+  return times;
+}
+
+void Timer::write_chrome_trace(std::ostream& os) {
+  auto spans = get_spans();
+  uint32_t num_threads = 0;
+  os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (const auto& span : spans) {
+    os << (first ? "\n" : ",\n");
+    first = false;
+    os << "{\"name\":";
+    write_json_string(os, span.msg);
+    os << ",\"cat\":\"redex\",\"ph\":\"X\",\"pid\":0,\"tid\":" << span.thread_id
+       << ",\"ts\":" << span.start.count() << ",\"dur\":"
+       << span.duration.count() << "}";
+    num_threads = std::max(num_threads, span.thread_id + 1);
+  }
+  for (uint32_t tid = 0; tid < num_threads; ++tid) {
+    os << (first ? "\n" : ",\n");
+    first = false;
+    os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid
+       << ",\"args\":{\"name\":\"thread " << tid << "\"}}";
   }
+  os << "\n]}\n";
 }
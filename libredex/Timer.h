@@ -8,25 +8,62 @@
 #pragma once
 
 #include <chrono>
-#include <mutex>
+#include <cstdint>
+#include <ostream>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "ThreadBuffers.h"
+
+/*
+ * Records the time spent in a scope. Timers may nest, and may run on any
+ * thread: every thread appends the spans it completes to its own buffer, so
+ * timing inside parallel code does not contend on a global lock.
+ */
 struct Timer {
   Timer(const std::string& msg);
   ~Timer();
 
+  using clock = std::chrono::steady_clock;
+
+  struct Span {
+    std::string msg;
+    // Small sequential id; the first thread to start a Timer gets 0.
+    uint32_t thread_id;
+    // Number of enclosing Timers that were running on the same thread.
+    uint32_t depth;
+    // Relative to the start of the process.
+    std::chrono::microseconds start;
+    std::chrono::microseconds duration;
+  };
+
   using times_t = std::vector<std::pair<std::string, double>>;
+  // Durations in seconds, in the order in which the Timers completed.
   // there should be no currently running Timers when this function is called
-  static const times_t& get_times() {
-    return s_times;
-  }
+  static times_t get_times();
+
+  // All recorded spans, ordered by start time.
+  // there should be no currently running Timers when this function is called
+  static std::vector<Span> get_spans();
+
+  // Writes all recorded spans in the Chrome trace_event JSON format, which
+  // chrome://tracing and Perfetto can open.
+  static void write_chrome_trace(std::ostream& os);
 
  private:
-  static std::mutex s_lock;
-  static times_t s_times;
-  static unsigned s_indent;
+  struct ThreadSpans {
+    // Only touched by the owning thread.
+    uint32_t depth{0};
+    std::vector<Span> spans;
+  };
+  using ThreadBuffer = ThreadBuffers<ThreadSpans>::Buffer;
+
+  static ThreadBuffers<ThreadSpans> s_buffers;
+  static const clock::time_point s_epoch;
+
+  ThreadBuffer& m_buffer;
   std::string m_msg;
-  std::chrono::high_resolution_clock::time_point m_start;
+  uint32_t m_depth;
+  clock::time_point m_start;
 };
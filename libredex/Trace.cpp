@@ -7,24 +7,67 @@
 
 #include "Trace.h"
 
+#include <algorithm>
 #include <array>
 #include <cstdarg>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <exception>
 #include <mutex>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
+
+#include "ThreadBuffers.h"
+
+#ifndef NDEBUG
+long g_trace_levels[N_TRACE_MODULES];
+#endif
 
 namespace {
 
+// A thread's buffer is written out once it holds this many bytes.
+constexpr size_t kTraceBufferFlushSize = 64 * 1024;
+
+void append_vformat(std::string& out, const char* fmt, va_list ap) {
+  std::array<char, 512> buf;
+  va_list ap_copy;
+  va_copy(ap_copy, ap);
+  int len = vsnprintf(buf.data(), buf.size(), fmt, ap_copy);
+  va_end(ap_copy);
+  if (len < 0) {
+    return;
+  }
+  if (static_cast<size_t>(len) < buf.size()) {
+    out.append(buf.data(), len);
+    return;
+  }
+  auto old_size = out.size();
+  out.resize(old_size + len + 1);
+  vsnprintf(&out[old_size], len + 1, fmt, ap);
+  out.resize(old_size + len);
+}
+
+void append_format(std::string& out, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  append_vformat(out, fmt, ap);
+  va_end(ap);
+}
+
+void terminate_handler();
+
 struct Tracer {
 
   bool m_show_timestamps{false};
   bool m_show_tracemodule{false};
+  bool m_show_thread_id{false};
   const char* m_method_filter;
   std::unordered_map<int/*TraceModule*/, std::string> m_module_id_name_map;
 
@@ -33,6 +76,7 @@ struct Tracer {
     const char* envfile = getenv("TRACEFILE");
     const char* show_timestamps = getenv("SHOW_TIMESTAMPS");
     const char* show_tracemodule = getenv("SHOW_TRACEMODULE");
+    const char* show_thread_id = getenv("SHOW_THREAD_ID");
     m_method_filter = getenv("TRACE_METHOD_FILTER");
     if (!traceenv) {
       return;
@@ -47,6 +91,9 @@ struct Tracer {
     std::cerr << "SHOW_TRACEMODULE="
               << (show_tracemodule == nullptr ? "" : show_tracemodule)
               << std::endl;
+    std::cerr << "SHOW_THREAD_ID="
+              << (show_thread_id == nullptr ? "" : show_thread_id)
+              << std::endl;
     std::cerr << "TRACE_METHOD_FILTER="
               << (m_method_filter == nullptr ? "" : m_method_filter)
               << std::endl;
@@ -60,22 +107,24 @@ struct Tracer {
     if (show_tracemodule) {
       m_show_tracemodule = true;
     }
+    if (show_thread_id) {
+      m_show_thread_id = true;
+    }
 
 #define TM(x) m_module_id_name_map[static_cast<int>(x)] = #x;
     TMS
 #undef TM
+
+    m_previous_terminate = std::set_terminate(terminate_handler);
   }
 
   ~Tracer() {
+    flush_all();
     if (m_file != nullptr && m_file != stderr) {
       fclose(m_file);
     }
   }
 
-  bool traceEnabled(TraceModule module, int level) {
-    return level <= m_level || level <= m_traces[module];
-  }
-
   void trace(TraceModule module, int level, const char* fmt, va_list ap) {
     if (m_method_filter && TraceContext::s_current_method != nullptr) {
       if (strstr(TraceContext::s_current_method->c_str(), m_method_filter) ==
@@ -83,7 +132,9 @@ struct Tracer {
         return;
       }
     }
-    std::lock_guard<std::mutex> guard(TraceContext::s_trace_mutex);
+    auto& buffer = m_buffers.this_thread();
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    auto& out = buffer.data;
     if (m_show_timestamps) {
       auto t = std::time(nullptr);
       struct tm local_tm;
@@ -94,18 +145,55 @@ struct Tracer {
 #endif
       std::array<char, 40> buf;
       std::strftime(buf.data(), sizeof(buf), "%c", &local_tm);
-      fprintf(m_file, "[%s]", buf.data());
+      append_format(out, "[%s]", buf.data());
+      if (!m_show_tracemodule && !m_show_thread_id) {
+        out += ' ';
+      }
+    }
+    if (m_show_thread_id) {
+      append_format(out, "[t%u]", buffer.thread_id);
       if (!m_show_tracemodule) {
-        fprintf(m_file, " ");
+        out += ' ';
       }
     }
     if (m_show_tracemodule) {
-      fprintf(m_file, "[%s:%d] ", m_module_id_name_map[module].c_str(), level);
+      append_format(out, "[%s:%d] ", m_module_id_name_map[module].c_str(),
+                    level);
+    }
+    append_vformat(out, fmt, ap);
+    if (out.size() >= kTraceBufferFlushSize) {
+      write_out(out);
     }
-    vfprintf(m_file, fmt, ap);
+  }
+
+  void flush_all() {
+    m_buffers.for_each(
+        [this](ThreadBuffers<std::string>::Buffer& buffer) {
+          write_out(buffer.data);
+        });
+  }
+
+  // Called when the process is going down abnormally, possibly from the
+  // thread that holds a buffer or the output lock, so nothing waits.
+  void flush_all_on_crash() {
+    if (m_file == nullptr) {
+      return;
+    }
+    std::unique_lock<std::mutex> guard(TraceContext::s_trace_mutex,
+                                       std::try_to_lock);
+    if (!guard.owns_lock()) {
+      return;
+    }
+    m_buffers.try_for_each(
+        [this](ThreadBuffers<std::string>::Buffer& buffer) {
+          fwrite(buffer.data.data(), 1, buffer.data.size(), m_file);
+          buffer.data.clear();
+        });
     fflush(m_file);
   }
 
+  std::terminate_handler m_previous_terminate{nullptr};
+
  private:
   void init_trace_modules(const char* traceenv) {
     std::unordered_map<std::string, int> module_id_map;
@@ -135,6 +223,24 @@ struct Tracer {
       tok = strtok(nullptr, sep);
     }
     free(tracespec);
+#ifndef NDEBUG
+    for (size_t i = 0; i < N_TRACE_MODULES; ++i) {
+      g_trace_levels[i] = std::max(m_level, m_traces[i]);
+    }
+#endif
+  }
+
+  // The caller must hold the lock of the buffer that owns `data`.
+  void write_out(std::string& data) {
+    if (data.empty()) {
+      return;
+    }
+    if (m_file != nullptr) {
+      std::lock_guard<std::mutex> guard(TraceContext::s_trace_mutex);
+      fwrite(data.data(), 1, data.size(), m_file);
+      fflush(m_file);
+    }
+    data.clear();
   }
 
   void init_trace_file(const char* envfile) {
@@ -160,21 +266,21 @@ struct Tracer {
  private:
   FILE* m_file{nullptr};
   long m_level{0};
-  std::array<long, N_TRACE_MODULES> m_traces;
+  std::array<long, N_TRACE_MODULES> m_traces{};
+  // Each thread's output, written out when it grows large or on flush.
+  ThreadBuffers<std::string> m_buffers;
 };
 
 static Tracer tracer;
-}
 
-#ifdef NDEBUG
-bool traceEnabled(TraceModule, int) {
-  return false;
+void terminate_handler() {
+  tracer.flush_all_on_crash();
+  if (tracer.m_previous_terminate != nullptr) {
+    tracer.m_previous_terminate();
+  }
+  abort();
 }
-#else
-bool traceEnabled(TraceModule module, int level) {
-  return tracer.traceEnabled(module, level);
 }
-#endif
 
 void trace(TraceModule module, int level, const char* fmt, ...) {
   va_list ap;
@@ -183,5 +289,9 @@ void trace(TraceModule module, int level, const char* fmt, ...) {
   va_end(ap);
 }
 
+void flush_trace() { tracer.flush_all(); }
+
+void flush_trace_on_crash() { tracer.flush_all_on_crash(); }
+
 thread_local const std::string* TraceContext::s_current_method = nullptr;
 std::mutex TraceContext::s_trace_mutex;
@@ -109,7 +109,8 @@
   TM(OPT_STORES)         \
   TM(MEINT)              \
   TM(OPUT)               \
-  TM(IODI)
+  TM(IODI)               \
+  TM(PARALLEL)
 
 enum TraceModule : int {
 #define TM(x) x,
@@ -118,10 +119,16 @@ enum TraceModule : int {
       N_TRACE_MODULES,
 };
 
-bool traceEnabled(TraceModule module, int level);
 #ifdef NDEBUG
+inline bool traceEnabled(TraceModule, int) { return false; }
 #define TRACE(...)
 #else
+// The level each module is traced at: the larger of its own level and the
+// global one. Filled in once from the TRACE environment variable.
+extern long g_trace_levels[N_TRACE_MODULES];
+inline bool traceEnabled(TraceModule module, int level) {
+  return level <= g_trace_levels[module];
+}
 void trace(TraceModule module, int level, const char* fmt, ...);
 #define TRACE(module, level, fmt, ...)          \
   do {                                          \
@@ -131,6 +138,22 @@ void trace(TraceModule module, int level, const char* fmt, ...);
   } while (0)
 #endif // NDEBUG
 
+/*
+ * Messages are formatted into a buffer owned by the calling thread and only
+ * written out once the buffer fills up, so tracing from parallel code does not
+ * serialize it. The messages of each thread stay in order, but those of
+ * different threads are not interleaved in the order they were traced. Call
+ * this to write out every thread's pending messages, e.g. at the end of a
+ * pass. Failed assertions, crash signals and std::terminate flush too.
+ */
+void flush_trace();
+
+/*
+ * Like flush_trace(), but for when the process is going down: skips whatever
+ * is locked, e.g. by the crashing thread, instead of waiting for it.
+ */
+void flush_trace_on_crash();
+
 struct TraceContext {
   explicit TraceContext(const std::string& current_method) {
     s_current_method = &current_method;
@@ -15,6 +15,8 @@ namespace {
 
 void make_instanceof_table(
     InstanceOfTable& instance_of_table,
+    TypeIntervals& intervals,
+    uint32_t& next_id,
     const ClassHierarchy& hierarchy,
     const DexType* type,
     size_t depth = 1) {
@@ -33,11 +35,15 @@ void make_instanceof_table(
   parent_chain.emplace_back(type);
   always_assert(parent_chain.size() == depth);
 
+  uint32_t begin = next_id++;
   const auto& children = hierarchy.find(type);
-  if (children == hierarchy.end()) return;
-  for (const auto& child : children->second) {
-    make_instanceof_table(instance_of_table, hierarchy, child, depth + 1);
+  if (children != hierarchy.end()) {
+    for (const auto& child : children->second) {
+      make_instanceof_table(
+          instance_of_table, intervals, next_id, hierarchy, child, depth + 1);
+    }
   }
+  intervals[type] = TypeInterval{begin, next_id};
 }
 
 void load_interface_children(ClassHierarchy& children, const DexClass* intf) {
@@ -182,8 +188,10 @@ void TypeSystem::make_instanceof_interfaces_table() {
     no_parents.emplace_back(parent);
   }
   no_parents.emplace_back(get_object_type());
+  uint32_t next_id = 0;
   for (const auto& root : no_parents) {
-    make_instanceof_table(m_instanceof_table, hierarchy, root);
+    make_instanceof_table(
+        m_instanceof_table, m_intervals, next_id, hierarchy, root);
   }
   for (const auto& root : no_parents) {
     make_interfaces_table(root);
@@ -17,6 +17,17 @@ using TypeVector = std::vector<const DexType*>;
 using InstanceOfTable = std::unordered_map<const DexType*, TypeVector>;
 using TypeToTypeSet = std::unordered_map<const DexType*, TypeSet>;
 
+/**
+ * The position of a type in a pre-order numbering of the class trees: the
+ * type is numbered `begin`, and its subtypes are exactly the types numbered
+ * from `begin` to `end - 1`.
+ */
+struct TypeInterval {
+  uint32_t begin;
+  uint32_t end;
+};
+using TypeIntervals = std::unordered_map<const DexType*, TypeInterval>;
+
 /**
  * TypeSystem
  * A class that computes information and caches on the current known state
@@ -34,6 +45,7 @@ class TypeSystem {
   ClassScopes m_class_scopes;
   ClassHierarchy m_intf_children;
   InstanceOfTable m_instanceof_table;
+  TypeIntervals m_intervals;
   TypeToTypeSet m_interfaces;
 
  public:
@@ -102,16 +114,14 @@ class TypeSystem {
    * The type must be a class (not an interface).
    */
   bool is_subtype(const DexType* parent, const DexType* child) const {
-    const auto& parent_it = m_instanceof_table.find(parent);
-    const auto& child_it = m_instanceof_table.find(child);
-    if (parent_it == m_instanceof_table.end() ||
-        child_it == m_instanceof_table.end()) {
+    const auto& parent_it = m_intervals.find(parent);
+    const auto& child_it = m_intervals.find(child);
+    if (parent_it == m_intervals.end() || child_it == m_intervals.end()) {
       return false;
     }
-    const auto& p_chain = parent_it->second;
-    const auto& c_chain = child_it->second;
-    if (p_chain.size() > c_chain.size()) return false;
-    return c_chain.at(p_chain.size() - 1) == parent;
+    const auto& p = parent_it->second;
+    const auto& c = child_it->second;
+    return p.begin <= c.begin && c.begin < p.end;
   }
 
   /**
@@ -35,21 +35,59 @@ void build_vinfos_for_meth(vinfos_t& vinfos, const DexMethod* meth) {
   vinfos[meth].decl = decl;
 }
 
-vinfos_t build_vinfos(const std::vector<DexClass*>& scope) {
-  vinfos_t vinfos;
+} // end namespace
+
+Vinfo::Vinfo(const std::vector<DexClass*>& scope) {
   for (const DexClass* cls : scope) {
     if (is_interface(cls)) continue;
     for (const DexMethod* meth : cls->get_vmethods()) {
-      build_vinfos_for_meth(vinfos, meth);
+      build_vinfos_for_meth(m_vinfos, meth);
+      m_methods_by_sig[meth->get_name()][meth->get_proto()].insert(meth);
     }
   }
-  return vinfos;
 }
 
-} // end namespace
+void Vinfo::rebuild_signature(const DexString* name, const DexProto* proto) {
+  auto& meths = m_methods_by_sig[name][proto];
+  // The overridden methods outside the scope only have vinfos because of
+  // the methods that override them, so they go away with them.
+  methods_t stale;
+  for (const DexMethod* meth : meths) {
+    stale.insert(meth);
+    auto it = m_vinfos.find(meth);
+    if (it != m_vinfos.end() && it->second.override_of != nullptr) {
+      stale.insert(it->second.override_of);
+    }
+  }
+  for (const DexMethod* meth : stale) {
+    m_vinfos.erase(meth);
+  }
+  for (const DexMethod* meth : meths) {
+    build_vinfos_for_meth(m_vinfos, meth);
+  }
+}
 
-Vinfo::Vinfo(const std::vector<DexClass*>& scope) {
-  m_vinfos = build_vinfos(scope);
+void Vinfo::add_method(const DexMethod* meth) {
+  assert(!is_interface(type_class(meth->get_class())));
+  m_methods_by_sig[meth->get_name()][meth->get_proto()].insert(meth);
+  rebuild_signature(meth->get_name(), meth->get_proto());
+}
+
+void Vinfo::remove_method(const DexMethod* meth) {
+  m_methods_by_sig[meth->get_name()][meth->get_proto()].erase(meth);
+  // The removed method might be the override_of of another method; erase it
+  // first in case nothing refers to it any more.
+  auto it = m_vinfos.find(meth);
+  if (it != m_vinfos.end() && it->second.override_of != nullptr) {
+    m_vinfos.erase(it->second.override_of);
+  }
+  m_vinfos.erase(meth);
+  rebuild_signature(meth->get_name(), meth->get_proto());
+}
+
+void Vinfo::relocate_method(const DexMethod* meth) {
+  assert(m_vinfos.find(meth) != m_vinfos.end());
+  rebuild_signature(meth->get_name(), meth->get_proto());
 }
 
 const DexMethod* Vinfo::get_decl(const DexMethod* meth) {
@@ -18,9 +18,10 @@
  * overridden, what does a vmethod override, where was a vmethod originally
  * declared, etc.
  *
- * This data structure should be rebuilt whenever changes occur to the type
- * hierarchy with mutation of classes/methods, e.g. DelSuper can delete
- * vmethods.
+ * Passes that mutate the vmethods of classes, e.g. DelSuper deleting
+ * vmethods, can keep a Vinfo up to date with add_method(), remove_method()
+ * and relocate_method() instead of rebuilding it. Changes to the super
+ * classes themselves still require a rebuild.
  *
  * The following caveats apply to ALL methods on Vinfo and will not be
  * reiterated in each piece of method documentation.
@@ -95,6 +96,39 @@ public:
    */
   const methods_t& get_override_methods(const DexMethod* meth);
 
+  /**
+   * Updates the Vinfo after meth was added to the vmethods of its class with
+   * DexClass::add_method. Only the methods with the same name and proto as
+   * meth are recomputed.
+   *
+   * @param meth The added method. Must be concrete and not on an interface.
+   */
+  void add_method(const DexMethod* meth);
+
+  /**
+   * Updates the Vinfo after meth was removed from the vmethods of its class
+   * with DexClass::remove_method. meth may not be queried afterwards.
+   *
+   * @param meth The removed method.
+   */
+  void remove_method(const DexMethod* meth);
+
+  /**
+   * Updates the Vinfo after meth was moved to the vmethods of another class,
+   * e.g. with relocate_method. Its name and proto must not have changed.
+   *
+   * @param meth The relocated method.
+   */
+  void relocate_method(const DexMethod* meth);
+
 private:
+  // Recomputes the vinfos of the methods with the given name and proto, as
+  // only methods with the same signature can override each other.
+  void rebuild_signature(const DexString* name, const DexProto* proto);
+
   vinfos_t m_vinfos;
+  // The vmethods in the scope, by name and proto.
+  std::unordered_map<const DexString*,
+                     std::unordered_map<const DexProto*, methods_t>>
+      m_methods_by_sig;
 };
@@ -9,12 +9,15 @@
 #include "Creators.h"
 #include "DexAccess.h"
 #include "DexUtil.h"
+#include "MethodOverrideGraph.h"
+#include "Parallel.h"
 #include "ReachableClasses.h"
 #include "Timer.h"
 #include "Trace.h"
 
 #include <map>
 #include <set>
+#include <unordered_set>
 
 namespace {
 
@@ -319,15 +322,18 @@ void build_interface_scope(const DexType* type,
 }
 
 /**
- * Merge 2 signatures map. The map from derived_sig_map is copied in
- * base_sig_map.
+ * Merge the signatures of one name from 2 signatures map. The protos in
+ * derived_protos_map are copied in base_protos_map.
  * Interface methods in base don't have an entry yet, that will be build later
  * because it's a straight copy of the class virtual scope.
+ * Only base_protos_map is modified, so different names can be merged
+ * concurrently.
  */
 void merge(const BaseSigs& base_sigs,
            const BaseIntfSigs& base_intf_sig_map,
-           SignatureMap& base_sig_map,
-           const SignatureMap& derived_sig_map) {
+           const DexString* name,
+           ProtoMap& base_protos_map,
+           const ProtoMap& derived_protos_map) {
 
   // Helpers
 
@@ -356,101 +362,115 @@ void merge(const BaseSigs& base_sigs,
       };
 
   // walk all derived signatures
-  for (const auto& derived_sig_entry : derived_sig_map) {
-    const auto name = derived_sig_entry.first;
-    auto& derived_protos_map = derived_sig_entry.second;
-    for (const auto& derived_scopes_it : derived_protos_map) {
-      const auto proto = derived_scopes_it.first;
-      // the signature in derived does not exists in base
-      if (!is_base_sig(name, proto)) {
-        TRACE(VIRT,
-              4,
-              "- no scope (%s:%s) in base, copy over\n",
-              SHOW(name),
-              SHOW(proto));
-        // not a known signature in original base, copy over
-        for (const auto& scope : derived_scopes_it.second) {
-          TRACE(VIRT,
-                4,
-                "- copy %s (%s:%s): (%ld) %s\n",
-                SHOW(scope.type),
-                SHOW(name),
-                SHOW(proto),
-                scope.methods.size(),
-                SHOW(scope.methods[0].first));
-          base_sig_map[name][proto].push_back(scope);
-        }
-        continue;
-      }
-
-      // it's a sig (name, proto) in original base, the derived entry
-      // needs to merge
-      // first scope in base_sig_map must be that of the type under
-      // analysis because we built it first and added to the empty vector
-      always_assert(base_sig_map[name][proto].size() > 0);
+  for (const auto& derived_scopes_it : derived_protos_map) {
+    const auto proto = derived_scopes_it.first;
+    // the signature in derived does not exists in base
+    if (!is_base_sig(name, proto)) {
       TRACE(VIRT,
             4,
-            "- found existing scopes for %s:%s (%ld) - first: %s, %ld, %ld\n",
+            "- no scope (%s:%s) in base, copy over\n",
             SHOW(name),
-            SHOW(proto),
-            base_sig_map[name][proto].size(),
-            SHOW(base_sig_map[name][proto][0].type),
-            base_sig_map[name][proto][0].methods.size(),
-            base_sig_map[name][proto][0].interfaces.size());
-      always_assert(
-          base_sig_map[name][proto][0].type == get_object_type() ||
-          !is_interface(type_class(base_sig_map[name][proto][0].type)));
-      // walk every scope in derived that we have to merge
-      TRACE(VIRT, 4, "-- walking scopes\n");
+            SHOW(proto));
+      // not a known signature in original base, copy over
       for (const auto& scope : derived_scopes_it.second) {
-        // if the scope was for a class (!interface) we merge
-        // with that of base which is now the top definition
         TRACE(VIRT,
               4,
-              "-- checking scope type %s(%ld)\n",
+              "- copy %s (%s:%s): (%ld) %s\n",
               SHOW(scope.type),
-              scope.methods.size());
+              SHOW(name),
+              SHOW(proto),
+              scope.methods.size(),
+              SHOW(scope.methods[0].first));
+        base_protos_map[proto].push_back(scope);
+      }
+      continue;
+    }
+
+    // it's a sig (name, proto) in original base, the derived entry
+    // needs to merge
+    // first scope in base_sig_map must be that of the type under
+    // analysis because we built it first and added to the empty vector
+    always_assert(base_protos_map[proto].size() > 0);
+    TRACE(VIRT,
+          4,
+          "- found existing scopes for %s:%s (%ld) - first: %s, %ld, %ld\n",
+          SHOW(name),
+          SHOW(proto),
+          base_protos_map[proto].size(),
+          SHOW(base_protos_map[proto][0].type),
+          base_protos_map[proto][0].methods.size(),
+          base_protos_map[proto][0].interfaces.size());
+    always_assert(
+        base_protos_map[proto][0].type == get_object_type() ||
+        !is_interface(type_class(base_protos_map[proto][0].type)));
+    // walk every scope in derived that we have to merge
+    TRACE(VIRT, 4, "-- walking scopes\n");
+    for (const auto& scope : derived_scopes_it.second) {
+      // if the scope was for a class (!interface) we merge
+      // with that of base which is now the top definition
+      TRACE(VIRT,
+            4,
+            "-- checking scope type %s(%ld)\n",
+            SHOW(scope.type),
+            scope.methods.size());
+      TRACE(VIRT,
+            4,
+            "-- is interface 0x%X %d\n",
+            scope.type,
+            scope.type != get_object_type() &&
+                is_interface(type_class(scope.type)));
+      if (scope.type == get_object_type() ||
+          !is_interface(type_class(scope.type))) {
         TRACE(VIRT,
               4,
-              "-- is interface 0x%X %d\n",
-              scope.type,
-              scope.type != get_object_type() &&
-                  is_interface(type_class(scope.type)));
-        if (scope.type == get_object_type() ||
-            !is_interface(type_class(scope.type))) {
-          TRACE(VIRT,
-                4,
-                "-- merging with base scopes %s(%ld) : %s\n",
-                SHOW(base_sig_map[name][proto][0].type),
-                base_sig_map[name][proto][0].methods.size(),
-                SHOW(base_sig_map[name][proto][0].methods[0].first));
-          merge(base_sig_map[name][proto][0], scope);
-          continue;
-        }
-        // interface case. If derived was for an interface in base
-        // do nothing because we will create those entries later
-        if (!is_base_intf_sig(name, proto, scope.type)) {
-          TRACE(VIRT,
-                4,
-                "-- unimplemented interface %s:%s - %s, %s\n",
-                SHOW(name),
-                SHOW(proto),
-                SHOW(scope.type),
-                SHOW(scope.methods[0].first));
-          base_sig_map[name][proto].push_back(scope);
-          continue;
-        }
+              "-- merging with base scopes %s(%ld) : %s\n",
+              SHOW(base_protos_map[proto][0].type),
+              base_protos_map[proto][0].methods.size(),
+              SHOW(base_protos_map[proto][0].methods[0].first));
+        merge(base_protos_map[proto][0], scope);
+        continue;
+      }
+      // interface case. If derived was for an interface in base
+      // do nothing because we will create those entries later
+      if (!is_base_intf_sig(name, proto, scope.type)) {
         TRACE(VIRT,
               4,
-              "-- implemented interface %s:%s - %s\n",
+              "-- unimplemented interface %s:%s - %s, %s\n",
               SHOW(name),
               SHOW(proto),
-              SHOW(scope.type));
+              SHOW(scope.type),
+              SHOW(scope.methods[0].first));
+        base_protos_map[proto].push_back(scope);
+        continue;
       }
+      TRACE(VIRT,
+            4,
+            "-- implemented interface %s:%s - %s\n",
+            SHOW(name),
+            SHOW(proto),
+            SHOW(scope.type));
     }
   }
 }
 
+/**
+ * Merge 2 signatures map. The map from derived_sig_map is copied in
+ * base_sig_map.
+ */
+void merge(const BaseSigs& base_sigs,
+           const BaseIntfSigs& base_intf_sig_map,
+           SignatureMap& base_sig_map,
+           const SignatureMap& derived_sig_map) {
+  for (const auto& derived_sig_entry : derived_sig_map) {
+    const auto name = derived_sig_entry.first;
+    merge(base_sigs,
+          base_intf_sig_map,
+          name,
+          base_sig_map[name],
+          derived_sig_entry.second);
+  }
+}
+
 //
 // Helpers to load interface methods in a MethodMap.
 //
@@ -473,7 +493,7 @@ DexMethod* make_miranda(const DexType* type,
   return static_cast<DexMethod*>(miranda);
 }
 
-bool load_interfaces_methods(const std::deque<DexType*>&, BaseIntfSigs&);
+bool load_interfaces_methods(const DexTypeList&, BaseIntfSigs&);
 
 /**
  * Load methods for a given interface and its super interfaces.
@@ -499,7 +519,7 @@ bool load_interface_methods(const DexClass* intf_cls,
  * Load methods for a list of interfaces.
  * If any interface escapes (no DexClass*) return true.
  */
-bool load_interfaces_methods(const std::deque<DexType*>& interfaces,
+bool load_interfaces_methods(const DexTypeList& interfaces,
                              BaseIntfSigs& intf_methods) {
   bool escaped = false;
   for (const auto& intf : interfaces) {
@@ -605,6 +625,71 @@ void load_methods(const DexType* type, SignatureMap& sig_map) {
   }
 }
 
+bool build_signature_map(const ClassHierarchy& hierarchy,
+                         const DexType* type,
+                         SignatureMap& sig_map,
+                         bool parallel);
+
+/**
+ * Build the signature maps of all the children of a type in parallel, one
+ * subtree per task, and merge them into the signature map of the type.
+ * Every name is merged in its own task too, going through the children in
+ * the same order as a sequential walk, so the result does not depend on the
+ * scheduling. Under java.lang.Object this splits the work across all the
+ * independent hierarchies and interfaces of the scope.
+ */
+bool merge_children(const ClassHierarchy& hierarchy,
+                    const TypeSet& children,
+                    const BaseSigs& base_sigs,
+                    const BaseIntfSigs& intf_sig_map,
+                    SignatureMap& sig_map) {
+  struct ChildSigMap {
+    const DexType* type;
+    SignatureMap sig_map;
+    bool escape{false};
+  };
+  std::vector<ChildSigMap> child_sig_maps;
+  child_sig_maps.reserve(children.size());
+  for (const auto& child : children) {
+    child_sig_maps.push_back(ChildSigMap{child, {}, false});
+  }
+  parallel_for(child_sig_maps.begin(),
+               child_sig_maps.end(),
+               [&](ChildSigMap& child) {
+                 child.escape = build_signature_map(
+                     hierarchy, child.type, child.sig_map, false);
+               },
+               /* grain */ 1);
+
+  // Create the entries of all the names up front, so that the tree of
+  // sig_map is not modified while the names are merged.
+  bool escape = false;
+  std::unordered_set<const DexString*> seen;
+  std::vector<std::pair<const DexString*, ProtoMap*>> names;
+  for (const auto& child : child_sig_maps) {
+    escape = escape || child.escape;
+    for (const auto& protos_it : child.sig_map) {
+      if (seen.insert(protos_it.first).second) {
+        names.emplace_back(protos_it.first, &sig_map[protos_it.first]);
+      }
+    }
+  }
+  parallel_for(names.begin(),
+               names.end(),
+               [&](const std::pair<const DexString*, ProtoMap*>& name) {
+                 for (const auto& child : child_sig_maps) {
+                   auto derived = child.sig_map.find(name.first);
+                   if (derived == child.sig_map.end()) continue;
+                   merge(base_sigs,
+                         intf_sig_map,
+                         name.first,
+                         *name.second,
+                         derived->second);
+                 }
+               });
+  return escape;
+}
+
 /**
  * Compute VirtualScopes and virtual method flags.
  * Starting from java.lang.Object recursively walk the type hierarchy down
@@ -645,7 +730,8 @@ void load_methods(const DexType* type, SignatureMap& sig_map) {
  */
 bool build_signature_map(const ClassHierarchy& hierarchy,
                          const DexType* type,
-                         SignatureMap& sig_map) {
+                         SignatureMap& sig_map,
+                         bool parallel = false) {
   always_assert_log(sig_map.size() == 0,
                     "intf_methods and children_methods are out params");
   const TypeSet& children = hierarchy.at(type);
@@ -661,16 +747,21 @@ bool build_signature_map(const ClassHierarchy& hierarchy,
   // recurse through every child to collect all methods
   // and interface methods under type
   bool escape_up = false;
-  for (const auto& child : children) {
-    SignatureMap child_sig_map;
-    escape_up =
-        build_signature_map(hierarchy, child, child_sig_map) || escape_up;
-    TRACE(VIRT,
-          3,
-          "* Merging sig map of %s with child %s\n",
-          SHOW(type),
-          SHOW(child));
-    merge(base_sigs, intf_sig_map, sig_map, child_sig_map);
+  if (parallel) {
+    escape_up = merge_children(
+        hierarchy, children, base_sigs, intf_sig_map, sig_map);
+  } else {
+    for (const auto& child : children) {
+      SignatureMap child_sig_map;
+      escape_up =
+          build_signature_map(hierarchy, child, child_sig_map) || escape_up;
+      TRACE(VIRT,
+            3,
+            "* Merging sig map of %s with child %s\n",
+            SHOW(type),
+            SHOW(child));
+      merge(base_sigs, intf_sig_map, sig_map, child_sig_map);
+    }
   }
 
   TRACE(VIRT, 3, "* Marking methods at %s\n", SHOW(type));
@@ -771,10 +862,31 @@ void get_root_scopes(const SignatureMap& sig_map,
 
 SignatureMap build_signature_map(const ClassHierarchy& class_hierarchy) {
   SignatureMap signature_map;
-  build_signature_map(class_hierarchy, get_object_type(), signature_map);
+  build_signature_map(class_hierarchy,
+                      get_object_type(),
+                      signature_map,
+                      /* parallel */ true);
   return signature_map;
 }
 
+std::shared_ptr<const SignatureMap> SignatureMapCache::get(const Scope& scope) {
+  auto inputs = method_override_graph::graph_inputs(scope);
+  std::lock_guard<std::mutex> guard(m_lock);
+  if (m_sig_map == nullptr || inputs != m_inputs) {
+    ClassHierarchy class_hierarchy = build_type_hierarchy(scope);
+    m_sig_map = std::make_shared<const SignatureMap>(
+        build_signature_map(class_hierarchy));
+    m_inputs = std::move(inputs);
+  }
+  return m_sig_map;
+}
+
+void SignatureMapCache::clear() {
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_inputs.clear();
+  m_sig_map.reset();
+}
+
 const std::vector<DexMethod*>& get_vmethods(const DexType* type) {
   const DexClass* cls = type_class(type);
   if (cls == nullptr) {
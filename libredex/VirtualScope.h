@@ -13,6 +13,8 @@
 #include "Timer.h"
 #include <vector>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 
 
@@ -198,6 +200,24 @@ using SignatureMap =
  */
 SignatureMap build_signature_map(const ClassHierarchy& class_hierarchy);
 
+/**
+ * Keeps the SignatureMap of a scope around, so that passes running back to
+ * back can share it read-only instead of each building their own. The map is
+ * rebuilt when a class, its super class, its interfaces or its virtual
+ * methods have changed since it was built.
+ */
+class SignatureMapCache {
+ public:
+  std::shared_ptr<const SignatureMap> get(const Scope& scope);
+
+  void clear();
+
+ private:
+  std::mutex m_lock;
+  std::vector<const void*> m_inputs;
+  std::shared_ptr<const SignatureMap> m_sig_map;
+};
+
 /**
  * Given a DexMethod return the scope the method is in.
  */
@@ -455,8 +475,12 @@ inline std::vector<DexMethod*> devirtualize(const SignatureMap& sig_map) {
 }
 
 inline std::vector<DexMethod*> devirtualize(
-    const std::vector<DexClass*>& scope) {
+    const std::vector<DexClass*>& scope,
+    SignatureMapCache* sig_map_cache = nullptr) {
   Timer timer("Devirtualizer");
+  if (sig_map_cache != nullptr) {
+    return devirtualize(*sig_map_cache->get(scope));
+  }
   ClassHierarchy class_hierarchy = build_type_hierarchy(scope);
   auto signature_map = build_signature_map(class_hierarchy);
   return devirtualize(signature_map);
@@ -484,7 +508,11 @@ inline std::unordered_set<const DexMethod*> find_non_overridden_virtuals(
 }
 
 inline std::unordered_set<const DexMethod*> find_non_overridden_virtuals(
-    const std::vector<DexClass*>& scope) {
+    const std::vector<DexClass*>& scope,
+    SignatureMapCache* sig_map_cache = nullptr) {
+  if (sig_map_cache != nullptr) {
+    return find_non_overridden_virtuals(*sig_map_cache->get(scope));
+  }
   ClassHierarchy class_hierarchy = build_type_hierarchy(scope);
   auto signature_map = build_signature_map(class_hierarchy);
   return find_non_overridden_virtuals(signature_map);
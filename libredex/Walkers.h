@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <functional>
+#include <queue>
 #include <thread>
 #include <vector>
 
@@ -18,6 +19,7 @@
 #include "EditableCfgAdapter.h"
 #include "IRCode.h"
 #include "Match.h"
+#include "WorkItemProfiler.h"
 #include "WorkQueue.h"
 
 /**
@@ -235,23 +237,29 @@ class walk {
     }
   }
 
+  static void iterate_method_code(DexMethod* m,
+                                  MethodFilterFn filter,
+                                  CodeWalkerFn walker) {
+    if (filter(m)) {
+      auto code = m->get_code();
+      if (code) {
+        walker(m, *code);
+      }
+    }
+  }
+
   static void iterate_code(const DexClass* cls,
                            MethodFilterFn filter,
                            CodeWalkerFn walker) {
     iterate_methods(cls, [&filter, &walker](DexMethod* m) {
-      if (filter(m)) {
-        auto code = m->get_code();
-        if (code) {
-          walker(m, *code);
-        }
-      }
+      iterate_method_code(m, filter, walker);
     });
   }
 
-  static void iterate_opcodes(const DexClass* cls,
-                              MethodFilterFn filter,
-                              InsnWalkerFn walker) {
-    iterate_code(cls, filter, [&walker](DexMethod* m, IRCode& code) {
+  static void iterate_method_opcodes(DexMethod* m,
+                                     MethodFilterFn filter,
+                                     InsnWalkerFn walker) {
+    iterate_method_code(m, filter, [&walker](DexMethod* m, IRCode& code) {
       editable_cfg_adapter::iterate(&code, [&walker, &m](MethodItemEntry* mie) {
         walker(m, mie->insn);
         return editable_cfg_adapter::LOOP_CONTINUE;
@@ -259,6 +267,14 @@ class walk {
     });
   }
 
+  static void iterate_opcodes(const DexClass* cls,
+                              MethodFilterFn filter,
+                              InsnWalkerFn walker) {
+    iterate_methods(cls, [&filter, &walker](DexMethod* m) {
+      iterate_method_opcodes(m, filter, walker);
+    });
+  }
+
   static void iterate_annotations(DexClass* cls, AnnotationWalkerFn walker) {
     call_annotation_walker(cls, walker);
     iterate_fields(cls, [&walker](DexField* field) {
@@ -365,12 +381,23 @@ class walk {
    * sequential counterparts.
    * The unit of parallelization is a DexClass. The reason is that we don't want
    * to create too many tasks on the WorkQueue, paying the overhead for each.
+   * Classes are scheduled by their estimated cost, largest first. Callers of
+   * the method-level walkers can opt into splitting the classes that are large
+   * enough to hold up the whole walk into one task per method.
    */
   class parallel {
    public:
     parallel() = delete;
     ~parallel() = delete;
 
+    /**
+     * Whether a method-level walker may split a large class into one task per
+     * method, which visits the methods of the class concurrently. Only opt in
+     * when the walker neither keeps state per class nor looks at the other
+     * methods of the class it is given.
+     */
+    enum class Split { NONE, LARGE_CLASSES };
+
     /**
      * Call walker on all classes in `classes` in parallel.
      */
@@ -390,11 +417,12 @@ class walk {
     template <class Classes>
     static void methods(const Classes& classes,
                         MethodWalkerFn walker,
-                        size_t num_threads = default_num_threads()) {
-      auto wq = workqueue_foreach<DexClass*>(
-          [&walker](DexClass* cls) { walk::iterate_methods(cls, walker); },
+                        size_t num_threads = default_num_threads(),
+                        Split split = Split::NONE) {
+      auto wq = workqueue_foreach<WorkItem>(
+          [&walker](WorkItem item) { item.iterate_methods(walker); },
           num_threads);
-      run_all(wq, classes);
+      run_all_split(wq, classes, split);
     }
 
     /**
@@ -409,29 +437,50 @@ class walk {
                                  MethodWalkerFn walker,
                                  OutputReducerFn reducer,
                                  const Output& init = Output(),
-                                 size_t num_threads = default_num_threads()) {
-      auto wq = WorkQueue<DexClass*, std::nullptr_t, Output>(
-          [&](WorkerState<DexClass*, std::nullptr_t, Output>* state,
-              DexClass* cls) {
+                                 size_t num_threads = default_num_threads(),
+                                 Split split = Split::NONE) {
+      auto wq = WorkQueue<WorkItem, std::nullptr_t, Output>(
+          [&](WorkerState<WorkItem, std::nullptr_t, Output>* state,
+              WorkItem item) {
             Output out = init;
-            for (auto dmethod : cls->get_dmethods()) {
-              TraceContext context(dmethod->get_deobfuscated_name());
-              out = reducer(out, walker(dmethod));
-            }
-            for (auto vmethod : cls->get_vmethods()) {
-              TraceContext context(vmethod->get_deobfuscated_name());
-              out = reducer(out, walker(vmethod));
-            }
+            item.iterate_methods([&](DexMethod* m) {
+              out = reducer(std::move(out), walker(m));
+            });
             return out;
           },
           reducer,
           [](unsigned int) { return nullptr; },
           num_threads);
+      return run_all_split(wq, classes, split);
+    }
 
-      for (const auto& cls : classes) {
-        wq.add_item(cls);
-      };
-      return wq.run_all();
+    /**
+     * Like reduce_methods(), but folds the Output of each method into the
+     * result in place with `accumulator(Output& acc, Output&& item)`, and
+     * merges the results of the workers in parallel. Prefer this when Output
+     * is a set or a map.
+     */
+    template <class Output,
+              class Classes,
+              class MethodWalkerFn = Output(DexMethod*),
+              class OutputAccumulatorFn = void(Output&, Output&&)>
+    Output static accumulate_methods(
+        const Classes& classes,
+        MethodWalkerFn walker,
+        OutputAccumulatorFn accumulator,
+        const Output& init = Output(),
+        size_t num_threads = default_num_threads(),
+        Split split = Split::NONE) {
+      auto wq = workqueue_accumulate<WorkItem, Output>(
+          [&](WorkItem item) {
+            Output out = init;
+            item.iterate_methods(
+                [&](DexMethod* m) { accumulator(out, walker(m)); });
+            return out;
+          },
+          accumulator,
+          num_threads);
+      return run_all_split(wq, classes, split);
     }
 
     /**
@@ -455,13 +504,16 @@ class walk {
     static void code(const Classes& classes,
                      MethodFilterFn filter,
                      CodeWalkerFn walker,
-                     size_t num_threads = default_num_threads()) {
-      auto wq = workqueue_foreach<DexClass*>(
-          [&filter, &walker](DexClass* cls) {
-            walk::iterate_code(cls, filter, walker);
+                     size_t num_threads = default_num_threads(),
+                     Split split = Split::NONE) {
+      auto wq = workqueue_foreach<WorkItem>(
+          [&filter, &walker](WorkItem item) {
+            item.iterate_methods([&filter, &walker](DexMethod* m) {
+              walk::iterate_method_code(m, filter, walker);
+            });
           },
           num_threads);
-      run_all(wq, classes);
+      run_all_split(wq, classes, split);
     }
 
     /**
@@ -470,8 +522,9 @@ class walk {
     template <class Classes>
     static void code(const Classes& classes,
                      CodeWalkerFn walker,
-                     size_t num_threads = default_num_threads()) {
-      walk::parallel::code(classes, all_methods, walker, num_threads);
+                     size_t num_threads = default_num_threads(),
+                     Split split = Split::NONE) {
+      walk::parallel::code(classes, all_methods, walker, num_threads, split);
     }
 
     /**
@@ -482,13 +535,16 @@ class walk {
     static void opcodes(const Classes& classes,
                         MethodFilterFn filter,
                         InsnWalkerFn walker,
-                        size_t num_threads = default_num_threads()) {
-      auto wq = workqueue_foreach<DexClass*>(
-          [&filter, &walker](DexClass* cls) {
-            walk::iterate_opcodes(cls, filter, walker);
+                        size_t num_threads = default_num_threads(),
+                        Split split = Split::NONE) {
+      auto wq = workqueue_foreach<WorkItem>(
+          [&filter, &walker](WorkItem item) {
+            item.iterate_methods([&filter, &walker](DexMethod* m) {
+              walk::iterate_method_opcodes(m, filter, walker);
+            });
           },
           num_threads);
-      run_all(wq, classes);
+      run_all_split(wq, classes, split);
     }
 
     /**
@@ -497,8 +553,10 @@ class walk {
     template <class Classes>
     static void opcodes(const Classes& classes,
                         InsnWalkerFn walker,
-                        size_t num_threads = default_num_threads()) {
-      walk::parallel::opcodes(classes, all_methods, walker, num_threads);
+                        size_t num_threads = default_num_threads(),
+                        Split split = Split::NONE) {
+      walk::parallel::opcodes(classes, all_methods, walker, num_threads,
+                              split);
     }
 
     /**
@@ -569,12 +627,164 @@ class walk {
     }
 
    private:
+    /*
+     * Either a whole class, or a single method of a class that was split up
+     * because of its size.
+     */
+    struct WorkItem {
+      DexClass* cls;
+      DexMethod* method;
+
+      void iterate_methods(MethodWalkerFn walker) const {
+        // Methods, rather than whole classes, are what the WorkItemProfiler
+        // attributes the time to.
+        auto profiled_walker = [&walker](DexMethod* m) {
+          WorkItemProfiler::Scope profile(WorkItemProfiler::item(m));
+          walker(m);
+        };
+        if (method == nullptr) {
+          walk::iterate_methods(cls, profiled_walker);
+        } else {
+          TraceContext context(method->get_deobfuscated_name());
+          profiled_walker(method);
+        }
+      }
+    };
+
+    static size_t method_cost(const DexMethod* method) {
+      auto code = method->get_code();
+      // Count every method for at least one unit of work, as the walker gets
+      // called on it regardless.
+      return 1 + (code != nullptr ? code->estimate_size() : 0);
+    }
+
+    static size_t class_cost(const DexClass* cls) {
+      size_t cost = 0;
+      for (auto m : cls->get_dmethods()) {
+        cost += method_cost(m);
+      }
+      for (auto m : cls->get_vmethods()) {
+        cost += method_cost(m);
+      }
+      return cost;
+    }
+
+    static const DexClass* class_of(const DexClass* cls) { return cls; }
+
+    static const DexClass* class_of(const WorkItem& item) { return item.cls; }
+
+    /*
+     * Longest-processing-time-first scheduling: hand out the items in order
+     * of decreasing cost, each one to the worker with the least work so far.
+     * Workers pop their own queue in LIFO order, so each queue is filled with
+     * its cheapest items first.
+     *
+     * When the workers are spread over several NUMA nodes, each class is first
+     * given to a node by its address, and only balanced among the workers of
+     * that node. A class thus stays on the same node from one walk to the
+     * next, along with the memory that was allocated for it there.
+     */
+    template <class WQ, class Item>
+    static auto schedule(WQ& wq, std::vector<std::pair<size_t, Item>>& items)
+        -> decltype(wq.run_all()) {
+      std::stable_sort(items.begin(), items.end(),
+                       [](const std::pair<size_t, Item>& a,
+                          const std::pair<size_t, Item>& b) {
+                         return a.first > b.first;
+                       });
+      auto num_workers = wq.num_threads();
+      using Load = std::pair<size_t, size_t>; // (cost so far, worker index)
+      using Loads =
+          std::priority_queue<Load, std::vector<Load>, std::greater<Load>>;
+      // One group of workers per node that has any.
+      std::vector<Loads> groups;
+      for (size_t i = 0; i < num_workers; ++i) {
+        if (i == 0 || wq.worker_node(i) != wq.worker_node(i - 1)) {
+          groups.emplace_back();
+        }
+        groups.back().emplace(0, i);
+      }
+      std::vector<std::vector<Item>> assigned(num_workers);
+      for (auto& cost_and_item : items) {
+        size_t group = 0;
+        if (groups.size() > 1) {
+          auto address =
+              reinterpret_cast<uintptr_t>(class_of(cost_and_item.second));
+          group = std::hash<uintptr_t>()(address / alignof(DexClass)) %
+                  groups.size();
+        }
+        auto& loads = groups[group];
+        auto load = loads.top();
+        loads.pop();
+        assigned[load.second].push_back(cost_and_item.second);
+        loads.emplace(load.first + cost_and_item.first, load.second);
+      }
+      for (size_t i = 0; i < num_workers; ++i) {
+        for (auto it = assigned[i].rbegin(); it != assigned[i].rend(); ++it) {
+          wq.add_item(*it, i);
+        }
+      }
+
+      bool trace_stats = traceEnabled(PARALLEL, 2);
+      if (trace_stats) {
+        wq.enable_stats();
+      }
+      auto result = wq.run_all();
+      if (trace_stats) {
+        auto stats = wq.get_worker_stats();
+        for (size_t i = 0; i < stats.size(); ++i) {
+          TRACE(PARALLEL, 2,
+                "worker %zu: %zu tasks, busy %.3fs, idle %.3fs\n", i,
+                stats[i].num_tasks, stats[i].busy_secs, stats[i].idle_secs);
+        }
+      }
+      return result;
+    }
+
     template <class WQ, class Classes>
     static void run_all(WQ& wq, const Classes& classes) {
+      std::vector<std::pair<size_t, DexClass*>> items;
       for (const auto& cls : classes) {
-        wq.add_item(cls);
-      };
-      wq.run_all();
+        items.emplace_back(class_cost(cls), cls);
+      }
+      schedule(wq, items);
+    }
+
+    /*
+     * Like run_all(), but with Split::LARGE_CLASSES, a class whose cost is
+     * more than a fraction of what each worker should get on average is
+     * visited one method at a time.
+     */
+    template <class WQ, class Classes>
+    static auto run_all_split(WQ& wq, const Classes& classes, Split split)
+        -> decltype(wq.run_all()) {
+      std::vector<std::pair<size_t, WorkItem>> items;
+      size_t total_cost = 0;
+      for (const auto& cls : classes) {
+        auto cost = class_cost(cls);
+        items.emplace_back(cost, WorkItem{cls, nullptr});
+        total_cost += cost;
+      }
+      if (split == Split::NONE) {
+        return schedule(wq, items);
+      }
+      auto split_threshold =
+          std::max<size_t>(1, total_cost / (4 * wq.num_threads()));
+      std::vector<std::pair<size_t, WorkItem>> split_items;
+      for (auto& cost_and_item : items) {
+        if (cost_and_item.first <= split_threshold) {
+          split_items.push_back(cost_and_item);
+          continue;
+        }
+        auto cls = cost_and_item.second.cls;
+        for (auto m : cls->get_dmethods()) {
+          split_items.emplace_back(method_cost(m), WorkItem{cls, m});
+        }
+        for (auto m : cls->get_vmethods()) {
+          split_items.emplace_back(method_cost(m), WorkItem{cls, m});
+        }
+      }
+      return schedule(wq, split_items);
     }
   };
 };
@@ -7,6 +7,7 @@
 
 #include "Warning.h"
 
+#include <atomic>
 #include <cstdarg>
 #include <cstdio>
 
@@ -18,8 +19,9 @@ const char* s_warning_text[] = {
 #undef OPT_WARN
 };
 
-size_t s_warning_counts[] = {
-#define OPT_WARN(...) 0,
+// Warnings may be raised from several threads, e.g. while encoding code items.
+std::atomic<size_t> s_warning_counts[] = {
+#define OPT_WARN(...) {0},
     OPT_WARNINGS
 #undef OPT_WARN
 };
@@ -28,7 +30,7 @@ constexpr size_t kNumWarnings =
     sizeof(s_warning_counts) / sizeof(s_warning_counts[0]);
 
 void opt_warn(OptWarning warn, const char* fmt, ...) {
-  ++s_warning_counts[warn];
+  s_warning_counts[warn].fetch_add(1, std::memory_order_relaxed);
   if (g_warning_level == WARN_FULL) {
     va_list ap;
     va_start(ap, fmt);
@@ -41,7 +43,7 @@ void opt_warn(OptWarning warn, const char* fmt, ...) {
 void print_warning_summary() {
   if (g_warning_level != WARN_COUNT) return;
   for (size_t i = 0; i < kNumWarnings; i++) {
-    size_t count = s_warning_counts[i];
+    size_t count = s_warning_counts[i].load();
     if (count > 0) {
       fprintf(stderr,
               "Optimization warning: %s: %zu occurrences\n",
@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "WorkItemProfiler.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include "DexClass.h"
+#include "Show.h"
+
+std::atomic<size_t> WorkItemProfiler::s_top_n{0};
+ThreadBuffers<WorkItemProfiler::ThreadSamples> WorkItemProfiler::s_buffers;
+
+namespace {
+
+bool slower(const WorkItemProfiler::Sample& a,
+            const WorkItemProfiler::Sample& b) {
+  return a.secs > b.secs;
+}
+
+} // namespace
+
+void WorkItemProfiler::set_worker_id(size_t worker_id) {
+  auto& buffer = s_buffers.this_thread();
+  std::lock_guard<std::mutex> guard(buffer.lock);
+  buffer.data.worker_id = worker_id;
+}
+
+void WorkItemProfiler::start(size_t top_n) {
+  using Buffer = ThreadBuffers<ThreadSamples>::Buffer;
+  s_buffers.for_each([](Buffer& buffer) { buffer.data.heap.clear(); });
+  s_top_n.store(top_n, std::memory_order_relaxed);
+}
+
+std::vector<WorkItemProfiler::Sample> WorkItemProfiler::stop() {
+  using Buffer = ThreadBuffers<ThreadSamples>::Buffer;
+  std::vector<Sample> samples;
+  auto top_n = s_top_n.exchange(0, std::memory_order_relaxed);
+  s_buffers.for_each([&samples](Buffer& buffer) {
+    auto& heap = buffer.data.heap;
+    std::move(heap.begin(), heap.end(), std::back_inserter(samples));
+    heap.clear();
+  });
+  std::sort(samples.begin(), samples.end(), slower);
+  if (samples.size() > top_n) {
+    samples.resize(top_n);
+  }
+  return samples;
+}
+
+void WorkItemProfiler::record(const Item& item, clock::duration duration) {
+  auto top_n = s_top_n.load(std::memory_order_relaxed);
+  auto secs = std::chrono::duration<double>(duration).count();
+  auto& buffer = s_buffers.this_thread();
+  std::lock_guard<std::mutex> guard(buffer.lock);
+  auto& heap = buffer.data.heap;
+  if (top_n == 0 || (heap.size() >= top_n && secs <= heap.front().secs)) {
+    return;
+  }
+  // Only the items that make it into the heap get named, as naming costs
+  // more than timing.
+  auto name = item.method != nullptr ? show(item.method) : show(item.cls);
+  if (heap.size() >= top_n) {
+    std::pop_heap(heap.begin(), heap.end(), slower);
+    heap.pop_back();
+  }
+  heap.push_back(Sample{std::move(name), buffer.data.worker_id, secs});
+  std::push_heap(heap.begin(), heap.end(), slower);
+}
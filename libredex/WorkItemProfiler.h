@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "ThreadBuffers.h"
+
+class DexClass;
+class DexMethod;
+
+/*
+ * Times the work items of parallel walks and WorkQueues, to find the classes
+ * and methods that a slow pass spends its time on. Only the slowest items are
+ * kept, and each thread keeps its own, so recording does not contend on a
+ * global lock.
+ *
+ * Recording is off until start() is called; PassManager does so around each
+ * pass when `work_item_profile_top_n` is set.
+ */
+struct WorkItemProfiler {
+  using clock = std::chrono::steady_clock;
+
+  // A class or a method. At most one of them is set.
+  struct Item {
+    const DexMethod* method{nullptr};
+    const DexClass* cls{nullptr};
+
+    bool empty() const { return method == nullptr && cls == nullptr; }
+  };
+
+  struct Sample {
+    std::string name;
+    // The index of the WorkQueue worker that ran the item.
+    size_t worker_id;
+    double secs;
+  };
+
+  // Records how long the item took to process, from construction to
+  // destruction. Does nothing when recording is off or the item is empty.
+  class Scope {
+   public:
+    explicit Scope(Item item)
+        : m_item(enabled() ? item : Item()),
+          m_start(m_item.empty() ? clock::time_point() : clock::now()) {}
+
+    ~Scope() {
+      if (!m_item.empty()) {
+        record(m_item, clock::now() - m_start);
+      }
+    }
+
+   private:
+    Item m_item;
+    clock::time_point m_start;
+  };
+
+  // Start keeping the `top_n` slowest items recorded from now on.
+  static void start(size_t top_n);
+
+  // Stop recording, and return the slowest items recorded since start(),
+  // slowest first. No work items may be running.
+  static std::vector<Sample> stop();
+
+  static bool enabled() {
+    return s_top_n.load(std::memory_order_relaxed) != 0;
+  }
+
+  // Which worker the current thread runs for, as reported in the samples.
+  static void set_worker_id(size_t worker_id);
+
+  static Item item(const DexMethod* method) { return Item{method, nullptr}; }
+  static Item item(const DexClass* cls) { return Item{nullptr, cls}; }
+
+  // Whether the inputs of a WorkQueue are items that can be profiled.
+  template <typename T>
+  using is_item = std::integral_constant<
+      bool,
+      std::is_convertible<T, const DexMethod*>::value ||
+          std::is_convertible<T, const DexClass*>::value>;
+
+ private:
+  struct ThreadSamples {
+    size_t worker_id{0};
+    // A min-heap on the duration, so that the fastest of the kept items is
+    // the one to evict.
+    std::vector<Sample> heap;
+  };
+
+  static void record(const Item& item, clock::duration duration);
+
+  static std::atomic<size_t> s_top_n;
+  static ThreadBuffers<ThreadSamples> s_buffers;
+};
@@ -8,15 +8,21 @@
 #pragma once
 
 #include "Debug.h"
+#include "ThreadPool.h"
+#include "WorkItemProfiler.h"
 
 #include <algorithm>
+#include <atomic>
 #include <boost/optional/optional.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
 #include <chrono>
+#include <deque>
+#include <memory>
 #include <numeric>
 #include <queue>
 #include <random>
+#include <type_traits>
 
 namespace workqueue_impl {
 
@@ -38,11 +44,344 @@ inline std::vector<int> create_permutation(int num, unsigned int thread_idx) {
   return attempts;
 }
 
+/**
+ * A Chase-Lev work-stealing deque, following "Correct and Efficient
+ * Work-Stealing for Weak Memory Models" (Le et al., PPoPP 2013).
+ *
+ * Only the owning thread may call push() and pop(); pop() is LIFO. Any thread
+ * may call steal(), which is FIFO. Neither operation takes a lock.
+ *
+ * Elements are read speculatively by thieves before they have won the race
+ * for them, so T must be trivially copyable. WorkStealingQueue below wraps
+ * this to support arbitrary task types.
+ */
+template <typename T>
+class ChaseLevDeque {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "ChaseLevDeque elements must be trivially copyable");
+
+  struct Buffer {
+    explicit Buffer(int64_t cap)
+        : capacity(cap), mask(cap - 1), slots(new std::atomic<T>[cap]) {}
+
+    T get(int64_t i) const {
+      return slots[i & mask].load(std::memory_order_relaxed);
+    }
+
+    void put(int64_t i, T value) {
+      slots[i & mask].store(value, std::memory_order_relaxed);
+    }
+
+    const int64_t capacity;
+    const int64_t mask;
+    std::unique_ptr<std::atomic<T>[]> slots;
+  };
+
+ public:
+  explicit ChaseLevDeque(int64_t initial_capacity = 64) {
+    always_assert((initial_capacity & (initial_capacity - 1)) == 0);
+    m_buffers.emplace_back(std::make_unique<Buffer>(initial_capacity));
+    m_buffer.store(m_buffers.back().get(), std::memory_order_relaxed);
+  }
+
+  ChaseLevDeque(const ChaseLevDeque&) = delete;
+  ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+  void push(T value) {
+    auto b = m_bottom.load(std::memory_order_relaxed);
+    auto t = m_top.load(std::memory_order_acquire);
+    auto buf = m_buffer.load(std::memory_order_relaxed);
+    if (b - t > buf->capacity - 1) {
+      buf = grow(buf, t, b);
+    }
+    buf->put(b, value);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  boost::optional<T> pop() {
+    auto b = m_bottom.load(std::memory_order_relaxed) - 1;
+    auto buf = m_buffer.load(std::memory_order_relaxed);
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t = m_top.load(std::memory_order_relaxed);
+    if (t > b) {
+      // Empty.
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+      return boost::none;
+    }
+    boost::optional<T> result = buf->get(b);
+    if (t == b) {
+      // Last element: race against the thieves for it.
+      if (!m_top.compare_exchange_strong(t,
+                                         t + 1,
+                                         std::memory_order_seq_cst,
+                                         std::memory_order_relaxed)) {
+        result = boost::none;
+      }
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return result;
+  }
+
+  /*
+   * Returns boost::none if the deque was empty or if another thread won the
+   * race for the oldest element.
+   */
+  boost::optional<T> steal() {
+    auto t = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto b = m_bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+      return boost::none;
+    }
+    auto buf = m_buffer.load(std::memory_order_acquire);
+    T value = buf->get(t);
+    if (!m_top.compare_exchange_strong(t,
+                                       t + 1,
+                                       std::memory_order_seq_cst,
+                                       std::memory_order_relaxed)) {
+      return boost::none;
+    }
+    return value;
+  }
+
+  bool empty() const {
+    return m_bottom.load(std::memory_order_relaxed) <=
+           m_top.load(std::memory_order_relaxed);
+  }
+
+ private:
+  Buffer* grow(Buffer* old, int64_t t, int64_t b) {
+    // Thieves may still be reading from the old buffer, so it is retired
+    // rather than freed. It goes away along with the deque.
+    m_buffers.emplace_back(std::make_unique<Buffer>(old->capacity * 2));
+    auto buf = m_buffers.back().get();
+    for (auto i = t; i < b; ++i) {
+      buf->put(i, old->get(i));
+    }
+    m_buffer.store(buf, std::memory_order_release);
+    return buf;
+  }
+
+  std::atomic<int64_t> m_top{0};
+  std::atomic<int64_t> m_bottom{0};
+  std::atomic<Buffer*> m_buffer{nullptr};
+  // Owned by the pushing thread.
+  std::vector<std::unique_ptr<Buffer>> m_buffers;
+};
+
+/**
+ * The task queue backing each WorkerState. The owning worker pushes and pops
+ * at the back (LIFO, which keeps recently-pushed data warm in its cache) while
+ * other workers steal from the front without taking any lock.
+ *
+ * Tasks live in owner-only slots with stable addresses; the deque only hands
+ * out pointers to them. Whoever takes a task destroys it in its slot, so that
+ * finished tasks hold on to nothing. The owner also gives back the slots of
+ * the tasks it pops; the slots of stolen tasks are released by clear(), which
+ * must only be called while no worker is running.
+ */
+template <typename Input>
+class WorkStealingQueue {
+  using Slot = boost::optional<Input>;
+
+ public:
+  void push(Input task) {
+    m_storage.emplace_back(std::move(task));
+    m_deque.push(&m_storage.back());
+  }
+
+  boost::optional<Input> pop() {
+    auto slot = m_deque.pop();
+    auto task = take(slot);
+    if (slot) {
+      // No other worker can have taken a task that was pushed after this
+      // one and not popped yet, so this is the last slot.
+      assert(*slot == &m_storage.back());
+      m_storage.pop_back();
+    }
+    return task;
+  }
+
+  boost::optional<Input> steal() { return take(m_deque.steal()); }
+
+  void clear() {
+    always_assert(m_deque.empty());
+    m_storage.clear();
+  }
+
+ private:
+  static boost::optional<Input> take(boost::optional<Slot*> slot) {
+    if (!slot) {
+      return boost::none;
+    }
+    boost::optional<Input> task = std::move(**slot);
+    **slot = boost::none;
+    return task;
+  }
+
+  std::deque<Slot> m_storage;
+  ChaseLevDeque<Slot*> m_deque;
+};
+
+// The WorkerState of the worker that runs on this thread, if any.
+inline const void*& current_worker_state() {
+  thread_local const void* t_state = nullptr;
+  return t_state;
+}
+
+// Makes a WorkerState the current one of this thread while it is in scope.
+// The outer one is restored afterwards, for a run_all() nested in a task.
+class CurrentWorkerState {
+ public:
+  explicit CurrentWorkerState(const void* state)
+      : m_outer(current_worker_state()) {
+    current_worker_state() = state;
+  }
+
+  ~CurrentWorkerState() { current_worker_state() = m_outer; }
+
+ private:
+  const void* m_outer;
+};
+
+/**
+ * The original WorkerState queue: a std::queue guarded by a mutex, where both
+ * the owner and thieves consume in FIFO order. Kept around as a baseline for
+ * WorkQueuePerfTest.
+ */
+template <typename Input>
+class LockedQueue {
+ public:
+  void push(Input task) {
+    boost::lock_guard<boost::mutex> guard(m_mtx);
+    m_queue.push(std::move(task));
+  }
+
+  boost::optional<Input> pop() {
+    boost::lock_guard<boost::mutex> guard(m_mtx);
+    if (!m_queue.empty()) {
+      auto task = std::move(m_queue.front());
+      m_queue.pop();
+      return task;
+    }
+    return boost::none;
+  }
+
+  boost::optional<Input> steal() { return pop(); }
+
+  void clear() {}
+
+ private:
+  std::queue<Input> m_queue;
+  boost::mutex m_mtx;
+};
+
 } // namespace workqueue_impl
 
+/**
+ * How a worker spent its time during the last WorkQueue::run_all(). Only
+ * collected after WorkQueue::enable_stats(), or while WorkQueueTotals are
+ * being collected.
+ */
+struct WorkerStats {
+  size_t num_tasks{0};
+  // Looks at the queues of other workers, and how many of them found a task.
+  size_t num_steal_attempts{0};
+  size_t num_steals{0};
+  double busy_secs{0};
+  double idle_secs{0};
+};
+
+/**
+ * The WorkerStats of all the WorkQueue::run_all() calls that complete between
+ * start() and stop(), summed up, whichever WorkQueues they are on. PassManager
+ * collects them for each pass when `work_queue_stats` is set.
+ */
+struct WorkQueueTotals {
+  size_t num_runs{0};
+  size_t num_tasks{0};
+  size_t num_steal_attempts{0};
+  size_t num_steals{0};
+  double wall_secs{0};
+  // Summed over all the workers of all the runs.
+  double busy_secs{0};
+  double idle_secs{0};
+  // The busy time of the busiest worker of each run, summed over the runs:
+  // how long the runs would have taken at the very least, given how their
+  // tasks were spread over the workers.
+  double critical_path_secs{0};
+
+  static void start();
+
+  static WorkQueueTotals stop();
+
+  static bool enabled();
+
+  static void add_run(const std::vector<WorkerStats>& workers,
+                      double wall_secs);
+
+ private:
+  struct Global;
+  static Global& get_global();
+};
+
+struct WorkQueueTotals::Global {
+  std::atomic<bool> enabled{false};
+  boost::mutex lock;
+  WorkQueueTotals totals;
+};
+
+inline WorkQueueTotals::Global& WorkQueueTotals::get_global() {
+  static Global global;
+  return global;
+}
+
+inline void WorkQueueTotals::start() {
+  auto& global = get_global();
+  boost::lock_guard<boost::mutex> guard(global.lock);
+  global.totals = WorkQueueTotals();
+  global.enabled.store(true, std::memory_order_relaxed);
+}
+
+inline WorkQueueTotals WorkQueueTotals::stop() {
+  auto& global = get_global();
+  boost::lock_guard<boost::mutex> guard(global.lock);
+  global.enabled.store(false, std::memory_order_relaxed);
+  return global.totals;
+}
+
+inline bool WorkQueueTotals::enabled() {
+  return get_global().enabled.load(std::memory_order_relaxed);
+}
+
+inline void WorkQueueTotals::add_run(const std::vector<WorkerStats>& workers,
+                                     double wall_secs) {
+  auto& global = get_global();
+  boost::lock_guard<boost::mutex> guard(global.lock);
+  if (!global.enabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+  auto& totals = global.totals;
+  ++totals.num_runs;
+  totals.wall_secs += wall_secs;
+  double critical_path_secs = 0;
+  for (const auto& worker : workers) {
+    totals.num_tasks += worker.num_tasks;
+    totals.num_steal_attempts += worker.num_steal_attempts;
+    totals.num_steals += worker.num_steals;
+    totals.busy_secs += worker.busy_secs;
+    totals.idle_secs += worker.idle_secs;
+    critical_path_secs = std::max(critical_path_secs, worker.busy_secs);
+  }
+  totals.critical_path_secs += critical_path_secs;
+}
+
 template <class Input,
           class Data = std::nullptr_t,
-          class Output = std::nullptr_t>
+          class Output = std::nullptr_t,
+          class TaskQueue = workqueue_impl::WorkStealingQueue<Input>>
 class WorkerState {
  public:
   WorkerState(size_t id, const Data& initial) : m_id(id), m_data(initial) {}
@@ -55,10 +394,13 @@ class WorkerState {
    * Add more items to the queue of the currently-running worker. When a
    * WorkQueue is running, this should be used instead of WorkQueue::add_item()
    * as the latter is not thread-safe.
+   *
+   * Only the worker that owns this state may push to it.
    */
   void push_task(Input task) {
-    boost::lock_guard<boost::mutex> guard(m_queue_mtx);
-    m_queue.push(task);
+    assert_log(!m_running || workqueue_impl::current_worker_state() == this,
+               "Only worker %zu may push to its own queue", m_id);
+    m_queue.push(std::move(task));
   }
 
   size_t worker_id() const {
@@ -66,43 +408,67 @@ class WorkerState {
   }
 
  private:
-  boost::optional<Input> pop_task() {
-    boost::lock_guard<boost::mutex> guard(m_queue_mtx);
-    if (!m_queue.empty()) {
-      auto task = std::move(m_queue.front());
-      m_queue.pop();
-      return task;
-    }
-    return boost::none;
-  }
-
   size_t m_id;
-  std::queue<Input> m_queue;
-  boost::mutex m_queue_mtx;
+  TaskQueue m_queue;
   Data m_data;
   Output m_result;
+  WorkerStats m_stats;
+  // Whether a WorkQueue::run_all() is running the workers.
+  bool m_running{false};
 
-  template <class, class, class>
+  template <class, class, class, class>
   friend class WorkQueue;
 };
 
 template <class Input,
           class Data = std::nullptr_t,
-          class Output = std::nullptr_t>
+          class Output = std::nullptr_t,
+          class TaskQueue = workqueue_impl::WorkStealingQueue<Input>>
 class WorkQueue {
  private:
-  using Mapper =
-      std::function<Output(WorkerState<Input, Data, Output>*, Input)>;
+  using State = WorkerState<Input, Data, Output, TaskQueue>;
+  using Mapper = std::function<Output(State*, Input)>;
+  using Accumulator = std::function<void(Output&, Output&&)>;
   Mapper m_mapper;
   std::function<Output(Output, Output)> m_reducer;
+  Accumulator m_accumulator;
 
-  std::vector<std::unique_ptr<WorkerState<Input, Data, Output>>> m_states;
+  std::vector<std::unique_ptr<State>> m_states;
 
   const size_t m_num_threads{1};
   size_t m_insert_idx{0};
+  bool m_collect_stats{false};
+
+  void consume(State* state, Input task) {
+    if (m_accumulator) {
+      m_accumulator(state->m_result, m_mapper(state, std::move(task)));
+    } else {
+      state->m_result = m_reducer(std::move(state->m_result),
+                                  m_mapper(state, std::move(task)));
+    }
+  }
+
+  void merge_results_in_place();
 
-  void consume(WorkerState<Input, Data, Output>* state, Input task) {
-    state->m_result = m_reducer(state->m_result, m_mapper(state, task));
+  void consume_timed(State* state, Input task) {
+    auto start = std::chrono::steady_clock::now();
+    consume(state, std::move(task));
+    state->m_stats.busy_secs +=
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count();
+    ++state->m_stats.num_tasks;
+  }
+
+  // The class or method a task works on, if the inputs are classes or
+  // methods, for the WorkItemProfiler.
+  template <class T>
+  static WorkItemProfiler::Item profiled_item(const T& task, std::true_type) {
+    return WorkItemProfiler::item(task);
+  }
+
+  template <class T>
+  static WorkItemProfiler::Item profiled_item(const T&, std::false_type) {
+    return WorkItemProfiler::Item();
   }
 
  public:
@@ -114,6 +480,38 @@ class WorkQueue {
 
   void add_item(Input task);
 
+  /*
+   * Add an item to the queue of a specific worker. Like add_item(), this is
+   * not thread-safe. Useful to callers that balance the load themselves.
+   */
+  void add_item(Input task, size_t worker_idx);
+
+  size_t num_threads() const { return m_num_threads; }
+
+  /*
+   * The NUMA node whose pool threads run the given worker, unless they are all
+   * busy. Always zero unless the pool threads are pinned; see
+   * ThreadPool::set_pin_threads().
+   */
+  size_t worker_node(size_t worker_idx) const {
+    return ThreadPool::node_of(
+        worker_idx, m_num_threads, ThreadPool::get().num_nodes());
+  }
+
+  /*
+   * Record how many tasks each worker ran and how long it was busy for. This
+   * costs two clock reads per task, so it is off by default.
+   */
+  void enable_stats() { m_collect_stats = true; }
+
+  std::vector<WorkerStats> get_worker_stats() const {
+    std::vector<WorkerStats> stats;
+    for (const auto& state : m_states) {
+      stats.push_back(state->m_stats);
+    }
+    return stats;
+  }
+
   void set_mapper(Mapper mapper) {
     m_mapper = mapper;
   }
@@ -122,14 +520,25 @@ class WorkQueue {
     m_reducer = reducer;
   }
 
+  /*
+   * Fold the output of each task into the result of its worker in place, as
+   * `accumulator(result, std::move(output))`, instead of going through the
+   * reducer. The results of the workers are then merged pairwise, in
+   * parallel, and run_all() returns the merged results without folding in
+   * `init_output` once more; each worker starts from a copy of it.
+   */
+  void set_accumulator(Accumulator accumulator) {
+    m_accumulator = std::move(accumulator);
+  }
+
   /**
-   * Spawn threads and evaluate function.  This method blocks.
+   * Evaluate function on the global ThreadPool.  This method blocks.
    */
   Output run_all(const Output& init_output = Output());
 };
 
-template <class Input, class Data, class Output>
-WorkQueue<Input, Data, Output>::WorkQueue(
+template <class Input, class Data, class Output, class TaskQueue>
+WorkQueue<Input, Data, Output, TaskQueue>::WorkQueue(
     WorkQueue::Mapper mapper,
     std::function<Output(Output, Output)> reducer,
     std::function<Data(unsigned int /* thread index*/)> data_initializer,
@@ -137,8 +546,7 @@ WorkQueue<Input, Data, Output>::WorkQueue(
     : m_mapper(mapper), m_reducer(reducer), m_num_threads(num_threads) {
   always_assert(num_threads >= 1);
   for (unsigned int i = 0; i < m_num_threads; ++i) {
-    m_states.emplace_back(std::make_unique<WorkerState<Input, Data, Output>>(
-        i, data_initializer(i)));
+    m_states.emplace_back(std::make_unique<State>(i, data_initializer(i)));
   }
 }
 
@@ -150,7 +558,7 @@ template <class Input>
 WorkQueue<Input, std::nullptr_t /* Data */, std::nullptr_t /*Output*/>
 workqueue_foreach(const std::function<void(Input)>& func,
                   unsigned int num_threads =
-                      std::max(1u, boost::thread::hardware_concurrency())) {
+                      ThreadPool::get().num_threads()) {
   using Data = std::nullptr_t;
   using Output = std::nullptr_t;
   return WorkQueue<Input, Data, Output>(
@@ -171,8 +579,7 @@ template <class Input, class Output>
 WorkQueue<Input, std::nullptr_t /* Data */, Output> workqueue_mapreduce(
     const std::function<Output(Input)>& mapper,
     const std::function<Output(Output, Output)>& reducer,
-    unsigned int num_threads =
-        std::max(1u, boost::thread::hardware_concurrency())) {
+    unsigned int num_threads = ThreadPool::get().num_threads()) {
   using Data = std::nullptr_t;
   return WorkQueue<Input, std::nullptr_t, Output>(
       [mapper](WorkerState<Input, Data, Output>*, Input a) -> Output {
@@ -183,31 +590,93 @@ WorkQueue<Input, std::nullptr_t /* Data */, Output> workqueue_mapreduce(
       num_threads);
 }
 
-template <class Input, class Data, class Output>
-void WorkQueue<Input, Data, Output>::add_item(Input task) {
+/**
+ * Creates a new work queue that folds the output of each item into a single
+ * value in place, for outputs that are expensive to copy, like sets and maps.
+ * See WorkQueue::set_accumulator().
+ */
+template <class Input, class Output>
+WorkQueue<Input, std::nullptr_t /* Data */, Output> workqueue_accumulate(
+    const std::function<Output(Input)>& mapper,
+    const std::function<void(Output&, Output&&)>& accumulator,
+    unsigned int num_threads = ThreadPool::get().num_threads()) {
+  using Data = std::nullptr_t;
+  auto wq = WorkQueue<Input, std::nullptr_t, Output>(
+      [mapper](WorkerState<Input, Data, Output>*, Input a) -> Output {
+        return mapper(a);
+      },
+      [accumulator](Output acc, Output item) -> Output {
+        accumulator(acc, std::move(item));
+        return acc;
+      },
+      [](unsigned int) -> Data { return nullptr; },
+      num_threads);
+  wq.set_accumulator(accumulator);
+  return wq;
+}
+
+template <class Input, class Data, class Output, class TaskQueue>
+void WorkQueue<Input, Data, Output, TaskQueue>::add_item(Input task) {
   m_insert_idx = (m_insert_idx + 1) % m_num_threads;
-  m_states[m_insert_idx]->m_queue.push(task);
+  m_states[m_insert_idx]->m_queue.push(std::move(task));
+}
+
+template <class Input, class Data, class Output, class TaskQueue>
+void WorkQueue<Input, Data, Output, TaskQueue>::add_item(Input task,
+                                                         size_t worker_idx) {
+  always_assert(worker_idx < m_num_threads);
+  m_states[worker_idx]->m_queue.push(std::move(task));
 }
 
 /*
  * Each worker thread pulls from its own queue first, and then once finished
- * looks randomly at other queues to try and steal work.
+ * looks randomly at other queues to try and steal work, starting with the
+ * queues of the workers on its own NUMA node.
  */
-template <class Input, class Data, class Output>
-Output WorkQueue<Input, Data, Output>::run_all(const Output& init_output) {
-  std::vector<boost::thread> all_threads;
-  auto worker = [&](WorkerState<Input, Data, Output>* state, size_t state_idx) {
+template <class Input, class Data, class Output, class TaskQueue>
+Output WorkQueue<Input, Data, Output, TaskQueue>::run_all(
+    const Output& init_output) {
+  auto run_start = std::chrono::steady_clock::now();
+  bool collect_stats = m_collect_stats || WorkQueueTotals::enabled();
+  bool profile_items = WorkItemProfiler::enabled();
+  bool multiple_nodes = ThreadPool::get().num_nodes() > 1;
+  auto worker = [&](size_t state_idx) {
+    auto state = m_states[state_idx].get();
+    workqueue_impl::CurrentWorkerState current_state(state);
     state->m_result = init_output;
+    state->m_stats = WorkerStats();
+    if (profile_items) {
+      WorkItemProfiler::set_worker_id(state_idx);
+    }
     auto attempts =
         workqueue_impl::create_permutation(m_num_threads, state_idx);
+    if (multiple_nodes) {
+      // Steal from the workers on the same NUMA node first.
+      std::stable_partition(attempts.begin() + 1, attempts.end(), [&](int idx) {
+        return worker_node(idx) == worker_node(state_idx);
+      });
+    }
     while (true) {
       auto have_task = false;
       for (auto idx : attempts) {
-        auto other_state = m_states[idx].get();
-        auto task = other_state->pop_task();
+        bool is_steal = static_cast<size_t>(idx) != state_idx;
+        auto task =
+            is_steal ? m_states[idx]->m_queue.steal() : state->m_queue.pop();
+        if (collect_stats && is_steal) {
+          ++state->m_stats.num_steal_attempts;
+          state->m_stats.num_steals += task ? 1 : 0;
+        }
         if (task) {
           have_task = true;
-          consume(state, *task);
+          WorkItemProfiler::Scope profile(
+              profile_items
+                  ? profiled_item(*task, WorkItemProfiler::is_item<Input>())
+                  : WorkItemProfiler::Item());
+          if (collect_stats) {
+            consume_timed(state, std::move(*task));
+          } else {
+            consume(state, std::move(*task));
+          }
           break;
         }
       }
@@ -217,20 +686,57 @@ Output WorkQueue<Input, Data, Output>::run_all(const Output& init_output) {
     }
   };
 
-  for (size_t i = 0; i < m_num_threads; ++i) {
-    boost::thread::attributes attrs;
-    attrs.set_stack_size(8 * 1024 * 1024);
-    all_threads.emplace_back(attrs,
-                             boost::bind<void>(worker, m_states[i].get(), i));
+  for (auto& state : m_states) {
+    state->m_running = true;
   }
-
-  for (auto& thread : all_threads) {
-    thread.join();
+  ThreadPool::get().run(m_num_threads, worker);
+  for (auto& state : m_states) {
+    state->m_running = false;
   }
 
+  double wall_secs =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                    run_start)
+          .count();
+  for (auto& thread_state : m_states) {
+    if (collect_stats) {
+      auto& stats = thread_state->m_stats;
+      stats.idle_secs = std::max(0.0, wall_secs - stats.busy_secs);
+    }
+    thread_state->m_queue.clear();
+  }
+  if (collect_stats && WorkQueueTotals::enabled()) {
+    WorkQueueTotals::add_run(get_worker_stats(), wall_secs);
+  }
+  if (m_accumulator) {
+    merge_results_in_place();
+    return std::move(m_states[0]->m_result);
+  }
   Output result = init_output;
   for (auto& thread_state : m_states) {
-    result = m_reducer(result, thread_state->m_result);
+    result = m_reducer(std::move(result), std::move(thread_state->m_result));
   }
   return result;
 }
+
+/*
+ * Merges the result of each worker into that of worker 0 as a binary tree:
+ * each round merges the results that are `stride` apart, in parallel, which
+ * takes log2(num_threads) rounds instead of num_threads sequential merges.
+ */
+template <class Input, class Data, class Output, class TaskQueue>
+void WorkQueue<Input, Data, Output, TaskQueue>::merge_results_in_place() {
+  for (size_t stride = 1; stride < m_num_threads; stride *= 2) {
+    auto num_merges = (m_num_threads - stride + 2 * stride - 1) / (2 * stride);
+    auto merge = [&](size_t i) {
+      auto dst = i * 2 * stride;
+      m_accumulator(m_states[dst]->m_result,
+                    std::move(m_states[dst + stride]->m_result));
+    };
+    if (num_merges == 1) {
+      merge(0);
+    } else {
+      ThreadPool::get().run(num_merges, merge);
+    }
+  }
+}
@@ -0,0 +1,246 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ZipWriter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <zlib.h>
+
+#include "Debug.h"
+#include "Parallel.h"
+
+namespace {
+
+constexpr uint32_t kLocalFileSignature = 0x04034b50;
+constexpr uint32_t kCentralFileSignature = 0x02014b50;
+constexpr uint32_t kCentralDirEndSignature = 0x06054b50;
+constexpr uint16_t kVersion = 20;
+constexpr uint16_t kStored = 0;
+constexpr uint16_t kDeflated = 8;
+// 1980-01-01 00:00, the earliest DOS date.
+constexpr uint16_t kDosTime = 0;
+constexpr uint16_t kDosDate = 0x21;
+
+void put16(std::vector<uint8_t>& out, uint16_t v) {
+  out.push_back(v & 0xff);
+  out.push_back(v >> 8);
+}
+
+void put32(std::vector<uint8_t>& out, uint32_t v) {
+  put16(out, v & 0xffff);
+  put16(out, v >> 16);
+}
+
+// Raw deflate, as zip wants it: no zlib header or trailer.
+bool deflate_raw(const uint8_t* data,
+                 size_t size,
+                 std::vector<uint8_t>& out) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+  out.resize(deflateBound(&stream, size));
+  stream.next_in = const_cast<uint8_t*>(data);
+  stream.avail_in = size;
+  stream.next_out = out.data();
+  stream.avail_out = out.size();
+  int err = deflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  return err == Z_STREAM_END;
+}
+
+void write_all(FILE* fd, const std::vector<uint8_t>& bytes,
+               const std::string& path) {
+  always_assert_log(fwrite(bytes.data(), 1, bytes.size(), fd) == bytes.size(),
+                    "Error writing %s", path.c_str());
+}
+
+} // namespace
+
+ZipWriter::ZipWriter(std::string path) : m_path(std::move(path)) {}
+
+ZipWriter::~ZipWriter() {
+  if (!m_finished) {
+    finish();
+  }
+}
+
+void ZipWriter::add_entry(const std::string& name,
+                          const void* data,
+                          size_t size,
+                          bool compress) {
+  always_assert_log(size <= std::numeric_limits<uint32_t>::max(),
+                    "Zip entry %s is too large", name.c_str());
+  auto bytes = static_cast<const uint8_t*>(data);
+  Entry entry;
+  entry.name = name;
+  entry.crc = crc32(crc32(0, Z_NULL, 0), bytes, size);
+  entry.uncompressed_size = size;
+  entry.method = kStored;
+  if (compress && size > 0 && deflate_raw(bytes, size, entry.data) &&
+      entry.data.size() < size) {
+    entry.method = kDeflated;
+  } else {
+    entry.data.assign(bytes, bytes + size);
+  }
+  add(std::move(entry));
+}
+
+void ZipWriter::add(Entry entry) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  always_assert_log(!m_finished, "Adding %s to finished zip %s",
+                    entry.name.c_str(), m_path.c_str());
+  m_entries.push_back(std::move(entry));
+}
+
+void ZipWriter::add_file(const std::string& name,
+                         const std::string& file_path,
+                         bool compress) {
+  std::ifstream in(file_path, std::ios::binary);
+  always_assert_log(in, "Cannot read %s", file_path.c_str());
+  if (!compress) {
+    std::vector<char> contents((std::istreambuf_iterator<char>(in)),
+                               std::istreambuf_iterator<char>());
+    add_entry(name, contents.data(), contents.size(), false);
+    return;
+  }
+  // The file is read and deflated a chunk at a time, so that only its
+  // compressed contents are held.
+  constexpr size_t k_chunk = 64 * 1024;
+  Entry entry;
+  entry.name = name;
+  entry.crc = crc32(0, Z_NULL, 0);
+  entry.method = kDeflated;
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  always_assert_log(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                                 -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK,
+                    "Cannot deflate %s", file_path.c_str());
+  std::vector<uint8_t> chunk(k_chunk);
+  uint64_t size = 0;
+  int flush;
+  do {
+    in.read(reinterpret_cast<char*>(chunk.data()), chunk.size());
+    always_assert_log(!in.bad(), "Cannot read %s", file_path.c_str());
+    auto n = in.gcount();
+    entry.crc = crc32(entry.crc, chunk.data(), n);
+    size += n;
+    flush = in ? Z_NO_FLUSH : Z_FINISH;
+    stream.next_in = chunk.data();
+    stream.avail_in = n;
+    do {
+      entry.data.resize(stream.total_out + k_chunk);
+      stream.next_out = entry.data.data() + stream.total_out;
+      stream.avail_out = k_chunk;
+      deflate(&stream, flush);
+    } while (stream.avail_out == 0);
+  } while (flush != Z_FINISH);
+  entry.data.resize(stream.total_out);
+  deflateEnd(&stream);
+  always_assert_log(size <= std::numeric_limits<uint32_t>::max(),
+                    "Zip entry %s is too large", name.c_str());
+  entry.uncompressed_size = size;
+  if (size == 0 || entry.data.size() >= size) {
+    // Deflate didn't help, so store the file as is.
+    in.clear();
+    in.seekg(0);
+    entry.data.assign(std::istreambuf_iterator<char>(in),
+                      std::istreambuf_iterator<char>());
+    entry.method = kStored;
+  }
+  add(std::move(entry));
+}
+
+void ZipWriter::add_files(
+    const std::vector<std::pair<std::string, std::string>>& name_to_paths,
+    bool compress) {
+  std::vector<size_t> indices(name_to_paths.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    add_file(name_to_paths[i].first, name_to_paths[i].second, compress);
+  }, 1);
+}
+
+void ZipWriter::finish() {
+  std::lock_guard<std::mutex> lock(m_lock);
+  always_assert_log(!m_finished, "Zip %s already finished", m_path.c_str());
+  m_finished = true;
+  std::sort(m_entries.begin(), m_entries.end(),
+            [](const Entry& a, const Entry& b) { return a.name < b.name; });
+  always_assert_log(m_entries.size() <= std::numeric_limits<uint16_t>::max(),
+                    "Too many entries for %s", m_path.c_str());
+
+  FILE* fd = fopen(m_path.c_str(), "wb");
+  always_assert_log(fd != nullptr, "Cannot create %s", m_path.c_str());
+  std::vector<uint8_t> central_dir;
+  uint64_t offset = 0;
+  for (const auto& entry : m_entries) {
+    always_assert_log(offset <= std::numeric_limits<uint32_t>::max(),
+                      "Zip %s is too large", m_path.c_str());
+    std::vector<uint8_t> header;
+    put32(header, kLocalFileSignature);
+    put16(header, kVersion);
+    put16(header, 0); // flags
+    put16(header, entry.method);
+    put16(header, kDosTime);
+    put16(header, kDosDate);
+    put32(header, entry.crc);
+    put32(header, entry.data.size());
+    put32(header, entry.uncompressed_size);
+    put16(header, entry.name.size());
+    put16(header, 0); // extra field length
+    header.insert(header.end(), entry.name.begin(), entry.name.end());
+    write_all(fd, header, m_path);
+    write_all(fd, entry.data, m_path);
+
+    put32(central_dir, kCentralFileSignature);
+    put16(central_dir, kVersion); // version made by
+    put16(central_dir, kVersion); // version needed to extract
+    put16(central_dir, 0); // flags
+    put16(central_dir, entry.method);
+    put16(central_dir, kDosTime);
+    put16(central_dir, kDosDate);
+    put32(central_dir, entry.crc);
+    put32(central_dir, entry.data.size());
+    put32(central_dir, entry.uncompressed_size);
+    put16(central_dir, entry.name.size());
+    put16(central_dir, 0); // extra field length
+    put16(central_dir, 0); // comment length
+    put16(central_dir, 0); // disk number
+    put16(central_dir, 0); // internal attributes
+    put32(central_dir, 0); // external attributes
+    put32(central_dir, offset);
+    central_dir.insert(central_dir.end(), entry.name.begin(),
+                       entry.name.end());
+    offset += header.size() + entry.data.size();
+  }
+  always_assert_log(offset + central_dir.size() <=
+                        std::numeric_limits<uint32_t>::max(),
+                    "Zip %s is too large", m_path.c_str());
+  std::vector<uint8_t> end;
+  put32(end, kCentralDirEndSignature);
+  put16(end, 0); // disk number
+  put16(end, 0); // disk with the central directory
+  put16(end, m_entries.size());
+  put16(end, m_entries.size());
+  put32(end, central_dir.size());
+  put32(end, offset);
+  put16(end, 0); // comment length
+  write_all(fd, central_dir, m_path);
+  write_all(fd, end, m_path);
+  always_assert_log(fclose(fd) == 0, "Error writing %s", m_path.c_str());
+  m_entries.clear();
+}
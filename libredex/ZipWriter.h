@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Writes a zip file whose entries can be added from several threads at once.
+ * Each entry is deflated on the thread that adds it, so adding entries in
+ * parallel compresses them across cores; only the bookkeeping is serialized.
+ *
+ * The entries are held, compressed, until finish(), which writes them sorted
+ * by name, followed by the central directory. The output thus does not depend
+ * on the order in which the entries were added, and all timestamps are fixed,
+ * so that the same entries always make the same bytes. Zip64 is not
+ * supported: entries and the whole file must stay below 4GB.
+ */
+class ZipWriter {
+ public:
+  explicit ZipWriter(std::string path);
+  ~ZipWriter();
+
+  ZipWriter(const ZipWriter&) = delete;
+  ZipWriter& operator=(const ZipWriter&) = delete;
+
+  // Adds an entry with the given contents. Entries that deflate doesn't make
+  // smaller, or that are added with compress = false, are stored as is.
+  void add_entry(const std::string& name,
+                 const void* data,
+                 size_t size,
+                 bool compress = true);
+
+  // Adds an entry with the contents of a file, read a chunk at a time.
+  void add_file(const std::string& name,
+                const std::string& file_path,
+                bool compress = true);
+
+  // Same as add_file on each (name, file path) pair, in parallel.
+  void add_files(
+      const std::vector<std::pair<std::string, std::string>>& name_to_paths,
+      bool compress = true);
+
+  // Writes out the zip file. No entries can be added afterwards. Called by
+  // the destructor if it wasn't already.
+  void finish();
+
+  const std::string& path() const { return m_path; }
+
+ private:
+  struct Entry {
+    std::string name;
+    uint16_t method;
+    uint32_t crc;
+    uint32_t uncompressed_size;
+    std::vector<uint8_t> data;
+  };
+
+  void add(Entry entry);
+
+  std::string m_path;
+  std::mutex m_lock;
+  std::vector<Entry> m_entries;
+  bool m_finished{false};
+};
@@ -7,13 +7,17 @@
 
 #include "AccessMarking.h"
 
+#include <atomic>
 #include <unordered_map>
 
+#include "AnalysisManager.h"
 #include "ClassHierarchy.h"
 #include "DexUtil.h"
 #include "FieldOpTracker.h"
 #include "IRCode.h"
+#include "MethodOverrideGraph.h"
 #include "Mutators.h"
+#include "PassManager.h"
 #include "ReachableClasses.h"
 #include "Resolver.h"
 #include "VirtualScope.h"
@@ -21,51 +25,34 @@
 
 namespace {
 size_t mark_classes_final(const Scope& scope, const ClassHierarchy& ch) {
-  size_t n_classes_finalized = 0;
-  for (auto const& cls : scope) {
-    if (has_keep(cls) || is_abstract(cls) || is_final(cls)) continue;
+  std::atomic<size_t> n_classes_finalized{0};
+  walk::parallel::classes(scope, [&](DexClass* cls) {
+    if (has_keep(cls) || is_abstract(cls) || is_final(cls)) return;
     auto const& children = get_children(ch, cls->get_type());
     if (children.empty()) {
       TRACE(ACCESS, 2, "Finalizing class: %s\n", SHOW(cls));
       set_final(cls);
       ++n_classes_finalized;
     }
-  }
+  });
   return n_classes_finalized;
 }
 
-const DexMethod* find_override(const DexMethod* method,
-                               const DexClass* cls,
-                               const ClassHierarchy& ch) {
-  TypeSet children;
-  get_all_children(ch, cls->get_type(), children);
-  for (auto const& childtype : children) {
-    auto const& child = type_class(childtype);
-    assert(child);
-    for (auto const& child_method : child->get_vmethods()) {
-      if (signatures_match(method, child_method)) {
-        return child_method;
-      }
-    }
-  }
-  return nullptr;
-}
-
-size_t mark_methods_final(const Scope& scope, const ClassHierarchy& ch) {
-  size_t n_methods_finalized = 0;
-  for (auto const& cls : scope) {
-    for (auto const& method : cls->get_vmethods()) {
-      if (has_keep(method) || is_abstract(method) || is_final(method)) {
-        continue;
-      }
-      if (!find_override(method, cls, ch)) {
+size_t mark_methods_final(const Scope& scope,
+                          const method_override_graph::Graph& graph) {
+  return walk::parallel::reduce_methods<size_t>(
+      scope,
+      [&](DexMethod* method) -> size_t {
+        if (!method->is_virtual() || has_keep(method) ||
+            is_abstract(method) || is_final(method) ||
+            !graph.get_node(method).children.empty()) {
+          return 0;
+        }
         TRACE(ACCESS, 2, "Finalizing method: %s\n", SHOW(method));
         set_final(method);
-        ++n_methods_finalized;
-      }
-    }
-  }
-  return n_methods_finalized;
+        return 1;
+      },
+      [](size_t a, size_t b) { return a + b; });
 }
 
 size_t mark_fields_final(const Scope& scope) {
@@ -104,17 +91,38 @@ std::unordered_set<DexMethod*> find_private_methods(
       candidates.emplace(m);
     }
   }
-  walk::opcodes(
+  // The candidates that are called from outside their class.
+  using CalleeSet = std::unordered_set<DexMethod*>;
+  auto external_callees = walk::parallel::reduce_methods<CalleeSet>(
       scope,
-      [](DexMethod*) { return true; },
-      [&](DexMethod* caller, IRInstruction* inst) {
-        if (!inst->has_method()) return;
-        auto callee = resolve_method(inst->get_method(), MethodSearch::Any);
-        if (callee == nullptr || callee->get_class() == caller->get_class()) {
-          return;
+      [&](DexMethod* caller) {
+        CalleeSet callees;
+        auto code = caller->get_code();
+        if (code == nullptr) {
+          return callees;
+        }
+        for (const MethodItemEntry& mie : InstructionIterable(code)) {
+          auto inst = mie.insn;
+          if (!inst->has_method()) continue;
+          auto callee = resolve_method(inst->get_method(), MethodSearch::Any);
+          // should be safe to read `candidates` here because there are no
+          // writers
+          if (callee == nullptr ||
+              callee->get_class() == caller->get_class() ||
+              !candidates.count(callee)) {
+            continue;
+          }
+          callees.emplace(callee);
         }
-        candidates.erase(callee);
+        return callees;
+      },
+      [](CalleeSet a, const CalleeSet& b) {
+        a.insert(b.begin(), b.end());
+        return a;
       });
+  for (auto callee : external_callees) {
+    candidates.erase(callee);
+  }
   return candidates;
 }
 
@@ -152,15 +160,17 @@ void AccessMarkingPass::run_pass(DexStoresVector& stores,
                                  ConfigFiles& cfg,
                                  PassManager& pm) {
   auto scope = build_class_scope(stores);
-  ClassHierarchy ch = build_type_hierarchy(scope);
-  SignatureMap sm = build_signature_map(ch);
+  auto& analyses = pm.analyses();
+  const auto& ch = analyses.class_hierarchy(scope);
+  const auto& sm = analyses.signature_map(scope);
+  const auto& override_graph = analyses.method_override_graph(scope);
   if (m_finalize_classes) {
     auto n_classes_final = mark_classes_final(scope, ch);
     pm.incr_metric("finalized_classes", n_classes_final);
     TRACE(ACCESS, 1, "Finalized %lu classes\n", n_classes_final);
   }
   if (m_finalize_methods) {
-    auto n_methods_final = mark_methods_final(scope, ch);
+    auto n_methods_final = mark_methods_final(scope, override_graph);
     pm.incr_metric("finalized_methods", n_methods_final);
     TRACE(ACCESS, 1, "Finalized %lu methods\n", n_methods_final);
   }
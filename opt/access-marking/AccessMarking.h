@@ -22,6 +22,11 @@ class AccessMarkingPass : public Pass {
 
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
+  analysis::Set required_analyses() const override {
+    return analysis::CLASS_HIERARCHY | analysis::SIGNATURE_MAP |
+           analysis::METHOD_OVERRIDE_GRAPH;
+  }
+
  private:
   bool m_finalize_classes;
   bool m_finalize_methods;
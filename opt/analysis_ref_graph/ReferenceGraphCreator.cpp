@@ -7,219 +7,233 @@
 
 #include "ReferenceGraphCreator.h"
 
+#include <fstream>
 #include <map>
+#include <numeric>
 #include <string>
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
 
+#include "ConfigFiles.h"
 #include "Walkers.h"
 #include "DexClass.h"
 #include "IRInstruction.h"
 #include "DexUtil.h"
+#include "Parallel.h"
 #include "Resolver.h"
 
+namespace {
+
+constexpr uint32_t EXTERNAL_STORE = 0xffffffff;
+constexpr uint32_t BINARY_GRAPH_VERSION = 1;
+
+void write_u32(std::ostream& out, uint32_t value) {
+  char bytes[4] = {static_cast<char>(value & 0xff),
+                   static_cast<char>((value >> 8) & 0xff),
+                   static_cast<char>((value >> 16) & 0xff),
+                   static_cast<char>((value >> 24) & 0xff)};
+  out.write(bytes, sizeof(bytes));
+}
+
+void write_string(std::ostream& out, const std::string& str) {
+  write_u32(out, str.size());
+  out.write(str.data(), str.size());
+}
+
+} // namespace
+
 void CreateReferenceGraphPass::build_super_and_interface_refs(
-    const Scope& scope,
-    refs_t& class_refs) {
-  for (const auto* child : scope) {
-    std::function<void(const DexType*)> recurse =
-      [&class_refs, &child, &recurse] (const DexType* super) {
-        if (super != nullptr) {
-          class_refs[child].emplace(super);
-          const auto super_cls_or_int = type_class(super);
-          if (super_cls_or_int != nullptr) {
-            recurse(super_cls_or_int->get_super_class());
-            for (const auto* interface : super_cls_or_int->get_interfaces()->get_type_list()) {
-              recurse(interface);
-            }
+    const DexClass* cls,
+    class_refs_t& class_refs) {
+  std::function<void(const DexType*)> recurse =
+    [&class_refs, &recurse] (const DexType* super) {
+      if (super != nullptr) {
+        class_refs.emplace(super);
+        const auto super_cls_or_int = type_class(super);
+        if (super_cls_or_int != nullptr) {
+          recurse(super_cls_or_int->get_super_class());
+          for (const auto* interface : super_cls_or_int->get_interfaces()->get_type_list()) {
+            recurse(interface);
           }
         }
-    };
-    recurse(child->get_type());
-  }
+      }
+  };
+  recurse(cls->get_type());
 }
 
 template <class T>
 void CreateReferenceGraphPass::get_annots(
     const T* thing_with_annots,
-    const DexClass* enclosing_class,
-    refs_t& class_refs) {
+    class_refs_t& class_refs) {
   const auto& thing_anno_set = thing_with_annots->get_anno_set();
   if (thing_anno_set != nullptr) {
     for (const auto* annot : thing_anno_set->get_annotations()) {
-      class_refs[enclosing_class].emplace(annot->type());
+      class_refs.emplace(annot->type());
     }
   }
 }
 
-CreateReferenceGraphPass::MethodWalkerFn
-CreateReferenceGraphPass::method_ref_builder(
-    const Scope& scope,
-    refs_t& class_refs) {
-  return ([this, &class_refs](const DexMethod* method) {
-    const auto* enclosing_class = type_class(method->get_class());
-    // do not add annotations to a method call. Only to method definition
-    get_annots(method, enclosing_class, class_refs);
+void CreateReferenceGraphPass::build_method_refs(
+    const DexMethod* method,
+    class_refs_t& class_refs) {
+  // do not add annotations to a method call. Only to method definition
+  get_annots(method, class_refs);
 
-    std::vector<DexType*> types;
-    method->get_proto()->gather_types(types);
-    for (const auto* t : types) {
-      if (t) class_refs[enclosing_class].emplace(t);
-    }
-  });
+  std::vector<DexType*> types;
+  method->get_proto()->gather_types(types);
+  for (const auto* t : types) {
+    if (t) class_refs.emplace(t);
+  }
 }
 
-CreateReferenceGraphPass::FieldWalkerFn
-CreateReferenceGraphPass::field_ref_builder(
-    const Scope& scope,
-    refs_t& class_refs) {
-  return ([this, &class_refs](DexField* field) {
-    const auto* enclosing_class = type_class(field->get_class());
-
-    const DexField* field_maybe_resolved;
-    if (config.resolve_fields) {
-      field_maybe_resolved = resolve_field(field);
-    } else {
-      field_maybe_resolved = field;
-    }
-    get_annots(field_maybe_resolved, enclosing_class, class_refs);
-    const auto* t = field_maybe_resolved->get_type();
-    if (t) class_refs[enclosing_class].emplace(t);
-  });
+void CreateReferenceGraphPass::build_field_refs(
+    DexField* field,
+    class_refs_t& class_refs) {
+  const DexField* field_maybe_resolved;
+  if (config.resolve_fields) {
+    field_maybe_resolved = resolve_field(field);
+  } else {
+    field_maybe_resolved = field;
+  }
+  get_annots(field_maybe_resolved, class_refs);
+  const auto* t = field_maybe_resolved->get_type();
+  if (t) class_refs.emplace(t);
 }
 
-void CreateReferenceGraphPass::build_class_annot_refs(
-    const Scope& scope,
-    refs_t& class_refs) {
-  for (const auto* cls : scope) {
-    get_annots(cls, cls, class_refs);
+void CreateReferenceGraphPass::build_exception_refs(
+    const DexMethod* method,
+    class_refs_t& class_refs) {
+  std::vector<DexType*> catch_types;
+  method->get_code()->gather_catch_types(catch_types);
+  for (auto type : catch_types) {
+    class_refs.emplace(type);
   }
 }
 
-CreateReferenceGraphPass::MethodWalkerFn
-CreateReferenceGraphPass::method_annot_ref_builder(
-    const Scope& scope,
-    refs_t& class_refs) {
-  return ([this, &scope, &class_refs](const DexMethod* meth) {
-   for (const auto* cls : scope) {
-     get_annots(meth, cls, class_refs);
+void CreateReferenceGraphPass::build_instruction_refs(
+    IRInstruction* insn,
+    class_refs_t& class_refs) {
+  if (insn->has_type()) {
+    const auto* tref = insn->get_type();
+    if (tref) class_refs.emplace(tref);
+    return;
+  }
+  if (insn->has_field()) {
+    auto* field = insn->get_field();
+    if (config.resolve_fields) {
+      field = resolve_field(field);
     }
-  });
-}
-
-CreateReferenceGraphPass::FieldWalkerFn
-CreateReferenceGraphPass::field_annot_ref_builder(
-    const Scope& scope,
-    refs_t& class_refs) {
-  return ([this, &scope, &class_refs](const DexField* field) {
-    for (const auto* cls : scope) {
-     get_annots(field, cls, class_refs);
+    const auto* field_owner = field->get_class();
+    const auto* field_type = field->get_type();
+    if (field_owner) class_refs.emplace(field_owner);
+    if (field_type) class_refs.emplace(field_type);
+    return;
+  }
+  if (insn->has_method()) {
+    auto* method = insn->get_method();
+    if (config.resolve_methods) {
+      method = resolve_method(method, MethodSearch::Any);
     }
-  });
-}
 
-CreateReferenceGraphPass::MethodWalkerFn
-CreateReferenceGraphPass::exception_ref_builder(
-    const Scope& scope,
-    refs_t& class_refs) {
-  return ([&class_refs](const DexMethod* meth) {
-    const auto* enclosing_class = type_class(meth->get_class());
-
-    std::vector<DexType*> catch_types;
-    meth->get_code()->gather_catch_types(catch_types);
-    for (auto type : catch_types) {
-      class_refs[enclosing_class].emplace(type);
+    // argument and return types
+    std::vector<DexType*> types;
+    method->get_proto()->gather_types(types);
+    for (const auto* t : types) {
+      if (t) class_refs.emplace(t);
     }
-  });
+  }
 }
 
-CreateReferenceGraphPass::InstructionWalkerFn
-CreateReferenceGraphPass::instruction_ref_builder(
-    const Scope& scope,
-    refs_t& class_refs) {
-  return ([this, &class_refs](const DexMethod* meth, IRInstruction* insn) {
-    const auto* enclosing_class = type_class(meth->get_class());
-
-    if (insn->has_type()) {
-      const auto* tref = insn->get_type();
-      if (tref) class_refs[enclosing_class].emplace(tref);
-      return;
-    }
-    if (insn->has_field()) {
-      auto* field = insn->get_field();
-      if (CreateReferenceGraphPass::config.resolve_fields) {
-        field = resolve_field(field);
-      }
-      const auto* field_owner = field->get_class();
-      const auto* field_type = field->get_type();
-      if (field_owner) class_refs[enclosing_class].emplace(field_owner);
-      if (field_type) class_refs[enclosing_class].emplace(field_type);
-      return;
-    }
-    if (insn->has_method()) {
-      auto* method = insn->get_method();
-      if (CreateReferenceGraphPass::config.resolve_methods) {
-        method = resolve_method(method, MethodSearch::Any);
-      }
-
-      // argument and return types
-      std::vector<DexType*> types;
-      method->get_proto()->gather_types(types);
-      for (const auto* t : types) {
-        if (t) class_refs[enclosing_class].emplace(t);
-      }
-
-      return;
-    }
+CreateReferenceGraphPass::class_refs_t
+CreateReferenceGraphPass::gather_member_annot_refs(const Scope& scope) {
+  class_refs_t member_annot_refs;
+  walk::methods(scope, [&](const DexMethod* method) {
+    get_annots(method, member_annot_refs);
+  });
+  walk::fields(scope, [&](const DexField* field) {
+    get_annots(field, member_annot_refs);
   });
+  return member_annot_refs;
 }
 
-void CreateReferenceGraphPass::gather_all(const Scope& scope, refs_t& class_refs) {
-  for (const auto* cls : scope) {
+void CreateReferenceGraphPass::build_class_refs(
+    const DexClass* cls,
+    const class_refs_t& member_annot_refs,
+    class_refs_t& class_refs) {
+  if (config.gather_all) {
     std::vector<DexType*> types;
     cls->gather_types(types);
     for (const auto* t : types) {
-      if (t) class_refs[cls].emplace(t);
+      if (t) class_refs.emplace(t);
     }
+    return;
   }
-}
 
-void CreateReferenceGraphPass::build_refs(const Scope& scope, refs_t& class_refs) {
-  if (CreateReferenceGraphPass::config.gather_all) {
-    gather_all(scope, class_refs);
-  } else {
-    if (CreateReferenceGraphPass::config.refs_in_annotations) {
-      build_class_annot_refs(scope, class_refs);
-      walk::methods(scope, method_annot_ref_builder(scope, class_refs));
-      walk::fields(scope, field_annot_ref_builder(scope, class_refs));
+  std::vector<DexMethod*> methods(cls->get_dmethods().begin(),
+                                  cls->get_dmethods().end());
+  methods.insert(methods.end(), cls->get_vmethods().begin(),
+                 cls->get_vmethods().end());
+  std::vector<DexField*> fields(cls->get_ifields().begin(),
+                                cls->get_ifields().end());
+  fields.insert(fields.end(), cls->get_sfields().begin(),
+                cls->get_sfields().end());
+
+  if (config.refs_in_annotations) {
+    get_annots(cls, class_refs);
+    class_refs.insert(member_annot_refs.begin(), member_annot_refs.end());
+  }
+  if (config.refs_in_class_structure) {
+    build_super_and_interface_refs(cls, class_refs);
+    for (const auto* method : methods) {
+      build_method_refs(method, class_refs);
     }
-    if (CreateReferenceGraphPass::config.refs_in_class_structure) {
-      build_super_and_interface_refs(scope, class_refs);
-      walk::methods(scope, method_ref_builder(scope, class_refs));
-      walk::fields(scope, field_ref_builder(scope, class_refs));
+    for (auto* field : fields) {
+      build_field_refs(field, class_refs);
     }
-    if (CreateReferenceGraphPass::config.refs_in_code) {
-      walk::methods(scope, exception_ref_builder(scope, class_refs));
-      walk::opcodes(
-        scope,
-        [](const DexMethod*) { return true; },
-        instruction_ref_builder(scope, class_refs)
-      );
+  }
+  if (config.refs_in_code) {
+    for (const auto* method : methods) {
+      if (method->get_code() == nullptr) {
+        continue;
+      }
+      build_exception_refs(method, class_refs);
+      for (const auto& mie : InstructionIterable(method->get_code())) {
+        build_instruction_refs(mie.insn, class_refs);
+      }
     }
   }
 }
 
+CreateReferenceGraphPass::refs_t CreateReferenceGraphPass::build_refs(
+    const Scope& scope) {
+  class_refs_t member_annot_refs;
+  if (!config.gather_all && config.refs_in_annotations) {
+    member_annot_refs = gather_member_annot_refs(scope);
+  }
+
+  // Each class only ever writes into its own set, so the sets can be built
+  // in parallel.
+  refs_t refs(scope.size());
+  std::vector<size_t> class_ids(scope.size());
+  std::iota(class_ids.begin(), class_ids.end(), 0);
+  parallel_for(class_ids.begin(), class_ids.end(), [&](size_t id) {
+    build_class_refs(scope[id], member_annot_refs, refs[id]);
+  });
+  return refs;
+}
+
 void CreateReferenceGraphPass::createAndOutputRefGraph(
     DexStore& store,
-    type_to_store_map_t type_to_store) {
-  refs_t class_refs;
+    const type_to_store_map_t& type_to_store,
+    Scope* classes,
+    refs_t* refs) {
   auto scope = build_class_scope(store.get_dexen());
-  build_refs(scope, class_refs);
+  auto store_refs = build_refs(scope);
 
-  for (auto& ref : class_refs) {
-    const auto source = ref.first;
-    for (const auto& target : ref.second) {
+  for (size_t id = 0; id < scope.size(); ++id) {
+    const auto source = scope[id];
+    for (const auto& target : store_refs[id]) {
       std::string target_store_name;
       auto find = type_to_store.find(target);
       if (find != type_to_store.end()) {
@@ -237,11 +251,75 @@ void CreateReferenceGraphPass::createAndOutputRefGraph(
         target->get_name()->c_str());
     }
   }
+
+  classes->insert(classes->end(), scope.begin(), scope.end());
+  refs->insert(refs->end(),
+               std::make_move_iterator(store_refs.begin()),
+               std::make_move_iterator(store_refs.end()));
+}
+
+void CreateReferenceGraphPass::write_binary_graph(
+    const std::string& filename,
+    const DexStoresVector& stores,
+    const type_to_store_map_t& type_to_store,
+    const Scope& classes,
+    const refs_t& refs) {
+  std::unordered_map<const DexStore*, uint32_t> store_ids;
+  for (const auto& store : stores) {
+    store_ids.emplace(&store, store_ids.size());
+  }
+
+  // Classes come first so that their node id is their dense class id, then
+  // external types in the order they are first referenced.
+  std::unordered_map<const DexType*, uint32_t> node_ids;
+  std::vector<const DexType*> nodes;
+  for (const auto* cls : classes) {
+    node_ids.emplace(cls->get_type(), nodes.size());
+    nodes.push_back(cls->get_type());
+  }
+  std::vector<uint32_t> offsets{0};
+  std::vector<uint32_t> targets;
+  for (const auto& class_refs : refs) {
+    for (const auto* target : class_refs) {
+      auto it = node_ids.find(target);
+      if (it == node_ids.end()) {
+        it = node_ids.emplace(target, nodes.size()).first;
+        nodes.push_back(target);
+      }
+      targets.push_back(it->second);
+    }
+    offsets.push_back(targets.size());
+  }
+
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  always_assert_log(out.is_open(), "Can not open %s", filename.c_str());
+  out.write("RGRF", 4);
+  write_u32(out, BINARY_GRAPH_VERSION);
+  write_u32(out, stores.size());
+  for (const auto& store : stores) {
+    write_string(out, store.get_name());
+  }
+  write_u32(out, nodes.size());
+  write_u32(out, classes.size());
+  for (size_t id = 0; id < nodes.size(); ++id) {
+    uint32_t store_id = EXTERNAL_STORE;
+    if (id < classes.size()) {
+      store_id = store_ids.at(type_to_store.at(nodes[id]));
+    }
+    write_u32(out, store_id);
+    write_string(out, nodes[id]->get_name()->str());
+  }
+  for (auto offset : offsets) {
+    write_u32(out, offset);
+  }
+  for (auto target : targets) {
+    write_u32(out, target);
+  }
 }
 
 void CreateReferenceGraphPass::run_pass(
     DexStoresVector& stores,
-    ConfigFiles& cfg, /* unused */
+    ConfigFiles& cfg,
     PassManager& mgr /* unused */) {
 
   type_to_store_map_t type_to_store;
@@ -252,8 +330,15 @@ void CreateReferenceGraphPass::run_pass(
     }
   }
 
+  Scope classes;
+  refs_t refs;
   for (auto& store : stores) {
-    createAndOutputRefGraph(store, type_to_store);
+    createAndOutputRefGraph(store, type_to_store, &classes, &refs);
+  }
+
+  if (!config.ref_output_filename.empty()) {
+    write_binary_graph(cfg.metafile(config.ref_output_filename), stores,
+                       type_to_store, classes, refs);
   }
 }
 
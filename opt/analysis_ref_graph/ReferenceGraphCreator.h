@@ -12,6 +12,7 @@
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 class CreateReferenceGraphPass : public Pass {
  public:
@@ -26,6 +27,8 @@ class CreateReferenceGraphPass : public Pass {
 
     jw.get("resolve_fields", false, config.resolve_fields);
     jw.get("resolve_methods", false, config.resolve_methods);
+
+    jw.get("ref_output_filename", "", config.ref_output_filename);
   }
 
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
@@ -45,61 +48,64 @@ class CreateReferenceGraphPass : public Pass {
   };
   Config config;
 
-  // refs_t is the "graph" type. It is a map from every class in the scope
-  // to the types each refer to
+  // class_refs_t holds the types referenced by a single class.
+  //
+  // refs_t is the "graph" type. Classes are identified by their dense index in
+  // the scope the graph was built from, and refs_t maps each of them to the
+  // types it refers to.
   //
   // Use the config file to decide which types of references to collect
-  using refs_t = std::unordered_map<const DexClass*, std::set<const DexType*, dextypes_comparator>>;
+  using class_refs_t = std::set<const DexType*, dextypes_comparator>;
+  using refs_t = std::vector<class_refs_t>;
   using type_to_store_map_t = std::unordered_map<const DexType*, DexStore*>;
 
-  using MethodWalkerFn = std::function<void(DexMethod*)>;
-  using FieldWalkerFn = std::function<void(DexField*)>;
-  using AnnotationWalkerFn = std::function<void(DexAnnotation*)>;
-  using InstructionWalkerFn = std::function<void(DexMethod*, IRInstruction*)>;
-
-  void build_super_and_interface_refs(
-      const Scope& scope,
-      refs_t& class_refs);
+  void build_super_and_interface_refs(const DexClass* cls,
+                                      class_refs_t& class_refs);
 
   template <class T>
-  void get_annots(
-      const T* thing_with_annots,
-      const DexClass* enclosing_class,
-      refs_t& class_refs);
-
-  MethodWalkerFn method_ref_builder(
-      const Scope& scope,
-      refs_t& class_refs);
-
-  FieldWalkerFn field_ref_builder(
-      const Scope& scope,
-      refs_t& class_refs);
-
-  void build_class_annot_refs(
-      const Scope& scope,
-      refs_t& class_refs);
-
-  MethodWalkerFn method_annot_ref_builder(
-      const Scope& scope,
-      refs_t& class_refs);
-
-  FieldWalkerFn field_annot_ref_builder(
-      const Scope& scope,
-      refs_t& class_refs);
-
-  MethodWalkerFn exception_ref_builder(
-      const Scope& scope,
-      refs_t& class_refs);
-
-  InstructionWalkerFn instruction_ref_builder(
-      const Scope& scope,
-      refs_t& class_refs);
-
-  void gather_all(const Scope& scope, refs_t& class_refs);
-
-  void build_refs(const Scope& scope, refs_t& class_refs);
-
-  void createAndOutputRefGraph(
-      DexStore& store,
-      type_to_store_map_t type_to_store);
+  void get_annots(const T* thing_with_annots, class_refs_t& class_refs);
+
+  void build_method_refs(const DexMethod* method, class_refs_t& class_refs);
+
+  void build_field_refs(DexField* field, class_refs_t& class_refs);
+
+  void build_exception_refs(const DexMethod* method, class_refs_t& class_refs);
+
+  void build_instruction_refs(IRInstruction* insn, class_refs_t& class_refs);
+
+  // The annotations of every method and field in the scope are attributed to
+  // every class in the scope, so we only gather them once.
+  class_refs_t gather_member_annot_refs(const Scope& scope);
+
+  void build_class_refs(const DexClass* cls,
+                        const class_refs_t& member_annot_refs,
+                        class_refs_t& class_refs);
+
+  refs_t build_refs(const Scope& scope);
+
+  void createAndOutputRefGraph(DexStore& store,
+                               const type_to_store_map_t& type_to_store,
+                               Scope* classes,
+                               refs_t* refs);
+
+  /*
+   * Writes the graph of all stores to `filename` in a compact binary format.
+   * All integers are unsigned 32-bit little-endian, and strings are a length
+   * followed by that many bytes of modified UTF-8.
+   *
+   *   "RGRF" version
+   *   num_stores (store name)*
+   *   num_nodes num_classes (store_index type_name)*
+   *   offsets[num_classes + 1] targets[offsets[num_classes]]
+   *
+   * Nodes [0, num_classes) are the classes of all stores in store order; the
+   * remaining nodes are the referenced types which are not defined in any
+   * store, and have a store index of 0xffffffff. The edges of class i are
+   * targets[offsets[i]] to targets[offsets[i + 1] - 1].
+   */
+  void write_binary_graph(const std::string& filename,
+                          const DexStoresVector& stores,
+                          const type_to_store_map_t& type_to_store,
+                          const Scope& classes,
+                          const refs_t& refs);
 };
@@ -15,6 +15,7 @@
 #include "DexUtil.h"
 #include "Resolver.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 constexpr const char* METRIC_ANNO_KILLED = "num_anno_killed";
 constexpr const char* METRIC_ANNO_TOTAL = "num_anno_total";
@@ -38,7 +39,10 @@ AnnoKill::AnnoKill(Scope& scope,
                    const std::unordered_map<std::string, std::vector<std::string>>& class_hierarchy_keep_annos,
                    const std::unordered_map<std::string, std::vector<std::string>>& annotated_keep_annos
                    )
-  : m_scope(scope), m_only_force_kill(only_force_kill), m_kill_bad_signatures(kill_bad_signatures) {
+  : m_scope(scope),
+    m_scope_classes(scope.begin(), scope.end()),
+    m_only_force_kill(only_force_kill),
+    m_kill_bad_signatures(kill_bad_signatures) {
   // Load annotations that should not be deleted.
   TRACE(ANNO, 2, "Keep annotations count %d\n", keep.size());
   for (const auto& anno_name : keep) {
@@ -176,129 +180,132 @@ AnnoKill::AnnoSet AnnoKill::get_referenced_annos() {
   });
 
   // mark an annotation as "unremovable" if a method signature contains a type
-  // with that annotation
-  walk::methods(m_scope, [&](DexMethod* meth) {
-    // don't look at methods defined on the annotation itself
-    const auto meth_cls_type = meth->get_class();
-    if (all_annos.count(meth_cls_type) > 0) {
-      return;
-    }
-
-    const auto meth_cls = type_class(meth_cls_type);
-    if (meth_cls != nullptr && is_annotation(meth_cls)) {
-      return;
-    }
-
-    const auto& has_anno = [&](DexType* type) {
-      if (all_annos.count(type) > 0) {
-        TRACE(ANNO,
-              3,
-              "Method contains annotation type in signature %s.%s:%s\n",
-              SHOW(meth->get_class()),
-              SHOW(meth->get_name()),
-              SHOW(meth->get_proto()));
-        referenced_annos.insert(type);
-      }
-    };
-
-    const auto proto = meth->get_proto();
-    has_anno(proto->get_rtype());
-    for (const auto& arg : proto->get_args()->get_type_list()) {
-      has_anno(arg);
-    }
-  });
-
-  // mark an annotation as "unremovable" if any opcode references the annotation
-  // type
-  walk::opcodes(
+  // with that annotation, or if any opcode references the annotation type.
+  // Methods are scanned in parallel, each into its own set.
+  auto method_referenced_annos = walk::parallel::reduce_methods<AnnoSet>(
       m_scope,
-      [](DexMethod*) { return true; },
-      [&](DexMethod* meth, IRInstruction* insn) {
+      [&](DexMethod* meth) {
+        AnnoSet method_annos;
         // don't look at methods defined on the annotation itself
         const auto meth_cls_type = meth->get_class();
         if (all_annos.count(meth_cls_type) > 0) {
-          return;
+          return method_annos;
         }
         const auto meth_cls = type_class(meth_cls_type);
         if (meth_cls != nullptr && is_annotation(meth_cls)) {
-          return;
+          return method_annos;
         }
 
-        if (insn->has_type()) {
-          auto type = insn->get_type();
-          if (all_annos.count(type) > 0) {
-            referenced_annos.insert(type);
-            TRACE(ANNO,
-                  3,
-                  "Annotation referenced in type opcode\n\t%s.%s:%s - %s\n",
-                  SHOW(meth->get_class()),
-                  SHOW(meth->get_name()),
-                  SHOW(meth->get_proto()),
-                  SHOW(insn));
-          }
-        } else if (insn->has_field()) {
-          auto field = insn->get_field();
-          auto fdef = resolve_field(field,
-                                    is_sfield_op(insn->opcode())
-                                        ? FieldSearch::Static
-                                        : FieldSearch::Instance);
-          if (fdef != nullptr) field = fdef;
-
-          bool referenced = false;
-          auto owner = field->get_class();
-          if (all_annos.count(owner) > 0) {
-            referenced = true;
-            referenced_annos.insert(owner);
-          }
-          auto type = field->get_type();
+        const auto& has_anno = [&](DexType* type) {
           if (all_annos.count(type) > 0) {
-            referenced = true;
-            referenced_annos.insert(type);
-          }
-          if (referenced) {
             TRACE(ANNO,
                   3,
-                  "Annotation referenced in field opcode\n\t%s.%s:%s - %s\n",
+                  "Method contains annotation type in signature %s.%s:%s\n",
                   SHOW(meth->get_class()),
                   SHOW(meth->get_name()),
-                  SHOW(meth->get_proto()),
-                  SHOW(insn));
+                  SHOW(meth->get_proto()));
+            method_annos.insert(type);
           }
-        } else if (insn->has_method()) {
-          auto method = insn->get_method();
-          DexMethod* methdef = resolve_method(method, opcode_to_search(insn));
-          if (methdef != nullptr) method = methdef;
-
-          bool referenced = false;
-          auto owner = method->get_class();
-          if (all_annos.count(owner) > 0) {
-            referenced = true;
-            referenced_annos.insert(owner);
-          }
-          auto proto = method->get_proto();
-          auto rtype = proto->get_rtype();
-          if (all_annos.count(rtype) > 0) {
-            referenced = true;
-            referenced_annos.insert(rtype);
-          }
-          auto arg_list = proto->get_args();
-          for (const auto& arg : arg_list->get_type_list()) {
-            if (all_annos.count(arg) > 0) {
+        };
+
+        const auto proto = meth->get_proto();
+        has_anno(proto->get_rtype());
+        for (const auto& arg : proto->get_args()->get_type_list()) {
+          has_anno(arg);
+        }
+
+        auto code = meth->get_code();
+        if (code == nullptr) {
+          return method_annos;
+        }
+        for (const auto& mie : InstructionIterable(code)) {
+          auto insn = mie.insn;
+          if (insn->has_type()) {
+            auto type = insn->get_type();
+            if (all_annos.count(type) > 0) {
+              method_annos.insert(type);
+              TRACE(ANNO,
+                    3,
+                    "Annotation referenced in type opcode\n\t%s.%s:%s - %s\n",
+                    SHOW(meth->get_class()),
+                    SHOW(meth->get_name()),
+                    SHOW(meth->get_proto()),
+                    SHOW(insn));
+            }
+          } else if (insn->has_field()) {
+            auto field = insn->get_field();
+            auto fdef = resolve_field(field,
+                                      is_sfield_op(insn->opcode())
+                                          ? FieldSearch::Static
+                                          : FieldSearch::Instance);
+            if (fdef != nullptr) field = fdef;
+
+            bool referenced = false;
+            auto owner = field->get_class();
+            if (all_annos.count(owner) > 0) {
               referenced = true;
-              referenced_annos.insert(arg);
+              method_annos.insert(owner);
+            }
+            auto type = field->get_type();
+            if (all_annos.count(type) > 0) {
+              referenced = true;
+              method_annos.insert(type);
+            }
+            if (referenced) {
+              TRACE(ANNO,
+                    3,
+                    "Annotation referenced in field opcode\n\t%s.%s:%s - %s\n",
+                    SHOW(meth->get_class()),
+                    SHOW(meth->get_name()),
+                    SHOW(meth->get_proto()),
+                    SHOW(insn));
+            }
+          } else if (insn->has_method()) {
+            auto method = insn->get_method();
+            DexMethod* methdef = resolve_method(method, opcode_to_search(insn));
+            if (methdef != nullptr) method = methdef;
+
+            bool referenced = false;
+            auto owner = method->get_class();
+            if (all_annos.count(owner) > 0) {
+              referenced = true;
+              method_annos.insert(owner);
+            }
+            auto proto = method->get_proto();
+            auto rtype = proto->get_rtype();
+            if (all_annos.count(rtype) > 0) {
+              referenced = true;
+              method_annos.insert(rtype);
+            }
+            auto arg_list = proto->get_args();
+            for (const auto& arg : arg_list->get_type_list()) {
+              if (all_annos.count(arg) > 0) {
+                referenced = true;
+                method_annos.insert(arg);
+              }
+            }
+            if (referenced) {
+              TRACE(ANNO,
+                    3,
+                    "Annotation referenced in method opcode\n\t%s.%s:%s - %s\n",
+                    SHOW(meth->get_class()),
+                    SHOW(meth->get_name()),
+                    SHOW(meth->get_proto()),
+                    SHOW(insn));
             }
           }
-          if (referenced) {
-            TRACE(ANNO,
-                  3,
-                  "Annotation referenced in method opcode\n\t%s.%s:%s - %s\n",
-                  SHOW(meth->get_class()),
-                  SHOW(meth->get_name()),
-                  SHOW(meth->get_proto()),
-                  SHOW(insn));
-          }
         }
+        return method_annos;
+      },
+      [](AnnoSet left, AnnoSet right) {
+        if (left.size() < right.size()) {
+          std::swap(left, right);
+        }
+        left.insert(right.begin(), right.end());
+        return left;
       });
+  referenced_annos.insert(method_referenced_annos.begin(),
+                          method_referenced_annos.end());
   return referenced_annos;
 }
 
@@ -329,28 +336,32 @@ AnnoKill::AnnoSet AnnoKill::get_removable_annotation_instances() {
   return bannotations;
 }
 
-void AnnoKill::count_annotation(const DexAnnotation* da) {
+void AnnoKill::count_annotation(const DexAnnotation* da,
+                                CleanupCounts* counts) {
   std::string annoName(da->type()->get_name()->c_str());
   if (da->system_visible()) {
-    m_system_anno_map[annoName]++;
-    m_stats.visibility_system_count++;
+    counts->system_anno_map[annoName]++;
+    counts->stats.visibility_system_count++;
   } else if (da->runtime_visible()) {
-    m_runtime_anno_map[annoName]++;
-    m_stats.visibility_runtime_count++;
+    counts->runtime_anno_map[annoName]++;
+    counts->stats.visibility_runtime_count++;
   } else if (da->build_visible()) {
-    m_build_anno_map[annoName]++;
-    m_stats.visibility_build_count++;
+    counts->build_anno_map[annoName]++;
+    counts->stats.visibility_build_count++;
   }
 }
 
-void AnnoKill::cleanup_aset(DexAnnotationSet* aset,
-                            const AnnoKill::AnnoSet& referenced_annos,
-                            const std::unordered_set<const DexType*>& keep_annos) {
-  m_stats.annotations += aset->size();
+void AnnoKill::cleanup_aset(
+    DexAnnotationSet* aset,
+    const AnnoKill::AnnoSet& referenced_annos,
+    const std::unordered_set<const DexType*>& keep_annos,
+    CleanupCounts* counts) {
+  auto& stats = counts->stats;
+  stats.annotations += aset->size();
   auto& annos = aset->get_annotations();
   auto fn = [&](DexAnnotation* da) {
     auto anno_type = da->type();
-    count_annotation(da);
+    count_annotation(da, counts);
 
     if (referenced_annos.count(anno_type) > 0) {
       TRACE(ANNO,
@@ -386,7 +397,7 @@ void AnnoKill::cleanup_aset(DexAnnotationSet* aset,
             "annotation: %s\n",
             SHOW(anno_type),
             SHOW(da));
-      m_stats.annotations_killed++;
+      stats.annotations_killed++;
       delete da;
       return true;
     }
@@ -398,21 +409,21 @@ void AnnoKill::cleanup_aset(DexAnnotationSet* aset,
             "annotation: %s\n",
             SHOW(anno_type),
             SHOW(da));
-      m_stats.annotations_killed++;
+      stats.annotations_killed++;
       delete da;
       return true;
     }
 
     if (!m_only_force_kill && !da->system_visible()) {
       TRACE(ANNO, 3, "Killing annotation instance %s\n", SHOW(da));
-      m_stats.annotations_killed++;
+      stats.annotations_killed++;
       delete da;
       return true;
     }
 
     if (anno_type == DexType::get_type("Ldalvik/annotation/Signature;")) {
       if (should_kill_bad_signature(da)) {
-        m_stats.signatures_killed++;
+        stats.signatures_killed++;
         delete da;
         return true;
       }
@@ -465,16 +476,8 @@ bool AnnoKill::should_kill_bad_signature(DexAnnotation* da) {
           if (!sigcls) {
             sigtype = nullptr;
           } else if (!sigcls->is_external()) {
-            bool found = false;
-            for (auto cls : m_scope) {
-              if (cls == sigcls) {
-                // Valid class, we're good, go to element in array
-                found = true;
-                continue;
-              }
-            }
             // Could not find the (non-external) class in Scope, so set signal to kill
-            if (!found) {
+            if (m_scope_classes.count(sigcls) == 0) {
               sigtype = nullptr;
             }
           }
@@ -492,46 +495,46 @@ bool AnnoKill::should_kill_bad_signature(DexAnnotation* da) {
 std::unordered_set<const DexType*> AnnoKill::build_anno_keep(DexAnnotationSet* aset) {
   std::unordered_set<const DexType*> keep_list;
   for (const auto& anno : aset->get_annotations()) {
-    auto& keeps = m_annotated_keep_annos[anno->type()];
-    keep_list.insert(keeps.begin(), keeps.end());
+    auto it = m_annotated_keep_annos.find(anno->type());
+    if (it != m_annotated_keep_annos.end()) {
+      keep_list.insert(it->second.begin(), it->second.end());
+    }
   }
   return keep_list;
 }
 
-bool AnnoKill::kill_annotations() {
-  const auto& referenced_annos = get_referenced_annos();
-  if (!m_only_force_kill) {
-    m_kill = get_removable_annotation_instances();
-  }
-
-  for (auto clazz : m_scope) {
-    DexAnnotationSet* aset = clazz->get_anno_set();
-    if (!aset) {
-      continue;
-    }
+void AnnoKill::cleanup_class(DexClass* clazz,
+                             const AnnoSet& referenced_annos,
+                             CleanupCounts* counts) {
+  auto& stats = counts->stats;
+  DexAnnotationSet* aset = clazz->get_anno_set();
+  if (aset) {
     auto keep_list = build_anno_keep(aset);
-    auto& class_hier_keep_list = m_anno_class_hierarchy_keep[clazz->get_type()];
-    keep_list.insert(class_hier_keep_list.begin(), class_hier_keep_list.end());
+    auto class_hier_keep = m_anno_class_hierarchy_keep.find(clazz->get_type());
+    if (class_hier_keep != m_anno_class_hierarchy_keep.end()) {
+      keep_list.insert(class_hier_keep->second.begin(),
+                       class_hier_keep->second.end());
+    }
 
-    m_stats.class_asets++;
-    cleanup_aset(aset, referenced_annos, keep_list);
+    stats.class_asets++;
+    cleanup_aset(aset, referenced_annos, keep_list, counts);
     if (aset->size() == 0) {
       TRACE(ANNO,
             3,
             "Clearing annotation for class %s\n",
             SHOW(clazz->get_type()));
       clazz->clear_annotations();
-      m_stats.class_asets_cleared++;
+      stats.class_asets_cleared++;
     }
   }
 
-  walk::methods(m_scope, [&](DexMethod* method) {
+  auto cleanup_method = [&](DexMethod* method) {
     // Method annotations
     auto method_aset = method->get_anno_set();
     if (method_aset) {
-      m_stats.method_asets++;
+      stats.method_asets++;
       auto keep_list = build_anno_keep(method_aset);
-      cleanup_aset(method_aset, referenced_annos, keep_list);
+      cleanup_aset(method_aset, referenced_annos, keep_list, counts);
       if (method_aset->size() == 0) {
         TRACE(ANNO,
               3,
@@ -540,14 +543,14 @@ bool AnnoKill::kill_annotations() {
               SHOW(method->get_name()),
               SHOW(method->get_proto()));
         method->clear_annotations();
-        m_stats.method_asets_cleared++;
+        stats.method_asets_cleared++;
       }
     }
 
     // Parameter annotations.
     auto param_annos = method->get_param_anno();
     if (param_annos) {
-      m_stats.method_param_asets += param_annos->size();
+      stats.method_param_asets += param_annos->size();
       bool clear_pas = true;
       for (auto pa : *param_annos) {
         auto param_aset = pa.second;
@@ -555,7 +558,7 @@ bool AnnoKill::kill_annotations() {
           continue;
         }
         auto keep_list = build_anno_keep(param_aset);
-        cleanup_aset(param_aset, referenced_annos, keep_list);
+        cleanup_aset(param_aset, referenced_annos, keep_list, counts);
         if (param_aset->size() == 0) {
           continue;
         }
@@ -568,23 +571,29 @@ bool AnnoKill::kill_annotations() {
               SHOW(method->get_class()),
               SHOW(method->get_name()),
               SHOW(method->get_proto()));
-        m_stats.method_param_asets_cleared += param_annos->size();
+        stats.method_param_asets_cleared += param_annos->size();
         for (auto pa : *param_annos) {
           delete pa.second;
         }
         param_annos->clear();
       }
     }
-  });
+  };
+  for (auto* method : clazz->get_dmethods()) {
+    cleanup_method(method);
+  }
+  for (auto* method : clazz->get_vmethods()) {
+    cleanup_method(method);
+  }
 
-  walk::fields(m_scope, [&](DexField* field) {
+  auto cleanup_field = [&](DexField* field) {
     DexAnnotationSet* aset = field->get_anno_set();
     if (!aset) {
       return;
     }
-    m_stats.field_asets++;
+    stats.field_asets++;
     auto keep_list = build_anno_keep(aset);
-    cleanup_aset(aset, referenced_annos, keep_list);
+    cleanup_aset(aset, referenced_annos, keep_list, counts);
     if (aset->size() == 0) {
       TRACE(ANNO,
             3,
@@ -593,9 +602,52 @@ bool AnnoKill::kill_annotations() {
             SHOW(field->get_name()),
             SHOW(field->get_type()));
       field->clear_annotations();
-      m_stats.field_asets_cleared++;
+      stats.field_asets_cleared++;
     }
-  });
+  };
+  for (auto* field : clazz->get_ifields()) {
+    cleanup_field(field);
+  }
+  for (auto* field : clazz->get_sfields()) {
+    cleanup_field(field);
+  }
+}
+
+bool AnnoKill::kill_annotations() {
+  const auto& referenced_annos = get_referenced_annos();
+  if (!m_only_force_kill) {
+    m_kill = get_removable_annotation_instances();
+  }
+
+  std::vector<std::unique_ptr<CleanupCounts>> thread_counts;
+  auto wq = WorkQueue<DexClass*, CleanupCounts*, std::nullptr_t>(
+      [&](WorkerState<DexClass*, CleanupCounts*, std::nullptr_t>* state,
+          DexClass* clazz) {
+        cleanup_class(clazz, referenced_annos, state->get_data());
+        return nullptr;
+      },
+      [](std::nullptr_t, std::nullptr_t) { return nullptr; }, // reducer
+      [&](unsigned int /*thread_index*/) { // data initializer
+        thread_counts.emplace_back(std::make_unique<CleanupCounts>());
+        return thread_counts.back().get();
+      },
+      walk::parallel::default_num_threads());
+  for (auto* clazz : m_scope) {
+    wq.add_item(clazz);
+  }
+  wq.run_all();
+  for (const auto& counts : thread_counts) {
+    m_stats += counts->stats;
+    for (const auto& p : counts->build_anno_map) {
+      m_build_anno_map[p.first] += p.second;
+    }
+    for (const auto& p : counts->runtime_anno_map) {
+      m_runtime_anno_map[p.first] += p.second;
+    }
+    for (const auto& p : counts->system_anno_map) {
+      m_system_anno_map[p.first] += p.second;
+    }
+  }
 
   bool classes_removed = false;
   // We're done removing annotation instances, go ahead and remove annotation
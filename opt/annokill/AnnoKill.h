@@ -36,6 +36,24 @@ class AnnoKill {
     size_t signatures_killed;
 
     AnnoKillStats() { memset(this, 0, sizeof(AnnoKillStats)); }
+
+    AnnoKillStats& operator+=(const AnnoKillStats& that) {
+      annotations += that.annotations;
+      annotations_killed += that.annotations_killed;
+      class_asets += that.class_asets;
+      class_asets_cleared += that.class_asets_cleared;
+      method_asets += that.method_asets;
+      method_asets_cleared += that.method_asets_cleared;
+      method_param_asets += that.method_param_asets;
+      method_param_asets_cleared += that.method_param_asets_cleared;
+      field_asets += that.field_asets;
+      field_asets_cleared += that.field_asets_cleared;
+      visibility_build_count += that.visibility_build_count;
+      visibility_runtime_count += that.visibility_runtime_count;
+      visibility_system_count += that.visibility_system_count;
+      signatures_killed += that.signatures_killed;
+      return *this;
+    }
   };
 
   AnnoKill(Scope& scope,
@@ -54,6 +72,14 @@ class AnnoKill {
   AnnoKillStats get_stats() const { return m_stats; }
 
  private:
+  // What a thread counted while cleaning up its classes.
+  struct CleanupCounts {
+    AnnoKillStats stats;
+    std::map<std::string, size_t> build_anno_map;
+    std::map<std::string, size_t> runtime_anno_map;
+    std::map<std::string, size_t> system_anno_map;
+  };
+
   // Gets the set of all annotations referenced in code
   // either by the use of SomeClass.class, as a parameter of a method
   // call or if the annotation is a field of a class.
@@ -63,13 +89,19 @@ class AnnoKill {
   // of annotation types to be removed.
   AnnoSet get_removable_annotation_instances();
 
-  void cleanup_aset(
-    DexAnnotationSet* aset,
-    const AnnoSet& referenced_annos,
-    const std::unordered_set<const DexType*>& keep_annos = std::unordered_set<const DexType*>{});
-  void count_annotation(const DexAnnotation* da);
+  // Removes the annotations of the class and of its members. Only touches
+  // the class, so classes can be cleaned up in parallel.
+  void cleanup_class(DexClass* clazz,
+                     const AnnoSet& referenced_annos,
+                     CleanupCounts* counts);
+  void cleanup_aset(DexAnnotationSet* aset,
+                    const AnnoSet& referenced_annos,
+                    const std::unordered_set<const DexType*>& keep_annos,
+                    CleanupCounts* counts);
+  void count_annotation(const DexAnnotation* da, CleanupCounts* counts);
 
   Scope& m_scope;
+  std::unordered_set<const DexClass*> m_scope_classes;
   bool m_only_force_kill;
   bool m_kill_bad_signatures;
   AnnoSet m_kill;
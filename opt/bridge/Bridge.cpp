@@ -11,6 +11,7 @@
 #include <string>
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -24,6 +25,7 @@
 #include "IRInstruction.h"
 #include "DexOutput.h"
 #include "DexUtil.h"
+#include "Parallel.h"
 #include "PassManager.h"
 #include "ReachableClasses.h"
 #include "Trace.h"
@@ -162,21 +164,29 @@ class BridgeRemover {
       m_potential_bridgee_refs;
 
   void find_bridges() {
-    walk::methods(*m_scope,
-                 [&](DexMethod* m) {
-                   if (has_bridgelike_access(m)) {
-                     auto bridgee = find_bridgee(m);
-                     if (!bridgee) return;
-                     m_bridges_to_bridgees.emplace(m, bridgee);
-                     TRACE(BRIDGE,
-                           5,
-                           "Bridge:%p:%s\nBridgee:%p:%s\n",
-                           m,
-                           SHOW(m),
-                           bridgee,
-                           SHOW(bridgee));
-                   }
-                 });
+    using Bridges = std::vector<std::pair<DexMethod*, DexMethod*>>;
+    auto bridges = walk::parallel::accumulate_methods<Bridges>(
+        *m_scope,
+        [](DexMethod* m) {
+          Bridges found;
+          if (has_bridgelike_access(m)) {
+            auto bridgee = find_bridgee(m);
+            if (!bridgee) return found;
+            found.emplace_back(m, bridgee);
+            TRACE(BRIDGE,
+                  5,
+                  "Bridge:%p:%s\nBridgee:%p:%s\n",
+                  m,
+                  SHOW(m),
+                  bridgee,
+                  SHOW(bridgee));
+          }
+          return found;
+        },
+        [](Bridges& left, Bridges&& right) {
+          left.insert(left.end(), right.begin(), right.end());
+        });
+    m_bridges_to_bridgees.insert(bridges.begin(), bridges.end());
   }
 
   void search_hierarchy_for_matches(DexMethod* bridge, DexMethod* bridgee) {
@@ -253,7 +263,10 @@ class BridgeRemover {
     }
   }
 
-  void exclude_referenced_bridgee(DexMethod* code_method, IRCode& code) {
+  // Returns the bridges whose bridgee is referenced from `code_method`.
+  std::unordered_set<DexMethod*> find_referenced_bridgees(
+      DexMethod* code_method, IRCode& code) const {
+    std::unordered_set<DexMethod*> referenced_bridges;
     for (auto& mie : InstructionIterable(&code)) {
       auto inst = mie.insn;
       if (!is_invoke(inst->opcode())) continue;
@@ -273,9 +286,10 @@ class BridgeRemover {
               SHOW(method->get_proto()),
               SHOW(code_method),
               SHOW(referenced_bridge));
-        m_bridges_to_bridgees.erase(referenced_bridge);
+        referenced_bridges.insert(referenced_bridge);
       }
     }
+    return referenced_bridges;
   }
 
   void exclude_referenced_bridgees() {
@@ -324,20 +338,37 @@ class BridgeRemover {
       m_bridges_to_bridgees.erase(kill);
     }
 
-    walk::code(*m_scope,
-              [](DexMethod*) { return true; },
-              [&](DexMethod* m, IRCode& code) {
-                exclude_referenced_bridgee(m, code);
-              });
+    using BridgeSet = std::unordered_set<DexMethod*>;
+    auto referenced_bridges = walk::parallel::accumulate_methods<BridgeSet>(
+        *m_scope,
+        [&](DexMethod* m) {
+          auto code = m->get_code();
+          if (code == nullptr) {
+            return BridgeSet();
+          }
+          return find_referenced_bridgees(m, *code);
+        },
+        [](BridgeSet& left, BridgeSet&& right) {
+          left.insert(right.begin(), right.end());
+        });
+    for (auto bridge : referenced_bridges) {
+      m_bridges_to_bridgees.erase(bridge);
+    }
   }
 
   void inline_bridges() {
-    for (auto bpair : m_bridges_to_bridgees) {
-      auto bridge = bpair.first;
-      auto bridgee = bpair.second;
-      TRACE(BRIDGE, 5, "Inlining %s\n", SHOW(bridge));
-      do_inlining(bridge, bridgee);
-    }
+    // A bridgee that two bridges call is referenced by the other bridge, so
+    // each bridgee is inlined into a single bridge, and they all can be
+    // inlined in parallel.
+    std::vector<std::pair<DexMethod*, DexMethod*>> bridges(
+        m_bridges_to_bridgees.begin(), m_bridges_to_bridgees.end());
+    parallel_for(bridges.begin(), bridges.end(),
+                 [](const std::pair<DexMethod*, DexMethod*>& bpair) {
+                   auto bridge = bpair.first;
+                   auto bridgee = bpair.second;
+                   TRACE(BRIDGE, 5, "Inlining %s\n", SHOW(bridge));
+                   do_inlining(bridge, bridgee);
+                 });
   }
 
   void delete_unused_bridgees() {
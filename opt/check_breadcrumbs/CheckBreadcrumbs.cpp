@@ -16,6 +16,7 @@
 #include "DexUtil.h"
 #include "IRCode.h"
 #include "IRInstruction.h"
+#include "Parallel.h"
 #include "Resolver.h"
 #include "Walkers.h"
 
@@ -97,10 +98,65 @@ Breadcrumbs::Breadcrumbs(const Scope& scope, DexStoresVector& stores, bool rejec
   m_multiple_root_store_dexes = stores[0].get_dexen().size() > 1;
 }
 
+void Breadcrumbs::Violations::append(Violations&& other) {
+  auto append_map = [](auto& to, auto& from) {
+    for (auto& pair : from) {
+      auto& values = to[pair.first];
+      values.insert(values.end(), pair.second.begin(), pair.second.end());
+    }
+  };
+  auto append_nested_map = [&](auto& to, auto& from) {
+    for (auto& pair : from) {
+      append_map(to[pair.first], pair.second);
+    }
+  };
+  append_map(bad_fields, other.bad_fields);
+  append_map(bad_methods, other.bad_methods);
+  append_nested_map(bad_type_insns, other.bad_type_insns);
+  append_nested_map(bad_field_insns, other.bad_field_insns);
+  append_nested_map(bad_meth_insns, other.bad_meth_insns);
+  append_map(illegal_field, other.illegal_field);
+  append_map(bad_fields_refs, other.bad_fields_refs);
+  append_map(illegal_type, other.illegal_type);
+  append_map(illegal_field_type, other.illegal_field_type);
+  append_map(illegal_field_cls, other.illegal_field_cls);
+  append_map(illegal_method_call, other.illegal_method_call);
+}
+
+/*
+ * The scope is split into contiguous chunks that are checked in parallel,
+ * each into its own Violations. Appending those in scope order gives the same
+ * reports as checking the whole scope at once.
+ */
 void Breadcrumbs::check_breadcrumbs() {
-  check_fields();
-  check_methods();
-  check_opcodes();
+  constexpr size_t CHUNKS_PER_THREAD = 16;
+  auto num_chunks = std::max<size_t>(
+      1,
+      std::min(m_scope.size(),
+               ThreadPool::get().num_threads() * CHUNKS_PER_THREAD));
+  std::vector<Violations> chunk_violations(num_chunks);
+  std::vector<size_t> chunks(num_chunks);
+  for (size_t i = 0; i < num_chunks; ++i) {
+    chunks[i] = i;
+  }
+  parallel_for(
+      chunks.begin(),
+      chunks.end(),
+      [&](size_t i) {
+        Scope classes(m_scope.begin() + m_scope.size() * i / num_chunks,
+                      m_scope.begin() + m_scope.size() * (i + 1) / num_chunks);
+        check_classes(classes, &chunk_violations[i]);
+      },
+      /* grain */ 1);
+  for (auto& violations : chunk_violations) {
+    m_violations.append(std::move(violations));
+  }
+}
+
+void Breadcrumbs::check_classes(const Scope& classes, Violations* v) {
+  check_fields(classes, v);
+  check_methods(classes, v);
+  check_opcodes(classes, v);
 }
 
 void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
@@ -109,25 +165,26 @@ void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
   size_t bad_type_insns_count = 0;
   size_t bad_field_insns_count = 0;
   size_t bad_meths_insns_count = 0;
-  if (m_bad_fields.size() > 0 || m_bad_methods.size() > 0 ||
-      m_bad_type_insns.size() > 0 || m_bad_field_insns.size() > 0 ||
-      m_bad_meth_insns.size() > 0) {
+  const auto& v = m_violations;
+  if (v.bad_fields.size() > 0 || v.bad_methods.size() > 0 ||
+      v.bad_type_insns.size() > 0 || v.bad_field_insns.size() > 0 ||
+      v.bad_meth_insns.size() > 0) {
     std::ostringstream ss;
-    for (const auto& bad_field : m_bad_fields) {
+    for (const auto& bad_field : m_violations.bad_fields) {
       for (const auto& field : bad_field.second) {
         bad_fields_count++;
         ss << "Reference to deleted type " << SHOW(bad_field.first)
            << " in field " << SHOW(field) << std::endl;
       }
     }
-    for (const auto& bad_meth : m_bad_methods) {
+    for (const auto& bad_meth : m_violations.bad_methods) {
       for (const auto& meth : bad_meth.second) {
         bad_methods_count++;
         ss << "Reference to deleted type " << SHOW(bad_meth.first)
            << " in method " << SHOW(meth) << std::endl;
       }
     }
-    for (const auto& bad_insns : m_bad_type_insns) {
+    for (const auto& bad_insns : m_violations.bad_type_insns) {
       for (const auto& insns : bad_insns.second) {
         for (const auto& insn : insns.second) {
           bad_type_insns_count++;
@@ -137,7 +194,7 @@ void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
         }
       }
     }
-    for (const auto& bad_insns : m_bad_field_insns) {
+    for (const auto& bad_insns : m_violations.bad_field_insns) {
       for (const auto& insns : bad_insns.second) {
         for (const auto& insn : insns.second) {
           bad_field_insns_count++;
@@ -147,7 +204,7 @@ void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
         }
       }
     }
-    for (const auto& bad_insns : m_bad_meth_insns) {
+    for (const auto& bad_insns : m_violations.bad_meth_insns) {
       for (const auto& insns : bad_insns.second) {
         for (const auto& insn : insns.second) {
           bad_meths_insns_count++;
@@ -182,7 +239,7 @@ void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
 
 std::string Breadcrumbs::get_methods_with_bad_refs() {
   std::ostringstream ss;
-  for (const auto& class_meth : m_bad_methods) {
+  for (const auto& class_meth : m_violations.bad_methods) {
     const auto type = class_meth.first;
     const auto& methods = class_meth.second;
     ss << "Bad methods in class " << type->get_name()->c_str() << std::endl;
@@ -191,7 +248,7 @@ std::string Breadcrumbs::get_methods_with_bad_refs() {
     }
     ss << std::endl;
   }
-  for (const auto& meth_field : m_bad_fields_refs) {
+  for (const auto& meth_field : m_violations.bad_fields_refs) {
     const auto type = meth_field.first->get_class();
     const auto method = meth_field.first;
     const auto& fields = meth_field.second;
@@ -209,7 +266,7 @@ void Breadcrumbs::report_illegal_refs(bool fail_if_illegal_refs,
                                       PassManager& mgr) {
   size_t num_illegal_fields = 0;
   std::ostringstream ss;
-  for (const auto& pair : m_illegal_field) {
+  for (const auto& pair : m_violations.illegal_field) {
     const auto type = pair.first;
     const auto& fields = pair.second;
     num_illegal_fields += fields.size();
@@ -223,13 +280,13 @@ void Breadcrumbs::report_illegal_refs(bool fail_if_illegal_refs,
   }
 
   size_t num_illegal_type_refs =
-      illegal_elements(m_illegal_type, "type refs", ss);
+      illegal_elements(m_violations.illegal_type, "type refs", ss);
   size_t num_illegal_field_type_refs =
-      illegal_elements(m_illegal_field_type, "field type refs", ss);
+      illegal_elements(m_violations.illegal_field_type, "field type refs", ss);
   size_t num_illegal_field_cls =
-      illegal_elements(m_illegal_field_cls, "field class refs", ss);
+      illegal_elements(m_violations.illegal_field_cls, "field class refs", ss);
   size_t num_illegal_method_calls =
-      illegal_elements(m_illegal_method_call, "method call", ss);
+      illegal_elements(m_violations.illegal_method_call, "method call", ss);
 
   size_t num_illegal_cross_store_refs =
       num_illegal_fields + num_illegal_type_refs + num_illegal_field_cls +
@@ -257,6 +314,11 @@ void Breadcrumbs::report_illegal_refs(bool fail_if_illegal_refs,
 }
 
 bool Breadcrumbs::has_illegal_access(const DexMethod* input_method) {
+  return has_illegal_access(input_method, &m_violations);
+}
+
+bool Breadcrumbs::has_illegal_access(const DexMethod* input_method,
+                                     Violations* v) {
   bool result = false;
   if (input_method->get_code() == nullptr) {
     return false;
@@ -266,7 +328,7 @@ bool Breadcrumbs::has_illegal_access(const DexMethod* input_method) {
     if (insn->has_field()) {
       auto res_field = resolve_field(insn->get_field());
       if (res_field != nullptr) {
-        if (!check_field_accessibility(input_method, res_field)) {
+        if (!check_field_accessibility(input_method, res_field, v)) {
           result = true;
         }
       } else if (referenced_field_is_deleted(insn->get_field())) {
@@ -277,7 +339,7 @@ bool Breadcrumbs::has_illegal_access(const DexMethod* input_method) {
       auto res_method =
           resolve_method(insn->get_method(), opcode_to_search(insn));
       if (res_method != nullptr) {
-        if (!check_method_accessibility(input_method, res_method)) {
+        if (!check_method_accessibility(input_method, res_method, v)) {
           result = true;
         }
       } else if (referenced_method_is_deleted(insn->get_method())) {
@@ -331,43 +393,45 @@ const DexType* Breadcrumbs::check_method(const DexMethodRef* method) {
 
 void Breadcrumbs::bad_type(const DexType* type,
                            const DexMethod* method,
-                           const IRInstruction* insn) {
-  m_bad_type_insns[type][method].emplace_back(insn);
+                           const IRInstruction* insn,
+                           Violations* v) {
+  v->bad_type_insns[type][method].emplace_back(insn);
 }
 
 // verify that all field definitions are of a type not deleted
-void Breadcrumbs::check_fields() {
-  walk::fields(m_scope, [&](DexField* field) {
+void Breadcrumbs::check_fields(const Scope& classes, Violations* v) {
+  walk::fields(classes, [&](DexField* field) {
     const auto& type = check_type(field->get_type());
     if (type == nullptr) {
       const auto cls = field->get_class();
       const auto field_type = field->get_type();
       if (is_illegal_cross_store(cls, field_type)) {
-        m_illegal_field[cls].emplace_back(field);
+        v->illegal_field[cls].emplace_back(field);
       }
       return;
     }
-    m_bad_fields[type].emplace_back(field);
+    v->bad_fields[type].emplace_back(field);
   });
 }
 
 // verify that all method definitions use not deleted types in their sig
-void Breadcrumbs::check_methods() {
-  walk::methods(m_scope, [&](DexMethod* method) {
+void Breadcrumbs::check_methods(const Scope& classes, Violations* v) {
+  walk::methods(classes, [&](DexMethod* method) {
     const auto& type = check_method(method);
     if (type == nullptr) return;
-    m_bad_methods[type].emplace_back(method);
-    has_illegal_access(method);
+    v->bad_methods[type].emplace_back(method);
+    has_illegal_access(method, v);
   });
 }
 
 /* verify that all method instructions that access fields are valid */
 bool Breadcrumbs::check_field_accessibility(const DexMethod* method,
-                                            const DexField* res_field) {
+                                            const DexField* res_field,
+                                            Violations* v) {
   const auto field_class = res_field->get_class();
   const auto method_class = method->get_class();
   if (field_class != method_class && is_private(res_field)) {
-    m_bad_fields_refs[method].emplace_back(res_field);
+    v->bad_fields_refs[method].emplace_back(res_field);
     return false;
   }
   return true;
@@ -383,11 +447,13 @@ bool Breadcrumbs::referenced_method_is_deleted(DexMethodRef* method) {
 
 /* verify that all method instructions that access methods are valid */
 bool Breadcrumbs::check_method_accessibility(
-    const DexMethod* method, const DexMethod* res_called_method) {
+    const DexMethod* method,
+    const DexMethod* res_called_method,
+    Violations* v) {
   const auto called_method_class = res_called_method->get_class();
   const auto method_class = method->get_class();
   if (called_method_class != method_class && is_private(res_called_method)) {
-    m_bad_methods[method_class].emplace_back(res_called_method);
+    v->bad_methods[method_class].emplace_back(res_called_method);
     return false;
   }
   return true;
@@ -395,41 +461,43 @@ bool Breadcrumbs::check_method_accessibility(
 
 // verify that all opcodes are to non deleted references
 void Breadcrumbs::check_type_opcode(const DexMethod* method,
-                                    IRInstruction* insn) {
+                                    IRInstruction* insn,
+                                    Violations* v) {
   const DexType* type = insn->get_type();
   type = check_type(type);
   if (type != nullptr) {
-    bad_type(type, method, insn);
+    bad_type(type, method, insn, v);
   } else {
     const auto cls = method->get_class();
     if (is_illegal_cross_store(cls, insn->get_type())) {
-      m_illegal_type[method].emplace_back(insn);
+      v->illegal_type[method].emplace_back(insn);
     }
   }
 }
 
 void Breadcrumbs::check_field_opcode(const DexMethod* method,
-                                     IRInstruction* insn) {
+                                     IRInstruction* insn,
+                                     Violations* v) {
   auto field = insn->get_field();
   const DexType* type = check_type(field->get_class());
   if (type != nullptr) {
-    bad_type(type, method, insn);
+    bad_type(type, method, insn, v);
     return;
   }
 
   auto cls = method->get_class();
   if (is_illegal_cross_store(cls, field->get_class())) {
-    m_illegal_field_type[method].emplace_back(insn);
+    v->illegal_field_type[method].emplace_back(insn);
   }
 
   type = check_type(field->get_type());
   if (type != nullptr) {
-    bad_type(type, method, insn);
+    bad_type(type, method, insn, v);
     return;
   }
 
   if (is_illegal_cross_store(cls, field->get_type())) {
-    m_illegal_field_cls[method].emplace_back(insn);
+    v->illegal_field_cls[method].emplace_back(insn);
   }
 
   auto res_field = resolve_field(field);
@@ -438,7 +506,7 @@ void Breadcrumbs::check_field_opcode(const DexMethod* method,
     if (field != res_field) {
       type = check_type(field->get_class());
       if (type != nullptr) {
-        bad_type(type, method, insn);
+        bad_type(type, method, insn, v);
         return;
       }
     }
@@ -446,7 +514,7 @@ void Breadcrumbs::check_field_opcode(const DexMethod* method,
     // the class of the field is around but the field may have
     // been deleted so let's verify the field exists on the class
     if (referenced_field_is_deleted(field)) {
-      m_bad_field_insns[static_cast<DexField*>(field)][method].emplace_back(
+      v->bad_field_insns[static_cast<DexField*>(field)][method].emplace_back(
           insn);
       return;
     }
@@ -454,15 +522,16 @@ void Breadcrumbs::check_field_opcode(const DexMethod* method,
 }
 
 void Breadcrumbs::check_method_opcode(const DexMethod* method,
-                                      IRInstruction* insn) {
+                                      IRInstruction* insn,
+                                      Violations* v) {
   const auto& meth = insn->get_method();
   const DexType* type = check_method(meth);
   if (type != nullptr) {
-    bad_type(type, method, insn);
+    bad_type(type, method, insn, v);
     return;
   }
   if (is_illegal_cross_store(method->get_class(), meth->get_class())) {
-    m_illegal_method_call[method].emplace_back(insn);
+    v->illegal_method_call[method].emplace_back(insn);
   }
 
   DexMethod* res_meth = resolve_method(meth, opcode_to_search(insn));
@@ -471,7 +540,7 @@ void Breadcrumbs::check_method_opcode(const DexMethod* method,
     if (res_meth != meth) {
       type = check_type(res_meth->get_class());
       if (type != nullptr) {
-        bad_type(type, method, insn);
+        bad_type(type, method, insn, v);
         return;
       }
     }
@@ -479,27 +548,27 @@ void Breadcrumbs::check_method_opcode(const DexMethod* method,
     // the class of the method is around but the method may have
     // been deleted so let's verify the method exists on the class
     if (referenced_method_is_deleted(meth)) {
-      m_bad_meth_insns[static_cast<DexMethod*>(meth)][method].emplace_back(
+      v->bad_meth_insns[static_cast<DexMethod*>(meth)][method].emplace_back(
           insn);
       return;
     }
   }
 }
 
-void Breadcrumbs::check_opcodes() {
-  walk::opcodes(m_scope,
+void Breadcrumbs::check_opcodes(const Scope& classes, Violations* v) {
+  walk::opcodes(classes,
                 [](DexMethod*) { return true; },
                 [&](DexMethod* method, IRInstruction* insn) {
                   if (insn->has_type()) {
-                    check_type_opcode(method, insn);
+                    check_type_opcode(method, insn, v);
                     return;
                   }
                   if (insn->has_field()) {
-                    check_field_opcode(method, insn);
+                    check_field_opcode(method, insn, v);
                     return;
                   }
                   if (insn->has_method()) {
-                    check_method_opcode(method, insn);
+                    check_method_opcode(method, insn, v);
                   }
                 });
 }
@@ -55,21 +55,30 @@ class Breadcrumbs {
   bool has_illegal_access(const DexMethod* input_method);
 
  private:
+  // The references that failed a check.
+  struct Violations {
+    std::map<const DexType*, Fields, dextypes_comparator> bad_fields;
+    std::map<const DexType*, Methods, dextypes_comparator> bad_methods;
+    std::map<const DexType*, MethodInsns, dextypes_comparator> bad_type_insns;
+    std::map<const DexField*, MethodInsns, dexfields_comparator>
+        bad_field_insns;
+    std::map<const DexMethod*, MethodInsns, dexmethods_comparator>
+        bad_meth_insns;
+    std::map<const DexType*, Fields, dextypes_comparator> illegal_field;
+    std::map<const DexMethod*, Fields, dexmethods_comparator> bad_fields_refs;
+    MethodInsns illegal_type;
+    MethodInsns illegal_field_type;
+    MethodInsns illegal_field_cls;
+    MethodInsns illegal_method_call;
+
+    // Appends the violations of `other`, which must come from classes after
+    // the ones of this.
+    void append(Violations&& other);
+  };
+
   const Scope& m_scope;
   std::unordered_set<const DexClass*> m_classes;
-  std::map<const DexType*, Fields, dextypes_comparator> m_bad_fields;
-  std::map<const DexType*, Methods, dextypes_comparator> m_bad_methods;
-  std::map<const DexType*, MethodInsns, dextypes_comparator> m_bad_type_insns;
-  std::map<const DexField*, MethodInsns, dexfields_comparator>
-      m_bad_field_insns;
-  std::map<const DexMethod*, MethodInsns, dexmethods_comparator>
-      m_bad_meth_insns;
-  std::map<const DexType*, Fields, dextypes_comparator> m_illegal_field;
-  std::map<const DexMethod*, Fields, dexmethods_comparator> m_bad_fields_refs;
-  MethodInsns m_illegal_type;
-  MethodInsns m_illegal_field_type;
-  MethodInsns m_illegal_field_cls;
-  MethodInsns m_illegal_method_call;
+  Violations m_violations;
   XStoreRefs m_xstores;
   bool m_multiple_root_store_dexes;
   bool m_reject_illegal_refs_root_store;
@@ -79,17 +88,28 @@ class Breadcrumbs {
   const DexType* check_method(const DexMethodRef* method);
   void bad_type(const DexType* type,
                 const DexMethod* method,
-                const IRInstruction* insn);
-  void check_fields();
-  void check_methods();
+                const IRInstruction* insn,
+                Violations* v);
+  void check_classes(const Scope& classes, Violations* v);
+  void check_fields(const Scope& classes, Violations* v);
+  void check_methods(const Scope& classes, Violations* v);
+  bool has_illegal_access(const DexMethod* input_method, Violations* v);
   bool referenced_field_is_deleted(DexFieldRef* field);
   bool referenced_method_is_deleted(DexMethodRef* method);
   bool check_field_accessibility(const DexMethod* method,
-                                 const DexField* res_field);
+                                 const DexField* res_field,
+                                 Violations* v);
   bool check_method_accessibility(const DexMethod* method,
-                                  const DexMethod* res_called_method);
-  void check_type_opcode(const DexMethod* method, IRInstruction* insn);
-  void check_field_opcode(const DexMethod* method, IRInstruction* insn);
-  void check_method_opcode(const DexMethod* method, IRInstruction* insn);
-  void check_opcodes();
+                                  const DexMethod* res_called_method,
+                                  Violations* v);
+  void check_type_opcode(const DexMethod* method,
+                         IRInstruction* insn,
+                         Violations* v);
+  void check_field_opcode(const DexMethod* method,
+                          IRInstruction* insn,
+                          Violations* v);
+  void check_method_opcode(const DexMethod* method,
+                           IRInstruction* insn,
+                           Violations* v);
+  void check_opcodes(const Scope& classes, Violations* v);
 };
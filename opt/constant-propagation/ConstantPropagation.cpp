@@ -7,8 +7,12 @@
 
 #include "ConstantPropagation.h"
 
+#include <atomic>
+#include <mutex>
+
 #include "ConstantPropagationAnalysis.h"
 #include "ConstantPropagationTransform.h"
+#include "IncrementalPassCache.h"
 #include "Walkers.h"
 
 using namespace constant_propagation;
@@ -17,45 +21,98 @@ void ConstantPropagationPass::configure_pass(const JsonWrapper& jw) {
   jw.get("replace_moves_with_consts",
          false,
          m_config.transform.replace_moves_with_consts);
+  int64_t lean_block_threshold;
+  jw.get("lean_block_threshold", 0, lean_block_threshold);
+  always_assert(lean_block_threshold >= 0);
+  if (lean_block_threshold > 0) {
+    m_config.lean_block_threshold = static_cast<size_t>(lean_block_threshold);
+  }
+  int64_t analysis_budget;
+  jw.get("analysis_budget", 0, analysis_budget);
+  always_assert(analysis_budget >= 0);
+  if (analysis_budget > 0) {
+    m_config.analysis_budget = static_cast<size_t>(analysis_budget);
+  }
+}
+
+namespace {
+
+class ConstantPropagationRunner : public Pass::MethodRunner {
+ public:
+  ConstantPropagationRunner(ConfigFiles& cfg,
+                            PassManager& mgr,
+                            const ConstantPropagationPass::Config& config)
+      : m_config(config), m_cache(cfg, mgr) {}
+
+  void run(DexMethod* method) override {
+    TRACE(CONSTP, 2, "Method: %s\n", SHOW(method));
+    // The counters are: branches removed, consts materialized, and whether
+    // the method was over the analysis budget.
+    auto stats = m_cache.run(method, /* summarize_refs */ true, [&] {
+      auto& code = *method->get_code();
+      code.build_cfg(/* editable */ false);
+      auto& cfg = code.cfg();
+
+      TRACE(CONSTP, 5, "CFG: %s\n", SHOW(cfg));
+      intraprocedural::FixpointIterator fp_iter(
+          cfg, ConstantPrimitiveAnalyzer(), m_config.lean_block_threshold);
+      fp_iter.set_budget(m_config.analysis_budget);
+      fp_iter.run(ConstantEnvironment());
+      if (fp_iter.budget_exceeded()) {
+        // Nothing would be known anyway.
+        TRACE(CONSTP, 1, "Over the analysis budget: %s\n", SHOW(method));
+        return IncrementalPassCache::Stats{0, 0, 1};
+      }
+      constant_propagation::Transform tf(m_config.transform);
+      auto tf_stats = tf.apply(fp_iter, WholeProgramState(), &code);
+      return IncrementalPassCache::Stats{
+          tf_stats.branches_removed, tf_stats.materialized_consts, 0};
+    });
+    m_methods_over_budget += stats.at(2);
+    Transform::Stats tf_stats;
+    tf_stats.branches_removed = stats.at(0);
+    tf_stats.materialized_consts = stats.at(1);
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+    m_stats = m_stats + tf_stats;
+  }
+
+  void finish(PassManager& mgr) override {
+    m_cache.finish(mgr);
+    mgr.incr_metric("num_branch_propagated", m_stats.branches_removed);
+    mgr.incr_metric("num_materialized_consts", m_stats.materialized_consts);
+    mgr.incr_metric("num_methods_over_analysis_budget", m_methods_over_budget);
+
+    TRACE(CONSTP, 1, "num_branch_propagated: %d\n", m_stats.branches_removed);
+    TRACE(CONSTP,
+          1,
+          "num_moves_replaced_by_const_loads: %d\n",
+          m_stats.materialized_consts);
+  }
+
+ private:
+  const ConstantPropagationPass::Config& m_config;
+  IncrementalPassCache m_cache;
+  std::mutex m_stats_mutex;
+  Transform::Stats m_stats;
+  std::atomic<size_t> m_methods_over_budget{0};
+};
+
+} // namespace
+
+std::unique_ptr<Pass::MethodRunner> ConstantPropagationPass::method_runner(
+    DexStoresVector&, ConfigFiles& cfg, PassManager& mgr) {
+  return std::make_unique<ConstantPropagationRunner>(cfg, mgr, m_config);
 }
 
 void ConstantPropagationPass::run_pass(DexStoresVector& stores,
-                                       ConfigFiles&,
+                                       ConfigFiles& cfg,
                                        PassManager& mgr) {
-  auto scope = build_class_scope(stores);
-
-  auto stats = walk::parallel::reduce_methods<Transform::Stats>(
-      scope,
-      [&](DexMethod* method) {
-        if (method->get_code() == nullptr) {
-          return Transform::Stats();
-        }
-
-        TRACE(CONSTP, 2, "Method: %s\n", SHOW(method));
-        auto& code = *method->get_code();
-        code.build_cfg(/* editable */ false);
-        auto& cfg = code.cfg();
-
-        TRACE(CONSTP, 5, "CFG: %s\n", SHOW(cfg));
-        intraprocedural::FixpointIterator fp_iter(cfg,
-                                                  ConstantPrimitiveAnalyzer());
-        fp_iter.run(ConstantEnvironment());
-        constant_propagation::Transform tf(m_config.transform);
-        return tf.apply(fp_iter, WholeProgramState(), &code);
-      },
-
-      [](Transform::Stats a, Transform::Stats b) { // reducer
-        return a + b;
-      });
-
-  mgr.incr_metric("num_branch_propagated", stats.branches_removed);
-  mgr.incr_metric("num_materialized_consts", stats.materialized_consts);
-
-  TRACE(CONSTP, 1, "num_branch_propagated: %d\n", stats.branches_removed);
-  TRACE(CONSTP,
-        1,
-        "num_moves_replaced_by_const_loads: %d\n",
-        stats.materialized_consts);
+  auto runner = method_runner(stores, cfg, mgr);
+  walk::parallel::code(build_class_scope(stores),
+                       [&](DexMethod* m, IRCode&) { runner->run(m); },
+                       walk::parallel::default_num_threads(),
+                       walk::parallel::Split::LARGE_CLASSES);
+  runner->finish(mgr);
 }
 
 static ConstantPropagationPass s_pass;
@@ -14,6 +14,12 @@
 class ConstantPropagationPass : public Pass {
  public:
   struct Config {
+    // Methods with at least this many blocks are analyzed in the lean mode of
+    // intraprocedural::FixpointIterator.
+    size_t lean_block_threshold{std::numeric_limits<size_t>::max()};
+    // The analysis of a method gives up after analyzing this many blocks,
+    // counting each visit of a loop block, and the method is left as is.
+    size_t analysis_budget{std::numeric_limits<size_t>::max()};
     constant_propagation::Transform::Config transform;
   };
 
@@ -24,6 +30,16 @@ class ConstantPropagationPass : public Pass {
                         ConfigFiles& cfg,
                         PassManager& mgr) override;
 
+  std::unique_ptr<MethodRunner> method_runner(DexStoresVector&,
+                                              ConfigFiles&,
+                                              PassManager&) override;
+
+  bool is_method_local() const override { return true; }
+
+  analysis::Set preserved_analyses() const override {
+    return analysis::CODE_AGNOSTIC;
+  }
+
  private:
   Config m_config;
 };
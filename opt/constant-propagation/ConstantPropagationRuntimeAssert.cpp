@@ -237,7 +237,7 @@ void RuntimeAssertTransform::insert_param_asserts(
     return;
   }
   auto& code = *method->get_code();
-  auto arg_types = method->get_proto()->get_args()->get_type_list();
+  const auto& arg_types = method->get_proto()->get_args()->get_type_list();
   auto param_insns = code.get_param_instructions();
   auto insert_it = param_insns.end();
   auto insn_it = ir_list::InstructionIterable(code).begin();
@@ -27,7 +27,8 @@ using CombinedAnalyzer = InstructionAnalyzerCombiner<ClinitFieldAnalyzer,
 std::unique_ptr<intraprocedural::FixpointIterator> analyze_procedure(
     const DexMethod* method,
     const WholeProgramState& wps,
-    ArgumentDomain args) {
+    ArgumentDomain args,
+    size_t lean_block_threshold) {
   always_assert(method->get_code() != nullptr);
   auto& code = *method->get_code();
   // Currently, our callgraph does not include calls to non-devirtualizable
@@ -53,7 +54,8 @@ std::unique_ptr<intraprocedural::FixpointIterator> analyze_procedure(
                        &wps,
                        EnumFieldAnalyzerState(),
                        BoxedBooleanAnalyzerState(),
-                       nullptr));
+                       nullptr),
+      lean_block_threshold);
   intra_cp->run(env);
 
   return intra_cp;
@@ -81,10 +83,25 @@ std::unique_ptr<FixpointIterator> PassImpl::analyze(const Scope& scope) {
     code.build_cfg(/* editable */ false);
     code.cfg().calculate_exit_block();
   });
-  auto fp_iter = std::make_unique<FixpointIterator>(cg, analyze_procedure);
+  auto fp_iter = std::make_unique<FixpointIterator>(
+      cg,
+      [this](const DexMethod* method,
+             const WholeProgramState& wps,
+             ArgumentDomain args) {
+        return analyze_procedure(method, wps, args,
+                                 m_config.lean_block_threshold);
+      });
+  auto run = [&]() {
+    Domain init({{CURRENT_PARTITION_LABEL, ArgumentDomain()}});
+    if (m_config.analyze_in_waves) {
+      fp_iter->run_in_waves(init);
+    } else {
+      fp_iter->run(init);
+    }
+  };
   // Run the bootstrap. All field value and method return values are
   // represented by Top.
-  fp_iter->run({{CURRENT_PARTITION_LABEL, ArgumentDomain()}});
+  run();
 
   for (size_t i = 0; i < m_config.max_heap_analysis_iterations; ++i) {
     // Build an approximation of all the field values and method return values.
@@ -96,7 +113,7 @@ std::unique_ptr<FixpointIterator> PassImpl::analyze(const Scope& scope) {
     // Use the refined WholeProgramState to propagate more constants via
     // the stack and registers.
     fp_iter->set_whole_program_state(std::move(wps));
-    fp_iter->run({{CURRENT_PARTITION_LABEL, ArgumentDomain()}});
+    run();
   }
   compute_analysis_stats(fp_iter->get_whole_program_state());
 
@@ -25,6 +25,12 @@ class PassImpl : public Pass {
     // Setting this to zero means that all field values and return values will
     // be treated as Top.
     size_t max_heap_analysis_iterations{0};
+    // Analyze the methods of each wave of call graph components in parallel
+    // (see FixpointIterator::run_in_waves).
+    bool analyze_in_waves{false};
+    // Methods with at least this many blocks are analyzed in the lean mode of
+    // intraprocedural::FixpointIterator.
+    size_t lean_block_threshold{std::numeric_limits<size_t>::max()};
 
     Transform::Config transform;
     RuntimeAssertTransform::Config runtime_assert;
@@ -41,11 +47,19 @@ class PassImpl : public Pass {
            m_config.transform.replace_moves_with_consts);
     jw.get("include_virtuals", false, m_config.include_virtuals);
     jw.get("create_runtime_asserts", false, m_config.create_runtime_asserts);
+    jw.get("analyze_in_waves", false, m_config.analyze_in_waves);
     int64_t max_heap_analysis_iterations;
     jw.get("max_heap_analysis_iterations", 0, max_heap_analysis_iterations);
     always_assert(max_heap_analysis_iterations >= 0);
     m_config.max_heap_analysis_iterations =
         static_cast<size_t>(max_heap_analysis_iterations);
+    int64_t lean_block_threshold;
+    jw.get("lean_block_threshold", 0, lean_block_threshold);
+    always_assert(lean_block_threshold >= 0);
+    if (lean_block_threshold > 0) {
+      m_config.lean_block_threshold =
+          static_cast<size_t>(lean_block_threshold);
+    }
   }
 
   void run_pass(DexStoresVector& stores,
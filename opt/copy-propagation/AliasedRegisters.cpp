@@ -8,46 +8,32 @@
 #include "AliasedRegisters.h"
 
 #include <algorithm>
-#ifdef __GNUC__
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wshadow"
-#endif
-#include <boost/graph/adjacency_list.hpp>
-#ifdef __GNUC__
-#pragma GCC diagnostic pop
-#endif
 #include <boost/optional.hpp>
-#include <boost/range/iterator_range.hpp>
 #include <limits>
-#include <numeric>
-#include <unordered_set>
+#include <unordered_map>
 
 using namespace sparta;
 
-// Implemented by an undirected graph where nodes are Registers and edges are an
-// alias between them.
-//
-// An alias group is a fully connected clique of nodes.
-// Every node in a group is aliased to every other node.
-//
-// Data structure invariant: The graph is a forest of cliques
-// Corollary: There are no edges that are not part of a clique.
+// Implemented as a partition of the values that are aliased to at least one
+// other value: each of them is labeled with the ID of its alias group, and
+// the labeled values are kept in a vector sorted by value. Copying the domain
+// at every block transfer and join is then a single allocation, and the
+// lattice operations walk over that vector.
 //
 // The aliasing relation is an equivalence relation. An alias group is an
 // equivalence class of this relation.
-//   Reflexive : a node is trivially equivalent to itself
-//   Symmetric : edges in the graph are undirected
-//   Transitive: `AliasedRegisters::move` adds an edge to every node in the
-//               group, creating a clique
+//   Reflexive : a value is trivially equivalent to itself
+//   Symmetric : membership in a group is symmetric
+//   Transitive: `AliasedRegisters::move` adds `moving` to the whole group
+//
+// Since `move` also removes values from their group, the groups are relabeled
+// explicitly rather than kept in a union-find forest, which can't split.
 
 namespace aliased_registers {
 
 // Move `moving` into the alias group of `group`
 //
-// Create an edge from `moving` to every vertex in the alias group of
-// `group`.
-//
-// We want alias groups to be fully connected cliques.
+// We want every member of the group to be an alias of `moving`.
 // Here's an example to show why:
 //
 //   move v1, v2
@@ -55,84 +41,68 @@ namespace aliased_registers {
 //   const v1, 0
 //
 // At this point, v0 and v2 still hold the same value, but if we had just
-// added an edge from v0 to v1, then we would have lost this information.
+// aliased v0 to v1, then we would have lost this information.
 void AliasedRegisters::move(const Value& moving, const Value& group) {
   // Only need to do something if they're not already in same group
-  if (!are_aliases(moving, group)) {
-    // remove from the old group
-    break_alias(moving);
-    vertex_t v_moving = find_or_create(moving);
-    vertex_t v_group = find_or_create(group);
-
-    const auto& grp = vertices_in_group(v_group);
-    track_insert_order(moving, v_moving, group, v_group, grp);
-
-    // add edge to every node in new group
-    for (vertex_t v : grp) {
-      boost::add_edge(v_moving, v, m_graph);
-    }
+  if (are_aliases(moving, group)) {
+    return;
   }
-}
-
-// Set the insertion number of `v_moving` to 1 + the max of `group`.
-// `v_moving` is the newest member of `group` so it should have the highest
-// insertion number.
-//
-// If this call creates a new clique (of size two), also set the insertion
-// number of v_group
-void AliasedRegisters::track_insert_order(const Value& moving,
-                                          vertex_t v_moving,
-                                          const Value& group,
-                                          vertex_t v_group,
-                                          const std::vector<vertex_t>& grp) {
-  always_assert(!grp.empty());
-  if (grp.size() == 1 && group.is_register()) {
-    // We're creating a new clique from a solitary vertex. The group
-    // register is the oldest, followed by moving.
-    m_insert_order[v_group] = 0;
-  }
-
-  if (moving.is_register()) {
-    m_insert_order[v_moving] =
-        1 + std::accumulate(
-                grp.begin(), grp.end(), 0, [this](size_t acc, vertex_t v) {
-                  // use operator[] to ignore non-register group members
-                  return std::max(acc, m_insert_order[v]);
-                });
+  // remove from the old group
+  break_alias(moving);
+
+  // `moving` is the newest member of `group` so it gets the highest insertion
+  // number. If this creates a new group (of size two), the group register is
+  // the oldest.
+  auto idx = find(group);
+  uint32_t group_id;
+  uint32_t insert_order = 0;
+  if (idx == m_entries.size()) {
+    group_id = m_next_group++;
+    insert(group, group_id, 0);
+  } else {
+    group_id = m_entries[idx].group;
+    for (const auto& entry : m_entries) {
+      if (entry.group == group_id) {
+        insert_order = std::max(insert_order, entry.insert_order);
+      }
+    }
   }
+  insert(moving, group_id, moving.is_register() ? insert_order + 1 : 0);
 }
 
 // Remove r from its alias group
 void AliasedRegisters::break_alias(const Value& r) {
-  const auto& v = find(r);
-  const auto& end = boost::vertices(m_graph).second;
-  if (v != end) {
-    // clear removes all edges incident to r
-    boost::clear_vertex(*v, m_graph);
-
-    if (r.is_register()) {
-      // v is not in a clique any more so it has no insert order
-      clear_insert_number(*v);
+  auto idx = find(r);
+  if (idx == m_entries.size()) {
+    return;
+  }
+  auto group = m_entries[idx].group;
+  m_entries.erase(m_entries.begin() + idx);
+  // A group of one is no group at all.
+  size_t remaining = m_entries.size();
+  for (size_t i = 0; i < m_entries.size(); ++i) {
+    if (m_entries[i].group == group) {
+      if (remaining != m_entries.size()) {
+        return;
+      }
+      remaining = i;
     }
   }
+  if (remaining != m_entries.size()) {
+    m_entries.erase(m_entries.begin() + remaining);
+  }
 }
 
-// Call this when `v` should no longer have an insertion number (because it does
-// not belong to a clique).
-void AliasedRegisters::clear_insert_number(vertex_t v) {
-  m_insert_order.erase(v);
-}
-
-// if there is an edge between r1 to r2, then they are aliases.
-// We only need to check for single edge paths because `move` adds an edge to
-// every node in the alias group, thus maintaining transitive closure of the
-// graph
+// r1 and r2 are aliases if they are labeled with the same group.
 bool AliasedRegisters::are_aliases(const Value& r1, const Value& r2) const {
   if (r1 == r2) {
     return true;
   }
 
-  return has_edge_between(r1, r2);
+  auto idx1 = find(r1);
+  auto idx2 = find(r2);
+  return idx1 != m_entries.size() && idx2 != m_entries.size() &&
+         m_entries[idx1].group == m_entries[idx2].group;
 }
 
 // Return a representative for this register.
@@ -154,161 +124,112 @@ Register AliasedRegisters::get_representative(
     const Value& orig, const boost::optional<Register>& max_addressable) const {
   always_assert(orig.is_register());
 
-  // if r is not in the graph, then it has no representative
-  const auto& v = find(orig);
-  const auto& end = boost::vertices(m_graph).second;
-  if (v == end) {
+  // if r is not in a group, then it has no representative
+  auto idx = find(orig);
+  if (idx == m_entries.size()) {
     return orig.reg();
   }
 
-  // intentionally copy the vector so we can safely remove from it
-  std::vector<vertex_t> group = vertices_in_group(*v);
-  // filter out non registers and other ineligible registers
-  group.erase(std::remove_if(group.begin(),
-                             group.end(),
-                             [this, &max_addressable](vertex_t elem) {
-                               // return true to remove it
-                               const Value& val = m_graph[elem];
-                               if (!val.is_register()) {
-                                 return true;
-                               }
-                               return max_addressable &&
-                                      val.reg() > *max_addressable;
-                             }),
-              group.end());
-
-  if (group.empty()) {
-    return orig.reg();
-  }
-
-  // We want the oldest element. It has the lowest insertion number
-  const Value& representative = m_graph[*std::min_element(
-      group.begin(), group.end(), [this](vertex_t a, vertex_t b) {
-        return m_insert_order.at(a) < m_insert_order.at(b);
-      })];
-  return representative.reg();
-}
-
-// if `r` is in the graph, return the vertex holding it.
-// if not, return the `end` iterator of the vertices
-const boost::range_detail::integer_iterator<AliasedRegisters::vertex_t>
-AliasedRegisters::find(const Value& r) const {
-  const auto& iters = boost::vertices(m_graph);
-  const auto& begin = iters.first;
-  const auto& end = iters.second;
-  for (auto it = begin; it != end; ++it) {
-    if (m_graph[*it] == r) {
-      return it;
+  // We want the oldest eligible register. It has the lowest insertion number
+  auto group = m_entries[idx].group;
+  const Entry* representative = nullptr;
+  for (const auto& entry : m_entries) {
+    if (entry.group != group || !entry.value.is_register() ||
+        (max_addressable && entry.value.reg() > *max_addressable)) {
+      continue;
+    }
+    if (representative == nullptr ||
+        entry.insert_order < representative->insert_order) {
+      representative = &entry;
     }
   }
-  return end;
-}
-
-// returns the vertex holding `r` or creates a new (unconnected)
-// vertex if `r` is not in m_graph
-AliasedRegisters::vertex_t AliasedRegisters::find_or_create(const Value& r) {
-  const auto& it = find(r);
-  const auto& end = boost::vertices(m_graph).second;
-  if (it != end) {
-    return *it;
-  } else {
-    return boost::add_vertex(r, m_graph);
-  }
+  return representative == nullptr ? orig.reg()
+                                   : representative->value.reg();
 }
 
-// return true if there is a path of length exactly 1 from r1 to r2
-bool AliasedRegisters::has_edge_between(const Value& r1,
-                                        const Value& r2) const {
-  // make sure we have both vertices
-  const auto& search1 = find(r1);
-  const auto& search2 = find(r2);
-  const auto& end = boost::vertices(m_graph).second;
-  if (search1 == end || search2 == end) {
-    return false;
+size_t AliasedRegisters::find(const Value& r) const {
+  auto it = std::lower_bound(
+      m_entries.begin(), m_entries.end(), r,
+      [](const Entry& entry, const Value& v) { return entry.value < v; });
+  if (it == m_entries.end() || it->value != r) {
+    return m_entries.size();
   }
-
-  return are_adjacent(*search1, *search2);
+  return it - m_entries.begin();
 }
 
-bool AliasedRegisters::are_adjacent(vertex_t v1, vertex_t v2) const {
-  // and check that they have an edge between them
-  const auto& adj = boost::adjacent_vertices(v1, m_graph);
-  const auto& adj_begin = adj.first;
-  const auto& adj_end = adj.second;
-  const auto& edge_search = std::find(adj_begin, adj_end, v2);
-  return edge_search != adj_end;
+void AliasedRegisters::insert(const Value& r,
+                              uint32_t group,
+                              uint32_t insert_order) {
+  auto it = std::lower_bound(
+      m_entries.begin(), m_entries.end(), r,
+      [](const Entry& entry, const Value& v) { return entry.value < v; });
+  always_assert(it == m_entries.end() || it->value != r);
+  m_entries.insert(it, Entry{r, group, insert_order});
 }
 
-// return a vector of v and all of it's neighbors (in no particular order)
-std::vector<AliasedRegisters::vertex_t> AliasedRegisters::vertices_in_group(
-    vertex_t v) const {
-  std::vector<vertex_t> result;
-  result.push_back(v);
-  const auto& adj = boost::adjacent_vertices(v, m_graph);
-  const auto& adj_begin = adj.first;
-  const auto& adj_end = adj.second;
-  for (auto it = adj_begin; it != adj_end; ++it) {
-    result.push_back(*it);
+std::vector<Value> AliasedRegisters::values_in_group(uint32_t group) const {
+  std::vector<Value> result;
+  for (const auto& entry : m_entries) {
+    if (entry.group == group) {
+      result.push_back(entry.value);
+    }
   }
   return result;
 }
 
-// return true if v has any neighboring vertices
-bool AliasedRegisters::has_neighbors(vertex_t v) {
-  const auto& adj = boost::adjacent_vertices(v, m_graph);
-  const auto& begin = adj.first;
-  const auto& end = adj.second;
-  return begin != end;
+uint32_t AliasedRegisters::insert_order_of(const Value& r) const {
+  auto idx = find(r);
+  always_assert(idx != m_entries.size());
+  return m_entries[idx].insert_order;
 }
 
 // ---- extends AbstractValue ----
 
 void AliasedRegisters::clear() {
-  m_graph.clear();
-  m_insert_order.clear();
+  m_entries.clear();
+  m_next_group = 0;
 }
 
 AbstractValueKind AliasedRegisters::kind() const {
-  return (boost::num_edges(m_graph) > 0) ? AbstractValueKind::Value
-                                         : AbstractValueKind::Top;
+  return m_entries.empty() ? AbstractValueKind::Top : AbstractValueKind::Value;
 }
 
 // The lattice looks like this:
 //
-//             T (graphs with no edges)
-//      graphs with 1 edge                  ^  join moves up (edge intersection)
-//      graphs with 2 edges                 |
-//            ...                           v  meet moves down (edge union)
-//      graphs with n edges
+//             T (no aliases)
+//      1 pair of aliases                   ^  join moves up (intersection)
+//      2 pairs of aliases                  |
+//            ...                           v  meet moves down (union)
+//      n pairs of aliases
 //            ...
 //            _|_
 //
-// So, leq is the superset relation on the edge set
+// So, leq is the superset relation on the pairs of aliases: every group of
+// `other` has to be within a group of this.
 bool AliasedRegisters::leq(const AliasedRegisters& other) const {
-  if (boost::num_edges(m_graph) < boost::num_edges(other.m_graph)) {
-    // this cannot be a superset of other if this has fewer edges
+  if (m_entries.size() < other.m_entries.size()) {
+    // this cannot be a superset of other if it aliases fewer values
     return false;
   }
 
-  // for all edges in other (the potential subset), make sure this contains that
-  // edge.
-  const auto& iters = boost::edges(other.m_graph);
-  const auto& begin = iters.first;
-  const auto& end = iters.second;
-  for (auto it = begin; it != end; ++it) {
-    const Value& r1 = other.m_graph[boost::source(*it, other.m_graph)];
-    const Value& r2 = other.m_graph[boost::target(*it, other.m_graph)];
-    if (!has_edge_between(r1, r2)) {
+  std::unordered_map<uint32_t, uint32_t> groups;
+  for (const auto& entry : other.m_entries) {
+    auto idx = find(entry.value);
+    if (idx == m_entries.size()) {
+      return false;
+    }
+    auto it = groups.emplace(entry.group, m_entries[idx].group).first;
+    if (it->second != m_entries[idx].group) {
       return false;
     }
   }
   return true;
 }
 
-// returns true iff they have exactly the same edges between the same Values
+// returns true iff they have exactly the same alias groups
 bool AliasedRegisters::equals(const AliasedRegisters& other) const {
-  return boost::num_edges(m_graph) == boost::num_edges(other.m_graph) &&
-         leq(other);
+  return m_entries.size() == other.m_entries.size() && leq(other) &&
+         other.leq(*this);
 }
 
 AbstractValueKind AliasedRegisters::narrow_with(
@@ -324,15 +245,11 @@ AbstractValueKind AliasedRegisters::widen_with(
 // alias group union
 AbstractValueKind AliasedRegisters::meet_with(
     const AliasedRegisters& other) {
-
-  const auto& iters = boost::edges(other.m_graph);
-  const auto& begin = iters.first;
-  const auto& end = iters.second;
-  for (auto it = begin; it != end; ++it) {
-    const Value& r1 = other.m_graph[boost::source(*it, other.m_graph)];
-    const Value& r2 = other.m_graph[boost::target(*it, other.m_graph)];
-    if (!this->are_aliases(r1, r2)) {
-      this->merge_groups_of(r1, r2, other);
+  for (const auto& group : other.all_groups()) {
+    for (size_t i = 1; i < group.size(); ++i) {
+      if (!this->are_aliases(group[0], group[i])) {
+        this->merge_groups_of(group[0], group[i], other);
+      }
     }
   }
   return AbstractValueKind::Value;
@@ -341,116 +258,115 @@ AbstractValueKind AliasedRegisters::meet_with(
 void AliasedRegisters::merge_groups_of(const Value& r1,
                                        const Value& r2,
                                        const AliasedRegisters& other) {
-  vertex_t v1 = find_or_create(r1);
-  vertex_t v2 = find_or_create(r2);
-
-  const auto& group1 = vertices_in_group(v1);
-  const auto& group2 = vertices_in_group(v2);
-  std::vector<vertex_t> union_group;
+  auto group_of = [this](const Value& r) -> std::vector<Value> {
+    auto idx = find(r);
+    if (idx == m_entries.size()) {
+      // Store it on its own for now, so that it can be renumbered.
+      insert(r, m_next_group++, 0);
+      return {r};
+    }
+    return values_in_group(m_entries[idx].group);
+  };
+  const auto& group1 = group_of(r1);
+  const auto& group2 = group_of(r2);
+  std::vector<Value> union_group;
   union_group.reserve(group1.size() + group2.size());
-  union_group.insert(union_group.begin(), group1.begin(), group1.end());
-  union_group.insert(union_group.begin(), group2.begin(), group2.end());
+  union_group.insert(union_group.end(), group1.begin(), group1.end());
+  union_group.insert(union_group.end(), group2.begin(), group2.end());
 
   handle_insert_order_at_merge(union_group, other);
-  for (vertex_t g1 : group1) {
-    for (vertex_t g2 : group2) {
-      boost::add_edge(g1, g2, m_graph);
-    }
+  auto group_id = m_entries[find(r1)].group;
+  for (const auto& r : group2) {
+    m_entries[find(r)].group = group_id;
   }
 }
 
-// edge intersection
+// alias group intersection
 AbstractValueKind AliasedRegisters::join_with(
     const AliasedRegisters& other) {
-
-  // fill `deletes` with edges that aren't in `other`
-  std::vector<std::pair<vertex_t, vertex_t>> deletes;
-  const auto& iters = boost::edges(this->m_graph);
-  const auto& begin = iters.first;
-  const auto& end = iters.second;
-  for (auto it = begin; it != end; ++it) {
-    vertex_t v1 = boost::source(*it, this->m_graph);
-    vertex_t v2 = boost::target(*it, this->m_graph);
-    const Value& r1 = this->m_graph[v1];
-    const Value& r2 = this->m_graph[v2];
-    if (!other.has_edge_between(r1, r2)) {
-      deletes.emplace_back(v1, v2);
+  // Two values stay aliases if they are in the same group in both. Values
+  // that `other` doesn't alias drop out, and so do the values that end up
+  // alone in their group.
+  std::unordered_map<uint64_t, uint32_t> group_ids;
+  std::vector<Entry> entries;
+  for (const auto& entry : m_entries) {
+    auto idx = other.find(entry.value);
+    if (idx == other.m_entries.size()) {
+      continue;
     }
+    uint64_t key = (uint64_t(entry.group) << 32) | other.m_entries[idx].group;
+    auto it = group_ids.emplace(key, group_ids.size()).first;
+    entries.push_back(Entry{entry.value, it->second, entry.insert_order});
   }
-
-  // This maintains a forest of cliques because any subset of nodes of a clique
-  // is also a clique
-  for (const auto& edge : deletes) {
-    boost::remove_edge(edge.first, edge.second, this->m_graph);
+  std::vector<std::vector<Value>> groups(group_ids.size());
+  for (const auto& entry : entries) {
+    groups[entry.group].push_back(entry.value);
   }
-
-  handle_edge_intersection_insert_order(other);
-  return AbstractValueKind::Value;
-}
-
-void AliasedRegisters::handle_edge_intersection_insert_order(
-    const AliasedRegisters& other) {
-  // Clear out stale values in m_insert_order for vertices removed from cliques.
-  const auto& iters = boost::vertices(this->m_graph);
-  const auto& begin = iters.first;
-  const auto& end = iters.second;
-  for (auto it = begin; it != end; ++it) {
-    if (!has_neighbors(*it)) {
-      clear_insert_number(*it);
+  m_entries.clear();
+  for (const auto& entry : entries) {
+    if (groups[entry.group].size() > 1) {
+      m_entries.push_back(entry);
     }
   }
-
-  // Assign new insertion numbers while taking into account both insertion maps.
-  for (auto& group : all_groups()) {
-    handle_insert_order_at_merge(group, other);
+  m_next_group = group_ids.size();
+
+  // Assign new insertion numbers while taking into account both orders. The
+  // values of a group are aliases in both, so the orders are compared as in
+  // handle_insert_order_at_merge.
+  for (const auto& group : groups) {
+    if (group.size() > 1) {
+      renumber_insert_order(group, [this, &other](const Value& a,
+                                                  const Value& b) {
+        bool this_less_than = insert_order_of(a) < insert_order_of(b);
+        bool other_less_than =
+            other.insert_order_of(a) < other.insert_order_of(b);
+        if (this_less_than == other_less_than) {
+          return this_less_than;
+        } else {
+          return a.reg() < b.reg();
+        }
+      });
+    }
   }
+  return AbstractValueKind::Value;
 }
 
-// Merge the ordering in other.m_insert_order into this->m_insert_order.
+// Merge the ordering of other's insertion numbers into this one's.
 //
-// When both graphs know about an edge (and they don't agree about insertion
-// order), use register number.
-// When only one graph knows about an edge, use insertion order from that graph.
-// When neither graph knows about the edge, use register number.
+// When both know that two values are aliases (and they don't agree about
+// insertion order), use register number.
+// When only one knows about it, use insertion order from that one.
+// When neither knows about it, use register number.
 // This function can be used (carefully) for both union and intersection.
 void AliasedRegisters::handle_insert_order_at_merge(
-    const std::vector<vertex_t>& group, const AliasedRegisters& other) {
-  renumber_insert_order(group, [this, &other](vertex_t a, vertex_t b) {
+    const std::vector<Value>& group, const AliasedRegisters& other) {
+  renumber_insert_order(group, [this, &other](const Value& a, const Value& b) {
     // return true if a occurs before b.
     // return false if they compare equal or if b occurs before a.
-
-    // `a` and `b` only index into this, not other.
-    const Value& val_a = this->m_graph[a];
-    const Value& val_b = this->m_graph[b];
-    auto other_a = other.find(val_a);
-    auto other_b = other.find(val_b);
-
-    bool this_has_edge = this->are_adjacent(a, b);
-    bool other_has_edge = other.are_aliases(val_a, val_b);
+    bool this_has_edge = a != b && this->are_aliases(a, b);
+    bool other_has_edge = a != b && other.are_aliases(a, b);
 
     if (this_has_edge && other_has_edge) {
-      // Intersection case should always come here
       bool this_less_than =
-          this->m_insert_order.at(a) < this->m_insert_order.at(b);
+          this->insert_order_of(a) < this->insert_order_of(b);
 
       bool other_less_than =
-          other.m_insert_order.at(*other_a) < other.m_insert_order.at(*other_b);
+          other.insert_order_of(a) < other.insert_order_of(b);
 
       if (this_less_than == other_less_than) {
-        // The graphs agree on the order of these two vertices.
+        // They agree on the order of these two values.
         // Preserve that order.
         return this_less_than;
       } else {
-        // The graphs do not agree. Choose a deterministic order
-        return val_a.reg() < val_b.reg();
+        // They do not agree. Choose a deterministic order
+        return a.reg() < b.reg();
       }
     } else if (this_has_edge) {
-      return this->m_insert_order.at(a) < this->m_insert_order.at(b);
+      return this->insert_order_of(a) < this->insert_order_of(b);
     } else if (other_has_edge) {
-      return other.m_insert_order.at(*other_a) <
-             other.m_insert_order.at(*other_b);
+      return other.insert_order_of(a) < other.insert_order_of(b);
     } else {
-      return val_a.reg() < val_b.reg();
+      return a.reg() < b.reg();
     }
   });
 }
@@ -458,44 +374,35 @@ void AliasedRegisters::handle_insert_order_at_merge(
 // Rewrite the insertion number of all registers in `group` in an order defined
 // by less_than
 void AliasedRegisters::renumber_insert_order(
-    std::vector<vertex_t> group,
-    const std::function<bool(vertex_t, vertex_t)>& less_than) {
+    std::vector<Value> group,
+    const std::function<bool(const Value&, const Value&)>& less_than) {
 
   // Filter out non registers.
-  group.erase(
-      std::remove_if(group.begin(),
-                     group.end(),
-                     [this](vertex_t v) { return !m_graph[v].is_register(); }),
-      group.end());
+  group.erase(std::remove_if(group.begin(),
+                             group.end(),
+                             [](const Value& v) { return !v.is_register(); }),
+              group.end());
 
-  // Assign new insertion numbers based on sorting.
+  // Assign new insertion numbers based on sorting. The comparisons are all
+  // done before the first insertion number changes.
   std::sort(group.begin(), group.end(), less_than);
-  size_t i = 0;
-  for (vertex_t v : group) {
-    this->m_insert_order[v] = i;
+  uint32_t i = 0;
+  for (const auto& v : group) {
+    m_entries[find(v)].insert_order = i;
     ++i;
   }
 }
 
-// return all groups (not including singletons)
-std::vector<std::vector<AliasedRegisters::vertex_t>>
-AliasedRegisters::all_groups() {
-  std::vector<std::vector<vertex_t>> result;
-  std::unordered_set<vertex_t> visited;
-
-  const auto& iters = boost::vertices(this->m_graph);
-  const auto& begin = iters.first;
-  const auto& end = iters.second;
-  for (auto it = begin; it != end; ++it) {
-    if (visited.count(*it) == 0) {
-      const auto& group = vertices_in_group(*it);
-      for (vertex_t v : group) {
-        visited.insert(v);
-      }
-      if (group.size() > 1) {
-        result.emplace_back(std::move(group));
-      }
+// return all groups, in the order of their smallest value
+std::vector<std::vector<Value>> AliasedRegisters::all_groups() const {
+  std::vector<std::vector<Value>> result;
+  std::unordered_map<uint32_t, size_t> indices;
+  for (const auto& entry : m_entries) {
+    auto it = indices.emplace(entry.group, result.size()).first;
+    if (it->second == result.size()) {
+      result.emplace_back();
     }
+    result[it->second].push_back(entry.value);
   }
   return result;
 }
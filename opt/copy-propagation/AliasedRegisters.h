@@ -7,17 +7,10 @@
 
 #pragma once
 
-#ifdef __GNUC__
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wshadow"
-#endif
-#include <boost/graph/adjacency_list.hpp>
-#ifdef __GNUC__
-#pragma GCC diagnostic pop
-#endif
 #include <boost/optional.hpp>
-#include <boost/range/iterator_range.hpp>
+#include <functional>
 #include <limits>
+#include <vector>
 
 #include "AbstractDomain.h"
 #include "DexClass.h"
@@ -125,6 +118,30 @@ class Value {
 
   bool operator!=(const Value& other) const { return !(*this == other); }
 
+  // A total order that doesn't depend on addresses, for keeping values sorted.
+  bool operator<(const Value& other) const {
+    if (m_kind != other.m_kind) {
+      return m_kind < other.m_kind;
+    }
+
+    switch (m_kind) {
+    case Kind::REGISTER:
+      return m_reg < other.m_reg;
+    case Kind::CONST_LITERAL:
+    case Kind::CONST_LITERAL_UPPER:
+      return m_literal < other.m_literal;
+    case Kind::CONST_STRING:
+      return compare_dexstrings(m_str, other.m_str);
+    case Kind::CONST_TYPE:
+      return compare_dextypes(m_type, other.m_type);
+    case Kind::STATIC_FINAL:
+    case Kind::STATIC_FINAL_UPPER:
+      return compare_dexfields(m_field, other.m_field);
+    case Kind::NONE:
+      return false;
+    }
+  }
+
   static const Value& none() {
     static const Value s_none;
     return s_none;
@@ -179,63 +196,51 @@ class AliasedRegisters final : public sparta::AbstractValue<AliasedRegisters> {
   sparta::AbstractValueKind narrow_with(const AliasedRegisters& other) override;
 
  private:
-  // An undirected graph where register values are vertices
-  // and an edge means they are aliased.
-  // Using a set for the edge container makes sure we can't have parallel edges
-  using Graph = boost::adjacency_list<boost::setS, // out edge container
-                                      boost::vecS, // vertex container
-                                      boost::undirectedS, // undirected graph
-                                      Value>; // node property
-  using vertex_t = boost::graph_traits<Graph>::vertex_descriptor;
-  Graph m_graph;
-
-  // For keeping track of the oldest representative.
-  //
-  // When adding a vertex to a group, it gets 1 + the max insertion number of
-  // the group. When choosing a representative, we prefer lower insertion
-  // numbers. Vertices in a group are guaranteed to have an entry in this map.
-  // Do not query this map if the vertex is not in a group.
-  //
-  // We only track the insertion for registers because they're the only type
-  // that could be chosen as a representative.
-  using InsertionOrder = std::unordered_map<vertex_t, size_t>;
-  InsertionOrder m_insert_order;
-
-  const boost::range_detail::integer_iterator<vertex_t> find(
-      const Value& r) const;
-
-  vertex_t find_or_create(const Value& r);
-
-  bool has_edge_between(const Value& r1, const Value& r2) const;
-  bool are_adjacent(vertex_t v1, vertex_t v2) const;
-
-  // return a vector of all vertices in v's alias group (including v itself)
-  std::vector<vertex_t> vertices_in_group(vertex_t v) const;
+  // A value that is aliased to at least one other value. Values that aren't
+  // aliased to anything are not stored, so every alias group has at least two
+  // members.
+  struct Entry {
+    Value value;
+    // The ID of the alias group.
+    uint32_t group;
+    // For keeping track of the oldest representative.
+    //
+    // When adding a register to a group, it gets 1 + the max insertion number
+    // of the group. When choosing a representative, we prefer lower insertion
+    // numbers. We only track the insertion for registers because they're the
+    // only type that could be chosen as a representative; other values keep 0.
+    uint32_t insert_order;
+  };
+
+  // Sorted by value, so that lookups are binary searches and copies are a
+  // single allocation.
+  std::vector<Entry> m_entries;
+  uint32_t m_next_group{0};
+
+  // The index of the entry of `r`, or m_entries.size() if `r` isn't aliased.
+  size_t find(const Value& r) const;
+
+  void insert(const Value& r, uint32_t group, uint32_t insert_order);
+
+  // return the values in the given group
+  std::vector<Value> values_in_group(uint32_t group) const;
+
+  uint32_t insert_order_of(const Value& r) const;
 
   // merge r1's group with r2. This operation is symmetric
   void merge_groups_of(const Value& r1,
                        const Value& r2,
                        const AliasedRegisters& other);
 
-  // return all groups (not including singletons)
-  std::vector<std::vector<vertex_t>> all_groups();
-
-  void track_insert_order(const Value& moving,
-                          vertex_t v_moving,
-                          const Value& group,
-                          vertex_t v_group,
-                          const std::vector<vertex_t>& grp);
-  void clear_insert_number(vertex_t v);
-  void handle_edge_intersection_insert_order(const AliasedRegisters& other);
-  void handle_insert_order_at_merge(const std::vector<vertex_t>& group,
+  // return all groups
+  std::vector<std::vector<Value>> all_groups() const;
+
+  void handle_insert_order_at_merge(const std::vector<Value>& group,
                                     const AliasedRegisters& other);
 
   void renumber_insert_order(
-      std::vector<vertex_t> group,
-      const std::function<bool(vertex_t, vertex_t)>& less_than);
-
-  // return true if v has any neighboring vertices
-  bool has_neighbors(vertex_t v);
+      std::vector<Value> group,
+      const std::function<bool(const Value&, const Value&)>& less_than);
 };
 
 class AliasDomain final
@@ -8,10 +8,12 @@
 #include "CopyPropagationPass.h"
 
 #include <boost/optional.hpp>
+#include <mutex>
 
 #include "AliasedRegisters.h"
 #include "ControlFlow.h"
 #include "DexUtil.h"
+#include "IncrementalPassCache.h"
 #include "IRInstruction.h"
 #include "IROpcode.h"
 #include "IRTypeChecker.h"
@@ -75,6 +77,7 @@ class AliasFixpointIterator final
   const CopyPropagationPass::Config& m_config;
   const std::unordered_set<const IRInstruction*>& m_range_set;
   Stats& m_stats;
+  const bool m_editable;
 
   AliasFixpointIterator(
       cfg::ControlFlowGraph& cfg,
@@ -85,7 +88,8 @@ class AliasFixpointIterator final
             cfg, cfg.blocks().size()),
         m_config(config),
         m_range_set(range_set),
-        m_stats(stats) {}
+        m_stats(stats),
+        m_editable(cfg.editable()) {}
 
   // An instruction can be removed if we know the source and destination are
   // aliases.
@@ -118,9 +122,7 @@ class AliasFixpointIterator final
             if (opcode::is_move_result_pseudo(op)) {
               // WARNING: This assumes that the primary instruction of a
               // move-result-pseudo has no side effects.
-              deletes->insert(
-                  ir_list::primary_instruction_of_move_result_pseudo(
-                      it.unwrap()));
+              deletes->insert(primary_instruction_of(block, it));
             } else {
               deletes->insert(insn);
             }
@@ -244,6 +246,17 @@ class AliasFixpointIterator final
 
   // if insn has a destination register (including RESULT), return it.
   //
+  // An editable CFG can put the move-result-pseudo at `it` at the start of a
+  // block, whose only predecessor ends with the primary instruction.
+  IRInstruction* primary_instruction_of(
+      cfg::Block* block, const ir_list::InstructionIterator& it) const {
+    if (m_editable && it.unwrap() == block->get_first_insn()) {
+      always_assert(block->preds().size() == 1);
+      return block->preds()[0]->src()->get_last_insn()->insn;
+    }
+    return ir_list::primary_instruction_of_move_result_pseudo(it.unwrap());
+  }
+
   // ALL destinations must be returned by this method (unlike get_src_value) if
   // we miss a destination register, we'll fail to clobber it and think we know
   // that a register holds a stale value.
@@ -257,11 +270,13 @@ class AliasFixpointIterator final
 
       // It's easier to check the following move-result for the width of the
       // RESULT_REGISTER
+      // When the move-result is in the next block, its width is unknown, so
+      // the upper half is clobbered too, to be safe.
       auto next = std::next(it);
-      if (next != end &&
-          (is_move_result(next->insn->opcode()) ||
-           opcode::is_move_result_pseudo(next->insn->opcode())) &&
-          next->insn->dest_is_wide()) {
+      if (next == end ||
+          ((is_move_result(next->insn->opcode()) ||
+            opcode::is_move_result_pseudo(next->insn->opcode())) &&
+           next->insn->dest_is_wide())) {
         dest.upper = Value::create_register(RESULT_REGISTER + 1);
       }
     } else if (insn->dests_size()) {
@@ -376,90 +391,172 @@ Stats Stats::operator+(const Stats& other) {
                replaced_sources + other.replaced_sources};
 }
 
-Stats CopyPropagation::run(Scope scope) {
+Stats CopyPropagation::run(Scope scope, IncrementalPassCache* cache) {
   using Output = Stats;
   return walk::parallel::reduce_methods<Output>(
       scope,
-      [this](DexMethod* m) {
-        IRCode* code = m->get_code();
-        if (code == nullptr) {
+      [this, cache](DexMethod* m) {
+        if (m->get_code() == nullptr) {
           return Stats();
         }
-
-        const std::string& before_code =
-            m_config.debug ? show(m->get_code()) : "";
-        const auto& result = run(code);
-
-        if (m_config.debug) {
-          // Run the IR type checker
-          IRTypeChecker checker(m);
-          checker.run();
-          if (!checker.good()) {
-            std::string msg = checker.what();
-            TRACE(RME,
-                  1,
-                  "%s: Inconsistency in Dex code. %s\n",
-                  SHOW(m),
-                  msg.c_str());
-            TRACE(RME, 1, "before code:\n%s\n", before_code.c_str());
-            TRACE(RME, 1, "after  code:\n%s\n", SHOW(m->get_code()));
-            always_assert(false);
-          }
-        }
-        return result;
+        return run(m, cache);
       },
       [](Output a, Output b) { return a + b; },
       Output(),
       m_config.debug ? 1 : walk::parallel::default_num_threads());
 }
 
-Stats CopyPropagation::run(IRCode* code) {
+Stats CopyPropagation::run(DexMethod* m, IncrementalPassCache* cache) {
+  IRCode* code = m->get_code();
+  const std::string& before_code = m_config.debug ? show(code) : "";
+  Stats result;
+  if (cache != nullptr) {
+    // Aliasing static final fields depends on the fields.
+    auto stats = cache->run(m, /* summarize_refs */ true, [&] {
+      auto code_stats = run(code);
+      return IncrementalPassCache::Stats{code_stats.moves_eliminated,
+                                         code_stats.replaced_sources};
+    });
+    result = Stats(stats.at(0), stats.at(1));
+  } else {
+    result = run(code);
+  }
+
+  if (m_config.debug) {
+    // Run the IR type checker
+    IRTypeChecker checker(m);
+    checker.run();
+    if (!checker.good()) {
+      std::string msg = checker.what();
+      TRACE(RME,
+            1,
+            "%s: Inconsistency in Dex code. %s\n",
+            SHOW(m),
+            msg.c_str());
+      TRACE(RME, 1, "before code:\n%s\n", before_code.c_str());
+      TRACE(RME, 1, "after  code:\n%s\n", SHOW(m->get_code()));
+      always_assert(false);
+    }
+  }
+  return result;
+}
+
+namespace {
+
+// Returns the instructions of `cfg` that only write the value that their
+// destination already holds.
+std::unordered_set<IRInstruction*> find_redundant_writes(
+    cfg::ControlFlowGraph& cfg,
+    const CopyPropagationPass::Config& config,
+    Stats* stats) {
   // XXX HACK! Since this pass runs after RegAlloc, we need to avoid remapping
   // registers that belong to /range instructions. The easiest way to find out
   // which instructions are in this category is by temporarily denormalizing
   // the registers.
   std::unordered_set<const IRInstruction*> range_set;
-  for (auto& mie : InstructionIterable(code)) {
-    auto* insn = mie.insn;
-    if (opcode::has_range_form(insn->opcode())) {
-      insn->denormalize_registers();
-      if (needs_range_conversion(insn)) {
-        range_set.emplace(insn);
+  for (auto* block : cfg.blocks()) {
+    for (auto& mie : InstructionIterable(block)) {
+      auto* insn = mie.insn;
+      if (opcode::has_range_form(insn->opcode())) {
+        insn->denormalize_registers();
+        if (needs_range_conversion(insn)) {
+          range_set.emplace(insn);
+        }
+        insn->normalize_registers();
       }
-      insn->normalize_registers();
     }
   }
 
   std::unordered_set<IRInstruction*> deletes;
-  Stats stats;
-
-  code->build_cfg(/* editable */ false);
-  const auto& blocks = code->cfg().blocks();
-
-  AliasFixpointIterator fixpoint(code->cfg(), m_config, range_set, stats);
-
+  AliasFixpointIterator fixpoint(cfg, config, range_set, *stats);
   fixpoint.run(AliasDomain());
-  for (auto block : blocks) {
+  for (auto block : cfg.blocks()) {
     AliasDomain domain = fixpoint.get_entry_state_at(block);
     domain.update([&fixpoint, block, &deletes](AliasedRegisters& aliases) {
       fixpoint.run_on_block(block, aliases, &deletes);
     });
   }
+  stats->moves_eliminated += deletes.size();
+  return deletes;
+}
+
+} // namespace
 
-  stats.moves_eliminated += deletes.size();
-  for (auto insn : deletes) {
+Stats CopyPropagation::run(IRCode* code) {
+  Stats stats;
+  code->build_cfg(/* editable */ false);
+  for (auto insn : find_redundant_writes(code->cfg(), m_config, &stats)) {
     code->remove_opcode(insn);
   }
   return stats;
 }
 
+Stats CopyPropagation::run(cfg::ControlFlowGraph& cfg) {
+  always_assert(cfg.editable());
+  Stats stats;
+  auto deletes = find_redundant_writes(cfg, m_config, &stats);
+  // Removing a primary instruction also removes its move-result-pseudo, which
+  // is never in `deletes` itself, so the other iterators stay valid.
+  std::vector<cfg::InstructionIterator> to_remove;
+  auto iterable = cfg::InstructionIterable(cfg);
+  for (auto it = iterable.begin(); it != iterable.end(); ++it) {
+    if (deletes.count(it->insn)) {
+      to_remove.push_back(it);
+    }
+  }
+  for (const auto& it : to_remove) {
+    cfg.remove_opcode(it);
+  }
+  return stats;
+}
+
 } // namespace copy_propagation_impl
 
-void CopyPropagationPass::run_pass(DexStoresVector& stores,
-                                   ConfigFiles& /* unused */,
-                                   PassManager& mgr) {
-  auto scope = build_class_scope(stores);
+namespace {
+
+class CopyPropagationRunner : public Pass::MethodRunner {
+ public:
+  CopyPropagationRunner(ConfigFiles& cfg,
+                        PassManager& mgr,
+                        const CopyPropagationPass::Config& config)
+      : m_impl(config),
+        m_cache(cfg,
+                mgr,
+                std::to_string(config.eliminate_const_literals) +
+                    std::to_string(config.regalloc_has_run)) {}
+
+  void run(DexMethod* m) override {
+    auto stats = m_impl.run(m, &m_cache);
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+    m_stats = m_stats + stats;
+  }
 
+  void finish(PassManager& mgr) override {
+    m_cache.finish(mgr);
+    mgr.incr_metric("redundant_moves_eliminated", m_stats.moves_eliminated);
+    mgr.incr_metric("source_regs_replaced_with_representative",
+                    m_stats.replaced_sources);
+    TRACE(RME,
+          1,
+          "%d redundant moves eliminated\n",
+          mgr.get_metric("redundant_moves_eliminated"));
+    TRACE(RME,
+          1,
+          "%d source registers replaced with representative\n",
+          mgr.get_metric("source_regs_replaced_with_representative"));
+  }
+
+ private:
+  copy_propagation_impl::CopyPropagation m_impl;
+  IncrementalPassCache m_cache;
+  std::mutex m_stats_mutex;
+  copy_propagation_impl::Stats m_stats;
+};
+
+} // namespace
+
+std::unique_ptr<Pass::MethodRunner> CopyPropagationPass::method_runner(
+    DexStoresVector&, ConfigFiles& cfg, PassManager& mgr) {
   if (m_config.eliminate_const_literals &&
       !mgr.get_redex_options().verify_none_enabled) {
     // This option is not safe with the verifier
@@ -470,20 +567,19 @@ void CopyPropagationPass::run_pass(DexStoresVector& stores,
           "enabled.\n");
   }
   m_config.regalloc_has_run = mgr.regalloc_has_run();
+  return std::make_unique<CopyPropagationRunner>(cfg, mgr, m_config);
+}
 
-  CopyPropagation impl(m_config);
-  auto stats = impl.run(scope);
-  mgr.incr_metric("redundant_moves_eliminated", stats.moves_eliminated);
-  mgr.incr_metric("source_regs_replaced_with_representative",
-                  stats.replaced_sources);
-  TRACE(RME,
-        1,
-        "%d redundant moves eliminated\n",
-        mgr.get_metric("redundant_moves_eliminated"));
-  TRACE(RME,
-        1,
-        "%d source registers replaced with representative\n",
-        mgr.get_metric("source_regs_replaced_with_representative"));
+void CopyPropagationPass::run_pass(DexStoresVector& stores,
+                                   ConfigFiles& cfg,
+                                   PassManager& mgr) {
+  auto runner = method_runner(stores, cfg, mgr);
+  walk::parallel::code(build_class_scope(stores),
+                       [&](DexMethod* m, IRCode&) { runner->run(m); },
+                       m_config.debug ? 1
+                                      : walk::parallel::default_num_threads(),
+                       walk::parallel::Split::LARGE_CLASSES);
+  runner->finish(mgr);
 }
 
 static CopyPropagationPass s_pass;
@@ -9,12 +9,24 @@
 
 #include "Pass.h"
 
+class IncrementalPassCache;
+
 class CopyPropagationPass : public Pass {
  public:
   CopyPropagationPass() : Pass("CopyPropagationPass") {}
 
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
+  std::unique_ptr<MethodRunner> method_runner(DexStoresVector&,
+                                              ConfigFiles&,
+                                              PassManager&) override;
+
+  bool is_method_local() const override { return true; }
+
+  analysis::Set preserved_analyses() const override {
+    return analysis::CODE_AGNOSTIC;
+  }
+
   virtual void configure_pass(const JsonWrapper& jw) override {
 
     // This option can only be safely enabled in verify-none. `run_pass` will
@@ -76,10 +88,18 @@ class CopyPropagation final {
   explicit CopyPropagation(const CopyPropagationPass::Config& config)
       : m_config(config) {}
 
-  Stats run(Scope scope);
+  // With a `cache`, the methods that it has the result for are not run.
+  Stats run(Scope scope, IncrementalPassCache* cache = nullptr);
+
+  // Runs on the code of `method`, which must have code. In debug mode, the
+  // code is type checked afterwards.
+  Stats run(DexMethod* method, IncrementalPassCache* cache = nullptr);
 
   Stats run(IRCode*);
 
+  // Runs on an editable CFG, which is left in place for the next steps.
+  Stats run(cfg::ControlFlowGraph& cfg);
+
  private:
   const CopyPropagationPass::Config& m_config;
 };
@@ -7,6 +7,8 @@
 
 #include "DeadCodeEliminationPass.h"
 
+#include <atomic>
+#include <cstdio>
 #include <functional>
 
 #include "ConcurrentContainers.h"
@@ -104,7 +106,7 @@ class CallGraphStrategy final : public call_graph::BuildStrategy {
 
   const Scope& m_scope;
   std::unordered_set<const DexMethod*> m_non_overridden_virtuals;
-  mutable MethodRefCache m_resolved_refs;
+  mutable ConcurrentMethodRefCache m_resolved_refs;
 };
 
 static side_effects::InvokeToSummaryMap build_summary_map(
@@ -145,17 +147,52 @@ void DeadCodeEliminationPass::run_pass(DexStoresVector& stores,
   }
   ptrs::SummaryCMap escape_summaries_cmap(escape_summaries.begin(),
                                           escape_summaries.end());
-  auto ptrs_fp_iter_map =
-      ptrs::analyze_scope(scope, call_graph, &escape_summaries_cmap);
+  auto ptrs_fp_iter_map = ptrs::analyze_scope(
+      scope, call_graph, &escape_summaries_cmap, m_analysis_budget);
 
   side_effects::SummaryMap effect_summaries;
   if (m_external_side_effect_summaries_file) {
     std::ifstream file_input(*m_external_side_effect_summaries_file);
     summary_serialization::read(file_input, &effect_summaries);
   }
+  if (m_side_effect_summaries_cache_file) {
+    // The summaries of methods whose code didn't change since they were
+    // cached need not be computed again. The escape analysis still runs on
+    // all of them, since its results are needed below.
+    size_t cached;
+    if (m_binary_side_effect_summaries_cache) {
+      cached = summary_serialization::read_binary_cache(
+          *m_side_effect_summaries_cache_file, scope, call_graph,
+          &effect_summaries);
+    } else {
+      std::ifstream cache_input(*m_side_effect_summaries_cache_file);
+      cached = summary_serialization::read_cache(cache_input, call_graph,
+                                                 &effect_summaries);
+    }
+    mgr.set_metric("cached_side_effect_summaries", cached);
+  }
   side_effects::analyze_scope(scope, call_graph, *ptrs_fp_iter_map,
                               &effect_summaries);
+  if (m_side_effect_summaries_cache_file) {
+    if (m_binary_side_effect_summaries_cache) {
+      // Write to a temporary file first, so that an interrupted run doesn't
+      // leave a truncated cache behind.
+      auto tmp_file = *m_side_effect_summaries_cache_file + ".tmp";
+      {
+        std::ofstream cache_output(tmp_file, std::ios::binary);
+        summary_serialization::print_binary_cache(
+            cache_output, effect_summaries, call_graph);
+      }
+      std::rename(tmp_file.c_str(),
+                  m_side_effect_summaries_cache_file->c_str());
+    } else {
+      std::ofstream cache_output(*m_side_effect_summaries_cache_file);
+      summary_serialization::print_cache(cache_output, effect_summaries,
+                                         call_graph);
+    }
+  }
 
+  std::atomic<size_t> methods_over_budget{0};
   auto removed = walk::parallel::reduce_methods<size_t>(
       scope,
       [&](DexMethod* method) -> size_t {
@@ -167,11 +204,24 @@ void DeadCodeEliminationPass::run_pass(DexStoresVector& stores,
           return 0;
         }
 
+        auto over_budget = [&]() -> size_t {
+          TRACE(DEAD_CODE, 2, "Over the analysis budget: %s\n", SHOW(method));
+          ++methods_over_budget;
+          return 0;
+        };
+        const auto& ptrs_fp_iter = *ptrs_fp_iter_map->find(method)->second;
+        if (ptrs_fp_iter.budget_exceeded()) {
+          return over_budget();
+        }
         uv::FixpointIterator used_vars_fp_iter(
-            *ptrs_fp_iter_map->find(method)->second,
+            ptrs_fp_iter,
             build_summary_map(effect_summaries, call_graph, method),
             code->cfg());
+        used_vars_fp_iter.set_budget(m_analysis_budget);
         used_vars_fp_iter.run(uv::UsedVarsSet());
+        if (used_vars_fp_iter.budget_exceeded()) {
+          return over_budget();
+        }
 
         TRACE(DEAD_CODE, 5, "Transforming %s\n", SHOW(method));
         TRACE(DEAD_CODE, 5, "Before:\n%s\n", SHOW(code->cfg()));
@@ -190,6 +240,7 @@ void DeadCodeEliminationPass::run_pass(DexStoresVector& stores,
       },
       std::plus<size_t>());
   mgr.set_metric("removed_instructions", removed);
+  mgr.set_metric("methods_over_analysis_budget", methods_over_budget);
 }
 
 static DeadCodeEliminationPass s_pass;
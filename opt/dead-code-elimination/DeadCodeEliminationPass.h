@@ -8,6 +8,7 @@
 #pragma once
 
 #include <boost/optional.hpp>
+#include <limits>
 
 #include "CallGraph.h"
 #include "LocalPointersAnalysis.h"
@@ -29,6 +30,18 @@ class DeadCodeEliminationPass final : public Pass {
     if (s != "") {
       m_external_escape_summaries_file = s;
     }
+    jw.get("side_effect_summaries_cache", "", s);
+    if (s != "") {
+      m_side_effect_summaries_cache_file = s;
+    }
+    jw.get("binary_side_effect_summaries_cache", false,
+           m_binary_side_effect_summaries_cache);
+    int64_t analysis_budget;
+    jw.get("analysis_budget", 0, analysis_budget);
+    always_assert(analysis_budget >= 0);
+    if (analysis_budget > 0) {
+      m_analysis_budget = static_cast<size_t>(analysis_budget);
+    }
   }
 
   void eval_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
@@ -38,5 +51,13 @@ class DeadCodeEliminationPass final : public Pass {
  private:
   boost::optional<std::string> m_external_side_effect_summaries_file;
   boost::optional<std::string> m_external_escape_summaries_file;
+  // Read before the analysis if it exists, and rewritten after it.
+  boost::optional<std::string> m_side_effect_summaries_cache_file;
+  // Whether that cache is in the binary format rather than in s-expressions.
+  bool m_binary_side_effect_summaries_cache{false};
+  // Each of the analyses of a method gives up after analyzing this many
+  // blocks, counting each visit of a loop block. The escape analysis then
+  // assumes that everything escapes, and the method is left as is.
+  size_t m_analysis_budget{std::numeric_limits<size_t>::max()};
   std::unordered_set<DexMethod*> m_do_not_optimize_methods;
 };
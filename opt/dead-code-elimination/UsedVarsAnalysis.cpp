@@ -74,7 +74,7 @@ std::vector<uint16_t> pointer_registers(const IRInstruction* insn) {
       regs.emplace_back(insn->src(idx++));
     }
     auto callee = insn->get_method();
-    auto arg_types = callee->get_proto()->get_args()->get_type_list();
+    const auto& arg_types = callee->get_proto()->get_args()->get_type_list();
     for (DexType* arg_type : arg_types) {
       if (!is_primitive(arg_type)) {
         regs.emplace_back(insn->src(idx));
@@ -8,6 +8,7 @@
 #include "DedupBlocksPass.h"
 
 #include <atomic>
+#include <boost/functional/hash.hpp>
 #include <boost/optional.hpp>
 #include <iterator>
 #include <mutex>
@@ -95,20 +96,46 @@ static bool same_successors(const cfg::Block* b1, const cfg::Block* b2) {
   return true;
 }
 
+// Hashes the successor edges the way same_successors compares them, that is
+// regardless of their order.
+static hash_t succs_hash(const cfg::Block* b) {
+  hash_t result = 0;
+  for (const cfg::Edge* succ : b->succs()) {
+    hash_t edge_hash = succ->target()->id();
+    boost::hash_combine(edge_hash, static_cast<int>(succ->type()));
+    result += edge_hash;
+  }
+  return result;
+}
+
+// A fingerprint of the code and the successors of a block. Unlike a xor of the
+// instruction hashes, it depends on the order of the instructions, and
+// repeated instructions don't cancel out.
+static hash_t fingerprint(cfg::Block* b) {
+  hash_t result = succs_hash(b);
+  for (auto& mie : InstructionIterable(b)) {
+    boost::hash_combine(result, mie.insn->hash());
+  }
+  return result;
+}
+
+// The fingerprints of the blocks of a cfg, computed once per block, so that
+// the structural comparisons only run when two fingerprints collide.
+using Fingerprints = std::unordered_map<cfg::Block*, hash_t>;
+
 struct BlockEquals {
+  const Fingerprints* fingerprints;
+
   bool operator()(cfg::Block* b1, cfg::Block* b2) const {
-    return same_successors(b1, b2) && b1->same_try(b2) && same_code(b1, b2);
+    return fingerprints->at(b1) == fingerprints->at(b2) &&
+           same_successors(b1, b2) && b1->same_try(b2) && same_code(b1, b2);
   }
 };
 
 struct BlockHasher {
-  hash_t operator()(cfg::Block* b) const {
-    hash_t result = 0;
-    for (auto& mie : InstructionIterable(b)) {
-      result ^= mie.insn->hash();
-    }
-    return result;
-  }
+  const Fingerprints* fingerprints;
+
+  hash_t operator()(cfg::Block* b) const { return fingerprints->at(b); }
 };
 
 struct BlockCompare {
@@ -118,13 +145,7 @@ struct BlockCompare {
 };
 
 struct BlockSuccHasher {
-  hash_t operator()(cfg::Block* b) const {
-    hash_t result = 0;
-    for (const auto& succ : b->succs()) {
-      result ^= succ->target()->id();
-    }
-    return result;
-  }
+  hash_t operator()(cfg::Block* b) const { return succs_hash(b); }
 };
 
 struct BlockSuccCompare {
@@ -150,7 +171,8 @@ class DedupBlocksImpl {
 
   // Dedup blocks that are exactly the same
   void dedup(cfg::ControlFlowGraph& cfg) {
-    Duplicates dups = collect_duplicates(cfg);
+    Fingerprints fingerprints;
+    Duplicates dups = collect_duplicates(cfg, &fingerprints);
     if (dups.size() > 0) {
       record_stats(dups);
       deduplicate(dups, cfg);
@@ -231,12 +253,15 @@ class DedupBlocksImpl {
   std::mutex lock;
 
   // Find blocks with the same exact code
-  Duplicates collect_duplicates(const cfg::ControlFlowGraph& cfg) {
+  Duplicates collect_duplicates(const cfg::ControlFlowGraph& cfg,
+                                Fingerprints* fingerprints) {
     const auto& blocks = cfg.blocks();
-    Duplicates duplicates;
+    Duplicates duplicates(blocks.size(), BlockHasher{fingerprints},
+                          BlockEquals{fingerprints});
 
     for (cfg::Block* block : blocks) {
       if (is_eligible(block)) {
+        fingerprints->emplace(block, fingerprint(block));
         duplicates[block].insert(block);
         ++m_num_eligible_blocks;
       }
@@ -826,10 +851,11 @@ class DedupBlocksImpl {
     return result;
   }
 
-  static void print_dups(Duplicates dups) {
+  static void print_dups(const Duplicates& dups) {
     TRACE(DEDUP_BLOCKS, 4, "duplicate blocks set: {\n");
     for (const auto& entry : dups) {
-      TRACE(DEDUP_BLOCKS, 4, "  hash = %lu\n", BlockHasher{}(entry.first));
+      TRACE(DEDUP_BLOCKS, 4, "  hash = %lu\n",
+            dups.hash_function()(entry.first));
       for (cfg::Block* b : entry.second) {
         TRACE(DEDUP_BLOCKS, 4, "    block %d\n", b->id());
         for (const MethodItemEntry& mie : *b) {
@@ -15,6 +15,12 @@ class DedupBlocksPass : public Pass {
 
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
+  bool is_cfg_friendly() const override { return true; }
+
+  analysis::Set preserved_analyses() const override {
+    return analysis::CODE_AGNOSTIC;
+  }
+
   virtual void configure_pass(const JsonWrapper& jw) override {
     std::vector<std::string> method_black_list_names;
     jw.get("method_black_list", {}, method_black_list_names);
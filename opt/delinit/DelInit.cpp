@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <map>
+#include <numeric>
 #include <string>
 #include <vector>
 #include <unordered_set>
@@ -18,6 +19,7 @@
 #include "DexClass.h"
 #include "IRInstruction.h"
 #include "DexUtil.h"
+#include "Parallel.h"
 #include "Resolver.h"
 #include "ReachableClasses.h"
 
@@ -130,10 +132,14 @@ void find_referenced_classes(const Scope& scope) {
       }
     });
 
-  walk::code(
+  using ClassSet = std::unordered_set<const DexClass*>;
+  auto code_refs = walk::parallel::accumulate_methods<ClassSet>(
     scope,
-    [](DexMethod*) { return true; },
-    [&](DexMethod* meth, IRCode& code) {
+    [](DexMethod* meth) {
+      ClassSet classes;
+      if (meth->get_code() == nullptr) {
+        return classes;
+      }
       for (const auto& mie :
            InstructionIterable(meth->get_code())) {
         auto opcode = mie.insn;
@@ -144,14 +150,19 @@ void find_referenced_classes(const Scope& scope) {
             get_dextype_from_dotname(dsclzref->c_str());
           if (dtexclude == nullptr) continue;
           TRACE(PGR, 3, "string_ref: %s\n", SHOW(dtexclude));
-          referenced_classes.insert(type_class(dtexclude));
+          classes.insert(type_class(dtexclude));
         }
         if (opcode->has_type()) {
           TRACE(PGR, 3, "type_ref: %s\n", SHOW(opcode->get_type()));
-          referenced_classes.insert(type_class(opcode->get_type()));
+          classes.insert(type_class(opcode->get_type()));
         }
       }
+      return classes;
+    },
+    [](ClassSet& left, ClassSet&& right) {
+      left.insert(right.begin(), right.end());
     });
+  referenced_classes.insert(code_refs.begin(), code_refs.end());
 }
 
 bool can_remove(const DexClass* cls) {
@@ -243,6 +254,19 @@ struct DeadRefs {
   // set of dmethods (no init or clinit) that are known
   MethodVector dmethods;
 
+  // What the code of each method references. A reference that resolves to a
+  // concrete method or field keeps it from being removed, and one that
+  // resolves to nothing or to an external member can't change either, so
+  // they are only resolved once.
+  struct CodeRefs {
+    MethodVector callees;
+    std::vector<DexField*> fields;
+    // The references to abstract methods, which may be removed, after which
+    // they resolve further up the hierarchy.
+    std::vector<std::pair<DexMethodRef*, MethodSearch>> unresolved_methods;
+  };
+  std::unordered_map<const DexMethod*, CodeRefs> code_refs;
+
   // statistic info
   struct stats {
     size_t deleted_inits{0};
@@ -257,6 +281,12 @@ struct DeadRefs {
   void find_unreachable_data(DexClass* clazz);
   void collect_dmethods(Scope& scope);
   void track_callers(Scope& scope);
+  static void add_reference(DexMethodRef* ref,
+                            MethodSearch search,
+                            CodeRefs& refs);
+  static void add_reference(DexFieldRef* ref,
+                            FieldSearch search,
+                            CodeRefs& refs);
   int remove_unreachable();
 };
 
@@ -384,6 +414,33 @@ void DeadRefs::collect_dmethods(Scope& scope) {
       initmethods.size(), dmethods.size());
 }
 
+/**
+ * Record what a reference resolves to in refs.
+ */
+void DeadRefs::add_reference(DexMethodRef* ref,
+                             MethodSearch search,
+                             CodeRefs& refs) {
+  auto callee = resolve_method(ref, search);
+  if (callee == nullptr || callee->is_external()) {
+    return;
+  }
+  if (!callee->is_concrete()) {
+    refs.unresolved_methods.emplace_back(ref, search);
+    return;
+  }
+  refs.callees.push_back(callee);
+}
+
+void DeadRefs::add_reference(DexFieldRef* ref,
+                             FieldSearch search,
+                             CodeRefs& refs) {
+  auto field = resolve_field(ref, search);
+  if (field == nullptr || !field->is_concrete()) {
+    return;
+  }
+  refs.fields.push_back(field);
+}
+
 /**
  * Walk all opcodes and find all methods called (live in scope).
  * Also remove all potentially unreachable members - if a reference exists -
@@ -391,32 +448,57 @@ void DeadRefs::collect_dmethods(Scope& scope) {
  */
 void DeadRefs::track_callers(Scope& scope) {
   called.clear();
-  walk::opcodes(scope,
-      [](DexMethod*) { return true; },
-      [&](DexMethod* m, IRInstruction* insn) {
-        if (insn->has_method()) {
-          auto callee =
-              resolve_method(insn->get_method(), opcode_to_search(insn));
-          if (callee == nullptr || !callee->is_concrete()) return;
-          if (vmethods.count(callee) > 0) {
-            vmethods.erase(callee);
-          }
-          called.insert(callee);
-          return;
-        }
-        if (insn->has_field()) {
-          auto field = resolve_field(insn->get_field(),
-              is_ifield_op(insn->opcode()) ?
-                  FieldSearch::Instance :
-                  is_sfield_op(insn->opcode()) ?
-                      FieldSearch::Static : FieldSearch::Any);
-          if (field == nullptr || !field->is_concrete()) return;
-          if (ifields.count(field) > 0) {
-            ifields.erase(field);
-          }
-          return;
-        }
-      });
+  std::vector<DexMethod*> methods;
+  std::vector<DexMethod*> new_methods;
+  walk::code(scope, [&](DexMethod* m, IRCode&) {
+    methods.push_back(m);
+    auto it = code_refs.find(m);
+    if (it == code_refs.end()) {
+      new_methods.push_back(m);
+      return;
+    }
+    auto& refs = it->second;
+    auto unresolved_methods = std::move(refs.unresolved_methods);
+    refs.unresolved_methods.clear();
+    for (const auto& ref : unresolved_methods) {
+      add_reference(ref.first, ref.second, refs);
+    }
+  });
+
+  // Only the code of the methods that were not seen before is walked.
+  std::vector<CodeRefs> new_refs(new_methods.size());
+  std::vector<size_t> indices(new_methods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    auto& refs = new_refs[i];
+    for (const auto& mie : InstructionIterable(new_methods[i]->get_code())) {
+      auto insn = mie.insn;
+      if (insn->has_method()) {
+        add_reference(insn->get_method(), opcode_to_search(insn), refs);
+      } else if (insn->has_field()) {
+        add_reference(insn->get_field(),
+                      is_ifield_op(insn->opcode())
+                          ? FieldSearch::Instance
+                          : is_sfield_op(insn->opcode()) ? FieldSearch::Static
+                                                         : FieldSearch::Any,
+                      refs);
+      }
+    }
+  });
+  for (size_t i = 0; i < new_methods.size(); ++i) {
+    code_refs.emplace(new_methods[i], std::move(new_refs[i]));
+  }
+
+  for (auto m : methods) {
+    const auto& refs = code_refs.at(m);
+    for (auto callee : refs.callees) {
+      vmethods.erase(callee);
+      called.insert(callee);
+    }
+    for (auto field : refs.fields) {
+      ifields.erase(field);
+    }
+  }
   TRACE(DELINIT, 3,
       "Unreachable (not called) %ld vmethods and %ld ifields\n",
       vmethods.size(), ifields.size());
@@ -44,30 +44,61 @@ static const IROpcode s_return_invoke_super_wide_opcs[3] = {
 static const IROpcode s_return_invoke_super_obj_opcs[3] = {
     OPCODE_INVOKE_SUPER, OPCODE_MOVE_RESULT_OBJECT, OPCODE_RETURN_OBJECT};
 
+struct Stats {
+  int num_methods{0};
+  int num_passed{0};
+  int num_trivial{0};
+  int num_private{0};
+  int num_culled_no_code{0};
+  int num_culled_too_short{0};
+  int num_culled_not_trivial{0};
+  int num_culled_static{0};
+  int num_culled_name_differs{0};
+  int num_culled_proto_differs{0};
+  int num_culled_return_move_result_differs{0};
+  int num_culled_args_differs{0};
+  int num_culled_super_is_non_public_sdk{0};
+  int num_culled_super_cls_non_public{0};
+  int num_culled_super_not_def{0};
+
+  Stats& operator+=(const Stats& other) {
+    num_methods += other.num_methods;
+    num_passed += other.num_passed;
+    num_trivial += other.num_trivial;
+    num_private += other.num_private;
+    num_culled_no_code += other.num_culled_no_code;
+    num_culled_too_short += other.num_culled_too_short;
+    num_culled_not_trivial += other.num_culled_not_trivial;
+    num_culled_static += other.num_culled_static;
+    num_culled_name_differs += other.num_culled_name_differs;
+    num_culled_proto_differs += other.num_culled_proto_differs;
+    num_culled_return_move_result_differs +=
+        other.num_culled_return_move_result_differs;
+    num_culled_args_differs += other.num_culled_args_differs;
+    num_culled_super_is_non_public_sdk +=
+        other.num_culled_super_is_non_public_sdk;
+    num_culled_super_cls_non_public += other.num_culled_super_cls_non_public;
+    num_culled_super_not_def += other.num_culled_super_not_def;
+    return *this;
+  }
+};
+
+// The trivial methods found in part of the scope.
+struct Candidates {
+  Stats stats;
+  // trivial return invoke super method -> invoked super method
+  std::vector<std::pair<DexMethod*, DexMethod*>> delmeths;
+};
+
 class DelSuper {
 
 private:
   const std::vector<DexClass*>& m_scope;
   // trivial return invoke super method -> invoked super method
   std::unordered_map<DexMethod*, DexMethod*> m_delmeths;
-  int m_num_methods;
-  int m_num_passed;
-  int m_num_trivial;
-  int m_num_relaxed_vis;
-  int m_num_cls_relaxed_vis;
-  int m_num_private;
-  int m_num_culled_no_code;
-  int m_num_culled_too_short;
-  int m_num_culled_not_trivial;
-  int m_num_culled_static;
-  int m_num_culled_name_differs;
-  int m_num_culled_proto_differs;
-  int m_num_culled_return_move_result_differs;
-  int m_num_culled_args_differs;
-  int m_num_culled_super_is_non_public_sdk;
-  int m_num_culled_super_cls_non_public;
-  int m_num_culled_super_not_def;
-
+  Stats m_stats;
+  int m_num_relaxed_vis{0};
+  int m_num_cls_relaxed_vis{0};
 
   /**
    * This method ensures that the method arguments pass directly through
@@ -99,7 +130,7 @@ private:
    * don't handle that case here.
    *
    */
-  bool do_invoke_meth_args_pass_through(
+  static bool do_invoke_meth_args_pass_through(
     const DexMethod* meth,
     const IRInstruction* insn) {
     assert(insn->opcode() == OPCODE_INVOKE_SUPER);
@@ -114,7 +145,7 @@ private:
     return true;
   }
 
-  bool are_opcs_equal(const std::vector<IRInstruction*> insns,
+  static bool are_opcs_equal(const std::vector<IRInstruction*> insns,
                       const IROpcode* opcs,
                       size_t opcs_len) {
     if (insns.size() != opcs_len) return false;
@@ -141,14 +172,16 @@ private:
    * - Method args must all go into invoke without rearrangement
    *
    * Returns the super method, or null if this is not a trivial return invoke
-   * super.
+   * super. The super method or its class may still have to be made public.
+   * This only reads `meth` and what it invokes, so it can run in parallel.
    */
-  DexMethod* get_trivial_return_invoke_super(const DexMethod* meth) {
+  static DexMethod* get_trivial_return_invoke_super(const DexMethod* meth,
+                                                    Stats& stats) {
     const auto* code = meth->get_code();
 
     // Must have code
     if (!code) {
-      m_num_culled_no_code++;
+      stats.num_culled_no_code++;
       return nullptr;
     }
 
@@ -165,7 +198,7 @@ private:
 
     // Must have at least two instructions
     if (insns.size() < 2) {
-      m_num_culled_too_short++;
+      stats.num_culled_too_short++;
       return nullptr;
     }
 
@@ -174,19 +207,19 @@ private:
       are_opcs_equal(insns, s_return_invoke_super_opcs, 3) ||
       are_opcs_equal(insns, s_return_invoke_super_wide_opcs, 3) ||
       are_opcs_equal(insns, s_return_invoke_super_obj_opcs, 3))) {
-      m_num_culled_not_trivial++;
+      stats.num_culled_not_trivial++;
       return nullptr;
     }
 
     // Must not be static
     if (is_static(meth)) {
-      m_num_culled_static++;
+      stats.num_culled_static++;
       return nullptr;
     }
 
     // Must not be private
     if (is_private(meth)) {
-      m_num_private++;
+      stats.num_private++;
     }
 
     // For non-void scenarios, capture move-result and return opcodes
@@ -196,120 +229,122 @@ private:
       move_res_opc = insns[1];
       return_opc = insns[2];
     }
-    m_num_trivial++;
+    stats.num_trivial++;
 
     // Get invoked method
     DexMethodRef* invoked_meth = insns[0]->get_method();
 
     // Invoked method name must match
     if (meth->get_name() != invoked_meth->get_name()) {
-      m_num_culled_name_differs++;
+      stats.num_culled_name_differs++;
       return nullptr;
     }
 
     // Invoked method proto must match
     if (meth->get_proto() != invoked_meth->get_proto()) {
-      m_num_culled_proto_differs++;
+      stats.num_culled_proto_differs++;
       return nullptr;
     }
 
     // Method return src register must match move-result dest register
     if (move_res_opc && return_opc &&
         move_res_opc->dest() != return_opc->src(0)) {
-      m_num_culled_return_move_result_differs++;
+      stats.num_culled_return_move_result_differs++;
       return nullptr;
     }
 
     // Method args must pass through directly
     if (!do_invoke_meth_args_pass_through(meth, insns[0])) {
-      m_num_culled_args_differs++;
+      stats.num_culled_args_differs++;
       return nullptr;
     }
 
     // If the invoked method does not have access flags, we can't operate
     // on it at all.
     if (!invoked_meth->is_def()) {
-      m_num_culled_super_not_def++;
+      stats.num_culled_super_not_def++;
       return nullptr;
     }
     auto meth_def = static_cast<DexMethod*>(invoked_meth);
-    // If invoked method is not public, make it public
+    // If invoked method is not public, it must be made public
+    if (!is_public(meth_def) && !meth_def->is_concrete()) {
+      stats.num_culled_super_is_non_public_sdk++;
+      return nullptr;
+    }
+
+    auto cls = type_class(meth_def->get_class());
+    if (!is_public(cls) && cls->is_external()) {
+      stats.num_culled_super_cls_non_public++;
+      return nullptr;
+    }
+
+    return meth_def;
+  }
+
+  // Makes the invoked super method and its class public.
+  void relax_visibility(DexMethod* meth_def) {
     if (!is_public(meth_def)) {
-      if (!meth_def->is_concrete()) {
-        m_num_culled_super_is_non_public_sdk++;
-        return nullptr;
-      }
       set_public(meth_def);
       m_num_relaxed_vis++;
     }
-
     auto cls = type_class(meth_def->get_class());
     if (!is_public(cls)) {
-      if (cls->is_external()) {
-        m_num_culled_super_cls_non_public++;
-        return nullptr;
-      }
       set_public(cls);
       m_num_cls_relaxed_vis++;
     }
-
-    return meth_def;
   }
 
+
 public:
-  explicit DelSuper(const std::vector<DexClass*>& scope)
-    : m_scope(scope),
-      m_num_methods(0),
-      m_num_passed(0),
-      m_num_trivial(0),
-      m_num_relaxed_vis(0),
-      m_num_cls_relaxed_vis(0),
-      m_num_private(0),
-      m_num_culled_no_code(0),
-      m_num_culled_too_short(0),
-      m_num_culled_not_trivial(0),
-      m_num_culled_static(0),
-      m_num_culled_name_differs(0),
-      m_num_culled_proto_differs(0),
-      m_num_culled_return_move_result_differs(0),
-      m_num_culled_args_differs(0),
-      m_num_culled_super_is_non_public_sdk(0),
-      m_num_culled_super_cls_non_public(0),
-      m_num_culled_super_not_def(0) {
-  }
+  explicit DelSuper(const std::vector<DexClass*>& scope) : m_scope(scope) {}
 
   void run(bool do_delete, PassManager& mgr) {
-    walk::methods(m_scope,
-      [&](DexMethod* meth) {
-        m_num_methods++;
-        auto invoked_meth = get_trivial_return_invoke_super(meth);
-        if (invoked_meth) {
-          TRACE(SUPER, 5, "Found trivial return invoke-super: %s\n",
-            SHOW(meth));
-          m_delmeths.emplace(meth, invoked_meth);
-          m_num_passed++;
-        }
-      });
+    auto candidates = walk::parallel::accumulate_methods<Candidates>(
+        m_scope,
+        [](DexMethod* meth) {
+          Candidates found;
+          found.stats.num_methods++;
+          auto invoked_meth =
+              get_trivial_return_invoke_super(meth, found.stats);
+          if (invoked_meth) {
+            TRACE(SUPER, 5, "Found trivial return invoke-super: %s\n",
+                  SHOW(meth));
+            found.delmeths.emplace_back(meth, invoked_meth);
+            found.stats.num_passed++;
+          }
+          return found;
+        },
+        [](Candidates& left, Candidates&& right) {
+          left.stats += right.stats;
+          left.delmeths.insert(left.delmeths.end(), right.delmeths.begin(),
+                               right.delmeths.end());
+        });
+    m_stats = candidates.stats;
+    for (const auto& pair : candidates.delmeths) {
+      relax_visibility(pair.second);
+      m_delmeths.emplace(pair);
+    }
     if (do_delete) {
       // we technically don't have to rewrite the opcodes -- we could just
       // remove the method declarations and the runtime semantics would be
       // unchanged -- but this ensures that we have no more references to
       // that method_id and can avoid emitting it in the dex output.
-      walk::opcodes(m_scope,
-                   [](DexMethod* meth) { return true; },
-                   [&](DexMethod* meth, IRInstruction* insn) {
-                     if (is_invoke(insn->opcode())) {
-                       if (!insn->get_method()->is_def()) {
-                         return;
-                       }
-                       auto method =
-                           static_cast<DexMethod*>(insn->get_method());
-                       while (m_delmeths.count(method)) {
-                         method = m_delmeths.at(method);
-                       }
-                       insn->set_method(method);
-                     }
-                   });
+      walk::parallel::opcodes(
+          m_scope,
+          [](DexMethod* meth) { return true; },
+          [&](DexMethod* meth, IRInstruction* insn) {
+            if (is_invoke(insn->opcode())) {
+              if (!insn->get_method()->is_def()) {
+                return;
+              }
+              auto method = static_cast<DexMethod*>(insn->get_method());
+              while (m_delmeths.count(method)) {
+                method = m_delmeths.at(method);
+              }
+              insn->set_method(method);
+            }
+          });
+      // The methods are only deleted once nothing references them.
       for (const auto& pair : m_delmeths) {
         auto meth = pair.first;
         auto clazz = type_class(meth->get_class());
@@ -324,29 +359,30 @@ public:
   }
 
   void print_stats(bool do_delete, PassManager& mgr) {
-    TRACE(SUPER, 1, "Examined %d total methods\n", m_num_methods);
-    TRACE(SUPER, 1, "Found %d candidate trivial methods\n", m_num_trivial);
+    TRACE(SUPER, 1, "Examined %d total methods\n", m_stats.num_methods);
+    TRACE(SUPER, 1, "Found %d candidate trivial methods\n",
+      m_stats.num_trivial);
     TRACE(SUPER, 5, "Culled %d due to super not defined\n",
-      m_num_culled_super_not_def);
+      m_stats.num_culled_super_not_def);
     TRACE(SUPER, 5, "Culled %d due to method is static\n",
-      m_num_culled_static);
+      m_stats.num_culled_static);
     TRACE(SUPER, 5, "Culled %d due to method name doesn't match super\n",
-      m_num_culled_name_differs);
+      m_stats.num_culled_name_differs);
     TRACE(SUPER, 5, "Culled %d due to method proto doesn't match super\n",
-      m_num_culled_proto_differs);
+      m_stats.num_culled_proto_differs);
     TRACE(SUPER, 5, "Culled %d due to method doesn't return move result\n",
-      m_num_culled_return_move_result_differs);
+      m_stats.num_culled_return_move_result_differs);
     TRACE(SUPER, 5, "Culled %d due to method args doesn't match super\n",
-      m_num_culled_args_differs);
+      m_stats.num_culled_args_differs);
     TRACE(SUPER, 5, "Culled %d due to non-public super method in sdk\n",
-      m_num_culled_super_is_non_public_sdk);
+      m_stats.num_culled_super_is_non_public_sdk);
     TRACE(SUPER, 5, "Culled %d due to non-public super class in sdk\n",
-      m_num_culled_super_cls_non_public);
+      m_stats.num_culled_super_cls_non_public);
     TRACE(SUPER, 1, "Found %d trivial return invoke-super methods\n",
-      m_num_passed);
+      m_stats.num_passed);
     if (do_delete) {
       TRACE(SUPER, 1, "Deleted %d trivial return invoke-super methods\n",
-        m_num_passed);
+        m_stats.num_passed);
       TRACE(SUPER, 1, "Promoted %d methods to public visibility\n",
         m_num_relaxed_vis);
       TRACE(SUPER, 1, "Promoted %d classes to public visibility\n",
@@ -354,16 +390,16 @@ public:
     } else {
       TRACE(SUPER, 1, "Preview-only; not performing any changes.\n");
       TRACE(SUPER, 1, "Would delete %d trivial return invoke-super methods\n",
-        m_num_passed);
+        m_stats.num_passed);
       TRACE(SUPER, 1, "Would promote %d methods to public visibility\n",
         m_num_relaxed_vis);
       TRACE(SUPER, 1, "Would promote %d classes to public visibility\n",
         m_num_cls_relaxed_vis);
     }
 
-    mgr.incr_metric(METRIC_TOTAL_METHODS, m_num_methods);
-    mgr.incr_metric(METRIC_TRIVIAL_METHOD_CANDIDATES, m_num_trivial);
-    mgr.incr_metric(METRIC_REMOVED_TRIVIAL_METHODS, m_num_passed);
+    mgr.incr_metric(METRIC_TOTAL_METHODS, m_stats.num_methods);
+    mgr.incr_metric(METRIC_TRIVIAL_METHOD_CANDIDATES, m_stats.num_trivial);
+    mgr.incr_metric(METRIC_REMOVED_TRIVIAL_METHODS, m_stats.num_passed);
     mgr.incr_metric(METRIC_METHOD_RELAXED_VISIBILITY, m_num_relaxed_vis);
     mgr.incr_metric(METRIC_CLASS_RELAXED_VISIBILITY, m_num_cls_relaxed_vis);
   }
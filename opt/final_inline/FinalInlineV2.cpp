@@ -8,6 +8,7 @@
 #include "FinalInlineV2.h"
 
 #include <boost/variant.hpp>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -20,6 +21,7 @@
 #include "IPConstantPropagationAnalysis.h"
 #include "IRCode.h"
 #include "LocalDce.h"
+#include "Parallel.h"
 #include "Resolver.h"
 #include "Walkers.h"
 
@@ -46,26 +48,36 @@ namespace {
  *
  * Similarly, to ensure that our analysis of Foo.<clinit> knows as much about
  * Bar's static fields as possible, we want to analyze Bar.<clinit> before
- * Foo.<clinit>, since Foo.<clinit> depends on it. As such, we do a topological
- * sort of the classes here based on these dependencies.
+ * Foo.<clinit>, since Foo.<clinit> depends on it. As such, we group the
+ * classes into waves here based on these dependencies: a class is in the
+ * wave after the last of the waves of the classes it depends on, so the
+ * classes of a wave can be analyzed in parallel once the earlier waves are
+ * done. Within a wave, classes are in topological order.
  *
  * Note that the class initialization graph is *not* guaranteed to be acyclic.
  * (JLS SE7 12.4.1 indicates that cycles are indeed allowed.) In that case,
  * this pass cannot safely optimize the static final constants.
  */
-Scope reverse_tsort_by_clinit_deps(const Scope& scope) {
+std::vector<Scope> group_by_clinit_deps(const Scope& scope) {
   std::unordered_set<const DexClass*> scope_set(scope.begin(), scope.end());
-  Scope result;
+  std::vector<Scope> waves;
   std::unordered_set<const DexClass*> visiting;
-  std::unordered_set<const DexClass*> visited;
-  std::function<void(DexClass*)> visit = [&](DexClass* cls) {
-    if (visited.count(cls) != 0 || scope_set.count(cls) == 0) {
-      return;
+  std::unordered_map<const DexClass*, size_t> wave_index;
+  // Returns the number of waves up to and including the one of `cls`, and 0
+  // for classes outside of the scope.
+  std::function<size_t(DexClass*)> visit = [&](DexClass* cls) -> size_t {
+    if (scope_set.count(cls) == 0) {
+      return 0;
+    }
+    auto it = wave_index.find(cls);
+    if (it != wave_index.end()) {
+      return it->second + 1;
     }
     if (visiting.count(cls)) {
       throw final_inline::class_initialization_cycle(cls);
     }
     visiting.emplace(cls);
+    size_t index = 0;
     auto clinit = cls->get_clinit();
     if (clinit != nullptr && clinit->get_code() != nullptr) {
       for (auto& mie : InstructionIterable(clinit->get_code())) {
@@ -75,22 +87,27 @@ Scope reverse_tsort_by_clinit_deps(const Scope& scope) {
           if (dependee_cls == nullptr || dependee_cls == cls) {
             continue;
           }
-          visit(dependee_cls);
+          index = std::max(index, visit(dependee_cls));
         }
       }
     }
     visiting.erase(cls);
-    result.emplace_back(cls);
-    visited.emplace(cls);
+    if (index == waves.size()) {
+      waves.emplace_back();
+    }
+    waves[index].emplace_back(cls);
+    wave_index.emplace(cls, index);
+    return index + 1;
   };
   for (DexClass* cls : scope) {
     visit(cls);
   }
-  return result;
+  return waves;
 }
 
 /**
- * Similar to reverse_tsort_by_clinit_deps(...), but since we are currently
+ * Similar to group_by_clinit_deps(...), but as a plain topological sort, and
+ * since we are currently
  * only dealing with instance field from class that only have one <init>
  * so stop when we are at a class that don't have exactly one constructor,
  * we are not dealing with them now so we won't have knowledge about their
@@ -216,40 +233,67 @@ namespace final_inline {
  * as part of the WholeProgramState object.
  */
 cp::WholeProgramState analyze_and_simplify_clinits(const Scope& scope) {
+  struct ClinitResult {
+    DexClass* cls;
+    FieldEnvironment field_env;
+    bool remove_clinit{false};
+  };
   cp::WholeProgramState wps;
-  for (DexClass* cls : reverse_tsort_by_clinit_deps(scope)) {
-    ConstantEnvironment env;
-    cp::set_encoded_values(cls, &env);
-    auto clinit = cls->get_clinit();
-    if (clinit != nullptr && clinit->get_code() != nullptr) {
-      auto* code = clinit->get_code();
-      code->build_cfg(/* editable */ false);
-      auto& cfg = code->cfg();
-      cfg.calculate_exit_block();
-      cp::intraprocedural::FixpointIterator intra_cp(
-          cfg, CombinedAnalyzer(cls->get_type(), &wps, nullptr, nullptr));
-      intra_cp.run(env);
-      env = intra_cp.get_exit_state_at(cfg.exit_block());
-
-      // Generate the encoded_values and re-run the analysis.
-      encode_values(cls, env.get_field_environment());
-      auto fresh_env = ConstantEnvironment();
-      cp::set_encoded_values(cls, &fresh_env);
-      intra_cp.run(fresh_env);
-
-      // Detect any field writes made redundant by the new encoded_values and
-      // remove those sputs.
-      cp::Transform::Config transform_config;
-      transform_config.class_under_init = cls->get_type();
-      cp::Transform(transform_config).apply(intra_cp, wps, code);
-      // Delete the instructions rendered dead by the removal of those sputs.
-      LocalDcePass::run(code);
-      // If the clinit is empty now, delete it.
-      if (is_trivial_clinit(clinit)) {
-        cls->remove_method(clinit);
+  for (const auto& wave : group_by_clinit_deps(scope)) {
+    std::vector<ClinitResult> results;
+    results.reserve(wave.size());
+    for (DexClass* cls : wave) {
+      results.push_back({cls, FieldEnvironment()});
+    }
+    // The classes of a wave only read the static finals of earlier waves, so
+    // wps is not written to until all of them are done. Each class only
+    // changes its own fields and <clinit> here; removing the <clinit> from
+    // the class waits until the end of the wave, as other threads may be
+    // resolving methods.
+    parallel_for(
+        results.begin(),
+        results.end(),
+        [&wps](ClinitResult& result) {
+          auto* cls = result.cls;
+          ConstantEnvironment env;
+          cp::set_encoded_values(cls, &env);
+          auto clinit = cls->get_clinit();
+          if (clinit != nullptr && clinit->get_code() != nullptr) {
+            auto* code = clinit->get_code();
+            code->build_cfg(/* editable */ false);
+            auto& cfg = code->cfg();
+            cfg.calculate_exit_block();
+            cp::intraprocedural::FixpointIterator intra_cp(
+                cfg, CombinedAnalyzer(cls->get_type(), &wps, nullptr, nullptr));
+            intra_cp.run(env);
+            env = intra_cp.get_exit_state_at(cfg.exit_block());
+
+            // Generate the encoded_values and re-run the analysis.
+            encode_values(cls, env.get_field_environment());
+            auto fresh_env = ConstantEnvironment();
+            cp::set_encoded_values(cls, &fresh_env);
+            intra_cp.run(fresh_env);
+
+            // Detect any field writes made redundant by the new
+            // encoded_values and remove those sputs.
+            cp::Transform::Config transform_config;
+            transform_config.class_under_init = cls->get_type();
+            cp::Transform(transform_config).apply(intra_cp, wps, code);
+            // Delete the instructions rendered dead by the removal of those
+            // sputs.
+            LocalDcePass::run(code);
+            // If the clinit is empty now, delete it.
+            result.remove_clinit = is_trivial_clinit(clinit);
+          }
+          result.field_env = env.get_field_environment();
+        },
+        /* grain */ 1);
+    for (auto& result : results) {
+      if (result.remove_clinit) {
+        result.cls->remove_method(result.cls->get_clinit());
       }
+      wps.collect_static_finals(result.cls, std::move(result.field_env));
     }
-    wps.collect_static_finals(cls, env.get_field_environment());
   }
   return wps;
 }
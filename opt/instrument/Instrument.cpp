@@ -426,22 +426,99 @@ int instrument_onBasicBlockBegin(
   return method_id;
 }
 
-void instrument_onMethodBegin(DexMethod* method,
-                              int index,
-                              DexMethod* method_onMethodBegin) {
-  IRCode* code = method->get_code();
+// Coverage-only alternative to instrument_onBasicBlockBegin. Instead of
+// carrying bit vectors to an analysis call at every exit, each block stores
+// `true` to its own element of a static boolean[], in the slice of the method
+// that starts at `offset` and is indexed by block id:
+//
+//  SGET_OBJECT <coverage_field>     ; at the method entry
+//  CONST v_true, 1
+//  ...
+//  CONST v_idx, offset + block_id   ; in each block
+//  APUT_BOOLEAN v_true, v_array, v_idx
+//
+// No instruction is added at the exits, and the array is read by the runtime
+// whenever it wants to dump the coverage. Returns the offset of the next slice.
+size_t instrument_basic_block_coverage(
+    IRCode* code,
+    DexMethod* method,
+    DexField* coverage_field,
+    size_t offset,
+    int& all_bbs,
+    int& num_blocks_instrumented,
+    int& all_methods_inst,
+    std::map<int, std::pair<std::string, int>>& method_id_name_map) {
   assert(code != nullptr);
 
-  IRInstruction* const_inst = new IRInstruction(OPCODE_CONST);
-  const_inst->set_literal(index);
-  const auto reg_dest = code->allocate_temp();
-  const_inst->set_dest(reg_dest);
+  code->build_cfg(/* editable */ false);
+  const auto& blocks = code->cfg().blocks();
+  all_bbs += blocks.size();
 
-  IRInstruction* invoke_inst = new IRInstruction(OPCODE_INVOKE_STATIC);
-  invoke_inst->set_method(method_onMethodBegin);
-  invoke_inst->set_arg_word_count(1);
-  invoke_inst->set_src(0, reg_dest);
+  const auto reg_array = code->allocate_temp();
+  const auto reg_true = code->allocate_temp();
+  const auto reg_idx = code->allocate_temp();
+  auto mark_block = [&](cfg::Block* block, const IRList::iterator& it) {
+    code->insert_before(it, (new IRInstruction(OPCODE_CONST))
+                                ->set_literal(offset + block->id())
+                                ->set_dest(reg_idx));
+    code->insert_before(it, (new IRInstruction(OPCODE_APUT_BOOLEAN))
+                                ->set_src(0, reg_true)
+                                ->set_src(1, reg_array)
+                                ->set_src(2, reg_idx));
+    num_blocks_instrumented++;
+  };
+
+  size_t slice_size = 0;
+  for (cfg::Block* block : blocks) {
+    slice_size = std::max(slice_size, size_t(block->id()) + 1);
+    // The entry block is marked along with the initialization below.
+    if (block == code->cfg().entry_block()) {
+      continue;
+    }
+    // Same as instrument_onBasicBlockBegin, blocks that have no opcodes, or
+    // only internal or MOVE ones, are not instrumented.
+    auto insert_point = find_or_insn_insert_point(block);
+    if (insert_point == block->end() || block->num_opcodes() < 1) {
+      TRACE(INSTRUMENT, 7, "No instrumentation to block: %s\n",
+            SHOW(show(method) + std::to_string(block->id())));
+      continue;
+    }
+    mark_block(block, insert_point);
+  }
+
+  // We use intentionally obfuscated name to guarantee the uniqueness.
+  const auto& method_name = show(method);
+  assert(!method_id_name_map.count(offset));
+  method_id_name_map.emplace(offset,
+                             std::make_pair(method_name, blocks.size()));
+
+  // Load the array and the stored value at the beginning of the method, so
+  // that they are defined in every block.
+  auto insert_point_init = std::find_if_not(
+      code->begin(), code->end(), [&](const MethodItemEntry& mie) {
+        return mie.type == MFLOW_FALLTHROUGH ||
+               (mie.type == MFLOW_OPCODE &&
+                opcode::is_load_param(mie.insn->opcode()));
+      });
+  code->insert_before(insert_point_init,
+                      (new IRInstruction(OPCODE_SGET_OBJECT))
+                          ->set_field(coverage_field));
+  code->insert_before(insert_point_init,
+                      (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT))
+                          ->set_dest(reg_array));
+  code->insert_before(
+      insert_point_init,
+      (new IRInstruction(OPCODE_CONST))->set_literal(1)->set_dest(reg_true));
+  mark_block(code->cfg().entry_block(), insert_point_init);
 
+  TRACE(INSTRUMENT, 7, "Offset: %zu Method: %s\n", offset, SHOW(method_name));
+  TRACE(INSTRUMENT, 7, "After Instrumentation Full:\n %s\n", SHOW(code));
+
+  all_methods_inst++;
+  return offset + slice_size;
+}
+
+IRList::iterator find_method_entry_insert_point(IRCode* code) {
   // TODO(minjang): Consider using get_param_instructions.
   // Try to find a right insertion point: the entry point of the method.
   // We skip any fall throughs and IOPCODE_LOAD_PARRM*.
@@ -469,7 +546,26 @@ void instrument_onMethodBegin(DexMethod* method,
   } else {
     // Otherwise, insert_point can be used directly.
   }
+  return insert_point;
+}
+
+void instrument_onMethodBegin(DexMethod* method,
+                              int index,
+                              DexMethod* method_onMethodBegin) {
+  IRCode* code = method->get_code();
+  assert(code != nullptr);
+
+  IRInstruction* const_inst = new IRInstruction(OPCODE_CONST);
+  const_inst->set_literal(index);
+  const auto reg_dest = code->allocate_temp();
+  const_inst->set_dest(reg_dest);
 
+  IRInstruction* invoke_inst = new IRInstruction(OPCODE_INVOKE_STATIC);
+  invoke_inst->set_method(method_onMethodBegin);
+  invoke_inst->set_arg_word_count(1);
+  invoke_inst->set_src(0, reg_dest);
+
+  auto insert_point = find_method_entry_insert_point(code);
   code->insert_before(code->insert_before(insert_point, invoke_inst),
                       const_inst);
 
@@ -494,6 +590,110 @@ void instrument_onMethodBegin(DexMethod* method,
   }
 }
 
+// Same as instrument_onMethodBegin, but the analysis method is only called on
+// some entries, which are picked inline so that the other entries cost a few
+// instructions instead of a call. `state_field` is the int[] that holds the
+// state of all methods: `method_id` indexes a counter in it for every_nth, or
+// a bit for first_execution. For every_nth, the period is a power of two:
+//
+//  SGET_OBJECT <state_field>          SGET_OBJECT <state_field>
+//  CONST v_idx, method_id             CONST v_idx, method_id / 32
+//  AGET v_count, v_state, v_idx       AGET v_word, v_state, v_idx
+//  ADD_INT_LIT8 v_tmp, v_count, 1     CONST v_bit, 1 << (method_id % 32)
+//  APUT v_tmp, v_state, v_idx         AND_INT v_tmp, v_word, v_bit
+//  AND_INT_LIT16 v_tmp, v_count, N-1  IF_NEZ v_tmp, :skip
+//  IF_NEZ v_tmp, :skip                OR_INT v_word, v_word, v_bit
+//  <onMethodBegin(index)>             APUT v_word, v_state, v_idx
+//  :skip                              <onMethodBegin(index)>
+//                                     :skip
+void instrument_sampled_onMethodBegin(DexMethod* method,
+                                      int method_id,
+                                      int index,
+                                      DexMethod* method_onMethodBegin,
+                                      DexField* state_field,
+                                      const InstrumentPass::Options& options) {
+  IRCode* code = method->get_code();
+  assert(code != nullptr);
+  bool every_nth = options.sampling_strategy == "every_nth";
+  auto insert_point = find_method_entry_insert_point(code);
+  auto insert = [&](IRInstruction* insn) {
+    return code->insert_before(insert_point, insn);
+  };
+
+  const auto reg_state = code->allocate_temp();
+  const auto reg_idx = code->allocate_temp();
+  const auto reg_value = code->allocate_temp();
+  const auto reg_tmp = code->allocate_temp();
+  insert((new IRInstruction(OPCODE_SGET_OBJECT))->set_field(state_field));
+  insert((new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT))
+             ->set_dest(reg_state));
+  insert((new IRInstruction(OPCODE_CONST))
+             ->set_literal(every_nth ? method_id : method_id / 32)
+             ->set_dest(reg_idx));
+  insert((new IRInstruction(OPCODE_AGET))
+             ->set_src(0, reg_state)
+             ->set_src(1, reg_idx));
+  insert(
+      (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO))->set_dest(reg_value));
+
+  auto aput = [&](uint16_t reg) {
+    insert((new IRInstruction(OPCODE_APUT))
+               ->set_src(0, reg)
+               ->set_src(1, reg_state)
+               ->set_src(2, reg_idx));
+  };
+  IRList::iterator if_it;
+  if (every_nth) {
+    insert((new IRInstruction(OPCODE_ADD_INT_LIT8))
+               ->set_literal(1)
+               ->set_src(0, reg_value)
+               ->set_dest(reg_tmp));
+    aput(reg_tmp);
+    insert((new IRInstruction(OPCODE_AND_INT_LIT16))
+               ->set_literal(options.sampling_period - 1)
+               ->set_src(0, reg_value)
+               ->set_dest(reg_tmp));
+    if_it = insert((new IRInstruction(OPCODE_IF_NEZ))->set_src(0, reg_tmp));
+  } else {
+    const auto reg_bit = code->allocate_temp();
+    insert((new IRInstruction(OPCODE_CONST))
+               ->set_literal(static_cast<int32_t>(1u << (method_id % 32)))
+               ->set_dest(reg_bit));
+    insert((new IRInstruction(OPCODE_AND_INT))
+               ->set_src(0, reg_value)
+               ->set_src(1, reg_bit)
+               ->set_dest(reg_tmp));
+    if_it = insert((new IRInstruction(OPCODE_IF_NEZ))->set_src(0, reg_tmp));
+    insert((new IRInstruction(OPCODE_OR_INT))
+               ->set_src(0, reg_value)
+               ->set_src(1, reg_bit)
+               ->set_dest(reg_value));
+    aput(reg_value);
+  }
+
+  insert((new IRInstruction(OPCODE_CONST))->set_literal(index)->set_dest(
+      reg_tmp));
+  insert((new IRInstruction(OPCODE_INVOKE_STATIC))
+             ->set_method(method_onMethodBegin)
+             ->set_arg_word_count(1)
+             ->set_src(0, reg_tmp));
+  code->insert_before(insert_point, new BranchTarget(&*if_it));
+}
+
+DexField* find_state_array(const DexClass& analysis_cls,
+                           const char* array_name,
+                           DexType* array_type) {
+  for (auto field : analysis_cls.get_sfields()) {
+    if (field->get_name()->str() == array_name &&
+        field->get_type() == array_type) {
+      return field;
+    }
+  }
+  std::cerr << "[InstrumentPass] error: cannot find static " << show(array_type)
+            << " " << array_name << " in " << show(analysis_cls) << std::endl;
+  exit(1);
+}
+
 // Find a sequence of opcode that creates a static array. Patch the array size.
 void patch_array_size(DexClass& analysis_cls,
                       const char* array_name,
@@ -613,6 +813,28 @@ void do_simple_method_tracing(DexClass* analysis_cls,
   always_assert(method_onMethodBegin_map.count(1));
   auto method_onMethodBegin = method_onMethodBegin_map.at(1);
 
+  DexField* state_field = nullptr;
+  const char* state_array_name = nullptr;
+  if (options.sampling_strategy == "every_nth") {
+    // The period is applied with a mask, and has to fit in an and-int/lit16.
+    always_assert_log(options.sampling_period > 0 &&
+                          options.sampling_period <= (1 << 15) &&
+                          (options.sampling_period &
+                           (options.sampling_period - 1)) == 0,
+                      "sampling_period must be a power of two up to 32768");
+    state_array_name = "sMethodCounters";
+  } else if (options.sampling_strategy == "first_execution") {
+    state_array_name = "sMethodBitmap";
+  } else {
+    always_assert_log(options.sampling_strategy.empty(),
+                      "Unknown sampling strategy: %s",
+                      options.sampling_strategy.c_str());
+  }
+  if (state_array_name != nullptr) {
+    state_field = find_state_array(*analysis_cls, state_array_name,
+                                   make_array_type(get_int_type()));
+  }
+
   // Write metadata file with more information.
   const auto& file_name = cfg.metafile(options.metadata_file_name);
   std::ofstream ofs(file_name, std::ofstream::out | std::ofstream::trunc);
@@ -673,8 +895,15 @@ void do_simple_method_tracing(DexClass* analysis_cls,
     }
 
     TRACE(INSTRUMENT, 5, "%d: %s\n", method_id, SHOW(method));
-    instrument_onMethodBegin(method, method_id * options.num_stats_per_method,
-                             method_onMethodBegin);
+    if (state_field == nullptr) {
+      instrument_onMethodBegin(method,
+                               method_id * options.num_stats_per_method,
+                               method_onMethodBegin);
+    } else {
+      instrument_sampled_onMethodBegin(
+          method, method_id, method_id * options.num_stats_per_method,
+          method_onMethodBegin, state_field, options);
+    }
 
     // Emit metadata to the file.
     ofs << "M," << method_id << "," << name << "," << sum_opcode_sizes << ",\""
@@ -739,6 +968,14 @@ void do_simple_method_tracing(DexClass* analysis_cls,
   patch_array_size(*analysis_cls, "sMethodStats",
                    method_id * options.num_stats_per_method);
 
+  // Patch the size of the per-method counters or bits.
+  if (state_field != nullptr) {
+    patch_array_size(*analysis_cls, state_array_name,
+                     options.sampling_strategy == "every_nth"
+                         ? method_id
+                         : (method_id + 31) / 32);
+  }
+
   // Patch method count constant.
   patch_static_field(*analysis_cls, "sMethodCount", method_id);
 
@@ -749,6 +986,46 @@ void do_simple_method_tracing(DexClass* analysis_cls,
   pm.incr_metric("Excluded", excluded);
 }
 
+std::unordered_set<std::string> get_cold_start_classes(ConfigFiles& cfg) {
+  auto interdex_list = cfg.get_coldstart_classes();
+  std::unordered_set<std::string> cold_start_classes;
+  std::string dex_end_marker0("LDexEndMarker0;");
+  for (auto class_string : interdex_list) {
+    if (class_string == dex_end_marker0) {
+      break;
+    }
+    class_string.back() = '/';
+    cold_start_classes.insert(class_string);
+  }
+  TRACE(INSTRUMENT, 7, "Number of classes: %d\n", cold_start_classes.size());
+  return cold_start_classes;
+}
+
+bool should_instrument_blocks(
+    DexMethod* method,
+    const InstrumentPass::Options& options,
+    const std::unordered_set<std::string>& cold_start_classes) {
+  // Basic block tracing assumes whitelist or set of cold start classes.
+  if ((!options.whitelist.empty() &&
+       !is_included(method->get_name()->str(), method->get_class()->c_str(),
+                    options.whitelist)) ||
+      (options.only_cold_start_class &&
+       !is_included(method->get_name()->str(), method->get_class()->c_str(),
+                    cold_start_classes))) {
+    return false;
+  }
+
+  // Blacklist has priority over whitelist or cold start list.
+  if (is_included(method->get_name()->str(), method->get_class()->c_str(),
+                  options.blacklist)) {
+    TRACE(INSTRUMENT, 9, "Blacklist: excluded: %s\n", SHOW(method));
+    return false;
+  }
+
+  TRACE(INSTRUMENT, 9, "Whitelist: included: %s\n", SHOW(method));
+  return true;
+}
+
 // A simple bit-vector basic block instrumentation algorithm
 //
 //  Example) Original CFG
@@ -789,17 +1066,7 @@ void do_basic_block_tracing(DexClass* analysis_cls,
       method_id_name_map;
   auto scope = build_class_scope(stores);
 
-  auto interdex_list = cfg.get_coldstart_classes();
-  std::unordered_set<std::string> cold_start_classes;
-  std::string dex_end_marker0("LDexEndMarker0;");
-  for (auto class_string : interdex_list) {
-    if (class_string == dex_end_marker0) {
-      break;
-    }
-    class_string.back() = '/';
-    cold_start_classes.insert(class_string);
-  }
-  TRACE(INSTRUMENT, 7, "Number of classes: %d\n", cold_start_classes.size());
+  auto cold_start_classes = get_cold_start_classes(cfg);
 
   std::map<size_t /* num_vectors */, int /* count */> bb_vector_stat;
   walk::code(scope, [&](DexMethod* method, IRCode& code) {
@@ -812,24 +1079,9 @@ void do_basic_block_tracing(DexClass* analysis_cls,
       return;
     }
 
-    // Basic block tracing assumes whitelist or set of cold start classes.
-    if ((!options.whitelist.empty() &&
-         !is_included(method->get_name()->str(), method->get_class()->c_str(),
-                      options.whitelist)) ||
-        (options.only_cold_start_class &&
-         !is_included(method->get_name()->str(), method->get_class()->c_str(),
-                      cold_start_classes))) {
+    if (!should_instrument_blocks(method, options, cold_start_classes)) {
       return;
     }
-
-    // Blacklist has priority over whitelist or cold start list.
-    if (is_included(method->get_name()->str(), method->get_class()->c_str(),
-                    options.blacklist)) {
-      TRACE(INSTRUMENT, 9, "Blacklist: excluded: %s\n", SHOW(method));
-      return;
-    }
-
-    TRACE(INSTRUMENT, 9, "Whitelist: included: %s\n", SHOW(method));
     all_methods++;
     method_index = instrument_onBasicBlockBegin(
         &code, method, method_onMethodExit_map, method_index, all_bb_nums,
@@ -855,6 +1107,51 @@ void do_basic_block_tracing(DexClass* analysis_cls,
         (all_method_inst - 1), all_bb_inst, all_methods, all_bb_nums);
 }
 
+void do_basic_block_coverage(DexClass* analysis_cls,
+                             DexStoresVector& stores,
+                             ConfigFiles& cfg,
+                             PassManager& pm,
+                             const InstrumentPass::Options& options) {
+  auto coverage_field =
+      find_state_array(*analysis_cls, "sBasicBlockCoverage",
+                       make_array_type(get_boolean_type()));
+
+  size_t offset = 0;
+  int all_bb_nums = 0;
+  int all_methods = 0;
+  int all_bb_inst = 0;
+  int all_method_inst = 0;
+  std::map<int /*offset*/, std::pair<std::string, int /*number of BBs*/>>
+      method_id_name_map;
+  auto scope = build_class_scope(stores);
+  auto cold_start_classes = get_cold_start_classes(cfg);
+
+  walk::code(scope, [&](DexMethod* method, IRCode& code) {
+    // The runtime side reads the array from the analysis class itself.
+    if (method->get_class() == analysis_cls->get_type()) {
+      return;
+    }
+    if (!should_instrument_blocks(method, options, cold_start_classes)) {
+      return;
+    }
+    all_methods++;
+    offset = instrument_basic_block_coverage(
+        &code, method, coverage_field, offset, all_bb_nums, all_bb_inst,
+        all_method_inst, method_id_name_map);
+  });
+  patch_array_size(*analysis_cls, "sBasicBlockCoverage", offset);
+
+  write_basic_block_index_file(cfg.metafile(options.metadata_file_name),
+                               method_id_name_map);
+
+  TRACE(INSTRUMENT, 3,
+        "Instrumented %d methods and %d blocks, out of %d methods and %d "
+        "blocks\n",
+        all_method_inst, all_bb_inst, all_methods, all_bb_nums);
+  pm.incr_metric("Instrumented", all_method_inst);
+  pm.incr_metric("InstrumentedBlocks", all_bb_inst);
+}
+
 std::unordered_set<std::string> load_blacklist_file(
     const std::string& file_name) {
   // Assume the file simply enumerates blacklisted names.
@@ -929,6 +1226,8 @@ void InstrumentPass::run_pass(DexStoresVector& stores,
     do_simple_method_tracing(analysis_cls, stores, cfg, pm, m_options);
   } else if (m_options.instrumentation_strategy == "basic_block_tracing") {
     do_basic_block_tracing(analysis_cls, stores, cfg, pm, m_options);
+  } else if (m_options.instrumentation_strategy == "basic_block_coverage") {
+    do_basic_block_coverage(analysis_cls, stores, cfg, pm, m_options);
   } else {
     std::cerr << "[InstrumentPass] Unknown instrumentation strategy.\n";
   }
@@ -33,6 +33,8 @@ class InstrumentPass : public Pass {
            m_options.metadata_file_name);
     jw.get("num_stats_per_method", 1, m_options.num_stats_per_method);
     jw.get("only_cold_start_class", true, m_options.only_cold_start_class);
+    jw.get("sampling_strategy", "", m_options.sampling_strategy);
+    jw.get("sampling_period", 64, m_options.sampling_period);
   }
 
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
@@ -47,6 +49,13 @@ class InstrumentPass : public Pass {
     std::string metadata_file_name;
     int64_t num_stats_per_method;
     bool only_cold_start_class;
+    // For simple_method_tracing: "" calls the analysis method on every entry.
+    // "every_nth" bumps a per-method counter in sMethodCounters, and only
+    // calls it on every sampling_period-th entry, starting with the first.
+    // "first_execution" only calls it on the first entry, which is recorded
+    // as a per-method bit in sMethodBitmap.
+    std::string sampling_strategy;
+    int64_t sampling_period;
   };
 
  private:
@@ -0,0 +1,243 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ColdStartLayoutPlugin.h"
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "IRCode.h"
+#include "MutablePriorityQueue.h"
+#include "PassManager.h"
+#include "Walkers.h"
+
+namespace interdex {
+
+namespace {
+
+constexpr size_t PAGE_SIZE = 4096;
+
+// Refs that more classes of a group share say little about which of those
+// classes belong together, and would make placing a class quadratic.
+constexpr size_t MAX_CLASSES_PER_REF = 32;
+
+template <class Fn>
+void for_each_method(const DexClass* cls, Fn fn) {
+  for (auto method : cls->get_dmethods()) {
+    fn(method);
+  }
+  for (auto method : cls->get_vmethods()) {
+    fn(method);
+  }
+}
+
+uint64_t class_profiles(const DexClass* cls,
+                        const ProfiledMethods* profiled_methods) {
+  uint64_t profiles = 0;
+  if (profiled_methods == nullptr) {
+    return profiles;
+  }
+  for_each_method(cls, [&](const DexMethod* method) {
+    for (size_t p = 0; p < profiled_methods->num_profiles(); ++p) {
+      if (profiled_methods->in_profile(method, p)) {
+        profiles |= uint64_t(1) << p;
+      }
+    }
+  });
+  return profiles;
+}
+
+double group_importance(uint64_t profiles,
+                        const ProfiledMethods* profiled_methods) {
+  double importance = 0;
+  for (size_t p = 0; profiles != 0; ++p, profiles >>= 1) {
+    if (profiles & 1) {
+      importance += profiled_methods->profile(p).importance;
+    }
+  }
+  return importance;
+}
+
+// Greedily orders a group of classes so that each class comes right after
+// the classes it shares the most refs with.
+std::vector<DexClass*> cluster_by_refs(
+    const std::vector<DexClass*>& group,
+    const CrossDexRefMinimizerConfig& config) {
+  always_assert(group.size() < (1 << 24));
+  std::vector<WeightedRefs> refs(group.size());
+  std::unordered_map<void*, std::vector<uint32_t>> ref_classes;
+  for (uint32_t i = 0; i < group.size(); ++i) {
+    refs[i] = gather_weighted_refs(group[i], config);
+    for (const auto& ref : refs[i]) {
+      ref_classes[ref.first].push_back(i);
+    }
+  }
+
+  // The score of a class is the weight of the refs it shares with the classes
+  // placed so far. Ties go to the class that came first.
+  std::vector<uint64_t> scores(group.size(), 0);
+  auto priority = [&](uint32_t i) {
+    auto score = std::min(scores[i], (UINT64_C(1) << 40) - 1);
+    return (score << 24) | (0xFFFFFF - i);
+  };
+  MutablePriorityQueue<uint32_t, uint64_t> queue;
+  for (uint32_t i = 0; i < group.size(); ++i) {
+    queue.insert(i, priority(i));
+  }
+  std::vector<bool> placed(group.size(), false);
+  std::vector<DexClass*> ordered;
+  ordered.reserve(group.size());
+  while (!queue.empty()) {
+    auto i = queue.front();
+    queue.erase(i);
+    placed[i] = true;
+    ordered.push_back(group[i]);
+    for (const auto& ref : refs[i]) {
+      const auto& classes = ref_classes.at(ref.first);
+      if (classes.size() > MAX_CLASSES_PER_REF) {
+        continue;
+      }
+      for (auto j : classes) {
+        if (!placed[j]) {
+          scores[j] += ref.second;
+          queue.update_priority(j, priority(j));
+        }
+      }
+    }
+  }
+  return ordered;
+}
+
+size_t estimate_size(const DexClass* cls) {
+  // A class_def_item, and the rough size of the class_data_item and the code
+  // items.
+  size_t size = 32;
+  size += 4 * (cls->get_sfields().size() + cls->get_ifields().size());
+  for_each_method(cls, [&](const DexMethod* method) {
+    size += 8;
+    auto code = method->get_code();
+    if (code != nullptr) {
+      size += 16 + 2 * code->sum_opcode_sizes();
+    }
+  });
+  return size;
+}
+
+} // namespace
+
+std::vector<DexClass*> order_for_startup(
+    const std::vector<DexClass*>& classes,
+    const ProfiledMethods* profiled_methods,
+    const CrossDexRefMinimizerConfig& config) {
+  // Group the classes, keeping the groups in order of first appearance.
+  std::vector<uint64_t> group_keys;
+  std::unordered_map<uint64_t, std::vector<DexClass*>> groups;
+  for (auto cls : classes) {
+    auto profiles = class_profiles(cls, profiled_methods);
+    auto& group = groups[profiles];
+    if (group.empty()) {
+      group_keys.push_back(profiles);
+    }
+    group.push_back(cls);
+  }
+  if (profiled_methods != nullptr) {
+    std::stable_sort(group_keys.begin(), group_keys.end(),
+                     [&](uint64_t a, uint64_t b) {
+                       if ((a == 0) != (b == 0)) {
+                         return b == 0;
+                       }
+                       return group_importance(a, profiled_methods) >
+                              group_importance(b, profiled_methods);
+                     });
+  }
+  std::vector<DexClass*> clustered;
+  clustered.reserve(classes.size());
+  for (auto key : group_keys) {
+    auto group = cluster_by_refs(groups.at(key), config);
+    clustered.insert(clustered.end(), group.begin(), group.end());
+  }
+
+  // Supertypes that are defined in this dex must come first.
+  std::unordered_map<const DexType*, DexClass*> classes_by_type;
+  for (auto cls : classes) {
+    classes_by_type.emplace(cls->get_type(), cls);
+  }
+  std::unordered_set<DexClass*> emitted;
+  std::vector<DexClass*> ordered;
+  ordered.reserve(classes.size());
+  std::function<void(DexClass*)> emit = [&](DexClass* cls) {
+    if (!emitted.insert(cls).second) {
+      return;
+    }
+    auto emit_type = [&](const DexType* type) {
+      auto it = classes_by_type.find(type);
+      if (it != classes_by_type.end()) {
+        emit(it->second);
+      }
+    };
+    emit_type(cls->get_super_class());
+    for (auto intf : cls->get_interfaces()->get_type_list()) {
+      emit_type(intf);
+    }
+    ordered.push_back(cls);
+  };
+  for (auto cls : clustered) {
+    emit(cls);
+  }
+  return ordered;
+}
+
+size_t estimate_startup_pages(const std::vector<DexClass*>& classes,
+                              const ProfiledMethods* profiled_methods) {
+  std::unordered_set<size_t> pages;
+  size_t offset = 0;
+  for (auto cls : classes) {
+    auto size = estimate_size(cls);
+    if (profiled_methods == nullptr ||
+        class_profiles(cls, profiled_methods) != 0) {
+      for (size_t page = offset / PAGE_SIZE;
+           page <= (offset + size - 1) / PAGE_SIZE; ++page) {
+        pages.insert(page);
+      }
+    }
+    offset += size;
+  }
+  return pages.size();
+}
+
+void ColdStartLayoutPlugin::configure(const Scope& original_scope,
+                                      ConfigFiles& cfg) {
+  const auto& profiles = cfg.get_method_profiles();
+  if (profiles.empty()) {
+    return;
+  }
+  std::vector<DexMethod*> methods;
+  walk::methods(original_scope,
+                [&](DexMethod* method) { methods.push_back(method); });
+  m_profiled_methods = std::make_unique<ProfiledMethods>(profiles, methods);
+}
+
+void ColdStartLayoutPlugin::reorder_classes(const DexInfo& dex_info,
+                                            DexClasses* classes) {
+  if (dex_info.primary || !dex_info.coldstart) {
+    return;
+  }
+  auto profiled_methods = m_profiled_methods.get();
+  auto pages_before = estimate_startup_pages(*classes, profiled_methods);
+  *classes = order_for_startup(*classes, profiled_methods, m_config);
+  auto pages_after = estimate_startup_pages(*classes, profiled_methods);
+  TRACE(IDEX, 2,
+        "[coldstart layout]: %lu classes, estimated startup pages %lu -> %lu\n",
+        classes->size(), pages_before, pages_after);
+  m_mgr.incr_metric(METRIC_COLDSTART_LAYOUT_DEXES, 1);
+  m_mgr.incr_metric(METRIC_COLDSTART_LAYOUT_PAGES_BEFORE, pages_before);
+  m_mgr.incr_metric(METRIC_COLDSTART_LAYOUT_PAGES_AFTER, pages_after);
+}
+
+} // namespace interdex
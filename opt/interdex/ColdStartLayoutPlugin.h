@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "CrossDexRefMinimizer.h"
+#include "DexClass.h"
+#include "InterDexPassPlugin.h"
+#include "MethodProfiles.h"
+
+class PassManager;
+
+namespace interdex {
+
+constexpr const char* COLDSTART_LAYOUT_PLUGIN = "COLDSTART_LAYOUT_PLUGIN";
+
+constexpr const char* METRIC_COLDSTART_LAYOUT_DEXES = "coldstart_layout_dexes";
+constexpr const char* METRIC_COLDSTART_LAYOUT_PAGES_BEFORE =
+    "coldstart_layout_pages_before";
+constexpr const char* METRIC_COLDSTART_LAYOUT_PAGES_AFTER =
+    "coldstart_layout_pages_after";
+
+/*
+ * Orders `classes`, the classes of a dex, so that the classes that are used
+ * together at startup are next to each other:
+ *  - Classes are grouped by the set of method profiles that their methods
+ *    appear in. The groups of the most important profiles come first, and the
+ *    classes that appear in no profile go last.
+ *  - Within a group, each next class is the one that shares the most refs
+ *    with the classes placed so far, as weighted by `config`. Refs that many
+ *    classes of the group share don't tell the classes apart, and are
+ *    ignored. Ties keep the original order.
+ *  - Finally, superclasses and interfaces are moved in front of the classes
+ *    of the dex that extend them, as the dex format requires.
+ * `profiled_methods` may be null, in which case all classes are in one group.
+ */
+std::vector<DexClass*> order_for_startup(
+    const std::vector<DexClass*>& classes,
+    const ProfiledMethods* profiled_methods,
+    const CrossDexRefMinimizerConfig& config);
+
+/*
+ * A rough estimate of the number of pages of the dex that are touched at
+ * startup: the classes are assumed to take up consecutive space in the given
+ * order, as much as their class definitions and code roughly take up, and a
+ * page is touched if it overlaps a class with a profiled method. Without
+ * profiles, every class counts as touched.
+ */
+size_t estimate_startup_pages(const std::vector<DexClass*>& classes,
+                              const ProfiledMethods* profiled_methods);
+
+/*
+ * Applies order_for_startup() to the secondary coldstart dexes, and records
+ * the estimated startup pages of those dexes before and after.
+ */
+class ColdStartLayoutPlugin : public InterDexPassPlugin {
+ public:
+  ColdStartLayoutPlugin(const CrossDexRefMinimizerConfig& config,
+                        PassManager& mgr)
+      : m_config(config), m_mgr(mgr) {}
+
+  void configure(const Scope& original_scope, ConfigFiles& cfg) override;
+
+  bool should_skip_class(const DexClass*) override { return false; }
+
+  void gather_refs(const DexClass*,
+                   std::vector<DexMethodRef*>&,
+                   std::vector<DexFieldRef*>&,
+                   std::vector<DexType*>&,
+                   std::vector<DexClass*>*) override {}
+
+  DexClasses additional_classes(const DexClassesVector&,
+                                const DexClasses&) override {
+    return DexClasses();
+  }
+
+  void reorder_classes(const DexInfo& dex_info, DexClasses* classes) override;
+
+  void cleanup(const std::vector<DexClass*>&) override {
+    m_profiled_methods.reset();
+  }
+
+ private:
+  const CrossDexRefMinimizerConfig m_config;
+  PassManager& m_mgr;
+  std::unique_ptr<ProfiledMethods> m_profiled_methods;
+};
+
+} // namespace interdex
@@ -10,6 +10,7 @@
 
 #include "CrossDexRefMinimizer.h"
 #include "DexUtil.h"
+#include "Parallel.h"
 
 namespace interdex {
 
@@ -67,17 +68,36 @@ uint64_t CrossDexRefMinimizer::ClassInfo::get_priority() const {
   return (primary_priority << 24) | secondary_priority;
 }
 
-void CrossDexRefMinimizer::reprioritize(
-    const std::unordered_map<DexClass*, CrossDexRefMinimizer::ClassInfoDelta>&
-        affected_classes) {
+CrossDexRefMinimizer::ClassInfoDelta& CrossDexRefMinimizer::delta(
+    uint32_t index) {
+  auto& d = m_deltas[index];
+  if (!d.affected) {
+    d.affected = true;
+    m_affected_classes.push_back(index);
+  }
+  return d;
+}
+
+template <class Fn>
+void CrossDexRefMinimizer::for_each_class(const RefClasses& ref_classes,
+                                          Fn fn) const {
+  for (uint32_t index : ref_classes.indices) {
+    if (!m_class_infos[index].erased) {
+      fn(index);
+    }
+  }
+}
+
+void CrossDexRefMinimizer::reprioritize() {
   TRACE(IDEX, 4, "[dex ordering] Reprioritizing %u classes\n",
-        affected_classes.size());
-  for (auto p : affected_classes) {
+        m_affected_classes.size());
+  std::vector<std::pair<DexClass*, uint64_t>> updates;
+  updates.reserve(m_affected_classes.size());
+  for (uint32_t index : m_affected_classes) {
     ++m_stats.reprioritizations;
-    DexClass* affected_class = p.first;
-    CrossDexRefMinimizer::ClassInfoDelta& delta = p.second;
+    CrossDexRefMinimizer::ClassInfoDelta& delta = m_deltas[index];
     CrossDexRefMinimizer::ClassInfo& affected_class_info =
-        m_class_infos.at(affected_class);
+        m_class_infos[index];
     affected_class_info.applied_refs_weight += delta.applied_refs_weight;
     for (size_t i = 0; i < INFREQUENT_REFS_COUNT; ++i) {
       affected_class_info.infrequent_refs_weight[i] +=
@@ -85,29 +105,26 @@ void CrossDexRefMinimizer::reprioritize(
     }
 
     const auto priority = affected_class_info.get_priority();
-    m_prioritized_classes.update_priority(affected_class, priority);
+    updates.emplace_back(affected_class_info.cls, priority);
     TRACE(
         IDEX, 5,
         "[dex ordering] Reprioritized class {%s} with priority %016lx; "
         "index %u; %u (delta %d) applied refs weight, %s (delta %s) infrequent "
         "refs weights, %u total refs\n",
-        SHOW(affected_class), priority, affected_class_info.index,
+        SHOW(affected_class_info.cls), priority, affected_class_info.index,
         affected_class_info.applied_refs_weight, delta.applied_refs_weight,
         format_infrequent_refs_array(affected_class_info.infrequent_refs_weight)
             .c_str(),
         format_infrequent_refs_array(delta.infrequent_refs_weight).c_str(),
         affected_class_info.refs.size());
+    delta = ClassInfoDelta();
   }
+  m_affected_classes.clear();
+  m_prioritized_classes.update_priorities(updates);
 }
 
-void CrossDexRefMinimizer::insert(DexClass* cls) {
-  always_assert(m_class_infos.count(cls) == 0);
-  ++m_stats.classes;
-  CrossDexRefMinimizer::ClassInfo& class_info =
-      m_class_infos
-          .insert({cls, CrossDexRefMinimizer::ClassInfo(m_next_index++)})
-          .first->second;
-
+WeightedRefs gather_weighted_refs(DexClass* cls,
+                                  const CrossDexRefMinimizerConfig& config) {
   // Collect all relevant references that contribute to cross-dex metadata
   // entries.
   // We don't bother with protos and type_lists, as they are directly related
@@ -124,8 +141,7 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
   sort_unique(types);
   cls->gather_strings(strings);
   sort_unique(strings);
-  auto& refs = class_info.refs;
-  uint64_t refs_weight = 0;
+  WeightedRefs refs;
   refs.reserve(method_refs.size() + field_refs.size() + types.size() +
                strings.size());
 
@@ -134,43 +150,73 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
   // different values and observing the effect on APK size.
   // TODO: Try some other variations.
   for (auto mref : method_refs) {
-    uint32_t weight = m_config.method_ref_weight;
-    refs.emplace_back(mref, weight);
-    refs_weight += weight;
+    refs.emplace_back(mref, config.method_ref_weight);
   }
   for (auto type : types) {
-    uint32_t weight = m_config.type_ref_weight;
-    refs.emplace_back(type, weight);
-    refs_weight += weight;
+    refs.emplace_back(type, config.type_ref_weight);
   }
   for (auto string : strings) {
-    uint32_t weight = m_config.string_ref_weight;
-    refs.emplace_back(string, weight);
-    refs_weight += weight;
+    refs.emplace_back(string, config.string_ref_weight);
   }
   for (auto fref : field_refs) {
-    uint32_t weight = m_config.field_ref_weight;
-    refs.emplace_back(fref, weight);
-    refs_weight += weight;
+    refs.emplace_back(fref, config.field_ref_weight);
+  }
+  return refs;
+}
+
+CrossDexRefMinimizer::Refs CrossDexRefMinimizer::gather_refs(
+    DexClass* cls) const {
+  return gather_weighted_refs(cls, m_config);
+}
+
+void CrossDexRefMinimizer::insert(DexClass* cls) {
+  insert(cls, gather_refs(cls));
+}
+
+void CrossDexRefMinimizer::insert(const std::vector<DexClass*>& classes) {
+  // Gathering the refs of a class only reads it, so that part runs in
+  // parallel; inserting the classes updates the shared state, in order.
+  std::vector<std::pair<DexClass*, Refs>> gathered;
+  gathered.reserve(classes.size());
+  for (auto cls : classes) {
+    gathered.emplace_back(cls, Refs());
+  }
+  parallel_for(gathered.begin(), gathered.end(),
+               [this](std::pair<DexClass*, Refs>& p) {
+                 p.second = gather_refs(p.first);
+               });
+  for (auto& p : gathered) {
+    insert(p.first, std::move(p.second));
+  }
+}
+
+void CrossDexRefMinimizer::insert(DexClass* cls, Refs refs) {
+  always_assert(m_class_indices.count(cls) == 0);
+  ++m_stats.classes;
+  uint32_t index = m_class_infos.size();
+  m_class_indices.emplace(cls, index);
+  m_class_infos.emplace_back(cls, index);
+  m_deltas.emplace_back();
+  CrossDexRefMinimizer::ClassInfo& class_info = m_class_infos.back();
+  uint64_t refs_weight = 0;
+  for (const auto& p : refs) {
+    refs_weight += p.second;
   }
   class_info.refs_weight = refs_weight;
 
-  std::unordered_map<DexClass*, CrossDexRefMinimizer::ClassInfoDelta>
-      affected_classes;
   for (const std::pair<void*, uint32_t>& p : refs) {
     void* ref = p.first;
     uint32_t weight = p.second;
     auto& classes = m_ref_classes[ref];
-    size_t frequency = classes.size();
+    size_t frequency = classes.size;
     // We record the need to undo (subtract weight of) a previously claimed
     // infrequent ref. The actual undoing happens later in
     // reprioritize.
     if (frequency > 0 && frequency <= INFREQUENT_REFS_COUNT) {
-      for (DexClass* affected_class : classes) {
-        always_assert(affected_class != cls);
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] -= weight;
-      }
+      for_each_class(classes, [&](uint32_t affected_index) {
+        always_assert(affected_index != index);
+        delta(affected_index).infrequent_refs_weight[frequency - 1] -= weight;
+      });
     }
     ++frequency;
     // We are recording a new infrequent unapplied ref, if any.
@@ -179,17 +225,17 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
     // class_info.get_priority() call, while all other change requests happen
     // later in reprioritize.
     if (frequency <= INFREQUENT_REFS_COUNT) {
-      for (DexClass* affected_class : classes) {
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] += weight;
-      }
+      for_each_class(classes, [&](uint32_t affected_index) {
+        delta(affected_index).infrequent_refs_weight[frequency - 1] += weight;
+      });
       class_info.infrequent_refs_weight[frequency - 1] += weight;
     }
 
-    // There's an implicit invariant that class_info and the keys of
-    // affected_classes are disjoint, so we are not going to reprioritize
+    // There's an implicit invariant that class_info and the affected
+    // classes are disjoint, so we are not going to reprioritize
     // the class that we are adding here.
-    classes.emplace(cls);
+    classes.indices.push_back(index);
+    ++classes.size;
   }
   const auto priority = class_info.get_priority();
   m_prioritized_classes.insert(cls, priority);
@@ -199,7 +245,8 @@ void CrossDexRefMinimizer::insert(DexClass* cls) {
         SHOW(cls), priority, class_info.index,
         format_infrequent_refs_array(class_info.infrequent_refs_weight).c_str(),
         refs.size());
-  reprioritize(affected_classes);
+  class_info.refs = std::move(refs);
+  reprioritize();
 }
 
 bool CrossDexRefMinimizer::empty() const {
@@ -211,33 +258,39 @@ DexClass* CrossDexRefMinimizer::front() const {
 }
 
 DexClass* CrossDexRefMinimizer::worst() const {
-  auto max_it = m_class_infos.begin();
-  for (auto it = m_class_infos.begin(); it != m_class_infos.end(); ++it) {
-    const CrossDexRefMinimizer::ClassInfo& max_class_info = max_it->second;
-    const CrossDexRefMinimizer::ClassInfo& class_info = it->second;
-    if (class_info.get_primary_priority_denominator() >
-        max_class_info.get_primary_priority_denominator()) {
-      max_it = it;
+  const CrossDexRefMinimizer::ClassInfo* max_class_info = nullptr;
+  for (const auto& class_info : m_class_infos) {
+    if (class_info.erased) {
+      continue;
+    }
+    if (max_class_info == nullptr ||
+        class_info.get_primary_priority_denominator() >
+            max_class_info->get_primary_priority_denominator()) {
+      max_class_info = &class_info;
     }
   }
+  always_assert(max_class_info != nullptr);
 
   TRACE(IDEX, 3,
         "[dex ordering] Picked worst class {%s} with priority %016lx; "
         "index %u; %u applied refs weight, %s infrequent refs weights, %u "
         "total refs\n",
-        SHOW(max_it->first), max_it->second.get_priority(),
-        max_it->second.index, max_it->second.applied_refs_weight,
-        format_infrequent_refs_array(max_it->second.infrequent_refs_weight)
+        SHOW(max_class_info->cls), max_class_info->get_priority(),
+        max_class_info->index, max_class_info->applied_refs_weight,
+        format_infrequent_refs_array(max_class_info->infrequent_refs_weight)
             .c_str(),
-        max_it->second.refs.size());
-  return max_it->first;
+        max_class_info->refs.size());
+  return max_class_info->cls;
 }
 
 void CrossDexRefMinimizer::erase(DexClass* cls, bool emitted, bool reset) {
   m_prioritized_classes.erase(cls);
-  auto class_info_it = m_class_infos.find(cls);
-  always_assert(class_info_it != m_class_infos.end());
-  const CrossDexRefMinimizer::ClassInfo& class_info = class_info_it->second;
+  auto class_index_it = m_class_indices.find(cls);
+  always_assert(class_index_it != m_class_indices.end());
+  uint32_t index = class_index_it->second;
+  m_class_indices.erase(class_index_it);
+  CrossDexRefMinimizer::ClassInfo& class_info = m_class_infos[index];
+  always_assert(!class_info.erased);
   TRACE(IDEX, 3,
         "[dex ordering] Processing class {%s} with priority %016lx; "
         "index %u; %u applied refs weight, %s infrequent refs weights, %u "
@@ -256,30 +309,32 @@ void CrossDexRefMinimizer::erase(DexClass* cls, bool emitted, bool reset) {
     m_applied_refs.clear();
   }
 
-  std::unordered_map<DexClass*, CrossDexRefMinimizer::ClassInfoDelta>
-      affected_classes;
+  class_info.erased = true;
   const auto& refs = class_info.refs;
   size_t old_applied_refs = m_applied_refs.size();
   for (const std::pair<void*, uint32_t>& p : refs) {
     void* ref = p.first;
     uint32_t weight = p.second;
     auto& classes = m_ref_classes.at(ref);
-    size_t frequency = classes.size();
+    size_t frequency = classes.size;
     always_assert(frequency > 0);
-    const auto erased = classes.erase(cls);
-    always_assert(erased);
+    --classes.size;
+    if (classes.size * 2 < classes.indices.size()) {
+      classes.indices.erase(
+          std::remove_if(classes.indices.begin(), classes.indices.end(),
+                         [this](uint32_t i) { return m_class_infos[i].erased; }),
+          classes.indices.end());
+    }
     if (frequency <= INFREQUENT_REFS_COUNT) {
-      for (DexClass* affected_class : classes) {
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] -= weight;
-      }
+      for_each_class(classes, [&](uint32_t affected_index) {
+        delta(affected_index).infrequent_refs_weight[frequency - 1] -= weight;
+      });
     }
     --frequency;
     if (frequency > 0 && frequency <= INFREQUENT_REFS_COUNT) {
-      for (DexClass* affected_class : classes) {
-        affected_classes[affected_class]
-            .infrequent_refs_weight[frequency - 1] += weight;
-      }
+      for_each_class(classes, [&](uint32_t affected_index) {
+        delta(affected_index).infrequent_refs_weight[frequency - 1] += weight;
+      });
     }
 
     if (!emitted) {
@@ -289,25 +344,24 @@ void CrossDexRefMinimizer::erase(DexClass* cls, bool emitted, bool reset) {
       continue;
     }
     m_applied_refs.emplace(ref);
-    for (DexClass* affected_class : classes) {
-      affected_classes[affected_class].applied_refs_weight += weight;
-    }
+    for_each_class(classes, [&](uint32_t affected_index) {
+      delta(affected_index).applied_refs_weight += weight;
+    });
   }
 
   // Updating m_class_infos and m_prioritized_classes
 
-  m_class_infos.erase(class_info_it);
-  always_assert(m_class_infos.count(cls) == 0);
+  class_info.refs = std::vector<std::pair<void*, uint32_t>>();
 
   if (reset) {
-    m_prioritized_classes.clear();
-    for (auto it = m_class_infos.begin(); it != m_class_infos.end(); ++it) {
-      DexClass* reset_class = it->first;
-      CrossDexRefMinimizer::ClassInfo& reset_class_info = it->second;
+    // All the remaining classes lose their applied refs, and get reinserted
+    // in one go, together with the deltas gathered above.
+    for (auto& reset_class_info : m_class_infos) {
+      if (reset_class_info.erased) {
+        continue;
+      }
       reset_class_info.applied_refs_weight = 0;
-      const auto priority = reset_class_info.get_priority();
-      m_prioritized_classes.insert(reset_class, priority);
-      always_assert(reset_class_info.applied_refs_weight == 0);
+      delta(reset_class_info.index);
     }
   }
   if (emitted) {
@@ -315,7 +369,7 @@ void CrossDexRefMinimizer::erase(DexClass* cls, bool emitted, bool reset) {
           old_applied_refs, m_applied_refs.size() - old_applied_refs,
           m_applied_refs.size());
   }
-  reprioritize(affected_classes);
+  reprioritize();
 }
 
 } // namespace interdex
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <unordered_map>
+#include <array>
 #include <unordered_set>
 #include <vector>
 
@@ -40,6 +41,13 @@ struct CrossDexRefMinimizerConfig {
   size_t string_ref_weight;
 };
 
+using WeightedRefs = std::vector<std::pair<void*, uint32_t>>;
+
+// The *refs of a class that contribute to cross-dex metadata entries, each
+// with its weight from the config.
+WeightedRefs gather_weighted_refs(DexClass* cls,
+                                  const CrossDexRefMinimizerConfig& config);
+
 // Helper class that maintains a set of dex classes with associated priorities
 // based on the *ref needs of the class and the *refs already added
 // to the current dex.
@@ -74,6 +82,7 @@ class CrossDexRefMinimizer {
   PrioritizedDexClasses m_prioritized_classes;
   std::unordered_set<void*> m_applied_refs;
   struct ClassInfo {
+    DexClass* cls;
     uint32_t index;
     // This array stores (the weights of) how many of the *refs of this class
     // have only one, two, ... classes left that reference them.
@@ -81,31 +90,58 @@ class CrossDexRefMinimizer {
     std::vector<std::pair<void*, uint32_t>> refs;
     uint64_t refs_weight;
     uint64_t applied_refs_weight;
-    ClassInfo(uint32_t i)
-        : index(i),
+    // Whether the class was erased.
+    bool erased;
+    ClassInfo(DexClass* c, uint32_t i)
+        : cls(c),
+          index(i),
           infrequent_refs_weight(),
           refs_weight(0),
-          applied_refs_weight(0) {}
+          applied_refs_weight(0),
+          erased(false) {}
     uint64_t get_primary_priority_denominator() const;
     uint64_t get_priority() const;
   };
-  std::unordered_map<DexClass*, ClassInfo> m_class_infos;
-  uint32_t m_next_index{0};
-  std::unordered_map<void*, std::unordered_set<DexClass*>> m_ref_classes;
+  // Indexed by ClassInfo::index.
+  std::vector<ClassInfo> m_class_infos;
+  std::unordered_map<DexClass*, uint32_t> m_class_indices;
+  // The indices of the classes that have a given *ref, in increasing order.
+  // Erased classes are only dropped from the vector once they make up half of
+  // it, so that erasing a class from the set of a *ref that most classes
+  // have is amortized constant time.
+  struct RefClasses {
+    std::vector<uint32_t> indices;
+    size_t size{0};
+  };
+  std::unordered_map<void*, RefClasses> m_ref_classes;
   CrossDexRefMinimizerStats m_stats;
   const CrossDexRefMinimizerConfig m_config;
 
   struct ClassInfoDelta {
     std::array<int32_t, INFREQUENT_REFS_COUNT> infrequent_refs_weight{};
     int64_t applied_refs_weight{0};
+    bool affected{false};
   };
-  void reprioritize(
-      const std::unordered_map<DexClass*, ClassInfoDelta>& affected_classes);
+  // Indexed by ClassInfo::index, and only non-zero for the classes in
+  // m_affected_classes, between the gathering of the deltas and reprioritize.
+  std::vector<ClassInfoDelta> m_deltas;
+  std::vector<uint32_t> m_affected_classes;
+  ClassInfoDelta& delta(uint32_t index);
+  template <class Fn>
+  void for_each_class(const RefClasses& ref_classes, Fn fn) const;
+  void reprioritize();
+
+  using Refs = WeightedRefs;
+  Refs gather_refs(DexClass* cls) const;
+  void insert(DexClass* cls, Refs refs);
 
  public:
   CrossDexRefMinimizer(const CrossDexRefMinimizerConfig& config)
       : m_config(config) {}
   void insert(DexClass* cls);
+  // Same as inserting the classes one by one, in order, but gathers their
+  // refs in parallel.
+  void insert(const std::vector<DexClass*>& classes);
   bool empty() const;
   DexClass* front() const;
   // "Worst" in the sense of having the biggest (adjusted) unapplied refs
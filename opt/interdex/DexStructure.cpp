@@ -75,22 +75,6 @@ unsigned estimate_linear_alloc(const DexClass* clazz) {
   return lasize;
 }
 
-/**
- * Removes the elements of b from a. Runs in O(size(a)), so it works best if
- * size(a) << size(b).
- */
-template <typename T>
-std::unordered_set<T> set_difference(const std::unordered_set<T>& a,
-                                     const std::unordered_set<T>& b) {
-  std::unordered_set<T> result;
-  for (auto& v : a) {
-    if (!b.count(v)) {
-      result.emplace(v);
-    }
-  }
-  return result;
-}
-
 } // namespace
 
 namespace interdex {
@@ -102,9 +86,9 @@ bool DexesStructure::add_class_to_current_dex(const MethodRefs& clazz_mrefs,
   always_assert_log(m_classes.count(clazz) == 0,
                     "Can't emit the same class twice!\n", SHOW(clazz));
 
-  if (m_current_dex.add_class_if_fits(clazz_mrefs, clazz_frefs, clazz_trefs,
-                                      m_linear_alloc_limit, m_type_refs_limit,
-                                      clazz)) {
+  if (m_current_dex.add_class_if_fits(
+          get_ids(clazz_mrefs, clazz_frefs, clazz_trefs), m_linear_alloc_limit,
+          m_type_refs_limit, clazz)) {
     update_stats(clazz_mrefs, clazz_frefs, clazz);
     m_classes.emplace(clazz);
     return true;
@@ -121,8 +105,8 @@ void DexesStructure::add_class_no_checks(const MethodRefs& clazz_mrefs,
                     "Can't emit the same class twice: %s!\n", SHOW(clazz));
 
   auto laclazz = estimate_linear_alloc(clazz);
-  m_current_dex.add_class_no_checks(clazz_mrefs, clazz_frefs, clazz_trefs,
-                                    laclazz, clazz);
+  m_current_dex.add_class_no_checks(
+      get_ids(clazz_mrefs, clazz_frefs, clazz_trefs), laclazz, clazz);
   m_classes.emplace(clazz);
   update_stats(clazz_mrefs, clazz_frefs, clazz);
 }
@@ -150,7 +134,7 @@ DexClasses DexesStructure::end_dex(DexInfo dex_info) {
     m_info.num_scroll_dexes++;
   }
 
-  m_current_dex.check_refs_count();
+  m_current_dex.check_refs_count(m_mref_ids, m_fref_ids);
 
   DexClasses all_classes = m_current_dex.take_all_classes();
 
@@ -158,6 +142,16 @@ DexClasses DexesStructure::end_dex(DexInfo dex_info) {
   return all_classes;
 }
 
+ClassRefIds DexesStructure::get_ids(const MethodRefs& clazz_mrefs,
+                                    const FieldRefs& clazz_frefs,
+                                    const TypeRefs& clazz_trefs) {
+  ClassRefIds ids;
+  ids.mrefs = m_mref_ids.get_or_assign(clazz_mrefs);
+  ids.frefs = m_fref_ids.get_or_assign(clazz_frefs);
+  ids.trefs = m_tref_ids.get_or_assign(clazz_trefs);
+  return ids;
+}
+
 void DexesStructure::update_stats(const MethodRefs& clazz_mrefs,
                                   const FieldRefs& clazz_frefs,
                                   DexClass* clazz) {
@@ -172,9 +166,7 @@ void DexesStructure::update_stats(const MethodRefs& clazz_mrefs,
   m_stats.num_frefs += clazz_frefs.size();
 }
 
-bool DexStructure::add_class_if_fits(const MethodRefs& clazz_mrefs,
-                                     const FieldRefs& clazz_frefs,
-                                     const TypeRefs& clazz_trefs,
+bool DexStructure::add_class_if_fits(const ClassRefIds& clazz_refs,
                                      size_t linear_alloc_limit,
                                      size_t type_refs_limit,
                                      DexClass* clazz) {
@@ -188,41 +180,39 @@ bool DexStructure::add_class_if_fits(const MethodRefs& clazz_mrefs,
     return false;
   }
 
-  auto extra_mrefs = set_difference(clazz_mrefs, m_mrefs);
-  auto extra_frefs = set_difference(clazz_frefs, m_frefs);
-  auto extra_trefs = set_difference(clazz_trefs, m_trefs);
+  auto extra_mrefs = m_mrefs.count_missing(clazz_refs.mrefs);
+  auto extra_frefs = m_frefs.count_missing(clazz_refs.frefs);
+  auto extra_trefs = m_trefs.count_missing(clazz_refs.trefs);
 
-  if (m_mrefs.size() + extra_mrefs.size() >= MAX_METHOD_REFS ||
-      m_frefs.size() + extra_frefs.size() >= MAX_FIELD_REFS) {
+  if (m_mrefs.size() + extra_mrefs >= MAX_METHOD_REFS ||
+      m_frefs.size() + extra_frefs >= MAX_FIELD_REFS) {
     TRACE(IDEX, 6,
           "[warning]: Class won't fit current dex since it will go "
           "over the method or field refs limit: %d / %d : %s\n",
-          m_mrefs.size() + extra_mrefs.size(),
-          m_frefs.size() + extra_frefs.size(), SHOW(clazz));
+          m_mrefs.size() + extra_mrefs, m_frefs.size() + extra_frefs,
+          SHOW(clazz));
     return false;
   }
 
-  if (m_trefs.size() + extra_trefs.size() >= type_refs_limit) {
+  if (m_trefs.size() + extra_trefs >= type_refs_limit) {
     TRACE(IDEX, 6,
           "[warning]: Class won't fit current dex since it will go "
           "over the type refs limit: %d : %s\n",
-          m_trefs.size() + extra_trefs.size(), SHOW(clazz));
+          m_trefs.size() + extra_trefs, SHOW(clazz));
     return false;
   }
 
-  add_class_no_checks(clazz_mrefs, clazz_frefs, clazz_trefs, laclazz, clazz);
+  add_class_no_checks(clazz_refs, laclazz, clazz);
   return true;
 }
 
-void DexStructure::add_class_no_checks(const MethodRefs& clazz_mrefs,
-                                       const FieldRefs& clazz_frefs,
-                                       const TypeRefs& clazz_trefs,
+void DexStructure::add_class_no_checks(const ClassRefIds& clazz_refs,
                                        unsigned laclazz,
                                        DexClass* clazz) {
   TRACE(IDEX, 7, "Adding class: %s\n", SHOW(clazz));
-  m_mrefs.insert(clazz_mrefs.begin(), clazz_mrefs.end());
-  m_frefs.insert(clazz_frefs.begin(), clazz_frefs.end());
-  m_trefs.insert(clazz_trefs.begin(), clazz_trefs.end());
+  m_mrefs.insert(clazz_refs.mrefs);
+  m_frefs.insert(clazz_refs.frefs);
+  m_trefs.insert(clazz_refs.trefs);
   m_linear_alloc_size += laclazz;
   m_classes.push_back(clazz);
 }
@@ -231,7 +221,8 @@ void DexStructure::add_class_no_checks(const MethodRefs& clazz_mrefs,
  * Sanity check: did gather_refs return all the refs that ultimately ended up
  * in the dex?
  */
-void DexStructure::check_refs_count() {
+void DexStructure::check_refs_count(const RefIds<DexMethodRef>& mref_ids,
+                                    const RefIds<DexFieldRef>& fref_ids) {
   std::vector<DexMethodRef*> mrefs;
   for (DexClass* cls : m_classes) {
     cls->gather_methods(mrefs);
@@ -239,7 +230,8 @@ void DexStructure::check_refs_count() {
   std::unordered_set<DexMethodRef*> mrefs_set(mrefs.begin(), mrefs.end());
   if (mrefs_set.size() > m_mrefs.size()) {
     for (DexMethodRef* mr : mrefs_set) {
-      if (!m_mrefs.count(mr)) {
+      uint32_t id;
+      if (!mref_ids.find(mr, &id) || !m_mrefs.contains(id)) {
         TRACE(IDEX, 4, "WARNING: Could not find %s in predicted mrefs set\n",
               SHOW(mr));
       }
@@ -253,7 +245,8 @@ void DexStructure::check_refs_count() {
   std::unordered_set<DexFieldRef*> frefs_set(frefs.begin(), frefs.end());
   if (frefs_set.size() > m_frefs.size()) {
     for (auto* fr : frefs_set) {
-      if (!m_frefs.count(fr)) {
+      uint32_t id;
+      if (!fref_ids.find(fr, &id) || !m_frefs.contains(id)) {
         TRACE(IDEX, 4, "WARNING: Could not find %s in predicted frefs set\n",
               SHOW(fr));
       }
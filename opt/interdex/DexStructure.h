@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -20,6 +21,83 @@ using MethodRefs = std::unordered_set<DexMethodRef*>;
 using FieldRefs = std::unordered_set<DexFieldRef*>;
 using TypeRefs = std::unordered_set<DexType*>;
 
+/*
+ * Dense ids for the refs of one kind, assigned in the order the refs are first
+ * seen and shared by all the dexes, so that the refs of a dex can be tracked
+ * in a bitset.
+ */
+template <class Ref>
+class RefIds {
+ public:
+  // Returns the ids of the refs, assigning ids to the refs that have none.
+  std::vector<uint32_t> get_or_assign(const std::unordered_set<Ref*>& refs) {
+    std::vector<uint32_t> ids;
+    ids.reserve(refs.size());
+    for (auto* ref : refs) {
+      ids.push_back(m_ids.emplace(ref, m_ids.size()).first->second);
+    }
+    return ids;
+  }
+
+  // Returns whether the ref has an id, and if so sets *id.
+  bool find(Ref* ref, uint32_t* id) const {
+    auto it = m_ids.find(ref);
+    if (it == m_ids.end()) {
+      return false;
+    }
+    *id = it->second;
+    return true;
+  }
+
+ private:
+  std::unordered_map<Ref*, uint32_t> m_ids;
+};
+
+/*
+ * A set of ref ids.
+ */
+class RefIdSet {
+ public:
+  size_t size() const { return m_size; }
+
+  bool contains(uint32_t id) const {
+    size_t word = id / 64;
+    return word < m_words.size() && ((m_words[word] >> (id % 64)) & 1);
+  }
+
+  // Returns how many of the ids (which must be distinct) are not in the set.
+  size_t count_missing(const std::vector<uint32_t>& ids) const {
+    size_t missing = 0;
+    for (auto id : ids) {
+      missing += !contains(id);
+    }
+    return missing;
+  }
+
+  void insert(const std::vector<uint32_t>& ids) {
+    for (auto id : ids) {
+      size_t word = id / 64;
+      if (word >= m_words.size()) {
+        m_words.resize(word + 1, 0);
+      }
+      uint64_t bit = uint64_t(1) << (id % 64);
+      m_size += !(m_words[word] & bit);
+      m_words[word] |= bit;
+    }
+  }
+
+ private:
+  std::vector<uint64_t> m_words;
+  size_t m_size{0};
+};
+
+// The ids of the refs of a class.
+struct ClassRefIds {
+  std::vector<uint32_t> mrefs;
+  std::vector<uint32_t> frefs;
+  std::vector<uint32_t> trefs;
+};
+
 struct DexInfo {
   bool primary{false};
   bool mixed_mode{false};
@@ -45,26 +123,23 @@ class DexStructure {
   /**
    * Tries to add the specified class. Returns false if it doesn't fit.
    */
-  bool add_class_if_fits(const MethodRefs& clazz_mrefs,
-                         const FieldRefs& clazz_frefs,
-                         const TypeRefs& clazz_trefs,
+  bool add_class_if_fits(const ClassRefIds& clazz_refs,
                          size_t linear_alloc_limit,
                          size_t type_refs_limit,
                          DexClass* clazz);
 
-  void add_class_no_checks(const MethodRefs& clazz_mrefs,
-                           const FieldRefs& clazz_frefs,
-                           const TypeRefs& clazz_trefs,
+  void add_class_no_checks(const ClassRefIds& clazz_refs,
                            unsigned laclazz,
                            DexClass* clazz);
 
-  void check_refs_count();
+  void check_refs_count(const RefIds<DexMethodRef>& mref_ids,
+                        const RefIds<DexFieldRef>& fref_ids);
 
  private:
   size_t m_linear_alloc_size;
-  TypeRefs m_trefs;
-  MethodRefs m_mrefs;
-  FieldRefs m_frefs;
+  RefIdSet m_trefs;
+  RefIdSet m_mrefs;
+  RefIdSet m_frefs;
   std::vector<DexClass*> m_classes;
 };
 
@@ -139,9 +214,17 @@ class DexesStructure {
                     const FieldRefs& clazz_frefs,
                     DexClass* clazz);
 
+  ClassRefIds get_ids(const MethodRefs& clazz_mrefs,
+                      const FieldRefs& clazz_frefs,
+                      const TypeRefs& clazz_trefs);
+
   // NOTE: Keeps track only of the last dex.
   DexStructure m_current_dex;
 
+  RefIds<DexMethodRef> m_mref_ids;
+  RefIds<DexFieldRef> m_fref_ids;
+  RefIds<DexType> m_tref_ids;
+
   // All the classes that end up added in the dexes.
   std::unordered_set<DexClass*> m_classes;
 
@@ -606,14 +606,16 @@ void InterDex::emit_remaining_classes(const Scope& scope) {
 
   // Emit classes using some algorithm to group together classes which
   // tend to share the same refs.
+  std::vector<DexClass*> classes;
   for (DexClass* cls : scope) {
     // Don't bother with classes that emit_class will skip anyway
     if (is_canary(cls) || m_dexes_structure.has_class(cls) ||
         should_skip_class(EMPTY_DEX_INFO, cls)) {
       continue;
     }
-    m_cross_dex_ref_minimizer.insert(cls);
+    classes.push_back(cls);
   }
+  m_cross_dex_ref_minimizer.insert(classes);
 
   int dexnum = m_dexes_structure.get_num_dexes();
   // Strategy for picking the next class to emit:
@@ -776,6 +778,9 @@ void InterDex::flush_out_dex(DexInfo dex_info) {
   }
 
   m_outdex.emplace_back(m_dexes_structure.end_dex(dex_info));
+  for (auto& plugin : m_plugins) {
+    plugin->reorder_classes(dex_info, &m_outdex.back());
+  }
 }
 
 bool InterDex::is_mixed_mode_dex(const DexInfo& dex_info) {
@@ -7,6 +7,7 @@
 
 #include "InterDexPass.h"
 
+#include "ColdStartLayoutPlugin.h"
 #include "ConfigFiles.h"
 #include "DexClass.h"
 #include "DexUtil.h"
@@ -149,6 +150,10 @@ void InterDexPass::configure_pass(const JsonWrapper& jw) {
          m_minimize_cross_dex_refs_config.type_ref_weight);
   jw.get("minimize_cross_dex_refs_string_ref_weight", 90,
          m_minimize_cross_dex_refs_config.string_ref_weight);
+
+  // Reorder the classes of the coldstart dexes to touch fewer pages at
+  // startup. Uses the same ref weights as minimize_cross_dex_refs.
+  jw.get("coldstart_layout", false, m_coldstart_layout);
 }
 
 void InterDexPass::run_pass(DexStoresVector& stores,
@@ -159,6 +164,13 @@ void InterDexPass::run_pass(DexStoresVector& stores,
   // Setup all external plugins.
   InterDexRegistry* registry = static_cast<InterDexRegistry*>(
       PluginRegistry::get().pass_registry(INTERDEX_PASS_NAME));
+  if (m_coldstart_layout) {
+    registry->register_plugin(
+        COLDSTART_LAYOUT_PLUGIN, [this, &mgr]() -> InterDexPassPlugin* {
+          return new ColdStartLayoutPlugin(m_minimize_cross_dex_refs_config,
+                                           mgr);
+        });
+  }
 
   auto plugins = registry->create_plugins();
   for (const auto& plugin : plugins) {
@@ -51,6 +51,7 @@ class InterDexPass : public Pass {
   bool m_emit_scroll_set_marker;
   bool m_minimize_cross_dex_refs;
   CrossDexRefMinimizerConfig m_minimize_cross_dex_refs_config;
+  bool m_coldstart_layout;
 
   virtual void run_pass(
       DexStoresVector&, DexClassesVector&, Scope&, ConfigFiles&, PassManager&);
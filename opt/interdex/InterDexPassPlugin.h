@@ -11,6 +11,7 @@
 
 #include "ConfigFiles.h"
 #include "DexClass.h"
+#include "DexStructure.h"
 #include "PluginRegistry.h"
 
 namespace interdex {
@@ -42,6 +43,11 @@ class InterDexPassPlugin {
     return empty;
   }
 
+  // Reorder the classes of a dex once it is complete, before it is emitted.
+  // Nothing, by default.
+  virtual void reorder_classes(const DexInfo& /* dex_info */,
+                               DexClasses* /* classes */) {}
+
   // Run plugin cleanup and finalization here. InterDex Pass should run
   // this after running its implementation
   virtual void cleanup(const std::vector<DexClass*>& scope) = 0;
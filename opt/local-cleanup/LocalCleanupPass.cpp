@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "LocalCleanupPass.h"
+
+#include "ConfigFiles.h"
+#include "ControlFlow.h"
+#include "DexUtil.h"
+#include "IRCode.h"
+#include "LocalDce.h"
+#include "Match.h"
+#include "PassManager.h"
+#include "RemoveGotos.h"
+#include "Walkers.h"
+
+namespace {
+
+struct Stats {
+  copy_propagation_impl::Stats copy_prop;
+  LocalDce::Stats dce;
+  size_t gotos_removed{0};
+
+  Stats operator+(const Stats& that) const {
+    Stats result;
+    result.copy_prop.moves_eliminated =
+        copy_prop.moves_eliminated + that.copy_prop.moves_eliminated;
+    result.copy_prop.replaced_sources =
+        copy_prop.replaced_sources + that.copy_prop.replaced_sources;
+    result.dce.dead_instruction_count =
+        dce.dead_instruction_count + that.dce.dead_instruction_count;
+    result.dce.unreachable_instruction_count =
+        dce.unreachable_instruction_count +
+        that.dce.unreachable_instruction_count;
+    result.gotos_removed = gotos_removed + that.gotos_removed;
+    return result;
+  }
+};
+
+} // namespace
+
+void LocalCleanupPass::eval_pass(DexStoresVector& stores,
+                                 ConfigFiles& cfg,
+                                 PassManager&) {
+  auto no_optimization_annos = cfg.get_no_optimizations_annos();
+  auto scope = build_class_scope(stores);
+  auto match = m::any_annos<DexMethod>(
+      m::as_type<DexAnnotation>(m::in<DexType>(no_optimization_annos)));
+  walk::methods(scope, [&](DexMethod* method) {
+    if (match.matches(method)) {
+      m_do_not_optimize_methods.insert(method);
+    }
+  });
+}
+
+void LocalCleanupPass::run_pass(DexStoresVector& stores,
+                                ConfigFiles& /* unused */,
+                                PassManager& mgr) {
+  auto scope = build_class_scope(stores);
+  m_config.copy_prop.regalloc_has_run = mgr.regalloc_has_run();
+  // Same as LocalDcePass: without ProGuard rules, we can't tell what is
+  // pure.
+  bool local_dce = m_config.local_dce && !mgr.no_proguard_rules();
+  std::unordered_set<DexMethodRef*> pure_methods;
+  if (local_dce) {
+    pure_methods = LocalDcePass::find_pure_methods();
+  }
+  copy_propagation_impl::CopyPropagation copy_prop(m_config.copy_prop);
+
+  auto stats = walk::parallel::reduce_methods<Stats>(
+      scope,
+      [&](DexMethod* m) {
+        Stats stats;
+        auto* code = m->get_code();
+        if (code == nullptr) {
+          return stats;
+        }
+        bool dce = local_dce && !m_do_not_optimize_methods.count(m);
+        if (!m_config.copy_propagation && !dce && !m_config.remove_gotos) {
+          return stats;
+        }
+        // All the steps work on the same editable CFG.
+        code->build_cfg(/* editable */ true);
+        auto& cfg = code->cfg();
+        if (m_config.copy_propagation) {
+          stats.copy_prop = copy_prop.run(cfg);
+        }
+        if (dce) {
+          LocalDce ldce(pure_methods);
+          ldce.dce(cfg);
+          stats.dce = ldce.get_stats();
+        }
+        if (m_config.remove_gotos) {
+          stats.gotos_removed = RemoveGotosPass::run(cfg);
+        }
+        code->clear_cfg();
+        return stats;
+      },
+      [](Stats a, Stats b) { return a + b; });
+
+  mgr.incr_metric("redundant_moves_eliminated",
+                  stats.copy_prop.moves_eliminated);
+  mgr.incr_metric("source_regs_replaced_with_representative",
+                  stats.copy_prop.replaced_sources);
+  mgr.incr_metric("num_dead_instructions", stats.dce.dead_instruction_count);
+  mgr.incr_metric("num_unreachable_instructions",
+                  stats.dce.unreachable_instruction_count);
+  mgr.incr_metric("num_goto_removed", stats.gotos_removed);
+  TRACE(DCE, 1,
+        "local cleanup -- moves: %zu, dead: %zu, unreachable: %zu, "
+        "gotos: %zu\n",
+        stats.copy_prop.moves_eliminated, stats.dce.dead_instruction_count,
+        stats.dce.unreachable_instruction_count, stats.gotos_removed);
+}
+
+static LocalCleanupPass s_pass;
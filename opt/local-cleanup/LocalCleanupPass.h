@@ -0,0 +1,51 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <unordered_set>
+
+#include "CopyPropagationPass.h"
+#include "Pass.h"
+
+/*
+ * Runs copy propagation, local dead code elimination and goto removal on each
+ * method in turn, in one walk over the scope, rather than one walk per pass.
+ * All three steps share a single editable CFG, built once per method.
+ *
+ * The result is the same as running CopyPropagationPass, LocalDcePass and
+ * RemoveGotosPass back to back, and they remain available on their own.
+ */
+class LocalCleanupPass : public Pass {
+ public:
+  LocalCleanupPass() : Pass("LocalCleanupPass") {}
+
+  void configure_pass(const JsonWrapper& jw) override {
+    jw.get("copy_propagation", true, m_config.copy_propagation);
+    jw.get("local_dce", true, m_config.local_dce);
+    jw.get("remove_gotos", true, m_config.remove_gotos);
+  }
+
+  void eval_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+  analysis::Set preserved_analyses() const override {
+    return analysis::CODE_AGNOSTIC;
+  }
+
+  struct Config {
+    bool copy_propagation{true};
+    bool local_dce{true};
+    bool remove_gotos{true};
+    // The copy propagation runs with the default options.
+    CopyPropagationPass::Config copy_prop;
+  } m_config;
+
+ private:
+  std::unordered_set<DexMethod*> m_do_not_optimize_methods;
+};
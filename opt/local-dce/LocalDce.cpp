@@ -9,6 +9,7 @@
 
 #include <iostream>
 #include <array>
+#include <atomic>
 #include <unordered_set>
 #include <vector>
 
@@ -19,6 +20,7 @@
 #include "DexUtil.h"
 #include "IRCode.h"
 #include "IRInstruction.h"
+#include "IncrementalPassCache.h"
 #include "DexUtil.h"
 #include "Resolver.h"
 #include "Transform.h"
@@ -136,9 +138,14 @@ void update_liveness(const IRInstruction* inst,
 
 void LocalDce::dce(IRCode* code) {
   code->build_cfg(/* editable */ true);
-  auto& cfg = code->cfg();
+  dce(code->cfg());
+  code->clear_cfg();
+}
+
+void LocalDce::dce(cfg::ControlFlowGraph& cfg) {
+  always_assert(cfg.editable());
   auto blocks = cfg::postorder_sort(cfg.blocks());
-  auto regs = code->get_registers_size();
+  auto regs = cfg.get_registers_size();
   std::unordered_map<cfg::BlockId, boost::dynamic_bitset<>> liveness;
   for (cfg::Block* b : blocks) {
     liveness.emplace(b->id(), boost::dynamic_bitset<>(regs + 1));
@@ -219,8 +226,7 @@ void LocalDce::dce(IRCode* code) {
   m_stats.unreachable_instruction_count += unreachable_insn_count;
 
   TRACE(DCE, 5, "=== Post-DCE CFG ===\n");
-  TRACE(DCE, 5, "%s", SHOW(code->cfg()));
-  code->clear_cfg();
+  TRACE(DCE, 5, "%s", SHOW(cfg));
 }
 
 /*
@@ -280,40 +286,76 @@ void LocalDcePass::eval_pass(DexStoresVector& stores,
   });
 }
 
+namespace {
+
+class LocalDceRunner : public Pass::MethodRunner {
+ public:
+  LocalDceRunner(ConfigFiles& cfg,
+                 PassManager& mgr,
+                 const std::unordered_set<DexMethod*>& do_not_optimize_methods)
+      : m_pure_methods(LocalDcePass::find_pure_methods()),
+        m_do_not_optimize_methods(do_not_optimize_methods),
+        m_cache(cfg, mgr) {}
+
+  void run(DexMethod* m) override {
+    if (m_do_not_optimize_methods.count(m)) {
+      return;
+    }
+    // Whether a call can be removed depends on the callee.
+    auto stats = m_cache.run(m, /* summarize_refs */ true, [&] {
+      LocalDce ldce(m_pure_methods);
+      ldce.dce(m->get_code());
+      const auto& dce_stats = ldce.get_stats();
+      return IncrementalPassCache::Stats{
+          dce_stats.dead_instruction_count,
+          dce_stats.unreachable_instruction_count};
+    });
+    m_dead_instructions += stats.at(0);
+    m_unreachable_instructions += stats.at(1);
+  }
+
+  void finish(PassManager& mgr) override {
+    m_cache.finish(mgr);
+    mgr.incr_metric(METRIC_DEAD_INSTRUCTIONS, m_dead_instructions);
+    mgr.incr_metric(METRIC_UNREACHABLE_INSTRUCTIONS,
+                    m_unreachable_instructions);
+    TRACE(DCE, 1, "instructions removed -- dead: %lu, unreachable: %lu\n",
+          m_dead_instructions.load(), m_unreachable_instructions.load());
+  }
+
+ private:
+  const std::unordered_set<DexMethodRef*> m_pure_methods;
+  const std::unordered_set<DexMethod*>& m_do_not_optimize_methods;
+  IncrementalPassCache m_cache;
+  std::atomic<size_t> m_dead_instructions{0};
+  std::atomic<size_t> m_unreachable_instructions{0};
+};
+
+} // namespace
+
+std::unique_ptr<Pass::MethodRunner> LocalDcePass::method_runner(
+    DexStoresVector&, ConfigFiles& cfg, PassManager& mgr) {
+  if (mgr.no_proguard_rules()) {
+    return nullptr;
+  }
+  return std::make_unique<LocalDceRunner>(cfg, mgr, m_do_not_optimize_methods);
+}
+
 void LocalDcePass::run_pass(DexStoresVector& stores,
                             ConfigFiles& cfg,
                             PassManager& mgr) {
-  if (mgr.no_proguard_rules()) {
+  auto runner = method_runner(stores, cfg, mgr);
+  if (runner == nullptr) {
     TRACE(DCE, 1,
           "LocalDcePass not run because no ProGuard configuration was "
           "provided.\n");
     return;
   }
-  const auto& pure_methods = find_pure_methods();
-  auto scope = build_class_scope(stores);
-  auto stats = walk::parallel::reduce_methods<LocalDce::Stats>(
-      scope,
-      [&](DexMethod* m) {
-        auto* code = m->get_code();
-        if (code == nullptr || m_do_not_optimize_methods.find(m) !=
-                                   m_do_not_optimize_methods.end()) {
-          return LocalDce::Stats();
-        }
-
-        LocalDce ldce(pure_methods);
-        ldce.dce(code);
-        return ldce.get_stats();
-      },
-      [](LocalDce::Stats a, LocalDce::Stats b) {
-        a.dead_instruction_count += b.dead_instruction_count;
-        a.unreachable_instruction_count += b.unreachable_instruction_count;
-        return a;
-      });
-  mgr.incr_metric(METRIC_DEAD_INSTRUCTIONS, stats.dead_instruction_count);
-  mgr.incr_metric(METRIC_UNREACHABLE_INSTRUCTIONS,
-                  stats.unreachable_instruction_count);
-  TRACE(DCE, 1, "instructions removed -- dead: %d, unreachable: %d\n",
-        stats.dead_instruction_count, stats.unreachable_instruction_count);
+  walk::parallel::code(build_class_scope(stores),
+                       [&](DexMethod* m, IRCode&) { runner->run(m); },
+                       walk::parallel::default_num_threads(),
+                       walk::parallel::Split::LARGE_CLASSES);
+  runner->finish(mgr);
 }
 
 std::unordered_set<DexMethodRef*> LocalDcePass::find_pure_methods() {
@@ -11,6 +11,10 @@
 
 #include <boost/dynamic_bitset.hpp>
 
+namespace cfg {
+class ControlFlowGraph;
+} // namespace cfg
+
 class LocalDce {
  public:
   struct Stats {
@@ -51,6 +55,9 @@ class LocalDce {
 
   void dce(IRCode*);
 
+  // Same as above, on an editable CFG that the caller built and clears.
+  void dce(cfg::ControlFlowGraph&);
+
  private:
   const std::unordered_set<DexMethodRef*>& m_pure_methods;
   Stats m_stats;
@@ -66,11 +73,24 @@ class LocalDcePass : public Pass {
 
   static void run(IRCode* code);
 
+  static std::unordered_set<DexMethodRef*> find_pure_methods();
+
   virtual void eval_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
+  std::unique_ptr<MethodRunner> method_runner(DexStoresVector&,
+                                              ConfigFiles&,
+                                              PassManager&) override;
+
+  bool is_cfg_friendly() const override { return true; }
+
+  bool is_method_local() const override { return true; }
+
+  analysis::Set preserved_analyses() const override {
+    return analysis::CODE_AGNOSTIC;
+  }
+
 private:
-  static std::unordered_set<DexMethodRef*> find_pure_methods();
   std::unordered_set<DexMethod*> m_do_not_optimize_methods;
 };
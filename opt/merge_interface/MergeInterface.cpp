@@ -7,11 +7,15 @@
 
 #include "MergeInterface.h"
 
+#include <numeric>
+
 #include "ClassHierarchy.h"
+#include "ConcurrentContainers.h"
 #include "DexAnnotation.h"
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "IROpcode.h"
+#include "Parallel.h"
 #include "Resolver.h"
 #include "Trace.h"
 #include "TypeReference.h"
@@ -67,8 +71,14 @@ std::vector<DexClassSet> collect_can_merge(
     const std::vector<std::vector<DexClass*>>& classes_groups,
     MergeInterfacePass::Metric* metric) {
   TypeSystem ts(scope);
-  std::vector<DexClassSet> interface_set;
-  for (const auto& classes_group : classes_groups) {
+  // The classes groups don't share any interface, so their mergeable
+  // interfaces are collected in parallel.
+  std::vector<std::vector<DexClassSet>> group_interface_sets(
+      classes_groups.size());
+  std::vector<size_t> indices(classes_groups.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    const auto& classes_group = classes_groups[i];
     // Build the map of interfaces and list of classes that implement
     // the interfaces
     ImplementorsToInterfaces interface_class_map;
@@ -104,27 +114,37 @@ std::vector<DexClassSet> collect_can_merge(
     for (const auto& pair : interface_class_map) {
       if (pair.first.size() > 0 && pair.second.size() > 1) {
         // Consider interfaces with same set of implementors as mergeable.
-        interface_set.emplace_back(pair.second);
+        group_interface_sets[i].emplace_back(pair.second);
       }
     }
+  });
+  std::vector<DexClassSet> interface_set;
+  std::unordered_map<const DexClass*, size_t> interface_to_set;
+  for (auto& sets : group_interface_sets) {
+    for (auto& intf_set : sets) {
+      for (auto intf : intf_set) {
+        interface_to_set.emplace(intf, interface_set.size());
+      }
+      interface_set.emplace_back(std::move(intf_set));
+    }
   }
   // Remove interface if it is the type of an annotation.
   // TODO(suree404): Merge the interface even though it appears in annotation?
-  walk::annotations(scope, [&](DexAnnotation* anno) {
+  ConcurrentSet<const DexClass*> in_annotations;
+  walk::parallel::annotations(scope, [&](DexAnnotation* anno) {
     std::vector<DexType*> types_in_anno;
     anno->gather_types(types_in_anno);
     for (const auto& type : types_in_anno) {
       DexClass* type_cls = type_class(type);
-      if (type_cls == nullptr) continue;
-      for (auto it = interface_set.begin(); it != interface_set.end(); ++it) {
-        if (it->count(type_cls) > 0) {
-          it->erase(type_cls);
-          ++metric->interfaces_in_annotation;
-          break;
-        }
+      if (type_cls != nullptr && interface_to_set.count(type_cls)) {
+        in_annotations.insert(type_cls);
       }
     }
   });
+  for (auto intf : in_annotations) {
+    interface_set[interface_to_set.at(intf)].erase(const_cast<DexClass*>(intf));
+    ++metric->interfaces_in_annotation;
+  }
   TRACE(MEINT, 4, SHOW(interface_set));
   return interface_set;
 }
@@ -512,7 +532,7 @@ void remove_implements(
     const std::unordered_map<const DexType*, DexType*>& intf_merge_map) {
   // TODO(suree404): possible speed optimization, use type system to get
   // implementors and interface children and only update those.
-  for (const auto& cls : scope) {
+  walk::parallel::classes(scope, [&](DexClass* cls) {
     bool got_one = false;
     for (const auto& cls_intf : cls->get_interfaces()->get_type_list()) {
       if (intf_merge_map.find(cls_intf) != intf_merge_map.end()) {
@@ -521,7 +541,7 @@ void remove_implements(
       }
     }
     if (!got_one) {
-      continue;
+      return;
     }
     TRACE(MEINT, 9, "Updating interface for %p\n", cls->get_type());
     std::unordered_set<DexType*> new_intfs;
@@ -548,7 +568,7 @@ void remove_implements(
     TRACE(MEINT, 9, "\n");
     DexTypeList* implements = DexTypeList::make_type_list(std::move(deque));
     cls->set_interfaces(implements);
-  }
+  });
 }
 
 void update_after_merge(
@@ -13,6 +13,7 @@
 #include "IRCode.h"
 #include "Obfuscate.h"
 #include "ObfuscateUtils.h"
+#include "Parallel.h"
 #include "ProguardMap.h"
 #include "ReachableClasses.h"
 #include "Resolver.h"
@@ -134,109 +135,189 @@ void get_totals(Scope& scope, RenameStats& stats) {
   }
 }
 
-} // end namespace
-
-void obfuscate(Scope& scope, RenameStats& stats) {
-  get_totals(scope, stats);
-  ClassHierarchy ch = build_type_hierarchy(scope);
+/*
+ * Picks the new names of the fields and direct methods of a class. The names
+ * only depend on the class itself and, for methods, on its super classes and
+ * subclasses, so classes in unrelated hierarchies can be handled
+ * concurrently.
+ */
+void obfuscate_class(DexClass* cls,
+                     DexFieldManager& field_name_manager,
+                     DexMethodManager& method_name_manager,
+                     const ClassHierarchy& ch) {
+  always_assert_log(!cls->is_external(),
+      "Shouldn't rename members of external classes. %s", SHOW(cls));
+  // Checks to short-circuit expensive name-gathering logic (code is still
+  // correct w/o this, but does unnecessary work)
+  bool operate_on_ifields =
+      contains_renamable_elem(cls->get_ifields(), field_name_manager);
+  bool operate_on_sfields =
+      contains_renamable_elem(cls->get_sfields(), field_name_manager);
+  bool operate_on_dmethods =
+      contains_renamable_elem(cls->get_dmethods(), method_name_manager);
+  if (operate_on_ifields || operate_on_sfields) {
+    FieldObfuscationState f_ob_state;
+    FieldNameGenerator field_name_generator(
+        f_ob_state.ids_to_avoid, f_ob_state.used_ids);
+    StaticFieldNameGenerator static_name_generator(
+        f_ob_state.ids_to_avoid, f_ob_state.used_ids);
+
+    TRACE(OBFUSCATE, 3, "Renaming the fields of class %s\n",
+        SHOW(cls->get_name()));
+
+    f_ob_state.populate_ids_to_avoid(cls, field_name_manager, true, ch);
+
+    // Keep this for all public ids in the class (they shouldn't conflict)
+    if (operate_on_ifields) {
+      obfuscate_elems(
+          FieldRenamingContext(cls->get_ifields(),
+              f_ob_state.ids_to_avoid,
+              field_name_generator, false),
+          field_name_manager);
+    }
+    if (operate_on_sfields) {
+      obfuscate_elems(
+          FieldRenamingContext(cls->get_sfields(),
+              f_ob_state.ids_to_avoid,
+              static_name_generator, false),
+          field_name_manager);
+    }
 
-  DexFieldManager field_name_manager(new_dex_field_manager());
-  DexMethodManager method_name_manager = new_dex_method_manager();
+    // Obfu private fields
+    f_ob_state.populate_ids_to_avoid(cls, field_name_manager, false, ch);
 
-  for (DexClass* cls : scope) {
-    always_assert_log(!cls->is_external(),
-        "Shouldn't rename members of external classes. %s", SHOW(cls));
-    // Checks to short-circuit expensive name-gathering logic (code is still
-    // correct w/o this, but does unnecessary work)
-    bool operate_on_ifields =
-        contains_renamable_elem(cls->get_ifields(), field_name_manager);
-    bool operate_on_sfields =
-        contains_renamable_elem(cls->get_sfields(), field_name_manager);
-    bool operate_on_dmethods =
-        contains_renamable_elem(cls->get_dmethods(), method_name_manager);
-    if (operate_on_ifields || operate_on_sfields) {
-      FieldObfuscationState f_ob_state;
-      FieldNameGenerator field_name_generator(
-          f_ob_state.ids_to_avoid, f_ob_state.used_ids);
-      StaticFieldNameGenerator static_name_generator(
-          f_ob_state.ids_to_avoid, f_ob_state.used_ids);
-
-      TRACE(OBFUSCATE, 3, "Renaming the fields of class %s\n",
-          SHOW(cls->get_name()));
-
-      f_ob_state.populate_ids_to_avoid(cls, field_name_manager, true, ch);
-
-      // Keep this for all public ids in the class (they shouldn't conflict)
-      if (operate_on_ifields) {
-        obfuscate_elems(
-            FieldRenamingContext(cls->get_ifields(),
-                f_ob_state.ids_to_avoid,
-                field_name_generator, false),
-            field_name_manager);
-      }
-      if (operate_on_sfields) {
-        obfuscate_elems(
-            FieldRenamingContext(cls->get_sfields(),
-                f_ob_state.ids_to_avoid,
-                static_name_generator, false),
-            field_name_manager);
-      }
+    // Keep this for all public ids in the class (they shouldn't conflict)
+    if (operate_on_ifields) {
+      obfuscate_elems(
+          FieldRenamingContext(cls->get_ifields(),
+          f_ob_state.ids_to_avoid,
+          field_name_generator, true),
+      field_name_manager);
+    }
+    if (operate_on_sfields) {
+      obfuscate_elems(
+          FieldRenamingContext(cls->get_sfields(),
+              f_ob_state.ids_to_avoid,
+              static_name_generator, true),
+          field_name_manager);
+    }
 
-      // Obfu private fields
-      f_ob_state.populate_ids_to_avoid(cls, field_name_manager, false, ch);
+    // Make sure to bind the new names otherwise not all generators will
+    // assign names to the members
+    static_name_generator.bind_names();
+  }
 
-      // Keep this for all public ids in the class (they shouldn't conflict)
-      if (operate_on_ifields) {
-        obfuscate_elems(
-            FieldRenamingContext(cls->get_ifields(),
-            f_ob_state.ids_to_avoid,
-            field_name_generator, true),
-        field_name_manager);
-      }
-      if (operate_on_sfields) {
-        obfuscate_elems(
-            FieldRenamingContext(cls->get_sfields(),
-                f_ob_state.ids_to_avoid,
-                static_name_generator, true),
-            field_name_manager);
-      }
+  // =========== Obfuscate Methods Below ==========
+  if (operate_on_dmethods) {
+    MethodObfuscationState m_ob_state;
+    MethodNameGenerator simple_name_gen(m_ob_state.ids_to_avoid,
+        m_ob_state.used_ids);
+
+    TRACE(OBFUSCATE, 3, "Renaming the methods of class %s\n",
+              SHOW(cls->get_name()));
+    m_ob_state.populate_ids_to_avoid(cls, method_name_manager, true, ch);
+
+    // Keep this for all public ids in the class (they shouldn't conflict)
+    obfuscate_elems(
+        MethodRenamingContext(cls->get_dmethods(),
+            m_ob_state.ids_to_avoid,
+            simple_name_gen,
+            method_name_manager,
+            false),
+        method_name_manager);
+
+    // Obfu private methods
+    m_ob_state.populate_ids_to_avoid(cls, method_name_manager, false, ch);
+
+    obfuscate_elems(
+        MethodRenamingContext(cls->get_dmethods(),
+            m_ob_state.ids_to_avoid,
+            simple_name_gen,
+            method_name_manager,
+            true),
+        method_name_manager);
+  }
+}
 
-      // Make sure to bind the new names otherwise not all generators will
-      // assign names to the members
-      static_name_generator.bind_names();
+/*
+ * Creates the name wrappers of all the members that the renaming of the scope
+ * will look at: those of the classes in the scope, and the methods of their
+ * external super classes. The managers are then only read, and each wrapper
+ * only written by the class that owns it, while the names are picked.
+ */
+void create_wrappers(const Scope& scope,
+                     DexFieldManager& field_name_manager,
+                     DexMethodManager& method_name_manager) {
+  std::unordered_set<DexClass*> visited;
+  auto add_methods = [&](DexClass* cls) {
+    for (auto meth : const_cast<const DexClass*>(cls)->get_dmethods()) {
+      method_name_manager[meth];
+    }
+    for (auto meth : const_cast<const DexClass*>(cls)->get_vmethods()) {
+      method_name_manager[meth];
+    }
+  };
+  for (DexClass* cls : scope) {
+    for (auto f : cls->get_ifields()) {
+      field_name_manager[f];
+    }
+    for (auto f : cls->get_sfields()) {
+      field_name_manager[f];
+    }
+    for (auto clazz = cls; clazz != nullptr && visited.insert(clazz).second;
+         clazz = clazz->get_super_class() == nullptr
+                     ? nullptr
+                     : type_class(clazz->get_super_class())) {
+      add_methods(clazz);
     }
+  }
+}
 
-    // =========== Obfuscate Methods Below ==========
-    if (operate_on_dmethods) {
-      MethodObfuscationState m_ob_state;
-      MethodNameGenerator simple_name_gen(m_ob_state.ids_to_avoid,
-          m_ob_state.used_ids);
+/*
+ * Groups the classes of the scope by the topmost of their super classes in
+ * the scope, keeping the scope order within each group.
+ */
+std::vector<std::vector<DexClass*>> group_by_hierarchy(const Scope& scope) {
+  std::unordered_set<const DexType*> scope_types;
+  for (auto cls : scope) {
+    scope_types.insert(cls->get_type());
+  }
+  std::unordered_map<const DexType*, size_t> root_groups;
+  std::vector<std::vector<DexClass*>> groups;
+  for (auto cls : scope) {
+    const DexType* root = cls->get_type();
+    for (auto super = cls->get_super_class();
+         super != nullptr && scope_types.count(super);
+         super = type_class(super)->get_super_class()) {
+      root = super;
+    }
+    auto it = root_groups.emplace(root, groups.size()).first;
+    if (it->second == groups.size()) {
+      groups.emplace_back();
+    }
+    groups[it->second].push_back(cls);
+  }
+  return groups;
+}
 
-      TRACE(OBFUSCATE, 3, "Renaming the methods of class %s\n",
-                SHOW(cls->get_name()));
-      m_ob_state.populate_ids_to_avoid(cls, method_name_manager, true, ch);
+} // end namespace
 
-      // Keep this for all public ids in the class (they shouldn't conflict)
-      obfuscate_elems(
-          MethodRenamingContext(cls->get_dmethods(),
-              m_ob_state.ids_to_avoid,
-              simple_name_gen,
-              method_name_manager,
-              false),
-          method_name_manager);
+void obfuscate(Scope& scope, RenameStats& stats) {
+  get_totals(scope, stats);
+  ClassHierarchy ch = build_type_hierarchy(scope);
 
-      // Obfu private methods
-      m_ob_state.populate_ids_to_avoid(cls, method_name_manager, false, ch);
+  DexFieldManager field_name_manager(new_dex_field_manager());
+  DexMethodManager method_name_manager = new_dex_method_manager();
 
-      obfuscate_elems(
-          MethodRenamingContext(cls->get_dmethods(),
-              m_ob_state.ids_to_avoid,
-              simple_name_gen,
-              method_name_manager,
-              true),
-          method_name_manager);
-    }
-  }
+  create_wrappers(scope, field_name_manager, method_name_manager);
+  auto groups = group_by_hierarchy(scope);
+  parallel_for(groups.begin(), groups.end(),
+               [&](const std::vector<DexClass*>& group) {
+                 for (DexClass* cls : group) {
+                   obfuscate_class(cls, field_name_manager,
+                                   method_name_manager, ch);
+                 }
+               });
   field_name_manager.print_elements();
   method_name_manager.print_elements();
 
@@ -14,6 +14,7 @@
 #include <unordered_set>
 #include <vector>
 
+#include "ConcurrentContainers.h"
 #include "Creators.h"
 #include "DexAsm.h"
 #include "DexClass.h"
@@ -157,19 +158,19 @@ void Outliner::run_pass(DexStoresVector& stores,
       m::invoke_direct(m::opcode_method(m::can_be_constructor())),
       m::throwex());
 
-  // Collect all throws we should outline
-  std::vector<outlined_t> outlined_throws;
-  walk::matching_opcodes_in_block(
+  // Find the throws to outline in parallel. The code is only rewritten
+  // afterwards, in scope order, so that the dispatcher cases come out in a
+  // deterministic order.
+  ConcurrentMap<DexMethod*, std::vector<std::vector<IRInstruction*>>>
+      method_matches;
+  walk::parallel::matching_opcodes_in_block(
       scope,
       match,
       [&](DexMethod* method,
           cfg::Block*,
           const std::vector<IRInstruction*>& insns) {
         always_assert(insns.size() == 6);
-
-        auto new_instance = insns[0];
         auto new_instance_result = insns[1];
-        auto const_string = insns[2];
         auto const_string_result = insns[3];
         auto invoke_direct = insns[4];
         IRInstruction* throwex = insns[5];
@@ -177,46 +178,75 @@ void Outliner::run_pass(DexStoresVector& stores,
             new_instance_result->dest() == invoke_direct->src(0) &&
             const_string_result->dest() == invoke_direct->src(1) &&
             new_instance_result->dest() == throwex->src(0)) {
-          TRACE(OUTLINE,
-                1,
-                "Found pattern in %s:\n  %s\n  %s\n  %s\n  %s\n",
-                SHOW(method),
-                SHOW(new_instance),
-                SHOW(const_string),
-                SHOW(invoke_direct),
-                SHOW(throwex));
-
-          auto const_int_extype = dasm(OPCODE_CONST,
-                                       {{VREG, new_instance_result->dest()},
-                                        {LITERAL, outlined_throws.size()}});
-          IRInstruction* invoke_static =
-              make_invoke(dispatch_method, new_instance_result->dest());
-
-          /*
-              Nice code you got there. Be a shame if someone ever put an
-	      infinite loop into it.
-
-              (We have to emit a branch of some sort here to appease the
-               verifier - all blocks either need to exit the method or
-               jump somewhere)
-
-              new-instance <TYPE> -> {vA}       => const-int {vA}, <EXTYPEORD>
-              const-string <STRING> -> {vB}     => invoke-static <METHOD>,
-              invoke-direct {vA}, {vB}, <CTTOR> => goto/32 +0 // will never run
-              throw {vA}                        =>
-          */
-          outlined_t outlined{new_instance->get_type(),
-                              const_string->get_string()};
-          outlined_throws.emplace_back(outlined);
-
-          IRCode* code = method->get_code();
-          code->replace_opcode(new_instance, const_int_extype);
-          code->replace_opcode(const_string, invoke_static);
-          code->replace_opcode_with_infinite_loop(invoke_direct);
-          code->remove_opcode(throwex);
+          method_matches.update(
+              method,
+              [&](DexMethod*,
+                  std::vector<std::vector<IRInstruction*>>& matches,
+                  bool) { matches.push_back(insns); });
         }
       });
 
+  // Identical throws share a dispatcher case.
+  std::vector<outlined_t> outlined_throws;
+  std::map<outlined_t, size_t> outlined_indices;
+  size_t outlined_sites = 0;
+  walk::methods(scope, [&](DexMethod* method) {
+    auto it = method_matches.find(method);
+    if (it == method_matches.end()) {
+      return;
+    }
+    for (const auto& insns : it->second) {
+      auto new_instance = insns[0];
+      auto new_instance_result = insns[1];
+      auto const_string = insns[2];
+      auto invoke_direct = insns[4];
+      IRInstruction* throwex = insns[5];
+      TRACE(OUTLINE,
+            1,
+            "Found pattern in %s:\n  %s\n  %s\n  %s\n  %s\n",
+            SHOW(method),
+            SHOW(new_instance),
+            SHOW(const_string),
+            SHOW(invoke_direct),
+            SHOW(throwex));
+
+      outlined_t outlined{new_instance->get_type(),
+                          const_string->get_string()};
+      auto index_it =
+          outlined_indices.emplace(outlined, outlined_throws.size()).first;
+      if (index_it->second == outlined_throws.size()) {
+        outlined_throws.emplace_back(outlined);
+      }
+
+      auto const_int_extype = dasm(OPCODE_CONST,
+                                   {{VREG, new_instance_result->dest()},
+                                    {LITERAL, index_it->second}});
+      IRInstruction* invoke_static =
+          make_invoke(dispatch_method, new_instance_result->dest());
+
+      /*
+          Nice code you got there. Be a shame if someone ever put an
+          infinite loop into it.
+
+          (We have to emit a branch of some sort here to appease the
+           verifier - all blocks either need to exit the method or
+           jump somewhere)
+
+          new-instance <TYPE> -> {vA}       => const-int {vA}, <EXTYPEORD>
+          const-string <STRING> -> {vB}     => invoke-static <METHOD>,
+          invoke-direct {vA}, {vB}, <CTTOR> => goto/32 +0 // will never run
+          throw {vA}                        =>
+      */
+      IRCode* code = method->get_code();
+      code->replace_opcode(new_instance, const_int_extype);
+      code->replace_opcode(const_string, invoke_static);
+      code->replace_opcode_with_infinite_loop(invoke_direct);
+      code->remove_opcode(throwex);
+      ++outlined_sites;
+    }
+  });
+
+  mgr.incr_metric("outlined_throw_sites", outlined_sites);
   mgr.incr_metric("outlined_throws", outlined_throws.size());
   if (outlined_throws.size() > 0) {
     build_dispatcher(stores, outlined_throws);
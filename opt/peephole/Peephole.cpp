@@ -8,6 +8,9 @@
 #include "Peephole.h"
 
 #include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <mutex>
 #include <numeric>
 #include <unordered_map>
 #include <unordered_set>
@@ -18,6 +21,7 @@
 #include "DexInstruction.h"
 #include "DexUtil.h"
 #include "IRInstruction.h"
+#include "IncrementalPassCache.h"
 #include "PassManager.h"
 #include "RedundantCheckCastRemover.h"
 #include "Walkers.h"
@@ -1466,9 +1470,15 @@ bool contains(const std::vector<T>& vec, const T& value) {
   return std::find(vec.begin(), vec.end(), value) != vec.end();
 }
 
+// The set of opcodes that appear in a method, or that a step of a pattern
+// accepts.
+using OpcodeSet = std::bitset<IOPCODE_MOVE_RESULT_PSEUDO_WIDE + 1>;
+
 class PeepholeOptimizer {
  private:
   std::vector<Matcher> m_matchers;
+  // For each matcher, the opcodes that each step of its pattern accepts.
+  std::vector<std::vector<OpcodeSet>> m_step_opcodes;
   std::vector<size_t> m_stats;
   PassManager& m_mgr;
   int m_stats_removed = 0;
@@ -1491,18 +1501,55 @@ class PeepholeOptimizer {
       }
     }
     m_stats.resize(m_matchers.size(), 0);
+    for (const auto& matcher : m_matchers) {
+      std::vector<OpcodeSet> steps;
+      for (const auto& dex_pattern : matcher.pattern.match) {
+        OpcodeSet step;
+        for (auto op : dex_pattern.opcodes) {
+          step.set(op);
+        }
+        steps.push_back(step);
+      }
+      m_step_opcodes.push_back(std::move(steps));
+    }
+  }
+
+  // A pattern can only match if every one of its steps accepts some opcode of
+  // the method. Most patterns fail this test for most methods, which is much
+  // cheaper than running their matcher over the whole code.
+  bool may_match(size_t i, const OpcodeSet& method_opcodes) const {
+    for (const auto& step : m_step_opcodes[i]) {
+      if ((step & method_opcodes).none()) {
+        return false;
+      }
+    }
+    return true;
   }
 
   PeepholeOptimizer(const PeepholeOptimizer&) = delete;
   PeepholeOptimizer& operator=(const PeepholeOptimizer&) = delete;
 
-  void peephole(DexMethod* method) {
+  // Adds the matches of each pattern, then the instructions inserted and
+  // removed, to `stats`.
+  void peephole(DexMethod* method, IncrementalPassCache::Stats* stats) {
+    auto& inserted = stats->at(m_matchers.size());
+    auto& removed = stats->at(m_matchers.size() + 1);
     auto code = method->get_code();
     code->build_cfg(/* editable */ false);
 
+    // The opcodes in the method. Replacements add to it, and removals are
+    // ignored, so it stays a superset as the patterns rewrite the code.
+    OpcodeSet method_opcodes;
+    for (const auto& mie : InstructionIterable(code)) {
+      method_opcodes.set(mie.insn->opcode());
+    }
+
     // do optimizations one at a time
     // so they can match on the same pattern without interfering
     for (size_t i = 0; i < m_matchers.size(); ++i) {
+      if (!may_match(i, method_opcodes)) {
+        continue;
+      }
       auto& matcher = m_matchers[i];
       std::vector<IRInstruction*> deletes;
       std::vector<std::pair<IRInstruction*, std::vector<IRInstruction*>>>
@@ -1517,7 +1564,7 @@ class PeepholeOptimizer {
           if (!matcher.try_match(mei.insn)) {
             continue;
           }
-          m_stats.at(i)++;
+          stats->at(i)++;
           TRACE(PEEPHOLE, 7, "PATTERN %s MATCHED!\n",
                 matcher.pattern.name.c_str());
           for (auto insn : matcher.matched_instructions) {
@@ -1530,10 +1577,11 @@ class PeepholeOptimizer {
           auto replace = matcher.get_replacements();
           for (const auto& r : replace) {
             TRACE(PEEPHOLE, 8, "-- %s\n", SHOW(r));
+            method_opcodes.set(r->opcode());
           }
 
-          m_stats_inserted += replace.size();
-          m_stats_removed += matcher.match_index;
+          inserted += replace.size();
+          removed += matcher.match_index;
 
           inserts.emplace_back(mei.insn, replace);
           matcher.reset();
@@ -1577,10 +1625,22 @@ class PeepholeOptimizer {
     }
   }
 
-  void run_method(DexMethod* m) {
+  // Returns the statistics of the method, in the layout of peephole().
+  IncrementalPassCache::Stats run_method(DexMethod* m) {
+    IncrementalPassCache::Stats stats(m_matchers.size() + 2, 0);
     if (m->get_code()) {
-      peephole(m);
+      peephole(m, &stats);
+    }
+    return stats;
+  }
+
+  void add_stats(const IncrementalPassCache::Stats& stats) {
+    always_assert(stats.size() == m_stats.size() + 2);
+    for (size_t i = 0; i < m_stats.size(); ++i) {
+      m_stats[i] += stats[i];
     }
+    m_stats_inserted += stats[m_stats.size()];
+    m_stats_removed += stats[m_stats.size() + 1];
   }
 
   void incr_all_metrics() {
@@ -1589,52 +1649,100 @@ class PeepholeOptimizer {
     }
   }
 };
-}
 
-void PeepholePass::run_pass(DexStoresVector& stores,
-                            ConfigFiles& /*cfg*/,
-                            PassManager& mgr) {
-  auto scope = build_class_scope(stores);
-  std::vector<std::unique_ptr<PeepholeOptimizer>> helpers;
-  auto wq = WorkQueue<DexClass*, PeepholeOptimizer*, std::nullptr_t>(
-      [&](WorkerState<DexClass*, PeepholeOptimizer*, std::nullptr_t>* state,
-          DexClass* cls) {
-        PeepholeOptimizer* ph = state->get_data();
-        for (auto dmethod : cls->get_dmethods()) {
-          TraceContext context(dmethod->get_deobfuscated_name());
-          ph->run_method(dmethod);
-        }
-        for (auto vmethod : cls->get_vmethods()) {
-          TraceContext context(vmethod->get_deobfuscated_name());
-          ph->run_method(vmethod);
-        }
-        return nullptr;
-      },
-      [](std::nullptr_t, std::nullptr_t) { return nullptr; }, // reducer
-      [&](unsigned int /*thread_index*/) { // data initializer
-        helpers.emplace_back(std::make_unique<PeepholeOptimizer>(
-            mgr, config.disabled_peepholes));
-        return helpers.back().get();
-      },
-      std::thread::hardware_concurrency() / 2);
-  for (auto* cls : scope) {
-    wq.add_item(cls);
+/*
+ * Runs the patterns over one method at a time, with an optimizer per thread,
+ * since the matchers keep their state. The redundant check-casts of each
+ * method are removed right after its patterns ran.
+ */
+class PeepholeRunner : public Pass::MethodRunner {
+ public:
+  PeepholeRunner(ConfigFiles& cfg,
+                 PassManager& mgr,
+                 const std::vector<std::string>& disabled_peepholes)
+      : m_mgr(mgr),
+        m_disabled_peepholes(disabled_peepholes),
+        m_remove_check_casts(!contains<std::string>(
+            disabled_peepholes, RedundantCheckCastRemover::get_name())),
+        m_cache(cfg, mgr) {
+    if (!m_remove_check_casts) {
+      TRACE(PEEPHOLE,
+            2,
+            "not running disabled peephole opt %s\n",
+            RedundantCheckCastRemover::get_name().c_str());
+    }
   }
-  wq.run_all();
 
-  for (const auto& helper : helpers) {
-    helper->incr_all_metrics();
+  void run(DexMethod* method) override {
+    TraceContext context(method->get_deobfuscated_name());
+    auto ph = acquire();
+    // The statistics of peephole(), followed by the check-casts removed.
+    auto stats = m_cache.run(method, /* summarize_refs */ false, [&] {
+      auto stats = ph->run_method(method);
+      stats.push_back(
+          m_remove_check_casts ? RedundantCheckCastRemover::run(method) : 0);
+      return stats;
+    });
+    m_check_casts_removed += stats.back();
+    stats.pop_back();
+    ph->add_stats(stats);
+    release(std::move(ph));
   }
 
-  if (!contains<std::string>(config.disabled_peepholes,
-                             RedundantCheckCastRemover::get_name())) {
-    RedundantCheckCastRemover(mgr, scope).run();
-  } else {
-    TRACE(PEEPHOLE,
-          2,
-          "not running disabled peephole opt %s\n",
-          RedundantCheckCastRemover::get_name().c_str());
+  void finish(PassManager& mgr) override {
+    m_cache.finish(mgr);
+    for (const auto& ph : m_optimizers) {
+      ph->incr_all_metrics();
+    }
+    if (m_remove_check_casts) {
+      mgr.incr_metric("redundant_check_casts_removed", m_check_casts_removed);
+    }
+  }
+
+ private:
+  std::unique_ptr<PeepholeOptimizer> acquire() {
+    {
+      std::lock_guard<std::mutex> lock(m_optimizers_mutex);
+      if (!m_optimizers.empty()) {
+        auto ph = std::move(m_optimizers.back());
+        m_optimizers.pop_back();
+        return ph;
+      }
+    }
+    return std::make_unique<PeepholeOptimizer>(m_mgr, m_disabled_peepholes);
   }
+
+  void release(std::unique_ptr<PeepholeOptimizer> ph) {
+    std::lock_guard<std::mutex> lock(m_optimizers_mutex);
+    m_optimizers.push_back(std::move(ph));
+  }
+
+  PassManager& m_mgr;
+  const std::vector<std::string>& m_disabled_peepholes;
+  const bool m_remove_check_casts;
+  IncrementalPassCache m_cache;
+  std::mutex m_optimizers_mutex;
+  // The optimizers that are not in use; there are at most as many as threads.
+  std::vector<std::unique_ptr<PeepholeOptimizer>> m_optimizers;
+  std::atomic<size_t> m_check_casts_removed{0};
+};
+}
+
+std::unique_ptr<Pass::MethodRunner> PeepholePass::method_runner(
+    DexStoresVector&, ConfigFiles& cfg, PassManager& mgr) {
+  return std::make_unique<PeepholeRunner>(cfg, mgr,
+                                          config.disabled_peepholes);
+}
+
+void PeepholePass::run_pass(DexStoresVector& stores,
+                            ConfigFiles& cfg,
+                            PassManager& mgr) {
+  auto runner = method_runner(stores, cfg, mgr);
+  walk::parallel::code(build_class_scope(stores),
+                       [&](DexMethod* m, IRCode&) { runner->run(m); },
+                       walk::parallel::default_num_threads(),
+                       walk::parallel::Split::LARGE_CLASSES);
+  runner->finish(mgr);
 }
 
 static PeepholePass s_pass;
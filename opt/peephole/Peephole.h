@@ -16,6 +16,16 @@ class PeepholePass : public Pass {
 
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
+  bool is_method_local() const override { return true; }
+
+  std::unique_ptr<MethodRunner> method_runner(DexStoresVector&,
+                                              ConfigFiles&,
+                                              PassManager&) override;
+
+  analysis::Set preserved_analyses() const override {
+    return analysis::CODE_AGNOSTIC;
+  }
+
   virtual void configure_pass(const JsonWrapper& jw) override {
     jw.get("disabled_peepholes", {}, config.disabled_peepholes);
   }
@@ -7,7 +7,7 @@
 
 #include "RedundantCheckCastRemover.h"
 
-#include <unordered_map>
+#include <atomic>
 
 #include "DexUtil.h"
 #include "IRCode.h"
@@ -19,21 +19,30 @@ RedundantCheckCastRemover::RedundantCheckCastRemover(
     : m_mgr(mgr), m_scope(scope) {}
 
 void RedundantCheckCastRemover::run() {
+  std::atomic<uint32_t> num_check_casts_removed{0};
+  walk::parallel::code(m_scope, [&](DexMethod* method, IRCode&) {
+    num_check_casts_removed += run(method);
+  });
+
+  m_mgr.incr_metric("redundant_check_casts_removed", num_check_casts_removed);
+}
+
+size_t RedundantCheckCastRemover::run(DexMethod* method) {
   auto match = std::make_tuple(m::invoke(),
                                m::is_opcode(OPCODE_MOVE_RESULT_OBJECT),
                                m::is_opcode(OPCODE_CHECK_CAST),
                                m::is_opcode(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT));
 
-  std::unordered_map<DexMethod*, std::vector<IRInstruction*>> to_remove;
-
-  std::atomic<uint32_t> num_check_casts_removed;
-  walk::parallel::matching_opcodes_in_block(
-      m_scope,
+  size_t num_check_casts_removed = 0;
+  walk::matching_opcodes_in_block(
+      *method,
       match,
-      [](DexMethod* method, cfg::Block*, const std::vector<IRInstruction*>& insns) {
+      [&](DexMethod* method, cfg::Block*,
+          const std::vector<IRInstruction*>& insns) {
         if (RedundantCheckCastRemover::can_remove_check_cast(insns)) {
           IRInstruction* check_cast = insns[2];
           method->get_code()->remove_opcode(check_cast);
+          ++num_check_casts_removed;
 
           TRACE(PEEPHOLE, 8, "redundant check cast in %s\n", SHOW(method));
           for (IRInstruction* insn : insns) {
@@ -41,8 +50,7 @@ void RedundantCheckCastRemover::run() {
           }
         }
       });
-
-  m_mgr.incr_metric("redundant_check_casts_removed", num_check_casts_removed);
+  return num_check_casts_removed;
 }
 
 bool RedundantCheckCastRemover::can_remove_check_cast(
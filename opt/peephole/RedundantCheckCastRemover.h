@@ -22,6 +22,10 @@ class RedundantCheckCastRemover {
                                      const std::vector<DexClass*>& scope);
   void run();
 
+  // Removes the redundant check-casts of one method, which must have code.
+  // Returns how many were removed.
+  static size_t run(DexMethod* method);
+
  private:
   static bool can_remove_check_cast(const std::vector<IRInstruction*>&);
 
@@ -116,164 +116,225 @@ DexMethod* bind_to_visible_ancestor(
   return top_impl;
 }
 
+template <typename T>
+struct RefStats {
+  int count = 0;
+  std::unordered_set<T> in;
+  std::unordered_set<T> out;
+
+  void insert(T tin, T tout) {
+    ++count;
+    in.emplace(tin);
+    out.emplace(tout);
+  }
+
+  void insert(T tin) {
+    insert(tin, T());
+  }
+
+  void merge(const RefStats& that) {
+    count += that.count;
+    in.insert(that.in.begin(), that.in.end());
+    out.insert(that.out.begin(), that.out.end());
+  }
+
+  void print(const char* tag, PassManager* mgr) const {
+    TRACE(BIND, 1,
+            "%11s [call sites: %6d, old refs: %6lu, new refs: %6lu]\n",
+            tag, count, in.size(), out.size());
+
+    if (mgr) {
+      using std::string;
+      string tagStr{tag};
+      string count_metric = tagStr + string("_candidates");
+      string rebound_metric = tagStr + string("_rebound");
+      mgr->incr_metric(count_metric, count);
+
+      auto rebound = static_cast<ssize_t>(in.size()) -
+        static_cast<ssize_t>(out.size());
+      mgr->incr_metric(rebound_metric, rebound);
+    }
+  }
+};
+
+/*
+ * What rebinding the refs of some methods did. Each thread of the walk fills
+ * its own, and they are merged at the end.
+ */
+struct RebindResult {
+  RefStats<DexFieldRef*> frefs;
+  RefStats<DexMethodRef*> mrefs;
+  RefStats<DexMethodRef*> array_clone_refs;
+  RefStats<DexMethodRef*> equals_refs;
+  RefStats<DexMethodRef*> hashCode_refs;
+  RefStats<DexMethodRef*> getClass_refs;
+  // The non-public classes of the new refs. They are made public once all the
+  // refs are rebound, so that the visibility checks of the rebinding don't
+  // depend on the order in which methods are visited.
+  std::unordered_set<DexClass*> classes_to_publicize;
+
+  RebindResult& operator+=(const RebindResult& that) {
+    frefs.merge(that.frefs);
+    mrefs.merge(that.mrefs);
+    array_clone_refs.merge(that.array_clone_refs);
+    equals_refs.merge(that.equals_refs);
+    hashCode_refs.merge(that.hashCode_refs);
+    getClass_refs.merge(that.getClass_refs);
+    classes_to_publicize.insert(that.classes_to_publicize.begin(),
+                                that.classes_to_publicize.end());
+    return *this;
+  }
+};
+
 struct Rebinder {
   Rebinder(Scope& scope, PassManager& mgr) : m_scope(scope), m_pass_mgr(mgr) {}
 
   void rewrite_refs() {
-    walk::opcodes(
-      m_scope,
-      [](DexMethod*) { return true; },
-      [&](DexMethod* m, IRInstruction* insn) {
-        bool top_ancestor = false;
-        switch (insn->opcode()) {
-          case OPCODE_INVOKE_VIRTUAL:
-            top_ancestor = true;
-            // fallthrough
-          case OPCODE_INVOKE_SUPER:
-          case OPCODE_INVOKE_INTERFACE:
-          case OPCODE_INVOKE_STATIC:
-            rebind_method(insn, opcode_to_search(insn), top_ancestor);
-            break;
-          case OPCODE_SGET:
-          case OPCODE_SGET_WIDE:
-          case OPCODE_SGET_OBJECT:
-          case OPCODE_SGET_BOOLEAN:
-          case OPCODE_SGET_BYTE:
-          case OPCODE_SGET_CHAR:
-          case OPCODE_SGET_SHORT:
-            rebind_field(insn, FieldSearch::Static);
-            break;
-          case OPCODE_IGET:
-          case OPCODE_IGET_WIDE:
-          case OPCODE_IGET_OBJECT:
-          case OPCODE_IGET_BOOLEAN:
-          case OPCODE_IGET_BYTE:
-          case OPCODE_IGET_CHAR:
-          case OPCODE_IGET_SHORT:
-            rebind_field(insn, FieldSearch::Instance);
-            break;
-          default:
-            break;
-        }
-      });
+    m_result = walk::parallel::reduce_methods<RebindResult>(
+        m_scope,
+        [&](DexMethod* m) {
+          RebindResult result;
+          auto code = m->get_code();
+          if (code == nullptr) {
+            return result;
+          }
+          for (auto& mie : InstructionIterable(code)) {
+            rebind_insn(mie.insn, result);
+          }
+          return result;
+        },
+        [](RebindResult a, const RebindResult& b) {
+          a += b;
+          return a;
+        });
+    for (auto cls : m_result.classes_to_publicize) {
+      set_public(cls);
+    }
   }
 
   void print_stats() {
-    m_frefs.print("field_refs", &m_pass_mgr);
-    m_mrefs.print("method_refs", &m_pass_mgr);
-    m_array_clone_refs.print("array_clone", nullptr);
-    m_equals_refs.print("equals", nullptr);
-    m_hashCode_refs.print("hashCode", nullptr);
-    m_getClass_refs.print("getClass", nullptr);
+    m_result.frefs.print("field_refs", &m_pass_mgr);
+    m_result.mrefs.print("method_refs", &m_pass_mgr);
+    m_result.array_clone_refs.print("array_clone", nullptr);
+    m_result.equals_refs.print("equals", nullptr);
+    m_result.hashCode_refs.print("hashCode", nullptr);
+    m_result.getClass_refs.print("getClass", nullptr);
   }
 
  private:
-  template<typename T>
-  struct RefStats {
-    int count = 0;
-    std::unordered_set<T> in;
-    std::unordered_set<T> out;
-
-    void insert(T tin, T tout) {
-      ++count;
-      in.emplace(tin);
-      out.emplace(tout);
-    }
-
-    void insert(T tin) {
-      insert(tin, T());
-    }
-
-    void print(const char* tag, PassManager* mgr) {
-      TRACE(BIND, 1,
-              "%11s [call sites: %6d, old refs: %6lu, new refs: %6lu]\n",
-              tag, count, in.size(), out.size());
-
-      if (mgr) {
-        using std::string;
-        string tagStr{tag};
-        string count_metric = tagStr + string("_candidates");
-        string rebound_metric = tagStr + string("_rebound");
-        mgr->incr_metric(count_metric, count);
-
-        auto rebound = static_cast<ssize_t>(in.size()) -
-          static_cast<ssize_t>(out.size());
-        mgr->incr_metric(rebound_metric, rebound);
-      }
+  void rebind_insn(IRInstruction* insn, RebindResult& result) const {
+    bool top_ancestor = false;
+    switch (insn->opcode()) {
+      case OPCODE_INVOKE_VIRTUAL:
+        top_ancestor = true;
+        // fallthrough
+      case OPCODE_INVOKE_SUPER:
+      case OPCODE_INVOKE_INTERFACE:
+      case OPCODE_INVOKE_STATIC:
+        rebind_method(insn, opcode_to_search(insn), top_ancestor, result);
+        break;
+      case OPCODE_SGET:
+      case OPCODE_SGET_WIDE:
+      case OPCODE_SGET_OBJECT:
+      case OPCODE_SGET_BOOLEAN:
+      case OPCODE_SGET_BYTE:
+      case OPCODE_SGET_CHAR:
+      case OPCODE_SGET_SHORT:
+        rebind_field(insn, FieldSearch::Static, result);
+        break;
+      case OPCODE_IGET:
+      case OPCODE_IGET_WIDE:
+      case OPCODE_IGET_OBJECT:
+      case OPCODE_IGET_BOOLEAN:
+      case OPCODE_IGET_BYTE:
+      case OPCODE_IGET_CHAR:
+      case OPCODE_IGET_SHORT:
+        rebind_field(insn, FieldSearch::Instance, result);
+        break;
+      default:
+        break;
     }
-  };
+  }
 
-  void rebind_method(
-      IRInstruction* mop, MethodSearch search, bool top_ancestor) {
+  void rebind_method(IRInstruction* mop,
+                     MethodSearch search,
+                     bool top_ancestor,
+                     RebindResult& result) const {
     const auto mref = mop->get_method();
     if (search == MethodSearch::Virtual && top_ancestor) {
       auto mtype = mref->get_class();
       if (is_array_clone(mref, mtype)) {
-        rebind_method_opcode(mop, mref, rebind_array_clone(mref));
+        rebind_method_opcode(
+            mop, mref, rebind_array_clone(mref, result), result);
         return;
       }
       // leave java.lang.String alone not to interfere with OP_EXECUTE_INLINE
       // and possibly any smart handling of String
       static auto str = DexType::make_type("Ljava/lang/String;");
       if (mtype == str) return;
-      auto real_ref = rebind_object_methods(mref);
+      auto real_ref = rebind_object_methods(mref, result);
       if (real_ref) {
-        rebind_method_opcode(mop, mref, real_ref);
+        rebind_method_opcode(mop, mref, real_ref, result);
         return;
       }
       auto cls = type_class(mtype);
       real_ref = bind_to_visible_ancestor(
           cls, mref->get_name(), mref->get_proto());
-      rebind_method_opcode(mop, mref, real_ref);
+      rebind_method_opcode(mop, mref, real_ref, result);
       return;
     }
-    rebind_method_opcode(mop, mref, resolve_method(mref, search));
+    rebind_method_opcode(
+        mop, mref, resolve_method_cached(mref, search), result);
   }
 
-  void rebind_method_opcode(
-      IRInstruction* mop,
-      DexMethodRef* mref,
-      DexMethodRef* real_ref) {
+  void rebind_method_opcode(IRInstruction* mop,
+                            DexMethodRef* mref,
+                            DexMethodRef* real_ref,
+                            RebindResult& result) const {
     if (!real_ref || real_ref == mref || real_ref->is_external()) {
       return;
     }
     TRACE(BIND, 2, "Rebinding %s\n\t=>%s\n", SHOW(mref), SHOW(real_ref));
-    m_mrefs.insert(mref, real_ref);
+    result.mrefs.insert(mref, real_ref);
     mop->set_method(real_ref);
     auto cls = type_class(real_ref->get_class());
     if (cls != nullptr && !is_public(cls)) {
-      set_public(cls);
+      result.classes_to_publicize.insert(cls);
     }
   }
 
-  bool is_array_clone(DexMethodRef* mref, DexType* mtype) {
+  static bool is_array_clone(DexMethodRef* mref, DexType* mtype) {
     static auto clone = DexString::make_string("clone");
     return is_array(mtype) &&
         mref->get_name() == clone &&
         !is_primitive(get_array_type(mtype));
   }
 
-  DexMethodRef* rebind_array_clone(DexMethodRef* mref) {
+  static DexMethodRef* rebind_array_clone(DexMethodRef* mref,
+                                          RebindResult& result) {
    DexMethodRef* real_ref = object_array_clone();
-   m_array_clone_refs.insert(mref, real_ref);
+   result.array_clone_refs.insert(mref, real_ref);
    return real_ref;
   }
 
-  DexMethodRef* rebind_object_methods(DexMethodRef* mref) {
+  static DexMethodRef* rebind_object_methods(DexMethodRef* mref,
+                                             RebindResult& result) {
     if (is_object_equals(mref)) {
-      m_equals_refs.insert(mref);
+      result.equals_refs.insert(mref);
       return object_equals();
     } else if (is_object_hashCode(mref)) {
-      m_hashCode_refs.insert(mref);
+      result.hashCode_refs.insert(mref);
       return object_hashCode();
     } else if (is_object_getClass(mref)) {
-      m_getClass_refs.insert(mref);
+      result.getClass_refs.insert(mref);
       return object_getClass();
     }
     return nullptr;
   }
 
-  void rebind_field(IRInstruction* insn, FieldSearch field_search) {
+  void rebind_field(IRInstruction* insn,
+                    FieldSearch field_search,
+                    RebindResult& result) const {
     const auto fref = insn->get_field();
     const auto real_ref = resolve_field(fref, field_search);
     if (real_ref && real_ref != fref) {
@@ -281,7 +342,7 @@ struct Rebinder {
       always_assert(cls != nullptr);
       if (!is_public(cls)) {
         if (cls->is_external()) return;
-        set_public(cls);
+        result.classes_to_publicize.insert(cls);
       }
       TRACE(BIND,
             2,
@@ -289,19 +350,13 @@ struct Rebinder {
             SHOW(fref),
             SHOW(real_ref));
       insn->set_field(real_ref);
-      m_frefs.insert(fref, real_ref);
+      result.frefs.insert(fref, real_ref);
     }
   }
 
   Scope& m_scope;
   PassManager& m_pass_mgr;
-
-  RefStats<DexFieldRef*> m_frefs;
-  RefStats<DexMethodRef*> m_mrefs;
-  RefStats<DexMethodRef*> m_array_clone_refs;
-  RefStats<DexMethodRef*> m_equals_refs;
-  RefStats<DexMethodRef*> m_hashCode_refs;
-  RefStats<DexMethodRef*> m_getClass_refs;
+  RebindResult m_result;
 };
 
 }
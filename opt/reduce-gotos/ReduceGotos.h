@@ -20,5 +20,11 @@ class ReduceGotosPass : public Pass {
 
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
+  bool is_cfg_friendly() const override { return true; }
+
+  analysis::Set preserved_analyses() const override {
+    return analysis::CODE_AGNOSTIC;
+  }
+
   static Stats process_code(IRCode*);
 };
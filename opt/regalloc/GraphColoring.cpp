@@ -15,6 +15,7 @@
 #include "Debug.h"
 #include "DexUtil.h"
 #include "IRCode.h"
+#include "LinearScan.h"
 #include "Show.h"
 #include "Transform.h"
 #include "VirtualRegistersFile.h"
@@ -153,7 +154,7 @@ int score_range_fit(
     auto reg = range_regs.at(i);
     const auto& node = ig.get_node(reg);
     const auto& vreg_file = vreg_files.at(reg);
-    // XXX We could be more precise here by checking the LivenessDomain for the
+    // XXX We could be more precise here by checking the liveness for the
     // given range instruction instead of just using the graph
     if (!vreg_file.is_free(vreg, node.width())) {
       return INVALID_SCORE;
@@ -308,12 +309,14 @@ std::string show(const RegisterTransform& reg_transform) {
 
 void Allocator::Stats::accumulate(const Allocator::Stats& that) {
   reiteration_count += that.reiteration_count;
+  methods_over_budget += that.methods_over_budget;
   param_spill_moves += that.param_spill_moves;
   range_spill_moves += that.range_spill_moves;
   global_spill_moves += that.global_spill_moves;
   split_moves += that.split_moves;
   moves_coalesced += that.moves_coalesced;
   params_spill_early += that.params_spill_early;
+  linear_scan_methods += that.linear_scan_methods;
 }
 
 static bool has_2addr_form(IROpcode op) {
@@ -641,7 +644,7 @@ void Allocator::select_ranges(const IRCode* code,
     }
 
     reg_t range_base = find_best_range_fit(ig,
-                                           insn->srcs(),
+                                           insn->srcs_vec(),
                                            0,
                                            reg_transform->size,
                                            vreg_files,
@@ -1025,7 +1028,22 @@ void Allocator::spill(const interference::Graph& ig,
  *     account for. These are handled in select_ranges and select_params
  *     respectively.
  */
-void Allocator::allocate(IRCode* code) {
+bool Allocator::allocate(IRCode* code) {
+  if (code->count_opcodes() > m_config.instruction_budget) {
+    TRACE(REG, 3, "Over the instruction budget\n");
+    ++m_stats.methods_over_budget;
+    return false;
+  }
+
+  if (m_config.use_linear_scan) {
+    linear_scan::Stats linear_scan_stats;
+    if (linear_scan::allocate(code, &linear_scan_stats)) {
+      ++m_stats.linear_scan_methods;
+      m_stats.moves_coalesced += linear_scan_stats.moves_coalesced;
+      TRACE(REG, 3, "Allocated by linear scan\n");
+      return true;
+    }
+  }
 
   // Any temp larger than this is the result of the spilling process
   auto initial_regs = code->get_registers_size();
@@ -1044,8 +1062,8 @@ void Allocator::allocate(IRCode* code) {
 
     auto& cfg = code->cfg();
     cfg.calculate_exit_block();
-    LivenessFixpointIterator fixpoint_iter(cfg);
-    fixpoint_iter.run(LivenessDomain());
+    DenseLivenessFixpointIterator fixpoint_iter(cfg);
+    fixpoint_iter.run(DenseLivenessDomain(code->get_registers_size()));
 
     TRACE(REG, 5, "Allocating:\n%s\n", ::SHOW(code->cfg()));
     auto ig =
@@ -1055,8 +1073,8 @@ void Allocator::allocate(IRCode* code) {
       coalesce(&ig, code);
       first = false;
       // After coalesce the live_out and live_in of blocks may change, so run
-      // LivenessFixpointIterator again.
-      fixpoint_iter.run(LivenessDomain());
+      // DenseLivenessFixpointIterator again.
+      fixpoint_iter.run(DenseLivenessDomain(code->get_registers_size()));
       TRACE(REG, 5, "Post-coalesce:\n%s\n", ::SHOW(code->cfg()));
     } else {
       // TODO we should coalesce here too, but we'll need to avoid removing
@@ -1065,6 +1083,11 @@ void Allocator::allocate(IRCode* code) {
       // If we've hit this many iterations, it's very likely that we've hit
       // some bug that's causing us to loop infinitely.
       always_assert(m_stats.reiteration_count++ < 200);
+      if (m_stats.reiteration_count > m_config.reiteration_budget) {
+        TRACE(REG, 3, "Over the reiteration budget\n");
+        ++m_stats.methods_over_budget;
+        return false;
+      }
     }
     TRACE(REG, 7, "IG:\n%s", SHOW(ig));
 
@@ -1121,6 +1144,7 @@ void Allocator::allocate(IRCode* code) {
   TRACE(REG, 3, "Coalesce count: %lu\n", m_stats.moves_coalesced);
   TRACE(REG, 3, "Params spilled too early: %lu\n", m_stats.params_spill_early);
   TRACE(REG, 3, "Net moves: %ld\n", m_stats.net_moves());
+  return true;
 }
 
 } // namespace graph_coloring
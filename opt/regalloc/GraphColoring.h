@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <limits>
 #include <stack>
 
 #include "Interference.h"
@@ -83,16 +84,28 @@ class Allocator {
   struct Config {
     bool use_splitting{false};
     bool use_spill_costs{false};
+    // Allocate the small methods that linear_scan::allocate() handles with
+    // it, and skip the graph coloring loop for them.
+    bool use_linear_scan{false};
+    // allocate() gives up on methods with more instructions than this,
+    // without changing them.
+    size_t instruction_budget{std::numeric_limits<size_t>::max()};
+    // allocate() gives up after this many rounds of spilling. The code is
+    // then equivalent to the original, but not allocated, so callers that set
+    // this should keep a copy of the original to put back.
+    size_t reiteration_budget{std::numeric_limits<size_t>::max()};
   };
 
   struct Stats {
     size_t reiteration_count{0};
+    size_t methods_over_budget{0};
     size_t param_spill_moves{0};
     size_t range_spill_moves{0};
     size_t global_spill_moves{0};
     size_t split_moves{0};
     size_t moves_coalesced{0};
     size_t params_spill_early{0};
+    size_t linear_scan_methods{0};
     size_t moves_inserted() const {
       return param_spill_moves + range_spill_moves + global_spill_moves +
              split_moves;
@@ -151,7 +164,8 @@ class Allocator {
              const RangeSet&,
              IRCode*);
 
-  void allocate(IRCode*);
+  // Returns false if it ran out of budget; see Config.
+  bool allocate(IRCode*);
 
   const Stats& get_stats() const { return m_stats; }
 
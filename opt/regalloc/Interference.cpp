@@ -87,7 +87,7 @@ void Graph::add_edge(reg_t u, reg_t v, bool can_coalesce) {
   //
   // then the final state of the edge between s0 and s1 must be
   // non-coalesceable.
-  m_adj_matrix[Edge(u, v)] = m_adj_matrix[Edge(u, v)] || !can_coalesce;
+  m_adj_matrix.add(u, v, can_coalesce);
 }
 
 uint32_t Node::colorable_limit() const {
@@ -264,11 +264,12 @@ void GraphBuilder::update_node_constraints(IRList::iterator it,
  * register interfere with the live registers in both B0 and B1, so that when
  * the move gets inserted, it does not clobber any live registers.
  */
-Graph GraphBuilder::build(const LivenessFixpointIterator& fixpoint_iter,
+Graph GraphBuilder::build(const DenseLivenessFixpointIterator& fixpoint_iter,
                           IRCode* code,
                           reg_t initial_regs,
                           const RangeSet& range_set) {
   Graph graph;
+  graph.m_adj_matrix.reserve(code->get_registers_size());
   auto ii = InstructionIterable(code);
   for (auto it = ii.begin(); it != ii.end(); ++it) {
     GraphBuilder::update_node_constraints(it.unwrap(), range_set, &graph);
@@ -276,7 +277,7 @@ Graph GraphBuilder::build(const LivenessFixpointIterator& fixpoint_iter,
 
   auto& cfg = code->cfg();
   for (cfg::Block* block : cfg.blocks()) {
-    LivenessDomain live_out = fixpoint_iter.get_live_out_vars_at(block);
+    DenseLivenessDomain live_out = fixpoint_iter.get_live_out_vars_at(block);
     for (auto it = block->rbegin(); it != block->rend(); ++it) {
       if (it->type != MFLOW_OPCODE) {
         continue;
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <boost/functional/hash.hpp>
 #include <boost/range/adaptor/filtered.hpp>
 #include <unordered_map>
@@ -83,6 +84,103 @@ inline size_t hash_value(const OrderedPair<T>& pair) {
   return seed;
 }
 
+/*
+ * The edges of the interference graph, each with whether it can be coalesced.
+ *
+ * Graphs over few registers keep them in a triangular bit matrix indexed by
+ * the register pair, as in Chaitin-Briggs allocators: a lookup is a shift and
+ * a mask, and the matrix takes n * (n + 1) bits for n registers. Larger graphs
+ * are usually sparse, and keep their edges in a hash map instead.
+ */
+class AdjacencyMatrix {
+ public:
+  // The largest number of registers for which the matrix is dense, i.e. at
+  // most 1MB per graph.
+  static constexpr size_t DENSE_MAX_REGS = 2048;
+
+  // Picks the representation for a graph over `regs` registers. Must be
+  // called before any edge is added. Registers beyond `regs` can still be
+  // added later, which grows a dense matrix.
+  void reserve(size_t regs) {
+    always_assert(m_sparse.empty() && m_adjacent.empty());
+    m_dense = regs <= DENSE_MAX_REGS;
+    if (m_dense) {
+      resize(regs);
+    }
+  }
+
+  bool contains(reg_t u, reg_t v) const {
+    if (!m_dense) {
+      return m_sparse.count(Edge(u, v));
+    }
+    auto idx = index(u, v);
+    return idx < m_size && test(m_adjacent, idx);
+  }
+
+  bool is_coalesceable(reg_t u, reg_t v) const {
+    if (!m_dense) {
+      auto it = m_sparse.find(Edge(u, v));
+      return it == m_sparse.end() || !it->second;
+    }
+    auto idx = index(u, v);
+    return idx >= m_size || !test(m_not_coalesceable, idx);
+  }
+
+  // Adds the edge if it is not there yet. An edge that can't be coalesced
+  // stays so.
+  void add(reg_t u, reg_t v, bool can_coalesce) {
+    if (!m_dense) {
+      auto& not_coalesceable = m_sparse[Edge(u, v)];
+      not_coalesceable = not_coalesceable || !can_coalesce;
+      return;
+    }
+    auto idx = index(u, v);
+    if (idx >= m_size) {
+      resize(std::max(u, v) + 1);
+    }
+    set(&m_adjacent, idx);
+    if (!can_coalesce) {
+      set(&m_not_coalesceable, idx);
+    }
+  }
+
+ private:
+  using Edge = OrderedPair<reg_t>;
+  using Word = uint64_t;
+  static constexpr size_t kWordBits = 64;
+
+  // Row r holds the pairs (c, r) with c <= r, so the index of a pair doesn't
+  // depend on the number of registers, and the matrix can grow in place.
+  static size_t index(reg_t u, reg_t v) {
+    size_t lo = std::min(u, v);
+    size_t hi = std::max(u, v);
+    return hi * (hi + 1) / 2 + lo;
+  }
+
+  static bool test(const std::vector<Word>& bits, size_t idx) {
+    return (bits[idx / kWordBits] >> (idx % kWordBits)) & 1;
+  }
+
+  static void set(std::vector<Word>* bits, size_t idx) {
+    (*bits)[idx / kWordBits] |= Word(1) << (idx % kWordBits);
+  }
+
+  void resize(size_t regs) {
+    m_size = regs * (regs + 1) / 2;
+    auto words = (m_size + kWordBits - 1) / kWordBits;
+    m_adjacent.resize(words, 0);
+    m_not_coalesceable.resize(words, 0);
+  }
+
+  bool m_dense{false};
+  // The number of pairs the dense matrix has room for.
+  size_t m_size{0};
+  std::vector<Word> m_adjacent;
+  std::vector<Word> m_not_coalesceable;
+  std::unordered_map<Edge, bool /* not_coalesceable */, boost::hash<Edge>>
+      m_sparse;
+};
+
 } // namespace impl
 
 class Node {
@@ -192,11 +290,11 @@ class Graph {
   }
 
   bool is_adjacent(reg_t u, reg_t v) const {
-    return m_adj_matrix.find(Edge(u, v)) != m_adj_matrix.end();
+    return m_adj_matrix.contains(u, v);
   }
 
   bool is_coalesceable(reg_t u, reg_t v) const {
-    return !is_adjacent(u, v) || !m_adj_matrix.at(Edge(u, v));
+    return m_adj_matrix.is_coalesceable(u, v);
   }
 
   bool has_containment_edge(reg_t u, reg_t v) const {
@@ -209,7 +307,7 @@ class Graph {
    * range encoding. We can use it to make better allocation decisions for
    * these instructions.
    */
-  const LivenessDomain& get_liveness(const IRInstruction* insn) const {
+  const DenseLivenessDomain& get_liveness(const IRInstruction* insn) const {
     return m_range_liveness.at(const_cast<IRInstruction*>(insn));
   }
 
@@ -243,14 +341,12 @@ class Graph {
   // from those without this constraint,
   bool m_separate_node{false};
   std::unordered_map<reg_t, Node> m_nodes;
-  using Edge = impl::OrderedPair<reg_t>;
-  std::unordered_map<Edge, bool /* not_coalesceable */, boost::hash<Edge>>
-      m_adj_matrix;
+  impl::AdjacencyMatrix m_adj_matrix;
   std::unordered_set<ContainmentEdge, boost::hash<ContainmentEdge>>
       m_containment_graph;
   // This map contains the LivenessDomains for all instructions which could
   // potentialy take on the /range format.
-  std::unordered_map<IRInstruction*, LivenessDomain> m_range_liveness;
+  std::unordered_map<IRInstruction*, DenseLivenessDomain> m_range_liveness;
 
   friend class impl::GraphBuilder;
 };
@@ -285,7 +381,7 @@ class GraphBuilder {
                                       Graph*);
 
  public:
-  static Graph build(const LivenessFixpointIterator&,
+  static Graph build(const DenseLivenessFixpointIterator&,
                      IRCode*,
                      reg_t initial_regs,
                      const RangeSet&);
@@ -300,7 +396,7 @@ uint32_t edge_weight_helper(uint8_t, uint8_t);
 
 } // namespace impl
 
-inline Graph build_graph(const LivenessFixpointIterator& fixpoint_iter,
+inline Graph build_graph(const DenseLivenessFixpointIterator& fixpoint_iter,
                          IRCode* code,
                          reg_t initial_regs,
                          const RangeSet& range_set) {
@@ -0,0 +1,236 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "LinearScan.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "ControlFlow.h"
+#include "DexOpcode.h"
+#include "IRInstruction.h"
+#include "Liveness.h"
+#include "Transform.h"
+
+namespace regalloc {
+
+namespace linear_scan {
+
+namespace {
+
+constexpr uint32_t NO_POSITION = std::numeric_limits<uint32_t>::max();
+constexpr reg_t NO_REG = std::numeric_limits<reg_t>::max();
+
+struct Interval {
+  uint32_t start{NO_POSITION};
+  uint32_t end{0};
+
+  bool empty() const { return start == NO_POSITION; }
+
+  void cover(uint32_t pos) {
+    start = std::min(start, pos);
+    end = std::max(end, pos);
+  }
+};
+
+bool has_2addr_form(IROpcode op) {
+  return op >= OPCODE_ADD_INT && op <= OPCODE_REM_DOUBLE;
+}
+
+/*
+ * Whether the method is in the subset that the linear scan handles: no wide
+ * registers, which would need aligned pairs, and no range instructions, which
+ * would need consecutive registers.
+ */
+bool is_candidate(IRCode* code) {
+  for (const auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    if (insn->dests_size() && insn->dest_is_wide()) {
+      return false;
+    }
+    if (insn->srcs_size() > dex_opcode::NON_RANGE_MAX) {
+      return false;
+    }
+    for (size_t i = 0; i < insn->srcs_size(); ++i) {
+      if (insn->src_is_wide(i)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/*
+ * The register that a register would like to share, because it is defined by
+ * a move, a 2addr candidate or a check-cast of it.
+ */
+struct Hint {
+  reg_t reg{NO_REG};
+  // The position of the move or 2addr candidate, and whether the source dies
+  // there. A check-cast has no position: the result is defined one position
+  // later, by the move-result-pseudo, and only shares with a source that is
+  // dead by then.
+  uint32_t pos{NO_POSITION};
+  bool dies{false};
+};
+
+/*
+ * Number the instructions in the order of cfg.blocks(), and cover, for each
+ * register, all the positions where it is defined, used, or live-out. Returns
+ * false if some block has no liveness, i.e. can't reach the exit.
+ */
+bool build_intervals(IRCode* code,
+                     std::vector<Interval>* intervals,
+                     std::vector<Hint>* hints) {
+  auto& cfg = code->cfg();
+  cfg.calculate_exit_block();
+  DenseLivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(DenseLivenessDomain(code->get_registers_size()));
+
+  uint32_t block_start = 0;
+  for (cfg::Block* block : cfg.blocks()) {
+    uint32_t pos = block_start;
+    for (auto it = block->begin(); it != block->end(); ++it) {
+      if (it->type == MFLOW_OPCODE) {
+        ++pos;
+      }
+    }
+    block_start = pos;
+    auto live = fixpoint_iter.get_live_out_vars_at(block);
+    if (live.is_bottom()) {
+      return false;
+    }
+    IRInstruction* next_insn = nullptr;
+    for (auto it = block->rbegin(); it != block->rend(); ++it) {
+      if (it->type != MFLOW_OPCODE) {
+        continue;
+      }
+      --pos;
+      auto insn = it->insn;
+      auto op = insn->opcode();
+      for (auto reg : live.elements()) {
+        (*intervals)[reg].cover(pos);
+      }
+      if (insn->dests_size()) {
+        (*intervals)[insn->dest()].cover(pos);
+      }
+      for (size_t i = 0; i < insn->srcs_size(); ++i) {
+        (*intervals)[insn->src(i)].cover(pos);
+      }
+      if (is_move(op) || has_2addr_form(op)) {
+        auto src = insn->src(0);
+        (*hints)[insn->dest()] = {src, pos, !live.contains(src)};
+      } else if (op == OPCODE_CHECK_CAST && next_insn != nullptr &&
+                 opcode::is_move_result_pseudo(next_insn->opcode())) {
+        (*hints)[next_insn->dest()] = {insn->src(0), NO_POSITION, false};
+      }
+      fixpoint_iter.analyze_instruction(insn, &live);
+      next_insn = insn;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+bool allocate(IRCode* code, Stats* stats) {
+  if (code->get_registers_size() == 0 || !is_candidate(code)) {
+    return false;
+  }
+  std::vector<reg_t> params;
+  for (const auto& mie : InstructionIterable(code->get_param_instructions())) {
+    params.push_back(mie.insn->dest());
+  }
+  if (params.size() > MAX_REGS) {
+    return false;
+  }
+  size_t max_colors = MAX_REGS - params.size();
+
+  std::vector<Interval> intervals(code->get_registers_size());
+  std::vector<Hint> hints(code->get_registers_size());
+  if (!build_intervals(code, &intervals, &hints)) {
+    return false;
+  }
+  std::vector<bool> is_param(code->get_registers_size(), false);
+  for (auto reg : params) {
+    is_param[reg] = true;
+  }
+  std::vector<reg_t> order;
+  for (reg_t reg = 0; reg < code->get_registers_size(); ++reg) {
+    if (!is_param[reg] && !intervals[reg].empty()) {
+      order.push_back(reg);
+    }
+  }
+  std::sort(order.begin(), order.end(), [&](reg_t a, reg_t b) {
+    return intervals[a].start != intervals[b].start
+               ? intervals[a].start < intervals[b].start
+               : a < b;
+  });
+
+  // The registers that hold each color, if any. There are at most MAX_REGS
+  // of them, so a plain scan beats keeping them sorted by end.
+  std::vector<reg_t> holder(max_colors, NO_REG);
+  std::vector<reg_t> color(code->get_registers_size(), NO_REG);
+  size_t colors_used = 0;
+  for (auto reg : order) {
+    const auto& interval = intervals[reg];
+    for (auto& h : holder) {
+      if (h != NO_REG && intervals[h].end < interval.start) {
+        h = NO_REG;
+      }
+    }
+    reg_t chosen = NO_REG;
+    const auto& hint = hints[reg];
+    if (hint.reg != NO_REG && color[hint.reg] != NO_REG) {
+      auto c = color[hint.reg];
+      // The hint may still hold its color if it dies where `reg` is defined,
+      // and `reg` isn't live before that. The two then only meet at that
+      // instruction, where they don't interfere.
+      if (holder[c] == NO_REG ||
+          (holder[c] == hint.reg && hint.dies &&
+           hint.pos == interval.start &&
+           intervals[hint.reg].end == hint.pos)) {
+        chosen = c;
+      }
+    }
+    if (chosen == NO_REG) {
+      auto it = std::find(holder.begin(), holder.end(), NO_REG);
+      if (it == holder.end()) {
+        return false;
+      }
+      chosen = it - holder.begin();
+    }
+    holder[chosen] = reg;
+    color[reg] = chosen;
+    colors_used = std::max(colors_used, size_t(chosen) + 1);
+  }
+
+  transform::RegMap reg_map;
+  for (auto reg : order) {
+    reg_map.emplace(reg, color[reg]);
+  }
+  for (size_t i = 0; i < params.size(); ++i) {
+    reg_map.emplace(params[i], colors_used + i);
+  }
+  transform::remap_registers(code, reg_map);
+  code->set_registers_size(colors_used + params.size());
+
+  auto ii = InstructionIterable(code);
+  for (auto it = ii.begin(); it != ii.end(); ++it) {
+    auto insn = it->insn;
+    if (is_move(insn->opcode()) && insn->dest() == insn->src(0)) {
+      code->remove_opcode(it.unwrap());
+      ++stats->moves_coalesced;
+    }
+  }
+  return true;
+}
+
+} // namespace linear_scan
+
+} // namespace regalloc
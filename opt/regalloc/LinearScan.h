@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include "IRCode.h"
+
+namespace regalloc {
+
+using reg_t = uint16_t;
+
+namespace linear_scan {
+
+// The size of the register frame that the linear scan allocates into. Every
+// operand of every instruction can address v0 to v15, so a method that fits
+// needs no spilling at all.
+constexpr size_t MAX_REGS = 16;
+
+struct Stats {
+  size_t moves_coalesced{0};
+};
+
+/*
+ * A fast path for the small methods that make up most of an app. It allocates
+ * the registers of methods with no wide registers and no range instructions,
+ * by a linear scan over live intervals, provided the whole frame fits in
+ * MAX_REGS registers. When it doesn't apply, it returns false and leaves the
+ * code untouched, and the method must go through the graph coloring
+ * allocator.
+ *
+ * The intervals are the hulls of the instruction positions where a register
+ * is live, in the order of cfg.blocks(), so two registers whose intervals
+ * don't overlap never interfere. A register defined by a move (or a 2addr
+ * candidate, or a check-cast) takes the register of its source when the
+ * source dies there, and the moves that end up with the same source and dest
+ * are removed.
+ *
+ * The code must have a non-editable CFG, with registers numbered as by
+ * live_range::renumber_registers.
+ */
+bool allocate(IRCode*, Stats*);
+
+} // namespace linear_scan
+
+} // namespace regalloc
@@ -8,12 +8,15 @@
 #include "RegAlloc.h"
 
 #include <boost/functional/hash.hpp>
+#include <limits>
+#include <mutex>
 
 #include "Dataflow.h"
 #include "DexUtil.h"
 #include "GraphColoring.h"
 #include "IRCode.h"
 #include "IRInstruction.h"
+#include "IncrementalPassCache.h"
 #include "LiveRange.h"
 #include "Transform.h"
 #include "Walkers.h"
@@ -22,73 +25,149 @@
 
 using namespace regalloc;
 
-void RegAllocPass::run_pass(DexStoresVector& stores,
-                            ConfigFiles&,
-                            PassManager& mgr) {
-  using Output = graph_coloring::Allocator::Stats;
-  auto scope = build_class_scope(stores);
-  auto stats = walk::parallel::reduce_methods<Output>(
-      scope,
-      [this](DexMethod* m) { // mapper
-        graph_coloring::Allocator::Stats stats;
-        if (m->get_code() == nullptr) {
-          return stats;
+namespace {
+
+// The allocator's statistics for one method, as the incremental cache stores
+// them.
+IncrementalPassCache::Stats to_cache_stats(
+    const graph_coloring::Allocator::Stats& stats) {
+  return {stats.reiteration_count,  stats.methods_over_budget,
+          stats.param_spill_moves,  stats.range_spill_moves,
+          stats.global_spill_moves, stats.split_moves,
+          stats.moves_coalesced,    stats.params_spill_early,
+          stats.linear_scan_methods};
+}
+
+graph_coloring::Allocator::Stats from_cache_stats(
+    const IncrementalPassCache::Stats& cached) {
+  graph_coloring::Allocator::Stats stats;
+  stats.reiteration_count = cached.at(0);
+  stats.methods_over_budget = cached.at(1);
+  stats.param_spill_moves = cached.at(2);
+  stats.range_spill_moves = cached.at(3);
+  stats.global_spill_moves = cached.at(4);
+  stats.split_moves = cached.at(5);
+  stats.moves_coalesced = cached.at(6);
+  stats.params_spill_early = cached.at(7);
+  stats.linear_scan_methods = cached.at(8);
+  return stats;
+}
+
+class RegAllocRunner : public Pass::MethodRunner {
+ public:
+  RegAllocRunner(ConfigFiles& cfg,
+                 PassManager& mgr,
+                 const graph_coloring::Allocator::Config& allocator_config)
+      : m_allocator_config(allocator_config), m_cache(cfg, mgr) {}
+
+  void run(DexMethod* m) override {
+    auto cached = m_cache.run(m, /* summarize_refs */ false, [&] {
+      graph_coloring::Allocator::Stats stats;
+      auto& code = *m->get_code();
+      TRACE(REG, 3, "Handling %s:\n", SHOW(m));
+      TRACE(REG,
+            5,
+            "regs:%d code:\n%s\n",
+            code.get_registers_size(),
+            SHOW(&code));
+      if (code.count_opcodes() > m_allocator_config.instruction_budget) {
+        TRACE(REG, 3, "Over the instruction budget\n");
+        ++stats.methods_over_budget;
+        return to_cache_stats(stats);
+      }
+      // The allocator may give up halfway, so keep the original to put back.
+      std::unique_ptr<IRCode> original;
+      if (m_allocator_config.reiteration_budget !=
+          std::numeric_limits<size_t>::max()) {
+        original = std::make_unique<IRCode>(code);
+      }
+      try {
+        // The transformations below all require a CFG. Build it once
+        // here instead of requiring each transform to build it.
+        code.build_cfg(/* editable */ false);
+        // It doesn't make sense to try to allocate registers in
+        // unreachable code. Remove it so that the allocator doesn't
+        // get confused.
+        transform::remove_unreachable_blocks(&code);
+        live_range::renumber_registers(&code, /* width_aware */ false);
+        graph_coloring::Allocator allocator(m_allocator_config);
+        bool allocated = allocator.allocate(&code);
+        stats.accumulate(allocator.get_stats());
+        if (!allocated) {
+          always_assert(original != nullptr);
+          m->set_code(std::move(original));
+          return to_cache_stats(stats);
         }
-        auto& code = *m->get_code();
 
-        TRACE(REG, 3, "Handling %s:\n", SHOW(m));
         TRACE(REG,
               5,
-              "regs:%d code:\n%s\n",
+              "After alloc: regs:%d code:\n%s\n",
               code.get_registers_size(),
               SHOW(&code));
-        try {
-          // The transformations below all require a CFG. Build it once
-          // here instead of requiring each transform to build it.
-          code.build_cfg(/* editable */ false);
-          // It doesn't make sense to try to allocate registers in
-          // unreachable code. Remove it so that the allocator doesn't
-          // get confused.
-          transform::remove_unreachable_blocks(&code);
-          live_range::renumber_registers(&code, /* width_aware */ false);
-          graph_coloring::Allocator allocator(m_allocator_config);
-          allocator.allocate(&code);
-          stats.accumulate(allocator.get_stats());
-
-          TRACE(REG,
-                5,
-                "After alloc: regs:%d code:\n%s\n",
-                code.get_registers_size(),
-                SHOW(&code));
-        } catch (std::exception&) {
-          fprintf(stderr, "Failed to allocate %s\n", SHOW(m));
-          fprintf(stderr, "%s\n", SHOW(code.cfg()));
-          throw;
-        }
-        return stats;
-      },
-      [](Output a, Output b) { // reducer
-        a.accumulate(b);
-        return a;
-      });
-
-  TRACE(REG, 1, "Total reiteration count: %lu\n", stats.reiteration_count);
-  TRACE(REG, 1, "Total Params spilled early: %lu\n", stats.params_spill_early);
-  TRACE(REG, 1, "Total spill count: %lu\n", stats.moves_inserted());
-  TRACE(REG, 1, "  Total param spills: %lu\n", stats.param_spill_moves);
-  TRACE(REG, 1, "  Total range spills: %lu\n", stats.range_spill_moves);
-  TRACE(REG, 1, "  Total global spills: %lu\n", stats.global_spill_moves);
-  TRACE(REG, 1, "  Total splits: %lu\n", stats.split_moves);
-  TRACE(REG, 1, "Total coalesce count: %lu\n", stats.moves_coalesced);
-  TRACE(REG, 1, "Total net moves: %ld\n", stats.net_moves());
-
-  mgr.incr_metric("param spilled too early", stats.params_spill_early);
-  mgr.incr_metric("reiteration_count", stats.reiteration_count);
-  mgr.incr_metric("spill_count", stats.moves_inserted());
-  mgr.incr_metric("coalesce_count", stats.moves_coalesced);
-  mgr.incr_metric("net_moves", stats.net_moves());
+      } catch (std::exception&) {
+        fprintf(stderr, "Failed to allocate %s\n", SHOW(m));
+        fprintf(stderr, "%s\n", SHOW(code.cfg()));
+        throw;
+      }
+      return to_cache_stats(stats);
+    });
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+    m_stats.accumulate(from_cache_stats(cached));
+  }
 
+  void finish(PassManager& mgr) override {
+    m_cache.finish(mgr);
+    const auto& stats = m_stats;
+
+    TRACE(REG, 1, "Total reiteration count: %lu\n", stats.reiteration_count);
+    TRACE(REG, 1, "Total Params spilled early: %lu\n",
+          stats.params_spill_early);
+    TRACE(REG, 1, "Total spill count: %lu\n", stats.moves_inserted());
+    TRACE(REG, 1, "  Total param spills: %lu\n", stats.param_spill_moves);
+    TRACE(REG, 1, "  Total range spills: %lu\n", stats.range_spill_moves);
+    TRACE(REG, 1, "  Total global spills: %lu\n", stats.global_spill_moves);
+    TRACE(REG, 1, "  Total splits: %lu\n", stats.split_moves);
+    TRACE(REG, 1, "Total coalesce count: %lu\n", stats.moves_coalesced);
+    TRACE(REG, 1, "Total net moves: %ld\n", stats.net_moves());
+    TRACE(REG, 1, "Total linear scan methods: %lu\n",
+          stats.linear_scan_methods);
+
+    mgr.incr_metric("param spilled too early", stats.params_spill_early);
+    mgr.incr_metric("reiteration_count", stats.reiteration_count);
+    mgr.incr_metric("spill_count", stats.moves_inserted());
+    mgr.incr_metric("coalesce_count", stats.moves_coalesced);
+    mgr.incr_metric("net_moves", stats.net_moves());
+    mgr.incr_metric("linear_scan_methods", stats.linear_scan_methods);
+    mgr.incr_metric("methods_over_budget", stats.methods_over_budget);
+  }
+
+ private:
+  const graph_coloring::Allocator::Config& m_allocator_config;
+  IncrementalPassCache m_cache;
+  std::mutex m_stats_mutex;
+  graph_coloring::Allocator::Stats m_stats;
+};
+
+} // namespace
+
+std::unique_ptr<Pass::MethodRunner> RegAllocPass::method_runner(
+    DexStoresVector&, ConfigFiles& cfg, PassManager& mgr) {
+  auto runner = std::make_unique<RegAllocRunner>(cfg, mgr, m_allocator_config);
+  // The passes after this one must see that it ran, even when they are run
+  // together with it one method at a time.
   mgr.record_running_regalloc();
+  return runner;
+}
+
+void RegAllocPass::run_pass(DexStoresVector& stores,
+                            ConfigFiles& cfg,
+                            PassManager& mgr) {
+  auto runner = method_runner(stores, cfg, mgr);
+  walk::parallel::code(build_class_scope(stores),
+                       [&](DexMethod* m, IRCode&) { runner->run(m); },
+                       walk::parallel::default_num_threads(),
+                       walk::parallel::Split::LARGE_CLASSES);
+  runner->finish(mgr);
 }
 
 static RegAllocPass s_pass;
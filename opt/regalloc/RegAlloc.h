@@ -18,9 +18,32 @@ class RegAllocPass : public Pass {
   virtual void configure_pass(const JsonWrapper& jw) override {
     jw.get("live_range_splitting", false, m_allocator_config.use_splitting);
     jw.get("use_spill_costs", false, m_allocator_config.use_spill_costs);
+    jw.get("use_linear_scan", false, m_allocator_config.use_linear_scan);
+    // Methods over a budget keep their registers as they were.
+    int64_t budget;
+    jw.get("instruction_budget", 0, budget);
+    always_assert(budget >= 0);
+    if (budget > 0) {
+      m_allocator_config.instruction_budget = static_cast<size_t>(budget);
+    }
+    jw.get("reiteration_budget", 0, budget);
+    always_assert(budget >= 0);
+    if (budget > 0) {
+      m_allocator_config.reiteration_budget = static_cast<size_t>(budget);
+    }
   }
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
+  std::unique_ptr<MethodRunner> method_runner(DexStoresVector&,
+                                              ConfigFiles&,
+                                              PassManager&) override;
+
+  bool is_method_local() const override { return true; }
+
+  analysis::Set preserved_analyses() const override {
+    return analysis::CODE_AGNOSTIC;
+  }
+
  private:
   regalloc::graph_coloring::Allocator::Config m_allocator_config;
 };
@@ -11,27 +11,25 @@ namespace regalloc {
 
 // Calculate potential split costs for each live range. Also store information
 // of catch block and move-result for later use.
-void calc_split_costs(const LivenessFixpointIterator& fixpoint_iter,
+void calc_split_costs(const DenseLivenessFixpointIterator& fixpoint_iter,
                       IRCode* code,
                       SplitCosts* split_costs) {
   auto& cfg = code->cfg();
   for (cfg::Block* block : cfg.blocks()) {
-    LivenessDomain live_out = fixpoint_iter.get_live_out_vars_at(block);
+    DenseLivenessDomain live_out = fixpoint_iter.get_live_out_vars_at(block);
     // Incrementing load number for each death in
     // LiveOut(block) - LiveIn(succs).
     for (auto& succ : block->succs()) {
-      LivenessDomain live_in =
-          fixpoint_iter.get_live_in_vars_at(succ->target());
-      for (auto reg : live_out.elements()) {
-        if (!live_in.contains(reg)) {
-          split_costs->increase_load(reg);
-          // Record how many death on edge occured at certain catch block.
-          if (succ->type() == cfg::EDGE_THROW) {
-            split_costs->add_catch_block(reg, succ->target());
-          } else {
-            // Record death on edge to non-catch block;
-            split_costs->add_other_block(reg, succ->target());
-          }
+      DenseLivenessDomain dying = live_out;
+      dying.difference_with(fixpoint_iter.get_live_in_vars_at(succ->target()));
+      for (auto reg : dying.elements()) {
+        split_costs->increase_load(reg);
+        // Record how many death on edge occured at certain catch block.
+        if (succ->type() == cfg::EDGE_THROW) {
+          split_costs->add_catch_block(reg, succ->target());
+        } else {
+          // Record death on edge to non-catch block;
+          split_costs->add_other_block(reg, succ->target());
         }
       }
     }
@@ -136,8 +134,8 @@ void store_info_for_branch(const std::pair<cfg::Block*, cfg::Block*>& block_edge
 // where B4 does the loading of s1.
 size_t split_for_block(const SplitPlan& split_plan,
                        const SplitCosts& split_costs,
-                       const LivenessDomain& live_out,
-                       const LivenessFixpointIterator& fixpoint_iter,
+                       const DenseLivenessDomain& live_out,
+                       const DenseLivenessFixpointIterator& fixpoint_iter,
                        const Graph& ig,
                        cfg::Block* block,
                        std::unordered_map<reg_t, reg_t>* load_store_reg,
@@ -145,7 +143,8 @@ size_t split_for_block(const SplitPlan& split_plan,
                        BlockLoadInfo* block_load_info) {
   size_t split_move = 0;
   for (auto& succ : block->succs()) {
-    LivenessDomain live_in = fixpoint_iter.get_live_in_vars_at(succ->target());
+    DenseLivenessDomain live_in =
+        fixpoint_iter.get_live_in_vars_at(succ->target());
     for (auto reg : live_out.elements()) {
       if (live_in.contains(reg)) {
         continue;
@@ -238,7 +237,7 @@ size_t split_for_block(const SplitPlan& split_plan,
 size_t split_for_define(const SplitPlan& split_plan,
                         const Graph& ig,
                         const IRInstruction* insn,
-                        const LivenessDomain& live_out,
+                        const DenseLivenessDomain& live_out,
                         IRCode* code,
                         std::unordered_map<reg_t, reg_t>* load_store_reg,
                         IRList::iterator it) {
@@ -285,7 +284,7 @@ size_t split_for_define(const SplitPlan& split_plan,
 size_t split_for_last_use(const SplitPlan& split_plan,
                           const Graph& ig,
                           const IRInstruction* insn,
-                          const LivenessDomain& live_out,
+                          const DenseLivenessDomain& live_out,
                           cfg::Block* block,
                           IRCode* code,
                           std::unordered_map<reg_t, reg_t>* load_store_reg,
@@ -434,7 +433,7 @@ size_t insert_insn_between_blocks(const BlockLoadInfo& block_load_info,
 // Live range splitting, Theory from
 // K. Cooper & L. Simpson. Live Range Splitting in a Graph Coloring
 // Register Allocator.
-size_t split(const LivenessFixpointIterator& fixpoint_iter,
+size_t split(const DenseLivenessFixpointIterator& fixpoint_iter,
              const SplitPlan& split_plan,
              const SplitCosts& split_costs,
              const Graph& ig,
@@ -447,7 +446,7 @@ size_t split(const LivenessFixpointIterator& fixpoint_iter,
   auto& cfg = code->cfg();
 
   for (cfg::Block* block : cfg.blocks()) {
-    LivenessDomain live_out = fixpoint_iter.get_live_out_vars_at(block);
+    DenseLivenessDomain live_out = fixpoint_iter.get_live_out_vars_at(block);
     // Split for death of reg on edge from block to its succs blocks.
     split_move += split_for_block(split_plan,
                                   split_costs,
@@ -120,9 +120,11 @@ struct BlockLoadInfo {
 using namespace interference;
 
 // Count load and store for possible split
-void calc_split_costs(const LivenessFixpointIterator&, IRCode*, SplitCosts*);
+void calc_split_costs(const DenseLivenessFixpointIterator&,
+                      IRCode*,
+                      SplitCosts*);
 
-size_t split(const LivenessFixpointIterator&,
+size_t split(const DenseLivenessFixpointIterator&,
              const SplitPlan&,
              const SplitCosts&,
              const Graph&,
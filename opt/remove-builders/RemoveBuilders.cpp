@@ -10,9 +10,12 @@
 #include <boost/regex.hpp>
 #include <tuple>
 
+#include "AnalysisManager.h"
 #include "Dataflow.h"
 #include "DexUtil.h"
 #include "IRCode.h"
+#include "LocalPointersAnalysis.h"
+#include "PassManager.h"
 #include "RemoveBuildersHelper.h"
 #include "Resolver.h"
 #include "Walkers.h"
@@ -95,6 +98,33 @@ bool this_arg_escapes(DexClass* cls, bool enable_buildee_constr_change) {
   return result;
 }
 
+// Checks, using the escape summaries, if the `this` argument of an instance
+// method of the class may escape. This is a cheaper and stricter version of
+// the check above: calls to the other methods of the builder are only
+// non-escaping if the call graph resolves them.
+bool this_arg_may_escape(DexClass* cls,
+                         const local_pointers::SummaryCMap& summaries) {
+  auto may_escape = [&](DexMethod* m) {
+    if (!m->get_code() || is_static(m)) {
+      return false;
+    }
+    auto it = summaries.find(m);
+    return it == summaries.end() ||
+           it->second.escaping_parameters.count(0) != 0;
+  };
+  for (DexMethod* m : cls->get_dmethods()) {
+    if (may_escape(m)) {
+      return true;
+    }
+  }
+  for (DexMethod* m : cls->get_vmethods()) {
+    if (may_escape(m)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 std::vector<DexMethod*> get_static_methods(
     const std::vector<DexMethod*>& dmethods) {
   std::vector<DexMethod*> static_methods;
@@ -250,20 +280,67 @@ void RemoveBuildersPass::run_pass(DexStoresVector& stores,
     }
   }
 
-  std::unordered_set<DexType*> escaped_builders;
-  walk::methods(scope, [&](DexMethod* m) {
-    auto builders = created_builders(m);
-    for (DexType* builder : builders) {
-      if (escapes_stack(builder, m)) {
-        TRACE(BUILDERS,
-              3,
-              "%s escapes in %s\n",
-              SHOW(builder),
-              m->get_deobfuscated_name().c_str());
-        escaped_builders.emplace(builder);
-      }
-    }
+  size_t total_builders = m_builders.size();
+
+  // Drop the builders whose `this` may escape one of their methods, or one of
+  // the methods of their super classes, according to the escape summaries.
+  // The summaries are computed once for the whole scope, in parallel. Only
+  // the methods that create one of the remaining builders go through the
+  // per-method analyses and the speculative inlining below.
+  walk::parallel::code(scope, [](DexMethod*, IRCode& code) {
+    code.build_cfg(/* editable */ false);
+    code.cfg().calculate_exit_block();
   });
+  local_pointers::SummaryCMap escape_summaries;
+  local_pointers::analyze_scope_summaries(
+      scope, mgr.analyses().call_graph(scope), &escape_summaries);
+  std::unordered_map<DexType*, bool> summary_escapes;
+  std::function<bool(DexType*)> hierarchy_may_escape = [&](DexType* type) {
+    if (type == nullptr || type == obj_type) {
+      return false;
+    }
+    auto it = summary_escapes.find(type);
+    if (it != summary_escapes.end()) {
+      return it->second;
+    }
+    auto cls = type_class(type);
+    bool escapes = cls == nullptr || cls->is_external() ||
+                   this_arg_may_escape(cls, escape_summaries) ||
+                   hierarchy_may_escape(cls->get_super_class());
+    summary_escapes.emplace(type, escapes);
+    return escapes;
+  };
+  for (auto it = m_builders.begin(); it != m_builders.end();) {
+    if (hierarchy_may_escape(*it)) {
+      TRACE(BUILDERS, 3, "this may escape in %s\n", SHOW(*it));
+      it = m_builders.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  size_t summary_candidates = m_builders.size();
+
+  auto escaped_builders = walk::parallel::accumulate_methods<
+      std::unordered_set<DexType*>>(
+      scope,
+      [&](DexMethod* m) {
+        std::unordered_set<DexType*> escaped;
+        for (DexType* builder : created_builders(m)) {
+          if (escapes_stack(builder, m)) {
+            TRACE(BUILDERS,
+                  3,
+                  "%s escapes in %s\n",
+                  SHOW(builder),
+                  m->get_deobfuscated_name().c_str());
+            escaped.emplace(builder);
+          }
+        }
+        return escaped;
+      },
+      [](std::unordered_set<DexType*>& left,
+         std::unordered_set<DexType*>&& right) {
+        left.insert(right.begin(), right.end());
+      });
 
   std::unordered_set<DexType*> stack_only_builders;
   for (DexType* builder : m_builders) {
@@ -378,7 +455,8 @@ void RemoveBuildersPass::run_pass(DexStoresVector& stores,
   // take care of it.
   gather_removal_builder_stats(removed_builders, kept_builders);
 
-  mgr.set_metric("total_builders", m_builders.size());
+  mgr.set_metric("total_builders", total_builders);
+  mgr.set_metric("summary_candidates", summary_candidates);
   mgr.set_metric("stack_only_builders", stack_only_builders.size());
   mgr.set_metric("no_escapes", no_escapes.size());
   mgr.incr_metric(METRIC_CLASSES_REMOVED, b_counter.classes_removed);
@@ -386,7 +464,11 @@ void RemoveBuildersPass::run_pass(DexStoresVector& stores,
   mgr.incr_metric(METRIC_FIELDS_REMOVED, b_counter.fields_removed);
   mgr.incr_metric(METRIC_METHODS_CLEARED, b_counter.methods_cleared);
 
-  TRACE(BUILDERS, 1, "Total builders: %d\n", m_builders.size());
+  TRACE(BUILDERS, 1, "Total builders: %d\n", total_builders);
+  TRACE(BUILDERS,
+        1,
+        "Builders that don't let `this` escape per the summaries: %d\n",
+        summary_candidates);
   TRACE(BUILDERS, 1, "Stack-only builders: %d\n", stack_only_builders.size());
   TRACE(BUILDERS,
         1,
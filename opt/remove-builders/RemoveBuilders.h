@@ -20,6 +20,11 @@ class RemoveBuildersPass : public Pass {
 
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
+  // The escape summaries of the whole scope filter the builders.
+  analysis::Set required_analyses() const override {
+    return analysis::CALL_GRAPH;
+  }
+
  private:
   std::unordered_set<DexType*> m_builders;
   bool m_enable_buildee_constr_change;
@@ -623,7 +623,7 @@ IROpcode get_iget_type(DexField* field) {
  */
 bool params_change_regs(DexMethod* method) {
   DexProto* proto = method->get_proto();
-  auto args = proto->get_args()->get_type_list();
+  const auto& args = proto->get_args()->get_type_list();
 
   auto code = method->get_code();
   code->build_cfg(/* editable */ false);
@@ -7,9 +7,15 @@
 
 #include "RemoveInterfacePass.h"
 
+#include <numeric>
+
+#include "AnalysisManager.h"
 #include "Creators.h"
 #include "DexStoreUtil.h"
 #include "DexUtil.h"
+#include "Parallel.h"
+#include "PassManager.h"
+#include "ReferenceIndex.h"
 #include "Resolver.h"
 #include "TypeReference.h"
 #include "TypeSystem.h"
@@ -160,24 +166,43 @@ DexMethod* generate_dispatch(const DexType* base_type,
   return materialized_dispatch(dispatch_owner, mc);
 }
 
-void update_interface_calls(
+// Returns the methods whose code changed, in order.
+std::vector<DexMethod*> update_interface_calls(
     const Scope& scope,
     const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee) {
-  auto patcher = [&old_to_new_callee](DexMethod*, IRInstruction* insn) {
-    if (!insn->has_method()) {
-      return;
-    }
-    const auto method =
-        resolve_method(insn->get_method(), opcode_to_search(insn));
-    if (method == nullptr || old_to_new_callee.count(method) == 0) {
-      return;
+  auto patcher = [&old_to_new_callee](DexMethod* meth) {
+    std::vector<DexMethod*> updated;
+    auto code = meth->get_code();
+    if (!code) {
+      return updated;
     }
-    auto new_callee = old_to_new_callee.at(method);
-    TRACE(RM_INTF, 9, "Updated call %s to %s\n", SHOW(insn), SHOW(new_callee));
-    insn->set_method(new_callee);
-    insn->set_opcode(OPCODE_INVOKE_STATIC);
+    for (const auto& mie : InstructionIterable(code)) {
+      auto insn = mie.insn;
+      if (!insn->has_method()) {
+        continue;
+      }
+      const auto method =
+          resolve_method(insn->get_method(), opcode_to_search(insn));
+      if (method == nullptr || old_to_new_callee.count(method) == 0) {
+        continue;
+      }
+      auto new_callee = old_to_new_callee.at(method);
+      TRACE(RM_INTF, 9, "Updated call %s to %s\n", SHOW(insn),
+            SHOW(new_callee));
+      insn->set_method(new_callee);
+      insn->set_opcode(OPCODE_INVOKE_STATIC);
+      updated = {meth};
+    }
+    return updated;
   };
-  walk::parallel::opcodes(scope, patcher);
+  auto updated = walk::parallel::accumulate_methods<std::vector<DexMethod*>>(
+      scope,
+      patcher,
+      [](std::vector<DexMethod*>& left, std::vector<DexMethod*>&& right) {
+        left.insert(left.end(), right.begin(), right.end());
+      });
+  std::sort(updated.begin(), updated.end(), compare_dexmethods);
+  return updated;
 }
 
 /**
@@ -241,40 +266,44 @@ void remove_interface_references(
     const Scope& scope,
     const TypeSystem& type_system,
     const DexType* root,
-    const std::unordered_set<const DexType*>& interfaces) {
-
-  auto patcher = [&](DexMethod*, IRInstruction* insn) {
-    if (!insn->has_type()) {
-      return;
-    }
-    const auto ref_type = insn->get_type();
-    auto type = get_array_type_or_self(ref_type);
-    if (interfaces.count(type) == 0) {
-      return;
-    }
-    auto opcode = insn->opcode();
-    if (is_opcode_excluded(opcode)) {
-      always_assert_log(false, "Unexpected opcode %s on %s\n", SHOW(opcode),
-                        SHOW(type));
+    const std::unordered_set<const DexType*>& interfaces,
+    ReferenceIndex& refs) {
+  std::vector<DexMethod*> updated;
+  for (const auto type : interfaces) {
+    // Copied, since the update below changes the referrers.
+    auto referrers = refs.type_referrers(type);
+    if (referrers.empty()) {
+      continue;
     }
     always_assert(type_class(type));
     auto new_type = get_replacement_type(type_system, type, root);
-    if (is_array(ref_type)) {
-      const auto array_merger_type = make_array_type(new_type);
-      insn->set_type(array_merger_type);
-      TRACE(RM_INTF,
-            9,
-            " removing %s referencing array type of %s\n",
-            SHOW(insn),
-            SHOW(type));
-    } else {
-      insn->set_type(const_cast<DexType*>(new_type));
-      TRACE(RM_INTF, 9, " removing %s referencing %s\n", SHOW(insn),
-            SHOW(type));
+    for (const auto& referrer : referrers) {
+      auto insn = referrer.insn;
+      const auto ref_type = insn->get_type();
+      auto opcode = insn->opcode();
+      if (is_opcode_excluded(opcode)) {
+        always_assert_log(false, "Unexpected opcode %s on %s\n", SHOW(opcode),
+                          SHOW(type));
+      }
+      if (is_array(ref_type)) {
+        const auto array_merger_type = make_array_type(new_type);
+        insn->set_type(array_merger_type);
+        TRACE(RM_INTF,
+              9,
+              " removing %s referencing array type of %s\n",
+              SHOW(insn),
+              SHOW(type));
+      } else {
+        insn->set_type(const_cast<DexType*>(new_type));
+        TRACE(RM_INTF, 9, " removing %s referencing %s\n", SHOW(insn),
+              SHOW(type));
+      }
+      updated.push_back(referrer.method);
     }
-  };
-
-  walk::parallel::opcodes(scope, patcher);
+  }
+  std::sort(updated.begin(), updated.end(), compare_dexmethods);
+  updated.erase(std::unique(updated.begin(), updated.end()), updated.end());
+  refs.update_methods(updated);
 
   std::unordered_map<const DexType*, DexType*> old_to_new;
   for (const auto intf : interfaces) {
@@ -298,11 +327,11 @@ bool has_targets_to_skip(
 }
 
 size_t exclude_unremovables(
-    const Scope& scope,
     const DexStoresVector& stores,
     const TypeSystem& type_system,
     const std::unordered_set<const DexType*>& skip_multiple_targets_roots,
     bool include_primary_dex,
+    const ReferenceIndex& refs,
     TypeSet& candidates) {
   size_t count = 0;
   always_assert(stores.size());
@@ -357,41 +386,19 @@ size_t exclude_unremovables(
     }
   }
 
-  // Scan unsupported opcodes.
-  auto patcher = [&](DexMethod* meth) {
-    std::unordered_set<const DexType*> current_excluded;
-    auto code = meth->get_code();
-    if (!code) {
-      return current_excluded;
-    }
-    for (const auto& mie : InstructionIterable(code)) {
-      auto insn = mie.insn;
-      if (!insn->has_type() || insn->get_type() == nullptr) {
-        continue;
-      }
-      auto type = get_array_type_or_self(insn->get_type());
-      if (candidates.count(type) == 0) {
-        continue;
-      }
-      if (is_opcode_excluded(insn->opcode())) {
-        TRACE(RM_INTF, 5, "Excluding %s %s in %s\n", SHOW(insn->opcode()),
-              SHOW(type), SHOW(meth));
-        current_excluded.insert(type);
+  // Look for unsupported opcodes.
+  std::vector<const DexType*> excluded_by_opcode;
+  for (const auto type : candidates) {
+    for (const auto& referrer : refs.type_referrers(type)) {
+      auto opcode = referrer.insn->opcode();
+      if (is_opcode_excluded(opcode)) {
+        TRACE(RM_INTF, 5, "Excluding %s %s in %s\n", SHOW(opcode), SHOW(type),
+              SHOW(referrer.method));
+        excluded_by_opcode.push_back(type);
+        break;
       }
     }
-
-    return current_excluded;
-  };
-
-  auto excluded_by_opcode =
-      walk::parallel::reduce_methods<std::unordered_set<const DexType*>>(
-          scope,
-          patcher,
-          [](std::unordered_set<const DexType*> left,
-             const std::unordered_set<const DexType*> right) {
-            left.insert(right.begin(), right.end());
-            return left;
-          });
+  }
 
   for (const auto type : excluded_by_opcode) {
     candidates.erase(type);
@@ -467,7 +474,8 @@ MethodOrderedSet find_dispatch_targets(const TypeSystem& type_system,
 void include_parent_interfaces(const DexType* root, TypeSet& interfaces) {
   TypeSet parent_interfaces;
   for (const auto intf : interfaces) {
-    auto parent_intfs = type_class(intf)->get_interfaces()->get_type_list();
+    const auto& parent_intfs =
+        type_class(intf)->get_interfaces()->get_type_list();
     for (const auto parent_intf : parent_intfs) {
       if (parent_intf != root) {
         parent_interfaces.insert(parent_intf);
@@ -514,7 +522,8 @@ TypeSet RemoveInterfacePass::remove_leaf_interfaces(
     const Scope& scope,
     const DexType* root,
     const TypeSet& interfaces,
-    const TypeSystem& type_system) {
+    const TypeSystem& type_system,
+    ReferenceIndex& refs) {
   TypeSet leaf_interfaces;
   for (const auto intf : interfaces) {
     if (is_leaf(type_system, intf)) {
@@ -522,27 +531,44 @@ TypeSet RemoveInterfacePass::remove_leaf_interfaces(
     }
   }
 
-  std::unordered_map<DexMethod*, DexMethod*> intf_meth_to_dispatch;
+  // Finding the dispatch targets only reads the type system, so it is done
+  // for all the leaf interface methods in parallel. The dispatches are then
+  // generated in order, as they are added to the target classes.
+  std::vector<std::pair<const DexType*, DexMethod*>> intf_methods;
   for (const auto intf : leaf_interfaces) {
     TRACE(RM_INTF, 5, "Found leaf interface %s\n", SHOW(intf));
-    auto implementors = type_system.get_implementors(intf);
-    auto intf_methods = type_class(intf)->get_vmethods();
-    for (const auto meth : intf_methods) {
-      TRACE(RM_INTF, 5, "Finding virt scope for %s\n", SHOW(meth));
-      auto intf_scope = type_system.find_interface_scope(meth);
-      MethodOrderedSet found_targets =
-          find_dispatch_targets(type_system, intf_scope, implementors);
-      std::vector<DexMethod*> dispatch_targets(found_targets.begin(),
-                                               found_targets.end());
-      auto replacement_type = get_replacement_type(type_system, intf, root);
-      auto dispatch =
-          generate_dispatch(replacement_type, dispatch_targets, meth,
-                            m_keep_debug_info, m_interface_dispatch_anno);
-      m_dispatch_stats[dispatch_targets.size()]++;
-      intf_meth_to_dispatch[meth] = dispatch;
+    for (const auto meth : type_class(intf)->get_vmethods()) {
+      intf_methods.emplace_back(intf, meth);
     }
   }
-  update_interface_calls(scope, intf_meth_to_dispatch);
+  std::vector<std::vector<DexMethod*>> dispatch_targets(intf_methods.size());
+  std::vector<size_t> indices(intf_methods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    auto intf = intf_methods[i].first;
+    auto meth = intf_methods[i].second;
+    TRACE(RM_INTF, 5, "Finding virt scope for %s\n", SHOW(meth));
+    auto intf_scope = type_system.find_interface_scope(meth);
+    MethodOrderedSet found_targets = find_dispatch_targets(
+        type_system, intf_scope, type_system.get_implementors(intf));
+    dispatch_targets[i].assign(found_targets.begin(), found_targets.end());
+  });
+
+  std::unordered_map<DexMethod*, DexMethod*> intf_meth_to_dispatch;
+  std::vector<DexMethod*> dispatches;
+  for (size_t i = 0; i < intf_methods.size(); ++i) {
+    auto intf = intf_methods[i].first;
+    auto meth = intf_methods[i].second;
+    auto replacement_type = get_replacement_type(type_system, intf, root);
+    auto dispatch =
+        generate_dispatch(replacement_type, dispatch_targets[i], meth,
+                          m_keep_debug_info, m_interface_dispatch_anno);
+    m_dispatch_stats[dispatch_targets[i].size()]++;
+    intf_meth_to_dispatch[meth] = dispatch;
+    dispatches.push_back(dispatch);
+  }
+  refs.update_methods(dispatches);
+  refs.update_methods(update_interface_calls(scope, intf_meth_to_dispatch));
   remove_inheritance(scope, type_system, leaf_interfaces);
   m_num_interface_removed += leaf_interfaces.size();
   return leaf_interfaces;
@@ -552,7 +578,8 @@ void RemoveInterfacePass::remove_interfaces_for_root(
     const Scope& scope,
     const DexStoresVector& stores,
     const DexType* root,
-    const TypeSystem& type_system) {
+    const TypeSystem& type_system,
+    ReferenceIndex& refs) {
   TRACE(RM_INTF, 5, "Processing root %s\n", SHOW(root));
   TypeSet interfaces;
   type_system.get_all_interface_children(root, interfaces);
@@ -560,12 +587,12 @@ void RemoveInterfacePass::remove_interfaces_for_root(
 
   m_total_num_interface += interfaces.size();
   m_num_interface_excluded += exclude_unremovables(
-      scope, stores, type_system, m_skip_multiple_targets_roots,
-      m_include_primary_dex, interfaces);
+      stores, type_system, m_skip_multiple_targets_roots, m_include_primary_dex,
+      refs, interfaces);
 
   TRACE(RM_INTF, 5, "removable interfaces %ld\n", interfaces.size());
   TypeSet removed =
-      remove_leaf_interfaces(scope, root, interfaces, type_system);
+      remove_leaf_interfaces(scope, root, interfaces, type_system, refs);
 
   while (removed.size() > 0) {
     for (const auto intf : removed) {
@@ -573,11 +600,13 @@ void RemoveInterfacePass::remove_interfaces_for_root(
       m_removed_interfaces.insert(intf);
     }
     TRACE(RM_INTF, 5, "non-leaf removable interfaces %ld\n", interfaces.size());
-    removed = remove_leaf_interfaces(scope, root, interfaces, type_system);
+    removed =
+        remove_leaf_interfaces(scope, root, interfaces, type_system, refs);
   }
 
   // Update type reference to removed interfaces all at once.
-  remove_interface_references(scope, type_system, root, m_removed_interfaces);
+  remove_interface_references(scope, type_system, root, m_removed_interfaces,
+                              refs);
 
   if (traceEnabled(RM_INTF, 9)) {
     TypeSystem updated_ts(scope);
@@ -628,8 +657,9 @@ void RemoveInterfacePass::run_pass(DexStoresVector& stores,
                                    PassManager& mgr) {
   auto scope = build_class_scope(stores);
   TypeSystem type_system(scope);
+  auto& refs = mgr.analyses().reference_index(scope);
   for (const auto root : m_interface_roots) {
-    remove_interfaces_for_root(scope, stores, root, type_system);
+    remove_interfaces_for_root(scope, stores, root, type_system, refs);
   }
   mgr.incr_metric("num_total_interface", m_total_num_interface);
   mgr.incr_metric("num_interface_excluded", m_num_interface_excluded);
@@ -10,6 +10,7 @@
 #include "Pass.h"
 
 using TypeSet = std::set<const DexType*, dextypes_comparator>;
+class ReferenceIndex;
 class TypeSystem;
 
 /**
@@ -37,6 +38,15 @@ class RemoveInterfacePass : public Pass {
   virtual void configure_pass(const JsonWrapper& jw) override;
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
+  // The reference index is kept up to date as calls and type references are
+  // rewritten.
+  analysis::Set required_analyses() const override {
+    return analysis::REFERENCE_INDEX;
+  }
+  analysis::Set preserved_analyses() const override {
+    return analysis::REFERENCE_INDEX;
+  }
+
  private:
   std::unordered_set<DexType*> m_interface_roots;
   DexType* m_interface_dispatch_anno;
@@ -52,11 +62,13 @@ class RemoveInterfacePass : public Pass {
   void remove_interfaces_for_root(const Scope& scope,
                                   const DexStoresVector& stores,
                                   const DexType* root,
-                                  const TypeSystem& type_system);
+                                  const TypeSystem& type_system,
+                                  ReferenceIndex& refs);
   TypeSet remove_leaf_interfaces(const Scope& scope,
                                  const DexType* root,
                                  const TypeSet& interfaces,
-                                 const TypeSystem& type_system);
+                                 const TypeSystem& type_system,
+                                 ReferenceIndex& refs);
   bool is_leaf(const TypeSystem& type_system, const DexType* intf);
   void remove_inheritance(const Scope& scope,
                           const TypeSystem& type_system,
@@ -7,6 +7,7 @@
 
 #include "RemoveUnreachable.h"
 
+#include "AnalysisManager.h"
 #include "PassManager.h"
 
 void RemoveUnreachablePass::run_pass(DexStoresVector& stores,
@@ -26,7 +27,9 @@ void RemoveUnreachablePass::run_pass(DexStoresVector& stores,
                                     !m_unreachable_symbols_file_name.empty();
   int num_ignore_check_strings = 0;
   auto reachables = reachability::compute_reachable_objects(
-      stores, m_ignore_sets, &num_ignore_check_strings);
+      stores, m_ignore_sets, &num_ignore_check_strings,
+      /* record_reachability */ false,
+      &pm.analyses().method_override_graph_cache());
   reachability::ObjectCounts before = reachability::count_objects(stores);
   TRACE(RMU, 1, "before: %lu classes, %lu fields, %lu methods\n",
         before.num_classes, before.num_fields, before.num_methods);
@@ -71,10 +71,12 @@ class RemoveGotos {
     return result;
   }
 
+ public:
   /*
    * Returns the number of blocks that were removed
    */
   static size_t merge_blocks(cfg::ControlFlowGraph& cfg) {
+    always_assert(cfg.editable());
     std::unordered_set<cfg::Block*> visited_blocks;
 
     size_t num_merged = 0;
@@ -107,7 +109,6 @@ class RemoveGotos {
     return num_merged;
   }
 
- public:
   static size_t process_method(DexMethod* method) {
     auto code = method->get_code();
 
@@ -149,6 +150,10 @@ size_t RemoveGotosPass::run(DexMethod* method) {
   return RemoveGotos::process_method(method);
 }
 
+size_t RemoveGotosPass::run(cfg::ControlFlowGraph& cfg) {
+  return RemoveGotos::merge_blocks(cfg);
+}
+
 void RemoveGotosPass::run_pass(DexStoresVector& stores,
                                ConfigFiles& /* unused */,
                                PassManager& mgr) {
@@ -9,11 +9,23 @@
 
 #include "Pass.h"
 
+namespace cfg {
+class ControlFlowGraph;
+} // namespace cfg
+
 class RemoveGotosPass : public Pass {
  public:
   RemoveGotosPass() : Pass("RemoveGotosPass") {}
 
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
+  analysis::Set preserved_analyses() const override {
+    return analysis::CODE_AGNOSTIC;
+  }
+
   size_t run(DexMethod*);
+
+  // Merges the blocks of an editable CFG that are only joined by gotos, and
+  // returns the number of gotos removed.
+  static size_t run(cfg::ControlFlowGraph&);
 };
@@ -8,6 +8,7 @@
 #include "RemoveUnusedArgs.h"
 
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -37,19 +38,36 @@ namespace remove_unused_args {
 constexpr const char* METRIC_CALLSITE_ARGS_REMOVED = "callsite_args_removed";
 constexpr const char* METRIC_METHOD_PARAMS_REMOVED = "method_params_removed";
 constexpr const char* METRIC_METHODS_UPDATED = "method_signatures_updated";
+constexpr const char* METRIC_ITERATIONS = "iterations";
 
 /**
  * Returns metrics as listed above from running RemoveArgs:
  * run() removes unused params from method signatures and param loads, then
- * updates all affected callsites accordingly.
+ * updates all affected callsites accordingly. It repeats this until nothing
+ * changes or it has run `max_iterations` rounds.
  */
-RemoveArgs::PassStats RemoveArgs::run() {
+RemoveArgs::PassStats RemoveArgs::run(size_t max_iterations) {
   RemoveArgs::PassStats pass_stats;
-  auto method_stats = update_meths_with_unused_args();
-  pass_stats.method_params_removed_count =
-      method_stats.method_params_removed_count;
-  pass_stats.methods_updated_count = method_stats.methods_updated_count;
-  pass_stats.callsite_args_removed_count = update_callsites();
+  // The methods to analyze in the current round, or all of them if null.
+  std::unique_ptr<ConcurrentSet<DexMethod*>> candidates;
+  while (pass_stats.iterations < max_iterations) {
+    pass_stats.iterations++;
+    m_live_arg_idxs_map.clear();
+    auto method_stats = update_meths_with_unused_args(candidates.get());
+    pass_stats.method_params_removed_count +=
+        method_stats.method_params_removed_count;
+    pass_stats.methods_updated_count += method_stats.methods_updated_count;
+    if (method_stats.methods_updated_count == 0) {
+      break;
+    }
+    auto updated_callers = std::make_unique<ConcurrentSet<DexMethod*>>();
+    pass_stats.callsite_args_removed_count +=
+        update_callsites(updated_callers.get());
+    TRACE(ARGS, 2, "Round %zu updated %zu methods and %zu callers\n",
+          pass_stats.iterations, method_stats.methods_updated_count,
+          updated_callers->size());
+    candidates = std::move(updated_callers);
+  }
   return pass_stats;
 }
 
@@ -67,21 +85,23 @@ std::deque<uint16_t> RemoveArgs::compute_live_args(
     size_t num_args,
     std::vector<IRInstruction*>* dead_insns) {
   auto code = method->get_code();
-  code->build_cfg(/* editable */ false);
-  auto& cfg = code->cfg();
-  cfg.calculate_exit_block();
-  LivenessFixpointIterator fixpoint_iter(cfg);
+  cfg::ControlFlowView cfg(*code);
+  ViewLivenessFixpointIterator fixpoint_iter(cfg);
   fixpoint_iter.run(LivenessDomain(code->get_registers_size()));
   auto entry_block = cfg.entry_block();
+  auto entries = cfg.entries(entry_block);
 
   std::deque<uint16_t> live_arg_idxs;
   bool is_instance_method = !is_static(method);
   size_t last_arg_idx = is_instance_method ? num_args : num_args - 1;
-  auto first_insn = entry_block->get_first_insn()->insn;
+  auto first_insn =
+      ir_list::ConstInstructionIterable(entries).begin()->insn;
   // live_vars contains all the registers needed by entry_block's successors.
   auto live_vars = fixpoint_iter.get_live_out_vars_at(entry_block);
 
-  for (auto it = entry_block->rbegin(); it != entry_block->rend(); ++it) {
+  for (auto it = std::make_reverse_iterator(entries.end());
+       it != std::make_reverse_iterator(entries.begin());
+       ++it) {
     if (it->type != MFLOW_OPCODE) {
       continue;
     }
@@ -109,7 +129,7 @@ std::deque<uint16_t> RemoveArgs::compute_live_args(
 std::deque<DexType*> RemoveArgs::get_live_arg_type_list(
     DexMethod* method, const std::deque<uint16_t>& live_arg_idxs) {
   std::deque<DexType*> live_args;
-  auto args_list = method->get_proto()->get_args()->get_type_list();
+  const auto& args_list = method->get_proto()->get_args()->get_type_list();
 
   for (uint16_t arg_num : live_arg_idxs) {
     if (!is_static(method)) {
@@ -184,13 +204,16 @@ bool RemoveArgs::update_method_signature(
 
 /**
  * For methods that have unused arguments, record live argument registers.
+ * Only the methods in `candidates` are analyzed, unless it is null.
  */
-RemoveArgs::MethodStats RemoveArgs::update_meths_with_unused_args() {
+RemoveArgs::MethodStats RemoveArgs::update_meths_with_unused_args(
+    const ConcurrentSet<DexMethod*>* candidates) {
   return walk::parallel::reduce_methods<RemoveArgs::MethodStats>(
       m_scope,
       [&](DexMethod* method) -> RemoveArgs::MethodStats {
         auto method_stats = RemoveArgs::MethodStats();
-        if (method->get_code() == nullptr) {
+        if (method->get_code() == nullptr ||
+            (candidates != nullptr && candidates->count(method) == 0)) {
           return method_stats;
         }
         auto proto = method->get_proto();
@@ -280,9 +303,11 @@ size_t RemoveArgs::update_callsite(IRInstruction* instr) {
 
 /**
  * Removes unused arguments at callsites and returns the number of arguments
- * removed.
+ * removed. The methods whose callsites were updated are added to
+ * `updated_callers`.
  */
-size_t RemoveArgs::update_callsites() {
+size_t RemoveArgs::update_callsites(
+    ConcurrentSet<DexMethod*>* updated_callers) {
   // Walk through all methods to look for and edit callsites.
   return walk::parallel::reduce_methods<size_t>(
       m_scope,
@@ -302,6 +327,9 @@ size_t RemoveArgs::update_callsites() {
             }
           }
         }
+        if (callsite_args_removed > 0) {
+          updated_callers->insert(method);
+        }
         return callsite_args_removed;
       },
       [](size_t a, size_t b) { return a + b; });
@@ -313,7 +341,7 @@ void RemoveUnusedArgsPass::run_pass(DexStoresVector& stores,
   auto scope = build_class_scope(stores);
 
   RemoveArgs rm_args(scope);
-  auto pass_stats = rm_args.run();
+  auto pass_stats = rm_args.run(m_max_iterations);
   size_t num_callsite_args_removed = pass_stats.callsite_args_removed_count;
   size_t num_method_params_removed = pass_stats.method_params_removed_count;
   size_t num_methods_updated = pass_stats.methods_updated_count;
@@ -334,6 +362,7 @@ void RemoveUnusedArgsPass::run_pass(DexStoresVector& stores,
   mgr.set_metric(METRIC_CALLSITE_ARGS_REMOVED, num_callsite_args_removed);
   mgr.set_metric(METRIC_METHOD_PARAMS_REMOVED, num_method_params_removed);
   mgr.set_metric(METRIC_METHODS_UPDATED, num_methods_updated);
+  mgr.set_metric(METRIC_ITERATIONS, pass_stats.iterations);
 }
 
 static RemoveUnusedArgsPass s_pass;
@@ -25,10 +25,14 @@ class RemoveArgs {
     size_t method_params_removed_count{0};
     size_t methods_updated_count{0};
     size_t callsite_args_removed_count{0};
+    size_t iterations{0};
   };
 
   RemoveArgs(const Scope& scope) : m_scope(scope), m_type_system(scope){};
-  RemoveArgs::PassStats run();
+  // Removing the arguments of a method can leave the arguments its callers
+  // passed along dead, so up to `max_iterations` rounds are run, each one
+  // reanalyzing only the methods whose callsites the previous one changed.
+  RemoveArgs::PassStats run(size_t max_iterations = 1);
   std::deque<uint16_t> compute_live_args(
       DexMethod* method,
       size_t num_args,
@@ -44,18 +48,26 @@ class RemoveArgs {
       DexMethod* method, const std::deque<uint16_t>& live_arg_idxs);
   bool update_method_signature(DexMethod* method,
                                const std::deque<uint16_t>& live_args);
-  MethodStats update_meths_with_unused_args();
+  MethodStats update_meths_with_unused_args(
+      const ConcurrentSet<DexMethod*>* candidates);
   size_t update_callsite(IRInstruction* instr);
-  size_t update_callsites();
+  size_t update_callsites(ConcurrentSet<DexMethod*>* updated_callers);
 };
 
 class RemoveUnusedArgsPass : public Pass {
  public:
   RemoveUnusedArgsPass() : Pass("RemoveUnusedArgsPass") {}
 
+  virtual void configure_pass(const JsonWrapper& jw) override {
+    jw.get("max_iterations", 1, m_max_iterations);
+  }
+
   virtual void run_pass(DexStoresVector&,
                         ConfigFiles&,
                         PassManager& mgr) override;
+
+ private:
+  size_t m_max_iterations;
 };
 
 } // namespace remove_unused_args
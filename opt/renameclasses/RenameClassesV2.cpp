@@ -8,15 +8,18 @@
 #include "RenameClassesV2.h"
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <string>
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
 
+#include "ConcurrentContainers.h"
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "IRInstruction.h"
+#include "Parallel.h"
 #include "ReachableClasses.h"
 #include "RedexResources.h"
 #include "Walkers.h"
@@ -375,45 +378,28 @@ RenameClassesPassV2::build_dont_rename_serde_relationships(Scope& scope) {
 
 std::unordered_set<const DexType*>
 RenameClassesPassV2::build_dont_rename_native_bindings(Scope& scope) {
-  std::unordered_set<const DexType*> dont_rename_native_bindings;
+  ConcurrentSet<const DexType*> native_binding_types;
   // find all classes with native methods, and all types mentioned
   // in protos of native methods
-  for(auto clazz: scope) {
-    for (auto meth : clazz->get_dmethods()) {
-      if (is_native(meth)) {
-        dont_rename_native_bindings.insert(clazz->get_type());
-        auto proto = meth->get_proto();
-        auto rtype = proto->get_rtype();
-        dont_rename_native_bindings.insert(rtype);
-        for (auto ptype : proto->get_args()->get_type_list()) {
-          // TODO: techincally we should recurse for array types
-          // not just go one level
-          if (is_array(ptype)) {
-            dont_rename_native_bindings.insert(get_array_type(ptype));
-          } else {
-            dont_rename_native_bindings.insert(ptype);
-          }
-        }
-      }
-    }
-    for (auto meth : clazz->get_vmethods()) {
-      if (is_native(meth)) {
-        dont_rename_native_bindings.insert(clazz->get_type());
-        auto proto = meth->get_proto();
-        auto rtype = proto->get_rtype();
-        dont_rename_native_bindings.insert(rtype);
-        for (auto ptype : proto->get_args()->get_type_list()) {
-          // TODO: techincally we should recurse for array types
-          // not just go one level
-          if (is_array(ptype)) {
-            dont_rename_native_bindings.insert(get_array_type(ptype));
-          } else {
-            dont_rename_native_bindings.insert(ptype);
-          }
-        }
+  walk::parallel::methods(scope, [&](DexMethod* meth) {
+    if (!is_native(meth)) {
+      return;
+    }
+    native_binding_types.emplace(meth->get_class());
+    auto proto = meth->get_proto();
+    native_binding_types.emplace(proto->get_rtype());
+    for (auto ptype : proto->get_args()->get_type_list()) {
+      // TODO: techincally we should recurse for array types
+      // not just go one level
+      if (is_array(ptype)) {
+        native_binding_types.emplace(get_array_type(ptype));
+      } else {
+        native_binding_types.emplace(ptype);
       }
     }
-  }
+  });
+  std::unordered_set<const DexType*> dont_rename_native_bindings(
+      native_binding_types.begin(), native_binding_types.end());
   return dont_rename_native_bindings;
 }
 
@@ -433,8 +419,8 @@ class AliasMap {
   std::map<DexString*, DexString*, dexstrings_comparator> m_class_name_map;
   std::map<DexString*, DexString*, dexstrings_comparator> m_extras_map;
  public:
-  void add_class_alias(DexClass* cls, DexString* alias) {
-    m_class_name_map.emplace(cls->get_name(), alias);
+  void add_class_alias(DexString* original, DexString* alias) {
+    m_class_name_map.emplace(original, alias);
   }
   void add_alias(DexString* original, DexString* alias) {
     m_extras_map.emplace(original, alias);
@@ -464,10 +450,17 @@ static void sanity_check(const Scope& scope, const AliasMap& aliases) {
     external_names.emplace(
         JavaNameUtil::internal_to_external(it.first->c_str()));
   }
-  std::vector<DexString*> all_strings;
-  for (auto clazz : scope) {
-    clazz->gather_strings(all_strings);
-  }
+  auto all_strings = parallel_reduce(
+      scope.begin(), scope.end(), std::vector<DexString*>(),
+      [](DexClass* clazz) {
+        std::vector<DexString*> strings;
+        clazz->gather_strings(strings);
+        return strings;
+      },
+      [](std::vector<DexString*> a, std::vector<DexString*> b) {
+        a.insert(a.end(), b.begin(), b.end());
+        return a;
+      });
   sort_unique(all_strings);
   int sketchy_strings = 0;
   for (auto s : all_strings) {
@@ -685,11 +678,13 @@ void RenameClassesPassV2::rename_classes(
   // Make everything public
   unpackage_private(scope);
 
-  AliasMap aliases;
+  // Decide which classes get renamed, and the sequence number of each, in
+  // scope order. The sequence numbers are what make the new names
+  // deterministic, so the renaming itself can then run in parallel.
+  std::vector<std::pair<DexClass*, uint32_t>> to_rename;
   uint32_t sequence = 0;
   for (auto clazz : scope) {
-    auto dtype = clazz->get_type();
-    auto oldname = dtype->get_name();
+    auto oldname = clazz->get_type()->get_name();
 
     if (m_force_rename_classes.count(clazz)) {
       mgr.incr_metric(METRIC_FORCE_RENAMED_CLASSES, 1);
@@ -713,33 +708,49 @@ void RenameClassesPassV2::rename_classes(
     }
 
     mgr.incr_metric(METRIC_RENAMED_CLASSES, 1);
+    always_assert(sequence != Locator::invalid_global_class_index);
+    to_rename.emplace_back(clazz, sequence);
+    sequence++;
+  }
+
+  // The aliases that renaming each class (and its array types) introduces,
+  // merged into the AliasMap in scope order afterwards.
+  struct Renaming {
+    DexString* oldname;
+    DexString* newname;
+    std::vector<std::pair<DexString*, DexString*>> array_aliases;
+  };
+  std::vector<Renaming> renamings(to_rename.size());
+  std::vector<size_t> indices(to_rename.size());
+  for (size_t i = 0; i < indices.size(); ++i) {
+    indices[i] = i;
+  }
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    auto clazz = to_rename[i].first;
+    auto seq = to_rename[i].second;
+    auto dtype = clazz->get_type();
+    auto oldname = dtype->get_name();
 
     char descriptor[Locator::encoded_global_class_index_max];
-    always_assert(sequence != Locator::invalid_global_class_index);
-    Locator::encodeGlobalClassIndex(sequence, m_digits, descriptor);
+    Locator::encodeGlobalClassIndex(seq, m_digits, descriptor);
     always_assert_log(facebook::Locator::decodeGlobalClassIndex(descriptor) ==
-                          sequence,
+                          seq,
                       "global class index didn't roundtrip; %s generated from "
                       "%u parsed to %u",
-                      descriptor, sequence,
+                      descriptor, seq,
                       facebook::Locator::decodeGlobalClassIndex(descriptor));
 
-    TRACE(RENAME, 2, "'%s' ->  %s (%u)'\n", oldname->c_str(), descriptor,
-          sequence);
-    sequence++;
+    TRACE(RENAME, 2, "'%s' ->  %s (%u)'\n", oldname->c_str(), descriptor, seq);
 
     auto exists = DexString::get_string(descriptor);
     always_assert_log(!exists, "Collision on class %s (%s)", oldname->c_str(),
                       descriptor);
 
     auto dstring = DexString::make_string(descriptor);
-    aliases.add_class_alias(clazz, dstring);
+    auto& renaming = renamings[i];
+    renaming.oldname = oldname;
+    renaming.newname = dstring;
     dtype->set_name(dstring);
-    std::string old_str(oldname->c_str());
-    std::string new_str(descriptor);
-    //    proguard_map.update_class_mapping(old_str, new_str);
-    m_base_strings_size += strlen(oldname->c_str());
-    m_ren_strings_size += strlen(dstring->c_str());
 
     while (1) {
       std::string arrayop("[");
@@ -756,15 +767,26 @@ void RenameClassesPassV2::rename_classes(
       newarraytype += dstring->c_str();
       dstring = DexString::make_string(newarraytype);
 
-      aliases.add_alias(oldname, dstring);
+      renaming.array_aliases.emplace_back(oldname, dstring);
       arraytype->set_name(dstring);
     }
+  });
+
+  AliasMap aliases;
+  for (const auto& renaming : renamings) {
+    aliases.add_class_alias(renaming.oldname, renaming.newname);
+    for (const auto& p : renaming.array_aliases) {
+      aliases.add_alias(p.first, p.second);
+    }
+    m_base_strings_size += strlen(renaming.oldname->c_str());
+    m_ren_strings_size += strlen(renaming.newname->c_str());
   }
 
   /* Now rewrite all const-string strings for force renamed classes. */
   auto match = std::make_tuple(m::const_string());
 
-  walk::matching_opcodes(
+  std::atomic<size_t> rewritten_const_strings{0};
+  walk::parallel::matching_opcodes(
       scope, match,
       [&](const DexMethod*, const std::vector<IRInstruction*>& insns) {
         IRInstruction* insn = insns[0];
@@ -795,7 +817,7 @@ void RenameClassesPassV2::rename_classes(
           DexType* alias_from_type = DexType::get_type(alias_from);
           DexClass* alias_from_cls = type_class(alias_from_type);
           if (m_force_rename_classes.count(alias_from_cls)) {
-            mgr.incr_metric(METRIC_REWRITTEN_CONST_STRINGS, 1);
+            ++rewritten_const_strings;
             insn->set_string(alias_to);
             TRACE(RENAME, 3, "Rewrote const-string \"%s\" to \"%s\"\n",
                 str->c_str(), alias_to->c_str());
@@ -803,6 +825,8 @@ void RenameClassesPassV2::rename_classes(
         }
       });
 
+  mgr.incr_metric(METRIC_REWRITTEN_CONST_STRINGS, rewritten_const_strings);
+
   /* Now we need to re-write the Signature annotations.  They use
    * Strings rather than Type's, so they have to be explicitly
    * handled.
@@ -832,7 +856,7 @@ void RenameClassesPassV2::rename_classes(
   }
   static DexType *dalviksig =
     DexType::get_type("Ldalvik/annotation/Signature;");
-  walk::annotations(scope, [&](DexAnnotation* anno) {
+  walk::parallel::annotations(scope, [&](DexAnnotation* anno) {
     if (anno->type() != dalviksig) return;
     auto elems = anno->anno_elems();
     for (auto elem : elems) {
@@ -871,24 +895,14 @@ void RenameClassesPassV2::rename_classes_in_layouts(
   }
   ssize_t layout_bytes_delta = 0;
   size_t num_layout_renamed = 0;
-  auto xml_files = get_xml_files(m_apk_dir + "/res");
-  for (const auto& path : xml_files) {
-    if (is_raw_resource(path)) {
-      continue;
+  std::vector<std::string> layout_files;
+  for (const auto& path : get_xml_files(m_apk_dir + "/res")) {
+    if (!is_raw_resource(path)) {
+      layout_files.push_back(path);
     }
-    size_t num_renamed = 0;
-    ssize_t out_delta = 0;
-    TRACE(RENAME, 5, "Begin rename Views in layout %s\n", path.c_str());
-    rename_classes_in_layout(path, aliases_for_layouts, &num_renamed, &out_delta);
-    TRACE(
-      RENAME,
-      3,
-      "Renamed %zu ResStringPool entries in layout %s\n",
-      num_renamed,
-      path.c_str());
-    layout_bytes_delta += out_delta;
-    num_layout_renamed += num_renamed;
   }
+  ::rename_classes_in_layouts(layout_files, aliases_for_layouts,
+                              &num_layout_renamed, &layout_bytes_delta);
   mgr.incr_metric("layout_bytes_delta", layout_bytes_delta);
   TRACE(
     RENAME,
@@ -45,8 +45,7 @@ class ReorderInterfacesImpl {
   void compute_call_frequencies(IRInstruction* insn);
   void reorder_interfaces();
   void reorder_interfaces_for_class(DexClass* cls);
-  std::deque<DexType*> sort_interfaces(
-      const std::deque<DexType*>& unsorted_list);
+  std::deque<DexType*> sort_interfaces(const DexTypeList& unsorted_list);
 };
 
 /**
@@ -99,7 +98,7 @@ void ReorderInterfacesImpl::compute_call_frequencies(IRInstruction* insn) {
  * calls and return the sorted list
  */
 std::deque<DexType*> ReorderInterfacesImpl::sort_interfaces(
-    const std::deque<DexType*>& unsorted_list) {
+    const DexTypeList& unsorted_list) {
   std::deque<DexType*> sorted_list;
   // Create list of interfaces and store frequencies
   std::vector<std::pair<DexType*, int>> list_with_frequencies;
@@ -7,13 +7,17 @@
 
 #include "ResultPropagation.h"
 
+#include <numeric>
 #include <vector>
 
+#include "AnalysisManager.h"
 #include "BaseIRAnalyzer.h"
+#include "CallGraph.h"
 #include "ConstantAbstractDomain.h"
 #include "ControlFlow.h"
 #include "IRCode.h"
 #include "IRInstruction.h"
+#include "Parallel.h"
 #include "PatriciaTreeMapAbstractEnvironment.h"
 #include "Resolver.h"
 #include "Walkers.h"
@@ -28,8 +32,8 @@ constexpr const char* METRIC_ERASED_MOVE_RESULTS = "num_erased_move_results";
 constexpr const char* METRIC_PATCHED_MOVE_RESULTS = "num_patched_move_results";
 constexpr const char* METRIC_UNVERIFIABLE_MOVE_RESULTS =
     "num_unverifiable_move_results";
-constexpr const char* METRIC_METHODS_WHICH_RETURN_PARAMETER_ITERATIONS =
-    "num_methods_which_return_parameters_iterations";
+constexpr const char* METRIC_METHODS_WHICH_RETURN_PARAMETER_WAVES =
+    "num_methods_which_return_parameters_waves";
 constexpr const ParamIndex WIDE_HIGH = 1 << 31;
 
 IROpcode move_result_to_move(IROpcode op) {
@@ -58,7 +62,7 @@ const DexType* get_param_type(bool is_static,
   if (!is_static && param_index-- == 0) {
     return method->get_class();
   }
-  const auto args = method->get_proto()->get_args()->get_type_list();
+  const auto& args = method->get_proto()->get_args()->get_type_list();
   return args[param_index];
 }
 
@@ -93,8 +97,7 @@ class Analyzer final : public BaseIRAnalyzer<ParamDomainEnvironment> {
  public:
   Analyzer(cfg::ControlFlowGraph& cfg,
            const ReturnParamResolver& resolver,
-           const std::unordered_map<const DexMethod*, ParamIndex>&
-               methods_which_return_parameter)
+           const ReturnParamMap& methods_which_return_parameter)
       : BaseIRAnalyzer(cfg),
         m_resolver(resolver),
         m_methods_which_return_parameter(methods_which_return_parameter),
@@ -234,8 +237,7 @@ class Analyzer final : public BaseIRAnalyzer<ParamDomainEnvironment> {
 
  private:
   const ReturnParamResolver& m_resolver;
-  const std::unordered_map<const DexMethod*, ParamIndex>&
-      m_methods_which_return_parameter;
+  const ReturnParamMap& m_methods_which_return_parameter;
   const std::unordered_map<const IRInstruction*, ParamIndex> m_load_param_map;
   mutable MethodRefCache m_resolved_refs;
 };
@@ -258,8 +260,7 @@ const std::unordered_map<const IRInstruction*, ParamIndex> get_load_param_map(
 
 const boost::optional<ParamIndex> ReturnParamResolver::get_return_param_index(
     IRInstruction* insn,
-    const std::unordered_map<const DexMethod*, ParamIndex>&
-        methods_which_return_parameter,
+    const ReturnParamMap& methods_which_return_parameter,
     MethodRefCache& resolved_refs) const {
   always_assert(is_invoke(insn->opcode()));
   const auto method = insn->get_method();
@@ -285,8 +286,8 @@ const boost::optional<ParamIndex> ReturnParamResolver::get_return_param_index(
     always_assert(opcode == OPCODE_INVOKE_VIRTUAL ||
                   opcode == OPCODE_INVOKE_INTERFACE);
   } else {
-    const auto& mwrpit = methods_which_return_parameter.find(callee);
-    if (mwrpit == methods_which_return_parameter.end()) {
+    const auto mwrpit = methods_which_return_parameter.find(callee);
+    if (mwrpit == nullptr) {
       return boost::none;
     }
     param = ParamDomain(mwrpit->second);
@@ -298,8 +299,8 @@ const boost::optional<ParamIndex> ReturnParamResolver::get_return_param_index(
     const auto overriding_methods =
         method_override_graph::get_overriding_methods(m_graph, callee);
     for (auto* overriding : overriding_methods) {
-      const auto& mwrpit = methods_which_return_parameter.find(overriding);
-      if (mwrpit == methods_which_return_parameter.end()) {
+      const auto mwrpit = methods_which_return_parameter.find(overriding);
+      if (mwrpit == nullptr) {
         return boost::none;
       }
       param.join_with(ParamDomain(mwrpit->second));
@@ -317,6 +318,23 @@ const boost::optional<ParamIndex> ReturnParamResolver::get_return_param_index(
   return param.get_constant();
 }
 
+const DexMethod* ReturnParamResolver::get_dependency(
+    IRInstruction* insn, MethodRefCache& resolved_refs, bool* is_virtual) const {
+  always_assert(is_invoke(insn->opcode()));
+  // Mirrors get_return_param_index above.
+  const auto method = insn->get_method();
+  if (method->get_proto()->is_void()) {
+    return nullptr;
+  }
+  const auto opcode = insn->opcode();
+  if (opcode == OPCODE_INVOKE_VIRTUAL && returns_receiver(method)) {
+    return nullptr;
+  }
+  *is_virtual =
+      opcode == OPCODE_INVOKE_VIRTUAL || opcode == OPCODE_INVOKE_INTERFACE;
+  return resolve_method(method, opcode_to_search(insn), resolved_refs);
+}
+
 bool ReturnParamResolver::returns_receiver(const DexMethodRef* method) const {
   // Hard-coded very special knowledge about certain framework methods
 
@@ -335,8 +353,7 @@ bool ReturnParamResolver::returns_receiver(const DexMethodRef* method) const {
 
 const boost::optional<ParamIndex> ReturnParamResolver::get_return_param_index(
     cfg::ControlFlowGraph& cfg,
-    const std::unordered_map<const DexMethod*, ParamIndex>&
-        methods_which_return_parameter) const {
+    const ReturnParamMap& methods_which_return_parameter) const {
   Analyzer analyzer(cfg, *this, methods_which_return_parameter);
   auto return_param_index = ParamDomain::bottom();
   // join together return values of all blocks which end with a
@@ -354,6 +371,19 @@ const boost::optional<ParamIndex> ReturnParamResolver::get_return_param_index(
   return return_param_index.get_constant();
 }
 
+const boost::optional<ParamIndex> ResultPropagation::get_return_param_index(
+    IRInstruction* insn) {
+  InvokeKey key(insn->get_method(), insn->opcode());
+  const auto cached = m_invoke_cache.find(key);
+  if (cached != nullptr) {
+    return cached->second;
+  }
+  const auto param_index = m_resolver.get_return_param_index(
+      insn, m_methods_which_return_parameter, m_resolved_refs);
+  m_invoke_cache.emplace(key, param_index);
+  return param_index;
+}
+
 void ResultPropagation::patch(PassManager& mgr, IRCode* code) {
   // turn move-result-... into move instructions if the called method
   // is known to always return a particular parameter
@@ -375,8 +405,7 @@ void ResultPropagation::patch(PassManager& mgr, IRCode* code) {
       continue;
     }
     // do we know the invoked method always returns a particular parameter?
-    const auto param_index = m_resolver.get_return_param_index(
-        insn, m_methods_which_return_parameter, m_resolved_refs);
+    const auto param_index = get_return_param_index(insn);
     if (!param_index) {
       continue;
     }
@@ -415,14 +444,175 @@ void ResultPropagation::patch(PassManager& mgr, IRCode* code) {
   }
 }
 
+namespace {
+
+/*
+ * The methods that may return a parameter, numbered densely, and the strongly
+ * connected components of the graph of their dependencies, grouped into
+ * waves. The dependencies of the members of a component are either in the
+ * component itself or in a component of an earlier wave.
+ */
+class Schedule {
+ public:
+  using NodeId = call_graph::SccNodeId;
+  using Component = call_graph::SccComponent;
+
+  Schedule(const Scope& scope, const ReturnParamResolver& resolver) {
+    walk::code(scope, [&](DexMethod* method, IRCode&) {
+      if (!method->get_proto()->is_void()) {
+        m_ids.emplace(method, m_methods.size());
+        m_methods.push_back(method);
+      }
+    });
+    const size_t num_methods = m_methods.size();
+    // The virtual callees, for which the dependencies on the callee and all
+    // its overrides go through a shared dispatch node, so that popular
+    // methods like Object.equals don't add an edge to every override for
+    // every caller.
+    std::vector<std::vector<const DexMethod*>> virtual_callees(num_methods);
+    m_dependencies.resize(num_methods);
+    std::vector<NodeId> nodes(num_methods);
+    std::iota(nodes.begin(), nodes.end(), 0);
+    parallel_for(nodes.begin(), nodes.end(), [&](NodeId node) {
+      MethodRefCache resolved_refs;
+      auto& dependencies = m_dependencies[node];
+      auto& cfg = m_methods[node]->get_code()->cfg();
+      for (const auto& mie : cfg::InstructionIterable(cfg)) {
+        if (!is_invoke(mie.insn->opcode())) {
+          continue;
+        }
+        bool is_virtual = false;
+        const auto callee =
+            resolver.get_dependency(mie.insn, resolved_refs, &is_virtual);
+        if (callee == nullptr) {
+          continue;
+        }
+        if (is_virtual) {
+          virtual_callees[node].push_back(callee);
+          continue;
+        }
+        auto it = m_ids.find(callee);
+        if (it != m_ids.end()) {
+          dependencies.push_back(it->second);
+        }
+      }
+    });
+    std::unordered_map<const DexMethod*, NodeId> dispatch_ids;
+    std::vector<const DexMethod*> dispatched;
+    for (size_t node = 0; node < num_methods; ++node) {
+      for (auto callee : virtual_callees[node]) {
+        auto it = dispatch_ids.emplace(callee, num_methods + dispatched.size());
+        if (it.second) {
+          dispatched.push_back(callee);
+        }
+        m_dependencies[node].push_back(it.first->second);
+      }
+    }
+    m_methods.resize(num_methods + dispatched.size(), nullptr);
+    m_dependencies.resize(m_methods.size());
+    nodes.resize(dispatched.size());
+    std::iota(nodes.begin(), nodes.end(), 0);
+    parallel_for(nodes.begin(), nodes.end(), [&](NodeId i) {
+      auto callee = dispatched[i];
+      auto& dependencies = m_dependencies[num_methods + i];
+      auto add = [&](const DexMethod* method) {
+        auto it = m_ids.find(method);
+        if (it != m_ids.end()) {
+          dependencies.push_back(it->second);
+        }
+      };
+      add(callee);
+      for (auto overriding : resolver.get_overriding_methods(callee)) {
+        add(overriding);
+      }
+    });
+    parallel_for(m_dependencies.begin(), m_dependencies.end(),
+                 [](std::vector<NodeId>& dependencies) {
+                   std::sort(dependencies.begin(), dependencies.end());
+                   dependencies.erase(
+                       std::unique(dependencies.begin(), dependencies.end()),
+                       dependencies.end());
+                 });
+    std::vector<bool> dispatch_nodes(num_methods, false);
+    dispatch_nodes.resize(m_methods.size(), true);
+    m_waves = call_graph::scc_waves(m_dependencies, dispatch_nodes);
+  }
+
+  // The dispatch nodes have no associated method.
+  DexMethod* method(NodeId node) const { return m_methods[node]; }
+
+  const std::vector<std::vector<Component>>& waves() const { return m_waves; }
+
+ private:
+  std::unordered_map<const DexMethod*, NodeId> m_ids;
+  std::vector<DexMethod*> m_methods;
+  std::vector<std::vector<NodeId>> m_dependencies;
+  std::vector<std::vector<Component>> m_waves;
+};
+
+} // namespace
+
+size_t find_methods_which_return_parameter(
+    const Scope& scope,
+    const ReturnParamResolver& resolver,
+    ReturnParamMap* methods_which_return_parameter) {
+  walk::parallel::code(scope, [](DexMethod* method, IRCode& code) {
+    const auto proto = method->get_proto();
+    if (!proto->is_void()) {
+      // void methods cannot return a parameter, skip expensive analysis
+      code.build_cfg(/* editable */ true);
+    }
+  });
+
+  Schedule schedule(scope, resolver);
+  for (const auto& wave : schedule.waves()) {
+    parallel_for(
+        wave.begin(), wave.end(), [&](const Schedule::Component& component) {
+          // Entries are only ever added, and a new entry can only make a
+          // difference to the members of this component, so we are done
+          // once a round over them adds nothing.
+          bool changed;
+          do {
+            changed = false;
+            for (auto node : component) {
+              const auto method = schedule.method(node);
+              if (methods_which_return_parameter->count(method) != 0) {
+                continue;
+              }
+              // TODO(T35815704): Make the cfg const
+              cfg::ControlFlowGraph& cfg = method->get_code()->cfg();
+              const auto return_param_index = resolver.get_return_param_index(
+                  cfg, *methods_which_return_parameter);
+              if (return_param_index) {
+                methods_which_return_parameter->emplace(method,
+                                                        *return_param_index);
+                changed = true;
+              }
+            }
+          } while (changed && component.size() > 1);
+        });
+  }
+
+  walk::parallel::code(scope, [](DexMethod* method, IRCode& code) {
+    const auto proto = method->get_proto();
+    if (!proto->is_void()) {
+      code.clear_cfg();
+    }
+  });
+  return schedule.waves().size();
+}
+
 void ResultPropagationPass::run_pass(DexStoresVector& stores,
                                      ConfigFiles& cfg,
                                      PassManager& mgr) {
   const auto scope = build_class_scope(stores);
-  const auto method_override_graph = method_override_graph::build_graph(scope);
-  ReturnParamResolver resolver(*method_override_graph);
-  const auto methods_which_return_parameter =
-      find_methods_which_return_parameter(mgr, scope, resolver);
+  const auto& method_override_graph =
+      mgr.analyses().method_override_graph(scope);
+  ReturnParamResolver resolver(method_override_graph);
+  ReturnParamMap methods_which_return_parameter;
+  const auto waves = find_methods_which_return_parameter(
+      scope, resolver, &methods_which_return_parameter);
+  ResultPropagation::InvokeCache invoke_cache;
 
   const auto stats = walk::parallel::reduce_methods<ResultPropagation::Stats>(
       scope,
@@ -432,7 +622,8 @@ void ResultPropagationPass::run_pass(DexStoresVector& stores,
           return ResultPropagation::Stats();
         }
 
-        ResultPropagation rp(methods_which_return_parameter, resolver);
+        ResultPropagation rp(methods_which_return_parameter, resolver,
+                             invoke_cache);
         rp.patch(mgr, code);
         return rp.get_stats();
       },
@@ -444,6 +635,7 @@ void ResultPropagationPass::run_pass(DexStoresVector& stores,
       });
   mgr.incr_metric(METRIC_METHODS_WHICH_RETURN_PARAMETER,
                   methods_which_return_parameter.size());
+  mgr.incr_metric(METRIC_METHODS_WHICH_RETURN_PARAMETER_WAVES, waves);
   mgr.incr_metric(METRIC_ERASED_MOVE_RESULTS, stats.erased_move_results);
   mgr.incr_metric(METRIC_PATCHED_MOVE_RESULTS, stats.patched_move_results);
   mgr.incr_metric(METRIC_UNVERIFIABLE_MOVE_RESULTS,
@@ -456,81 +648,4 @@ void ResultPropagationPass::run_pass(DexStoresVector& stores,
         stats.patched_move_results, stats.unverifiable_move_results);
 }
 
-const std::unordered_map<const DexMethod*, ParamIndex>
-ResultPropagationPass::find_methods_which_return_parameter(
-    PassManager& mgr, const Scope& scope, const ReturnParamResolver& resolver) {
-  walk::parallel::code(scope, [](DexMethod* method, IRCode& code) {
-    const auto proto = method->get_proto();
-    if (!proto->is_void()) {
-      // void methods cannot return a parameter, skip expensive analysis
-      code.build_cfg(/* editable */ true);
-    }
-  });
-
-  std::unordered_map<const DexMethod*, ParamIndex>
-      methods_which_return_parameter;
-  // We iterate a few times to capture chains of method calls that all
-  // eventually return `this`.
-  // TODO(perf): Add flag to limit number of iterations
-  // TODO(perf): For each analyzed method, keep track of the reasons (a set of
-  // methods) why the call resolution gave up, and use that "dependency"
-  // information to limit what needs to be processed in subsequent iterations
-  while (true) {
-    mgr.incr_metric(METRIC_METHODS_WHICH_RETURN_PARAMETER_ITERATIONS, 1);
-    const auto next_methods_which_return_parameter =
-        walk::parallel::reduce_methods<
-            std::unordered_map<const DexMethod*, ParamIndex>>(
-            scope,
-            [&](DexMethod* method) {
-              std::unordered_map<const DexMethod*, ParamIndex> res;
-
-              const auto code = method->get_code();
-              if (code == nullptr) {
-                return res;
-              }
-              const auto proto = method->get_proto();
-              if (proto->is_void()) {
-                // void methods cannot return a parameter, skip expensive
-                // analysis
-                return res;
-              }
-
-              const auto mwrpit = methods_which_return_parameter.find(method);
-              if (mwrpit != methods_which_return_parameter.end()) {
-                // Short-circuit re-computing for perf
-                res.insert({method, mwrpit->second});
-                return res;
-              }
-
-              // TODO(T35815704): Make the cfg const
-              cfg::ControlFlowGraph& cfg = code->cfg();
-              const auto return_param_index = resolver.get_return_param_index(
-                  cfg, methods_which_return_parameter);
-              if (return_param_index) {
-                res.insert({method, *return_param_index});
-              }
-
-              return res;
-            },
-            [](std::unordered_map<const DexMethod*, ParamIndex> a,
-               std::unordered_map<const DexMethod*, ParamIndex> b) {
-              a.insert(b.begin(), b.end());
-              return a;
-            });
-
-    if (next_methods_which_return_parameter.size() ==
-        methods_which_return_parameter.size()) {
-
-      walk::parallel::code(scope, [](DexMethod* method, IRCode& code) {
-        const auto proto = method->get_proto();
-        if (!proto->is_void()) {
-          code.clear_cfg();
-        }
-      });
-      return methods_which_return_parameter;
-    }
-    methods_which_return_parameter = next_methods_which_return_parameter;
-  }
-}
-
 static ResultPropagationPass s_pass;
@@ -7,6 +7,9 @@
 
 #pragma once
 
+#include <boost/functional/hash.hpp>
+
+#include "ConcurrentContainers.h"
 #include "MethodOverrideGraph.h"
 #include "Pass.h"
 #include "Resolver.h"
@@ -16,6 +19,13 @@
  */
 using ParamIndex = uint32_t;
 
+/*
+ * The methods which always return a particular incoming parameter, mapped to
+ * the index of that parameter. Entries are only ever added, so lookups may
+ * run concurrently with the analysis of other methods.
+ */
+using ReturnParamMap = ReadOptimizedConcurrentMap<const DexMethod*, ParamIndex>;
+
 /*
  * A helper function that computes the mapping of load param instructions
  * to their respective indices.
@@ -41,18 +51,32 @@ class ReturnParamResolver {
    */
   const boost::optional<ParamIndex> get_return_param_index(
       IRInstruction* insn,
-      const std::unordered_map<const DexMethod*, ParamIndex>&
-          methods_which_return_parameter,
+      const ReturnParamMap& methods_which_return_parameter,
       MethodRefCache& resolved_refs) const;
 
+  /*
+   * For an invocation given by an instruction, figure out the method whose
+   * entry in methods_which_return_parameter the result of
+   * get_return_param_index depends on, or nullptr if it depends on none. For
+   * virtual invocations, the result also depends on the entries of all the
+   * methods overriding it, which is denoted by setting `is_virtual`.
+   */
+  const DexMethod* get_dependency(IRInstruction* insn,
+                                  MethodRefCache& resolved_refs,
+                                  bool* is_virtual) const;
+
+  std::unordered_set<const DexMethod*> get_overriding_methods(
+      const DexMethod* method) const {
+    return method_override_graph::get_overriding_methods(m_graph, method);
+  }
+
   /*
    * For a method given by its cfg, figure out whether all regular return
    * instructions would return a particular incoming parameter.
    */
   const boost::optional<ParamIndex> get_return_param_index(
       cfg::ControlFlowGraph& cfg,
-      const std::unordered_map<const DexMethod*, ParamIndex>&
-          methods_which_return_parameter) const;
+      const ReturnParamMap& methods_which_return_parameter) const;
 
  private:
   bool returns_receiver(const DexMethodRef* method) const;
@@ -73,11 +97,23 @@ class ResultPropagation {
     size_t unverifiable_move_results{0};
   };
 
-  ResultPropagation(const std::unordered_map<const DexMethod*, ParamIndex>&
-                        methods_which_return_parameter,
-                    const ReturnParamResolver& resolver)
+  /*
+   * The return param indices of the invocations resolved so far, keyed by the
+   * invoked method and the invoke opcode. It may be shared by any number of
+   * ResultPropagation instances that patch code concurrently, as long as
+   * methods_which_return_parameter no longer changes.
+   */
+  using InvokeKey = std::pair<const DexMethodRef*, IROpcode>;
+  using InvokeCache = ReadOptimizedConcurrentMap<InvokeKey,
+                                                 boost::optional<ParamIndex>,
+                                                 boost::hash<InvokeKey>>;
+
+  ResultPropagation(const ReturnParamMap& methods_which_return_parameter,
+                    const ReturnParamResolver& resolver,
+                    InvokeCache& invoke_cache)
       : m_methods_which_return_parameter(methods_which_return_parameter),
-        m_resolver(resolver) {}
+        m_resolver(resolver),
+        m_invoke_cache(invoke_cache) {}
 
   const Stats& get_stats() const { return m_stats; }
 
@@ -87,9 +123,11 @@ class ResultPropagation {
   void patch(PassManager&, IRCode*);
 
  private:
-  const std::unordered_map<const DexMethod*, ParamIndex>&
-      m_methods_which_return_parameter;
+  const boost::optional<ParamIndex> get_return_param_index(IRInstruction* insn);
+
+  const ReturnParamMap& m_methods_which_return_parameter;
   const ReturnParamResolver& m_resolver;
+  InvokeCache& m_invoke_cache;
   mutable Stats m_stats;
   mutable MethodRefCache m_resolved_refs;
 };
@@ -108,14 +146,28 @@ class ResultPropagationPass : public Pass {
 
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
- private:
-  /*
-   * Via a fixed point computation that repeatedly inspects all methods,
-   * figure out all methods which return an incoming parameter, taking into
-   * account deep call chains.
-   */
-  static const std::unordered_map<const DexMethod*, ParamIndex>
-  find_methods_which_return_parameter(PassManager& mgr,
-                                      const Scope& scope,
-                                      const ReturnParamResolver& resolver);
+  analysis::Set required_analyses() const override {
+    return analysis::METHOD_OVERRIDE_GRAPH;
+  }
+
+  analysis::Set preserved_analyses() const override {
+    return analysis::CODE_AGNOSTIC;
+  }
+
 };
+
+/*
+ * Figure out all methods which return an incoming parameter, taking into
+ * account deep call chains, and add them to `methods_which_return_parameter`.
+ *
+ * Methods are grouped into the strongly connected components of the graph of
+ * the callees their results depend on. The components are analyzed in waves,
+ * each after all the components it depends on, and the components of a wave
+ * in parallel. Only the members of a component that calls itself need to be
+ * inspected repeatedly, until a fixed point is reached. Returns the number of
+ * waves.
+ */
+size_t find_methods_which_return_parameter(
+    const Scope& scope,
+    const ReturnParamResolver& resolver,
+    ReturnParamMap* methods_which_return_parameter);
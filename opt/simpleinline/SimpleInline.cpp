@@ -14,6 +14,7 @@
 #include <map>
 #include <set>
 
+#include "AnalysisManager.h"
 #include "ClassHierarchy.h"
 #include "Deleter.h"
 #include "DexClass.h"
@@ -33,7 +34,7 @@ void SimpleInlinePass::run_pass(DexStoresVector& stores, ConfigFiles& cfg, PassM
   }
   auto scope = build_class_scope(stores);
   // gather all inlinable candidates
-  auto methods = gather_non_virtual_methods(scope);
+  auto methods = gather_non_virtual_methods(scope, mgr.analyses());
 
   populate_blacklist(scope);
 
@@ -93,7 +94,7 @@ void SimpleInlinePass::run_pass(DexStoresVector& stores, ConfigFiles& cfg, PassM
  * for inlining.
  */
 std::unordered_set<DexMethod*> SimpleInlinePass::gather_non_virtual_methods(
-    Scope& scope) {
+    Scope& scope, AnalysisManager& analyses) {
   // trace counter
   size_t all_methods = 0;
   size_t direct_methods = 0;
@@ -132,7 +133,7 @@ std::unordered_set<DexMethod*> SimpleInlinePass::gather_non_virtual_methods(
         methods.insert(method);
       });
   if (m_virtual_inline) {
-    auto non_virtual = devirtualize(scope);
+    auto non_virtual = devirtualize(analyses.signature_map(scope));
     non_virt_methods = non_virtual.size();
     for (const auto& vmeth : non_virtual) {
       auto code = vmeth->get_code();
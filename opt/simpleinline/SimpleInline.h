@@ -27,7 +27,11 @@ class SimpleInlinePass : public Pass {
            true,
            m_inliner_config.enforce_method_size_limit);
     jw.get("use_cfg_inliner", false, m_inliner_config.use_cfg_inliner);
+    jw.get("move_single_callsite_callees",
+           false,
+           m_inliner_config.move_single_callsite_callees);
     jw.get("multiple_callers", false, m_inliner_config.multiple_callers);
+    jw.get("parallel", false, m_inliner_config.parallel);
     jw.get("inline_small_non_deletables",
            false,
            m_inliner_config.inline_small_non_deletables);
@@ -63,7 +67,8 @@ class SimpleInlinePass : public Pass {
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
  private:
-  std::unordered_set<DexMethod*> gather_non_virtual_methods(Scope& scope);
+  std::unordered_set<DexMethod*> gather_non_virtual_methods(
+      Scope& scope, AnalysisManager& analyses);
 
   void populate_blacklist(const Scope&);
 
@@ -25,13 +25,19 @@ void SimplifyCFGPass::run_pass(DexStoresVector& stores,
               return 0;
             }
 
-            int64_t before_insns = code->count_opcodes();
+            // With persistent CFGs the IRList is stale while a CFG is kept,
+            // so count what the CFG holds.
+            auto count_insns = [code]() -> int64_t {
+              return code->editable_cfg_built() ? code->cfg().num_opcodes()
+                                                : code->count_opcodes();
+            };
+            int64_t before_insns = count_insns();
 
-            // build and linearize the CFG
             code->build_cfg(/* editable */ true);
+            code->cfg().simplify_worklist();
             code->clear_cfg();
 
-            int64_t after_insns = code->count_opcodes();
+            int64_t after_insns = count_insns();
             return before_insns - after_insns;
           },
           [](int64_t a, int64_t b) { return a + b; });
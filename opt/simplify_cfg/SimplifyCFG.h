@@ -15,5 +15,7 @@ class SimplifyCFGPass : public Pass {
 
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
+  bool is_cfg_friendly() const override { return true; }
+
   virtual void configure_pass(const JsonWrapper& jw) override {}
 };
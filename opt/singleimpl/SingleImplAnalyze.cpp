@@ -6,6 +6,8 @@
  */
 
 #include <stdio.h>
+#include <algorithm>
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
@@ -24,6 +26,45 @@
 #include "Resolver.h"
 #include "Trace.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
+
+namespace {
+
+constexpr size_t kNotSingleImpl = std::numeric_limits<size_t>::max();
+
+/**
+ * A reference to a single impl interface found while scanning the methods:
+ * the interface in the signature of a method, or an instruction referring to
+ * the interface.
+ */
+struct Ref {
+  enum Kind : uint8_t {
+    METHOD_DEF,
+    TYPE_REF,
+    FIELD_REF,
+    INTF_METHOD_REF,
+    METHOD_REF,
+  };
+  Kind kind;
+  // The dense id of the interface.
+  size_t intf;
+  // The index of the method the reference is in.
+  size_t method;
+  IRInstruction* insn;
+  DexFieldRef* field;
+  DexMethodRef* meth;
+};
+
+/**
+ * What one thread finds while scanning the methods.
+ */
+struct ScanState {
+  // The escape reasons of the interfaces, by dense id.
+  std::vector<EscapeReason> escapes;
+  std::vector<Ref> refs;
+};
+
+} // namespace
 
 struct AnalysisImpl : SingleImplAnalysis {
   AnalysisImpl(const Scope& scope,
@@ -35,13 +76,16 @@ struct AnalysisImpl : SingleImplAnalysis {
                           const TypeSet& intfs,
                           const SingleImplConfig& config);
   void collect_field_defs();
-  void collect_method_defs();
-  void analyze_opcodes();
+  void analyze_methods();
   void escape_cross_stores();
   void remove_escaped();
 
  private:
   DexType* get_and_check_single_impl(DexType* type);
+  size_t find_single_impl(DexType* type, ScanState* state) const;
+  void scan_method(DexMethod* method, size_t index, ScanState* state) const;
+  void scan_opcode(IRInstruction* insn, size_t index, ScanState* state) const;
+  void collect_refs(std::vector<Ref>& refs);
   void collect_children(const TypeSet& intfs);
   void check_impl_hierarchy();
   void escape_with_clinit();
@@ -56,6 +100,11 @@ struct AnalysisImpl : SingleImplAnalysis {
   const Scope& scope;
   const ProguardMap& pg_map;
   XStoreRefs xstores;
+  // Dense ids of the single impl interfaces, which index the escape masks of
+  // the parallel scan of the methods.
+  std::vector<DexType*> intfs_by_id;
+  std::unordered_map<DexType*, size_t> intf_ids;
+  std::vector<DexMethod*> methods;
 };
 
 /**
@@ -299,153 +348,258 @@ void AnalysisImpl::collect_field_defs() {
 }
 
 /**
- * Find all methods with a single impl interface in their signature.
+ * Like get_and_check_single_impl, but returns the dense id of the interface,
+ * and records the escape in `state`, so that it can run in parallel.
+ */
+size_t AnalysisImpl::find_single_impl(DexType* type, ScanState* state) const {
+  auto it = intf_ids.find(type);
+  if (it != intf_ids.end()) return it->second;
+  if (is_array(type)) {
+    auto array_type = get_array_type(type);
+    assert(array_type);
+    it = intf_ids.find(array_type);
+    if (it != intf_ids.end()) {
+      state->escapes[it->second] |= HAS_ARRAY_TYPE;
+      return it->second;
+    }
+  }
+  return kNotSingleImpl;
+}
+
+/**
+ * Find whether a method has a single impl interface in its signature, and
+ * the opcodes of its code that reference a single implemented interface in a
+ * typeref, fieldref or methodref.
  * Also if a method with the interface in the signature is native mark the
  * interface as "escaped".
  */
-void AnalysisImpl::collect_method_defs() {
-
-  auto check_method_arg = [&](DexType* type, DexMethod* method, bool native) {
-    auto intf = get_and_check_single_impl(type);
-    if (!intf) return;
+void AnalysisImpl::scan_method(DexMethod* method,
+                               size_t index,
+                               ScanState* state) const {
+  bool native = is_native(method);
+  auto check_method_arg = [&](DexType* type) {
+    auto intf = find_single_impl(type, state);
+    if (intf == kNotSingleImpl) return;
     if (native) {
-      escape_interface(intf, NATIVE_METHOD);
+      state->escapes[intf] |= NATIVE_METHOD;
     }
-    if (method->get_class() == intf) {
-      escape_interface(intf, SELF_REFERENCE);
+    if (method->get_class() == intfs_by_id[intf]) {
+      state->escapes[intf] |= SELF_REFERENCE;
     }
-    single_impls[intf].methoddefs.insert(method);
+    state->refs.push_back(
+        {Ref::METHOD_DEF, intf, index, nullptr, nullptr, nullptr});
   };
+  auto proto = method->get_proto();
+  check_method_arg(proto->get_rtype());
+  for (const auto it : proto->get_args()->get_type_list()) {
+    check_method_arg(it);
+  }
 
-  walk::methods(scope,
-    [&](DexMethod* method) {
-      auto proto = method->get_proto();
-      bool native = is_native(method);
-      check_method_arg(proto->get_rtype(), method, native);
-      auto args = proto->get_args();
-      for (const auto it : args->get_type_list()) {
-        check_method_arg(it, method, native);
-      }
-    });
+  auto code = method->get_code();
+  if (code == nullptr) return;
+  for (auto& mie : InstructionIterable(code)) {
+    scan_opcode(mie.insn, index, state);
+  }
 }
 
-/**
- * Find all opcodes that reference a single implemented interface in a typeref,
- * fieldref or methodref.
- */
-void AnalysisImpl::analyze_opcodes() {
-
-  auto check_arg = [&](DexType* type, DexMethodRef* meth, IRInstruction* insn) {
-    auto intf = get_and_check_single_impl(type);
-    if (intf) {
-      single_impls[intf].methodrefs[meth].insert(insn);
-    }
-  };
-
-  auto check_sig = [&](DexMethodRef* meth, IRInstruction* insn) {
+void AnalysisImpl::scan_opcode(IRInstruction* insn,
+                               size_t index,
+                               ScanState* state) const {
+  auto check_sig = [&](DexMethodRef* meth) {
     // check the sig for single implemented interface
+    auto check_arg = [&](DexType* type) {
+      auto intf = find_single_impl(type, state);
+      if (intf != kNotSingleImpl) {
+        state->refs.push_back(
+            {Ref::METHOD_REF, intf, index, insn, nullptr, meth});
+      }
+    };
     const auto proto = meth->get_proto();
-    check_arg(proto->get_rtype(), meth, insn);
-    const auto args = proto->get_args();
-    for (const auto arg : args->get_type_list()) {
-      check_arg(arg, meth, insn);
+    check_arg(proto->get_rtype());
+    for (const auto arg : proto->get_args()->get_type_list()) {
+      check_arg(arg);
     }
   };
 
-  auto check_field = [&](DexFieldRef* field, IRInstruction* insn) {
-    auto cls = field->get_class();
-    cls = get_and_check_single_impl(cls);
-    if (cls) {
-      escape_interface(cls, HAS_FIELD_REF);
+  auto check_field = [&](DexFieldRef* field) {
+    auto cls = find_single_impl(field->get_class(), state);
+    if (cls != kNotSingleImpl) {
+      state->escapes[cls] |= HAS_FIELD_REF;
     }
-    const auto type = field->get_type();
-    auto intf = get_and_check_single_impl(type);
-    if (intf) {
-      single_impls[intf].fieldrefs[field].push_back(insn);
+    auto intf = find_single_impl(field->get_type(), state);
+    if (intf != kNotSingleImpl) {
+      state->refs.push_back({Ref::FIELD_REF, intf, index, insn, field, nullptr});
     }
   };
 
-  walk::opcodes(scope,
-               [](DexMethod* method) { return true; },
-               [&](DexMethod* method, IRInstruction* insn) {
-                 auto op = insn->opcode();
-                 switch (op) {
-                 // type ref
-                 case OPCODE_CONST_CLASS:
-                 case OPCODE_CHECK_CAST:
-                 case OPCODE_INSTANCE_OF:
-                 case OPCODE_NEW_INSTANCE:
-                 case OPCODE_NEW_ARRAY:
-                 case OPCODE_FILLED_NEW_ARRAY: {
-                   auto intf = get_and_check_single_impl(insn->get_type());
-                   if (intf) {
-                     single_impls[intf].typerefs.push_back(insn);
-                   }
-                   return;
-                 }
-                 // field ref
-                 case OPCODE_IGET:
-                 case OPCODE_IGET_WIDE:
-                 case OPCODE_IGET_OBJECT:
-                 case OPCODE_IPUT:
-                 case OPCODE_IPUT_WIDE:
-                 case OPCODE_IPUT_OBJECT: {
-                   DexFieldRef* field =
-                       resolve_field(insn->get_field(), FieldSearch::Instance);
-                   if (field == nullptr) {
-                     field = insn->get_field();
-                   }
-                   check_field(field, insn);
-                   return;
-                 }
-                 case OPCODE_SGET:
-                 case OPCODE_SGET_WIDE:
-                 case OPCODE_SGET_OBJECT:
-                 case OPCODE_SPUT:
-                 case OPCODE_SPUT_WIDE:
-                 case OPCODE_SPUT_OBJECT: {
-                   DexFieldRef* field =
-                       resolve_field(insn->get_field(), FieldSearch::Static);
-                   if (field == nullptr) {
-                     field = insn->get_field();
-                   }
-                   check_field(field, insn);
-                   return;
-                 }
-                 // method ref
-                 case OPCODE_INVOKE_INTERFACE: {
-                   // if it is an invoke on the interface method, collect it as
-                   // such
-                   const auto meth = insn->get_method();
-                   const auto owner = meth->get_class();
-                   const auto intf = get_and_check_single_impl(owner);
-                   if (intf) {
-                     // if the method ref is not defined on the interface itself
-                     // drop the optimization
-                     const auto& meths = type_class(intf)->get_vmethods();
-                     if (std::find(meths.begin(), meths.end(), meth) ==
-                         meths.end()) {
-                       escape_interface(intf, UNKNOWN_MREF);
-                     } else {
-                       single_impls[intf].intf_methodrefs[meth].insert(insn);
-                     }
-                   }
-                   check_sig(meth, insn);
-                   return;
-                 }
-
-                 case OPCODE_INVOKE_DIRECT:
-                 case OPCODE_INVOKE_STATIC:
-                 case OPCODE_INVOKE_VIRTUAL:
-                 case OPCODE_INVOKE_SUPER: {
-                   const auto meth = insn->get_method();
-                   check_sig(meth, insn);
-                   return;
-                 }
-                 default:
-                   return;
-                 }
-               });
+  auto op = insn->opcode();
+  switch (op) {
+  // type ref
+  case OPCODE_CONST_CLASS:
+  case OPCODE_CHECK_CAST:
+  case OPCODE_INSTANCE_OF:
+  case OPCODE_NEW_INSTANCE:
+  case OPCODE_NEW_ARRAY:
+  case OPCODE_FILLED_NEW_ARRAY: {
+    auto intf = find_single_impl(insn->get_type(), state);
+    if (intf != kNotSingleImpl) {
+      state->refs.push_back(
+          {Ref::TYPE_REF, intf, index, insn, nullptr, nullptr});
+    }
+    return;
+  }
+  // field ref
+  case OPCODE_IGET:
+  case OPCODE_IGET_WIDE:
+  case OPCODE_IGET_OBJECT:
+  case OPCODE_IPUT:
+  case OPCODE_IPUT_WIDE:
+  case OPCODE_IPUT_OBJECT: {
+    DexFieldRef* field = resolve_field(insn->get_field(), FieldSearch::Instance);
+    if (field == nullptr) {
+      field = insn->get_field();
+    }
+    check_field(field);
+    return;
+  }
+  case OPCODE_SGET:
+  case OPCODE_SGET_WIDE:
+  case OPCODE_SGET_OBJECT:
+  case OPCODE_SPUT:
+  case OPCODE_SPUT_WIDE:
+  case OPCODE_SPUT_OBJECT: {
+    DexFieldRef* field = resolve_field(insn->get_field(), FieldSearch::Static);
+    if (field == nullptr) {
+      field = insn->get_field();
+    }
+    check_field(field);
+    return;
+  }
+  // method ref
+  case OPCODE_INVOKE_INTERFACE: {
+    // if it is an invoke on the interface method, collect it as
+    // such
+    const auto meth = insn->get_method();
+    const auto intf = find_single_impl(meth->get_class(), state);
+    if (intf != kNotSingleImpl) {
+      // if the method ref is not defined on the interface itself
+      // drop the optimization
+      const auto& meths = type_class(intfs_by_id[intf])->get_vmethods();
+      if (std::find(meths.begin(), meths.end(), meth) == meths.end()) {
+        state->escapes[intf] |= UNKNOWN_MREF;
+      } else {
+        state->refs.push_back(
+            {Ref::INTF_METHOD_REF, intf, index, insn, nullptr, meth});
+      }
+    }
+    check_sig(meth);
+    return;
+  }
+
+  case OPCODE_INVOKE_DIRECT:
+  case OPCODE_INVOKE_STATIC:
+  case OPCODE_INVOKE_VIRTUAL:
+  case OPCODE_INVOKE_SUPER: {
+    check_sig(insn->get_method());
+    return;
+  }
+  default:
+    return;
+  }
+}
+
+/**
+ * Find all methods with a single impl interface in their signature, and all
+ * opcodes that reference a single implemented interface.
+ * The methods are scanned in parallel, each thread recording escapes in its
+ * own mask per interface. The masks are merged once all the methods are
+ * scanned, and the references are then added to the interfaces that didn't
+ * escape.
+ */
+void AnalysisImpl::analyze_methods() {
+  for (const auto& intf_it : single_impls) {
+    intf_ids.emplace(intf_it.first, intfs_by_id.size());
+    intfs_by_id.push_back(intf_it.first);
+  }
+  walk::methods(scope, [&](DexMethod* method) { methods.push_back(method); });
+
+  auto num_threads = walk::parallel::default_num_threads();
+  std::vector<ScanState> states(num_threads);
+  auto wq = WorkQueue<size_t, ScanState*, std::nullptr_t>(
+      [&](WorkerState<size_t, ScanState*, std::nullptr_t>* worker,
+          size_t index) {
+        scan_method(methods[index], index, worker->get_data());
+        return nullptr;
+      },
+      [](std::nullptr_t, std::nullptr_t) { return nullptr; }, // reducer
+      [&](unsigned int thread_index) { // data initializer
+        auto state = &states[thread_index];
+        state->escapes.resize(intfs_by_id.size(), NO_ESCAPE);
+        return state;
+      },
+      num_threads);
+  for (size_t i = 0; i < methods.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  std::vector<Ref> refs;
+  for (auto& state : states) {
+    for (size_t intf = 0; intf < intfs_by_id.size(); ++intf) {
+      if (state.escapes[intf] != NO_ESCAPE) {
+        escape_interface(intfs_by_id[intf], state.escapes[intf]);
+      }
+    }
+    refs.insert(refs.end(), state.refs.begin(), state.refs.end());
+  }
+  // Every method was scanned by a single thread, so this restores the order of
+  // a serial walk.
+  std::stable_sort(refs.begin(), refs.end(), [](const Ref& a, const Ref& b) {
+    return a.method < b.method;
+  });
+  collect_refs(refs);
+}
+
+/**
+ * Add the references found by the scan to the data of their interfaces, in
+ * parallel over the interfaces. The references to escaped interfaces are
+ * dropped, since those are removed anyway.
+ */
+void AnalysisImpl::collect_refs(std::vector<Ref>& refs) {
+  std::vector<std::vector<const Ref*>> refs_by_intf(intfs_by_id.size());
+  for (const auto& ref : refs) {
+    refs_by_intf[ref.intf].push_back(&ref);
+  }
+  auto wq = workqueue_foreach<size_t>(
+      [&](size_t intf) {
+        auto& data = single_impls.at(intfs_by_id[intf]);
+        for (auto ref : refs_by_intf[intf]) {
+          switch (ref->kind) {
+          case Ref::METHOD_DEF:
+            data.methoddefs.insert(methods[ref->method]);
+            break;
+          case Ref::TYPE_REF:
+            data.typerefs.push_back(ref->insn);
+            break;
+          case Ref::FIELD_REF:
+            data.fieldrefs[ref->field].push_back(ref->insn);
+            break;
+          case Ref::INTF_METHOD_REF:
+            data.intf_methodrefs[ref->meth].insert(ref->insn);
+            break;
+          case Ref::METHOD_REF:
+            data.methodrefs[ref->meth].insert(ref->insn);
+            break;
+          }
+        }
+      },
+      walk::parallel::default_num_threads());
+  for (size_t intf = 0; intf < intfs_by_id.size(); ++intf) {
+    if (!refs_by_intf[intf].empty() && !is_escaped(intfs_by_id[intf])) {
+      wq.add_item(intf);
+    }
+  }
+  wq.run_all();
 }
 
 /**
@@ -460,9 +614,8 @@ std::unique_ptr<SingleImplAnalysis> SingleImplAnalysis::analyze(
       new AnalysisImpl(scope, pg_map, stores));
   single_impls->create_single_impl(single_impl, intfs, config);
   single_impls->collect_field_defs();
-  single_impls->collect_method_defs();
-  single_impls->analyze_opcodes();
   single_impls->escape_cross_stores();
+  single_impls->analyze_methods();
   single_impls->remove_escaped();
   return std::move(single_impls);
 }
@@ -98,7 +98,7 @@ void remove_interface(DexType* intf, SingleImplData& data) {
   std::unordered_set<DexType*> new_intfs;
   auto collect_interfaces = [&](DexClass* impl) {
     auto intfs = impl->get_interfaces();
-    auto intf_types = intfs->get_type_list();
+    const auto& intf_types = intfs->get_type_list();
     for (auto type : intf_types) {
       if (intf != type) {
         // make interface public if it was not already. It may happen
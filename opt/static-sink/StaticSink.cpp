@@ -120,17 +120,15 @@ std::vector<DexClass*> get_coldstart_classes(
   const DexClassesVector& dexen,
   ConfigFiles& cfg
 ) {
-  auto interdex_list = cfg.get_coldstart_classes();
-  std::unordered_map<std::string, DexClass*> class_string_map;
-  std::vector<DexClass*> coldstart_classes;
+  std::unordered_set<const DexClass*> classes;
   for (auto const& dex : dexen) {
-    for (auto const& cls : dex) {
-      class_string_map[cls->get_type()->get_name()->str()] = cls;
-    }
+    classes.insert(dex.begin(), dex.end());
   }
-  for (auto const& class_string : interdex_list) {
-    if (class_string_map.count(class_string)) {
-      coldstart_classes.push_back(class_string_map[class_string]);
+  std::vector<DexClass*> coldstart_classes;
+  for (DexType* type : cfg.get_coldstart_types()) {
+    DexClass* cls = type == nullptr ? nullptr : type_class(type);
+    if (cls != nullptr && classes.count(cls)) {
+      coldstart_classes.push_back(cls);
     }
   }
   return coldstart_classes;
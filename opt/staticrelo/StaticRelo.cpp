@@ -115,18 +115,16 @@ std::unordered_map<const DexClass*, size_t> build_class_to_dex_map(
 std::unordered_map<const DexClass*, size_t> build_class_to_pgo_order_map(
   const DexClassesVector& dexen,
   ConfigFiles& cfg) {
-  auto interdex_list = cfg.get_coldstart_classes();
-  std::unordered_map<std::string, DexClass*> class_string_map;
-  std::unordered_map<const DexClass*, size_t> coldstart_classes;
+  std::unordered_set<const DexClass*> classes;
   for (auto const& dex : dexen) {
-    for (auto const& cls : dex) {
-      class_string_map[cls->get_type()->get_name()->str()] = cls;
-    }
+    classes.insert(dex.begin(), dex.end());
   }
+  std::unordered_map<const DexClass*, size_t> coldstart_classes;
   int rank = 0;
-  for (auto const& class_string : interdex_list) {
-    if (class_string_map.count(class_string)) {
-      coldstart_classes[class_string_map[class_string]] = rank++;
+  for (DexType* type : cfg.get_coldstart_types()) {
+    const DexClass* cls = type == nullptr ? nullptr : type_class(type);
+    if (cls != nullptr && classes.count(cls)) {
+      coldstart_classes[cls] = rank++;
     }
   }
   return coldstart_classes;
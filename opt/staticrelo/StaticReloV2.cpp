@@ -7,9 +7,13 @@
 
 #include "StaticReloV2.h"
 
+#include <algorithm>
+#include <functional>
+
 #include "Resolver.h"
 #include "TypeSystem.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 /**
  * Implementation:
@@ -81,42 +85,77 @@ struct StaticCallGraph {
 };
 
 /**
- * Build call graph for all static methods in candidate classes
+ * The vertices that `method` invokes, without duplicates, in the order of the
+ * first invoke of each.
+ */
+std::vector<int> static_callees(const StaticCallGraph& graph,
+                                DexMethod* method) {
+  std::vector<int> callee_ids;
+  IRCode* code = method->get_code();
+  if (code == nullptr) {
+    return callee_ids;
+  }
+  for (const auto& mie : InstructionIterable(code)) {
+    if (mie.insn->opcode() != OPCODE_INVOKE_STATIC) {
+      continue;
+    }
+    DexMethod* callee =
+        resolve_method(mie.insn->get_method(), MethodSearch::Static);
+    auto it = graph.method_id_map.find(callee);
+    if (it != graph.method_id_map.end() &&
+        std::find(callee_ids.begin(), callee_ids.end(), it->second) ==
+            callee_ids.end()) {
+      callee_ids.push_back(it->second);
+    }
+  }
+  return callee_ids;
+}
+
+/**
+ * Run `fn(i)` for every i in [0, n) in parallel.
  */
-void build_call_graph(const std::unordered_set<DexClass*>& candidate_classes,
+void parallel_for(size_t n, const std::function<void(size_t)>& fn) {
+  auto wq = workqueue_foreach<size_t>(fn, walk::parallel::default_num_threads());
+  for (size_t i = 0; i < n; i++) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+}
+
+/**
+ * Build call graph for all static methods in candidate classes. The vertices
+ * are numbered in the order of the scope, so that the relocations are applied
+ * in the same order on every run.
+ */
+void build_call_graph(const Scope& scope,
+                      const std::unordered_set<DexClass*>& candidate_classes,
                       StaticCallGraph& graph) {
-  walk::classes(candidate_classes, [&](DexClass* cls) {
+  for (DexClass* cls : scope) {
+    if (candidate_classes.count(cls) == 0) {
+      continue;
+    }
     // The candidate class set only contains classes with only static methods
     for (auto& method : cls->get_dmethods()) {
       graph.add_vertex(method);
     }
-  });
+  }
 
   graph.callers.resize(graph.vertices.size());
   graph.callees.resize(graph.vertices.size());
 
-  for (auto& meth_id : graph.method_id_map) {
-    DexMethod* caller = meth_id.first;
-    int caller_id = meth_id.second;
-    for (const auto& mie : InstructionIterable(caller->get_code())) {
-      if (mie.insn->has_method()) {
-        if (mie.insn->opcode() != OPCODE_INVOKE_STATIC) {
-          continue;
-        }
-        DexMethod* callee =
-            resolve_method(mie.insn->get_method(), MethodSearch::Static);
-        if (graph.method_id_map.find(callee) != graph.method_id_map.end()) {
-          int callee_id = graph.method_id_map[callee];
-          graph.callers[callee_id].insert(caller_id);
-          graph.callees[caller_id].insert(callee_id);
-        }
-      }
+  std::vector<std::vector<int>> callee_ids(graph.vertices.size());
+  parallel_for(graph.vertices.size(), [&](size_t caller_id) {
+    callee_ids[caller_id] =
+        static_callees(graph, graph.vertices[caller_id].method);
+  });
+  for (size_t caller_id = 0; caller_id < callee_ids.size(); caller_id++) {
+    for (int callee_id : callee_ids[caller_id]) {
+      graph.callers[callee_id].insert(caller_id);
+      graph.callees[caller_id].insert(callee_id);
     }
   }
 }
 
-void color_vertex(StaticCallGraph& graph, DexMethod* method, int color);
-
 void color_vertex(StaticCallGraph& graph,
                   StaticCallGraph::Vertex& vertex,
                   int color) {
@@ -128,8 +167,8 @@ void color_vertex(StaticCallGraph& graph,
     if (is_private(vertex.method)) {
       // color callers within the same class of this private vertex.method
       for (int caller_id : graph.callers[vertex.id]) {
-        DexMethod* caller = graph.vertices[caller_id].method;
-        if (caller->get_class() == vertex.method->get_class()) {
+        auto& caller = graph.vertices[caller_id];
+        if (caller.method->get_class() == vertex.method->get_class()) {
           color_vertex(graph, caller, color);
         }
       }
@@ -137,35 +176,16 @@ void color_vertex(StaticCallGraph& graph,
   }
 }
 
-void color_vertex(StaticCallGraph& graph, DexMethod* method, int color) {
-  // Assume the method is in the map
-  always_assert(graph.method_id_map.count(method) == 1);
-  int method_id = graph.method_id_map[method];
-  color_vertex(graph, graph.vertices[method_id], color);
-}
-
 /**
- * Color the vertices for a class
- * For private static method, should color all the caller within the class to
- * the same color
+ * The vertices that the methods of a class invoke, which get the color of the
+ * class.
  */
-void color_from_a_class(StaticCallGraph& graph, DexClass* cls, int color) {
+std::vector<int> callees_of_a_class(const StaticCallGraph& graph,
+                                    DexClass* cls) {
+  std::vector<int> callee_ids;
   auto process_method = [&](DexMethod* caller) {
-    IRCode* code = caller->get_code();
-    if (code == nullptr) {
-      return;
-    }
-    for (const auto& mie : InstructionIterable(code)) {
-      if (mie.insn->has_method()) {
-        if (mie.insn->opcode() != OPCODE_INVOKE_STATIC) {
-          continue;
-        }
-        DexMethod* callee =
-            resolve_method(mie.insn->get_method(), MethodSearch::Static);
-        if (graph.method_id_map.find(callee) != graph.method_id_map.end()) {
-          color_vertex(graph, callee, color);
-        }
-      }
+    for (int callee_id : static_callees(graph, caller)) {
+      callee_ids.push_back(callee_id);
     }
   };
   for (DexMethod* method : cls->get_vmethods()) {
@@ -174,6 +194,7 @@ void color_from_a_class(StaticCallGraph& graph, DexClass* cls, int color) {
   for (DexMethod* method : cls->get_dmethods()) {
     process_method(method);
   }
+  return callee_ids;
 }
 
 /**
@@ -244,12 +265,20 @@ std::unordered_set<DexClass*> StaticReloPassV2::gen_candidates(
 int StaticReloPassV2::run_relocation(
     const Scope& scope, std::unordered_set<DexClass*>& candidate_classes) {
   StaticCallGraph graph;
-  build_call_graph(candidate_classes, graph);
+  build_call_graph(scope, candidate_classes, graph);
+  // Scanning the code of the other classes is the expensive part, and it
+  // doesn't depend on the colors, so it runs in parallel. The coloring itself
+  // is a cheap walk of the graph, done in the order of the scope.
+  std::vector<std::vector<int>> class_callees(scope.size());
+  parallel_for(scope.size(), [&](size_t color) {
+    if (candidate_classes.count(scope[color]) == 0) {
+      class_callees[color] = callees_of_a_class(graph, scope[color]);
+    }
+  });
   for (size_t color = 0; color < scope.size(); color++) {
-    if (candidate_classes.find(scope[color]) != candidate_classes.end()) {
-      continue;
+    for (int callee_id : class_callees[color]) {
+      color_vertex(graph, graph.vertices[callee_id], color);
     }
-    color_from_a_class(graph, scope[color], color);
   }
 
   return relocate_clusters(graph, scope);
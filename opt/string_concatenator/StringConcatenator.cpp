@@ -9,10 +9,10 @@
 
 #include <boost/optional.hpp>
 #include <map>
-#include <mutex>
 #include <unordered_map>
 #include <utility>
 
+#include "ClassMutations.h"
 #include "ControlFlow.h"
 #include "DexClass.h"
 #include "IRCode.h"
@@ -129,19 +129,6 @@ struct ConcatenatorConfig {
   }
 };
 
-struct LockedMethodSet {
-  using Map = std::set<DexMethod*, dexmethods_comparator>;
-  std::mutex mutex;
-  Map map;
-
-  void insert(DexMethod* method) {
-    std::lock_guard<std::mutex> lock(mutex);
-    map.insert(method);
-  }
-
-  Map& get() { return map; }
-};
-
 class Concatenator {
 
   using BuilderStrMap = std::unordered_map<StrBuilderId, std::string>;
@@ -334,7 +321,7 @@ class Concatenator {
 
   Stats run(cfg::ControlFlowGraph* cfg,
             DexMethod* method,
-            LockedMethodSet* methods_to_remove) {
+            ClassMutations* mutations) {
     Stats stats;
     const auto& blocks = cfg->blocks();
     if (blocks.size() != 1) {
@@ -356,7 +343,7 @@ class Concatenator {
     const auto before_size = block->num_opcodes();
     encode(fields);
     clear_method(cfg, &block->get_entries());
-    methods_to_remove->insert(method);
+    mutations->remove_method(method);
     const auto after_size = block->num_opcodes();
 
     stats.insns_removed += before_size - after_size;
@@ -377,10 +364,10 @@ void StringConcatenatorPass::run_pass(DexStoresVector& stores,
   const bool DEBUG = false;
   const auto& scope = build_class_scope(stores);
   const ConcatenatorConfig config{};
-  LockedMethodSet methods_to_remove;
+  ClassMutations mutations;
   Stats stats = walk::parallel::reduce_methods<Stats, Scope>(
       scope,
-      [&config, &methods_to_remove](DexMethod* m) -> Stats {
+      [&config, &mutations](DexMethod* m) -> Stats {
         auto code = m->get_code();
         if (code == nullptr) {
           return Stats{};
@@ -393,7 +380,7 @@ void StringConcatenatorPass::run_pass(DexStoresVector& stores,
 
         code->build_cfg(/* editable */ true);
         Stats stats =
-            Concatenator{config}.run(&code->cfg(), m, &methods_to_remove);
+            Concatenator{config}.run(&code->cfg(), m, &mutations);
         code->clear_cfg();
 
         return stats;
@@ -405,14 +392,9 @@ void StringConcatenatorPass::run_pass(DexStoresVector& stores,
       Stats{},
       DEBUG ? 1 : walk::parallel::default_num_threads());
 
-  for (DexMethod* method : methods_to_remove.get()) {
-    // We can delete the method without finding callsites because these are all
-    // <clinit> methods, which don't have explicit callsites
-    auto cls = type_class(method->get_class());
-    always_assert_log(cls != nullptr, "%s comes from an unknown class",
-                      SHOW(method));
-    cls->remove_method(method);
-  }
+  // We can delete the methods without finding callsites because these are all
+  // <clinit> methods, which don't have explicit callsites
+  mutations.apply();
 
   stats.report(mgr);
 }
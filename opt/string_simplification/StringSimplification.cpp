@@ -14,21 +14,77 @@
 constexpr const char* NUM_CONST_STRINGS_ADDED = "num_const_strings_added";
 constexpr const char* NUM_INSTRUCTIONS_ADDED = "num_instructions_added";
 constexpr const char* NUM_INSTRUCTIONS_REMOVED = "num_instructions_removed";
+constexpr const char* NUM_METHODS_ANALYZED = "num_methods_analyzed";
+
+namespace {
+
+struct Stats {
+  size_t strings_added{0};
+  size_t instructions_added{0};
+  size_t instructions_removed{0};
+  size_t methods_analyzed{0};
+
+  Stats& operator+=(const Stats& that) {
+    strings_added += that.strings_added;
+    instructions_added += that.instructions_added;
+    instructions_removed += that.instructions_removed;
+    methods_analyzed += that.methods_analyzed;
+    return *this;
+  }
+};
+
+/*
+ * The only rewrites StringIterator performs are on calls to
+ * StringBuilder.toString(), hence there is no point in running the fixpoint on
+ * methods which don't have any.
+ */
+bool has_to_string_call(IRCode* code, DexMethodRef* to_string_method) {
+  for (const auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    if (insn->opcode() == OPCODE_INVOKE_VIRTUAL &&
+        insn->get_method() == to_string_method) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
 
 void StringSimplificationPass::run_pass(DexStoresVector& stores,
                                         ConfigFiles& /* cfg */,
                                         PassManager& mgr) {
   auto scope = build_class_scope(stores);
-  walk::code(scope, [&](DexMethod* m, IRCode& code) {
-    TRACE(STR_SIMPLE, 8, "Method: %s\n", SHOW(m));
-    code.build_cfg(/* editable */ false);
-    StringIterator iter(&code, code.cfg().entry_block());
-    iter.run(StringProdEnvironment());
-    iter.simplify();
-    mgr.incr_metric(NUM_CONST_STRINGS_ADDED, iter.get_strings_added());
-    mgr.incr_metric(NUM_INSTRUCTIONS_ADDED, iter.get_instructions_added());
-    mgr.incr_metric(NUM_INSTRUCTIONS_REMOVED, iter.get_instructions_removed());
-  });
+  auto to_string_method = DexMethod::make_method(
+      STRINGBUILDER_DEF, "toString", STRING_DEF, {});
+  Stats stats = walk::parallel::reduce_methods<Stats, Scope>(
+      scope,
+      [to_string_method](DexMethod* m) -> Stats {
+        auto code = m->get_code();
+        if (code == nullptr || !has_to_string_call(code, to_string_method)) {
+          return Stats{};
+        }
+        TRACE(STR_SIMPLE, 8, "Method: %s\n", SHOW(m));
+        code->build_cfg(/* editable */ false);
+        StringIterator iter(code, code->cfg().entry_block());
+        iter.run(StringProdEnvironment());
+        iter.simplify();
+        code->clear_cfg();
+        Stats stats;
+        stats.strings_added = iter.get_strings_added();
+        stats.instructions_added = iter.get_instructions_added();
+        stats.instructions_removed = iter.get_instructions_removed();
+        stats.methods_analyzed = 1;
+        return stats;
+      },
+      [](Stats a, Stats b) {
+        a += b;
+        return a;
+      });
+  mgr.incr_metric(NUM_CONST_STRINGS_ADDED, stats.strings_added);
+  mgr.incr_metric(NUM_INSTRUCTIONS_ADDED, stats.instructions_added);
+  mgr.incr_metric(NUM_INSTRUCTIONS_REMOVED, stats.instructions_removed);
+  mgr.incr_metric(NUM_METHODS_ANALYZED, stats.methods_analyzed);
 }
 
 static StringSimplificationPass s_pass;
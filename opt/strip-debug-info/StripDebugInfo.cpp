@@ -126,12 +126,16 @@ bool StripDebugInfo::should_drop_for_synth(const DexMethod* method) const {
 }
 
 Stats StripDebugInfo::run(Scope scope) {
-  Stats stats;
-  walk::code(scope, [&](DexMethod* meth, IRCode& code) {
-    if (!method_passes_filter(meth)) return;
-    stats += run(code, should_drop_for_synth(meth));
-  });
-  return stats;
+  return walk::parallel::accumulate_methods<Stats>(
+      scope,
+      [&](DexMethod* meth) {
+        auto code = meth->get_code();
+        if (code == nullptr || !method_passes_filter(meth)) {
+          return Stats();
+        }
+        return run(*code, should_drop_for_synth(meth));
+      },
+      [](Stats& left, Stats&& right) { left += right; });
 }
 
 Stats StripDebugInfo::run(IRCode& code, bool should_drop_synth) {
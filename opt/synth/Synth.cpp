@@ -7,6 +7,7 @@
 
 #include "Synth.h"
 
+#include <numeric>
 #include <signal.h>
 #include <stdio.h>
 #include <string>
@@ -25,6 +26,7 @@
 #include "IRCode.h"
 #include "IRInstruction.h"
 #include "Mutators.h"
+#include "Parallel.h"
 #include "PassManager.h"
 #include "ReachableClasses.h"
 #include "Resolver.h"
@@ -288,65 +290,82 @@ void purge_wrapped_wrappers(WrapperMethods& ssms) {
   ssms.next_pass = ssms.next_pass || remove.size() > 0;
 }
 
+/*
+ * What analyze() found a direct method to be. The getters, wrappers and
+ * constructor wrappers of WrapperMethods are built from a table of these.
+ */
+struct WrapperKind {
+  enum Kind : uint8_t { NONE, CTOR, GETTER, WRAPPER };
+  Kind kind{NONE};
+  // The field that a GETTER gets.
+  DexField* field{nullptr};
+  // The method that a CTOR or WRAPPER calls.
+  DexMethod* method{nullptr};
+};
+
+WrapperKind classify(const ClassHierarchy& ch,
+                     DexMethod* dmethod,
+                     const SynthConfig& synthConfig) {
+  WrapperKind result;
+  // constructors are special and all we can remove are synthetic ones
+  if (synthConfig.remove_constructors && is_synthetic(dmethod) &&
+      is_constructor(dmethod)) {
+    auto ctor = trivial_ctor_wrapper(dmethod);
+    if (ctor) {
+      TRACE(SYNT, 2, "Trivial constructor wrapper: %s\n", SHOW(dmethod));
+      TRACE(SYNT, 2, "  Calls constructor: %s\n", SHOW(ctor));
+      result.kind = WrapperKind::CTOR;
+      result.method = ctor;
+    }
+    return result;
+  }
+  if (is_constructor(dmethod)) return result;
+
+  if (is_static_synthetic(dmethod)) {
+    auto field = trivial_get_field_wrapper(dmethod);
+    if (field) {
+      TRACE(SYNT, 2, "Static trivial getter: %s\n", SHOW(dmethod));
+      TRACE(SYNT, 2, "  Gets field: %s\n", SHOW(field));
+      result.kind = WrapperKind::GETTER;
+      result.field = field;
+      return result;
+    }
+    auto sfield = trivial_get_static_field_wrapper(dmethod);
+    if (sfield) {
+      TRACE(SYNT, 2, "Static trivial static field getter: %s\n",
+      SHOW(dmethod));
+      TRACE(SYNT, 2, "  Gets static field: %s\n", SHOW(sfield));
+      result.kind = WrapperKind::GETTER;
+      result.field = sfield;
+      return result;
+    }
+  }
+
+  if (can_optimize(dmethod, synthConfig)) {
+    auto method = trivial_method_wrapper(dmethod, ch);
+    if (method) {
+      // this is not strictly needed but to avoid changing visibility of
+      // virtuals we are skipping a wrapper to a virtual.
+      // Incidentally we have no single method falling in that bucket
+      // at this time
+      if (method->is_virtual()) return result;
+
+      TRACE(SYNT, 2, "Static trivial method wrapper: %s\n", SHOW(dmethod));
+      TRACE(SYNT, 2, "  Calls method: %s\n", SHOW(method));
+      result.kind = WrapperKind::WRAPPER;
+      result.method = method;
+    }
+  }
+  return result;
+}
+
 WrapperMethods analyze(const ClassHierarchy& ch,
                        const std::vector<DexClass*>& classes,
                        const SynthConfig& synthConfig) {
-  WrapperMethods ssms;
+  std::vector<DexMethod*> dmethods;
   for (auto cls : classes) {
     for (auto dmethod : cls->get_dmethods()) {
-      // constructors are special and all we can remove are synthetic ones
-      if (synthConfig.remove_constructors && is_synthetic(dmethod) &&
-          is_constructor(dmethod)) {
-        auto ctor = trivial_ctor_wrapper(dmethod);
-        if (ctor) {
-          TRACE(SYNT, 2, "Trivial constructor wrapper: %s\n", SHOW(dmethod));
-          TRACE(SYNT, 2, "  Calls constructor: %s\n", SHOW(ctor));
-          ssms.ctors.emplace(dmethod, ctor);
-        }
-        continue;
-      }
-      if (is_constructor(dmethod)) continue;
-
-      if (is_static_synthetic(dmethod)) {
-        auto field = trivial_get_field_wrapper(dmethod);
-        if (field) {
-          TRACE(SYNT, 2, "Static trivial getter: %s\n", SHOW(dmethod));
-          TRACE(SYNT, 2, "  Gets field: %s\n", SHOW(field));
-          ssms.getters.emplace(dmethod, field);
-          continue;
-        }
-        auto sfield = trivial_get_static_field_wrapper(dmethod);
-        if (sfield) {
-          TRACE(SYNT, 2, "Static trivial static field getter: %s\n",
-          SHOW(dmethod));
-          TRACE(SYNT, 2, "  Gets static field: %s\n", SHOW(sfield));
-          ssms.getters.emplace(dmethod, sfield);
-          continue;
-        }
-      }
-
-      if (can_optimize(dmethod, synthConfig)) {
-        auto method = trivial_method_wrapper(dmethod, ch);
-        if (method) {
-          // this is not strictly needed but to avoid changing visibility of
-          // virtuals we are skipping a wrapper to a virtual.
-          // Incidentally we have no single method falling in that bucket
-          // at this time
-          if (method->is_virtual()) continue;
-
-          TRACE(SYNT, 2, "Static trivial method wrapper: %s\n", SHOW(dmethod));
-          TRACE(SYNT, 2, "  Calls method: %s\n", SHOW(method));
-          ssms.wrappers.emplace(dmethod, method);
-          if (!is_static(method)) {
-            auto wrapped = ssms.wrapped.find(method);
-            if (wrapped == ssms.wrapped.end()) {
-              ssms.wrapped.emplace(method, std::make_pair(dmethod, 1));
-            } else {
-              wrapped->second.second++;
-            }
-          }
-        }
-      }
+      dmethods.push_back(dmethod);
     }
     if (debug) {
       // Static synthetics should never be virtual.
@@ -356,6 +375,44 @@ WrapperMethods analyze(const ClassHierarchy& ch,
       }
     }
   }
+
+  // Classifying a method only reads code, so it is done in parallel. The maps
+  // are then filled in scope order.
+  std::vector<WrapperKind> kinds(dmethods.size());
+  std::vector<size_t> indices(dmethods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    kinds[i] = classify(ch, dmethods[i], synthConfig);
+  });
+
+  WrapperMethods ssms;
+  for (size_t i = 0; i < dmethods.size(); ++i) {
+    auto dmethod = dmethods[i];
+    const auto& kind = kinds[i];
+    switch (kind.kind) {
+    case WrapperKind::NONE:
+      break;
+    case WrapperKind::CTOR:
+      ssms.ctors.emplace(dmethod, kind.method);
+      break;
+    case WrapperKind::GETTER:
+      ssms.getters.emplace(dmethod, kind.field);
+      break;
+    case WrapperKind::WRAPPER: {
+      auto method = kind.method;
+      ssms.wrappers.emplace(dmethod, method);
+      if (!is_static(method)) {
+        auto wrapped = ssms.wrapped.find(method);
+        if (wrapped == ssms.wrapped.end()) {
+          ssms.wrapped.emplace(method, std::make_pair(dmethod, 1));
+        } else {
+          wrapped->second.second++;
+        }
+      }
+      break;
+    }
+    }
+  }
   purge_wrapped_wrappers(ssms);
   return ssms;
 }
@@ -478,7 +535,7 @@ bool can_update_wrappee(
     return false;
   }
   DexProto* old_proto = wrappee->get_proto();
-  auto new_args = old_proto->get_args()->get_type_list();
+  auto new_args = old_proto->get_args()->to_deque();
   new_args.push_front(wrappee->get_class());
   DexProto* new_proto = DexProto::make_proto(
     old_proto->get_rtype(),
@@ -552,15 +609,32 @@ void replace_ctor_wrapper(IRCode* transform,
   transform->replace_opcode(ctor_insn, new_ctor_call);
 }
 
-void replace_wrappers(const ClassHierarchy& ch,
-                      DexMethod* caller_method,
-                      WrapperMethods& ssms) {
-  std::vector<std::tuple<IRInstruction*, IRInstruction*, DexField*>> getter_calls;
+/*
+ * The calls to getters, wrappers and constructor wrappers in a method.
+ */
+struct WrapperCalls {
+  std::vector<std::tuple<IRInstruction*, IRInstruction*, DexField*>>
+      getter_calls;
   std::vector<std::pair<IRInstruction*, DexMethod*>> wrapper_calls;
   std::vector<std::pair<IRInstruction*, DexMethod*>> wrapped_calls;
   std::vector<std::pair<IRInstruction*, DexMethod*>> ctor_calls;
+  // The wrappers that are called in a way that can't be replaced.
+  std::vector<DexMethod*> keepers;
+};
+
+/*
+ * Only reads the code of the caller and ssms, so this can run on all the
+ * methods in parallel before any of them is changed.
+ */
+WrapperCalls find_wrapper_calls(DexMethod* caller_method,
+                                const WrapperMethods& ssms) {
+  WrapperCalls calls;
+  auto& getter_calls = calls.getter_calls;
+  auto& wrapper_calls = calls.wrapper_calls;
+  auto& wrapped_calls = calls.wrapped_calls;
+  auto& ctor_calls = calls.ctor_calls;
+  auto& keepers = calls.keepers;
 
-  TRACE(SYNT, 4, "Replacing wrappers in %s\n", SHOW(caller_method));
   auto ii = InstructionIterable(caller_method->get_code());
   for (auto it = ii.begin(); it != ii.end(); ++it) {
     auto insn = it->insn;
@@ -575,7 +649,7 @@ void replace_wrappers(const ClassHierarchy& ch,
         auto next_it = std::next(it);
         auto const move_result = next_it->insn;
         if (!is_move_result(move_result->opcode())) {
-          ssms.keepers.emplace(callee);
+          keepers.push_back(callee);
           continue;
         }
         auto field = found_get->second;
@@ -594,7 +668,7 @@ void replace_wrappers(const ClassHierarchy& ch,
         "caller: %s\ncallee: %s\ninsn: %s\n",
         SHOW(caller_method), SHOW(callee), SHOW(insn));
 
-      ssms.keepers.emplace(callee);
+      keepers.push_back(callee);
     } else if (insn->opcode() == OPCODE_INVOKE_DIRECT) {
       auto const callee =
           resolve_method(insn->get_method(), MethodSearch::Direct);
@@ -605,7 +679,7 @@ void replace_wrappers(const ClassHierarchy& ch,
         auto next_it = std::next(it);
         auto const move_result = next_it->insn;
         if (!is_move_result(move_result->opcode())) {
-          ssms.keepers.emplace(callee);
+          keepers.push_back(callee);
           continue;
         }
         auto field = found_get->second;
@@ -635,6 +709,24 @@ void replace_wrappers(const ClassHierarchy& ch,
       }
     }
   }
+  return calls;
+}
+
+/*
+ * Replace the calls found by find_wrapper_calls(). The checks for naming
+ * conflicts depend on the changes made to the other methods, so this runs on
+ * one method at a time.
+ */
+void replace_wrappers(const ClassHierarchy& ch,
+                      DexMethod* caller_method,
+                      WrapperCalls& calls,
+                      WrapperMethods& ssms) {
+  auto& getter_calls = calls.getter_calls;
+  auto& wrapper_calls = calls.wrapper_calls;
+  auto& wrapped_calls = calls.wrapped_calls;
+  auto& ctor_calls = calls.ctor_calls;
+
+  TRACE(SYNT, 4, "Replacing wrappers in %s\n", SHOW(caller_method));
   // Prune out wrappers that are invalid due to naming conflicts.
   std::unordered_set<DexMethod*> bad_wrappees;
   std::unordered_multimap<DexMethod*, DexMethod*> wrappees_to_wrappers;
@@ -828,9 +920,21 @@ void do_transform(const ClassHierarchy& ch,
       methods.emplace_back(vm);
     }
   }
-  for (auto const& m : methods) {
-    if (m->get_code()) {
-      replace_wrappers(ch, m, ssms);
+  std::vector<WrapperCalls> calls(methods.size());
+  std::vector<size_t> indices(methods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    if (methods[i]->get_code()) {
+      calls[i] = find_wrapper_calls(methods[i], ssms);
+    }
+  });
+  for (const auto& method_calls : calls) {
+    ssms.keepers.insert(method_calls.keepers.begin(),
+                        method_calls.keepers.end());
+  }
+  for (size_t i = 0; i < methods.size(); ++i) {
+    if (methods[i]->get_code()) {
+      replace_wrappers(ch, methods[i], calls[i], ssms);
     }
   }
   // check that invokes to promoted static method is correct
@@ -7,6 +7,7 @@
 
 #include "TrackResources.h"
 
+#include <algorithm>
 #include <stdio.h>
 #include <string>
 #include <unordered_map>
@@ -41,7 +42,10 @@ void write_found_fields(std::string path, std::unordered_set<DexField*>& recorde
       perror("Error writing tracked fields file");
       return;
     }
-    for (const auto &it : recorded_fields) {
+    std::vector<DexField*> fields(recorded_fields.begin(),
+                                  recorded_fields.end());
+    std::sort(fields.begin(), fields.end(), dexfields_comparator());
+    for (const auto &it : fields) {
       TRACE(TRACKRESOURCES, 4, "recording %s -> %s\n",
           SHOW(it->get_class()->get_name()),
           SHOW(it->get_name()));
@@ -53,31 +57,6 @@ void write_found_fields(std::string path, std::unordered_set<DexField*>& recorde
   }
 }
 
-void check_if_tracked_sget(DexMethod* src_method,
-    DexField* target_field,
-    std::unordered_set<std::string>& src_set,
-    std::unordered_set<DexClass*>& classes_to_track,
-    size_t& num_field_references,
-    std::map<DexClass*, int, dexclasses_comparator>& per_cls_refs,
-    std::unordered_set<DexField*>& recorded_fields) {
-  auto src_cls_name = src_method->get_class()->get_name()->c_str();
-  auto target_cls = type_class(target_field->get_class());
-  if ((src_set.empty() || src_set.count(src_cls_name))
-    && classes_to_track.count(target_cls)
-    && !recorded_fields.count(target_field)) {
-    always_assert_log(target_field->is_concrete(), "Must be a concrete field");
-    if (is_primitive(target_field->get_type())) {
-      auto value = target_field->get_static_value();
-      TRACE(TRACKRESOURCES, 3, "value %d, sget to %s from %s\n", value, SHOW(target_field), SHOW(src_method));
-    } else {
-      TRACE(TRACKRESOURCES, 3, "(non-primitive) sget to %s from %s\n", SHOW(target_field), SHOW(src_method));
-    }
-    num_field_references++;
-    recorded_fields.emplace(target_field);
-    ++per_cls_refs[target_cls];
-  }
-}
-
 }
 
 void TrackResourcesPass::find_accessed_fields(Scope& fullscope,
@@ -88,10 +67,6 @@ void TrackResourcesPass::find_accessed_fields(Scope& fullscope,
   std::unordered_set<DexField*> inline_field;
   uint32_t aflags = ACC_STATIC | ACC_FINAL;
 
-  // data structures to track field references from given classes
-  size_t num_field_references = 0;
-  std::map<DexClass*, int, dexclasses_comparator> per_cls_refs;
-
   for (auto clazz : classes_to_track) {
     auto sfields = clazz->get_sfields();
     for (auto sfield : sfields) {
@@ -99,24 +74,55 @@ void TrackResourcesPass::find_accessed_fields(Scope& fullscope,
       inline_field.emplace(sfield);
     }
   }
-  walk::opcodes(
+
+  // Each worker collects the tracked fields that its methods read, and the
+  // sets are merged at the end.
+  using FieldSet = std::unordered_set<DexField*>;
+  auto accessed_fields = walk::parallel::accumulate_methods<FieldSet>(
       fullscope,
-      [](DexMethod* method) { return true; },
-      [&](DexMethod* method, IRInstruction* insn) {
-        if (insn->has_field() && is_sfield_op(insn->opcode())) {
+      [&](DexMethod* method) {
+        FieldSet fields;
+        auto code = method->get_code();
+        if (code == nullptr) return fields;
+        auto src_cls_name = method->get_class()->get_name()->c_str();
+        if (!classes_to_search.empty() &&
+            !classes_to_search.count(src_cls_name)) {
+          return fields;
+        }
+        for (const auto& mie : InstructionIterable(code)) {
+          auto insn = mie.insn;
+          if (!insn->has_field() || !is_sfield_op(insn->opcode())) continue;
           auto field = resolve_field(insn->get_field(), FieldSearch::Static);
-          if (field == nullptr || !field->is_concrete()) return;
-          if (inline_field.count(field) == 0) return;
-          check_if_tracked_sget(
-            method,
-            field,
-            classes_to_search,
-            classes_to_track,
-            num_field_references,
-            per_cls_refs,
-            recorded_fields);
+          if (field == nullptr || !field->is_concrete()) continue;
+          if (inline_field.count(field) == 0) continue;
+          if (!classes_to_track.count(type_class(field->get_class()))) continue;
+          if (is_primitive(field->get_type())) {
+            TRACE(TRACKRESOURCES, 3, "value %d, sget to %s from %s\n",
+                  field->get_static_value(), SHOW(field), SHOW(method));
+          } else {
+            TRACE(TRACKRESOURCES, 3, "(non-primitive) sget to %s from %s\n",
+                  SHOW(field), SHOW(method));
+          }
+          fields.emplace(field);
+        }
+        return fields;
+      },
+      [](FieldSet& acc, FieldSet&& fields) {
+        if (acc.size() < fields.size()) {
+          std::swap(acc, fields);
         }
+        acc.insert(fields.begin(), fields.end());
       });
+
+  // data structures to track field references from given classes
+  size_t num_field_references = 0;
+  std::map<DexClass*, int, dexclasses_comparator> per_cls_refs;
+  for (auto field : accessed_fields) {
+    if (recorded_fields.emplace(field).second) {
+      num_field_references++;
+      ++per_cls_refs[type_class(field->get_class())];
+    }
+  }
   TRACE(TRACKRESOURCES, 1,
       "found %d total sgets to tracked classes\n", num_field_references);
   for (auto& it : per_cls_refs) {
@@ -9,6 +9,7 @@
 
 #include <algorithm>
 #include <climits>
+#include <mutex>
 
 #include "ConfigFiles.h"
 
@@ -231,6 +232,10 @@ void write_shape_graph(
     const std::unordered_map<Shape, size_t>& num_mergeables) {
   TRACE(TERA, 5, "[approx] printing dot graph to: %s.\n",
         graph_file_name.c_str());
+  // The shapes of several mergers may be approximated at once, and they all
+  // append to the same file; keep each graph in one piece.
+  static std::mutex graph_file_mutex;
+  std::lock_guard<std::mutex> lock(graph_file_mutex);
   std::ofstream os(graph_file_name, std::ios::app);
   if (!os.is_open()) {
     TRACE(TERA, 5, "         Cannot open file.\n");
@@ -64,6 +64,35 @@ void update_call_refs(
   }
 }
 
+/*
+ * Points the call sites in `code` of the deduplicated methods to their final
+ * replacement, and makes the calls to the staticized methods static.
+ */
+void update_dedupped_call_refs(
+    IRCode& code,
+    const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee,
+    const std::unordered_set<DexMethod*>& staticized) {
+  for (const auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    if (!insn->has_method()) {
+      continue;
+    }
+    auto callee = resolve_method(insn->get_method(), opcode_to_search(insn));
+    if (callee != nullptr && old_to_new_callee.count(callee)) {
+      // A replacement can be deduplicated again in a later round.
+      do {
+        callee = old_to_new_callee.at(callee);
+      } while (old_to_new_callee.count(callee));
+      TRACE(TERA, 9, " Updated call %s to %s\n", SHOW(insn), SHOW(callee));
+      insn->set_method(callee);
+    }
+    callee = resolve_method(insn->get_method(), MethodSearch::Any);
+    if (staticized.count(callee) > 0) {
+      insn->set_opcode(OPCODE_INVOKE_STATIC);
+    }
+  }
+}
+
 void replace_method_args_head(DexMethod* meth, DexType* new_head) {
   DexMethodSpec spec;
   auto args = meth->get_proto()->get_args();
@@ -585,6 +614,14 @@ void MethodMerger::merge_ctors() {
 }
 
 void MethodMerger::merge_non_ctor_non_virt_methods() {
+  // The call sites of the deduplicated and staticized methods of all the
+  // mergers are updated in a single sweep over the scope once all the mergers
+  // are done. The methods of a merger may call those of the mergers before
+  // it, so they are updated first to get the same groups of identical methods
+  // as with a sweep per merger.
+  std::unordered_map<DexMethod*, DexMethod*> old_to_new_callee;
+  std::unordered_set<DexMethod*> staticized;
+  std::vector<DexMethod*> to_remove;
   for (auto merger : m_mergers) {
     auto merger_type = const_cast<DexType*>(merger->type);
     std::vector<DexMethod*> to_dedup;
@@ -593,6 +630,14 @@ void MethodMerger::merge_non_ctor_non_virt_methods() {
     to_dedup.insert(to_dedup.end(), non_ctors.begin(), non_ctors.end());
     auto non_vmethods = m_merger_non_vmethods.at(merger);
     to_dedup.insert(to_dedup.end(), non_vmethods.begin(), non_vmethods.end());
+    if (!old_to_new_callee.empty() || !staticized.empty()) {
+      for (auto m : to_dedup) {
+        auto code = m->get_code();
+        if (code != nullptr) {
+          update_dedupped_call_refs(*code, old_to_new_callee, staticized);
+        }
+      }
+    }
 
     // Lift constants
     if (m_process_method_meta) {
@@ -618,7 +663,8 @@ void MethodMerger::merge_non_ctor_non_virt_methods() {
         boost::optional<std::unordered_map<DexMethod*, MethodOrderedSet>>(
             new_to_old);
     m_num_static_non_virt_dedupped += method_dedup::dedup_methods(
-        m_scope, to_dedup, replacements, new_to_old_optional);
+        m_scope, to_dedup, replacements, new_to_old_optional,
+        &old_to_new_callee);
 
     // Relocate the remainders.
     std::set<DexMethod*, dexmethods_comparator> to_relocate(
@@ -645,7 +691,7 @@ void MethodMerger::merge_non_ctor_non_virt_methods() {
         m_static_methods.emplace(m);
       }
     }
-    update_to_static(to_relocate);
+    update_to_static(to_relocate, &staticized);
 
     // Update method dedup map
     for (auto& pair : new_to_old) {
@@ -667,20 +713,29 @@ void MethodMerger::merge_non_ctor_non_virt_methods() {
       }
     }
 
-    // Clean up remainders
+    // Clean up remainders, once the call sites no longer need to resolve
+    // them.
     TRACE(TERA,
           8,
           "dedup: clean up static|non_virt remainders %d\n",
           to_cleanup.size());
     for (auto m : to_cleanup) {
-      auto owner = m->get_class();
-      if (m_mergeable_to_merger_ctor.count(owner) > 0) {
-        auto cls = type_class(owner);
-        TRACE(TERA, 9, "dedup: removing %s\n", SHOW(m));
-        cls->remove_method(m);
+      if (m_mergeable_to_merger_ctor.count(m->get_class()) > 0) {
+        to_remove.push_back(m);
       }
     }
   }
+
+  if (!old_to_new_callee.empty() || !staticized.empty()) {
+    walk::parallel::code(m_scope, [&](DexMethod*, IRCode& code) {
+      update_dedupped_call_refs(code, old_to_new_callee, staticized);
+    });
+  }
+  for (auto m : to_remove) {
+    auto cls = type_class(m->get_class());
+    TRACE(TERA, 9, "dedup: removing %s\n", SHOW(m));
+    cls->remove_method(m);
+  }
 }
 
 void MethodMerger::merge_virt_itf_methods() {
@@ -722,35 +777,18 @@ void MethodMerger::merge_virt_itf_methods() {
 }
 
 void MethodMerger::update_to_static(
-    const std::set<DexMethod*, dexmethods_comparator>& methods) {
+    const std::set<DexMethod*, dexmethods_comparator>& methods,
+    std::unordered_set<DexMethod*>* staticized) {
 
   if (!m_devirtualize_enabled) {
     return;
   }
 
-  std::unordered_set<DexMethod*> staticized;
   for (DexMethod* method : methods) {
     if (!is_static(method)) {
       mutators::make_static(method, mutators::KeepThis::Yes);
-      staticized.emplace(method);
+      staticized->emplace(method);
       m_static_methods.emplace(method);
     }
   }
-
-  const std::unordered_set<DexMethod*>& const_staticized = staticized;
-  walk::parallel::code(
-      m_scope, [&const_staticized](DexMethod* method, IRCode& code) {
-        for (const auto& mie : InstructionIterable(code)) {
-          auto insn = mie.insn;
-          if (!insn->has_method()) {
-            continue;
-          }
-
-          DexMethod* current_method =
-              resolve_method(insn->get_method(), MethodSearch::Any);
-          if (const_staticized.count(current_method) > 0) {
-            insn->set_opcode(OPCODE_INVOKE_STATIC);
-          }
-        }
-      });
 }
@@ -157,8 +157,11 @@ class MethodMerger {
 
   DexType* get_merger_type(DexType* mergeable);
 
+  // Makes the methods static, and adds them to `staticized`. Their call sites
+  // are left for the caller to update.
   void update_to_static(
-      const std::set<DexMethod*, dexmethods_comparator>& methods);
+      const std::set<DexMethod*, dexmethods_comparator>& methods,
+      std::unordered_set<DexMethod*>* staticized);
 
   bool no_type_tags();
 
@@ -7,6 +7,7 @@
 
 #include "Model.h"
 
+#include <numeric>
 #include <set>
 #include <sstream>
 
@@ -19,6 +20,7 @@
 #include "DexStoreUtil.h"
 #include "DexUtil.h"
 #include "IRCode.h"
+#include "Parallel.h"
 #include "Resolver.h"
 #include "Walkers.h"
 
@@ -229,13 +231,12 @@ void exclude_reference_to_android_sdk(const Json::Value& json_val,
     return current_excluded;
   };
   auto excluded_by_android_sdk_ref =
-      walk::parallel::reduce_methods<std::unordered_set<const DexType*>>(
+      walk::parallel::accumulate_methods<std::unordered_set<const DexType*>>(
           mergeable_classes,
           scanner,
-          [](std::unordered_set<const DexType*> left,
-             const std::unordered_set<const DexType*> right) {
+          [](std::unordered_set<const DexType*>& left,
+             std::unordered_set<const DexType*>&& right) {
             left.insert(right.begin(), right.end());
-            return left;
           });
   for (const auto excluded : excluded_by_android_sdk_ref) {
     non_mergeables.insert(excluded);
@@ -599,10 +600,9 @@ void Model::find_non_mergeables(const Scope& scope, const TypeSet& generated) {
     return current_non_mergeables;
   };
 
-  TypeSet non_mergeables_opcode = walk::parallel::reduce_methods<TypeSet>(
-      scope, patcher, [](TypeSet left, const TypeSet right) {
+  TypeSet non_mergeables_opcode = walk::parallel::accumulate_methods<TypeSet>(
+      scope, patcher, [](TypeSet& left, TypeSet&& right) {
         left.insert(right.begin(), right.end());
-        return left;
       });
 
   m_non_mergeables.insert(non_mergeables_opcode.begin(),
@@ -675,17 +675,36 @@ void Model::shape_model() {
     mergers.emplace_back(&m_mergers[type]);
   }
 
-  for (auto merger : mergers) {
-    TRACE(TERA, 6, "Build shapes from %s\n", SHOW(merger->type));
+  // Shaping a merger only reads the model, so the shapes of all the mergers
+  // are built concurrently. Creating the new mergers from them changes the
+  // model and is left to a single thread, in the sorted merger order.
+  struct MergerShapes {
     MergerType::ShapeCollector shapes;
-    shape_merger(*merger, shapes);
-    approximate_shapes(shapes);
-    m_metric.dropped += trim_shapes(shapes, m_spec.min_count);
-    for (auto& shape_it : shapes) {
+    ApproximateStats approx_stats;
+    size_t dropped{0};
+  };
+  std::vector<MergerShapes> merger_shapes(mergers.size());
+  std::vector<size_t> indices(mergers.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    auto merger = mergers[i];
+    auto& result = merger_shapes[i];
+    TRACE(TERA, 6, "Build shapes from %s\n", SHOW(merger->type));
+    shape_merger(*merger, result.shapes);
+    approximate_shapes(result.shapes, result.approx_stats);
+    result.dropped = trim_shapes(result.shapes, m_spec.min_count);
+    for (auto& shape_it : result.shapes) {
       break_by_interface(*merger, shape_it.first, shape_it.second);
     }
+  });
 
-    flatten_shapes(*merger, shapes);
+  for (size_t i = 0; i < mergers.size(); ++i) {
+    auto& result = merger_shapes[i];
+    m_approx_stats.shapes_merged += result.approx_stats.shapes_merged;
+    m_approx_stats.mergeables += result.approx_stats.mergeables;
+    m_approx_stats.fields_added += result.approx_stats.fields_added;
+    m_metric.dropped += result.dropped;
+    flatten_shapes(*mergers[i], result.shapes);
   }
 }
 
@@ -755,7 +774,8 @@ void Model::shape_merger(const MergerType& merger,
  * Depending the spec, choosing a approximation algorithm to merge different
  * shapes together. By default, no approximation is done.
  */
-void Model::approximate_shapes(MergerType::ShapeCollector& shapes) {
+void Model::approximate_shapes(MergerType::ShapeCollector& shapes,
+                               ApproximateStats& stats) {
   if (m_spec.approximate_shape_merging.isNull()) {
     TRACE(TERA, 3, "[approx] No approximate shape merging specified.\n");
     return;
@@ -787,11 +807,11 @@ void Model::approximate_shapes(MergerType::ShapeCollector& shapes) {
 
   // Select an approximation algorithm
   if (algo_name == "simple_greedy") {
-    simple_greedy_approximation(approx_spec, shapes, m_approx_stats);
+    simple_greedy_approximation(approx_spec, shapes, stats);
   } else if (algo_name == "max_mergeable_greedy") {
-    max_mergeable_greedy(approx_spec, s_outdir, shapes, m_approx_stats);
+    max_mergeable_greedy(approx_spec, s_outdir, shapes, stats);
   } else if (algo_name == "max_shape_merged_greedy") {
-    max_shape_merged_greedy(approx_spec, s_outdir, shapes, m_approx_stats);
+    max_shape_merged_greedy(approx_spec, s_outdir, shapes, stats);
   } else {
     TRACE(TERA, 3,
           "[approx] Invalid approximate shape merging spec, skipping...\n");
@@ -855,39 +875,55 @@ DexType* check_current_instance(const TypeSet& types, IRInstruction* insn) {
   return type;
 }
 
-std::unordered_map<DexType*, std::unordered_set<DexType*>> get_type_usages(
-    const TypeSet& types, const Scope& scope) {
-  std::unordered_map<DexType*, std::unordered_set<DexType*>> res;
+using TypeUsages = std::unordered_map<DexType*, std::unordered_set<DexType*>>;
 
-  walk::opcodes(
-      scope, [](DexMethod*) { return true; },
-      [&](DexMethod* method, IRInstruction* insn) {
-        auto current_instance = check_current_instance(types, insn);
-        if (current_instance) {
-          res[current_instance].emplace(method->get_class());
+TypeUsages get_type_usages(const TypeSet& types, const Scope& scope) {
+  return walk::parallel::accumulate_methods<TypeUsages>(
+      scope,
+      [&](DexMethod* method) {
+        TypeUsages res;
+        auto code = method->get_code();
+        if (code == nullptr) {
+          return res;
         }
-
-        if (insn->has_method()) {
-          auto callee =
-              resolve_method(insn->get_method(), opcode_to_search(insn));
-          if (!callee) {
-            return;
-          }
-          auto proto = callee->get_proto();
-          auto rtype = proto->get_rtype();
-          if (rtype && types.count(rtype)) {
-            res[rtype].emplace(method->get_class());
+        for (const auto& mie : InstructionIterable(code)) {
+          auto insn = mie.insn;
+          auto current_instance = check_current_instance(types, insn);
+          if (current_instance) {
+            res[current_instance].emplace(method->get_class());
           }
 
-          for (const auto& type : proto->get_args()->get_type_list()) {
-            if (type && types.count(type)) {
-              res[type].emplace(method->get_class());
+          if (insn->has_method()) {
+            auto callee =
+                resolve_method(insn->get_method(), opcode_to_search(insn));
+            if (!callee) {
+              continue;
+            }
+            auto proto = callee->get_proto();
+            auto rtype = proto->get_rtype();
+            if (rtype && types.count(rtype)) {
+              res[rtype].emplace(method->get_class());
+            }
+
+            for (const auto& type : proto->get_args()->get_type_list()) {
+              if (type && types.count(type)) {
+                res[type].emplace(method->get_class());
+              }
             }
           }
         }
+        return res;
+      },
+      [](TypeUsages& left, TypeUsages&& right) {
+        for (auto& pair : right) {
+          auto& usages = left[pair.first];
+          if (usages.empty()) {
+            usages = std::move(pair.second);
+          } else {
+            usages.insert(pair.second.begin(), pair.second.end());
+          }
+        }
       });
-
-  return res;
 }
 
 size_t get_interdex_group(
@@ -1048,10 +1084,17 @@ void Model::map_fields(MergerType& merger, const TypeSet& classes) {
  * belong to the mergeable types.
  */
 void Model::collect_methods() {
-  // collect all vmethods and dmethods of mergeable types into the merger
+  // collect all vmethods and dmethods of mergeable types into the merger.
+  // Each merger only gets its own mergeables' methods, so they are collected
+  // concurrently.
+  std::vector<MergerType*> mergers;
   for (auto& merger_it : m_mergers) {
-    auto& merger = merger_it.second;
-    if (merger.mergeables.empty()) continue;
+    if (!merger_it.second.mergeables.empty()) {
+      mergers.push_back(&merger_it.second);
+    }
+  }
+  parallel_for(mergers.begin(), mergers.end(), [&](MergerType* merger_ptr) {
+    auto& merger = *merger_ptr;
     TRACE(TERA,
           8,
           "Collect methods for merger %s [%ld]\n",
@@ -1104,7 +1147,7 @@ void Model::collect_methods() {
         add_virtual_scope(merger, *virt_scope);
       }
     }
-  }
+  });
 
   // now for the virtual methods up the hierarchy and those in the type
   // of the merger (if an existing type) distribute them across the
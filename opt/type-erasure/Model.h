@@ -356,7 +356,8 @@ class Model {
   // make shapes out of the model classes
   void shape_model();
   void shape_merger(const MergerType& root, MergerType::ShapeCollector& shapes);
-  void approximate_shapes(MergerType::ShapeCollector& shapes);
+  void approximate_shapes(MergerType::ShapeCollector& shapes,
+                          ApproximateStats& stats);
   void break_by_interface(const MergerType& merger,
                           const MergerType::Shape& shape,
                           MergerType::ShapeHierarchy& hier);
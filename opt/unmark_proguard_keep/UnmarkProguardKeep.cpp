@@ -7,11 +7,13 @@
 
 #include <string.h>
 
+#include "AnalysisManager.h"
 #include "TypeSystem.h"
 #include "UnmarkProguardKeep.h"
 #include "Walkers.h"
 
 void unmark_keep(const Scope& scope,
+                 AnalysisManager& analyses,
                  const std::vector<std::string>& package_list,
                  const std::vector<std::string>& supercls_list) {
   if (package_list.size() == 0 && supercls_list.size() == 0) {
@@ -30,7 +32,7 @@ void unmark_keep(const Scope& scope,
       }
     }
   }
-  TypeSystem ts(scope);
+  const auto& ts = analyses.type_system(scope);
   // Unmark proguard keep rule for interface implementors like
   // "-keep class * extend xxx".
   for (const DexType* intf_type : interface_list) {
@@ -76,7 +78,7 @@ void UnmarkProguardKeepPass::run_pass(DexStoresVector& stores,
                                       ConfigFiles& cfg,
                                       PassManager& mgr) {
   auto scope = build_class_scope(stores);
-  unmark_keep(scope, m_package_list, m_supercls_list);
+  unmark_keep(scope, mgr.analyses(), m_package_list, m_supercls_list);
 }
 
 static UnmarkProguardKeepPass s_pass;
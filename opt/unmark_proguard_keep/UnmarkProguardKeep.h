@@ -30,6 +30,9 @@ class UnmarkProguardKeepPass : Pass {
 
   virtual void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
+  // Only the keep flags of classes change.
+  analysis::Set preserved_analyses() const override { return analysis::ALL; }
+
  private:
   std::vector<std::string> m_supercls_list;
   std::vector<std::string> m_package_list;
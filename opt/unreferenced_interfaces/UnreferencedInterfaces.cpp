@@ -32,7 +32,7 @@ void update_scope(const TypeSet& removable, Scope& scope) {
 }
 
 void get_super_interfaces(TypeSet& interfaces, DexClass* intf) {
-  const auto super_intfs = intf->get_interfaces()->get_type_list();
+  const auto& super_intfs = intf->get_interfaces()->get_type_list();
   for (const auto super : super_intfs) {
     interfaces.insert(super);
     auto super_intf = type_class(super);
@@ -43,7 +43,7 @@ void get_super_interfaces(TypeSet& interfaces, DexClass* intf) {
 }
 
 void get_interfaces(TypeSet& interfaces, DexClass* cls) {
-  const auto intfs = cls->get_interfaces()->get_type_list();
+  const auto& intfs = cls->get_interfaces()->get_type_list();
   for (const auto& intf : intfs) {
     interfaces.insert(intf);
     const auto intf_cls = type_class(intf);
@@ -8,8 +8,8 @@
 #include "ConstantEnvironment.h"
 
 int64_t SignedConstantDomain::max_element() const {
-  if (constant_domain().is_value()) {
-    return *constant_domain().get_constant();
+  if (auto cst = get_constant()) {
+    return *cst;
   }
   switch (interval()) {
   case sign_domain::Interval::EMPTY:
@@ -29,8 +29,8 @@ int64_t SignedConstantDomain::max_element() const {
 }
 
 int64_t SignedConstantDomain::min_element() const {
-  if (constant_domain().is_value()) {
-    return *constant_domain().get_constant();
+  if (auto cst = get_constant()) {
+    return *cst;
   }
   switch (interval()) {
   case sign_domain::Interval::EMPTY:
@@ -516,6 +516,96 @@ ReturnState collect_return_state(
 
 namespace intraprocedural {
 
+void FixpointIterator::run(const ConstantEnvironment& init) {
+  MonotonicFixpointIterator::run(init);
+  if (m_lean) {
+    drop_states();
+  }
+}
+
+bool FixpointIterator::is_entry_state_dropped(cfg::Block* block) const {
+  return m_lean && block != m_graph.entry_block() && block->preds().size() == 1;
+}
+
+void FixpointIterator::drop_states() {
+  // The exit state of a loop head is computed from its entry state before the
+  // last iteration, so it can't be recomputed from the final one.
+  m_loop_heads.clear();
+  std::function<void(const sparta::WtoComponent<cfg::Block*>&)> find_heads =
+      [&](const sparta::WtoComponent<cfg::Block*>& component) {
+        if (component.is_scc()) {
+          m_loop_heads.emplace(component.head_node());
+          for (const auto& subcomponent : component) {
+            find_heads(subcomponent);
+          }
+        }
+      };
+  for (const auto& component : m_wto) {
+    find_heads(component);
+  }
+  for (auto it = m_entry_states.begin(); it != m_entry_states.end();) {
+    if (is_entry_state_dropped(it->first)) {
+      it = m_entry_states.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto it = m_exit_states.begin(); it != m_exit_states.end();) {
+    if (m_loop_heads.count(it->first) == 0) {
+      it = m_exit_states.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+ConstantEnvironment FixpointIterator::get_entry_state_at(
+    cfg::Block* block) const {
+  if (!is_entry_state_dropped(block)) {
+    return MonotonicFixpointIterator::get_entry_state_at(block);
+  }
+  // Walk up the single predecessors to a block whose state was kept, then
+  // replay the blocks in between.
+  std::vector<cfg::Edge*> edges;
+  std::unordered_set<cfg::Block*> visited;
+  ConstantEnvironment env;
+  for (auto* b = block;; b = edges.back()->src()) {
+    if (!visited.emplace(b).second) {
+      // A cycle of blocks with a single predecessor each can't be reached
+      // from the entry block.
+      return ConstantEnvironment::bottom();
+    }
+    edges.push_back(b->preds().front());
+    auto* src = edges.back()->src();
+    if (m_loop_heads.count(src) != 0) {
+      env = MonotonicFixpointIterator::get_exit_state_at(src);
+      break;
+    }
+    if (!is_entry_state_dropped(src)) {
+      env = MonotonicFixpointIterator::get_entry_state_at(src);
+      analyze_node(src, &env);
+      break;
+    }
+  }
+  for (auto it = edges.rbegin(); it != edges.rend(); ++it) {
+    env = analyze_edge(*it, env);
+    if (*it != edges.front()) {
+      analyze_node((*it)->target(), &env);
+    }
+  }
+  return env;
+}
+
+ConstantEnvironment FixpointIterator::get_exit_state_at(
+    cfg::Block* block) const {
+  if (!m_lean || m_loop_heads.count(block) != 0) {
+    return MonotonicFixpointIterator::get_exit_state_at(block);
+  }
+  auto env = get_entry_state_at(block);
+  analyze_node(block, &env);
+  return env;
+}
+
 void FixpointIterator::analyze_instruction(const IRInstruction* insn,
                                            ConstantEnvironment* env) const {
   TRACE(CONSTP, 5, "Analyzing instruction: %s\n", SHOW(insn));
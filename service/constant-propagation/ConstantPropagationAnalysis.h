@@ -7,6 +7,9 @@
 
 #pragma once
 
+#include <limits>
+#include <unordered_set>
+
 #include "ConstantEnvironment.h"
 #include "IRCode.h"
 #include "InstructionAnalyzer.h"
@@ -24,10 +27,29 @@ class FixpointIterator final
    * The fixpoint iterator takes an optional WholeProgramState argument that
    * it will use to determine the static field values and method return values.
    */
+  //
+  // CFGs with at least :lean_block_threshold blocks are analyzed in lean
+  // mode: once run() is done, only the entry states of the entry block and of
+  // the blocks that don't have exactly one predecessor, and the exit states of
+  // the loop heads, are kept. The other states are recomputed from them when
+  // they are asked for, and are the same as they would have been if they had
+  // been kept. This trades time for memory on huge methods, like switch
+  // dispatchers, where most blocks have a single predecessor.
   explicit FixpointIterator(
       const cfg::ControlFlowGraph& cfg,
-      InstructionAnalyzer<ConstantEnvironment> insn_analyzer)
-      : MonotonicFixpointIterator(cfg), m_insn_analyzer(insn_analyzer) {}
+      InstructionAnalyzer<ConstantEnvironment> insn_analyzer,
+      size_t lean_block_threshold = std::numeric_limits<size_t>::max())
+      : MonotonicFixpointIterator(cfg),
+        m_insn_analyzer(insn_analyzer),
+        m_lean(cfg.blocks().size() >= lean_block_threshold) {}
+
+  void run(const ConstantEnvironment& init);
+
+  ConstantEnvironment get_entry_state_at(cfg::Block* block) const;
+
+  ConstantEnvironment get_exit_state_at(cfg::Block* block) const;
+
+  bool is_lean() const { return m_lean; }
 
   ConstantEnvironment analyze_edge(
       const EdgeId&,
@@ -40,7 +62,13 @@ class FixpointIterator final
                     ConstantEnvironment* state_at_entry) const override;
 
  private:
+  bool is_entry_state_dropped(cfg::Block* block) const;
+
+  void drop_states();
+
   InstructionAnalyzer<ConstantEnvironment> m_insn_analyzer;
+  bool m_lean;
+  std::unordered_set<cfg::Block*> m_loop_heads;
 };
 
 } // namespace intraprocedural
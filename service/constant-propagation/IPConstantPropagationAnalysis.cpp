@@ -7,10 +7,59 @@
 
 #include "IPConstantPropagationAnalysis.h"
 
+#include "Parallel.h"
+
 namespace constant_propagation {
 
 namespace interprocedural {
 
+namespace {
+
+using Component = std::vector<DexMethod*>;
+
+/*
+ * Groups the strongly connected components of the part of the call graph that
+ * is reachable from its entry into waves, so that every caller of a method is
+ * either in the same component or in an earlier wave.
+ */
+std::vector<std::vector<Component>> waves(const call_graph::Graph& cg) {
+  std::unordered_map<DexMethod*, call_graph::SccNodeId> ids;
+  std::vector<DexMethod*> methods;
+  auto* entry = call_graph::GraphInterface::entry(cg);
+  ids.emplace(entry, 0);
+  methods.push_back(entry);
+  for (size_t node = 0; node < methods.size(); ++node) {
+    for (const auto& edge : cg.node(methods[node]).callees()) {
+      if (ids.emplace(edge->callee(), methods.size()).second) {
+        methods.push_back(edge->callee());
+      }
+    }
+  }
+  // Callers that are not reachable from the entry are left out.
+  std::vector<std::vector<call_graph::SccNodeId>> callers(methods.size());
+  for (size_t node = 0; node < methods.size(); ++node) {
+    for (const auto& edge : cg.node(methods[node]).callers()) {
+      auto it = ids.find(edge->caller());
+      if (it != ids.end()) {
+        callers[node].push_back(it->second);
+      }
+    }
+  }
+  std::vector<std::vector<Component>> result;
+  for (auto& wave : call_graph::scc_waves(callers)) {
+    result.emplace_back();
+    for (const auto& component : wave) {
+      result.back().emplace_back();
+      for (auto node : component) {
+        result.back().back().push_back(methods[node]);
+      }
+    }
+  }
+  return result;
+}
+
+} // namespace
+
 /*
  * Return an environment populated with parameter values.
  */
@@ -69,6 +118,78 @@ Domain FixpointIterator::analyze_edge(
   return entry_state_at_dest;
 }
 
+void FixpointIterator::run_in_waves(const Domain& init) {
+  auto all_waves = waves(m_call_graph);
+  // Create every slot up front, so that the maps are not rehashed while the
+  // components of a wave are analyzed concurrently.
+  m_wave_entry_states.clear();
+  m_wave_exit_states.clear();
+  for (const auto& wave : all_waves) {
+    for (const auto& component : wave) {
+      for (auto* method : component) {
+        m_wave_entry_states.emplace(method, Domain::bottom());
+        m_wave_exit_states.emplace(method, Domain::bottom());
+      }
+    }
+  }
+  m_ran_in_waves = true;
+  for (const auto& wave : all_waves) {
+    parallel_for(wave.begin(),
+                 wave.end(),
+                 [&](const Component& component) {
+                   analyze_wave_component(component, init);
+                 },
+                 /* grain */ 1);
+  }
+}
+
+Domain FixpointIterator::compute_wave_entry_state(DexMethod* method,
+                                                  const Domain& init) const {
+  Domain entry_state = Domain::bottom();
+  if (method == call_graph::GraphInterface::entry(m_call_graph)) {
+    entry_state.join_with(init);
+  }
+  for (const auto& edge : m_call_graph.node(method).callers()) {
+    // Callers that are not reachable from the entry have no slot, and their
+    // exit state is _|_, just like in run().
+    auto it = m_wave_exit_states.find(edge->caller());
+    entry_state.join_with(analyze_edge(
+        edge, it == m_wave_exit_states.end() ? Domain::bottom() : it->second));
+  }
+  return entry_state;
+}
+
+void FixpointIterator::analyze_wave_component(const Component& component,
+                                              const Domain& init) {
+  // Callers outside of the component are all done by now, so only the members
+  // of the component itself may need to be analyzed more than once. As in
+  // MonotonicFixpointIterator::extrapolate(), the first update of an entry
+  // state is a join and all the later ones are widenings.
+  for (size_t iteration = 0;; ++iteration) {
+    bool changed = false;
+    for (auto* method : component) {
+      auto new_state = compute_wave_entry_state(method, init);
+      auto& entry_state = m_wave_entry_states.at(method);
+      if (iteration == 0) {
+        entry_state = std::move(new_state);
+      } else if (new_state.leq(entry_state)) {
+        continue;
+      } else if (iteration == 1) {
+        entry_state.join_with(new_state);
+      } else {
+        entry_state.widen_with(new_state);
+      }
+      changed = true;
+      auto& exit_state = m_wave_exit_states.at(method);
+      exit_state = entry_state;
+      analyze_node(method, &exit_state);
+    }
+    if (!changed) {
+      break;
+    }
+  }
+}
+
 std::unique_ptr<intraprocedural::FixpointIterator>
 FixpointIterator::get_intraprocedural_analysis(const DexMethod* method) const {
   auto args = this->get_entry_state_at(const_cast<DexMethod*>(method));
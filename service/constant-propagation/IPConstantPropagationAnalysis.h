@@ -71,12 +71,36 @@ class FixpointIterator
   FixpointIterator(const call_graph::Graph& call_graph,
                    const ProcedureAnalysisFactory& proc_analysis_factory)
       : MonotonicFixpointIterator(call_graph),
+        m_call_graph(call_graph),
         m_proc_analysis_factory(proc_analysis_factory) {
     auto wps = new WholeProgramState();
     wps->set_to_top();
     m_wps.reset(wps);
   }
 
+  void run(const Domain& init) {
+    m_ran_in_waves = false;
+    MonotonicFixpointIterator::run(init);
+  }
+
+  /*
+   * Computes the same kind of fixpoint as run(), but analyzes independent
+   * methods in parallel. The call graph is split into strongly connected
+   * components, and each component is placed in the wave right after the last
+   * wave of its callers. All the components of a wave are analyzed
+   * concurrently, each one iterated to its own fixpoint, and a wave only
+   * starts once the previous one is done.
+   */
+  void run_in_waves(const Domain& init);
+
+  Domain get_entry_state_at(DexMethod* const& method) const {
+    if (!m_ran_in_waves) {
+      return MonotonicFixpointIterator::get_entry_state_at(method);
+    }
+    auto it = m_wave_entry_states.find(method);
+    return (it == m_wave_entry_states.end()) ? Domain::bottom() : it->second;
+  }
+
   void analyze_node(DexMethod* const& method,
                     Domain* current_state) const override;
 
@@ -93,8 +117,18 @@ class FixpointIterator
   }
 
  private:
+  Domain compute_wave_entry_state(DexMethod* method, const Domain& init) const;
+
+  void analyze_wave_component(const std::vector<DexMethod*>& component,
+                              const Domain& init);
+
+  const call_graph::Graph& m_call_graph;
   std::unique_ptr<const WholeProgramState> m_wps;
   ProcedureAnalysisFactory m_proc_analysis_factory;
+  // The invariants computed by run_in_waves().
+  bool m_ran_in_waves{false};
+  std::unordered_map<const DexMethod*, Domain> m_wave_entry_states;
+  std::unordered_map<const DexMethod*, Domain> m_wave_exit_states;
 };
 
 } // namespace interprocedural
@@ -7,59 +7,120 @@
 
 #pragma once
 
+#include <ostream>
+
 #include "ConstantAbstractDomain.h"
+#include "Debug.h"
 #include "SignDomain.h"
 
 using ConstantDomain = sparta::ConstantAbstractDomain<int64_t>;
 
-class SignedConstantDomain
-    : public sparta::ReducedProductAbstractDomain<SignedConstantDomain,
-                                                  sign_domain::Domain,
-                                                  ConstantDomain> {
+/*
+ * The product of a sign_domain::Domain and a ConstantDomain, with the same
+ * semantics as a sparta::ReducedProductAbstractDomain of the two: the
+ * components are combined independently, the product is bottom as soon as a
+ * meet or narrowing makes either of them bottom, and the reduction only
+ * happens on construction.
+ *
+ * Registers hold one of these almost everywhere in constant propagation, so
+ * instead of a tuple of two full abstract domains, it only holds the interval
+ * as a bit set of the signs it contains, the kind of the constant, and the
+ * constant itself.
+ */
+class SignedConstantDomain final
+    : public sparta::AbstractDomain<SignedConstantDomain> {
  public:
-  using ReducedProductAbstractDomain::ReducedProductAbstractDomain;
-
-  // Some older compilers complain that the class is not default constructible.
-  // We intended to use the default constructors of the base class (via the
-  // `using` declaration above), but some compilers fail to catch this. So we
-  // insert a redundant '= default'.
   SignedConstantDomain() = default;
 
   explicit SignedConstantDomain(int64_t v)
-      : SignedConstantDomain(
-            std::make_tuple(sign_domain::Domain::top(), ConstantDomain(v))) {}
+      : m_constant(v),
+        m_signs(to_signs(sign_domain::from_int(v).element())),
+        m_constant_kind(sparta::AbstractValueKind::Value) {}
 
   explicit SignedConstantDomain(sign_domain::Interval interval)
-      : SignedConstantDomain(std::make_tuple(sign_domain::Domain(interval),
-                                             ConstantDomain::top())) {}
-
-  static void reduce_product(
-      std::tuple<sign_domain::Domain, ConstantDomain>& domains) {
-    auto& sdom = std::get<0>(domains);
-    auto& cdom = std::get<1>(domains);
-    if (sdom.element() == sign_domain::Interval::EQZ) {
-      cdom.meet_with(ConstantDomain(0));
-      return;
+      : m_signs(to_signs(interval)) {
+    if (m_signs == EMPTY) {
+      set_to_bottom();
+    } else if (m_signs == ZERO) {
+      m_constant_kind = sparta::AbstractValueKind::Value;
     }
-    auto cst = cdom.get_constant();
-    if (!cst) {
+  }
+
+  bool is_bottom() const override { return m_signs == EMPTY; }
+
+  bool is_top() const override {
+    return m_signs == ALL && m_constant_kind == sparta::AbstractValueKind::Top;
+  }
+
+  bool leq(const SignedConstantDomain& other) const override {
+    return (m_signs & ~other.m_signs) == 0 && constant_leq(other);
+  }
+
+  bool equals(const SignedConstantDomain& other) const override {
+    return m_signs == other.m_signs && constant_equals(other);
+  }
+
+  void set_to_bottom() override {
+    m_constant = 0;
+    m_signs = EMPTY;
+    m_constant_kind = sparta::AbstractValueKind::Bottom;
+  }
+
+  void set_to_top() override {
+    m_constant = 0;
+    m_signs = ALL;
+    m_constant_kind = sparta::AbstractValueKind::Top;
+  }
+
+  void join_with(const SignedConstantDomain& other) override {
+    m_signs = join_signs(m_signs, other.m_signs);
+    constant_join_with(other);
+  }
+
+  // Both domains are finite, so the widening is the join.
+  void widen_with(const SignedConstantDomain& other) override {
+    join_with(other);
+  }
+
+  void meet_with(const SignedConstantDomain& other) override {
+    m_signs &= other.m_signs;
+    if (m_signs == EMPTY) {
+      set_to_bottom();
       return;
     }
-    if (!sign_domain::contains(sdom.element(), *cst)) {
-      sdom.set_to_bottom();
-      return;
+    constant_meet_with(other);
+    if (m_constant_kind == sparta::AbstractValueKind::Bottom) {
+      set_to_bottom();
     }
-    sdom.meet_with(sign_domain::from_int(*cst));
   }
 
-  sign_domain::Domain interval_domain() const { return get<0>(); }
+  void narrow_with(const SignedConstantDomain& other) override {
+    meet_with(other);
+  }
+
+  sign_domain::Domain interval_domain() const {
+    return sign_domain::Domain(interval());
+  }
 
-  sign_domain::Interval interval() const { return interval_domain().element(); }
+  sign_domain::Interval interval() const { return to_interval(m_signs); }
 
-  ConstantDomain constant_domain() const { return get<1>(); }
+  ConstantDomain constant_domain() const {
+    switch (m_constant_kind) {
+    case sparta::AbstractValueKind::Bottom:
+      return ConstantDomain::bottom();
+    case sparta::AbstractValueKind::Value:
+      return ConstantDomain(m_constant);
+    case sparta::AbstractValueKind::Top:
+      return ConstantDomain::top();
+    }
+    not_reached();
+  }
 
   boost::optional<ConstantDomain::ConstantType> get_constant() const {
-    return constant_domain().get_constant();
+    if (m_constant_kind != sparta::AbstractValueKind::Value) {
+      return boost::none;
+    }
+    return m_constant;
   }
 
   static SignedConstantDomain default_value() {
@@ -71,4 +132,113 @@ class SignedConstantDomain
 
   /* Return the smallest element within the interval. */
   int64_t min_element() const;
+
+  friend std::ostream& operator<<(std::ostream& o,
+                                  const SignedConstantDomain& scd) {
+    return o << "(" << scd.interval_domain() << ", " << scd.constant_domain()
+             << ")";
+  }
+
+ private:
+  // The signs an interval contains.
+  enum Signs : uint8_t {
+    EMPTY = 0,
+    NEGATIVE = 1,
+    ZERO = 2,
+    POSITIVE = 4,
+    ALL = NEGATIVE | ZERO | POSITIVE,
+  };
+
+  static uint8_t to_signs(sign_domain::Interval interval) {
+    switch (interval) {
+    case sign_domain::Interval::EMPTY:
+      return EMPTY;
+    case sign_domain::Interval::LTZ:
+      return NEGATIVE;
+    case sign_domain::Interval::GTZ:
+      return POSITIVE;
+    case sign_domain::Interval::EQZ:
+      return ZERO;
+    case sign_domain::Interval::GEZ:
+      return ZERO | POSITIVE;
+    case sign_domain::Interval::LEZ:
+      return NEGATIVE | ZERO;
+    case sign_domain::Interval::ALL:
+      return ALL;
+    case sign_domain::Interval::SIZE:
+      break;
+    }
+    not_reached();
+  }
+
+  static sign_domain::Interval to_interval(uint8_t signs) {
+    switch (signs) {
+    case EMPTY:
+      return sign_domain::Interval::EMPTY;
+    case NEGATIVE:
+      return sign_domain::Interval::LTZ;
+    case POSITIVE:
+      return sign_domain::Interval::GTZ;
+    case ZERO:
+      return sign_domain::Interval::EQZ;
+    case ZERO | POSITIVE:
+      return sign_domain::Interval::GEZ;
+    case NEGATIVE | ZERO:
+      return sign_domain::Interval::LEZ;
+    case ALL:
+      return sign_domain::Interval::ALL;
+    }
+    not_reached();
+  }
+
+  // The only set of signs that isn't an interval is {negative, positive}; the
+  // smallest interval that contains it is ALL.
+  static uint8_t join_signs(uint8_t a, uint8_t b) {
+    uint8_t signs = a | b;
+    return signs == (NEGATIVE | POSITIVE) ? ALL : signs;
+  }
+
+  bool constant_leq(const SignedConstantDomain& other) const {
+    switch (m_constant_kind) {
+    case sparta::AbstractValueKind::Bottom:
+      return true;
+    case sparta::AbstractValueKind::Value:
+      return other.m_constant_kind == sparta::AbstractValueKind::Top ||
+             (other.m_constant_kind == sparta::AbstractValueKind::Value &&
+              m_constant == other.m_constant);
+    case sparta::AbstractValueKind::Top:
+      return other.m_constant_kind == sparta::AbstractValueKind::Top;
+    }
+    not_reached();
+  }
+
+  bool constant_equals(const SignedConstantDomain& other) const {
+    return m_constant_kind == other.m_constant_kind &&
+           (m_constant_kind != sparta::AbstractValueKind::Value ||
+            m_constant == other.m_constant);
+  }
+
+  void constant_join_with(const SignedConstantDomain& other) {
+    if (constant_leq(other)) {
+      m_constant = other.m_constant;
+      m_constant_kind = other.m_constant_kind;
+    } else if (!other.constant_leq(*this)) {
+      m_constant = 0;
+      m_constant_kind = sparta::AbstractValueKind::Top;
+    }
+  }
+
+  void constant_meet_with(const SignedConstantDomain& other) {
+    if (other.constant_leq(*this)) {
+      m_constant = other.m_constant;
+      m_constant_kind = other.m_constant_kind;
+    } else if (!constant_leq(other)) {
+      m_constant = 0;
+      m_constant_kind = sparta::AbstractValueKind::Bottom;
+    }
+  }
+
+  int64_t m_constant{0};
+  uint8_t m_signs{ALL};
+  sparta::AbstractValueKind m_constant_kind{sparta::AbstractValueKind::Top};
 };
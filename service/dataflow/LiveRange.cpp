@@ -7,10 +7,14 @@
 
 #include "LiveRange.h"
 
+#include <limits>
+
 #include <boost/pending/disjoint_sets.hpp>
 #include <boost/property_map/property_map.hpp>
 
+#include "ControlFlow.h"
 #include "IRCode.h"
+#include "Liveness.h"
 #include "ReachingDefinitions.h"
 
 namespace {
@@ -98,15 +102,7 @@ UDChains calculate_ud_chains(IRCode* code) {
   return chains;
 }
 
-} // namespace
-
-namespace live_range {
-
-bool Use::operator==(const Use& that) const {
-  return insn == that.insn && reg == that.reg;
-}
-
-void renumber_registers(IRCode* code, bool width_aware) {
+void renumber_with_ud_chains(IRCode* code, bool width_aware) {
   auto chains = calculate_ud_chains(code);
 
   Rank rank;
@@ -136,4 +132,237 @@ void renumber_registers(IRCode* code, bool width_aware) {
   code->set_registers_size(sym_reg_mapper.regs_size());
 }
 
+constexpr uint32_t NO_NODE = std::numeric_limits<uint32_t>::max();
+
+/*
+ * Builds live ranges through pruned SSA form (Cytron et al.): a phi goes at
+ * every block in the iterated dominance frontier of a register's defs where
+ * that register is live-in. Defs and phis are the nodes of a disjoint-set
+ * forest, and each phi is unified with the nodes flowing into it, so each set
+ * ends up being the defs with a use in common, as with the ud-chains.
+ *
+ * Instructions are numbered in block order, which for a non-editable CFG is
+ * also code order, and all the tables are flat arrays indexed by instruction
+ * ordinal, block id or node id.
+ *
+ * Requires every block to be reachable from the entry block. Returns the
+ * number of symbolic registers.
+ */
+reg_t renumber_with_ssa(cfg::ControlFlowGraph& cfg, bool width_aware) {
+  const auto& blocks = cfg.blocks();
+  size_t num_block_ids = 0;
+  for (cfg::Block* block : blocks) {
+    num_block_ids = std::max(num_block_ids, block->id() + 1);
+  }
+
+  // Number the instructions, their defs and their uses.
+  std::vector<IRInstruction*> insns;
+  std::vector<uint32_t> block_begin(num_block_ids);
+  std::vector<uint32_t> block_end(num_block_ids);
+  std::vector<uint32_t> def_nodes;
+  std::vector<uint32_t> use_offsets{0};
+  uint32_t num_defs = 0;
+  size_t num_regs = 0;
+  for (cfg::Block* block : blocks) {
+    block_begin[block->id()] = insns.size();
+    for (const auto& mie : InstructionIterable(block)) {
+      auto insn = mie.insn;
+      insns.push_back(insn);
+      if (insn->dests_size()) {
+        def_nodes.push_back(num_defs++);
+        num_regs = std::max<size_t>(num_regs, insn->dest() + 1);
+      } else {
+        def_nodes.push_back(NO_NODE);
+      }
+      for (size_t i = 0; i < insn->srcs_size(); ++i) {
+        num_regs = std::max<size_t>(num_regs, insn->src(i) + 1);
+      }
+      use_offsets.push_back(use_offsets.back() + insn->srcs_size());
+    }
+    block_end[block->id()] = insns.size();
+  }
+
+  std::vector<std::vector<cfg::Block*>> def_blocks(num_regs);
+  for (cfg::Block* block : blocks) {
+    for (auto i = block_begin[block->id()]; i < block_end[block->id()]; ++i) {
+      if (def_nodes[i] == NO_NODE) {
+        continue;
+      }
+      auto& reg_blocks = def_blocks[insns[i]->dest()];
+      if (reg_blocks.empty() || reg_blocks.back() != block) {
+        reg_blocks.push_back(block);
+      }
+    }
+  }
+
+  // Dominance frontiers, as in Cooper, Harvey & Kennedy's "A Simple, Fast
+  // Dominance Algorithm".
+  std::vector<std::vector<cfg::Block*>> frontiers(num_block_ids);
+  for (cfg::Block* block : blocks) {
+    if (block->preds().size() < 2) {
+      continue;
+    }
+    cfg::Block* idom = cfg.idom(block);
+    for (const cfg::Edge* e : block->preds()) {
+      for (cfg::Block* runner = e->src(); runner != idom;
+           runner = cfg.idom(runner)) {
+        auto& frontier = frontiers[runner->id()];
+        if (!frontier.empty() && frontier.back() == block) {
+          break;
+        }
+        frontier.push_back(block);
+      }
+    }
+  }
+
+  DenseLivenessFixpointIterator liveness(cfg);
+  liveness.run(DenseLivenessDomain(num_regs));
+  std::vector<DenseLivenessDomain> live_in(num_block_ids);
+  for (cfg::Block* block : blocks) {
+    live_in[block->id()] = liveness.get_live_in_vars_at(block);
+  }
+
+  // Place the phis. Phi nodes are numbered after the def nodes.
+  std::vector<std::vector<std::pair<reg_t, uint32_t>>> phis(num_block_ids);
+  uint32_t num_nodes = num_defs;
+  std::vector<size_t> considered_for(num_block_ids, num_regs);
+  std::vector<size_t> queued_for(num_block_ids, num_regs);
+  std::vector<cfg::Block*> worklist;
+  for (size_t reg = 0; reg < num_regs; ++reg) {
+    worklist = def_blocks[reg];
+    for (cfg::Block* block : worklist) {
+      queued_for[block->id()] = reg;
+    }
+    while (!worklist.empty()) {
+      cfg::Block* block = worklist.back();
+      worklist.pop_back();
+      for (cfg::Block* frontier : frontiers[block->id()]) {
+        auto id = frontier->id();
+        if (considered_for[id] == reg) {
+          continue;
+        }
+        considered_for[id] = reg;
+        if (!live_in[id].contains(reg)) {
+          continue;
+        }
+        phis[id].emplace_back(reg, num_nodes++);
+        if (queued_for[id] != reg) {
+          queued_for[id] = reg;
+          worklist.push_back(frontier);
+        }
+      }
+    }
+  }
+
+  // Rename along the dominator tree: each use reads the node on top of its
+  // register's stack, and each phi is unified with the nodes that reach the
+  // ends of its block's predecessors.
+  std::vector<std::vector<cfg::Block*>> children(num_block_ids);
+  for (cfg::Block* block : cfg.reverse_postorder()) {
+    if (block != cfg.entry_block()) {
+      children[cfg.idom(block)->id()].push_back(block);
+    }
+  }
+  boost::disjoint_sets_with_storage<> node_sets(num_nodes);
+  std::vector<uint32_t> use_nodes(use_offsets.back());
+  std::vector<std::vector<uint32_t>> stacks(num_regs);
+  std::vector<reg_t> pushed;
+  // A null block marks where the walk leaves the subtree of the block below
+  // it, and the size of `pushed` to restore.
+  std::vector<std::pair<cfg::Block*, size_t>> walk{{cfg.entry_block(), 0}};
+  while (!walk.empty()) {
+    auto frame = walk.back();
+    walk.pop_back();
+    if (frame.first == nullptr) {
+      while (pushed.size() > frame.second) {
+        stacks[pushed.back()].pop_back();
+        pushed.pop_back();
+      }
+      continue;
+    }
+    cfg::Block* block = frame.first;
+    walk.emplace_back(nullptr, pushed.size());
+
+    for (const auto& phi : phis[block->id()]) {
+      stacks[phi.first].push_back(phi.second);
+      pushed.push_back(phi.first);
+    }
+    for (auto i = block_begin[block->id()]; i < block_end[block->id()]; ++i) {
+      auto insn = insns[i];
+      for (size_t k = 0; k < insn->srcs_size(); ++k) {
+        const auto& stack = stacks[insn->src(k)];
+        always_assert_log(!stack.empty(),
+                          "Found use without def when processing %s",
+                          SHOW(insn));
+        use_nodes[use_offsets[i] + k] = stack.back();
+      }
+      if (def_nodes[i] != NO_NODE) {
+        stacks[insn->dest()].push_back(def_nodes[i]);
+        pushed.push_back(insn->dest());
+      }
+    }
+    for (const cfg::Edge* e : block->succs()) {
+      for (const auto& phi : phis[e->target()->id()]) {
+        const auto& stack = stacks[phi.first];
+        if (!stack.empty()) {
+          node_sets.union_set(phi.second, stack.back());
+        }
+      }
+    }
+
+    for (cfg::Block* child : children[block->id()]) {
+      walk.emplace_back(child, 0);
+    }
+  }
+
+  // Allocate the symbolic registers in code order of each live range's first
+  // def, like SymRegMapper.
+  constexpr reg_t NO_REG = std::numeric_limits<reg_t>::max();
+  std::vector<reg_t> node_regs(num_nodes, NO_REG);
+  reg_t next_symreg = 0;
+  for (size_t i = 0; i < insns.size(); ++i) {
+    if (def_nodes[i] == NO_NODE) {
+      continue;
+    }
+    auto insn = insns[i];
+    auto& sym_reg = node_regs[node_sets.find_set(def_nodes[i])];
+    if (sym_reg == NO_REG) {
+      sym_reg = next_symreg;
+      next_symreg += width_aware && insn->dest_is_wide() ? 2 : 1;
+    }
+    insn->set_dest(sym_reg);
+  }
+  for (size_t i = 0; i < insns.size(); ++i) {
+    auto insn = insns[i];
+    for (size_t k = 0; k < insn->srcs_size(); ++k) {
+      auto node = use_nodes[use_offsets[i] + k];
+      auto sym_reg = node_regs[node_sets.find_set(node)];
+      always_assert_log(sym_reg != NO_REG,
+                        "Found use without def when processing %s",
+                        SHOW(insn));
+      insn->set_src(k, sym_reg);
+    }
+  }
+  return next_symreg;
+}
+
+} // namespace
+
+namespace live_range {
+
+bool Use::operator==(const Use& that) const {
+  return insn == that.insn && reg == that.reg;
+}
+
+void renumber_registers(IRCode* code, bool width_aware) {
+  auto& cfg = code->cfg();
+  // The SSA construction walks the dominator tree, which only covers the
+  // reachable blocks.
+  if (cfg.reverse_postorder().size() != cfg.num_blocks()) {
+    renumber_with_ud_chains(code, width_aware);
+    return;
+  }
+  code->set_registers_size(renumber_with_ssa(cfg, width_aware));
+}
+
 } // namespace live_range
@@ -53,6 +53,10 @@ namespace live_range {
 /*
  * width_aware means that the renumbering process will allocate 2 slots per
  * wide register. In general, callers should use the default (true) value.
+ *
+ * The CFG of the code must be built. When all its blocks are reachable, the
+ * live ranges come from an SSA construction over the dominator tree;
+ * otherwise they come from ud-chains computed by reaching definitions.
  */
 void renumber_registers(IRCode*, bool width_aware = true);
 
@@ -8,19 +8,37 @@
 #pragma once
 
 #include "BaseIRAnalyzer.h"
+#include "BitVectorSetAbstractDomain.h"
 #include "ControlFlow.h"
 #include "PatriciaTreeSetAbstractDomain.h"
 
 using LivenessDomain = sparta::PatriciaTreeSetAbstractDomain<uint16_t>;
 
-class LivenessFixpointIterator final
-    : public ir_analyzer::BaseBackwardsIRAnalyzer<LivenessDomain> {
+/*
+ * Liveness over a dense bit vector with one bit per register. Its joins and
+ * comparisons are word-parallel, which beats the Patricia trees on methods
+ * where many registers are live at once, e.g. in register allocation. It takes
+ * registers_size / 8 bytes per state, so prefer LivenessDomain when the states
+ * are kept around on large methods.
+ */
+using DenseLivenessDomain = sparta::BitVectorSetAbstractDomain<uint16_t>;
+
+/*
+ * Analyzer is either ir_analyzer::BaseBackwardsIRAnalyzer, over a
+ * ControlFlowGraph, or ir_analyzer::BaseBackwardsIRViewAnalyzer, over a
+ * ControlFlowView.
+ */
+template <typename Domain,
+          typename Analyzer = ir_analyzer::BaseBackwardsIRAnalyzer<Domain>>
+class BasicLivenessFixpointIterator final : public Analyzer {
  public:
-  LivenessFixpointIterator(const cfg::ControlFlowGraph& cfg)
-      : ir_analyzer::BaseBackwardsIRAnalyzer<LivenessDomain>(cfg) {}
+  using NodeId = typename Analyzer::NodeId;
+
+  BasicLivenessFixpointIterator(const typename Analyzer::Graph& cfg)
+      : Analyzer(cfg) {}
 
   void analyze_instruction(IRInstruction* insn,
-                           LivenessDomain* current_state) const override {
+                           Domain* current_state) const override {
     if (insn->dests_size()) {
       current_state->remove(insn->dest());
     }
@@ -29,11 +47,20 @@ class LivenessFixpointIterator final
     }
   }
 
-  LivenessDomain get_live_in_vars_at(const NodeId& block) const {
-    return get_exit_state_at(block);
+  Domain get_live_in_vars_at(const NodeId& block) const {
+    return this->get_exit_state_at(block);
   }
 
-  LivenessDomain get_live_out_vars_at(const NodeId& block) const {
-    return get_entry_state_at(block);
+  Domain get_live_out_vars_at(const NodeId& block) const {
+    return this->get_entry_state_at(block);
   }
 };
+
+using LivenessFixpointIterator = BasicLivenessFixpointIterator<LivenessDomain>;
+
+using DenseLivenessFixpointIterator =
+    BasicLivenessFixpointIterator<DenseLivenessDomain>;
+
+using ViewLivenessFixpointIterator = BasicLivenessFixpointIterator<
+    LivenessDomain,
+    ir_analyzer::BaseBackwardsIRViewAnalyzer<LivenessDomain>>;
@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ReachingDefinitions.h"
+
+#include "IRCode.h"
+
+namespace reaching_defs {
+
+DenseDefs::DenseDefs(const cfg::ControlFlowGraph& cfg) {
+  for (cfg::Block* block : cfg.blocks()) {
+    for (const auto& mie : InstructionIterable(block)) {
+      auto insn = mie.insn;
+      if (insn->dests_size()) {
+        uint32_t id = m_defs.size();
+        m_defs.push_back(insn);
+        m_ids.emplace(insn, id);
+        m_reg_defs[insn->dest()].push_back(id);
+      }
+    }
+  }
+}
+
+const std::vector<uint32_t>& DenseDefs::defs_of(reg_t reg) const {
+  static const std::vector<uint32_t> no_defs;
+  auto it = m_reg_defs.find(reg);
+  return it == m_reg_defs.end() ? no_defs : it->second;
+}
+
+Domain DenseEnvironment::get(reg_t reg) const {
+  if (is_bottom()) {
+    return Domain::bottom();
+  }
+  // Like an unbound register in Environment, no definitions is Top.
+  Domain result = Domain::top();
+  if (m_defs == nullptr) {
+    return result;
+  }
+  for (uint32_t id : m_defs->defs_of(reg)) {
+    if (!m_set.contains(id)) {
+      continue;
+    }
+    if (result.is_top()) {
+      result = Domain(m_defs->def(id));
+    } else {
+      result.unwrap().add(m_defs->def(id));
+    }
+  }
+  return result;
+}
+
+DenseFixpointIterator::DenseFixpointIterator(const cfg::ControlFlowGraph& cfg)
+    : ir_analyzer::BaseIRAnalyzer<DenseEnvironment>(cfg),
+      m_defs(std::make_shared<DenseDefs>(cfg)) {
+  size_t num_defs = m_defs->size();
+  for (cfg::Block* block : cfg.blocks()) {
+    GenKill gen_kill{DenseDefSet(num_defs), DenseDefSet(num_defs)};
+    for (const auto& mie : InstructionIterable(block)) {
+      auto insn = mie.insn;
+      if (!insn->dests_size()) {
+        continue;
+      }
+      for (uint32_t id : m_defs->defs_of(insn->dest())) {
+        gen_kill.gen.remove(id);
+        gen_kill.kill.add(id);
+      }
+      gen_kill.gen.add(m_defs->id(insn));
+    }
+    m_gen_kill.emplace(block->id(), std::move(gen_kill));
+  }
+}
+
+void DenseFixpointIterator::prepare(DenseEnvironment* current_state) const {
+  if (current_state->m_defs == nullptr) {
+    current_state->m_defs = m_defs;
+  }
+}
+
+void DenseFixpointIterator::analyze_node(
+    const NodeId& block, DenseEnvironment* current_state) const {
+  if (current_state->is_bottom()) {
+    return;
+  }
+  prepare(current_state);
+  const auto& gen_kill = m_gen_kill.at(block->id());
+  current_state->m_set.difference_with(gen_kill.kill);
+  current_state->m_set.join_with(gen_kill.gen);
+}
+
+void DenseFixpointIterator::analyze_instruction(
+    IRInstruction* insn, DenseEnvironment* current_state) const {
+  if (!insn->dests_size()) {
+    return;
+  }
+  prepare(current_state);
+  for (uint32_t id : m_defs->defs_of(insn->dest())) {
+    current_state->m_set.remove(id);
+  }
+  current_state->m_set.add(m_defs->id(insn));
+}
+
+} // namespace reaching_defs
@@ -9,8 +9,13 @@
 
 #pragma once
 
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 #include "AbstractDomain.h"
 #include "BaseIRAnalyzer.h"
+#include "BitVectorSetAbstractDomain.h"
 #include "ControlFlow.h"
 #include "DexClass.h"
 #include "PatriciaTreeMapAbstractEnvironment.h"
@@ -68,4 +73,138 @@ class FixpointIterator final : public ir_analyzer::BaseIRAnalyzer<Environment> {
   }
 };
 
+/*
+ * The definitions of a method, numbered densely in block order.
+ */
+class DenseDefs final {
+ public:
+  explicit DenseDefs(const cfg::ControlFlowGraph& cfg);
+
+  size_t size() const { return m_defs.size(); }
+
+  IRInstruction* def(uint32_t id) const { return m_defs[id]; }
+
+  uint32_t id(const IRInstruction* insn) const { return m_ids.at(insn); }
+
+  // The ids of the definitions that write `reg`, in ascending order.
+  const std::vector<uint32_t>& defs_of(reg_t reg) const;
+
+ private:
+  std::vector<IRInstruction*> m_defs;
+  std::unordered_map<const IRInstruction*, uint32_t> m_ids;
+  std::unordered_map<reg_t, std::vector<uint32_t>> m_reg_defs;
+};
+
+using DenseDefSet = sparta::BitVectorSetAbstractDomain<uint32_t>;
+
+/*
+ * Reaching definitions as one bit vector over the dense ids of DenseDefs,
+ * instead of a map from registers to sets of instructions. A state takes
+ * num_defs / 8 bytes, and joins and comparisons are word-parallel.
+ *
+ * get() answers the same queries as Environment::get(). States that were
+ * never touched by the DenseFixpointIterator have no DenseDefs attached, but
+ * they are also empty.
+ */
+class DenseEnvironment final
+    : public sparta::AbstractDomain<DenseEnvironment> {
+ public:
+  DenseEnvironment() = default;
+
+  DenseEnvironment(std::shared_ptr<const DenseDefs> defs, DenseDefSet set)
+      : m_defs(std::move(defs)), m_set(std::move(set)) {}
+
+  Domain get(reg_t reg) const;
+
+  const DenseDefSet& def_ids() const { return m_set; }
+
+  bool is_bottom() const override { return m_set.is_bottom(); }
+
+  bool is_top() const override { return m_set.is_top(); }
+
+  bool leq(const DenseEnvironment& other) const override {
+    return m_set.leq(other.m_set);
+  }
+
+  bool equals(const DenseEnvironment& other) const override {
+    return m_set.equals(other.m_set);
+  }
+
+  void set_to_bottom() override { m_set.set_to_bottom(); }
+
+  void set_to_top() override { m_set.set_to_top(); }
+
+  void join_with(const DenseEnvironment& other) override {
+    adopt_defs(other);
+    m_set.join_with(other.m_set);
+  }
+
+  void widen_with(const DenseEnvironment& other) override {
+    adopt_defs(other);
+    m_set.widen_with(other.m_set);
+  }
+
+  void meet_with(const DenseEnvironment& other) override {
+    adopt_defs(other);
+    m_set.meet_with(other.m_set);
+  }
+
+  void narrow_with(const DenseEnvironment& other) override {
+    adopt_defs(other);
+    m_set.narrow_with(other.m_set);
+  }
+
+  static DenseEnvironment bottom() {
+    return DenseEnvironment(nullptr, DenseDefSet::bottom());
+  }
+
+  static DenseEnvironment top() {
+    return DenseEnvironment(nullptr, DenseDefSet::top());
+  }
+
+ private:
+  friend class DenseFixpointIterator;
+
+  void adopt_defs(const DenseEnvironment& other) {
+    if (m_defs == nullptr) {
+      m_defs = other.m_defs;
+    }
+  }
+
+  std::shared_ptr<const DenseDefs> m_defs;
+  DenseDefSet m_set;
+};
+
+/*
+ * A drop-in replacement for FixpointIterator on large methods, where the
+ * Patricia tree environments get memory-hungry. Each block is summarized once
+ * as a GEN/KILL pair of bit vectors, so its transfer function during the
+ * fixpoint is two word-parallel operations. analyze_instruction still works
+ * one instruction at a time, for clients that replay a block.
+ */
+class DenseFixpointIterator final
+    : public ir_analyzer::BaseIRAnalyzer<DenseEnvironment> {
+ public:
+  explicit DenseFixpointIterator(const cfg::ControlFlowGraph& cfg);
+
+  void analyze_node(const NodeId& block,
+                    DenseEnvironment* current_state) const override;
+
+  void analyze_instruction(IRInstruction* insn,
+                           DenseEnvironment* current_state) const override;
+
+  const DenseDefs& defs() const { return *m_defs; }
+
+ private:
+  struct GenKill {
+    DenseDefSet gen;
+    DenseDefSet kill;
+  };
+
+  void prepare(DenseEnvironment* current_state) const;
+
+  std::shared_ptr<const DenseDefs> m_defs;
+  std::unordered_map<cfg::BlockId, GenKill> m_gen_kill;
+};
+
 } // namespace reaching_defs
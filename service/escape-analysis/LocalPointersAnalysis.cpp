@@ -7,8 +7,11 @@
 
 #include "LocalPointersAnalysis.h"
 
+#include <limits>
+
+#include "CallGraph.h"
 #include "DexUtil.h"
-#include "PatriciaTreeSet.h"
+#include "Parallel.h"
 #include "Resolver.h"
 #include "Walkers.h"
 #include "WorkQueue.h"
@@ -346,25 +349,74 @@ void FixpointIteratorMapDeleter::operator()(FixpointIteratorMap* map) {
   wq.run_all();
 }
 
-static void analyze_method_recursive(
-    const DexMethod* method,
-    const call_graph::Graph& call_graph,
-    sparta::PatriciaTreeSet<const DexMethodRef*> visiting,
-    FixpointIteratorMap* fp_iter_map,
-    SummaryCMap* summary_map) {
-  if (summary_map->count(method) != 0 || visiting.contains(method) ||
-      method->get_code() == nullptr) {
-    return;
+namespace {
+
+/*
+ * The strongly connected components of the call graph, restricted to the
+ * methods with code that are reachable from the scope, grouped into waves.
+ * The callees of the members of a component are either in the component
+ * itself or in a component of an earlier wave.
+ */
+class Schedule {
+ public:
+  using Component = std::vector<const DexMethod*>;
+
+  Schedule(const Scope& scope, const call_graph::Graph& call_graph) {
+    std::unordered_map<const DexMethod*, call_graph::SccNodeId> ids;
+    std::vector<const DexMethod*> methods;
+    auto id = [&](const DexMethod* method) {
+      auto it = ids.emplace(method, methods.size());
+      if (it.second) {
+        methods.push_back(method);
+      }
+      return it.first->second;
+    };
+    walk::code(scope, [&](const DexMethod* method, IRCode&) { id(method); });
+    // The callees with code of the methods found so far, which may add more.
+    std::vector<std::vector<call_graph::SccNodeId>> callees;
+    for (size_t node = 0; node < methods.size(); ++node) {
+      std::vector<call_graph::SccNodeId> node_callees;
+      if (call_graph.has_node(methods[node])) {
+        for (const auto& edge : call_graph.node(methods[node]).callees()) {
+          auto* callee = edge->callee();
+          if (callee->get_code() != nullptr) {
+            node_callees.push_back(id(callee));
+          }
+        }
+      }
+      callees.push_back(std::move(node_callees));
+    }
+    for (auto& wave : call_graph::scc_waves(callees)) {
+      m_waves.emplace_back();
+      for (const auto& component : wave) {
+        m_waves.back().emplace_back();
+        for (auto node : component) {
+          m_waves.back().back().push_back(methods[node]);
+        }
+      }
+    }
   }
-  visiting.insert(method);
 
+  const std::vector<std::vector<Component>>& waves() const { return m_waves; }
+
+ private:
+  std::vector<std::vector<Component>> m_waves;
+};
+
+/*
+ * Analyze a method whose callees have all been analyzed, or are in its own
+ * component, and add its summary to :summary_map.
+ */
+std::unique_ptr<FixpointIterator> analyze_method(
+    const DexMethod* method,
+    const call_graph::Graph& call_graph,
+    SummaryCMap* summary_map,
+    size_t budget) {
   std::unordered_map<const IRInstruction*, EscapeSummary> invoke_to_summary_map;
   if (call_graph.has_node(method)) {
     const auto& callee_edges = call_graph.node(method).callees();
     for (const auto& edge : callee_edges) {
       auto* callee = edge->callee();
-      analyze_method_recursive(
-          callee, call_graph, visiting, fp_iter_map, summary_map);
       if (summary_map->count(callee) != 0) {
         invoke_to_summary_map.emplace(edge->invoke_iterator()->insn,
                                       summary_map->at(callee));
@@ -374,31 +426,65 @@ static void analyze_method_recursive(
 
   auto* code = method->get_code();
   auto& cfg = code->cfg();
-  auto fp_iter = new FixpointIterator(cfg, std::move(invoke_to_summary_map));
+  std::unique_ptr<FixpointIterator> fp_iter(
+      new FixpointIterator(cfg, std::move(invoke_to_summary_map)));
+  fp_iter->set_budget(budget);
   fp_iter->run(Environment());
-  fp_iter_map->emplace(method, fp_iter);
   summary_map->emplace(method, get_escape_summary(*fp_iter, *code));
+  return fp_iter;
 }
 
+template <typename Fn>
+void analyze_scope_impl(const Scope& scope,
+                        const call_graph::Graph& call_graph,
+                        SummaryCMap* summary_map,
+                        size_t budget,
+                        const Fn& analyzed) {
+  summary_map->emplace(
+      DexMethod::get_method("Ljava/lang/Object;.<init>:()V"), EscapeSummary{});
+
+  Schedule schedule(scope, call_graph);
+  for (const auto& wave : schedule.waves()) {
+    parallel_for(wave.begin(), wave.end(),
+                 [&](const Schedule::Component& component) {
+                   for (auto* method : component) {
+                     if (summary_map->count(method) == 0) {
+                       analyzed(method,
+                                analyze_method(method, call_graph,
+                                               summary_map, budget));
+                     }
+                   }
+                 });
+  }
+}
+
+} // namespace
+
 FixpointIteratorMapPtr analyze_scope(const Scope& scope,
                                      const call_graph::Graph& call_graph,
-                                     SummaryCMap* summary_map_ptr) {
+                                     SummaryCMap* summary_map_ptr,
+                                     size_t budget) {
   FixpointIteratorMapPtr fp_iter_map(new FixpointIteratorMap());
   SummaryCMap summary_map;
   if (summary_map_ptr == nullptr) {
     summary_map_ptr = &summary_map;
   }
-  summary_map_ptr->emplace(
-      DexMethod::get_method("Ljava/lang/Object;.<init>:()V"), EscapeSummary{});
-
-  walk::parallel::code(scope, [&](const DexMethod* method, IRCode& code) {
-    sparta::PatriciaTreeSet<const DexMethodRef*> visiting;
-    analyze_method_recursive(method, call_graph, visiting, fp_iter_map.get(),
-                             summary_map_ptr);
-  });
+  analyze_scope_impl(
+      scope, call_graph, summary_map_ptr, budget,
+      [&](const DexMethod* method, std::unique_ptr<FixpointIterator> fp_iter) {
+        fp_iter_map->emplace(method, fp_iter.release());
+      });
   return fp_iter_map;
 }
 
+void analyze_scope_summaries(const Scope& scope,
+                             const call_graph::Graph& call_graph,
+                             SummaryCMap* summary_map) {
+  analyze_scope_impl(
+      scope, call_graph, summary_map, std::numeric_limits<size_t>::max(),
+      [](const DexMethod*, std::unique_ptr<FixpointIterator>) {});
+}
+
 /*
  * Join over all possible return values.
  */
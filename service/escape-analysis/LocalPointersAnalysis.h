@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <limits>
 #include <ostream>
 
 #include "BaseIRAnalyzer.h"
@@ -182,14 +183,34 @@ using SummaryCMap = ConcurrentMap<const DexMethodRef*, EscapeSummary>;
 
 /*
  * Analyze all methods in scope, making sure to analyze the callees before
- * their callers.
+ * their callers. The strongly connected components of the call graph are
+ * analyzed in waves: all the components whose callees are done are analyzed
+ * in parallel. Within a component, the methods are analyzed one after the
+ * other, and an invoke of a member that isn't done yet is treated as an
+ * invoke without a summary.
  *
  * If a non-null SummaryCMap pointer is passed in, it will get populated
- * with the escape summaries of the methods in scope.
+ * with the escape summaries of the methods in scope. Methods that already
+ * have a summary in it are not analyzed.
+ *
+ * The analysis of each method gives up after analyzing :budget blocks; see
+ * sparta::MonotonicFixpointIterator::set_budget(). All the pointers of such a
+ * method may then escape.
+ */
+FixpointIteratorMapPtr analyze_scope(
+    const Scope&,
+    const call_graph::Graph&,
+    SummaryCMap* = nullptr,
+    size_t budget = std::numeric_limits<size_t>::max());
+
+/*
+ * Same as analyze_scope, for callers that only need the summaries. Each
+ * FixpointIterator is deleted as soon as the summary of its method has been
+ * extracted, instead of living as long as all the others.
  */
-FixpointIteratorMapPtr analyze_scope(const Scope&,
-                                     const call_graph::Graph&,
-                                     SummaryCMap* = nullptr);
+void analyze_scope_summaries(const Scope&,
+                             const call_graph::Graph&,
+                             SummaryCMap*);
 
 EscapeSummary get_escape_summary(const FixpointIterator& fp_iter,
                                  const IRCode& code);
@@ -7,47 +7,37 @@
 
 #include "MethodDedup.h"
 
+#include <boost/functional/hash.hpp>
+
 #include "IRCode.h"
 #include "MethodReference.h"
+#include "Parallel.h"
+#include "Walkers.h"
 
 namespace {
 
-struct CodeAsKey {
-  IRCode* code;
-
-  explicit CodeAsKey(IRCode* c) : code(c) {}
-
-  bool operator==(const CodeAsKey& other) const {
-    return code->structural_equals(*other.code);
-  }
-};
-
-struct CodeHasher {
-  size_t operator()(const CodeAsKey& key) const {
-    size_t result = 0;
-    for (auto& mie : InstructionIterable(key.code)) {
-      result ^= mie.insn->hash();
+// Combines the proto and, in order, the opcodes and non-register operands of
+// the code. Methods that differ only in their registers or debug info share a
+// fingerprint.
+size_t fingerprint(DexMethod* method) {
+  size_t result = 0;
+  boost::hash_combine(result, method->get_proto());
+  for (auto& mie : InstructionIterable(method->get_code())) {
+    auto insn = mie.insn;
+    boost::hash_combine(result, static_cast<uint16_t>(insn->opcode()));
+    boost::hash_combine(result, insn->srcs_size());
+    if (insn->has_literal()) {
+      boost::hash_combine(result, insn->get_literal());
+    } else if (insn->has_type()) {
+      boost::hash_combine(result, insn->get_type());
+    } else if (insn->has_field()) {
+      boost::hash_combine(result, insn->get_field());
+    } else if (insn->has_method()) {
+      boost::hash_combine(result, insn->get_method());
+    } else if (insn->has_string()) {
+      boost::hash_combine(result, insn->get_string());
     }
-    return result;
-  }
-};
-
-using DuplicateMethods =
-    std::unordered_map<CodeAsKey, MethodOrderedSet, CodeHasher>;
-
-std::vector<MethodOrderedSet> get_duplicate_methods_simple(
-    const MethodOrderedSet& methods) {
-  DuplicateMethods duplicates;
-  for (DexMethod* method : methods) {
-    always_assert(method->get_code());
-    duplicates[CodeAsKey(method->get_code())].emplace(method);
   }
-
-  std::vector<MethodOrderedSet> result;
-  for (auto& duplicate : duplicates) {
-    result.push_back(std::move(duplicate.second));
-  }
-
   return result;
 }
 
@@ -86,18 +76,60 @@ std::vector<MethodOrderedSet> group_similar_methods(
 
 std::vector<MethodOrderedSet> group_identical_methods(
     const std::vector<DexMethod*>& methods) {
-  std::vector<MethodOrderedSet> result;
-  std::vector<MethodOrderedSet> same_protos = group_similar_methods(methods);
-
-  // Find actual duplicates.
-  for (const auto& same_proto : same_protos) {
-    std::vector<MethodOrderedSet> duplicates =
-        get_duplicate_methods_simple(same_proto);
+  return IdenticalMethodsIndex(methods).groups();
+}
 
-    result.insert(result.end(), duplicates.begin(), duplicates.end());
+IdenticalMethodsIndex::IdenticalMethodsIndex(
+    const std::vector<DexMethod*>& methods) {
+  std::vector<size_t> fingerprints(methods.size());
+  std::vector<size_t> indices(methods.size());
+  for (size_t i = 0; i < methods.size(); ++i) {
+    indices[i] = i;
+  }
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    always_assert(methods[i]->get_code());
+    fingerprints[i] = fingerprint(methods[i]);
+  });
+
+  // The groups whose methods have each fingerprint.
+  std::unordered_map<size_t, std::vector<size_t>> fingerprint_groups;
+  for (size_t i = 0; i < methods.size(); ++i) {
+    auto method = methods[i];
+    if (m_group_of.count(method)) {
+      continue;
+    }
+    auto& candidates = fingerprint_groups[fingerprints[i]];
+    size_t group = m_groups.size();
+    for (auto candidate : candidates) {
+      auto other = *m_groups[candidate].begin();
+      if (other->get_proto() == method->get_proto() &&
+          method->get_code()->structural_equals(*other->get_code())) {
+        group = candidate;
+        break;
+      }
+    }
+    if (group == m_groups.size()) {
+      candidates.push_back(group);
+      m_groups.emplace_back();
+    }
+    m_groups[group].emplace(method);
+    m_group_of.emplace(method, group);
   }
+}
 
-  return result;
+IdenticalMethodsIndex IdenticalMethodsIndex::from_scope(const Scope& scope) {
+  std::vector<DexMethod*> methods;
+  walk::code(scope, [&](DexMethod* method, IRCode&) {
+    methods.push_back(method);
+  });
+  return IdenticalMethodsIndex(methods);
+}
+
+const MethodOrderedSet& IdenticalMethodsIndex::identical_to(
+    DexMethod* method) const {
+  static const MethodOrderedSet empty;
+  auto it = m_group_of.find(method);
+  return it == m_group_of.end() ? empty : m_groups[it->second];
 }
 
 bool are_methods_identical(const std::vector<DexMethod*>& methods) {
@@ -109,7 +141,8 @@ size_t dedup_methods_helper(
     const std::vector<DexMethod*>& to_dedup,
     std::vector<DexMethod*>& replacements,
     boost::optional<std::unordered_map<DexMethod*, MethodOrderedSet>>&
-        new_to_old) {
+        new_to_old,
+    std::unordered_map<DexMethod*, DexMethod*>* deferred_call_refs) {
   if (to_dedup.size() <= 1) {
     replacements = to_dedup;
     return 0;
@@ -148,7 +181,25 @@ size_t dedup_methods_helper(
             SHOW(replacement));
     }
   }
-  method_reference::update_call_refs_simple(scope, duplicates_to_replacement);
+  if (deferred_call_refs == nullptr) {
+    method_reference::update_call_refs_simple(scope,
+                                              duplicates_to_replacement);
+    return dedup_count;
+  }
+  // The next round only compares the methods of to_dedup, so their code is
+  // all that needs to see the replacements now.
+  for (auto m : to_dedup) {
+    auto code = m->get_code();
+    if (code != nullptr) {
+      method_reference::update_call_refs_simple(*code,
+                                                duplicates_to_replacement);
+    }
+  }
+  for (const auto& pair : duplicates_to_replacement) {
+    if (pair.first != pair.second) {
+      deferred_call_refs->emplace(pair.first, pair.second);
+    }
+  }
   return dedup_count;
 }
 
@@ -157,7 +208,8 @@ size_t dedup_methods(
     const std::vector<DexMethod*>& to_dedup,
     std::vector<DexMethod*>& replacements,
     boost::optional<std::unordered_map<DexMethod*, MethodOrderedSet>>&
-        new_to_old) {
+        new_to_old,
+    std::unordered_map<DexMethod*, DexMethod*>* deferred_call_refs) {
   size_t total_dedup_count = 0;
   auto to_dedup_temp = to_dedup;
   while (true) {
@@ -166,7 +218,8 @@ size_t dedup_methods(
           "dedup: static|non_virt input %d\n",
           to_dedup_temp.size());
     size_t dedup_count =
-        dedup_methods_helper(scope, to_dedup_temp, replacements, new_to_old);
+        dedup_methods_helper(scope, to_dedup_temp, replacements, new_to_old,
+                             deferred_call_refs);
     total_dedup_count += dedup_count;
     TRACE(METH_DEDUP, 8, "dedup: static|non_virt dedupped %d\n", dedup_count);
     if (dedup_count == 0) {
@@ -9,6 +9,8 @@
 
 #include <boost/optional.hpp>
 #include <set>
+#include <unordered_map>
+#include <vector>
 
 #include "DexClass.h"
 
@@ -34,6 +36,37 @@ std::vector<MethodOrderedSet> group_similar_methods(
 std::vector<MethodOrderedSet> group_identical_methods(
     const std::vector<DexMethod*>&);
 
+/**
+ * An index of methods by signature and code, so that the methods identical to
+ * a given one are a lookup away rather than a regrouping. Methods are identical
+ * as in group_identical_methods.
+ *
+ * The methods are first keyed by a fingerprint of their proto and code that
+ * ignores registers and debug info, computed in parallel. Only methods whose
+ * fingerprints collide are then compared instruction by instruction. The
+ * methods must have code, and the code must not change while the index is in
+ * use.
+ */
+class IdenticalMethodsIndex {
+ public:
+  explicit IdenticalMethodsIndex(const std::vector<DexMethod*>& methods);
+
+  // Indexes all the methods with code in the scope.
+  static IdenticalMethodsIndex from_scope(const Scope& scope);
+
+  // The methods identical to the given one, itself included; empty if the
+  // method isn't in the index.
+  const MethodOrderedSet& identical_to(DexMethod* method) const;
+
+  // The groups of identical methods, in the order of their first method in
+  // the input.
+  const std::vector<MethodOrderedSet>& groups() const { return m_groups; }
+
+ private:
+  std::vector<MethodOrderedSet> m_groups;
+  std::unordered_map<DexMethod*, size_t> m_group_of;
+};
+
 /**
  * Check if the given list of methods share the same signature and identical
  * code.
@@ -46,12 +79,19 @@ bool are_methods_identical(const std::vector<DexMethod*>&);
  * We do so by grouping identical methods, choosing the first one in each group
  * as its canonical replacement and update all call sites to point to their
  * canonical replacement.
+ *
+ * If deferred_call_refs is given, only the code of the methods in to_dedup is
+ * updated, and each duplicate is recorded there with its replacement instead.
+ * A replacement may itself be recorded as a duplicate in a later round. This
+ * allows a caller deduping several batches to update all the call sites of the
+ * scope in one sweep at the end.
  */
 size_t dedup_methods(
     const Scope& scope,
     const std::vector<DexMethod*>& to_dedup,
     std::vector<DexMethod*>& replacements,
     boost::optional<std::unordered_map<DexMethod*, MethodOrderedSet>>&
-        new_to_old);
+        new_to_old,
+    std::unordered_map<DexMethod*, DexMethod*>* deferred_call_refs = nullptr);
 
 } // namespace method_dedup
@@ -82,38 +82,43 @@ void patch_callsite_var_additional_args(
 }
 
 void update_call_refs_simple(
-    const Scope& scope,
+    IRCode& code,
     const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee) {
-  auto patcher = [&](DexMethod* meth, IRCode& code) {
-    for (auto& mie : InstructionIterable(code)) {
-      auto insn = mie.insn;
-      if (!insn->has_method()) {
-        continue;
-      }
-      const auto method =
-          resolve_method(insn->get_method(), opcode_to_search(insn));
-      if (method == nullptr || old_to_new_callee.count(method) == 0) {
-        continue;
-      }
-      auto new_callee = old_to_new_callee.at(method);
-      // At this point, a non static private should not exist.
-      always_assert_log(!is_private(new_callee) || is_static(new_callee),
-                        "%s\n",
-                        vshow(new_callee).c_str());
-      TRACE(REFU, 9, " Updated call %s to %s\n", SHOW(insn), SHOW(new_callee));
-      insn->set_method(new_callee);
-      if (new_callee->is_virtual()) {
-        always_assert_log(is_invoke_virtual(insn->opcode()),
-                          "invalid callsite %s\n",
-                          SHOW(insn));
-      } else if (is_static(new_callee)) {
-        always_assert_log(is_invoke_static(insn->opcode()),
-                          "invalid callsite %s\n",
-                          SHOW(insn));
-      }
+  for (auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    if (!insn->has_method()) {
+      continue;
     }
-  };
-  walk::parallel::code(scope, patcher);
+    const auto method =
+        resolve_method(insn->get_method(), opcode_to_search(insn));
+    if (method == nullptr || old_to_new_callee.count(method) == 0) {
+      continue;
+    }
+    auto new_callee = old_to_new_callee.at(method);
+    // At this point, a non static private should not exist.
+    always_assert_log(!is_private(new_callee) || is_static(new_callee),
+                      "%s\n",
+                      vshow(new_callee).c_str());
+    TRACE(REFU, 9, " Updated call %s to %s\n", SHOW(insn), SHOW(new_callee));
+    insn->set_method(new_callee);
+    if (new_callee->is_virtual()) {
+      always_assert_log(is_invoke_virtual(insn->opcode()),
+                        "invalid callsite %s\n",
+                        SHOW(insn));
+    } else if (is_static(new_callee)) {
+      always_assert_log(is_invoke_static(insn->opcode()),
+                        "invalid callsite %s\n",
+                        SHOW(insn));
+    }
+  }
+}
+
+void update_call_refs_simple(
+    const Scope& scope,
+    const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee) {
+  walk::parallel::code(scope, [&](DexMethod*, IRCode& code) {
+    update_call_refs_simple(code, old_to_new_callee);
+  });
 }
 
 void patch_callsite(
@@ -51,6 +51,13 @@ void update_call_refs_simple(
     const Scope& scope,
     const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee);
 
+/**
+ * Same as above, for the call sites of a single method body.
+ */
+void update_call_refs_simple(
+    IRCode& code,
+    const std::unordered_map<DexMethod*, DexMethod*>& old_to_new_callee);
+
 CallSites collect_call_refs(const Scope& scope,
                             const MethodOrderedSet& callees);
 }
@@ -111,7 +111,7 @@ std::string get_method_signature(const DexMethod* method) {
   auto arg_list = proto->get_args();
   if (arg_list->size() > 0) {
     ss << "(";
-    auto que = arg_list->get_type_list();
+    const auto& que = arg_list->get_type_list();
     for (auto t : que) {
       ss << show(t) << ", ";
     }
@@ -166,30 +166,26 @@ DexProto* update_proto_reference(
 }
 
 DexTypeList* prepend_and_make(const DexTypeList* list, DexType* new_type) {
-  auto old_list = list->get_type_list();
-  auto prepended = std::deque<DexType*>(old_list.begin(), old_list.end());
+  auto prepended = list->to_deque();
   prepended.push_front(new_type);
   return DexTypeList::make_type_list(std::move(prepended));
 }
 
 DexTypeList* append_and_make(const DexTypeList* list, DexType* new_type) {
-  auto old_list = list->get_type_list();
-  auto appended = std::deque<DexType*>(old_list.begin(), old_list.end());
+  auto appended = list->to_deque();
   appended.push_back(new_type);
   return DexTypeList::make_type_list(std::move(appended));
 }
 
 DexTypeList* append_and_make(const DexTypeList* list,
                              const std::vector<DexType*>& new_types) {
-  auto old_list = list->get_type_list();
-  auto appended = std::deque<DexType*>(old_list.begin(), old_list.end());
+  auto appended = list->to_deque();
   appended.insert(appended.end(), new_types.begin(), new_types.end());
   return DexTypeList::make_type_list(std::move(appended));
 }
 
 DexTypeList* replace_head_and_make(const DexTypeList* list, DexType* new_head) {
-  auto old_list = list->get_type_list();
-  auto new_list = std::deque<DexType*>(old_list.begin(), old_list.end());
+  auto new_list = list->to_deque();
   always_assert(!new_list.empty());
   new_list.pop_front();
   new_list.push_front(new_head);
@@ -197,8 +193,7 @@ DexTypeList* replace_head_and_make(const DexTypeList* list, DexType* new_head) {
 }
 
 DexTypeList* drop_and_make(const DexTypeList* list, size_t num_types_to_drop) {
-  auto old_list = list->get_type_list();
-  auto dropped = std::deque<DexType*>(old_list.begin(), old_list.end());
+  auto dropped = list->to_deque();
   for (size_t i = 0; i < num_types_to_drop; ++i) {
     dropped.pop_back();
   }
@@ -7,7 +7,10 @@
 
 #include "SwitchDispatch.h"
 
+#include <numeric>
+
 #include "Creators.h"
+#include "Parallel.h"
 #include "TypeReference.h"
 
 using namespace type_reference;
@@ -195,11 +198,15 @@ size_t estimate_num_switch_dispatch_needed(
     return ceil(static_cast<float>(num_cases) / max_num_dispatch_target.get());
   }
   if (num_cases > MAX_NUM_DISPATCH_TARGET) {
-    size_t total_num_insn = 0;
+    std::vector<DexMethod*> targets;
+    targets.reserve(num_cases);
     for (auto& it : indices_to_callee) {
-      auto target = it.second;
-      total_num_insn += target->get_code()->count_opcodes();
+      targets.push_back(it.second);
     }
+    size_t total_num_insn = parallel_reduce(
+        targets.begin(), targets.end(), size_t(0),
+        [](DexMethod* target) { return target->get_code()->count_opcodes(); },
+        [](size_t a, size_t b) { return a + b; });
 
     return ceil(static_cast<float>(total_num_insn) /
                 MAX_NUM_DISPATCH_INSTRUCTION);
@@ -282,49 +289,63 @@ dispatch::DispatchMethod create_two_level_switch_dispatch(
   handle_default_block(spec, indices_to_callee, args, mc, ret_loc, def_block);
   mb->ret(spec.proto->get_rtype(), ret_loc);
 
+  // Partition the cases into runs, each handled by a sub dispatch that is
+  // called from the block of the last case of its run.
   size_t max_num_leaf_switch = cases.size() / num_switch_needed + 1;
-  std::map<SwitchIndices, DexMethod*> sub_indices_to_callee;
-  std::vector<DexMethod*> sub_dispatches;
-  size_t dispatch_index = 0;
+  std::vector<std::map<SwitchIndices, DexMethod*>> sub_indices_to_callees;
+  std::vector<MethodBlock*> sub_dispatch_blocks;
   size_t case_index = 0;
   size_t subcase_count = 0;
   for (auto& case_it : cases) {
-    sub_indices_to_callee[case_it.first] = indices_to_callee.at(case_it.first);
+    if (subcase_count == 0) {
+      sub_indices_to_callees.emplace_back();
+    }
+    sub_indices_to_callees.back()[case_it.first] =
+        indices_to_callee.at(case_it.first);
     subcase_count++;
 
     if (subcase_count == max_num_leaf_switch ||
         case_index == cases.size() - 1) {
-      auto sub_name = spec.name + "$" + std::to_string(dispatch_index);
-      auto new_arg_list =
-          prepend_and_make(spec.proto->get_args(), spec.owner_type);
-      auto static_dispatch_proto =
-          DexProto::make_proto(spec.proto->get_rtype(), new_arg_list);
-      dispatch::Spec sub_spec{spec.owner_type,
-                              dispatch::Type::VIRTUAL,
-                              sub_name,
-                              static_dispatch_proto,
-                              spec.access_flags | ACC_STATIC,
-                              spec.type_tag_field,
-                              nullptr, // overridden_method,
-                              spec.keep_debug_info};
-      auto sub_dispatch =
-          create_simple_switch_dispatch(sub_spec, sub_indices_to_callee);
-      sub_indices_to_callee.clear();
-
-      auto case_block = case_it.second;
-      always_assert(case_block != nullptr);
-      // check-cast and call
-      emit_check_cast(spec, args, sub_dispatch, case_block);
-      invoke_static(spec, args, ret_loc, sub_dispatch, case_block);
-
-      sub_dispatches.push_back(sub_dispatch);
-      dispatch_index++;
+      always_assert(case_it.second != nullptr);
+      sub_dispatch_blocks.push_back(case_it.second);
       subcase_count = 0;
     }
 
     case_index++;
   }
 
+  // The sub dispatches only read the targets, so they are created in
+  // parallel.
+  auto new_arg_list = prepend_and_make(spec.proto->get_args(), spec.owner_type);
+  auto static_dispatch_proto =
+      DexProto::make_proto(spec.proto->get_rtype(), new_arg_list);
+  std::vector<DexMethod*> sub_dispatches(sub_indices_to_callees.size());
+  std::vector<size_t> dispatch_indices(sub_dispatches.size());
+  std::iota(dispatch_indices.begin(), dispatch_indices.end(), 0);
+  parallel_for(
+      dispatch_indices.begin(), dispatch_indices.end(),
+      [&](size_t dispatch_index) {
+        auto sub_name = spec.name + "$" + std::to_string(dispatch_index);
+        dispatch::Spec sub_spec{spec.owner_type,
+                                dispatch::Type::VIRTUAL,
+                                sub_name,
+                                static_dispatch_proto,
+                                spec.access_flags | ACC_STATIC,
+                                spec.type_tag_field,
+                                nullptr, // overridden_method,
+                                spec.keep_debug_info};
+        sub_dispatches[dispatch_index] = create_simple_switch_dispatch(
+            sub_spec, sub_indices_to_callees[dispatch_index]);
+      },
+      /* grain */ 1);
+
+  for (size_t i = 0; i < sub_dispatches.size(); ++i) {
+    // check-cast and call
+    emit_check_cast(spec, args, sub_dispatches[i], sub_dispatch_blocks[i]);
+    invoke_static(spec, args, ret_loc, sub_dispatches[i],
+                  sub_dispatch_blocks[i]);
+  }
+
   auto dispatch_meth = materialize_dispatch(orig_method, mc);
 
   /////////////////////////////////////////////////////////////////////////////
@@ -10,9 +10,16 @@
 #include <sstream>
 #include <stdexcept>
 
+#include <stddef.h>
 #include <stdint.h>
 #include <string>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 /*
  * LEB128 is a DEX data type.  It was borrowed by DEX from the DWARF3
  * specification.  Dex uses a subset of it, which it uses for encoding of
@@ -180,6 +187,47 @@ inline uint32_t mutf8_next_code_point(const char*& s) {
   throw std::invalid_argument("Invalid size encoding mutf8 string");
 }
 
+/*
+ * The index of the first of the n bytes at a and b that differ, or n if they
+ * are all the same. Compares 16 bytes per step with SSE2 or NEON, which every
+ * x86-64 and arm64 target has.
+ */
+inline size_t mismatch_index(const char* a, const char* b, size_t n) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 16 <= n; i += 16) {
+    auto va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+    if (mask != 0xffff) {
+      return i + __builtin_ctz(~mask);
+    }
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; i + 16 <= n; i += 16) {
+    auto eq = vreinterpretq_u64_u8(
+        vceqq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(a + i)),
+                 vld1q_u8(reinterpret_cast<const uint8_t*>(b + i))));
+    // Each byte of the halves is 0xff where the bytes are equal, and the
+    // first byte in memory is the lowest one.
+    uint64_t lo = ~vgetq_lane_u64(eq, 0);
+    if (lo != 0) {
+      return i + __builtin_ctzll(lo) / 8;
+    }
+    uint64_t hi = ~vgetq_lane_u64(eq, 1);
+    if (hi != 0) {
+      return i + 8 + __builtin_ctzll(hi) / 8;
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    if (a[i] != b[i]) {
+      break;
+    }
+  }
+  return i;
+}
+
 inline uint32_t length_of_utf8_string(const char* s) {
   if (s == nullptr) {
     return 0;
@@ -0,0 +1,257 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <ostream>
+#include <vector>
+
+#include "PowersetAbstractDomain.h"
+
+namespace sparta {
+
+namespace bvsad_impl {
+
+/*
+ * An implementation of a powerset abstract domain as a dense bit vector. The
+ * elements are unsigned integers, and a set over the universe {0, ..., n-1}
+ * takes n bits, whatever the number of elements it holds.
+ *
+ * All the lattice operations are plain loops over 64-bit words, which the
+ * compiler can vectorize. This is the representation of choice for dataflow
+ * problems over a small, dense universe, e.g. liveness over the registers of
+ * a method, where most sets are large and the operations dominate the cost.
+ *
+ * The vector grows as elements are added, so two sets may have a different
+ * number of words. The missing words are all zeros.
+ */
+template <typename IntegerType>
+class BitVectorSetValue final
+    : public PowersetImplementation<IntegerType,
+                                    std::vector<IntegerType>,
+                                    BitVectorSetValue<IntegerType>> {
+ public:
+  using Word = uint64_t;
+  static constexpr size_t kWordBits = 64;
+
+  BitVectorSetValue() = default;
+
+  // Returns an empty set with room for the elements {0, ..., max_size-1}.
+  explicit BitVectorSetValue(size_t max_size)
+      : m_words(word_count(max_size), 0) {}
+
+  void clear() override { std::fill(m_words.begin(), m_words.end(), 0); }
+
+  // Returns the elements in ascending order.
+  std::vector<IntegerType> elements() const override {
+    std::vector<IntegerType> result;
+    result.reserve(size());
+    for (size_t i = 0; i < m_words.size(); ++i) {
+      Word w = m_words[i];
+      while (w != 0) {
+        result.push_back(
+            static_cast<IntegerType>(i * kWordBits + __builtin_ctzll(w)));
+        w &= w - 1;
+      }
+    }
+    return result;
+  }
+
+  AbstractValueKind kind() const override { return AbstractValueKind::Value; }
+
+  bool contains(const IntegerType& element) const override {
+    size_t idx = element / kWordBits;
+    return idx < m_words.size() && (m_words[idx] & bit(element)) != 0;
+  }
+
+  bool leq(const BitVectorSetValue& other) const override {
+    size_t common = std::min(m_words.size(), other.m_words.size());
+    Word extra = 0;
+    for (size_t i = 0; i < common; ++i) {
+      extra |= m_words[i] & ~other.m_words[i];
+    }
+    for (size_t i = common; i < m_words.size(); ++i) {
+      extra |= m_words[i];
+    }
+    return extra == 0;
+  }
+
+  bool equals(const BitVectorSetValue& other) const override {
+    size_t common = std::min(m_words.size(), other.m_words.size());
+    Word diff = 0;
+    for (size_t i = 0; i < common; ++i) {
+      diff |= m_words[i] ^ other.m_words[i];
+    }
+    for (size_t i = common; i < m_words.size(); ++i) {
+      diff |= m_words[i];
+    }
+    for (size_t i = common; i < other.m_words.size(); ++i) {
+      diff |= other.m_words[i];
+    }
+    return diff == 0;
+  }
+
+  void add(const IntegerType& element) override {
+    size_t idx = element / kWordBits;
+    if (idx >= m_words.size()) {
+      m_words.resize(idx + 1, 0);
+    }
+    m_words[idx] |= bit(element);
+  }
+
+  void remove(const IntegerType& element) override {
+    size_t idx = element / kWordBits;
+    if (idx < m_words.size()) {
+      m_words[idx] &= ~bit(element);
+    }
+  }
+
+  AbstractValueKind join_with(const BitVectorSetValue& other) override {
+    if (other.m_words.size() > m_words.size()) {
+      m_words.resize(other.m_words.size(), 0);
+    }
+    for (size_t i = 0; i < other.m_words.size(); ++i) {
+      m_words[i] |= other.m_words[i];
+    }
+    return AbstractValueKind::Value;
+  }
+
+  AbstractValueKind widen_with(const BitVectorSetValue& other) override {
+    return join_with(other);
+  }
+
+  AbstractValueKind meet_with(const BitVectorSetValue& other) override {
+    size_t common = std::min(m_words.size(), other.m_words.size());
+    for (size_t i = 0; i < common; ++i) {
+      m_words[i] &= other.m_words[i];
+    }
+    std::fill(m_words.begin() + common, m_words.end(), 0);
+    return AbstractValueKind::Value;
+  }
+
+  AbstractValueKind narrow_with(const BitVectorSetValue& other) override {
+    return meet_with(other);
+  }
+
+  // Removes all the elements of `other` from this set.
+  void difference_with(const BitVectorSetValue& other) {
+    size_t common = std::min(m_words.size(), other.m_words.size());
+    for (size_t i = 0; i < common; ++i) {
+      m_words[i] &= ~other.m_words[i];
+    }
+  }
+
+  size_t size() const override {
+    size_t n = 0;
+    for (Word w : m_words) {
+      n += __builtin_popcountll(w);
+    }
+    return n;
+  }
+
+  friend std::ostream& operator<<(std::ostream& o,
+                                  const BitVectorSetValue& value) {
+    o << "[#" << value.size() << "]";
+    const auto& elements = value.elements();
+    o << "{";
+    for (auto it = elements.begin(); it != elements.end();) {
+      o << *it++;
+      if (it != elements.end()) {
+        o << ", ";
+      }
+    }
+    o << "}";
+    return o;
+  }
+
+ private:
+  static size_t word_count(size_t max_size) {
+    return (max_size + kWordBits - 1) / kWordBits;
+  }
+
+  static Word bit(IntegerType element) {
+    return Word(1) << (element % kWordBits);
+  }
+
+  std::vector<Word> m_words;
+};
+
+} // namespace bvsad_impl
+
+/*
+ * A powerset abstract domain based on dense bit vectors.
+ */
+template <typename IntegerType>
+class BitVectorSetAbstractDomain final
+    : public PowersetAbstractDomain<IntegerType,
+                                    bvsad_impl::BitVectorSetValue<IntegerType>,
+                                    std::vector<IntegerType>,
+                                    BitVectorSetAbstractDomain<IntegerType>> {
+ public:
+  using Value = bvsad_impl::BitVectorSetValue<IntegerType>;
+
+  ~BitVectorSetAbstractDomain() {
+    // The destructor is the only method that is guaranteed to be created when
+    // a class template is instantiated. This is a good place to perform all
+    // the sanity checks on the template parameters.
+    static_assert(std::is_unsigned<IntegerType>::value,
+                  "IntegerType is not an unsigned arihmetic type");
+    static_assert(sizeof(IntegerType) <= sizeof(size_t),
+                  "IntegerType is too large");
+  }
+
+  BitVectorSetAbstractDomain()
+      : PowersetAbstractDomain<IntegerType,
+                               Value,
+                               std::vector<IntegerType>,
+                               BitVectorSetAbstractDomain>() {}
+
+  explicit BitVectorSetAbstractDomain(AbstractValueKind kind)
+      : PowersetAbstractDomain<IntegerType,
+                               Value,
+                               std::vector<IntegerType>,
+                               BitVectorSetAbstractDomain>(kind) {}
+
+  // Returns an empty set with room for the elements {0, ..., max_size-1}.
+  // Larger elements can still be added, at the cost of a reallocation.
+  explicit BitVectorSetAbstractDomain(size_t max_size) {
+    this->set_to_value(Value(max_size));
+  }
+
+  explicit BitVectorSetAbstractDomain(std::initializer_list<IntegerType> l) {
+    this->set_to_value(Value());
+    this->add(l.begin(), l.end());
+  }
+
+  // Removes all the elements of `other` from this set. The complement of Top
+  // can't be represented, so Top minus a value stays Top.
+  void difference_with(const BitVectorSetAbstractDomain& other) {
+    if (this->is_bottom() || other.is_bottom()) {
+      return;
+    }
+    if (other.is_top()) {
+      this->set_to_value(Value());
+      return;
+    }
+    if (this->kind() == AbstractValueKind::Value) {
+      this->get_value()->difference_with(*other.get_value());
+    }
+  }
+
+  static BitVectorSetAbstractDomain bottom() {
+    return BitVectorSetAbstractDomain(AbstractValueKind::Bottom);
+  }
+
+  static BitVectorSetAbstractDomain top() {
+    return BitVectorSetAbstractDomain(AbstractValueKind::Top);
+  }
+};
+
+} // namespace sparta
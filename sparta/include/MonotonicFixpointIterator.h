@@ -8,8 +8,10 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <functional>
+#include <limits>
 #include <type_traits>
 #include <unordered_map>
 #include <vector>
@@ -20,6 +22,9 @@
 
 namespace sparta {
 
+template <typename GraphInterface, typename Domain, typename NodeHash>
+class ParallelMonotonicFixpointIterator;
+
 /*
  * This data structure contains the current state of the fixpoint iteration,
  * which is provided to the user when an extrapolation step is executed, so as
@@ -82,6 +87,8 @@ class MonotonicFixpointIteratorContext final {
 
   template <typename T1, typename T2, typename T3>
   friend class MonotonicFixpointIterator;
+  template <typename T1, typename T2, typename T3>
+  friend class ParallelMonotonicFixpointIterator;
 };
 
 /*
@@ -163,10 +170,26 @@ class MonotonicFixpointIterator
     }
   }
 
+  /*
+   * Limits the number of times that run() may analyze a node. Pathological
+   * graphs, e.g., huge generated methods, can otherwise take very long to
+   * stabilize. When run() would exceed the budget, it stops early, and every
+   * invariant is then Top, which is always a sound result. Clients can check
+   * budget_exceeded() to skip the work that would be pointless with it.
+   */
+  void set_budget(size_t max_node_analyses) {
+    m_budget = max_node_analyses;
+  }
+
+  bool budget_exceeded() const { return m_budget_exceeded; }
+
   /*
    * Returns the invariant computed by the fixpoint iterator at a node entry.
    */
   Domain get_entry_state_at(const NodeId& node) const {
+    if (m_budget_exceeded) {
+      return Domain::top();
+    }
     auto it = m_entry_states.find(node);
     return (it == m_entry_states.end()) ? Domain::bottom() : it->second;
   }
@@ -175,6 +198,9 @@ class MonotonicFixpointIterator
    * Returns the invariant computed by the fixpoint iterator at a node exit.
    */
   Domain get_exit_state_at(const NodeId& node) const {
+    if (m_budget_exceeded) {
+      return Domain::top();
+    }
     auto it = m_exit_states.find(node);
     // It's impossible to get rid of this condition by initializing all exit
     // states to _|_ prior to starting the fixpoint iteration. The reason is
@@ -193,10 +219,12 @@ class MonotonicFixpointIterator
     return (it == m_exit_states.end()) ? Domain::bottom() : it->second;
   }
 
- private:
+ protected:
   void clear() {
     m_entry_states.clear();
     m_exit_states.clear();
+    m_node_analyses = 0;
+    m_budget_exceeded = false;
   }
 
   void compute_entry_state(Context* context,
@@ -222,7 +250,11 @@ class MonotonicFixpointIterator
   }
 
   void analyze_vertex(Context* context, const NodeId& node) {
-    Domain& entry_state = m_entry_states[node];
+    if (m_budget_exceeded || ++m_node_analyses > m_budget) {
+      m_budget_exceeded = true;
+      return;
+    }
+    Domain& entry_state = state_slot(&m_entry_states, node);
     // We should be careful not to access m_exit_states[node] before computing
     // the entry state, as this may silently initialize it with an unwanted
     // value (i.e., the default-constructed value of Domain). This can in turn
@@ -232,7 +264,7 @@ class MonotonicFixpointIterator
     // contain unreachable nodes pointing to reachable ones (see the
     // documentation of `get_exit_state_at`).
     compute_entry_state(context, node, &entry_state);
-    Domain& exit_state = m_exit_states[node];
+    Domain& exit_state = state_slot(&m_exit_states, node);
     exit_state = entry_state;
     this->analyze_node(node, &exit_state);
   }
@@ -240,7 +272,8 @@ class MonotonicFixpointIterator
   void analyze_scc(Context* context, const WtoComponent<NodeId>& scc) {
     NodeId head = scc.head_node();
     bool iterate = true;
-    for (context->reset_local_iteration_count_for(head); iterate;
+    for (context->reset_local_iteration_count_for(head);
+         iterate && !m_budget_exceeded;
          context->increase_iteration_count_for(head)) {
       analyze_vertex(context, head);
       for (const auto& component : scc) {
@@ -250,7 +283,7 @@ class MonotonicFixpointIterator
       // slot associated with the head node in the hash table of entry states.
       // The state is updated in place within the hash table via side effects,
       // which avoids costly copies and allocations.
-      Domain* current_state = &m_entry_states[head];
+      Domain* current_state = &state_slot(&m_entry_states, head);
       Domain new_state;
       compute_entry_state(context, head, &new_state);
       if (new_state.leq(*current_state)) {
@@ -270,10 +303,24 @@ class MonotonicFixpointIterator
     }
   }
 
+  // Only inserts into the table if the node has no slot yet. The parallel
+  // iterator creates all the slots upfront, so that its workers never modify
+  // the tables themselves.
+  static Domain& state_slot(
+      std::unordered_map<NodeId, Domain, NodeHash>* states,
+      const NodeId& node) {
+    auto it = states->find(node);
+    return it != states->end() ? it->second : (*states)[node];
+  }
+
   const Graph& m_graph;
   WeakTopologicalOrdering<NodeId, NodeHash> m_wto;
   std::unordered_map<NodeId, Domain, NodeHash> m_entry_states;
   std::unordered_map<NodeId, Domain, NodeHash> m_exit_states;
+  size_t m_budget{std::numeric_limits<size_t>::max()};
+  // Atomic since the workers of the parallel iterator share the budget.
+  std::atomic<size_t> m_node_analyses{0};
+  std::atomic<bool> m_budget_exceeded{false};
 };
 
 /*
@@ -302,12 +349,12 @@ class BackwardsFixpointIterationAdaptor {
   static NodeId exit(const Graph& graph) {
     return GraphInterface::entry(graph);
   }
-  static std::vector<EdgeId> predecessors(const Graph& graph,
-                                          const NodeId& node) {
+  static auto predecessors(const Graph& graph, const NodeId& node)
+      -> decltype(GraphInterface::successors(graph, node)) {
     return GraphInterface::successors(graph, node);
   }
-  static std::vector<EdgeId> successors(const Graph& graph,
-                                        const NodeId& node) {
+  static auto successors(const Graph& graph, const NodeId& node)
+      -> decltype(GraphInterface::predecessors(graph, node)) {
     return GraphInterface::predecessors(graph, node);
   }
   static NodeId source(const Graph& graph, const EdgeId& edge) {
@@ -0,0 +1,181 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "MonotonicFixpointIterator.h"
+#include "WeakTopologicalOrdering.h"
+
+namespace sparta {
+
+/*
+ * A MonotonicFixpointIterator that analyzes independent parts of the graph
+ * concurrently. The top-level components of the weak topological ordering
+ * form a DAG, in which a component depends on every other component that has
+ * an edge into it. A component is picked up by one of `num_workers` workers
+ * as soon as all the components it depends on have been analyzed. The nested
+ * components of an SCC are still analyzed in sequence, following the
+ * recursive iteration strategy.
+ *
+ * The iterator doesn't create any threads. The workers are run by the
+ * `executor`, which must call fn(0) ... fn(n - 1), each exactly once, and
+ * return when all of them have finished. It is free to run them one after the
+ * other, e.g. when all its threads are busy: the first worker then simply
+ * analyzes every component. The default executor does just that. In Redex,
+ * the executor should be ThreadPool::run(), which bounds the concurrency of
+ * nested parallel regions:
+ *
+ *   MyAnalyzer analyzer(graph, ThreadPool::get().num_threads(),
+ *                       [](size_t n, const std::function<void(size_t)>& fn) {
+ *                         ThreadPool::get().run(n, fn);
+ *                       });
+ *
+ * The interface is the same as the one of MonotonicFixpointIterator, but
+ * analyze_node(), analyze_edge() and extrapolate() may be called concurrently
+ * for nodes of different components, so they must not modify any state shared
+ * between nodes. Every top-level component has its own iteration context.
+ */
+template <typename GraphInterface,
+          typename Domain,
+          typename NodeHash = std::hash<typename GraphInterface::NodeId>>
+class ParallelMonotonicFixpointIterator
+    : public MonotonicFixpointIterator<GraphInterface, Domain, NodeHash> {
+  using Base = MonotonicFixpointIterator<GraphInterface, Domain, NodeHash>;
+
+ public:
+  using Graph = typename Base::Graph;
+  using NodeId = typename Base::NodeId;
+  using EdgeId = typename Base::EdgeId;
+  using Context = typename Base::Context;
+  using Executor =
+      std::function<void(size_t, const std::function<void(size_t)>&)>;
+
+  static void run_sequentially(size_t n,
+                               const std::function<void(size_t)>& fn) {
+    for (size_t i = 0; i < n; ++i) {
+      fn(i);
+    }
+  }
+
+  explicit ParallelMonotonicFixpointIterator(
+      const Graph& graph,
+      size_t num_workers = 1,
+      Executor executor = run_sequentially,
+      size_t cfg_size_hint = 4)
+      : Base(graph, cfg_size_hint),
+        m_num_workers(std::max<size_t>(num_workers, 1)),
+        m_executor(std::move(executor)) {}
+
+  void run(const Domain& init) {
+    this->clear();
+    std::vector<const WtoComponent<NodeId>*> components;
+    std::unordered_map<NodeId, size_t, NodeHash> component_of;
+    for (const WtoComponent<NodeId>& component : this->m_wto) {
+      collect_nodes(component, components.size(), &component_of);
+      components.push_back(&component);
+    }
+    // All the slots are created before the workers start, so that the hash
+    // tables are never modified concurrently (see state_slot()). This is
+    // equivalent to the sequential iteration, where a missing exit state also
+    // stands for _|_.
+    for (const auto& pair : component_of) {
+      this->m_entry_states.emplace(pair.first, Domain::bottom());
+      this->m_exit_states.emplace(pair.first, Domain::bottom());
+    }
+
+    // Edges between distinct top-level components always go forward in the
+    // weak topological ordering, hence the dependencies form a DAG.
+    std::vector<std::vector<size_t>> dependents(components.size());
+    std::vector<size_t> pending(components.size(), 0);
+    for (const auto& pair : component_of) {
+      for (const EdgeId& edge :
+           GraphInterface::predecessors(this->m_graph, pair.first)) {
+        auto it =
+            component_of.find(GraphInterface::source(this->m_graph, edge));
+        if (it != component_of.end() && it->second != pair.second) {
+          dependents[it->second].push_back(pair.second);
+          ++pending[pair.second];
+        }
+      }
+    }
+
+    std::mutex lock;
+    std::condition_variable cv;
+    std::vector<size_t> ready;
+    size_t remaining = components.size();
+    std::exception_ptr error;
+    for (size_t i = 0; i < components.size(); ++i) {
+      if (pending[i] == 0) {
+        ready.push_back(i);
+      }
+    }
+    auto worker = [&](size_t) {
+      std::unique_lock<std::mutex> guard(lock);
+      while (true) {
+        cv.wait(guard,
+                [&] { return !ready.empty() || remaining == 0 || error; });
+        if (remaining == 0 || error) {
+          return;
+        }
+        size_t i = ready.back();
+        ready.pop_back();
+        guard.unlock();
+        try {
+          Context context(init);
+          this->analyze_component(&context, *components[i]);
+        } catch (...) {
+          guard.lock();
+          if (!error) {
+            error = std::current_exception();
+          }
+          cv.notify_all();
+          return;
+        }
+        guard.lock();
+        --remaining;
+        for (size_t j : dependents[i]) {
+          if (--pending[j] == 0) {
+            ready.push_back(j);
+          }
+        }
+        cv.notify_all();
+      }
+    };
+
+    m_executor(std::min(m_num_workers, components.size()), worker);
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+ private:
+  static void collect_nodes(
+      const WtoComponent<NodeId>& component,
+      size_t index,
+      std::unordered_map<NodeId, size_t, NodeHash>* component_of) {
+    component_of->emplace(component.head_node(), index);
+    if (component.is_scc()) {
+      for (const auto& subcomponent : component) {
+        collect_nodes(subcomponent, index, component_of);
+      }
+    }
+  }
+
+  const size_t m_num_workers;
+  const Executor m_executor;
+};
+
+} // namespace sparta
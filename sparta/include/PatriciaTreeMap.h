@@ -8,15 +8,23 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <stack>
+#include <tuple>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
 
 #include "AbstractDomain.h"
 #include "PatriciaTreeUtil.h"
@@ -51,6 +59,9 @@ class PatriciaTreeIterator;
 template <typename T>
 using CombiningFunction = std::function<T(const T&, const T&)>;
 
+// The Memo parameter of merge() and intersect() that turns memoization off.
+struct NoMemo;
+
 template <typename IntegerType, typename Value>
 inline const typename Value::type* find_value(
     IntegerType key,
@@ -78,13 +89,13 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> update(
     const typename Value::type& value,
     const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree);
 
-template <typename IntegerType, typename Value>
+template <typename IntegerType, typename Value, typename Memo = NoMemo>
 inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
     const CombiningFunction<typename Value::type>& combine,
     const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
     const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t);
 
-template <typename IntegerType, typename Value>
+template <typename IntegerType, typename Value, typename Memo = NoMemo>
 inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
     const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
@@ -112,6 +123,24 @@ struct SimpleValue {
 
 } // namespace ptmap_impl
 
+/*
+ * Turns hash-consing of Patricia-tree map nodes on or off, for maps of all
+ * key and value types. While it is on, every node is looked up in a global
+ * table before it is created, so that structurally equal subtrees built
+ * afterwards usually share the same node, and `equals()` and `leq()` can stop
+ * as soon as they reach a shared subtree. The results of
+ * `memoized_union_with()` and `memoized_intersection_with()` on pairs of
+ * subtrees are also memoized in a small per-thread cache. Nodes created while
+ * it was off are left as they are, which is correct but shares less.
+ *
+ * Values have no hash, so leaves are looked up by key and compared with
+ * Value::equals(). Only the last few distinct values of each key are kept in
+ * the table, which keeps that lookup cheap. Branches are looked up by their
+ * prefix and children, so equal branches over shared children are always
+ * shared.
+ */
+inline void set_patricia_tree_map_hash_consing(bool enabled);
+
 /*
  * This structure implements a map of integer/pointer keys and AbstractDomain
  * values. It's based on the following paper:
@@ -294,6 +323,29 @@ class PatriciaTreeMap final {
     return *this;
   }
 
+  /*
+   * The same as union_with() and intersection_with(), except that the
+   * results on pairs of subtrees are memoized while hash-consing is on (see
+   * set_patricia_tree_map_hash_consing()). `Tag` stands for `combine` in the
+   * memo cache: `combine` must only depend on its arguments, and no other
+   * combining function may be used with the same `Tag` and map type.
+   */
+  template <typename Tag>
+  PatriciaTreeMap& memoized_union_with(const combining_function& combine,
+                                       const PatriciaTreeMap& other) {
+    m_tree = ptmap_impl::merge<IntegerType, Value, Tag>(
+        combine, m_tree, other.m_tree);
+    return *this;
+  }
+
+  template <typename Tag>
+  PatriciaTreeMap& memoized_intersection_with(
+      const combining_function& combine, const PatriciaTreeMap& other) {
+    m_tree = ptmap_impl::intersect<IntegerType, Value, Tag>(
+        combine, m_tree, other.m_tree);
+    return *this;
+  }
+
   PatriciaTreeMap get_union_with(const combining_function& combine,
                                  const PatriciaTreeMap& other) const {
     auto result = *this;
@@ -459,6 +511,196 @@ class PatriciaTreeLeaf final : public PatriciaTree<IntegerType, Value> {
   friend class ptmap_impl::PatriciaTreeIterator;
 };
 
+inline std::atomic<bool>& hash_consing_flag() {
+  static std::atomic<bool> s_enabled{false};
+  return s_enabled;
+}
+
+inline bool is_hash_consing() {
+  return hash_consing_flag().load(std::memory_order_relaxed);
+}
+
+// The global table of interned nodes, for one type of map. It only holds weak
+// references, and a node takes itself out of the table when its last owner
+// releases it. The table is split into shards, each with its own lock, so that
+// threads building unrelated trees rarely contend.
+template <typename IntegerType, typename Value>
+class NodeTable final {
+ public:
+  using Tree = PatriciaTree<IntegerType, Value>;
+  using Leaf = PatriciaTreeLeaf<IntegerType, Value>;
+  using Branch = PatriciaTreeBranch<IntegerType, Value>;
+  using mapped_type = typename Value::type;
+
+  static NodeTable& get() {
+    // Never destroyed, as nodes may outlive every other static.
+    static NodeTable* s_table = new NodeTable();
+    return *s_table;
+  }
+
+  std::shared_ptr<Leaf> make_leaf(IntegerType key, const mapped_type& value) {
+    auto& shard = m_shards[boost::hash<IntegerType>()(key) % kShards];
+    // The candidates that don't match are only released after the lock,
+    // since releasing the last owner of a node takes the lock in turn.
+    std::vector<std::shared_ptr<Tree>> mismatches;
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto& slots = shard.leaves[key];
+    for (const auto& slot : slots) {
+      auto node = slot.node.lock();
+      if (node == nullptr) {
+        continue;
+      }
+      auto leaf = std::static_pointer_cast<Leaf>(node);
+      if (Value::equals(leaf->value(), value)) {
+        return leaf;
+      }
+      mismatches.push_back(std::move(node));
+    }
+    std::shared_ptr<Leaf> leaf(new Leaf(key, value),
+                               [](Leaf* l) { release(l); });
+    if (slots.size() == kLeavesPerKey) {
+      // The oldest leaf stays valid, it just can't be found anymore.
+      slots.erase(slots.begin());
+    }
+    slots.push_back({leaf.get(), leaf});
+    return leaf;
+  }
+
+  std::shared_ptr<Branch> make_branch(IntegerType prefix,
+                                      IntegerType branching_bit,
+                                      const std::shared_ptr<Tree>& left_tree,
+                                      const std::shared_ptr<Tree>& right_tree) {
+    BranchKey key{prefix, branching_bit, left_tree.get(), right_tree.get()};
+    auto& shard = m_shards[hash_branch(key) % kShards];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto& slot = shard.branches[key];
+    if (auto branch = slot.node.lock()) {
+      return std::static_pointer_cast<Branch>(branch);
+    }
+    std::shared_ptr<Branch> branch(
+        new Branch(prefix, branching_bit, left_tree, right_tree),
+        [](Branch* b) { release(b); });
+    slot = {branch.get(), branch};
+    return branch;
+  }
+
+  size_t size() {
+    size_t result = 0;
+    for (auto& shard : m_shards) {
+      std::lock_guard<std::mutex> guard(shard.lock);
+      for (const auto& pair : shard.leaves) {
+        result += pair.second.size();
+      }
+      result += shard.branches.size();
+    }
+    return result;
+  }
+
+ private:
+  using BranchKey = std::tuple<IntegerType, IntegerType, Tree*, Tree*>;
+
+  struct BranchKeyHash {
+    size_t operator()(const BranchKey& key) const { return hash_branch(key); }
+  };
+
+  struct Slot {
+    Tree* raw;
+    std::weak_ptr<Tree> node;
+  };
+
+  struct Shard {
+    std::mutex lock;
+    std::unordered_map<IntegerType, std::vector<Slot>> leaves;
+    std::unordered_map<BranchKey, Slot, BranchKeyHash> branches;
+  };
+
+  static constexpr size_t kShards = 64;
+  static constexpr size_t kLeavesPerKey = 16;
+
+  static size_t hash_branch(const BranchKey& key) {
+    size_t seed = 0;
+    boost::hash_combine(seed, std::get<0>(key));
+    boost::hash_combine(seed, std::get<1>(key));
+    boost::hash_combine(seed, std::get<2>(key));
+    boost::hash_combine(seed, std::get<3>(key));
+    return seed;
+  }
+
+  // A node that has just expired may already have been evicted, or replaced
+  // by a new node for the same key, hence the check on the raw pointer. The
+  // node is destroyed outside of the lock, because destroying it may release
+  // its children, which then take a lock in turn.
+  static void release(Leaf* leaf) {
+    auto& table = get();
+    auto& shard =
+        table.m_shards[boost::hash<IntegerType>()(leaf->key()) % kShards];
+    {
+      std::lock_guard<std::mutex> guard(shard.lock);
+      auto it = shard.leaves.find(leaf->key());
+      if (it != shard.leaves.end()) {
+        auto& slots = it->second;
+        auto slot = std::find_if(slots.begin(), slots.end(),
+                                 [&](const Slot& s) { return s.raw == leaf; });
+        if (slot != slots.end()) {
+          slots.erase(slot);
+        }
+        if (slots.empty()) {
+          shard.leaves.erase(it);
+        }
+      }
+    }
+    delete leaf;
+  }
+
+  static void release(Branch* branch) {
+    auto& table = get();
+    BranchKey key{branch->prefix(),
+                  branch->branching_bit(),
+                  branch->left_tree().get(),
+                  branch->right_tree().get()};
+    auto& shard = table.m_shards[hash_branch(key) % kShards];
+    {
+      std::lock_guard<std::mutex> guard(shard.lock);
+      auto it = shard.branches.find(key);
+      if (it != shard.branches.end() && it->second.raw == branch) {
+        shard.branches.erase(it);
+      }
+    }
+    delete branch;
+  }
+
+  std::array<Shard, kShards> m_shards;
+};
+
+template <typename IntegerType, typename Value>
+std::shared_ptr<PatriciaTreeLeaf<IntegerType, Value>> create_leaf(
+    IntegerType key, const typename Value::type& value) {
+  if (is_hash_consing()) {
+    return NodeTable<IntegerType, Value>::get().make_leaf(key, value);
+  }
+  return std::make_shared<PatriciaTreeLeaf<IntegerType, Value>>(key, value);
+}
+
+template <typename IntegerType, typename Value>
+std::shared_ptr<PatriciaTreeBranch<IntegerType, Value>> create_branch(
+    IntegerType prefix,
+    IntegerType branching_bit,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& left_tree,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& right_tree) {
+  if (is_hash_consing()) {
+    return NodeTable<IntegerType, Value>::get().make_branch(
+        prefix, branching_bit, left_tree, right_tree);
+  }
+  return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+      prefix, branching_bit, left_tree, right_tree);
+}
+
+// The operations in the memo cache, for each Memo parameter.
+template <typename Memo>
+struct MergeTag;
+template <typename Memo>
+struct IntersectTag;
+
 template <typename IntegerType, typename Value>
 std::shared_ptr<PatriciaTreeBranch<IntegerType, Value>> join(
     IntegerType prefix0,
@@ -467,10 +709,10 @@ std::shared_ptr<PatriciaTreeBranch<IntegerType, Value>> join(
     const std::shared_ptr<PatriciaTree<IntegerType, Value>>& tree1) {
   IntegerType m = get_branching_bit(prefix0, prefix1);
   if (is_zero_bit(prefix0, m)) {
-    return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+    return create_branch<IntegerType, Value>(
         mask(prefix0, m), m, tree0, tree1);
   } else {
-    return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+    return create_branch<IntegerType, Value>(
         mask(prefix0, m), m, tree1, tree0);
   }
 }
@@ -489,7 +731,7 @@ std::shared_ptr<PatriciaTree<IntegerType, Value>> make_branch(
   if (right_tree == nullptr) {
     return left_tree;
   }
-  return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+  return create_branch<IntegerType, Value>(
       prefix, branching_bit, left_tree, right_tree);
 }
 
@@ -673,32 +915,11 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> update(
 
 // We keep the notations of the paper so as to make the implementation easier
 // to follow.
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
+template <typename IntegerType, typename Value, typename Memo>
+inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge_branches(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
     const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
     const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t) {
-  if (s == t) {
-    // This conditional is what allows the union operation to complete in
-    // sublinear time when the operands share some structure.
-    return s;
-  }
-  if (s == nullptr) {
-    return t;
-  }
-  if (t == nullptr) {
-    return s;
-  }
-  if (s->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(s);
-    return update(combine, leaf->key(), leaf->value(), t);
-  }
-  if (t->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(t);
-    return update(combine, leaf->key(), leaf->value(), s);
-  }
   const auto& s_branch =
       std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(s);
   const auto& t_branch =
@@ -713,50 +934,50 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
   const auto& t1 = t_branch->right_tree();
   if (m == n && p == q) {
     // The two trees have the same prefix. We just merge the subtrees.
-    auto new_left = merge(combine, s0, t0);
-    auto new_right = merge(combine, s1, t1);
+    auto new_left = merge<IntegerType, Value, Memo>(combine, s0, t0);
+    auto new_right = merge<IntegerType, Value, Memo>(combine, s1, t1);
     if (new_left == s0 && new_right == s1) {
       return s;
     }
     if (new_left == t0 && new_right == t1) {
       return t;
     }
-    return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+    return create_branch<IntegerType, Value>(
         p, m, new_left, new_right);
   }
   if (m < n && match_prefix(q, p, m)) {
     // q contains p. Merge t with a subtree of s.
     if (is_zero_bit(q, m)) {
-      auto new_left = merge(combine, s0, t);
+      auto new_left = merge<IntegerType, Value, Memo>(combine, s0, t);
       if (s0 == new_left) {
         return s;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+      return create_branch<IntegerType, Value>(
           p, m, new_left, s1);
     } else {
-      auto new_right = merge(combine, s1, t);
+      auto new_right = merge<IntegerType, Value, Memo>(combine, s1, t);
       if (s1 == new_right) {
         return s;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+      return create_branch<IntegerType, Value>(
           p, m, s0, new_right);
     }
   }
   if (m > n && match_prefix(p, q, n)) {
     // p contains q. Merge s with a subtree of t.
     if (is_zero_bit(p, n)) {
-      auto new_left = merge(combine, s, t0);
+      auto new_left = merge<IntegerType, Value, Memo>(combine, s, t0);
       if (t0 == new_left) {
         return t;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+      return create_branch<IntegerType, Value>(
           q, n, new_left, t1);
     } else {
-      auto new_right = merge(combine, s, t1);
+      auto new_right = merge<IntegerType, Value, Memo>(combine, s, t1);
       if (t1 == new_right) {
         return t;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType, Value>>(
+      return create_branch<IntegerType, Value>(
           q, n, t0, new_right);
     }
   }
@@ -764,6 +985,45 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
   return join(p, s, q, t);
 }
 
+template <typename IntegerType, typename Value, typename Memo>
+inline std::shared_ptr<PatriciaTree<IntegerType, Value>> merge(
+    const ptmap_impl::CombiningFunction<typename Value::type>& combine,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t) {
+  if (s == t) {
+    // This conditional is what allows the union operation to complete in
+    // sublinear time when the operands share some structure.
+    return s;
+  }
+  if (s == nullptr) {
+    return t;
+  }
+  if (t == nullptr) {
+    return s;
+  }
+  if (s->is_leaf()) {
+    const auto& leaf =
+        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(s);
+    return update(combine, leaf->key(), leaf->value(), t);
+  }
+  if (t->is_leaf()) {
+    const auto& leaf =
+        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(t);
+    return update(combine, leaf->key(), leaf->value(), s);
+  }
+  if (std::is_same<Memo, NoMemo>::value || !is_hash_consing()) {
+    return merge_branches<IntegerType, Value, Memo>(combine, s, t);
+  }
+  using TreePtr = std::shared_ptr<PatriciaTree<IntegerType, Value>>;
+  using Cache = OperationCache<TreePtr, MergeTag<Memo>>;
+  TreePtr result;
+  if (!Cache::lookup(s, t, &result)) {
+    result = merge_branches<IntegerType, Value, Memo>(combine, s, t);
+    Cache::store(s, t, result);
+  }
+  return result;
+}
+
 // Combine :value with the value in :leaf.
 template <typename IntegerType, typename Value>
 inline std::shared_ptr<PatriciaTree<IntegerType, Value>> combine_leaf(
@@ -775,54 +1035,29 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> combine_leaf(
     return nullptr;
   }
   if (!Value::equals(combined_value, leaf->value())) {
-    return std::make_shared<PatriciaTreeLeaf<IntegerType, Value>>(
-        leaf->key(), combined_value);
+    return create_leaf<IntegerType, Value>(leaf->key(), combined_value);
   }
   return leaf;
 }
 
-// Create a new leaf with a Top value and combine :value into it.
+// Create a new leaf with the combination of a Top value and :value.
 template <typename IntegerType, typename Value>
 inline std::shared_ptr<PatriciaTree<IntegerType, Value>> combine_new_leaf(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
     IntegerType key,
     const typename Value::type& value) {
-  auto new_leaf = std::make_shared<PatriciaTreeLeaf<IntegerType, Value>>(
-      key, Value::default_value());
-  return combine_leaf(combine, value, new_leaf);
+  auto combined_value = combine(Value::default_value(), value);
+  if (Value::is_default_value(combined_value)) {
+    return nullptr;
+  }
+  return create_leaf<IntegerType, Value>(key, combined_value);
 }
 
-template <typename IntegerType, typename Value>
-inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect(
+template <typename IntegerType, typename Value, typename Memo>
+inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect_branches(
     const ptmap_impl::CombiningFunction<typename Value::type>& combine,
     const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
     const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t) {
-  if (s == t) {
-    // This conditional is what allows the intersection operation to complete in
-    // sublinear time when the operands share some structure.
-    return s;
-  }
-  if (s == nullptr || t == nullptr) {
-    return nullptr;
-  }
-  if (s->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(s);
-    auto* value = find_value(leaf->key(), t);
-    if (value == nullptr) {
-      return nullptr;
-    }
-    return combine_leaf(combine, *value, leaf);
-  }
-  if (t->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(t);
-    auto* value = find_value(leaf->key(), s);
-    if (value == nullptr) {
-      return nullptr;
-    }
-    return combine_leaf(combine, *value, leaf);
-  }
   const auto& s_branch =
       std::static_pointer_cast<PatriciaTreeBranch<IntegerType, Value>>(s);
   const auto& t_branch =
@@ -854,21 +1089,67 @@ inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect(
           BOOST_THROW_EXCEPTION(internal_error()
                                 << error_msg("Malformed Patricia tree"));
         },
-        intersect(combine, s0, t0),
-        intersect(combine, s1, t1));
+        intersect<IntegerType, Value, Memo>(combine, s0, t0),
+        intersect<IntegerType, Value, Memo>(combine, s1, t1));
   }
   if (m < n && match_prefix(q, p, m)) {
     // q contains p. Intersect t with a subtree of s.
-    return intersect(combine, is_zero_bit(q, m) ? s0 : s1, t);
+    return intersect<IntegerType, Value, Memo>(
+        combine, is_zero_bit(q, m) ? s0 : s1, t);
   }
   if (m > n && match_prefix(p, q, n)) {
     // p contains q. Intersect s with a subtree of t.
-    return intersect(combine, s, is_zero_bit(p, n) ? t0 : t1);
+    return intersect<IntegerType, Value, Memo>(
+        combine, s, is_zero_bit(p, n) ? t0 : t1);
   }
   // The prefixes disagree.
   return nullptr;
 }
 
+template <typename IntegerType, typename Value, typename Memo>
+inline std::shared_ptr<PatriciaTree<IntegerType, Value>> intersect(
+    const ptmap_impl::CombiningFunction<typename Value::type>& combine,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& s,
+    const std::shared_ptr<PatriciaTree<IntegerType, Value>>& t) {
+  if (s == t) {
+    // This conditional is what allows the intersection operation to complete in
+    // sublinear time when the operands share some structure.
+    return s;
+  }
+  if (s == nullptr || t == nullptr) {
+    return nullptr;
+  }
+  if (s->is_leaf()) {
+    const auto& leaf =
+        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(s);
+    auto* value = find_value(leaf->key(), t);
+    if (value == nullptr) {
+      return nullptr;
+    }
+    return combine_leaf(combine, *value, leaf);
+  }
+  if (t->is_leaf()) {
+    const auto& leaf =
+        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType, Value>>(t);
+    auto* value = find_value(leaf->key(), s);
+    if (value == nullptr) {
+      return nullptr;
+    }
+    return combine_leaf(combine, *value, leaf);
+  }
+  if (std::is_same<Memo, NoMemo>::value || !is_hash_consing()) {
+    return intersect_branches<IntegerType, Value, Memo>(combine, s, t);
+  }
+  using TreePtr = std::shared_ptr<PatriciaTree<IntegerType, Value>>;
+  using Cache = OperationCache<TreePtr, IntersectTag<Memo>>;
+  TreePtr result;
+  if (!Cache::lookup(s, t, &result)) {
+    result = intersect_branches<IntegerType, Value, Memo>(combine, s, t);
+    Cache::store(s, t, result);
+  }
+  return result;
+}
+
 // The iterator basically performs a post-order traversal of the tree, pausing
 // at each leaf.
 template <typename Key, typename Value>
@@ -961,4 +1242,8 @@ class PatriciaTreeIterator final {
 
 } // namespace ptmap_impl
 
+inline void set_patricia_tree_map_hash_consing(bool enabled) {
+  ptmap_impl::hash_consing_flag().store(enabled, std::memory_order_relaxed);
+}
+
 } // namespace sparta
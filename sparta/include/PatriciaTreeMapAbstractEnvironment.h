@@ -219,22 +219,22 @@ class MapValue final : public AbstractValue<MapValue<Variable, Domain>> {
   }
 
   AbstractValueKind join_with(const MapValue& other) override {
-    return join_like_operation(
+    return join_like_operation<JoinTag>(
         other, [](const Domain& x, const Domain& y) { return x.join(y); });
   }
 
   AbstractValueKind widen_with(const MapValue& other) override {
-    return join_like_operation(
+    return join_like_operation<WideningTag>(
         other, [](const Domain& x, const Domain& y) { return x.widening(y); });
   }
 
   AbstractValueKind meet_with(const MapValue& other) override {
-    return meet_like_operation(
+    return meet_like_operation<MeetTag>(
         other, [](const Domain& x, const Domain& y) { return x.meet(y); });
   }
 
   AbstractValueKind narrow_with(const MapValue& other) override {
-    return meet_like_operation(
+    return meet_like_operation<NarrowingTag>(
         other, [](const Domain& x, const Domain& y) { return x.narrowing(y); });
   }
 
@@ -245,18 +245,26 @@ class MapValue final : public AbstractValue<MapValue<Variable, Domain>> {
     m_map.insert_or_assign(variable, value);
   }
 
+  // Each operation has its own tag in the memo cache of the map.
+  struct JoinTag;
+  struct WideningTag;
+  struct MeetTag;
+  struct NarrowingTag;
+
+  template <typename Tag>
   AbstractValueKind join_like_operation(
       const MapValue& other,
       std::function<Domain(const Domain&, const Domain&)> operation) {
-    m_map.intersection_with(operation, other.m_map);
+    m_map.template memoized_intersection_with<Tag>(operation, other.m_map);
     return kind();
   }
 
+  template <typename Tag>
   AbstractValueKind meet_like_operation(
       const MapValue& other,
       std::function<Domain(const Domain&, const Domain&)> operation) {
     try {
-      m_map.union_with(
+      m_map.template memoized_union_with<Tag>(
           [&operation](const Domain& x, const Domain& y) {
             Domain result = operation(x, y);
             if (result.is_bottom()) {
@@ -148,25 +148,26 @@ class PatriciaTreeMapAbstractPartition final
   }
 
   void join_with(const PatriciaTreeMapAbstractPartition& other) override {
-    join_like_operation(
+    join_like_operation<JoinTag>(
         other, [](const Domain& x, const Domain& y) { return x.join(y); });
   }
 
   void widen_with(const PatriciaTreeMapAbstractPartition& other) override {
-    join_like_operation(
+    join_like_operation<WideningTag>(
         other, [](const Domain& x, const Domain& y) { return x.widening(y); });
   }
 
   void meet_with(const PatriciaTreeMapAbstractPartition& other) override {
-    meet_like_operation(
+    meet_like_operation<MeetTag>(
         other, [](const Domain& x, const Domain& y) { return x.meet(y); });
   }
 
   void narrow_with(const PatriciaTreeMapAbstractPartition& other) override {
-    meet_like_operation(
+    meet_like_operation<NarrowingTag>(
         other, [](const Domain& x, const Domain& y) { return x.narrowing(y); });
   }
 
+  template <typename Tag>
   void join_like_operation(
       const PatriciaTreeMapAbstractPartition& other,
       std::function<Domain(const Domain&, const Domain&)> operation) {
@@ -177,9 +178,10 @@ class PatriciaTreeMapAbstractPartition final
       set_to_top();
       return;
     }
-    m_map.union_with(operation, other.m_map);
+    m_map.template memoized_union_with<Tag>(operation, other.m_map);
   }
 
+  template <typename Tag>
   void meet_like_operation(
       const PatriciaTreeMapAbstractPartition& other,
       std::function<Domain(const Domain&, const Domain&)> operation) {
@@ -190,7 +192,7 @@ class PatriciaTreeMapAbstractPartition final
     if (other.is_top()) {
       return;
     }
-    m_map.intersection_with(operation, other.m_map);
+    m_map.template memoized_intersection_with<Tag>(operation, other.m_map);
   }
 
   static PatriciaTreeMapAbstractPartition bottom() {
@@ -204,6 +206,12 @@ class PatriciaTreeMapAbstractPartition final
   }
 
  private:
+  // Each operation has its own tag in the memo cache of the map.
+  struct JoinTag;
+  struct WideningTag;
+  struct MeetTag;
+  struct NarrowingTag;
+
   MapType m_map;
   bool m_is_top{false};
 };
@@ -8,15 +8,20 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <functional>
 #include <initializer_list>
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <stack>
+#include <tuple>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 
 #include <boost/functional/hash.hpp>
@@ -81,6 +86,20 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> diff(
 
 } // namespace pt_impl
 
+/*
+ * Turns hash-consing of Patricia-tree set nodes on or off, for sets of all
+ * element types. While it is on, every node is looked up in a global table
+ * before it is created, so that structurally equal subtrees built afterwards
+ * share the same node. `reference_equals()` then becomes equivalent to
+ * `equals()` on such sets, and the results of unions and intersections of
+ * pairs of subtrees are memoized in a small per-thread cache. Nodes created
+ * while it was off are left as they are, which is correct but shares less.
+ *
+ * Patricia-tree maps have their own switch, see
+ * set_patricia_tree_map_hash_consing().
+ */
+inline void set_patricia_tree_set_hash_consing(bool enabled);
+
 /*
  * This implementation of sets of integers using Patricia trees is based on the
  * following paper:
@@ -409,6 +428,163 @@ class PatriciaTreeLeaf final : public PatriciaTree<IntegerType> {
   IntegerType m_key;
 };
 
+inline std::atomic<bool>& hash_consing_flag() {
+  static std::atomic<bool> s_enabled{false};
+  return s_enabled;
+}
+
+inline bool is_hash_consing() {
+  return hash_consing_flag().load(std::memory_order_relaxed);
+}
+
+// The global table of interned nodes. It only holds weak references, and a
+// node takes itself out of the table when its last owner releases it. The
+// table is split into shards, each with its own lock, so that threads
+// building unrelated trees rarely contend.
+template <typename IntegerType>
+class NodeTable final {
+ public:
+  using Tree = PatriciaTree<IntegerType>;
+  using Leaf = PatriciaTreeLeaf<IntegerType>;
+  using Branch = PatriciaTreeBranch<IntegerType>;
+
+  static NodeTable& get() {
+    // Never destroyed, as nodes may outlive every other static.
+    static NodeTable* s_table = new NodeTable();
+    return *s_table;
+  }
+
+  std::shared_ptr<Leaf> make_leaf(IntegerType key) {
+    auto& shard = m_shards[boost::hash<IntegerType>()(key) % kShards];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto& slot = shard.leaves[key];
+    if (auto leaf = slot.node.lock()) {
+      return std::static_pointer_cast<Leaf>(leaf);
+    }
+    std::shared_ptr<Leaf> leaf(new Leaf(key), [](Leaf* l) { release(l); });
+    slot = {leaf.get(), leaf};
+    return leaf;
+  }
+
+  std::shared_ptr<Branch> make_branch(IntegerType prefix,
+                                      IntegerType branching_bit,
+                                      const std::shared_ptr<Tree>& left_tree,
+                                      const std::shared_ptr<Tree>& right_tree) {
+    BranchKey key{prefix, branching_bit, left_tree.get(), right_tree.get()};
+    auto& shard = m_shards[hash_branch(key) % kShards];
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto& slot = shard.branches[key];
+    if (auto branch = slot.node.lock()) {
+      return std::static_pointer_cast<Branch>(branch);
+    }
+    std::shared_ptr<Branch> branch(
+        new Branch(prefix, branching_bit, left_tree, right_tree),
+        [](Branch* b) { release(b); });
+    slot = {branch.get(), branch};
+    return branch;
+  }
+
+  size_t size() {
+    size_t result = 0;
+    for (auto& shard : m_shards) {
+      std::lock_guard<std::mutex> guard(shard.lock);
+      result += shard.leaves.size() + shard.branches.size();
+    }
+    return result;
+  }
+
+ private:
+  using BranchKey = std::tuple<IntegerType, IntegerType, Tree*, Tree*>;
+
+  struct BranchKeyHash {
+    size_t operator()(const BranchKey& key) const { return hash_branch(key); }
+  };
+
+  struct Slot {
+    Tree* raw;
+    std::weak_ptr<Tree> node;
+  };
+
+  struct Shard {
+    std::mutex lock;
+    std::unordered_map<IntegerType, Slot> leaves;
+    std::unordered_map<BranchKey, Slot, BranchKeyHash> branches;
+  };
+
+  static constexpr size_t kShards = 64;
+
+  static size_t hash_branch(const BranchKey& key) {
+    size_t seed = 0;
+    boost::hash_combine(seed, std::get<0>(key));
+    boost::hash_combine(seed, std::get<1>(key));
+    boost::hash_combine(seed, std::get<2>(key));
+    boost::hash_combine(seed, std::get<3>(key));
+    return seed;
+  }
+
+  // A node that has just expired may already have been replaced in its slot
+  // by a new node for the same key, hence the check on the raw pointer. The
+  // node is destroyed outside of the lock, because destroying it may release
+  // its children, which then take a lock in turn.
+  static void release(Leaf* leaf) {
+    auto& table = get();
+    auto& shard = table.m_shards[boost::hash<IntegerType>()(leaf->key()) %
+                                 kShards];
+    {
+      std::lock_guard<std::mutex> guard(shard.lock);
+      auto it = shard.leaves.find(leaf->key());
+      if (it != shard.leaves.end() && it->second.raw == leaf) {
+        shard.leaves.erase(it);
+      }
+    }
+    delete leaf;
+  }
+
+  static void release(Branch* branch) {
+    auto& table = get();
+    BranchKey key{branch->prefix(),
+                  branch->branching_bit(),
+                  branch->left_tree().get(),
+                  branch->right_tree().get()};
+    auto& shard = table.m_shards[hash_branch(key) % kShards];
+    {
+      std::lock_guard<std::mutex> guard(shard.lock);
+      auto it = shard.branches.find(key);
+      if (it != shard.branches.end() && it->second.raw == branch) {
+        shard.branches.erase(it);
+      }
+    }
+    delete branch;
+  }
+
+  std::array<Shard, kShards> m_shards;
+};
+
+template <typename IntegerType>
+std::shared_ptr<PatriciaTreeLeaf<IntegerType>> create_leaf(IntegerType key) {
+  if (is_hash_consing()) {
+    return NodeTable<IntegerType>::get().make_leaf(key);
+  }
+  return std::make_shared<PatriciaTreeLeaf<IntegerType>>(key);
+}
+
+template <typename IntegerType>
+std::shared_ptr<PatriciaTreeBranch<IntegerType>> create_branch(
+    IntegerType prefix,
+    IntegerType branching_bit,
+    const std::shared_ptr<PatriciaTree<IntegerType>>& left_tree,
+    const std::shared_ptr<PatriciaTree<IntegerType>>& right_tree) {
+  if (is_hash_consing()) {
+    return NodeTable<IntegerType>::get().make_branch(
+        prefix, branching_bit, left_tree, right_tree);
+  }
+  return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+      prefix, branching_bit, left_tree, right_tree);
+}
+
+struct MergeTag;
+struct IntersectTag;
+
 template <typename IntegerType>
 std::shared_ptr<PatriciaTreeBranch<IntegerType>> join(
     IntegerType prefix0,
@@ -417,11 +593,9 @@ std::shared_ptr<PatriciaTreeBranch<IntegerType>> join(
     const std::shared_ptr<PatriciaTree<IntegerType>>& tree1) {
   IntegerType m = get_branching_bit(prefix0, prefix1);
   if (is_zero_bit(prefix0, m)) {
-    return std::make_shared<PatriciaTreeBranch<IntegerType>>(
-        mask(prefix0, m), m, tree0, tree1);
+    return create_branch<IntegerType>(mask(prefix0, m), m, tree0, tree1);
   } else {
-    return std::make_shared<PatriciaTreeBranch<IntegerType>>(
-        mask(prefix0, m), m, tree1, tree0);
+    return create_branch<IntegerType>(mask(prefix0, m), m, tree1, tree0);
   }
 }
 
@@ -439,7 +613,7 @@ std::shared_ptr<PatriciaTree<IntegerType>> make_branch(
   if (right_tree == nullptr) {
     return left_tree;
   }
-  return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+  return create_branch<IntegerType>(
       prefix, branching_bit, left_tree, right_tree);
 }
 
@@ -557,7 +731,7 @@ template <typename IntegerType>
 inline std::shared_ptr<PatriciaTree<IntegerType>> insert(
     IntegerType key, const std::shared_ptr<PatriciaTree<IntegerType>>& tree) {
   if (tree == nullptr) {
-    return std::make_shared<PatriciaTreeLeaf<IntegerType>>(key);
+    return create_leaf<IntegerType>(key);
   }
   if (tree->is_leaf()) {
     const auto& leaf =
@@ -567,7 +741,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> insert(
     }
     return join<IntegerType>(
         key,
-        std::make_shared<PatriciaTreeLeaf<IntegerType>>(key),
+        create_leaf<IntegerType>(key),
         leaf->key(),
         leaf);
   }
@@ -579,7 +753,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> insert(
       if (new_left_tree == branch->left_tree()) {
         return branch;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+      return create_branch<IntegerType>(
           branch->prefix(),
           branch->branching_bit(),
           new_left_tree,
@@ -589,7 +763,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> insert(
       if (new_right_tree == branch->right_tree()) {
         return branch;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
+      return create_branch<IntegerType>(
           branch->prefix(),
           branch->branching_bit(),
           branch->left_tree(),
@@ -597,7 +771,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> insert(
     }
   }
   return join<IntegerType>(key,
-                           std::make_shared<PatriciaTreeLeaf<IntegerType>>(key),
+                           create_leaf<IntegerType>(key),
                            branch->prefix(),
                            branch);
 }
@@ -672,33 +846,9 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> filter(
 // We keep the notations of the paper so as to make the implementation easier
 // to follow.
 template <typename IntegerType>
-inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
+inline std::shared_ptr<PatriciaTree<IntegerType>> merge_branches(
     const std::shared_ptr<PatriciaTree<IntegerType>>& s,
     const std::shared_ptr<PatriciaTree<IntegerType>>& t) {
-  if (s == t) {
-    // This conditional is what allows the union operation to complete in
-    // sublinear time when the operands share some structure.
-    return s;
-  }
-  if (s == nullptr) {
-    return t;
-  }
-  if (t == nullptr) {
-    return s;
-  }
-  // We need to check whether t is a leaf before we do the same for s.
-  // Otherwise, if s and t are both leaves, we would end up inserting s into t.
-  // This would violate the assumptions required by `reference_equals()`.
-  if (t->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(t);
-    return insert(leaf->key(), s);
-  }
-  if (s->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(s);
-    return insert(leaf->key(), t);
-  }
   const auto& s_branch =
       std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(s);
   const auto& t_branch =
@@ -721,8 +871,7 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
     if (new_left == t0 && new_right == t1) {
       return t;
     }
-    return std::make_shared<PatriciaTreeBranch<IntegerType>>(
-        p, m, new_left, new_right);
+    return create_branch<IntegerType>(p, m, new_left, new_right);
   }
   if (m < n && match_prefix(q, p, m)) {
     // q contains p. Merge t with a subtree of s.
@@ -731,15 +880,13 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
       if (s0 == new_left) {
         return s;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
-          p, m, new_left, s1);
+      return create_branch<IntegerType>(p, m, new_left, s1);
     } else {
       auto new_right = merge(s1, t);
       if (s1 == new_right) {
         return s;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
-          p, m, s0, new_right);
+      return create_branch<IntegerType>(p, m, s0, new_right);
     }
   }
   if (m > n && match_prefix(p, q, n)) {
@@ -749,15 +896,13 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
       if (t0 == new_left) {
         return t;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
-          q, n, new_left, t1);
+      return create_branch<IntegerType>(q, n, new_left, t1);
     } else {
       auto new_right = merge(s, t1);
       if (t1 == new_right) {
         return t;
       }
-      return std::make_shared<PatriciaTreeBranch<IntegerType>>(
-          q, n, t0, new_right);
+      return create_branch<IntegerType>(q, n, t0, new_right);
     }
   }
   // The prefixes disagree.
@@ -765,27 +910,50 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
 }
 
 template <typename IntegerType>
-inline std::shared_ptr<PatriciaTree<IntegerType>> intersect(
+inline std::shared_ptr<PatriciaTree<IntegerType>> merge(
     const std::shared_ptr<PatriciaTree<IntegerType>>& s,
     const std::shared_ptr<PatriciaTree<IntegerType>>& t) {
   if (s == t) {
-    // This conditional is what allows the intersection operation to complete in
+    // This conditional is what allows the union operation to complete in
     // sublinear time when the operands share some structure.
     return s;
   }
-  if (s == nullptr || t == nullptr) {
-    return nullptr;
+  if (s == nullptr) {
+    return t;
   }
-  if (s->is_leaf()) {
-    const auto& leaf =
-        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(s);
-    return contains(leaf->key(), t) ? leaf : nullptr;
+  if (t == nullptr) {
+    return s;
   }
+  // We need to check whether t is a leaf before we do the same for s.
+  // Otherwise, if s and t are both leaves, we would end up inserting s into t.
+  // This would violate the assumptions required by `reference_equals()`.
   if (t->is_leaf()) {
     const auto& leaf =
         std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(t);
-    return contains(leaf->key(), s) ? leaf : nullptr;
+    return insert(leaf->key(), s);
+  }
+  if (s->is_leaf()) {
+    const auto& leaf =
+        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(s);
+    return insert(leaf->key(), t);
+  }
+  if (!is_hash_consing()) {
+    return merge_branches(s, t);
   }
+  using Cache =
+      OperationCache<std::shared_ptr<PatriciaTree<IntegerType>>, MergeTag>;
+  std::shared_ptr<PatriciaTree<IntegerType>> result;
+  if (!Cache::lookup(s, t, &result)) {
+    result = merge_branches(s, t);
+    Cache::store(s, t, result);
+  }
+  return result;
+}
+
+template <typename IntegerType>
+inline std::shared_ptr<PatriciaTree<IntegerType>> intersect_branches(
+    const std::shared_ptr<PatriciaTree<IntegerType>>& s,
+    const std::shared_ptr<PatriciaTree<IntegerType>>& t) {
   const auto& s_branch =
       std::static_pointer_cast<PatriciaTreeBranch<IntegerType>>(s);
   const auto& t_branch =
@@ -815,6 +983,41 @@ inline std::shared_ptr<PatriciaTree<IntegerType>> intersect(
   return nullptr;
 }
 
+template <typename IntegerType>
+inline std::shared_ptr<PatriciaTree<IntegerType>> intersect(
+    const std::shared_ptr<PatriciaTree<IntegerType>>& s,
+    const std::shared_ptr<PatriciaTree<IntegerType>>& t) {
+  if (s == t) {
+    // This conditional is what allows the intersection operation to complete in
+    // sublinear time when the operands share some structure.
+    return s;
+  }
+  if (s == nullptr || t == nullptr) {
+    return nullptr;
+  }
+  if (s->is_leaf()) {
+    const auto& leaf =
+        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(s);
+    return contains(leaf->key(), t) ? leaf : nullptr;
+  }
+  if (t->is_leaf()) {
+    const auto& leaf =
+        std::static_pointer_cast<PatriciaTreeLeaf<IntegerType>>(t);
+    return contains(leaf->key(), s) ? leaf : nullptr;
+  }
+  if (!is_hash_consing()) {
+    return intersect_branches(s, t);
+  }
+  using Cache =
+      OperationCache<std::shared_ptr<PatriciaTree<IntegerType>>, IntersectTag>;
+  std::shared_ptr<PatriciaTree<IntegerType>> result;
+  if (!Cache::lookup(s, t, &result)) {
+    result = intersect_branches(s, t);
+    Cache::store(s, t, result);
+  }
+  return result;
+}
+
 template <typename IntegerType>
 inline std::shared_ptr<PatriciaTree<IntegerType>> diff(
     const std::shared_ptr<PatriciaTree<IntegerType>>& s,
@@ -962,4 +1165,8 @@ class PatriciaTreeIterator final {
 
 } // namespace pt_impl
 
+inline void set_patricia_tree_set_hash_consing(bool enabled) {
+  pt_impl::hash_consing_flag().store(enabled, std::memory_order_relaxed);
+}
+
 } // namespace sparta
@@ -7,6 +7,11 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
+
+#include <boost/functional/hash.hpp>
+
 namespace sparta {
 
 namespace pt_util {
@@ -36,6 +41,44 @@ IntegerType match_prefix(IntegerType k, IntegerType p, IntegerType m) {
   return mask(k, m) == p;
 }
 
+// A small direct-mapped cache of the results of a binary operation on pairs of
+// branch nodes, one per thread and per Tag. The entries own their operands, so
+// that a cached pointer can never be reused by another node while the entry is
+// alive.
+template <typename TreePtr, typename Tag>
+class OperationCache final {
+ public:
+  static bool lookup(const TreePtr& s, const TreePtr& t, TreePtr* result) {
+    auto& entry = slot(s, t);
+    if (entry.s == s && entry.t == t) {
+      *result = entry.result;
+      return true;
+    }
+    return false;
+  }
+
+  static void store(const TreePtr& s, const TreePtr& t, const TreePtr& result) {
+    slot(s, t) = {s, t, result};
+  }
+
+ private:
+  struct Entry {
+    TreePtr s;
+    TreePtr t;
+    TreePtr result;
+  };
+
+  static constexpr size_t kEntries = 256;
+
+  static Entry& slot(const TreePtr& s, const TreePtr& t) {
+    thread_local std::array<Entry, kEntries> t_entries;
+    size_t seed = 0;
+    boost::hash_combine(seed, s.get());
+    boost::hash_combine(seed, t.get());
+    return t_entries[seed % kEntries];
+  }
+};
+
 } // namespace pt_util
 
 } // namespace sparta
@@ -0,0 +1,653 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <ostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "AbstractDomain.h"
+
+namespace sparta {
+
+namespace sfae_impl {
+
+template <typename Variable,
+          typename Domain,
+          typename VariableHash,
+          typename VariableEqual,
+          typename VariableLess,
+          size_t kMaxFlatSize>
+class MapValue;
+
+} // namespace sfae_impl
+
+/*
+ * An abstract environment with the same semantics and interface as
+ * HashedAbstractEnvironment, tuned for the common case of environments that
+ * bind a few dozen variables.
+ *
+ * The bindings are kept in a vector sorted by variable. Copying a state is a
+ * single allocation instead of one per binding, lookups are binary searches
+ * over contiguous memory, and the lattice operations between two such states
+ * are linear merges. Once an environment grows beyond kMaxFlatSize bindings,
+ * it switches to a hashtable like HashedAbstractEnvironment, and it switches
+ * back when a join-like operation shrinks it to half that size.
+ *
+ * The variables must be ordered by VariableLess, in addition to being hashed
+ * by VariableHash. Switching a domain from HashedAbstractEnvironment only takes
+ * changing its type alias, as long as bindings() is only iterated: it returns
+ * a view whose elements expose `first` and `second` references, rather than an
+ * std::unordered_map.
+ */
+template <typename Variable,
+          typename Domain,
+          typename VariableHash = std::hash<Variable>,
+          typename VariableEqual = std::equal_to<Variable>,
+          typename VariableLess = std::less<Variable>,
+          size_t kMaxFlatSize = 64>
+class SmallFlatAbstractEnvironment final
+    : public AbstractDomainScaffolding<
+          sfae_impl::MapValue<Variable,
+                              Domain,
+                              VariableHash,
+                              VariableEqual,
+                              VariableLess,
+                              kMaxFlatSize>,
+          SmallFlatAbstractEnvironment<Variable,
+                                       Domain,
+                                       VariableHash,
+                                       VariableEqual,
+                                       VariableLess,
+                                       kMaxFlatSize>> {
+ public:
+  using Value = sfae_impl::MapValue<Variable,
+                                    Domain,
+                                    VariableHash,
+                                    VariableEqual,
+                                    VariableLess,
+                                    kMaxFlatSize>;
+
+  /*
+   * The default constructor produces the Top value.
+   */
+  SmallFlatAbstractEnvironment()
+      : AbstractDomainScaffolding<Value, SmallFlatAbstractEnvironment>() {}
+
+  SmallFlatAbstractEnvironment(AbstractValueKind kind)
+      : AbstractDomainScaffolding<Value, SmallFlatAbstractEnvironment>(kind) {}
+
+  SmallFlatAbstractEnvironment(
+      std::initializer_list<std::pair<Variable, Domain>> l) {
+    for (const auto& p : l) {
+      if (p.second.is_bottom()) {
+        this->set_to_bottom();
+        return;
+      }
+      this->get_value()->insert_binding(p.first, p.second);
+    }
+    this->normalize();
+  }
+
+  bool is_value() const { return this->kind() == AbstractValueKind::Value; }
+
+  size_t size() const {
+    RUNTIME_CHECK(this->kind() == AbstractValueKind::Value,
+                  invalid_abstract_value()
+                      << expected_kind(AbstractValueKind::Value)
+                      << actual_kind(this->kind()));
+    return this->get_value()->size();
+  }
+
+  typename Value::Bindings bindings() const {
+    RUNTIME_CHECK(this->kind() == AbstractValueKind::Value,
+                  invalid_abstract_value()
+                      << expected_kind(AbstractValueKind::Value)
+                      << actual_kind(this->kind()));
+    return this->get_value()->bindings();
+  }
+
+  Domain get(const Variable& variable) const {
+    if (this->is_bottom()) {
+      return Domain::bottom();
+    }
+    const Domain* value = this->get_value()->find(variable);
+    if (value == nullptr) {
+      return Domain::top();
+    }
+    return *value;
+  }
+
+  SmallFlatAbstractEnvironment& set(const Variable& variable,
+                                    const Domain& value) {
+    if (this->is_bottom()) {
+      return *this;
+    }
+    if (value.is_bottom()) {
+      this->set_to_bottom();
+      return *this;
+    }
+    this->get_value()->insert_binding(variable, value);
+    this->normalize();
+    return *this;
+  }
+
+  SmallFlatAbstractEnvironment& update(
+      const Variable& variable, std::function<void(Domain*)> operation) {
+    if (this->is_bottom()) {
+      return *this;
+    }
+    auto map = this->get_value();
+    // An implicit binding (variable, Top) is made explicit in order to apply
+    // the operation, and removed again below if it is still Top.
+    Domain* value = map->find_or_insert_top(variable);
+    operation(value);
+    // We normalize the abstract environment after the operation has been
+    // completed.
+    if (value->is_bottom()) {
+      this->set_to_bottom();
+      return *this;
+    }
+    if (value->is_top()) {
+      map->erase(variable);
+    } else {
+      map->maybe_grow();
+    }
+    this->normalize();
+    return *this;
+  }
+
+  static SmallFlatAbstractEnvironment bottom() {
+    return SmallFlatAbstractEnvironment(AbstractValueKind::Bottom);
+  }
+
+  static SmallFlatAbstractEnvironment top() {
+    return SmallFlatAbstractEnvironment(AbstractValueKind::Top);
+  }
+};
+
+} // namespace sparta
+
+template <typename Variable,
+          typename Domain,
+          typename VariableHash,
+          typename VariableEqual,
+          typename VariableLess,
+          size_t kMaxFlatSize>
+inline std::ostream& operator<<(
+    std::ostream& o,
+    const typename sparta::SmallFlatAbstractEnvironment<Variable,
+                                                        Domain,
+                                                        VariableHash,
+                                                        VariableEqual,
+                                                        VariableLess,
+                                                        kMaxFlatSize>& e) {
+  using namespace sparta;
+  switch (e.kind()) {
+  case AbstractValueKind::Bottom: {
+    o << "_|_";
+    break;
+  }
+  case AbstractValueKind::Top: {
+    o << "T";
+    break;
+  }
+  case AbstractValueKind::Value: {
+    o << "[#" << e.size() << "]";
+    o << "{";
+    auto bindings = e.bindings();
+    for (auto it = bindings.begin(); it != bindings.end();) {
+      o << it->first << " -> " << it->second;
+      ++it;
+      if (it != bindings.end()) {
+        o << ", ";
+      }
+    }
+    o << "}";
+    break;
+  }
+  }
+  return o;
+}
+
+namespace sparta {
+
+namespace sfae_impl {
+
+/*
+ * The bindings of a SmallFlatAbstractEnvironment, either as a vector sorted by
+ * variable or as a hashtable. As in HashedAbstractEnvironment, bindings to Top
+ * are not stored, and bindings to Bottom never are, since the whole
+ * environment is set to Bottom instead.
+ */
+template <typename Variable,
+          typename Domain,
+          typename VariableHash,
+          typename VariableEqual,
+          typename VariableLess,
+          size_t kMaxFlatSize>
+class MapValue final : public AbstractValue<MapValue<Variable,
+                                                     Domain,
+                                                     VariableHash,
+                                                     VariableEqual,
+                                                     VariableLess,
+                                                     kMaxFlatSize>> {
+  using FlatMap = std::vector<std::pair<Variable, Domain>>;
+  using HashMap =
+      std::unordered_map<Variable, Domain, VariableHash, VariableEqual>;
+
+ public:
+  /*
+   * A forward iterator over the bindings, whichever the representation. It
+   * yields pairs of references to the variable and its value.
+   */
+  class BindingIterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::pair<const Variable&, const Domain&>;
+    using difference_type = std::ptrdiff_t;
+    using reference = value_type;
+
+    struct pointer {
+      value_type binding;
+      const value_type* operator->() const { return &binding; }
+    };
+
+    BindingIterator(typename FlatMap::const_iterator it)
+        : m_hashed(false), m_flat_it(it) {}
+
+    BindingIterator(typename HashMap::const_iterator it)
+        : m_hashed(true), m_hash_it(it) {}
+
+    reference operator*() const {
+      return m_hashed ? reference(m_hash_it->first, m_hash_it->second)
+                      : reference(m_flat_it->first, m_flat_it->second);
+    }
+
+    pointer operator->() const { return pointer{**this}; }
+
+    BindingIterator& operator++() {
+      if (m_hashed) {
+        ++m_hash_it;
+      } else {
+        ++m_flat_it;
+      }
+      return *this;
+    }
+
+    BindingIterator operator++(int) {
+      BindingIterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    bool operator==(const BindingIterator& other) const {
+      return m_hashed ? m_hash_it == other.m_hash_it
+                      : m_flat_it == other.m_flat_it;
+    }
+
+    bool operator!=(const BindingIterator& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    bool m_hashed;
+    typename FlatMap::const_iterator m_flat_it;
+    typename HashMap::const_iterator m_hash_it;
+  };
+
+  class Bindings {
+   public:
+    Bindings(BindingIterator begin, BindingIterator end)
+        : m_begin(begin), m_end(end) {}
+    BindingIterator begin() const { return m_begin; }
+    BindingIterator end() const { return m_end; }
+
+   private:
+    BindingIterator m_begin;
+    BindingIterator m_end;
+  };
+
+  MapValue() = default;
+
+  MapValue(const Variable& variable, const Domain& value) {
+    insert_binding(variable, value);
+  }
+
+  void clear() override {
+    m_flat.clear();
+    m_hash.clear();
+    m_hashed = false;
+  }
+
+  AbstractValueKind kind() const override {
+    // If the map is empty, then all variables are implicitly bound to Top,
+    // i.e., the abstract environment itself is Top.
+    return (size() == 0) ? AbstractValueKind::Top : AbstractValueKind::Value;
+  }
+
+  size_t size() const { return m_hashed ? m_hash.size() : m_flat.size(); }
+
+  Bindings bindings() const {
+    if (m_hashed) {
+      return Bindings(BindingIterator(m_hash.cbegin()),
+                      BindingIterator(m_hash.cend()));
+    }
+    return Bindings(BindingIterator(m_flat.cbegin()),
+                    BindingIterator(m_flat.cend()));
+  }
+
+  const Domain* find(const Variable& variable) const {
+    if (m_hashed) {
+      auto it = m_hash.find(variable);
+      return it == m_hash.end() ? nullptr : &it->second;
+    }
+    auto it = flat_lower_bound(variable);
+    if (it == m_flat.end() || VariableLess()(variable, it->first)) {
+      return nullptr;
+    }
+    return &it->second;
+  }
+
+  bool leq(const MapValue& other) const override {
+    if (other.size() > size()) {
+      // In this case, there is a variable bound to a non-Top value in 'other'
+      // that is not defined in 'this' (and is therefore implicitly bound to
+      // Top).
+      return false;
+    }
+    if (!m_hashed && !other.m_hashed) {
+      auto it = m_flat.begin();
+      for (const auto& other_binding : other.m_flat) {
+        // Variables only bound in 'this' are Top in 'other'.
+        while (it != m_flat.end() &&
+               VariableLess()(it->first, other_binding.first)) {
+          ++it;
+        }
+        if (it == m_flat.end() ||
+            VariableLess()(other_binding.first, it->first) ||
+            !it->second.leq(other_binding.second)) {
+          return false;
+        }
+        ++it;
+      }
+      return true;
+    }
+    for (const auto& binding : bindings()) {
+      const Domain* other_value = other.find(binding.first);
+      if (other_value != nullptr && !binding.second.leq(*other_value)) {
+        return false;
+      }
+    }
+    for (const auto& other_binding : other.bindings()) {
+      if (find(other_binding.first) == nullptr) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool equals(const MapValue& other) const override {
+    if (size() != other.size()) {
+      return false;
+    }
+    if (!m_hashed && !other.m_hashed) {
+      for (size_t i = 0; i < m_flat.size(); ++i) {
+        const auto& binding = m_flat[i];
+        const auto& other_binding = other.m_flat[i];
+        if (VariableLess()(binding.first, other_binding.first) ||
+            VariableLess()(other_binding.first, binding.first) ||
+            !binding.second.equals(other_binding.second)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    for (const auto& binding : bindings()) {
+      const Domain* other_value = other.find(binding.first);
+      if (other_value == nullptr || !binding.second.equals(*other_value)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  AbstractValueKind join_with(const MapValue& other) override {
+    return join_like_operation(
+        other, [](Domain* x, const Domain& y) { x->join_with(y); });
+  }
+
+  AbstractValueKind widen_with(const MapValue& other) override {
+    return join_like_operation(
+        other, [](Domain* x, const Domain& y) { x->widen_with(y); });
+  }
+
+  AbstractValueKind meet_with(const MapValue& other) override {
+    return meet_like_operation(
+        other, [](Domain* x, const Domain& y) { x->meet_with(y); });
+  }
+
+  AbstractValueKind narrow_with(const MapValue& other) override {
+    return meet_like_operation(
+        other, [](Domain* x, const Domain& y) { x->narrow_with(y); });
+  }
+
+ private:
+  typename FlatMap::const_iterator flat_lower_bound(
+      const Variable& variable) const {
+    return std::lower_bound(
+        m_flat.begin(), m_flat.end(), variable,
+        [](const std::pair<Variable, Domain>& binding,
+           const Variable& variable) {
+          return VariableLess()(binding.first, variable);
+        });
+  }
+
+  typename FlatMap::iterator flat_lower_bound(const Variable& variable) {
+    auto it = static_cast<const MapValue*>(this)->flat_lower_bound(variable);
+    return m_flat.begin() + (it - m_flat.cbegin());
+  }
+
+  void insert_binding(const Variable& variable, const Domain& value) {
+    // The Bottom value is handled in SmallFlatAbstractEnvironment and should
+    // never occur here.
+    RUNTIME_CHECK(!value.is_bottom(), internal_error());
+    if (value.is_top()) {
+      // Bindings with the Top value are not explicitly represented.
+      erase(variable);
+      return;
+    }
+    *find_or_insert_top(variable) = value;
+    maybe_grow();
+  }
+
+  // Returns the binding of `variable`, after binding it to Top if it was not
+  // bound. The pointer is valid until the next insertion.
+  Domain* find_or_insert_top(const Variable& variable) {
+    if (m_hashed) {
+      auto it = m_hash.find(variable);
+      if (it != m_hash.end()) {
+        return &it->second;
+      }
+      Domain* value = &m_hash[variable];
+      value->set_to_top();
+      return value;
+    }
+    auto it = flat_lower_bound(variable);
+    if (it == m_flat.end() || VariableLess()(variable, it->first)) {
+      it = m_flat.emplace(it, variable, Domain::top());
+    }
+    return &it->second;
+  }
+
+  void erase(const Variable& variable) {
+    if (m_hashed) {
+      m_hash.erase(variable);
+      return;
+    }
+    auto it = flat_lower_bound(variable);
+    if (it != m_flat.end() && !VariableLess()(variable, it->first)) {
+      m_flat.erase(it);
+    }
+  }
+
+  void maybe_grow() {
+    if (!m_hashed && m_flat.size() > kMaxFlatSize) {
+      switch_to_hashed();
+    }
+  }
+
+  void switch_to_hashed() {
+    m_hash.reserve(m_flat.size());
+    for (auto& binding : m_flat) {
+      m_hash.emplace(std::move(binding.first), std::move(binding.second));
+    }
+    m_flat = FlatMap();
+    m_hashed = true;
+  }
+
+  void maybe_shrink() {
+    if (!m_hashed || m_hash.size() > kMaxFlatSize / 2) {
+      return;
+    }
+    m_flat.reserve(m_hash.size());
+    for (auto& binding : m_hash) {
+      m_flat.emplace_back(binding.first, std::move(binding.second));
+    }
+    std::sort(m_flat.begin(), m_flat.end(),
+              [](const std::pair<Variable, Domain>& x,
+                 const std::pair<Variable, Domain>& y) {
+                return VariableLess()(x.first, y.first);
+              });
+    m_hash = HashMap();
+    m_hashed = false;
+  }
+
+  AbstractValueKind join_like_operation(
+      const MapValue& other,
+      std::function<void(Domain*, const Domain&)> operation) {
+    if (m_hashed) {
+      for (auto it = m_hash.begin(); it != m_hash.end();) {
+        const Domain* other_value = other.find(it->first);
+        if (other_value != nullptr) {
+          operation(&it->second, *other_value);
+        }
+        if (other_value == nullptr || it->second.is_top()) {
+          // The other value is Top, or the result is Top: we erase the
+          // binding.
+          it = m_hash.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      maybe_shrink();
+      return kind();
+    }
+    // We compact the vector in place, keeping the bindings that are not Top.
+    auto out = m_flat.begin();
+    auto other_it = other.m_flat.begin();
+    for (auto it = m_flat.begin(); it != m_flat.end(); ++it) {
+      const Domain* other_value;
+      if (other.m_hashed) {
+        other_value = other.find(it->first);
+      } else {
+        while (other_it != other.m_flat.end() &&
+               VariableLess()(other_it->first, it->first)) {
+          ++other_it;
+        }
+        other_value = (other_it == other.m_flat.end() ||
+                       VariableLess()(it->first, other_it->first))
+                          ? nullptr
+                          : &other_it->second;
+      }
+      if (other_value == nullptr) {
+        continue;
+      }
+      operation(&it->second, *other_value);
+      if (it->second.is_top()) {
+        continue;
+      }
+      if (out != it) {
+        *out = std::move(*it);
+      }
+      ++out;
+    }
+    m_flat.erase(out, m_flat.end());
+    return kind();
+  }
+
+  AbstractValueKind meet_like_operation(
+      const MapValue& other,
+      std::function<void(Domain*, const Domain&)> operation) {
+    if (m_hashed || other.m_hashed) {
+      // The result is at least as large as `other`, so we switch to the
+      // hashtable rather than insert its bindings one by one into the vector.
+      if (!m_hashed) {
+        switch_to_hashed();
+      }
+      for (const auto& other_binding : other.bindings()) {
+        Domain* value = find_or_insert_top(other_binding.first);
+        // Top is the identity for meet-like operations.
+        operation(value, other_binding.second);
+        if (value->is_bottom()) {
+          // If the result is Bottom, the entire environment becomes Bottom.
+          clear();
+          return AbstractValueKind::Bottom;
+        }
+      }
+      return kind();
+    }
+    FlatMap result;
+    result.reserve(m_flat.size() + other.m_flat.size());
+    auto it = m_flat.begin();
+    auto other_it = other.m_flat.begin();
+    while (it != m_flat.end() || other_it != other.m_flat.end()) {
+      if (other_it == other.m_flat.end() ||
+          (it != m_flat.end() && VariableLess()(it->first, other_it->first))) {
+        result.push_back(std::move(*it++));
+      } else if (it == m_flat.end() ||
+                 VariableLess()(other_it->first, it->first)) {
+        result.push_back(*other_it++);
+      } else {
+        // We compute the meet-like combination of the values.
+        operation(&it->second, other_it->second);
+        if (it->second.is_bottom()) {
+          clear();
+          return AbstractValueKind::Bottom;
+        }
+        result.push_back(std::move(*it++));
+        ++other_it;
+      }
+    }
+    m_flat = std::move(result);
+    maybe_grow();
+    return kind();
+  }
+
+  bool m_hashed{false};
+  FlatMap m_flat;
+  HashMap m_hash;
+
+  template <typename T1,
+            typename T2,
+            typename T3,
+            typename T4,
+            typename T5,
+            size_t N>
+  friend class sparta::SmallFlatAbstractEnvironment;
+};
+
+} // namespace sfae_impl
+
+} // namespace sparta
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "BitVectorSetAbstractDomain.h"
+
+#include <cstdint>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace sparta;
+
+using Domain = BitVectorSetAbstractDomain<uint16_t>;
+
+TEST(BitVectorSetAbstractDomainTest, latticeOperations) {
+  Domain e1(16);
+  Domain e2(16);
+  Domain e3(16);
+  e1.add(1);
+  e2.add({1, 2, 3});
+  e3.add({2, 3, 4});
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1));
+  EXPECT_THAT(e2.elements(), ::testing::ElementsAre(1, 2, 3));
+  EXPECT_THAT(e3.elements(), ::testing::ElementsAre(2, 3, 4));
+  e3.add(4);
+  EXPECT_EQ(e3.size(), 3);
+
+  std::ostringstream out;
+  out << e2;
+  EXPECT_EQ("[#3]{1, 2, 3}", out.str());
+
+  EXPECT_TRUE(Domain::bottom().leq(Domain::top()));
+  EXPECT_FALSE(Domain::top().leq(Domain::bottom()));
+  EXPECT_FALSE(e2.is_top());
+  EXPECT_FALSE(e2.is_bottom());
+
+  EXPECT_TRUE(e1.leq(e2));
+  EXPECT_FALSE(e1.leq(e3));
+  EXPECT_FALSE(e2.leq(e1));
+  EXPECT_TRUE(e2.equals(Domain({3, 2, 1})));
+  EXPECT_FALSE(e2.equals(e3));
+
+  EXPECT_THAT(e2.join(e3).elements(), ::testing::ElementsAre(1, 2, 3, 4));
+  EXPECT_TRUE(e1.join(e2).equals(e2));
+  EXPECT_TRUE(e2.join(Domain::bottom()).equals(e2));
+  EXPECT_TRUE(e2.join(Domain::top()).is_top());
+  EXPECT_TRUE(e1.widening(e2).equals(e2));
+
+  EXPECT_THAT(e2.meet(e3).elements(), ::testing::ElementsAre(2, 3));
+  EXPECT_TRUE(e1.meet(e2).equals(e1));
+  EXPECT_TRUE(e2.meet(Domain::bottom()).is_bottom());
+  EXPECT_TRUE(e2.meet(Domain::top()).equals(e2));
+  EXPECT_TRUE(e1.meet(e3).elements().empty());
+  EXPECT_TRUE(e1.narrowing(e2).equals(e1));
+
+  // Making sure no side effect happened.
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1));
+  EXPECT_THAT(e2.elements(), ::testing::ElementsAre(1, 2, 3));
+  EXPECT_THAT(e3.elements(), ::testing::ElementsAre(2, 3, 4));
+}
+
+TEST(BitVectorSetAbstractDomainTest, differentSizes) {
+  // The sets grow past their initial size, and the words that one set has
+  // and the other doesn't count as empty.
+  Domain small;
+  Domain large(300);
+  small.add(3);
+  large.add({3, 64, 299});
+  EXPECT_TRUE(small.leq(large));
+  EXPECT_FALSE(large.leq(small));
+  EXPECT_TRUE(small.equals(Domain({3})));
+  EXPECT_TRUE(Domain(300).equals(Domain()));
+
+  small.add(200);
+  EXPECT_TRUE(small.contains(200));
+  EXPECT_FALSE(small.contains(1000));
+  EXPECT_THAT(small.join(large).elements(),
+              ::testing::ElementsAre(3, 64, 200, 299));
+  EXPECT_THAT(large.meet(small).elements(), ::testing::ElementsAre(3));
+
+  small.remove(200);
+  small.remove(1000);
+  EXPECT_TRUE(small.equals(Domain({3})));
+}
+
+TEST(BitVectorSetAbstractDomainTest, difference) {
+  Domain e1({1, 2, 3, 70});
+  Domain e2({2, 70, 100});
+  e1.difference_with(e2);
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1, 3));
+
+  e1.difference_with(Domain::bottom());
+  EXPECT_THAT(e1.elements(), ::testing::ElementsAre(1, 3));
+  Domain top = Domain::top();
+  top.difference_with(e2);
+  EXPECT_TRUE(top.is_top());
+  e1.difference_with(Domain::top());
+  EXPECT_TRUE(e1.elements().empty());
+}
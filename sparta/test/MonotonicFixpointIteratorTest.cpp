@@ -360,3 +360,20 @@ TEST_F(MonotonicFixpointIteratorTest, program2) {
   ASSERT_TRUE(fp.get_live_in_vars_at("7").is_bottom());
   ASSERT_TRUE(fp.get_live_out_vars_at("7").is_bottom());
 }
+
+TEST_F(MonotonicFixpointIteratorTest, budget) {
+  FixpointEngine fp(this->m_program1);
+  // Program 1 has 6 statements, and its loop needs more than one iteration.
+  fp.set_budget(6);
+  fp.run(LivenessDomain());
+  EXPECT_TRUE(fp.budget_exceeded());
+  EXPECT_TRUE(fp.get_live_in_vars_at("1").is_top());
+  EXPECT_TRUE(fp.get_live_out_vars_at("6").is_top());
+
+  // A new run starts with the full budget again.
+  fp.set_budget(100);
+  fp.run(LivenessDomain());
+  EXPECT_FALSE(fp.budget_exceeded());
+  EXPECT_THAT(fp.get_live_in_vars_at("1").elements(),
+              ::testing::UnorderedElementsAre("c"));
+}
@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ParallelMonotonicFixpointIterator.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "HashedSetAbstractDomain.h"
+#include "MonotonicFixpointIterator.h"
+
+using namespace sparta;
+
+/*
+ * A graph whose nodes are strings. The analysis below computes, for every
+ * node, the set of nodes that lie on some path from the entry to it.
+ */
+class StringGraph final {
+ public:
+  using Edge = std::pair<std::string, std::string>;
+  using EdgeId = std::shared_ptr<Edge>;
+
+  explicit StringGraph(const std::string& entry) : m_entry(entry) {
+    m_successors[entry];
+    m_predecessors[entry];
+  }
+
+  void add_edge(const std::string& src, const std::string& dst) {
+    auto edge = std::make_shared<Edge>(src, dst);
+    m_successors[src].push_back(edge);
+    m_successors[dst];
+    m_predecessors[dst].push_back(edge);
+    m_predecessors[src];
+  }
+
+ private:
+  std::string m_entry;
+  std::unordered_map<std::string, std::vector<EdgeId>> m_successors;
+  std::unordered_map<std::string, std::vector<EdgeId>> m_predecessors;
+
+  friend class StringGraphInterface;
+};
+
+class StringGraphInterface {
+ public:
+  using Graph = StringGraph;
+  using NodeId = std::string;
+  using EdgeId = StringGraph::EdgeId;
+
+  static NodeId entry(const Graph& graph) { return graph.m_entry; }
+  static std::vector<EdgeId> predecessors(const Graph& graph,
+                                          const NodeId& node) {
+    return graph.m_predecessors.at(node);
+  }
+  static std::vector<EdgeId> successors(const Graph& graph,
+                                        const NodeId& node) {
+    return graph.m_successors.at(node);
+  }
+  static NodeId source(const Graph&, const EdgeId& e) { return e->first; }
+  static NodeId target(const Graph&, const EdgeId& e) { return e->second; }
+};
+
+using PathDomain = HashedSetAbstractDomain<std::string>;
+
+template <typename Base>
+class PathAnalysis final : public Base {
+ public:
+  template <typename... Args>
+  explicit PathAnalysis(Args&&... args) : Base(std::forward<Args>(args)...) {}
+
+  void analyze_node(const std::string& node,
+                    PathDomain* current_state) const override {
+    if (node == "throw") {
+      throw std::runtime_error("analyze_node");
+    }
+    current_state->add(node);
+  }
+
+  PathDomain analyze_edge(
+      const StringGraph::EdgeId&,
+      const PathDomain& exit_state_at_source) const override {
+    return exit_state_at_source;
+  }
+};
+
+using SequentialPathAnalysis = PathAnalysis<
+    MonotonicFixpointIterator<StringGraphInterface, PathDomain>>;
+using ParallelPathAnalysis = PathAnalysis<
+    ParallelMonotonicFixpointIterator<StringGraphInterface, PathDomain>>;
+
+/*
+ * The entry fans out into many independent branches, each one with a loop,
+ * which then all meet again at a single exit.
+ */
+StringGraph make_fan_graph(size_t branches) {
+  StringGraph graph("entry");
+  for (size_t i = 0; i < branches; ++i) {
+    auto head = "head" + std::to_string(i);
+    auto body = "body" + std::to_string(i);
+    auto tail = "tail" + std::to_string(i);
+    graph.add_edge("entry", head);
+    graph.add_edge(head, body);
+    graph.add_edge(body, head);
+    graph.add_edge(head, tail);
+    graph.add_edge(tail, "exit");
+    if (i > 0 && i % 3 == 0) {
+      // Some branches also depend on the previous one.
+      graph.add_edge("tail" + std::to_string(i - 1), head);
+    }
+  }
+  return graph;
+}
+
+// Runs every worker on a thread of its own.
+void run_on_threads(size_t n, const std::function<void(size_t)>& fn) {
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < n; ++i) {
+    threads.emplace_back(fn, i);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+TEST(ParallelMonotonicFixpointIteratorTest, sameResultAsSequential) {
+  const size_t branches = 32;
+  auto graph = make_fan_graph(branches);
+  PathDomain init({"init"});
+
+  SequentialPathAnalysis sequential(graph);
+  sequential.run(init);
+  ParallelPathAnalysis parallel(graph, /* num_workers */ 4, run_on_threads);
+  parallel.run(init);
+  // By default, the workers run one after the other on the calling thread.
+  ParallelPathAnalysis sequential_workers(graph, /* num_workers */ 4);
+  sequential_workers.run(init);
+
+  std::vector<std::string> nodes{"entry", "exit"};
+  for (size_t i = 0; i < branches; ++i) {
+    for (auto prefix : {"head", "body", "tail"}) {
+      nodes.push_back(prefix + std::to_string(i));
+    }
+  }
+  for (const auto& node : nodes) {
+    EXPECT_TRUE(
+        parallel.get_entry_state_at(node).equals(
+            sequential.get_entry_state_at(node)))
+        << node;
+    EXPECT_TRUE(parallel.get_exit_state_at(node).equals(
+        sequential.get_exit_state_at(node)))
+        << node;
+    EXPECT_TRUE(sequential_workers.get_exit_state_at(node).equals(
+        sequential.get_exit_state_at(node)))
+        << node;
+  }
+  EXPECT_EQ(parallel.get_exit_state_at("exit").size(), 3 * branches + 3);
+  EXPECT_TRUE(parallel.get_entry_state_at("unknown").is_bottom());
+
+  // Running again starts from scratch.
+  parallel.run(PathDomain::bottom());
+  EXPECT_TRUE(parallel.get_exit_state_at("exit").is_bottom());
+}
+
+TEST(ParallelMonotonicFixpointIteratorTest, exceptionIsPropagated) {
+  auto graph = make_fan_graph(8);
+  graph.add_edge("tail5", "throw");
+  ParallelPathAnalysis parallel(graph, /* num_workers */ 4, run_on_threads);
+  EXPECT_THROW(parallel.run(PathDomain()), std::runtime_error);
+}
@@ -44,3 +44,68 @@ TEST(PatriciaTreeMapTest, basicOperations) {
 
   EXPECT_EQ(m1.at(1000000), default_value);
 }
+
+TEST(PatriciaTreeMapTest, hashConsing) {
+  struct MaxTag;
+  struct MinTag;
+  auto max = [](const uint32_t& x, const uint32_t& y) {
+    return std::max(x, y);
+  };
+  auto min = [](const uint32_t& x, const uint32_t& y) {
+    return std::min(x, y);
+  };
+  std::vector<std::pair<uint32_t, uint32_t>> pairs1;
+  std::vector<std::pair<uint32_t, uint32_t>> pairs2;
+  for (uint32_t k = 0; k < 100; ++k) {
+    pairs1.emplace_back(k * 7, k % 5 + 1);
+    pairs2.emplace_back(k * 3, k % 3 + 1);
+  }
+
+  set_patricia_tree_map_hash_consing(true);
+  {
+    pt_map m1;
+    for (const auto& p : pairs1) {
+      m1.insert_or_assign(p.first, p.second);
+    }
+    // The same map built in a different order is the same tree.
+    pt_map m1_reversed;
+    for (auto it = pairs1.rbegin(); it != pairs1.rend(); ++it) {
+      m1_reversed.insert_or_assign(it->first, it->second);
+    }
+    EXPECT_TRUE(m1_reversed.reference_equals(m1));
+
+    pt_map m2;
+    for (const auto& p : pairs2) {
+      m2.insert_or_assign(p.first, p.second);
+    }
+    auto u = m1;
+    u.memoized_union_with<MaxTag>(max, m2);
+    EXPECT_TRUE(u.equals(m1.get_union_with(max, m2)));
+    auto v = m2;
+    v.memoized_union_with<MaxTag>(max, m1);
+    EXPECT_TRUE(u.reference_equals(v));
+    // The memoized result is the same as the one computed from scratch.
+    auto u_again = m1;
+    u_again.memoized_union_with<MaxTag>(max, m2);
+    EXPECT_TRUE(u_again.reference_equals(u));
+
+    auto i = m1;
+    i.memoized_intersection_with<MinTag>(min, m2);
+    EXPECT_TRUE(i.equals(m1.get_intersection_with(min, m2)));
+    auto j = m2;
+    j.memoized_intersection_with<MinTag>(min, m1);
+    EXPECT_TRUE(i.reference_equals(j));
+    EXPECT_EQ(i.size(), 15);
+  }
+  set_patricia_tree_map_hash_consing(false);
+
+  // Maps built while hash-consing is off are still compared structurally.
+  pt_map m1;
+  pt_map m2;
+  for (const auto& p : pairs1) {
+    m1.insert_or_assign(p.first, p.second);
+    m2.insert_or_assign(p.first, p.second);
+  }
+  EXPECT_FALSE(m1.reference_equals(m2));
+  EXPECT_TRUE(m1.equals(m2));
+}
@@ -296,3 +296,50 @@ TEST_F(PatriciaTreeSetTest, setsOfPointers) {
   out << t;
   EXPECT_EQ("{a}", out.str());
 }
+
+TEST_F(PatriciaTreeSetTest, hashConsing) {
+  set_patricia_tree_set_hash_consing(true);
+  {
+    for (size_t k = 0; k < 10; ++k) {
+      pt_set s1 = this->generate_random_set();
+      pt_set s2 = this->generate_random_set();
+      std::vector<uint32_t> elems(s1.begin(), s1.end());
+
+      // The same set built in a different order is the same tree.
+      pt_set t1;
+      for (auto it = elems.rbegin(); it != elems.rend(); ++it) {
+        t1.insert(*it);
+      }
+      EXPECT_TRUE(t1.reference_equals(s1));
+
+      pt_set u = s1.get_union_with(s2);
+      pt_set v = s2.get_union_with(s1);
+      EXPECT_TRUE(u.reference_equals(v));
+      // The memoized result is the same as the one computed from scratch.
+      EXPECT_TRUE(s1.get_union_with(s2).reference_equals(u));
+      EXPECT_THAT(std::vector<uint32_t>(u.begin(), u.end()),
+                  ::testing::UnorderedElementsAreArray(get_union(
+                      elems, std::vector<uint32_t>(s2.begin(), s2.end()))));
+
+      pt_set i = s1.get_intersection_with(s2);
+      EXPECT_TRUE(i.reference_equals(s2.get_intersection_with(s1)));
+      EXPECT_THAT(
+          std::vector<uint32_t>(i.begin(), i.end()),
+          ::testing::UnorderedElementsAreArray(get_intersection(
+              elems, std::vector<uint32_t>(s2.begin(), s2.end()))));
+
+      pt_set d = u.get_difference_with(s2);
+      EXPECT_TRUE(d.reference_equals(s1.get_difference_with(s2)));
+    }
+  }
+  set_patricia_tree_set_hash_consing(false);
+
+  // Sets built while hash-consing is off are still compared structurally
+  // with interned ones.
+  pt_set s1 = this->generate_random_set();
+  pt_set s2;
+  for (uint32_t x : s1) {
+    s2.insert(x);
+  }
+  EXPECT_TRUE(s1.equals(s2));
+}
@@ -15,6 +15,9 @@ public class InstrumentAnalysis {
 
   private static int sMethodCount = 0; // Redex will patch
   private static final int[] sMethodStats = new int[0]; // Redex will patch
+  // Only used by the sampled modes; Redex will patch.
+  private static final int[] sMethodCounters = new int[0];
+  private static final int[] sMethodBitmap = new int[0];
 
   public static void onMethodBegin(int index) {
     ++sMethodStats[index];
@@ -6,9 +6,23 @@
  */
 package com.facebook.redextest;
 
+import java.io.PrintStream;
+
 public class InstrumentBasicBlockAnalysis {
 
   private static final int[] sBasicBlockStats = new int[0];
+  // Only used by basic_block_coverage; Redex will patch.
+  private static final boolean[] sBasicBlockCoverage = new boolean[0];
+
+  // Prints the index of every covered block. The metadata file maps the start
+  // of each method's slice to the method.
+  public static void dumpBasicBlockCoverage(PrintStream out) {
+    for (int i = 0; i < sBasicBlockCoverage.length; i++) {
+      if (sBasicBlockCoverage[i]) {
+        out.println(i);
+      }
+    }
+  }
 
   public static void onMethodExitBB(int methodId, int bbVector) {
     sBasicBlockStats[methodId] |= bbVector;
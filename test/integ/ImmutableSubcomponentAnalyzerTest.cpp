@@ -197,6 +197,56 @@ TEST(ImmutableSubcomponentAnalyzerTest, blockSnapshot) {
   delete g_redex;
 }
 
+TEST(ImmutableSubcomponentAnalyzerTest, blockSnapshotOfInstructions) {
+  g_redex = new RedexContext();
+  auto method = make_ir_test_method();
+  auto code = method->get_code();
+
+  auto get_a = DexMethod::make_method(
+    "Lcom/facebook/Structure;.getA:()Lcom/facebook/A;");
+  AccessPath path_a{AccessPathKind::Parameter, 1, {get_a}};
+
+  ImmutableSubcomponentAnalyzer analyzer(method, is_immutable_getter);
+  std::vector<IRInstruction*> queried;
+  for (const auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    if (insn->has_method() && strcmp(insn->get_method()->c_str(), "baz") == 0) {
+      queried.push_back(insn);
+    }
+  }
+  ASSERT_EQ(queried.size(), 1);
+  auto snapshot = analyzer.get_block_state_snapshot(queried);
+  ASSERT_EQ(snapshot.size(), 1);
+  ASSERT_EQ(snapshot.count(1), 1);
+  EXPECT_EQ(snapshot[1].entry_state_bindings[0], path_a);
+  EXPECT_EQ(snapshot[1].exit_state_bindings[1], path_a);
+
+  delete g_redex;
+}
+
+TEST(ImmutableSubcomponentAnalyzerTest, queriesAcrossBlocks) {
+  g_redex = new RedexContext();
+  auto method = make_ir_test_method();
+  auto code = method->get_code();
+  ImmutableSubcomponentAnalyzer analyzer(method, is_immutable_getter);
+
+  std::vector<IRInstruction*> insns;
+  for (const auto& mie : InstructionIterable(code)) {
+    insns.push_back(mie.insn);
+  }
+  std::vector<boost::optional<AccessPath>> forward;
+  for (auto insn : insns) {
+    forward.push_back(analyzer.get_access_path(0, insn));
+  }
+  // Querying the instructions in reverse order repeatedly switches between
+  // blocks, which must not affect the results.
+  for (size_t i = insns.size(); i > 0; --i) {
+    EXPECT_EQ(analyzer.get_access_path(0, insns[i - 1]), forward[i - 1]);
+  }
+
+  delete g_redex;
+}
+
 TEST(ImmutableSubcomponentAnalyzerTest, accessPathEquality) {
   g_redex = new RedexContext();
   AccessPath p0{AccessPathKind::Parameter, 0};
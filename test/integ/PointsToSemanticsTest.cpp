@@ -375,5 +375,18 @@ TEST(PointsToSemanticsTest, semanticActionGeneration) {
   }
   EXPECT_THAT(deserialization, ::testing::ContainerEq(method_semantics));
 
+  // Testing the binary serialization mechanism.
+  std::stringstream binary_serialization;
+  pt_semantics.write_binary(binary_serialization);
+  PointsToSemantics binary_semantics(scope, binary_serialization);
+  std::set<std::string> binary_deserialization;
+  for (const auto& pt_entry : binary_semantics) {
+    std::ostringstream out;
+    out << pt_entry.second;
+    binary_deserialization.insert(out.str());
+  }
+  EXPECT_THAT(binary_deserialization,
+              ::testing::ContainerEq(method_semantics));
+
   delete g_redex;
 }
@@ -386,3 +386,28 @@ TEST(AliasedRegistersTest, CopyOnWriteDomain) {
     EXPECT_FALSE(a.are_aliases(zero, one));
   });
 }
+
+TEST(AliasedRegistersTest, JoinSplitsGroups) {
+  AliasedRegisters a;
+  a.move(one, zero);
+  a.move(two, zero);
+  a.move(three, zero);
+
+  AliasedRegisters b;
+  b.move(one, zero);
+  b.move(three, two);
+
+  // {0, 1, 2, 3} and {0, 1}, {2, 3} have {0, 1} and {2, 3} in common.
+  a.join_with(b);
+  EXPECT_TRUE(a.are_aliases(zero, one));
+  EXPECT_TRUE(a.are_aliases(two, three));
+  EXPECT_FALSE(a.are_aliases(zero, two));
+  EXPECT_EQ(0, a.get_representative(one));
+  EXPECT_EQ(2, a.get_representative(three));
+  EXPECT_TRUE(a.equals(b));
+
+  // Breaking up the last pair of a group leaves no aliases behind.
+  a.break_alias(one);
+  a.break_alias(three);
+  EXPECT_EQ(AbstractValueKind::Top, a.kind());
+}
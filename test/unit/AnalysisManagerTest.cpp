@@ -0,0 +1,57 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "AnalysisManager.h"
+#include "DexUtil.h"
+#include "ScopeHelper.h"
+#include "TypeSystem.h"
+
+TEST(AnalysisManager, cachedUntilInvalidated) {
+  g_redex = new RedexContext();
+  auto scope = create_empty_scope();
+  auto a_t = DexType::make_type("LA;");
+  auto a_cls = create_internal_class(a_t, get_object_type(), {});
+  scope.push_back(a_cls);
+  auto void_void =
+      DexProto::make_proto(get_void_type(), DexTypeList::make_type_list({}));
+  create_empty_method(a_cls, "f", void_void);
+
+  AnalysisManager analyses;
+  EXPECT_FALSE(analyses.is_cached(analysis::TYPE_SYSTEM));
+  const auto* ts = &analyses.type_system(scope);
+  const auto* sig_map = &analyses.signature_map(scope);
+  analyses.method_override_graph(scope);
+  EXPECT_TRUE(analyses.is_cached(analysis::TYPE_SYSTEM));
+  EXPECT_TRUE(analyses.is_cached(analysis::SIGNATURE_MAP));
+  EXPECT_TRUE(analyses.is_cached(analysis::METHOD_OVERRIDE_GRAPH));
+  EXPECT_FALSE(analyses.is_cached(analysis::CLASS_HIERARCHY));
+  EXPECT_EQ(&analyses.type_system(scope), ts);
+  EXPECT_EQ(&analyses.signature_map(scope), sig_map);
+
+  // Only what is not preserved goes away.
+  analyses.invalidate(~analysis::SIGNATURE_MAP);
+  EXPECT_FALSE(analyses.is_cached(analysis::TYPE_SYSTEM));
+  EXPECT_FALSE(analyses.is_cached(analysis::METHOD_OVERRIDE_GRAPH));
+  EXPECT_TRUE(analyses.is_cached(analysis::SIGNATURE_MAP));
+
+  // A new method in the hierarchy shows up once the map is invalidated.
+  auto b_t = DexType::make_type("LB;");
+  auto b_cls = create_internal_class(b_t, a_t, {});
+  scope.push_back(b_cls);
+  auto b_f = create_empty_method(b_cls, "f", void_void);
+  analyses.invalidate(analysis::ALL);
+  const auto& scopes = analyses.signature_map(scope)
+                           .at(b_f->get_name())
+                           .at(b_f->get_proto());
+  ASSERT_FALSE(scopes.empty());
+  EXPECT_EQ(scopes[0].methods.size(), 2);
+  EXPECT_EQ(analyses.class_hierarchy(scope).at(a_t).count(b_t), 1);
+
+  delete g_redex;
+}
@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "AnnoKill.h"
+#include "Creators.h"
+#include "DexAnnotation.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+struct AnnoKillTest : public RedexTest {};
+
+namespace {
+
+DexAnnotationSet* make_aset(std::initializer_list<const char*> types) {
+  auto aset = new DexAnnotationSet();
+  for (auto type : types) {
+    aset->add_annotation(
+        new DexAnnotation(DexType::make_type(type), DAV_BUILD));
+  }
+  return aset;
+}
+
+} // namespace
+
+TEST_F(AnnoKillTest, killAnnotations) {
+  // Enough classes to be cleaned up on several threads. Each one has a class,
+  // a method and a field annotation.
+  constexpr size_t NUM_CLASSES = 64;
+  Scope scope;
+  std::vector<DexMethod*> methods;
+  std::vector<DexField*> fields;
+  for (size_t i = 0; i < NUM_CLASSES; ++i) {
+    auto name = "LFoo" + std::to_string(i) + ";";
+    ClassCreator cc(DexType::make_type(name.c_str()));
+    cc.set_super(get_object_type());
+
+    auto method = static_cast<DexMethod*>(
+        DexMethod::make_method(name.c_str(), "bar", "V", {}));
+    method->attach_annotation_set(make_aset({"LGone;"}));
+    method->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+    method->set_code(assembler::ircode_from_string(R"(
+      (
+        (const-class "LReferenced;")
+        (move-result-pseudo-object v0)
+        (return-void)
+      )
+    )"));
+    cc.add_method(method);
+    methods.push_back(method);
+
+    auto field = static_cast<DexField*>(
+        DexField::make_field((name + ".baz:I").c_str()));
+    field->attach_annotation_set(make_aset({"LGone;"}));
+    field->make_concrete(ACC_PUBLIC | ACC_STATIC);
+    cc.add_field(field);
+    fields.push_back(field);
+
+    auto cls = cc.create();
+    cls->attach_annotation_set(
+        make_aset({"LGone;", "LKept;", "LReferenced;"}));
+    scope.push_back(cls);
+  }
+
+  AnnoKill ak(scope,
+              /* kill_bad_signatures */ false,
+              /* only_force_kill */ false,
+              /* keep */ {"LKept;"},
+              /* kill */ {},
+              /* force_kill */ {},
+              /* class_hierarchy_keep_annos */ {},
+              /* annotated_keep_annos */ {});
+  EXPECT_FALSE(ak.kill_annotations());
+
+  for (size_t i = 0; i < NUM_CLASSES; ++i) {
+    auto aset = scope[i]->get_anno_set();
+    ASSERT_NE(aset, nullptr);
+    ASSERT_EQ(aset->size(), 2);
+    EXPECT_EQ(aset->get_annotations()[0]->type(), DexType::get_type("LKept;"));
+    EXPECT_EQ(aset->get_annotations()[1]->type(),
+              DexType::get_type("LReferenced;"));
+    EXPECT_EQ(methods[i]->get_anno_set(), nullptr);
+    EXPECT_EQ(fields[i]->get_anno_set(), nullptr);
+  }
+
+  auto stats = ak.get_stats();
+  EXPECT_EQ(stats.annotations, 5 * NUM_CLASSES);
+  EXPECT_EQ(stats.annotations_killed, 3 * NUM_CLASSES);
+  EXPECT_EQ(stats.visibility_build_count, 5 * NUM_CLASSES);
+  EXPECT_EQ(stats.class_asets, NUM_CLASSES);
+  EXPECT_EQ(stats.class_asets_cleared, 0);
+  EXPECT_EQ(stats.method_asets, NUM_CLASSES);
+  EXPECT_EQ(stats.method_asets_cleared, NUM_CLASSES);
+  EXPECT_EQ(stats.field_asets, NUM_CLASSES);
+  EXPECT_EQ(stats.field_asets_cleared, NUM_CLASSES);
+}
@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "ApiLevelChecker.h"
+#include "Creators.h"
+#include "DexUtil.h"
+#include "RedexTest.h"
+
+namespace {
+
+DexAnnotationSet* make_target_api(int32_t level) {
+  auto anno = new DexAnnotation(
+      DexType::make_type("Landroid/annotation/TargetApi;"), DAV_BUILD);
+  auto value = DexEncodedValue::zero_for_type(get_int_type());
+  value->value(level);
+  anno->add_element("value", value);
+  auto anno_set = new DexAnnotationSet();
+  anno_set->add_annotation(anno);
+  return anno_set;
+}
+
+DexClass* make_class(const std::string& name, DexAnnotationSet* anno_set) {
+  ClassCreator creator(DexType::make_type(name.c_str()));
+  creator.set_super(get_object_type());
+  auto cls = creator.create();
+  cls->set_deobfuscated_name(name);
+  cls->attach_annotation_set(anno_set);
+  return cls;
+}
+
+DexMethod* make_method(DexClass* cls,
+                       const std::string& name,
+                       DexAnnotationSet* anno_set = nullptr) {
+  auto method = static_cast<DexMethod*>(
+      DexMethod::make_method(show(cls) + "." + name + ":()V"));
+  if (anno_set != nullptr) {
+    method->attach_annotation_set(anno_set);
+  }
+  method->make_concrete(ACC_PUBLIC, true);
+  cls->add_method(method);
+  return method;
+}
+
+} // namespace
+
+struct ApiLevelCheckerTest : public RedexTest {};
+
+TEST_F(ApiLevelCheckerTest, methodLevels) {
+  make_target_api(0); // Create the annotation type before `init`.
+  auto outer = make_class("LOuter;", make_target_api(21));
+  auto inner = make_class("LOuter$Inner;", nullptr);
+  auto plain = make_class("LPlain;", make_target_api(10));
+  auto outer_method = make_method(outer, "a");
+  auto inner_method = make_method(inner, "b");
+  auto annotated_method = make_method(inner, "c", make_target_api(23));
+  auto plain_method = make_method(plain, "d");
+
+  api::LevelChecker::init(15, {outer, inner, plain});
+  EXPECT_EQ(api::LevelChecker::get_method_level(outer_method), 21);
+  EXPECT_EQ(api::LevelChecker::get_method_level(inner_method), 21);
+  EXPECT_EQ(api::LevelChecker::get_method_level(annotated_method), 23);
+  // Levels below the minimum are ignored.
+  EXPECT_EQ(api::LevelChecker::get_method_level(plain_method), 15);
+
+  // Classes created after `init` are looked up on demand.
+  auto late = make_class("LOuter$Late;", nullptr);
+  EXPECT_EQ(api::LevelChecker::get_method_level(make_method(late, "e")), 21);
+}
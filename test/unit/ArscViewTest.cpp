@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "ArscView.h"
+#include "androidfw/ResourceTypes.h"
+#include "utils/String8.h"
+
+namespace {
+
+template <class T>
+void append(std::vector<char>& bytes, const T& value) {
+  auto data = reinterpret_cast<const char*>(&value);
+  bytes.insert(bytes.end(), data, data + sizeof(T));
+}
+
+void append_pool(std::vector<char>& bytes,
+                 const std::vector<std::string>& strings) {
+  const auto header_size = (uint16_t)sizeof(android::ResStringPool_header);
+  android::ResStringPool_header empty_header{
+      {android::RES_STRING_POOL_TYPE, header_size, header_size}, 0, 0, 0, 0,
+      0};
+  android::ResStringPool pool(&empty_header, header_size);
+  for (const auto& s : strings) {
+    pool.appendString(android::String8(s.c_str()));
+  }
+  android::Vector<char> serialized;
+  pool.serialize(serialized);
+  bytes.insert(bytes.end(), serialized.array(),
+               serialized.array() + serialized.size());
+}
+
+void set_size(std::vector<char>& bytes, size_t chunk_start) {
+  auto header = reinterpret_cast<android::ResChunk_header*>(&bytes[chunk_start]);
+  header->size = bytes.size() - chunk_start;
+}
+
+// A type chunk whose entries have the given keys; -1 is a missing entry.
+void append_type(std::vector<char>& bytes,
+                 uint8_t id,
+                 const std::vector<int>& keys) {
+  size_t start = bytes.size();
+  android::ResTable_type type;
+  memset(&type, 0, sizeof(type));
+  type.header.type = android::RES_TABLE_TYPE_TYPE;
+  type.header.headerSize = sizeof(type);
+  type.id = id;
+  type.entryCount = keys.size();
+  type.entriesStart = sizeof(type) + keys.size() * sizeof(uint32_t);
+  append(bytes, type);
+  uint32_t offset = 0;
+  for (auto key : keys) {
+    if (key < 0) {
+      append(bytes, uint32_t(android::ResTable_type::NO_ENTRY));
+    } else {
+      append(bytes, offset);
+      offset += sizeof(android::ResTable_entry) + sizeof(android::Res_value);
+    }
+  }
+  for (auto key : keys) {
+    if (key < 0) {
+      continue;
+    }
+    android::ResTable_entry entry;
+    entry.size = sizeof(entry);
+    entry.flags = 0;
+    entry.key.index = key;
+    append(bytes, entry);
+    android::Res_value value;
+    memset(&value, 0, sizeof(value));
+    value.size = sizeof(value);
+    append(bytes, value);
+  }
+  set_size(bytes, start);
+}
+
+std::vector<char> make_table() {
+  std::vector<char> bytes;
+  android::ResTable_header table;
+  table.header.type = android::RES_TABLE_TYPE;
+  table.header.headerSize = sizeof(table);
+  table.packageCount = 1;
+  append(bytes, table);
+  append_pool(bytes, {"Hello"});
+
+  size_t package_start = bytes.size();
+  android::ResTable_package package;
+  memset(&package, 0, sizeof(package));
+  package.header.type = android::RES_TABLE_PACKAGE_TYPE;
+  package.header.headerSize = sizeof(package);
+  package.id = 0x7f;
+  const char* name = "com.example";
+  for (size_t i = 0; name[i] != '\0'; ++i) {
+    package.name[i] = name[i];
+  }
+  append(bytes, package);
+  auto package_header = [&]() {
+    return reinterpret_cast<android::ResTable_package*>(&bytes[package_start]);
+  };
+  package_header()->typeStrings = bytes.size() - package_start;
+  append_pool(bytes, {"string", "id"});
+  package_header()->keyStrings = bytes.size() - package_start;
+  append_pool(bytes, {"app_name", "title"});
+  append_type(bytes, 1, {0, -1, 1});
+  // Same type in another configuration.
+  append_type(bytes, 1, {0});
+  append_type(bytes, 2, {1});
+  set_size(bytes, package_start);
+  set_size(bytes, 0);
+  return bytes;
+}
+
+} // namespace
+
+TEST(ArscView, iteratePackagesAndEntries) {
+  auto bytes = make_table();
+  arsc::TableView table(bytes.data(), bytes.size());
+  EXPECT_EQ(arsc::string_at(table.global_strings(), 0), "Hello");
+
+  size_t packages = 0;
+  std::vector<uint32_t> ids;
+  table.for_each_package([&](arsc::PackageView& package) {
+    ++packages;
+    EXPECT_EQ(package.id(), 0x7f);
+    EXPECT_EQ(package.name(), "com.example");
+    EXPECT_EQ(arsc::string_at(package.type_strings(), 1), "id");
+    package.for_each_entry(
+        [&](uint32_t id, const android::ResTable_entry*) { ids.push_back(id); });
+  });
+  EXPECT_EQ(packages, 1);
+  EXPECT_EQ(ids,
+            std::vector<uint32_t>({0x7f010000, 0x7f010002, 0x7f010000,
+                                   0x7f020000}));
+}
+
+TEST(ArscView, nameToIds) {
+  auto bytes = make_table();
+  auto name_to_ids = arsc::get_name_to_ids(
+      arsc::TableView(bytes.data(), bytes.size()));
+  EXPECT_EQ(name_to_ids.size(), 2);
+  EXPECT_EQ(name_to_ids.at("app_name"), std::vector<uint32_t>({0x7f010000}));
+  EXPECT_EQ(name_to_ids.at("title"),
+            std::vector<uint32_t>({0x7f010002, 0x7f020000}));
+}
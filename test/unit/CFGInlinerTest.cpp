@@ -27,22 +27,33 @@ void test_inliner(const std::string& caller_str,
                   const std::string& expected_str) {
   g_redex = new RedexContext();
 
-  auto caller_code = assembler::ircode_from_string(caller_str);
-  caller_code->build_cfg(true);
-  auto& caller = caller_code->cfg();
-
-  auto callee_code = assembler::ircode_from_string(callee_str);
-  callee_code->build_cfg(true);
-  auto& callee = callee_code->cfg();
-
-  cfg::CFGInliner::inline_cfg(&caller, get_invoke(&caller), callee);
+  // Inlining a copy of the callee and moving the callee itself must give the
+  // same code.
+  for (bool move_callee : {false, true}) {
+    auto caller_code = assembler::ircode_from_string(caller_str);
+    caller_code->build_cfg(true);
+    auto& caller = caller_code->cfg();
+
+    auto callee_code = assembler::ircode_from_string(callee_str);
+    callee_code->build_cfg(true);
+    auto& callee = callee_code->cfg();
+
+    if (move_callee) {
+      cfg::CFGInliner::inline_cfg_by_move(&caller, get_invoke(&caller),
+                                          &callee);
+      EXPECT_TRUE(callee.blocks().empty());
+    } else {
+      cfg::CFGInliner::inline_cfg(&caller, get_invoke(&caller), callee);
+    }
 
-  auto expected_code = assembler::ircode_from_string(expected_str);
+    auto expected_code = assembler::ircode_from_string(expected_str);
 
-  const std::string& final_cfg = show(caller);
-  caller_code->clear_cfg();
-  EXPECT_EQ(assembler::to_string(expected_code.get()),
-            assembler::to_string(caller_code.get())) << final_cfg;
+    const std::string& final_cfg = show(caller);
+    caller_code->clear_cfg();
+    EXPECT_EQ(assembler::to_string(expected_code.get()),
+              assembler::to_string(caller_code.get()))
+        << final_cfg << (move_callee ? " (moved)" : " (copied)");
+  }
 
   delete g_redex;
 }
@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CallGraph.h"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+
+#include "Creators.h"
+#include "DexUtil.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+struct CallGraphTest : public RedexTest {};
+
+TEST_F(CallGraphTest, graphHasTheReachableCallsites) {
+  Scope scope;
+  ClassCreator creator(DexType::make_type("LFoo;"));
+  creator.set_super(get_object_type());
+
+  auto root = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.root:()V"
+     (
+      (invoke-static () "LFoo;.a:()V")
+      (invoke-static () "LFoo;.b:()V")
+      (invoke-static () "LFoo;.a:()V")
+      (return-void)
+     )
+    )
+  )");
+  root->rstate.set_root();
+  creator.add_method(root);
+
+  auto a = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.a:()V"
+     (
+      (invoke-static () "LFoo;.b:()V")
+      (return-void)
+     )
+    )
+  )");
+  creator.add_method(a);
+
+  auto b = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.b:()V"
+     (
+      (invoke-static () "LFoo;.a:()V")
+      (return-void)
+     )
+    )
+  )");
+  creator.add_method(b);
+
+  auto unreachable = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.unreachable:()V"
+     (
+      (invoke-static () "LFoo;.a:()V")
+      (return-void)
+     )
+    )
+  )");
+  creator.add_method(unreachable);
+  scope.push_back(creator.create());
+
+  auto graph = call_graph::single_callee_graph(scope);
+  EXPECT_FALSE(graph.has_node(unreachable));
+
+  using Callees = std::vector<std::pair<DexMethod*, IRList::iterator>>;
+  auto callees = [&](const DexMethod* m) {
+    Callees result;
+    for (const auto& edge : graph.node(m).callees()) {
+      EXPECT_EQ(edge->caller(), m);
+      result.emplace_back(edge->callee(), edge->invoke_iterator());
+    }
+    return result;
+  };
+  auto callers = [&](const DexMethod* m) {
+    std::vector<DexMethod*> result;
+    for (const auto& edge : graph.node(m).callers()) {
+      EXPECT_EQ(edge->callee(), m);
+      result.push_back(edge->caller());
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+  };
+  // The invoke instructions of a method, in order.
+  auto invokes = [](DexMethod* m) {
+    std::vector<IRList::iterator> result;
+    auto* code = m->get_code();
+    for (auto it = code->begin(); it != code->end(); ++it) {
+      if (it->type == MFLOW_OPCODE && is_invoke(it->insn->opcode())) {
+        result.push_back(it);
+      }
+    }
+    return result;
+  };
+
+  EXPECT_EQ(callees(nullptr), (Callees{{root, IRList::iterator()}}));
+  auto root_invokes = invokes(root);
+  EXPECT_EQ(callees(root), (Callees{{a, root_invokes[0]},
+                                    {b, root_invokes[1]},
+                                    {a, root_invokes[2]}}));
+  EXPECT_EQ(callees(a), (Callees{{b, invokes(a)[0]}}));
+  EXPECT_EQ(callees(b), (Callees{{a, invokes(b)[0]}}));
+
+  auto sorted = [](std::vector<DexMethod*> methods) {
+    std::sort(methods.begin(), methods.end());
+    return methods;
+  };
+  EXPECT_EQ(callers(root), std::vector<DexMethod*>{nullptr});
+  EXPECT_EQ(callers(a), sorted({root, root, b}));
+  EXPECT_EQ(callers(b), sorted({root, a}));
+}
+
+TEST(SccWavesTest, componentsComeAfterTheirSuccessors) {
+  // 0 -> 1 <-> 2 -> 3, 0 -> 4 -> 5 (a placeholder) -> 3, 6 on its own.
+  std::vector<std::vector<call_graph::SccNodeId>> successors{
+      {1, 4}, {2}, {1, 3}, {}, {5}, {3}, {}};
+  std::vector<bool> placeholders{false, false, false, false,
+                                 false, true,  false};
+  auto waves = call_graph::scc_waves(successors, placeholders);
+  using Wave = std::vector<call_graph::SccComponent>;
+  ASSERT_EQ(waves.size(), 3);
+  auto sorted = [](Wave wave) {
+    std::sort(wave.begin(), wave.end());
+    return wave;
+  };
+  // The placeholder takes no wave, so 4 runs right after 3.
+  EXPECT_EQ(sorted(waves[0]), (Wave{{3}, {6}}));
+  EXPECT_EQ(sorted(waves[1]), (Wave{{1, 2}, {4}}));
+  EXPECT_EQ(sorted(waves[2]), (Wave{{0}}));
+}
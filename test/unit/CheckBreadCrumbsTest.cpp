@@ -230,4 +230,42 @@ TEST(CheckBreadcrumbs, AccessValidityTest) {
   delete g_redex;
 }
 
+TEST(CheckBreadcrumbs, ReportsInScopeOrder) {
+  g_redex = new RedexContext();
+  // A class that is neither external nor in the scope, i.e. deleted.
+  ClassCreator deleted_creator(DexType::make_type("LDeleted;"));
+  deleted_creator.set_super(get_object_type());
+  deleted_creator.create();
+
+  // Enough classes to be split across threads, each with a method whose
+  // signature refers to the deleted class.
+  std::vector<DexClass*> classes;
+  std::ostringstream expected;
+  expected << "Bad methods in class LDeleted;\n";
+  for (size_t i = 0; i < 100; ++i) {
+    auto name = "LC" + std::to_string(i) + ";";
+    auto method_name = "m" + std::to_string(i);
+    ClassCreator creator(DexType::make_type(name.c_str()));
+    creator.set_super(get_object_type());
+    auto method = static_cast<DexMethod*>(DexMethod::make_method(
+        name.c_str(), method_name.c_str(), "V", {"LDeleted;"}));
+    method->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+    creator.add_method(method);
+    classes.push_back(creator.create());
+    expected << "\t" << method_name << "\n";
+  }
+  expected << "\n";
+  DexMetadata dm;
+  dm.set_id("classes");
+  DexStore store(dm);
+  store.add_classes(classes);
+  std::vector<DexStore> stores;
+  stores.emplace_back(std::move(store));
+  auto scope = build_class_scope(stores);
+  Breadcrumbs bc(scope, stores, false);
+  bc.check_breadcrumbs();
+  EXPECT_EQ(expected.str(), bc.get_methods_with_bad_refs());
+  delete g_redex;
+}
+
 } // namespace
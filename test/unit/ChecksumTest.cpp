@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include "Adler32.h"
+#include "Sha1.h"
+
+namespace {
+
+std::string sha1_hex(const std::string& input, size_t piece_size) {
+  Sha1Context context;
+  sha1_init(&context);
+  auto data = reinterpret_cast<const unsigned char*>(input.data());
+  for (size_t offset = 0; offset < input.size(); offset += piece_size) {
+    sha1_update(&context, data + offset,
+                std::min(piece_size, input.size() - offset));
+  }
+  unsigned char digest[20];
+  sha1_final(digest, &context);
+  std::string hex;
+  char buf[3];
+  for (auto byte : digest) {
+    snprintf(buf, sizeof(buf), "%02x", byte);
+    hex += buf;
+  }
+  return hex;
+}
+
+} // namespace
+
+TEST(Sha1, knownDigests) {
+  EXPECT_EQ(sha1_hex("", 1), "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+  EXPECT_EQ(sha1_hex("abc", 1), "a9993e364706816aba3e25717850c26c9cd0d89d");
+  const std::string two_blocks =
+      "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  EXPECT_EQ(sha1_hex(two_blocks, two_blocks.size()),
+            "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+  // Split in pieces that don't line up with the blocks.
+  const std::string million(1000000, 'a');
+  for (size_t piece_size : {7, 64, 1000, 1000000}) {
+    EXPECT_EQ(sha1_hex(million, piece_size),
+              "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+  }
+}
+
+TEST(Adler32, matchesZlib) {
+  std::vector<unsigned char> data(100000);
+  uint32_t seed = 1;
+  for (auto& byte : data) {
+    seed = seed * 1103515245 + 12345;
+    byte = seed >> 24;
+  }
+  // All ones makes the sums grow the fastest.
+  std::vector<unsigned char> ones(20000, 0xff);
+  for (const auto* bytes : {&data, &ones}) {
+    for (size_t start : {0, 1, 13}) {
+      for (size_t len : {0, 1, 31, 32, 33, 5552, 5553, 19000}) {
+        auto expected = adler32(adler32(0L, Z_NULL, 0), bytes->data() + start,
+                                len);
+        EXPECT_EQ(adler32_update(1, bytes->data() + start, len), expected)
+            << "start " << start << " len " << len;
+      }
+    }
+  }
+  // Continuing a checksum.
+  auto expected = adler32(adler32(0L, Z_NULL, 0), data.data(), data.size());
+  auto adler = adler32_update(1, data.data(), 12345);
+  adler = adler32_update(adler, data.data() + 12345, data.size() - 12345);
+  EXPECT_EQ(adler, expected);
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <numeric>
+
+#include "ClassMutations.h"
+#include "Creators.h"
+#include "DexUtil.h"
+#include "Parallel.h"
+#include "RedexTest.h"
+
+struct ClassMutationsTest : public RedexTest {};
+
+namespace {
+
+DexMethod* make_method(DexType* type, const std::string& name) {
+  MethodCreator creator(type,
+                        DexString::make_string(name),
+                        DexProto::make_proto(get_void_type(),
+                                             DexTypeList::make_type_list({})),
+                        ACC_PUBLIC | ACC_STATIC);
+  creator.get_main_block()->ret_void();
+  return creator.create();
+}
+
+} // namespace
+
+TEST_F(ClassMutationsTest, appliesStagedChanges) {
+  auto type = DexType::make_type("LFoo;");
+  ClassCreator creator(type);
+  creator.set_super(get_object_type());
+  auto removed = make_method(type, "removed");
+  creator.add_method(removed);
+  auto field = static_cast<DexField*>(
+      DexField::make_field(type, DexString::make_string("f"), get_int_type()));
+  field->make_concrete(ACC_PUBLIC);
+  creator.add_field(field);
+  auto cls = creator.create();
+
+  ClassMutations mutations;
+  std::vector<size_t> indices(100);
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    mutations.add_method(make_method(type, "m" + std::to_string(i)));
+  });
+  mutations.remove_method(removed);
+  mutations.remove_field(field);
+  EXPECT_FALSE(mutations.empty());
+  EXPECT_EQ(cls->get_dmethods().size(), 1);
+
+  mutations.apply();
+  EXPECT_TRUE(mutations.empty());
+  EXPECT_TRUE(cls->get_ifields().empty());
+  const auto& dmethods = cls->get_dmethods();
+  ASSERT_EQ(dmethods.size(), 100);
+  EXPECT_TRUE(std::is_sorted(dmethods.begin(), dmethods.end(),
+                             compare_dexmethods));
+  EXPECT_EQ(std::find(dmethods.begin(), dmethods.end(), removed),
+            dmethods.end());
+}
@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "ColdStartLayoutPlugin.h"
+#include "Creators.h"
+#include "DexUtil.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+using namespace interdex;
+
+struct ColdStartLayoutTest : public RedexTest {};
+
+namespace {
+
+const CrossDexRefMinimizerConfig config{100, 90, 100, 90};
+
+// A class whose only method loads `str`.
+DexClass* make_class(const std::string& name,
+                     const std::string& str,
+                     DexType* super = get_object_type()) {
+  ClassCreator creator(DexType::make_type(name.c_str()));
+  creator.set_super(super);
+  creator.add_method(assembler::method_from_string(R"(
+    (method (public static) ")" + name + R"(.foo:()V"
+     (
+      (const-string ")" + str + R"(")
+      (move-result-pseudo-object v0)
+      (return-void)
+     )
+    )
+  )"));
+  return creator.create();
+}
+
+} // namespace
+
+TEST_F(ColdStartLayoutTest, clustersClassesWithSharedRefs) {
+  auto a = make_class("LA;", "x");
+  auto b = make_class("LB;", "y");
+  auto c = make_class("LC;", "x");
+  auto d = make_class("LD;", "y");
+  auto ordered = order_for_startup({a, b, c, d}, nullptr, config);
+  EXPECT_EQ(ordered, std::vector<DexClass*>({a, c, b, d}));
+}
+
+TEST_F(ColdStartLayoutTest, keepsSuperclassesFirst) {
+  auto base = make_class("LBase;", "x");
+  auto sub = make_class("LSub;", "y", base->get_type());
+  auto other = make_class("LOther;", "y");
+  // Sub is clustered with Other, but Base must still come before it.
+  auto ordered = order_for_startup({other, sub, base}, nullptr, config);
+  EXPECT_EQ(ordered, std::vector<DexClass*>({other, base, sub}));
+}
+
+TEST_F(ColdStartLayoutTest, estimatesPagesOfAllClassesWithoutProfiles) {
+  auto a = make_class("LPageA;", "x");
+  auto b = make_class("LPageB;", "y");
+  EXPECT_EQ(estimate_startup_pages({a, b}, nullptr), 1);
+}
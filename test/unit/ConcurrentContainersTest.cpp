@@ -9,6 +9,8 @@
 #include "ConcurrentContainers.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <gtest/gtest.h>
@@ -232,3 +234,153 @@ TEST_F(ConcurrentContainersTest, concurrentMapTest) {
   map.clear();
   EXPECT_EQ(0, map.size());
 }
+
+TEST_F(ConcurrentContainersTest, readOptimizedConcurrentMapTest) {
+  ReadOptimizedConcurrentMap<std::string, uint32_t> map;
+
+  run_on_samples([&map](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      std::string s = std::to_string(sample[i]);
+      map.insert({s, sample[i]});
+      EXPECT_EQ(1, map.count(s));
+      EXPECT_EQ(sample[i], map.at(s));
+    }
+  });
+  EXPECT_EQ(m_data_set.size(), map.size());
+  size_t iterated = 0;
+  for (const auto& entry : map) {
+    EXPECT_EQ(std::to_string(entry.second), entry.first);
+    ++iterated;
+  }
+  EXPECT_EQ(m_data_set.size(), iterated);
+
+  std::unordered_map<uint32_t, size_t> occurrences;
+  for (uint32_t x : m_data) {
+    ++occurrences[x];
+  }
+  run_on_samples([&map](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      std::string s = std::to_string(sample[i]);
+      map.update(s, [&s](const std::string& key, uint32_t& value,
+                         bool key_exists) {
+        EXPECT_EQ(s, key);
+        EXPECT_TRUE(key_exists);
+        ++value;
+      });
+    }
+  });
+  EXPECT_EQ(m_data_set.size(), map.size());
+  auto copy = map;
+  for (uint32_t x : m_data) {
+    std::string s = std::to_string(x);
+    EXPECT_EQ(x + occurrences[x], map.get(s, 0));
+    EXPECT_EQ(x + occurrences[x], copy.get(s, 0));
+  }
+
+  run_on_samples([&map](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      map.erase(std::to_string(sample[i]));
+    }
+  });
+  EXPECT_EQ(0, map.size());
+  EXPECT_EQ(map.end(), map.begin());
+  for (uint32_t x : m_data) {
+    EXPECT_EQ(0, map.count(std::to_string(x)));
+  }
+  EXPECT_EQ(m_data_set.size(), copy.size());
+}
+
+TEST_F(ConcurrentContainersTest, readOptimizedConcurrentMapGrowKeepsEntries) {
+  ReadOptimizedConcurrentMap<uint32_t, uint32_t> map;
+  map.insert({0, 0});
+  auto entry = map.find(0);
+  ASSERT_NE(nullptr, entry);
+  // Growing relinks the nodes instead of copying them, while other threads
+  // look up the keys that are already there.
+  run_on_samples([&map](const std::vector<uint32_t>& sample) {
+    for (size_t i = 0; i < sample.size(); ++i) {
+      map.insert({sample[i] + 1, sample[i]});
+      EXPECT_EQ(1, map.count(0));
+      EXPECT_EQ(sample[i], map.get(sample[i] + 1, 0));
+    }
+  });
+  EXPECT_EQ(entry, map.find(0));
+  EXPECT_EQ(m_data_set.size() + 1, map.size());
+}
+
+TEST_F(ConcurrentContainersTest, readOptimizedConcurrentMapGetOrEmplaceAll) {
+  ReadOptimizedConcurrentMap<uint32_t, uint32_t> map;
+  std::atomic<size_t> made{0};
+
+  run_on_samples([&map, &made](const std::vector<uint32_t>& sample) {
+    std::vector<uint32_t> out(sample.size());
+    map.get_or_emplace_all(sample.data(), sample.size(), out.data(),
+                           [&made](uint32_t key) {
+                             ++made;
+                             return key + 1;
+                           });
+    for (size_t i = 0; i < sample.size(); ++i) {
+      EXPECT_EQ(sample[i] + 1, out[i]);
+    }
+  });
+  EXPECT_EQ(m_data_set.size(), map.size());
+  EXPECT_EQ(m_data_set.size(), made.load());
+  for (uint32_t x : m_data_set) {
+    EXPECT_EQ(x + 1, map.get(x, 0));
+  }
+}
+
+namespace {
+
+// Run a mix of 95% lookups and 5% insertions from kThreads threads and return
+// the number of operations per second.
+template <typename Map>
+double read_mostly_throughput(const std::vector<uint32_t> samples[]) {
+  constexpr size_t kRounds = 200;
+  Map map;
+  for (size_t t = 0; t < kThreads; ++t) {
+    for (size_t i = 0; i < samples[t].size(); i += 2) {
+      map.insert({samples[t][i], samples[t][i]});
+    }
+  }
+  std::atomic<size_t> found{0};
+  std::vector<boost::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t t = 0; t < kThreads; ++t) {
+    const auto& sample = samples[t];
+    threads.emplace_back([&map, &found, &sample]() {
+      size_t local_found = 0;
+      for (size_t round = 0; round < kRounds; ++round) {
+        for (size_t i = 0; i < sample.size(); ++i) {
+          if ((round * sample.size() + i) % 20 == 0) {
+            map.insert({sample[i] + round, sample[i]});
+          } else {
+            local_found += map.count(sample[i]);
+          }
+        }
+      }
+      found += local_found;
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  double secs = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  EXPECT_LT(0, found.load());
+  return kThreads * kRounds * samples[0].size() / secs;
+}
+
+} // namespace
+
+TEST_F(ConcurrentContainersTest, readMostlyBenchmark) {
+  double locked =
+      read_mostly_throughput<ConcurrentMap<uint32_t, uint32_t>>(m_samples);
+  double lock_free =
+      read_mostly_throughput<ReadOptimizedConcurrentMap<uint32_t, uint32_t>>(
+          m_samples);
+  printf("95/5 read/write mix: ConcurrentMap %.0f ops/s, "
+         "ReadOptimizedConcurrentMap %.0f ops/s (%.2fx)\n",
+         locked, lock_free, lock_free / locked);
+}
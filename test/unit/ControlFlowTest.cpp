@@ -294,6 +294,63 @@ TEST(ControlFlow, findImmediateDominator) {
   }
 }
 
+TEST(ControlFlow, cachedAnalyses) {
+  //                   +---+
+  //                   v   |
+  //     +---+     +---+     +---+     +---+     +---+
+  //     | 0 | --> | 1 | --> | 2 | --> | 3 | --> | 4 |
+  //     +---+     +---+     +---+     +---+     +---+
+  //                 ^                   |
+  //                 +-------------------+
+  ControlFlowGraph cfg;
+  auto b0 = cfg.create_block();
+  auto b1 = cfg.create_block();
+  auto b2 = cfg.create_block();
+  auto b3 = cfg.create_block();
+  auto b4 = cfg.create_block();
+  cfg.set_entry_block(b0);
+  cfg.add_edge(b0, b1, EDGE_GOTO);
+  cfg.add_edge(b1, b2, EDGE_GOTO);
+  cfg.add_edge(b2, b2, EDGE_GOTO);
+  cfg.add_edge(b2, b3, EDGE_GOTO);
+  cfg.add_edge(b3, b1, EDGE_GOTO);
+  cfg.add_edge(b3, b4, EDGE_GOTO);
+
+  EXPECT_THAT(cfg.reverse_postorder(),
+              ::testing::ElementsAre(b0, b1, b2, b3, b4));
+  EXPECT_EQ(cfg.idom(b0), b0);
+  EXPECT_EQ(cfg.idom(b1), b0);
+  EXPECT_EQ(cfg.idom(b2), b1);
+  EXPECT_EQ(cfg.idom(b3), b2);
+  EXPECT_EQ(cfg.idom(b4), b3);
+  EXPECT_TRUE(cfg.dominates(b1, b4));
+  EXPECT_FALSE(cfg.dominates(b4, b1));
+  EXPECT_EQ(cfg.common_dominator(b4, b2), b2);
+
+  EXPECT_EQ(cfg.post_idom(b4), b4);
+  EXPECT_EQ(cfg.post_idom(b3), b4);
+  EXPECT_EQ(cfg.post_idom(b1), b2);
+  EXPECT_EQ(cfg.post_idom(b0), b1);
+
+  EXPECT_EQ(cfg.loop_depth(b0), 0);
+  EXPECT_EQ(cfg.loop_depth(b1), 1);
+  EXPECT_EQ(cfg.loop_depth(b2), 2);
+  EXPECT_EQ(cfg.loop_depth(b3), 1);
+  EXPECT_EQ(cfg.loop_depth(b4), 0);
+  EXPECT_EQ(cfg.loop_header(b0), nullptr);
+  EXPECT_EQ(cfg.loop_header(b2), b2);
+  EXPECT_EQ(cfg.loop_header(b3), b1);
+
+  // Editing the graph drops the cached results.
+  cfg.add_edge(b0, b4, EDGE_GOTO);
+  EXPECT_EQ(cfg.idom(b4), b0);
+  EXPECT_EQ(cfg.common_dominator(b4, b3), b0);
+  EXPECT_EQ(cfg.post_idom(b0), b4);
+  cfg.delete_edges_between(b2, b2);
+  EXPECT_EQ(cfg.loop_depth(b2), 1);
+  EXPECT_EQ(cfg.loop_header(b2), b1);
+}
+
 TEST(ControlFlow, iterate1) {
   auto code = assembler::ircode_from_string(R"(
     (
@@ -1184,3 +1241,61 @@ TEST(ControlFlow, line_numbers) {
 
   delete g_redex;
 }
+
+TEST(ControlFlow, simplify_worklist) {
+  g_redex = new RedexContext();
+
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :true)
+
+      (const v1 1)
+      (goto :a)
+
+      (:b)
+      (const v2 2)
+      (goto :exit)
+
+      (:a)
+      (goto :b)
+
+      (:true)
+      (const v1 0)
+
+      (:exit)
+      (return v1)
+    )
+  )");
+
+  code->build_cfg(/* editable */ true);
+  auto& cfg = code->cfg();
+  // The empty block at :a is already gone; the blocks at :b and :exit are each
+  // reached by a single goto, so only :b can be merged into its predecessor.
+  EXPECT_EQ(5, cfg.num_blocks());
+  EXPECT_EQ(1, cfg.simplify_worklist());
+  EXPECT_EQ(4, cfg.num_blocks());
+  EXPECT_EQ(0, cfg.simplify_worklist());
+  code->clear_cfg();
+
+  auto expected = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :true)
+
+      (const v1 1)
+      (const v2 2)
+
+      (:exit)
+      (return v1)
+
+      (:true)
+      (const v1 0)
+      (goto :exit)
+    )
+  )");
+  EXPECT_EQ(assembler::to_s_expr(expected.get()),
+            assembler::to_s_expr(code.get()));
+
+  delete g_redex;
+}
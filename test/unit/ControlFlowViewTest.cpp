@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "ControlFlowView.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "Liveness.h"
+#include "RedexTest.h"
+
+struct ControlFlowViewTest : public RedexTest {};
+
+namespace {
+
+using Edges = std::vector<std::tuple<size_t, size_t, cfg::EdgeType>>;
+
+Edges edges_of(const std::vector<cfg::Edge*>& edges) {
+  Edges result;
+  for (auto e : edges) {
+    result.emplace_back(e->src()->id(), e->target()->id(), e->type());
+  }
+  return result;
+}
+
+template <typename Range>
+Edges edges_of(const cfg::ControlFlowView& view, const Range& edges) {
+  Edges result;
+  for (auto e : edges) {
+    result.emplace_back(view.src(e), view.target(e), view.type(e));
+  }
+  return result;
+}
+
+// The view must have the same blocks and edges as a non-editable CFG.
+void expect_same_graph(const std::string& code_str) {
+  auto code = assembler::ircode_from_string(code_str);
+  cfg::ControlFlowView view(*code);
+  code->build_cfg(/* editable */ false);
+  auto& cfg = code->cfg();
+  cfg.calculate_exit_block();
+
+  auto blocks = cfg.blocks();
+  ASSERT_EQ(view.num_blocks(), blocks.size()) << show(cfg);
+  EXPECT_EQ(view.exit_block(), cfg.exit_block()->id());
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    auto* block = blocks[i];
+    ASSERT_EQ(block->id(), i);
+    if (block != cfg.exit_block() || block->num_opcodes() != 0) {
+      EXPECT_TRUE(view.entries(i).begin() == block->begin()) << i;
+      EXPECT_TRUE(view.entries(i).end() == block->end()) << i;
+    }
+    EXPECT_EQ(edges_of(view, view.succs(i)), edges_of(block->succs())) << i;
+    EXPECT_EQ(edges_of(view, view.preds(i)), edges_of(block->preds())) << i;
+  }
+}
+
+} // namespace
+
+TEST_F(ControlFlowViewTest, branches) {
+  expect_same_graph(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :true)
+      (const v1 1)
+      (goto :end)
+      (:true)
+      (const v1 2)
+      (:end)
+      (return v1)
+    )
+  )");
+}
+
+TEST_F(ControlFlowViewTest, switchWithSharedTarget) {
+  expect_same_graph(R"(
+    (
+      (load-param v0)
+      (sparse-switch v0 (:a :b :c))
+      (return-void)
+      (:a 0)
+      (:c 2)
+      (const v0 0)
+      (return-void)
+      (:b 1)
+      (const v1 1)
+      (return-void)
+    )
+  )");
+}
+
+TEST_F(ControlFlowViewTest, tryCatch) {
+  expect_same_graph(R"(
+    (
+      (.try_start a)
+      (const v0 0)
+      (invoke-static () "LCls;.foo:()V")
+      (invoke-static () "LCls;.bar:()V")
+      (return v0)
+      (.try_end a)
+
+      (.catch (a))
+      (const v1 1)
+      (return v1)
+    )
+  )");
+}
+
+TEST_F(ControlFlowViewTest, unreachableAndInfiniteLoop) {
+  expect_same_graph(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :loop)
+      (return-void)
+
+      (const v1 1)
+      (goto :loop)
+
+      (:loop)
+      (add-int/lit8 v0 v0 1)
+      (goto :loop)
+    )
+  )");
+}
+
+TEST_F(ControlFlowViewTest, liveness) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (load-param v1)
+      (if-eqz v0 :true)
+      (return v1)
+      (:true)
+      (const v1 2)
+      (return v1)
+    )
+  )");
+  code->set_registers_size(2);
+  cfg::ControlFlowView view(*code);
+  ViewLivenessFixpointIterator liveness(view);
+  liveness.run(LivenessDomain());
+
+  EXPECT_EQ(liveness.get_live_in_vars_at(view.entry_block()),
+            LivenessDomain());
+  EXPECT_EQ(liveness.get_live_out_vars_at(view.entry_block()),
+            LivenessDomain(1));
+}
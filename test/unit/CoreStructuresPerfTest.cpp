@@ -0,0 +1,294 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "ConcurrentContainers.h"
+#include "ConstantAbstractDomain.h"
+#include "ControlFlow.h"
+#include "DexClass.h"
+#include "DexOutput.h"
+#include "GraphColoring.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "InstructionLowering.h"
+#include "LiveRange.h"
+#include "PatriciaTreeMapAbstractEnvironment.h"
+#include "RedexContext.h"
+#include "Transform.h"
+
+//==========
+// Microbenchmarks of the core data structures. Each benchmark is run until it
+// has taken enough time, and reports the median time per operation and the
+// number of heap allocations per operation. Only the body of a benchmark is
+// measured: the state it works on is set up before, and torn down after.
+//==========
+
+namespace {
+
+std::atomic<size_t> s_allocations{0};
+
+} // namespace
+
+void* operator new(size_t size) {
+  s_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete[](void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const auto kMinDuration = std::chrono::milliseconds(300);
+const size_t kMinRuns = 5;
+const size_t kMaxRuns = 1000;
+
+/*
+ * Run `body(state)` on fresh states from `setup()` until it has run for
+ * kMinDuration, and print its cost per operation, where each run does `ops`
+ * operations.
+ */
+template <typename Setup, typename Body>
+void benchmark(const char* name, size_t ops, Setup setup, Body body) {
+  std::vector<double> ns_per_op;
+  size_t allocations = 0;
+  Clock::duration total{0};
+  while (ns_per_op.size() < kMinRuns ||
+         (total < kMinDuration && ns_per_op.size() < kMaxRuns)) {
+    auto state = setup();
+    auto allocations_before = s_allocations.load();
+    auto start = Clock::now();
+    body(state);
+    auto end = Clock::now();
+    allocations += s_allocations.load() - allocations_before;
+    total += end - start;
+    ns_per_op.push_back(
+        std::chrono::duration<double, std::nano>(end - start).count() / ops);
+  }
+  std::sort(ns_per_op.begin(), ns_per_op.end());
+  printf("%-44s %10.1f ns/op (min %.1f, max %.1f) %8.2f allocs/op, %zu runs\n",
+         name, ns_per_op[ns_per_op.size() / 2], ns_per_op.front(),
+         ns_per_op.back(), double(allocations) / (ops * ns_per_op.size()),
+         ns_per_op.size());
+}
+
+template <typename Body>
+void benchmark(const char* name, size_t ops, Body body) {
+  benchmark(name, ops, [] { return nullptr; },
+            [&](std::nullptr_t) { body(); });
+}
+
+void bench_interning() {
+  const size_t kCount = 10000;
+  static size_t s_generation = 0;
+  auto make_names = [&] {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < kCount; i++) {
+      names.push_back("Lcom/facebook/bench/G" + std::to_string(s_generation) +
+                      "/Class" + std::to_string(i) + ";");
+    }
+    s_generation++;
+    return names;
+  };
+  benchmark("RedexContext: make_string (new)", kCount, make_names,
+            [](const std::vector<std::string>& names) {
+              for (const auto& name : names) {
+                DexString::make_string(name.c_str());
+              }
+            });
+
+  auto existing = make_names();
+  for (const auto& name : existing) {
+    DexType::make_type(name.c_str());
+  }
+  benchmark("RedexContext: make_string (existing)", kCount, [&] {
+    for (const auto& name : existing) {
+      DexString::make_string(name.c_str());
+    }
+  });
+  benchmark("RedexContext: get_type (existing)", kCount, [&] {
+    for (const auto& name : existing) {
+      DexType::get_type(name.c_str());
+    }
+  });
+}
+
+void bench_concurrent_map() {
+  const uint32_t kCount = 100000;
+  using Map = ConcurrentMap<uint32_t, uint32_t>;
+  benchmark("ConcurrentMap: insert", kCount,
+            [] { return std::make_unique<Map>(); },
+            [&](std::unique_ptr<Map>& map) {
+              for (uint32_t i = 0; i < kCount; i++) {
+                map->insert(std::make_pair(i * 7919, i));
+              }
+            });
+
+  Map map;
+  for (uint32_t i = 0; i < kCount; i++) {
+    map.insert(std::make_pair(i * 7919, i));
+  }
+  benchmark("ConcurrentMap: find", kCount, [&] {
+    size_t found = 0;
+    for (uint32_t i = 0; i < kCount; i++) {
+      found += map.find(i * 7919) != map.end();
+    }
+    always_assert(found == kCount);
+  });
+  benchmark("ConcurrentMap: update", kCount, [&] {
+    for (uint32_t i = 0; i < kCount; i++) {
+      map.update(i * 7919, [](const uint32_t&, uint32_t& v, bool) { v++; });
+    }
+  });
+}
+
+void bench_patricia_tree_environment() {
+  using Domain = sparta::ConstantAbstractDomain<int64_t>;
+  using Environment = sparta::PatriciaTreeMapAbstractEnvironment<uint32_t,
+                                                                 Domain>;
+  const uint32_t kCount = 10000;
+  // `b` and `c` share the even keys of `a`, and bind keys of their own. Half
+  // of the shared keys of `b` are bound to other constants, so that the join
+  // has work to do, and none of those of `c` are, so that the meet doesn't
+  // just give bottom.
+  Environment a, b, c;
+  for (uint32_t i = 0; i < kCount; i++) {
+    a.set(2 * i, Domain(i));
+    b.set(2 * i, Domain(i % 2 == 0 ? i : i + 1));
+    b.set(2 * i + 1, Domain(i));
+    c.set(2 * i, Domain(i));
+    c.set(2 * i + 1, Domain(i));
+  }
+  benchmark("PatriciaTreeMapAbstractEnvironment: join", kCount,
+            [&] { return a; },
+            [&](Environment& env) { env.join_with(b); });
+  benchmark("PatriciaTreeMapAbstractEnvironment: meet", kCount,
+            [&] { return a; },
+            [&](Environment& env) { env.meet_with(c); });
+}
+
+/*
+ * A method of `blocks` diamonds, each of which uses a fresh register, so that
+ * the register allocator has many live ranges to color.
+ */
+std::unique_ptr<IRCode> make_synthetic_code(size_t blocks) {
+  std::string s = "(\n (const v0 0)\n";
+  for (size_t i = 0; i < blocks; i++) {
+    auto reg = "v" + std::to_string(i + 1);
+    auto label = ":L" + std::to_string(i);
+    s += " (const " + reg + " " + std::to_string(i) + ")\n";
+    s += " (add-int v0 v0 " + reg + ")\n";
+    s += " (if-eqz v0 " + label + ")\n";
+    s += " (mul-int v0 v0 " + reg + ")\n";
+    s += " (" + label + ")\n";
+  }
+  s += " (return v0)\n)\n";
+  auto code = assembler::ircode_from_string(s);
+  code->set_registers_size(blocks + 1);
+  return code;
+}
+
+size_t count_opcodes(IRCode* code) {
+  size_t count = 0;
+  for (const auto& mie : InstructionIterable(code)) {
+    (void)mie;
+    count++;
+  }
+  return count;
+}
+
+void bench_code() {
+  const size_t kBlocks = 200;
+  auto code = make_synthetic_code(kBlocks);
+  auto insns = count_opcodes(code.get());
+  auto copy = [&] { return std::make_unique<IRCode>(*code); };
+
+  benchmark("IRCode: copy", insns,
+            [] { return std::unique_ptr<IRCode>(); },
+            [&](std::unique_ptr<IRCode>& c) { c = copy(); });
+  benchmark("IRList: iterate instructions", insns, [&] {
+    size_t count = 0;
+    for (const auto& mie : InstructionIterable(code.get())) {
+      count += mie.insn->opcode() != OPCODE_NOP;
+    }
+    always_assert(count == insns);
+  });
+  benchmark("ControlFlowGraph: build", insns, copy,
+            [](std::unique_ptr<IRCode>& c) {
+              c->build_cfg(/* editable */ false);
+            });
+  benchmark("ControlFlowGraph: build editable", insns, copy,
+            [](std::unique_ptr<IRCode>& c) {
+              c->build_cfg(/* editable */ true);
+            });
+  benchmark("ControlFlowGraph: linearize", insns,
+            [&] {
+              auto c = copy();
+              c->build_cfg(/* editable */ true);
+              return c;
+            },
+            [](std::unique_ptr<IRCode>& c) { c->clear_cfg(); });
+
+  benchmark("graph_coloring::Allocator: allocate", insns, copy,
+            [](std::unique_ptr<IRCode>& c) {
+              c->build_cfg(/* editable */ false);
+              transform::remove_unreachable_blocks(c.get());
+              live_range::renumber_registers(c.get(), /* width_aware */ false);
+              regalloc::graph_coloring::Allocator allocator;
+              allocator.allocate(c.get());
+              c->clear_cfg();
+            });
+
+  auto method = static_cast<DexMethod*>(
+      DexMethod::make_method("LBench;.run:()I"));
+  method->make_concrete(ACC_PUBLIC | ACC_STATIC, copy(), false);
+  benchmark("DexCode: lower, sync and encode", insns,
+            [&] {
+              method->set_code(copy());
+              return std::vector<uint32_t>(insns * 4);
+            },
+            [&](std::vector<uint32_t>& output) {
+              instruction_lowering::lower(method);
+              auto dex_code = method->get_code()->sync(method);
+              DexOutputIdx dodx(new dexstring_to_idx(), new dextype_to_idx(),
+                                new dexproto_to_idx(), new dexfield_to_idx(),
+                                new dexmethod_to_idx(), nullptr);
+              dex_code->encode(&dodx, output.data());
+            });
+}
+
+} // namespace
+
+int main() {
+  g_redex = new RedexContext();
+  bench_interning();
+  bench_concurrent_map();
+  bench_patricia_tree_environment();
+  bench_code();
+  delete g_redex;
+}
@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Creators.h"
+#include "CrossStoreRefs.h"
+#include "DexUtil.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+struct CrossStoreRefsTest : public RedexTest {};
+
+namespace {
+
+DexClass* make_class(const std::string& name, const std::string& code) {
+  ClassCreator creator(DexType::make_type(name.c_str()));
+  creator.set_super(get_object_type());
+  creator.add_method(assembler::method_from_string(
+      "(method (public static) \"" + name + ".foo:()V\" (" + code +
+      " (return-void)))"));
+  return creator.create();
+}
+
+DexStore make_store(const std::string& name,
+                    const std::vector<std::string>& dependencies,
+                    DexClass* cls) {
+  DexMetadata metadata;
+  metadata.set_id(name);
+  metadata.get_dependencies() = dependencies;
+  DexStore store(metadata);
+  store.add_classes({cls});
+  return store;
+}
+
+} // namespace
+
+TEST_F(CrossStoreRefsTest, findsReferencesToStoresThatAreNotDependencies) {
+  auto root = make_class("LRoot;", "");
+  auto leaf = make_class("LLeaf;", "");
+  auto mid = make_class("LMid;",
+                        "(new-instance \"LLeaf;\") "
+                        "(move-result-pseudo-object v0)");
+  auto user = make_class("LUser;",
+                         "(const-class \"LMid;\") "
+                         "(move-result-pseudo-object v0) "
+                         "(new-instance \"LLeaf;\") "
+                         "(move-result-pseudo-object v0) "
+                         "(sget-object \"LRoot;.f:LRoot;\") "
+                         "(move-result-pseudo-object v0)");
+  DexStoresVector stores;
+  stores.push_back(make_store("classes", {}, root));
+  stores.push_back(make_store("leaf", {}, leaf));
+  stores.push_back(make_store("mid", {"leaf"}, mid));
+  stores.push_back(make_store("user", {"mid"}, user));
+
+  auto refs = find_cross_store_refs(stores, /* root_store_visible */ false);
+  // Sorted by source store and then by target store.
+  std::vector<std::tuple<const DexClass*, const DexClass*, bool>> expected{
+      {mid, leaf, true},
+      {user, root, false},
+      {user, leaf, true},
+      {user, mid, true}};
+  std::vector<std::tuple<const DexClass*, const DexClass*, bool>> actual;
+  for (const auto& ref : refs) {
+    actual.emplace_back(ref.source, ref.target, ref.allowed);
+  }
+  EXPECT_EQ(actual, expected);
+
+  // Only the reference to the root store was illegal.
+  refs = find_cross_store_refs(stores, /* root_store_visible */ true);
+  for (const auto& ref : refs) {
+    EXPECT_TRUE(ref.allowed);
+  }
+}
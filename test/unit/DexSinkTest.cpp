@@ -0,0 +1,48 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <string>
+
+#include "DexSink.h"
+
+namespace {
+
+std::string temp_path() {
+  return (boost::filesystem::temp_directory_path() /
+          boost::filesystem::unique_path("dex-sink-%%%%%%.dex"))
+      .string();
+}
+
+std::string read_file(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+TEST(DexSink, sectionsAreWrittenInOrderAndPatchedAtTheEnd) {
+  auto path = temp_path();
+  {
+    FileDexSink sink(path);
+    // The front is left out until the data after it is written.
+    sink.write(4, "data", 4);
+    sink.write(8, "more", 4);
+    char back[5] = {};
+    sink.read(4, back, 4);
+    EXPECT_STREQ(back, "data");
+    sink.write(6, "TA", 2);
+    sink.write(0, "head", 4);
+    sink.close();
+  }
+  EXPECT_EQ(read_file(path), "headdaTAmore");
+  boost::filesystem::remove(path);
+}
@@ -0,0 +1,38 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "DexStructure.h"
+
+using namespace interdex;
+
+TEST(DexStructureTest, RefIdSet) {
+  g_redex = new RedexContext();
+  auto a = DexType::make_type("LA;");
+  auto b = DexType::make_type("LB;");
+  auto c = DexType::make_type("LC;");
+
+  RefIds<DexType> ids;
+  auto ab = ids.get_or_assign({a, b});
+  auto bc = ids.get_or_assign({b, c});
+  uint32_t id;
+  EXPECT_TRUE(ids.find(c, &id));
+  EXPECT_FALSE(ids.find(DexType::make_type("LD;"), &id));
+
+  RefIdSet set;
+  EXPECT_EQ(set.count_missing(ab), 2);
+  set.insert(ab);
+  EXPECT_EQ(set.size(), 2);
+  EXPECT_EQ(set.count_missing(ab), 0);
+  EXPECT_EQ(set.count_missing(bc), 1);
+  set.insert(bc);
+  EXPECT_EQ(set.size(), 3);
+  EXPECT_TRUE(set.contains(id));
+
+  delete g_redex;
+}
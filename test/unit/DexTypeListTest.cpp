@@ -0,0 +1,36 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "DexClass.h"
+#include "RedexTest.h"
+
+struct DexTypeListTest : public RedexTest {};
+
+TEST_F(DexTypeListTest, interning) {
+  auto a = DexType::make_type("LA;");
+  auto b = DexType::make_type("LB;");
+
+  auto empty = DexTypeList::make_type_list({});
+  EXPECT_TRUE(empty->empty());
+  EXPECT_EQ(empty, DexTypeList::make_type_list({}));
+
+  auto ab = DexTypeList::make_type_list({a, b});
+  EXPECT_EQ(ab->size(), 2u);
+  EXPECT_EQ(ab->front(), a);
+  EXPECT_EQ(ab->back(), b);
+  EXPECT_EQ(ab->to_deque(), std::deque<DexType*>({a, b}));
+  EXPECT_EQ(ab, DexTypeList::make_type_list({a, b}));
+  EXPECT_EQ(ab, DexTypeList::get_type_list({a, b}));
+
+  EXPECT_EQ(nullptr, DexTypeList::get_type_list({b, a}));
+  auto ba = DexTypeList::make_type_list({b, a});
+  EXPECT_NE(ab, ba);
+  EXPECT_EQ(ba->front(), b);
+  EXPECT_TRUE(*ab < *ba || *ba < *ab);
+}
@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Creators.h"
+#include "FieldOpTracker.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+using namespace field_op_tracker;
+
+struct FieldOpTrackerTest : public RedexTest {
+  FieldOpTrackerTest() {
+    ClassCreator cc(DexType::make_type("LFoo;"));
+    cc.set_super(get_object_type());
+    m_field = static_cast<DexField*>(DexField::make_field("LFoo;.bar:I"));
+    m_field->make_concrete(ACC_PUBLIC | ACC_STATIC,
+                           DexEncodedValue::zero_for_type(get_int_type()));
+    cc.add_field(m_field);
+    m_clinit = assembler::method_from_string(R"(
+      (method (public static) "LFoo;.<clinit>:()V"
+       (
+        (const v0 1)
+        (sput v0 "LFoo;.bar:I")
+        (sget "LFoo;.bar:I")
+        (move-result-pseudo v0)
+        (return-void)
+       )
+      )
+    )");
+    cc.add_method(m_clinit);
+    m_reader = assembler::method_from_string(R"(
+      (method (public static) "LFoo;.read:()I"
+       (
+        (sget "LFoo;.bar:I")
+        (move-result-pseudo v0)
+        (sget "LFoo;.bar:I")
+        (move-result-pseudo v1)
+        (return v0)
+       )
+      )
+    )");
+    cc.add_method(m_reader);
+    m_scope = {cc.create()};
+  }
+
+  static void expect_stats(const FieldStats& stats,
+                           size_t reads,
+                           size_t reads_outside_init,
+                           size_t writes) {
+    EXPECT_EQ(stats.reads, reads);
+    EXPECT_EQ(stats.reads_outside_init, reads_outside_init);
+    EXPECT_EQ(stats.writes, writes);
+  }
+
+  DexField* m_field;
+  DexMethod* m_clinit;
+  DexMethod* m_reader;
+  Scope m_scope;
+};
+
+TEST_F(FieldOpTrackerTest, analyze) {
+  auto field_stats = analyze(m_scope);
+  ASSERT_EQ(field_stats.size(), 1);
+  expect_stats(field_stats.at(m_field), 3, 2, 1);
+}
+
+TEST_F(FieldOpTrackerTest, recount) {
+  FieldStatsTracker tracker(m_scope);
+  ASSERT_EQ(tracker.field_stats().size(), 1);
+  expect_stats(tracker.field_stats().at(m_field), 3, 2, 1);
+
+  auto* code = m_reader->get_code();
+  for (auto it = code->begin(); it != code->end(); ++it) {
+    if (it->type == MFLOW_OPCODE && is_sget(it->insn->opcode())) {
+      code->remove_opcode(it);
+      break;
+    }
+  }
+  tracker.recount({m_reader});
+  expect_stats(tracker.field_stats().at(m_field), 2, 1, 1);
+  EXPECT_EQ(tracker.field_stats().at(m_field).reads,
+            analyze(m_scope).at(m_field).reads);
+
+  // A method that loses its code takes its counts with it.
+  m_clinit->set_code(nullptr);
+  m_reader->set_code(nullptr);
+  tracker.recount({m_clinit, m_reader});
+  EXPECT_TRUE(tracker.field_stats().empty());
+  EXPECT_TRUE(analyze(m_scope).empty());
+}
@@ -38,3 +38,92 @@ TEST_F(FinalInlineTest, encodeValues) {
   EXPECT_EQ(cls->get_clinit(), nullptr);
   EXPECT_EQ(field_bar->get_static_value()->value(), 1);
 }
+
+namespace {
+
+DexClass* create_class_with_clinit(const std::string& name,
+                                   const std::string& clinit) {
+  ClassCreator cc(DexType::make_type(DexString::make_string(name)));
+  cc.set_super(get_object_type());
+  auto field = static_cast<DexField*>(DexField::make_field(name + ".f:I"));
+  field->make_concrete(ACC_PUBLIC | ACC_STATIC | ACC_FINAL,
+                       DexEncodedValue::zero_for_type(get_int_type()));
+  cc.add_field(field);
+  cc.add_method(assembler::method_from_string(clinit));
+  return cc.create();
+}
+
+} // namespace
+
+TEST_F(FinalInlineTest, dependentClinits) {
+  // Each class depends on the one before it. They are passed in reverse, so
+  // every one of them must wait for the others.
+  auto foo = create_class_with_clinit("LFoo;", R"(
+    (method (public static) "LFoo;.<clinit>:()V"
+     (
+      (const v0 1)
+      (sput v0 "LFoo;.f:I")
+      (return-void)
+     )
+    )
+  )");
+  auto bar = create_class_with_clinit("LBar;", R"(
+    (method (public static) "LBar;.<clinit>:()V"
+     (
+      (sget "LFoo;.f:I")
+      (move-result-pseudo v0)
+      (add-int/lit8 v0 v0 1)
+      (sput v0 "LBar;.f:I")
+      (return-void)
+     )
+    )
+  )");
+  auto baz = create_class_with_clinit("LBaz;", R"(
+    (method (public static) "LBaz;.<clinit>:()V"
+     (
+      (sget "LBar;.f:I")
+      (move-result-pseudo v0)
+      (add-int/lit8 v0 v0 1)
+      (sput v0 "LBaz;.f:I")
+      (return-void)
+     )
+    )
+  )");
+
+  FinalInlinePassV2::run({baz, bar, foo});
+
+  for (auto* cls : {foo, bar, baz}) {
+    EXPECT_EQ(cls->get_clinit(), nullptr) << show(cls);
+  }
+  EXPECT_EQ(foo->get_sfields()[0]->get_static_value()->value(), 1);
+  EXPECT_EQ(bar->get_sfields()[0]->get_static_value()->value(), 2);
+  EXPECT_EQ(baz->get_sfields()[0]->get_static_value()->value(), 3);
+}
+
+TEST_F(FinalInlineTest, clinitCycle) {
+  auto foo = create_class_with_clinit("LFoo;", R"(
+    (method (public static) "LFoo;.<clinit>:()V"
+     (
+      (sget "LBar;.f:I")
+      (move-result-pseudo v0)
+      (sput v0 "LFoo;.f:I")
+      (return-void)
+     )
+    )
+  )");
+  auto bar = create_class_with_clinit("LBar;", R"(
+    (method (public static) "LBar;.<clinit>:()V"
+     (
+      (sget "LFoo;.f:I")
+      (move-result-pseudo v0)
+      (sput v0 "LBar;.f:I")
+      (return-void)
+     )
+    )
+  )");
+
+  EXPECT_THROW(final_inline::analyze_and_simplify_clinits({foo, bar}),
+               final_inline::class_initialization_cycle);
+  EXPECT_NE(foo->get_clinit(), nullptr);
+  EXPECT_NE(bar->get_clinit(), nullptr);
+}
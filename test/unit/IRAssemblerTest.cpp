@@ -323,12 +323,44 @@ TEST_F(IRAssemblerTest, pos) {
   auto positions = get_positions(code);
   ASSERT_EQ(positions.size(), 1);
   auto pos = positions[0];
-  EXPECT_EQ(show(pos->method), std::string("LFoo;.bar:()V"));
-  EXPECT_EQ(pos->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos->method()), std::string("LFoo;.bar:()V"));
+  EXPECT_EQ(pos->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos->line, 420);
   EXPECT_EQ(pos->parent, nullptr);
 }
 
+TEST_F(IRAssemblerTest, posSharesOrigin) {
+  auto method =
+      static_cast<DexMethod*>(DexMethod::make_method("LFoo;.bar:()V"));
+  method->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+
+  auto code = assembler::ircode_from_string(R"(
+    (
+     (.pos "LFoo;.bar:()V" "Foo.java" "420")
+     (const v0 420)
+     (.pos "LFoo;.bar:()V" "Foo.java" "421")
+     (const v1 421)
+     (.pos "LFoo;.bar:()V" "Bar.java" "421")
+     (const v2 421)
+    )
+  )");
+
+  auto positions = get_positions(code);
+  ASSERT_EQ(positions.size(), 3);
+  EXPECT_EQ(positions[0]->origin, positions[1]->origin);
+  EXPECT_NE(positions[1]->origin, positions[2]->origin);
+  EXPECT_EQ(positions[2]->method(), method);
+  EXPECT_EQ(positions[2]->file()->c_str(), std::string("Bar.java"));
+
+  DexPosition copy(*positions[1]);
+  EXPECT_EQ(copy, *positions[1]);
+  EXPECT_FALSE(*positions[1] == *positions[2]);
+
+  DexPosition unbound(421);
+  EXPECT_EQ(unbound.method(), nullptr);
+  EXPECT_EQ(unbound.file(), nullptr);
+}
+
 TEST_F(IRAssemblerTest, posWithParent_DbgLabel) {
   auto method =
       static_cast<DexMethod*>(DexMethod::make_method("LFoo;.bar:()V"));
@@ -356,14 +388,14 @@ TEST_F(IRAssemblerTest, posWithParent_DbgLabel) {
   ASSERT_EQ(positions.size(), 2);
 
   auto pos0 = positions[0];
-  EXPECT_EQ(show(pos0->method), std::string("LFoo;.bar:()V"));
-  EXPECT_EQ(pos0->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos0->method()), std::string("LFoo;.bar:()V"));
+  EXPECT_EQ(pos0->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos0->line, 420);
   EXPECT_EQ(pos0->parent, nullptr);
 
   auto pos1 = positions[1];
-  EXPECT_EQ(show(pos1->method), std::string("LFoo;.baz:()I"));
-  EXPECT_EQ(pos1->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos1->method()), std::string("LFoo;.baz:()I"));
+  EXPECT_EQ(pos1->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos1->line, 440);
   EXPECT_EQ(*pos1->parent, *pos0);
 }
@@ -395,14 +427,14 @@ TEST_F(IRAssemblerTest, posWithParent_UserLabel) {
   ASSERT_EQ(positions.size(), 2);
 
   auto pos0 = positions[0];
-  EXPECT_EQ(show(pos0->method), std::string("LFoo;.bar:()V"));
-  EXPECT_EQ(pos0->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos0->method()), std::string("LFoo;.bar:()V"));
+  EXPECT_EQ(pos0->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos0->line, 420);
   EXPECT_EQ(pos0->parent, nullptr);
 
   auto pos1 = positions[1];
-  EXPECT_EQ(show(pos1->method), std::string("LFoo;.baz:()I"));
-  EXPECT_EQ(pos1->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos1->method()), std::string("LFoo;.baz:()I"));
+  EXPECT_EQ(pos1->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos1->line, 440);
   EXPECT_EQ(*pos1->parent, *pos0);
 }
@@ -434,14 +466,14 @@ TEST_F(IRAssemblerTest, posWithParent_BadParent) {
   ASSERT_EQ(positions.size(), 2);
 
   auto pos0 = positions[0];
-  EXPECT_EQ(show(pos0->method), std::string("LFoo;.bar:()V"));
-  EXPECT_EQ(pos0->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos0->method()), std::string("LFoo;.bar:()V"));
+  EXPECT_EQ(pos0->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos0->line, 420);
   EXPECT_EQ(pos0->parent, nullptr);
 
   auto pos1 = positions[1];
-  EXPECT_EQ(show(pos1->method), std::string("LFoo;.baz:()I"));
-  EXPECT_EQ(pos1->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos1->method()), std::string("LFoo;.baz:()I"));
+  EXPECT_EQ(pos1->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos1->line, 440);
   EXPECT_EQ(pos1->parent, nullptr);
 }
@@ -477,14 +509,14 @@ TEST_F(IRAssemblerTest, posWithGrandparent) {
   ASSERT_EQ(positions.size(), 3);
 
   auto pos0 = positions[0];
-  EXPECT_EQ(show(pos0->method), std::string("LFoo;.bar:()V"));
-  EXPECT_EQ(pos0->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos0->method()), std::string("LFoo;.bar:()V"));
+  EXPECT_EQ(pos0->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos0->line, 420);
   EXPECT_EQ(pos0->parent, nullptr);
 
   auto pos2 = positions[2];
-  EXPECT_EQ(show(pos2->method), std::string("LFoo;.baz:()Z"));
-  EXPECT_EQ(pos2->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos2->method()), std::string("LFoo;.baz:()Z"));
+  EXPECT_EQ(pos2->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos2->line, 441);
   EXPECT_EQ(*pos2->parent->parent, *pos0);
 }
@@ -521,14 +553,14 @@ TEST_F(IRAssemblerTest, posWithGreatGrandparent) {
   ASSERT_EQ(positions.size(), 4);
 
   auto pos0 = positions[0];
-  EXPECT_EQ(show(pos0->method), std::string("LFoo;.bar:()V"));
-  EXPECT_EQ(pos0->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos0->method()), std::string("LFoo;.bar:()V"));
+  EXPECT_EQ(pos0->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos0->line, 420);
   EXPECT_EQ(pos0->parent, nullptr);
 
   auto pos3 = positions[3];
-  EXPECT_EQ(show(pos3->method), std::string("LFoo;.baz:()Z"));
-  EXPECT_EQ(pos3->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos3->method()), std::string("LFoo;.baz:()Z"));
+  EXPECT_EQ(pos3->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos3->line, 442);
   EXPECT_EQ(*pos3->parent->parent->parent, *pos0);
 }
@@ -154,3 +154,25 @@ TEST_F(IRCodeTest, try_region) {
   EXPECT_EQ(split, second->m_start_addr);
   EXPECT_EQ(num * op->size() - split, second->m_insn_count);
 }
+
+TEST_F(IRCodeTest, balloonLazily) {
+  auto method =
+      static_cast<DexMethod*>(DexMethod::make_method("LFoo;.lazy:()V"));
+  method->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (const v0 0)
+      (return-void)
+    )
+  )");
+  auto expected = assembler::to_s_expr(code.get());
+  method->set_code(std::move(code));
+  instruction_lowering::lower(method);
+  method->sync();
+
+  method->balloon_lazily();
+  EXPECT_NE(nullptr, method->get_dex_code());
+
+  EXPECT_EQ(expected, assembler::to_s_expr(method->get_code()));
+  EXPECT_EQ(nullptr, method->get_dex_code());
+}
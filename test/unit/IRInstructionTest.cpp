@@ -419,3 +419,28 @@ TEST(IRInstruction, InvokeSourceIsWideComplex2) {
 
   delete g_redex;
 }
+
+TEST(IRInstruction, SrcsSpillToHeap) {
+  IRInstruction insn(OPCODE_INVOKE_STATIC);
+  insn.set_arg_word_count(3);
+  for (size_t i = 0; i < 3; ++i) {
+    insn.set_src(i, i + 10);
+  }
+  // Growing past the inline capacity keeps the existing registers.
+  insn.set_arg_word_count(8);
+  EXPECT_EQ(insn.srcs_vec(),
+            std::vector<uint16_t>({10, 11, 12, 0, 0, 0, 0, 0}));
+  insn.set_src(7, 17);
+
+  IRInstruction copy(insn);
+  EXPECT_EQ(copy, insn);
+  copy.set_src(7, 27);
+  EXPECT_NE(copy, insn);
+  EXPECT_EQ(insn.src(7), 17);
+
+  // Shrinking back moves the registers into the instruction again.
+  insn.set_arg_word_count(2);
+  EXPECT_EQ(insn.srcs_vec(), std::vector<uint16_t>({10, 11}));
+  copy = insn;
+  EXPECT_EQ(copy.srcs_vec(), std::vector<uint16_t>({10, 11}));
+}
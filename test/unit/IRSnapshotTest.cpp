@@ -0,0 +1,290 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "Creators.h"
+#include "DexAnnotation.h"
+#include "DexInstruction.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "IRSnapshot.h"
+#include "RedexTest.h"
+#include "Show.h"
+
+namespace {
+
+DexAnnotationSet* make_annotations(DexType* self) {
+  auto anno = new DexAnnotation(DexType::make_type("LAnno;"), DAV_RUNTIME);
+  anno->add_element("name",
+                    new DexEncodedValueString(DexString::make_string("foo")));
+  anno->add_element(
+      "values",
+      new DexEncodedValueArray(new std::deque<DexEncodedValue*>{
+          DexEncodedValue::make_numeric(DEVT_INT, 42),
+          new DexEncodedValueType(self)}));
+  auto aset = new DexAnnotationSet();
+  aset->add_annotation(anno);
+  return aset;
+}
+
+// A class with fields, annotations, code with positions, try/catch, switches
+// and debug entries, a fill-array-data payload, and a method without code.
+DexClass* make_foo() {
+  auto self = DexType::make_type("LFoo;");
+  ClassCreator cc(self, "classes.dex");
+  cc.set_super(get_object_type());
+  cc.set_access(ACC_PUBLIC);
+  cc.add_interface(DexType::make_type("Ljava/lang/Runnable;"));
+  auto cls = cc.get_class();
+  cls->set_source_file(DexString::make_string("Foo.java"));
+  cls->attach_annotation_set(make_annotations(self));
+
+  auto count = static_cast<DexField*>(DexField::make_field("LFoo;.count:I"));
+  count->make_concrete(ACC_PUBLIC | ACC_STATIC,
+                       DexEncodedValue::make_numeric(DEVT_INT, 7));
+  cc.add_field(count);
+  auto name = static_cast<DexField*>(
+      DexField::make_field("LFoo;.name:Ljava/lang/String;"));
+  name->attach_annotation_set(make_annotations(self));
+  name->make_concrete(ACC_PRIVATE);
+  cc.add_field(name);
+
+  auto run = assembler::method_from_string(R"(
+    (method (public) "LFoo;.run:()V"
+     (
+      (load-param-object v3)
+      (.pos:dbg_0 "LFoo;.run:()V" "Foo.java" 10)
+      (.pos:dbg_1 "LFoo;.bar:()I" "Bar.java" 20 dbg_0)
+      (sget "LFoo;.count:I")
+      (move-result-pseudo v0)
+      (.try_start a)
+      (invoke-static (v0) "LFoo;.check:(I)V")
+      (.try_end a)
+      (sparse-switch v0 (:b :c))
+      (const-string "hello")
+      (move-result-pseudo-object v1)
+      (:b 0)
+      (const-wide v4 12345678901)
+      (:c 1)
+      (return-void)
+      (.catch (a) "Ljava/lang/Exception;")
+      (return-void)
+     )
+    )
+  )");
+  cc.add_method(run);
+
+  auto fill =
+      static_cast<DexMethod*>(DexMethod::make_method("LFoo;.fill:([S)V"));
+  auto fill_code = std::make_unique<IRCode>();
+  fill_code->push_back(new IRInstruction(IOPCODE_LOAD_PARAM_OBJECT));
+  fill_code->begin()->insn->set_dest(0);
+  fill_code->push_back(std::unique_ptr<DexDebugInstruction>(
+      new DexDebugOpcodeStartLocal(0, DexString::make_string("values"),
+                                   DexType::make_type("[S"))));
+  fill_code->push_back(std::make_unique<DexDebugInstruction>(
+      DBG_ADVANCE_LINE, static_cast<int32_t>(-3)));
+  // Three shorts.
+  const uint16_t payload[] = {FOPCODE_FILLED_ARRAY, 2, 3, 0, 1, 2, 3};
+  auto insn = new IRInstruction(OPCODE_FILL_ARRAY_DATA);
+  insn->set_src(0, 0);
+  insn->set_data(new DexOpcodeData(payload, 6));
+  fill_code->push_back(insn);
+  fill_code->push_back(new IRInstruction(OPCODE_RETURN_VOID));
+  fill_code->set_registers_size(1);
+  fill_code->set_debug_item(std::make_unique<DexDebugItem>());
+  fill_code->get_debug_item()->get_param_names().push_back(
+      DexString::make_string("values"));
+  fill->make_concrete(ACC_PUBLIC | ACC_STATIC, std::move(fill_code), false);
+  cc.add_method(fill);
+
+  auto native =
+      static_cast<DexMethod*>(DexMethod::make_method("LFoo;.nat:(I)V"));
+  native->attach_param_annotation_set(0, make_annotations(self));
+  native->make_concrete(ACC_PUBLIC | ACC_NATIVE, true);
+  cc.add_method(native);
+
+  return cc.create();
+}
+
+DexClass* make_bar() {
+  ClassCreator cc(DexType::make_type("LBar;"), "other.dex");
+  cc.set_super(DexType::make_type("LFoo;"));
+  return cc.create();
+}
+
+DexStoresVector make_stores() {
+  DexStoresVector stores;
+  stores.emplace_back("classes");
+  stores.back().add_classes({make_foo()});
+  stores.emplace_back("other");
+  stores.back().add_classes({});
+  stores.back().add_classes({make_bar()});
+  return stores;
+}
+
+std::string describe(IRCode* code) {
+  std::ostringstream ss;
+  ss << "registers " << code->get_registers_size() << "\n";
+  if (code->get_debug_item() != nullptr) {
+    for (auto param : code->get_debug_item()->get_param_names()) {
+      ss << "param " << show(param) << "\n";
+    }
+  }
+  for (const auto& mie : *code) {
+    if (mie.type == MFLOW_DEBUG) {
+      ss << show(mie.dbgop) << "\n";
+    } else if (mie.type == MFLOW_OPCODE && mie.insn->has_data()) {
+      auto data = mie.insn->get_data();
+      ss << show(mie.insn) << " " << data->size() << ":";
+      for (size_t i = 0; i < data->data_size(); ++i) {
+        ss << " " << data->data()[i];
+      }
+      ss << "\n";
+    } else if (mie.type == MFLOW_OPCODE) {
+      ss << show(mie.insn) << "\n";
+    }
+  }
+  if (assembler::can_express(code)) {
+    ss << assembler::to_string(code) << "\n";
+  }
+  return ss.str();
+}
+
+// Describes the stores in detail, and in a stable order.
+std::string describe(const DexStoresVector& stores) {
+  std::ostringstream ss;
+  for (const auto& store : stores) {
+    ss << "store " << store.get_name() << "\n";
+    for (const auto& dex : store.get_dexen()) {
+      ss << "dex\n";
+      for (auto cls : dex) {
+        ss << show(cls) << " " << cls->get_access() << " "
+           << show(cls->get_super_class()) << " "
+           << show(cls->get_interfaces()) << " "
+           << show(cls->get_source_file()) << " " << cls->get_location()
+           << " " << show(cls->get_anno_set()) << "\n";
+        for (const auto& fields : {cls->get_sfields(), cls->get_ifields()}) {
+          for (auto field : fields) {
+            ss << show(field) << " " << field->get_access() << " "
+               << show(field->get_anno_set()) << " "
+               << show(field->get_static_value()) << "\n";
+          }
+        }
+        for (const auto& methods :
+             {cls->get_dmethods(), cls->get_vmethods()}) {
+          for (auto method : methods) {
+            ss << show(method) << " " << method->get_access() << " "
+               << method->is_virtual() << " "
+               << show(method->get_anno_set()) << "\n";
+            if (method->get_param_anno() != nullptr) {
+              for (const auto& pair : *method->get_param_anno()) {
+                ss << "param " << pair.first << " " << show(pair.second)
+                   << "\n";
+              }
+            }
+            if (method->get_code() != nullptr) {
+              ss << describe(method->get_code());
+            }
+          }
+        }
+      }
+    }
+  }
+  return ss.str();
+}
+
+std::string read_file(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+struct IRSnapshotTest : public RedexTest {
+  IRSnapshotTest() {
+    m_dir = boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path("ir-snapshot-%%%%%%");
+    boost::filesystem::create_directories(m_dir / "first");
+    boost::filesystem::create_directories(m_dir / "second");
+  }
+
+  ~IRSnapshotTest() { boost::filesystem::remove_all(m_dir); }
+
+  std::string dir(const std::string& name) const {
+    return (m_dir / name).string();
+  }
+
+  // Loads the snapshot into a fresh context.
+  bool load(const std::string& dir, DexStoresVector* stores) {
+    delete g_redex;
+    g_redex = new RedexContext();
+    return ir_snapshot::load(dir, *stores);
+  }
+
+ private:
+  boost::filesystem::path m_dir;
+};
+
+TEST_F(IRSnapshotTest, roundTrip) {
+  auto stores = make_stores();
+  auto expected = describe(stores);
+  // The empty dex is left out, as in the intermediate dexes.
+  boost::replace_first(expected, "store other\ndex\n", "store other\n");
+  ir_snapshot::dump(stores, dir("first"));
+
+  DexStoresVector loaded;
+  ASSERT_TRUE(load(dir("first"), &loaded));
+  EXPECT_EQ(describe(loaded), expected);
+
+  // The positions are bound to their methods, and keep their parent.
+  auto run = static_cast<DexMethod*>(DexMethod::get_method("LFoo;.run:()V"));
+  auto code = run->get_code();
+  std::vector<DexPosition*> positions;
+  for (const auto& mie : *code) {
+    if (mie.type == MFLOW_POSITION) {
+      positions.push_back(mie.pos.get());
+    }
+  }
+  ASSERT_EQ(positions.size(), 2);
+  EXPECT_EQ(positions[1]->parent, positions[0]);
+  EXPECT_EQ(show(positions[1]->method()), "LFoo;.bar:()I");
+  EXPECT_EQ(show(positions[1]->file()), "Bar.java");
+
+  // A snapshot of what was loaded is the same snapshot.
+  ir_snapshot::dump(loaded, dir("second"));
+  EXPECT_EQ(read_file(dir("second") + "/irsnapshot.bin"),
+            read_file(dir("first") + "/irsnapshot.bin"));
+}
+
+TEST_F(IRSnapshotTest, otherSnapshotsAreIgnored) {
+  DexStoresVector loaded;
+  EXPECT_FALSE(load(dir("first"), &loaded));
+
+  ir_snapshot::dump(make_stores(), dir("first"));
+  auto path = dir("first") + "/irsnapshot.bin";
+  auto contents = read_file(path);
+
+  // A snapshot of another version of the format.
+  auto other = contents;
+  boost::replace_first(other, "redex-ir-snapshot-1", "redex-ir-snapshot-0");
+  std::ofstream(path, std::ios::binary) << other;
+  EXPECT_FALSE(load(dir("first"), &loaded));
+
+  // A truncated snapshot.
+  std::ofstream(path, std::ios::binary) << contents.substr(0, 100);
+  EXPECT_FALSE(load(dir("first"), &loaded));
+  EXPECT_TRUE(loaded.empty());
+}
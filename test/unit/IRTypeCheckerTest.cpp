@@ -729,3 +729,75 @@ TEST_F(IRTypeCheckerTest, joinDexTypesSharingCommonBaseSimple) {
   EXPECT_EQ(type_base, checker.get_dex_type(insns[8], 0));
   EXPECT_EQ(type_base, checker.get_dex_type(insns[9], 0));
 }
+
+TEST_F(IRTypeCheckerTest, checkOnlyFindsTheSameError) {
+  using namespace dex_asm;
+  std::vector<IRInstruction*> insns = {
+      dasm(OPCODE_ADD_INT, {5_v, 5_v, 6_v}),
+      dasm(OPCODE_ADD_INT, {5_v, 5_v, 14_v}),
+      dasm(OPCODE_ADD_LONG, {7_v, 7_v, 5_v}),
+      dasm(OPCODE_RETURN, {9_v}),
+  };
+  add_code(insns);
+  IRTypeChecker full(m_method);
+  full.run();
+  IRTypeChecker check_only(m_method);
+  check_only.check_only();
+  check_only.run();
+  EXPECT_TRUE(full.fail());
+  EXPECT_TRUE(check_only.fail());
+  EXPECT_EQ(full.what(), check_only.what());
+}
+
+TEST_F(IRTypeCheckerTest, checkScope) {
+  using namespace dex_asm;
+  auto make_method = [](const std::string& name, bool good) {
+    auto method = static_cast<DexMethod*>(
+        DexMethod::make_method("LScope;." + name + ":(I)V"));
+    method->make_concrete(ACC_PUBLIC | ACC_STATIC, /* is_virtual */ false);
+    auto code = std::make_unique<IRCode>(method, /* temp_regs */ 1);
+    if (!good) {
+      // The parameter is an int, not a reference.
+      code->push_back(dasm(OPCODE_MONITOR_ENTER, {1_v}));
+    }
+    code->push_back(dasm(OPCODE_RETURN_VOID));
+    method->set_code(std::move(code));
+    return method;
+  };
+  ClassCreator creator(DexType::make_type("LScope;"));
+  creator.set_super(get_object_type());
+  std::vector<DexMethod*> bad;
+  for (int i = 0; i < 20; i++) {
+    bool good = i % 5 != 0;
+    auto method = make_method("m" + std::to_string(i), good);
+    creator.add_method(method);
+    if (!good) {
+      bad.push_back(method);
+    }
+  }
+  Scope scope{creator.create()};
+  std::sort(bad.begin(), bad.end(), compare_dexmethods);
+
+  IRTypeChecker::ScopeOptions options;
+  auto result = IRTypeChecker::check_scope(scope, options);
+  EXPECT_EQ(result.checked, 20);
+  ASSERT_EQ(result.failures.size(), bad.size());
+  for (size_t i = 0; i < bad.size(); i++) {
+    EXPECT_EQ(result.failures[i].method, bad[i]);
+    EXPECT_THAT(result.failures[i].what, HasSubstr("Type error"));
+  }
+
+  result = IRTypeChecker::check_scope(
+      scope, options, [&](DexMethod* m) { return m != bad[0]; });
+  EXPECT_EQ(result.checked, 19);
+  EXPECT_EQ(result.failures.size(), bad.size() - 1);
+
+  // With a single worker, nothing else is under way when the first method
+  // fails.
+  options.stop_at_first_failure = true;
+  options.num_threads = 1;
+  result = IRTypeChecker::check_scope(scope, options);
+  ASSERT_EQ(result.failures.size(), 1);
+  EXPECT_GE(result.checked, 1);
+  EXPECT_LT(result.checked, 20);
+}
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "IncrementalPassCache.h"
+#include "RedexTest.h"
+
+struct IncrementalPassCacheTest : public RedexTest {
+  IncrementalPassCacheTest() {
+    m_dir = boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path("incremental-%%%%%%");
+    boost::filesystem::create_directories(m_dir);
+  }
+
+  ~IncrementalPassCacheTest() { boost::filesystem::remove_all(m_dir); }
+
+  std::string dir() const { return m_dir.string(); }
+
+ private:
+  boost::filesystem::path m_dir;
+};
+
+namespace {
+
+DexMethod* make_method() {
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.bar:()I"
+      (
+        (const v0 1)
+        (const v1 2)
+        (return v0)
+      )
+    )
+  )");
+  method->get_code()->set_registers_size(2);
+  return method;
+}
+
+// Stands in for a pass: removes the dead const, and counts the removed
+// instructions.
+IncrementalPassCache::Stats optimize(DexMethod* method) {
+  auto code = method->get_code();
+  for (auto it = code->begin(); it != code->end(); ++it) {
+    if (it->type == MFLOW_OPCODE && it->insn->opcode() == OPCODE_CONST &&
+        it->insn->dest() == 1) {
+      code->remove_opcode(it);
+      return {1};
+    }
+  }
+  return {0};
+}
+
+const char* optimized_code = R"(
+  (
+    (const v0 1)
+    (return v0)
+  )
+)";
+
+} // namespace
+
+TEST_F(IncrementalPassCacheTest, restoresCachedCode) {
+  {
+    IncrementalPassCache cache(dir(), "Pass#1", "config");
+    auto method = make_method();
+    size_t runs = 0;
+    cache.run(method, /* summarize_refs */ true, [&] {
+      ++runs;
+      return optimize(method);
+    });
+    EXPECT_EQ(runs, 1);
+    EXPECT_EQ(cache.hits(), 0);
+    cache.save();
+  }
+
+  IncrementalPassCache cache(dir(), "Pass#1", "config");
+  auto method = make_method();
+  auto stats = cache.run(method, /* summarize_refs */ true, [&] {
+    ADD_FAILURE();
+    return IncrementalPassCache::Stats();
+  });
+  EXPECT_EQ(cache.hits(), 1);
+  EXPECT_EQ(stats, IncrementalPassCache::Stats{1});
+  EXPECT_EQ(assembler::to_s_expr(method->get_code()),
+            assembler::to_s_expr(
+                assembler::ircode_from_string(optimized_code).get()));
+  EXPECT_EQ(method->get_code()->get_registers_size(), 2);
+}
+
+TEST_F(IncrementalPassCacheTest, ignoresOtherConfig) {
+  {
+    IncrementalPassCache cache(dir(), "Pass#1", "config");
+    auto method = make_method();
+    cache.run(
+        method, /* summarize_refs */ false, [&] { return optimize(method); });
+    cache.save();
+  }
+
+  IncrementalPassCache cache(dir(), "Pass#1", "other config");
+  auto method = make_method();
+  size_t runs = 0;
+  cache.run(method, /* summarize_refs */ false, [&] {
+    ++runs;
+    return optimize(method);
+  });
+  EXPECT_EQ(runs, 1);
+  EXPECT_EQ(cache.hits(), 0);
+}
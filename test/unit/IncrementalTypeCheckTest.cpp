@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "ConfigFiles.h"
+#include "Creators.h"
+#include "DexUtil.h"
+#include "IRAssembler.h"
+#include "PassManager.h"
+#include "RedexTest.h"
+
+struct IncrementalTypeCheckTest : public RedexTest {};
+
+namespace {
+
+// Calls `change` when it runs.
+class ChangePass : public Pass {
+ public:
+  ChangePass(const std::string& name, std::function<void()> change)
+      : Pass(name), m_change(std::move(change)) {}
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override {
+    m_change();
+  }
+
+ private:
+  std::function<void()> m_change;
+};
+
+DexClass* make_class(const std::string& name, DexType* super) {
+  ClassCreator creator(DexType::make_type(name.c_str()));
+  creator.set_super(super);
+  return creator.create();
+}
+
+} // namespace
+
+TEST_F(IncrementalTypeCheckTest, onlyChangedMethodsAreChecked) {
+  auto base = make_class("LBase;", get_object_type());
+  auto other_base = make_class("LOtherBase;", get_object_type());
+  auto derived = make_class("LDerived;", base->get_type());
+
+  ClassCreator creator(DexType::make_type("LChecked;"));
+  creator.set_super(get_object_type());
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LChecked;.cast:(Ljava/lang/Object;)LDerived;"
+     (
+      (load-param-object v0)
+      (check-cast v0 "LDerived;")
+      (move-result-pseudo-object v0)
+      (return-object v0)
+     )
+    )
+  )");
+  creator.add_method(method);
+  auto untouched = assembler::method_from_string(R"(
+    (method (public static) "LChecked;.id:(I)I"
+     (
+      (load-param v0)
+      (return v0)
+     )
+    )
+  )");
+  creator.add_method(untouched);
+
+  DexMetadata dm;
+  dm.set_id("classes");
+  DexStore store(dm);
+  store.add_classes({base, other_base, derived, creator.create()});
+  DexStoresVector stores;
+  stores.emplace_back(std::move(store));
+
+  ChangePass nothing("NothingPass", [] {});
+  ChangePass code_change("CodePass", [&] {
+    auto code = method->get_code();
+    code->set_registers_size(code->get_registers_size() + 1);
+  });
+  // Only the class hierarchy changes, not the code.
+  ChangePass hierarchy("HierarchyPass", [&] {
+    derived->set_super_class(other_base->get_type());
+  });
+  ChangePass nothing_again("NothingAgainPass", [] {});
+  PassManager manager({&nothing, &code_change, &hierarchy, &nothing_again});
+  manager.set_testing_mode();
+  Json::Value conf_obj;
+  conf_obj["ir_type_checker"]["run_after_each_pass"] = true;
+  ConfigFiles config(conf_obj);
+  manager.run_passes(stores, config);
+
+  std::vector<int> checked;
+  for (const auto& info : manager.get_pass_info()) {
+    checked.push_back(info.metrics.at("ir_type_checker_methods_checked"));
+  }
+  EXPECT_EQ(checked, std::vector<int>({2, 1, 1, 0}));
+}
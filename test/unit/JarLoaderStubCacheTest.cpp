@@ -0,0 +1,229 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "DexClass.h"
+#include "JarLoader.h"
+#include "RedexTest.h"
+#include "Show.h"
+#include "ZipWriter.h"
+
+namespace {
+
+// Builds a class file whose class has one interface, one int field and one
+// abstract method.
+class ClassFileBuilder {
+ public:
+  std::string build(const std::string& name,
+                    const std::string& super,
+                    const std::string& iface) {
+    auto self_index = add_class(name);
+    auto super_index = add_class(super);
+    auto iface_index = add_class(iface);
+    auto field_name = add_utf8("count");
+    auto field_desc = add_utf8("I");
+    auto method_name = add_utf8("run");
+    auto method_desc = add_utf8("()V");
+
+    std::string out;
+    put32(&out, 0xcafebabe);
+    put16(&out, 0); // minor version
+    put16(&out, 50); // major version
+    put16(&out, m_count);
+    out += m_pool;
+    put16(&out, 0x0401); // public abstract
+    put16(&out, self_index);
+    put16(&out, super_index);
+    put16(&out, 1);
+    put16(&out, iface_index);
+    put16(&out, 1);
+    put16(&out, 0x0002); // private
+    put16(&out, field_name);
+    put16(&out, field_desc);
+    put16(&out, 0);
+    put16(&out, 1);
+    put16(&out, 0x0401); // public abstract
+    put16(&out, method_name);
+    put16(&out, method_desc);
+    put16(&out, 0);
+    put16(&out, 0); // class attributes
+    return out;
+  }
+
+ private:
+  static void put16(std::string* out, uint16_t v) {
+    out->push_back(char(v >> 8));
+    out->push_back(char(v));
+  }
+
+  static void put32(std::string* out, uint32_t v) {
+    put16(out, uint16_t(v >> 16));
+    put16(out, uint16_t(v));
+  }
+
+  uint16_t add_utf8(const std::string& str) {
+    m_pool.push_back(1); // CONSTANT_Utf8
+    put16(&m_pool, str.size());
+    m_pool += str;
+    return m_count++;
+  }
+
+  uint16_t add_class(const std::string& name) {
+    auto name_index = add_utf8(name);
+    m_pool.push_back(7); // CONSTANT_Class
+    put16(&m_pool, name_index);
+    return m_count++;
+  }
+
+  std::string m_pool;
+  uint16_t m_count{1};
+};
+
+std::string read_file(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string& path, const std::string& contents) {
+  std::ofstream out(path, std::ios::binary);
+  out << contents;
+}
+
+// Describes the loaded classes and their members, in a stable order.
+std::string describe(const Scope& classes) {
+  std::vector<std::string> lines;
+  for (const DexClass* cls : classes) {
+    std::ostringstream ss;
+    ss << show(cls) << " " << cls->get_access() << " extends "
+       << show(cls->get_super_class()) << " implements "
+       << show(cls->get_interfaces());
+    for (auto field : cls->get_ifields()) {
+      ss << " " << show(field) << " " << field->get_access();
+    }
+    for (auto method : cls->get_vmethods()) {
+      ss << " " << show(method) << " " << method->get_access();
+    }
+    lines.push_back(ss.str());
+  }
+  std::sort(lines.begin(), lines.end());
+  std::string out;
+  for (const auto& line : lines) {
+    out += line + "\n";
+  }
+  return out;
+}
+
+} // namespace
+
+struct JarLoaderStubCacheTest : public RedexTest {
+  JarLoaderStubCacheTest() {
+    m_dir = boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path("jar-stubs-%%%%%%");
+    boost::filesystem::create_directories(m_dir / "cache");
+    m_jar = (m_dir / "lib.jar").string();
+    ZipWriter zip(m_jar);
+    for (const auto& name : {"Foo", "Bar"}) {
+      auto contents = ClassFileBuilder().build(
+          name, "java/lang/Object", "java/lang/Runnable");
+      zip.add_entry(std::string(name) + ".class", contents.data(),
+                    contents.size());
+    }
+    zip.finish();
+  }
+
+  ~JarLoaderStubCacheTest() { boost::filesystem::remove_all(m_dir); }
+
+  std::string cache_dir() const { return (m_dir / "cache").string(); }
+
+  std::vector<std::string> cache_files() const {
+    std::vector<std::string> files;
+    for (const auto& entry :
+         boost::filesystem::directory_iterator(m_dir / "cache")) {
+      files.push_back(entry.path().string());
+    }
+    return files;
+  }
+
+  // Loads the jar into a fresh context and describes what was loaded.
+  std::string load(const std::string& stub_cache_dir) {
+    delete g_redex;
+    g_redex = new RedexContext();
+    Scope classes;
+    EXPECT_TRUE(load_jar_files({m_jar}, &classes, nullptr, stub_cache_dir));
+    return describe(classes);
+  }
+
+  std::string m_jar;
+
+ private:
+  boost::filesystem::path m_dir;
+};
+
+TEST_F(JarLoaderStubCacheTest, coldAndWarmCacheLoadTheSameClasses) {
+  auto uncached = load("");
+  EXPECT_NE(uncached.find("LFoo;"), std::string::npos);
+  EXPECT_NE(uncached.find("LBar;"), std::string::npos);
+  EXPECT_TRUE(cache_files().empty());
+
+  auto cold = load(cache_dir());
+  ASSERT_EQ(cache_files().size(), 1);
+  auto cache = read_file(cache_files()[0]);
+
+  auto warm = load(cache_dir());
+  EXPECT_EQ(cold, uncached);
+  EXPECT_EQ(warm, uncached);
+  // The warm load reads the cache and leaves it alone.
+  ASSERT_EQ(cache_files().size(), 1);
+  EXPECT_EQ(read_file(cache_files()[0]), cache);
+}
+
+TEST_F(JarLoaderStubCacheTest, warmCacheIsRead) {
+  load(cache_dir());
+  ASSERT_EQ(cache_files().size(), 1);
+  auto path = cache_files()[0];
+  // Rename a class in the cache only, without changing any lengths.
+  auto cache = read_file(path);
+  boost::replace_all(cache, "Bar", "Baz");
+  write_file(path, cache);
+
+  auto warm = load(cache_dir());
+  EXPECT_NE(warm.find("LBaz;"), std::string::npos);
+  EXPECT_EQ(warm.find("LBar;"), std::string::npos);
+}
+
+TEST_F(JarLoaderStubCacheTest, corruptCacheIsRejected) {
+  auto uncached = load("");
+  load(cache_dir());
+  ASSERT_EQ(cache_files().size(), 1);
+  auto path = cache_files()[0];
+  auto cache = read_file(path);
+
+  // A truncated cache is ignored, and rewritten.
+  write_file(path, cache.substr(0, cache.size() - 3));
+  EXPECT_EQ(load(cache_dir()), uncached);
+  EXPECT_EQ(read_file(path), cache);
+
+  // So is one with trailing garbage.
+  write_file(path, cache + "garbage");
+  EXPECT_EQ(load(cache_dir()), uncached);
+  EXPECT_EQ(read_file(path), cache);
+
+  // And so is one that is not a cache at all.
+  write_file(path, "not a stub cache");
+  EXPECT_EQ(load(cache_dir()), uncached);
+  EXPECT_EQ(read_file(path), cache);
+}
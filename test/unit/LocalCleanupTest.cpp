@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "ConfigFiles.h"
+#include "Creators.h"
+#include "DexUtil.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "LocalCleanupPass.h"
+#include "PassManager.h"
+#include "RedexTest.h"
+
+struct LocalCleanupTest : public RedexTest {};
+
+TEST_F(LocalCleanupTest, fusedCleanup) {
+  ClassCreator creator(DexType::make_type("LFoo;"));
+  creator.set_super(get_object_type());
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.bar:(I)I"
+     (
+      (load-param v0)
+      (move v1 v0)
+      (move v2 v1)
+      (const v3 42)
+      (goto :next)
+      (:next)
+      (return v2)
+     )
+    )
+  )");
+  creator.add_method(method);
+
+  std::vector<DexStore> stores;
+  DexMetadata dm;
+  dm.set_id("classes");
+  DexStore store(dm);
+  store.add_classes({creator.create()});
+  stores.emplace_back(std::move(store));
+  LocalCleanupPass pass;
+  PassManager manager({&pass});
+  manager.set_testing_mode();
+  Json::Value conf_obj = Json::nullValue;
+  ConfigFiles dummy_config(conf_obj);
+  manager.run_passes(stores, dummy_config);
+
+  // Copy propagation rewrites the return to use v0, and the moves, the const
+  // and the goto are then all dead.
+  auto expected = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (return v0)
+     )
+  )");
+  EXPECT_EQ(assembler::to_s_expr(method->get_code()),
+            assembler::to_s_expr(expected.get()));
+}
+
+TEST_F(LocalCleanupTest, repeatedConstStringOnSharedCfg) {
+  ClassCreator creator(DexType::make_type("LBaz;"));
+  creator.set_super(get_object_type());
+  auto method = assembler::method_from_string(R"(
+    (method (public static) "LBaz;.qux:()Ljava/lang/String;"
+     (
+      (const-string "hello")
+      (move-result-pseudo-object v0)
+      (const-string "hello")
+      (move-result-pseudo-object v0)
+      (return-object v0)
+     )
+    )
+  )");
+  creator.add_method(method);
+
+  std::vector<DexStore> stores;
+  DexMetadata dm;
+  dm.set_id("classes");
+  DexStore store(dm);
+  store.add_classes({creator.create()});
+  stores.emplace_back(std::move(store));
+  LocalCleanupPass pass;
+  PassManager manager({&pass});
+  manager.set_testing_mode();
+  Json::Value conf_obj = Json::nullValue;
+  ConfigFiles dummy_config(conf_obj);
+  manager.run_passes(stores, dummy_config);
+
+  // The second const-string is removed together with its move-result-pseudo,
+  // even though the editable CFG puts them in different blocks.
+  auto expected = assembler::ircode_from_string(R"(
+    (
+      (const-string "hello")
+      (move-result-pseudo-object v0)
+      (return-object v0)
+     )
+  )");
+  EXPECT_EQ(assembler::to_s_expr(method->get_code()),
+            assembler::to_s_expr(expected.get()));
+}
@@ -10,6 +10,8 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include "CallGraph.h"
+#include "Creators.h"
 #include "IRAssembler.h"
 #include "RedexTest.h"
 #include "Show.h"
@@ -212,3 +214,87 @@ TEST_F(LocalPointersTest, generateEscapeSummary2) {
   EXPECT_EQ(summary_copy.returned_parameters, ptrs::ParamSet::top());
   EXPECT_THAT(summary_copy.escaping_parameters, UnorderedElementsAre());
 }
+
+TEST_F(LocalPointersTest, analyzeScope) {
+  ClassCreator creator(DexType::make_type("LFoo;"));
+  creator.set_super(get_object_type());
+  std::vector<DexMethod*> methods;
+  for (const char* method_str : {
+    R"((method (public static) "LFoo;.id:(LFoo;)LFoo;"
+        (
+         (load-param-object v0)
+         (return v0)
+        )
+       ))",
+    R"((method (public static) "LFoo;.wrap:(LFoo;)LFoo;"
+        (
+         (load-param-object v0)
+         (invoke-static (v0) "LFoo;.id:(LFoo;)LFoo;")
+         (move-result-object v1)
+         (return v1)
+        )
+       ))",
+    R"((method (public static) "LFoo;.leak:(LFoo;)V"
+        (
+         (load-param-object v0)
+         (sput-object v0 "LFoo;.bar:LFoo;")
+         (return-void)
+        )
+       ))",
+    R"((method (public static) "LFoo;.recA:(LFoo;)V"
+        (
+         (load-param-object v0)
+         (invoke-static (v0) "LFoo;.recB:(LFoo;)V")
+         (return-void)
+        )
+       ))",
+    R"((method (public static) "LFoo;.recB:(LFoo;)V"
+        (
+         (load-param-object v0)
+         (invoke-static (v0) "LFoo;.recA:(LFoo;)V")
+         (return-void)
+        )
+       ))",
+  }) {
+    auto method = assembler::method_from_string(method_str);
+    method->rstate.set_root();
+    method->get_code()->build_cfg(/* editable */ false);
+    method->get_code()->cfg().calculate_exit_block();
+    creator.add_method(method);
+    methods.push_back(method);
+  }
+  Scope scope{creator.create()};
+  auto call_graph = call_graph::single_callee_graph(scope);
+
+  ptrs::SummaryCMap summaries;
+  auto fp_iter_map = ptrs::analyze_scope(scope, call_graph, &summaries);
+  for (auto* method : methods) {
+    EXPECT_EQ(fp_iter_map->count(method), 1);
+  }
+  auto id = DexMethod::get_method("LFoo;.id:(LFoo;)LFoo;");
+  auto wrap = DexMethod::get_method("LFoo;.wrap:(LFoo;)LFoo;");
+  auto leak = DexMethod::get_method("LFoo;.leak:(LFoo;)V");
+  auto rec_a = DexMethod::get_method("LFoo;.recA:(LFoo;)V");
+  auto rec_b = DexMethod::get_method("LFoo;.recB:(LFoo;)V");
+  EXPECT_EQ(summaries.at(id).returned_parameters, ptrs::ParamSet({0}));
+  // The summary of the callee was available when the caller was analyzed.
+  EXPECT_EQ(summaries.at(wrap).returned_parameters, ptrs::ParamSet({0}));
+  EXPECT_THAT(summaries.at(wrap).escaping_parameters, UnorderedElementsAre());
+  EXPECT_THAT(summaries.at(leak).escaping_parameters, UnorderedElementsAre(0));
+  // Within a cycle, an invoke of a method that isn't summarized yet makes
+  // its arguments escape.
+  EXPECT_THAT(summaries.at(rec_a).escaping_parameters,
+              UnorderedElementsAre(0));
+  EXPECT_THAT(summaries.at(rec_b).escaping_parameters,
+              UnorderedElementsAre(0));
+
+  ptrs::SummaryCMap summaries_only;
+  ptrs::analyze_scope_summaries(scope, call_graph, &summaries_only);
+  EXPECT_EQ(summaries_only.size(), summaries.size());
+  for (auto* method : methods) {
+    EXPECT_EQ(summaries_only.at(method).escaping_parameters,
+              summaries.at(method).escaping_parameters);
+    EXPECT_EQ(summaries_only.at(method).returned_parameters,
+              summaries.at(method).returned_parameters);
+  }
+}
@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Match.h"
+
+#include <gtest/gtest.h>
+
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+class MatchTest : public RedexTest {
+ protected:
+  static std::vector<IRInstruction*> insns_of(IRCode* code) {
+    std::vector<IRInstruction*> insns;
+    for (auto& mie : InstructionIterable(code)) {
+      insns.push_back(mie.insn);
+    }
+    return insns;
+  }
+};
+
+TEST_F(MatchTest, opcodeSets) {
+  EXPECT_EQ(m::any<IRInstruction>().opcodes, m::all_opcodes());
+  EXPECT_EQ(m::has_type().opcodes, m::all_opcodes());
+  EXPECT_EQ(m::const_string().opcodes,
+            m::opcodes_of({OPCODE_CONST_STRING}));
+  EXPECT_EQ(m::move_result_pseudo().opcodes.count(), 3);
+  EXPECT_EQ(m::invoke().opcodes.count(), 5);
+
+  auto static_or_virtual = m::invoke_static() || m::invoke_virtual();
+  EXPECT_EQ(static_or_virtual.opcodes,
+            m::opcodes_of({OPCODE_INVOKE_STATIC, OPCODE_INVOKE_VIRTUAL}));
+  EXPECT_EQ((m::invoke() && m::is_opcode(OPCODE_INVOKE_DIRECT)).opcodes,
+            m::opcodes_of({OPCODE_INVOKE_DIRECT}));
+  // An opcode check nested under another matcher still narrows it.
+  EXPECT_TRUE(m::invoke(m::is_opcode(OPCODE_CONST)).opcodes.none());
+  EXPECT_EQ((!m::const_string()).opcodes, m::all_opcodes());
+}
+
+TEST_F(MatchTest, findMatches) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (const-string "a")
+      (move-result-pseudo-object v0)
+      (invoke-static (v0) "LFoo;.bar:(Ljava/lang/String;)V")
+      (const-string "b")
+      (move-result-pseudo-object v1)
+      (invoke-virtual (v1) "Ljava/lang/String;.length:()I")
+      (const-string "c")
+      (return-void)
+    )
+  )");
+  auto insns = insns_of(code.get());
+
+  std::vector<std::vector<IRInstruction*>> matches;
+  m::find_matches(insns,
+                  std::make_tuple(m::const_string(),
+                                  m::move_result_pseudo(),
+                                  m::invoke_static() || m::invoke_virtual()),
+                  matches);
+  ASSERT_EQ(matches.size(), 2);
+  EXPECT_EQ(matches[0][0], insns[0]);
+  EXPECT_EQ(matches[1][0], insns[3]);
+  EXPECT_EQ(matches[1][2]->opcode(), OPCODE_INVOKE_VIRTUAL);
+
+  // Matchers that don't check the opcode still run against every window.
+  matches.clear();
+  m::find_matches(insns,
+                  std::make_tuple(m::has_type() || m::const_string(),
+                                  m::return_void()),
+                  matches);
+  ASSERT_EQ(matches.size(), 1);
+  EXPECT_EQ(matches[0][0], insns[6]);
+
+  matches.clear();
+  m::find_matches(
+      insns, std::make_tuple(m::invoke_static(), m::const_string()), matches);
+  ASSERT_EQ(matches.size(), 1);
+  EXPECT_EQ(matches[0][1], insns[3]);
+}
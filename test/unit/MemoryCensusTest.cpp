@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "MemoryCensus.h"
+
+#include <gtest/gtest.h>
+
+#include "ControlFlow.h"
+#include "Creators.h"
+#include "DexAnnotation.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+class MemoryCensusTest : public RedexTest {
+ public:
+  MemoryCensusTest() {
+    ClassCreator creator(DexType::make_type("LFoo;"));
+    creator.set_super(get_object_type());
+    // The method that the position is in must exist first.
+    auto inlined = static_cast<DexMethod*>(
+        DexMethod::make_method("LFoo;.inlined:()V"));
+    inlined->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+    creator.add_method(inlined);
+    m_method = assembler::method_from_string(R"(
+      (method (public static) "LFoo;.bar:(I)I"
+       (
+        (load-param v0)
+        (.pos "LFoo;.inlined:()V" "Foo.java" "12")
+        (if-eqz v0 :end)
+        (add-int/lit8 v0 v0 1)
+        (:end)
+        (return v0)
+       )
+      )
+    )");
+    creator.add_method(m_method);
+    m_cls = creator.create();
+    auto aset = new DexAnnotationSet();
+    aset->add_annotation(
+        new DexAnnotation(DexType::make_type("LAnno;"), DAV_RUNTIME));
+    m_cls->attach_annotation_set(aset);
+  }
+
+ protected:
+  static const MemoryCensus::Count& count(const MemoryCensus& census,
+                                          MemoryCensus::Category category) {
+    return census.counts[category];
+  }
+
+  DexMethod* m_method;
+  DexClass* m_cls;
+};
+
+TEST_F(MemoryCensusTest, countsLinearCode) {
+  auto census = MemoryCensus::take({m_cls});
+
+  EXPECT_EQ(count(census, MemoryCensus::CLASS).objects, 1);
+  EXPECT_EQ(count(census, MemoryCensus::ANNOTATION).objects, 1);
+  EXPECT_EQ(count(census, MemoryCensus::IR_CODE).objects, 1);
+  EXPECT_EQ(count(census, MemoryCensus::IR_INSTRUCTION).objects, 4);
+  EXPECT_EQ(count(census, MemoryCensus::POSITION).objects, 1);
+  // The instructions, the position, and the branch target.
+  EXPECT_EQ(count(census, MemoryCensus::METHOD_ITEM_ENTRY).objects, 6);
+  EXPECT_EQ(count(census, MemoryCensus::CFG_BLOCK).objects, 0);
+  EXPECT_EQ(count(census, MemoryCensus::DEX_CODE).objects, 0);
+
+  // LFoo;, LAnno;, Ljava/lang/Object; and I at least.
+  EXPECT_GE(count(census, MemoryCensus::TYPE).objects, 4);
+  EXPECT_GE(count(census, MemoryCensus::STRING).objects,
+            count(census, MemoryCensus::TYPE).objects);
+  EXPECT_GE(count(census, MemoryCensus::METHOD).objects, 1);
+  EXPECT_GE(count(census, MemoryCensus::PROTO).objects, 1);
+
+  size_t total = 0;
+  for (const auto& c : census.counts) {
+    EXPECT_EQ(c.objects == 0, c.bytes == 0);
+    total += c.bytes;
+  }
+  EXPECT_EQ(census.total_bytes(), total);
+}
+
+TEST_F(MemoryCensusTest, countsEditableCfgs) {
+  auto linear = MemoryCensus::take({m_cls});
+  auto code = m_method->get_code();
+  code->build_cfg(/* editable */ true);
+  auto census = MemoryCensus::take({m_cls});
+
+  auto& cfg = code->cfg();
+  size_t edges = 0;
+  for (auto block : cfg.blocks()) {
+    edges += block->succs().size();
+  }
+  EXPECT_EQ(count(census, MemoryCensus::CFG_BLOCK).objects, cfg.num_blocks());
+  EXPECT_EQ(count(census, MemoryCensus::CFG_EDGE).objects, edges);
+  EXPECT_GT(edges, 0);
+  EXPECT_EQ(count(census, MemoryCensus::IR_INSTRUCTION).objects,
+            count(linear, MemoryCensus::IR_INSTRUCTION).objects);
+  // Building the CFG copies the position into the blocks that follow it.
+  EXPECT_GE(count(census, MemoryCensus::POSITION).objects, 1);
+  code->clear_cfg();
+}
+
+TEST_F(MemoryCensusTest, typesAreCountedOncePerType) {
+  auto before = MemoryCensus::take({m_cls});
+  g_redex->alias_type_name(m_cls->get_type(),
+                           DexString::make_string("LAliasOfFoo;"));
+  auto after = MemoryCensus::take({m_cls});
+  EXPECT_EQ(count(after, MemoryCensus::TYPE).objects,
+            count(before, MemoryCensus::TYPE).objects);
+}
+
+TEST_F(MemoryCensusTest, sumsCensuses) {
+  auto census = MemoryCensus::take({m_cls});
+  auto twice = census;
+  twice += census;
+  for (size_t i = 0; i < MemoryCensus::NUM_CATEGORIES; i++) {
+    EXPECT_EQ(twice.counts[i].objects, 2 * census.counts[i].objects);
+    EXPECT_EQ(twice.counts[i].bytes, 2 * census.counts[i].bytes);
+  }
+  EXPECT_STREQ(MemoryCensus::name(MemoryCensus::IR_INSTRUCTION),
+               "IRInstruction");
+}
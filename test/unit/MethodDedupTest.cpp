@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "MethodDedup.h"
+
+#include <gtest/gtest.h>
+
+#include "IRAssembler.h"
+#include "RedexTest.h"
+
+struct MethodDedupTest : public RedexTest {};
+
+TEST_F(MethodDedupTest, identicalMethodsIndex) {
+  auto a = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.a:(I)I"
+     (
+      (load-param v0)
+      (add-int/lit8 v0 v0 1)
+      (return v0)
+     )
+    )
+  )");
+  auto b = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.b:(I)I"
+     (
+      (load-param v0)
+      (add-int/lit8 v0 v0 1)
+      (return v0)
+     )
+    )
+  )");
+  // Same fingerprint as a and b, but different registers.
+  auto c = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.c:(I)I"
+     (
+      (load-param v1)
+      (add-int/lit8 v1 v1 1)
+      (return v1)
+     )
+    )
+  )");
+  auto d = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.d:(I)I"
+     (
+      (load-param v0)
+      (add-int/lit8 v0 v0 2)
+      (return v0)
+     )
+    )
+  )");
+  auto e = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.e:(I)I"
+     (
+      (load-param v0)
+      (return v0)
+     )
+    )
+  )");
+
+  method_dedup::IdenticalMethodsIndex index({a, b, c, d});
+  EXPECT_EQ(index.groups().size(), 3);
+  EXPECT_EQ(index.identical_to(a), MethodOrderedSet({a, b}));
+  EXPECT_EQ(index.identical_to(b), MethodOrderedSet({a, b}));
+  EXPECT_EQ(index.identical_to(c), MethodOrderedSet({c}));
+  EXPECT_EQ(index.identical_to(d), MethodOrderedSet({d}));
+  EXPECT_TRUE(index.identical_to(e).empty());
+
+  EXPECT_TRUE(method_dedup::are_methods_identical({a, b}));
+  EXPECT_FALSE(method_dedup::are_methods_identical({a, c}));
+}
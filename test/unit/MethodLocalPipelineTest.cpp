@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "ConfigFiles.h"
+#include "CopyPropagationPass.h"
+#include "Creators.h"
+#include "DexUtil.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "LocalDce.h"
+#include "PassManager.h"
+#include "RedexTest.h"
+
+struct MethodLocalPipelineTest : public RedexTest {};
+
+namespace {
+
+DexMethod* make_method(const std::string& cls_name, DexStoresVector* stores) {
+  ClassCreator creator(DexType::make_type(cls_name.c_str()));
+  creator.set_super(get_object_type());
+  auto method = assembler::method_from_string(R"(
+    (method (public static) ")" + cls_name + R"(.bar:(I)I"
+     (
+      (load-param v0)
+      (move v1 v0)
+      (move v2 v1)
+      (const v3 42)
+      (return v2)
+     )
+    )
+  )");
+  creator.add_method(method);
+
+  DexMetadata dm;
+  dm.set_id("classes");
+  DexStore store(dm);
+  store.add_classes({creator.create()});
+  stores->emplace_back(std::move(store));
+  return method;
+}
+
+// Runs copy propagation and then local DCE over a fresh method, and returns
+// it along with the metrics of both passes. The resources of the passes go to
+// `resources` if given.
+std::pair<DexMethod*, std::vector<std::unordered_map<std::string, int>>>
+run_passes(
+    const std::string& cls_name,
+    bool pipeline,
+    std::vector<PassManager::PassResources>* resources = nullptr) {
+  DexStoresVector stores;
+  auto method = make_method(cls_name, &stores);
+  CopyPropagationPass copy_prop;
+  LocalDcePass local_dce;
+  PassManager manager({&copy_prop, &local_dce});
+  manager.set_testing_mode();
+  Json::Value conf_obj;
+  conf_obj["pipeline_method_local_passes"] = pipeline;
+  ConfigFiles config(conf_obj);
+  manager.run_passes(stores, config);
+
+  std::vector<std::unordered_map<std::string, int>> metrics;
+  for (const auto& info : manager.get_pass_info()) {
+    metrics.push_back(info.metrics);
+    if (resources != nullptr) {
+      resources->push_back(info.resources);
+    }
+  }
+  return {method, metrics};
+}
+
+// A method-local pass that changes nothing.
+class NopPass : public Pass {
+ public:
+  NopPass() : Pass("NopPass") {}
+  bool is_method_local() const override { return true; }
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override {}
+};
+
+} // namespace
+
+TEST_F(MethodLocalPipelineTest, sameResultsAsSeparatePasses) {
+  auto separate = run_passes("LSeparate;", /* pipeline */ false);
+  auto pipelined = run_passes("LPipelined;", /* pipeline */ true);
+
+  EXPECT_EQ(assembler::to_s_expr(pipelined.first->get_code()),
+            assembler::to_s_expr(separate.first->get_code()));
+  // Each pass still reports its own metrics, and how many passes ran together.
+  for (auto& metrics : pipelined.second) {
+    EXPECT_EQ(metrics.at("method_local_group_passes"), 2);
+    metrics.erase("method_local_group_passes");
+  }
+  EXPECT_EQ(pipelined.second, separate.second);
+  EXPECT_GT(pipelined.second[1].at("num_dead_instructions"), 0);
+}
+
+TEST_F(MethodLocalPipelineTest, groupResourcesAreSharedOut) {
+  std::vector<PassManager::PassResources> resources;
+  run_passes("LShared;", /* pipeline */ true, &resources);
+
+  ASSERT_EQ(resources.size(), 2);
+  for (const auto& res : resources) {
+    EXPECT_GT(res.wall_seconds, 0);
+    EXPECT_EQ(res.peak_rss_kb, resources[0].peak_rss_kb);
+  }
+}
+
+TEST_F(MethodLocalPipelineTest, shardedRunKeepsCode) {
+  DexStoresVector stores;
+  std::vector<DexMethod*> methods;
+  std::vector<std::string> before;
+  for (int i = 0; i < 6; ++i) {
+    auto cls_name = "LSharded" + std::to_string(i) + ";";
+    ClassCreator creator(DexType::make_type(cls_name.c_str()));
+    creator.set_super(get_object_type());
+    // The position names a method that is never defined.
+    auto method = assembler::method_from_string(R"(
+      (method (public static) ")" + cls_name + R"(.bar:(I)I"
+       (
+        (.pos "LInlined;.callee:()V" "Inlined.java" 7)
+        (load-param v0)
+        (if-eqz v0 :zero)
+        (add-int/lit8 v0 v0 )" + std::to_string(i) + R"()
+        (:zero)
+        (return v0)
+       )
+      )
+    )");
+    creator.add_method(method);
+    methods.push_back(method);
+    before.push_back(assembler::to_string(method->get_code()));
+
+    DexMetadata dm;
+    dm.set_id("classes");
+    DexStore store(dm);
+    store.add_classes({creator.create()});
+    stores.emplace_back(std::move(store));
+  }
+
+  NopPass nop;
+  PassManager manager({&nop});
+  manager.set_testing_mode();
+  Json::Value conf_obj;
+  conf_obj["method_local_processes"] = 2;
+  ConfigFiles config(conf_obj);
+  manager.run_passes(stores, config);
+
+  for (size_t i = 0; i < methods.size(); ++i) {
+    EXPECT_EQ(assembler::to_string(methods[i]->get_code()), before[i]);
+  }
+}
@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <gtest/gtest.h>
+
+#include "DexClass.h"
+#include "MethodProfiles.h"
+#include "RedexTest.h"
+#include "Show.h"
+
+struct MethodProfilesTest : public RedexTest {};
+
+namespace {
+
+DexMethod* make_method(const std::string& name) {
+  auto method = static_cast<DexMethod*>(DexMethod::make_method(name));
+  method->set_deobfuscated_name(show(method));
+  return method;
+}
+
+} // namespace
+
+TEST_F(MethodProfilesTest, groupsMethodsByProfiles) {
+  auto a = make_method("LA;.a:()V");
+  auto b = make_method("LA;.b:()V");
+  auto c = make_method("LA;.c:()V");
+  auto d = make_method("LA;.d:()V");
+  auto e = make_method("LA;.e:()V");
+
+  std::vector<MethodProfile> profiles(2);
+  profiles[0].name = "coldstart";
+  profiles[0].importance = 2;
+  profiles[0].method_to_weight = {
+      {"LA;.a:()V", 10}, {"LA;.b:()V", 5}, {"LA;.c:()V", 1}};
+  profiles[1].name = "scroll";
+  profiles[1].importance = 1;
+  profiles[1].method_to_weight = {{"LA;.c:()V", 3}, {"LA;.d:()V", 7}};
+
+  std::vector<DexMethod*> methods{e, d, c, b, a};
+  ProfiledMethods profiled_methods(profiles, methods);
+  EXPECT_TRUE(profiled_methods.in_profile(c, 0));
+  EXPECT_TRUE(profiled_methods.in_profile(c, 1));
+  EXPECT_FALSE(profiled_methods.in_profile(d, 0));
+  EXPECT_FALSE(profiled_methods.in_any_profile(e));
+
+  // `c` is used by both profiles, then come the methods of the most important
+  // profile by weight, then those of the other profile, and finally the
+  // methods that no profile uses.
+  profiled_methods.sort(methods);
+  EXPECT_EQ(methods, std::vector<DexMethod*>({c, a, b, d, e}));
+}
+
+TEST_F(MethodProfilesTest, binaryProfileMatchesTextProfile) {
+  auto a = make_method("LB;.a:()V");
+  auto b = make_method("LB;.b:()V");
+  auto c = make_method("LB;.c:()V");
+  std::unordered_map<std::string, unsigned int> weights{{"LB;.a:()V", 2},
+                                                        {"LB;.c:()V", 9}};
+
+  auto dir = boost::filesystem::temp_directory_path() /
+             boost::filesystem::unique_path("profiles-%%%%%%");
+  boost::filesystem::create_directories(dir);
+  auto text_file = (dir / "profile.txt").string();
+  auto binary_file = (dir / "profile.bin").string();
+  {
+    std::ofstream os(text_file);
+    for (const auto& pair : weights) {
+      os << pair.first << ' ' << pair.second << '\n';
+    }
+  }
+  write_binary_method_profile(binary_file, weights);
+
+  Json::Value config(Json::arrayValue);
+  config[0]["file"] = text_file;
+  config[1]["file"] = binary_file;
+  auto profiles = load_method_profiles(config);
+  boost::filesystem::remove_all(dir);
+  ASSERT_EQ(profiles.size(), 2);
+  EXPECT_EQ(profiles[0].binary, nullptr);
+  ASSERT_NE(profiles[1].binary, nullptr);
+  EXPECT_EQ(profiles[1].binary->size(), 2);
+  EXPECT_EQ(profiles[1].max_weight(), 9);
+
+  ProfiledMethods profiled_methods(profiles, {a, b, c});
+  for (auto method : {a, b, c}) {
+    EXPECT_EQ(profiled_methods.in_profile(method, 0),
+              profiled_methods.in_profile(method, 1));
+  }
+  EXPECT_TRUE(profiled_methods.in_profile(c, 1));
+  EXPECT_FALSE(profiled_methods.in_any_profile(b));
+}
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+
+#include "Debug.h"
+#include "MutablePriorityQueue.h"
+
+TEST(MutablePriorityQueueTest, basic) {
+  MutablePriorityQueue<int, int> queue;
+  EXPECT_TRUE(queue.empty());
+  queue.insert(1, 10);
+  queue.insert(2, 30);
+  queue.insert(3, 20);
+  EXPECT_EQ(queue.front(), 2);
+  queue.update_priority(1, 40);
+  EXPECT_EQ(queue.front(), 1);
+  queue.erase(1);
+  EXPECT_EQ(queue.front(), 2);
+  queue.update_priority(2, 5);
+  EXPECT_EQ(queue.front(), 3);
+  queue.erase(3);
+  queue.erase(2);
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(MutablePriorityQueueTest, matchesOrderedMap) {
+  // Priorities are unique, so the queue must agree with a map from priority
+  // to value, whichever way the priorities are updated.
+  std::mt19937 gen(0);
+  MutablePriorityQueue<int, int> queue;
+  std::unordered_map<int, int> priorities;
+  std::map<int, int> by_priority;
+  int next_priority = 0;
+  auto fresh_priority = [&]() {
+    next_priority += 1 + gen() % 3;
+    return (next_priority * 7919) % 100003;
+  };
+  for (int value = 0; value < 200; ++value) {
+    auto priority = fresh_priority();
+    queue.insert(value, priority);
+    priorities[value] = priority;
+    by_priority[priority] = value;
+  }
+  for (int round = 0; round < 500; ++round) {
+    std::vector<std::pair<int, int>> updates;
+    size_t count = round % 10 == 0 ? priorities.size() : 1 + gen() % 5;
+    for (const auto& p : priorities) {
+      if (updates.size() == count) {
+        break;
+      }
+      if (count < priorities.size() && gen() % 4 != 0) {
+        continue;
+      }
+      auto priority = fresh_priority();
+      updates.emplace_back(p.first, priority);
+    }
+    for (const auto& p : updates) {
+      by_priority.erase(priorities.at(p.first));
+      priorities[p.first] = p.second;
+      by_priority[p.second] = p.first;
+    }
+    queue.update_priorities(updates);
+    ASSERT_EQ(queue.front(), by_priority.rbegin()->second);
+
+    if (round % 3 == 0) {
+      auto value = queue.front();
+      queue.erase(value);
+      by_priority.erase(priorities.at(value));
+      priorities.erase(value);
+      ASSERT_EQ(queue.size(), priorities.size());
+    }
+  }
+}
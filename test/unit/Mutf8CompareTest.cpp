@@ -5,7 +5,12 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <memory>
+#include <string>
+#include <vector>
 #include <gtest/gtest.h>
 
 #include "DexClass.h"
@@ -18,3 +23,110 @@ TEST(Mutf8CompareTest, empty) {
   EXPECT_FALSE(compare_dexstrings(s2, s1));
   delete g_redex;
 }
+
+namespace {
+
+// compare_dexstrings before it skipped the common prefix, one code point at a
+// time throughout.
+bool reference_compare(const DexString* a, const DexString* b) {
+  const char* sa = a->c_str();
+  const char* sb = b->c_str();
+  if (strcmp(sa, sb) == 0) return false;
+  if (strlen(sa) == 0) return true;
+  if (strlen(sb) == 0) return false;
+  while (true) {
+    uint32_t cpa = mutf8_next_code_point(sa);
+    uint32_t cpb = mutf8_next_code_point(sb);
+    if (cpa == cpb) {
+      if (*sa == '\0') return true;
+      if (*sb == '\0') return false;
+      continue;
+    }
+    return cpa < cpb;
+  }
+}
+
+// Strings that share prefixes of every length around the 16 byte steps, and
+// then differ in ASCII, in the encoded NUL, or in 2 and 3 byte chars.
+std::vector<DexString*> make_strings() {
+  const std::vector<std::string> tails = {
+      "",
+      "a",
+      "z",
+      "\300\200", // U+0000
+      "\302\200", // U+0080
+      "\337\277", // U+07FF
+      "\340\240\200", // U+0800
+      "\355\240\200", // U+D800
+      "\357\277\277", // U+FFFF
+      "\302\200a",
+      "a\300\200",
+  };
+  std::vector<DexString*> strings;
+  for (size_t prefix_len : {0, 1, 7, 14, 15, 16, 17, 31, 32, 33}) {
+    std::string ascii_prefix(prefix_len, 'L');
+    for (const auto& prefix : {ascii_prefix, "\337\277" + ascii_prefix}) {
+      for (const auto& tail : tails) {
+        strings.push_back(DexString::make_string(prefix + tail));
+        strings.push_back(DexString::make_string(prefix + "\337\277" + tail));
+      }
+    }
+  }
+  return strings;
+}
+
+} // namespace
+
+TEST(Mutf8CompareTest, mismatchIndex) {
+  std::string a(40, 'x');
+  for (size_t n = 0; n <= a.size(); n++) {
+    EXPECT_EQ(n, mismatch_index(a.c_str(), a.c_str(), n));
+    for (size_t pos = 0; pos < n; pos++) {
+      std::string b = a;
+      b[pos] = '\377';
+      EXPECT_EQ(pos, mismatch_index(a.c_str(), b.c_str(), n));
+      b[n - 1] = '\1';
+      EXPECT_EQ(pos, mismatch_index(a.c_str(), b.c_str(), n));
+    }
+  }
+}
+
+TEST(Mutf8CompareTest, matchesCodePointOrder) {
+  g_redex = new RedexContext();
+  auto strings = make_strings();
+  for (auto a : strings) {
+    for (auto b : strings) {
+      EXPECT_EQ(reference_compare(a, b), compare_dexstrings(a, b))
+          << "\"" << a->c_str() << "\" vs \"" << b->c_str() << "\"";
+    }
+  }
+  delete g_redex;
+}
+
+TEST(Mutf8CompareTest, sortBenchmark) {
+  g_redex = new RedexContext();
+  // Class-like names, which share long package prefixes.
+  std::vector<DexString*> strings;
+  for (int i = 0; i < 20000; i++) {
+    auto name = "Lcom/facebook/redex/some/package/name" + std::to_string(i % 7) +
+                "/Class" + std::to_string(i * 7919 % 20000) +
+                (i % 10 == 0 ? "\302\200;" : ";");
+    strings.push_back(DexString::make_string(name));
+  }
+  auto time_sort = [&](bool (*cmp)(const DexString*, const DexString*)) {
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < 5; round++) {
+      auto copy = strings;
+      std::sort(copy.begin(), copy.end(), cmp);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  };
+  double reference = time_sort(reference_compare);
+  double fast = time_sort(compare_dexstrings);
+  printf("sorting %zu strings: code point loop %.3fs, compare_dexstrings "
+         "%.3fs (%.2fx)\n",
+         strings.size(), reference, fast, reference / fast);
+  delete g_redex;
+}
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "IRInstruction.h"
+#include "RedexContext.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+//==========
+// Measures how fast the opcode property queries that analyses make on every
+// instruction are, by iterating over a list of instructions with a random mix
+// of opcodes:
+//
+//   opcode_properties_perf_test [num_insns] [num_iterations]
+//==========
+
+namespace {
+
+std::vector<std::unique_ptr<IRInstruction>> make_insns(size_t n) {
+  std::vector<IROpcode> ops;
+#define OP(op, ...) ops.push_back(OPCODE_##op);
+  OPS
+#undef OP
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<size_t> dist(0, ops.size() - 1);
+  std::vector<std::unique_ptr<IRInstruction>> insns;
+  insns.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    insns.emplace_back(new IRInstruction(ops[dist(gen)]));
+  }
+  return insns;
+}
+
+size_t query_all(const std::vector<std::unique_ptr<IRInstruction>>& insns) {
+  size_t count = 0;
+  for (const auto& insn : insns) {
+    auto op = insn->opcode();
+    count += insn->dests_size();
+    count += insn->has_move_result_pseudo();
+    count += opcode::may_throw(op);
+    count += opcode::branchingness(op) != opcode::BRANCH_NONE;
+    count += opcode::ref(op) == opcode::Ref::Method;
+    if (insn->dests_size()) {
+      count += insn->dest_is_wide();
+    }
+  }
+  return count;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  size_t n = argc > 1 ? std::stoul(argv[1]) : 1'000'000;
+  size_t iterations = argc > 2 ? std::stoul(argv[2]) : 100;
+
+  g_redex = new RedexContext();
+  auto insns = make_insns(n);
+  size_t count = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    count += query_all(insns);
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  printf("%zu instructions x %zu iterations: %.2f ns/instruction (%zu)\n", n,
+         iterations, seconds * 1e9 / (n * iterations), count);
+  delete g_redex;
+}
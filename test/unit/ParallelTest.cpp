@@ -0,0 +1,42 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Parallel.h"
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <numeric>
+
+constexpr size_t NUM_INTS = 100'000;
+
+TEST(ParallelTest, emptyRange) {
+  std::vector<int> ints;
+  parallel_for(ints.begin(), ints.end(), [](int) { FAIL(); });
+  EXPECT_EQ(3, parallel_reduce(ints.begin(), ints.end(), 3,
+                               [](int a) { return a; },
+                               [](int a, int b) { return a + b; }));
+}
+
+TEST(ParallelTest, forVisitsEachElementOnce) {
+  std::vector<std::atomic<int>> counts(NUM_INTS);
+  for (size_t grain : {0, 1, 1000, 1'000'000}) {
+    parallel_for(counts.begin(), counts.end(),
+                 [](std::atomic<int>& c) { c++; }, grain);
+  }
+  for (auto& c : counts) {
+    ASSERT_EQ(4, c.load());
+  }
+}
+
+TEST(ParallelTest, reduceSums) {
+  std::vector<size_t> ints(NUM_INTS);
+  std::iota(ints.begin(), ints.end(), 0);
+  auto sum = parallel_reduce(ints.begin(), ints.end(), size_t(0),
+                             [](size_t a) { return a; },
+                             [](size_t a, size_t b) { return a + b; });
+  EXPECT_EQ(NUM_INTS * (NUM_INTS - 1) / 2, sum);
+}
@@ -5,11 +5,16 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <boost/filesystem.hpp>
+#include <fstream>
 #include <gtest/gtest.h>
 
 #include <sstream>
 
+#include "Creators.h"
+#include "DexUtil.h"
 #include "ProguardMap.h"
+#include "RedexTest.h"
 
 TEST(ProguardMapTest, empty) {
   std::stringstream ss(
@@ -53,4 +58,59 @@ TEST(ProguardMapTest, HandlesGeneratedComments) {
   ProguardMap pm(ss);
   EXPECT_EQ("LA;", pm.translate_class("Lcom/foo/bar;"));
   EXPECT_EQ("LA;.a:I", pm.translate_field("Lcom/foo/bar;.do1:I"));
-}
\ No newline at end of file
+}
+TEST(ProguardMapTest, FromFile) {
+  auto path = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path("mapping-%%%%%%.txt");
+  std::ofstream(path.string())
+      << "com.foo.bar -> A:\n"
+         "    com.foo.baz next -> a\n"
+         "    1:1:com.foo.baz get(com.foo.bar) -> b\n"
+         "com.foo.baz -> B:\n"
+         "    int do1 -> a";
+  ProguardMap pm(path.string());
+  boost::filesystem::remove(path);
+  EXPECT_EQ("LB;", pm.translate_class("Lcom/foo/baz;"));
+  // Types are translated with the classes that are mapped further down.
+  EXPECT_EQ("LA;.a:LB;", pm.translate_field("Lcom/foo/bar;.next:Lcom/foo/baz;"));
+  EXPECT_EQ("LA;.b:(LA;)LB;",
+            pm.translate_method("Lcom/foo/bar;.get:(Lcom/foo/bar;)Lcom/foo/baz;"));
+  EXPECT_EQ("Lcom/foo/bar;.get:(Lcom/foo/bar;)Lcom/foo/baz;",
+            pm.deobfuscate_method("LA;.b:(LA;)LB;"));
+  // The last line has no newline.
+  EXPECT_EQ("LB;.a:I", pm.translate_field("Lcom/foo/baz;.do1:I"));
+}
+
+struct ProguardMapApplyTest : public RedexTest {};
+
+TEST_F(ProguardMapApplyTest, ApplyDeobfuscatedNames) {
+  ClassCreator creator(DexType::make_type("LA;"));
+  creator.set_super(get_object_type());
+  auto method = static_cast<DexMethod*>(DexMethod::make_method("LA;.b:(LA;I)V"));
+  method->make_concrete(ACC_PUBLIC, true);
+  creator.add_method(method);
+  auto field = static_cast<DexField*>(DexField::make_field("LA;.a:[LA;"));
+  field->make_concrete(ACC_PUBLIC | ACC_STATIC);
+  creator.add_field(field);
+  auto unmapped = static_cast<DexField*>(DexField::make_field("LA;.c:I"));
+  unmapped->make_concrete(ACC_PUBLIC);
+  creator.add_field(unmapped);
+  DexClasses dex{creator.create()};
+
+  apply_deobfuscated_names({dex}, ProguardMap(std::string()));
+  EXPECT_EQ(dex[0]->get_deobfuscated_name(), "LA;");
+  EXPECT_EQ(method->get_deobfuscated_name(), show(method));
+  EXPECT_EQ(field->get_deobfuscated_name(), show(field));
+
+  std::stringstream ss(
+      "com.foo.bar -> A:\n"
+      "    com.foo.bar[] items -> a\n"
+      "    1:1:void set(com.foo.bar,int) -> b\n");
+  apply_deobfuscated_names({dex}, ProguardMap(ss));
+  EXPECT_EQ(dex[0]->get_deobfuscated_name(), "Lcom/foo/bar;");
+  EXPECT_EQ(method->get_deobfuscated_name(),
+            "Lcom/foo/bar;.set:(Lcom/foo/bar;I)V");
+  EXPECT_EQ(field->get_deobfuscated_name(),
+            "Lcom/foo/bar;.items:[Lcom/foo/bar;");
+  EXPECT_EQ(unmapped->get_deobfuscated_name(), "LA;.c:I");
+}
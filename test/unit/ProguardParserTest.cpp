@@ -5,6 +5,8 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <boost/filesystem.hpp>
+#include <fstream>
 #include <gtest/gtest.h>
 
 #include <istream>
@@ -59,6 +61,46 @@ TEST(ProguardParserTest, include) {
   ASSERT_EQ(config.includes[2], "gamma.txt");
 }
 
+// Parse included files, in the order of their -include commands.
+TEST(ProguardParserTest, include_files) {
+  namespace fs = boost::filesystem;
+  auto dir = fs::temp_directory_path() / fs::unique_path("pg-%%%%%%");
+  fs::create_directories(dir / "lib");
+  auto write = [&](const fs::path& path, const std::string& contents) {
+    std::ofstream(path.string()) << contents;
+  };
+  write(dir / "top.pro",
+        "-include " + (dir / "a.pro").string() + "\n" +
+            "-include " + (dir / "b.pro").string() + "\n");
+  write(dir / "a.pro",
+        "-keep class A\n"
+        "-basedirectory " +
+            (dir / "lib").string() + "\n" + "-include c.pro\n" +
+            "-include " + (dir / "b.pro").string() + "\n");
+  write(dir / "b.pro", "-keep class B\n-dontwarn B\n");
+  // Only found through the -basedirectory set by a.pro.
+  write(dir / "lib" / "c.pro",
+        "-keep class C\n-include " + (dir / "lib" / "d.pro").string() +
+            "\n");
+  // The same contents as b.pro, under another name.
+  write(dir / "lib" / "d.pro", "-keep class B\n-dontwarn B\n");
+
+  ProguardConfiguration config;
+  proguard_parser::parse_file((dir / "top.pro").string(), &config);
+  fs::remove_all(dir);
+
+  ASSERT_TRUE(config.ok);
+  ASSERT_EQ(config.includes.size(), 5);
+  EXPECT_EQ(config.already_included.size(), 4);
+  std::vector<std::string> kept;
+  for (const auto* k : config.keep_rules) {
+    kept.push_back(k->class_spec.className);
+  }
+  EXPECT_EQ(kept, std::vector<std::string>({"A", "B", "C", "B"}));
+  // b.pro and d.pro have each been parsed once.
+  EXPECT_EQ(config.dontwarn, std::vector<std::string>({"B", "B"}));
+}
+
 // Parse basedirectory
 TEST(ProguardParserTest, basedirectory) {
   ProguardConfiguration config;
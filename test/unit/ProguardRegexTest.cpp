@@ -247,3 +247,36 @@ TEST(ProguardRegexTest, types) {
     ASSERT_EQ("Lalpha/**/beta;", descriptor);
   }
 }
+
+TEST(ProguardRegexTest, typePatternMatcher) {
+  std::vector<std::string> names = {
+      "Lcom/foo/Bar;",     "Lcom/foo/Bar$Baz;", "Lcom/foo/Barn;",
+      "Lcom/foo/bar/Baz;", "Lcom/foo/;",        "Lcom/foo//Bar;",
+      "Lcom/foo/Bar/;",    "Lcom/foo;",         "Lcom/fooBar;",
+      "Lcom/foo/Bar",      "Lcom/foo/Bar;;",    "LBar;",
+  };
+  std::vector<std::string> patterns = {
+      "com.foo.Bar", "com.foo.Bar*", "com.foo.Bar**", "com.foo.*",
+      "com.foo.**",  "com.foo*",     "*",             "**",
+  };
+  for (const auto& pattern : patterns) {
+    auto descriptor = proguard_parser::convert_wildcard_type(pattern);
+    proguard_parser::TypePatternMatcher matcher(descriptor);
+    ASSERT_TRUE(matcher.is_compiled()) << descriptor;
+    boost::regex rx(proguard_parser::form_type_regex(descriptor));
+    for (const auto& name : names) {
+      EXPECT_EQ(boost::regex_match(name, rx), matcher.match(name))
+          << descriptor << " " << name;
+      if (matcher.match(name)) {
+        EXPECT_EQ(0, name.compare(0, matcher.prefix().size(), matcher.prefix()));
+      }
+    }
+  }
+
+  for (const auto& pattern : {"com.*.Bar", "com.foo.B?r", "com.foo.***",
+                              "!com.foo.Bar", "com.foo.Bar,com.foo.Baz"}) {
+    auto descriptor = proguard_parser::convert_wildcard_type(pattern);
+    EXPECT_FALSE(proguard_parser::TypePatternMatcher(descriptor).is_compiled())
+        << descriptor;
+  }
+}
@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "ReachingDefinitions.h"
+#include "RedexTest.h"
+
+struct ReachingDefinitionsTest : public RedexTest {};
+
+namespace {
+
+std::unordered_set<IRInstruction*> to_set(const reaching_defs::Domain& defs) {
+  if (defs.is_top() || defs.is_bottom()) {
+    return {};
+  }
+  return {defs.elements().begin(), defs.elements().end()};
+}
+
+} // namespace
+
+TEST_F(ReachingDefinitionsTest, DenseMatchesPatriciaTree) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (const v1 0)
+      (const v2 0)
+
+      (:loop)
+      (if-eqz v0 :end)
+      (add-int/lit8 v1 v1 1)
+      (if-eqz v1 :skip)
+      (const v2 1)
+      (:skip)
+      (add-int/lit8 v0 v0 -1)
+      (goto :loop)
+
+      (:end)
+      (add-int v3 v1 v2)
+      (return v3)
+    )
+  )");
+  code->build_cfg(/* editable */ true);
+  auto& cfg = code->cfg();
+
+  reaching_defs::FixpointIterator sparse(cfg);
+  sparse.run(reaching_defs::Environment());
+  reaching_defs::DenseFixpointIterator dense(cfg);
+  dense.run(reaching_defs::DenseEnvironment());
+  EXPECT_EQ(7, dense.defs().size());
+
+  for (cfg::Block* block : cfg.blocks()) {
+    auto sparse_env = sparse.get_entry_state_at(block);
+    auto dense_env = dense.get_entry_state_at(block);
+    for (const auto& mie : InstructionIterable(block)) {
+      for (reaching_defs::reg_t reg = 0; reg < 4; ++reg) {
+        EXPECT_EQ(to_set(sparse_env.get(reg)), to_set(dense_env.get(reg)))
+            << "v" << reg << " before " << show(mie.insn);
+      }
+      sparse.analyze_instruction(mie.insn, &sparse_env);
+      dense.analyze_instruction(mie.insn, &dense_env);
+    }
+    auto dense_exit = dense.get_exit_state_at(block);
+    for (reaching_defs::reg_t reg = 0; reg < 4; ++reg) {
+      EXPECT_EQ(to_set(dense_env.get(reg)), to_set(dense_exit.get(reg)));
+    }
+  }
+
+  // Both definitions of v1 reach the add-int at :end.
+  auto exit_block = cfg.real_exit_blocks()[0];
+  auto defs = dense.get_entry_state_at(exit_block).get(1);
+  EXPECT_EQ(2, defs.size());
+}
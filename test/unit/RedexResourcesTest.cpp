@@ -9,6 +9,7 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <boost/filesystem.hpp>
 #include <gtest/gtest.h>
 
 #include "Debug.h"
@@ -46,3 +47,47 @@ TEST(RedexResources, ReadXmlTagsAndAttributes) {
   auto no_ns_vals = multimap_values_to_set(attribute_values, "onClick");
   EXPECT_EQ(no_ns_vals.size(), 0);
 }
+
+TEST(RedexResources, CollectLayoutsOfApkDirectory) {
+  auto apk_dir = boost::filesystem::temp_directory_path() /
+                 boost::filesystem::unique_path();
+  auto layout_dir = apk_dir / "res" / "layout";
+  boost::filesystem::create_directories(layout_dir);
+  auto layout_contents = read_entire_file(std::getenv("test_layout_path"));
+  write_entire_file((layout_dir / "a.xml").string(), layout_contents);
+  write_entire_file((layout_dir / "b.xml").string(), layout_contents);
+
+  std::unordered_set<std::string> attributes_to_find;
+  attributes_to_find.emplace("android:onClick");
+  auto collect = [&](std::unordered_set<std::string>& classes,
+                     std::unordered_multimap<std::string, std::string>&
+                         attribute_values) {
+    collect_layout_classes_and_attributes(
+        apk_dir.string(), attributes_to_find, classes, attribute_values);
+  };
+
+  std::unordered_set<std::string> classes;
+  std::unordered_multimap<std::string, std::string> attribute_values;
+  collect(classes, attribute_values);
+  EXPECT_EQ(classes.size(), 3);
+  EXPECT_EQ(classes.count("Lcom/example/test/CustomButton;"), 1);
+  // Both layouts have the same two onClick values.
+  EXPECT_EQ(attribute_values.count("android:onClick"), 4);
+
+  // Reading the layouts again gives the same results.
+  std::unordered_set<std::string> classes_again;
+  std::unordered_multimap<std::string, std::string> attribute_values_again;
+  collect(classes_again, attribute_values_again);
+  EXPECT_EQ(classes_again, classes);
+  EXPECT_EQ(attribute_values_again.count("android:onClick"), 4);
+
+  // A rewritten layout is read again.
+  write_entire_file((layout_dir / "a.xml").string(), "");
+  std::unordered_set<std::string> classes_after_write;
+  std::unordered_multimap<std::string, std::string> attribute_values_after;
+  collect(classes_after_write, attribute_values_after);
+  EXPECT_EQ(classes_after_write, classes);
+  EXPECT_EQ(attribute_values_after.count("android:onClick"), 2);
+
+  boost::filesystem::remove_all(apk_dir);
+}
@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Creators.h"
+#include "DexUtil.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+#include "ReferenceIndex.h"
+
+struct ReferenceIndexTest : public RedexTest {};
+
+namespace {
+
+DexClass* make_class(const std::string& name, const std::string& body) {
+  ClassCreator creator(DexType::make_type(name.c_str()));
+  creator.set_super(get_object_type());
+  creator.add_method(assembler::method_from_string(R"(
+    (method (public static) ")" + name + R"(.foo:()V"
+     ()" + body + R"(
+      (return-void)
+     )
+    )
+  )"));
+  return creator.create();
+}
+
+DexMethod* foo(DexClass* cls) { return cls->get_dmethods().at(0); }
+
+std::vector<DexMethod*> methods_of(const ReferenceIndex::Referrers& referrers) {
+  std::vector<DexMethod*> methods;
+  for (const auto& referrer : referrers) {
+    methods.push_back(referrer.method);
+  }
+  return methods;
+}
+
+} // namespace
+
+TEST_F(ReferenceIndexTest, indexesTypesMethodsAndFields) {
+  auto a = make_class("LA;", R"(
+      (new-instance "LX;")
+      (move-result-pseudo-object v0)
+      (invoke-static () "LY;.bar:()V")
+  )");
+  auto b = make_class("LB;", R"(
+      (const v0 1)
+      (new-array v0 "[LX;")
+      (move-result-pseudo-object v1)
+      (sget "LY;.f:I")
+      (move-result-pseudo v0)
+  )");
+  ReferenceIndex refs({a, b});
+  EXPECT_EQ(refs.size(), 2);
+
+  auto x = DexType::get_type("LX;");
+  EXPECT_EQ(methods_of(refs.type_referrers(x)),
+            std::vector<DexMethod*>({foo(a), foo(b)}));
+  auto bar = DexMethod::get_method("LY;.bar:()V");
+  ASSERT_EQ(refs.method_referrers(bar).size(), 1);
+  EXPECT_EQ(refs.method_referrers(bar)[0].method, foo(a));
+  EXPECT_EQ(refs.method_referrers(bar)[0].insn->opcode(), OPCODE_INVOKE_STATIC);
+  auto f = DexField::get_field("LY;.f:I");
+  EXPECT_EQ(methods_of(refs.field_referrers(f)),
+            std::vector<DexMethod*>({foo(b)}));
+  EXPECT_TRUE(refs.type_referrers(DexType::make_type("LZ;")).empty());
+}
+
+TEST_F(ReferenceIndexTest, updatesChangedMethods) {
+  auto a = make_class("LA;", R"(
+      (new-instance "LX;")
+      (move-result-pseudo-object v0)
+  )");
+  ReferenceIndex refs({a});
+  auto x = DexType::get_type("LX;");
+  auto z = DexType::make_type("LZ;");
+  ASSERT_EQ(refs.type_referrers(x).size(), 1);
+
+  refs.type_referrers(x)[0].insn->set_type(z);
+  auto c = make_class("LC;", R"(
+      (new-instance "LZ;")
+      (move-result-pseudo-object v0)
+  )");
+  refs.update_methods({foo(a), foo(c)});
+  EXPECT_TRUE(refs.type_referrers(x).empty());
+  EXPECT_EQ(refs.type_referrers(z).size(), 2);
+  EXPECT_EQ(refs.size(), 2);
+
+  refs.remove_method(foo(a));
+  EXPECT_EQ(methods_of(refs.type_referrers(z)),
+            std::vector<DexMethod*>({foo(c)}));
+  EXPECT_EQ(refs.size(), 1);
+}
@@ -17,6 +17,7 @@
 #include "IRInstruction.h"
 #include "Interference.h"
 #include "LiveRange.h"
+#include "LinearScan.h"
 #include "Liveness.h"
 #include "OpcodeList.h"
 #include "RedexTest.h"
@@ -156,6 +157,42 @@ TEST_F(RegAllocTest, LiveRange) {
   EXPECT_EQ(code->get_registers_size(), 6);
 }
 
+TEST_F(RegAllocTest, LiveRangeLoop) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+     (const v0 0)
+
+     (:loop)
+     (add-int/lit8 v0 v0 1)
+     (if-eqz v0 :loop)
+
+     (const v0 5)
+     (return v0)
+    )
+)");
+
+  code->build_cfg(/* editable */ false);
+  live_range::renumber_registers(code.get(), /* width_aware */ false);
+
+  // The def before the loop and the def in the loop both reach the add-int, so
+  // they share a live range.
+  auto expected_code = assembler::ircode_from_string(R"(
+    (
+     (const v0 0)
+
+     (:loop)
+     (add-int/lit8 v0 v0 1)
+     (if-eqz v0 :loop)
+
+     (const v1 5)
+     (return v1)
+    )
+)");
+  EXPECT_EQ(assembler::to_s_expr(code.get()),
+            assembler::to_s_expr(expected_code.get()));
+  EXPECT_EQ(code->get_registers_size(), 2);
+}
+
 TEST_F(RegAllocTest, WidthAwareLiveRange) {
   auto code = assembler::ircode_from_string(R"(
     (
@@ -276,8 +313,8 @@ TEST_F(RegAllocTest, BuildInterferenceGraph) {
   code->build_cfg(/* editable */ false);
   auto& cfg = code->cfg();
   cfg.calculate_exit_block();
-  LivenessFixpointIterator fixpoint_iter(cfg);
-  fixpoint_iter.run(LivenessDomain());
+  DenseLivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(DenseLivenessDomain());
 
   RangeSet range_set;
   interference::Graph ig = interference::build_graph(
@@ -371,6 +408,32 @@ TEST_F(RegAllocTest, CombineAdjacentNodes) {
   EXPECT_FALSE(ig.get_node(2).is_active());
 }
 
+TEST_F(RegAllocTest, AdjacencyMatrix) {
+  using interference::impl::AdjacencyMatrix;
+  AdjacencyMatrix dense;
+  dense.reserve(4);
+  AdjacencyMatrix sparse;
+  sparse.reserve(AdjacencyMatrix::DENSE_MAX_REGS + 1);
+  for (auto* matrix : {&dense, &sparse}) {
+    matrix->add(0, 3, /* can_coalesce */ true);
+    matrix->add(2, 1, /* can_coalesce */ false);
+    // Past the reserved size of the dense matrix.
+    matrix->add(7, 2, /* can_coalesce */ true);
+    matrix->add(2, 7, /* can_coalesce */ false);
+
+    EXPECT_TRUE(matrix->contains(3, 0));
+    EXPECT_TRUE(matrix->contains(1, 2));
+    EXPECT_TRUE(matrix->contains(7, 2));
+    EXPECT_FALSE(matrix->contains(0, 1));
+    EXPECT_FALSE(matrix->contains(0, 200));
+
+    EXPECT_TRUE(matrix->is_coalesceable(0, 3));
+    EXPECT_FALSE(matrix->is_coalesceable(1, 2));
+    EXPECT_FALSE(matrix->is_coalesceable(2, 7));
+    EXPECT_TRUE(matrix->is_coalesceable(0, 1));
+  }
+}
+
 TEST_F(RegAllocTest, Coalesce) {
   auto code = assembler::ircode_from_string(R"(
     (
@@ -384,8 +447,8 @@ TEST_F(RegAllocTest, Coalesce) {
   code->build_cfg(/* editable */ false);
   auto& cfg = code->cfg();
   cfg.calculate_exit_block();
-  LivenessFixpointIterator fixpoint_iter(cfg);
-  fixpoint_iter.run(LivenessDomain());
+  DenseLivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(DenseLivenessDomain());
 
   RangeSet range_set;
   interference::Graph ig = interference::build_graph(
@@ -416,8 +479,8 @@ TEST_F(RegAllocTest, MoveWideCoalesce) {
   code->build_cfg(/* editable */ false);
   auto& cfg = code->cfg();
   cfg.calculate_exit_block();
-  LivenessFixpointIterator fixpoint_iter(cfg);
-  fixpoint_iter.run(LivenessDomain());
+  DenseLivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(DenseLivenessDomain());
 
   RangeSet range_set;
   interference::Graph ig = interference::build_graph(
@@ -456,8 +519,8 @@ TEST_F(RegAllocTest, NoCoalesceWide) {
   code->build_cfg(/* editable */ false);
   auto& cfg = code->cfg();
   cfg.calculate_exit_block();
-  LivenessFixpointIterator fixpoint_iter(cfg);
-  fixpoint_iter.run(LivenessDomain());
+  DenseLivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(DenseLivenessDomain());
 
   RangeSet range_set;
   interference::Graph ig = interference::build_graph(
@@ -554,8 +617,8 @@ TEST_F(RegAllocTest, SelectRange) {
   code->build_cfg(/* editable */ false);
   auto& cfg = code->cfg();
   cfg.calculate_exit_block();
-  LivenessFixpointIterator fixpoint_iter(cfg);
-  fixpoint_iter.run(LivenessDomain());
+  DenseLivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(DenseLivenessDomain());
 
   RangeSet range_set = init_range_set(code.get());
   EXPECT_EQ(range_set.size(), 1);
@@ -597,8 +660,8 @@ TEST_F(RegAllocTest, SelectAliasedRange) {
   code->build_cfg(/* editable */ false);
   auto& cfg = code->cfg();
   cfg.calculate_exit_block();
-  LivenessFixpointIterator fixpoint_iter(cfg);
-  fixpoint_iter.run(LivenessDomain());
+  DenseLivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(DenseLivenessDomain());
 
   auto invoke_it =
       std::find_if(code->begin(), code->end(), [](const MethodItemEntry& mie) {
@@ -650,8 +713,8 @@ TEST_F(RegAllocTest, AlignRanges) {
   code->build_cfg(/* editable */ false);
   auto& cfg = code->cfg();
   cfg.calculate_exit_block();
-  LivenessFixpointIterator fixpoint_iter(cfg);
-  fixpoint_iter.run(LivenessDomain());
+  DenseLivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(DenseLivenessDomain());
 
   RangeSet range_set;
   for (auto& mie : InstructionIterable(code.get())) {
@@ -688,8 +751,8 @@ TEST_F(RegAllocTest, Spill) {
   code->build_cfg(/* editable */ false);
   auto& cfg = code->cfg();
   cfg.calculate_exit_block();
-  LivenessFixpointIterator fixpoint_iter(cfg);
-  fixpoint_iter.run(LivenessDomain());
+  DenseLivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(DenseLivenessDomain());
 
   RangeSet range_set;
   interference::Graph ig = interference::build_graph(
@@ -741,8 +804,8 @@ TEST_F(RegAllocTest, NoSpillSingleArgInvokes) {
   code->build_cfg(/* editable */ false);
   auto& cfg = code->cfg();
   cfg.calculate_exit_block();
-  LivenessFixpointIterator fixpoint_iter(cfg);
-  fixpoint_iter.run(LivenessDomain());
+  DenseLivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(DenseLivenessDomain());
 
   RangeSet range_set;
   interference::Graph ig = interference::build_graph(
@@ -786,8 +849,8 @@ TEST_F(RegAllocTest, ContainmentGraph) {
   code->build_cfg(/* editable */ false);
   auto& cfg = code->cfg();
   cfg.calculate_exit_block();
-  LivenessFixpointIterator fixpoint_iter(cfg);
-  fixpoint_iter.run(LivenessDomain());
+  DenseLivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(DenseLivenessDomain());
 
   RangeSet range_set;
   interference::Graph ig = interference::build_graph(
@@ -842,8 +905,8 @@ TEST_F(RegAllocTest, FindSplit) {
   code->build_cfg(/* editable */ false);
   auto& cfg = code->cfg();
   cfg.calculate_exit_block();
-  LivenessFixpointIterator fixpoint_iter(cfg);
-  fixpoint_iter.run(LivenessDomain());
+  DenseLivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(DenseLivenessDomain());
 
   RangeSet range_set;
   interference::Graph ig = interference::build_graph(
@@ -877,8 +940,8 @@ TEST_F(RegAllocTest, Split) {
   code->build_cfg(/* editable */ false);
   auto& cfg = code->cfg();
   cfg.calculate_exit_block();
-  LivenessFixpointIterator fixpoint_iter(cfg);
-  fixpoint_iter.run(LivenessDomain());
+  DenseLivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(DenseLivenessDomain());
 
   RangeSet range_set;
   interference::Graph ig = interference::build_graph(
@@ -928,8 +991,8 @@ TEST_F(RegAllocTest, ParamFirstUse) {
   code->build_cfg(/* editable */ false);
   auto& cfg = code->cfg();
   cfg.calculate_exit_block();
-  LivenessFixpointIterator fixpoint_iter(cfg);
-  fixpoint_iter.run(LivenessDomain());
+  DenseLivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(DenseLivenessDomain());
 
   RangeSet range_set;
   interference::Graph ig = interference::build_graph(
@@ -961,3 +1024,80 @@ TEST_F(RegAllocTest, ParamFirstUse) {
   EXPECT_EQ(assembler::to_s_expr(code.get()),
             assembler::to_s_expr(expected_code.get()));
 }
+
+TEST_F(RegAllocTest, LinearScan) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+     (load-param v5)
+     (const v0 1)
+     (move v1 v0)
+     (const v3 0)
+     (:loop)
+     (add-int v2 v1 v5)
+     (add-int v3 v3 v2)
+     (if-eqz v3 :loop)
+     (return v3)
+    )
+)");
+  code->set_registers_size(6);
+  code->build_cfg(/* editable */ false);
+  linear_scan::Stats stats;
+  EXPECT_TRUE(linear_scan::allocate(code.get(), &stats));
+  code->clear_cfg();
+
+  // The move's source and dest share a register, and the move goes away. The
+  // moved value is live around the loop, so it doesn't share with v2 or v3.
+  // The param goes at the end of the frame.
+  auto expected_code = assembler::ircode_from_string(R"(
+    (
+     (load-param v3)
+     (const v0 1)
+     (const v1 0)
+     (:loop)
+     (add-int v2 v0 v3)
+     (add-int v1 v1 v2)
+     (if-eqz v1 :loop)
+     (return v1)
+    )
+)");
+  EXPECT_EQ(assembler::to_s_expr(code.get()),
+            assembler::to_s_expr(expected_code.get()));
+  EXPECT_EQ(code->get_registers_size(), 4);
+  EXPECT_EQ(stats.moves_coalesced, 1);
+}
+
+TEST_F(RegAllocTest, NoLinearScanForWide) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+     (const-wide v0 0)
+     (return-wide v0)
+    )
+)");
+  auto original = assembler::to_s_expr(code.get());
+  code->set_registers_size(2);
+  code->build_cfg(/* editable */ false);
+  linear_scan::Stats stats;
+  EXPECT_FALSE(linear_scan::allocate(code.get(), &stats));
+  code->clear_cfg();
+  EXPECT_EQ(assembler::to_s_expr(code.get()), original);
+}
+
+TEST_F(RegAllocTest, InstructionBudget) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+     (const v0 0)
+     (move v1 v0)
+     (return v1)
+    )
+)");
+  code->set_registers_size(2);
+  auto original = assembler::to_s_expr(code.get());
+  code->build_cfg(/* editable */ false);
+
+  graph_coloring::Allocator::Config config;
+  config.instruction_budget = 2;
+  graph_coloring::Allocator allocator(config);
+  EXPECT_FALSE(allocator.allocate(code.get()));
+  EXPECT_EQ(allocator.get_stats().methods_over_budget, 1);
+  EXPECT_EQ(assembler::to_s_expr(code.get()), original);
+}
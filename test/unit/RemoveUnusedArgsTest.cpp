@@ -243,3 +243,67 @@ TEST_F(RemoveUnusedArgsTest, multipleBlocksMixedArgs) {
   EXPECT_THAT(live_arg_idxs, ::testing::ElementsAre(0, 1, 2, 3));
   EXPECT_THAT(dead_insns.size(), 0);
 }
+
+// Builds LChain<n>; where each method only passes its argument along to the
+// next one, and the last one ignores it.
+static std::vector<DexMethod*> make_call_chain(const std::string& cls_name,
+                                               Scope* scope) {
+  auto cls = create_internal_class(
+      DexType::make_type(cls_name.c_str()), get_object_type(), {});
+  std::vector<DexMethod*> methods;
+  auto callee = assembler::method_from_string(R"(
+    (method (private static) ")" + cls_name + R"(.m2:(I)V"
+      (
+        (load-param v0)
+        (return-void)
+      )
+    )
+  )");
+  for (auto name : {"m1", "m0"}) {
+    auto next = methods.empty() ? callee : methods.back();
+    methods.push_back(assembler::method_from_string(R"(
+      (method (private static) ")" + cls_name + "." + name + R"(:(I)V"
+        (
+          (load-param v0)
+          (invoke-static (v0) ")" + show(next) + R"(")
+          (return-void)
+        )
+      )
+    )"));
+  }
+  methods.insert(methods.begin(), callee);
+  for (auto method : methods) {
+    cls->add_method(method);
+  }
+  scope->push_back(cls);
+  return methods;
+}
+
+// Checks that arguments only passed along to dead arguments of callees are
+// removed by later iterations
+TEST_F(RemoveUnusedArgsTest, iterateToFixpoint) {
+  {
+    Scope scope;
+    auto chain = make_call_chain("LOnce;", &scope);
+    auto stats = remove_unused_args::RemoveArgs(scope).run();
+    EXPECT_EQ(stats.iterations, 1);
+    EXPECT_EQ(stats.methods_updated_count, 1);
+    EXPECT_EQ(stats.callsite_args_removed_count, 1);
+    EXPECT_EQ(chain[0]->get_proto()->get_args()->size(), 0);
+    EXPECT_EQ(chain[1]->get_proto()->get_args()->size(), 1);
+    EXPECT_EQ(chain[2]->get_proto()->get_args()->size(), 1);
+  }
+
+  Scope scope;
+  auto chain = make_call_chain("LFixpoint;", &scope);
+  auto stats =
+      remove_unused_args::RemoveArgs(scope).run(/* max_iterations */ 10);
+  // The fourth round has no changed callers left to analyze.
+  EXPECT_EQ(stats.iterations, 4);
+  EXPECT_EQ(stats.methods_updated_count, 3);
+  EXPECT_EQ(stats.method_params_removed_count, 3);
+  EXPECT_EQ(stats.callsite_args_removed_count, 2);
+  for (auto method : chain) {
+    EXPECT_EQ(method->get_proto()->get_args()->size(), 0) << show(method);
+  }
+}
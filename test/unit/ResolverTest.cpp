@@ -210,3 +210,38 @@ TEST(ResolveField, empty) {
 
   delete g_redex;
 }
+
+TEST(ResolveMethod, cachedResolutionIsInvalidated) {
+  g_redex = new RedexContext();
+  auto obj_t = DexType::make_type("Ljava/lang/Object;");
+  auto p_t = DexType::make_type("LP;");
+  auto q_t = DexType::make_type("LQ;");
+  auto r_t = DexType::make_type("LR;");
+
+  ClassCreator p_creator(p_t);
+  p_creator.set_super(obj_t);
+  auto p_foo = static_cast<DexMethod*>(DexMethod::make_method("LP;.foo:()I"));
+  p_foo->make_concrete(ACC_PUBLIC, true);
+  p_creator.add_method(p_foo);
+  p_creator.create();
+  ClassCreator q_creator(q_t);
+  q_creator.set_super(p_t);
+  auto cls_q = q_creator.create();
+  ClassCreator r_creator(r_t);
+  r_creator.set_super(q_t);
+  r_creator.create();
+
+  auto r_foo = DexMethod::make_method("LR;.foo:()I");
+  EXPECT_EQ(p_foo, resolve_method_cached(r_foo, MethodSearch::Virtual));
+  EXPECT_EQ(p_foo, resolve_method_cached(r_foo, MethodSearch::Virtual));
+  EXPECT_EQ(nullptr, resolve_method_cached(r_foo, MethodSearch::Direct));
+
+  // Adding an override in between changes the resolution.
+  auto q_foo = static_cast<DexMethod*>(DexMethod::make_method("LQ;.foo:()I"));
+  q_foo->make_concrete(ACC_PUBLIC, true);
+  cls_q->add_method(q_foo);
+  EXPECT_EQ(q_foo, resolve_method_cached(r_foo, MethodSearch::Virtual));
+
+  cls_q->remove_method(q_foo);
+  EXPECT_EQ(p_foo, resolve_method_cached(r_foo, MethodSearch::Virtual));
+}
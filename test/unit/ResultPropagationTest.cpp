@@ -8,6 +8,7 @@
 #include <gtest/gtest.h>
 
 #include "ControlFlow.h"
+#include "Creators.h"
 #include "IRAssembler.h"
 #include "IRCode.h"
 #include "ResultPropagation.h"
@@ -32,8 +33,7 @@ void test_get_return_param_index(const std::string& code_str,
 
   method_override_graph::Graph graph;
   ReturnParamResolver resolver(graph);
-  std::unordered_map<const DexMethod*, ParamIndex>
-      methods_which_return_parameter;
+  ReturnParamMap methods_which_return_parameter;
   auto const actual =
       resolver.get_return_param_index(cfg, methods_which_return_parameter);
 
@@ -177,3 +177,121 @@ TEST(CFGInliner, return_receiver_of_framework_method) {
   )";
   test_get_return_param_index(code_str, 0);
 }
+
+TEST(ResultPropagation, find_methods_which_return_parameter) {
+  g_redex = new RedexContext();
+
+  ClassCreator creator(DexType::make_type("LCls;"));
+  creator.set_super(get_object_type());
+  auto make = [&](const char* str) {
+    auto method = assembler::method_from_string(str);
+    creator.add_method(method);
+    return method;
+  };
+  // A chain of calls that eventually returns the parameter.
+  auto top = make(R"(
+    (method (public static) "LCls;.top:(I)I"
+     (
+      (load-param v0)
+      (invoke-static (v0) "LCls;.middle:(I)I")
+      (move-result v1)
+      (return v1)
+     )
+    )
+  )");
+  auto middle = make(R"(
+    (method (public static) "LCls;.middle:(I)I"
+     (
+      (load-param v0)
+      (invoke-static (v0) "LCls;.bottom:(I)I")
+      (move-result v0)
+      (return v0)
+     )
+    )
+  )");
+  auto bottom = make(R"(
+    (method (public static) "LCls;.bottom:(I)I"
+     (
+      (load-param v0)
+      (return v0)
+     )
+    )
+  )");
+  // A cycle whose members can only be resolved one after the other, in the
+  // opposite of their order in the scope.
+  auto second = make(R"(
+    (method (public static) "LCls;.second:(I)I"
+     (
+      (load-param v0)
+      (invoke-static (v0) "LCls;.first:(I)I")
+      (move-result v1)
+      (return v1)
+     )
+    )
+  )");
+  auto first = make(R"(
+    (method (public static) "LCls;.first:(I)I"
+     (
+      (load-param v0)
+      (invoke-static (v0) "LCls;.second:(I)I")
+      (move-result v1)
+      (return v0)
+     )
+    )
+  )");
+  // A virtual call, which depends on the callee and its overrides.
+  auto virtual_callee = make(R"(
+    (method (public) "LCls;.virtualCallee:(I)I"
+     (
+      (load-param-object v0)
+      (load-param v1)
+      (return v1)
+     )
+    )
+  )");
+  auto virtual_caller = make(R"(
+    (method (public static) "LCls;.virtualCaller:(LCls;I)I"
+     (
+      (load-param-object v0)
+      (load-param v1)
+      (invoke-virtual (v0 v1) "LCls;.virtualCallee:(I)I")
+      (move-result v1)
+      (return v1)
+     )
+    )
+  )");
+  // A cycle that never returns a parameter.
+  auto loop = make(R"(
+    (method (public static) "LCls;.loop:(I)I"
+     (
+      (load-param v0)
+      (if-eqz v0 :exit)
+      (invoke-static (v0) "LCls;.loop:(I)I")
+      (move-result v0)
+      (return v0)
+      (:exit)
+      (const v0 1)
+      (return v0)
+     )
+    )
+  )");
+  Scope scope{creator.create()};
+
+  auto graph = method_override_graph::build_graph(scope);
+  ReturnParamResolver resolver(*graph);
+  ReturnParamMap methods_which_return_parameter;
+  const auto waves = find_methods_which_return_parameter(
+      scope, resolver, &methods_which_return_parameter);
+
+  EXPECT_EQ(waves, 3);
+  EXPECT_EQ(methods_which_return_parameter.size(), 7);
+  EXPECT_EQ(methods_which_return_parameter.get(virtual_callee, 0), 1);
+  EXPECT_EQ(methods_which_return_parameter.get(virtual_caller, 0), 1);
+  for (auto method : {top, middle, bottom, first, second}) {
+    EXPECT_EQ(methods_which_return_parameter.get(method, 1), 0) << SHOW(method);
+  }
+  EXPECT_EQ(methods_which_return_parameter.count(loop), 0);
+  EXPECT_FALSE(top->get_code()->editable_cfg_built());
+
+  delete g_redex;
+}
@@ -0,0 +1,32 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "DexClass.h"
+#include "RedexTest.h"
+#include "Show.h"
+
+struct ShowTest : public RedexTest {};
+
+TEST_F(ShowTest, showToAppends) {
+  auto method = DexMethod::make_method("LFoo;.bar:(I[LBaz;)LFoo;");
+  auto field = DexField::make_field("LFoo;.baz:[J");
+
+  std::string out = "> ";
+  show_to(out, method);
+  EXPECT_EQ(out, "> LFoo;.bar:(I[LBaz;)LFoo;");
+  out.push_back(' ');
+  show_to(out, field);
+  EXPECT_EQ(out, "> LFoo;.bar:(I[LBaz;)LFoo; LFoo;.baz:[J");
+
+  EXPECT_EQ(show(method), "LFoo;.bar:(I[LBaz;)LFoo;");
+  EXPECT_EQ(show(method->get_proto()), "(I[LBaz;)LFoo;");
+  EXPECT_EQ(show(method->get_proto()->get_args()), "I[LBaz;");
+  EXPECT_EQ(show(field), "LFoo;.baz:[J");
+  EXPECT_EQ(show(static_cast<const DexFieldRef*>(nullptr)), "");
+}
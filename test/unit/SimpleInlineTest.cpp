@@ -7,6 +7,7 @@
 
 #include <gtest/gtest.h>
 
+#include "Creators.h"
 #include "DexAsm.h"
 #include "DexUtil.h"
 #include "Inliner.h"
@@ -141,3 +142,36 @@ TEST_F(SimpleInlineTest, debugPositionsAfterReturn) {
   )";
   test_inliner(caller_str, callee_str, expected_str);
 }
+
+/*
+ * A callee that is moved into its caller gets its visibility changes applied
+ * only once the inlining succeeded, so gathering them must not change
+ * anything.
+ */
+TEST_F(SimpleInlineTest, visibilityChangesAreAppliedLater) {
+  ClassCreator creator(DexType::make_type("LBar;"));
+  creator.set_super(get_object_type());
+  creator.set_access(ACC_PUBLIC);
+  auto field = static_cast<DexField*>(
+      DexField::make_field("LBar;.secret:I"));
+  field->make_concrete(ACC_PRIVATE | ACC_STATIC);
+  creator.add_field(field);
+  auto callee = assembler::method_from_string(R"(
+    (method (private static) "LBar;.peek:()I"
+     (
+      (sget "LBar;.secret:I")
+      (move-result-pseudo v0)
+      (return v0)
+     )
+    )
+  )");
+  creator.add_method(callee);
+  creator.create();
+
+  auto changes = get_visibility_changes(callee);
+  EXPECT_EQ(changes.fields.count(field), 1);
+  EXPECT_TRUE(is_private(field));
+
+  changes.apply();
+  EXPECT_TRUE(is_public(field));
+}
@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "Creators.h"
+#include "DexStore.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "ProguardMap.h"
+#include "RedexTest.h"
+#include "SingleImplDefs.h"
+
+class SingleImplAnalyzeTest : public RedexTest {
+ protected:
+  DexClass* make_interface(const char* name) {
+    auto type = DexType::make_type(name);
+    ClassCreator creator(type);
+    creator.set_super(get_object_type());
+    creator.set_access(ACC_PUBLIC | ACC_INTERFACE | ACC_ABSTRACT);
+    auto foo = static_cast<DexMethod*>(DexMethod::make_method(
+        std::string(name) + ".foo:()V"));
+    foo->make_concrete(ACC_PUBLIC | ACC_ABSTRACT, /* is_virtual */ true);
+    creator.add_method(foo);
+    auto cls = creator.create();
+    m_scope.push_back(cls);
+    m_intfs.insert(type);
+    return cls;
+  }
+
+  DexClass* make_impl(const char* name, DexClass* intf) {
+    ClassCreator creator(DexType::make_type(name));
+    creator.set_super(get_object_type());
+    creator.add_interface(intf->get_type());
+    auto cls = creator.create();
+    m_scope.push_back(cls);
+    m_single_impl[intf->get_type()] = cls->get_type();
+    return cls;
+  }
+
+  void add_user(DexClass* cls) { m_scope.push_back(cls); }
+
+  std::unique_ptr<SingleImplAnalysis> analyze() {
+    DexStore store("classes");
+    store.add_classes(m_scope);
+    DexStoresVector stores{store};
+    std::istringstream empty;
+    ProguardMap pg_map(empty);
+    SingleImplConfig config{};
+    return SingleImplAnalysis::analyze(
+        m_scope, stores, m_single_impl, m_intfs, pg_map, config);
+  }
+
+  Scope m_scope;
+  TypeMap m_single_impl;
+  TypeSet m_intfs;
+};
+
+TEST_F(SingleImplAnalyzeTest, collectsReferences) {
+  auto intf = make_interface("LIntf;");
+  make_impl("LImpl;", intf);
+
+  ClassCreator creator(DexType::make_type("LUser;"));
+  creator.set_super(get_object_type());
+  auto use = assembler::method_from_string(R"(
+    (method (public static) "LUser;.use:(LIntf;)LIntf;"
+     (
+      (load-param-object v0)
+      (invoke-interface (v0) "LIntf;.foo:()V")
+      (check-cast v0 "LIntf;")
+      (move-result-pseudo-object v1)
+      (invoke-static (v1) "LUser;.use:(LIntf;)LIntf;")
+      (move-result-object v1)
+      (const-class "LIntf;")
+      (move-result-pseudo-object v1)
+      (return-object v0)
+     )
+    )
+  )");
+  creator.add_method(use);
+  add_user(creator.create());
+
+  auto analysis = analyze();
+  ASSERT_TRUE(analysis->is_single_impl(intf->get_type()));
+  EXPECT_FALSE(analysis->is_escaped(intf->get_type()));
+  auto& data = analysis->get_single_impl_data(intf->get_type());
+  EXPECT_EQ(data.methoddefs.size(), 1);
+  EXPECT_EQ(data.methoddefs.count(use), 1);
+  ASSERT_EQ(data.typerefs.size(), 2);
+  // In the order of the code.
+  EXPECT_EQ(data.typerefs[0]->opcode(), OPCODE_CHECK_CAST);
+  EXPECT_EQ(data.typerefs[1]->opcode(), OPCODE_CONST_CLASS);
+  EXPECT_EQ(data.intf_methodrefs.size(), 1);
+  ASSERT_EQ(data.methodrefs.size(), 1);
+  EXPECT_EQ(data.methodrefs.begin()->first, use);
+  // The return type and the argument both refer to the same instruction.
+  EXPECT_EQ(data.methodrefs.begin()->second.size(), 1);
+}
+
+TEST_F(SingleImplAnalyzeTest, escapesAreMerged) {
+  auto native_intf = make_interface("LNativeIntf;");
+  make_impl("LNativeImpl;", native_intf);
+  auto array_intf = make_interface("LArrayIntf;");
+  make_impl("LArrayImpl;", array_intf);
+  auto unknown_intf = make_interface("LUnknownIntf;");
+  make_impl("LUnknownImpl;", unknown_intf);
+  auto good_intf = make_interface("LGoodIntf;");
+  make_impl("LGoodImpl;", good_intf);
+
+  ClassCreator creator(DexType::make_type("LUser;"));
+  creator.set_super(get_object_type());
+  auto native = static_cast<DexMethod*>(
+      DexMethod::make_method("LUser;.native:(LNativeIntf;)V"));
+  native->make_concrete(ACC_PUBLIC | ACC_STATIC | ACC_NATIVE, false);
+  creator.add_method(native);
+  creator.add_method(assembler::method_from_string(R"(
+    (method (public static) "LUser;.arrays:(LGoodIntf;LUnknownIntf;)V"
+     (
+      (load-param-object v0)
+      (load-param-object v1)
+      (const v2 1)
+      (new-array v2 "[LArrayIntf;")
+      (move-result-pseudo-object v3)
+      (invoke-interface (v1) "LUnknownIntf;.bar:()V")
+      (invoke-interface (v0) "LGoodIntf;.foo:()V")
+      (return-void)
+     )
+    )
+  )"));
+  add_user(creator.create());
+
+  auto analysis = analyze();
+  EXPECT_FALSE(analysis->is_single_impl(native_intf->get_type()));
+  EXPECT_FALSE(analysis->is_single_impl(array_intf->get_type()));
+  EXPECT_FALSE(analysis->is_single_impl(unknown_intf->get_type()));
+  ASSERT_TRUE(analysis->is_single_impl(good_intf->get_type()));
+  auto& data = analysis->get_single_impl_data(good_intf->get_type());
+  EXPECT_EQ(data.methoddefs.size(), 1);
+  EXPECT_EQ(data.intf_methodrefs.size(), 1);
+}
@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SlabAllocator.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using Allocator = SlabAllocator<24, 8>;
+
+TEST(SlabAllocatorTest, blocksAreDistinctAndAligned) {
+  std::vector<void*> blocks;
+  std::unordered_set<void*> seen;
+  for (size_t i = 0; i < 10000; ++i) {
+    auto block = Allocator::allocate();
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(block) % 8, 0);
+    EXPECT_TRUE(seen.insert(block).second);
+    // The whole block is usable.
+    memset(block, 0xab, 24);
+    blocks.push_back(block);
+  }
+  for (auto block : blocks) {
+    Allocator::deallocate(block);
+  }
+}
+
+TEST(SlabAllocatorTest, freedBlocksAreReused) {
+  auto block = Allocator::allocate();
+  Allocator::deallocate(block);
+#ifndef REDEX_SLAB_ALLOCATOR_DISABLED
+  EXPECT_EQ(Allocator::allocate(), block);
+#endif
+}
+
+TEST(SlabAllocatorTest, freeOnAnotherThread) {
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < 1000; ++i) {
+    blocks.push_back(Allocator::allocate());
+  }
+  std::thread worker([&] {
+    for (auto block : blocks) {
+      Allocator::deallocate(block);
+    }
+    // Allocate after freeing, then exit, handing the blocks back.
+    blocks.assign(1, Allocator::allocate());
+  });
+  worker.join();
+  Allocator::deallocate(blocks[0]);
+  blocks.clear();
+  for (size_t i = 0; i < 2000; ++i) {
+    blocks.push_back(Allocator::allocate());
+  }
+  for (auto block : blocks) {
+    Allocator::deallocate(block);
+  }
+}
+
+TEST(SlabAllocatorTest, freeingThreadGivesBlocksBack) {
+  std::vector<void*> blocks;
+  for (size_t i = 0; i < 20000; ++i) {
+    blocks.push_back(Allocator::allocate());
+  }
+  std::unordered_set<void*> freed(blocks.begin(), blocks.end());
+  std::mutex lock;
+  std::condition_variable cv;
+  bool done_freeing = false;
+  bool done_checking = false;
+  // The freeing thread stays alive, so only an over-long free list can have
+  // handed its blocks back.
+  std::thread freeing([&] {
+    for (auto block : blocks) {
+      Allocator::deallocate(block);
+    }
+    std::unique_lock<std::mutex> guard(lock);
+    done_freeing = true;
+    cv.notify_all();
+    cv.wait(guard, [&] { return done_checking; });
+  });
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    cv.wait(guard, [&] { return done_freeing; });
+  }
+  std::thread allocating([&] {
+    auto block = Allocator::allocate();
+#ifndef REDEX_SLAB_ALLOCATOR_DISABLED
+    EXPECT_EQ(freed.count(block), 1);
+#endif
+    Allocator::deallocate(block);
+  });
+  allocating.join();
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    done_checking = true;
+    cv.notify_all();
+  }
+  freeing.join();
+}
+
+namespace {
+
+// Allocates from its destructor, which runs after the thread's allocator
+// cache is gone when the object was constructed before the cache.
+struct LateUser {
+  ~LateUser() {
+    auto block = Allocator::allocate();
+    memset(block, 0xcd, 24);
+    Allocator::deallocate(block);
+  }
+};
+
+} // namespace
+
+TEST(SlabAllocatorTest, useAfterThreadCacheIsDestroyed) {
+  std::thread worker([] {
+    thread_local LateUser t_late_user;
+    (void)t_late_user;
+    Allocator::deallocate(Allocator::allocate());
+  });
+  worker.join();
+  Allocator::deallocate(Allocator::allocate());
+}
@@ -265,4 +265,42 @@ TEST_F(StaticReloV2Test, relocatePrivateStaticMethod) {
   EXPECT_EQ(method_b->get_class(), classOuter->get_type());
   EXPECT_EQ(method_c->get_class(), classInner->get_type());
 }
+/**
+ * Static methods with the same name that move to the same class are renamed
+ * in the order of the scope, whatever order the candidate set is in.
+ *
+ * Input:
+ * class A { public static void foo() {} }
+ * class B { public static void foo() {} }
+ * class Other {
+ *   public void c() {
+ *     B.foo();
+ *     A.foo();
+ *   }
+ * }
+ */
+TEST_F(StaticReloV2Test, relocationsFollowTheScope) {
+  DexClass* classA = create_class("A");
+  DexMethod* method_a = create_method(classA, "foo", ACC_PUBLIC | ACC_STATIC);
+  DexClass* classB = create_class("B");
+  DexMethod* method_b = create_method(classB, "foo", ACC_PUBLIC | ACC_STATIC);
+  DexClass* classOther = create_class("Other");
+  DexMethod* method_c = create_method(classOther, "c", ACC_PUBLIC);
+
+  call(method_c, method_b);
+  call(method_c, method_a);
+
+  Scope scope({classA, classB, classOther});
+  std::unordered_set<DexClass*> candidate_classes =
+      StaticReloPassV2::gen_candidates(scope);
+  EXPECT_EQ(candidate_classes.size(), 2);
+  int relocated_methods =
+      StaticReloPassV2::run_relocation(scope, candidate_classes);
+  EXPECT_EQ(relocated_methods, 2);
+  EXPECT_EQ(method_a->get_class(), classOther->get_type());
+  EXPECT_EQ(method_b->get_class(), classOther->get_type());
+  EXPECT_EQ(method_a->get_name()->str(), "foo");
+  EXPECT_NE(method_b->get_name()->str(), "foo");
+}
+
 } // namespace static_relo_v2
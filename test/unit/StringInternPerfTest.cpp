@@ -0,0 +1,90 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "DexClass.h"
+#include "RedexContext.h"
+#include "WorkQueue.h"
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <sys/resource.h>
+#include <vector>
+
+//==========
+// Measures DexString interning throughput and the resulting peak RSS. Run it
+// once per string table flavor, since peak RSS is per process:
+//
+//   string_intern_perf_test [tree|hashed] [num_strings]
+//==========
+
+namespace {
+
+// Strings shaped like the contents of a typical dex string pool: type
+// descriptors and member names sharing long package prefixes.
+std::vector<std::string> make_strings(size_t n) {
+  std::vector<std::string> strings;
+  strings.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    switch (i % 3) {
+    case 0:
+      strings.push_back("Lcom/facebook/generated/module" +
+                        std::to_string(i % 997) + "/Class" +
+                        std::to_string(i) + ";");
+      break;
+    case 1:
+      strings.push_back("field" + std::to_string(i));
+      break;
+    default:
+      strings.push_back("method$lambda$" + std::to_string(i));
+      break;
+    }
+  }
+  return strings;
+}
+
+double intern_all(const std::vector<std::string>& strings) {
+  auto wq = workqueue_foreach<size_t>([&](size_t t) {
+    auto num_threads = ThreadPool::get().num_threads();
+    for (size_t i = t; i < strings.size(); i += num_threads) {
+      DexString::make_string(strings[i]);
+    }
+  });
+  for (size_t t = 0; t < ThreadPool::get().num_threads(); ++t) {
+    wq.add_item(t);
+  }
+  auto start = std::chrono::steady_clock::now();
+  wq.run_all();
+  return strings.size() /
+         std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+             .count();
+}
+
+long peak_rss_kb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  bool hashed = argc > 1 && strcmp(argv[1], "hashed") == 0;
+  size_t n = argc > 2 ? std::stoul(argv[2]) : 2'000'000;
+  auto strings = make_strings(n);
+  auto baseline_rss = peak_rss_kb();
+
+  g_redex = new RedexContext(hashed);
+  double insert_rate = intern_all(strings);
+  double lookup_rate = intern_all(strings);
+  printf("%s string table, %zu strings: insert %.0f strings/s, "
+         "lookup %.0f strings/s, peak RSS +%ld KiB\n",
+         hashed ? "hashed" : "tree", n, insert_rate, lookup_rate,
+         peak_rss_kb() - baseline_rss);
+  delete g_redex;
+}
@@ -0,0 +1,167 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SummarySerialization.h"
+
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "Creators.h"
+#include "IRAssembler.h"
+#include "RedexTest.h"
+#include "SideEffectSummary.h"
+
+class SummarySerializationTest : public RedexTest {
+ public:
+  SummarySerializationTest() {
+    ClassCreator creator(DexType::make_type("LFoo;"));
+    creator.set_super(get_object_type());
+
+    m_root = assembler::method_from_string(R"(
+      (method (public static) "LFoo;.root:()V"
+       (
+        (invoke-static () "LFoo;.a:()V")
+        (return-void)
+       )
+      )
+    )");
+    m_root->rstate.set_root();
+    creator.add_method(m_root);
+
+    m_a = assembler::method_from_string(R"(
+      (method (public static) "LFoo;.a:()V"
+       (
+        (invoke-static () "LFoo;.b:()V")
+        (return-void)
+       )
+      )
+    )");
+    creator.add_method(m_a);
+
+    m_b = assembler::method_from_string(R"(
+      (method (public static) "LFoo;.b:()V"
+       (
+        (return-void)
+       )
+      )
+    )");
+    creator.add_method(m_b);
+
+    m_c = assembler::method_from_string(R"(
+      (method (public static) "LFoo;.c:()V"
+       (
+        (return-void)
+       )
+      )
+    )");
+    m_c->rstate.set_root();
+    creator.add_method(m_c);
+
+    m_scope.push_back(creator.create());
+  }
+
+  std::string print_summaries() {
+    auto graph = call_graph::single_callee_graph(m_scope);
+    side_effects::SummaryMap summaries;
+    summaries.emplace(m_root, side_effects::Summary(side_effects::EFF_THROWS,
+                                                    {}));
+    summaries.emplace(m_a, side_effects::Summary({0}));
+    summaries.emplace(m_b, side_effects::Summary());
+    summaries.emplace(m_c, side_effects::Summary());
+    std::ostringstream output;
+    summary_serialization::print_cache(output, summaries, graph);
+    return output.str();
+  }
+
+  side_effects::SummaryMap read_summaries(const std::string& cached) {
+    auto graph = call_graph::single_callee_graph(m_scope);
+    side_effects::SummaryMap summaries;
+    std::istringstream input(cached);
+    summary_serialization::read_cache(input, graph, &summaries);
+    return summaries;
+  }
+
+ protected:
+  Scope m_scope;
+  DexMethod* m_root;
+  DexMethod* m_a;
+  DexMethod* m_b;
+  DexMethod* m_c;
+};
+
+TEST_F(SummarySerializationTest, unchangedCodeIsValid) {
+  auto summaries = read_summaries(print_summaries());
+  EXPECT_EQ(summaries.size(), 4);
+  EXPECT_EQ(summaries.at(m_root),
+            side_effects::Summary(side_effects::EFF_THROWS, {}));
+  EXPECT_EQ(summaries.at(m_a), side_effects::Summary({0}));
+}
+
+TEST_F(SummarySerializationTest, changedCalleeInvalidatesCallers) {
+  auto cached = print_summaries();
+  m_b->get_code()->push_back(new IRInstruction(OPCODE_NOP));
+  auto summaries = read_summaries(cached);
+  EXPECT_EQ(summaries.size(), 1);
+  EXPECT_EQ(summaries.count(m_c), 1);
+}
+
+TEST_F(SummarySerializationTest, changedCallerKeepsCallees) {
+  auto cached = print_summaries();
+  m_a->get_code()->push_back(new IRInstruction(OPCODE_NOP));
+  auto summaries = read_summaries(cached);
+  EXPECT_EQ(summaries.size(), 2);
+  EXPECT_EQ(summaries.count(m_b), 1);
+  EXPECT_EQ(summaries.count(m_c), 1);
+}
+
+TEST_F(SummarySerializationTest, binaryEncodingRoundTrips) {
+  sparta::s_expr expr({sparta::s_expr("a b"), sparta::s_expr(-3),
+                       sparta::s_expr({}),
+                       sparta::s_expr({sparta::s_expr(1 << 20)})});
+  std::ostringstream output;
+  summary_serialization::write_binary(output, expr);
+  auto bytes = output.str();
+  const char* begin = bytes.data();
+  sparta::s_expr read;
+  ASSERT_TRUE(summary_serialization::read_binary(
+      &begin, bytes.data() + bytes.size(), &read));
+  EXPECT_EQ(read, expr);
+  EXPECT_EQ(begin, bytes.data() + bytes.size());
+
+  begin = bytes.data();
+  EXPECT_FALSE(summary_serialization::read_binary(
+      &begin, bytes.data() + bytes.size() - 1, &read));
+}
+
+TEST_F(SummarySerializationTest, binaryCacheMatchesTextCache) {
+  auto graph = call_graph::single_callee_graph(m_scope);
+  side_effects::SummaryMap summaries;
+  summaries.emplace(m_root,
+                    side_effects::Summary(side_effects::EFF_THROWS, {}));
+  summaries.emplace(m_a, side_effects::Summary({0}));
+  summaries.emplace(m_b, side_effects::Summary());
+  summaries.emplace(m_c, side_effects::Summary());
+  auto file = (boost::filesystem::temp_directory_path() /
+               boost::filesystem::unique_path("summaries-%%%%%%.bin"))
+                  .string();
+  {
+    std::ofstream output(file, std::ios::binary);
+    summary_serialization::print_binary_cache(output, summaries, graph);
+  }
+  auto cached = print_summaries();
+
+  m_b->get_code()->push_back(new IRInstruction(OPCODE_NOP));
+  side_effects::SummaryMap binary_summaries;
+  summary_serialization::read_binary_cache(file, m_scope, graph,
+                                           &binary_summaries);
+  boost::filesystem::remove(file);
+  EXPECT_EQ(binary_summaries, read_summaries(cached));
+  EXPECT_EQ(binary_summaries.size(), 1);
+  EXPECT_EQ(binary_summaries.count(m_c), 1);
+}
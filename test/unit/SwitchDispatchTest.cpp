@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Creators.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+#include "SwitchDispatch.h"
+
+class SwitchDispatchTest : public RedexTest {};
+
+namespace {
+
+std::vector<DexMethodRef*> get_invoked_methods(DexMethod* method) {
+  std::vector<DexMethodRef*> callees;
+  for (const auto& mie : InstructionIterable(method->get_code())) {
+    if (is_invoke(mie.insn->opcode())) {
+      callees.push_back(mie.insn->get_method());
+    }
+  }
+  return callees;
+}
+
+} // namespace
+
+TEST_F(SwitchDispatchTest, splitDispatch) {
+  auto type = DexType::make_type("LFoo;");
+  auto type_tag_field =
+      static_cast<DexField*>(DexField::make_field("LFoo;.$t:I"));
+  type_tag_field->make_concrete(ACC_PUBLIC);
+
+  std::map<SwitchIndices, DexMethod*> indices_to_callee;
+  std::vector<DexMethod*> targets;
+  for (int i = 0; i < 5; ++i) {
+    auto target = assembler::method_from_string(
+        "(method (public static) \"LFoo;.get" + std::to_string(i) +
+        ":(LFoo;)I\" ((load-param-object v0) (const v1 " + std::to_string(i) +
+        ") (return v1)))");
+    indices_to_callee[{i}] = target;
+    targets.push_back(target);
+  }
+
+  dispatch::Spec spec{type,
+                      dispatch::Type::VIRTUAL,
+                      "get",
+                      DexProto::make_proto(get_int_type(),
+                                           DexTypeList::make_type_list({})),
+                      ACC_PUBLIC,
+                      type_tag_field,
+                      nullptr, // overridden_meth
+                      /* max_num_dispatch_target */ 2,
+                      /* keep_debug_info */ false};
+  auto dispatch = dispatch::create_virtual_dispatch(spec, indices_to_callee);
+
+  // The five cases need three sub dispatches, of at most two cases each.
+  ASSERT_EQ(dispatch.sub_dispatches.size(), 3);
+  std::vector<DexMethodRef*> sub_dispatches;
+  for (size_t i = 0; i < dispatch.sub_dispatches.size(); ++i) {
+    auto sub_dispatch = dispatch.sub_dispatches[i];
+    EXPECT_EQ(sub_dispatch->get_name()->str(), "get$" + std::to_string(i));
+    EXPECT_TRUE(is_static(sub_dispatch));
+    sub_dispatches.push_back(sub_dispatch);
+  }
+  EXPECT_EQ(get_invoked_methods(dispatch.main_dispatch), sub_dispatches);
+  EXPECT_EQ(get_invoked_methods(dispatch.sub_dispatches[0]),
+            std::vector<DexMethodRef*>({targets[0], targets[1]}));
+  EXPECT_EQ(get_invoked_methods(dispatch.sub_dispatches[1]),
+            std::vector<DexMethodRef*>({targets[2], targets[3]}));
+  EXPECT_EQ(get_invoked_methods(dispatch.sub_dispatches[2]),
+            std::vector<DexMethodRef*>({targets[4]}));
+}
@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Timer.h"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <json/json.h>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+const Timer::Span* find_span(const std::vector<Timer::Span>& spans,
+                             const std::string& msg) {
+  for (const auto& span : spans) {
+    if (span.msg == msg) {
+      return &span;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace
+
+TEST(TimerTest, nestedSpans) {
+  {
+    Timer outer("nested outer");
+    { Timer inner("nested inner"); }
+  }
+  auto spans = Timer::get_spans();
+  auto outer = find_span(spans, "nested outer");
+  auto inner = find_span(spans, "nested inner");
+  ASSERT_NE(outer, nullptr);
+  ASSERT_NE(inner, nullptr);
+  EXPECT_EQ(outer->thread_id, inner->thread_id);
+  EXPECT_EQ(outer->depth + 1, inner->depth);
+  EXPECT_LE(outer->start, inner->start);
+  EXPECT_GE(outer->start + outer->duration, inner->start + inner->duration);
+
+  // get_times() lists the Timers in completion order.
+  auto times = Timer::get_times();
+  auto pos = [&](const std::string& msg) {
+    return std::find_if(times.begin(), times.end(),
+                        [&](const auto& t) { return t.first == msg; });
+  };
+  EXPECT_LT(pos("nested inner"), pos("nested outer"));
+}
+
+TEST(TimerTest, threadsGetTheirOwnIds) {
+  { Timer t("thread main"); }
+  std::thread worker([] {
+    Timer outer("thread worker");
+    { Timer inner("thread worker inner"); }
+  });
+  worker.join();
+  auto spans = Timer::get_spans();
+  auto main_span = find_span(spans, "thread main");
+  auto worker_span = find_span(spans, "thread worker");
+  ASSERT_NE(main_span, nullptr);
+  ASSERT_NE(worker_span, nullptr);
+  EXPECT_NE(main_span->thread_id, worker_span->thread_id);
+  EXPECT_EQ(worker_span->depth, 0);
+  EXPECT_EQ(find_span(spans, "thread worker inner")->depth, 1);
+}
+
+TEST(TimerTest, chromeTrace) {
+  { Timer t("trace \"quoted\""); }
+  std::ostringstream os;
+  Timer::write_chrome_trace(os);
+  Json::Value trace;
+  std::istringstream is(os.str());
+  is >> trace;
+  bool found = false;
+  for (const auto& event : trace["traceEvents"]) {
+    if (event["name"].asString() == "trace \"quoted\"") {
+      EXPECT_EQ(event["ph"].asString(), "X");
+      EXPECT_GE(event["dur"].asInt64(), 0);
+      found = true;
+    }
+  }
+  EXPECT_TRUE(found);
+}
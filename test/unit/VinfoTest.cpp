@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "DexUtil.h"
+#include "RedexTest.h"
+#include "ScopeHelper.h"
+#include "Vinfo.h"
+
+struct VinfoTest : public RedexTest {};
+
+/**
+ * class A           { void f() }
+ * class B extends A { void f() }
+ * class C extends B { void f() }
+ */
+TEST_F(VinfoTest, updatesOnRemoveAndAdd) {
+  auto scope = create_empty_scope();
+  auto obj_t = get_object_type();
+  auto a_t = DexType::make_type("LA;");
+  auto b_t = DexType::make_type("LB;");
+  auto c_t = DexType::make_type("LC;");
+  auto a_cls = create_internal_class(a_t, obj_t, {});
+  auto b_cls = create_internal_class(b_t, a_t, {});
+  auto c_cls = create_internal_class(c_t, b_t, {});
+  scope.push_back(a_cls);
+  scope.push_back(b_cls);
+  scope.push_back(c_cls);
+  auto proto =
+      DexProto::make_proto(get_void_type(), DexTypeList::make_type_list({}));
+  auto a_f = create_empty_method(a_cls, "f", proto);
+  auto b_f = create_empty_method(b_cls, "f", proto);
+  auto c_f = create_empty_method(c_cls, "f", proto);
+
+  Vinfo vinfo(scope);
+  EXPECT_EQ(vinfo.get_overriden_method(c_f), b_f);
+  EXPECT_EQ(vinfo.get_decl(c_f), a_f);
+  EXPECT_EQ(vinfo.get_override_methods(a_f), Vinfo::methods_t{b_f});
+
+  // Removing B.f makes C.f a direct override of A.f.
+  b_cls->remove_method(b_f);
+  vinfo.remove_method(b_f);
+  EXPECT_EQ(vinfo.get_overriden_method(c_f), a_f);
+  EXPECT_EQ(vinfo.get_override_methods(a_f), Vinfo::methods_t{c_f});
+  EXPECT_TRUE(vinfo.is_overriden(a_f));
+
+  // Removing A.f makes C.f its own declaration.
+  a_cls->remove_method(a_f);
+  vinfo.remove_method(a_f);
+  EXPECT_FALSE(vinfo.is_override(c_f));
+  EXPECT_EQ(vinfo.get_decl(c_f), c_f);
+
+  // Adding B.f back makes it the declaration of C.f.
+  b_cls->add_method(b_f);
+  vinfo.add_method(b_f);
+  EXPECT_EQ(vinfo.get_overriden_method(c_f), b_f);
+  EXPECT_EQ(vinfo.get_decl(c_f), b_f);
+  EXPECT_FALSE(vinfo.is_override(b_f));
+  EXPECT_TRUE(vinfo.is_overriden(b_f));
+
+  // Moving B.f up to A.
+  relocate_method(b_f, a_t);
+  vinfo.relocate_method(b_f);
+  EXPECT_EQ(vinfo.get_overriden_method(c_f), b_f);
+  EXPECT_EQ(vinfo.get_decl(c_f), b_f);
+  EXPECT_EQ(vinfo.get_override_methods(b_f), Vinfo::methods_t{c_f});
+}
@@ -1622,3 +1622,25 @@ TEST(VitualInterfaceResolutionTest, empty) {
 
   delete g_redex;
 }
+
+/**
+ * A cached signature map is shared until the hierarchy changes.
+ */
+TEST(SignatureMapCache, rebuiltWhenMethodsChange) {
+  g_redex = new RedexContext();
+  std::vector<DexClass*> scope = create_scope_1();
+  SignatureMapCache cache;
+  auto sm = cache.get(scope);
+  EXPECT_EQ(sm->size(), OBJ_METH_NAMES + 2);
+  EXPECT_EQ(cache.get(scope), sm);
+
+  auto a_cls = type_class(DexType::get_type("LA;"));
+  auto void_void = DexProto::make_proto(
+      get_void_type(), DexTypeList::make_type_list({}));
+  create_empty_method(a_cls, "h", void_void);
+  auto rebuilt = cache.get(scope);
+  EXPECT_NE(rebuilt, sm);
+  EXPECT_EQ(rebuilt->size(), sm->size() + 1);
+
+  delete g_redex;
+}
@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "WorkItemProfiler.h"
+
+#include <chrono>
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "Creators.h"
+#include "DexClass.h"
+#include "RedexTest.h"
+#include "Show.h"
+#include "Walkers.h"
+#include "WorkQueue.h"
+
+class WorkItemProfilerTest : public RedexTest {
+ public:
+  WorkItemProfilerTest() {
+    for (int i = 0; i < 8; i++) {
+      auto type = DexType::make_type(
+          ("LFoo" + std::to_string(i) + ";").c_str());
+      ClassCreator cc(type);
+      cc.set_super(get_object_type());
+      for (int j = 0; j < 4; j++) {
+        auto method = static_cast<DexMethod*>(DexMethod::make_method(
+            show(type) + ".m" + std::to_string(j) + ":()V"));
+        method->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+        cc.add_method(method);
+      }
+      m_scope.push_back(cc.create());
+    }
+  }
+
+ protected:
+  static void sleep_ms(int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  }
+
+  Scope m_scope;
+};
+
+TEST_F(WorkItemProfilerTest, nothingRecordedWhenNotStarted) {
+  walk::parallel::methods(m_scope, [](DexMethod*) {});
+  EXPECT_FALSE(WorkItemProfiler::enabled());
+  EXPECT_TRUE(WorkItemProfiler::stop().empty());
+}
+
+TEST_F(WorkItemProfilerTest, slowestMethodsFirst) {
+  auto slowest = m_scope[3]->get_dmethods()[1];
+  auto second = m_scope[6]->get_dmethods()[2];
+  WorkItemProfiler::start(2);
+  walk::parallel::methods(m_scope, [&](DexMethod* m) {
+    if (m == slowest) {
+      sleep_ms(40);
+    } else if (m == second) {
+      sleep_ms(20);
+    }
+  });
+  auto samples = WorkItemProfiler::stop();
+  EXPECT_FALSE(WorkItemProfiler::enabled());
+
+  ASSERT_EQ(samples.size(), 2);
+  EXPECT_EQ(samples[0].name, show(slowest));
+  EXPECT_EQ(samples[1].name, show(second));
+  EXPECT_GE(samples[0].secs, 0.04);
+  EXPECT_GE(samples[1].secs, 0.02);
+}
+
+TEST_F(WorkItemProfilerTest, workQueueOfClasses) {
+  const unsigned int num_threads = 4;
+  auto slowest = m_scope[5];
+  auto wq = workqueue_foreach<DexClass*>(
+      [&](DexClass* cls) {
+        sleep_ms(cls == slowest ? 30 : 1);
+      },
+      num_threads);
+  for (auto cls : m_scope) {
+    wq.add_item(cls);
+  }
+  WorkItemProfiler::start(100);
+  wq.run_all();
+  auto samples = WorkItemProfiler::stop();
+
+  ASSERT_EQ(samples.size(), m_scope.size());
+  EXPECT_EQ(samples[0].name, show(slowest));
+  for (size_t i = 0; i < samples.size(); i++) {
+    EXPECT_LT(samples[i].worker_id, num_threads);
+    if (i > 0) {
+      EXPECT_GE(samples[i - 1].secs, samples[i].secs);
+    }
+  }
+}
+
+TEST_F(WorkItemProfilerTest, otherInputsAreNotRecorded) {
+  auto wq = workqueue_foreach<int>([](int) { sleep_ms(1); });
+  for (int i = 0; i < 10; i++) {
+    wq.add_item(i);
+  }
+  WorkItemProfiler::start(10);
+  wq.run_all();
+  EXPECT_TRUE(WorkItemProfiler::stop().empty());
+}
@@ -7,6 +7,7 @@
 
 #include "WorkQueue.h"
 
+#include <atomic>
 #include <thread>
 #include <chrono>
 #include <random>
@@ -80,9 +81,63 @@ void smallLengthTasks() {
   printf("speedup small length tasks: %f\n", speedup);
 }
 
+// Returns the number of tasks processed per second. Each task does a tiny
+// amount of work, so this mostly measures the cost of the queue operations
+// themselves.
+template <class TaskQueue>
+double measure_throughput(int num_items, int fanout, int num_threads) {
+  using Output = std::nullptr_t;
+  using State = WorkerState<int, std::nullptr_t, Output, TaskQueue>;
+  std::atomic<int> processed{0};
+  WorkQueue<int, std::nullptr_t, Output, TaskQueue> wq(
+      [&](State* state, int depth) -> Output {
+        if (depth > 0) {
+          for (int i = 0; i < fanout; ++i) {
+            state->push_task(depth - 1);
+          }
+        }
+        processed.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+      },
+      [](Output, Output) -> Output { return nullptr; },
+      [](unsigned int) { return nullptr; },
+      num_threads);
+  for (int i = 0; i < num_items; ++i) {
+    wq.add_item(fanout > 0 ? 1 : 0);
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+  wq.run_all();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  double secs = std::chrono::duration<double>(end - start).count();
+  return processed.load() / secs;
+}
+
+void compareQueueThroughput() {
+  auto num_threads = std::max(1u, std::thread::hardware_concurrency());
+  struct Config {
+    const char* name;
+    int num_items;
+    int fanout;
+  };
+  for (const auto& config : {Config{"flat", 4'000'000, 0},
+                             Config{"push_task", 400'000, 9}}) {
+    double locked = measure_throughput<workqueue_impl::LockedQueue<int>>(
+        config.num_items, config.fanout, num_threads);
+    double stealing =
+        measure_throughput<workqueue_impl::WorkStealingQueue<int>>(
+            config.num_items, config.fanout, num_threads);
+    printf("throughput %s (%u threads): locked %.0f tasks/s, "
+           "work-stealing %.0f tasks/s (%.2fx)\n",
+           config.name, num_threads, locked, stealing, stealing / locked);
+  }
+}
+
 int main() {
   printf("Begin!\n");
   profileBusyLoop();
   variableLengthTasks();
   smallLengthTasks();
+  compareQueueThroughput();
 }
@@ -7,9 +7,12 @@
 
 #include "WorkQueue.h"
 
+#include <atomic>
 #include <chrono>
 #include <gtest/gtest.h>
+#include <memory>
 #include <random>
+#include <unordered_set>
 
 constexpr unsigned int NUM_STRINGS = 100'000;
 constexpr unsigned int NUM_INTS = 1000;
@@ -38,6 +41,26 @@ TEST(WorkQueueTest, mapreduceTest) {
   ASSERT_EQ(7 * NUM_STRINGS, result);
 }
 
+TEST(WorkQueueTest, accumulateTest) {
+  // An odd number of workers leaves one result unpaired in the tree merge.
+  for (unsigned int num_threads : {1, 2, 3, 5, 8}) {
+    auto wq = workqueue_accumulate<int, std::unordered_set<int>>(
+        [](int a) { return std::unordered_set<int>{a, a + NUM_INTS}; },
+        [](std::unordered_set<int>& acc, std::unordered_set<int>&& item) {
+          acc.insert(item.begin(), item.end());
+        },
+        num_threads);
+    for (int idx = 0; idx < NUM_INTS; ++idx) {
+      wq.add_item(idx);
+    }
+    auto result = wq.run_all();
+    ASSERT_EQ(2 * NUM_INTS, result.size());
+    for (int idx = 0; idx < 2 * NUM_INTS; ++idx) {
+      ASSERT_EQ(1, result.count(idx));
+    }
+  }
+}
+
 TEST(WorkQueueTest, foreachTest) {
   int array[NUM_INTS] = {0};
 
@@ -103,3 +126,170 @@ TEST(WorkQueueTest, checkDynamicallyAddingTasks) {
   // 10 + 9 + ... + 1 + 0 = 55
   EXPECT_EQ(55, result);
 }
+
+// Work queues run from inside another work queue share the same pool threads,
+// and must complete even when every pool thread is busy with the outer queue.
+TEST(WorkQueueTest, nestedRunAll) {
+  auto outer = workqueue_mapreduce<int, int>(
+      [](int a) {
+        auto inner = workqueue_mapreduce<int, int>(
+            [](int b) { return b; }, [](int x, int y) { return x + y; });
+        for (int idx = 0; idx < NUM_INTS; ++idx) {
+          inner.add_item(a);
+        }
+        return inner.run_all();
+      },
+      [](int a, int b) { return a + b; });
+  for (int idx = 0; idx < 100; ++idx) {
+    outer.add_item(1);
+  }
+  EXPECT_EQ(100 * NUM_INTS, outer.run_all());
+}
+
+TEST(WorkQueueTest, threadPoolRunsEachIndexOnce) {
+  constexpr size_t N = 1000;
+  std::vector<std::atomic<int>> counts(N);
+  ThreadPool::get().run(N, [&](size_t i) { counts[i]++; });
+  for (size_t i = 0; i < N; ++i) {
+    ASSERT_EQ(1, counts[i].load());
+  }
+}
+
+TEST(WorkQueueTest, addItemToWorkerAndStats) {
+  auto wq = workqueue_mapreduce<int, int>(
+      [](int a) { return a; }, [](int a, int b) { return a + b; }, 2);
+  wq.enable_stats();
+  for (int idx = 0; idx < NUM_INTS; ++idx) {
+    wq.add_item(1, idx % 2);
+  }
+  EXPECT_EQ(NUM_INTS, wq.run_all());
+  auto stats = wq.get_worker_stats();
+  ASSERT_EQ(2, stats.size());
+  EXPECT_EQ(NUM_INTS, stats[0].num_tasks + stats[1].num_tasks);
+}
+
+TEST(WorkQueueTest, stealsAreCounted) {
+  // All the tasks start on the first worker, so any the second one runs were
+  // stolen.
+  auto wq = workqueue_mapreduce<int, int>(
+      [](int a) { return a; }, [](int a, int b) { return a + b; }, 2);
+  wq.enable_stats();
+  for (int idx = 0; idx < NUM_INTS; ++idx) {
+    wq.add_item(1, 0);
+  }
+  EXPECT_EQ(NUM_INTS, wq.run_all());
+  auto stats = wq.get_worker_stats();
+  ASSERT_EQ(2, stats.size());
+  EXPECT_EQ(stats[1].num_tasks, stats[1].num_steals);
+  EXPECT_EQ(0, stats[0].num_steals);
+  for (const auto& worker : stats) {
+    EXPECT_GE(worker.num_steal_attempts, worker.num_steals);
+    // Every worker looks at the other queue before it gives up.
+    EXPECT_GE(worker.num_steal_attempts, 1);
+  }
+}
+
+TEST(WorkQueueTest, totalsCoverAllRuns) {
+  auto run = [](int n) {
+    auto wq = workqueue_mapreduce<int, int>(
+        [](int a) { return a; }, [](int a, int b) { return a + b; }, 2);
+    for (int idx = 0; idx < n; ++idx) {
+      wq.add_item(1);
+    }
+    return wq.run_all();
+  };
+  run(10);
+  WorkQueueTotals::start();
+  EXPECT_TRUE(WorkQueueTotals::enabled());
+  run(NUM_INTS);
+  run(2 * NUM_INTS);
+  auto totals = WorkQueueTotals::stop();
+  EXPECT_FALSE(WorkQueueTotals::enabled());
+  run(10);
+
+  EXPECT_EQ(2, totals.num_runs);
+  EXPECT_EQ(3 * NUM_INTS, totals.num_tasks);
+  EXPECT_GE(totals.num_steal_attempts, totals.num_steals);
+  EXPECT_LE(totals.critical_path_secs, totals.busy_secs);
+  EXPECT_LE(totals.critical_path_secs, totals.wall_secs);
+}
+
+TEST(WorkQueueTest, nodeRangesCoverEachIndexOnce) {
+  for (size_t num_nodes = 1; num_nodes <= 4; ++num_nodes) {
+    for (size_t n = 1; n <= 9; ++n) {
+      EXPECT_EQ(0, ThreadPool::first_of_node(0, n, num_nodes));
+      EXPECT_EQ(n, ThreadPool::first_of_node(num_nodes, n, num_nodes));
+      for (size_t i = 0; i < n; ++i) {
+        auto node = ThreadPool::node_of(i, n, num_nodes);
+        EXPECT_LE(ThreadPool::first_of_node(node, n, num_nodes), i);
+        EXPECT_GT(ThreadPool::first_of_node(node + 1, n, num_nodes), i);
+      }
+    }
+  }
+}
+
+TEST(WorkQueueTest, pinnedThreadPoolRunsEachIndexOnce) {
+  auto& pool = ThreadPool::get();
+  pool.set_pin_threads(true);
+  EXPECT_GE(pool.num_nodes(), 1);
+  std::vector<std::atomic<int>> runs(NUM_INTS);
+  pool.run(NUM_INTS, [&](size_t i) { ++runs[i]; });
+  pool.set_pin_threads(false);
+  EXPECT_EQ(1, pool.num_nodes());
+  for (const auto& count : runs) {
+    EXPECT_EQ(1, count.load());
+  }
+}
+
+namespace {
+
+// Moving it copies it, so a moved-from task still holds its data.
+struct CopyOnlyTask {
+  explicit CopyOnlyTask(int i) : data(std::make_shared<int>(i)) {}
+  CopyOnlyTask(const CopyOnlyTask&) = default;
+  CopyOnlyTask& operator=(const CopyOnlyTask&) = default;
+
+  std::shared_ptr<int> data;
+};
+
+} // namespace
+
+TEST(WorkQueueTest, finishedTasksAreFreed) {
+  std::vector<std::weak_ptr<int>> tasks;
+  size_t num_alive_earlier = 0;
+  auto wq = workqueue_foreach<CopyOnlyTask>(
+      [&](CopyOnlyTask task) {
+        // A single worker pops its tasks last in, first out.
+        for (size_t i = *task.data + 1; i < tasks.size(); ++i) {
+          num_alive_earlier += tasks[i].expired() ? 0 : 1;
+        }
+      },
+      /* num_threads */ 1);
+  for (int i = 0; i < 100; ++i) {
+    CopyOnlyTask task(i);
+    tasks.push_back(task.data);
+    wq.add_item(task);
+  }
+  wq.run_all();
+  EXPECT_EQ(num_alive_earlier, 0);
+}
+
+TEST(WorkQueueTest, pushTaskFromOwnWorker) {
+  std::atomic<int> sum{0};
+  auto wq = WorkQueue<int>(
+      [&](WorkerState<int>* state, int n) {
+        sum += n;
+        if (n > 0) {
+          state->push_task(n - 1);
+        }
+        return nullptr;
+      },
+      [](std::nullptr_t, std::nullptr_t) { return nullptr; },
+      [](unsigned int) { return nullptr; },
+      4);
+  for (size_t i = 0; i < 4; ++i) {
+    wq.add_item(10, i);
+  }
+  wq.run_all();
+  EXPECT_EQ(sum, 4 * 55);
+}
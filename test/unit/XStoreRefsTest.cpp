@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Creators.h"
+#include "DexStore.h"
+#include "DexUtil.h"
+#include "RedexTest.h"
+
+namespace {
+
+DexClass* make_class(const std::string& name) {
+  ClassCreator creator(DexType::make_type(name.c_str()));
+  creator.set_super(get_object_type());
+  return creator.create();
+}
+
+DexStore make_store(const std::string& name,
+                    const std::vector<std::string>& dependencies,
+                    const std::vector<DexClasses>& dexen) {
+  DexMetadata dm;
+  dm.set_id(name);
+  dm.get_dependencies() = dependencies;
+  DexStore store(dm);
+  for (const auto& classes : dexen) {
+    store.add_classes(classes);
+  }
+  return store;
+}
+
+} // namespace
+
+struct XStoreRefsTest : public RedexTest {};
+
+TEST_F(XStoreRefsTest, illegalRefs) {
+  auto primary = make_class("LPrimary;");
+  auto secondary = make_class("LSecondary;");
+  auto a = make_class("LA;");
+  auto b = make_class("LB;");
+  auto c = make_class("LC;");
+  auto unknown = make_class("LUnknown;");
+
+  DexStoresVector stores;
+  stores.emplace_back(make_store("classes", {}, {{primary}, {secondary}}));
+  stores.emplace_back(make_store("A", {"classes"}, {{a}}));
+  stores.emplace_back(make_store("B", {"A"}, {{b}}));
+  stores.emplace_back(make_store("C", {}, {{c}}));
+  XStoreRefs xstores(stores);
+
+  EXPECT_EQ(xstores.get_store_idx(primary->get_type()), 0);
+  EXPECT_EQ(xstores.get_store_idx(secondary->get_type()), 1);
+  EXPECT_EQ(xstores.get_store_idx(a->get_type()), 2);
+  EXPECT_EQ(xstores.get_store(c->get_type()), &stores[3]);
+
+  // Within the root store, only the primary dex can't refer to the others.
+  EXPECT_TRUE(xstores.illegal_ref(primary->get_type(), secondary->get_type()));
+  EXPECT_FALSE(xstores.illegal_ref(secondary->get_type(), primary->get_type()));
+
+  // Anything can refer to the root store, but not the other way around.
+  EXPECT_FALSE(xstores.illegal_ref(a->get_type(), primary->get_type()));
+  EXPECT_FALSE(xstores.illegal_ref(c->get_type(), secondary->get_type()));
+  EXPECT_TRUE(xstores.illegal_ref(secondary->get_type(), a->get_type()));
+
+  // Other stores can only refer to their direct dependencies.
+  EXPECT_FALSE(xstores.illegal_ref(b->get_type(), a->get_type()));
+  EXPECT_FALSE(xstores.illegal_ref(b->get_type(), b->get_type()));
+  EXPECT_TRUE(xstores.illegal_ref(a->get_type(), b->get_type()));
+  EXPECT_TRUE(xstores.illegal_ref(c->get_type(), a->get_type()));
+
+  // Classes outside of the stores can't be referred to, unlike external types.
+  EXPECT_TRUE(xstores.illegal_ref(c->get_type(), unknown->get_type()));
+  EXPECT_FALSE(xstores.illegal_ref(c->get_type(), get_object_type()));
+}
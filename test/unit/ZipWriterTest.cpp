@@ -0,0 +1,185 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <numeric>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include "DexSink.h"
+#include "Parallel.h"
+#include "ZipWriter.h"
+
+namespace {
+
+uint32_t get16(const std::vector<uint8_t>& bytes, size_t offset) {
+  return bytes[offset] | (bytes[offset + 1] << 8);
+}
+
+uint32_t get32(const std::vector<uint8_t>& bytes, size_t offset) {
+  return get16(bytes, offset) | (get16(bytes, offset + 2) << 16);
+}
+
+struct ReadEntry {
+  uint32_t method;
+  std::string contents;
+};
+
+// Reads back a zip through its central directory.
+std::map<std::string, ReadEntry> read_zip(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)),
+                             std::istreambuf_iterator<char>());
+  std::map<std::string, ReadEntry> entries;
+  size_t end = bytes.size() - 22;
+  EXPECT_EQ(get32(bytes, end), 0x06054b50);
+  size_t count = get16(bytes, end + 10);
+  size_t cd = get32(bytes, end + 16);
+  for (size_t i = 0; i < count; ++i) {
+    EXPECT_EQ(get32(bytes, cd), 0x02014b50);
+    uint32_t method = get16(bytes, cd + 10);
+    uint32_t crc = get32(bytes, cd + 16);
+    uint32_t compressed_size = get32(bytes, cd + 20);
+    uint32_t size = get32(bytes, cd + 24);
+    size_t name_len = get16(bytes, cd + 28);
+    size_t local = get32(bytes, cd + 42);
+    std::string name(bytes.begin() + cd + 46,
+                     bytes.begin() + cd + 46 + name_len);
+    EXPECT_EQ(get32(bytes, local), 0x04034b50);
+    size_t data = local + 30 + get16(bytes, local + 26) +
+                  get16(bytes, local + 28);
+    std::string contents(size, '\0');
+    if (method == 0) {
+      EXPECT_EQ(compressed_size, size);
+      contents.assign(bytes.begin() + data, bytes.begin() + data + size);
+    } else {
+      z_stream stream;
+      memset(&stream, 0, sizeof(stream));
+      inflateInit2(&stream, -MAX_WBITS);
+      stream.next_in = &bytes[data];
+      stream.avail_in = compressed_size;
+      stream.next_out = reinterpret_cast<Bytef*>(&contents[0]);
+      stream.avail_out = size;
+      EXPECT_EQ(inflate(&stream, Z_FINISH), Z_STREAM_END);
+      inflateEnd(&stream);
+    }
+    EXPECT_EQ(crc32(0, reinterpret_cast<const Bytef*>(contents.data()),
+                    contents.size()),
+              crc);
+    entries[name] = {method, contents};
+    cd += 46 + name_len + get16(bytes, cd + 30) + get16(bytes, cd + 32);
+  }
+  return entries;
+}
+
+std::string temp_path(const char* name) {
+  return (boost::filesystem::temp_directory_path() /
+          boost::filesystem::unique_path(std::string(name) + "-%%%%%%.zip"))
+      .string();
+}
+
+} // namespace
+
+TEST(ZipWriter, entriesAddedInParallel) {
+  auto path = temp_path("zip_writer");
+  std::vector<std::string> contents;
+  for (size_t i = 0; i < 16; ++i) {
+    contents.push_back(std::string(1000 + i, 'a' + i));
+  }
+  {
+    ZipWriter zip(path);
+    std::vector<size_t> indices(contents.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+      zip.add_entry("classes" + std::to_string(i) + ".dex", contents[i].data(),
+                    contents[i].size());
+    });
+    zip.add_entry("stored", "xyz", 3, false);
+    zip.add_entry("empty", "", 0);
+  }
+  auto entries = read_zip(path);
+  EXPECT_EQ(entries.size(), contents.size() + 2);
+  for (size_t i = 0; i < contents.size(); ++i) {
+    const auto& entry = entries.at("classes" + std::to_string(i) + ".dex");
+    EXPECT_EQ(entry.method, 8);
+    EXPECT_EQ(entry.contents, contents[i]);
+  }
+  EXPECT_EQ(entries.at("stored").method, 0);
+  EXPECT_EQ(entries.at("stored").contents, "xyz");
+  EXPECT_EQ(entries.at("empty").contents, "");
+  boost::filesystem::remove(path);
+}
+
+TEST(ZipWriter, outputDoesNotDependOnOrder) {
+  auto read_bytes = [](const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+  };
+  auto first = temp_path("zip_writer_a");
+  auto second = temp_path("zip_writer_b");
+  {
+    ZipWriter zip(first);
+    zip.add_entry("a", "hello hello hello", 17);
+    zip.add_entry("b", "world", 5);
+  }
+  {
+    ZipWriter zip(second);
+    zip.add_entry("b", "world", 5);
+    zip.add_entry("a", "hello hello hello", 17);
+    zip.finish();
+  }
+  EXPECT_EQ(read_bytes(first), read_bytes(second));
+  boost::filesystem::remove(first);
+  boost::filesystem::remove(second);
+}
+
+TEST(ZipWriter, filesAreDeflatedAChunkAtATime) {
+  auto path = temp_path("zip_writer");
+  auto file = temp_path("zip_writer_file");
+  std::string contents;
+  for (size_t i = 0; i < 50000; ++i) {
+    contents += std::to_string(i * i) + ",";
+  }
+  {
+    std::ofstream out(file, std::ios::binary);
+    out << contents;
+  }
+  {
+    ZipWriter zip(path);
+    zip.add_file("big", file);
+    zip.add_file("big.stored", file, false);
+  }
+  auto entries = read_zip(path);
+  EXPECT_EQ(entries.at("big").method, 8);
+  EXPECT_EQ(entries.at("big").contents, contents);
+  EXPECT_EQ(entries.at("big.stored").method, 0);
+  EXPECT_EQ(entries.at("big.stored").contents, contents);
+  boost::filesystem::remove(path);
+  boost::filesystem::remove(file);
+}
+
+TEST(ZipWriter, dexSinkAddsTheDexWhenClosed) {
+  auto path = temp_path("zip_writer");
+  {
+    ZipWriter zip(path);
+    ZipEntryDexSink sink(&zip, "classes.dex");
+    sink.write(4, "body", 4);
+    sink.write(0, "head", 4);
+    sink.close();
+    EXPECT_FALSE(boost::filesystem::exists(sink.path()));
+  }
+  auto entries = read_zip(path);
+  EXPECT_EQ(entries.at("classes.dex").contents, "headbody");
+  boost::filesystem::remove(path);
+}
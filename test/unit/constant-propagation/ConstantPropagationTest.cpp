@@ -109,3 +109,53 @@ TEST(ConstantPropagation, WhiteBox2) {
             SignedConstantDomain(sign_domain::Interval::GEZ));
   EXPECT_EQ(exit_state.get<SignedConstantDomain>(1), SignedConstantDomain(0));
 }
+
+TEST(ConstantPropagation, LeanModeRecomputesSameStates) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+     (load-param v0)
+     (const v1 0)
+     (:loop)
+     (add-int/lit8 v1 v1 1)
+     (if-gez v1 :body)
+     (goto :done)
+     (:body)
+     (const v2 2)
+     (if-eqz v0 :loop)
+     (packed-switch v0 (:a :b :c))
+     (const v2 3)
+     (goto :loop)
+     (:a 0)
+     (const v2 4)
+     (:b 1)
+     (add-int/lit8 v2 v2 1)
+     (goto :loop)
+     (:c 2)
+     (const v3 5)
+     (goto :loop)
+     (:done)
+     (return-void)
+    )
+)");
+
+  code->build_cfg(/* editable */ false);
+  auto& cfg = code->cfg();
+  cfg.calculate_exit_block();
+  cp::intraprocedural::FixpointIterator intra_cp(
+      cfg, cp::ConstantPrimitiveAnalyzer());
+  intra_cp.run(ConstantEnvironment());
+  cp::intraprocedural::FixpointIterator lean_intra_cp(
+      cfg, cp::ConstantPrimitiveAnalyzer(), /* lean_block_threshold */ 1);
+  lean_intra_cp.run(ConstantEnvironment());
+  EXPECT_FALSE(intra_cp.is_lean());
+  EXPECT_TRUE(lean_intra_cp.is_lean());
+
+  for (auto* block : cfg.blocks()) {
+    EXPECT_TRUE(intra_cp.get_entry_state_at(block).equals(
+        lean_intra_cp.get_entry_state_at(block)))
+        << "entry of B" << block->id();
+    EXPECT_TRUE(intra_cp.get_exit_state_at(block).equals(
+        lean_intra_cp.get_exit_state_at(block)))
+        << "exit of B" << block->id();
+  }
+}
@@ -279,6 +279,98 @@ TEST_F(InterproceduralConstantPropagationTest, unreachableInvoke) {
   EXPECT_TRUE(fp_iter.get_entry_state_at(m3).is_bottom());
 }
 
+TEST_F(InterproceduralConstantPropagationTest, analyzeInWaves) {
+  // bar() passes a constant down a chain of calls that goes through a pair of
+  // mutually recursive methods; run_in_waves() should find the same entry
+  // states as run().
+  Scope scope;
+  auto cls_ty = DexType::make_type("LFoo;");
+  ClassCreator creator(cls_ty);
+  creator.set_super(get_object_type());
+
+  auto m1 = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.bar:()V"
+     (
+      (const v0 1)
+      (invoke-static (v0) "LFoo;.ping:(I)V")
+      (return-void)
+     )
+    )
+  )");
+  m1->rstate.set_root();
+  creator.add_method(m1);
+
+  auto m2 = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.ping:(I)V"
+     (
+      (load-param v0)
+      (invoke-static (v0) "LFoo;.pong:(I)V")
+      (return-void)
+     )
+    )
+  )");
+  creator.add_method(m2);
+
+  auto m3 = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.pong:(I)V"
+     (
+      (load-param v0)
+      (if-eqz v0 :done)
+      (invoke-static (v0) "LFoo;.ping:(I)V")
+      (invoke-static (v0) "LFoo;.baz:(I)V")
+      (:done)
+      (return-void)
+     )
+    )
+  )");
+  creator.add_method(m3);
+
+  auto m4 = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.baz:(I)V"
+     (
+      (load-param v0)
+      (return-void)
+     )
+    )
+  )");
+  creator.add_method(m4);
+
+  auto cls = creator.create();
+  scope.push_back(cls);
+
+  call_graph::Graph cg = call_graph::single_callee_graph(scope);
+  walk::code(scope, [](DexMethod*, IRCode& code) {
+    code.build_cfg(/* editable */ false);
+  });
+  FixpointIterator fp_iter(
+      cg,
+      [](const DexMethod* method,
+         const WholeProgramState&,
+         ArgumentDomain args) {
+        auto& code = *method->get_code();
+        auto env = env_with_params(&code, args);
+        auto intra_cp = std::make_unique<intraprocedural::FixpointIterator>(
+            code.cfg(), ConstantPrimitiveAnalyzer());
+        intra_cp->run(env);
+        return intra_cp;
+      });
+
+  fp_iter.run({{CURRENT_PARTITION_LABEL, ArgumentDomain()}});
+  std::vector<Domain> sequential;
+  for (auto* m : {m1, m2, m3, m4}) {
+    sequential.push_back(fp_iter.get_entry_state_at(m));
+  }
+
+  fp_iter.run_in_waves({{CURRENT_PARTITION_LABEL, ArgumentDomain()}});
+  size_t i = 0;
+  for (auto* m : {m1, m2, m3, m4}) {
+    EXPECT_TRUE(fp_iter.get_entry_state_at(m).equals(sequential[i++]))
+        << show(m);
+  }
+  EXPECT_EQ(fp_iter.get_entry_state_at(m4).get(CURRENT_PARTITION_LABEL),
+            ArgumentDomain({{0, SignedConstantDomain(1)}}));
+}
+
 struct RuntimeAssertTest : public InterproceduralConstantPropagationTest {
   DexMethodRef* m_fail_handler;
 
@@ -12,6 +12,7 @@
 #include "AbstractDomainPropertyTest.h"
 #include "ConstantPropagationTestUtil.h"
 #include "IRAssembler.h"
+#include "ReducedProductAbstractDomain.h"
 
 struct Constants {
   SignedConstantDomain one{SignedConstantDomain(1)};
@@ -90,6 +91,103 @@ TEST_F(SignedConstantDomainOperationsTest, binaryOperations) {
   EXPECT_TRUE(min_val.meet(positive).is_bottom());
 }
 
+/*
+ * The reduced product that SignedConstantDomain used to be. The packed
+ * representation must behave the same way.
+ */
+class ReferenceSignedConstantDomain
+    : public sparta::ReducedProductAbstractDomain<ReferenceSignedConstantDomain,
+                                                  sign_domain::Domain,
+                                                  ConstantDomain> {
+ public:
+  using ReducedProductAbstractDomain::ReducedProductAbstractDomain;
+
+  ReferenceSignedConstantDomain() = default;
+
+  explicit ReferenceSignedConstantDomain(int64_t v)
+      : ReferenceSignedConstantDomain(
+            std::make_tuple(sign_domain::Domain::top(), ConstantDomain(v))) {}
+
+  explicit ReferenceSignedConstantDomain(sign_domain::Interval interval)
+      : ReferenceSignedConstantDomain(std::make_tuple(
+            sign_domain::Domain(interval), ConstantDomain::top())) {}
+
+  static void reduce_product(
+      std::tuple<sign_domain::Domain, ConstantDomain>& domains) {
+    auto& sdom = std::get<0>(domains);
+    auto& cdom = std::get<1>(domains);
+    if (sdom.element() == sign_domain::Interval::EQZ) {
+      cdom.meet_with(ConstantDomain(0));
+      return;
+    }
+    auto cst = cdom.get_constant();
+    if (!cst) {
+      return;
+    }
+    if (!sign_domain::contains(sdom.element(), *cst)) {
+      sdom.set_to_bottom();
+      return;
+    }
+    sdom.meet_with(sign_domain::from_int(*cst));
+  }
+};
+
+TEST(SignedConstantDomainPacking, sameAsReducedProduct) {
+  using namespace sign_domain;
+  std::vector<SignedConstantDomain> values{SignedConstantDomain::bottom(),
+                                           SignedConstantDomain::top()};
+  std::vector<ReferenceSignedConstantDomain> reference_values{
+      ReferenceSignedConstantDomain::bottom(),
+      ReferenceSignedConstantDomain::top()};
+  for (int64_t v : {std::numeric_limits<int64_t>::min(), int64_t(-7),
+                    int64_t(-1), int64_t(0), int64_t(1), int64_t(42),
+                    std::numeric_limits<int64_t>::max()}) {
+    values.emplace_back(v);
+    reference_values.emplace_back(v);
+  }
+  for (auto interval : {Interval::EMPTY, Interval::LTZ, Interval::GTZ,
+                        Interval::EQZ, Interval::GEZ, Interval::LEZ,
+                        Interval::ALL}) {
+    values.emplace_back(interval);
+    reference_values.emplace_back(interval);
+  }
+  // Meets and joins don't reduce, so they make values that the constructors
+  // don't, like an EQZ interval with a Top constant. Add one round of them.
+  auto size = values.size();
+  for (size_t i = 0; i < size; ++i) {
+    for (size_t j = 0; j < size; ++j) {
+      values.push_back(values[i].meet(values[j]));
+      reference_values.push_back(reference_values[i].meet(reference_values[j]));
+      values.push_back(values[i].join(values[j]));
+      reference_values.push_back(reference_values[i].join(reference_values[j]));
+    }
+  }
+
+  auto same = [](const SignedConstantDomain& value,
+                 const ReferenceSignedConstantDomain& reference) {
+    return show(value) == show(reference) &&
+           value.is_bottom() == reference.is_bottom() &&
+           value.is_top() == reference.is_top();
+  };
+  for (size_t i = 0; i < values.size(); ++i) {
+    ASSERT_TRUE(same(values[i], reference_values[i])) << show(values[i]);
+    for (size_t j = 0; j < values.size(); ++j) {
+      const auto& a = values[i];
+      const auto& b = values[j];
+      const auto& ra = reference_values[i];
+      const auto& rb = reference_values[j];
+      EXPECT_EQ(a.leq(b), ra.leq(rb)) << show(a) << " " << show(b);
+      EXPECT_EQ(a.equals(b), ra.equals(rb)) << show(a) << " " << show(b);
+      EXPECT_TRUE(same(a.join(b), ra.join(rb))) << show(a) << " " << show(b);
+      EXPECT_TRUE(same(a.widening(b), ra.widening(rb)))
+          << show(a) << " " << show(b);
+      EXPECT_TRUE(same(a.meet(b), ra.meet(rb))) << show(a) << " " << show(b);
+      EXPECT_TRUE(same(a.narrowing(b), ra.narrowing(rb)))
+          << show(a) << " " << show(b);
+    }
+  }
+}
+
 TEST(ConstantPropagation, IfToGoto) {
   auto code = assembler::ircode_from_string(R"(
     (
@@ -7,6 +7,7 @@
 #include "ToolsCommon.h"
 
 #include <boost/filesystem.hpp>
+#include <cmath>
 #ifdef __GNUC__
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
@@ -22,8 +23,10 @@
 #include "DexOutput.h"
 #include "DexUtil.h"
 #include "IRMetaIO.h"
+#include "IRSnapshot.h"
 #include "InstructionLowering.h"
 #include "JarLoader.h"
+#include "Parallel.h"
 #include "Timer.h"
 #include "Walkers.h"
 
@@ -78,6 +81,16 @@ void write_ir_meta(const std::string& output_ir_dir, DexStoresVector& stores) {
   ir_meta_io::dump(classes, output_ir_dir);
 }
 
+/**
+ * Write the snapshot of the IR. This must come before the intermediate dexes,
+ * which are written from lowered code.
+ */
+void write_ir_snapshot(const std::string& output_ir_dir,
+                       DexStoresVector& stores) {
+  Timer t("Writing IR snapshot");
+  ir_snapshot::dump(stores, output_ir_dir);
+}
+
 /**
  * Write intermediate dex to files.
  * Development usage only
@@ -92,9 +105,9 @@ void write_intermediate_dex(const ConfigFiles& cfg,
     instruction_lowering::run(stores);
   }
   std::unique_ptr<PositionMapper> pos_mapper(PositionMapper::make("", ""));
+  std::vector<DexOutputTarget> targets;
   for (size_t store_number = 0; store_number < stores.size(); ++store_number) {
     auto& store = stores[store_number];
-    Timer t("Writing intermediate dexes");
 
     dex_files.append(Json::nullValue);
     Json::Value& store_files = dex_files[dex_files.size() - 1];
@@ -120,21 +133,20 @@ void write_intermediate_dex(const ConfigFiles& cfg,
       }
       ss << ".dex";
 
-      write_classes_to_dex(ss.str(),
-                           &store.get_dexen()[i],
-                           nullptr /* locator_index */,
-                           false /* name-based locators */,
-                           store_number,
-                           i,
-                           cfg,
-                           pos_mapper.get(),
-                           nullptr,
-                           nullptr,
-                           nullptr /* IODIMetadata* */);
+      targets.push_back({ss.str(), &store.get_dexen()[i], store_number, i});
       auto basename = boost::filesystem::path(ss.str()).filename().string();
       store_files["list"].append(basename);
     }
   }
+  Timer t("Writing intermediate dexes");
+  write_classes_to_dexes(targets,
+                         nullptr /* locator_index */,
+                         false /* name-based locators */,
+                         cfg,
+                         pos_mapper.get(),
+                         nullptr,
+                         nullptr,
+                         nullptr /* IODIMetadata* */);
 }
 
 /**
@@ -144,17 +156,39 @@ void load_intermediate_dex(const std::string& input_ir_dir,
                            const Json::Value& dex_files,
                            DexStoresVector& stores) {
   Timer t("Load intermediate dex");
-  dex_stats_t dex_stats;
+  // The dexes are loaded in parallel, and then added to their stores in the
+  // order they are listed in.
+  struct DexInput {
+    std::string location;
+    size_t store_idx;
+    DexClasses classes;
+  };
+  std::vector<DexInput> dex_inputs;
   for (const Json::Value& store_files : dex_files) {
     DexStore store(store_files["name"].asString());
     stores.emplace_back(std::move(store));
     for (const Json::Value& file_name : store_files["list"]) {
       auto location = boost::filesystem::path(input_ir_dir);
       location /= file_name.asString();
-      DexClasses classes = load_classes_from_dex(location.c_str(), &dex_stats);
-      stores.back().add_classes(std::move(classes));
+      dex_inputs.push_back({location.string(), stores.size() - 1, {}});
     }
   }
+  parallel_for(dex_inputs.begin(), dex_inputs.end(), [](DexInput& input) {
+    dex_stats_t dex_stats;
+    input.classes = load_classes_from_dex(input.location.c_str(), &dex_stats);
+  }, 1);
+  for (auto& input : dex_inputs) {
+    stores[input.store_idx].add_classes(std::move(input.classes));
+  }
+}
+
+/**
+ * Load the snapshot of the IR, if there is one
+ */
+bool load_ir_snapshot(const std::string& input_ir_dir,
+                      DexStoresVector& stores) {
+  Timer t("Loading IR snapshot");
+  return ir_snapshot::load(input_ir_dir, stores);
 }
 
 /**
@@ -195,7 +229,7 @@ Json::Value parse_config(const std::string& config_file) {
 }
 
 /**
- * Dumping dex, IR meta data and entry file
+ * Dumping IR snapshot, dex, IR meta data and entry file
  */
 void write_all_intermediate(const ConfigFiles& cfg,
                             const std::string& output_ir_dir,
@@ -206,20 +240,25 @@ void write_all_intermediate(const ConfigFiles& cfg,
   redex_options.serialize(entry_data);
   entry_data["dex_list"] = Json::arrayValue;
   write_ir_meta(output_ir_dir, stores);
+  write_ir_snapshot(output_ir_dir, stores);
   write_intermediate_dex(ConfigFiles(Json::nullValue), output_ir_dir, stores,
                          entry_data["dex_list"]);
   write_entry_file(output_ir_dir, entry_data);
 }
 
 /**
- * Loading entry file, dex files and IR meta data
+ * Loading entry file, IR snapshot or dex files, and IR meta data
  */
 void load_all_intermediate(const std::string& input_ir_dir,
                            DexStoresVector& stores,
                            Json::Value* entry_data) {
   Timer t("Loading all");
   load_entry_file(input_ir_dir, entry_data);
-  load_intermediate_dex(input_ir_dir, (*entry_data)["dex_list"], stores);
+  // The dexes are only read when there is no snapshot, e.g. when it was
+  // written by another version of Redex.
+  if (!load_ir_snapshot(input_ir_dir, stores)) {
+    load_intermediate_dex(input_ir_dir, (*entry_data)["dex_list"], stores);
+  }
 
   // load external classes
   Scope external_classes;
@@ -235,4 +274,60 @@ void load_all_intermediate(const std::string& input_ir_dir,
     std::cerr << "Load IR meta failed\n";
   }
 }
+
+Json::Value get_pass_stats(const PassManager& mgr) {
+  Json::Value all(Json::ValueType::objectValue);
+  for (const auto& pass_info : mgr.get_pass_info()) {
+    Json::Value pass(Json::ValueType::objectValue);
+    for (const auto& pass_metric : pass_info.metrics) {
+      pass[pass_metric.first] = pass_metric.second;
+    }
+    // Recorded for every pass, so that resource regressions can be tracked
+    // from one release to the next.
+    const auto& res = pass_info.resources;
+    pass["resource_wall_ms"] = Json::Int64(std::round(res.wall_seconds * 1000));
+    pass["resource_cpu_ms"] = Json::Int64(std::round(res.cpu_seconds * 1000));
+    pass["resource_rss_delta_kb"] = Json::Int64(res.rss_delta_kb);
+    pass["resource_peak_rss_kb"] = Json::Int64(res.peak_rss_kb);
+    if (res.has_allocated_bytes) {
+      pass["resource_allocated_bytes_delta"] =
+          Json::Int64(res.allocated_bytes_delta);
+    }
+    if (res.has_numa_stats) {
+      pass["resource_numa_local_pages"] =
+          Json::Int64(res.numa_local_pages_delta);
+      pass["resource_numa_remote_pages"] =
+          Json::Int64(res.numa_remote_pages_delta);
+    }
+    if (!pass_info.hot_items.empty()) {
+      Json::Value hot_items(Json::ValueType::arrayValue);
+      for (const auto& sample : pass_info.hot_items) {
+        Json::Value item(Json::ValueType::objectValue);
+        item["name"] = sample.name;
+        item["worker"] = Json::UInt64(sample.worker_id);
+        item["us"] = Json::Int64(std::round(sample.secs * 1000000));
+        hot_items.append(item);
+      }
+      pass["hot_work_items"] = hot_items;
+    }
+    if (pass_info.memory_census) {
+      const auto& census = *pass_info.memory_census;
+      Json::Value census_json(Json::ValueType::objectValue);
+      for (size_t i = 0; i < MemoryCensus::NUM_CATEGORIES; i++) {
+        const auto& count = census.counts[i];
+        Json::Value category(Json::ValueType::objectValue);
+        category["objects"] = Json::UInt64(count.objects);
+        category["bytes"] = Json::UInt64(count.bytes);
+        census_json[MemoryCensus::name(MemoryCensus::Category(i))] = category;
+      }
+      census_json["total_bytes"] = Json::UInt64(census.total_bytes());
+      if (census.has_allocated_bytes) {
+        census_json["allocated_bytes"] = Json::UInt64(census.allocated_bytes);
+      }
+      pass["memory_census"] = census_json;
+    }
+    all[pass_info.name] = pass;
+  }
+  return all;
+}
 } // namespace redex
@@ -24,4 +24,10 @@ void write_all_intermediate(const ConfigFiles& cfg,
 void load_all_intermediate(const std::string& input_ir_dir,
                            DexStoresVector& stores,
                            Json::Value* entry_data);
+
+/**
+ * The metrics and the resources of every pass that the manager ran, keyed by
+ * pass name.
+ */
+Json::Value get_pass_stats(const PassManager& mgr);
 } // namespace redex
@@ -5,16 +5,24 @@
  * LICENSE file in the root directory of this source tree.
  */
 
-#include <boost/scope_exit.hpp>
+#include <cctype>
+#include <cstring>
 #include <fcntl.h>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "PositionMap.h"
 
+PositionMap::~PositionMap() {
+  if (mapping != nullptr) {
+    munmap(const_cast<uint8_t*>(mapping), mapping_size);
+  }
+}
+
 std::unique_ptr<PositionMap> read_map(const char* filename) {
   int fd = open(filename, O_RDONLY);
   if (fd == -1) {
@@ -26,46 +34,69 @@ std::unique_ptr<PositionMap> read_map(const char* filename) {
   if (fstat(fd, &buf)) {
     std::cerr << "Cannot fstat file (" << filename
               << ") with error: " << strerror(errno) << std::endl;
+    close(fd);
     return nullptr;
   }
-  uint8_t* mapping = (uint8_t*)mmap(
-      nullptr, buf.st_size, PROT_READ, MAP_FILE | MAP_SHARED, fd, 0);
-  uint32_t magic = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
+  void* mapping =
+      mmap(nullptr, buf.st_size, PROT_READ, MAP_FILE | MAP_SHARED, fd, 0);
+  close(fd);
   if (mapping == MAP_FAILED) {
     std::cerr << "mmap failed for file (" << filename
               << ") with error: " << strerror(errno) << std::endl;
     return nullptr;
   }
-  BOOST_SCOPE_EXIT_ALL(=, &buf) {
-    munmap(mapping, buf.st_size);
+  // The map owns the mapping from here on, and unmaps it on failure too.
+  std::unique_ptr<PositionMap> map(new PositionMap());
+  map->mapping = static_cast<const uint8_t*>(mapping);
+  map->mapping_size = buf.st_size;
+
+  size_t offset = 0;
+  auto read_u32 = [&](uint32_t* value) {
+    if (map->mapping_size - offset < sizeof(uint32_t)) {
+      return false;
+    }
+    memcpy(value, map->mapping + offset, sizeof(uint32_t));
+    offset += sizeof(uint32_t);
+    return true;
   };
-  if (magic != 0xfaceb000) {
+  auto truncated = [&]() {
+    std::cerr << "Truncated line map file (" << filename << ")\n";
+    return nullptr;
+  };
+
+  uint32_t magic;
+  if (!read_u32(&magic) || magic != 0xfaceb000) {
     std::cerr << "Magic number mismatch\n";
     return nullptr;
   }
-  uint32_t version = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
-  if (version != 2) {
+  uint32_t version;
+  if (!read_u32(&version) || version != 2) {
     std::cerr << "Version mismatch\n";
     return nullptr;
   }
 
-  std::unique_ptr<PositionMap> map(new PositionMap());
-  std::vector<std::string> string_pool;
-  uint32_t spool_count = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
+  uint32_t spool_count;
+  if (!read_u32(&spool_count)) {
+    return truncated();
+  }
+  map->string_offsets.reserve(spool_count);
   for (uint32_t i = 0; i < spool_count; ++i) {
-    uint32_t ssize = *(uint32_t*)mapping;
-    mapping += sizeof(uint32_t);
-    map->string_pool.emplace_back((const char*)mapping, ssize);
-    mapping += ssize;
-  }
-  uint32_t pos_count = *(uint32_t*)mapping;
-  mapping += sizeof(uint32_t);
-  map->positions.reset(new PositionItem[pos_count]);
+    uint32_t string_offset = offset;
+    uint32_t ssize;
+    if (!read_u32(&ssize) || map->mapping_size - offset < ssize) {
+      return truncated();
+    }
+    map->string_offsets.push_back(string_offset);
+    offset += ssize;
+  }
+  uint32_t pos_count;
+  if (!read_u32(&pos_count) ||
+      (map->mapping_size - offset) / sizeof(PositionItem) < pos_count) {
+    return truncated();
+  }
+  map->positions =
+      reinterpret_cast<const PositionItem*>(map->mapping + offset);
   map->positions_size = pos_count;
-  memcpy(map->positions.get(), mapping, pos_count * sizeof(PositionItem));
   return map;
 }
 
@@ -73,11 +104,132 @@ std::vector<Position> get_stack(const PositionMap& map, int64_t idx) {
   std::vector<Position> stack;
   while (idx >= 0 && (size_t)idx < map.positions_size) {
     auto pi = map.positions[idx];
-    stack.push_back(Position(map.string_pool[pi.class_id],
-                             map.string_pool[pi.method_id],
-                             map.string_pool[pi.file_id],
+    stack.push_back(Position(map.string_at(pi.class_id),
+                             map.string_at(pi.method_id),
+                             map.string_at(pi.file_id),
                              pi.line));
     idx = (int64_t)pi.parent - 1;
   }
   return stack;
 }
+
+std::vector<std::vector<Position>> get_stacks(
+    const PositionMap& map, const std::vector<int64_t>& idxs) {
+  std::vector<std::vector<Position>> stacks;
+  stacks.reserve(idxs.size());
+  for (auto idx : idxs) {
+    stacks.push_back(get_stack(map, idx));
+  }
+  return stacks;
+}
+
+bool parse_frame(boost::string_ref line,
+                 boost::string_ref* prefix,
+                 int64_t* idx) {
+  auto is_space = [](char c) { return isspace((unsigned char)c) != 0; };
+  size_t i = 0;
+  auto skip_spaces = [&]() {
+    size_t start = i;
+    while (i < line.size() && is_space(line[i])) {
+      ++i;
+    }
+    return i > start;
+  };
+  if (!skip_spaces() || line.substr(i, 2) != "at") {
+    return false;
+  }
+  i += 2;
+  if (!skip_spaces()) {
+    return false;
+  }
+  auto paren = line.substr(i).find('(');
+  if (paren == boost::string_ref::npos) {
+    return false;
+  }
+  paren += i;
+  if (line.substr(paren + 1, 1) != ":") {
+    return false;
+  }
+  i = paren + 2;
+  int64_t number = 0;
+  size_t digits_start = i;
+  for (; i < line.size() && isdigit((unsigned char)line[i]); ++i) {
+    // Anything this large is not an index of the map either.
+    if (number > (int64_t(1) << 40)) {
+      return false;
+    }
+    number = number * 10 + (line[i] - '0');
+  }
+  if (i == digits_start || i >= line.size() || line[i] != ')') {
+    return false;
+  }
+  ++i;
+  if (i < line.size() && is_space(line[i])) {
+    ++i;
+  }
+  if (i != line.size()) {
+    return false;
+  }
+  *prefix = line.substr(0, paren);
+  *idx = number - 1;
+  return true;
+}
+
+void symbolicate(const PositionMap& map,
+                 boost::string_ref trace,
+                 std::string* out) {
+  while (!trace.empty()) {
+    auto eol = trace.find('\n');
+    auto line = trace.substr(0, eol);
+    trace = eol == boost::string_ref::npos ? boost::string_ref()
+                                           : trace.substr(eol + 1);
+    boost::string_ref prefix;
+    int64_t idx;
+    if (!parse_frame(line, &prefix, &idx)) {
+      out->append(line.data(), line.size());
+      out->push_back('\n');
+      continue;
+    }
+    for (const auto& pos : get_stack(map, idx)) {
+      out->append(prefix.data(), prefix.size());
+      out->push_back('(');
+      out->append(pos.filename.data(), pos.filename.size());
+      out->push_back(':');
+      out->append(std::to_string(pos.line));
+      out->append(")\n");
+    }
+  }
+}
+
+void PositionMapCache::add_build(const std::string& build_id,
+                                 const std::string& filename) {
+  m_filenames[build_id] = filename;
+  auto it = m_loaded.find(build_id);
+  if (it != m_loaded.end()) {
+    m_lru.erase(it->second);
+    m_loaded.erase(it);
+  }
+}
+
+const PositionMap* PositionMapCache::get(const std::string& build_id) {
+  auto loaded_it = m_loaded.find(build_id);
+  if (loaded_it != m_loaded.end()) {
+    m_lru.splice(m_lru.begin(), m_lru, loaded_it->second);
+    return m_lru.front().second.get();
+  }
+  auto filename_it = m_filenames.find(build_id);
+  if (filename_it == m_filenames.end()) {
+    return nullptr;
+  }
+  auto map = read_map(filename_it->second.c_str());
+  if (map == nullptr) {
+    return nullptr;
+  }
+  while (!m_lru.empty() && m_lru.size() >= m_capacity) {
+    m_loaded.erase(m_lru.back().first);
+    m_lru.pop_back();
+  }
+  m_lru.emplace_front(build_id, std::move(map));
+  m_loaded[build_id] = m_lru.begin();
+  return m_lru.front().second.get();
+}
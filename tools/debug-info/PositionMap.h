@@ -5,8 +5,12 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <boost/utility/string_ref.hpp>
+#include <list>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 struct __attribute__((packed)) PositionItem {
@@ -17,23 +21,100 @@ struct __attribute__((packed)) PositionItem {
   uint32_t parent;
 };
 
+/*
+ * The strings point into the PositionMap that the position came from, and are
+ * only valid as long as it is.
+ */
 struct Position {
-  std::string cls;
-  std::string method;
-  std::string filename;
+  boost::string_ref cls;
+  boost::string_ref method;
+  boost::string_ref filename;
   uint32_t line;
-  Position(const std::string& cls,
-           const std::string& method,
-           const std::string& filename,
+  Position(boost::string_ref cls,
+           boost::string_ref method,
+           boost::string_ref filename,
            uint32_t line)
       : cls(cls), method(method), filename(filename), line(line) {}
 };
 
+/*
+ * A line map file, mapped in memory. Nothing is copied out of it: the string
+ * pool is an index of offsets into the mapping, and the positions are read in
+ * place.
+ */
 struct PositionMap {
-  std::vector<std::string> string_pool;
-  std::unique_ptr<PositionItem[]> positions;
-  size_t positions_size;
+  PositionMap() = default;
+  PositionMap(const PositionMap&) = delete;
+  PositionMap& operator=(const PositionMap&) = delete;
+  ~PositionMap();
+
+  boost::string_ref string_at(uint32_t id) const {
+    return boost::string_ref(
+        reinterpret_cast<const char*>(mapping + string_offsets[id] +
+                                      sizeof(uint32_t)),
+        *reinterpret_cast<const uint32_t*>(mapping + string_offsets[id]));
+  }
+
+  // The offset of each string of the pool, i.e. of its size.
+  std::vector<uint32_t> string_offsets;
+  const PositionItem* positions{nullptr};
+  size_t positions_size{0};
+
+  const uint8_t* mapping{nullptr};
+  size_t mapping_size{0};
 };
 
 std::unique_ptr<PositionMap> read_map(const char* filename);
 std::vector<Position> get_stack(const PositionMap& map, int64_t idx);
+
+// Same as get_stack on each index.
+std::vector<std::vector<Position>> get_stacks(const PositionMap& map,
+                                              const std::vector<int64_t>& idxs);
+
+/*
+ * Parses a frame of a stack trace that was emitted with a line map, i.e.
+ * whitespace, "at", whitespace, then "<prefix>(:<line>)" with an optional
+ * trailing whitespace character, where the line is the index of the position
+ * plus one. Sets `prefix` to everything before the "(" and `idx` to the
+ * position index.
+ */
+bool parse_frame(boost::string_ref line, boost::string_ref* prefix,
+                 int64_t* idx);
+
+/*
+ * Appends the trace to `out` with each frame that parse_frame accepts
+ * replaced by its stack, one frame per line. Other lines are copied as is.
+ */
+void symbolicate(const PositionMap& map,
+                 boost::string_ref trace,
+                 std::string* out);
+
+/*
+ * Keeps the maps of the most recently used builds loaded, up to `capacity` of
+ * them, so that a long-running process doesn't read a map again for each
+ * trace. Maps are loaded when first asked for, from the file registered for
+ * their build id.
+ */
+class PositionMapCache {
+ public:
+  explicit PositionMapCache(size_t capacity) : m_capacity(capacity) {}
+
+  // Registers, or replaces, the file of a build. A map of the build that was
+  // already loaded is dropped.
+  void add_build(const std::string& build_id, const std::string& filename);
+
+  // The map of the build, or nullptr if the build is unknown or its file
+  // can't be read. The map stays valid until the next call.
+  const PositionMap* get(const std::string& build_id);
+
+  size_t loaded_count() const { return m_lru.size(); }
+
+ private:
+  using Entry = std::pair<std::string, std::unique_ptr<PositionMap>>;
+
+  size_t m_capacity;
+  std::unordered_map<std::string, std::string> m_filenames;
+  // Most recently used first.
+  std::list<Entry> m_lru;
+  std::unordered_map<std::string, std::list<Entry>::iterator> m_loaded;
+};
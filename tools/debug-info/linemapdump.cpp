@@ -15,10 +15,13 @@ int main(int argc, char** argv) {
     abort();
   }
   auto map = read_map(argv[1]);
+  if (map == nullptr) {
+    return 1;
+  }
   for (size_t i = 0; i < map->positions_size; ++i) {
     auto pi = map->positions[i];
-    std::cout << map->string_pool[pi.class_id] << "."
-              << map->string_pool[pi.method_id] << map->string_pool[pi.file_id]
+    std::cout << map->string_at(pi.class_id) << "."
+              << map->string_at(pi.method_id) << map->string_at(pi.file_id)
               << ":" << pi.line << " => " << pi.parent << std::endl;
   }
 }
@@ -5,31 +5,103 @@
  * LICENSE file in the root directory of this source tree.
  */
 
-#include <boost/regex.hpp>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <sstream>
 #include <string>
 
 #include "PositionMap.h"
 
-boost::regex trace_regex(R"/((\s+at\s+[^(]*)\(:(\d+)\)\s?)/");
+namespace {
+
+constexpr size_t kDefaultMaxMaps = 8;
+
+void print_usage() {
+  std::cerr << "Usage: cat trace | remap mapping_file\n"
+               "       remap --server [max_loaded_maps]\n"
+               "\n"
+               "In server mode, requests are read from stdin, one per line:\n"
+               "  map <build_id> <mapping_file>\n"
+               "    Registers the map of a build. Replies \"ok\".\n"
+               "  trace <build_id>\n"
+               "    Followed by the lines of a trace, then a line \"end\".\n"
+               "    Replies with the symbolicated trace, then \"end\".\n"
+               "Failed requests get \"error <reason>\". Only the most recently\n"
+               "used maps are kept loaded.\n";
+}
+
+// Reads the lines of a trace up to the "end" line.
+std::string read_trace(std::istream& in) {
+  std::string trace;
+  for (std::string line; std::getline(in, line) && line != "end";) {
+    trace += line;
+    trace += '\n';
+  }
+  return trace;
+}
+
+int run_server(size_t max_maps) {
+  PositionMapCache cache(max_maps);
+  std::string out;
+  for (std::string request; std::getline(std::cin, request);) {
+    std::istringstream words(request);
+    std::string command, build_id;
+    words >> command >> build_id;
+    if (command == "map") {
+      std::string filename;
+      std::getline(words >> std::ws, filename);
+      if (build_id.empty() || filename.empty()) {
+        std::cout << "error usage: map <build_id> <mapping_file>" << std::endl;
+        continue;
+      }
+      cache.add_build(build_id, filename);
+      std::cout << "ok" << std::endl;
+    } else if (command == "trace") {
+      // Consume the trace even if it can't be symbolicated, to stay in sync.
+      auto trace = read_trace(std::cin);
+      auto map = cache.get(build_id);
+      if (map == nullptr) {
+        std::cout << "error cannot load map of build " << build_id
+                  << std::endl;
+        continue;
+      }
+      out.clear();
+      symbolicate(*map, trace, &out);
+      std::cout << out << "end" << std::endl;
+    } else if (!command.empty()) {
+      std::cout << "error unknown request " << command << std::endl;
+    }
+  }
+  return 0;
+}
+
+} // namespace
 
 int main(int argc, char** argv) {
   if (argc < 2) {
-    std::cerr << "Usage: cat trace | remap mapping_file\n";
+    print_usage();
     abort();
   }
-  auto map = read_map(argv[1]);
-  for (std::string line; std::getline(std::cin, line);) {
-    boost::smatch matches;
-    if (boost::regex_match(line, matches, trace_regex)) {
-      auto idx = std::stoi(matches[2]) - 1;
-      auto stack = get_stack(*map, idx);
-      for (auto pos : stack) {
-        std::cout << matches[1] << "(" << pos.filename << ":" << pos.line
-                  << ")" << std::endl;
+  if (strcmp(argv[1], "--server") == 0) {
+    size_t max_maps = kDefaultMaxMaps;
+    if (argc > 2) {
+      max_maps = strtoul(argv[2], nullptr, 10);
+      if (max_maps == 0) {
+        print_usage();
+        return 1;
       }
-    } else {
-      std::cout << line << std::endl;
     }
+    return run_server(max_maps);
+  }
+  auto map = read_map(argv[1]);
+  if (map == nullptr) {
+    return 1;
+  }
+  std::string out;
+  for (std::string line; std::getline(std::cin, line);) {
+    out.clear();
+    symbolicate(*map, line, &out);
+    std::cout << out;
   }
 }
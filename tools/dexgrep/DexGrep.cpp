@@ -5,33 +5,428 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <fcntl.h>
 #include <getopt.h>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 #include "DexCommon.h"
 
+namespace {
+
+// What is searched: class names, method signatures or string constants.
+enum class Kind : char {
+  CLASS = 'C',
+  METHOD = 'M',
+  STRING = 'S',
+};
+
+// Class defs, method ids or strings scanned by one task.
+constexpr uint32_t kChunkSize = 4096;
+
+constexpr const char* kIndexHeader = "dexgrep-index 1\n";
+
 void print_usage() {
-  fprintf(stderr, "Usage: dexgrep <classname> <dexfile 1> <dexfile 2> ...\n");
+  fprintf(stderr,
+          "Usage: dexgrep [-l] [-m | -s] [-j jobs] [-i indexfile] <pattern> "
+          "<dexfile 1> <dexfile 2> ...\n"
+          "  -m, --methods  search method signatures, e.g. "
+          "Lcom/Foo;.bar:(I)V\n"
+          "  -s, --strings  search string constants\n"
+          "  -j, --jobs     number of threads (default: number of cores)\n"
+          "  -i, --index    look up in this index file, building it first if "
+          "it is missing or out of date; the index covers all kinds\n");
+}
+
+uint32_t item_count(ddump_data* rd, Kind kind) {
+  switch (kind) {
+  case Kind::CLASS:
+    return rd->dexh->class_defs_size;
+  case Kind::METHOD:
+    return rd->dexh->method_ids_size;
+  case Kind::STRING:
+    return rd->dexh->string_ids_size;
+  }
+  return 0;
+}
+
+// The types of the classes defined in the dex, so that method signatures are
+// only reported for the dex that defines the method, not for every dex that
+// references it.
+std::vector<bool> defined_types(ddump_data* rd) {
+  std::vector<bool> defined(rd->dexh->type_ids_size);
+  for (uint32_t i = 0; i < rd->dexh->class_defs_size; i++) {
+    defined[rd->dex_class_defs[i].typeidx] = true;
+  }
+  return defined;
+}
+
+void method_signature(ddump_data* rd, uint32_t idx, std::string* out) {
+  dex_method_id* method = rd->dex_method_ids + idx;
+  dex_proto_id* proto = rd->dex_proto_ids + method->protoidx;
+  out->assign(dex_string_by_type_idx(rd, method->classidx));
+  out->push_back('.');
+  out->append(dex_string_by_idx(rd, method->nameidx));
+  out->append(":(");
+  if (proto->param_off != 0) {
+    auto size = *(uint32_t*)(rd->dexmmap + proto->param_off);
+    auto types = (uint16_t*)(rd->dexmmap + proto->param_off + 4);
+    for (uint32_t i = 0; i < size; i++) {
+      out->append(dex_string_by_type_idx(rd, types[i]));
+    }
+  }
+  out->push_back(')');
+  out->append(dex_string_by_type_idx(rd, proto->rtypeidx));
+}
+
+/*
+ * Calls f on the name of each item of the kind in [begin, end). The pointer is
+ * only valid during the call.
+ */
+template <typename F>
+void for_each_name(ddump_data* rd,
+                   const std::vector<bool>& defined,
+                   Kind kind,
+                   uint32_t begin,
+                   uint32_t end,
+                   F f) {
+  std::string signature;
+  for (uint32_t i = begin; i < end; i++) {
+    switch (kind) {
+    case Kind::CLASS:
+      f(dex_string_by_type_idx(rd, rd->dex_class_defs[i].typeidx));
+      break;
+    case Kind::METHOD:
+      if (defined[rd->dex_method_ids[i].classidx]) {
+        method_signature(rd, i, &signature);
+        f(signature.c_str());
+      }
+      break;
+    case Kind::STRING:
+      f(dex_string_by_idx(rd, i));
+      break;
+    }
+  }
 }
 
+// Runs f(0) ... f(count - 1) on `jobs` threads.
+template <typename F>
+void run_tasks(size_t count, unsigned jobs, F f) {
+  std::atomic<size_t> next{0};
+  auto work = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      f(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < std::min<size_t>(jobs, count); i++) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+struct Task {
+  size_t dex;
+  uint32_t begin;
+  uint32_t end;
+};
+
+// Splits the items of each dex into chunks, so that a single large dex also
+// gets scanned by several threads.
+std::vector<Task> make_tasks(std::vector<ddump_data>& dexes, Kind kind) {
+  std::vector<Task> tasks;
+  for (size_t i = 0; i < dexes.size(); i++) {
+    auto count = item_count(&dexes[i], kind);
+    for (uint32_t begin = 0; begin < count; begin += kChunkSize) {
+      tasks.push_back({i, begin, std::min(count, begin + kChunkSize)});
+    }
+  }
+  return tasks;
+}
+
+/*
+ * Index file: the header, a "dex <size> <mtime> <path>" line for each dex,
+ * then a "<kind> <dex number> <name>" line for each class, defined method and
+ * string. Newlines and backslashes in names are escaped, so that there is one
+ * name per line.
+ */
+
+void append_escaped(const char* name, std::string* out) {
+  for (const char* p = name; *p; p++) {
+    if (*p == '\n') {
+      out->append("\\n");
+    } else if (*p == '\\') {
+      out->append("\\\\");
+    } else {
+      out->push_back(*p);
+    }
+  }
+}
+
+std::string unescape(const char* begin, const char* end) {
+  std::string name;
+  for (const char* p = begin; p < end; p++) {
+    if (*p == '\\' && p + 1 < end) {
+      p++;
+      name.push_back(*p == 'n' ? '\n' : *p);
+    } else {
+      name.push_back(*p);
+    }
+  }
+  return name;
+}
+
+std::string dex_line(const char* path) {
+  struct stat st;
+  if (stat(path, &st)) {
+    fprintf(stderr, "Cannot stat file %s, bailing\n", path);
+    exit(1);
+  }
+  return "dex " + std::to_string(st.st_size) + " " +
+         std::to_string(st.st_mtime) + " " + path + "\n";
+}
+
+void build_index(const char* index_file,
+                 const std::vector<const char*>& dexfiles,
+                 unsigned jobs) {
+  std::vector<ddump_data> dexes(dexfiles.size());
+  for (size_t i = 0; i < dexfiles.size(); i++) {
+    open_dex_file(dexfiles[i], &dexes[i]);
+  }
+  std::vector<std::string> lines(dexes.size());
+  run_tasks(dexes.size(), jobs, [&](size_t i) {
+    auto defined = defined_types(&dexes[i]);
+    auto prefix = " " + std::to_string(i) + " ";
+    for (auto kind : {Kind::CLASS, Kind::METHOD, Kind::STRING}) {
+      for_each_name(&dexes[i], defined, kind, 0, item_count(&dexes[i], kind),
+                    [&](const char* name) {
+                      lines[i].push_back((char)kind);
+                      lines[i].append(prefix);
+                      append_escaped(name, &lines[i]);
+                      lines[i].push_back('\n');
+                    });
+    }
+  });
+
+  // Written to the side and renamed, so that a concurrent query never sees a
+  // partial index.
+  auto tmp = std::string(index_file) + ".tmp";
+  FILE* out = fopen(tmp.c_str(), "w");
+  if (out == nullptr) {
+    fprintf(stderr, "Cannot create index file %s, bailing\n", tmp.c_str());
+    exit(1);
+  }
+  bool ok = fputs(kIndexHeader, out) >= 0;
+  for (auto dexfile : dexfiles) {
+    ok = ok && fputs(dex_line(dexfile).c_str(), out) >= 0;
+  }
+  for (const auto& dex_lines : lines) {
+    ok = ok &&
+         fwrite(dex_lines.data(), 1, dex_lines.size(), out) == dex_lines.size();
+  }
+  ok = fclose(out) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), index_file)) {
+    fprintf(stderr, "Cannot write index file %s, bailing\n", index_file);
+    exit(1);
+  }
+}
+
+struct IndexFile {
+  const char* data{nullptr};
+  size_t size{0};
+
+  ~IndexFile() {
+    if (data != nullptr) {
+      munmap(const_cast<char*>(data), size);
+    }
+  }
+};
+
+// Maps the index, and returns the offset of its first name line, or 0 if it
+// doesn't exist or wasn't built from exactly these dex files as they are now.
+size_t open_index(const char* index_file,
+                  const std::vector<const char*>& dexfiles,
+                  IndexFile* index) {
+  int fd = open(index_file, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size == 0) {
+    close(fd);
+    return 0;
+  }
+  void* mapping =
+      mmap(nullptr, st.st_size, PROT_READ, MAP_FILE | MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return 0;
+  }
+  index->data = static_cast<const char*>(mapping);
+  index->size = st.st_size;
+
+  std::string expected = kIndexHeader;
+  for (auto dexfile : dexfiles) {
+    expected += dex_line(dexfile);
+  }
+  if (index->size <= expected.size() ||
+      memcmp(index->data, expected.data(), expected.size()) ||
+      strncmp(index->data + expected.size(), "dex ", 4) == 0) {
+    return 0;
+  }
+  return expected.size();
+}
+
+struct Match {
+  size_t dex;
+  std::string name;
+};
+
+// Finds the lines of the kind whose name contains the pattern, sharing the
+// lines out between threads.
+std::vector<Match> search_index(const IndexFile& index,
+                                size_t start,
+                                Kind kind,
+                                const char* search_str,
+                                unsigned jobs) {
+  std::string needle;
+  append_escaped(search_str, &needle);
+  // Byte ranges of whole lines.
+  std::vector<std::pair<size_t, size_t>> tasks;
+  constexpr size_t kBytesPerTask = 1 << 20;
+  for (size_t begin = start; begin < index.size;) {
+    size_t end = std::min(index.size, begin + kBytesPerTask);
+    auto eol = (const char*)memchr(
+        index.data + end - 1, '\n', index.size - end + 1);
+    end = eol == nullptr ? index.size : eol - index.data + 1;
+    tasks.emplace_back(begin, end);
+    begin = end;
+  }
+  std::vector<std::vector<Match>> matches(tasks.size());
+  run_tasks(tasks.size(), jobs, [&](size_t t) {
+    const char* p = index.data + tasks[t].first;
+    const char* end = index.data + tasks[t].second;
+    while (p < end) {
+      auto eol = (const char*)memchr(p, '\n', end - p);
+      if (eol == nullptr) {
+        eol = end;
+      }
+      if (*p == (char)kind) {
+        char* name;
+        size_t dex = strtoul(p + 2, &name, 10);
+        name++;
+        if (name < eol &&
+            memmem(name, eol - name, needle.data(), needle.size()) != nullptr) {
+          // The escaped needle can straddle an escape, so check the name too.
+          auto unescaped = unescape(name, eol);
+          if (strstr(unescaped.c_str(), search_str) != nullptr) {
+            matches[t].push_back({dex, std::move(unescaped)});
+          }
+        }
+      }
+      p = eol + 1;
+    }
+  });
+  std::vector<Match> all;
+  for (auto& task_matches : matches) {
+    for (auto& match : task_matches) {
+      all.push_back(std::move(match));
+    }
+  }
+  // The index lists each dex's names in the order the scan finds them.
+  std::stable_sort(all.begin(), all.end(), [](const Match& a, const Match& b) {
+    return a.dex < b.dex;
+  });
+  return all;
+}
+
+std::vector<Match> search_dexes(const std::vector<const char*>& dexfiles,
+                                Kind kind,
+                                const char* search_str,
+                                unsigned jobs) {
+  std::vector<ddump_data> dexes(dexfiles.size());
+  for (size_t i = 0; i < dexfiles.size(); i++) {
+    open_dex_file(dexfiles[i], &dexes[i]);
+  }
+  std::vector<std::vector<bool>> defined(dexes.size());
+  if (kind == Kind::METHOD) {
+    for (size_t i = 0; i < dexes.size(); i++) {
+      defined[i] = defined_types(&dexes[i]);
+    }
+  }
+  auto tasks = make_tasks(dexes, kind);
+  std::vector<std::vector<Match>> matches(tasks.size());
+  run_tasks(tasks.size(), jobs, [&](size_t t) {
+    const auto& task = tasks[t];
+    for_each_name(&dexes[task.dex], defined[task.dex], kind, task.begin,
+                  task.end, [&](const char* name) {
+                    if (strstr(name, search_str) != nullptr) {
+                      matches[t].push_back({task.dex, name});
+                    }
+                  });
+  });
+  // Tasks are in dex then item order, so this is the order of a serial scan.
+  std::vector<Match> all;
+  for (auto& task_matches : matches) {
+    for (auto& match : task_matches) {
+      all.push_back(std::move(match));
+    }
+  }
+  return all;
+}
+
+} // namespace
+
 int main(int argc, char* argv[]) {
   bool files_only = false;
-  char c;
+  Kind kind = Kind::CLASS;
+  const char* index_file = nullptr;
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  int c;
   static const struct option options[] = {
     { "files-without-match", no_argument, nullptr, 'l' },
+    { "methods", no_argument, nullptr, 'm' },
+    { "strings", no_argument, nullptr, 's' },
+    { "jobs", required_argument, nullptr, 'j' },
+    { "index", required_argument, nullptr, 'i' },
+    { "help", no_argument, nullptr, 'h' },
+    { nullptr, 0, nullptr, 0 },
   };
   while ((c = getopt_long(
             argc,
             argv,
-            "hl",
+            "hlmsj:i:",
             &options[0],
             nullptr)) != -1) {
     switch (c) {
       case 'l':
         files_only = true;
         break;
+      case 'm':
+        kind = Kind::METHOD;
+        break;
+      case 's':
+        kind = Kind::STRING;
+        break;
+      case 'j':
+        jobs = std::max(1, atoi(optarg));
+        break;
+      case 'i':
+        index_file = optarg;
+        break;
       case 'h':
         print_usage();
         return 0;
@@ -41,30 +436,42 @@ int main(int argc, char* argv[]) {
     }
   }
 
-  if (optind == argc) {
+  if (optind + 1 >= argc) {
     fprintf(stderr, "%s: no dex files given\n", argv[0]);
     print_usage();
     return 1;
   }
 
   const char* search_str = argv[optind];
+  std::vector<const char*> dexfiles(argv + optind + 1, argv + argc);
 
-  for (int i = optind + 1; i < argc; ++i) {
-    const char* dexfile = argv[i];
-    ddump_data rd;
-    open_dex_file(dexfile, &rd);
-
-    auto size = rd.dexh->class_defs_size;
-    for (uint32_t j = 0; j < size; j++) {
-      dex_class_def* cls_def = rd.dex_class_defs + j;
-      char* name = dex_string_by_type_idx(&rd, cls_def->typeidx);
-      if (strstr(name, search_str) != nullptr) {
-        if (files_only) {
-          printf("%s\n", dexfile);
-        } else {
-          printf("%s: %s\n", dexfile, name);
-        }
+  std::vector<Match> matches;
+  if (index_file != nullptr) {
+    std::unique_ptr<IndexFile> index(new IndexFile());
+    size_t start = open_index(index_file, dexfiles, index.get());
+    if (start == 0) {
+      build_index(index_file, dexfiles, jobs);
+      index.reset(new IndexFile());
+      start = open_index(index_file, dexfiles, index.get());
+      if (start == 0) {
+        fprintf(stderr, "Cannot read index file %s, bailing\n", index_file);
+        return 1;
+      }
+    }
+    matches = search_index(*index, start, kind, search_str, jobs);
+  } else {
+    matches = search_dexes(dexfiles, kind, search_str, jobs);
+  }
+
+  size_t last_dex = dexfiles.size();
+  for (const auto& match : matches) {
+    if (files_only) {
+      if (match.dex != last_dex) {
+        printf("%s\n", dexfiles[match.dex]);
       }
+    } else {
+      printf("%s: %s\n", dexfiles[match.dex], match.name.c_str());
     }
+    last_dex = match.dex;
   }
 }
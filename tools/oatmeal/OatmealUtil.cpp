@@ -6,9 +6,16 @@
  */
 
 #include "OatmealUtil.h"
+#include "mmap.h"
+#include <algorithm>
 #include <cerrno>
+#include <climits>
 #include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 void write_buf(FileHandle& fh, ConstBuffer buf) {
   CHECK(fh.fwrite(buf.ptr, sizeof(char), buf.len) == buf.len);
@@ -26,6 +33,39 @@ size_t get_filesize(FileHandle& fh) {
   return dex_stat.st_size;
 }
 
+std::unique_ptr<MappedFile> map_file(const std::string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr,
+            "failed to open file %s %s\n",
+            filename.c_str(),
+            std::strerror(errno));
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    fprintf(stderr,
+            "failed to stat file %s %s\n",
+            filename.c_str(),
+            std::strerror(errno));
+    close(fd);
+    return nullptr;
+  }
+  std::string error_msg;
+  std::unique_ptr<MappedFile> map(MappedFile::mmap_file(
+      st.st_size, PROT_READ, MAP_PRIVATE, fd, filename.c_str(), &error_msg));
+  close(fd);
+  return map;
+}
+
+ConstBuffer mapped_buffer(const MappedFile& file) {
+  // Empty files aren't mapped at all.
+  if (file.size() == 0) {
+    return ConstBuffer{"", 0};
+  }
+  return ConstBuffer{reinterpret_cast<const char*>(file.begin()), file.size()};
+}
+
 void stream_file(FileHandle& in, FileHandle& out) {
   constexpr int kBufSize = 0x80000;
   std::unique_ptr<char[]> buf(new char[kBufSize]);
@@ -47,6 +87,46 @@ void write_padding(FileHandle& fh, char byte, size_t num) {
   }
 }
 
+void write_bufs(FileHandle& fh, const std::vector<ConstBuffer>& bufs) {
+  std::vector<iovec> iovs;
+  iovs.reserve(bufs.size());
+  size_t total = 0;
+  for (const auto& buf : bufs) {
+    if (buf.len > 0) {
+      iovs.push_back(iovec{const_cast<char*>(buf.ptr), buf.len});
+      total += buf.len;
+    }
+  }
+
+  // Write what the stream has buffered first, and move the descriptor to the
+  // position of the stream.
+  CHECK(fflush(fh.get()) == 0);
+  const auto fd = fileno(fh.get());
+  const auto pos = ftell(fh.get());
+  CHECK(pos >= 0 && lseek(fd, pos, SEEK_SET) == pos);
+
+  size_t first = 0;
+  while (first < iovs.size()) {
+    const int count = std::min<size_t>(iovs.size() - first, IOV_MAX);
+    auto written = writev(fd, &iovs[first], count);
+    CHECK(written >= 0, "writev failed: %s", std::strerror(errno));
+    // Skip what was written. Short writes can stop in the middle of a buffer.
+    size_t remaining = written;
+    while (remaining > 0 && remaining >= iovs[first].iov_len) {
+      remaining -= iovs[first].iov_len;
+      first++;
+    }
+    if (remaining > 0) {
+      auto base = static_cast<char*>(iovs[first].iov_base);
+      iovs[first].iov_base = base + remaining;
+      iovs[first].iov_len -= remaining;
+    }
+  }
+
+  // Bring the stream to where the write ended.
+  CHECK(fseek(fh.get(), pos + total, SEEK_SET) == 0);
+}
+
 std::string read_string(const uint8_t* dstr) {
   // int utfsize = read_uleb128(&dstr);
   read_uleb128(&dstr);
@@ -11,9 +11,12 @@
 #include "DexOpcodeDefs.h"
 #include "file-utils.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -22,6 +25,8 @@
 
 #define PACK __attribute__((packed))
 
+class MappedFile;
+
 #ifdef PERF_LOG
 #include <chrono>
 
@@ -168,6 +173,11 @@ struct WritableBuffer {
 
 void write_padding(FileHandle& fh, char byte, size_t num);
 
+// Writes the buffers back to back at the current position, with as few
+// writev calls as possible. The write goes around the stream, so unlike
+// write_buf it isn't counted by bytes_written().
+void write_bufs(FileHandle& fh, const std::vector<ConstBuffer>& bufs);
+
 template <typename T>
 void write_obj(FileHandle& fh, const T& obj) {
   write_buf(fh, ConstBuffer{reinterpret_cast<const char*>(&obj), sizeof(T)});
@@ -185,8 +195,44 @@ void stream_file(FileHandle& in, FileHandle& out);
 
 bool is_vdex_file(ConstBuffer buf);
 
+// Calls fn(i) for each i in [0, count), spread over up to one thread per core.
+// The calls must not depend on each other.
+template <typename Fn>
+void parallel_for_index(size_t count, const Fn& fn) {
+  const size_t num_threads = std::min<size_t>(
+      count, std::max(1u, std::thread::hardware_concurrency()));
+  if (num_threads <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      fn(i);
+    }
+    return;
+  }
+  std::atomic<size_t> next{0};
+  auto work = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      fn(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; i++) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
 size_t get_filesize(FileHandle& fh);
 
+// Maps a whole file read-only. Pages are only read in as they are touched, so
+// parsing just the parts of a large file that are asked for doesn't need to
+// hold all of it in memory. Prints an error and returns null if the file can't
+// be opened or mapped.
+std::unique_ptr<MappedFile> map_file(const std::string& filename);
+
+ConstBuffer mapped_buffer(const MappedFile& file);
+
 std::string read_string(const uint8_t* dstr);
 
 inline uint32_t read_uleb128(char** _ptr) {
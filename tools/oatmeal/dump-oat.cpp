@@ -39,6 +39,7 @@
 #include "dex.h"
 #include "elf-writer.h"
 #include "memory-accounter.h"
+#include "mmap.h"
 #include "vdex.h"
 
 #include <algorithm>
@@ -46,6 +47,7 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <map>
 #include <memory>
 #include <string>
 #include <sys/stat.h>
@@ -679,6 +681,25 @@ class OatClasses {
     uint16_t type = 0;
   };
 
+  // Prints how many classes of a dex have each status and each type.
+  static void print_summary(const std::string& dex_file,
+                            const std::vector<ClassInfo>& class_info) {
+    std::map<int, uint32_t> statuses;
+    std::map<int, uint32_t> types;
+    for (const auto& info : class_info) {
+      statuses[info.status]++;
+      types[info.type]++;
+    }
+    printf("  { Classes for dex %s: %zu\n", dex_file.c_str(), class_info.size());
+    for (const auto& e : statuses) {
+      printf("    %s: %u\n", statusStr(e.first), e.second);
+    }
+    for (const auto& e : types) {
+      printf("    %s: %u\n", typeStr(static_cast<Type>(e.first)), e.second);
+    }
+    printf("  }\n");
+  }
+
  protected:
   OatClasses() = default;
 };
@@ -1144,6 +1165,12 @@ class DexFileListing_064 : public DexFileListing {
     }
   }
 
+  void print_class_summary() {
+    for (const auto& e : dex_files_) {
+      OatClasses::print_summary(e.location, e.class_info);
+    }
+  }
+
   void print_unverified_classes() {
     printf("unverified classes:\n");
     for (const auto& e : dex_files_) {
@@ -1254,7 +1281,7 @@ class DexFiles {
     }
   }
 
-  void print() {
+  void print(bool with_code = true) {
     for (const auto& e : headers_) {
       printf("DexFile: { \
       file_size: 0x%08x(%u), \
@@ -1264,6 +1291,9 @@ class DexFiles {
       e.class_defs_size,
       e.class_defs_size);
     }
+    if (!with_code) {
+      return;
+    }
     size_t index = 0;
     for (const auto& e : dexes_) {
       print_dex_opcodes(reinterpret_cast<const uint8_t*>(e.ptr), headers_[index].file_size);
@@ -1296,6 +1326,8 @@ class OatClasses_079 : public OatClasses {
 
   void print();
 
+  void print_summary();
+
   void print_unverified_classes();
 
   template<typename DexFileType>
@@ -1366,9 +1398,7 @@ class OatClasses_064 : public OatClasses {
         continue;
       }
       CHECK(file.class_offsets[0] == cksum_fh.bytes_written());
-      for (const auto& info : file.class_info) {
-        write_obj(cksum_fh, info);
-      }
+      write_vec(cksum_fh, file.class_info);
     }
   }
 };
@@ -1436,6 +1466,12 @@ void OatClasses_079::print() {
   }
 }
 
+void OatClasses_079::print_summary() {
+  for (const auto& e : classes_) {
+    OatClasses::print_summary(e.dex_file, e.class_info);
+  }
+}
+
 void OatClasses_079::print_unverified_classes() {
   printf("unverified classes:\n");
   for (const auto& e : classes_) {
@@ -1461,52 +1497,48 @@ void OatClasses_079::write(
   printf("WRITING OatClasses:\n");
   #endif
 
-  size_t dex_count = 0;
-  for (const auto& dex_file : dex_files) {
-    CHECK(dex_file.classes_offset == cksum_fh.bytes_written());
-
+  // The table of each dex is an array of pointers (offsets) to ClassInfo
+  // structs, followed by the structs. They are laid out in their own buffers,
+  // and then written in order.
+  std::vector<std::vector<uint32_t>> tables(dex_files.size());
+  parallel_for_index(dex_files.size(), [&](size_t dex_idx) {
+    const auto& dex_file = dex_files[dex_idx];
     const auto num_classes = dex_file.num_classes;
-    uint32_t table_offset =
+    const uint32_t table_offset =
         dex_file.classes_offset + num_classes * sizeof(uint32_t);
 
+    static_assert(sizeof(OatClasses::ClassInfo) == sizeof(uint32_t),
+                  "ClassInfo must fit a table word");
+    OatClasses::ClassInfo info(OatClasses::Status::kStatusVerified,
+                               OatClasses::Type::kOatClassNoneCompiled);
+    uint32_t info_word;
+    memcpy(&info_word, &info, sizeof(info_word));
+
+    auto& table = tables[dex_idx];
+    table.reserve(2 * num_classes);
+    for (size_t i = 0; i < num_classes; i++) {
+      table.push_back(table_offset + i * sizeof(uint32_t));
+    }
+    table.insert(table.end(), num_classes, info_word);
+  });
+
+  for (size_t dex_idx = 0; dex_idx < dex_files.size(); dex_idx++) {
+    const auto& dex_file = dex_files[dex_idx];
+    CHECK(dex_file.classes_offset == cksum_fh.bytes_written());
+
     #ifdef DEBUG_LOG
     printf("WRITING OatClasses for dex[%zu]: \
       #classes: %u :: \
-      #offset: %u (-> %u)\n",
-      dex_count,
-      num_classes,
+      #offset: %u (-> %zu)\n",
+      dex_idx,
+      dex_file.num_classes,
       dex_file.classes_offset,
-      table_offset);
+      dex_file.classes_offset + dex_file.num_classes * sizeof(uint32_t));
     #endif
 
-    // write pointers to ClassInfo.
-    for (size_t i = 0; i < num_classes; i++) {
-      write_word(cksum_fh, table_offset + i * sizeof(uint32_t));
-
-      #ifdef DEBUG_LOG
-      printf("#ClassOffsets[%zu] -> %zu\n",
-        i,
-        table_offset + i * sizeof(uint32_t));
-      #endif
-    }
-    CHECK(table_offset == cksum_fh.bytes_written());
-
-    // Write ClassInfo structs.
-    OatClasses::ClassInfo info(OatClasses::Status::kStatusVerified,
-                               OatClasses::Type::kOatClassNoneCompiled);
-    for (size_t i = 0; i < num_classes; i++) {
-      write_obj(cksum_fh, info);
-
-      #ifdef DEBUG_LOG
-      printf("#OatClass[%zu]:%u ::  type: %u\n",
-        i,
-        table_offset,
-        info.type);
-      #endif
-      table_offset += sizeof(OatClasses::ClassInfo);
-    }
-    CHECK(table_offset == cksum_fh.bytes_written());
-    dex_count++;
+    write_vec(cksum_fh, tables[dex_idx]);
+    CHECK(dex_file.classes_offset + tables[dex_idx].size() * sizeof(uint32_t) ==
+          cksum_fh.bytes_written());
   }
 }
 
@@ -1561,20 +1593,25 @@ class SamsungLookupTables {
       const std::vector<DexInput>& dex_input_vec,
       const std::vector<DexFileListing_064::DexFile_064>& dex_files,
       FileHandle& cksum_fh) {
-    foreach_pair(
-        dex_input_vec,
-        dex_files,
-        [&](const DexInput& dex_input,
-            const DexFileListing_064::DexFile_064& dex_file) {
-          CHECK(dex_file.lookup_table_offset == cksum_fh.bytes_written());
+    CHECK(dex_input_vec.size() == dex_files.size());
 
-          auto table = build_lookup_table(dex_input.filename);
+    // Build the tables of all the dexes first, and then write them in order.
+    std::vector<LookupTable> tables;
+    tables.reserve(dex_files.size());
+    for (size_t i = 0; i < dex_files.size(); i++) {
+      tables.push_back(LookupTable{nullptr, 0});
+    }
+    parallel_for_index(dex_files.size(), [&](size_t i) {
+      tables[i] = build_lookup_table(dex_input_vec[i].filename);
+    });
 
-          auto buf =
-              ConstBuffer{reinterpret_cast<const char*>(table.data.get()),
-                          table.byte_size()};
-          write_buf(cksum_fh, buf);
-        });
+    for (size_t i = 0; i < dex_files.size(); i++) {
+      CHECK(dex_files[i].lookup_table_offset == cksum_fh.bytes_written());
+      const auto& table = tables[i];
+      auto buf = ConstBuffer{reinterpret_cast<const char*>(table.data.get()),
+                             table.byte_size()};
+      write_buf(cksum_fh, buf);
+    }
   }
 
  private:
@@ -1782,25 +1819,25 @@ class LookupTables {
       const std::vector<DexInput>& dex_input_vec,
       const std::vector<DexFileType>& dex_files,
       FileHandle& cksum_fh) {
-    foreach_pair(
-        dex_input_vec,
-        dex_files,
-        [&](const DexInput& dex_input,
-            const DexFileListing_079::DexFile_079& dex_file) {
-          CHECK(dex_file.lookup_table_offset == cksum_fh.bytes_written());
-          const auto num_classes = dex_file.num_classes;
-
-          const auto lookup_table_size = numEntries(num_classes);
-          const auto lookup_table_byte_size =
-              lookup_table_size * sizeof(LookupTableEntry);
-
-          auto lookup_table_buf =
-              build_lookup_table(dex_input.filename, lookup_table_size);
-          auto buf =
-              ConstBuffer{reinterpret_cast<const char*>(lookup_table_buf.get()),
-                          lookup_table_byte_size};
-          write_buf(cksum_fh, buf);
-        });
+    CHECK(dex_input_vec.size() == dex_files.size());
+
+    // The tables of each dex don't depend on each other, so they are all
+    // built up front, and then written in order.
+    std::vector<std::unique_ptr<LookupTableEntry[]>> tables(dex_files.size());
+    parallel_for_index(dex_files.size(), [&](size_t i) {
+      tables[i] = build_lookup_table(dex_input_vec[i].filename,
+                                     numEntries(dex_files[i].num_classes));
+    });
+
+    for (size_t i = 0; i < dex_files.size(); i++) {
+      const auto& dex_file = dex_files[i];
+      CHECK(dex_file.lookup_table_offset == cksum_fh.bytes_written());
+      const auto lookup_table_byte_size =
+          numEntries(dex_file.num_classes) * sizeof(LookupTableEntry);
+      auto buf = ConstBuffer{reinterpret_cast<const char*>(tables[i].get()),
+                             lookup_table_byte_size};
+      write_buf(cksum_fh, buf);
+    }
   }
 
  private:
@@ -1984,13 +2021,15 @@ class OatFile_064 : public OatFile {
 
   static std::unique_ptr<OatFile> parse(bool dex_files_only,
                                         ConstBuffer buf,
-                                        size_t oat_offset) {
+                                        size_t oat_offset,
+                                        uint32_t sections) {
     auto header = OatHeader::parse(buf);
     auto key_value_store = KeyValueStore(
         buf.slice(header.size()).truncate(header.key_value_store_size));
 
     auto rest = buf.slice(header.size() + header.key_value_store_size);
-    DexFileListing_064 dfl(dex_files_only,
+    // The class info of these versions is part of the dex file listing.
+    DexFileListing_064 dfl(dex_files_only || !(sections & kOatSectionClasses),
                            static_cast<OatVersion>(header.common.version),
                            header.dex_file_count,
                            rest,
@@ -2007,7 +2046,8 @@ class OatFile_064 : public OatFile {
 
   void print(bool dump_classes,
              bool dump_tables,
-             bool print_unverified_classes) override {
+             bool print_unverified_classes,
+             bool summarize) override {
     printf("Header:\n");
     header_.print();
     printf("Key/Value store:\n");
@@ -2015,10 +2055,14 @@ class OatFile_064 : public OatFile {
     printf("Dex File Listing:\n");
     dex_file_listing_.print();
     printf("Dex Files:\n");
-    dex_files_.print();
+    dex_files_.print(!summarize);
     if (dump_classes) {
       printf("Classes:\n");
-      dex_file_listing_.print_classes();
+      if (summarize) {
+        dex_file_listing_.print_class_summary();
+      } else {
+        dex_file_listing_.print_classes();
+      }
     }
     if (print_unverified_classes) {
       dex_file_listing_.print_unverified_classes();
@@ -2100,7 +2144,8 @@ class OatFile_079 : public OatFile {
 
   static std::unique_ptr<OatFile> parse(bool dex_files_only,
                                         ConstBuffer buf,
-                                        size_t oat_offset) {
+                                        size_t oat_offset,
+                                        uint32_t sections) {
     auto header = OatHeader::parse(buf);
     auto key_value_store = KeyValueStore(
         buf.slice(header.size()).truncate(header.key_value_store_size));
@@ -2118,9 +2163,15 @@ class OatFile_079 : public OatFile {
                                                       oat_offset));
     }
 
-    LookupTables lookup_tables(dfl, dex_files, buf);
+    LookupTables lookup_tables;
+    if (sections & kOatSectionLookupTables) {
+      lookup_tables = LookupTables(dfl, dex_files, buf);
+    }
 
-    OatClasses_079 oat_classes(dfl, dex_files, buf);
+    OatClasses_079 oat_classes;
+    if (sections & kOatSectionClasses) {
+      oat_classes = OatClasses_079(dfl, dex_files, buf);
+    }
 
     return std::unique_ptr<OatFile>(new OatFile_079(header,
                                                     key_value_store,
@@ -2133,7 +2184,8 @@ class OatFile_079 : public OatFile {
 
   void print(bool dump_classes,
              bool dump_tables,
-             bool print_unverified_classes) override {
+             bool print_unverified_classes,
+             bool summarize) override {
     printf("Header:\n");
     header_.print();
     printf("Key/Value store:\n");
@@ -2141,7 +2193,7 @@ class OatFile_079 : public OatFile {
     printf("Dex File Listing:\n");
     dex_file_listing_.print();
     printf("Dex Files:\n");
-    dex_files_.print();
+    dex_files_.print(!summarize);
 
     if (dump_tables) {
       printf("LookupTables:\n");
@@ -2149,7 +2201,11 @@ class OatFile_079 : public OatFile {
     }
     if (dump_classes) {
       printf("Classes:\n");
-      oat_classes_.print();
+      if (summarize) {
+        oat_classes_.print_summary();
+      } else {
+        oat_classes_.print();
+      }
     }
     if (print_unverified_classes) {
       oat_classes_.print_unverified_classes();
@@ -2249,7 +2305,8 @@ class OatFile_124 : public OatFile {
   static std::unique_ptr<OatFile> oatfile_124_131_parse(bool dex_files_only,
                                         ConstBuffer buf,
                                         size_t oat_offset,
-                                        const std::vector<DexInput>& dexes) {
+                                        const std::vector<DexInput>& dexes,
+                                        uint32_t sections) {
     if (dexes.size() != 1) {
       fprintf(stderr,
               "V124/V131 odex files must come accompained with one and only "
@@ -2264,66 +2321,60 @@ class OatFile_124 : public OatFile {
     auto rest = buf.slice(header.size() + header.key_value_store_size);
     DexFileListingType dfl(header.dex_file_count, rest);
 
-    auto dex_file_name = dexes[0].filename;
-    auto dex_file = FileHandle(fopen(dex_file_name.c_str(), "r"));
-    if (dex_file.get() == nullptr) {
-      fprintf(stderr,
-              "failed to open dex file %s %s\n",
-              dex_file_name.c_str(),
-              std::strerror(errno));
-      return nullptr;
-    }
-
-    auto dex_file_size = get_filesize(dex_file);
-
-    // We don't run dumping during install on device, so it is allowed to
-    // consume lots of memory.
-    auto dex_file_contents = std::make_unique<char[]>(dex_file_size);
-    auto dexFileBytesRead =
-        fread(dex_file_contents.get(), 1, dex_file_size, dex_file.get());
-    if (dexFileBytesRead != dex_file_size) {
-      fprintf(stderr,
-              "Failed to read dex file %s (%zd)\n",
-              std::strerror(errno),
-              dexFileBytesRead);
+    // The dex files are read in place from a mapping of the vdex file, which
+    // the oat file keeps alive for as long as they are used.
+    auto dex_file_mapping = map_file(dexes[0].filename);
+    if (dex_file_mapping == nullptr) {
       return nullptr;
     }
 
-    ConstBuffer dex_file_buf{dex_file_contents.get(), dex_file_size};
+    ConstBuffer dex_file_buf = mapped_buffer(*dex_file_mapping);
     cur_ma()->addBuffer(dex_file_buf);
     DexFiles dex_files(dfl, dex_file_buf);
 
     if (dex_files_only) {
-      return std::unique_ptr<OatFile>(new OatFileType(header,
-                                                      key_value_store,
-                                                      std::move(dfl),
-                                                      std::move(dex_files),
-                                                      oat_offset));
+      auto oat_file = new OatFileType(header,
+                                      key_value_store,
+                                      std::move(dfl),
+                                      std::move(dex_files),
+                                      oat_offset);
+      oat_file->dex_file_mapping_ = std::move(dex_file_mapping);
+      return std::unique_ptr<OatFile>(oat_file);
     }
 
-    LookupTables lookup_tables(dfl, dex_files, buf);
-    OatClasses_124 oat_classes(dfl, dex_files, buf, dex_file_buf);
+    LookupTables lookup_tables;
+    if (sections & kOatSectionLookupTables) {
+      lookup_tables = LookupTables(dfl, dex_files, buf);
+    }
+    OatClasses_124 oat_classes;
+    if (sections & kOatSectionClasses) {
+      oat_classes = OatClasses_124(dfl, dex_files, buf, dex_file_buf);
+    }
 
-    return std::unique_ptr<OatFile>(new OatFileType(header,
-                                                    key_value_store,
-                                                    std::move(dfl),
-                                                    std::move(dex_files),
-                                                    std::move(lookup_tables),
-                                                    std::move(oat_classes),
-                                                    oat_offset));
+    auto oat_file = new OatFileType(header,
+                                    key_value_store,
+                                    std::move(dfl),
+                                    std::move(dex_files),
+                                    std::move(lookup_tables),
+                                    std::move(oat_classes),
+                                    oat_offset);
+    oat_file->dex_file_mapping_ = std::move(dex_file_mapping);
+    return std::unique_ptr<OatFile>(oat_file);
   }
 
   static std::unique_ptr<OatFile> parse(bool dex_files_only,
                                         ConstBuffer buf,
                                         size_t oat_offset,
-                                        const std::vector<DexInput>& dexes) {
+                                        const std::vector<DexInput>& dexes,
+                                        uint32_t sections) {
 
-    return oatfile_124_131_parse<DexFileListing_124, OatFile_124>(dex_files_only, buf, oat_offset, dexes);
+    return oatfile_124_131_parse<DexFileListing_124, OatFile_124>(dex_files_only, buf, oat_offset, dexes, sections);
   }
 
   void print(bool dump_classes,
              bool dump_tables,
-             bool print_unverified_classes) override {
+             bool print_unverified_classes,
+             bool summarize) override {
     printf("Header:\n");
     header_.print();
     printf("Key/Value store:\n");
@@ -2331,7 +2382,7 @@ class OatFile_124 : public OatFile {
     printf("Dex File Listing:\n");
     dex_file_listing_->print();
     printf("Dex Files:\n");
-    dex_files_.print();
+    dex_files_.print(!summarize);
 
     if (dump_tables) {
       printf("LookupTables:\n");
@@ -2339,7 +2390,11 @@ class OatFile_124 : public OatFile {
     }
     if (dump_classes) {
       printf("Classes:\n");
-      oat_classes_.print();
+      if (summarize) {
+        oat_classes_.print_summary();
+      } else {
+        oat_classes_.print();
+      }
     }
     if (print_unverified_classes) {
       oat_classes_.print_unverified_classes();
@@ -2446,6 +2501,8 @@ protected:
   LookupTables lookup_tables_;
   OatClasses_124 oat_classes_;
   size_t oat_offset_;
+  // Backs the buffers of dex_files_ and oat_classes_.
+  std::unique_ptr<MappedFile> dex_file_mapping_;
 
 private:
     std::unique_ptr<DexFileListing_124> dex_file_listing_;
@@ -2459,7 +2516,8 @@ class OatFile_131 : public OatFile_124 {
 
   void print(bool dump_classes,
              bool dump_tables,
-             bool print_unverified_classes) override {
+             bool print_unverified_classes,
+             bool summarize) override {
     printf("Header:\n");
     header_.print();
     printf("Key/Value store:\n");
@@ -2467,7 +2525,7 @@ class OatFile_131 : public OatFile_124 {
     printf("Dex File Listing:\n");
     dex_file_listing_.print();
     printf("Dex Files:\n");
-    dex_files_.print();
+    dex_files_.print(!summarize);
 
     if (dump_tables) {
       printf("LookupTables:\n");
@@ -2475,7 +2533,11 @@ class OatFile_131 : public OatFile_124 {
     }
     if (dump_classes) {
       printf("Classes:\n");
-      oat_classes_.print();
+      if (summarize) {
+        oat_classes_.print_summary();
+      } else {
+        oat_classes_.print();
+      }
     }
     if (print_unverified_classes) {
       oat_classes_.print_unverified_classes();
@@ -2559,7 +2621,8 @@ class OatFile_Unknown : public OatFile {
  public:
   void print(bool dump_classes,
              bool dump_tables,
-             bool print_unverified_classes) override {
+             bool print_unverified_classes,
+             bool summarize) override {
     printf("Unknown OAT file version!\n");
     header_.print();
   }
@@ -2598,7 +2661,8 @@ class OatFile_Bad : public OatFile {
  public:
   void print(bool dump_classes,
              bool dump_tables,
-             bool print_unverified_classes) override {
+             bool print_unverified_classes,
+             bool summarize) override {
     printf("Bad magic number:\n");
     header_.print();
   }
@@ -2640,7 +2704,8 @@ OatFile::~OatFile() = default;
 static std::unique_ptr<OatFile> parse_oatfile_impl(
     bool dex_files_only,
     ConstBuffer oatfile_buffer,
-    const std::vector<DexInput>& dexes) {
+    const std::vector<DexInput>& dexes,
+    uint32_t sections) {
   constexpr size_t kOatElfOffset = 0x1000;
 
   size_t oat_offset = 0;
@@ -2674,15 +2739,17 @@ static std::unique_ptr<OatFile> parse_oatfile_impl(
   case OatVersion::V_045:
   case OatVersion::V_064:
   case OatVersion::V_067:
-    return OatFile_064::parse(dex_files_only, oatfile_buffer, oat_offset);
+    return OatFile_064::parse(
+        dex_files_only, oatfile_buffer, oat_offset, sections);
   case OatVersion::V_079:
   case OatVersion::V_088:
     // 079 and 088 are the same as far as I can tell.
-    return OatFile_079::parse(dex_files_only, oatfile_buffer, oat_offset);
+    return OatFile_079::parse(
+        dex_files_only, oatfile_buffer, oat_offset, sections);
   case OatVersion::V_124:
   case OatVersion::V_131:
     return OatFile_124::parse(
-        dex_files_only, oatfile_buffer, oat_offset, dexes);
+        dex_files_only, oatfile_buffer, oat_offset, dexes, sections);
   case OatVersion::UNKNOWN:
     return OatFile_Unknown::parse(oatfile_buffer);
   }
@@ -2692,12 +2759,15 @@ static std::unique_ptr<OatFile> parse_oatfile_impl(
 
 std::unique_ptr<OatFile> OatFile::parse(ConstBuffer oatfile_buffer,
                                         const std::vector<DexInput>& dex_files,
-                                        bool dex_files_only) {
-  return parse_oatfile_impl(dex_files_only, oatfile_buffer, dex_files);
+                                        bool dex_files_only,
+                                        uint32_t sections) {
+  return parse_oatfile_impl(
+      dex_files_only, oatfile_buffer, dex_files, sections);
 }
 
 std::unique_ptr<OatFile> OatFile::parse_dex_files_only(ConstBuffer buf) {
-  return parse_oatfile_impl(true, buf, std::vector<DexInput>());
+  return parse_oatfile_impl(
+      true, buf, std::vector<DexInput>(), kOatSectionAll);
 }
 
 std::unique_ptr<OatFile> OatFile::parse_dex_files_only(void* ptr, size_t len) {
@@ -3405,19 +3475,21 @@ OatFile::Status build_oatfile_after_v124(
     const QuickData* quick_data) {
   // Make sure the output is a directory where we will place ODEX and VDEX files
   CHECK(oat_file_name[oat_file_name.size() - 1] == '/');
-  OatFile::Status result = OatFile::Status::BUILD_SUCCESS;
-
-  for (const auto& dex : dex_input) {
+  CHECK(oat_version == OatVersion::V_124 || oat_version == OatVersion::V_131,
+        "must not build vdex/odex pairs for non-Oreo builds");
+
+  // Each dex gets its own pair of files, so they are all built at once.
+  std::vector<OatFile::Status> results(dex_input.size(),
+                                       OatFile::Status::BUILD_SUCCESS);
+  parallel_for_index(dex_input.size(), [&](size_t i) {
+    const auto& dex = dex_input[i];
     size_t found = dex.filename.find_last_of("/") + 1;
     CHECK(found >= 0);
     auto odex_file_name = dex.filename.substr(found);
     odex_file_name.erase(odex_file_name.size() - 3);
     odex_file_name = oat_file_name + odex_file_name + std::string("odex");
 
-    CHECK(oat_version == OatVersion::V_124 || oat_version == OatVersion::V_131,
-          "must not build vdex/odex pairs for non-Oreo builds");
-
-    auto partial_result = build_vdex_odex_pairs<DexFileListinType>(
+    results[i] = build_vdex_odex_pairs<DexFileListinType>(
           odex_file_name,
           oat_version,
           dex,
@@ -3426,16 +3498,22 @@ OatFile::Status build_oatfile_after_v124(
           art_image_location,
           samsung_mode,
           quick_data);
+  });
 
-    if (partial_result != OatFile::Status::BUILD_SUCCESS) {
-      fprintf(stderr,
-              "Building V124/V131 ODEX/VDEX pair failed for DEX input: %s, "
-              "Result: %d\n",
-              dex.filename.c_str(),
-              static_cast<int>(partial_result));
-      result = partial_result;
-    }
-  }
+  OatFile::Status result = OatFile::Status::BUILD_SUCCESS;
+  foreach_pair(
+      dex_input,
+      results,
+      [&](const DexInput& dex, const OatFile::Status& partial_result) {
+        if (partial_result != OatFile::Status::BUILD_SUCCESS) {
+          fprintf(stderr,
+                  "Building V124/V131 ODEX/VDEX pair failed for DEX input: "
+                  "%s, Result: %d\n",
+                  dex.filename.c_str(),
+                  static_cast<int>(partial_result));
+          result = partial_result;
+        }
+      });
   return result;
 }
 
@@ -34,6 +34,15 @@ enum class VdexVersion : uint32_t {
   V_010 = 0x00303130 // 8.1, api level 27
 };
 
+// The parts of an oat file past its header, key/value store, dex file listing
+// and dex headers. OatFile::parse only decodes the ones asked for, so that
+// dumping one of them doesn't need to touch the rest of the file.
+enum OatSection : uint32_t {
+  kOatSectionLookupTables = 1 << 0,
+  kOatSectionClasses = 1 << 1,
+  kOatSectionAll = kOatSectionLookupTables | kOatSectionClasses,
+};
+
 struct DexInput {
   std::string filename; // the location on disk.
   std::string location; // the name to store in the OAT file.
@@ -68,10 +77,12 @@ class OatFile {
   UNCOPYABLE(OatFile);
   virtual ~OatFile();
 
-  // Reads magic number, returns correct oat file implementation.
+  // Reads magic number, returns correct oat file implementation. Only the
+  // given sections are decoded, and only those can be printed.
   static std::unique_ptr<OatFile> parse(ConstBuffer oatfile_buffer,
                                         const std::vector<DexInput>& dexes,
-                                        bool dex_files_only);
+                                        bool dex_files_only,
+                                        uint32_t sections = kOatSectionAll);
 
   // Like parse, but stops after parsing the dex file listing and dex headers.
   static std::unique_ptr<OatFile> parse_dex_files_only(ConstBuffer buf);
@@ -79,9 +90,12 @@ class OatFile {
 
   virtual std::vector<OatDexFile> get_oat_dexfiles() = 0;
 
+  // With summarize, the dex files are printed without their code, and classes
+  // as counts per status rather than one by one.
   virtual void print(bool dump_classes,
                      bool dump_tables,
-                     bool print_unverified_classes) = 0;
+                     bool print_unverified_classes,
+                     bool summarize) = 0;
 
   virtual Status status() = 0;
 
@@ -32,6 +32,8 @@
 #include "elf-writer.h"
 #include "OatmealUtil.h"
 
+#include <algorithm>
+
 const std::string& ElfStringTable::at(int orig_idx) const {
   auto idx = orig_idx;
   for (const auto& str : strings_) {
@@ -164,16 +166,50 @@ void ElfWriter::build(InstructionSet isa,
 }
 
 void ElfWriter::write(FileHandle& fh) {
-  write_dynstr(fh);
-  write_dynsym(fh);
-  write_hash(fh);
-  write_dynamic(fh);
-  write_shstrtab(fh);
-  write_headers(fh);
-  write_program_headers(fh);
-
-  fh.seek_begin();
-  write_obj(fh, elf_header_);
+  // Order matters: the hash table is built from the symbols, and the ELF
+  // header is only complete once both header tables are built.
+  std::vector<Chunk> chunks;
+  chunks.push_back(dynstr_chunk());
+  chunks.push_back(dynsym_chunk());
+  chunks.push_back(hash_chunk());
+  chunks.push_back(dynamic_chunk());
+  chunks.push_back(shstrtab_chunk());
+  chunks.push_back(headers_chunk());
+  chunks.push_back(program_headers_chunk());
+  chunks.push_back(make_chunk(0, std::vector<Elf32_Ehdr>{elf_header_}));
+
+  write_chunks(fh, std::move(chunks));
+}
+
+void ElfWriter::write_chunks(FileHandle& fh, std::vector<Chunk> chunks) {
+  // Sections are at most page aligned, so chunks that are less than a page
+  // apart are written as one run, with zeros in between. Anything further
+  // apart has the oat data in between, which must be left alone.
+  constexpr Elf32_Word kMaxGap = 0x1000;
+  static const char zeros[kMaxGap] = {};
+
+  std::sort(chunks.begin(), chunks.end(), [](const Chunk& a, const Chunk& b) {
+    return a.offset < b.offset;
+  });
+
+  size_t i = 0;
+  while (i < chunks.size()) {
+    const auto run_offset = chunks[i].offset;
+    auto run_end = run_offset;
+    std::vector<ConstBuffer> bufs;
+    for (; i < chunks.size(); i++) {
+      const auto& chunk = chunks[i];
+      CHECK(chunk.offset >= run_end, "overlapping ELF chunks");
+      if (!bufs.empty() && chunk.offset - run_end >= kMaxGap) {
+        break;
+      }
+      bufs.push_back(ConstBuffer{zeros, chunk.offset - run_end});
+      bufs.push_back(ConstBuffer{chunk.data.data(), chunk.data.size()});
+      run_end = chunk.offset + chunk.data.size();
+    }
+    CHECK(fh.seek_set(run_offset));
+    write_bufs(fh, bufs);
+  }
 }
 
 unsigned int ElfWriter::get_num_dynsymbols() const {
@@ -457,13 +493,12 @@ void ElfWriter::link_section(int src_idx, int dst_idx) {
   section_headers_[src_idx].sh_link = dst_idx;
 }
 
-void ElfWriter::write_dynstr(FileHandle& fh) {
-  fh.seek_set(section_headers_.at(dynstr_idx_).sh_offset);
-  auto flat_dynstr = dynstr_table_.flatten();
-  write_buf(fh, ConstBuffer{flat_dynstr.data(), flat_dynstr.size()});
+ElfWriter::Chunk ElfWriter::dynstr_chunk() {
+  return Chunk{section_headers_.at(dynstr_idx_).sh_offset,
+               dynstr_table_.flatten()};
 }
 
-void ElfWriter::write_dynsym(FileHandle& fh) {
+ElfWriter::Chunk ElfWriter::dynsym_chunk() {
 
   dynsyms_.clear();
 
@@ -538,8 +573,7 @@ void ElfWriter::write_dynsym(FileHandle& fh) {
 
   CHECK(dynsyms_.size() == get_num_dynsymbols());
 
-  fh.seek_set(section_headers_.at(dynsym_idx_).sh_offset);
-  write_vec(fh, dynsyms_);
+  return make_chunk(section_headers_.at(dynsym_idx_).sh_offset, dynsyms_);
 }
 
 // Determine the number of buckets to use for the hash table
@@ -574,7 +608,7 @@ uint32_t ElfWriter::hash_dynsym(int sym_idx) const {
   return h;
 }
 
-void ElfWriter::write_hash(FileHandle& fh) {
+ElfWriter::Chunk ElfWriter::hash_chunk() {
   const auto num_dynsymbols = get_num_dynsymbols();
   std::vector<Elf32_Word> hash;
 
@@ -640,11 +674,10 @@ void ElfWriter::write_hash(FileHandle& fh) {
     break;
   }
 
-  fh.seek_set(section_headers_.at(hash_idx_).sh_offset);
-  write_vec(fh, hash);
+  return make_chunk(section_headers_.at(hash_idx_).sh_offset, hash);
 }
 
-void ElfWriter::write_dynamic(FileHandle& fh) {
+ElfWriter::Chunk ElfWriter::dynamic_chunk() {
 
   // Calculate addresses of .dynsym, .hash and .dynamic.
 
@@ -665,28 +698,21 @@ void ElfWriter::write_dynamic(FileHandle& fh) {
 
   CHECK(dyns.size() == kNumDynamics);
 
-  fh.seek_set(section_headers_.at(dynamic_idx_).sh_offset);
-  write_vec(fh, dyns);
+  return make_chunk(section_headers_.at(dynamic_idx_).sh_offset, dyns);
 }
 
-void ElfWriter::write_shstrtab(FileHandle& fh) {
-  fh.seek_set(section_headers_.at(shstrtab_idx_).sh_offset);
-  auto flat_strtab = string_table_.flatten();
-  write_buf(fh, ConstBuffer{flat_strtab.data(), flat_strtab.size()});
+ElfWriter::Chunk ElfWriter::shstrtab_chunk() {
+  return Chunk{section_headers_.at(shstrtab_idx_).sh_offset,
+               string_table_.flatten()};
 }
 
-void ElfWriter::write_headers(FileHandle& fh) {
-  const auto prev_offset = next_offset_;
+ElfWriter::Chunk ElfWriter::headers_chunk() {
+  // The padding before the headers is left to write_chunks.
   next_offset_ = align<4>(next_offset_);
-  const auto padding = next_offset_ - prev_offset;
-
-  fh.seek_set(prev_offset);
-  char buf[4] = {};
-  write_buf(fh, ConstBuffer{buf, padding});
 
   elf_header_.e_shoff = next_offset_;
 
-  write_vec(fh, section_headers_);
+  return make_chunk(next_offset_, section_headers_);
 }
 
 unsigned int ElfWriter::get_num_program_headers() const {
@@ -712,7 +738,7 @@ unsigned int ElfWriter::get_num_program_headers() const {
 }
 
 // Write ELF program headers.
-void ElfWriter::write_program_headers(FileHandle& fh) {
+ElfWriter::Chunk ElfWriter::program_headers_chunk() {
   auto num_prog_headers = get_num_program_headers();
 
   std::vector<Elf32_Phdr> prog_headers;
@@ -810,10 +836,7 @@ void ElfWriter::write_program_headers(FileHandle& fh) {
   elf_header_.e_phentsize = sizeof(Elf32_Phdr);
   elf_header_.e_phnum = prog_headers.size();
 
-  fh.seek_set(sizeof(Elf32_Ehdr));
-  for (const auto& e : prog_headers) {
-    write_obj(fh, e);
-  }
+  return make_chunk(sizeof(Elf32_Ehdr), prog_headers);
 }
 
 Elf32_Word ElfWriter::add_section_header(Elf32_Word str_idx,
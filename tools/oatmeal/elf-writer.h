@@ -84,13 +84,28 @@ class ElfWriter {
 
   void link_section(int src_idx, int dst_idx);
 
-  void write_dynstr(FileHandle& fh);
-  void write_dynsym(FileHandle& fh);
-  void write_hash(FileHandle& fh);
-  void write_dynamic(FileHandle& fh);
-  void write_shstrtab(FileHandle& fh);
-  void write_headers(FileHandle& fh);
-  void write_program_headers(FileHandle& fh);
+  // A piece of the file, at its offset. The pieces are built first, and then
+  // written together.
+  struct Chunk {
+    Elf32_Word offset;
+    std::vector<char> data;
+  };
+
+  template <typename T>
+  static Chunk make_chunk(Elf32_Word offset, const std::vector<T>& vec) {
+    auto ptr = reinterpret_cast<const char*>(vec.data());
+    return Chunk{offset, std::vector<char>(ptr, ptr + vec.size() * sizeof(T))};
+  }
+
+  static void write_chunks(FileHandle& fh, std::vector<Chunk> chunks);
+
+  Chunk dynstr_chunk();
+  Chunk dynsym_chunk();
+  Chunk hash_chunk();
+  Chunk dynamic_chunk();
+  Chunk shstrtab_chunk();
+  Chunk headers_chunk();
+  Chunk program_headers_chunk();
 
   uint32_t hash_dynsym(int sym_idx) const;
 
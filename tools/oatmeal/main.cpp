@@ -7,6 +7,7 @@
 
 #include "dump-oat.h"
 #include "memory-accounter.h"
+#include "mmap.h"
 #include "OatmealUtil.h"
 #include "vdex.h"
 
@@ -51,6 +52,8 @@ struct Arguments {
 
   bool print_unverified_classes = false;
 
+  bool summary = false;
+
   std::string arch;
 
   std::string art_image_location;
@@ -95,6 +98,7 @@ Arguments parse_args(int argc, char* argv[]) {
       {"dump-tables", no_argument, nullptr, 't'},
       {"dump-memory-usage", no_argument, nullptr, 'm'},
       {"print-unverified-classes", no_argument, nullptr, 'p'},
+      {"summary", no_argument, nullptr, 's'},
       {"arch", required_argument, nullptr, 'a'},
       {"art-image-location", required_argument, nullptr, 0},
       {"test-is-oatmeal", no_argument, nullptr, 1},
@@ -109,7 +113,7 @@ Arguments parse_args(int argc, char* argv[]) {
 
   int c;
   while ((c = getopt_long(
-              argc, argv, "cetmpdbx:l:o:v:a:", &options[0], nullptr)) != -1) {
+              argc, argv, "cetmpsdbx:l:o:v:a:", &options[0], nullptr)) != -1) {
     switch (c) {
     case 'd':
       if (ret.action != Action::DUMP && ret.action != Action::NONE) {
@@ -127,6 +131,10 @@ Arguments parse_args(int argc, char* argv[]) {
       ret.print_unverified_classes = true;
       break;
 
+    case 's':
+      ret.summary = true;
+      break;
+
     case 'b':
       if (ret.action != Action::BUILD && ret.action != Action::NONE) {
         fprintf(stderr, "Only one of --dump, --build may be set\n");
@@ -238,41 +246,35 @@ int dump(const Arguments& args) {
   }
 
   auto const& oat_file_name = args.oat_files[0];
-  auto oat_file = FileHandle(fopen(oat_file_name.c_str(), "r"));
-  if (oat_file.get() == nullptr) {
-    fprintf(stderr,
-            "failed to open file %s %s\n",
-            oat_file_name.c_str(),
-            std::strerror(errno));
-    return 1;
-  }
-
-  auto oat_file_size = get_filesize(oat_file);
-
-  // We don't run dumping during install on device, so it is allowed to consume
-  // lots of memory.
-  auto oat_file_contents = std::make_unique<char[]>(oat_file_size);
-  auto oatFileBytesRead =
-      fread(oat_file_contents.get(), 1, oat_file_size, oat_file.get());
-  if (oatFileBytesRead != oat_file_size) {
-    fprintf(stderr,
-            "Failed to read file %s (%zd)\n",
-            std::strerror(errno),
-            oatFileBytesRead);
+  auto oat_file = map_file(oat_file_name);
+  if (oat_file == nullptr) {
     return 1;
   }
 
-  ConstBuffer oatfile_buffer{oat_file_contents.get(), oat_file_size};
+  ConstBuffer oatfile_buffer = mapped_buffer(*oat_file);
   auto ma_scope = MemoryAccounter::NewScope(oatfile_buffer);
 
   CHECK(oatfile_buffer.len > 4);
   if (*(reinterpret_cast<const uint32_t*>(oatfile_buffer.ptr)) == kVdexMagicNum) {
     auto vdexfile = VdexFile::parse(oatfile_buffer);
-    vdexfile->print();
+    vdexfile->print(args.summary);
     return 0;
   }
-  auto oatfile =
-      OatFile::parse(oatfile_buffer, args.dex_files, args.test_is_oatmeal);
+
+  // Only decode what is printed. The memory usage report covers the whole
+  // file, so it needs everything.
+  uint32_t sections = 0;
+  if (args.dump_tables) {
+    sections |= kOatSectionLookupTables;
+  }
+  if (args.dump_classes || args.print_unverified_classes) {
+    sections |= kOatSectionClasses;
+  }
+  if (args.dump_memory_usage) {
+    sections = kOatSectionAll;
+  }
+  auto oatfile = OatFile::parse(
+      oatfile_buffer, args.dex_files, args.test_is_oatmeal, sections);
 
   if (!oatfile) {
     fprintf(stderr, "Cannot open .oat file %s\n", oat_file_name.c_str());
@@ -283,8 +285,10 @@ int dump(const Arguments& args) {
     return oatfile->created_by_oatmeal();
   }
 
-  oatfile->print(
-      args.dump_classes, args.dump_tables, args.print_unverified_classes);
+  oatfile->print(args.dump_classes,
+                 args.dump_tables,
+                 args.print_unverified_classes,
+                 args.summary);
 
   if (args.dump_memory_usage) {
     cur_ma()->print();
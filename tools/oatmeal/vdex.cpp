@@ -40,7 +40,7 @@ std::unique_ptr<VdexFile> VdexFile::parse(ConstBuffer buf) {
   return std::unique_ptr<VdexFile>(new VdexFile(header, buf));
 }
 
-void VdexFile::print() const {
+void VdexFile::print(bool summarize) const {
   header_.print();
   for (const auto& e : dex_headers_) {
     printf("DexFile: { \
@@ -51,6 +51,9 @@ void VdexFile::print() const {
     e.class_defs_size,
     e.class_defs_size);
   }
+  if (summarize) {
+    return;
+  }
   size_t index = 0;
   for (const auto& e : dexes_) {
     print_dex_opcodes(reinterpret_cast<const uint8_t*>(e.ptr), dex_headers_[index].file_size);
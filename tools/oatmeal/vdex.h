@@ -65,7 +65,8 @@ class VdexFile {
   MOVABLE(VdexFile);
 
   static std::unique_ptr<VdexFile> parse(ConstBuffer buf);
-  void print() const;
+  // With summarize, only the headers are printed, not the code of the dexes.
+  void print(bool summarize = false) const;
 
  private:
   VdexFile(VdexFileHeader& header, ConstBuffer buf);
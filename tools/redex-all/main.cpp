@@ -5,7 +5,9 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <chrono>
 #include <cinttypes>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -37,7 +39,11 @@
 #include "IODIMetadata.h"
 #include "InstructionLowering.h"
 #include "JarLoader.h"
+#include "JemallocUtil.h"
 #include "OptData.h"
+#include "Parallel.h"
+#include "PatriciaTreeMap.h"
+#include "PatriciaTreeSet.h"
 #include "PassRegistry.h"
 #include "ProguardConfiguration.h" // New ProGuard configuration
 #include "ProguardMatcher.h"
@@ -45,6 +51,7 @@
 #include "ReachableClasses.h"
 #include "RedexContext.h"
 #include "RedexResources.h"
+#include "ThreadPool.h"
 #include "Timer.h"
 #include "ToolsCommon.h"
 #include "Walkers.h"
@@ -69,6 +76,8 @@ struct Arguments {
   Json::Value entry_data;
   boost::optional<int> stop_pass_idx;
   std::string output_ir_dir;
+  boost::optional<int> resume_pass_idx;
+  std::string input_ir_dir;
   RedexOptions redex_options;
 };
 
@@ -237,6 +246,11 @@ Arguments parse_args(int argc, char* argv[]) {
                    "Stop before pass n and output IR to file");
   od.add_options()("output-ir", po::value<std::string>(),
                    "IR output directory, used with --stop-pass");
+  od.add_options()("resume-from", po::value<int>(),
+                   "Load the IR that --stop-pass n wrote and run the passes "
+                   "from pass n on");
+  od.add_options()("input-ir", po::value<std::string>(),
+                   "IR input directory, used with --resume-from");
 
   po::positional_options_description pod;
   pod.add("dex-files", -1);
@@ -268,9 +282,10 @@ Arguments parse_args(int argc, char* argv[]) {
     exit(EXIT_SUCCESS);
   }
 
+  // With --resume-from, the dexes are read from --input-ir instead.
   if (vm.count("dex-files")) {
     args.dex_files = vm["dex-files"].as<std::vector<std::string>>();
-  } else {
+  } else if (!vm.count("resume-from")) {
     std::cerr << "error: no input dex files" << std::endl << std::endl;
     print_usage();
     exit(EXIT_SUCCESS);
@@ -367,6 +382,39 @@ Arguments parse_args(int argc, char* argv[]) {
     args.output_ir_dir = vm["output-ir"].as<std::string>();
   }
 
+  if (vm.count("resume-from")) {
+    args.resume_pass_idx = vm["resume-from"].as<int>();
+  }
+
+  if (vm.count("input-ir")) {
+    args.input_ir_dir = vm["input-ir"].as<std::string>();
+  }
+
+  if (args.resume_pass_idx != boost::none) {
+    // Drop the passes that ran before the IR was written.
+    auto& passes_list = args.config["redex"]["passes"];
+    int idx = *args.resume_pass_idx;
+    int stop_idx = args.stop_pass_idx != boost::none ? *args.stop_pass_idx
+                                                     : passes_list.size();
+    if (idx < 0 || (size_t)idx > passes_list.size() || idx > stop_idx) {
+      std::cerr << "Invalid resume_from value\n";
+      exit(EXIT_FAILURE);
+    }
+    if (args.input_ir_dir.empty() ||
+        !boost::filesystem::is_directory(args.input_ir_dir)) {
+      std::cerr << "input-ir is empty or not a directory" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    Json::Value remaining_passes = Json::arrayValue;
+    for (Json::ArrayIndex i = idx; i < passes_list.size(); ++i) {
+      remaining_passes.append(passes_list[i]);
+    }
+    passes_list = remaining_passes;
+    if (args.stop_pass_idx != boost::none) {
+      args.stop_pass_idx = *args.stop_pass_idx - idx;
+    }
+  }
+
   if (args.stop_pass_idx != boost::none) {
     // Resize the passes list and append an additional RegAllocPass if its final
     // pass is not RegAllocPass.
@@ -389,6 +437,8 @@ Arguments parse_args(int argc, char* argv[]) {
     }
   }
 
+  args.redex_options.num_threads = args.config.get("num_threads", 0).asUInt();
+
   TRACE(MAIN, 2, "Verify-none mode: %s\n",
         args.redex_options.verify_none_enabled ? "Yes" : "No");
   TRACE(MAIN, 2, "Art build: %s\n",
@@ -414,24 +464,10 @@ Json::Value get_stats(const dex_stats_t& stats) {
   val["num_annotations"] = stats.num_annotations;
   val["num_bytes"] = stats.num_bytes;
   val["num_instructions"] = stats.num_instructions;
+  val["num_startup_pages"] = stats.num_startup_pages;
   return val;
 }
 
-Json::Value get_pass_stats(const PassManager& mgr) {
-  Json::Value all(Json::ValueType::objectValue);
-  for (const auto& pass_info : mgr.get_pass_info()) {
-    if (pass_info.metrics.empty()) {
-      continue;
-    }
-    Json::Value pass;
-    for (const auto& pass_metric : pass_info.metrics) {
-      pass[pass_metric.first] = pass_metric.second;
-    }
-    all[pass_info.name] = pass;
-  }
-  return all;
-}
-
 Json::Value get_lowering_stats(const instruction_lowering::Stats& stats) {
   Json::Value obj(Json::ValueType::objectValue);
   obj["num_2addr_instructions"] = Json::UInt(stats.to_2addr);
@@ -459,10 +495,15 @@ Json::Value get_times() {
 }
 
 Json::Value get_input_stats(const dex_stats_t& stats,
-                            const std::vector<dex_stats_t>& dexes_stats) {
+                            const std::vector<dex_stats_t>& dexes_stats,
+                            const std::vector<double>& dexes_load_secs) {
   Json::Value d;
   d["total_stats"] = get_stats(stats);
   d["dexes_stats"] = get_detailed_stats(dexes_stats);
+  for (size_t i = 0; i < dexes_load_secs.size(); ++i) {
+    d["dexes_stats"][(int)i]["load_secs"] =
+        std::round(dexes_load_secs[i] * 1000) / 1000.0;
+  }
   return d;
 }
 
@@ -474,7 +515,7 @@ Json::Value get_output_stats(
   Json::Value d;
   d["total_stats"] = get_stats(stats);
   d["dexes_stats"] = get_detailed_stats(dexes_stats);
-  d["pass_stats"] = get_pass_stats(mgr);
+  d["pass_stats"] = redex::get_pass_stats(mgr);
   d["lowering_stats"] = get_lowering_stats(instruction_lowering_stats);
   return d;
 }
@@ -555,42 +596,55 @@ void write_debug_line_mapping(
   ofs.write((const char*)&version, bit_32_size);
   ofs.write((const char*)&num_method, bit_32_size);
   FILE* fd = fopen(debug_line_mapping_filename.c_str(), "a");
-  std::ostringstream line_out;
-  std::stringstream readable_line_out;
 
+  // Both files list the methods before their lines, so the methods are
+  // collected first and the lines are written by a second pass, instead of
+  // being formatted into buffers.
+  struct MethodLines {
+    const DexMethod* method;
+    uint64_t method_id;
+    const std::vector<DebugLineItem>* debug_lines;
+  };
+  std::vector<MethodLines> method_lines;
+  method_lines.reserve(num_method);
   auto scope = build_class_scope(stores);
   walk::methods(scope, [&](DexMethod* method) {
     auto dex_code = method->get_dex_code();
-    if (dex_code == nullptr ||
-        code_debug_lines.find(dex_code) == code_debug_lines.end()) {
+    if (dex_code == nullptr) {
+      return;
+    }
+    auto it = code_debug_lines.find(dex_code);
+    if (it == code_debug_lines.end()) {
       return;
     }
+    method_lines.push_back({method, method_to_id.at(method), &it->second});
+  });
 
-    uint64_t method_id = method_to_id.at(method);
+  for (const auto& ml : method_lines) {
     // write human readable file
-    fprintf(fd, "0x%016" PRIx64 " %u\n", method_id, offset);
-    readable_line_out << method->get_deobfuscated_name() << "\n";
+    fprintf(fd, "0x%016" PRIx64 " %u\n", ml.method_id, offset);
     // write method id => offset info for binary file
-    ofs.write((const char*)&method_id, bit_64_size);
+    ofs.write((const char*)&ml.method_id, bit_64_size);
     ofs.write((const char*)&binary_offset, bit_32_size);
 
-    auto debug_lines = code_debug_lines.at(dex_code);
-    uint32_t num_line_info = debug_lines.size();
+    uint32_t num_line_info = ml.debug_lines->size();
     offset = offset + 1 + num_line_info;
     uint32_t info_section_size = bit_64_size + num_line_info * 2 * bit_32_size;
     ofs.write((const char*)&info_section_size, bit_32_size);
     binary_offset = binary_offset + info_section_size;
+  }
 
+  fprintf(fd, "\n");
+  for (const auto& ml : method_lines) {
+    fprintf(fd, "%s\n", ml.method->get_deobfuscated_name().c_str());
     // Generate debug line info for binary file.
-    line_out.write((const char*)&method_id, bit_64_size);
-    for (auto it = debug_lines.begin(); it != debug_lines.end(); ++it) {
-      line_out.write((const char*)&it->offset, bit_32_size);
-      line_out.write((const char*)&it->line, bit_32_size);
-      readable_line_out << it->offset << " " << it->line << "\n";
+    ofs.write((const char*)&ml.method_id, bit_64_size);
+    for (const auto& item : *ml.debug_lines) {
+      ofs.write((const char*)&item.offset, bit_32_size);
+      ofs.write((const char*)&item.line, bit_32_size);
+      fprintf(fd, "%u %u\n", item.offset, item.line);
     }
-  });
-  ofs << line_out.str();
-  fprintf(fd, "\n%s", readable_line_out.str().c_str());
+  }
   fclose(fd);
 }
 
@@ -629,34 +683,49 @@ void redex_frontend(ConfigFiles& cfg, /* input */
 
   {
     Timer t("Load classes from dexes");
-    dex_stats_t input_totals;
-    std::vector<dex_stats_t> input_dexes_stats;
+    // The input dexes in command line order, each with the store it belongs
+    // to. They are loaded in parallel and then added to their stores in this
+    // order, so the resulting stores don't depend on the scheduling.
+    struct DexInput {
+      std::string location;
+      size_t store_idx;
+      DexClasses classes;
+      dex_stats_t stats;
+      double load_secs;
+    };
+    std::vector<DexInput> dex_inputs;
     for (const auto& filename : args.dex_files) {
       if (filename.size() >= 5 &&
           filename.compare(filename.size() - 4, 4, ".dex") == 0) {
-        dex_stats_t dex_stats;
-        DexClasses classes =
-            load_classes_from_dex(filename.c_str(), &dex_stats);
-        input_totals += dex_stats;
-        input_dexes_stats.push_back(dex_stats);
-        stores[0].add_classes(std::move(classes));
+        dex_inputs.push_back({filename, 0, {}, {}, 0});
       } else {
         DexMetadata store_metadata;
         store_metadata.parse(filename);
-        DexStore store(store_metadata);
+        stores.emplace_back(store_metadata);
         for (const auto& file_path : store_metadata.get_files()) {
-          dex_stats_t dex_stats;
-          DexClasses classes =
-              load_classes_from_dex(file_path.c_str(), &dex_stats);
-
-          input_totals += dex_stats;
-          input_dexes_stats.push_back(dex_stats);
-          store.add_classes(std::move(classes));
+          dex_inputs.push_back({file_path, stores.size() - 1, {}, {}, 0});
         }
-        stores.emplace_back(std::move(store));
       }
     }
-    stats["input_stats"] = get_input_stats(input_totals, input_dexes_stats);
+    parallel_for(dex_inputs.begin(), dex_inputs.end(), [](DexInput& input) {
+      auto start = std::chrono::steady_clock::now();
+      input.classes =
+          load_classes_from_dex(input.location.c_str(), &input.stats);
+      input.load_secs = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+    }, 1);
+    dex_stats_t input_totals;
+    std::vector<dex_stats_t> input_dexes_stats;
+    std::vector<double> input_dexes_load_secs;
+    for (auto& input : dex_inputs) {
+      input_totals += input.stats;
+      input_dexes_stats.push_back(input.stats);
+      input_dexes_load_secs.push_back(input.load_secs);
+      stores[input.store_idx].add_classes(std::move(input.classes));
+    }
+    stats["input_stats"] = get_input_stats(
+        input_totals, input_dexes_stats, input_dexes_load_secs);
   }
 
   Scope external_classes;
@@ -666,23 +735,28 @@ void redex_frontend(ConfigFiles& cfg, /* input */
     const JsonWrapper& json_cfg = cfg.get_json_config();
     read_dup_class_whitelist(json_cfg);
 
+    std::vector<std::string> library_jar_paths;
     for (const auto& library_jar : library_jars) {
       TRACE(MAIN, 1, "LIBRARY JAR: %s\n", library_jar.c_str());
-      if (!load_jar_file(library_jar.c_str(), &external_classes)) {
+      if (boost::filesystem::exists(library_jar)) {
+        library_jar_paths.push_back(library_jar);
+        auto abs_path = boost::filesystem::absolute(library_jar);
+        args.entry_data["jars"].append(abs_path.string());
+      } else {
         // Try again with the basedir
         std::string basedir_path =
             pg_config.basedirectory + "/" + library_jar.c_str();
-        if (!load_jar_file(basedir_path.c_str())) {
-          std::cerr << "error: library jar could not be loaded: " << library_jar
-                    << std::endl;
-          exit(EXIT_FAILURE);
-        }
+        library_jar_paths.push_back(basedir_path);
         args.entry_data["jars"].append(basedir_path);
-      } else {
-        auto abs_path = boost::filesystem::absolute(library_jar);
-        args.entry_data["jars"].append(abs_path.string());
       }
     }
+    std::string stub_cache_dir;
+    json_cfg.get("library_jar_cache_dir", "", stub_cache_dir);
+    if (!load_jar_files(library_jar_paths, &external_classes,
+                        /* attr_hook */ nullptr, stub_cache_dir)) {
+      std::cerr << "error: library jars could not be loaded" << std::endl;
+      exit(EXIT_FAILURE);
+    }
   }
 
   {
@@ -706,6 +780,25 @@ void redex_frontend(ConfigFiles& cfg, /* input */
   }
 }
 
+/**
+ * Replaces redex_frontend when resuming: the stores come from the dexes that an
+ * earlier run wrote with --stop-pass, and the keep rules and deobfuscated names
+ * that its frontend computed from the IR meta next to them. So the ProGuard
+ * configuration is only parsed for the passes, not applied again.
+ */
+void redex_resume_frontend(Arguments& args, /* inout */
+                           redex::ProguardConfiguration& pg_config,
+                           DexStoresVector& stores) {
+  Timer redex_resume_frontend_timer("Redex_resume_frontend");
+  for (const auto& pg_config_path : args.proguard_config_paths) {
+    Timer time_pg_parsing("Parsed ProGuard config file");
+    redex::proguard_parser::parse_file(pg_config_path, &pg_config);
+  }
+  Json::Value entry_data;
+  redex::load_all_intermediate(args.input_ir_dir, stores, &entry_data);
+  args.entry_data["jars"] = entry_data["jars"];
+}
+
 /**
  * Post processing steps: write dex and collect stats
  */
@@ -715,14 +808,8 @@ void redex_backend(const PassManager& manager,
                    DexStoresVector& stores,
                    Json::Value& stats) {
   Timer redex_backend_timer("Redex_backend");
+  // The instructions are lowered dex by dex as they are written out.
   instruction_lowering::Stats instruction_lowering_stats;
-  {
-    bool lower_with_cfg = false;
-    cfg.get_json_config().get("lower_with_cfg", false, lower_with_cfg);
-    Timer t("Instruction lowering");
-    instruction_lowering_stats =
-        instruction_lowering::run(stores, lower_with_cfg);
-  }
 
   TRACE(MAIN, 1, "Writing out new DexClasses...\n");
   const JsonWrapper& json_cfg = cfg.get_json_config();
@@ -760,42 +847,59 @@ void redex_backend(const PassManager& manager,
   IODIMetadata iodi_metadata;
   bool needs_method_to_id = !iodi_metadata_filename.empty() ||
                             !debug_line_mapping_filename_v2.empty();
+  // With free_code_after_output, the code of the methods is freed as soon as
+  // nothing needs it anymore: right after its dex is written, or if the debug
+  // metadata below still looks at it, after that is written.
+  bool free_code = false;
+  json_cfg.get("free_code_after_output", false, free_code);
+  bool code_needed_after_output =
+      needs_method_to_id || !pos_output.empty() || !pos_output_v2.empty();
+  bool code_needed_after_backend =
+      !json_cfg.get("class_method_info_map", std::string()).empty();
+  bool free_code_per_dex =
+      free_code && !code_needed_after_output && !code_needed_after_backend;
   if (!iodi_metadata_filename.empty()) {
     Timer t("Rename and find duplicates for IODI");
     iodi_metadata.mark_and_rename_methods(stores);
   }
-  for (size_t store_number = 0; store_number < stores.size(); ++store_number) {
-    auto& store = stores[store_number];
+  {
     Timer t("Writing optimized dexes");
-    for (size_t i = 0; i < store.get_dexen().size(); i++) {
-      std::ostringstream ss;
-      ss << output_dir << "/" << store.get_name();
-      if (store.get_name().compare("classes") == 0) {
-        // primary/secondary dex store, primary has no numeral and secondaries
-        // start at 2
-        if (i > 0) {
-          ss << (i + 1);
+    std::vector<DexOutputTarget> targets;
+    for (size_t store_number = 0; store_number < stores.size();
+         ++store_number) {
+      auto& store = stores[store_number];
+      for (size_t i = 0; i < store.get_dexen().size(); i++) {
+        std::ostringstream ss;
+        ss << output_dir << "/" << store.get_name();
+        if (store.get_name().compare("classes") == 0) {
+          // primary/secondary dex store, primary has no numeral and
+          // secondaries start at 2
+          if (i > 0) {
+            ss << (i + 1);
+          }
+        } else {
+          // other dex stores do not have a primary,
+          // so it makes sense to start at 2
+          ss << (i + 2);
         }
-      } else {
-        // other dex stores do not have a primary,
-        // so it makes sense to start at 2
-        ss << (i + 2);
+        ss << ".dex";
+        targets.push_back(
+            {ss.str(), &store.get_dexen()[i], store_number, i});
       }
-      ss << ".dex";
-      auto this_dex_stats = write_classes_to_dex(
-          ss.str(),
-          &store.get_dexen()[i],
-          locator_index,
-          emit_name_based_locators,
-          store_number,
-          i,
-          cfg,
-          pos_mapper.get(),
-          needs_method_to_id ? &method_to_id : nullptr,
-          debug_line_mapping_filename_v2.empty() ? nullptr : &code_debug_lines,
-          iodi_metadata_filename.empty() ? nullptr : &iodi_metadata);
+    }
+    output_dexes_stats = write_classes_to_dexes(
+        targets,
+        locator_index,
+        emit_name_based_locators,
+        cfg,
+        pos_mapper.get(),
+        needs_method_to_id ? &method_to_id : nullptr,
+        debug_line_mapping_filename_v2.empty() ? nullptr : &code_debug_lines,
+        iodi_metadata_filename.empty() ? nullptr : &iodi_metadata,
+        &instruction_lowering_stats,
+        free_code_per_dex);
+    for (const auto& this_dex_stats : output_dexes_stats) {
       output_totals += this_dex_stats;
-      output_dexes_stats.push_back(this_dex_stats);
     }
   }
 
@@ -830,6 +934,12 @@ void redex_backend(const PassManager& manager,
                              code_debug_lines, stores);
     iodi_metadata.write(iodi_metadata_filename, method_to_id);
     pos_mapper->write_map();
+    if (free_code && code_needed_after_output && !code_needed_after_backend) {
+      Timer t_free("Freeing code");
+      walk::parallel::methods(build_class_scope(stores), [](DexMethod* m) {
+        m->set_dex_code(nullptr);
+      });
+    }
     stats["output_stats"] = get_output_stats(
         output_totals, output_dexes_stats, manager, instruction_lowering_stats);
     output_moved_methods_map(method_move_map.c_str(), cfg);
@@ -901,6 +1011,33 @@ void dump_class_method_info_map(const std::string file_path,
   });
 }
 
+/*
+ * Allocator tuning for long runs. All of it is a no-op unless Redex runs with
+ * jemalloc.
+ */
+void configure_allocator(const Json::Value& config) {
+  if (config.get("malloc_background_thread", false).asBool() &&
+      !jemalloc_util::set_background_thread(true)) {
+    TRACE(MAIN, 1, "Unable to start the allocator's background threads\n");
+  }
+  bool thread_arenas = config.get("malloc_thread_arenas", false).asBool();
+  bool thread_cache = config.get("malloc_thread_cache", true).asBool();
+  if (!thread_arenas && thread_cache) {
+    return;
+  }
+  if (!thread_cache) {
+    jemalloc_util::set_thread_cache(false);
+  }
+  ThreadPool::get().set_thread_init([thread_arenas, thread_cache] {
+    if (thread_arenas) {
+      jemalloc_util::use_own_arena();
+    }
+    if (!thread_cache) {
+      jemalloc_util::set_thread_cache(false);
+    }
+  });
+}
+
 } // namespace
 
 int main(int argc, char* argv[]) {
@@ -911,12 +1048,12 @@ int main(int argc, char* argv[]) {
 #endif
 
   std::string stats_output_path;
+  std::string trace_events_output_path;
   Json::Value stats;
+  bool fast_exit = false;
   {
     Timer redex_all_main_timer("redex-all main()");
 
-    g_redex = new RedexContext();
-
     // Currently there are two sources that specify the library jars:
     // 1. The jar_path argument, which may specify one library jar.
     // 2. The library_jars vector, which lists the library jars specified in
@@ -928,9 +1065,21 @@ int main(int argc, char* argv[]) {
     // TODO: Make the command line -jarpath option like a colon separated
     //       list of library JARS.
     Arguments args = parse_args(argc, argv);
+    ThreadPool::get().set_num_threads(args.redex_options.num_threads);
+    ThreadPool::get().set_pin_threads(
+        args.config.get("pin_threads", false).asBool());
+    configure_allocator(args.config);
+
+    g_redex = new RedexContext(
+        args.config.get("hashed_string_table", false).asBool());
 
     RedexContext::set_record_keep_reasons(
         args.config.get("record_keep_reasons", false).asBool());
+    set_lazy_ballooning(args.config.get("lazy_balloon", false).asBool());
+    sparta::set_patricia_tree_set_hash_consing(
+        args.config.get("patricia_tree_set_hash_consing", false).asBool());
+    sparta::set_patricia_tree_map_hash_consing(
+        args.config.get("patricia_tree_map_hash_consing", false).asBool());
 
     auto pg_config = std::make_unique<redex::ProguardConfiguration>();
     DexStoresVector stores;
@@ -944,7 +1093,11 @@ int main(int argc, char* argv[]) {
       args.redex_options.min_sdk = *maybe_sdk;
     }
 
-    redex_frontend(cfg, args, *pg_config, stores, stats);
+    if (args.resume_pass_idx == boost::none) {
+      redex_frontend(cfg, args, *pg_config, stores, stats);
+    } else {
+      redex_resume_frontend(args, *pg_config, stores);
+    }
 
     auto const& passes = PassRegistry::get().get_passes();
     PassManager manager(passes, std::move(pg_config), args.config,
@@ -970,7 +1123,10 @@ int main(int argc, char* argv[]) {
 
     stats_output_path =
         cfg.metafile(args.config.get("stats_output", "").asString());
-    {
+    trace_events_output_path =
+        cfg.metafile(args.config.get("trace_events_output", "").asString());
+    fast_exit = args.config.get("fast_exit", false).asBool();
+    if (!fast_exit) {
       Timer t("Freeing global memory");
       delete g_redex;
     }
@@ -982,7 +1138,19 @@ int main(int argc, char* argv[]) {
     std::ofstream out(stats_output_path);
     writer.write(out, stats);
   }
+  if (!trace_events_output_path.empty()) {
+    std::ofstream out(trace_events_output_path);
+    Timer::write_chrome_trace(out);
+  }
 
   TRACE(MAIN, 1, "Done.\n");
+  if (fast_exit) {
+    // Everything has been written out, and all that is left to tear down is
+    // memory, which the OS reclaims at once. The TRACE buffers are normally
+    // written out by a static destructor, which _Exit skips.
+    flush_trace();
+    fflush(nullptr);
+    std::_Exit(0);
+  }
   return 0;
 }
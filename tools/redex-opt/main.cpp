@@ -7,10 +7,20 @@
 
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
 #include <iostream>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
 #include "DexClass.h"
+#include "DexLoader.h"
 #include "PassRegistry.h"
+#include "ThreadPool.h"
 #include "Timer.h"
 #include "ToolsCommon.h"
 
@@ -20,6 +30,11 @@ struct Arguments {
   std::string input_ir_dir;
   std::string output_ir_dir;
   std::vector<std::string> pass_names;
+  bool lazy_balloon{false};
+  // If set, run the passes this many times instead of once, and report what
+  // they cost rather than writing the output IR.
+  unsigned benchmark_runs{0};
+  std::string benchmark_output;
   RedexOptions redex_options;
 };
 
@@ -35,6 +50,15 @@ Arguments parse_args(int argc, char* argv[]) {
                      "output dex and IR meta directory");
   desc.add_options()("pass-name,p", po::value<std::vector<std::string>>(),
                      "pass name");
+  desc.add_options()("lazy-balloon",
+                     "balloon each method when its code is first used");
+  desc.add_options()(
+      "benchmark", po::value<unsigned>(),
+      "run the passes this many times, each time on a fresh load of the "
+      "input IR, and report their time, peak RSS and metrics as JSON instead "
+      "of writing the output IR");
+  desc.add_options()("benchmark-output", po::value<std::string>(),
+                     "where to write the benchmark report, stdout otherwise");
 
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -63,6 +87,13 @@ Arguments parse_args(int argc, char* argv[]) {
   if (vm.count("pass-name")) {
     args.pass_names = vm["pass-name"].as<std::vector<std::string>>();
   }
+  args.lazy_balloon = vm.count("lazy-balloon") > 0;
+  if (vm.count("benchmark")) {
+    args.benchmark_runs = vm["benchmark"].as<unsigned>();
+  }
+  if (vm.count("benchmark-output")) {
+    args.benchmark_output = vm["benchmark-output"].as<std::string>();
+  }
 
   return args;
 }
@@ -92,12 +123,147 @@ Json::Value process_entry_data(const Json::Value& entry_data,
 
   return config_data;
 }
+
+// Start a new high-water mark of the RSS, so that the next get_peak_rss_kb
+// only covers what runs in between. Only supported on Linux.
+void reset_peak_rss() {
+#ifdef __linux__
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+#endif
+}
+
+int64_t get_peak_rss_kb() {
+#ifdef __linux__
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      return std::stoll(line.substr(6));
+    }
+  }
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+  }
+#endif
+  return 0;
+}
+
+// User + system time of all threads.
+double get_cpu_seconds() {
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    auto seconds = [](const timeval& tv) {
+      return tv.tv_sec + tv.tv_usec / 1000000.0;
+    };
+    return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+  }
+#endif
+  return 0;
+}
+
+Json::Value get_summary(const Json::Value& runs, const char* key) {
+  std::vector<Json::Value> values(runs.begin(), runs.end());
+  std::sort(values.begin(), values.end(),
+            [&](const Json::Value& a, const Json::Value& b) {
+              return a[key].asDouble() < b[key].asDouble();
+            });
+  Json::Value summary;
+  summary["min"] = values.front()[key];
+  summary["median"] = values[values.size() / 2][key];
+  summary["max"] = values.back()[key];
+  return summary;
+}
+
+// Milliseconds, to the microsecond: a pass can take well under a millisecond
+// on a small input.
+Json::Value to_ms(double seconds) {
+  return std::round(seconds * 1000000) / 1000;
+}
+
+/**
+ * Run the passes `args.benchmark_runs` times. Each run loads the input IR into
+ * a new RedexContext, so that every run starts from the same state; loading
+ * isn't measured. The passes themselves are registered once per process, so a
+ * pass that keeps state across runs will see it again.
+ */
+void run_benchmark(Arguments& args) {
+  Json::Value runs = Json::arrayValue;
+  for (unsigned i = 0; i < args.benchmark_runs; i++) {
+    g_redex = new RedexContext();
+    {
+      Json::Value entry_data;
+      DexStoresVector stores;
+      redex::load_all_intermediate(args.input_ir_dir, stores, &entry_data);
+      args.redex_options.deserialize(entry_data);
+      ThreadPool::get().set_num_threads(args.redex_options.num_threads);
+
+      Json::Value config_data = process_entry_data(entry_data, args);
+      ConfigFiles cfg(std::move(config_data), args.output_ir_dir);
+
+      const auto& passes = PassRegistry::get().get_passes();
+      PassManager manager(passes, config_data, args.redex_options);
+      manager.set_testing_mode();
+
+      reset_peak_rss();
+      auto wall_start = std::chrono::steady_clock::now();
+      auto cpu_start = get_cpu_seconds();
+      manager.run_passes(stores, cfg);
+      auto wall_seconds = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - wall_start)
+                              .count();
+      auto cpu_seconds = get_cpu_seconds() - cpu_start;
+
+      Json::Value run;
+      run["wall_ms"] = to_ms(wall_seconds);
+      run["cpu_ms"] = to_ms(cpu_seconds);
+      run["peak_rss_kb"] = Json::Int64(get_peak_rss_kb());
+      run["pass_stats"] = redex::get_pass_stats(manager);
+      runs.append(run);
+      std::cerr << "Benchmark run " << i + 1 << "/" << args.benchmark_runs
+                << ": " << run["wall_ms"].asDouble() << " ms\n";
+    }
+    delete g_redex;
+  }
+
+  Json::Value report;
+  report["passes"] = Json::arrayValue;
+  for (const auto& pass_name : args.pass_names) {
+    report["passes"].append(pass_name);
+  }
+  report["wall_ms"] = get_summary(runs, "wall_ms");
+  report["cpu_ms"] = get_summary(runs, "cpu_ms");
+  report["peak_rss_kb"] = get_summary(runs, "peak_rss_kb");
+  report["runs"] = runs;
+
+  Json::StyledStreamWriter writer;
+  if (args.benchmark_output.empty()) {
+    writer.write(std::cout, report);
+  } else {
+    std::ofstream out(args.benchmark_output);
+    writer.write(out, report);
+  }
+}
 } // namespace
 
 int main(int argc, char* argv[]) {
   Timer opt_timer("Redex-opt");
   Arguments args = parse_args(argc, argv);
 
+  set_lazy_ballooning(args.lazy_balloon);
+  if (args.benchmark_runs > 0) {
+    run_benchmark(args);
+    return 0;
+  }
+
   g_redex = new RedexContext();
 
   Json::Value entry_data;
@@ -106,6 +272,7 @@ int main(int argc, char* argv[]) {
 
   redex::load_all_intermediate(args.input_ir_dir, stores, &entry_data);
   args.redex_options.deserialize(entry_data);
+  ThreadPool::get().set_num_threads(args.redex_options.num_threads);
 
   Json::Value config_data = process_entry_data(entry_data, args);
   ConfigFiles cfg(std::move(config_data), args.output_ir_dir);
@@ -0,0 +1,46 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <iostream>
+
+#include "MethodProfiles.h"
+#include "Tool.h"
+
+/*
+ * This tool converts a `<deobfuscated method name> <weight>` method profile
+ * into the binary format, which Redex maps into memory instead of parsing.
+ */
+namespace {
+
+class ConvertMethodProfile : public Tool {
+ public:
+  ConvertMethodProfile()
+      : Tool("convert-method-profile",
+             "convert a method profile to the binary format") {}
+
+  void add_options(po::options_description& options) const override {
+    options.add_options()("input,i",
+                          po::value<std::string>()->required(),
+                          "the method profile to convert")(
+        "output,o",
+        po::value<std::string>()->required(),
+        "where to write the binary method profile");
+  }
+
+  void run(const po::variables_map& options) override {
+    auto method_to_weight =
+        read_method_weights(options["input"].as<std::string>());
+    write_binary_method_profile(options["output"].as<std::string>(),
+                                method_to_weight);
+    std::cout << "Converted " << method_to_weight.size() << " methods"
+              << std::endl;
+  }
+};
+
+} // namespace
+
+static ConvertMethodProfile s_tool;
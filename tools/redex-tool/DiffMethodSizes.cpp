@@ -5,10 +5,12 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include "BinarySerialization.h"
 #include "DexClass.h"
 #include "DexInstruction.h"
 #include "DexUtil.h"
 #include "JarLoader.h"
+#include "Parallel.h"
 #include "ProguardConfiguration.h"
 #include "ProguardParser.h"
 #include "ReachableClasses.h"
@@ -18,6 +20,7 @@
 #include <algorithm>
 #include <iostream>
 #include <map>
+#include <numeric>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -135,40 +138,46 @@ using DexMethodInfoMap =
                                               // or <#move, moves size> if
                                               // it is storing move info.
 
-DexMethodInfoMap load_dex_method_info(const std::string& dir) {
+// Loads the dexen in `dir` without ballooning them, and gets the info of
+// each method from its DexCode in parallel.
+template <class InfoFn>
+DexMethodInfoMap load_dex_method_info(const std::string& dir, InfoFn info_fn) {
   DexStore root_store("dex");
   DexStoresVector stores;
 
   // Load root dexen
   load_root_dexen(root_store, dir);
   stores.emplace_back(std::move(root_store));
-  DexMethodInfoMap result;
 
-  walk::methods(build_class_scope(stores), [&result](DexMethod* method) {
-    auto key = show(method);
-    always_assert(result.find(key) == end(result));
-    const auto* code = method->get_dex_code();
-    result.emplace(key,
-                   std::make_tuple((code ? code->size() : 0),
-                                   (code ? code->get_registers_size() : 0)));
+  std::vector<DexMethod*> methods;
+  walk::methods(build_class_scope(stores),
+                [&](DexMethod* method) { methods.push_back(method); });
+  std::vector<std::pair<std::string, std::tuple<int, int>>> infos(
+      methods.size());
+  std::vector<size_t> indices(methods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    infos[i] = std::make_pair(show(methods[i]),
+                              info_fn(methods[i]->get_dex_code()));
   });
 
+  DexMethodInfoMap result;
+  for (auto& info : infos) {
+    auto inserted = result.emplace(std::move(info)).second;
+    always_assert(inserted);
+  }
   return result;
 }
 
-DexMethodInfoMap load_dex_method_move_info(const std::string& dir) {
-  DexStore root_store("dex");
-  DexStoresVector stores;
-
-  // Load root dexen
-  load_root_dexen(root_store, dir);
-  stores.emplace_back(std::move(root_store));
-  DexMethodInfoMap result;
+DexMethodInfoMap load_dex_method_info(const std::string& dir) {
+  return load_dex_method_info(dir, [](const DexCode* code) {
+    return std::make_tuple((code ? code->size() : 0),
+                           (code ? code->get_registers_size() : 0));
+  });
+}
 
-  walk::methods(build_class_scope(stores), [&result](DexMethod* method) {
-    auto key = show(method);
-    always_assert(result.find(key) == end(result));
-    const auto* code = method->get_dex_code();
+DexMethodInfoMap load_dex_method_move_info(const std::string& dir) {
+  return load_dex_method_info(dir, [](const DexCode* code) {
     int num_moves = 0;
     int moves_size = 0;
     if (code) {
@@ -179,16 +188,92 @@ DexMethodInfoMap load_dex_method_move_info(const std::string& dir) {
         }
       }
     }
-    result.emplace(key, std::make_tuple(num_moves, moves_size));
+    return std::make_tuple(num_moves, moves_size);
   });
+}
 
-  return result;
+/*
+ * A snapshot keeps the method info of a set of dexen, so that it can be
+ * compared with others without loading them again. It is a header, the kind
+ * of info, the number of methods, and then the name and the info of each
+ * method, sorted by name.
+ */
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+enum SnapshotKind : uint32_t { SIZES = 0, MOVES = 1 };
+
+void write_snapshot(const std::string& filename,
+                    const DexMethodInfoMap& info,
+                    SnapshotKind kind) {
+  std::vector<const DexMethodInfoMap::value_type*> entries;
+  entries.reserve(info.size());
+  for (const auto& entry : info) {
+    entries.push_back(&entry);
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const DexMethodInfoMap::value_type* a,
+               const DexMethodInfoMap::value_type* b) {
+              return a->first < b->first;
+            });
+
+  std::ofstream os(filename, std::ios::binary | std::ios::trunc);
+  binary_serialization::write_header(os, SNAPSHOT_VERSION);
+  binary_serialization::write<uint32_t>(os, kind);
+  binary_serialization::write<uint32_t>(os, entries.size());
+  for (auto entry : entries) {
+    binary_serialization::write_string(os, entry->first);
+    binary_serialization::write<int32_t>(os, std::get<0>(entry->second));
+    binary_serialization::write<int32_t>(os, std::get<1>(entry->second));
+  }
+  always_assert_log(os, "Unable to write snapshot %s\n", filename.c_str());
+}
+
+// Returns false if `filename` is not a snapshot, e.g. if it is a directory.
+bool read_snapshot(const std::string& filename,
+                   SnapshotKind kind,
+                   DexMethodInfoMap* info) {
+  std::ifstream is(filename, std::ios::binary);
+  uint32_t version;
+  if (!is.is_open() || !binary_serialization::read_header(is, &version)) {
+    return false;
+  }
+  always_assert_log(version == SNAPSHOT_VERSION,
+                    "Unsupported snapshot version %u in %s\n", version,
+                    filename.c_str());
+  uint32_t snapshot_kind;
+  uint32_t count;
+  is.read((char*)&snapshot_kind, sizeof(snapshot_kind));
+  is.read((char*)&count, sizeof(count));
+  always_assert_log(is && snapshot_kind == kind,
+                    "%s is not a snapshot of the compared info\n",
+                    filename.c_str());
+  info->reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    std::string name;
+    int32_t values[2];
+    bool read = binary_serialization::read_string(is, &name) &&
+                is.read((char*)values, sizeof(values));
+    always_assert_log(read, "Truncated snapshot %s\n", filename.c_str());
+    info->emplace(std::move(name), std::make_tuple(values[0], values[1]));
+  }
+  return true;
+}
+
+// Reads the info from a snapshot, or from the dexen if `path` is a directory.
+DexMethodInfoMap load_method_info(const std::string& path,
+                                  bool is_comparing_dex_size) {
+  DexMethodInfoMap info;
+  if (read_snapshot(path, is_comparing_dex_size ? SIZES : MOVES, &info)) {
+    return info;
+  }
+  return is_comparing_dex_size ? load_dex_method_info(path)
+                               : load_dex_method_move_info(path);
 }
 
 void dump_method_sizes_from_dexen_dir(const std::string& dexen_dir) {
   std::cout << "INFO: "
             << "Loading directory " << dexen_dir << " ... " << std::endl;
-  auto info = load_dex_method_info(dexen_dir);
+  auto info = load_method_info(dexen_dir, true /* is_comparing_dex_size */);
   std::cout << "INFO: " << info.size() << " method information loaded"
             << std::endl;
   for (const auto& pair : info) {
@@ -203,8 +288,7 @@ void diff_from_two_dexen_dirs(const std::string& dexen_dir_A,
   std::cout << "INFO: "
             << "Loading directory " << dexen_dir_A << " ... " << std::endl;
   RedexContext* A_context = g_redex;
-  auto A_info = is_comparing_dex_size ? load_dex_method_info(dexen_dir_A)
-                                      : load_dex_method_move_info(dexen_dir_A);
+  auto A_info = load_method_info(dexen_dir_A, is_comparing_dex_size);
   std::cout << "INFO: " << A_info.size() << " method information loaded"
             << std::endl;
 
@@ -212,8 +296,7 @@ void diff_from_two_dexen_dirs(const std::string& dexen_dir_A,
             << "Loading directory " << dexen_dir_B << " ... " << std::endl;
   std::unique_ptr<RedexContext> B_context(new RedexContext());
   g_redex = B_context.get();
-  auto B_info = is_comparing_dex_size ? load_dex_method_info(dexen_dir_B)
-                                      : load_dex_method_move_info(dexen_dir_B);
+  auto B_info = load_method_info(dexen_dir_B, is_comparing_dex_size);
   std::cout << "INFO: " << B_info.size() << " method information loaded"
             << std::endl;
 
@@ -268,7 +351,7 @@ void diff_from_two_dexen_dirs(const std::string& dexen_dir_A,
 void dump_method_move_info_from_dex_dir(const std::string& dex_dir) {
   std::cout << "INFO: "
             << "Loading directory " << dex_dir << " ... " << std::endl;
-  auto info = load_dex_method_move_info(dex_dir);
+  auto info = load_method_info(dex_dir, false /* is_comparing_dex_size */);
   std::cout << "INFO: " << info.size() << " method information loaded"
             << std::endl;
   for (const auto& pair : info) {
@@ -293,7 +376,12 @@ class DiffMethodSizes : public Tool {
         "directories are given, compare the method sizes")(
         "show-moves,s",
         po::value<std::vector<std::string>>()->multitoken(),
-        "show number of move code and their size for each methods");
+        "show number of move code and their size for each methods")(
+        "snapshot,o",
+        po::value<std::string>(),
+        "with a single --dexendir or --show-moves, write the method info to "
+        "this snapshot instead of printing it. A snapshot can be given in "
+        "place of any dexen directory.");
   }
 
   virtual void run(const po::variables_map& options) override {
@@ -305,7 +393,12 @@ class DiffMethodSizes : public Tool {
           options["dexendir"].as<std::vector<std::string>>();
       switch (dexen_dirs.size()) {
       case 1:
-        dump_method_sizes_from_dexen_dir(dexen_dirs[0]);
+        if (!options["snapshot"].empty()) {
+          write_snapshot(options["snapshot"].as<std::string>(),
+                         load_method_info(dexen_dirs[0], true), SIZES);
+        } else {
+          dump_method_sizes_from_dexen_dir(dexen_dirs[0]);
+        }
         break;
       case 2:
         diff_from_two_dexen_dirs(
@@ -320,7 +413,12 @@ class DiffMethodSizes : public Tool {
           options["show-moves"].as<std::vector<std::string>>();
       switch (dex_dirs.size()) {
       case 1:
-        dump_method_move_info_from_dex_dir(dex_dirs[0]);
+        if (!options["snapshot"].empty()) {
+          write_snapshot(options["snapshot"].as<std::string>(),
+                         load_method_info(dex_dirs[0], false), MOVES);
+        } else {
+          dump_method_move_info_from_dex_dir(dex_dirs[0]);
+        }
         break;
       case 2:
         diff_from_two_dexen_dirs(
@@ -5,9 +5,12 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <numeric>
 #include <ostream>
+#include <sstream>
 
 #include "DexOutput.h"
+#include "Parallel.h"
 #include "Show.h"
 #include "Tool.h"
 #include "Walkers.h"
@@ -22,20 +25,33 @@
  */
 namespace {
 void dump_sizes(std::ostream& ofs, DexStoresVector& stores) {
-  auto print = [&](DexMethod* method) {
-    ofs << method->get_fully_deobfuscated_name() << ", "
-        << (method->get_dex_code() ? method->get_dex_code()->size() : -1)
-        << ", " << method->is_virtual() << ", " << method->is_external() << ", "
-        << method->is_concrete() << std::endl;
-  };
+  std::vector<DexMethod*> methods;
   walk::classes(build_class_scope(stores), [&](DexClass* cls) {
     for (auto dmethod : cls->get_dmethods()) {
-      print(dmethod);
+      methods.push_back(dmethod);
     }
     for (auto vmethod : cls->get_vmethods()) {
-      print(vmethod);
+      methods.push_back(vmethod);
     }
   });
+  // The methods are not ballooned, so their sizes come straight from their
+  // DexCode, and can be computed in parallel.
+  std::vector<std::string> lines(methods.size());
+  std::vector<size_t> indices(methods.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    auto method = methods[i];
+    std::ostringstream line;
+    line << method->get_fully_deobfuscated_name() << ", "
+         << (method->get_dex_code() ? method->get_dex_code()->size() : -1)
+         << ", " << method->is_virtual() << ", " << method->is_external()
+         << ", " << method->is_concrete() << "\n";
+    lines[i] = line.str();
+  });
+  for (const auto& line : lines) {
+    ofs << line;
+  }
+  ofs.flush();
 }
 
 class SizeMap : public Tool {
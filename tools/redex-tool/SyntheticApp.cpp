@@ -0,0 +1,461 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "ConfigFiles.h"
+#include "Creators.h"
+#include "DexAnnotation.h"
+#include "DexAsm.h"
+#include "DexClass.h"
+#include "DexOutput.h"
+#include "DexStore.h"
+#include "IRCode.h"
+#include "InstructionLowering.h"
+#include "Tool.h"
+
+/*
+ * This tool generates a synthetic app, to measure how Redex scales on inputs
+ * of a given size and shape without needing a real app.
+ *
+ * The classes form chains of subclasses whose virtual methods override each
+ * other, and implement some of the interfaces. Every method takes and returns
+ * an int; its body loads strings, reads and writes the fields of its class,
+ * and calls methods of other classes and of its own. The classes get split
+ * into as many dexes as the dex format limits on refs require.
+ */
+
+using namespace dex_asm;
+
+namespace {
+
+const std::string kPackage = "Lcom/redex/synthetic/";
+
+// Stay a little under the 64K limits of the dex format on method, field and
+// type refs.
+const size_t kMaxRefsPerDex = 64000;
+
+struct Shape {
+  size_t classes;
+  size_t hierarchy_depth;
+  size_t interfaces;
+  size_t interfaces_per_class;
+  size_t methods_per_interface;
+  size_t methods_per_class;
+  size_t fields_per_class;
+  size_t calls_per_method;
+  size_t strings;
+  size_t strings_per_method;
+  size_t annotation_types;
+  size_t annotations_per_class;
+  size_t annotations_per_method;
+};
+
+class Generator {
+ public:
+  Generator(const Shape& shape, unsigned seed)
+      : m_shape(shape), m_rng(seed), m_int_proto(DexProto::make_proto(
+                                         get_int_type(),
+                                         DexTypeList::make_type_list(
+                                             {get_int_type()}))) {}
+
+  DexClasses generate() {
+    DexClasses classes;
+    for (size_t i = 0; i < m_shape.annotation_types; i++) {
+      classes.push_back(make_annotation_type(i));
+    }
+    for (size_t i = 0; i < m_shape.interfaces; i++) {
+      classes.push_back(make_interface(i));
+    }
+    for (size_t i = 0; i < m_shape.classes; i++) {
+      classes.push_back(make_class(i));
+    }
+    return classes;
+  }
+
+ private:
+  static DexType* make_type(const std::string& kind, size_t i) {
+    return DexType::make_type(
+        (kPackage + kind + std::to_string(i) + ";").c_str());
+  }
+
+  DexType* class_type(size_t i) const { return make_type("C", i); }
+
+  size_t static_methods() const { return m_shape.methods_per_class / 2; }
+
+  size_t virtual_methods() const {
+    return m_shape.methods_per_class - static_methods();
+  }
+
+  DexMethodRef* static_method(size_t cls, size_t i) const {
+    return DexMethod::make_method(
+        class_type(cls), DexString::make_string("s" + std::to_string(i)),
+        m_int_proto);
+  }
+
+  DexMethodRef* virtual_method(DexType* cls, size_t i) const {
+    return DexMethod::make_method(
+        cls, DexString::make_string("v" + std::to_string(i)), m_int_proto);
+  }
+
+  DexMethodRef* interface_method(size_t iface, size_t i) const {
+    return DexMethod::make_method(
+        make_type("I", iface),
+        DexString::make_string("i" + std::to_string(iface) + "_" +
+                               std::to_string(i)),
+        m_int_proto);
+  }
+
+  DexFieldRef* field(DexType* cls, bool is_static, size_t i) const {
+    return DexField::make_field(
+        cls,
+        DexString::make_string((is_static ? "sf" : "f") + std::to_string(i)),
+        get_int_type());
+  }
+
+  size_t random(size_t bound) {
+    return std::uniform_int_distribution<size_t>(0, bound - 1)(m_rng);
+  }
+
+  DexAnnotationSet* make_annotations(size_t count) {
+    if (count == 0 || m_shape.annotation_types == 0) {
+      return nullptr;
+    }
+    auto aset = new DexAnnotationSet();
+    std::unordered_set<size_t> used;
+    for (size_t i = 0; i < std::min(count, m_shape.annotation_types); i++) {
+      size_t type;
+      do {
+        type = random(m_shape.annotation_types);
+      } while (!used.insert(type).second);
+      aset->add_annotation(
+          new DexAnnotation(make_type("A", type), DAV_RUNTIME));
+    }
+    return aset;
+  }
+
+  DexClass* make_annotation_type(size_t i) {
+    ClassCreator cc(make_type("A", i));
+    cc.set_access(ACC_PUBLIC | ACC_INTERFACE | ACC_ABSTRACT | ACC_ANNOTATION);
+    cc.set_super(get_object_type());
+    cc.add_interface(DexType::make_type("Ljava/lang/annotation/Annotation;"));
+    return cc.create();
+  }
+
+  DexClass* make_interface(size_t i) {
+    ClassCreator cc(make_type("I", i));
+    cc.set_access(ACC_PUBLIC | ACC_INTERFACE | ACC_ABSTRACT);
+    cc.set_super(get_object_type());
+    for (size_t j = 0; j < m_shape.methods_per_interface; j++) {
+      auto method = static_cast<DexMethod*>(interface_method(i, j));
+      method->make_concrete(ACC_PUBLIC | ACC_ABSTRACT, /* is_virtual */ true);
+      cc.add_method(method);
+    }
+    return cc.create();
+  }
+
+  DexMethod* make_constructor(DexType* self, DexType* super) {
+    auto void_proto = DexProto::make_proto(get_void_type(),
+                                           DexTypeList::make_type_list({}));
+    auto method = static_cast<DexMethod*>(DexMethod::make_method(
+        self, DexString::make_string("<init>"), void_proto));
+    method->make_concrete(ACC_PUBLIC | ACC_CONSTRUCTOR, /* is_virtual */ false);
+    auto code = std::make_unique<IRCode>(method, 0);
+    auto super_init = DexMethod::make_method(
+        super, DexString::make_string("<init>"), method->get_proto());
+    code->push_back(dasm(OPCODE_INVOKE_DIRECT, super_init, {0_v}));
+    code->push_back(dasm(OPCODE_RETURN_VOID));
+    method->set_code(std::move(code));
+    return method;
+  }
+
+  /*
+   * A method of the class `cls`, which implements the given interfaces. v0
+   * holds the result, v1 and v2 are scratch registers, and the parameters
+   * come after them.
+   */
+  DexMethod* make_method(size_t cls,
+                         DexMethodRef* ref,
+                         bool is_static,
+                         const std::vector<size_t>& interfaces) {
+    auto self = class_type(cls);
+    auto method = static_cast<DexMethod*>(ref);
+    DexAccessFlags access = is_static ? (ACC_PUBLIC | ACC_STATIC) : ACC_PUBLIC;
+    if (auto aset = make_annotations(m_shape.annotations_per_method)) {
+      method->attach_annotation_set(aset);
+    }
+    method->make_concrete(access, !is_static);
+    auto code = std::make_unique<IRCode>(method, 3);
+    uint16_t this_reg = 3;
+    uint16_t arg_reg = is_static ? 3 : 4;
+    code->push_back(dasm(OPCODE_MOVE, {0_v, {VREG, arg_reg}}));
+
+    for (size_t i = 0; i < m_shape.strings_per_method; i++) {
+      auto str = DexString::make_string(
+          "synthetic string " + std::to_string(random(m_shape.strings)));
+      code->push_back(dasm(OPCODE_CONST_STRING, str, {}));
+      code->push_back(dasm(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT, {1_v}));
+    }
+
+    size_t fields = is_static ? m_shape.fields_per_class / 2
+                              : m_shape.fields_per_class -
+                                    m_shape.fields_per_class / 2;
+    if (fields > 0) {
+      auto f = field(self, is_static, random(fields));
+      if (is_static) {
+        code->push_back(dasm(OPCODE_SGET, f, {}));
+      } else {
+        code->push_back(dasm(OPCODE_IGET, f, {{VREG, this_reg}}));
+      }
+      code->push_back(dasm(IOPCODE_MOVE_RESULT_PSEUDO, {2_v}));
+      code->push_back(dasm(OPCODE_ADD_INT, {0_v, 0_v, 2_v}));
+      if (is_static) {
+        code->push_back(dasm(OPCODE_SPUT, f, {0_v}));
+      } else {
+        code->push_back(dasm(OPCODE_IPUT, f, {0_v, {VREG, this_reg}}));
+      }
+    }
+
+    for (size_t i = 0; i < m_shape.calls_per_method; i++) {
+      // Mostly calls to other classes, and some to the methods of `this`.
+      auto kind = is_static ? 0 : random(4);
+      if (kind == 1 && virtual_methods() > 0) {
+        code->push_back(dasm(OPCODE_INVOKE_VIRTUAL,
+                             virtual_method(self, random(virtual_methods())),
+                             {{VREG, this_reg}, 0_v}));
+      } else if (kind == 2 && !interfaces.empty() &&
+                 m_shape.methods_per_interface > 0) {
+        auto iface = interfaces[random(interfaces.size())];
+        code->push_back(dasm(
+            OPCODE_INVOKE_INTERFACE,
+            interface_method(iface, random(m_shape.methods_per_interface)),
+            {{VREG, this_reg}, 0_v}));
+      } else if (static_methods() > 0) {
+        code->push_back(dasm(
+            OPCODE_INVOKE_STATIC,
+            static_method(random(m_shape.classes), random(static_methods())),
+            {0_v}));
+      } else {
+        continue;
+      }
+      code->push_back(dasm(OPCODE_MOVE_RESULT, {0_v}));
+    }
+    code->push_back(dasm(OPCODE_RETURN, {0_v}));
+    method->set_code(std::move(code));
+    return method;
+  }
+
+  DexClass* make_class(size_t i) {
+    auto self = class_type(i);
+    // Each chain of subclasses starts from Object.
+    size_t depth = std::max<size_t>(m_shape.hierarchy_depth, 1);
+    auto super = i % depth == 0 ? get_object_type() : class_type(i - 1);
+
+    ClassCreator cc(self);
+    cc.set_access(ACC_PUBLIC);
+    cc.set_super(super);
+    std::vector<size_t> interfaces;
+    if (m_shape.interfaces > 0) {
+      for (size_t j = 0;
+           j < std::min(m_shape.interfaces_per_class, m_shape.interfaces);
+           j++) {
+        size_t iface;
+        do {
+          iface = random(m_shape.interfaces);
+        } while (std::find(interfaces.begin(), interfaces.end(), iface) !=
+                 interfaces.end());
+        interfaces.push_back(iface);
+        cc.add_interface(make_type("I", iface));
+      }
+    }
+
+    for (size_t j = 0; j < m_shape.fields_per_class; j++) {
+      bool is_static = j % 2 == 1;
+      auto f = static_cast<DexField*>(field(self, is_static, j / 2));
+      if (is_static) {
+        f->make_concrete(ACC_PUBLIC | ACC_STATIC,
+                         DexEncodedValue::zero_for_type(get_int_type()));
+      } else {
+        f->make_concrete(ACC_PUBLIC);
+      }
+      cc.add_field(f);
+    }
+
+    cc.add_method(make_constructor(self, super));
+    for (size_t j = 0; j < static_methods(); j++) {
+      cc.add_method(make_method(i, static_method(i, j), true, interfaces));
+    }
+    for (size_t j = 0; j < virtual_methods(); j++) {
+      cc.add_method(
+          make_method(i, virtual_method(self, j), false, interfaces));
+    }
+    for (auto iface : interfaces) {
+      for (size_t j = 0; j < m_shape.methods_per_interface; j++) {
+        auto ref = DexMethod::make_method(
+            self, interface_method(iface, j)->get_name(), m_int_proto);
+        cc.add_method(make_method(i, ref, false, interfaces));
+      }
+    }
+
+    auto cls = cc.create();
+    if (auto aset = make_annotations(m_shape.annotations_per_class)) {
+      cls->attach_annotation_set(aset);
+    }
+    return cls;
+  }
+
+  const Shape m_shape;
+  std::mt19937 m_rng;
+  DexProto* m_int_proto;
+};
+
+/*
+ * Split the classes into dexes, in order, starting a new dex whenever a class
+ * would take one over the limits on refs.
+ */
+DexClassesVector split_into_dexes(const DexClasses& classes) {
+  DexClassesVector dexen(1);
+  std::unordered_set<DexMethodRef*> methods;
+  std::unordered_set<DexFieldRef*> fields;
+  std::unordered_set<DexType*> types;
+  for (auto cls : classes) {
+    std::vector<DexMethodRef*> cls_methods;
+    std::vector<DexFieldRef*> cls_fields;
+    std::vector<DexType*> cls_types;
+    cls->gather_methods(cls_methods);
+    cls->gather_fields(cls_fields);
+    cls->gather_types(cls_types);
+    auto count_new = [](const auto& refs, const auto& set) {
+      return std::count_if(refs.begin(), refs.end(), [&](auto ref) {
+        return set.count(ref) == 0;
+      });
+    };
+    if (!dexen.back().empty() &&
+        (methods.size() + count_new(cls_methods, methods) > kMaxRefsPerDex ||
+         fields.size() + count_new(cls_fields, fields) > kMaxRefsPerDex ||
+         types.size() + count_new(cls_types, types) > kMaxRefsPerDex)) {
+      dexen.emplace_back();
+      methods.clear();
+      fields.clear();
+      types.clear();
+    }
+    methods.insert(cls_methods.begin(), cls_methods.end());
+    fields.insert(cls_fields.begin(), cls_fields.end());
+    types.insert(cls_types.begin(), cls_types.end());
+    dexen.back().push_back(cls);
+  }
+  return dexen;
+}
+
+class SyntheticApp : public Tool {
+ public:
+  SyntheticApp()
+      : Tool("synthetic-app",
+             "generate the dexes of a synthetic app of a given size and "
+             "shape") {}
+
+  void add_options(po::options_description& options) const override {
+    auto size_option = [&](const char* name, size_t dflt, const char* desc) {
+      options.add_options()(name, po::value<size_t>()->default_value(dflt),
+                            desc);
+    };
+    options.add_options()(
+        "outdir,o",
+        po::value<std::string>()->value_name("out")->required(),
+        "directory to write classes.dex, classes2.dex, ... to");
+    size_option("classes", 1000, "number of classes");
+    size_option("hierarchy-depth", 3,
+                "length of the chains of subclasses, from Object");
+    size_option("interfaces", 100, "number of interfaces");
+    size_option("interfaces-per-class", 1,
+                "number of interfaces each class implements");
+    size_option("methods-per-interface", 2,
+                "number of methods each interface declares");
+    size_option("methods-per-class", 10,
+                "number of methods of each class, besides its constructor "
+                "and the methods of its interfaces; half of them are static");
+    size_option("fields-per-class", 4,
+                "number of int fields of each class; half of them are static");
+    size_option("calls-per-method", 3, "number of calls in each method");
+    size_option("strings", 10000, "number of distinct strings");
+    size_option("strings-per-method", 1,
+                "number of strings each method loads");
+    size_option("annotation-types", 10, "number of annotation types");
+    size_option("annotations-per-class", 1,
+                "number of annotations on each class");
+    size_option("annotations-per-method", 0,
+                "number of annotations on each method");
+    options.add_options()("seed", po::value<unsigned>()->default_value(0),
+                          "seed of the random choices");
+  }
+
+  void run(const po::variables_map& options) override {
+    auto get = [&](const char* name) { return options[name].as<size_t>(); };
+    Shape shape;
+    shape.classes = get("classes");
+    shape.hierarchy_depth = get("hierarchy-depth");
+    shape.interfaces = get("interfaces");
+    shape.interfaces_per_class = get("interfaces-per-class");
+    shape.methods_per_interface = get("methods-per-interface");
+    shape.methods_per_class = get("methods-per-class");
+    shape.fields_per_class = get("fields-per-class");
+    shape.calls_per_method = get("calls-per-method");
+    shape.strings = std::max<size_t>(get("strings"), 1);
+    shape.strings_per_method = get("strings-per-method");
+    shape.annotation_types = get("annotation-types");
+    shape.annotations_per_class = get("annotations-per-class");
+    shape.annotations_per_method = get("annotations-per-method");
+
+    Generator generator(shape, options["seed"].as<unsigned>());
+    auto classes = generator.generate();
+
+    DexStore store("classes");
+    for (auto& dex : split_into_dexes(classes)) {
+      store.add_classes(std::move(dex));
+    }
+    DexStoresVector stores;
+    stores.emplace_back(std::move(store));
+    instruction_lowering::run(stores);
+
+    auto outdir = options["outdir"].as<std::string>();
+    boost::filesystem::create_directories(outdir);
+    ConfigFiles cfg(Json::nullValue, outdir);
+    std::unique_ptr<PositionMapper> pos_mapper(PositionMapper::make("", ""));
+    auto& dexen = stores[0].get_dexen();
+    for (size_t i = 0; i < dexen.size(); i++) {
+      auto filename = outdir + "/classes" +
+                      (i == 0 ? "" : std::to_string(i + 1)) + ".dex";
+      auto stats = write_classes_to_dex(filename,
+                                        &dexen[i],
+                                        nullptr /* locator_index */,
+                                        false /* name-based locators */,
+                                        0,
+                                        i,
+                                        cfg,
+                                        pos_mapper.get(),
+                                        nullptr,
+                                        nullptr,
+                                        nullptr /* IODIMetadata* */);
+      if (m_verbose) {
+        std::cout << filename << ": " << dexen[i].size() << " classes, "
+                  << stats.num_methods << " methods, " << stats.num_bytes
+                  << " bytes" << std::endl;
+      }
+    }
+  }
+};
+
+static SyntheticApp s_tool;
+
+} // namespace
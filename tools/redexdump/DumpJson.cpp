@@ -0,0 +1,178 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "DexEncoding.h"
+#include "PrintUtil.h"
+#include "RedexDump.h"
+
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+/**
+ * Append a dex string as a JSON string literal. Strings are modified UTF-8,
+ * where characters outside of the BMP are already surrogate pairs, so every
+ * non-ASCII code point maps to a single \u escape. Strings that don't decode
+ * are escaped byte by byte instead.
+ */
+static void append_json_string(std::string& out, const char* str) {
+  auto append_escape = [&](uint32_t cp) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "\\u%04x", cp);
+    out.append(buf);
+  };
+  auto start = out.size();
+  out.push_back('"');
+  try {
+    const char* pos = str;
+    uint32_t cp;
+    while ((cp = mutf8_next_code_point(pos))) {
+      if (cp == '"' || cp == '\\') {
+        out.push_back('\\');
+        out.push_back(cp);
+      } else if (cp < ' ' || cp >= 0x7f) {
+        append_escape(cp);
+      } else {
+        out.push_back(cp);
+      }
+    }
+  } catch (const std::invalid_argument&) {
+    out.resize(start + 1);
+    for (const char* pos = str; *pos; pos++) {
+      append_escape((uint8_t)*pos);
+    }
+  }
+  out.push_back('"');
+}
+
+std::string format_json_string(const char* str) {
+  std::string out;
+  append_json_string(out, str);
+  return out;
+}
+
+static void append_type(std::string& out, ddump_data* rd, uint32_t typeidx) {
+  if (typeidx == DEX_NO_INDEX) {
+    out.append("null");
+  } else {
+    append_json_string(out, dex_string_by_type_idx(rd, typeidx));
+  }
+}
+
+static void append_type_list(std::string& out, ddump_data* rd, uint32_t off) {
+  out.push_back('[');
+  if (off) {
+    uint32_t* tl = (uint32_t*)(rd->dexmmap + off);
+    uint32_t count = *tl++;
+    uint16_t* types = (uint16_t*)tl;
+    for (uint32_t i = 0; i < count; i++) {
+      if (i != 0) out.push_back(',');
+      append_type(out, rd, types[i]);
+    }
+  }
+  out.push_back(']');
+}
+
+/**
+ * Print a section as `"name": [items...]`, one item per line. The section is
+ * formatted into a single string, so that it costs one redump call.
+ */
+template <typename F>
+static void dump_json_section(const char* name, uint32_t size, F append_item) {
+  std::string out;
+  out.append("\"").append(name).append("\": [");
+  for (uint32_t i = 0; i < size; i++) {
+    out.append(i == 0 ? "\n" : ",\n");
+    append_item(out, i);
+  }
+  out.append("]");
+  redump("%s", out.c_str());
+}
+
+void dump_json_strings(ddump_data* rd) {
+  dump_json_section("strings", rd->dexh->string_ids_size,
+                    [&](std::string& out, uint32_t i) {
+                      append_json_string(out, dex_string_by_idx(rd, i));
+                    });
+}
+
+void dump_json_types(ddump_data* rd) {
+  dump_json_section("types", rd->dexh->type_ids_size,
+                    [&](std::string& out, uint32_t i) {
+                      append_type(out, rd, i);
+                    });
+}
+
+void dump_json_protos(ddump_data* rd) {
+  dump_json_section(
+      "protos", rd->dexh->proto_ids_size, [&](std::string& out, uint32_t i) {
+        dex_proto_id* proto = rd->dex_proto_ids + i;
+        out.append("{\"shorty\":");
+        append_json_string(out, dex_string_by_idx(rd, proto->shortyidx));
+        out.append(",\"return\":");
+        append_type(out, rd, proto->rtypeidx);
+        out.append(",\"params\":");
+        append_type_list(out, rd, proto->param_off);
+        out.append("}");
+      });
+}
+
+void dump_json_fields(ddump_data* rd) {
+  dump_json_section(
+      "fields", rd->dexh->field_ids_size, [&](std::string& out, uint32_t i) {
+        dex_field_id* field = rd->dex_field_ids + i;
+        out.append("{\"class\":");
+        append_type(out, rd, field->classidx);
+        out.append(",\"type\":");
+        append_type(out, rd, field->typeidx);
+        out.append(",\"name\":");
+        append_json_string(out, dex_string_by_idx(rd, field->nameidx));
+        out.append("}");
+      });
+}
+
+void dump_json_methods(ddump_data* rd) {
+  dump_json_section(
+      "methods", rd->dexh->method_ids_size, [&](std::string& out, uint32_t i) {
+        dex_method_id* method = rd->dex_method_ids + i;
+        out.append("{\"class\":");
+        append_type(out, rd, method->classidx);
+        out.append(",\"name\":");
+        append_json_string(out, dex_string_by_idx(rd, method->nameidx));
+        out.append(",\"proto\":").append(std::to_string(method->protoidx));
+        out.append("}");
+      });
+}
+
+void dump_json_clsdefs(ddump_data* rd) {
+  dump_json_section(
+      "classes", rd->dexh->class_defs_size, [&](std::string& out, uint32_t i) {
+        dex_class_def* cls_def = rd->dex_class_defs + i;
+        out.append("{\"name\":");
+        append_type(out, rd, cls_def->typeidx);
+        out.append(",\"flags\":").append(std::to_string(cls_def->access_flags));
+        out.append(",\"super\":");
+        append_type(out, rd, cls_def->super_idx);
+        out.append(",\"interfaces\":");
+        append_type_list(out, rd, cls_def->interfaces_off);
+        out.append(",\"source_file\":");
+        if (cls_def->source_file_idx == DEX_NO_INDEX) {
+          out.append("null");
+        } else {
+          append_json_string(out,
+                             dex_string_by_idx(rd, cls_def->source_file_idx));
+        }
+        out.append(",\"annotations_off\":")
+            .append(std::to_string(cls_def->annotations_off));
+        out.append(",\"class_data_off\":")
+            .append(std::to_string(cls_def->class_data_offset));
+        out.append(",\"static_values_off\":")
+            .append(std::to_string(cls_def->static_values_off));
+        out.append("}");
+      });
+}
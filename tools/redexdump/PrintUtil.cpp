@@ -13,25 +13,46 @@ bool clean = false;
 bool raw = false;
 bool escape = false;
 
+thread_local std::string* redump_buffer = nullptr;
+
+static void vredump(const char* format, va_list va) {
+  if (redump_buffer == nullptr) {
+    vprintf(format, va);
+    return;
+  }
+  va_list copy;
+  va_copy(copy, va);
+  int size = vsnprintf(nullptr, 0, format, copy);
+  va_end(copy);
+  if (size <= 0) {
+    return;
+  }
+  auto old_size = redump_buffer->size();
+  // vsnprintf writes a terminating NUL, which the resize after drops.
+  redump_buffer->resize(old_size + size + 1);
+  vsnprintf(&(*redump_buffer)[old_size], size + 1, format, va);
+  redump_buffer->resize(old_size + size);
+}
+
 void redump(const char* format, ...) {
   va_list va;
   va_start(va, format);
-  vprintf(format, va);
+  vredump(format, va);
   va_end(va);
 }
 
 void redump(uint32_t off, const char* format, ...) {
   va_list va;
   va_start(va, format);
-  if (!clean) printf("[0x%x] ", off);
-  vprintf(format, va);
+  if (!clean) redump("[0x%x] ", off);
+  vredump(format, va);
   va_end(va);
 }
 
 void redump(uint32_t pos, uint32_t off, const char* format, ...) {
   va_list va;
   va_start(va, format);
-  if (!clean) printf("(0x%x) [0x%x] ", pos, off);
-  vprintf(format, va);
+  if (!clean) redump("(0x%x) [0x%x] ", pos, off);
+  vredump(format, va);
   va_end(va);
 }
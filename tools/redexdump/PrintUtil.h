@@ -8,11 +8,17 @@
 #pragma once
 
 #include <stdint.h>
+#include <string>
 
 extern bool clean;
 extern bool raw;
 extern bool escape;
 
+// When set, redump appends to this buffer instead of printing to stdout. It is
+// per thread, so that sections can be formatted in parallel and written out in
+// order afterwards.
+extern thread_local std::string* redump_buffer;
+
 void redump(const char* format, ...);
 void redump(uint32_t off, const char* format, ...);
 void redump(uint32_t pos, uint32_t off, const char* format, ...);
@@ -10,9 +10,17 @@
 #include <stdio.h>
 #include <string.h>
 #include <getopt.h>
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
 
-#include "PrintUtil.h"
 #include "Formatters.h"
+#include "Parallel.h"
+#include "PrintUtil.h"
+#include "ThreadPool.h"
 
 static const char ddump_usage_string[] =
     "ReDex, DEX Dump tool\n"
@@ -46,8 +54,42 @@ static const char ddump_usage_string[] =
     "--clean: suppress indices and offsets\n"
     "--no-headers: suppress headers\n"
     "--raw: print all bytes, even control characters\n"
+    "--json: print one JSON object per dex file instead, with the string,\n"
+    "  type, proto, field, method and class def sections; the other\n"
+    "  sections are not available as JSON\n"
+    "-j, --jobs=<n>: format sections on n threads (default: number of cores);\n"
+    "  with more than one, a dex file's output is written once it is complete\n"
   ;
 
+/**
+ * Run the section dumpers and print their output in order, separated by
+ * `separator`. With more than one thread, each section is formatted into its
+ * own buffer in parallel and the buffers are written out once all are done;
+ * with one, sections are printed as they are formatted.
+ */
+static void dump_sections(const std::vector<std::function<void()>>& sections,
+                          const char* separator) {
+  if (ThreadPool::get().num_threads() == 1) {
+    for (const auto& section : sections) {
+      redump("%s", separator);
+      section();
+    }
+    return;
+  }
+  std::vector<std::string> buffers(sections.size());
+  std::vector<size_t> indices(sections.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  parallel_for(indices.begin(), indices.end(), [&](size_t i) {
+    redump_buffer = &buffers[i];
+    sections[i]();
+    redump_buffer = nullptr;
+  }, 1);
+  for (const auto& buffer : buffers) {
+    fputs(separator, stdout);
+    fwrite(buffer.data(), 1, buffer.size(), stdout);
+  }
+}
+
 int main(int argc, char* argv[]) {
 
   bool all = false;
@@ -65,6 +107,8 @@ int main(int argc, char* argv[]) {
   bool redexdump_debug = false;
   uint32_t ddebug_offset = 0;
   int no_headers = 0;
+  int json = 0;
+  size_t jobs = std::max(1u, std::thread::hardware_concurrency());
 
   char c;
   static const struct option options[] = {
@@ -86,6 +130,8 @@ int main(int argc, char* argv[]) {
     { "raw", no_argument, (int*)&raw, 1 },
     { "escape", no_argument, (int*)&escape, 1 },
     { "no-headers", no_argument, &no_headers, 1 },
+    { "json", no_argument, &json, 1 },
+    { "jobs", required_argument, nullptr, 'j' },
     { "help", no_argument, nullptr, 'h' },
     { nullptr, 0, nullptr, 0 },
   };
@@ -93,7 +139,7 @@ int main(int argc, char* argv[]) {
   while ((c = getopt_long(
             argc,
             argv,
-            "asStpfmcCxeAdDh",
+            "asStpfmcCxeAdD:hj:",
             &options[0],
             nullptr)) != -1) {
     switch (c) {
@@ -139,6 +185,9 @@ int main(int argc, char* argv[]) {
       case 'D':
         sscanf(optarg, "%x", &ddebug_offset);
         break;
+      case 'j':
+        jobs = std::max(1, atoi(optarg));
+        break;
       case 'h':
         puts(ddump_usage_string);
         return 0;
@@ -156,53 +205,88 @@ int main(int argc, char* argv[]) {
     fprintf(stderr, "%s: no dex files given; use -h for help\n", argv[0]);
     return 1;
   }
+  if (json && (clsdata || code || enarr || anno || redexdump_debug ||
+               ddebug_offset != 0)) {
+    fprintf(stderr,
+            "%s: warning: only the string, type, proto, field, method and "
+            "class def sections are printed as JSON\n",
+            argv[0]);
+  }
 
+  ThreadPool::get().set_num_threads(jobs);
   while (optind < argc) {
     const char* dexfile = argv[optind++];
     ddump_data rd;
     open_dex_file(dexfile, &rd);
+    std::vector<std::function<void()>> sections;
+    if (json) {
+      if (string || stringdata || all) {
+        sections.push_back([&] { dump_json_strings(&rd); });
+      }
+      if (type || all) {
+        sections.push_back([&] { dump_json_types(&rd); });
+      }
+      if (proto || all) {
+        sections.push_back([&] { dump_json_protos(&rd); });
+      }
+      if (field || all) {
+        sections.push_back([&] { dump_json_fields(&rd); });
+      }
+      if (meth || all) {
+        sections.push_back([&] { dump_json_methods(&rd); });
+      }
+      if (clsdef || all) {
+        sections.push_back([&] { dump_json_clsdefs(&rd); });
+      }
+      redump("{\"file\": %s", format_json_string(dexfile).c_str());
+      dump_sections(sections, ",\n");
+      redump("}\n");
+      fflush(stdout);
+      continue;
+    }
     if (!no_headers) {
-      redump(format_map(&rd).c_str());
+      sections.push_back([&] { redump(format_map(&rd).c_str()); });
     }
     if (string || all) {
-      dump_strings(&rd, !no_headers);
+      sections.push_back([&] { dump_strings(&rd, !no_headers); });
     }
     if (stringdata || all) {
-      dump_stringdata(&rd, !no_headers);
+      sections.push_back([&] { dump_stringdata(&rd, !no_headers); });
     }
     if (type || all) {
-      dump_types(&rd);
+      sections.push_back([&] { dump_types(&rd); });
     }
     if (proto || all) {
-      dump_protos(&rd, !no_headers);
+      sections.push_back([&] { dump_protos(&rd, !no_headers); });
     }
     if (field || all) {
-      dump_fields(&rd, !no_headers);
+      sections.push_back([&] { dump_fields(&rd, !no_headers); });
     }
     if (meth || all) {
-      dump_methods(&rd, !no_headers);
+      sections.push_back([&] { dump_methods(&rd, !no_headers); });
     }
     if (clsdef || all) {
-      dump_clsdefs(&rd, !no_headers);
+      sections.push_back([&] { dump_clsdefs(&rd, !no_headers); });
     }
     if (clsdata || all) {
-      dump_clsdata(&rd, !no_headers);
+      sections.push_back([&] { dump_clsdata(&rd, !no_headers); });
     }
     if (code || all) {
-      dump_code(&rd);
+      sections.push_back([&] { dump_code(&rd); });
     }
     if (enarr || all) {
-      dump_enarr(&rd);
+      sections.push_back([&] { dump_enarr(&rd); });
     }
     if (anno || all) {
-      dump_anno(&rd);
+      sections.push_back([&] { dump_anno(&rd); });
     }
     if (redexdump_debug || all) {
-      dump_debug(&rd);
+      sections.push_back([&] { dump_debug(&rd); });
     }
     if (ddebug_offset != 0) {
-      disassemble_debug(&rd, ddebug_offset);
+      sections.push_back([&] { disassemble_debug(&rd, ddebug_offset); });
     }
+    dump_sections(sections, "");
     fprintf(stdout, "\n");
     fflush(stdout);
   }
@@ -22,3 +22,17 @@ void dump_enarr(ddump_data* rd);
 void dump_anno(ddump_data* rd);
 void dump_debug(ddump_data* rd);
 void disassemble_debug(ddump_data* rd, uint32_t offset);
+
+#include <string>
+
+// Quote a modified UTF-8 string as a JSON string literal.
+std::string format_json_string(const char* str);
+
+// JSON counterparts of the id table dumpers. Each prints one `"name": [...]`
+// member of the dex's JSON object, with the items in table order.
+void dump_json_strings(ddump_data* rd);
+void dump_json_types(ddump_data* rd);
+void dump_json_protos(ddump_data* rd);
+void dump_json_fields(ddump_data* rd);
+void dump_json_methods(ddump_data* rd);
+void dump_json_clsdefs(ddump_data* rd);
@@ -136,6 +136,9 @@ DexStoresVector Tool::init(const std::string& system_jar_paths,
   DexStore root_store("dex");
   DexStoresVector stores;
 
+  // Analysis tools rarely look at the code of every method.
+  set_lazy_ballooning(true);
+
   // Load root dexen
   load_root_dexen(root_store, dexen_dir_str, balloon, m_verbose);
   stores.emplace_back(std::move(root_store));
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Adler32.h"
+
+#include <algorithm>
+#include <zlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define ADLER32_HAVE_SSSE3 1
+#endif
+
+namespace {
+
+// Largest prime below 2^16.
+constexpr uint32_t kBase = 65521;
+// The most bytes that can be summed before s2 can overflow 32 bits.
+constexpr size_t kNMax = 5552;
+
+#ifdef ADLER32_HAVE_SSSE3
+/*
+ * Sums 32 bytes per iteration: s1 with a sum of absolute differences against
+ * zero, and s2 with byte weights 32..1 through multiply-adds. The s1 of the
+ * earlier blocks of the run, of which s2 takes 32 copies per block, are summed
+ * apart and scaled once at the end of each run of at most kNMax bytes.
+ */
+__attribute__((target("ssse3"))) uint32_t adler32_ssse3(
+    uint32_t adler, const unsigned char* data, size_t len) {
+  constexpr size_t kBlockSize = 32;
+  uint32_t s1 = adler & 0xffff;
+  uint32_t s2 = adler >> 16;
+  size_t blocks = len / kBlockSize;
+  len -= blocks * kBlockSize;
+
+  const __m128i weights_hi = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24,
+                                           23, 22, 21, 20, 19, 18, 17);
+  const __m128i weights_lo =
+      _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16(1);
+  while (blocks > 0) {
+    size_t n = std::min(blocks, kNMax / kBlockSize);
+    blocks -= n;
+    __m128i v_prev_s1 = _mm_set_epi32(0, 0, 0, s1 * n);
+    __m128i v_s1 = zero;
+    __m128i v_s2 = _mm_set_epi32(0, 0, 0, s2);
+    for (; n > 0; --n, data += kBlockSize) {
+      const __m128i lo =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+      const __m128i hi =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+      v_prev_s1 = _mm_add_epi32(v_prev_s1, v_s1);
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(lo, zero));
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(hi, zero));
+      v_s2 = _mm_add_epi32(
+          v_s2, _mm_madd_epi16(_mm_maddubs_epi16(lo, weights_hi), ones));
+      v_s2 = _mm_add_epi32(
+          v_s2, _mm_madd_epi16(_mm_maddubs_epi16(hi, weights_lo), ones));
+    }
+    v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_prev_s1, 5));
+    // Sum the lanes.
+    v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(2, 3, 0, 1)));
+    v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+    v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+    v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+    s1 = (s1 + static_cast<uint32_t>(_mm_cvtsi128_si32(v_s1))) % kBase;
+    s2 = static_cast<uint32_t>(_mm_cvtsi128_si32(v_s2)) % kBase;
+  }
+  for (; len > 0; --len) {
+    s1 += *data++;
+    s2 += s1;
+  }
+  return ((s2 % kBase) << 16) | (s1 % kBase);
+}
+
+bool cpu_has_ssse3() {
+  unsigned int eax, ebx, ecx, edx;
+  return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSSE3);
+}
+#endif
+
+} // namespace
+
+uint32_t adler32_update(uint32_t adler, const unsigned char* data, size_t len) {
+#ifdef ADLER32_HAVE_SSSE3
+  static const bool use_ssse3 = cpu_has_ssse3();
+  if (use_ssse3) {
+    return adler32_ssse3(adler, data, len);
+  }
+#endif
+  // zlib takes the length as a uInt.
+  while (len > 0) {
+    auto n = static_cast<uInt>(std::min<size_t>(len, 1u << 30));
+    adler = adler32(adler, data, n);
+    data += n;
+    len -= n;
+  }
+  return adler;
+}
@@ -0,0 +1,17 @@
+/**
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Same as zlib's adler32(adler, data, len), but with an SSSE3 kernel that is
+ * used when the CPU has it. Start with adler = 1 for a new checksum.
+ */
+uint32_t adler32_update(uint32_t adler, const unsigned char* data, size_t len);
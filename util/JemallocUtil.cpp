@@ -41,6 +41,65 @@ void set_profile_active(bool active) {
 
 namespace jemalloc_util {
 
+bool get_allocated_bytes(uint64_t* allocated) {
+  if (mallctl == nullptr) {
+    return false;
+  }
+  // jemalloc only refreshes its statistics when the epoch is bumped.
+  uint64_t epoch = 1;
+  size_t len = sizeof(epoch);
+  if (mallctl("epoch", &epoch, &len, &epoch, len) != 0) {
+    return false;
+  }
+  size_t value;
+  len = sizeof(value);
+  if (mallctl("stats.allocated", &value, &len, nullptr, 0) != 0) {
+    return false;
+  }
+  *allocated = value;
+  return true;
+}
+
+bool set_background_thread(bool enable) {
+  if (mallctl == nullptr) {
+    return false;
+  }
+  return mallctl("background_thread", nullptr, nullptr, (void*)&enable,
+                 sizeof(enable)) == 0;
+}
+
+bool use_own_arena() {
+  if (mallctl == nullptr) {
+    return false;
+  }
+  unsigned arena;
+  size_t len = sizeof(arena);
+  if (mallctl("arenas.create", &arena, &len, nullptr, 0) != 0) {
+    return false;
+  }
+  return mallctl("thread.arena", nullptr, nullptr, (void*)&arena,
+                 sizeof(arena)) == 0;
+}
+
+bool set_thread_cache(bool enable) {
+  if (mallctl == nullptr) {
+    return false;
+  }
+  return mallctl("thread.tcache.enabled", nullptr, nullptr, (void*)&enable,
+                 sizeof(enable)) == 0;
+}
+
+bool purge_all_arenas() {
+  if (mallctl == nullptr) {
+    return false;
+  }
+  // The cached objects would keep their pages dirty otherwise. Failing to
+  // flush is fine, e.g. if the thread cache is disabled.
+  mallctl("thread.tcache.flush", nullptr, nullptr, nullptr, 0);
+  // MALLCTL_ARENAS_ALL, which jemalloc.h would define, stands for all arenas.
+  return mallctl("arena.4096.purge", nullptr, nullptr, nullptr, 0) == 0;
+}
+
 void enable_profiling() { set_profile_active(true); }
 
 void disable_profiling() { set_profile_active(false); }
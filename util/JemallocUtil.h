@@ -5,6 +5,7 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <cstdint>
 #include <cstdio>
 
 namespace jemalloc_util {
@@ -13,6 +14,40 @@ void enable_profiling();
 
 void disable_profiling();
 
+/*
+ * Total number of bytes currently allocated by the application, as reported
+ * by jemalloc's "stats.allocated". Returns false if jemalloc is not linked in.
+ */
+bool get_allocated_bytes(uint64_t* allocated);
+
+/*
+ * Start or stop jemalloc's background threads, which return unused dirty
+ * pages to the OS as they decay, instead of leaving that to whichever thread
+ * happens to allocate next. Returns false if jemalloc is not linked in, or
+ * doesn't support them.
+ */
+bool set_background_thread(bool enable);
+
+/*
+ * Move the calling thread to an arena of its own, so that it doesn't contend
+ * with other threads, nor interleave its allocations with theirs. Returns
+ * false if jemalloc is not linked in.
+ */
+bool use_own_arena();
+
+/*
+ * Turn the thread cache of the calling thread on or off. The maximum size of
+ * the cached objects can only be set when jemalloc starts, with the
+ * `tcache_max` option of MALLOC_CONF.
+ */
+bool set_thread_cache(bool enable);
+
+/*
+ * Return the unused dirty pages of every arena to the OS, after flushing the
+ * thread cache of the calling thread. Live allocations are not affected.
+ */
+bool purge_all_arenas();
+
 class ScopedProfiling final {
  public:
   ScopedProfiling(bool enable) {
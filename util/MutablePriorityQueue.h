@@ -7,11 +7,20 @@
 
 #pragma once
 
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 /*
  * Collection type that maintains a set of elements with associated
  * priorities, allowing updating priorities, and enabling efficient
  * retrieval of the element with the highest priority.
  *
+ * This is a binary heap that knows the position of each value, so that
+ * updating the priority of a value just sifts it up or down, rather than
+ * removing and inserting it.
+ *
  * Limitations:
  * - The same value cannot be present twice (even with a different priority)
  * - No two values can exist in the queue with the same priority at the same
@@ -22,44 +31,133 @@ template <class Value,
           class PriorityCompare = std::less<Priority>>
 class MutablePriorityQueue {
  private:
-  std::map<Priority, Value, PriorityCompare> m_values;
-  std::unordered_map<Value, Priority> m_priorities;
+  using Entry = std::pair<Priority, Value>;
+  std::vector<Entry> m_heap;
+  std::unordered_map<Value, size_t> m_positions;
+  PriorityCompare m_compare;
+
+  // Whether the entry at position i belongs above the entry at position j.
+  bool above(size_t i, size_t j) const {
+    return m_compare(m_heap[j].first, m_heap[i].first);
+  }
+
+  void place(size_t i, Entry entry) {
+    m_positions[entry.second] = i;
+    m_heap[i] = std::move(entry);
+  }
+
+  void sift_up(size_t i) {
+    Entry entry = std::move(m_heap[i]);
+    while (i > 0) {
+      size_t parent = (i - 1) / 2;
+      if (!m_compare(m_heap[parent].first, entry.first)) {
+        break;
+      }
+      place(i, std::move(m_heap[parent]));
+      i = parent;
+    }
+    place(i, std::move(entry));
+  }
+
+  void sift_down(size_t i) {
+    Entry entry = std::move(m_heap[i]);
+    size_t size = m_heap.size();
+    while (true) {
+      size_t child = 2 * i + 1;
+      if (child >= size) {
+        break;
+      }
+      if (child + 1 < size && above(child + 1, child)) {
+        ++child;
+      }
+      if (!m_compare(entry.first, m_heap[child].first)) {
+        break;
+      }
+      place(i, std::move(m_heap[child]));
+      i = child;
+    }
+    place(i, std::move(entry));
+  }
+
+  void restore(size_t i) {
+    if (i > 0 && above(i, (i - 1) / 2)) {
+      sift_up(i);
+    } else {
+      sift_down(i);
+    }
+  }
 
  public:
   // Inserts a value with a priority; neither value or priority can already be
   // present.
   void insert(const Value& value, const Priority& priority) {
-    auto map_result = m_values.insert({priority, value});
-    always_assert(map_result.second);
-    auto priorities_result = m_priorities.insert({value, priority});
-    always_assert(priorities_result.second);
+    auto positions_result = m_positions.emplace(value, m_heap.size());
+    always_assert(positions_result.second);
+    m_heap.emplace_back(priority, value);
+    sift_up(m_heap.size() - 1);
   }
 
   // Erases a value that's currently in the queue.
   void erase(const Value& value) {
-    auto old_priority_it = m_priorities.find(value);
-    always_assert(old_priority_it != m_priorities.end());
-    const auto erased = m_values.erase(old_priority_it->second);
-    always_assert(erased);
-    m_priorities.erase(old_priority_it);
+    auto it = m_positions.find(value);
+    always_assert(it != m_positions.end());
+    size_t i = it->second;
+    m_positions.erase(it);
+    size_t last = m_heap.size() - 1;
+    if (i != last) {
+      place(i, std::move(m_heap[last]));
+      m_heap.pop_back();
+      restore(i);
+    } else {
+      m_heap.pop_back();
+    }
   }
 
   // Changes the priority of a value. The value must already be in the queue.
   // No current queue element may already have the new priority.
   void update_priority(const Value& value, const Priority& priority) {
-    erase(value);
-    insert(value, priority);
+    auto it = m_positions.find(value);
+    always_assert(it != m_positions.end());
+    size_t i = it->second;
+    m_heap[i].first = priority;
+    restore(i);
+  }
+
+  // Changes the priorities of many values at once, with the same
+  // requirements as update_priority. When a large part of the queue changes,
+  // rebuilding the heap in linear time beats updating each value.
+  void update_priorities(
+      const std::vector<std::pair<Value, Priority>>& updates) {
+    if (updates.size() < m_heap.size() / 8) {
+      for (const auto& p : updates) {
+        update_priority(p.first, p.second);
+      }
+      return;
+    }
+    for (const auto& p : updates) {
+      m_heap[m_positions.at(p.first)].first = p.second;
+    }
+    auto by_priority = [this](const Entry& a, const Entry& b) {
+      return m_compare(a.first, b.first);
+    };
+    std::make_heap(m_heap.begin(), m_heap.end(), by_priority);
+    for (size_t i = 0; i < m_heap.size(); ++i) {
+      m_positions[m_heap[i].second] = i;
+    }
   }
 
   // Removes all elements.
   void clear() {
-    m_values.clear();
-    m_priorities.clear();
+    m_heap.clear();
+    m_positions.clear();
   }
 
   // Checks if queue is empty.
-  bool empty() const { return m_values.empty(); }
+  bool empty() const { return m_heap.empty(); }
+
+  // Returns the number of elements.
+  size_t size() const { return m_heap.size(); }
 
   // Returns element with highest priority.
-  Value front() const { return m_values.rbegin()->second; }
+  Value front() const { return m_heap.front().second; }
 };
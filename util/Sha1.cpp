@@ -14,6 +14,18 @@
 
 #include <cstring>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA1_HAVE_SHA_NI 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO) && \
+    defined(__linux__)
+#include <arm_neon.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#define SHA1_HAVE_ARMV8_CRYPTO 1
+#endif
+
 static const unsigned char PADDING[128] = {
   0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -208,6 +220,184 @@ static void sha1_transform(
   memset((unsigned char*) x, 0, sizeof(x));
 }
 
+#ifdef SHA1_HAVE_SHA_NI
+/*
+ * Rounds 4i+1 to 4i+4 with the SHA extensions, where f picks the round
+ * function. Also computes the message words of rounds 4i+17 to 4i+20, and the
+ * `e` of the next rounds, which is the rotated `a` from before these ones.
+ */
+#define SHA_NI_ROUNDS4(i, f) {                                          \
+    const __m128i prev_abcd = abcd;                                     \
+    abcd = _mm_sha1rnds4_epu32(abcd, e, f);                             \
+    if ((i) < 16) {                                                     \
+      msg[(i) % 4] = _mm_sha1msg2_epu32(                                \
+          _mm_xor_si128(_mm_sha1msg1_epu32(msg[(i) % 4],                \
+                                           msg[((i) + 1) % 4]),         \
+                        msg[((i) + 2) % 4]),                            \
+          msg[((i) + 3) % 4]);                                          \
+    }                                                                   \
+    e = _mm_sha1nexte_epu32(prev_abcd,                                  \
+                            (i) < 19 ? msg[((i) + 1) % 4] : e0_save);   \
+  }
+
+/*
+ * Same as calling sha1_transform on each of the `blocks` blocks of `input`, with
+ * the SHA extensions.
+ */
+__attribute__((target("sha,sse4.1"))) static void sha1_transform_sha_ni(
+    unsigned int state[5], const unsigned char* input, size_t blocks) {
+  const __m128i byte_swap =
+      _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+  __m128i abcd = _mm_shuffle_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+  __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+  for (; blocks > 0; --blocks, input += 64) {
+    const __m128i abcd_save = abcd;
+    const __m128i e0_save = e0;
+    __m128i msg[4];
+    for (int i = 0; i < 4; ++i) {
+      msg[i] = _mm_shuffle_epi8(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 16 * i)),
+          byte_swap);
+    }
+    __m128i e = _mm_add_epi32(e0, msg[0]);
+    SHA_NI_ROUNDS4(0, 0);  /* 1-4 */
+    SHA_NI_ROUNDS4(1, 0);  /* 5-8 */
+    SHA_NI_ROUNDS4(2, 0);  /* 9-12 */
+    SHA_NI_ROUNDS4(3, 0);  /* 13-16 */
+    SHA_NI_ROUNDS4(4, 0);  /* 17-20 */
+    SHA_NI_ROUNDS4(5, 1);  /* 21-24 */
+    SHA_NI_ROUNDS4(6, 1);  /* 25-28 */
+    SHA_NI_ROUNDS4(7, 1);  /* 29-32 */
+    SHA_NI_ROUNDS4(8, 1);  /* 33-36 */
+    SHA_NI_ROUNDS4(9, 1);  /* 37-40 */
+    SHA_NI_ROUNDS4(10, 2); /* 41-44 */
+    SHA_NI_ROUNDS4(11, 2); /* 45-48 */
+    SHA_NI_ROUNDS4(12, 2); /* 49-52 */
+    SHA_NI_ROUNDS4(13, 2); /* 53-56 */
+    SHA_NI_ROUNDS4(14, 2); /* 57-60 */
+    SHA_NI_ROUNDS4(15, 3); /* 61-64 */
+    SHA_NI_ROUNDS4(16, 3); /* 65-68 */
+    SHA_NI_ROUNDS4(17, 3); /* 69-72 */
+    SHA_NI_ROUNDS4(18, 3); /* 73-76 */
+    SHA_NI_ROUNDS4(19, 3); /* 77-80 */
+    e0 = e;
+    abcd = _mm_add_epi32(abcd, abcd_save);
+  }
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state),
+                   _mm_shuffle_epi32(abcd, 0x1B));
+  state[4] = _mm_extract_epi32(e0, 3);
+}
+
+static bool cpu_has_sha_ni() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+      !(ecx & bit_SSE4_1) || !(ecx & bit_SSSE3)) {
+    return false;
+  }
+  if (__get_cpuid_max(0, nullptr) < 7) {
+    return false;
+  }
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  return ebx & (1u << 29);
+}
+#endif
+
+#ifdef SHA1_HAVE_ARMV8_CRYPTO
+/*
+ * Rounds 4i+1 to 4i+4 with the ARMv8 crypto extensions, where op is the
+ * instruction of the round function. Same as SHA_NI_ROUNDS4 otherwise.
+ */
+#define ARMV8_ROUNDS4(i, op) {                                          \
+    const uint32x4_t wk = vaddq_u32(msg[(i) % 4], k[(i) / 5]);          \
+    const uint32_t next_e = vsha1h_u32(vgetq_lane_u32(abcd, 0));        \
+    abcd = op(abcd, e, wk);                                             \
+    e = next_e;                                                         \
+    if ((i) < 16) {                                                     \
+      msg[(i) % 4] = vsha1su1q_u32(                                     \
+          vsha1su0q_u32(msg[(i) % 4], msg[((i) + 1) % 4],               \
+                        msg[((i) + 2) % 4]),                            \
+          msg[((i) + 3) % 4]);                                          \
+    }                                                                   \
+  }
+
+/*
+ * Same as calling sha1_transform on each of the `blocks` blocks of `input`, with
+ * the ARMv8 crypto extensions.
+ */
+static void sha1_transform_armv8(unsigned int state[5],
+                                 const unsigned char* input,
+                                 size_t blocks) {
+  const uint32x4_t k[4] = {vdupq_n_u32(0x5A827999), vdupq_n_u32(0x6ED9EBA1),
+                           vdupq_n_u32(0x8F1BBCDC), vdupq_n_u32(0xCA62C1D6)};
+  uint32x4_t abcd = vld1q_u32(state);
+  uint32_t e0 = state[4];
+
+  for (; blocks > 0; --blocks, input += 64) {
+    const uint32x4_t abcd_save = abcd;
+    const uint32_t e0_save = e0;
+    uint32x4_t msg[4];
+    for (int i = 0; i < 4; ++i) {
+      msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(input + 16 * i)));
+    }
+    uint32_t e = e0;
+    ARMV8_ROUNDS4(0, vsha1cq_u32);  /* 1-4 */
+    ARMV8_ROUNDS4(1, vsha1cq_u32);  /* 5-8 */
+    ARMV8_ROUNDS4(2, vsha1cq_u32);  /* 9-12 */
+    ARMV8_ROUNDS4(3, vsha1cq_u32);  /* 13-16 */
+    ARMV8_ROUNDS4(4, vsha1cq_u32);  /* 17-20 */
+    ARMV8_ROUNDS4(5, vsha1pq_u32);  /* 21-24 */
+    ARMV8_ROUNDS4(6, vsha1pq_u32);  /* 25-28 */
+    ARMV8_ROUNDS4(7, vsha1pq_u32);  /* 29-32 */
+    ARMV8_ROUNDS4(8, vsha1pq_u32);  /* 33-36 */
+    ARMV8_ROUNDS4(9, vsha1pq_u32);  /* 37-40 */
+    ARMV8_ROUNDS4(10, vsha1mq_u32); /* 41-44 */
+    ARMV8_ROUNDS4(11, vsha1mq_u32); /* 45-48 */
+    ARMV8_ROUNDS4(12, vsha1mq_u32); /* 49-52 */
+    ARMV8_ROUNDS4(13, vsha1mq_u32); /* 53-56 */
+    ARMV8_ROUNDS4(14, vsha1mq_u32); /* 57-60 */
+    ARMV8_ROUNDS4(15, vsha1pq_u32); /* 61-64 */
+    ARMV8_ROUNDS4(16, vsha1pq_u32); /* 65-68 */
+    ARMV8_ROUNDS4(17, vsha1pq_u32); /* 69-72 */
+    ARMV8_ROUNDS4(18, vsha1pq_u32); /* 73-76 */
+    ARMV8_ROUNDS4(19, vsha1pq_u32); /* 77-80 */
+    e0 = e + e0_save;
+    abcd = vaddq_u32(abcd, abcd_save);
+  }
+
+  vst1q_u32(state, abcd);
+  state[4] = e0;
+}
+#endif
+
+/*
+ * Runs sha1_transform on consecutive blocks, with the CPU's SHA-1
+ * instructions if it has them.
+ */
+static void sha1_transform_blocks(unsigned int state[5],
+                                  const unsigned char* input,
+                                  size_t blocks) {
+#ifdef SHA1_HAVE_SHA_NI
+  static const bool use_sha_ni = cpu_has_sha_ni();
+  if (use_sha_ni) {
+    sha1_transform_sha_ni(state, input, blocks);
+    return;
+  }
+#endif
+#ifdef SHA1_HAVE_ARMV8_CRYPTO
+  static const bool use_armv8 = getauxval(AT_HWCAP) & HWCAP_SHA1;
+  if (use_armv8) {
+    sha1_transform_armv8(state, input, blocks);
+    return;
+  }
+#endif
+  for (; blocks > 0; --blocks, input += 64) {
+    sha1_transform(state, input);
+  }
+}
+
 /*
  * SHA1 initialization. Begins an SHA1 operation, writing a new context.
  */
@@ -248,10 +438,11 @@ void sha1_update(
   if (inputLen >= partLen) {
     memcpy((unsigned char*) & context->buffer[index], (unsigned char*) input,
            partLen);
-    sha1_transform(context->state, context->buffer);
+    sha1_transform_blocks(context->state, context->buffer, 1);
 
-    for (i = partLen; i + 63 < inputLen; i += 64)
-      sha1_transform(context->state, &input[i]);
+    i = partLen;
+    sha1_transform_blocks(context->state, &input[i], (inputLen - i) / 64);
+    i += (inputLen - i) / 64 * 64;
 
     index = 0;
   } else